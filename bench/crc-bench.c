@@ -0,0 +1,84 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <sysexits.h>
+#include <lib-common/parseopt.h>
+#include <lib-common/datetime.h>
+#include <lib-common/hash.h>
+
+/* This bench measures the throughput of the CRC functions:
+ *
+ *     ./crc-bench -s 4096 -n 100000
+ *
+ * computes the CRCs of a buffer of 4KiB 100000 times, and prints the
+ * throughput in MB/s.
+ */
+
+static struct {
+    int  size;
+    int  loops;
+    int  help;
+} bench_g = {
+#define _G  bench_g
+    .size  = 64 << 10,
+    .loops = 10000,
+};
+
+static popt_t popts[] = {
+    OPT_FLAG('h', "help",  &_G.help,  "show help"),
+    OPT_INT('s',  "size",  &_G.size,  "size of the input (default: 64KiB)"),
+    OPT_INT('n',  "loops", &_G.loops, "number of runs (default: 10000)"),
+    OPT_END(),
+};
+
+#define BENCH(name, expr)                                                    \
+    do {                                                                     \
+        proctimer_t pt;                                                      \
+        uint64_t res = 0;                                                    \
+                                                                             \
+        proctimer_start(&pt);                                                \
+        for (int i = 0; i < _G.loops; i++) {                                 \
+            res ^= (expr);                                                   \
+        }                                                                    \
+        proctimer_stop(&pt);                                                 \
+        printf("%-8s %8.1f MB/s (%jx)\n", name,                              \
+               (double)_G.size * _G.loops / MAX(pt.elapsed_real, 1),         \
+               (uintmax_t)res);                                              \
+    } while (0)
+
+int main(int argc, char **argv)
+{
+    const char *arg0 = NEXTARG(argc, argv);
+    SB_1k(buf);
+
+    argc = parseopt(argc, argv, popts, 0);
+    if (argc != 0 || _G.help || _G.size <= 0) {
+        makeusage(_G.help ? EX_OK : EX_USAGE, arg0, "", NULL, popts);
+    }
+
+    for (int i = 0; i < _G.size; i++) {
+        sb_addc(&buf, rand());
+    }
+
+    BENCH("crc32",  icrc32(0, buf.data, buf.len));
+    BENCH("crc32c", icrc32c(0, buf.data, buf.len));
+    BENCH("crc64",  icrc64(0, buf.data, buf.len));
+
+    sb_wipe(&buf);
+    return 0;
+}
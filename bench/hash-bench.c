@@ -0,0 +1,91 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <sysexits.h>
+#include <lib-common/parseopt.h>
+#include <lib-common/datetime.h>
+#include <lib-common/hash.h>
+
+/* This bench compares the non-cryptographic hashes on keys of a given size:
+ *
+ *     ./hash-bench -s 16 -n 10000000
+ *
+ * hashes 16 bytes keys 10 million times with each function, and prints the
+ * number of hashes per second and the throughput.
+ */
+
+static struct {
+    int  size;
+    int  loops;
+    int  help;
+} bench_g = {
+#define _G  bench_g
+    .size  = 32,
+    .loops = 10000000,
+};
+
+static popt_t popts[] = {
+    OPT_FLAG('h', "help",  &_G.help,  "show help"),
+    OPT_INT('s',  "size",  &_G.size,  "size of the keys (default: 32)"),
+    OPT_INT('n',  "loops", &_G.loops, "number of runs (default: 10000000)"),
+    OPT_END(),
+};
+
+#define BENCH(name, expr)                                                    \
+    do {                                                                     \
+        proctimer_t pt;                                                      \
+        uint64_t res = 0;                                                    \
+                                                                             \
+        proctimer_start(&pt);                                                \
+        for (int i = 0; i < _G.loops; i++) {                                 \
+            /* Use 16 different keys so that the loop is not hoisted. */    \
+            const char *key = keys.data + (i & 15) * _G.size;                \
+                                                                             \
+            res ^= (expr);                                                   \
+        }                                                                    \
+        proctimer_stop(&pt);                                                 \
+        printf("%-20s %8.1f Mh/s %8.1f MB/s (%jx)\n", name,                  \
+               (double)_G.loops / MAX(pt.elapsed_real, 1),                   \
+               (double)_G.size * _G.loops / MAX(pt.elapsed_real, 1),         \
+               (uintmax_t)res);                                              \
+    } while (0)
+
+int main(int argc, char **argv)
+{
+    const char *arg0 = NEXTARG(argc, argv);
+    SB_1k(keys);
+
+    argc = parseopt(argc, argv, popts, 0);
+    if (argc != 0 || _G.help || _G.size < 0) {
+        makeusage(_G.help ? EX_OK : EX_USAGE, arg0, "", NULL, popts);
+    }
+
+    for (int i = 0; i < 16 * _G.size; i++) {
+        sb_addc(&keys, rand());
+    }
+
+    BENCH("jenkins_hash",        jenkins_hash(key, _G.size));
+    BENCH("hsieh_hash",          hsieh_hash(key, _G.size));
+    BENCH("murmur_hash3_x86_32", murmur_hash3_x86_32(key, _G.size, 0));
+    BENCH("murmur3_128_hash_64", murmur3_128_hash_64(key, _G.size));
+    BENCH("crc64_hash_64",       crc64_hash_64(key, _G.size));
+    BENCH("wyhash64",            wyhash64(key, _G.size, 0));
+
+    sb_wipe(&keys);
+    return 0;
+}
@@ -0,0 +1,100 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/datetime.h>
+#include <lib-common/iop.h>
+#include "../tests/iop/tstiop.iop.h"
+
+/* This bench measures the throughput of the binary (un)packing of repeated
+ * integer fields.
+ *
+ * Launch bench:
+ *
+ *     ./iop-bpack-bench <nb-integers> <nb-loops> <max-value>
+ *
+ * The integers are random between -max-value and max-value, so that a
+ * max-value under 128 packs every integer on an INT1.
+ */
+
+static void bench_report(const char *what, size_t bytes, long long elapsed)
+{
+    printf("%s: %zu bytes, %lld.%03lld ms, %.1f MB/s\n", what, bytes,
+           elapsed / 1000, elapsed % 1000,
+           elapsed ? (double)bytes / elapsed : 0.);
+}
+
+int main(int argc, char **argv)
+{
+    t_scope;
+    tstiop__repeated__t rep;
+    tstiop__repeated__t *res = NULL;
+    int nb_ints;
+    int nb_loops;
+    int max;
+    int32_t *ints;
+    lstr_t packed = LSTR_NULL_V;
+    proctimer_t pt;
+    long long elapsed;
+
+    if (argc <= 3) {
+        fprintf(stderr, "usage: %s nb_integers nb_loops max_value\n",
+                argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    nb_ints  = atoi(argv[1]);
+    nb_loops = atoi(argv[2]);
+    max      = atoi(argv[3]);
+    if (nb_ints <= 0 || nb_loops <= 0 || max <= 0) {
+        fprintf(stderr, "invalid arguments\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ints = t_new_raw(int32_t, nb_ints);
+    for (int i = 0; i < nb_ints; i++) {
+        ints[i] = rand_range(-max, max);
+    }
+    iop_init(tstiop__repeated, &rep);
+    rep.i32 = (iop_array_i32_t)IOP_ARRAY(ints, nb_ints);
+
+    proctimer_start(&pt);
+    for (int i = 0; i < nb_loops; i++) {
+        t_scope;
+
+        packed = t_iop_bpack_struct(&tstiop__repeated__s, &rep);
+    }
+    elapsed = proctimer_stop(&pt);
+    packed = t_iop_bpack_struct(&tstiop__repeated__s, &rep);
+    bench_report("pack", packed.len * nb_loops, elapsed);
+
+    proctimer_start(&pt);
+    for (int i = 0; i < nb_loops; i++) {
+        t_scope;
+
+        if (iop_bunpack_ptr(t_pool(), &tstiop__repeated__s, (void **)&res,
+                            ps_initlstr(&packed), false) < 0)
+        {
+            fprintf(stderr, "unpacking failed: %s\n", iop_get_err());
+            exit(EXIT_FAILURE);
+        }
+        res = NULL;
+    }
+    elapsed = proctimer_stop(&pt);
+    bench_report("unpack", packed.len * nb_loops, elapsed);
+
+    return 0;
+}
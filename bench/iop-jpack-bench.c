@@ -0,0 +1,108 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/datetime.h>
+#include <lib-common/iop-json.h>
+#include "../tests/iop/tstiop.iop.h"
+
+/* This bench measures the throughput of the json packing and unpacking of
+ * arrays of strings and structures.
+ *
+ * Launch bench:
+ *
+ *     ./iop-jpack-bench <nb-elements> <nb-loops> <string-len>
+ *
+ * One character out of 64 of the strings needs escaping.
+ */
+
+static void bench_report(const char *what, size_t bytes, long long elapsed)
+{
+    printf("%s: %zu bytes, %lld.%03lld ms, %.1f MB/s\n", what, bytes,
+           elapsed / 1000, elapsed % 1000,
+           elapsed ? (double)bytes / elapsed : 0.);
+}
+
+int main(int argc, char **argv)
+{
+    t_scope;
+    tstiop__my_struct_f__t sf;
+    tstiop__my_struct_f__t *res = NULL;
+    int nb_elems;
+    int nb_loops;
+    int str_len;
+    lstr_t *strs;
+    tstiop__my_struct_b__t *sbs;
+    SB_1k(sb);
+    proctimer_t pt;
+    long long elapsed;
+
+    if (argc <= 3) {
+        fprintf(stderr, "usage: %s nb_elements nb_loops string_len\n",
+                argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    nb_elems = atoi(argv[1]);
+    nb_loops = atoi(argv[2]);
+    str_len  = atoi(argv[3]);
+    if (nb_elems <= 0 || nb_loops <= 0 || str_len < 0) {
+        fprintf(stderr, "invalid arguments\n");
+        exit(EXIT_FAILURE);
+    }
+
+    strs = t_new_raw(lstr_t, nb_elems);
+    sbs  = t_new(tstiop__my_struct_b__t, nb_elems);
+    for (int i = 0; i < nb_elems; i++) {
+        char *s = t_new_raw(char, str_len + 1);
+
+        for (int j = 0; j < str_len; j++) {
+            s[j] = rand_range(0, 63) ? rand_range('a', 'z') : '"';
+        }
+        s[str_len] = '\0';
+        strs[i] = LSTR_INIT_V(s, str_len);
+        OPT_SET(sbs[i].a, i);
+    }
+    iop_init(tstiop__my_struct_f, &sf);
+    sf.a = (iop_array_lstr_t)IOP_ARRAY(strs, nb_elems);
+    sf.c = IOP_TYPED_ARRAY(tstiop__my_struct_b, sbs, nb_elems);
+
+    proctimer_start(&pt);
+    for (int i = 0; i < nb_loops; i++) {
+        sb_reset(&sb);
+        iop_sb_jpack(&sb, &tstiop__my_struct_f__s, &sf, 0);
+    }
+    elapsed = proctimer_stop(&pt);
+    bench_report("pack", sb.len * nb_loops, elapsed);
+
+    proctimer_start(&pt);
+    for (int i = 0; i < nb_loops; i++) {
+        t_scope;
+        pstream_t ps = ps_initsb(&sb);
+
+        if (t_iop_junpack_ptr_ps(&ps, &tstiop__my_struct_f__s, (void **)&res,
+                                 0, NULL) < 0)
+        {
+            fprintf(stderr, "unpacking failed\n");
+            exit(EXIT_FAILURE);
+        }
+        res = NULL;
+    }
+    elapsed = proctimer_stop(&pt);
+    bench_report("unpack", sb.len * nb_loops, elapsed);
+
+    return 0;
+}
@@ -114,6 +114,31 @@ int main(int argc, char **argv)
     fprintf(stderr, "isnprintf: %d tests, %ld bytes, %d.%03d ms.\n",
             count, nbytes, elapsed / 1000, elapsed % 1000);
 
+    nbytes = 0;
+    proctimer_start(&pt);
+
+    for (i = 0; i < count; i++) {
+        event->type = "ABDG"[i & 3];
+        event->msisdn = 33612345678LL + i + (i ^ 4321);
+        event->camp_lineno = i & 16383;
+        event->camp_id = i >> 14;
+        event->remote_id = 1;
+        event->payload_len = 0;
+
+        len = isnprintf_cached(buf, sizeof(buf),
+                               "%d|%c|%lld|%d|%d|%u|%d|\n",
+                               event->stamp, event->type,
+                               (long long)event->msisdn,
+                               event->camp_lineno, event->camp_id,
+                               event->remote_id, event->payload_len);
+        nbytes += len;
+    }
+
+    elapsed = proctimer_stop(&pt);
+
+    fprintf(stderr, "isnprintf_cached: %d tests, %ld bytes, %d.%03d ms.\n",
+            count, nbytes, elapsed / 1000, elapsed % 1000);
+
     p_fclose(&out1);
     p_fclose(&out2);
 
@@ -0,0 +1,142 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <sysexits.h>
+#include <lib-common/parseopt.h>
+#include <lib-common/datetime.h>
+#include <lib-common/iop-rpc.h>
+#include "../tests/iop/tstiop.iop.h"
+
+/* This bench measures the throughput of the IOP RPCs served over HTTP, in
+ * JSON.
+ *
+ * It serves the tstiop.Iface.f RPC on /iop/iface/f and reports the number of
+ * answered queries per second, while a load generator sends the queries.
+ * With HTTP/2 in clear text (the default):
+ *
+ *     ./rpc-http-bench -p 1080 &
+ *     echo '{ "i": 42 }' > q.json
+ *     h2load -n 1000000 -c 16 -m 32 -d q.json \
+ *         -H 'Content-Type: application/json' \
+ *         http://127.0.0.1:1080/iop/iface/f
+ *
+ * Add -H 'Accept-Encoding: gzip' to measure the compressed answers, and
+ * start the bench with -1 and use h2load --h1 to measure HTTP/1.1.
+ */
+
+static struct {
+    int  port;
+    int  help;
+    bool http1;
+
+    el_t httpd;
+    el_t blocker;
+    el_t report;
+
+    uint64_t replies;
+    uint64_t bytes;
+    proctimer_t pt;
+} bench_g = {
+#define _G  bench_g
+    .port = 1080,
+};
+
+static popt_t popts[] = {
+    OPT_FLAG('h', "help", &_G.help,  "show help"),
+    OPT_FLAG('1', "http1", &_G.http1, "serve HTTP/1.x instead of HTTP/2"),
+    OPT_INT('p', "port",  &_G.port,  "port to listen to (default: 1080)"),
+    OPT_END(),
+};
+
+static void f_cb(IOP_RPC_IMPL_ARGS(tstiop__t, iface, f))
+{
+    ic_reply(ic, slot, tstiop__t, iface, f, .i = arg->i);
+}
+
+static void on_reply(const httpd_trigger__ic_t *tcb,
+                     const ichttp_query_t *iq, size_t res_size,
+                     http_code_t res_code)
+{
+    _G.replies++;
+    _G.bytes += res_size;
+}
+
+static void on_report(el_t ev, data_t priv)
+{
+    proctimer_stop(&_G.pt);
+    if (_G.replies) {
+        printf("%.0f req/s, %.1f bytes/reply, %s\n",
+               _G.replies * 1000000. / MAX(_G.pt.elapsed_real, 1),
+               (double)_G.bytes / _G.replies,
+               proctimer_report(&_G.pt, "cpu: %p ms"));
+    }
+    _G.replies = 0;
+    _G.bytes   = 0;
+    proctimer_start(&_G.pt);
+}
+
+static void on_term(el_t ev, int signo, data_t priv)
+{
+    el_unregister(&_G.blocker);
+}
+
+int main(int argc, char **argv)
+{
+    const char *arg0 = NEXTARG(argc, argv);
+    httpd_trigger__ic_t *itcb;
+    httpd_cfg_t *cfg;
+    sockunion_t su = {
+        .sin = {
+            .sin_family = AF_INET,
+            .sin_addr   = { INADDR_ANY },
+        }
+    };
+
+    argc = parseopt(argc, argv, popts, 0);
+    if (argc != 0 || _G.help) {
+        makeusage(_G.help ? EX_OK : EX_USAGE, arg0, "", NULL, popts);
+    }
+
+    cfg = httpd_cfg_new();
+    cfg->mode = _G.http1 ? HTTP_MODE_USE_HTTP1X_ONLY
+                         : HTTP_MODE_USE_HTTP2_ONLY;
+    itcb = httpd_trigger__ic_new(&tstiop__t__mod, "http://example.com/tstiop",
+                                 1 << 20);
+    itcb->jpack_flags = IOP_JPACK_NO_WHITESPACES;
+    itcb->on_reply    = &on_reply;
+    httpd_trigger_register(cfg, POST, "iop", &itcb->cb);
+    ichttp_register_(itcb, tstiop__t, iface, f, f_cb);
+
+    su.sin.sin_port = htons(_G.port);
+    _G.httpd = httpd_listen(&su, cfg);
+    httpd_cfg_delete(&cfg);
+    if (!_G.httpd) {
+        fprintf(stderr, "cannot listen on port %d: %m\n", _G.port);
+        exit(EXIT_FAILURE);
+    }
+
+    proctimer_start(&_G.pt);
+    _G.report  = el_timer_register(1000, 1000, 0, &on_report, NULL);
+    _G.blocker = el_blocker_register();
+    el_signal_register(SIGTERM, on_term, NULL);
+    el_signal_register(SIGINT,  on_term, NULL);
+    el_loop();
+    el_unregister(&_G.report);
+    httpd_unlisten(&_G.httpd);
+    return 0;
+}
@@ -0,0 +1,883 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <math.h>
+#include <sysexits.h>
+#include <lib-common/parseopt.h>
+#include <lib-common/datetime.h>
+#include <lib-common/http.h>
+#include <lib-common/iop-json.h>
+#include <lib-common/iop-rpc.h>
+#include "rpcload.iop.h"
+
+/* This tool loads a server with IOP RPCs over ichannels or HTTP, and
+ * reports the throughput and the latency percentiles of the queries. With
+ * -S, it is the matching server: it serves the rpcload.Load RPCs over
+ * ichannels on the -i address, and in JSON over HTTP on the -u address.
+ *
+ *     ./rpc-load -S &
+ *     ./rpc-load -c 8 -w 32 -d 30 -x echo:8,fetch:2 -s 64-4096
+ *     ./rpc-load -H -r 50000 -s 1024
+ *
+ * The queries are spread on -c connections with at most -w of them in
+ * flight per connection. Their RPC is picked at random according to the
+ * weights of the mix -x, and their payload size at random in the range -s
+ * (the size of the answer for fetch).
+ *
+ * Without -r, a new query is sent as soon as another one completes (closed
+ * loop), and the latency is the service time of the server. With -r, the
+ * queries are scheduled at a constant rate, and their response time is
+ * measured from the time they were scheduled at rather than the time they
+ * were sent: the queries that should have been sent while the server
+ * stalled account for the stall, instead of being silently delayed as in a
+ * closed loop ("coordinated omission"). The scheduling has the resolution
+ * of the 1ms tick of the tool.
+ */
+
+#define LOAD_NS_PER_SEC  1000000000LL
+#define LOAD_SIZE_MAX    (1 << 20)
+#define LOAD_GRACE_MS    5000
+
+typedef enum load_rpc_t {
+    LOAD_ECHO,
+    LOAD_SINK,
+    LOAD_FETCH,
+    LOAD_RPC_count,
+} load_rpc_t;
+
+static const char * const load_rpc_names_g[LOAD_RPC_count] = {
+    [LOAD_ECHO]  = "echo",
+    [LOAD_SINK]  = "sink",
+    [LOAD_FETCH] = "fetch",
+};
+
+/* Values with 4 significant bits, as in HdrHistogram: the values below 16
+ * have their own bucket, then each power of 2 is split in 16 buckets, so
+ * that the percentiles are reported within 7%. */
+#define LOAD_HIST_SUB  16
+
+typedef struct load_hist_t {
+    uint64_t n;
+    uint64_t max;
+    uint64_t counts[64 * LOAD_HIST_SUB];
+} load_hist_t;
+
+/* Timings of a query, in ns. */
+typedef struct load_msg_t {
+    int64_t intended;   /* time it was scheduled at */
+    int64_t sent;       /* time it was sent at */
+    int     bytes;      /* payload of the query */
+} load_msg_t;
+
+typedef struct load_ic_t {
+    ichannel_t ic;
+    int        inflight;
+} load_ic_t;
+
+typedef struct load_http_query_t {
+    httpc_query_t q;
+    load_msg_t    msg;
+} load_http_query_t;
+
+static struct {
+    int         help;
+    bool        server;
+    bool        http;
+    bool        http2;
+    const char *ic_addr;
+    const char *http_addr;
+    int         conns;
+    int         window;
+    int         rate;
+    int         duration;
+    const char *mix;
+    const char *size;
+
+    int   weights[LOAD_RPC_count];
+    int   weights_sum;
+    int   size_min;
+    int   size_max;
+    byte *payload;
+
+    el_t        blocker;
+    el_t        tick;
+    proctimer_t pt;
+
+    /* client */
+    load_ic_t   *ics;
+    int          ic_next;
+    int          connected;
+    httpc_pool_t pool;
+
+    bool     started;
+    bool     stopping;
+    bool     finished;
+    int64_t  t0;
+    int64_t  t_stop;
+    int64_t  t_end;
+    uint64_t sent;
+    uint64_t inflight;
+    uint64_t done;
+    uint64_t errors;
+    uint64_t bytes;
+    load_hist_t service;
+    load_hist_t response;
+
+    /* server */
+    qm_t(ic_cbs) impl;
+    el_t         ic_srv;
+    el_t         httpd;
+    el_t         report;
+    uint64_t     replies;
+} load_g = {
+#define _G  load_g
+    .ic_addr   = "127.0.0.1:1081",
+    .http_addr = "127.0.0.1:1080",
+    .conns     = 4,
+    .window    = 64,
+    .duration  = 10,
+    .mix       = "echo",
+    .size      = "64",
+    .impl      = QM_INIT(ic_cbs, _G.impl),
+};
+
+static popt_t popts[] = {
+    OPT_FLAG('h', "help",        &_G.help,      "show help"),
+    OPT_FLAG('S', "server",      &_G.server,    "serve the RPCs"),
+    OPT_FLAG('H', "http",        &_G.http,      "send the queries over HTTP "
+                                                "instead of ichannels"),
+    OPT_FLAG('2', "http2",       &_G.http2,     "use HTTP/2 instead of "
+                                                "HTTP/1.1"),
+    OPT_STR('i',  "ic-addr",     &_G.ic_addr,   "ichannel address "
+                                                "(default: 127.0.0.1:1081)"),
+    OPT_STR('u',  "http-addr",   &_G.http_addr, "HTTP address "
+                                                "(default: 127.0.0.1:1080)"),
+    OPT_INT('c',  "connections", &_G.conns,     "connections (default: 4)"),
+    OPT_INT('w',  "window",      &_G.window,    "queries in flight per "
+                                                "connection (default: 64)"),
+    OPT_INT('r',  "rate",        &_G.rate,      "queries per second, 0 for a "
+                                                "closed loop (default: 0)"),
+    OPT_INT('d',  "duration",    &_G.duration,  "duration of the load, in "
+                                                "seconds (default: 10)"),
+    OPT_STR('x',  "mix",         &_G.mix,       "weighted RPCs, such as "
+                                                "echo:8,sink:1,fetch:1 "
+                                                "(default: echo)"),
+    OPT_STR('s',  "size",        &_G.size,      "payload size or range of "
+                                                "sizes, such as 64-4096 "
+                                                "(default: 64)"),
+    OPT_END(),
+};
+
+/* {{{ Helpers */
+
+static int64_t load_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * LOAD_NS_PER_SEC + ts.tv_nsec;
+}
+
+static pstream_t load_ps_get_item(pstream_t *ps, int sep)
+{
+    pstream_t item;
+
+    if (ps_get_ps_chr_and_skip(ps, sep, &item) < 0) {
+        item = *ps;
+        ps->b = ps->b_end;
+    }
+    return item;
+}
+
+/* Parse a mix such as "echo:8,fetch:2", the weights default to 1. */
+static int load_parse_mix(const char *mix)
+{
+    pstream_t ps = ps_initstr(mix);
+
+    while (!ps_done(&ps)) {
+        pstream_t item = load_ps_get_item(&ps, ',');
+        pstream_t name = load_ps_get_item(&item, ':');
+        int weight = 1;
+        int rpc = 0;
+
+        while (rpc < LOAD_RPC_count
+           &&  !ps_strequal(&name, load_rpc_names_g[rpc]))
+        {
+            rpc++;
+        }
+        if (rpc == LOAD_RPC_count) {
+            return -1;
+        }
+        if (!ps_done(&item)) {
+            weight = ps_geti(&item);
+            if (weight < 0 || !ps_done(&item)) {
+                return -1;
+            }
+        }
+        _G.weights[rpc] += weight;
+        _G.weights_sum  += weight;
+    }
+    return _G.weights_sum > 0 ? 0 : -1;
+}
+
+/* Parse a size such as "64" or a range such as "64-4096". */
+static int load_parse_size(const char *size)
+{
+    pstream_t ps = ps_initstr(size);
+
+    _G.size_min = _G.size_max = ps_geti(&ps);
+    if (ps_skipc(&ps, '-') == 0) {
+        _G.size_max = ps_geti(&ps);
+    }
+    if (!ps_done(&ps) || _G.size_min < 0 || _G.size_max < _G.size_min
+    ||  _G.size_max > LOAD_SIZE_MAX)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static lstr_t load_payload(int size)
+{
+    return LSTR_INIT_V((const char *)_G.payload, size);
+}
+
+static load_rpc_t load_pick(int *size)
+{
+    int w = rand() % _G.weights_sum;
+    int rpc = 0;
+
+    while (w >= _G.weights[rpc]) {
+        w -= _G.weights[rpc++];
+    }
+    *size = _G.size_min + rand() % (_G.size_max - _G.size_min + 1);
+    return rpc;
+}
+
+/* }}} */
+/* {{{ Latency histograms */
+
+static int load_hist_bucket(uint64_t ns)
+{
+    int e;
+
+    if (ns < LOAD_HIST_SUB) {
+        return ns;
+    }
+    e = bsr64(ns) - 4;
+    return e * LOAD_HIST_SUB + (ns >> e);
+}
+
+static uint64_t load_hist_bucket_max(int b)
+{
+    int e = b / LOAD_HIST_SUB - 1;
+
+    if (e < 0) {
+        return b;
+    }
+    return ((uint64_t)(b % LOAD_HIST_SUB + LOAD_HIST_SUB + 1) << e) - 1;
+}
+
+static void load_hist_add(load_hist_t *h, int64_t ns)
+{
+    ns = MAX(ns, 0);
+    h->counts[load_hist_bucket(ns)]++;
+    h->n++;
+    h->max = MAX(h->max, (uint64_t)ns);
+}
+
+static uint64_t load_hist_percentile(const load_hist_t *h, double pct)
+{
+    uint64_t rank = MAX(ceil(pct * h->n / 100), 1);
+    uint64_t seen = 0;
+
+    carray_for_each_pos(b, h->counts) {
+        seen += h->counts[b];
+        if (seen >= rank) {
+            return MIN(load_hist_bucket_max(b), h->max);
+        }
+    }
+    return h->max;
+}
+
+static void load_hist_print(const char *what, const load_hist_t *h)
+{
+    static double const pcts[] = { 50, 90, 99, 99.9, 99.99 };
+
+    printf("%-10s", what);
+    carray_for_each_ptr(pct, pcts) {
+        printf(" %10.1f", load_hist_percentile(h, *pct) / 1000.);
+    }
+    printf(" %10.1f\n", h->max / 1000.);
+}
+
+/* }}} */
+/* {{{ Load */
+
+static bool load_ic_send(int64_t intended);
+static bool load_http_send(int64_t intended);
+
+static void load_finish(void)
+{
+    if (_G.finished) {
+        return;
+    }
+    _G.finished = true;
+    _G.t_end = load_now();
+    proctimer_stop(&_G.pt);
+    el_unregister(&_G.tick);
+}
+
+/* Send the queries that are due, as long as the connections accept them. */
+static void load_pump(void)
+{
+    if (!_G.started || _G.stopping) {
+        return;
+    }
+    for (;;) {
+        int64_t intended = load_now();
+
+        if (_G.rate) {
+            int64_t scheduled = _G.t0 + _G.sent * LOAD_NS_PER_SEC / _G.rate;
+
+            if (scheduled > intended) {
+                break;
+            }
+            intended = scheduled;
+        }
+        if (!(_G.http ? load_http_send(intended) : load_ic_send(intended))) {
+            break;
+        }
+    }
+}
+
+static void load_msg_init(load_msg_t *msg, int64_t intended, int bytes)
+{
+    msg->intended = intended;
+    msg->sent     = load_now();
+    msg->bytes    = bytes;
+    _G.sent++;
+    _G.inflight++;
+}
+
+static void load_done(const load_msg_t *msg, bool ok, int bytes)
+{
+    int64_t now = load_now();
+
+    _G.inflight--;
+    _G.done++;
+    _G.bytes += msg->bytes + bytes;
+    if (ok) {
+        load_hist_add(&_G.service, now - msg->sent);
+        load_hist_add(&_G.response, now - msg->intended);
+    } else {
+        _G.errors++;
+    }
+
+    if (!_G.stopping) {
+        load_pump();
+    } else
+    if (!_G.inflight) {
+        load_finish();
+    }
+}
+
+static void load_on_tick(el_t ev, data_t priv)
+{
+    if (!_G.stopping) {
+        load_pump();
+        return;
+    }
+    if (load_now() - _G.t_stop > LOAD_GRACE_MS * 1000000LL) {
+        e_warning("%ju queries still in flight, giving up", _G.inflight);
+        load_finish();
+    }
+}
+
+static void load_stop(void)
+{
+    if (_G.stopping) {
+        return;
+    }
+    _G.stopping = true;
+    _G.t_stop = load_now();
+    if (!_G.started || !_G.inflight) {
+        load_finish();
+    }
+}
+
+static void load_on_stop(el_t ev, data_t priv)
+{
+    load_stop();
+}
+
+/* Start the load once the connections are established, so that the
+ * connection time is not part of the measures. */
+static void load_start(void)
+{
+    if (_G.started || _G.stopping) {
+        return;
+    }
+    _G.started = true;
+    _G.t0 = load_now();
+    proctimer_start(&_G.pt);
+    el_timer_register(_G.duration * 1000, 0, 0, &load_on_stop, NULL);
+    load_pump();
+}
+
+static void load_on_connect_timeout(el_t ev, data_t priv)
+{
+    const char *addr = _G.http ? _G.http_addr : _G.ic_addr;
+
+    if (_G.started) {
+        return;
+    }
+    if (_G.http ? !httpc_pool_has_ready(&_G.pool) : !_G.connected) {
+        e_error("cannot connect to %s", addr);
+        load_stop();
+        return;
+    }
+    e_warning("some connections to %s are not established, starting "
+              "without them", addr);
+    load_start();
+}
+
+static void load_report(void)
+{
+    double secs = (double)(_G.t_end - _G.t0) / LOAD_NS_PER_SEC;
+
+    if (!_G.started || secs <= 0) {
+        return;
+    }
+    printf("%ju queries over %d %s connections in %.1fs, %ju errors, "
+           "%ju lost\n", _G.done, _G.conns,
+           _G.http ? (_G.http2 ? "HTTP/2" : "HTTP/1.1") : "ichannel",
+           secs, _G.errors, _G.inflight);
+    printf("%.0f queries/s, %.1f MB/s of payloads, %s\n", _G.done / secs,
+           _G.bytes / secs / 1e6, proctimer_report(&_G.pt, "cpu: %p ms"));
+    if (_G.rate
+    &&  _G.sent < 0.99 * _G.rate * (_G.t_stop - _G.t0) / LOAD_NS_PER_SEC)
+    {
+        printf("the rate of %d queries/s was not sustained, %ju queries "
+               "were not sent\n", _G.rate,
+               (uint64_t)(_G.rate * (_G.t_stop - _G.t0) / LOAD_NS_PER_SEC)
+               - _G.sent);
+    }
+
+    printf("\n%-10s %10s %10s %10s %10s %10s %10s\n", "latency", "p50",
+           "p90", "p99", "p99.9", "p99.99", "max (us)");
+    load_hist_print("service", &_G.service);
+    if (_G.rate) {
+        load_hist_print("response", &_G.response);
+    }
+}
+
+/* }}} */
+/* {{{ ichannel client */
+
+static void load_ic_done(ichannel_t *ic, ic_msg_t *msg, ic_status_t status,
+                         int bytes)
+{
+    load_ic_t *conn = container_of(ic, load_ic_t, ic);
+
+    conn->inflight--;
+    load_done(acast(load_msg_t, msg->priv), status == IC_MSG_OK, bytes);
+}
+
+static void IOP_RPC_CB(rpcload__server, load, echo)
+{
+    load_ic_done(ic, msg, status, res ? res->data.len : 0);
+}
+
+static void IOP_RPC_CB(rpcload__server, load, sink)
+{
+    load_ic_done(ic, msg, status, 0);
+}
+
+static void IOP_RPC_CB(rpcload__server, load, fetch)
+{
+    load_ic_done(ic, msg, status, res ? res->data.len : 0);
+}
+
+/* Round-robin on the connections that have room for a query. */
+static load_ic_t *load_ic_get(void)
+{
+    for (int i = 0; i < _G.conns; i++) {
+        load_ic_t *conn = &_G.ics[(_G.ic_next + i) % _G.conns];
+
+        if (conn->ic.is_connected && conn->inflight < _G.window) {
+            _G.ic_next = (_G.ic_next + i + 1) % _G.conns;
+            return conn;
+        }
+    }
+    return NULL;
+}
+
+static bool load_ic_send(int64_t intended)
+{
+    load_ic_t *conn = load_ic_get();
+    load_msg_t *lmsg;
+    ic_msg_t *msg;
+    load_rpc_t rpc;
+    int size;
+
+    if (!conn) {
+        return false;
+    }
+    rpc  = load_pick(&size);
+    msg  = ic_msg_new(sizeof(load_msg_t));
+    lmsg = acast(load_msg_t, msg->priv);
+    conn->inflight++;
+
+    switch (rpc) {
+    case LOAD_ECHO:
+        load_msg_init(lmsg, intended, size);
+        ic_query2(&conn->ic, msg, rpcload__server, load, echo,
+                  .data = load_payload(size));
+        break;
+
+    case LOAD_SINK:
+        load_msg_init(lmsg, intended, size);
+        ic_query2(&conn->ic, msg, rpcload__server, load, sink,
+                  .data = load_payload(size));
+        break;
+
+    default:
+        load_msg_init(lmsg, intended, 0);
+        ic_query2(&conn->ic, msg, rpcload__server, load, fetch,
+                  .size = size);
+        break;
+    }
+    return true;
+}
+
+static void load_ic_on_event(ichannel_t *ic, ic_event_t evt)
+{
+    if (evt == IC_EVT_CONNECTED) {
+        if (++_G.connected == _G.conns) {
+            load_start();
+        }
+        load_pump();
+    } else
+    if (evt == IC_EVT_DISCONNECTED) {
+        e_warning("disconnected from %s", _G.ic_addr);
+        _G.connected--;
+    }
+}
+
+static void load_ic_connect(void)
+{
+    sockunion_t su;
+
+    if (addr_resolve("ichannel", LSTR(_G.ic_addr), &su) < 0) {
+        exit(EX_NOHOST);
+    }
+    _G.ics = p_new(load_ic_t, _G.conns);
+    for (int i = 0; i < _G.conns; i++) {
+        ichannel_t *ic = ic_init(&_G.ics[i].ic);
+
+        ic->no_autodel = true;
+        ic->on_event   = &load_ic_on_event;
+        ic->su         = su;
+        if (ic_connect(ic) < 0) {
+            e_fatal("cannot connect to %s", _G.ic_addr);
+        }
+    }
+}
+
+static void load_ic_wipe(void)
+{
+    for (int i = 0; i < _G.conns; i++) {
+        ic_wipe(&_G.ics[i].ic);
+    }
+    p_delete(&_G.ics);
+}
+
+/* }}} */
+/* {{{ HTTP client */
+
+static void load_http_on_done(httpc_query_t *q, httpc_status_t status)
+{
+    load_http_query_t *lq = container_of(q, load_http_query_t, q);
+    bool ok = status == HTTPC_STATUS_OK && q->qinfo
+           && q->qinfo->code == HTTP_CODE_OK;
+
+    load_done(&lq->msg, ok, q->payload.len);
+    httpc_query_wipe(q);
+    p_delete(&lq);
+}
+
+static void load_http_pack(sb_t *body, load_rpc_t rpc, int size)
+{
+    if (rpc == LOAD_ECHO) {
+        IOP_RPC_T(rpcload__server, load, echo, args) args = {
+            .data = load_payload(size),
+        };
+
+        iop_sb_jpack(body, IOP_RPC(rpcload__server, load, echo)->args,
+                     &args, IOP_JPACK_MINIMAL);
+    } else
+    if (rpc == LOAD_SINK) {
+        IOP_RPC_T(rpcload__server, load, sink, args) args = {
+            .data = load_payload(size),
+        };
+
+        iop_sb_jpack(body, IOP_RPC(rpcload__server, load, sink)->args,
+                     &args, IOP_JPACK_MINIMAL);
+    } else {
+        IOP_RPC_T(rpcload__server, load, fetch, args) args = {
+            .size = size,
+        };
+
+        iop_sb_jpack(body, IOP_RPC(rpcload__server, load, fetch)->args,
+                     &args, IOP_JPACK_MINIMAL);
+    }
+}
+
+/* The payloads of the HTTP queries are accounted as JSON. */
+static bool load_http_send(int64_t intended)
+{
+    static lstr_t const uris[LOAD_RPC_count] = {
+        [LOAD_ECHO]  = LSTR_IMMED("/iop/load/echo"),
+        [LOAD_SINK]  = LSTR_IMMED("/iop/load/sink"),
+        [LOAD_FETCH] = LSTR_IMMED("/iop/load/fetch"),
+    };
+    httpc_t *w = httpc_pool_get(&_G.pool);
+    load_http_query_t *lq;
+    load_rpc_t rpc;
+    outbuf_t *ob;
+    int size;
+    SB_8k(body);
+
+    if (!w) {
+        return false;
+    }
+    rpc = load_pick(&size);
+    load_http_pack(&body, rpc, size);
+
+    lq = p_new(load_http_query_t, 1);
+    httpc_query_init(&lq->q);
+    httpc_bufferize(&lq->q, 2 * LOAD_SIZE_MAX);
+    lq->q.on_done = &load_http_on_done;
+    load_msg_init(&lq->msg, intended, body.len);
+
+    httpc_query_attach(&lq->q, w);
+    httpc_query_start(&lq->q, HTTP_METHOD_POST, _G.pool.host, uris[rpc]);
+    ob = httpc_get_ob(&lq->q);
+    ob_adds(ob, "Content-Type: application/json\r\n");
+    httpc_query_hdrs_done(&lq->q, body.len, false);
+    ob_addsb(ob, &body);
+    httpc_query_done(&lq->q);
+    sb_wipe(&body);
+    return true;
+}
+
+static void load_http_on_ready(httpc_pool_t *pool, httpc_t *w)
+{
+    httpc_pool_stats_t stats;
+
+    httpc_pool_get_stats(pool, &stats);
+    if (stats.ready == _G.conns) {
+        load_start();
+    }
+    load_pump();
+}
+
+static void load_http_connect(void)
+{
+    httpc_cfg_t *cfg = httpc_cfg_new();
+
+    cfg->http_mode      = _G.http2 ? HTTP_MODE_USE_HTTP2_ONLY
+                                   : HTTP_MODE_USE_HTTP1X_ONLY;
+    cfg->pipeline_depth = _G.window;
+
+    httpc_pool_init(&_G.pool);
+    _G.pool.cfg      = cfg;
+    _G.pool.host     = lstr_dups(_G.http_addr, -1);
+    _G.pool.max_len  = _G.conns;
+    _G.pool.on_ready = &load_http_on_ready;
+    if (addr_resolve("HTTP", LSTR(_G.http_addr), &_G.pool.su) < 0) {
+        exit(EX_NOHOST);
+    }
+    for (int i = 0; i < _G.conns; i++) {
+        if (!httpc_pool_launch(&_G.pool)) {
+            e_fatal("cannot connect to %s", _G.http_addr);
+        }
+    }
+}
+
+/* }}} */
+/* {{{ Server */
+
+static void IOP_RPC_IMPL(rpcload__server, load, echo)
+{
+    _G.replies++;
+    ic_reply(ic, slot, rpcload__server, load, echo, .data = arg->data);
+}
+
+static void IOP_RPC_IMPL(rpcload__server, load, sink)
+{
+    _G.replies++;
+    ic_reply(ic, slot, rpcload__server, load, sink, .len = arg->data.len);
+}
+
+static void IOP_RPC_IMPL(rpcload__server, load, fetch)
+{
+    _G.replies++;
+    ic_reply(ic, slot, rpcload__server, load, fetch,
+             .data = load_payload(CLIP(arg->size, 0, LOAD_SIZE_MAX)));
+}
+
+static void load_server_on_event(ichannel_t *ic, ic_event_t evt)
+{
+}
+
+static int load_server_on_accept(el_t ev, int fd)
+{
+    ichannel_t *ic = ic_new();
+
+    ic->on_event    = &load_server_on_event;
+    ic->impl        = &_G.impl;
+    ic->do_el_unref = true;
+    ic_spawn(ic, fd, NULL);
+    return 0;
+}
+
+static void load_server_on_report(el_t ev, data_t priv)
+{
+    proctimer_stop(&_G.pt);
+    if (_G.replies) {
+        printf("%.0f replies/s, %s\n",
+               _G.replies * 1000000. / MAX(_G.pt.elapsed_real, 1),
+               proctimer_report(&_G.pt, "cpu: %p ms"));
+    }
+    _G.replies = 0;
+    proctimer_start(&_G.pt);
+}
+
+static void load_server_start(void)
+{
+    httpd_trigger__ic_t *itcb;
+    httpd_cfg_t *cfg;
+    sockunion_t su;
+
+    ic_register(&_G.impl, rpcload__server, load, echo);
+    ic_register(&_G.impl, rpcload__server, load, sink);
+    ic_register(&_G.impl, rpcload__server, load, fetch);
+    if (addr_resolve("ichannel", LSTR(_G.ic_addr), &su) < 0) {
+        exit(EX_NOHOST);
+    }
+    _G.ic_srv = ic_listento(&su, SOCK_STREAM, IPPROTO_TCP,
+                            &load_server_on_accept);
+    if (!_G.ic_srv) {
+        e_fatal("cannot listen on %s: %m", _G.ic_addr);
+    }
+
+    cfg = httpd_cfg_new();
+    cfg->mode = _G.http2 ? HTTP_MODE_USE_HTTP2_ONLY
+                         : HTTP_MODE_USE_HTTP1X_ONLY;
+    itcb = httpd_trigger__ic_new(&rpcload__server__mod,
+                                 "http://example.com/rpcload",
+                                 2 * LOAD_SIZE_MAX);
+    itcb->jpack_flags = IOP_JPACK_MINIMAL;
+    httpd_trigger_register(cfg, POST, "iop", &itcb->cb);
+    ichttp_register(itcb, rpcload__server, load, echo);
+    ichttp_register(itcb, rpcload__server, load, sink);
+    ichttp_register(itcb, rpcload__server, load, fetch);
+    if (addr_resolve("HTTP", LSTR(_G.http_addr), &su) < 0) {
+        exit(EX_NOHOST);
+    }
+    _G.httpd = httpd_listen(&su, cfg);
+    httpd_cfg_delete(&cfg);
+    if (!_G.httpd) {
+        e_fatal("cannot listen on %s: %m", _G.http_addr);
+    }
+
+    proctimer_start(&_G.pt);
+    _G.report = el_timer_register(1000, 1000, 0, &load_server_on_report,
+                                  NULL);
+}
+
+static void load_server_stop(void)
+{
+    el_unregister(&_G.report);
+    el_unregister(&_G.ic_srv);
+    httpd_unlisten(&_G.httpd);
+    qm_wipe(ic_cbs, &_G.impl);
+}
+
+/* }}} */
+
+static void load_on_term(el_t ev, int signo, data_t priv)
+{
+    if (_G.server) {
+        el_unregister(&_G.blocker);
+    } else {
+        load_stop();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *arg0 = NEXTARG(argc, argv);
+
+    argc = parseopt(argc, argv, popts, 0);
+    if (argc != 0 || _G.help || _G.conns <= 0 || _G.window <= 0
+    ||  _G.rate < 0 || _G.duration <= 0
+    ||  load_parse_mix(_G.mix) < 0 || load_parse_size(_G.size) < 0)
+    {
+        makeusage(_G.help ? EX_OK : EX_USAGE, arg0, "", NULL, popts);
+    }
+
+    MODULE_REQUIRE(ic);
+    _G.payload = p_new_raw(byte, LOAD_SIZE_MAX);
+    for (int i = 0; i < LOAD_SIZE_MAX; i++) {
+        _G.payload[i] = rand();
+    }
+    el_signal_register(SIGTERM, &load_on_term, NULL);
+    el_signal_register(SIGINT,  &load_on_term, NULL);
+
+    if (_G.server) {
+        load_server_start();
+        _G.blocker = el_blocker_register();
+        el_loop();
+        load_server_stop();
+    } else {
+        if (_G.http) {
+            load_http_connect();
+        } else {
+            load_ic_connect();
+        }
+        _G.tick = el_timer_register(1, 1, 0, &load_on_tick, NULL);
+        el_unref(el_timer_register(LOAD_GRACE_MS, 0, 0,
+                                   &load_on_connect_timeout, NULL));
+        while (!_G.finished) {
+            el_loop_timeout(100);
+        }
+        load_report();
+        if (_G.http) {
+            httpc_pool_wipe(&_G.pool, true);
+        } else {
+            load_ic_wipe();
+        }
+    }
+
+    p_delete(&_G.payload);
+    MODULE_RELEASE(ic);
+    return _G.started && !_G.errors ? 0 : EXIT_FAILURE;
+}
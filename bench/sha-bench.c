@@ -0,0 +1,117 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <sysexits.h>
+#include <lib-common/parseopt.h>
+#include <lib-common/datetime.h>
+#include <lib-common/hash.h>
+
+/* This bench measures the SHA-1 and SHA-256 functions:
+ *
+ *     ./sha-bench -s 256 -c 64 -n 10000
+ *
+ * hashes 64 messages of 256 bytes 10000 times, one by one and with the
+ * multi-buffer API, and prints the number of messages per second and the
+ * throughput.
+ */
+
+typedef byte sha256_digest_t[32];
+
+static struct {
+    int  size;
+    int  count;
+    int  loops;
+    int  help;
+} bench_g = {
+#define _G  bench_g
+    .size  = 256,
+    .count = 64,
+    .loops = 10000,
+};
+
+static popt_t popts[] = {
+    OPT_FLAG('h', "help",  &_G.help,  "show help"),
+    OPT_INT('s',  "size",  &_G.size,  "size of the messages (default: 256)"),
+    OPT_INT('c',  "count", &_G.count, "number of messages (default: 64)"),
+    OPT_INT('n',  "loops", &_G.loops, "number of runs (default: 10000)"),
+    OPT_END(),
+};
+
+#define BENCH(name, expr)                                                    \
+    do {                                                                     \
+        proctimer_t pt;                                                      \
+                                                                             \
+        proctimer_start(&pt);                                                \
+        for (int i = 0; i < _G.loops; i++) {                                 \
+            expr;                                                            \
+        }                                                                    \
+        proctimer_stop(&pt);                                                 \
+        printf("%-18s %8.3f Mmsg/s %8.1f MB/s\n", name,                      \
+               (double)_G.count * _G.loops / MAX(pt.elapsed_real, 1),        \
+               (double)_G.count * _G.size * _G.loops                         \
+               / MAX(pt.elapsed_real, 1));                                   \
+    } while (0)
+
+int main(int argc, char **argv)
+{
+    const char *arg0 = NEXTARG(argc, argv);
+    const void **inputs;
+    ssize_t *ilens;
+    sha256_digest_t *outputs;
+    SB_1k(buf);
+
+    argc = parseopt(argc, argv, popts, 0);
+    if (argc != 0 || _G.help || _G.size < 0 || _G.count <= 0) {
+        makeusage(_G.help ? EX_OK : EX_USAGE, arg0, "", NULL, popts);
+    }
+
+    for (int i = 0; i < _G.size * _G.count; i++) {
+        sb_addc(&buf, rand());
+    }
+    inputs = p_new(const void *, _G.count);
+    ilens = p_new(ssize_t, _G.count);
+    outputs = p_new(sha256_digest_t, _G.count);
+    for (int i = 0; i < _G.count; i++) {
+        inputs[i] = buf.data + i * _G.size;
+        ilens[i] = _G.size;
+    }
+
+    BENCH("sha1",
+          for (int j = 0; j < _G.count; j++) {
+              sha1(inputs[j], ilens[j], outputs[j]);
+          });
+    BENCH("sha256",
+          for (int j = 0; j < _G.count; j++) {
+              sha2(inputs[j], ilens[j], outputs[j], false);
+          });
+    BENCH("sha256_multi",
+          sha2_multi(inputs, ilens, _G.count, outputs, false));
+    BENCH("hmac_sha256",
+          for (int j = 0; j < _G.count; j++) {
+              sha2_hmac("key", 3, inputs[j], ilens[j], outputs[j], false);
+          });
+    BENCH("hmac_sha256_multi",
+          sha2_hmac_multi("key", 3, inputs, ilens, _G.count, outputs,
+                          false));
+
+    p_delete(&inputs);
+    p_delete(&ilens);
+    p_delete(&outputs);
+    sb_wipe(&buf);
+    return 0;
+}
@@ -0,0 +1,109 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <sysexits.h>
+#include <lib-common/parseopt.h>
+#include <lib-common/datetime.h>
+
+/* This bench measures the throughput of the hexadecimal, base64 and URL
+ * codecs of the string buffers:
+ *
+ *     ./str-codecs-bench -s 65536 -n 2000
+ *
+ * encodes and decodes a buffer of 64KiB 2000 times with each codec, and
+ * prints the throughput in MB/s of input.
+ */
+
+static struct {
+    int  size;
+    int  loops;
+    int  help;
+} bench_g = {
+#define _G  bench_g
+    .size  = 64 << 10,
+    .loops = 1000,
+};
+
+static popt_t popts[] = {
+    OPT_FLAG('h', "help",  &_G.help,  "show help"),
+    OPT_INT('s',  "size",  &_G.size,  "size of the input (default: 64KiB)"),
+    OPT_INT('n',  "loops", &_G.loops, "number of runs (default: 1000)"),
+    OPT_END(),
+};
+
+#define BENCH(name, in, expr)                                                \
+    do {                                                                     \
+        proctimer_t pt;                                                      \
+        int res = 0;                                                         \
+                                                                             \
+        proctimer_start(&pt);                                                \
+        for (int i = 0; i < _G.loops; i++) {                                 \
+            sb_reset(&out);                                                  \
+            res |= (expr);                                                   \
+        }                                                                    \
+        proctimer_stop(&pt);                                                 \
+        if (res < 0) {                                                       \
+            fprintf(stderr, "%s: decoding failed\n", name);                  \
+            exit(EXIT_FAILURE);                                              \
+        }                                                                    \
+        printf("%-12s %8.1f MB/s\n", name,                                   \
+               (double)(in).len * _G.loops / MAX(pt.elapsed_real, 1));       \
+    } while (0)
+
+int main(int argc, char **argv)
+{
+    const char *arg0 = NEXTARG(argc, argv);
+    SB_1k(raw);
+    SB_1k(text);
+    SB_1k(hex);
+    SB_1k(b64);
+    SB_1k(b64_lines);
+    SB_1k(out);
+
+    argc = parseopt(argc, argv, popts, 0);
+    if (argc != 0 || _G.help || _G.size <= 0) {
+        makeusage(_G.help ? EX_OK : EX_USAGE, arg0, "", NULL, popts);
+    }
+
+    for (int i = 0; i < _G.size; i++) {
+        sb_addc(&raw, rand());
+        /* mostly characters that are not escaped in URLs */
+        sb_addc(&text, rand() % 64 ? "abcdefghijklmnop"[rand() % 16] : ' ');
+    }
+    sb_add_hex(&hex, raw.data, raw.len);
+    sb_add_b64(&b64, raw.data, raw.len, -1);
+    sb_add_b64(&b64_lines, raw.data, raw.len, 0);
+
+    BENCH("hex",       raw, (sb_add_hex(&out, raw.data, raw.len), 0));
+    BENCH("unhex",     hex, sb_add_unhex(&out, hex.data, hex.len));
+    BENCH("b64",       raw, (sb_add_b64(&out, raw.data, raw.len, -1), 0));
+    BENCH("b64-lines", raw, (sb_add_b64(&out, raw.data, raw.len, 0), 0));
+    BENCH("unb64",     b64, sb_add_unb64(&out, b64.data, b64.len));
+    BENCH("unb64-lines", b64_lines,
+          sb_add_unb64(&out, b64_lines.data, b64_lines.len));
+    BENCH("urlencode", text,
+          (sb_add_urlencode(&out, text.data, text.len), 0));
+
+    sb_wipe(&raw);
+    sb_wipe(&text);
+    sb_wipe(&hex);
+    sb_wipe(&b64);
+    sb_wipe(&b64_lines);
+    sb_wipe(&out);
+    return 0;
+}
@@ -0,0 +1,385 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/container-qbtree.h>
+#include <lib-common/container-qhash.h>
+#include <lib-common/container-rbtree.h>
+#include <lib-common/hash.h>
+#include <lib-common/qps-hat.h>
+#include <lib-common/unix.h>
+
+#include "zbench.h"
+
+/* Benchmarks of the allocators, the containers and the codecs. */
+
+/* {{{ Allocators */
+
+#define ZBENCH_ALLOC_SIZE  64
+
+ZBENCH(alloc, libc, "malloc and free of 64 bytes") {
+    ZBENCH_LOOP(zb) {
+        void *p = p_new_raw(char, ZBENCH_ALLOC_SIZE);
+
+        zbench_use(p);
+        p_delete(&p);
+    }
+}
+
+ZBENCH(alloc, stack, "16 allocations of 64 bytes in a t_scope") {
+    ZBENCH_LOOP(zb) {
+        t_scope;
+
+        for (int i = 0; i < 16; i++) {
+            zbench_use(t_new_raw(char, ZBENCH_ALLOC_SIZE));
+        }
+    }
+}
+
+ZBENCH(alloc, ring, "16 allocations of 64 bytes in a ring frame") {
+    ZBENCH_LOOP(zb) {
+        const void *frame = r_newframe();
+
+        for (int i = 0; i < 16; i++) {
+            zbench_use(r_new_raw(char, ZBENCH_ALLOC_SIZE));
+        }
+        r_release(frame);
+    }
+}
+
+/* }}} */
+/* {{{ qhash */
+
+#define ZBENCH_QHASH_KEYS  (1 << 16)
+
+qm_k64_t(zbench_u64, uint64_t);
+
+ZBENCH(qhash, insert, "insertion of 64k random keys in a qm") {
+    qm_t(zbench_u64) qm;
+    uint64_t *keys = p_new_raw(uint64_t, ZBENCH_QHASH_KEYS);
+
+    for (int i = 0; i < ZBENCH_QHASH_KEYS; i++) {
+        keys[i] = rand64();
+    }
+    qm_init(zbench_u64, &qm);
+    ZBENCH_LOOP(zb) {
+        qm_clear(zbench_u64, &qm);
+        for (int i = 0; i < ZBENCH_QHASH_KEYS; i++) {
+            qm_add(zbench_u64, &qm, keys[i], i);
+        }
+    }
+    qm_wipe(zbench_u64, &qm);
+    p_delete(&keys);
+}
+
+ZBENCH(qhash, find, "lookup of 64k keys in a qm, half of them missing") {
+    qm_t(zbench_u64) qm;
+    uint64_t *keys = p_new_raw(uint64_t, ZBENCH_QHASH_KEYS);
+
+    qm_init(zbench_u64, &qm);
+    for (int i = 0; i < ZBENCH_QHASH_KEYS; i++) {
+        keys[i] = rand64();
+        if (i & 1) {
+            qm_add(zbench_u64, &qm, keys[i], i);
+        }
+    }
+    ZBENCH_LOOP(zb) {
+        int found = 0;
+
+        for (int i = 0; i < ZBENCH_QHASH_KEYS; i++) {
+            found += qm_find(zbench_u64, &qm, keys[i]) >= 0;
+        }
+        zbench_use(found);
+    }
+    qm_wipe(zbench_u64, &qm);
+    p_delete(&keys);
+}
+
+/* }}} */
+/* {{{ qhat */
+
+#define ZBENCH_QHAT_KEYS  (1 << 16)
+
+/* The qhat lives in a qps spooled in a temporary directory. */
+static qps_t *zbench_qps_create(char *dir)
+{
+    MODULE_REQUIRE(qps);
+    if (!mkdtemp(dir)) {
+        e_fatal("cannot create %s: %m", dir);
+    }
+    return qps_create(dir, "zbench", 0755, NULL, 0);
+}
+
+static void zbench_qps_delete(qps_t **qps, const char *dir)
+{
+    qps_close(qps);
+    rmdir_r(dir, false);
+    MODULE_RELEASE(qps);
+}
+
+ZBENCH(qhat, set, "set of 64k random keys in a qhat") {
+    char dir[] = "zbench-qps-XXXXXX";
+    qps_t *qps = zbench_qps_create(dir);
+    uint32_t *keys = p_new_raw(uint32_t, ZBENCH_QHAT_KEYS);
+    qhat_t hat;
+
+    for (int i = 0; i < ZBENCH_QHAT_KEYS; i++) {
+        keys[i] = rand();
+    }
+    qhat_init(&hat, qps, qhat_create(qps, sizeof(uint32_t), false));
+    ZBENCH_LOOP(zb) {
+        for (int i = 0; i < ZBENCH_QHAT_KEYS; i++) {
+            *(uint32_t *)qhat_set(&hat, keys[i]) = i;
+        }
+    }
+    qhat_destroy(&hat);
+    p_delete(&keys);
+    zbench_qps_delete(&qps, dir);
+}
+
+ZBENCH(qhat, get, "lookup of 64k random keys in a qhat") {
+    char dir[] = "zbench-qps-XXXXXX";
+    qps_t *qps = zbench_qps_create(dir);
+    uint32_t *keys = p_new_raw(uint32_t, ZBENCH_QHAT_KEYS);
+    qhat_t hat;
+
+    qhat_init(&hat, qps, qhat_create(qps, sizeof(uint32_t), false));
+    for (int i = 0; i < ZBENCH_QHAT_KEYS; i++) {
+        keys[i] = rand();
+        *(uint32_t *)qhat_set(&hat, keys[i]) = i;
+    }
+    ZBENCH_LOOP(zb) {
+        uint32_t sum = 0;
+
+        for (int i = 0; i < ZBENCH_QHAT_KEYS; i++) {
+            const uint32_t *v = qhat_get(&hat, keys[i]);
+
+            sum += v ? *v : 0;
+        }
+        zbench_use(sum);
+    }
+    qhat_destroy(&hat);
+    p_delete(&keys);
+    zbench_qps_delete(&qps, dir);
+}
+
+/* }}} */
+/* {{{ Ordered maps */
+
+/* The same random keys as the qhat benchmarks, in a rbtree and in a qbt,
+ * and the bulk loading and scan of a big qbt. */
+
+#define ZBENCH_ORDERED_KEYS   (1 << 16)
+#define ZBENCH_QBT_BIG_KEYS   (1 << 20)
+
+typedef struct zbench_rb_node_t {
+    uint32_t  key;
+    uint32_t  val;
+    rb_node_t link;
+} zbench_rb_node_t;
+
+#define ZBENCH_RB_GET_KEY(node)  (node)->key
+
+rb_tree_t(zbench_rb, zbench_rb_node_t, uint32_t, link, ZBENCH_RB_GET_KEY,
+          CMP);
+
+qbt_k32_t(zbench_qbt, uint32_t);
+
+ZBENCH(rbtree, insert, "insertion of 64k random keys in a rbtree") {
+    zbench_rb_node_t *nodes = p_new(zbench_rb_node_t, ZBENCH_ORDERED_KEYS);
+    rb_t(zbench_rb) rb;
+
+    for (int i = 0; i < ZBENCH_ORDERED_KEYS; i++) {
+        nodes[i].key = rand();
+        nodes[i].val = i;
+    }
+    ZBENCH_LOOP(zb) {
+        rb_init(zbench_rb, &rb);
+        for (int i = 0; i < ZBENCH_ORDERED_KEYS; i++) {
+            rb_insert(zbench_rb, &rb, &nodes[i]);
+        }
+    }
+    p_delete(&nodes);
+}
+
+ZBENCH(rbtree, get, "lookup of 64k random keys in a rbtree") {
+    zbench_rb_node_t *nodes = p_new(zbench_rb_node_t, ZBENCH_ORDERED_KEYS);
+    rb_t(zbench_rb) rb;
+
+    rb_init(zbench_rb, &rb);
+    for (int i = 0; i < ZBENCH_ORDERED_KEYS; i++) {
+        nodes[i].key = rand();
+        nodes[i].val = i;
+        rb_insert(zbench_rb, &rb, &nodes[i]);
+    }
+    ZBENCH_LOOP(zb) {
+        uint32_t sum = 0;
+
+        for (int i = 0; i < ZBENCH_ORDERED_KEYS; i++) {
+            zbench_rb_node_t *node = rb_find(zbench_rb, &rb, nodes[i].key);
+
+            sum += node ? node->val : 0;
+        }
+        zbench_use(sum);
+    }
+    p_delete(&nodes);
+}
+
+ZBENCH(qbt, insert, "insertion of 64k random keys in a qbt") {
+    uint32_t *keys = p_new_raw(uint32_t, ZBENCH_ORDERED_KEYS);
+    qbt_t(zbench_qbt) qbt;
+
+    for (int i = 0; i < ZBENCH_ORDERED_KEYS; i++) {
+        keys[i] = rand();
+    }
+    qbt_init(zbench_qbt, &qbt);
+    ZBENCH_LOOP(zb) {
+        qbt_clear(zbench_qbt, &qbt);
+        for (int i = 0; i < ZBENCH_ORDERED_KEYS; i++) {
+            qbt_add(zbench_qbt, &qbt, keys[i], i);
+        }
+    }
+    qbt_wipe(zbench_qbt, &qbt);
+    p_delete(&keys);
+}
+
+ZBENCH(qbt, get, "lookup of 64k random keys in a qbt") {
+    uint32_t *keys = p_new_raw(uint32_t, ZBENCH_ORDERED_KEYS);
+    qbt_t(zbench_qbt) qbt;
+
+    qbt_init(zbench_qbt, &qbt);
+    for (int i = 0; i < ZBENCH_ORDERED_KEYS; i++) {
+        keys[i] = rand();
+        qbt_add(zbench_qbt, &qbt, keys[i], i);
+    }
+    ZBENCH_LOOP(zb) {
+        uint32_t sum = 0;
+
+        for (int i = 0; i < ZBENCH_ORDERED_KEYS; i++) {
+            sum += qbt_get_def(zbench_qbt, &qbt, keys[i], 0);
+        }
+        zbench_use(sum);
+    }
+    qbt_wipe(zbench_qbt, &qbt);
+    p_delete(&keys);
+}
+
+ZBENCH(qbt, load, "bulk loading of 1M sorted keys in a qbt") {
+    uint32_t *keys = p_new_raw(uint32_t, ZBENCH_QBT_BIG_KEYS);
+    uint32_t *vals = p_new_raw(uint32_t, ZBENCH_QBT_BIG_KEYS);
+    qbt_t(zbench_qbt) qbt;
+
+    for (int i = 0; i < ZBENCH_QBT_BIG_KEYS; i++) {
+        keys[i] = 3 * i;
+        vals[i] = i;
+    }
+    qbt_init(zbench_qbt, &qbt);
+    ZBENCH_LOOP(zb) {
+        qbt_clear(zbench_qbt, &qbt);
+        qbt_load_sorted(zbench_qbt, &qbt, keys, vals, ZBENCH_QBT_BIG_KEYS);
+    }
+    qbt_wipe(zbench_qbt, &qbt);
+    p_delete(&keys);
+    p_delete(&vals);
+}
+
+ZBENCH(qbt, range, "iteration on 1M keys of a qbt") {
+    uint32_t *keys = p_new_raw(uint32_t, ZBENCH_QBT_BIG_KEYS);
+    uint32_t *vals = p_new_raw(uint32_t, ZBENCH_QBT_BIG_KEYS);
+    qbt_t(zbench_qbt) qbt;
+
+    for (int i = 0; i < ZBENCH_QBT_BIG_KEYS; i++) {
+        keys[i] = 3 * i;
+        vals[i] = i;
+    }
+    qbt_init(zbench_qbt, &qbt);
+    qbt_load_sorted(zbench_qbt, &qbt, keys, vals, ZBENCH_QBT_BIG_KEYS);
+    ZBENCH_LOOP(zb) {
+        uint32_t sum = 0;
+
+        qbt_for_each_range(zbench_qbt, it, &qbt, 0, UINT32_MAX) {
+            sum += qbt_it_val(&it);
+        }
+        zbench_use(sum);
+    }
+    qbt_wipe(zbench_qbt, &qbt);
+    p_delete(&keys);
+    p_delete(&vals);
+}
+
+/* }}} */
+/* {{{ Codecs */
+
+#define ZBENCH_BUF_SIZE  (64 << 10)
+
+static void zbench_fill(sb_t *sb, int len)
+{
+    for (int i = 0; i < len; i++) {
+        sb_addc(sb, rand());
+    }
+}
+
+ZBENCH(base64, encode, "base64 encoding of 64KiB") {
+    SB_1k(raw);
+    SB_1k(out);
+
+    zbench_fill(&raw, ZBENCH_BUF_SIZE);
+    zbench_set_bytes(zb, raw.len);
+    ZBENCH_LOOP(zb) {
+        sb_reset(&out);
+        sb_add_b64(&out, raw.data, raw.len, -1);
+    }
+    sb_wipe(&raw);
+    sb_wipe(&out);
+}
+
+ZBENCH(base64, decode, "base64 decoding of 64KiB") {
+    SB_1k(raw);
+    SB_1k(b64);
+    SB_1k(out);
+
+    zbench_fill(&raw, ZBENCH_BUF_SIZE);
+    sb_add_b64(&b64, raw.data, raw.len, -1);
+    zbench_set_bytes(zb, b64.len);
+    ZBENCH_LOOP(zb) {
+        sb_reset(&out);
+        if (sb_add_unb64(&out, b64.data, b64.len) < 0) {
+            e_fatal("base64 decoding failed");
+        }
+    }
+    sb_wipe(&raw);
+    sb_wipe(&b64);
+    sb_wipe(&out);
+}
+
+#define ZBENCH_CRC(name, fun)                                                \
+    ZBENCH(crc, name, #name " of 64KiB") {                                   \
+        SB_1k(raw);                                                          \
+                                                                             \
+        zbench_fill(&raw, ZBENCH_BUF_SIZE);                                  \
+        zbench_set_bytes(zb, raw.len);                                       \
+        ZBENCH_LOOP(zb) {                                                    \
+            zbench_use(fun(0, raw.data, raw.len));                           \
+        }                                                                    \
+        sb_wipe(&raw);                                                       \
+    }
+
+ZBENCH_CRC(crc32,  icrc32)
+ZBENCH_CRC(crc32c, icrc32c)
+ZBENCH_CRC(crc64,  icrc64)
+
+/* }}} */
@@ -0,0 +1,188 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/iop.h>
+#include <lib-common/iop-rpc.h>
+#include <lib-common/unix.h>
+#include "../tests/iop/tstiop.iop.h"
+
+#include "zbench.h"
+
+/* Benchmarks of the IOP packers and of the ichannels. */
+
+/* {{{ bpack/jpack */
+
+#define ZBENCH_IOP_INTS  1024
+
+/* 1024 integers, packed on 1 to 5 bytes. */
+static void zbench_iop_repeated(tstiop__repeated__t *rep)
+{
+    int32_t *ints = t_new_raw(int32_t, ZBENCH_IOP_INTS);
+
+    for (int i = 0; i < ZBENCH_IOP_INTS; i++) {
+        ints[i] = rand() >> (i % 32);
+    }
+    iop_init(tstiop__repeated, rep);
+    rep->i32 = (iop_array_i32_t)IOP_ARRAY(ints, ZBENCH_IOP_INTS);
+}
+
+ZBENCH(iop, bpack, "binary packing of 1024 integers") {
+    t_scope;
+    tstiop__repeated__t rep;
+
+    zbench_iop_repeated(&rep);
+    zbench_set_bytes(zb, t_iop_bpack_struct(&tstiop__repeated__s, &rep).len);
+    ZBENCH_LOOP(zb) {
+        t_scope;
+
+        zbench_use(t_iop_bpack_struct(&tstiop__repeated__s, &rep).len);
+    }
+}
+
+ZBENCH(iop, bunpack, "binary unpacking of 1024 integers") {
+    t_scope;
+    tstiop__repeated__t rep;
+    lstr_t packed;
+
+    zbench_iop_repeated(&rep);
+    packed = t_iop_bpack_struct(&tstiop__repeated__s, &rep);
+    zbench_set_bytes(zb, packed.len);
+    ZBENCH_LOOP(zb) {
+        t_scope;
+        tstiop__repeated__t *res = NULL;
+
+        if (iop_bunpack_ptr(t_pool(), &tstiop__repeated__s, (void **)&res,
+                            ps_initlstr(&packed), false) < 0)
+        {
+            e_fatal("unpacking failed: %s", iop_get_err());
+        }
+    }
+}
+
+ZBENCH(iop, jpack, "JSON packing of 1024 integers") {
+    t_scope;
+    tstiop__repeated__t rep;
+    SB_1k(sb);
+
+    zbench_iop_repeated(&rep);
+    iop_sb_jpack(&sb, &tstiop__repeated__s, &rep, IOP_JPACK_MINIMAL);
+    zbench_set_bytes(zb, sb.len);
+    ZBENCH_LOOP(zb) {
+        sb_reset(&sb);
+        iop_sb_jpack(&sb, &tstiop__repeated__s, &rep, IOP_JPACK_MINIMAL);
+    }
+    sb_wipe(&sb);
+}
+
+ZBENCH(iop, junpack, "JSON unpacking of 1024 integers") {
+    t_scope;
+    tstiop__repeated__t rep;
+    SB_1k(sb);
+
+    zbench_iop_repeated(&rep);
+    iop_sb_jpack(&sb, &tstiop__repeated__s, &rep, IOP_JPACK_MINIMAL);
+    zbench_set_bytes(zb, sb.len);
+    ZBENCH_LOOP(zb) {
+        t_scope;
+        tstiop__repeated__t *res = NULL;
+        pstream_t ps = ps_initsb(&sb);
+
+        if (t_iop_junpack_ptr_ps(&ps, &tstiop__repeated__s, (void **)&res,
+                                 0, NULL) < 0)
+        {
+            e_fatal("unpacking failed");
+        }
+    }
+    sb_wipe(&sb);
+}
+
+/* }}} */
+/* {{{ ichannels */
+
+/* Number of queries sent before waiting for their replies. */
+#define ZBENCH_IC_WINDOW  64
+
+static struct {
+    uint64_t replies;
+} zbench_ic_g;
+
+static void IOP_RPC_IMPL(tstiop__t, iface, f)
+{
+    ic_reply(ic, slot, tstiop__t, iface, f, .i = arg->i);
+}
+
+static void IOP_RPC_CB(tstiop__t, iface, f)
+{
+    if (status != IC_MSG_OK) {
+        e_fatal("query failed: %s", ic_status_to_string(status));
+    }
+    zbench_ic_g.replies++;
+}
+
+static void zbench_ic_on_event(ichannel_t *ic, ic_event_t evt)
+{
+}
+
+static void zbench_ic_wait(uint64_t sent)
+{
+    while (zbench_ic_g.replies < sent) {
+        el_loop_timeout(10);
+    }
+}
+
+ZBENCH(ic, loopback, "RPCs over a pair of unix ichannels, 64 in flight") {
+    qm_t(ic_cbs) impl = QM_INIT(ic_cbs, impl);
+    ichannel_t client;
+    ichannel_t server;
+    uint64_t sent = 0;
+    uint64_t n;
+    int sv[2];
+
+    MODULE_REQUIRE(ic);
+    ic_register(&impl, tstiop__t, iface, f);
+    ic_init(&client);
+    ic_init(&server);
+    client.no_autodel = server.no_autodel = true;
+    client.on_event = server.on_event = &zbench_ic_on_event;
+    server.impl = &impl;
+    if (socketpairx(AF_UNIX, SOCK_STREAM, 0, O_NONBLOCK, sv) < 0) {
+        e_fatal("cannot create a socketpair: %m");
+    }
+    ic_spawn(&client, sv[0], NULL);
+    ic_spawn(&server, sv[1], NULL);
+    zbench_ic_g.replies = 0;
+
+    /* the replies of the last window are part of the measure */
+    n = zbench_start(zb);
+    for (uint64_t i = 0; i < n; i++) {
+        ic_query2(&client, ic_msg_new(0), tstiop__t, iface, f, .i = 42);
+        if (++sent % ZBENCH_IC_WINDOW == 0) {
+            zbench_ic_wait(sent);
+        }
+    }
+    zbench_ic_wait(sent);
+    zbench_stop(zb);
+
+    ic_wipe(&client);
+    ic_wipe(&server);
+    ic_unregister(&impl, tstiop__t, iface, f);
+    qm_wipe(ic_cbs, &impl);
+    MODULE_RELEASE(ic);
+}
+
+/* }}} */
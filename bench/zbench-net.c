@@ -0,0 +1,118 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/el.h>
+#include <lib-common/net.h>
+#include <lib-common/unix.h>
+#include <lib-common/net/hpack-priv.h>
+
+#include "zbench.h"
+
+/* Benchmarks of the HPACK codec and of the event loop. */
+
+/* {{{ hpack */
+
+/* A typical set of header values. */
+static lstr_t const zbench_hpack_hdrs_g[] = {
+    LSTR_IMMED("application/json; charset=utf-8"),
+    LSTR_IMMED("Mon, 21 Oct 2013 20:13:21 GMT"),
+    LSTR_IMMED("https://www.example.com/iop/iface/f?query=42"),
+    LSTR_IMMED("Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101"),
+    LSTR_IMMED("gzip, deflate, br"),
+    LSTR_IMMED("no-cache"),
+};
+
+ZBENCH(hpack, huffman_encode, "huffman coding of a few header values") {
+    byte buf[256];
+    uint64_t bytes = 0;
+
+    carray_for_each_ptr(hdr, zbench_hpack_hdrs_g) {
+        bytes += hdr->len;
+    }
+    zbench_set_bytes(zb, bytes);
+    ZBENCH_LOOP(zb) {
+        carray_for_each_ptr(hdr, zbench_hpack_hdrs_g) {
+            zbench_use(hpack_encode_huffman(*hdr, buf, sizeof(buf)));
+        }
+    }
+}
+
+ZBENCH(hpack, huffman_decode, "huffman decoding of a few header values") {
+    byte coded[countof(zbench_hpack_hdrs_g)][256];
+    int coded_len[countof(zbench_hpack_hdrs_g)];
+    byte buf[256];
+    uint64_t bytes = 0;
+
+    carray_for_each_pos(i, zbench_hpack_hdrs_g) {
+        coded_len[i] = hpack_encode_huffman(zbench_hpack_hdrs_g[i], coded[i],
+                                            sizeof(coded[i]));
+        bytes += coded_len[i];
+    }
+    zbench_set_bytes(zb, bytes);
+    ZBENCH_LOOP(zb) {
+        carray_for_each_pos(i, zbench_hpack_hdrs_g) {
+            lstr_t s = LSTR_INIT_V((const char *)coded[i], coded_len[i]);
+
+            zbench_use(hpack_decode_huffman(s, buf));
+        }
+    }
+}
+
+/* }}} */
+/* {{{ el */
+
+#define ZBENCH_EL_MSG  64
+
+static int zbench_el_on_read(el_t ev, int fd, short events, data_t priv)
+{
+    char buf[BUFSIZ];
+    uint64_t *received = priv.ptr;
+    ssize_t len;
+
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        *received += len;
+    }
+    return 0;
+}
+
+ZBENCH(el, loopback, "64-byte messages through a socketpair and the loop") {
+    char msg[ZBENCH_EL_MSG] = { 0 };
+    uint64_t received = 0;
+    uint64_t sent = 0;
+    int fds[2];
+    el_t ev;
+
+    if (socketpairx(AF_UNIX, SOCK_STREAM, 0, O_NONBLOCK, fds) < 0) {
+        e_fatal("cannot create a socketpair: %m");
+    }
+    ev = el_fd_register(fds[0], true, POLLIN, &zbench_el_on_read, &received);
+    zbench_set_bytes(zb, sizeof(msg));
+    ZBENCH_LOOP(zb) {
+        if (write(fds[1], msg, sizeof(msg)) != sizeof(msg)) {
+            e_fatal("cannot write on the socketpair: %m");
+        }
+        sent += sizeof(msg);
+        while (received < sent) {
+            el_loop_timeout(10);
+        }
+    }
+    el_fd_unregister(&ev);
+    p_close(&fds[1]);
+}
+
+/* }}} */
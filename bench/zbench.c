@@ -0,0 +1,432 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <math.h>
+#include <sysexits.h>
+#include <lib-common/parseopt.h>
+#include <lib-common/unix.h>
+
+#include "zbench.h"
+
+/* This program runs the benchmarks registered with ZBENCH() (see zbench.h):
+ *
+ *     ./zbench                     run all the benchmarks
+ *     ./zbench qhash crc/crc32     run the qhash group and one benchmark
+ *     ./zbench -o new.tsv          also write the results in new.tsv
+ *     ./zbench -b base.tsv         compare the results to base.tsv
+ *     ./zbench -r new.tsv -b base.tsv
+ *                                  compare two results files
+ *
+ * The results files have one line per benchmark with, separated by tabs:
+ * its name, the mean time per iteration in ns, the half width of its 95%
+ * confidence interval in ns, the number of samples, the number of
+ * iterations of each sample, the bytes processed by an iteration and, with
+ * -p, the cycles, instructions, cache misses and branch misses of an
+ * iteration (0 otherwise).
+ *
+ * A benchmark regressed when it got slower than the threshold (-t) and
+ * the confidence intervals of both results don't overlap. The program then
+ * exits with EX_DATAERR, so that it can gate a CI pipeline. When both
+ * results have the hardware counts, they are printed along with the
+ * regressions and improvements, to tell why the time changed.
+ */
+
+struct zbench_export *zbench_exports_g;
+
+typedef struct zbench_res_t {
+    char    *name;
+    double   ns;
+    double   ci;
+    int      samples;
+    uint64_t n;
+    uint64_t bytes;
+    double   perf[PERF_COUNTER__MAX];
+} zbench_res_t;
+
+qvector_t(zbench_res, zbench_res_t);
+qvector_t(zbench_export, struct zbench_export *);
+
+static struct {
+    int   help;
+    int   list;
+    int   samples;
+    int   min_ms;
+    int   threshold;
+    int   perf_on;
+    char *output;
+    char *baseline;
+    char *results;
+
+    qv_t(zbench_res) res;
+    perf_counters_t  perf;
+} zbench_g = {
+#define _G  zbench_g
+    .samples   = 10,
+    .min_ms    = 50,
+    .threshold = 5,
+};
+
+static popt_t popts[] = {
+    OPT_FLAG('h', "help",      &_G.help,      "show help"),
+    OPT_FLAG('l', "list",      &_G.list,      "list the benchmarks"),
+    OPT_INT('s',  "samples",   &_G.samples,   "samples per benchmark "
+                                              "(default: 10)"),
+    OPT_INT('m',  "min-time",  &_G.min_ms,    "minimum duration of a sample, "
+                                              "in ms (default: 50)"),
+    OPT_FLAG('p', "perf",      &_G.perf_on,   "count the cycles, instructions, "
+                                              "cache and branch misses"),
+    OPT_STR('o',  "output",    &_G.output,    "write the results in a file"),
+    OPT_STR('b',  "baseline",  &_G.baseline,  "compare the results to the "
+                                              "ones of a file"),
+    OPT_STR('r',  "results",   &_G.results,   "read the results from a file "
+                                              "instead of running"),
+    OPT_INT('t',  "threshold", &_G.threshold, "regression threshold, in % "
+                                              "(default: 5)"),
+    OPT_END(),
+};
+
+/* {{{ Measures */
+
+static uint64_t zbench_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+uint64_t zbench_start(zbench_t *zb)
+{
+    if (_G.perf_on) {
+        perf_counters_start(&_G.perf);
+    }
+    zb->start = zbench_clock();
+    return zb->n;
+}
+
+void zbench_stop(zbench_t *zb)
+{
+    zb->elapsed = MAX(zbench_clock() - zb->start, 1U);
+    if (_G.perf_on) {
+        perf_counters_stop(&_G.perf);
+    }
+}
+
+static uint64_t zbench_run_once(const struct zbench_export *ex, uint64_t n,
+                                uint64_t *bytes)
+{
+    zbench_t zb = { .n = n };
+
+    (*ex->cb)(&zb);
+    if (!zb.elapsed) {
+        fprintf(stderr, "%s/%s: the benchmark did not measure anything\n",
+                ex->group, ex->name);
+        exit(EXIT_FAILURE);
+    }
+    *bytes = zb.bytes;
+    return zb.elapsed;
+}
+
+/* Two-sided 95% quantiles of the Student's t-distribution, by degrees of
+ * freedom. */
+static double zbench_student_t95(int df)
+{
+    static double const t95[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+        2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101,
+        2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052,
+        2.048, 2.045, 2.042,
+    };
+
+    if (df <= 0) {
+        return 0;
+    }
+    return df <= countof(t95) ? t95[df - 1] : 1.960;
+}
+
+static void zbench_run(const struct zbench_export *ex, zbench_res_t *res)
+{
+    uint64_t min_ns = _G.min_ms * 1000000ULL;
+    uint64_t n = 1;
+    uint64_t elapsed;
+    double sum = 0;
+    double sq = 0;
+    double *samples = p_alloca(double, _G.samples);
+
+    /* grow the iterations until a run lasts the minimum duration */
+    while ((elapsed = zbench_run_once(ex, n, &res->bytes)) < min_ns) {
+        uint64_t next = n * 1.2 * min_ns / elapsed;
+
+        n = MIN(MAX(next, n + 1), n * 100);
+    }
+
+    perf_counters_reset(&_G.perf);
+    for (int i = 0; i < _G.samples; i++) {
+        samples[i] = (double)zbench_run_once(ex, n, &res->bytes) / n;
+        sum += samples[i];
+    }
+    res->ns = sum / _G.samples;
+    for (int i = 0; i < _G.samples; i++) {
+        sq += (samples[i] - res->ns) * (samples[i] - res->ns);
+    }
+    res->ci = _G.samples > 1
+            ? zbench_student_t95(_G.samples - 1)
+              * sqrt(sq / (_G.samples - 1)) / sqrt(_G.samples)
+            : 0;
+    res->samples = _G.samples;
+    res->n = n;
+    for (int i = 0; i < PERF_COUNTER__MAX; i++) {
+        res->perf[i] = (double)_G.perf.counts[i] / (n * _G.samples);
+    }
+}
+
+/* }}} */
+/* {{{ Results */
+
+static double zbench_ipc(const zbench_res_t *res)
+{
+    if (!res->perf[PERF_COUNTER_CYCLES]) {
+        return 0;
+    }
+    return res->perf[PERF_COUNTER_INSTRUCTIONS]
+         / res->perf[PERF_COUNTER_CYCLES];
+}
+
+static void zbench_print(const zbench_res_t *res)
+{
+    printf("%-32s %12.1f ns/op +- %5.1f%%", res->name, res->ns,
+           100 * res->ci / res->ns);
+    if (res->bytes) {
+        printf(" %10.1f MB/s", res->bytes * 1000 / res->ns);
+    }
+    if (res->perf[PERF_COUNTER_CYCLES]) {
+        printf("  %5.2f IPC %10.1f cycles %8.2f cache-misses "
+               "%8.2f branch-misses", zbench_ipc(res),
+               res->perf[PERF_COUNTER_CYCLES],
+               res->perf[PERF_COUNTER_CACHE_MISSES],
+               res->perf[PERF_COUNTER_BRANCH_MISSES]);
+    }
+    printf("\n");
+}
+
+static int zbench_write(const char *path, const qv_t(zbench_res) *results)
+{
+    FILE *out = fopen(path, "w");
+
+    if (!out) {
+        fprintf(stderr, "cannot open %s: %m\n", path);
+        return -1;
+    }
+    fprintf(out, "# name\tns/op\tci95\tsamples\titerations\tbytes/op");
+    carray_for_each_entry(name, perf_counter_names_g) {
+        fprintf(out, "\t%s/op", name);
+    }
+    fprintf(out, "\n");
+    tab_for_each_ptr(res, results) {
+        fprintf(out, "%s\t%.3f\t%.3f\t%d\t%ju\t%ju", res->name, res->ns,
+                res->ci, res->samples, res->n, res->bytes);
+        carray_for_each_entry(count, res->perf) {
+            fprintf(out, "\t%.3f", count);
+        }
+        fprintf(out, "\n");
+    }
+    return p_fclose(&out);
+}
+
+static int zbench_read(const char *path, qv_t(zbench_res) *results)
+{
+    FILE *in = fopen(path, "r");
+    char line[BUFSIZ];
+    int lineno = 0;
+
+    if (!in) {
+        fprintf(stderr, "cannot open %s: %m\n", path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), in)) {
+        char name[256];
+        zbench_res_t res = { .ns = 0 };
+        int fields;
+
+        lineno++;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        /* the hardware counts are missing in the older files */
+        fields = sscanf(line, "%255s %lf %lf %d %ju %ju %lf %lf %lf %lf",
+                        name, &res.ns, &res.ci, &res.samples, &res.n,
+                        &res.bytes, &res.perf[0], &res.perf[1],
+                        &res.perf[2], &res.perf[3]);
+        if ((fields != 6 && fields != 6 + PERF_COUNTER__MAX) || res.ns <= 0)
+        {
+            fprintf(stderr, "%s:%d: invalid result\n", path, lineno);
+            p_fclose(&in);
+            return -1;
+        }
+        res.name = p_strdup(name);
+        qv_append(results, res);
+    }
+    return p_fclose(&in);
+}
+
+/* Compare the results to the baseline, and return the number of
+ * regressions. */
+static int zbench_compare(const qv_t(zbench_res) *base,
+                          const qv_t(zbench_res) *results)
+{
+    int regressions = 0;
+
+    printf("\n%-32s %12s %12s %8s\n", "benchmark", "base ns/op", "ns/op",
+           "delta");
+    tab_for_each_ptr(res, results) {
+        const zbench_res_t *ref = NULL;
+        const char *verdict = "";
+        double delta;
+
+        tab_for_each_ptr(b, base) {
+            if (strequal(b->name, res->name)) {
+                ref = b;
+                break;
+            }
+        }
+        if (!ref) {
+            printf("%-32s %12s %12.1f %8s\n", res->name, "-", res->ns, "new");
+            continue;
+        }
+
+        delta = 100 * (res->ns - ref->ns) / ref->ns;
+        if (delta > _G.threshold && res->ns - res->ci > ref->ns + ref->ci) {
+            verdict = "  REGRESSION";
+            regressions++;
+        } else
+        if (delta < -_G.threshold && res->ns + res->ci < ref->ns - ref->ci) {
+            verdict = "  improvement";
+        }
+        printf("%-32s %12.1f %12.1f %+7.1f%%%s\n", res->name, ref->ns,
+               res->ns, delta, verdict);
+        if (*verdict && ref->perf[PERF_COUNTER_CYCLES]
+        &&  res->perf[PERF_COUNTER_CYCLES])
+        {
+            printf("%32s IPC %.2f -> %.2f", "", zbench_ipc(ref),
+                   zbench_ipc(res));
+            carray_for_each_pos(i, perf_counter_names_g) {
+                printf(", %s %.1f -> %.1f", perf_counter_names_g[i],
+                       ref->perf[i], res->perf[i]);
+            }
+            printf("\n");
+        }
+    }
+    return regressions;
+}
+
+static void zbench_res_wipe(zbench_res_t *res)
+{
+    p_delete(&res->name);
+}
+
+/* }}} */
+
+static bool zbench_is_selected(const struct zbench_export *ex, int argc,
+                               char **argv)
+{
+    char name[256];
+
+    if (!argc) {
+        return true;
+    }
+    snprintf(name, sizeof(name), "%s/%s", ex->group, ex->name);
+    for (int i = 0; i < argc; i++) {
+        if (strequal(argv[i], ex->group) || strequal(argv[i], name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    const char *arg0 = NEXTARG(argc, argv);
+    qv_t(zbench_export) exports;
+    qv_t(zbench_res) base;
+    int res = EXIT_SUCCESS;
+
+    argc = parseopt(argc, argv, popts, 0);
+    if (argc < 0 || _G.help || _G.samples <= 0 || _G.min_ms <= 0) {
+        makeusage(_G.help ? EX_OK : EX_USAGE, arg0, "[<group>|<group>/<name>]*",
+                  NULL, popts);
+    }
+
+    /* run the benchmarks in the order of the sources */
+    qv_init(&exports);
+    for (struct zbench_export *ex = zbench_exports_g; ex; ex = ex->prev) {
+        if (zbench_is_selected(ex, argc, argv)) {
+            qv_insert(&exports, 0, ex);
+        }
+    }
+
+    if (_G.list) {
+        tab_for_each_entry(ex, &exports) {
+            printf("%s/%s: %s\n", ex->group, ex->name, ex->desc);
+        }
+        qv_wipe(&exports);
+        return EXIT_SUCCESS;
+    }
+
+    if (_G.perf_on && !_G.results && perf_counters_open(&_G.perf) < 0) {
+        fprintf(stderr, "cannot count the hardware events: %m\n");
+        _G.perf_on = false;
+    }
+
+    qv_init(&_G.res);
+    if (_G.results) {
+        if (zbench_read(_G.results, &_G.res) < 0) {
+            exit(EX_NOINPUT);
+        }
+    } else {
+        tab_for_each_entry(ex, &exports) {
+            zbench_res_t *r = qv_growlen0(&_G.res, 1);
+
+            r->name = asprintf("%s/%s", ex->group, ex->name);
+            zbench_run(ex, r);
+            zbench_print(r);
+            fflush(stdout);
+        }
+    }
+
+    if (_G.output && zbench_write(_G.output, &_G.res) < 0) {
+        exit(EX_CANTCREAT);
+    }
+
+    if (_G.baseline) {
+        qv_init(&base);
+        if (zbench_read(_G.baseline, &base) < 0) {
+            exit(EX_NOINPUT);
+        }
+        if (zbench_compare(&base, &_G.res) > 0) {
+            res = EX_DATAERR;
+        }
+        qv_deep_wipe(&base, zbench_res_wipe);
+    }
+
+    if (_G.perf_on) {
+        perf_counters_close(&_G.perf);
+    }
+    qv_deep_wipe(&_G.res, zbench_res_wipe);
+    qv_wipe(&exports);
+    return res;
+}
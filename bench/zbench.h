@@ -0,0 +1,106 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_ZBENCH_H
+#define IS_LIB_COMMON_ZBENCH_H
+
+#include <lib-common/core.h>
+
+/* Benchmarks of the core primitives, run by the zbench program.
+ *
+ * A benchmark is a function registered with ZBENCH(), which does its setup
+ * and then runs the measured operation in a ZBENCH_LOOP():
+ *
+ *     ZBENCH(crc, crc32, "CRC32 of 4KiB") {
+ *         char buf[4096] = { 0 };
+ *
+ *         zbench_set_bytes(zb, sizeof(buf));
+ *         ZBENCH_LOOP(zb) {
+ *             zbench_use(icrc32(0, buf, sizeof(buf)));
+ *         }
+ *     }
+ *
+ * The harness calls the function several times: first to find a number of
+ * iterations long enough to be measured (see zbench -m), then once per
+ * sample. The result of a benchmark is the mean time per iteration over
+ * the samples, with its 95% confidence interval.
+ */
+
+typedef struct zbench_t {
+    uint64_t n;         /* iterations to run */
+    uint64_t bytes;     /* bytes processed by an iteration, if relevant */
+    uint64_t start;
+    uint64_t elapsed;   /* in nanoseconds */
+} zbench_t;
+
+typedef void (zbench_f)(zbench_t *zb);
+
+struct zbench_export {
+    struct zbench_export *prev;
+    const char *group;
+    const char *name;
+    const char *desc;
+    zbench_f   *cb;
+};
+extern struct zbench_export *zbench_exports_g;
+
+#define ZBENCH(group, name, desc)                                            \
+    static void zbench_##group##_##name(zbench_t *zb);                       \
+    static __attribute__((constructor))                                      \
+    void zbench_##group##_##name##_export(void)                              \
+    {                                                                        \
+        static struct zbench_export ex = {                                   \
+            .group = #group,                                                 \
+            .name  = #name,                                                  \
+            .desc  = desc,                                                   \
+            .cb    = &zbench_##group##_##name,                               \
+        };                                                                   \
+                                                                             \
+        ex.prev = zbench_exports_g;                                          \
+        zbench_exports_g = &ex;                                              \
+    }                                                                        \
+    static void zbench_##group##_##name(zbench_t *zb)
+
+/** Start measuring, the benchmark must then run zb->n iterations.
+ *
+ * \return the number of iterations to run.
+ */
+uint64_t zbench_start(zbench_t *zb);
+
+/** Stop measuring. */
+void zbench_stop(zbench_t *zb);
+
+/** Run the next statement zb->n times, measured. */
+#define ZBENCH_LOOP(zb)                                                      \
+    for (uint64_t __zb_n = zbench_start(zb);                                 \
+         __zb_n > 0 || (zbench_stop(zb), false); __zb_n--)
+
+/** Set the bytes processed by an iteration, to report a throughput. */
+static inline void zbench_set_bytes(zbench_t *zb, uint64_t bytes)
+{
+    zb->bytes = bytes;
+}
+
+/** Keep the compiler from optimizing out the computation of a value. */
+#define zbench_use(v)                                                        \
+    ({  __typeof__(v) __zb_v = (v);                                          \
+                                                                             \
+        __asm__ volatile ("" : : "g"(__zb_v) : "memory");                    \
+    })
+
+#endif
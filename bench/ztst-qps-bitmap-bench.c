@@ -101,6 +101,84 @@ static void z_qps_bitmap_scan(qps_bitmap_t *bitmap, bool is_nullable,
            elapsed / 1000000, elapsed % 1000000);
 }
 
+#define BITMAP_BULK_TIME(_what, _expr)                                       \
+    do {                                                                     \
+        proctimer_t _pt;                                                     \
+        uint64_t _res;                                                       \
+        int _elapsed;                                                        \
+                                                                             \
+        proctimer_start(&_pt);                                               \
+        _res = (_expr);                                                      \
+        _elapsed = proctimer_stop(&_pt);                                     \
+        printf("\t(%s)\t%ju in %d.%06d s\n", _what, _res,                    \
+               _elapsed / 1000000, _elapsed % 1000000);                      \
+    } while (0)
+
+static uint64_t z_qps_bitmap_probe_count(qps_bitmap_t *a, qps_bitmap_t *b)
+{
+    uint64_t count = 0;
+
+    qps_bitmap_for_each_unsafe(en, a) {
+        count += qps_bitmap_get(b, en.key.key) == QPS_BITMAP_1;
+    }
+    return count;
+}
+
+static uint64_t z_qps_bitmap_op(qps_bitmap_t *res, qps_bitmap_t *a,
+                                qps_bitmap_t *b,
+                                void (*op)(qps_bitmap_t *, qps_bitmap_t *))
+{
+    qps_bitmap_clear(res);
+    qps_bitmap_or(res, a);
+    (*op)(res, b);
+    return qps_bitmap_cardinality(res);
+}
+
+static uint64_t z_qps_bitmap_rank_select(qps_bitmap_t *bitmap, int count)
+{
+    uint64_t total = qps_bitmap_cardinality(bitmap);
+    uint64_t sum = 0;
+
+    for (int i = 0; i < count && total; i++) {
+        uint32_t row;
+
+        if (qps_bitmap_select(bitmap, (uint64_t)rand() % total, &row) >= 0)
+        {
+            sum += qps_bitmap_rank(bitmap, row);
+        }
+    }
+    return sum;
+}
+
+/* Bulk operations, on non-nullable bitmaps only. */
+static void z_qps_bitmap_bulk(qps_t *qps, qps_bitmap_t *bitmap,
+                              int nb_elements)
+{
+    qps_bitmap_t other;
+    qps_bitmap_t res;
+
+    qps_bitmap_init(&other, qps, qps_bitmap_create(qps, false));
+    qps_bitmap_init(&res, qps, qps_bitmap_create(qps, false));
+    z_qps_bitmap_fill(&other, nb_elements, false);
+
+    BITMAP_BULK_TIME("cardinality", qps_bitmap_cardinality(bitmap));
+    BITMAP_BULK_TIME("probe count", z_qps_bitmap_probe_count(bitmap,
+                                                             &other));
+    BITMAP_BULK_TIME("and cardinality",
+                     qps_bitmap_and_cardinality(bitmap, &other));
+    BITMAP_BULK_TIME("and", z_qps_bitmap_op(&res, bitmap, &other,
+                                            &qps_bitmap_and));
+    BITMAP_BULK_TIME("or", z_qps_bitmap_op(&res, bitmap, &other,
+                                           &qps_bitmap_or));
+    BITMAP_BULK_TIME("andnot", z_qps_bitmap_op(&res, bitmap, &other,
+                                               &qps_bitmap_andnot));
+    BITMAP_BULK_TIME("10000 select+rank",
+                     z_qps_bitmap_rank_select(bitmap, 10000));
+
+    qps_bitmap_destroy(&res);
+    qps_bitmap_destroy(&other);
+}
+
 static void z_qps_bitmap_bench(qps_t *qps, int nb_elements, bool is_nullable,
                                bool generic, bool safe, int repeat)
 {
@@ -121,6 +199,9 @@ static void z_qps_bitmap_bench(qps_t *qps, int nb_elements, bool is_nullable,
            nb_elements, elapsed / 1000000, elapsed % 1000000);
 
     z_qps_bitmap_scan(&bitmap, is_nullable, generic, safe, repeat);
+    if (!is_nullable) {
+        z_qps_bitmap_bulk(qps, &bitmap, nb_elements);
+    }
 
     qps_bitmap_destroy(&bitmap);
 }
@@ -989,10 +989,11 @@ def process_tokens(self, node):
 class IopcOptions:
 
     def __init__(self, ctx, path=None, class_range=None, includes=None,
-                 json_path=None, ts_path=None):
+                 json_path=None, ts_path=None, c_codecs=False):
         self.ctx = ctx
         self.path = path or ctx.path
         self.class_range = class_range
+        self.c_codecs = c_codecs
 
         # Evaluate include nodes
         self.includes = set()
@@ -1039,6 +1040,14 @@ class IopcOptions:
         else:
             return ''
 
+    @property
+    def c_codecs_option(self):
+        """ Get the c-codecs option for iopc """
+        if self.c_codecs:
+            return '--c-codecs'
+        else:
+            return ''
+
     @property
     def json_output_option(self):
         """ Get the json-output-path option for iopc """
@@ -1130,11 +1139,13 @@ class Iop2c(FirstInputStrTask):
     def run(self):
         cmd = ('{iopc} --Wextra --language {languages} '
                '--c-resolve-includes --typescript-enable-backbone '
-               '{includes} {class_range} {json_output} {ts_output} {source}')
+               '{includes} {class_range} {c_codecs} {json_output} '
+               '{ts_output} {source}')
         cmd = cmd.format(iopc=self.inputs[1].abspath(),
                          languages=self.env.IOP_LANGUAGES,
                          includes=self.env.IOP_INCLUDES,
                          class_range=self.env.IOP_CLASS_RANGE,
+                         c_codecs=self.env.IOP_C_CODECS,
                          json_output=self.env.IOP_JSON_OUTPUT,
                          ts_output=self.env.IOP_TS_OUTPUT,
                          source=self.inputs[0].abspath())
@@ -1203,6 +1214,7 @@ def process_iop(self, node):
         task.env.IOP_LANGUAGES   = opts.languages
         task.env.IOP_INCLUDES    = opts.includes_option
         task.env.IOP_CLASS_RANGE = opts.class_range_option
+        task.env.IOP_C_CODECS    = opts.c_codecs_option
         task.env.IOP_JSON_OUTPUT = opts.json_output_option
         task.env.IOP_TS_OUTPUT   = opts.ts_output_option
 
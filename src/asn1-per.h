@@ -155,6 +155,32 @@ int aper_encode_desc(sb_t *sb, const void *st, const asn1_desc_t *desc);
 int t_aper_decode_desc(pstream_t *ps, const asn1_desc_t *desc,
                        bool copy, void *st);
 
+/** Partially decode an APER-encoded message.
+ *
+ * Decode the message only up to a field, typically to route a message
+ * without decoding it entirely.
+ *
+ * The fields preceding the path are decoded, except the open types and
+ * the extensions that are skipped (left absent or zeroed). The decoding
+ * stops as soon as the last field of the path is (fully) decoded: the
+ * following fields are left absent or zeroed.
+ *
+ * The path can only go through SEQUENCE and CHOICE types; when a CHOICE
+ * on the path has another value, only its selected value is set.
+ *
+ * \param[in]  ps    The input, which is not consumed.
+ * \param[in]  desc  The description of the message.
+ * \param[in]  path  The names of the fields to go through, separated by
+ *                   dots, e.g. "initiatingMessage.procedureCode".
+ * \param[in]  copy  Whether the decoded strings must be copied.
+ * \param[out] st    The partially decoded message.
+ *
+ * \return 1 if the last field of the path was decoded, 0 if it cannot be
+ *         reached in the message, a negative value on error.
+ */
+int t_aper_decode_desc_partial(pstream_t *ps, const asn1_desc_t *desc,
+                               lstr_t path, bool copy, void *st);
+
 #define aper_encode(sb, pfx, st)  \
     ({                                                                       \
         if (!__builtin_types_compatible_p(typeof(st), pfx##_t *)             \
@@ -175,6 +201,15 @@ int t_aper_decode_desc(pstream_t *ps, const asn1_desc_t *desc,
         t_aper_decode_desc(ps, ASN1_GET_DESC(pfx), copy, st);                \
     })
 
+#define t_aper_decode_partial(ps, pfx, path, copy, st)  \
+    ({                                                                       \
+        if (!__builtin_types_compatible_p(typeof(st), pfx##_t *)) {          \
+            __error__("ASN.1 PER decoder: `"#st"' type "                     \
+                      "is not <"#pfx"_t *>");                                \
+        }                                                                    \
+        t_aper_decode_desc_partial(ps, ASN1_GET_DESC(pfx), path, copy, st);  \
+    })
+
 /*
  * The decode_log_level allows to specify the way we want to log (or not)
  * decoding errors:
@@ -178,6 +178,16 @@
         asn1_pack_(dst, v, ASN1_GET_DESC(pfx), stack);                       \
     })
 
+#define asn1_pack_ob(pfx, ob, v, stack) \
+    ({                                                                       \
+        if (!__builtin_types_compatible_p(typeof(v), const pfx##_t *)        \
+        &&  !__builtin_types_compatible_p(typeof(v), pfx##_t *))             \
+        {                                                                    \
+            __error__("incompatible input type for packing");                \
+        }                                                                    \
+        asn1_pack_ob_(ob, v, ASN1_GET_DESC(pfx), stack);                     \
+    })
+
 /* TODO stop messing with param order */
 #define asn1_unpack(pfx, ps, mem_pool, st, cpy) \
     ({                                                                       \
@@ -109,9 +109,13 @@ static int t_aper_get_unaligned_bytes(bit_stream_t *bs, size_t olen,
         }
     } else {
         uint8_t *buf;
+        size_t i = 0;
 
         buf = t_new_raw(uint8_t, olen);
-        for (size_t i = 0; i < olen; i++) {
+        for (; i + 8 <= olen; i += 8) {
+            put_unaligned_be64(buf + i, __bs_be_get_bits(bs, 64));
+        }
+        for (; i < olen; i++) {
             buf[i] = __bs_be_get_bits(bs, 8);
         }
 
@@ -1723,10 +1727,10 @@ int t_aper_decode_octet_string(bit_stream_t *bs, const asn1_cnt_info_t *info,
         }
     } while (len_ctx.more_fragments_to_read);
 
-    if (likely(buf.mp == &mem_pool_libc)) {
+    if (likely(buf.mp == &mem_pool_libc || buf.mp == &mem_pool_mremap)) {
         /* XXX There were more than one fragment so the buffer was reallocated
-         * on LIBC. The content has to be transferred on the t_stack or it
-         * will be lost. */
+         * on LIBC (or on the mremap pool when it is large). The content has
+         * to be transferred on the t_stack or it will be lost. */
         copy = true;
     }
     *os = LSTR_DATA_V(buf.tab, buf.len);
@@ -1802,6 +1806,54 @@ t_aper_decode_bit_string(bit_stream_t *bs, const asn1_cnt_info_t *info,
 /* }}} */
 /* Constructed types {{{ */
 
+/* Partial decoding: only the fields preceding the ones of the path are
+ * decoded (the open types and extensions among them are skipped without
+ * being decoded), the decoding stops as soon as the last field of the path
+ * is decoded. */
+typedef struct aper_partial_t {
+    qv_t(lstr) path;
+    int        depth;
+    /* The next constructed type decoded is the one in which the field
+     * path.tab[depth] is looked for. */
+    bool       on_path;
+    bool       reached;
+} aper_partial_t;
+
+static __thread aper_partial_t *aper_partial_g;
+
+/* Returns the partial decoding state if the constructed type being decoded
+ * is on the path. */
+static aper_partial_t *aper_partial_enter(void)
+{
+    aper_partial_t *p = aper_partial_g;
+
+    if (!p || !p->on_path) {
+        return NULL;
+    }
+    p->on_path = false;
+    return p;
+}
+
+static bool
+aper_partial_is_next(const aper_partial_t *p, const asn1_field_t *field)
+{
+    return lstr_equal(p->path.tab[p->depth], LSTR(field->name));
+}
+
+static int aper_partial_skip_field(bit_stream_t *bs, const asn1_field_t *field)
+{
+    lstr_t os;
+
+    /* The aligned octet strings are not copied. */
+    if (t_aper_decode_octet_string(bs, NULL, false, &os) < 0) {
+        e_info("cannot skip field %s:%s", field->oc_t_name, field->name);
+        return -1;
+    }
+    e_trace(5, "skipped field %s:%s (%d bytes)", field->oc_t_name,
+            field->name, os.len);
+    return 0;
+}
+
 static int
 t_aper_decode_constructed(bit_stream_t *bs, const asn1_desc_t *desc,
                           const asn1_field_t *field, bool copy, void *st);
@@ -1901,6 +1953,24 @@ t_aper_decode_field(bit_stream_t *bs, const asn1_field_t *field,
     return t_aper_decode_value(bs, field, copy, v);
 }
 
+static int
+t_aper_partial_decode_field(aper_partial_t *p, bit_stream_t *bs,
+                            const asn1_field_t *field, bool copy, void *v)
+{
+    e_trace(5, "field %s:%s of the path reached", field->oc_t_name,
+            field->name);
+
+    if (++p->depth == p->path.len) {
+        RETHROW(t_aper_decode_field(bs, field, copy, v));
+        p->reached = true;
+    } else {
+        p->on_path = true;
+        RETHROW(t_aper_decode_field(bs, field, copy, v));
+        p->on_path = false;
+    }
+    return 0;
+}
+
 static void *t_alloc_if_pointed(const asn1_field_t *field, void *st)
 {
     if (field->pointed) {
@@ -1948,6 +2018,12 @@ t_aper_decode_sequence(bit_stream_t *bs, const asn1_desc_t *desc,
     bit_stream_t *fields_bitmap = &opt_bitmap;
     bool extension_present = false;
     bool extended_fields_reached = false;
+    aper_partial_t *partial = aper_partial_enter();
+
+    if (partial) {
+        /* The fields following the path are left unset. */
+        p_clear(st, desc->size);
+    }
 
     if (desc->is_extended) {
         e_trace(5, "the sequence is extended");
@@ -2015,17 +2091,36 @@ t_aper_decode_sequence(bit_stream_t *bs, const asn1_desc_t *desc,
                 continue;
             }
 
-            t_alloc_if_pointed(field, st);
-            v = asn1_opt_field_w(GET_PTR(st, field, void), field->type, true);
         } else {
             assert (field->mode != ASN1_OBJ_MODE(SEQ_OF));
 
             /* Should be checked in "asn1_reg_field()". */
             assert (!field->is_extension);
+        }
+
+        if (partial && !aper_partial_is_next(partial, field)
+        &&  (field->is_open_type || field->is_extension))
+        {
+            /* Left absent (or zeroed) when not on the path. */
+            if (field->mode == ASN1_OBJ_MODE(OPTIONAL)) {
+                asn1_opt_field_w(GET_PTR(st, field, void), field->type,
+                                 false);
+            }
+            RETHROW(aper_partial_skip_field(bs, field));
+            continue;
+        }
 
+        if (field->mode == ASN1_OBJ_MODE(OPTIONAL)) {
+            t_alloc_if_pointed(field, st);
+            v = asn1_opt_field_w(GET_PTR(st, field, void), field->type, true);
+        } else {
             v = t_alloc_if_pointed(field, st);
         }
 
+        if (partial && aper_partial_is_next(partial, field)) {
+            return t_aper_partial_decode_field(partial, bs, field, copy, v);
+        }
+
         e_trace(5, "decoding SEQUENCE value %s:%s",
                 field->oc_t_name, field->name);
 
@@ -2080,6 +2175,7 @@ t_aper_decode_choice(bit_stream_t *bs, const asn1_desc_t *desc, bool copy,
     size_t               index;
     void                *v;
     bool extension_present = false;
+    aper_partial_t *partial = aper_partial_enter();
 
     if (desc->is_extended) {
         if (bs_done(bs)) {
@@ -2130,6 +2226,14 @@ t_aper_decode_choice(bit_stream_t *bs, const asn1_desc_t *desc, bool copy,
     enum_field = &desc->fields.tab[0];
     choice_field = &desc->fields.tab[index];   /* XXX Indexes start from 0 */
     __asn1_set_int(st, enum_field, index);  /* Write enum value         */
+
+    if (partial && !aper_partial_is_next(partial, choice_field)) {
+        /* The path cannot be reached: only the choice is known. */
+        e_trace(5, "choice %s:%s is not on the path",
+                choice_field->oc_t_name, choice_field->name);
+        return 0;
+    }
+
     v = t_alloc_if_pointed(choice_field, st);
 
     assert (choice_field->mode == ASN1_OBJ_MODE(MANDATORY));
@@ -2138,6 +2242,10 @@ t_aper_decode_choice(bit_stream_t *bs, const asn1_desc_t *desc, bool copy,
     e_trace(5, "decoding CHOICE value %s:%s",
             choice_field->oc_t_name, choice_field->name);
 
+    if (partial) {
+        return t_aper_partial_decode_field(partial, bs, choice_field, copy,
+                                           v);
+    }
     if (t_aper_decode_field(bs, choice_field, copy, v) < 0) {
         e_info("cannot decode choice value");
         return -1;
@@ -2246,6 +2354,9 @@ t_aper_decode_constructed(bit_stream_t *bs, const asn1_desc_t *desc,
         assert (field);
         assert (field->u.comp == desc);
 
+        /* A path cannot go through a SEQUENCE OF: it is fully decoded. */
+        aper_partial_enter();
+
         return t_aper_decode_seq_of(bs, field, copy, st);
     }
 
@@ -2277,6 +2388,31 @@ int t_aper_decode_desc(pstream_t *ps, const asn1_desc_t *desc,
     return 0;
 }
 
+int t_aper_decode_desc_partial(pstream_t *ps, const asn1_desc_t *desc,
+                               lstr_t path, bool copy, void *st)
+{
+    bit_stream_t bs = bs_init_ps(ps, 0);
+    aper_partial_t partial;
+    ctype_desc_t sep;
+    int res;
+
+    assert (!aper_partial_g);
+
+    p_clear(&partial, 1);
+    t_qv_init(&partial.path, 4);
+    ctype_desc_build(&sep, ".");
+    ps_split(ps_initlstr(&path), &sep, 0, &partial.path);
+    THROW_ERR_IF(!partial.path.len);
+    partial.on_path = true;
+
+    aper_partial_g = &partial;
+    res = t_aper_decode_constructed(&bs, desc, NULL, copy, st);
+    aper_partial_g = NULL;
+    RETHROW(res);
+
+    return partial.reached;
+}
+
 /* }}} */
 
 /* }}} */
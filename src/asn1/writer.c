@@ -332,6 +332,18 @@ static uint8_t *asn1_pack_bit_string(uint8_t *dst, const asn1_bit_string_t *bs)
 #define GET_VECTOR_LEN(st, field) \
     GET_CONST_PTR(st, ASN1_VECTOR_OF(void), field->offset)->len
 
+/* Outbuf output mode: the big strings are referenced as outbuf chunks
+ * instead of being copied. */
+static __thread struct {
+    outbuf_t *ob;
+    int       chunked_len;
+} asn1_pack_ob_g;
+
+static ALWAYS_INLINE bool asn1_pack_ob_is_chunked(int32_t len)
+{
+    return unlikely(asn1_pack_ob_g.ob) && len > OUTBUF_CHUNK_MIN_SIZE;
+}
+
 /* ----- SIZE PACKING - {{{ - */
 static int asn1_pack_size_rec(const void *st, const asn1_desc_t *desc,
                               qv_t(i32) *stack);
@@ -391,6 +403,9 @@ static int asn1_pack_value_size(const void *dt, const asn1_field_t *spec,
         assert (((lstr_t *)dt)->data);
         data_size = ((lstr_t *)dt)->len;
         qv_append(stack, data_size);
+        if (asn1_pack_ob_is_chunked(data_size)) {
+            asn1_pack_ob_g.chunked_len += data_size;
+        }
         break;
       case ASN1_OBJ_TYPE(asn1_bit_string_t):
         /* IF ASSERT: user maybe forgot to declare field as optional */
@@ -576,6 +591,28 @@ static int asn1_pack_size_rec(const void *st, const asn1_desc_t *desc,
 }
 /* - }}} */
 /* ----- PROPER PACKING -{{{- */
+/* Commits to the outbuf the bytes written in its reserved space. */
+static void asn1_pack_ob_commit(uint8_t *dst)
+{
+    outbuf_t *ob = asn1_pack_ob_g.ob;
+    int len = dst - (uint8_t *)sb_end(&ob->sb);
+
+    __sb_fixlen(&ob->sb, ob->sb.len + len);
+    ob->sb_trailing += len;
+    ob->length      += len;
+}
+
+static uint8_t *asn1_pack_ob_chunk(uint8_t *dst, const lstr_t *data)
+{
+    outbuf_t *ob = asn1_pack_ob_g.ob;
+
+    asn1_pack_ob_commit(dst);
+    ob_add_memchunk(ob, data->data, data->len, true);
+
+    /* The reserved space is left untouched by the chunk. */
+    return (uint8_t *)sb_end(&ob->sb);
+}
+
 static uint8_t *asn1_pack_rec(uint8_t *dst, const void *st, const
                               asn1_desc_t *desc, int32_t depth,
                               qv_t(i32) *stack);
@@ -640,7 +677,11 @@ static uint8_t *asn1_pack_value(uint8_t *dst, const void *dt,
         break;
       case ASN1_OBJ_TYPE(lstr_t):
       case ASN1_OBJ_TYPE(OPEN_TYPE):
-        dst = asn1_pack_data(dst, (const lstr_t *)dt);
+        if (asn1_pack_ob_is_chunked(data_size)) {
+            dst = asn1_pack_ob_chunk(dst, (const lstr_t *)dt);
+        } else {
+            dst = asn1_pack_data(dst, (const lstr_t *)dt);
+        }
         e_trace_hex(4, "value:", ((const lstr_t *)dt)->data,
                     ((const lstr_t *)dt)->len);
         break;
@@ -859,8 +900,43 @@ uint8_t *asn1_pack_(uint8_t *dst, const void *st, const asn1_desc_t *desc,
 int asn1_pack_size_(const void *st, const asn1_desc_t *desc,
                     qv_t(i32) *stack)
 {
+    int len;
+
+    /* Reserve the stack at once from the previous messages of the same
+     * description instead of growing it field after field. */
     stack->len = 0;
-    return asn1_pack_size_rec(st, desc, stack);
+    qv_grow(stack, desc->pack_stack_hint);
+    len = RETHROW(asn1_pack_size_rec(st, desc, stack));
+    if (stack->len > desc->pack_stack_hint) {
+        /* Descriptions are per-thread, this is not racy. */
+        ((asn1_desc_t *)desc)->pack_stack_hint = stack->len;
+    }
+
+    return len;
+}
+
+int asn1_pack_ob_(outbuf_t *ob, const void *st, const asn1_desc_t *desc,
+                  qv_t(i32) *stack)
+{
+    int len;
+    uint8_t *dst;
+
+    asn1_pack_ob_g.ob = ob;
+    asn1_pack_ob_g.chunked_len = 0;
+    len = asn1_pack_size_(st, desc, stack);
+    if (len < 0) {
+        asn1_pack_ob_g.ob = NULL;
+        return len;
+    }
+
+    /* Reserve the space for everything but the chunked strings, so that
+     * the buffer is not reallocated while being written. */
+    sb_grow(&ob->sb, len - asn1_pack_ob_g.chunked_len);
+    dst = asn1_pack_(sb_end(&ob->sb), st, desc, stack);
+    asn1_pack_ob_commit(dst);
+    asn1_pack_ob_g.ob = NULL;
+
+    return len;
 }
 /* }}} */
 /*----- UNPACKER -- */
@@ -22,6 +22,7 @@
 #define IS_LIB_COMMON_ASN1_WRITER_H
 
 #include <lib-common/container-qvector.h>
+#include <lib-common/str-outbuf.h>
 #include "helpers.in.c"
 
 /* ASN1 writing API
@@ -448,6 +449,10 @@ typedef struct asn1_desc_t {
 
     /* TODO add SEQUENCE OF into constructed type enum */
     bool                  is_seq_of : 1;
+
+    /* BER packing: largest length stack seen when sizing a value of this
+     * description, used to reserve the stack upfront. */
+    int32_t               pack_stack_hint;
 } asn1_desc_t;
 
 static inline asn1_desc_t *asn1_desc_init(asn1_desc_t *desc)
@@ -495,6 +500,17 @@ int asn1_pack_size_(const void *st, const asn1_desc_t *desc,
 uint8_t *asn1_pack_(uint8_t *dst, const void *st, const asn1_desc_t *desc,
                     qv_t(i32) *stack);
 
+/** \brief Packs a value at the end of an outbuf.
+ *
+ * Both the size and the packing passes are run. The strings and open types
+ * larger than OUTBUF_CHUNK_MIN_SIZE are not copied: they are referenced as
+ * outbuf chunks, so they must outlive \p ob.
+ *
+ * \return The length of the packed value, or a negative error code.
+ */
+int asn1_pack_ob_(outbuf_t *ob, const void *st, const asn1_desc_t *desc,
+                  qv_t(i32) *stack);
+
 int asn1_unpack_(pstream_t *ps, const asn1_desc_t *desc,
                  mem_pool_t *mem_pool, void *st, bool copy);
 
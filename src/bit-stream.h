@@ -469,34 +469,30 @@ static inline int bs_be_get_bit(bit_stream_t *bs)
     return unlikely(bs_done(bs)) ? -1 : __bs_be_get_bit(bs);
 }
 
+/* The bits are read a 64-bits word at a time: in big endian order, the bit
+ * at offset k of an aligned word is the bit (63 - k) of its value. */
 static inline uint64_t __bs_be_peek_bits(const bit_stream_t *bs, size_t blen)
 {
-    const byte *b = &((const byte *)bs->s.p)[bs->s.offset / 8];
-    size_t offset = bs->s.offset % 8;
-    size_t remain = blen;
-    uint64_t res = 0;
+    uint64_t res;
+
+    assert (blen <= 64);
+    if (unlikely(!blen))
+        return 0;
+
+    assert (bs_has(bs, blen));
 
-    if (offset + blen <= 8) {
-        res = (*b >> (8 - (offset + blen))) & BITMASK_LT(uint64_t, blen);
-        return res;
+    if (bs->e.p == bs->s.p) {
+        mem_tool_allow_memory(bs->s.p, 8, true);
     }
-    if (offset) {
-        remain -= 8 - offset;
-        res |= ((uint64_t)*b << remain);
-        if (blen != 64) {
-            res &= BITMASK_LT(uint64_t, blen);
+    res = be_to_cpu64p((const be64_t *)bs->s.p) << bs->s.offset;
+    if (bs->s.offset + blen > 64) {
+        if (bs->e.p == &bs->s.p[1]) {
+            mem_tool_allow_memory(&bs->s.p[1], 8, true);
         }
-        b++;
+        res |= be_to_cpu64p((const be64_t *)&bs->s.p[1])
+            >> (64 - bs->s.offset);
     }
-    while (remain >= 8) {
-        remain -= 8;
-        res |= ((uint64_t)*b << remain);
-        b++;
-    }
-    if (remain) {
-        res |= (*b >> (8 - remain)) & BITMASK_LT(uint64_t, remain);
-    }
-    return res;
+    return res >> (64 - blen);
 }
 
 static inline uint64_t __bs_be_get_bits(bit_stream_t *bs, size_t blen)
@@ -152,6 +152,9 @@ static inline wah_t *wah_new_from_data(pstream_t data)
 const qv_t(wah_word_vec) *wah_get_storage(const wah_t *wah);
 uint64_t wah_get_storage_len(const wah_t *wah);
 
+/** Get the memory allocated for a wah_t, not including the wah_t itself. */
+size_t wah_memory_footprint(const wah_t *wah);
+
 void wah_add0s(wah_t *map, uint64_t count) __leaf;
 void wah_add1s(wah_t *map, uint64_t count) __leaf;
 void wah_add1_at(wah_t *map, uint64_t pos) __leaf;
@@ -174,6 +177,64 @@ wah_t *wah_multi_or(const wah_t *src[], int len, wah_t * __restrict dest) __leaf
 __must_check__ __leaf
 bool wah_get(const wah_t *map, uint64_t pos);
 
+/* }}} */
+/* Boolean expressions {{{ */
+
+/** Operators of the nodes of a boolean expression of WAH. */
+typedef enum wah_expr_op_t {
+    WAH_EXPR_MAP,
+    WAH_EXPR_AND,
+    WAH_EXPR_OR,
+    WAH_EXPR_NOT,
+} wah_expr_op_t;
+
+typedef struct wah_expr_t wah_expr_t;
+qvector_t(wah_expr, wah_expr_t *);
+
+/** A node of a boolean expression of WAH.
+ *
+ * The leaves (WAH_EXPR_MAP) reference a map, the other nodes have operands:
+ * at least one for WAH_EXPR_AND and WAH_EXPR_OR, exactly one for
+ * WAH_EXPR_NOT.
+ */
+struct wah_expr_t {
+    wah_expr_op_t   op;
+    const wah_t    *map;
+    qv_t(wah_expr)  operands;
+};
+
+wah_expr_t *t_wah_expr_map(const wah_t *map);
+wah_expr_t *t_wah_expr_new(wah_expr_op_t op, wah_expr_t * const operands[],
+                           int len);
+
+static inline wah_expr_t *t_wah_expr_not(wah_expr_t *operand)
+{
+    return t_wah_expr_new(WAH_EXPR_NOT, &operand, 1);
+}
+
+#define t_wah_expr_args(op, ...)                                             \
+    t_wah_expr_new((op), (wah_expr_t *[]){ __VA_ARGS__ },                    \
+                   countof(((wah_expr_t *[]){ __VA_ARGS__ })))
+#define t_wah_expr_and(...)  t_wah_expr_args(WAH_EXPR_AND, __VA_ARGS__)
+#define t_wah_expr_or(...)   t_wah_expr_args(WAH_EXPR_OR, __VA_ARGS__)
+
+/** Evaluate a boolean expression of WAH.
+ *
+ * The maps of the expression are considered padded with 0s up to the length
+ * of the longest one, which is the length of the result.
+ *
+ * The expression is planned with the densities of its maps: the operands of
+ * the ANDs are intersected from the sparsest to the densest one until the
+ * intersection is empty, and their negated operands are subtracted instead
+ * of being complemented. When the maps are large enough and several threads
+ * are running, the bit range is split in chunks evaluated by thr jobs, and
+ * the words of the results of the chunks are appended to \p dest as is.
+ *
+ * \param[in]  expr  the expression, whose maps must not be \p dest.
+ * \param[out] dest  the result, a map of the pool if NULL.
+ */
+wah_t *wah_expr_eval(const wah_expr_t *expr, wah_t * __restrict dest);
+
 /* }}} */
 /* WAH pools {{{ */
 
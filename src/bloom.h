@@ -0,0 +1,194 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_BLOOM_H
+#define IS_LIB_COMMON_BLOOM_H
+
+#include <lib-common/core.h>
+#include <lib-common/hash.h>
+
+/** \defgroup bloom Approximate membership filters.
+ * \brief Bloom and cuckoo filters.
+ *
+ * \{
+ *
+ * These filters answer "is this key in the set?" with no false negatives
+ * and a bounded rate of false positives, in a few bits per key. They are
+ * meant to guard expensive lookups (a qhat, a remote service, ...): when
+ * the filter says no, the lookup can be skipped.
+ *
+ * The keys are given by their 64-bit hash, wyhash64() being used by the
+ * helpers taking the data directly. The hash is the only thing the filters
+ * see, so it must be the same for all the users of a filter, and stable
+ * across restarts for the persistent ones.
+ *
+ * The filters are not thread-safe: concurrent readers are fine, writers
+ * must be serialized with the readers.
+ */
+
+/* {{{ Blocked Bloom filters */
+
+/** Blocked Bloom filter.
+ *
+ * This is a "split block" Bloom filter: the key selects a block of 256
+ * bits made of 8 words of 32 bits, and sets one bit in each word. A lookup
+ * thus touches a single cache line, and is done with a couple of AVX2
+ * instructions when the CPU supports them.
+ *
+ * The false positive rate is slightly higher than the one of a classic
+ * Bloom filter of the same size, which is compensated by the sizing of
+ * bloom_init(). Keys cannot be removed, see cuckoo_t for that.
+ */
+typedef struct bloom_t {
+    uint32_t *words;
+    uint32_t  nb_blocks;
+} bloom_t;
+
+#define BLOOM_BLOCK_WORDS  8
+
+/** Compute the number of blocks needed for a filter.
+ *
+ * \param[in] nb_keys  the expected number of keys.
+ * \param[in] fpr      the wanted false positive rate, in ]0, 1[.
+ */
+uint32_t bloom_nb_blocks(uint64_t nb_keys, double fpr);
+
+/** Initialize a filter sized with bloom_nb_blocks(). */
+bloom_t * nonnull bloom_init(bloom_t * nonnull bf, uint64_t nb_keys,
+                             double fpr);
+void bloom_wipe(bloom_t * nonnull bf);
+GENERIC_DELETE(bloom_t, bloom);
+
+static inline bloom_t * nonnull bloom_new(uint64_t nb_keys, double fpr)
+{
+    return bloom_init(p_new_raw(bloom_t, 1), nb_keys, fpr);
+}
+
+/** Remove all the keys of a filter. */
+void bloom_clear(bloom_t * nonnull bf);
+
+/** Add in \p dst the keys of \p src, both having the same size. */
+void bloom_union(bloom_t * nonnull dst, const bloom_t * nonnull src);
+
+/* Low-level functions, on the words of nb_blocks blocks. */
+void __bloom_add(uint32_t * nonnull words, uint32_t nb_blocks,
+                 uint64_t hash);
+bool __bloom_has(const uint32_t * nonnull words, uint32_t nb_blocks,
+                 uint64_t hash);
+
+static inline void bloom_add_hash(bloom_t * nonnull bf, uint64_t hash)
+{
+    __bloom_add(bf->words, bf->nb_blocks, hash);
+}
+
+static inline bool bloom_has_hash(const bloom_t * nonnull bf, uint64_t hash)
+{
+    return __bloom_has(bf->words, bf->nb_blocks, hash);
+}
+
+static inline void bloom_add(bloom_t * nonnull bf,
+                             const void * nonnull data, size_t len)
+{
+    bloom_add_hash(bf, wyhash64(data, len, 0));
+}
+
+static inline bool bloom_has(const bloom_t * nonnull bf,
+                             const void * nonnull data, size_t len)
+{
+    return bloom_has_hash(bf, wyhash64(data, len, 0));
+}
+
+/* }}} */
+/* {{{ Cuckoo filters */
+
+/** Cuckoo filter.
+ *
+ * The filter stores a 16-bit fingerprint of the keys in buckets of 4
+ * slots, each key having two possible buckets. Unlike Bloom filters, keys
+ * can be removed, and the false positive rate (about 0.01%) does not
+ * depend on the load. The lookups check the 8 slots of the two buckets at
+ * once with SSE2.
+ *
+ * The filter is sized for a number of keys, and the insertions may fail
+ * when it gets full (generally above 95% of the slots).
+ */
+typedef struct cuckoo_t {
+    uint16_t *slots;
+    uint32_t  mask;
+    uint32_t  nb_keys;
+} cuckoo_t;
+
+#define CUCKOO_BUCKET_SLOTS  4
+
+/** Initialize a filter able to hold at least \p nb_keys keys. */
+cuckoo_t * nonnull cuckoo_init(cuckoo_t * nonnull cf, uint32_t nb_keys);
+void cuckoo_wipe(cuckoo_t * nonnull cf);
+GENERIC_DELETE(cuckoo_t, cuckoo);
+
+static inline cuckoo_t * nonnull cuckoo_new(uint32_t nb_keys)
+{
+    return cuckoo_init(p_new_raw(cuckoo_t, 1), nb_keys);
+}
+
+/** Remove all the keys of a filter. */
+void cuckoo_clear(cuckoo_t * nonnull cf);
+
+/** Add a key.
+ *
+ * A key added several times must be removed as many times.
+ *
+ * \return 0 on success, -1 if the filter is full (the key is not added
+ *         then, and the filter is left unchanged).
+ */
+int cuckoo_add_hash(cuckoo_t * nonnull cf, uint64_t hash);
+
+bool cuckoo_has_hash(const cuckoo_t * nonnull cf, uint64_t hash);
+
+/** Remove a key.
+ *
+ * \warning only keys that were added can be removed: removing another key
+ *          can remove the fingerprint of an added one, and produce false
+ *          negatives.
+ *
+ * \return 0 on success, -1 if the key was not found.
+ */
+int cuckoo_remove_hash(cuckoo_t * nonnull cf, uint64_t hash);
+
+static inline int cuckoo_add(cuckoo_t * nonnull cf,
+                             const void * nonnull data, size_t len)
+{
+    return cuckoo_add_hash(cf, wyhash64(data, len, 0));
+}
+
+static inline bool cuckoo_has(const cuckoo_t * nonnull cf,
+                              const void * nonnull data, size_t len)
+{
+    return cuckoo_has_hash(cf, wyhash64(data, len, 0));
+}
+
+static inline int cuckoo_remove(cuckoo_t * nonnull cf,
+                                const void * nonnull data, size_t len)
+{
+    return cuckoo_remove_hash(cf, wyhash64(data, len, 0));
+}
+
+/* }}} */
+
+/** \} */
+
+#endif
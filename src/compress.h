@@ -0,0 +1,240 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_COMPRESS_H
+#define IS_LIB_COMMON_COMPRESS_H
+
+#include <lib-common/core.h>
+#include <lib-common/str-outbuf.h>
+
+#if __has_feature(nullability)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic error "-Wnullability-completeness"
+#if __has_warning("-Wnullability-completeness-on-arrays")
+#pragma GCC diagnostic ignored "-Wnullability-completeness-on-arrays"
+#endif
+#endif
+
+/* Uniform compression API on top of zstd and LZ4.
+ *
+ * The data is always produced in the standard frame format of the
+ * algorithm (the one of the zstd and lz4 command line tools), with the
+ * uncompressed size stored in the frame header by the one-shot functions.
+ *
+ * zstd offers ratios close to (or better than) zlib for a much lower CPU
+ * cost, and supports dictionaries, that are very efficient on small
+ * similar messages (bpacked IOPs for example). LZ4 compresses less but is
+ * several times faster, in particular to decompress.
+ *
+ * For the gzip and deflate formats, see zlib-wrapper.h.
+ */
+
+typedef enum compress_algo_t {
+    COMPRESS_ZSTD,
+    COMPRESS_LZ4,
+} compress_algo_t;
+
+/** Default compression level of the algorithm.
+ *
+ * Otherwise, the levels are the ones of the libraries:
+ *  - zstd: 1 to 22 (negative levels are faster and compress less);
+ *  - LZ4: 1 and 2 use the fast compressor, 3 to 12 the high compression
+ *    one.
+ */
+#define COMPRESS_LEVEL_DEFAULT  0
+
+/* {{{ Dictionaries */
+
+/** Compression dictionary.
+ *
+ * Only zstd supports dictionaries. The same dictionary must be used for
+ * the compression and the decompression, its identifier is stored in the
+ * zstd frames. A dictionary is read-only once created and can be shared
+ * by several threads.
+ */
+typedef struct compress_dict_t compress_dict_t;
+
+/** Load a dictionary.
+ *
+ * \param[in] data   the content of the dictionary, as produced by
+ *                   compress_dict_train() or `zstd --train`. Any other
+ *                   content is used as a raw dictionary. It is copied.
+ * \param[in] level  the compression level used with the dictionary.
+ *
+ * \return the dictionary, NULL if it could not be loaded.
+ */
+compress_dict_t * nullable compress_dict_new(lstr_t data, int level);
+void compress_dict_delete(compress_dict_t * nullable * nonnull dict);
+
+/** Get the identifier of a dictionary, 0 for raw dictionaries. */
+uint32_t compress_dict_id(const compress_dict_t * nonnull dict);
+
+/** Get the identifier of the dictionary used to compress a zstd frame.
+ *
+ * \return the identifier, 0 if the frame was compressed without a
+ *         dictionary (or with a raw one), or if it is not a valid zstd
+ *         frame.
+ */
+uint32_t compress_dict_id_from_frame(lstr_t frame);
+
+/** Train a zstd dictionary on a set of samples.
+ *
+ * The samples should be representative of the messages to compress, a
+ * few hundred samples and a dictionary of about 100 times smaller than
+ * their total size are good starting points.
+ *
+ * \param[out] out         buffer where the dictionary is appended.
+ * \param[in]  samples     the samples.
+ * \param[in]  nb_samples  the number of samples.
+ * \param[in]  max_size    the maximum size of the dictionary.
+ *
+ * \return the size of the dictionary, -1 if the training failed (not
+ *         enough samples for example).
+ */
+int compress_dict_train(sb_t * nonnull out,
+                        const lstr_t * nonnull samples, int nb_samples,
+                        int max_size);
+
+/* }}} */
+/* {{{ One-shot API */
+
+/** Add compressed data in the string buffer.
+ *
+ * The data is compressed as a single frame.
+ *
+ * \param[out] out    output buffer.
+ * \param[in]  algo   the compression algorithm.
+ * \param[in]  level  the compression level, see COMPRESS_LEVEL_DEFAULT.
+ * \param[in]  dict   the dictionary to use (zstd only), can be NULL.
+ * \param[in]  data   source data.
+ * \param[in]  dlen   size of the data pointed by \p data.
+ *
+ * \return the amount of data added to \p out, -1 in case of error (in
+ *         which case \p out is left untouched).
+ */
+ssize_t sb_add_compress(sb_t * nonnull out, compress_algo_t algo, int level,
+                        const compress_dict_t * nullable dict,
+                        const void * nonnull data, size_t dlen);
+
+/** Add uncompressed data in the string buffer.
+ *
+ * \p data must contain one or several complete frames.
+ *
+ * \param[out] out   output buffer.
+ * \param[in]  algo  the compression algorithm.
+ * \param[in]  dict  the dictionary used by the compression, can be NULL.
+ * \param[in]  data  compressed data.
+ * \param[in]  dlen  size of the data pointed by \p data.
+ *
+ * \return the amount of data added to \p out, -1 if the data is invalid
+ *         or truncated (in which case \p out is left untouched).
+ */
+ssize_t sb_add_decompress(sb_t * nonnull out, compress_algo_t algo,
+                          const compress_dict_t * nullable dict,
+                          const void * nonnull data, size_t dlen);
+
+#define ob_add_compress(ob, algo, level, dict, data, dlen)  \
+    OB_WRAP(sb_add_compress, ob, algo, level, dict, data, dlen)
+
+#define ob_add_decompress(ob, algo, dict, data, dlen)  \
+    OB_WRAP(sb_add_decompress, ob, algo, dict, data, dlen)
+
+/* }}} */
+/* {{{ Streaming API */
+
+/** Compression stream.
+ *
+ * A stream produces a frame, whose data is added piece by piece. The
+ * frame is ended by compress_stream_end(), after which the stream can be
+ * used for a new frame.
+ */
+typedef struct compress_stream_t compress_stream_t;
+
+/** Create a compression stream.
+ *
+ * \p dict, when not NULL, must outlive the stream.
+ */
+compress_stream_t * nonnull
+compress_stream_new(compress_algo_t algo, int level,
+                    const compress_dict_t * nullable dict);
+void compress_stream_delete(compress_stream_t * nullable * nonnull cs);
+
+/** Compress data.
+ *
+ * The compressor can keep the data to compress it along the following
+ * one, so this does not necessarily add anything to \p out.
+ *
+ * \return the amount of data added to \p out, -1 in case of error.
+ */
+ssize_t compress_stream_add(compress_stream_t * nonnull cs,
+                            sb_t * nonnull out,
+                            const void * nonnull data, size_t dlen);
+
+/** Flush the data buffered by the compressor.
+ *
+ * Once flushed, everything added so far can be decompressed by the
+ * receiver. Flushing too often degrades the compression ratio.
+ *
+ * \return the amount of data added to \p out, -1 in case of error.
+ */
+ssize_t compress_stream_flush(compress_stream_t * nonnull cs,
+                              sb_t * nonnull out);
+
+/** End the current frame.
+ *
+ * \return the amount of data added to \p out, -1 in case of error.
+ */
+ssize_t compress_stream_end(compress_stream_t * nonnull cs,
+                            sb_t * nonnull out);
+
+#define ob_compress_stream_add(ob, cs, data, dlen)  \
+    OB_WRAP(compress_stream_add, ob, cs, data, dlen)
+
+/** Decompression stream. */
+typedef struct decompress_stream_t decompress_stream_t;
+
+/** Create a decompression stream.
+ *
+ * \p dict, when not NULL, must outlive the stream.
+ */
+decompress_stream_t * nonnull
+decompress_stream_new(compress_algo_t algo,
+                      const compress_dict_t * nullable dict);
+void decompress_stream_delete(decompress_stream_t * nullable * nonnull ds);
+
+/** Decompress data.
+ *
+ * Consumes the data of \p in, and adds the uncompressed data to \p out.
+ * It stops at the end of a frame, leaving the data that follows it in
+ * \p in.
+ *
+ * \return 1 if the end of a frame was reached, 0 if all of \p in was
+ *         consumed before the end of the frame, -1 if the data is invalid
+ *         (the stream is then reset and expects the start of a new
+ *         frame).
+ */
+int decompress_stream_add(decompress_stream_t * nonnull ds,
+                          sb_t * nonnull out, pstream_t * nonnull in);
+
+/* }}} */
+
+#if __has_feature(nullability)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
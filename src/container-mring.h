@@ -0,0 +1,154 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_CONTAINER_MRING_H
+#define IS_LIB_COMMON_CONTAINER_MRING_H
+
+#include <lib-common/core.h>
+
+#if __has_feature(nullability)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic error "-Wnullability-completeness"
+#if __has_warning("-Wnullability-completeness-on-arrays")
+#pragma GCC diagnostic ignored "-Wnullability-completeness-on-arrays"
+#endif
+#endif
+
+/** Mirrored ring buffers of bytes.
+ *
+ * The memory of a mring is mapped twice, one copy right after the other,
+ * so that both the data and the free space are always contiguous, whatever
+ * their position in the ring: a frame that wraps around the end of the
+ * ring can be parsed in place, with a pstream_t, and the data is never
+ * moved nor reallocated, unlike with a sb_t on which the consumed bytes are
+ * skipped.
+ *
+ * It is meant for the read buffers of the connections, whose size is
+ * bounded:
+ *
+ *     if (mring_read(&w->ibuf, w->fd) <= 0) {
+ *         ...
+ *     }
+ *     ps = mring_ps(&w->ibuf);
+ *     while (parse_frame(&ps) >= 0) {
+ *         ...
+ *     }
+ *     mring_skip_upto(&w->ibuf, ps.s);
+ *
+ * The size of the ring is a multiple of the page size, and does not change.
+ */
+typedef struct mring_t {
+    char   * nullable buf;
+    uint32_t size;
+    uint32_t rpos;
+    uint32_t len;
+} mring_t;
+
+/** Initialize a mring of (at least) \p size bytes.
+ *
+ * \return -1 if the mappings failed, with errno set.
+ */
+int mring_init(mring_t * nonnull r, uint32_t size);
+void mring_wipe(mring_t * nonnull r);
+
+static inline uint32_t mring_len(const mring_t * nonnull r)
+{
+    return r->len;
+}
+
+/** Room left in the ring. */
+static inline uint32_t mring_avail(const mring_t * nonnull r)
+{
+    return r->size - r->len;
+}
+
+static inline const char * nonnull mring_data(const mring_t * nonnull r)
+{
+    return r->buf + r->rpos;
+}
+
+static inline pstream_t mring_ps(const mring_t * nonnull r)
+{
+    return ps_init(r->buf + r->rpos, r->len);
+}
+
+/** Pointer on the free space, where the next mring_avail() bytes can be
+ * written before a call to mring_commit().
+ */
+static inline char * nonnull mring_wptr(const mring_t * nonnull r)
+{
+    return r->buf + r->rpos + r->len;
+}
+
+static inline void mring_commit(mring_t * nonnull r, uint32_t len)
+{
+    assert (len <= mring_avail(r));
+    r->len += len;
+}
+
+/** Consume the \p len first bytes of the ring. */
+static inline void mring_skip(mring_t * nonnull r, uint32_t len)
+{
+    assert (len <= r->len);
+    r->len  -= len;
+    r->rpos += len;
+    if (r->rpos >= r->size) {
+        r->rpos -= r->size;
+    }
+}
+
+/** Consume the bytes up to \p p, a pointer in the data of the ring. */
+static inline void mring_skip_upto(mring_t * nonnull r,
+                                   const void * nonnull p)
+{
+    mring_skip(r, (const char *)p - mring_data(r));
+}
+
+static inline void mring_reset(mring_t * nonnull r)
+{
+    r->rpos = 0;
+    r->len  = 0;
+}
+
+/** Append \p len bytes to the ring.
+ *
+ * \return -1 if there is not enough room.
+ */
+static inline int mring_add(mring_t * nonnull r, const void * nonnull data,
+                            uint32_t len)
+{
+    if (len > mring_avail(r)) {
+        return -1;
+    }
+    memcpy(mring_wptr(r), data, len);
+    r->len += len;
+    return 0;
+}
+
+/** Read from \p fd into the free space of the ring.
+ *
+ * \return the result of read(2), or -1 with errno set to ENOBUFS if the
+ *         ring is full.
+ */
+int mring_read(mring_t * nonnull r, int fd);
+
+#if __has_feature(nullability)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
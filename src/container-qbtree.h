@@ -0,0 +1,667 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_CONTAINER_QBTREE_H
+#define IS_LIB_COMMON_CONTAINER_QBTREE_H
+
+#include <lib-common/core.h>
+
+/** In-memory B+-trees.
+ *
+ * \section qbt_principles Principles
+ *
+ * A qbt is an ordered map of integer keys, for the ordered indexes that are
+ * too big for a \ref rb_tree_t: instead of one allocation per entry and
+ * about 2.log2(n) pointers chased per lookup, the entries are stored sorted
+ * in leaves of a few cache lines, and a lookup only goes through the inner
+ * nodes of the few levels of the tree (4 for 10M 64 bits keys).
+ *
+ * Each node holds QBT_NODE_KEYS_SIZE bytes of keys, and the unused slots
+ * are filled with the biggest key, so that the search in a node is a
+ * branchless count over all the keys of the node, that the compiler turns
+ * into SIMD comparisons. The leaves are linked, for the iterations, and
+ * the values are stored next to the keys, so they must be small (integers,
+ * pointers).
+ *
+ * \code
+ * qbt_k64_t(idx, uint32_t);
+ *
+ * qbt_t(idx) idx;
+ *
+ * qbt_init(idx, &idx);
+ * qbt_add(idx, &idx, 42, 1);
+ * qbt_for_each_range(idx, it, &idx, 10, 100) {
+ *     e_trace(0, "%ju: %u", qbt_it_key(&it), qbt_it_val(&it));
+ * }
+ * qbt_wipe(idx, &idx);
+ * \endcode
+ *
+ * The leaves emptied by the deletions are freed, but the nodes are not
+ * merged: the trees are meant for indexes that mostly grow. An index built
+ * from sorted data is best loaded at once with qbt_load_sorted(), which
+ * fills the nodes completely.
+ *
+ * The iterators are invalidated by any modification of the tree.
+ *
+ * More code examples into: lib-common/zchk-container.blk
+ */
+
+#define QBT_NODE_KEYS_SIZE  256
+#define QBT_MAX_DEPTH       16
+
+#define qbt_t(name)     qbt_##name##_t
+#define qbt_it_t(name)  qbt_##name##_it_t
+
+/*{{{1 Type */
+
+#define qbt_type_t(n, key_t, val_t)                                          \
+    enum {                                                                   \
+        qbt_##n##_cap = QBT_NODE_KEYS_SIZE / sizeof(key_t),                  \
+    };                                                                       \
+                                                                             \
+    typedef struct qbt_##n##_leaf_t {                                        \
+        key_t keys[qbt_##n##_cap];                                           \
+        val_t vals[qbt_##n##_cap];                                           \
+        struct qbt_##n##_leaf_t *prev;                                       \
+        struct qbt_##n##_leaf_t *next;                                       \
+        int len;                                                             \
+    } qbt_##n##_leaf_t;                                                      \
+                                                                             \
+    /* keys[i] is the lower bound of the keys of children[i + 1] */          \
+    typedef struct qbt_##n##_inner_t {                                       \
+        key_t keys[qbt_##n##_cap];                                           \
+        void *children[qbt_##n##_cap];                                       \
+        int len;                                                             \
+    } qbt_##n##_inner_t;                                                     \
+                                                                             \
+    typedef struct qbt_t(n) {                                                \
+        void *root;                                                          \
+        qbt_##n##_leaf_t *first;                                             \
+        qbt_##n##_leaf_t *last;                                              \
+        uint32_t len;                                                        \
+        uint16_t depth;                                                      \
+        uint32_t leaves;                                                     \
+        uint32_t inners;                                                     \
+    } qbt_t(n);                                                              \
+                                                                             \
+    typedef struct qbt_it_t(n) {                                             \
+        qbt_##n##_leaf_t *leaf;                                              \
+        int pos;                                                             \
+    } qbt_it_t(n);
+
+/*1}}}*/
+/*{{{1 Functions */
+
+/*{{{2 Nodes */
+
+#define __qbt_node_funcs_t(n, key_t, val_t, key_max)                         \
+    __unused__                                                               \
+    static inline qbt_##n##_leaf_t *__qbt_##n##_leaf_new(qbt_t(n) *t)        \
+    {                                                                        \
+        qbt_##n##_leaf_t *l;                                                 \
+                                                                             \
+        l = pa_new(qbt_##n##_leaf_t, 1, 64);                                 \
+        for (int i = 0; i < qbt_##n##_cap; i++) {                            \
+            l->keys[i] = key_max;                                            \
+        }                                                                    \
+        t->leaves++;                                                         \
+        return l;                                                            \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline qbt_##n##_inner_t *                                        \
+    __qbt_##n##_inner_new(qbt_t(n) *t)                                       \
+    {                                                                        \
+        qbt_##n##_inner_t *in;                                               \
+                                                                             \
+        in = pa_new(qbt_##n##_inner_t, 1, 64);                               \
+        for (int i = 0; i < qbt_##n##_cap; i++) {                            \
+            in->keys[i] = key_max;                                           \
+        }                                                                    \
+        t->inners++;                                                         \
+        return in;                                                           \
+    }                                                                        \
+                                                                             \
+    /* position of the first key >= k */                                     \
+    __unused__                                                               \
+    static ALWAYS_INLINE int                                                 \
+    __qbt_##n##_leaf_lower(const qbt_##n##_leaf_t *l, key_t k)               \
+    {                                                                        \
+        int pos = 0;                                                         \
+                                                                             \
+        for (int i = 0; i < qbt_##n##_cap; i++) {                            \
+            pos += l->keys[i] < k;                                           \
+        }                                                                    \
+        return pos;                                                          \
+    }                                                                        \
+                                                                             \
+    /* position of the child that may hold k */                              \
+    __unused__                                                               \
+    static ALWAYS_INLINE int                                                 \
+    __qbt_##n##_inner_child(const qbt_##n##_inner_t *in, key_t k)            \
+    {                                                                        \
+        int pos = 0;                                                         \
+                                                                             \
+        for (int i = 0; i < qbt_##n##_cap; i++) {                            \
+            pos += in->keys[i] <= k;                                         \
+        }                                                                    \
+        /* the padding counts when k is key_max */                           \
+        return MIN(pos, in->len - 1);                                        \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline qbt_##n##_leaf_t *                                         \
+    __qbt_##n##_leaf_of(const qbt_t(n) *t, key_t k)                          \
+    {                                                                        \
+        void *node = t->root;                                                \
+                                                                             \
+        for (int d = t->depth; d-- > 0; ) {                                  \
+            const qbt_##n##_inner_t *in = node;                              \
+                                                                             \
+            node = in->children[__qbt_##n##_inner_child(in, k)];             \
+        }                                                                    \
+        return node;                                                         \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static void __qbt_##n##_inner_wipe(qbt_t(n) *t, void *node, int d)       \
+    {                                                                        \
+        qbt_##n##_inner_t *in = node;                                        \
+                                                                             \
+        if (d > 1) {                                                         \
+            for (int i = 0; i < in->len; i++) {                              \
+                __qbt_##n##_inner_wipe(t, in->children[i], d - 1);           \
+            }                                                                \
+        }                                                                    \
+        p_delete(&in);                                                       \
+    }
+
+/*2}}}*/
+/*{{{2 Insertion */
+
+#define __qbt_insert_funcs_t(n, key_t, val_t, key_max)                       \
+    /* Inserts the separator sep and the node right after the child          \
+     * idx[d] of path[d], splitting the inner nodes up to the root as        \
+     * needed.                                                               \
+     */                                                                      \
+    __unused__                                                               \
+    static void                                                              \
+    __qbt_##n##_insert_parent(qbt_t(n) *t, qbt_##n##_inner_t **path,         \
+                              const int *idx, int d, key_t sep,              \
+                              void *right)                                   \
+    {                                                                        \
+        enum { cap = qbt_##n##_cap };                                        \
+        qbt_##n##_inner_t *root;                                             \
+                                                                             \
+        for (; d >= 0; d--) {                                                \
+            qbt_##n##_inner_t *in = path[d];                                 \
+            qbt_##n##_inner_t *r;                                            \
+            key_t keys[cap];                                                 \
+            void *children[cap + 1];                                         \
+            int at = idx[d] + 1;                                             \
+            int lc = (cap + 1) / 2;                                          \
+                                                                             \
+            if (in->len < cap) {                                             \
+                memmove(in->keys + at, in->keys + at - 1,                    \
+                        (in->len - at) * sizeof(key_t));                     \
+                memmove(in->children + at + 1, in->children + at,            \
+                        (in->len - at) * sizeof(void *));                    \
+                in->keys[at - 1] = sep;                                      \
+                in->children[at] = right;                                    \
+                in->len++;                                                   \
+                return;                                                      \
+            }                                                                \
+                                                                             \
+            /* full: split it in two, the middle key goes up */              \
+            memcpy(keys, in->keys, (at - 1) * sizeof(key_t));                \
+            keys[at - 1] = sep;                                              \
+            memcpy(keys + at, in->keys + at - 1,                             \
+                   (cap - at) * sizeof(key_t));                              \
+            memcpy(children, in->children, at * sizeof(void *));             \
+            children[at] = right;                                            \
+            memcpy(children + at + 1, in->children + at,                     \
+                   (cap - at) * sizeof(void *));                             \
+                                                                             \
+            r = __qbt_##n##_inner_new(t);                                    \
+            r->len = cap + 1 - lc;                                           \
+            memcpy(r->keys, keys + lc, (r->len - 1) * sizeof(key_t));        \
+            memcpy(r->children, children + lc, r->len * sizeof(void *));     \
+            in->len = lc;                                                    \
+            memcpy(in->keys, keys, (lc - 1) * sizeof(key_t));                \
+            memcpy(in->children, children, lc * sizeof(void *));             \
+            for (int i = lc - 1; i < cap; i++) {                             \
+                in->keys[i] = key_max;                                       \
+            }                                                                \
+            sep   = keys[lc - 1];                                            \
+            right = r;                                                       \
+        }                                                                    \
+                                                                             \
+        root = __qbt_##n##_inner_new(t);                                     \
+        root->keys[0]     = sep;                                             \
+        root->children[0] = t->root;                                         \
+        root->children[1] = right;                                           \
+        root->len = 2;                                                       \
+        t->root = root;                                                      \
+        t->depth++;                                                          \
+        assert (t->depth < QBT_MAX_DEPTH);                                   \
+    }                                                                        \
+                                                                             \
+    /* Splits the full leaf l to insert k at *pos, returns the leaf          \
+     * where k goes, and its position in it.                                 \
+     */                                                                      \
+    __unused__                                                               \
+    static qbt_##n##_leaf_t *                                                \
+    __qbt_##n##_split_leaf(qbt_t(n) *t, qbt_##n##_inner_t **path,            \
+                           const int *idx, qbt_##n##_leaf_t *l,              \
+                           key_t k, int *pos)                                \
+    {                                                                        \
+        enum { cap = qbt_##n##_cap };                                        \
+        qbt_##n##_leaf_t *r = __qbt_##n##_leaf_new(t);                       \
+        /* appending to the last leaf: keep it full, as for the              \
+         * insertions of increasing keys */                                  \
+        bool append = *pos == cap && !l->next;                               \
+        int keep = append ? cap : cap / 2;                                   \
+        key_t sep = append ? k : l->keys[keep];                              \
+                                                                             \
+        r->len = cap - keep;                                                 \
+        memcpy(r->keys, l->keys + keep, r->len * sizeof(key_t));             \
+        memcpy(r->vals, l->vals + keep, r->len * sizeof(val_t));             \
+        for (int i = keep; i < cap; i++) {                                   \
+            l->keys[i] = key_max;                                            \
+        }                                                                    \
+        l->len = keep;                                                       \
+                                                                             \
+        r->prev = l;                                                         \
+        r->next = l->next;                                                   \
+        if (l->next) {                                                       \
+            l->next->prev = r;                                               \
+        } else {                                                             \
+            t->last = r;                                                     \
+        }                                                                    \
+        l->next = r;                                                         \
+        __qbt_##n##_insert_parent(t, path, idx, t->depth - 1, sep, r);       \
+                                                                             \
+        if (append || *pos > keep) {                                         \
+            *pos -= keep;                                                    \
+            return r;                                                        \
+        }                                                                    \
+        return l;                                                            \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline val_t *                                                    \
+    qbt_##n##_reserve(qbt_t(n) *t, key_t k, bool *found)                     \
+    {                                                                        \
+        qbt_##n##_inner_t *path[QBT_MAX_DEPTH];                              \
+        int idx[QBT_MAX_DEPTH];                                              \
+        qbt_##n##_leaf_t *l;                                                 \
+        void *node;                                                          \
+        int pos;                                                             \
+                                                                             \
+        if (unlikely(!t->root)) {                                            \
+            t->root = t->first = t->last = __qbt_##n##_leaf_new(t);          \
+        }                                                                    \
+        node = t->root;                                                      \
+        for (int d = 0; d < t->depth; d++) {                                 \
+            path[d] = node;                                                  \
+            idx[d]  = __qbt_##n##_inner_child(path[d], k);                   \
+            node    = path[d]->children[idx[d]];                             \
+        }                                                                    \
+        l = node;                                                            \
+        pos = __qbt_##n##_leaf_lower(l, k);                                  \
+        if (pos < l->len && l->keys[pos] == k) {                             \
+            *found = true;                                                   \
+            return &l->vals[pos];                                            \
+        }                                                                    \
+                                                                             \
+        *found = false;                                                      \
+        t->len++;                                                            \
+        if (unlikely(l->len == qbt_##n##_cap)) {                             \
+            l = __qbt_##n##_split_leaf(t, path, idx, l, k, &pos);            \
+        }                                                                    \
+        memmove(l->keys + pos + 1, l->keys + pos,                            \
+                (l->len - pos) * sizeof(key_t));                             \
+        memmove(l->vals + pos + 1, l->vals + pos,                            \
+                (l->len - pos) * sizeof(val_t));                             \
+        l->keys[pos] = k;                                                    \
+        l->len++;                                                            \
+        return &l->vals[pos];                                                \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline int qbt_##n##_add(qbt_t(n) *t, key_t k, val_t v)           \
+    {                                                                        \
+        bool found;                                                          \
+        val_t *slot = qbt_##n##_reserve(t, k, &found);                       \
+                                                                             \
+        if (found) {                                                         \
+            return -1;                                                       \
+        }                                                                    \
+        *slot = v;                                                           \
+        return 0;                                                            \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline bool qbt_##n##_replace(qbt_t(n) *t, key_t k, val_t v)      \
+    {                                                                        \
+        bool found;                                                          \
+                                                                             \
+        *qbt_##n##_reserve(t, k, &found) = v;                                \
+        return found;                                                        \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline void                                                       \
+    qbt_##n##_load_sorted(qbt_t(n) *t, const key_t *keys,                    \
+                          const val_t *vals, int len)                        \
+    {                                                                        \
+        enum { cap = qbt_##n##_cap };                                        \
+        qbt_##n##_leaf_t *prev = NULL;                                       \
+        void **nodes;                                                        \
+        key_t *mins;                                                         \
+        int nb;                                                              \
+                                                                             \
+        assert (!t->root);                                                   \
+        if (len <= 0) {                                                      \
+            return;                                                          \
+        }                                                                    \
+        nb    = DIV_ROUND_UP(len, cap);                                      \
+        nodes = p_new_raw(void *, nb);                                       \
+        mins  = p_new_raw(key_t, nb);                                        \
+                                                                             \
+        for (int i = 0, pos = 0; i < nb; i++) {                              \
+            qbt_##n##_leaf_t *l = __qbt_##n##_leaf_new(t);                   \
+                                                                             \
+            l->len = len / nb + (i < len % nb);                              \
+            for (int j = pos; j < pos + l->len; j++) {                       \
+                assert (j == 0 || keys[j - 1] < keys[j]);                    \
+                l->keys[j - pos] = keys[j];                                  \
+            }                                                                \
+            memcpy(l->vals, vals + pos, l->len * sizeof(val_t));             \
+            pos += l->len;                                                   \
+            l->prev = prev;                                                  \
+            if (prev) {                                                      \
+                prev->next = l;                                              \
+            } else {                                                         \
+                t->first = l;                                                \
+            }                                                                \
+            prev     = l;                                                    \
+            nodes[i] = l;                                                    \
+            mins[i]  = l->keys[0];                                           \
+        }                                                                    \
+        t->last = prev;                                                      \
+        t->len  = len;                                                       \
+                                                                             \
+        while (nb > 1) {                                                     \
+            int nb_up = DIV_ROUND_UP(nb, cap);                               \
+                                                                             \
+            for (int i = 0, pos = 0; i < nb_up; i++) {                       \
+                qbt_##n##_inner_t *in = __qbt_##n##_inner_new(t);            \
+                                                                             \
+                in->len = nb / nb_up + (i < nb % nb_up);                     \
+                for (int j = 0; j < in->len; j++) {                          \
+                    in->children[j] = nodes[pos + j];                        \
+                    if (j) {                                                 \
+                        in->keys[j - 1] = mins[pos + j];                     \
+                    }                                                        \
+                }                                                            \
+                nodes[i] = in;                                               \
+                mins[i]  = mins[pos];                                        \
+                pos += in->len;                                              \
+            }                                                                \
+            nb = nb_up;                                                      \
+            t->depth++;                                                      \
+        }                                                                    \
+        t->root = nodes[0];                                                  \
+        p_delete(&nodes);                                                    \
+        p_delete(&mins);                                                     \
+    }
+
+/*2}}}*/
+/*{{{2 Lookup, deletion, iteration */
+
+#define __qbt_lookup_funcs_t(n, key_t, val_t, key_max)                       \
+    __unused__                                                               \
+    static inline val_t *qbt_##n##_find(const qbt_t(n) *t, key_t k)          \
+    {                                                                        \
+        qbt_##n##_leaf_t *l;                                                 \
+        int pos;                                                             \
+                                                                             \
+        if (unlikely(!t->root)) {                                            \
+            return NULL;                                                     \
+        }                                                                    \
+        l = __qbt_##n##_leaf_of(t, k);                                       \
+        pos = __qbt_##n##_leaf_lower(l, k);                                  \
+        return pos < l->len && l->keys[pos] == k ? &l->vals[pos] : NULL;     \
+    }                                                                        \
+                                                                             \
+    /* Removes the child idx[d] of path[d], and the inner nodes that         \
+     * get empty.                                                            \
+     */                                                                      \
+    __unused__                                                               \
+    static void                                                              \
+    __qbt_##n##_remove_child(qbt_t(n) *t, qbt_##n##_inner_t **path,          \
+                             const int *idx, int d)                          \
+    {                                                                        \
+        for (; d >= 0; d--) {                                                \
+            qbt_##n##_inner_t *in = path[d];                                 \
+            int at = idx[d];                                                 \
+            int k_at = MAX(at - 1, 0);                                       \
+                                                                             \
+            if (in->len > 1) {                                               \
+                memmove(in->keys + k_at, in->keys + k_at + 1,                \
+                        (in->len - 2 - k_at) * sizeof(key_t));               \
+                memmove(in->children + at, in->children + at + 1,            \
+                        (in->len - 1 - at) * sizeof(void *));                \
+                in->len--;                                                   \
+                in->keys[in->len - 1] = key_max;                             \
+                break;                                                       \
+            }                                                                \
+            p_delete(&path[d]);                                              \
+            t->inners--;                                                     \
+        }                                                                    \
+        if (d < 0) {                                                         \
+            t->root  = NULL;                                                 \
+            t->depth = 0;                                                    \
+            return;                                                          \
+        }                                                                    \
+                                                                             \
+        /* collapse the root while it has a single child */                  \
+        while (t->depth > 0) {                                               \
+            qbt_##n##_inner_t *root = t->root;                               \
+                                                                             \
+            if (root->len > 1) {                                             \
+                break;                                                       \
+            }                                                                \
+            t->root = root->children[0];                                     \
+            t->depth--;                                                      \
+            p_delete(&root);                                                 \
+            t->inners--;                                                     \
+        }                                                                    \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline int                                                        \
+    qbt_##n##_del_key(qbt_t(n) *t, key_t k, val_t *out)                      \
+    {                                                                        \
+        qbt_##n##_inner_t *path[QBT_MAX_DEPTH];                              \
+        int idx[QBT_MAX_DEPTH];                                              \
+        qbt_##n##_leaf_t *l;                                                 \
+        void *node = t->root;                                                \
+        int pos;                                                             \
+                                                                             \
+        if (unlikely(!node)) {                                               \
+            return -1;                                                       \
+        }                                                                    \
+        for (int d = 0; d < t->depth; d++) {                                 \
+            path[d] = node;                                                  \
+            idx[d]  = __qbt_##n##_inner_child(path[d], k);                   \
+            node    = path[d]->children[idx[d]];                             \
+        }                                                                    \
+        l = node;                                                            \
+        pos = __qbt_##n##_leaf_lower(l, k);                                  \
+        if (pos >= l->len || l->keys[pos] != k) {                            \
+            return -1;                                                       \
+        }                                                                    \
+        if (out) {                                                           \
+            *out = l->vals[pos];                                             \
+        }                                                                    \
+        l->len--;                                                            \
+        memmove(l->keys + pos, l->keys + pos + 1,                            \
+                (l->len - pos) * sizeof(key_t));                             \
+        memmove(l->vals + pos, l->vals + pos + 1,                            \
+                (l->len - pos) * sizeof(val_t));                             \
+        l->keys[l->len] = key_max;                                           \
+        t->len--;                                                            \
+                                                                             \
+        if (l->len == 0) {                                                   \
+            if (l->prev) {                                                   \
+                l->prev->next = l->next;                                     \
+            } else {                                                         \
+                t->first = l->next;                                          \
+            }                                                                \
+            if (l->next) {                                                   \
+                l->next->prev = l->prev;                                     \
+            } else {                                                         \
+                t->last = l->prev;                                           \
+            }                                                                \
+            p_delete(&l);                                                    \
+            t->leaves--;                                                     \
+            __qbt_##n##_remove_child(t, path, idx, t->depth - 1);            \
+        }                                                                    \
+        return 0;                                                            \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline void qbt_##n##_wipe(qbt_t(n) *t)                           \
+    {                                                                        \
+        for (qbt_##n##_leaf_t *l = t->first, *next; l; l = next) {           \
+            next = l->next;                                                  \
+            p_delete(&l);                                                    \
+        }                                                                    \
+        if (t->depth) {                                                      \
+            __qbt_##n##_inner_wipe(t, t->root, t->depth);                    \
+        }                                                                    \
+        p_clear(t, 1);                                                       \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline qbt_it_t(n) qbt_##n##_first(const qbt_t(n) *t)             \
+    {                                                                        \
+        return (qbt_it_t(n)){ .leaf = t->first };                            \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline qbt_it_t(n)                                                \
+    qbt_##n##_lower_bound(const qbt_t(n) *t, key_t k)                        \
+    {                                                                        \
+        qbt_##n##_leaf_t *l;                                                 \
+        int pos;                                                             \
+                                                                             \
+        if (unlikely(!t->root)) {                                            \
+            return (qbt_it_t(n)){ .leaf = NULL };                            \
+        }                                                                    \
+        l = __qbt_##n##_leaf_of(t, k);                                       \
+        pos = __qbt_##n##_leaf_lower(l, k);                                  \
+        if (pos == l->len) {                                                 \
+            /* the leaves are never empty */                                 \
+            return (qbt_it_t(n)){ .leaf = l->next };                         \
+        }                                                                    \
+        return (qbt_it_t(n)){ .leaf = l, .pos = pos };                       \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static ALWAYS_INLINE void qbt_##n##_it_next(qbt_it_t(n) *it)             \
+    {                                                                        \
+        if (++it->pos >= it->leaf->len) {                                    \
+            it->leaf = it->leaf->next;                                       \
+            it->pos  = 0;                                                    \
+        }                                                                    \
+    }
+
+/*2}}}*/
+
+#define qbt_funcs_t(n, key_t, val_t, key_max)                                \
+    __qbt_node_funcs_t(n, key_t, val_t, key_max)                             \
+    __qbt_insert_funcs_t(n, key_t, val_t, key_max)                           \
+    __qbt_lookup_funcs_t(n, key_t, val_t, key_max)
+
+/*1}}}*/
+/*{{{1 API */
+
+/** Declare a B+-tree of integer keys.
+ *
+ * \param[in] key_max  the biggest value of key_t.
+ */
+#define qbt_kint_t(name, key_t, val_t, key_max)                              \
+    qbt_type_t(name, key_t, val_t);                                          \
+    qbt_funcs_t(name, key_t, val_t, key_max)
+
+#define qbt_k32_t(name, val_t)  qbt_kint_t(name, uint32_t, val_t, UINT32_MAX)
+#define qbt_k64_t(name, val_t)  qbt_kint_t(name, uint64_t, val_t, UINT64_MAX)
+
+#define qbt_init(n, t)                 p_clear(t, 1)
+#define qbt_wipe(n, t)                 qbt_##n##_wipe(t)
+#define qbt_clear(n, t)                qbt_##n##_wipe(t)
+#define qbt_len(n, t)                  ((t)->len)
+#define qbt_depth(n, t)                ((t)->depth)
+#define qbt_memory_footprint(n, t)                                           \
+    ((size_t)(t)->leaves * sizeof(qbt_##n##_leaf_t)                          \
+   + (size_t)(t)->inners * sizeof(qbt_##n##_inner_t))
+
+/** Get a pointer on the value of \p k, NULL if absent. */
+#define qbt_find(n, t, k)              qbt_##n##_find(t, k)
+#define qbt_get_def(n, t, k, def)                                            \
+    ({ typeof(*qbt_find(n, t, k)) *__v = qbt_find(n, t, k);                  \
+       __v ? *__v : (def); })
+
+/** Get the slot of the value of \p k, inserting \p k if absent (the value
+ * is then left uninitialized and *found set to false).
+ */
+#define qbt_reserve(n, t, k, found)    qbt_##n##_reserve(t, k, found)
+/** Insert \p k if absent, returns -1 if it was already there. */
+#define qbt_add(n, t, k, v)            qbt_##n##_add(t, k, v)
+/** Set the value of \p k, returns true if it was already there. */
+#define qbt_replace(n, t, k, v)        qbt_##n##_replace(t, k, v)
+/** Remove \p k, returns -1 if absent. The value is put in \p out if set. */
+#define qbt_del_key(n, t, k, out)      qbt_##n##_del_key(t, k, out)
+
+/** Load \p len entries, of strictly increasing keys, in an empty tree. */
+#define qbt_load_sorted(n, t, keys, vals, len)                               \
+    qbt_##n##_load_sorted(t, keys, vals, len)
+
+#define qbt_first(n, t)                qbt_##n##_first(t)
+/** Iterator on the first key >= \p k. */
+#define qbt_lower_bound(n, t, k)       qbt_##n##_lower_bound(t, k)
+#define qbt_it_ok(it)                  ((it)->leaf != NULL)
+#define qbt_it_next(n, it)             qbt_##n##_it_next(it)
+#define qbt_it_key(it)                 ((it)->leaf->keys[(it)->pos])
+#define qbt_it_val(it)                 ((it)->leaf->vals[(it)->pos])
+
+#define qbt_for_each(n, it, t)                                               \
+    for (qbt_it_t(n) it = qbt_first(n, t); qbt_it_ok(&it);                   \
+         qbt_it_next(n, &it))
+
+/** Iterate on the keys in [from, to). */
+#define qbt_for_each_range(n, it, t, from, to)                               \
+    for (qbt_it_t(n) it = qbt_lower_bound(n, t, from);                       \
+         qbt_it_ok(&it) && qbt_it_key(&it) < (to); qbt_it_next(n, &it))
+
+/*1}}}*/
+
+#endif
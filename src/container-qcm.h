@@ -0,0 +1,386 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_CONTAINER_QCM_H
+#define IS_LIB_COMMON_CONTAINER_QCM_H
+
+#include <lib-common/container-qhash.h>
+#include <lib-common/thr.h>
+
+/*
+ * QCMs: concurrent hash maps.
+ *
+ * This implements a wrapper around the qm that can be shared by several
+ * threads, for the caches that are filled by some threads and read by all
+ * the others.
+ *
+ * The map is split in a fixed number of shards, a parameter of the type,
+ * that are plain qm protected by a spinlock, so that the writers of
+ * different shards don't contend. The key of an entry selects its shard with
+ * the high bits of its mixed hash, the qm of the shard uses the low ones.
+ *
+ * The lookups in the maps with integer or hashed pointer keys don't take the
+ * lock: each shard has a sequence counter that the writers make odd while
+ * they modify the shard, a reader copies the qm header and looks the key up
+ * in the copy, and retries if the counter moved meanwhile. The qm of the
+ * shards allocate with mem_pool_epoch, and the readers look up in an epoch
+ * critical section, so that the blocks of the copy stay readable even when
+ * a concurrent writer frees or reallocates them. After QCM_READ_TRIES
+ * failed attempts, because of a busy writer, the reader takes the lock.
+ * The lookups in the maps whose keys are vectors or pointers always take the
+ * lock: a torn key could not be compared safely.
+ *
+ * The values are copied out of the map: a value that points to an object
+ * shared by the threads must be protected in another way, for example by
+ * retiring the object with thr_epoch_retire() once it is removed from the
+ * map.
+ *
+ * The memory of a wiped or cleared map is freed by the next epoch
+ * collections, use thr_epoch_synchronize() to wait for it.
+ */
+
+/* {{{ Shards */
+
+/* Optimistic lookups attempts before taking the lock of the shard. */
+#define QCM_READ_TRIES  4
+
+typedef struct qcm_shard_hdr_t {
+    atomic_uint32_t seq;
+    spinlock_t      lock;
+} qcm_shard_hdr_t;
+
+static ALWAYS_INLINE uint32_t qcm_shard_id(uint32_t h, uint32_t count)
+{
+    return ((uint64_t)(uint32_t)(h * 0x9e3779b1U) * count) >> 32;
+}
+
+static ALWAYS_INLINE void qcm_shard_write_begin(qcm_shard_hdr_t *hdr)
+{
+    spin_lock(&hdr->lock);
+    atomic_store_explicit(&hdr->seq,
+                          atomic_load_explicit(&hdr->seq,
+                                               memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    /* the odd counter must be visible before any change of the shard */
+    atomic_thread_fence(memory_order_release);
+}
+
+static ALWAYS_INLINE void qcm_shard_write_end(qcm_shard_hdr_t *hdr)
+{
+    atomic_store_explicit(&hdr->seq,
+                          atomic_load_explicit(&hdr->seq,
+                                               memory_order_relaxed) + 1,
+                          memory_order_release);
+    spin_unlock(&hdr->lock);
+}
+
+/** Start an optimistic read of a shard, returns false if a writer is
+ * modifying it. */
+static ALWAYS_INLINE bool
+qcm_shard_read_begin(qcm_shard_hdr_t *hdr, uint32_t *seq)
+{
+    *seq = atomic_load_explicit(&hdr->seq, memory_order_acquire);
+    return !(*seq & 1);
+}
+
+/** Returns true if what was read since qcm_shard_read_begin() is
+ * consistent. */
+static ALWAYS_INLINE bool qcm_shard_read_end(qcm_shard_hdr_t *hdr,
+                                             uint32_t seq)
+{
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&hdr->seq, memory_order_relaxed) == seq;
+}
+
+/* }}} */
+/* {{{ Base macros */
+
+#define __QCM_BASE(pfx, qmpfx, shard_count, ckey_t, pkey_t, skey_t, val_t,   \
+                   optimistic)                                               \
+    typedef struct pfx##_shard_t {                                           \
+        qcm_shard_hdr_t hdr;                                                 \
+        qmpfx##_t qm;                                                        \
+    } __attribute__((aligned(CACHE_LINE_SIZE))) pfx##_shard_t;               \
+    typedef struct pfx##_t {                                                 \
+        pfx##_shard_t shards[shard_count];                                   \
+    } pfx##_t;                                                               \
+                                                                             \
+    __unused__                                                               \
+    static inline pfx##_t *pfx##_init(pfx##_t *qcm)                          \
+    {                                                                        \
+        for (int it = 0; it < countof(qcm->shards); it++) {                  \
+            p_clear(&qcm->shards[it].hdr, 1);                                \
+            qmpfx##_init(&qcm->shards[it].qm, false, &mem_pool_epoch);       \
+        }                                                                    \
+        return qcm;                                                          \
+    }                                                                        \
+                                                                             \
+    /* no thread must use the map anymore */                                 \
+    __unused__                                                               \
+    static inline void pfx##_wipe(pfx##_t *qcm)                              \
+    {                                                                        \
+        for (int it = 0; it < countof(qcm->shards); it++) {                  \
+            qhash_wipe(&qcm->shards[it].qm.qh);                              \
+        }                                                                    \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline void pfx##_clear(pfx##_t *qcm)                             \
+    {                                                                        \
+        for (int it = 0; it < countof(qcm->shards); it++) {                  \
+            pfx##_shard_t *shard = &qcm->shards[it];                         \
+                                                                             \
+            qcm_shard_write_begin(&shard->hdr);                              \
+            qhash_clear(&shard->qm.qh);                                      \
+            qcm_shard_write_end(&shard->hdr);                                \
+        }                                                                    \
+    }                                                                        \
+                                                                             \
+    /* the length is approximate when the map is modified concurrently */    \
+    __unused__                                                               \
+    static inline uint64_t pfx##_len(pfx##_t *qcm)                           \
+    {                                                                        \
+        uint64_t len = 0;                                                    \
+                                                                             \
+        for (int it = 0; it < countof(qcm->shards); it++) {                  \
+            len += *(volatile uint32_t *)&qcm->shards[it].qm.qh.hdr.len;     \
+        }                                                                    \
+        return len;                                                          \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline size_t pfx##_memory_footprint(pfx##_t *qcm)                \
+    {                                                                        \
+        size_t size = 0;                                                     \
+                                                                             \
+        for (int it = 0; it < countof(qcm->shards); it++) {                  \
+            pfx##_shard_t *shard = &qcm->shards[it];                         \
+                                                                             \
+            spin_lock(&shard->hdr.lock);                                     \
+            size += qhash_memory_footprint(&shard->qm.qh);                   \
+            spin_unlock(&shard->hdr.lock);                                   \
+        }                                                                    \
+        return size;                                                         \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline uint32_t pfx##_hash(const pfx##_t *qcm, ckey_t key)        \
+    {                                                                        \
+        return qmpfx##_hash(&qcm->shards[0].qm, key);                        \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline pfx##_shard_t *pfx##_shard(pfx##_t *qcm, uint32_t h)       \
+    {                                                                        \
+        return &qcm->shards[qcm_shard_id(h, countof(qcm->shards))];          \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline bool pfx##_get_h(pfx##_t *qcm, uint32_t h, ckey_t key,     \
+                                   val_t *out)                               \
+    {                                                                        \
+        pfx##_shard_t *shard = pfx##_shard(qcm, h);                          \
+        int32_t pos;                                                         \
+                                                                             \
+        if (optimistic) {                                                    \
+            thr_epoch_enter();                                               \
+            for (int i = 0; i < QCM_READ_TRIES; i++) {                       \
+                qmpfx##_t qm;                                                \
+                val_t v;                                                     \
+                uint32_t seq;                                                \
+                                                                             \
+                if (!qcm_shard_read_begin(&shard->hdr, &seq)) {              \
+                    cpu_relax();                                             \
+                    continue;                                                \
+                }                                                            \
+                memcpy(&qm, &shard->qm, sizeof(qm));                         \
+                if (!qcm_shard_read_end(&shard->hdr, seq)) {                 \
+                    continue;                                                \
+                }                                                            \
+                pos = qmpfx##_find_safe_int(&qm, &h, key);                   \
+                if (pos >= 0) {                                              \
+                    memcpy(&v, &qm.values[pos], sizeof(v));                  \
+                }                                                            \
+                if (qcm_shard_read_end(&shard->hdr, seq)) {                  \
+                    thr_epoch_leave();                                       \
+                    if (pos < 0) {                                           \
+                        return false;                                        \
+                    }                                                        \
+                    *out = v;                                                \
+                    return true;                                             \
+                }                                                            \
+            }                                                                \
+            thr_epoch_leave();                                               \
+        }                                                                    \
+                                                                             \
+        spin_lock(&shard->hdr.lock);                                         \
+        pos = qmpfx##_find_safe_int(&shard->qm, &h, key);                    \
+        if (pos >= 0) {                                                      \
+            *out = shard->qm.values[pos];                                    \
+        }                                                                    \
+        spin_unlock(&shard->hdr.lock);                                       \
+        return pos >= 0;                                                     \
+    }                                                                        \
+    __unused__                                                               \
+    static inline bool pfx##_get(pfx##_t *qcm, ckey_t key, val_t *out)       \
+    {                                                                        \
+        return pfx##_get_h(qcm, pfx##_hash(qcm, key), key, out);             \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline int pfx##_put_h(pfx##_t *qcm, uint32_t h, pkey_t key,      \
+                                  val_t v, uint32_t fl)                      \
+    {                                                                        \
+        pfx##_shard_t *shard = pfx##_shard(qcm, h);                          \
+        uint32_t pos;                                                        \
+                                                                             \
+        qcm_shard_write_begin(&shard->hdr);                                  \
+        pos = qmpfx##_reserve_int(&shard->qm, &h, key, fl);                  \
+        if ((fl & QHASH_OVERWRITE) || !(pos & QHASH_COLLISION)) {            \
+            shard->qm.values[pos & ~QHASH_COLLISION] = v;                    \
+        }                                                                    \
+        qcm_shard_write_end(&shard->hdr);                                    \
+        return (int)pos >> 31;                                               \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline int pfx##_add_h(pfx##_t *qcm, uint32_t h, pkey_t key,      \
+                                  val_t v)                                   \
+    {                                                                        \
+        return pfx##_put_h(qcm, h, key, v, 0);                               \
+    }                                                                        \
+    __unused__                                                               \
+    static inline int pfx##_add(pfx##_t *qcm, pkey_t key, val_t v)           \
+    {                                                                        \
+        return pfx##_add_h(qcm, pfx##_hash(qcm, key), key, v);               \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline int pfx##_replace_h(pfx##_t *qcm, uint32_t h, pkey_t key,  \
+                                      val_t v)                               \
+    {                                                                        \
+        return pfx##_put_h(qcm, h, key, v, QHASH_OVERWRITE);                 \
+    }                                                                        \
+    __unused__                                                               \
+    static inline int pfx##_replace(pfx##_t *qcm, pkey_t key, val_t v)       \
+    {                                                                        \
+        return pfx##_replace_h(qcm, pfx##_hash(qcm, key), key, v);           \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline int pfx##_del_key_h(pfx##_t *qcm, uint32_t h, ckey_t key,  \
+                                      skey_t *okey, val_t *ov)               \
+    {                                                                        \
+        pfx##_shard_t *shard = pfx##_shard(qcm, h);                          \
+        int32_t pos;                                                         \
+                                                                             \
+        qcm_shard_write_begin(&shard->hdr);                                  \
+        pos = qmpfx##_find_int(&shard->qm, &h, key);                         \
+        if (pos >= 0) {                                                      \
+            if (okey) {                                                      \
+                *okey = shard->qm.keys[pos];                                 \
+            }                                                                \
+            if (ov) {                                                        \
+                *ov = shard->qm.values[pos];                                 \
+            }                                                                \
+            qhash_del_at(&shard->qm.qh, pos);                                \
+        }                                                                    \
+        qcm_shard_write_end(&shard->hdr);                                    \
+        return pos < 0 ? -1 : 0;                                             \
+    }                                                                        \
+    __unused__                                                               \
+    static inline int pfx##_del_key(pfx##_t *qcm, ckey_t key, skey_t *okey,  \
+                                    val_t *ov)                               \
+    {                                                                        \
+        return pfx##_del_key_h(qcm, pfx##_hash(qcm, key), key, okey, ov);    \
+    }
+
+/* }}} */
+/* {{{ QCM API */
+
+#define qcm_k32_t(name, shard_count, val_t)                                  \
+    qm_k32_t(qcm_##name, val_t);                                             \
+    __QCM_BASE(qcm_##name, qm_qcm_##name, shard_count, uint32_t const,       \
+               uint32_t, uint32_t, val_t, true)
+#define qcm_k64_t(name, shard_count, val_t)                                  \
+    qm_k64_t(qcm_##name, val_t);                                             \
+    __QCM_BASE(qcm_##name, qm_qcm_##name, shard_count, uint64_t const,       \
+               uint64_t, uint64_t, val_t, true)
+#define qcm_khptr_t(name, shard_count, key_t, val_t)                         \
+    qm_khptr_t(qcm_##name, key_t, val_t);                                    \
+    __QCM_BASE(qcm_##name, qm_qcm_##name, shard_count, key_t const *,        \
+               key_t *, key_t *, val_t, true)
+#define qcm_khptr_ckey_t(name, shard_count, key_t, val_t)                    \
+    qm_khptr_ckey_t(qcm_##name, key_t, val_t);                               \
+    __QCM_BASE(qcm_##name, qm_qcm_##name, shard_count, key_t const *,        \
+               key_t const *, key_t const *, val_t, true)
+#define qcm_kvec_t(name, shard_count, key_t, val_t, hf, ef)                  \
+    qm_kvec_t(qcm_##name, key_t, val_t, hf, ef);                             \
+    __QCM_BASE(qcm_##name, qm_qcm_##name, shard_count, key_t const *,        \
+               key_t const *, key_t, val_t, false)
+#define qcm_kptr_t(name, shard_count, key_t, val_t, hf, ef)                  \
+    qm_kptr_t(qcm_##name, key_t, val_t, hf, ef);                             \
+    __QCM_BASE(qcm_##name, qm_qcm_##name, shard_count, key_t const *,        \
+               key_t *, key_t *, val_t, false)
+#define qcm_kptr_ckey_t(name, shard_count, key_t, val_t, hf, ef)             \
+    qm_kptr_ckey_t(qcm_##name, key_t, val_t, hf, ef);                        \
+    __QCM_BASE(qcm_##name, qm_qcm_##name, shard_count, key_t const *,        \
+               key_t const *, key_t const *, val_t, false)
+
+#define qcm_t(name)  qcm_##name##_t
+#define qcm_fn(name, fname)                 qcm_##name##_##fname
+
+/** Initialize a concurrent map.
+ *
+ * The map must be allocated aligned on CACHE_LINE_SIZE (static variable, or
+ * mpa_new() with that alignment) so that its shards don't share any cache
+ * line.
+ */
+#define qcm_init(name, qcm)                 qcm_##name##_init(qcm)
+#define qcm_wipe(name, qcm)                 qcm_##name##_wipe(qcm)
+#define qcm_clear(name, qcm)                qcm_##name##_clear(qcm)
+#define qcm_len(name, qcm)                  qcm_##name##_len(qcm)
+#define qcm_memory_footprint(name, qcm)     qcm_##name##_memory_footprint(qcm)
+#define qcm_hash(name, qcm, key)            qcm_##name##_hash(qcm, key)
+
+/** Copy the value of \p key in \p out, returns false if it is absent. */
+#define qcm_get(name, qcm, key, out)        qcm_##name##_get(qcm, key, out)
+#define qcm_get_h(name, qcm, h, key, out)                                    \
+    qcm_##name##_get_h(qcm, h, key, out)
+
+/** Same return values as qm_add() and qm_replace(). */
+#define qcm_add(name, qcm, key, v)          qcm_##name##_add(qcm, key, v)
+#define qcm_add_h(name, qcm, h, key, v)     qcm_##name##_add_h(qcm, h, key, v)
+#define qcm_replace(name, qcm, key, v)      qcm_##name##_replace(qcm, key, v)
+#define qcm_replace_h(name, qcm, h, key, v)                                  \
+    qcm_##name##_replace_h(qcm, h, key, v)
+
+/** Remove \p key from the map.
+ *
+ * The removed key and value are copied in \p okey and \p ov when they are
+ * not NULL.
+ *
+ * \return 0 if the key was removed, -1 if it was absent.
+ */
+#define qcm_del_key(name, qcm, key, okey, ov)                                \
+    qcm_##name##_del_key(qcm, key, okey, ov)
+#define qcm_del_key_h(name, qcm, h, key, okey, ov)                           \
+    qcm_##name##_del_key_h(qcm, h, key, okey, ov)
+
+/* }}} */
+#endif
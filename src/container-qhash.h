@@ -64,6 +64,49 @@
  *   but we assume that collision chains are usually short due to our double
  *   hashing.
  *
+ *
+ * Swiss tables
+ *
+ *   The *_swiss_t declarations (qm_k64_swiss_t, qh_kvec_swiss_t, ...) have
+ *   the same API and the same keys/values arrays indexed by position, but
+ *   use another layout, chosen by the first insertion:
+ *    - hdr.bits points to one control byte per slot: QHASH_SWISS_EMPTY,
+ *      QHASH_SWISS_DELETED, or the 7 bits of the hash not used to choose
+ *      the slot when it is set;
+ *    - the size is a power of 2, and the slots are probed by groups of 16
+ *      control bytes, each group being matched at once with SSE2, so that a
+ *      lookup seldom touches more than one cache line of control bytes and
+ *      almost never compares a key that is not the searched one;
+ *    - the table is filled up to 7/8 before it grows.
+ *
+ *   There is no "real time" resize though: the table is rehashed at once
+ *   when it grows and qh->old is always NULL. They are meant for the big
+ *   maps with a lot of lookups, not for the ones where a latency spike at
+ *   resize is a concern.
+ *
+ *
+ * Compact tables
+ *
+ *   The *_compact_t declarations (qm_kvec_compact_t, qh_k64_compact_t, ...)
+ *   have the same API too, but the keys, values and hashes arrays are dense
+ *   and in insertion order, like the dictionaries of Python:
+ *    - hdr.bits points to the bitmap of the live entries, followed by an
+ *      index of hdr.size 32 bits slots, the size being a power of 2. A set
+ *      slot holds the position of its entry in the dense arrays in its low
+ *      bits, and some bits of the hash of the entry in its high bits, so
+ *      that a lookup touches one slot and almost only the searched key;
+ *    - the dense arrays grow by steps of 1.33 or 1.5, independently of the
+ *      index, so that an entry costs 1 to 1.5 times its key, value and hash
+ *      plus 5 to 11 bytes of index, instead of the 1.5 to 4 slots of keys
+ *      and values of the other tables;
+ *    - the hashes are always cached, so that the deletions and the rebuilds
+ *      of the index never hash the keys again;
+ *    - the enumerations only scan the dense arrays, in insertion order.
+ *
+ *   A deleted entry leaves a hole in the dense arrays until the next rebuild
+ *   of the index, which packs the entries and thus changes their positions,
+ *   and which happens when the index grows or is 3/4th full, or when the
+ *   table is sealed. Like the swiss ones, they have no "real time" resize.
  */
 
 #define QHASH_COLLISION     (1U << 31)
@@ -94,6 +137,8 @@ typedef struct qhash_hdr_t {
         uint8_t      k_size;                                                 \
         uint16_t     v_size;                                                 \
         uint32_t     minsize;                                                \
+        bool         swiss;                                                  \
+        bool         compact;                                                \
     }
 
 /* uint8_t allow us to use pointer arith on ->{values,vec} */
@@ -124,6 +169,17 @@ void qhash_unseal(qhash_t * nonnull qh)
     __leaf;
 void qhash_wipe(qhash_t * nonnull qh)
     __leaf;
+void qhash_swiss_del_at(qhash_t * nonnull qh, uint32_t pos)
+    __leaf;
+void qhash_compact_del_at(qhash_t * nonnull qh, uint32_t pos)
+    __leaf;
+
+#define QHASH_SWISS_EMPTY    0x80
+#define QHASH_SWISS_DELETED  0xfe
+#define QHASH_SWISS_GROUP    16
+
+#define QHASH_COMPACT_EMPTY    0U
+#define QHASH_COMPACT_DELETED  UINT32_MAX
 
 static inline void qhash_slot_inv_flags(size_t * nonnull bits, uint32_t pos)
 {
@@ -156,6 +212,12 @@ static inline void qhash_del_at(qhash_t * nonnull qh, uint32_t pos)
              "delete operation performed on a sealed hash table");
 #endif
 
+    if (qh->swiss) {
+        qhash_swiss_del_at(qh, pos);
+    } else
+    if (qh->compact) {
+        qhash_compact_del_at(qh, pos);
+    } else
     if (likely(qhash_slot_is_set(hdr, pos))) {
         qhash_slot_inv_flags(hdr->bits, pos);
         hdr->len--;
@@ -255,6 +317,24 @@ uint32_t __qhash_put32(qhash_t * nonnull qh, uint32_t h, uint32_t k,
                        uint32_t flags)
     __leaf;
 void qhash_seal32(qhash_t * nonnull qh);
+int32_t  qhash_swiss_safe_get32(const qhash_t * nonnull qh, uint32_t h,
+                                uint32_t k)
+    __leaf;
+int32_t  qhash_swiss_get32(qhash_t * nonnull qh, uint32_t h, uint32_t k)
+    __leaf;
+uint32_t __qhash_swiss_put32(qhash_t * nonnull qh, uint32_t h,
+                             uint32_t k, uint32_t flags)
+    __leaf;
+void qhash_swiss_seal32(qhash_t * nonnull qh);
+int32_t  qhash_compact_safe_get32(const qhash_t * nonnull qh, uint32_t h,
+                                  uint32_t k)
+    __leaf;
+int32_t  qhash_compact_get32(qhash_t * nonnull qh, uint32_t h, uint32_t k)
+    __leaf;
+uint32_t __qhash_compact_put32(qhash_t * nonnull qh, uint32_t h,
+                               uint32_t k, uint32_t flags)
+    __leaf;
+void qhash_compact_seal32(qhash_t * nonnull qh);
 
 int32_t  qhash_safe_get64(const qhash_t * nonnull qh, uint32_t h, uint64_t k)
     __leaf;
@@ -264,6 +344,24 @@ uint32_t __qhash_put64(qhash_t * nonnull qh, uint32_t h, uint64_t k,
                        uint32_t flags)
     __leaf;
 void qhash_seal64(qhash_t * nonnull qh);
+int32_t  qhash_swiss_safe_get64(const qhash_t * nonnull qh, uint32_t h,
+                                uint64_t k)
+    __leaf;
+int32_t  qhash_swiss_get64(qhash_t * nonnull qh, uint32_t h, uint64_t k)
+    __leaf;
+uint32_t __qhash_swiss_put64(qhash_t * nonnull qh, uint32_t h,
+                             uint64_t k, uint32_t flags)
+    __leaf;
+void qhash_swiss_seal64(qhash_t * nonnull qh);
+int32_t  qhash_compact_safe_get64(const qhash_t * nonnull qh, uint32_t h,
+                                  uint64_t k)
+    __leaf;
+int32_t  qhash_compact_get64(qhash_t * nonnull qh, uint32_t h, uint64_t k)
+    __leaf;
+uint32_t __qhash_compact_put64(qhash_t * nonnull qh, uint32_t h,
+                               uint64_t k, uint32_t flags)
+    __leaf;
+void qhash_compact_seal64(qhash_t * nonnull qh);
 
 int32_t  qhash_safe_get_ptr(const qhash_t * nonnull qh, uint32_t h,
                             const void * nullable k,
@@ -279,6 +377,35 @@ uint32_t __qhash_put_ptr(qhash_t * nonnull qh, uint32_t h,
                          qhash_kequ_f * nonnull equ);
 void qhash_seal_ptr(qhash_t * nonnull qh, qhash_khash_f * nonnull hf,
                     qhash_kequ_f * nonnull equ);
+int32_t  qhash_swiss_safe_get_ptr(const qhash_t * nonnull qh, uint32_t h,
+                                  const void * nullable k,
+                                  qhash_khash_f * nonnull hf,
+                                  qhash_kequ_f * nonnull equ);
+int32_t  qhash_swiss_get_ptr(qhash_t * nonnull qh, uint32_t h,
+                             const void * nullable k,
+                             qhash_khash_f * nonnull hf,
+                             qhash_kequ_f * nonnull equ);
+uint32_t __qhash_swiss_put_ptr(qhash_t * nonnull qh, uint32_t h,
+                               const void * nullable k, uint32_t flags,
+                               qhash_khash_f * nonnull hf,
+                               qhash_kequ_f * nonnull equ);
+void qhash_swiss_seal_ptr(qhash_t * nonnull qh, qhash_khash_f * nonnull hf,
+                          qhash_kequ_f * nonnull equ);
+int32_t  qhash_compact_safe_get_ptr(const qhash_t * nonnull qh, uint32_t h,
+                                    const void * nullable k,
+                                    qhash_khash_f * nonnull hf,
+                                    qhash_kequ_f * nonnull equ);
+int32_t  qhash_compact_get_ptr(qhash_t * nonnull qh, uint32_t h,
+                               const void * nullable k,
+                               qhash_khash_f * nonnull hf,
+                               qhash_kequ_f * nonnull equ);
+uint32_t __qhash_compact_put_ptr(qhash_t * nonnull qh, uint32_t h,
+                                 const void * nullable k, uint32_t flags,
+                                 qhash_khash_f * nonnull hf,
+                                 qhash_kequ_f * nonnull equ);
+void qhash_compact_seal_ptr(qhash_t * nonnull qh,
+                            qhash_khash_f * nonnull hf,
+                            qhash_kequ_f * nonnull equ);
 
 int32_t  qhash_safe_get_vec(const qhash_t * nonnull qh, uint32_t h,
                             const void * nullable k,
@@ -294,7 +421,43 @@ uint32_t __qhash_put_vec(qhash_t * nonnull qh, uint32_t h,
                          qhash_kequ_f * nonnull equ);
 void qhash_seal_vec(qhash_t * nonnull qh, qhash_khash_f * nonnull hf,
                     qhash_kequ_f * nonnull equ);
+int32_t  qhash_swiss_safe_get_vec(const qhash_t * nonnull qh, uint32_t h,
+                                  const void * nullable k,
+                                  qhash_khash_f * nonnull hf,
+                                  qhash_kequ_f * nonnull equ);
+int32_t  qhash_swiss_get_vec(qhash_t * nonnull qh, uint32_t h,
+                             const void * nullable k,
+                             qhash_khash_f * nonnull hf,
+                             qhash_kequ_f * nonnull equ);
+uint32_t __qhash_swiss_put_vec(qhash_t * nonnull qh, uint32_t h,
+                               const void * nullable k, uint32_t flags,
+                               qhash_khash_f * nonnull hf,
+                               qhash_kequ_f * nonnull equ);
+void qhash_swiss_seal_vec(qhash_t * nonnull qh, qhash_khash_f * nonnull hf,
+                          qhash_kequ_f * nonnull equ);
+int32_t  qhash_compact_safe_get_vec(const qhash_t * nonnull qh, uint32_t h,
+                                    const void * nullable k,
+                                    qhash_khash_f * nonnull hf,
+                                    qhash_kequ_f * nonnull equ);
+int32_t  qhash_compact_get_vec(qhash_t * nonnull qh, uint32_t h,
+                               const void * nullable k,
+                               qhash_khash_f * nonnull hf,
+                               qhash_kequ_f * nonnull equ);
+uint32_t __qhash_compact_put_vec(qhash_t * nonnull qh, uint32_t h,
+                                 const void * nullable k, uint32_t flags,
+                                 qhash_khash_f * nonnull hf,
+                                 qhash_kequ_f * nonnull equ);
+void qhash_compact_seal_vec(qhash_t * nonnull qh,
+                            qhash_khash_f * nonnull hf,
+                            qhash_kequ_f * nonnull equ);
 size_t qhash_memory_footprint(const qhash_t * nonnull qh);
+int qhash_dump(const qhash_t * nonnull qh, int fd);
+ssize_t qhash_attach(qhash_t * nonnull qh, const void * nonnull mem,
+                     size_t len);
+ssize_t qhash_swiss_attach(qhash_t * nonnull qh, const void * nonnull mem,
+                           size_t len);
+ssize_t qhash_compact_attach(qhash_t * nonnull qh, const void * nonnull mem,
+                             size_t len);
 
 /* }}} */
 /*----- base macros to define QH's and QM's -{{{-*/
@@ -321,14 +484,14 @@ size_t qhash_memory_footprint(const qhash_t * nonnull qh);
         return hashK(&qh->qh, castK(key));                                   \
     }
 
-#define __QH_FIND(sfx, pfx, name, ckey_t, key_t, hashK, castK)               \
+#define __QH_FIND(sfx, mode, pfx, name, ckey_t, key_t, hashK, castK)         \
     __unused__                                                               \
     static inline int32_t                                                    \
     pfx##_find_int(pfx##_t * nonnull qh, const uint32_t * nullable ph,       \
                    ckey_t key)                                               \
     {                                                                        \
         uint32_t h = ph ? *ph : pfx##_hash(qh, key);                         \
-        return qhash_get##sfx(&qh->qh, h, castK(key));                       \
+        return qhash_##mode##get##sfx(&qh->qh, h, castK(key));               \
     }                                                                        \
     __unused__                                                               \
     static inline int32_t                                                    \
@@ -336,15 +499,15 @@ size_t qhash_memory_footprint(const qhash_t * nonnull qh);
                         const uint32_t * nullable ph, ckey_t key)            \
     {                                                                        \
         uint32_t h = ph ? *ph : pfx##_hash(qh, key);                         \
-        return qhash_safe_get##sfx(&qh->qh, h, castK(key));                  \
+        return qhash_##mode##safe_get##sfx(&qh->qh, h, castK(key));          \
     }                                                                        \
     __unused__                                                               \
     static inline void pfx##_seal(pfx##_t * nonnull qh)                      \
     {                                                                        \
-        return qhash_seal##sfx(&qh->qh);                                     \
+        return qhash_##mode##seal##sfx(&qh->qh);                             \
     }
 
-#define __QH_FIND2(sfx, pfx, name, ckey_t, key_t, hashK, castK, iseqK)       \
+#define __QH_FIND2(sfx, mode, pfx, name, ckey_t, key_t, hashK, castK, iseqK) \
     __unused__                                                               \
     static inline int32_t                                                    \
     pfx##_find_int(pfx##_t * nonnull qh, const uint32_t * nullable ph,       \
@@ -353,7 +516,7 @@ size_t qhash_memory_footprint(const qhash_t * nonnull qh);
         uint32_t (*hf)(const qhash_t *, ckey_t) = &hashK;                    \
         bool     (*ef)(const qhash_t *, ckey_t, ckey_t) = &iseqK;            \
         uint32_t h = ph ? *ph : pfx##_hash(qh, key);                         \
-        return qhash_get##sfx(&qh->qh, h, castK(key),                        \
+        return qhash_##mode##get##sfx(&qh->qh, h, castK(key),                \
                               (qhash_khash_f *)hf, (qhash_kequ_f *)ef);      \
     }                                                                        \
     __unused__                                                               \
@@ -364,7 +527,7 @@ size_t qhash_memory_footprint(const qhash_t * nonnull qh);
         uint32_t (*hf)(const qhash_t *, ckey_t) = &hashK;                    \
         bool     (*ef)(const qhash_t *, ckey_t, ckey_t) = &iseqK;            \
         uint32_t h = ph ? *ph : pfx##_hash(qh, key);                         \
-        return qhash_safe_get##sfx(&qh->qh, h, castK(key),                   \
+        return qhash_##mode##safe_get##sfx(&qh->qh, h, castK(key),           \
                                    (qhash_khash_f *)hf, (qhash_kequ_f *)ef); \
     }                                                                        \
     __unused__                                                               \
@@ -372,15 +535,32 @@ size_t qhash_memory_footprint(const qhash_t * nonnull qh);
     {                                                                        \
         uint32_t (*hf)(const qhash_t *, ckey_t) = &hashK;                    \
         bool     (*ef)(const qhash_t *, ckey_t, ckey_t) = &iseqK;            \
-        return qhash_seal##sfx(&qh->qh,                                      \
+        return qhash_##mode##seal##sfx(&qh->qh,                              \
                                (qhash_khash_f *)hf, (qhash_kequ_f *)ef);     \
     }
 
-#define __QH_IKEY(sfx, pfx, name, key_t, val_t, v_size)                      \
+#define __QH_FILE(mode, pfx)                                                 \
+    __unused__                                                               \
+    static inline int pfx##_dump(pfx##_t * nonnull qh, int fd)               \
+    {                                                                        \
+        if (qh->qh.ghosts != UINT32_MAX) {                                   \
+            pfx##_seal(qh);                                                  \
+        }                                                                    \
+        return qhash_dump(&qh->qh, fd);                                      \
+    }                                                                        \
+    __unused__                                                               \
+    static inline ssize_t pfx##_attach(pfx##_t * nonnull qh,                 \
+                                       const void * nonnull mem, size_t len) \
+    {                                                                        \
+        return qhash_##mode##attach(&qh->qh, mem, len);                      \
+    }
+
+#define __QH_IKEY(sfx, mode, pfx, name, key_t, val_t, v_size)                \
     __QH_BASE(sfx, pfx, name, key_t const, key_t, val_t, v_size,             \
               qhash_hash_u##sfx, CASTK_ID);                                  \
-    __QH_FIND(sfx, pfx, name, key_t const, key_t, qhash_hash_u##sfx,         \
+    __QH_FIND(sfx, mode, pfx, name, key_t const, key_t, qhash_hash_u##sfx,   \
               CASTK_ID);                                                     \
+    __QH_FILE(mode, pfx);                                                    \
                                                                              \
     __unused__                                                               \
     static inline uint32_t                                                   \
@@ -388,7 +568,7 @@ size_t qhash_memory_footprint(const qhash_t * nonnull qh);
                       key_t key, uint32_t fl)                                \
     {                                                                        \
         uint32_t h = ph ? *ph : pfx##_hash(qh, key);                         \
-        uint32_t pos = __qhash_put##sfx(&qh->qh, h, key, fl);                \
+        uint32_t pos = __qhash_##mode##put##sfx(&qh->qh, h, key, fl);        \
                                                                              \
         if ((fl & QHASH_OVERWRITE) || !(pos & QHASH_COLLISION)) {            \
             qh->keys[pos & ~QHASH_COLLISION] = key;                          \
@@ -396,10 +576,10 @@ size_t qhash_memory_footprint(const qhash_t * nonnull qh);
         return pos;                                                          \
     }
 
-#define __QH_HPKEY(pfx, name, ckey_t, key_t, val_t, v_size)                  \
+#define __QH_HPKEY(mode, pfx, name, ckey_t, key_t, val_t, v_size)            \
     __QH_BASE(64, pfx, name, ckey_t * nullable, key_t * nullable, val_t,     \
               v_size, qhash_hash_u64, CASTK_UPTR);                           \
-    __QH_FIND(64, pfx, name, ckey_t * nullable, key_t * nullable,            \
+    __QH_FIND(64, mode, pfx, name, ckey_t * nullable, key_t * nullable,      \
               qhash_hash_u64, CASTK_UPTR);                                   \
                                                                              \
     __unused__                                                               \
@@ -408,7 +588,8 @@ size_t qhash_memory_footprint(const qhash_t * nonnull qh);
                       key_t * nullable key, uint32_t fl)                     \
     {                                                                        \
         uint32_t h = ph ? *ph : pfx##_hash(qh, key);                         \
-        uint32_t pos = __qhash_put64(&qh->qh, h, CASTK_UPTR(key), fl);       \
+        uint32_t pos = __qhash_##mode##put64(&qh->qh, h, CASTK_UPTR(key),    \
+                                             fl);                            \
                                                                              \
         if ((fl & QHASH_OVERWRITE) || !(pos & QHASH_COLLISION)) {            \
             qh->keys[pos & ~QHASH_COLLISION] = key;                          \
@@ -416,11 +597,12 @@ size_t qhash_memory_footprint(const qhash_t * nonnull qh);
         return pos;                                                          \
     }
 
-#define __QH_PKEY(pfx, name, ckey_t, key_t, val_t, v_size, hashK, iseqK)     \
+#define __QH_PKEY(mode, pfx, name, ckey_t, key_t, val_t, v_size, hashK,      \
+                  iseqK)                                                     \
     __QH_BASE(_ptr, pfx, name, ckey_t * nullable, key_t * nullable, val_t,   \
               v_size, hashK, CASTK_ID);                                      \
-    __QH_FIND2(_ptr, pfx, name, ckey_t * nullable, key_t * nullable, hashK,  \
-               CASTK_ID, iseqK);                                             \
+    __QH_FIND2(_ptr, mode, pfx, name, ckey_t * nullable, key_t * nullable,   \
+               hashK, CASTK_ID, iseqK);                                      \
                                                                              \
     __unused__                                                               \
     static inline uint32_t                                                   \
@@ -431,7 +613,7 @@ size_t qhash_memory_footprint(const qhash_t * nonnull qh);
         bool     (*ef)(const qhash_t * nullable, ckey_t * nullable,          \
                        ckey_t * nullable) = &iseqK;                          \
         uint32_t h = ph ? *ph : pfx##_hash(qh, key);                         \
-        uint32_t pos = __qhash_put_ptr(&qh->qh, h, key, fl,                  \
+        uint32_t pos = __qhash_##mode##put_ptr(&qh->qh, h, key, fl,          \
                               (qhash_khash_f *)hf, (qhash_kequ_f *)ef);      \
                                                                              \
         if ((fl & QHASH_OVERWRITE) || !(pos & QHASH_COLLISION)) {            \
@@ -440,11 +622,13 @@ size_t qhash_memory_footprint(const qhash_t * nonnull qh);
         return pos;                                                          \
     }
 
-#define __QH_VKEY(pfx, name, ckey_t, key_t, val_t, v_size, hashK, iseqK)     \
+#define __QH_VKEY(mode, pfx, name, ckey_t, key_t, val_t, v_size, hashK,      \
+                  iseqK)                                                     \
     __QH_BASE(_vec, pfx, name, ckey_t * nonnull, key_t, val_t, v_size,       \
               hashK, CASTK_ID);                                              \
-    __QH_FIND2(_vec, pfx, name, ckey_t * nonnull, key_t * nonnull, hashK,    \
-               CASTK_ID,  iseqK);                                            \
+    __QH_FIND2(_vec, mode, pfx, name, ckey_t * nonnull, key_t * nonnull,     \
+               hashK, CASTK_ID, iseqK);                                      \
+    __QH_FILE(mode, pfx);                                                    \
                                                                              \
     __unused__                                                               \
     static inline uint32_t                                                   \
@@ -455,7 +639,7 @@ size_t qhash_memory_footprint(const qhash_t * nonnull qh);
         bool     (*ef)(const qhash_t * nullable, ckey_t * nonnull,           \
                        ckey_t * nonnull) = &iseqK;                           \
         uint32_t h = ph ? *ph : pfx##_hash(qh, key);                         \
-        uint32_t pos = __qhash_put_vec(&qh->qh, h, key, fl,                  \
+        uint32_t pos = __qhash_##mode##put_vec(&qh->qh, h, key, fl,          \
                                        (qhash_khash_f *)hf,                  \
                                        (qhash_kequ_f *)ef);                  \
                                                                              \
@@ -478,35 +662,115 @@ size_t qhash_memory_footprint(const qhash_t * nonnull qh);
  */
 
 #define qh_k32_t(name)                                                       \
-    __QH_IKEY(32, qh_##name, name, uint32_t, void, 0)
+    __QH_IKEY(32, , qh_##name, name, uint32_t, void, 0)
 #define qh_k64_t(name)                                                       \
-    __QH_IKEY(64, qh_##name, name, uint64_t, void, 0)
+    __QH_IKEY(64, , qh_##name, name, uint64_t, void, 0)
 #define qh_kvec_t(name, key_t, hf, ef)                                       \
-    __QH_VKEY(qh_##name, name, key_t const, key_t, void, 0, hf, ef)
+    __QH_VKEY(, qh_##name, name, key_t const, key_t, void, 0, hf, ef)
 #define qh_kptr_t(name, key_t, hf, ef)                                       \
-    __QH_PKEY(qh_##name, name, key_t const, key_t, void, 0, hf, ef)
+    __QH_PKEY(, qh_##name, name, key_t const, key_t, void, 0, hf, ef)
 #define qh_kptr_ckey_t(name, key_t, hf, ef)                                  \
-    __QH_PKEY(qh_##name, name, key_t const, key_t const, void, 0, hf, ef)
+    __QH_PKEY(, qh_##name, name, key_t const, key_t const, void, 0, hf, ef)
 #define qh_khptr_t(name, key_t)                                              \
-    __QH_HPKEY(qh_##name, name, key_t const, key_t, void, 0)
+    __QH_HPKEY(, qh_##name, name, key_t const, key_t, void, 0)
 #define qh_khptr_ckey_t(name, key_t)                                         \
-    __QH_HPKEY(qh_##name, name, key_t const, key_t const, void, 0)
+    __QH_HPKEY(, qh_##name, name, key_t const, key_t const, void, 0)
 
 #define qm_k32_t(name, val_t)                                                \
-    __QH_IKEY(32, qm_##name, name, uint32_t, val_t, sizeof(val_t))
+    __QH_IKEY(32, , qm_##name, name, uint32_t, val_t, sizeof(val_t))
 #define qm_k64_t(name, val_t)                                                \
-    __QH_IKEY(64, qm_##name, name, uint64_t, val_t, sizeof(val_t))
+    __QH_IKEY(64, , qm_##name, name, uint64_t, val_t, sizeof(val_t))
 #define qm_kvec_t(name, key_t, val_t, hf, ef)                                \
-    __QH_VKEY(qm_##name, name, key_t const, key_t, val_t, sizeof(val_t), hf, ef)
+    __QH_VKEY(, qm_##name, name, key_t const, key_t, val_t, sizeof(val_t),   \
+              hf, ef)
 #define qm_kptr_t(name, key_t, val_t, hf, ef)                                \
-    __QH_PKEY(qm_##name, name, key_t const, key_t, val_t, sizeof(val_t), hf, ef)
+    __QH_PKEY(, qm_##name, name, key_t const, key_t, val_t, sizeof(val_t),   \
+              hf, ef)
 #define qm_kptr_ckey_t(name, key_t, val_t, hf, ef)                           \
-    __QH_PKEY(qm_##name, name, key_t const, key_t const, val_t,              \
+    __QH_PKEY(, qm_##name, name, key_t const, key_t const, val_t,            \
               sizeof(val_t), hf, ef)
 #define qm_khptr_t(name, key_t, val_t)                                       \
-    __QH_HPKEY(qm_##name, name, key_t const, key_t, val_t, sizeof(val_t))
+    __QH_HPKEY(, qm_##name, name, key_t const, key_t, val_t, sizeof(val_t))
 #define qm_khptr_ckey_t(name, key_t, val_t)                                  \
-    __QH_HPKEY(qm_##name, name, key_t const, key_t const, val_t, sizeof(val_t))
+    __QH_HPKEY(, qm_##name, name, key_t const, key_t const, val_t,           \
+               sizeof(val_t))
+
+/* Swiss tables variants, see the top of this file. They are used with the
+ * same qh_* and qm_* macros and initializers as the other ones. */
+
+#define qh_k32_swiss_t(name)                                                 \
+    __QH_IKEY(32, swiss_, qh_##name, name, uint32_t, void, 0)
+#define qh_k64_swiss_t(name)                                                 \
+    __QH_IKEY(64, swiss_, qh_##name, name, uint64_t, void, 0)
+#define qh_kvec_swiss_t(name, key_t, hf, ef)                                 \
+    __QH_VKEY(swiss_, qh_##name, name, key_t const, key_t, void, 0, hf, ef)
+#define qh_kptr_swiss_t(name, key_t, hf, ef)                                 \
+    __QH_PKEY(swiss_, qh_##name, name, key_t const, key_t, void, 0, hf, ef)
+#define qh_kptr_ckey_swiss_t(name, key_t, hf, ef)                            \
+    __QH_PKEY(swiss_, qh_##name, name, key_t const, key_t const, void, 0,    \
+              hf, ef)
+#define qh_khptr_swiss_t(name, key_t)                                        \
+    __QH_HPKEY(swiss_, qh_##name, name, key_t const, key_t, void, 0)
+#define qh_khptr_ckey_swiss_t(name, key_t)                                   \
+    __QH_HPKEY(swiss_, qh_##name, name, key_t const, key_t const, void, 0)
+
+#define qm_k32_swiss_t(name, val_t)                                          \
+    __QH_IKEY(32, swiss_, qm_##name, name, uint32_t, val_t, sizeof(val_t))
+#define qm_k64_swiss_t(name, val_t)                                          \
+    __QH_IKEY(64, swiss_, qm_##name, name, uint64_t, val_t, sizeof(val_t))
+#define qm_kvec_swiss_t(name, key_t, val_t, hf, ef)                          \
+    __QH_VKEY(swiss_, qm_##name, name, key_t const, key_t, val_t,            \
+              sizeof(val_t), hf, ef)
+#define qm_kptr_swiss_t(name, key_t, val_t, hf, ef)                          \
+    __QH_PKEY(swiss_, qm_##name, name, key_t const, key_t, val_t,            \
+              sizeof(val_t), hf, ef)
+#define qm_kptr_ckey_swiss_t(name, key_t, val_t, hf, ef)                     \
+    __QH_PKEY(swiss_, qm_##name, name, key_t const, key_t const, val_t,      \
+              sizeof(val_t), hf, ef)
+#define qm_khptr_swiss_t(name, key_t, val_t)                                 \
+    __QH_HPKEY(swiss_, qm_##name, name, key_t const, key_t, val_t,           \
+               sizeof(val_t))
+#define qm_khptr_ckey_swiss_t(name, key_t, val_t)                            \
+    __QH_HPKEY(swiss_, qm_##name, name, key_t const, key_t const, val_t,     \
+               sizeof(val_t))
+
+/* Compact tables variants, see the top of this file. */
+
+#define qh_k32_compact_t(name)                                               \
+    __QH_IKEY(32, compact_, qh_##name, name, uint32_t, void, 0)
+#define qh_k64_compact_t(name)                                               \
+    __QH_IKEY(64, compact_, qh_##name, name, uint64_t, void, 0)
+#define qh_kvec_compact_t(name, key_t, hf, ef)                               \
+    __QH_VKEY(compact_, qh_##name, name, key_t const, key_t, void, 0, hf, ef)
+#define qh_kptr_compact_t(name, key_t, hf, ef)                               \
+    __QH_PKEY(compact_, qh_##name, name, key_t const, key_t, void, 0, hf, ef)
+#define qh_kptr_ckey_compact_t(name, key_t, hf, ef)                          \
+    __QH_PKEY(compact_, qh_##name, name, key_t const, key_t const, void, 0,  \
+              hf, ef)
+#define qh_khptr_compact_t(name, key_t)                                      \
+    __QH_HPKEY(compact_, qh_##name, name, key_t const, key_t, void, 0)
+#define qh_khptr_ckey_compact_t(name, key_t)                                 \
+    __QH_HPKEY(compact_, qh_##name, name, key_t const, key_t const, void, 0)
+
+#define qm_k32_compact_t(name, val_t)                                        \
+    __QH_IKEY(32, compact_, qm_##name, name, uint32_t, val_t, sizeof(val_t))
+#define qm_k64_compact_t(name, val_t)                                        \
+    __QH_IKEY(64, compact_, qm_##name, name, uint64_t, val_t, sizeof(val_t))
+#define qm_kvec_compact_t(name, key_t, val_t, hf, ef)                        \
+    __QH_VKEY(compact_, qm_##name, name, key_t const, key_t, val_t,          \
+              sizeof(val_t), hf, ef)
+#define qm_kptr_compact_t(name, key_t, val_t, hf, ef)                        \
+    __QH_PKEY(compact_, qm_##name, name, key_t const, key_t, val_t,          \
+              sizeof(val_t), hf, ef)
+#define qm_kptr_ckey_compact_t(name, key_t, val_t, hf, ef)                   \
+    __QH_PKEY(compact_, qm_##name, name, key_t const, key_t const, val_t,    \
+              sizeof(val_t), hf, ef)
+#define qm_khptr_compact_t(name, key_t, val_t)                               \
+    __QH_HPKEY(compact_, qm_##name, name, key_t const, key_t, val_t,         \
+               sizeof(val_t))
+#define qm_khptr_ckey_compact_t(name, key_t, val_t)                          \
+    __QH_HPKEY(compact_, qm_##name, name, key_t const, key_t const, val_t,   \
+               sizeof(val_t))
 
 /** Static QH initializer.
  *
@@ -643,6 +907,8 @@ size_t qhash_memory_footprint(const qhash_t * nonnull qh);
 #define qh_unseal(name, _qh)                                                 \
     ({  qh_t(name) *__qh = (_qh);                                            \
         qhash_unseal(&__qh->qh); })
+#define qh_dump(name, qh, fd)               qh_##name##_dump(qh, fd)
+#define qh_attach(name, qh, mem, len)       qh_##name##_attach(qh, mem, len)
 #define qh_wipe(name, _qh)                                                   \
     ({  qh_t(name) *__qh = (_qh);                                            \
         qhash_wipe(&__qh->qh); })
@@ -865,6 +1131,39 @@ size_t qhash_memory_footprint(const qhash_t * nonnull qh);
     ({  qm_t(name) *__qh = (_qh);                                            \
         qhash_unseal(&__qh->qh); })
 
+/** Write the table to \p fd, so that it can be attached later.
+ *
+ * The table is sealed first (see qm_seal()). Only the maps with integer
+ * keys or vector keys (qm_kvec_t) can be dumped, and the keys and values
+ * must be plain old data: no pointer survives the file.
+ *
+ * The file is written in the byte order of the host, it must be attached by
+ * a map of the same type, compiled for the same architecture.
+ *
+ * \return 0 on success, -1 with errno set on error.
+ */
+#define qm_dump(name, qh, fd)               qm_##name##_dump(qh, fd)
+
+/** Attach a table written by qm_dump() in memory.
+ *
+ * The map reads its keys, values and control bits in place, without any
+ * copy nor rehash: with a file mapped by lstr_init_from_file(), the
+ * loading of the map costs page faults instead of insertions. The memory
+ * must be aligned on 64 bytes (mmap()ed memory is), and must outlive the
+ * map.
+ *
+ * The map must have been initialized (any content is wiped), and is sealed
+ * and read-only once attached: it must be wiped before the memory is
+ * unmapped, and reinitialized to be used for anything else, it must never
+ * be unsealed.
+ *
+ * \return the number of bytes of \p mem used by the table, so that several
+ *         tables can be dumped to and attached from the same file, or -1
+ *         with errno set to EINVAL if the memory doesn't hold a table of
+ *         the map type.
+ */
+#define qm_attach(name, qh, mem, len)       qm_##name##_attach(qh, mem, len)
+
 #define qm_wipe(name, _qh)                                                   \
     ({  qm_t(name) *__qh = (_qh);                                            \
         qhash_wipe(&__qh->qh); })
@@ -1221,7 +1520,7 @@ qhash_str_equal(const qhash_t * nullable qh, const char * nonnull s1,
 static inline uint32_t qhash_lstr_hash(const qhash_t * nullable qh,
                                        const lstr_t * nonnull ls)
 {
-    return mem_hash32(ls->s, ls->len);
+    return u64_hash32(mem_hash64(ls->s, ls->len));
 }
 
 static inline bool
@@ -1231,6 +1530,21 @@ qhash_lstr_equal(const qhash_t * nullable qh, const lstr_t * nonnull s1,
     return lstr_equal(*s1, *s2);
 }
 
+/* Keys interned in a same table with lstr_intern(): the hash is the one
+ * stored with the string, and the keys are compared by pointer. */
+static inline uint32_t
+qhash_lstr_intern_hash(const qhash_t * nullable qh, const lstr_t * nonnull ls)
+{
+    return lstr_intern_hash(*ls);
+}
+
+static inline bool
+qhash_lstr_intern_equal(const qhash_t * nullable qh,
+                        const lstr_t * nonnull s1, const lstr_t * nonnull s2)
+{
+    return lstr_intern_equal(*s1, *s2);
+}
+
 static inline uint32_t
 qhash_lstr_ascii_ihash(const qhash_t * nullable qh, const lstr_t * nonnull ls)
 {
@@ -1256,6 +1570,8 @@ qh_k64_t(u64);
 qh_kptr_t(str,   char,    qhash_str_hash,  qhash_str_equal);
 qh_kvec_t(lstr,  lstr_t,  qhash_lstr_hash, qhash_lstr_equal);
 qh_kvec_t(ilstr, lstr_t,  qhash_lstr_ascii_ihash, qhash_lstr_ascii_iequal);
+qh_kvec_t(lstr_intern, lstr_t, qhash_lstr_intern_hash,
+          qhash_lstr_intern_equal);
 qh_khptr_t(ptr, void);
 
 qh_kptr_ckey_t(cstr, char, qhash_str_hash, qhash_str_equal);
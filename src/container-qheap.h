@@ -236,6 +236,7 @@
 #define qhp_deep_wipe(n, heap, wipe)   qv_deep_wipe(heap, wipe)
 #define qhp_clear(n, heap)             qv_clear(heap)
 #define qhp_deep_clear(n, heap, wipe)  qv_deep_clear(heap, wipe)
+#define qhp_memory_footprint(n, heap)  qv_memory_footprint(heap)
 
 /* Low-level update functions */
 #define __qhp_up(n, heap, pos)          __qhp_##n##_up(heap, pos)
@@ -290,4 +291,469 @@ qhp_max_t(double_max, double,   QHP_SCALAR_CMP, QHP_IGNORE);
 qhp_min_t(lstr_min, lstr_t *, QHP_LSTR_CMP, QHP_IGNORE);
 qhp_max_t(lstr_max, lstr_t *, QHP_LSTR_CMP, QHP_IGNORE);
 
+/*{{{1 Radix heap */
+
+/* Radix Heap Container
+ * ----------
+ *
+ * This container is a min heap of nodes with an unsigned integer key, such
+ * as a timestamp, that is never smaller than the key of the last node that
+ * was taken: the keys are monotone, like the expiration times of timers.
+ *
+ * A node lives in the bucket of the highest bit that differs between its
+ * key and the key of the last taken node, bucket 0 holding the nodes with
+ * that very key. When bucket 0 is empty, the first bucket that is not is
+ * spread into the lower ones, if bits so that a node is moved at most 64
+ * times and that the operations are amortized O(1) instead of O(log n).
+ * ----------
+ *
+ * It has the same API as the qhp (qrhp_insert(), qrhp_take_first(), ...)
+ * and its nodes are defined the same way, but the comparison macro is
+ * replaced by a macro or function that returns the uint64_t key of a node.
+ * The positions given to the setter can be used with qrhp_remove() and
+ * qrhp_fixup(), the new key of a fixed up node must not be smaller than the
+ * key of the last taken node either.
+ * ----------
+ *
+ * Example:
+ * -----
+ *
+ * #define GET_KEY(node)  ((node)->expiry)
+ *
+ * qrhp_t(timers, timer_t *, GET_KEY, SET_POS);
+ */
+
+#define qrhp_t(name)  qrhp_##name##_t
+
+#define QRHP_BUCKETS                 65
+#define QRHP_POS(bucket, i)         (((i) << 7) | (bucket))
+#define QRHP_POS_BUCKET(pos)        ((pos) & 0x7f)
+#define QRHP_POS_IDX(pos)           ((pos) >> 7)
+
+#define qrhp_type_t(name, type_t)                                             \
+    qvector_t(qrhp_##name, type_t);                                           \
+    typedef struct qrhp_##name##_t {                                          \
+        uint64_t last;                                                        \
+        int      len;                                                         \
+        qv_t(qrhp_##name) buckets[QRHP_BUCKETS];                              \
+    } qrhp_t(name);
+
+#define qrhp_funcs_t(n, type_t, key, set_pos)                                 \
+                                                                              \
+    __unused__                                                                \
+    static inline void qrhp_##n##_init(qrhp_t(n) *heap)                       \
+    {                                                                         \
+        p_clear(heap, 1);                                                     \
+        carray_for_each_ptr(bucket, heap->buckets) {                          \
+            qv_init(bucket);                                                  \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    __unused__                                                                \
+    static inline void qrhp_##n##_wipe(qrhp_t(n) *heap)                       \
+    {                                                                         \
+        carray_for_each_ptr(bucket, heap->buckets) {                          \
+            qv_wipe(bucket);                                                  \
+        }                                                                     \
+        heap->last = 0;                                                       \
+        heap->len  = 0;                                                       \
+    }                                                                         \
+                                                                              \
+    __unused__                                                                \
+    static inline void qrhp_##n##_clear(qrhp_t(n) *heap)                      \
+    {                                                                         \
+        carray_for_each_ptr(bucket, heap->buckets) {                          \
+            qv_clear(bucket);                                                 \
+        }                                                                     \
+        heap->last = 0;                                                       \
+        heap->len  = 0;                                                       \
+    }                                                                         \
+                                                                              \
+    __unused__                                                                \
+    static inline size_t qrhp_##n##_memory_footprint(const qrhp_t(n) *heap)   \
+    {                                                                         \
+        size_t size = 0;                                                      \
+                                                                              \
+        carray_for_each_ptr(bucket, heap->buckets) {                          \
+            size += qv_memory_footprint(bucket);                              \
+        }                                                                     \
+        return size;                                                          \
+    }                                                                         \
+                                                                              \
+    __unused__                                                                \
+    static ALWAYS_INLINE int                                                  \
+    __qrhp_##n##_push(qrhp_t(n) *heap, type_t node)                           \
+    {                                                                         \
+        uint64_t k = key(node);                                               \
+        int      b = k == heap->last ? 0 : bsr64(k ^ heap->last) + 1;         \
+        int      pos;                                                         \
+                                                                              \
+        assert (k >= heap->last && heap->buckets[b].len < (1 << 24));         \
+        pos = QRHP_POS(b, heap->buckets[b].len);                              \
+        set_pos(node, pos);                                                   \
+        qv_append(&heap->buckets[b], node);                                   \
+        return pos;                                                           \
+    }                                                                         \
+                                                                              \
+    /* Make sure bucket 0 holds the smallest keys. */                         \
+    __unused__                                                                \
+    static inline void __qrhp_##n##_settle(qrhp_t(n) *heap)                   \
+    {                                                                         \
+        qv_t(qrhp_##n) *bucket = &heap->buckets[1];                           \
+        uint64_t min;                                                         \
+                                                                              \
+        if (heap->buckets[0].len || !heap->len) {                             \
+            return;                                                           \
+        }                                                                     \
+        while (!bucket->len) {                                                \
+            bucket++;                                                         \
+        }                                                                     \
+        min = key(bucket->tab[0]);                                            \
+        for (int i = 1; i < bucket->len; i++) {                               \
+            min = MIN(min, (uint64_t)key(bucket->tab[i]));                    \
+        }                                                                     \
+        heap->last = min;                                                     \
+        for (int i = 0; i < bucket->len; i++) {                               \
+            __qrhp_##n##_push(heap, bucket->tab[i]);                          \
+        }                                                                     \
+        qv_clear(bucket);                                                     \
+    }                                                                         \
+                                                                              \
+    __unused__                                                                \
+    static inline int qrhp_##n##_insert(qrhp_t(n) *heap, type_t node)         \
+    {                                                                         \
+        heap->len++;                                                          \
+        return __qrhp_##n##_push(heap, node);                                 \
+    }                                                                         \
+                                                                              \
+    __unused__                                                                \
+    static inline type_t qrhp_##n##_first(qrhp_t(n) *heap)                    \
+    {                                                                         \
+        __qrhp_##n##_settle(heap);                                            \
+        return *tab_last(&heap->buckets[0]);                                  \
+    }                                                                         \
+                                                                              \
+    __unused__                                                                \
+    static inline type_t qrhp_##n##_remove(qrhp_t(n) *heap, int pos)          \
+    {                                                                         \
+        qv_t(qrhp_##n) *bucket;                                               \
+        type_t node;                                                          \
+        type_t last;                                                          \
+        int    i;                                                             \
+                                                                              \
+        if (unlikely(pos < 0)) {                                              \
+            p_clear(&node, 1);                                                \
+            return node;                                                      \
+        }                                                                     \
+                                                                              \
+        bucket = &heap->buckets[QRHP_POS_BUCKET(pos)];                        \
+        i      = QRHP_POS_IDX(pos);                                           \
+        node   = bucket->tab[i];                                              \
+        last   = *tab_last(bucket);                                           \
+        qv_shrink(bucket, 1);                                                 \
+        if (i < bucket->len) {                                                \
+            set_pos(last, pos);                                               \
+            bucket->tab[i] = last;                                            \
+        }                                                                     \
+        heap->len--;                                                          \
+                                                                              \
+        set_pos(node, -1);                                                    \
+        return node;                                                          \
+    }                                                                         \
+                                                                              \
+    __unused__                                                                \
+    static inline type_t qrhp_##n##_take_first(qrhp_t(n) *heap)               \
+    {                                                                         \
+        __qrhp_##n##_settle(heap);                                            \
+        return qrhp_##n##_remove(heap,                                        \
+                                 QRHP_POS(0, heap->buckets[0].len - 1));      \
+    }                                                                         \
+                                                                              \
+    __unused__                                                                \
+    static inline int qrhp_##n##_fixup(qrhp_t(n) *heap, int pos)              \
+    {                                                                         \
+        return qrhp_##n##_insert(heap, qrhp_##n##_remove(heap, pos));         \
+    }
+
+/* \macro  qrhp_t
+ * \brief  Declares a radix heap and its functions
+ *
+ * \param  name         Name of the heap
+ *
+ * \param  type_t       Node type
+ *
+ * \param  key          Key getter function or macro, the keys being
+ *                      unsigned integers of at most 64 bits.
+ *
+ * \param  set_pos      Position setter function or macro, that can be
+ *                      QHP_IGNORE, see qhp_full_t().
+ */
+#define qrhp_full_t(name, type_t, key, set_pos)               \
+    qrhp_type_t(name, type_t);                                \
+    qrhp_funcs_t(name, type_t, key, set_pos);
+
+/* Setup */
+#define qrhp_init(n, heap)              qrhp_##n##_init(heap)
+#define qrhp_wipe(n, heap)              qrhp_##n##_wipe(heap)
+#define qrhp_clear(n, heap)             qrhp_##n##_clear(heap)
+#define qrhp_memory_footprint(n, heap)  qrhp_##n##_memory_footprint(heap)
+
+/* Content modifiers */
+#define qrhp_insert(n, heap, node)      qrhp_##n##_insert(heap, node)
+#define qrhp_fixup(n, heap, pos)        qrhp_##n##_fixup(heap, pos)
+#define qrhp_remove(n, heap, pos)       qrhp_##n##_remove(heap, pos)
+#define qrhp_take_first(n, heap)        qrhp_##n##_take_first(heap)
+
+/* Getters, qrhp_first() moves the nodes around to find the first one */
+#define qrhp_len(n, heap)         ({ const qrhp_t(n) *__heap = (heap);       \
+                                     __heap->len; })
+#define qrhp_is_empty(n, heap)    (!qrhp_len(n, (heap)))
+#define qrhp_first(n, heap)       qrhp_##n##_first(heap)
+
+#define QRHP_SCALAR_KEY(a)  (a)
+
+qrhp_full_t(u32, uint32_t, QRHP_SCALAR_KEY, QHP_IGNORE);
+qrhp_full_t(u64, uint64_t, QRHP_SCALAR_KEY, QHP_IGNORE);
+
+/*1}}}*/
+/*{{{1 Pairing heap */
+
+/* Pairing Heap Container
+ * ----------
+ *
+ * This container is a min heap or a max heap of intrusive nodes: the nodes
+ * are structures with a qphp_node_t member, the heap being a tree of these
+ * members. It is meant for the workloads that change the keys of their
+ * nodes more often than they take the first one:
+ *  - qphp_insert() and qphp_decrease() (when a node gets closer to the
+ *    first one) are O(1);
+ *  - qphp_take_first(), qphp_remove() and qphp_fixup() are O(log n)
+ *    amortized.
+ * ----------
+ *
+ * It has the same API as the qhp, but with the nodes instead of their
+ * positions, and the same comparison macros, that take two nodes pointers.
+ * ----------
+ *
+ * Example:
+ * -----
+ *
+ * typedef struct test_node_t {
+ *     qphp_node_t heap;
+ *     int val;
+ * } test_node_t;
+ *
+ * #define CMP(a, op, b)       ((a)->val op (b)->val)
+ *
+ * qphp_min_t(min_heap, test_node_t, heap, CMP);
+ */
+
+#define qphp_t(name)  qphp_##name##_t
+
+typedef struct qphp_node_t {
+    struct qphp_node_t *child;
+    struct qphp_node_t *next;
+    /* the parent of a first child, the previous sibling otherwise */
+    struct qphp_node_t *prev;
+} qphp_node_t;
+
+static inline void __qphp_cut(qphp_node_t *node)
+{
+    if (node->prev->child == node) {
+        node->prev->child = node->next;
+    } else {
+        node->prev->next = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    }
+    node->next = NULL;
+    node->prev = NULL;
+}
+
+#define qphp_type_t(name)                                                     \
+    typedef struct qphp_##name##_t {                                          \
+        qphp_node_t *root;                                                    \
+        int          len;                                                     \
+    } qphp_t(name);
+
+#define qphp_funcs_t(n, type_t, is_min_heap, member, cmp)                     \
+                                                                              \
+    __unused__                                                                \
+    static ALWAYS_INLINE type_t *__qphp_##n##_entry(qphp_node_t *node)        \
+    {                                                                         \
+        return container_of(node, type_t, member);                            \
+    }                                                                         \
+                                                                              \
+    /* Meld two roots, the one that loses becomes the first child of the      \
+     * other. */                                                              \
+    __unused__                                                                \
+    static inline qphp_node_t *                                               \
+    __qphp_##n##_meld(qphp_node_t *a, qphp_node_t *b)                         \
+    {                                                                         \
+        if (QHP_CMP(is_min_heap, cmp, __qphp_##n##_entry(b), <,               \
+                    __qphp_##n##_entry(a)))                                   \
+        {                                                                     \
+            SWAP(qphp_node_t *, a, b);                                        \
+        }                                                                     \
+        b->prev = a;                                                          \
+        b->next = a->child;                                                   \
+        if (a->child) {                                                       \
+            a->child->prev = b;                                               \
+        }                                                                     \
+        a->child = b;                                                         \
+        return a;                                                             \
+    }                                                                         \
+                                                                              \
+    /* The two passes merge of the children of a removed node: the pairs      \
+     * are melded from left to right and chained through their prev field,    \
+     * then melded from right to left. */                                     \
+    __unused__                                                                \
+    static inline qphp_node_t *                                               \
+    __qphp_##n##_merge(qphp_node_t *first)                                    \
+    {                                                                         \
+        qphp_node_t *pairs = NULL;                                            \
+                                                                              \
+        while (first) {                                                       \
+            qphp_node_t *a = first;                                           \
+            qphp_node_t *b = a->next;                                         \
+                                                                              \
+            first = b ? b->next : NULL;                                       \
+            a->next = a->prev = NULL;                                         \
+            if (b) {                                                          \
+                b->next = b->prev = NULL;                                     \
+                a = __qphp_##n##_meld(a, b);                                  \
+            }                                                                 \
+            a->prev = pairs;                                                  \
+            pairs = a;                                                        \
+        }                                                                     \
+        if (!pairs) {                                                         \
+            return NULL;                                                      \
+        }                                                                     \
+        first = pairs;                                                        \
+        pairs = first->prev;                                                  \
+        first->prev = NULL;                                                   \
+        while (pairs) {                                                       \
+            qphp_node_t *a = pairs;                                           \
+                                                                              \
+            pairs = a->prev;                                                  \
+            a->prev = NULL;                                                   \
+            first = __qphp_##n##_meld(first, a);                              \
+        }                                                                     \
+        return first;                                                         \
+    }                                                                         \
+                                                                              \
+    __unused__                                                                \
+    static inline void qphp_##n##_insert(qphp_t(n) *heap, type_t *e)          \
+    {                                                                         \
+        qphp_node_t *node = &e->member;                                       \
+                                                                              \
+        p_clear(node, 1);                                                     \
+        heap->root = heap->root ? __qphp_##n##_meld(heap->root, node) : node; \
+        heap->len++;                                                          \
+    }                                                                         \
+                                                                              \
+    __unused__                                                                \
+    static inline type_t *qphp_##n##_first(const qphp_t(n) *heap)             \
+    {                                                                         \
+        return heap->root ? __qphp_##n##_entry(heap->root) : NULL;            \
+    }                                                                         \
+                                                                              \
+    __unused__                                                                \
+    static inline type_t *qphp_##n##_remove(qphp_t(n) *heap, type_t *e)       \
+    {                                                                         \
+        qphp_node_t *node = &e->member;                                       \
+        qphp_node_t *children = __qphp_##n##_merge(node->child);              \
+                                                                              \
+        if (node == heap->root) {                                             \
+            heap->root = children;                                            \
+        } else {                                                              \
+            __qphp_cut(node);                                                 \
+            if (children) {                                                   \
+                heap->root = __qphp_##n##_meld(heap->root, children);         \
+            }                                                                 \
+        }                                                                     \
+        node->child = NULL;                                                   \
+        heap->len--;                                                          \
+        return e;                                                             \
+    }                                                                         \
+                                                                              \
+    __unused__                                                                \
+    static inline type_t *qphp_##n##_take_first(qphp_t(n) *heap)              \
+    {                                                                         \
+        if (!heap->root) {                                                    \
+            return NULL;                                                      \
+        }                                                                     \
+        return qphp_##n##_remove(heap, __qphp_##n##_entry(heap->root));       \
+    }                                                                         \
+                                                                              \
+    /* The node got closer to the first one, its children are still in        \
+     * order. */                                                              \
+    __unused__                                                                \
+    static inline void qphp_##n##_decrease(qphp_t(n) *heap, type_t *e)        \
+    {                                                                         \
+        qphp_node_t *node = &e->member;                                       \
+                                                                              \
+        if (node != heap->root) {                                             \
+            __qphp_cut(node);                                                 \
+            heap->root = __qphp_##n##_meld(heap->root, node);                 \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    __unused__                                                                \
+    static inline void qphp_##n##_fixup(qphp_t(n) *heap, type_t *e)           \
+    {                                                                         \
+        qphp_##n##_insert(heap, qphp_##n##_remove(heap, e));                  \
+    }
+
+/* \macro  qphp_t
+ * \brief  Declares a pairing heap and its functions
+ *
+ * \param  name         Name of the heap
+ *
+ * \param  type_t       Node structure type
+ *
+ * \param  is_min_heap  Boolean. Defines whether the heap is a min heap or a
+ *                      max heap.
+ *
+ * \param  member       The qphp_node_t member of the node structures.
+ *
+ * \param  cmp          Comparison macro, see qhp_full_t().
+ */
+#define qphp_full_t(name, type_t, is_min_heap, member, cmp)   \
+    qphp_type_t(name);                                        \
+    qphp_funcs_t(name, type_t, is_min_heap, member, cmp);
+
+#define qphp_min_t(name, type_t, member, cmp)                 \
+    qphp_full_t(name, type_t, true, member, cmp)
+
+#define qphp_max_t(name, type_t, member, cmp)                 \
+    qphp_full_t(name, type_t, false, member, cmp)
+
+/* Setup, the nodes belong to the caller */
+#define qphp_init(n, heap)              p_clear(QPHP_CHECK_TYPE(n, heap), 1)
+#define qphp_wipe(n, heap)              qphp_init(n, heap)
+#define qphp_clear(n, heap)             qphp_init(n, heap)
+
+/* Content modifiers */
+#define qphp_insert(n, heap, node)      qphp_##n##_insert(heap, node)
+#define qphp_decrease(n, heap, node)    qphp_##n##_decrease(heap, node)
+#define qphp_fixup(n, heap, node)       qphp_##n##_fixup(heap, node)
+#define qphp_fixup_first(n, heap)                                            \
+    ({ qphp_t(n) *__heap = (heap);                                           \
+       qphp_fixup(n, __heap, qphp_first(n, __heap)); })
+#define qphp_remove(n, heap, node)      qphp_##n##_remove(heap, node)
+#define qphp_take_first(n, heap)        qphp_##n##_take_first(heap)
+
+#define QPHP_CHECK_TYPE(n, heap)                                             \
+    ({ qphp_t(n) *__qphp = (heap); __qphp; })
+
+/* Getters */
+#define qphp_len(n, heap)         ({ const qphp_t(n) *__heap = (heap);       \
+                                     __heap->len; })
+#define qphp_is_empty(n, heap)    (!qphp_len(n, (heap)))
+#define qphp_first(n, heap)       qphp_##n##_first(heap)
+
+/*1}}}*/
+
 #endif /* IS_LIB_COMMON_CONTAINER_HEAP_H */
@@ -263,6 +263,33 @@ qhhash_ptr_equal(const qhhash_t *qhh, const qhash_t *qh,
         return pfx##_find_safe_h(qhh, pfx##_hash(qhh, key), key);            \
     }
 
+#define __QHH_FILE(pfx, hpfx)                                                \
+    __unused__                                                               \
+    static inline int pfx##_dump(pfx##_t *qhh, int fd)                       \
+    {                                                                        \
+        for (int it = 0; it < countof(qhh->buckets); it++) {                 \
+            RETHROW(hpfx##_dump(&qhh->buckets[it].qm, fd));                  \
+        }                                                                    \
+        return 0;                                                            \
+    }                                                                        \
+                                                                             \
+    __unused__                                                               \
+    static inline ssize_t pfx##_attach(pfx##_t *qhh, const void *mem,        \
+                                       size_t len)                           \
+    {                                                                        \
+        const uint8_t *p = mem;                                              \
+        size_t pos = 0;                                                      \
+                                                                             \
+        qhh->hdr.len = 0;                                                    \
+        for (int it = 0; it < countof(qhh->buckets); it++) {                 \
+            hpfx##_t *bucket = &qhh->buckets[it].qm;                         \
+                                                                             \
+            pos += RETHROW(hpfx##_attach(bucket, p + pos, len - pos));       \
+            qhh->hdr.len += bucket->qh.hdr.len;                              \
+        }                                                                    \
+        return pos;                                                          \
+    }
+
 /* }}} */
 /* macro for QHH {{{ */
 
@@ -328,6 +355,7 @@ qhhash_ptr_equal(const qhhash_t *qhh, const qhash_t *qh,
     __QHH_BASE(pfx, name, qh_u##sfx, bucket_count, key_t const, key_t *,     \
                qhhash_hash_u##sfx);                                          \
     __QHH_FIND(pfx, name, qh_u##sfx, key_t const);                           \
+    __QHH_FILE(pfx, qh_u##sfx);                                              \
     __QHH_ADD(pfx, name, qh_u##sfx, key_t);                                  \
                                                                              \
 
@@ -352,6 +380,7 @@ qhhash_ptr_equal(const qhhash_t *qhh, const qhash_t *qh,
                key_t *, hf);                                                 \
     __QHH_EQUAL(pfx, name, qh_qhh_##name, ckey_t *, ef);                     \
     __QHH_FIND(pfx, name, qh_qhh_##name, ckey_t *);                          \
+    __QHH_FILE(pfx, qh_qhh_##name);                                          \
     __QHH_ADD(pfx, name, qh_qhh_##name, ckey_t *)
 
 /* }}} */
@@ -440,6 +469,7 @@ qhhash_ptr_equal(const qhhash_t *qhh, const qhash_t *qh,
     __QHH_BASE(pfx, name, qm_qhm_##name, bucket_count, key_t const,          \
                key_t *, qhhash_hash_u##sfx);                                 \
     __QHH_FIND(pfx, name, qm_qhm_##name, key_t const);                       \
+    __QHH_FILE(pfx, qm_qhm_##name);                                          \
     __QHM_ADD(pfx, name, qm_qhm_##name, key_t, val_t)
 
 #define __QHM_PKEY(pfx, name, qmc_t, bkey_t, ckey_t, key_t, val_t, hf, ef,   \
@@ -463,6 +493,7 @@ qhhash_ptr_equal(const qhhash_t *qhh, const qhash_t *qh,
                key_t *, hf);                                                 \
     __QHH_EQUAL(pfx, name, qm_qhm_##name, ckey_t *, ef);                     \
     __QHH_FIND(pfx, name, qm_qhm_##name, ckey_t *);                          \
+    __QHH_FILE(pfx, qm_qhm_##name);                                          \
     __QHM_ADD(pfx, name, qm_qhm_##name, ckey_t *, val_t)
 
 
@@ -517,6 +548,9 @@ qhhash_ptr_equal(const qhhash_t *qhh, const qhash_t *qh,
 #define qhh_add_h(name, qhh, h, key)        qhh_##name##_add_h(qhh, h, key)
 #define qhh_replace(name, qhh, key)         qhh_##name##_replace(qhh, key)
 #define qhh_replace_h(name, qhh, h, key)    qhh_##name##_replace_h(qhh, h, key)
+/* see qm_dump() and qm_attach(), the buckets are dumped one after another */
+#define qhh_dump(name, qhh, fd)             qhh_##name##_dump(qhh, fd)
+#define qhh_attach(name, qhh, mem, len)     qhh_##name##_attach(qhh, mem, len)
 
 #define mp_qhh_init(name, mp, qhh, sz)                                       \
     ({                                                                       \
@@ -667,6 +701,8 @@ qhhash_ptr_equal(const qhhash_t *qhh, const qhash_t *qh,
 #define qhm_add_h(name, qhm, h, key, v)     qhm_##name##_add_h(qhm, h, key, v)
 #define qhm_replace(name, qhm, key, v)      qhm_##name##_replace(qhm, key, v)
 #define qhm_replace_h(name, qhm, h, key, v) qhm_##name##_replace_h(qhm, h, key, v)
+#define qhm_dump(name, qhm, fd)             qhm_##name##_dump(qhm, fd)
+#define qhm_attach(name, qhm, mem, len)     qhm_##name##_attach(qhm, mem, len)
 
 #define mp_qhm_init(name, mp, qhm, sz)                                       \
     ({                                                                       \
@@ -70,6 +70,9 @@ void  __qvector_grow(qvector_t * nonnull , size_t v_size, size_t v_align,
 void  __qvector_optimize(qvector_t * nonnull, size_t v_size, size_t v_align,
                          size_t size)
     __leaf;
+void  __qvector_reserve_huge(qvector_t * nonnull, size_t v_size,
+                             size_t v_align, int size)
+    __leaf;
 void * nonnull __qvector_splice(qvector_t * nonnull, size_t v_size,
                                 size_t v_align, int pos, int rm_len,
                                 int inserted_len)
@@ -377,6 +380,17 @@ qvector_splice(qvector_t * nonnull vec, size_t v_size, size_t v_align,
             qv_delete(__vecp);                                               \
         } })
 
+/** Get the memory allocated for the elements of a vector.
+ *
+ * This is its capacity, not its length. A vector on a static or stack
+ * buffer (qv_init_static(), qv_inita()) has no allocated memory.
+ */
+#define qv_memory_footprint(vec)                                             \
+    ({  const typeof(*(vec)) *__mf_vec = (vec);                              \
+        __mf_vec->mp == &mem_pool_static ? (size_t)0                         \
+                                         : (size_t)__mf_vec->size            \
+                                         * __qv_sz(__mf_vec); })
+
 #define qv_new(n)  p_new(qv_t(n), 1)
 
 #define mp_qv_new(n, mp, sz)                                                 \
@@ -476,6 +490,18 @@ qvector_splice(qvector_t * nonnull vec, size_t v_size, size_t v_align,
     ({ (__qv_typeof(vec) *)qvector_growlen(&(vec)->qv, __qv_sz(vec),         \
                                            __qv_align(vec), (extra)); })
 
+/** Reserve room for \p size elements in a vector known to become large.
+ *
+ * A vector of the libc pool is moved to mem_pool_mremap right away instead
+ * of waiting for it to reach MEM_MREMAP_THRESHOLD bytes: the pages of the
+ * reserved room are only used once written, and the next reallocations
+ * only move the pages instead of copying the data.
+ *
+ * The vectors of the other pools are simply grown.
+ */
+#define qv_reserve_huge(vec, size)                                           \
+    __qvector_reserve_huge(&(vec)->qv, __qv_sz(vec), __qv_align(vec), (size))
+
 /** Get the amount of memory needed to perform such grow call.
  *
  * Parameters are identical to \ref qv_grow ones.
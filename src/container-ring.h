@@ -65,6 +65,12 @@ void generic_ring_ensure(generic_ring *r, int newlen, int el_siz)
     }                                                                  \
                                                                        \
     __unused__                                                         \
+    static inline size_t                                               \
+    pfx##_ring_memory_footprint(const pfx##_ring *r) {                 \
+        return (size_t)r->size * sizeof(type_t);                       \
+    }                                                                  \
+                                                                       \
+    __unused__                                                         \
     static inline int pfx##_ring_pos(pfx##_ring *r, int idx) {         \
         int pos = r->first + idx;                                      \
         return pos >= r->size ? pos - r->size : pos;                   \
@@ -23,6 +23,8 @@
 
 #include <lib-common/container-dlist.h>
 #include <lib-common/container-htlist.h>
+#include <lib-common/container-mring.h>
+#include <lib-common/container-qbtree.h>
 #include <lib-common/container-qhash.h>
 #include <lib-common/container-qhugehash.h>
 #include <lib-common/container-qvector.h>
@@ -0,0 +1,86 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <sys/mman.h>
+
+#include <lib-common/container-mring.h>
+#include <lib-common/unix.h>
+
+int mring_init(mring_t *r, uint32_t size)
+{
+    char *buf;
+    int fd;
+
+    p_clear(r, 1);
+    if (!size || size > UINT32_MAX / 2 - PAGE_SIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+    size = ROUND_UP(size, PAGE_SIZE);
+
+    fd = RETHROW(memfd_create("mring", MFD_CLOEXEC));
+    if (ftruncate(fd, size) < 0) {
+        goto error;
+    }
+
+    /* reserve the address space of both copies, then map the file twice
+     * over it */
+    buf = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS,
+               -1, 0);
+    if (buf == MAP_FAILED) {
+        goto error;
+    }
+    if (mmap(buf, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+             fd, 0) == MAP_FAILED
+    ||  mmap(buf + size, size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        PROTECT_ERRNO(munmap(buf, 2 * size));
+        goto error;
+    }
+    p_close(&fd);
+
+    r->buf  = buf;
+    r->size = size;
+    return 0;
+
+  error:
+    PROTECT_ERRNO(p_close(&fd));
+    return -1;
+}
+
+void mring_wipe(mring_t *r)
+{
+    if (r->buf) {
+        munmap(r->buf, 2 * r->size);
+    }
+    p_clear(r, 1);
+}
+
+int mring_read(mring_t *r, int fd)
+{
+    int res;
+
+    if (!mring_avail(r)) {
+        errno = ENOBUFS;
+        return -1;
+    }
+    res = RETHROW(read(fd, mring_wptr(r), mring_avail(r)));
+    r->len += res;
+    return res;
+}
@@ -19,6 +19,14 @@
 #include <lib-common/container-qhash.h>
 #include <lib-common/container-qvector.h>
 #include <lib-common/arith.h>
+#include <lib-common/unix.h>
+
+#ifdef __SSE2__
+#   pragma push_macro("__leaf")
+#   undef __leaf
+#   include <emmintrin.h>
+#   pragma pop_macro("__leaf")
+#endif
 
 #define QH_SETBITS_MASK  ((size_t)0x5555555555555555ULL)
 
@@ -139,6 +147,413 @@ static void qhash_resize_done(qhash_t *qh)
     mp_delete(hdr->mp, &qh->old);
 }
 
+/* {{{ Swiss tables */
+
+/* The position of the group of a key is taken in the high half of the mixed
+ * hash and its control byte in the low half, so that the integers that are
+ * their own hash are spread too. */
+static ALWAYS_INLINE uint64_t qhash_swiss_mix(uint32_t h)
+{
+    return h * 0x9e3779b97f4a7c15ULL;
+}
+
+static ALWAYS_INLINE uint32_t qhash_swiss_pos(uint64_t m, uint32_t mask)
+{
+    return (m >> 32) & mask & ~(QHASH_SWISS_GROUP - 1);
+}
+
+static ALWAYS_INLINE uint8_t qhash_swiss_h2(uint64_t m)
+{
+    return (m >> 25) & 0x7f;
+}
+
+#ifdef __SSE2__
+
+/* The groups are aligned, so that a group never straddles the end of the
+ * control bytes. */
+static ALWAYS_INLINE uint32_t qhash_swiss_match(const uint8_t *ctrl,
+                                                uint8_t c)
+{
+    __m128i group = _mm_load_si128((const __m128i *)ctrl);
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(c)));
+}
+
+/* EMPTY and DELETED are the only control bytes with the high bit set. */
+static ALWAYS_INLINE uint32_t qhash_swiss_avail(const uint8_t *ctrl)
+{
+    return _mm_movemask_epi8(_mm_load_si128((const __m128i *)ctrl));
+}
+
+#else
+
+static ALWAYS_INLINE uint32_t qhash_swiss_match(const uint8_t *ctrl,
+                                                uint8_t c)
+{
+    uint32_t res = 0;
+
+    for (int i = 0; i < QHASH_SWISS_GROUP; i++) {
+        res |= (uint32_t)(ctrl[i] == c) << i;
+    }
+    return res;
+}
+
+static ALWAYS_INLINE uint32_t qhash_swiss_avail(const uint8_t *ctrl)
+{
+    uint32_t res = 0;
+
+    for (int i = 0; i < QHASH_SWISS_GROUP; i++) {
+        res |= (uint32_t)(ctrl[i] >> 7) << i;
+    }
+    return res;
+}
+
+#endif
+
+/* Size of the table for its current length: it is at most 7/12th full
+ * after a resize, so that it doubles when it is 7/8th full. */
+static uint32_t qhash_swiss_get_size(const qhash_t *qh)
+{
+    uint64_t want = 3 * ((uint64_t)qh->hdr.len + 1) / 2;
+    uint64_t size = QHASH_SWISS_GROUP;
+
+    while (size * 7 / 8 < want || size < qh->minsize) {
+        size *= 2;
+    }
+    if (unlikely(size > (1U << 31)))
+        e_panic("out of memory");
+    return size;
+}
+
+static bool qhash_swiss_should_resize(const qhash_t *qh)
+{
+    const qhash_hdr_t *hdr = &qh->hdr;
+
+    if (unlikely(((uint64_t)hdr->len + qh->ghosts + 1) * 8 >
+                 (uint64_t)hdr->size * 7))
+    {
+        return true;
+    }
+    if (unlikely(hdr->size < qh->minsize)) {
+        return true;
+    }
+    if (unlikely(hdr->size > QHASH_SWISS_GROUP && hdr->len < hdr->size / 16))
+    {
+        return qhash_swiss_get_size(qh) < hdr->size;
+    }
+    return false;
+}
+
+/* Allocate an empty table of newsize slots in qh, the previous arrays are
+ * left in old to be rehashed. */
+static void qhash_swiss_alloc(qhash_t *qh, qhash_t *old, uint32_t newsize)
+{
+    mem_pool_t *mp = qh->hdr.mp;
+
+    *old = *qh;
+    qh->swiss    = true;
+    qh->ghosts   = 0;
+    qh->hdr.len  = 0;
+    qh->hdr.size = newsize;
+    qh->hdr.bits = mp_imalloc(mp, newsize, QHASH_SWISS_GROUP, MEM_RAW);
+    memset(qh->hdr.bits, QHASH_SWISS_EMPTY, newsize);
+    qh->keys = mp_imalloc(mp, (size_t)newsize * qh->k_size,
+                          __BIGGEST_ALIGNMENT__, MEM_RAW);
+    if (qh->v_size) {
+        qh->values = mp_imalloc(mp, (size_t)newsize * qh->v_size,
+                                __BIGGEST_ALIGNMENT__, MEM_RAW);
+    }
+    if (qh->h_size) {
+        qh->hashes = mp_imalloc(mp, (size_t)newsize * 4, 4, MEM_RAW);
+    }
+}
+
+static void qhash_swiss_release(qhash_t *old)
+{
+    mem_pool_t *mp = old->hdr.mp;
+
+    mp_delete(mp, &old->hdr.bits);
+    mp_delete(mp, &old->keys);
+    mp_delete(mp, &old->values);
+    mp_delete(mp, &old->hashes);
+}
+
+static uint32_t qhash_swiss_scan(const qhash_t *qh, uint32_t pos)
+{
+    const uint8_t *ctrl = (const uint8_t *)qh->hdr.bits;
+
+    while (pos < qh->hdr.size) {
+        uint32_t group = pos & ~(QHASH_SWISS_GROUP - 1);
+        uint32_t full  = ~qhash_swiss_avail(ctrl + group) & 0xffff;
+
+        full &= 0xffff << (pos - group);
+        if (full) {
+            return group + bsf32(full);
+        }
+        pos = group + QHASH_SWISS_GROUP;
+    }
+    return UINT32_MAX;
+}
+
+void qhash_swiss_del_at(qhash_t *qh, uint32_t pos)
+{
+    uint8_t *ctrl = (uint8_t *)qh->hdr.bits;
+
+    if (unlikely(pos >= qh->hdr.size) || (ctrl[pos] & 0x80)) {
+        return;
+    }
+
+    /* No key lives past a group that has an empty slot on its probe
+     * sequence, so the slot needs no tombstone in that case. */
+    if (qhash_swiss_match(ctrl + (pos & ~(QHASH_SWISS_GROUP - 1)),
+                          QHASH_SWISS_EMPTY))
+    {
+        ctrl[pos] = QHASH_SWISS_EMPTY;
+    } else {
+        ctrl[pos] = QHASH_SWISS_DELETED;
+        qh->ghosts++;
+    }
+    qh->hdr.len--;
+}
+
+/* }}} */
+/* {{{ Compact tables */
+
+/* hdr.bits points to the bitmap of the live entries of the dense arrays,
+ * followed by the hdr.size slots of the index. A set slot holds the dense
+ * position of its entry plus one in its low bits (the ones of the mask of
+ * the index) and the same high bits as the mixed hash of the entry, the
+ * "tag", so that few keys of other entries are compared. The dense entries
+ * are never more than 3/4 of the slots, so that the low bits of a set slot
+ * are never all ones, and QHASH_COMPACT_DELETED is unambiguous.
+ *
+ * The deleted entries are ghosts: they keep their dense position until the
+ * next rebuild, which packs the live entries at the front of the dense
+ * arrays, so that the entries in use are always hdr.len + ghosts. */
+
+static ALWAYS_INLINE uint32_t qhash_compact_tag(uint64_t m, uint32_t mask)
+{
+    return (uint32_t)m & ~mask;
+}
+
+static ALWAYS_INLINE uint32_t *qhash_compact_slots(const qhash_t *qh)
+{
+    return (uint32_t *)(qh->hdr.bits
+                        + BITS_TO_ARRAY_LEN(size_t, qh->hdr.size));
+}
+
+static ALWAYS_INLINE uint32_t qhash_compact_used(const qhash_t *qh)
+{
+    return qh->hdr.len + (qh->ghosts == UINT32_MAX ? 0 : qh->ghosts);
+}
+
+/* Allocated length of the dense arrays holding n entries: 16, 24, 32, 48,
+ * 64, ... so that they grow by 1.5 or 1.33 at a time. */
+static uint32_t qhash_compact_cap(uint32_t n)
+{
+    uint32_t cap;
+
+    if (n <= 16) {
+        return n ? 16 : 0;
+    }
+    cap = 1U << bsr32(n - 1);
+    return n <= cap + cap / 2 ? cap + cap / 2 : 2 * cap;
+}
+
+/* Size of the index for the current length: it is at most 3/8th full after
+ * a rebuild, so that it doubles when it is 3/4th full. */
+static uint32_t qhash_compact_get_size(const qhash_t *qh)
+{
+    uint64_t want = (uint64_t)qh->hdr.len + 1;
+    uint64_t size = 16;
+
+    while (size * 3 / 8 < want || size < qh->minsize) {
+        size *= 2;
+    }
+    if (unlikely(size > (1U << 31)))
+        e_panic("out of memory");
+    return size;
+}
+
+static bool qhash_compact_should_resize(const qhash_t *qh)
+{
+    const qhash_hdr_t *hdr = &qh->hdr;
+
+    if (unlikely(((uint64_t)qhash_compact_used(qh) + 1) * 4 >
+                 (uint64_t)hdr->size * 3))
+    {
+        return true;
+    }
+    if (unlikely(hdr->size < qh->minsize)) {
+        return true;
+    }
+    if (unlikely(hdr->size > 16 && hdr->len < hdr->size / 16)) {
+        return qhash_compact_get_size(qh) < hdr->size;
+    }
+    return false;
+}
+
+static void qhash_compact_realloc(qhash_t *qh, uint32_t from, uint32_t to)
+{
+    mem_pool_t *mp = qh->hdr.mp;
+    size_t from_cap = qhash_compact_cap(from);
+    size_t to_cap = qhash_compact_cap(to);
+
+    if (from_cap == to_cap) {
+        return;
+    }
+    if (!to_cap) {
+        mp_delete(mp, &qh->keys);
+        mp_delete(mp, &qh->values);
+        mp_delete(mp, &qh->hashes);
+        return;
+    }
+    qh->keys = mp_irealloc(mp, qh->keys, from_cap * qh->k_size,
+                           to_cap * qh->k_size, __BIGGEST_ALIGNMENT__,
+                           MEM_RAW);
+    if (qh->v_size) {
+        qh->values = mp_irealloc(mp, qh->values, from_cap * qh->v_size,
+                                 to_cap * qh->v_size, __BIGGEST_ALIGNMENT__,
+                                 MEM_RAW);
+    }
+    qh->hashes = mp_irealloc(mp, qh->hashes, from_cap * 4, to_cap * 4, 4,
+                             MEM_RAW);
+}
+
+/* Pack the live entries at the front of the dense arrays and rebuild an
+ * index of newsize slots from their cached hashes, without looking at the
+ * keys. */
+static void qhash_compact_rebuild(qhash_t *qh, uint32_t newsize)
+{
+    uint32_t used = qhash_compact_used(qh);
+    uint32_t len  = qh->hdr.len;
+    uint32_t mask = newsize - 1;
+    uint64_t k_size = qh->k_size;
+    uint64_t v_size = qh->v_size;
+    size_t   words = BITS_TO_ARRAY_LEN(size_t, newsize);
+    size_t  *bits;
+    uint32_t *slots;
+
+    if (used != len) {
+        uint32_t dst = 0;
+
+        for (uint32_t pos = 0; pos < used; pos++) {
+            if (!TST_BIT(qh->hdr.bits, pos)) {
+                continue;
+            }
+            if (dst != pos) {
+                memcpy(qh->keys + k_size * dst, qh->keys + k_size * pos,
+                       k_size);
+                if (v_size) {
+                    memcpy(qh->values + v_size * dst,
+                           qh->values + v_size * pos, v_size);
+                }
+                qh->hashes[dst] = qh->hashes[pos];
+            }
+            dst++;
+        }
+    }
+    qhash_compact_realloc(qh, used, len);
+
+    bits = mp_imalloc(qh->hdr.mp, sizeof(size_t) * words + 4 * newsize,
+                      __BIGGEST_ALIGNMENT__, 0);
+    for (uint32_t i = 0; i < len / bitsizeof(size_t); i++) {
+        bits[i] = ~(size_t)0;
+    }
+    for (uint32_t pos = len & -bitsizeof(size_t); pos < len; pos++) {
+        SET_BIT(bits, pos);
+    }
+    slots = (uint32_t *)(bits + words);
+    for (uint32_t pos = 0; pos < len; pos++) {
+        uint64_t m = qhash_swiss_mix(qh->hashes[pos]);
+        uint32_t i = (m >> 32) & mask;
+
+        for (uint32_t step = 1; slots[i]; i = (i + step++) & mask) {
+            continue;
+        }
+        slots[i] = qhash_compact_tag(m, mask) | (pos + 1);
+    }
+
+    mp_delete(qh->hdr.mp, &qh->hdr.bits);
+    qh->hdr.bits = bits;
+    qh->hdr.size = newsize;
+    qh->ghosts   = 0;
+    qh->compact  = true;
+    qh->h_size   = 1;
+}
+
+/* Add a live entry at the end of the dense arrays, the caller fills its
+ * key and value. */
+static uint32_t qhash_compact_append(qhash_t *qh, uint32_t h)
+{
+    uint32_t pos = qhash_compact_used(qh);
+
+    qhash_compact_realloc(qh, pos, pos + 1);
+    SET_BIT(qh->hdr.bits, pos);
+    qh->hashes[pos] = h;
+    qh->hdr.len++;
+    return pos;
+}
+
+static uint32_t qhash_compact_scan(const qhash_t *qh, uint32_t pos)
+{
+    uint32_t used = qhash_compact_used(qh);
+
+    while (pos < used) {
+        size_t word = qh->hdr.bits[pos / bitsizeof(size_t)];
+
+        word >>= pos % bitsizeof(size_t);
+        if (word) {
+            pos += bsfsz(word);
+            return pos < used ? pos : UINT32_MAX;
+        }
+        pos = (pos & -bitsizeof(size_t)) + bitsizeof(size_t);
+    }
+    return UINT32_MAX;
+}
+
+static void qhash_compact_seal_(qhash_t *qh)
+{
+#ifndef NDEBUG
+    e_assert(panic, qh->ghosts != UINT32_MAX, "hash table already sealed");
+#endif
+
+    if (qh->ghosts || qhash_compact_should_resize(qh)) {
+        qhash_compact_rebuild(qh, qhash_compact_get_size(qh));
+    }
+    qh->ghosts = UINT32_MAX;
+}
+
+void qhash_compact_del_at(qhash_t *qh, uint32_t pos)
+{
+    const uint32_t mask = qh->hdr.size - 1;
+    uint32_t *slots;
+    uint32_t  slot;
+    uint64_t  m;
+    uint32_t  i;
+
+    if (unlikely(pos >= qhash_compact_used(qh))
+    ||  !TST_BIT(qh->hdr.bits, pos))
+    {
+        return;
+    }
+
+    /* the slot of the entry is found from its cached hash */
+    slots = qhash_compact_slots(qh);
+    m     = qhash_swiss_mix(qh->hashes[pos]);
+    slot  = qhash_compact_tag(m, mask) | (pos + 1);
+    i     = (m >> 32) & mask;
+    for (uint32_t step = 1; slots[i] != slot; i = (i + step++) & mask) {
+        continue;
+    }
+    slots[i] = QHASH_COMPACT_DELETED;
+    RST_BIT(qh->hdr.bits, pos);
+    qh->hdr.len--;
+    qh->ghosts++;
+}
+
+/* }}} */
+
 void qhash_init(qhash_t *qh, uint16_t k_size, uint16_t v_size, bool doh,
                 mem_pool_t *mp)
 {
@@ -153,8 +568,14 @@ void qhash_set_minsize(qhash_t *qh, uint32_t minsize)
 {
     if (minsize) {
         qh->minsize = qhash_get_size(2 * (uint64_t)minsize);
-        if (!qh->old && qh->hdr.size < qh->minsize)
+        /* An empty table is sized by its first insertion, which knows
+         * whether it is a swiss one, and a swiss one grows at the next
+         * insertion. */
+        if (!qh->swiss && !qh->compact && !qh->old && qh->hdr.size
+        &&  qh->hdr.size < qh->minsize)
+        {
             qhash_resize_start(qh);
+        }
     } else {
         qh->minsize = 0;
     }
@@ -184,6 +605,14 @@ void qhash_clear(qhash_t *qh)
         mp_delete(qh->hdr.mp, &qh->old->bits);
         mp_delete(qh->hdr.mp, &qh->old);
     }
+    if (qh->swiss) {
+        memset(qh->hdr.bits, QHASH_SWISS_EMPTY, qh->hdr.size);
+    } else
+    if (qh->compact) {
+        qhash_compact_realloc(qh, qhash_compact_used(qh), 0);
+        p_clear(qh->hdr.bits, BITS_TO_ARRAY_LEN(size_t, qh->hdr.size));
+        p_clear(qhash_compact_slots(qh), qh->hdr.size);
+    } else
     if (qh->hdr.bits) {
         uint64_t size = qh->hdr.size;
 
@@ -202,6 +631,13 @@ uint32_t qhash_scan(const qhash_t *qh, uint32_t pos)
     size_t  maxsize = hdr->size;
     size_t *maxbits = hdr->bits;
 
+    if (qh->swiss) {
+        return qhash_swiss_scan(qh, pos);
+    }
+    if (qh->compact) {
+        return qhash_compact_scan(qh, pos);
+    }
+
     maxsize = 2 * maxsize;
     pos = 2 * pos;
 
@@ -260,6 +696,20 @@ size_t qhash_memory_footprint(const qhash_t *qh)
 
     max_size = qh->hdr.size;
     size = 0;
+    if (qh->swiss) {
+        size += max_size * (1 + qh->k_size + qh->v_size);
+        if (qh->h_size) {
+            size += max_size * 4;
+        }
+        return size;
+    }
+    if (qh->compact) {
+        size += sizeof(size_t) * BITS_TO_ARRAY_LEN(size_t, max_size);
+        size += max_size * 4;
+        size += (size_t)qhash_compact_cap(qhash_compact_used(qh))
+              * (qh->k_size + qh->v_size + 4);
+        return size;
+    }
     if (qh->old) {
         max_size = MAX(qh->hdr.size, qh->old->size);
         size += sizeof(qhash_hdr_t);
@@ -274,6 +724,149 @@ size_t qhash_memory_footprint(const qhash_t *qh)
     return size;
 }
 
+/* {{{ Files */
+
+/* A table is dumped as a header followed by its control bits, keys, values
+ * and cached hashes, each section being padded to QHASH_FILE_ALIGN. The
+ * file only holds sizes, so it can be mapped anywhere, but it is in the
+ * byte order of the host. */
+
+#define QHASH_FILE_MAGIC  0x31485151 /* "QQH1" */
+#define QHASH_FILE_ALIGN  64
+
+typedef struct qhash_file_hdr_t {
+    uint32_t magic;
+    uint32_t len;
+    uint32_t size;
+    uint16_t v_size;
+    uint8_t  k_size;
+    uint8_t  h_size;
+    bool     swiss;
+    bool     compact;
+    uint8_t  padding[QHASH_FILE_ALIGN - 18];
+} qhash_file_hdr_t;
+
+/* sizes of the sections, padding excluded */
+static void qhash_file_sections(const qhash_file_hdr_t *fh, size_t sizes[4])
+{
+    if (!fh->size) {
+        p_clear(sizes, 4);
+        return;
+    }
+    if (fh->compact) {
+        /* the dense arrays of a sealed compact table have no ghost */
+        sizes[0] = sizeof(size_t) * BITS_TO_ARRAY_LEN(size_t, fh->size)
+                 + (size_t)fh->size * 4;
+        sizes[1] = (size_t)fh->len * fh->k_size;
+        sizes[2] = (size_t)fh->len * fh->v_size;
+        sizes[3] = (size_t)fh->len * 4;
+        return;
+    }
+    sizes[0] = fh->swiss ? fh->size
+             : sizeof(size_t) * BITS_TO_ARRAY_LEN(size_t, 2 * fh->size);
+    sizes[1] = (size_t)fh->size * fh->k_size;
+    sizes[2] = (size_t)fh->size * fh->v_size;
+    sizes[3] = fh->h_size ? (size_t)fh->size * 4 : 0;
+}
+
+int qhash_dump(const qhash_t *qh, int fd)
+{
+    static uint8_t const zeros[QHASH_FILE_ALIGN];
+    qhash_file_hdr_t fh = {
+        .magic   = QHASH_FILE_MAGIC,
+        .len     = qh->hdr.len,
+        .size    = qh->hdr.size,
+        .v_size  = qh->v_size,
+        .k_size  = qh->k_size,
+        .h_size  = qh->h_size,
+        .swiss   = qh->swiss,
+        .compact = qh->compact,
+    };
+    const void *sections[4] = { qh->hdr.bits, qh->keys, qh->values,
+                                qh->hashes };
+    size_t sizes[4];
+    struct iovec iov[1 + 2 * countof(sizes)];
+    int iovcnt = 0;
+
+    if (qh->old || (qh->compact && qh->ghosts != UINT32_MAX)) {
+        /* the table must be sealed */
+        errno = EINVAL;
+        return -1;
+    }
+    qhash_file_sections(&fh, sizes);
+    iov[iovcnt++] = MAKE_IOVEC(&fh, sizeof(fh));
+    for (int i = 0; i < countof(sizes); i++) {
+        size_t pad = ROUND_UP(sizes[i], QHASH_FILE_ALIGN) - sizes[i];
+
+        if (sizes[i]) {
+            iov[iovcnt++] = MAKE_IOVEC(sections[i], sizes[i]);
+        }
+        if (pad) {
+            iov[iovcnt++] = MAKE_IOVEC(zeros, pad);
+        }
+    }
+    return xwritev(fd, iov, iovcnt) < 0 ? -1 : 0;
+}
+
+static ssize_t qhash_attach_mode(qhash_t *qh, const void *mem, size_t len,
+                                 bool swiss, bool compact)
+{
+    const qhash_file_hdr_t *fh = mem;
+    const uint8_t *p = mem;
+    size_t sizes[4];
+    const uint8_t *sections[4];
+
+    if ((uintptr_t)mem % QHASH_FILE_ALIGN || len < sizeof(*fh)
+    ||  fh->magic != QHASH_FILE_MAGIC || fh->swiss != swiss
+    ||  fh->compact != compact
+    ||  fh->k_size != qh->k_size || fh->v_size != qh->v_size
+    ||  (!compact && fh->h_size != qh->h_size) || fh->len > fh->size)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    qhash_file_sections(fh, sizes);
+    p += sizeof(*fh);
+    for (int i = 0; i < countof(sizes); i++) {
+        sections[i] = sizes[i] ? p : NULL;
+        p += ROUND_UP(sizes[i], QHASH_FILE_ALIGN);
+    }
+    if ((size_t)(p - (const uint8_t *)mem) > len) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    qhash_wipe(qh);
+    qhash_init(qh, fh->k_size, fh->v_size, fh->h_size, &mem_pool_static);
+    qh->hdr.bits = (size_t *)sections[0];
+    qh->hdr.len  = fh->len;
+    qh->hdr.size = fh->size;
+    qh->keys     = (uint8_t *)sections[1];
+    qh->values   = (uint8_t *)sections[2];
+    qh->hashes   = (uint32_t *)sections[3];
+    qh->swiss    = fh->swiss;
+    qh->compact  = fh->compact;
+    qh->ghosts   = UINT32_MAX;
+    return p - (const uint8_t *)mem;
+}
+
+ssize_t qhash_attach(qhash_t *qh, const void *mem, size_t len)
+{
+    return qhash_attach_mode(qh, mem, len, false, false);
+}
+
+ssize_t qhash_swiss_attach(qhash_t *qh, const void *mem, size_t len)
+{
+    return qhash_attach_mode(qh, mem, len, true, false);
+}
+
+ssize_t qhash_compact_attach(qhash_t *qh, const void *mem, size_t len)
+{
+    return qhash_attach_mode(qh, mem, len, false, true);
+}
+
+/* }}} */
+
 #define F(x)               x##32
 #define key_t              uint32_t
 #define getK(qh, pos)      (((key_t *)(qh)->keys)[pos])
@@ -303,6 +303,275 @@ uint32_t F(__qhash_put)(qhash_t *qh, uint32_t h, const key_t k, uint32_t flags _
     return collision | pos;
 }
 
+/* {{{ Swiss tables */
+
+static inline int32_t
+F(qhash_swiss_get_ll)(const qhash_t *qh, uint32_t h, const key_t k __F_PROTO)
+{
+    const uint8_t *ctrl = (const uint8_t *)qh->hdr.bits;
+    uint64_t m    = qhash_swiss_mix(h);
+    uint8_t  h2   = qhash_swiss_h2(m);
+    uint32_t mask = qh->hdr.size - 1;
+    uint32_t pos;
+
+    if (!qh->hdr.len)
+        return -1;
+
+    pos = qhash_swiss_pos(m, mask);
+    for (uint32_t step = QHASH_SWISS_GROUP;; step += QHASH_SWISS_GROUP) {
+        uint32_t match = qhash_swiss_match(ctrl + pos, h2);
+
+        while (match) {
+            uint32_t i = pos + bsf32(match);
+
+#ifdef MAY_CACHE_HASHES
+            if (!qh->hashes || qh->hashes[i] == h)
+#endif
+            {
+                if (iseqK(qh, getK(qh, i), k))
+                    return i;
+            }
+            match &= match - 1;
+        }
+        if (qhash_swiss_match(ctrl + pos, QHASH_SWISS_EMPTY))
+            return -1;
+        pos = (pos + step) & mask;
+    }
+}
+
+static inline uint32_t
+F(qhash_swiss_put_ll)(qhash_t *qh, bool check_collision, uint32_t h,
+                      const key_t k, uint64_t *out __F_PROTO)
+{
+    uint8_t *ctrl = (uint8_t *)qh->hdr.bits;
+    uint64_t m    = qhash_swiss_mix(h);
+    uint8_t  h2   = qhash_swiss_h2(m);
+    uint32_t mask = qh->hdr.size - 1;
+    uint32_t pos  = qhash_swiss_pos(m, mask);
+    uint32_t slot = UINT32_MAX;
+
+    for (uint32_t step = QHASH_SWISS_GROUP;; step += QHASH_SWISS_GROUP) {
+        if (check_collision) {
+            uint32_t match = qhash_swiss_match(ctrl + pos, h2);
+
+            while (match) {
+                uint32_t i = pos + bsf32(match);
+
+#ifdef MAY_CACHE_HASHES
+                if (!qh->hashes || qh->hashes[i] == h)
+#endif
+                {
+                    if (iseqK(qh, getK(qh, i), k)) {
+                        *out = i;
+                        return QHASH_COLLISION;
+                    }
+                }
+                match &= match - 1;
+            }
+        }
+        if (slot == UINT32_MAX) {
+            uint32_t avail = qhash_swiss_avail(ctrl + pos);
+
+            if (avail) {
+                slot = pos + bsf32(avail);
+                if (!check_collision)
+                    break;
+            }
+        }
+        /* the table is never full, so there is an empty slot somewhere on
+         * the probe sequence, which visits all the groups */
+        if (qhash_swiss_match(ctrl + pos, QHASH_SWISS_EMPTY))
+            break;
+        pos = (pos + step) & mask;
+    }
+
+    if (ctrl[slot] == QHASH_SWISS_DELETED)
+        qh->ghosts--;
+    ctrl[slot] = h2;
+    qh->hdr.len++;
+    *out = slot;
+    return 0;
+}
+
+static void F(qhash_swiss_rehash)(qhash_t *qh, uint32_t newsize __F_PROTO)
+{
+    uint64_t v_size = qh->v_size;
+    qhash_t  old;
+
+    qhash_swiss_alloc(qh, &old, newsize);
+    for (uint32_t pos = qhash_swiss_scan(&old, 0); pos != UINT32_MAX;
+         pos = qhash_swiss_scan(&old, pos + 1))
+    {
+        key_t    k = getK(&old, pos);
+        uint32_t h = hashK(&old, pos, k);
+        uint64_t newpos;
+
+        F(qhash_swiss_put_ll)(qh, false, h, k, &newpos __F_ARGS);
+        putK(qh, newpos, k);
+        if (v_size) {
+            memcpy(qh->values + v_size * newpos,
+                   old.values + v_size * pos, v_size);
+        }
+#ifdef MAY_CACHE_HASHES
+        if (qh->hashes)
+            qh->hashes[newpos] = h;
+#endif
+    }
+    qhash_swiss_release(&old);
+}
+
+void F(qhash_swiss_seal)(qhash_t *qh __F_PROTO)
+{
+#ifndef NDEBUG
+    e_assert(panic, qh->ghosts != UINT32_MAX, "hash table already sealed");
+#endif
+
+    if (qh->ghosts || qhash_swiss_should_resize(qh)) {
+        F(qhash_swiss_rehash)(qh, qhash_swiss_get_size(qh) __F_ARGS);
+    }
+    qh->ghosts = UINT32_MAX;
+}
+
+int32_t F(qhash_swiss_get)(qhash_t *qh, uint32_t h, const key_t k __F_PROTO)
+{
+#ifndef NDEBUG
+    e_assert(panic, qh->ghosts != UINT32_MAX,
+             "unsafe find operation performed on a sealed hash table");
+#endif
+
+    return F(qhash_swiss_get_ll)(qh, h, k __F_ARGS);
+}
+
+int32_t F(qhash_swiss_safe_get)(const qhash_t *qh, uint32_t h, const key_t k
+                                __F_PROTO)
+{
+    return F(qhash_swiss_get_ll)(qh, h, k __F_ARGS);
+}
+
+uint32_t F(__qhash_swiss_put)(qhash_t *qh, uint32_t h, const key_t k,
+                              uint32_t flags __F_PROTO)
+{
+    uint64_t pos, collision;
+
+#ifndef NDEBUG
+    e_assert(panic, qh->ghosts != UINT32_MAX,
+             "insert operation performed on a sealed hash table");
+#endif
+
+    if (qhash_swiss_should_resize(qh)) {
+        F(qhash_swiss_rehash)(qh, qhash_swiss_get_size(qh) __F_ARGS);
+    }
+    collision = F(qhash_swiss_put_ll)(qh, true, h, k, &pos __F_ARGS);
+#ifdef MAY_CACHE_HASHES
+    if (qh->hashes)
+        qh->hashes[pos] = h;
+#endif
+    return collision | pos;
+}
+
+/* }}} */
+/* {{{ Compact tables */
+
+static inline int32_t
+F(qhash_compact_get_ll)(const qhash_t *qh, uint32_t h, const key_t k
+                        __F_PROTO)
+{
+    const uint32_t *slots;
+    uint64_t m    = qhash_swiss_mix(h);
+    uint32_t mask = qh->hdr.size - 1;
+    uint32_t tag  = qhash_compact_tag(m, mask);
+    uint32_t pos;
+
+    if (!qh->hdr.len)
+        return -1;
+
+    slots = qhash_compact_slots(qh);
+    pos   = (m >> 32) & mask;
+    for (uint32_t step = 1;; pos = (pos + step++) & mask) {
+        uint32_t slot = slots[pos];
+
+        if (slot == QHASH_COMPACT_EMPTY)
+            return -1;
+        if ((slot & ~mask) == tag && slot != QHASH_COMPACT_DELETED) {
+            uint32_t i = (slot & mask) - 1;
+
+            if (iseqK(qh, getK(qh, i), k))
+                return i;
+        }
+    }
+}
+
+void F(qhash_compact_seal)(qhash_t *qh __F_PROTO)
+{
+    qhash_compact_seal_(qh);
+}
+
+int32_t F(qhash_compact_get)(qhash_t *qh, uint32_t h, const key_t k
+                             __F_PROTO)
+{
+#ifndef NDEBUG
+    e_assert(panic, qh->ghosts != UINT32_MAX,
+             "unsafe find operation performed on a sealed hash table");
+#endif
+
+    return F(qhash_compact_get_ll)(qh, h, k __F_ARGS);
+}
+
+int32_t F(qhash_compact_safe_get)(const qhash_t *qh, uint32_t h,
+                                  const key_t k __F_PROTO)
+{
+    return F(qhash_compact_get_ll)(qh, h, k __F_ARGS);
+}
+
+uint32_t F(__qhash_compact_put)(qhash_t *qh, uint32_t h, const key_t k,
+                                uint32_t flags __F_PROTO)
+{
+    uint32_t *slots;
+    uint64_t m;
+    uint32_t mask, tag, pos;
+    uint32_t ghost = UINT32_MAX;
+    uint32_t i;
+
+#ifndef NDEBUG
+    e_assert(panic, qh->ghosts != UINT32_MAX,
+             "insert operation performed on a sealed hash table");
+#endif
+
+    if (qhash_compact_should_resize(qh)) {
+        qhash_compact_rebuild(qh, qhash_compact_get_size(qh));
+    }
+
+    slots = qhash_compact_slots(qh);
+    m     = qhash_swiss_mix(h);
+    mask  = qh->hdr.size - 1;
+    tag   = qhash_compact_tag(m, mask);
+    pos   = (m >> 32) & mask;
+    for (uint32_t step = 1;; pos = (pos + step++) & mask) {
+        uint32_t slot = slots[pos];
+
+        if (slot == QHASH_COMPACT_EMPTY)
+            break;
+        if (slot == QHASH_COMPACT_DELETED) {
+            if (ghost == UINT32_MAX)
+                ghost = pos;
+            continue;
+        }
+        if ((slot & ~mask) == tag) {
+            i = (slot & mask) - 1;
+            if (iseqK(qh, getK(qh, i), k))
+                return QHASH_COLLISION | i;
+        }
+    }
+    if (ghost != UINT32_MAX)
+        pos = ghost;
+
+    i = qhash_compact_append(qh, h);
+    slots[pos] = tag | (i + 1);
+    return i;
+}
+
+/* }}} */
+
 #undef F
 #undef key_t
 #undef getK
@@ -20,13 +20,24 @@
 #include <lib-common/arith.h>
 #include <lib-common/bit-wah.h>
 
+#ifdef __SSE2__
+#   pragma push_macro("__leaf")
+#   undef __leaf
+#   include <emmintrin.h>
+#   pragma pop_macro("__leaf")
+#endif
+
 //#define WAH_CHECK_NORMALIZED  1
 
 static struct {
     uint64_t bits_in_bucket;
+
+    /* minimum number of words of the chunks of wah_expr_eval() */
+    uint64_t expr_chunk_words;
 } bit_wah_g = {
 #define _G  bit_wah_g
-    .bits_in_bucket = 8 * (512ul << 20),
+    .bits_in_bucket   = 8 * (512ul << 20),
+    .expr_chunk_words = 1 << 15,
 };
 
 /* Word enumerator {{{ */
@@ -198,6 +209,64 @@ uint32_t wah_word_enum_skip0(wah_word_enum_t *en)
     return skipped;
 }
 
+/* Literal words of the current chunk, from the current one. */
+static ALWAYS_INLINE const uint32_t *
+wah_word_enum_literals(wah_word_enum_t *en)
+{
+    const qv_t(wah_word) *bucket = wah_word_enum_get_cur_bucket(en);
+
+    assert (en->state == WAH_ENUM_LITERAL);
+    return &bucket->tab[en->pos - en->remain_words].literal;
+}
+
+/* }}} */
+/* Literal words operations {{{ */
+
+/* The binary operations process the literal words of the operands by
+ * blocks, four words at a time when SSE2 is available, instead of one word
+ * per step of the enumerators. The complement masks are the `reverse` of
+ * the enumerators (0 or UINT32_MAX). */
+
+static void wah_words_or(uint32_t *dst, const uint32_t *src, uint32_t count)
+{
+    uint32_t i = 0;
+
+#ifdef __SSE2__
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i *)&dst[i]);
+        __m128i b = _mm_loadu_si128((const __m128i *)&src[i]);
+
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_or_si128(a, b));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] |= src[i];
+    }
+}
+
+static void wah_words_and(uint32_t *dst, const uint32_t *a, uint32_t a_not,
+                          const uint32_t *b, uint32_t b_not, uint32_t count)
+{
+    uint32_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i na = _mm_set1_epi32(a_not);
+    const __m128i nb = _mm_set1_epi32(b_not);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i va = _mm_loadu_si128((const __m128i *)&a[i]);
+        __m128i vb = _mm_loadu_si128((const __m128i *)&b[i]);
+
+        va = _mm_xor_si128(va, na);
+        vb = _mm_xor_si128(vb, nb);
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_and_si128(va, vb));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = (a[i] ^ a_not) & (b[i] ^ b_not);
+    }
+}
+
 /* }}} */
 /* Bit enumerator {{{ */
 
@@ -830,6 +899,37 @@ const void *wah_add_unaligned(wah_t *map, const uint8_t *src, uint64_t count)
     return src;
 }
 
+/* Number of leading words of src to add as literals.
+ *
+ * The runs shorter than WAH_MIN_RUN_WORDS words are kept in the literals:
+ * as a chunk header takes two words, a run of two words is not smaller than
+ * two literal words, and the dense regions are made of long literal chunks
+ * that are processed by blocks instead of alternating short runs and
+ * literals.
+ */
+#define WAH_MIN_RUN_WORDS  3
+
+static uint64_t wah_literal_words(const uint8_t *src, uint64_t count)
+{
+    for (uint64_t words = 0; words < count; words++) {
+        uint32_t word = get_unaligned_le32(src + 4 * words);
+
+        if (word == 0 || word == UINT32_MAX) {
+            uint64_t end = MIN(count, words + WAH_MIN_RUN_WORDS);
+            uint64_t pos = words + 1;
+
+            while (pos < end && get_unaligned_le32(src + 4 * pos) == word) {
+                pos++;
+            }
+            if (pos == end) {
+                return words;
+            }
+            words = pos - 1;
+        }
+    }
+    return count;
+}
+
 static void wah_add_literal(wah_t *map, const uint8_t *src, uint64_t count)
 {
     qv_t(wah_word) *bucket = tab_last(&map->_buckets);
@@ -864,22 +964,16 @@ void wah_add_aligned(wah_t *map, const uint8_t *src, uint64_t count)
     uint64_t exp_len = map->len + count;
 
     while (count >= 32) {
-        ssize_t run_length = 32;
-        bool    bit = false;
-
-        switch (get_unaligned_le32(src)) {
-          case 0:
-            bit = false;
-            break;
-
-          case UINT32_MAX:
-            bit = true;
-            break;
+        uint64_t words = wah_literal_words(src, count / 32);
+        ssize_t  run_length;
+        bool     bit;
 
-          default:
-            wah_add_literal(map, src, 4);
+        if (words) {
+            run_length = words * 32;
+            wah_add_literal(map, src, 4 * words);
             goto end;
         }
+        bit = get_unaligned_le32(src) == UINT32_MAX;
 
         run_length = bsf(src, 0, ROUND_2EXP(count, 32), bit);
         if (run_length < 0) {
@@ -1004,6 +1098,7 @@ void wah_and_(wah_t *map, const wah_t *other, bool map_not, bool other_not)
     const wah_t *src = t_wah_dup(map);
     wah_word_enum_t src_en   = wah_word_enum_start(src, map_not);
     wah_word_enum_t other_en = wah_word_enum_start(other, other_not);
+    uint32_t buffer[1024];
 
     wah_check_invariant(map);
     wah_reset_map(map);
@@ -1062,6 +1157,19 @@ void wah_and_(wah_t *map, const wah_t *other, bool map_not, bool other_not)
             }
             break;
 
+          case WAH_ENUM_LITERAL | (WAH_ENUM_LITERAL << 2): {
+            uint32_t count = MIN3(src_en.remain_words,
+                                  other_en.remain_words, countof(buffer));
+
+            wah_words_and(buffer, wah_word_enum_literals(&src_en),
+                          src_en.reverse, wah_word_enum_literals(&other_en),
+                          other_en.reverse, count);
+            wah_add_aligned(map, (const uint8_t *)buffer,
+                            count * WAH_BIT_IN_WORD);
+            wah_word_enum_skip(&src_en, count);
+            wah_word_enum_skip(&other_en, count);
+          } break;
+
           default:
             map->_pending = src_en.current & other_en.current;
             wah_push_pending(map, 1, bitcount32(map->_pending));
@@ -1145,12 +1253,6 @@ static void wah_add_en(wah_t *dest, wah_word_enum_t *en, uint64_t words)
     assert (exp_len == dest->len);
 }
 
-enum {
-    FLAG_RUN_0    = 0,
-    FLAG_LITTERAL = 1,
-    FLAG_RUN_1    = 0xff,
-};
-
 static uint64_t wah_word_enum_weight(const wah_word_enum_t *a)
 {
     switch (a->state) {
@@ -1177,7 +1279,6 @@ wah_t *wah_multi_or(const wah_t *src[], int len, wah_t * restrict dest)
     t_scope;
     qv_t(wah_word_enum) enums;
     uint32_t buffer[1024];
-    byte     buffer_flags[countof(buffer)];
     uint64_t exp_len = 0;
     uint64_t min_act = 0;
     uint64_t max_act = 0;
@@ -1276,7 +1377,9 @@ wah_t *wah_multi_or(const wah_t *src[], int len, wah_t * restrict dest)
             continue;
         }
 
-        p_clear(&buffer_flags, 1);
+        /* The next words of the sources are ORed in a plain bitset, whose
+         * runs of 0s and 1s are then compressed. */
+        p_clear(&buffer, 1);
         tab_for_each_pos_safe(pos, &enums) {
             uint32_t     remain  = countof(buffer);
             uint32_t     en_bits = 0;
@@ -1287,46 +1390,22 @@ wah_t *wah_multi_or(const wah_t *src[], int len, wah_t * restrict dest)
                 uint32_t to_consume = MIN(remain, en->remain_words);
 
                 switch (en->state) {
-                  case WAH_ENUM_LITERAL: {
-                    qv_t(wah_word) *bucket = wah_word_enum_get_cur_bucket(en);
-                    const uint32_t *data = (const uint32_t *)bucket->tab;
-
-                    data = &data[en->pos - en->remain_words];
-                    for (uint32_t i = 0; i < to_consume; i++) {
-                        if (buffer_flags[buf_pos + i] != FLAG_RUN_1) {
-                            if (buffer_flags[buf_pos + i] == FLAG_RUN_0) {
-                                buffer[buf_pos + i]  = data[i];
-                                buffer_flags[buf_pos + i] = FLAG_LITTERAL;
-                            } else {
-                                buffer[buf_pos + i] |= data[i];
-                            }
-                            if (buffer[buf_pos + i] == 0xffffffff) {
-                                buffer_flags[buf_pos + i] = FLAG_RUN_1;
-                            }
-                        }
-                    }
+                  case WAH_ENUM_LITERAL:
+                    wah_words_or(&buffer[buf_pos], wah_word_enum_literals(en),
+                                 to_consume);
                     en_bits += to_consume * 32;
-                  } break;
+                    break;
 
                   case WAH_ENUM_RUN:
                     if (en->current) {
-                        memset(&buffer_flags[buf_pos], 0xff, to_consume);
+                        memset(&buffer[buf_pos], 0xff,
+                               to_consume * sizeof(buffer[0]));
                     }
                     en_bits += to_consume * 32;
                     break;
 
                   case WAH_ENUM_PENDING:
-                    if (buffer_flags[buf_pos] != FLAG_RUN_1) {
-                        if (buffer_flags[buf_pos] == FLAG_RUN_0) {
-                            buffer[buf_pos] = en->current;
-                            buffer_flags[buf_pos] = FLAG_LITTERAL;
-                        } else {
-                            buffer[buf_pos] |= en->current;
-                            if (buffer[buf_pos] == 0xffffffff) {
-                                buffer_flags[buf_pos] = FLAG_RUN_1;
-                            }
-                        }
-                    }
+                    buffer[buf_pos] |= en->current;
                     en_bits += en->map->len % 32;
                     break;
 
@@ -1350,37 +1429,37 @@ wah_t *wah_multi_or(const wah_t *src[], int len, wah_t * restrict dest)
         buf_pos = 0;
         end_pos = DIV_ROUND_UP(bits, 32);
         while (buf_pos < end_pos) {
-            byte val = buffer_flags[buf_pos];
-            uint32_t end = buf_pos + 1;
+            uint32_t val = buffer[buf_pos];
+            uint32_t end = buf_pos;
+            bool     literal;
+            uint64_t count;
 
-            while (end < end_pos) {
-                if (buffer_flags[end] != val) {
-                    break;
+            end += wah_literal_words((const uint8_t *)&buffer[buf_pos],
+                                     end_pos - buf_pos);
+            literal = end > buf_pos;
+            if (!literal) {
+                while (end < end_pos && buffer[end] == val) {
+                    end++;
                 }
-                end++;
             }
+            count = MIN(32 * (end - buf_pos), bits);
 
-            switch (val) {
-              case FLAG_RUN_1:
-                wah_add1s(dest, 32 * (end - buf_pos));
-                break;
-
-              case FLAG_RUN_0:
-                wah_add0s(dest, 32 * (end - buf_pos));
-                break;
-
-              case FLAG_LITTERAL:
-                if (32 * (end - buf_pos) > bits) {
-                    wah_add_aligned(dest,  (const uint8_t *)&buffer[buf_pos],
-                                    bits);
+            if (literal) {
+                if (count < 32 * (end - buf_pos)) {
+                    wah_add_aligned(dest, (const uint8_t *)&buffer[buf_pos],
+                                    count);
                 } else {
                     wah_add_literal(dest, (const uint8_t *)&buffer[buf_pos],
                                     4 * (end - buf_pos));
                 }
-                break;
+            } else
+            if (val) {
+                wah_add1s(dest, count);
+            } else {
+                wah_add0s(dest, count);
             }
 
-            bits -= 32 * (end - buf_pos);
+            bits -= count;
             buf_pos = end;
         }
     }
@@ -1471,6 +1550,369 @@ bool wah_get(const wah_t *map, uint64_t pos)
 }
 
 /* }}} */
+/* Boolean expressions {{{ */
+
+wah_expr_t *t_wah_expr_map(const wah_t *map)
+{
+    wah_expr_t *expr = t_new(wah_expr_t, 1);
+
+    expr->op  = WAH_EXPR_MAP;
+    expr->map = map;
+    return expr;
+}
+
+wah_expr_t *t_wah_expr_new(wah_expr_op_t op, wah_expr_t * const operands[],
+                           int len)
+{
+    wah_expr_t *expr = t_new(wah_expr_t, 1);
+
+    assert (op != WAH_EXPR_MAP && len > 0);
+    assert (op != WAH_EXPR_NOT || len == 1);
+    expr->op = op;
+    t_qv_init(&expr->operands, len);
+    qv_extend(&expr->operands, operands, len);
+    return expr;
+}
+
+/* Append the bits [from * 32, from * 32 + count[ of src to map, the bits
+ * beyond the end of src are 0s. */
+static void wah_add_slice(wah_t *map, const wah_t *src, uint64_t from,
+                          uint64_t count)
+{
+    wah_word_enum_t en = wah_word_enum_start(src, false);
+
+    while (from > 0 && en.state != WAH_ENUM_END) {
+        uint32_t skip = MIN(from, UINT32_MAX);
+
+        wah_word_enum_skip(&en, skip);
+        from -= skip;
+    }
+    wah_add_en(map, &en, count / WAH_BIT_IN_WORD);
+    if (count % WAH_BIT_IN_WORD) {
+        wah_add(map, &en.current, count % WAH_BIT_IN_WORD);
+    }
+}
+
+/* Append src to map by copying its words.
+ *
+ * The chunks of src are appended after the last one of map, so this
+ * requires map to have no pending bits and src to fit in the last bucket of
+ * map, otherwise src is reencoded.
+ */
+static void wah_append_map(wah_t *map, const wah_t *src)
+{
+    qv_t(wah_word) *bucket = tab_last(&map->_buckets);
+    const qv_t(wah_word) *words = &src->_buckets.tab[0];
+    uint64_t bucket_len;
+    int base = bucket->len;
+    int skip = 0;
+    int prev = src->previous_run_pos;
+
+    assert (map->len % WAH_BIT_IN_WORD == 0);
+    bucket_len = map->len - (map->_buckets.len - 1) * _G.bits_in_bucket;
+    if (!map->len || src->_buckets.len > 1
+    ||  bucket_len + src->len > _G.bits_in_bucket)
+    {
+        wah_add_slice(map, src, 0, src->len);
+        return;
+    }
+
+    wah_check_invariant(src);
+    if (words->tab[0].head.words == 0) {
+        /* Only the first chunk of a bucket can start with literal words:
+         * merge them in the last chunk of map. */
+        *wah_last_run_count(map) += words->tab[1].count;
+        skip = 2;
+    }
+    qv_extend(bucket, words->tab + skip, words->len - skip);
+
+    if (src->last_run_pos > 0 || !skip) {
+        if (prev < 0) {
+            prev = src->last_run_pos ? -1 : map->last_run_pos;
+        } else {
+            prev = prev || !skip ? base + prev - skip : map->last_run_pos;
+        }
+        map->previous_run_pos = prev;
+        map->last_run_pos     = base + src->last_run_pos - skip;
+    }
+    map->len     += src->len;
+    map->active  += src->active;
+    map->_pending = src->_pending;
+    wah_check_invariant(map);
+}
+
+typedef struct wah_expr_plan_t wah_expr_plan_t;
+qvector_t(wah_expr_plan, wah_expr_plan_t *);
+
+/* Node of the evaluation plan of an expression: the double negations are
+ * removed, the nested ANDs and ORs are flattened and the operands of the
+ * ANDs are sorted by estimated density. */
+struct wah_expr_plan_t {
+    wah_expr_op_t        op;
+    const wah_t         *map;
+    double               density;
+    qv_t(wah_expr_plan)  operands;
+};
+
+static uint64_t wah_expr_len(const wah_expr_t *expr)
+{
+    uint64_t len = 0;
+
+    if (expr->op == WAH_EXPR_MAP) {
+        return expr->map->len;
+    }
+    tab_for_each_entry(operand, &expr->operands) {
+        len = MAX(len, wah_expr_len(operand));
+    }
+    return len;
+}
+
+static int wah_expr_plan_cmp(wah_expr_plan_t * const *a,
+                             wah_expr_plan_t * const *b)
+{
+    return CMP((*a)->density, (*b)->density);
+}
+
+static wah_expr_plan_t *t_wah_expr_plan(const wah_expr_t *expr, uint64_t len)
+{
+    wah_expr_plan_t *plan;
+
+    if (expr->op != WAH_EXPR_MAP && expr->operands.len == 1
+    &&  expr->op != WAH_EXPR_NOT)
+    {
+        return t_wah_expr_plan(expr->operands.tab[0], len);
+    }
+
+    plan = t_new(wah_expr_plan_t, 1);
+    plan->op = expr->op;
+    switch (expr->op) {
+      case WAH_EXPR_MAP:
+        plan->map     = expr->map;
+        plan->density = len ? (double)expr->map->active / len : 0;
+        return plan;
+
+      case WAH_EXPR_NOT: {
+        wah_expr_plan_t *operand = t_wah_expr_plan(expr->operands.tab[0],
+                                                   len);
+
+        if (operand->op == WAH_EXPR_NOT) {
+            return operand->operands.tab[0];
+        }
+        t_qv_init(&plan->operands, 1);
+        qv_append(&plan->operands, operand);
+        plan->density = 1 - operand->density;
+        return plan;
+      }
+
+      case WAH_EXPR_AND:
+      case WAH_EXPR_OR:
+        break;
+    }
+
+    /* Estimate the densities as if the maps were independent. */
+    t_qv_init(&plan->operands, expr->operands.len);
+    plan->density = 1;
+    tab_for_each_entry(e, &expr->operands) {
+        wah_expr_plan_t *operand = t_wah_expr_plan(e, len);
+
+        if (operand->op == plan->op) {
+            qv_extend(&plan->operands, operand->operands.tab,
+                      operand->operands.len);
+        } else {
+            qv_append(&plan->operands, operand);
+        }
+        if (plan->op == WAH_EXPR_AND) {
+            plan->density *= operand->density;
+        } else {
+            plan->density *= 1 - operand->density;
+        }
+    }
+    if (plan->op == WAH_EXPR_AND) {
+        qv_qsort(&plan->operands, &wah_expr_plan_cmp);
+    } else {
+        plan->density = 1 - plan->density;
+    }
+    return plan;
+}
+
+/* Range of words evaluated by a job. */
+typedef struct wah_expr_range_t {
+    uint64_t from;
+    uint64_t bits;
+
+    /* the range covers the whole maps, so the leaves are used in place */
+    bool     whole;
+} wah_expr_range_t;
+
+static void wah_expr_eval_range(const wah_expr_plan_t *plan,
+                                const wah_expr_range_t *range, wah_t *dest);
+
+static const wah_t *
+t_wah_expr_operand(const wah_expr_plan_t *plan, const wah_expr_range_t *range)
+{
+    wah_t *map;
+
+    if (plan->op == WAH_EXPR_MAP && range->whole) {
+        return plan->map;
+    }
+    map = t_wah_new(0);
+    wah_expr_eval_range(plan, range, map);
+    return map;
+}
+
+static void wah_expr_eval_and(const wah_expr_plan_t *plan,
+                              const wah_expr_range_t *range, wah_t *dest)
+{
+    int first = 0;
+
+    /* Start with the sparsest operand that is not negated, the negated
+     * operands are then subtracted. */
+    while (first < plan->operands.len
+       &&  plan->operands.tab[first]->op == WAH_EXPR_NOT)
+    {
+        first++;
+    }
+    if (first == plan->operands.len) {
+        first = 0;
+    }
+    wah_expr_eval_range(plan->operands.tab[first], range, dest);
+
+    tab_enumerate(pos, operand, &plan->operands) {
+        t_scope;
+
+        if (pos == first) {
+            continue;
+        }
+        if (!dest->active) {
+            break;
+        }
+        if (operand->op == WAH_EXPR_NOT) {
+            wah_and_not(dest, t_wah_expr_operand(operand->operands.tab[0],
+                                                 range));
+        } else {
+            wah_and(dest, t_wah_expr_operand(operand, range));
+        }
+    }
+}
+
+static void wah_expr_eval_or(const wah_expr_plan_t *plan,
+                             const wah_expr_range_t *range, wah_t *dest)
+{
+    t_scope;
+    const wah_t **srcs = t_new_raw(const wah_t *, plan->operands.len);
+
+    tab_enumerate(pos, operand, &plan->operands) {
+        srcs[pos] = t_wah_expr_operand(operand, range);
+    }
+    wah_multi_or(srcs, plan->operands.len, dest);
+}
+
+/* Evaluate a plan on a range in an empty map. */
+static void wah_expr_eval_range(const wah_expr_plan_t *plan,
+                                const wah_expr_range_t *range, wah_t *dest)
+{
+    switch (plan->op) {
+      case WAH_EXPR_MAP:
+        if (range->whole) {
+            wah_copy(dest, plan->map);
+        } else {
+            wah_add_slice(dest, plan->map, range->from, range->bits);
+        }
+        break;
+
+      case WAH_EXPR_AND:
+        wah_expr_eval_and(plan, range, dest);
+        break;
+
+      case WAH_EXPR_OR:
+        wah_expr_eval_or(plan, range, dest);
+        break;
+
+      case WAH_EXPR_NOT:
+        wah_expr_eval_range(plan->operands.tab[0], range, dest);
+        if (dest->len < range->bits) {
+            wah_add0s(dest, range->bits - dest->len);
+        }
+        wah_not(dest);
+        break;
+    }
+    if (dest->len < range->bits) {
+        wah_add0s(dest, range->bits - dest->len);
+    }
+}
+
+typedef struct wah_expr_job_t {
+    thr_job_t               job;
+    const wah_expr_plan_t  *plan;
+    wah_expr_range_t        range;
+    wah_t                  *res;
+} wah_expr_job_t;
+
+static void wah_expr_job_run(thr_job_t *job, thr_syn_t *syn)
+{
+    t_scope;
+    wah_expr_job_t *expr_job = container_of(job, wah_expr_job_t, job);
+
+    wah_expr_eval_range(expr_job->plan, &expr_job->range, expr_job->res);
+}
+
+wah_t *wah_expr_eval(const wah_expr_t *expr, wah_t * restrict dest)
+{
+    t_scope;
+    uint64_t len = wah_expr_len(expr);
+    uint64_t words = DIV_ROUND_UP(len, WAH_BIT_IN_WORD);
+    const wah_expr_plan_t *plan = t_wah_expr_plan(expr, len);
+    wah_expr_job_t *jobs;
+    uint64_t grain;
+    int nb_chunks;
+    thr_syn_t syn;
+
+    if (!dest) {
+        dest = wah_pool_acquire();
+    } else {
+        wah_reset_map(dest);
+    }
+
+    if (thr_parallelism_g <= 1 || words <= _G.expr_chunk_words) {
+        wah_expr_range_t range = { .bits = len, .whole = true };
+
+        wah_expr_eval_range(plan, &range, dest);
+        return dest;
+    }
+
+    /* About 4 chunks per thread so that the threads can balance the load,
+     * the first one is evaluated in dest and the results of the others are
+     * appended to it. */
+    grain     = MAX(DIV_ROUND_UP(words, thr_parallelism_g * 4),
+                    _G.expr_chunk_words);
+    nb_chunks = DIV_ROUND_UP(words, grain);
+    jobs      = t_new(wah_expr_job_t, nb_chunks);
+
+    thr_syn_init(&syn);
+    for (int i = 0; i < nb_chunks; i++) {
+        wah_expr_job_t *job = &jobs[i];
+        uint64_t from = i * grain;
+
+        job->job.run     = &wah_expr_job_run;
+        job->plan        = plan;
+        job->range.from  = from;
+        job->range.bits  = MIN(grain, words - from) * WAH_BIT_IN_WORD;
+        job->res         = i ? wah_pool_acquire() : dest;
+        if (i == nb_chunks - 1 && len % WAH_BIT_IN_WORD) {
+            job->range.bits -= WAH_BIT_IN_WORD - len % WAH_BIT_IN_WORD;
+        }
+        thr_syn_schedule(&syn, &job->job);
+    }
+    thr_syn_wait(&syn);
+    thr_syn_wipe(&syn);
+
+    for (int i = 1; i < nb_chunks; i++) {
+        wah_append_map(dest, jobs[i].res);
+        wah_pool_release(&jobs[i].res);
+    }
+    return dest;
+}
+
 /* Open/store existing WAH {{{ */
 
 typedef struct from_data_ctx_t {
@@ -1676,6 +2118,16 @@ uint64_t wah_get_storage_len(const wah_t *wah)
     return res;
 }
 
+size_t wah_memory_footprint(const wah_t *wah)
+{
+    size_t res = qv_memory_footprint(&wah->_buckets);
+
+    tab_for_each_ptr(bucket, &wah->_buckets) {
+        res += qv_memory_footprint(bucket);
+    }
+    return res;
+}
+
 /* }}} */
 /* Pool {{{ */
 
@@ -2263,6 +2715,161 @@ Z_GROUP_EXPORT(wah)
         wah_wipe(&map1);
     } Z_TEST_END;
 
+    Z_TEST(dense, "") {
+        /* Maps made of runs, and of dense regions where the literal words
+         * alternate with short runs, against plain bitsets. */
+        enum { NB_MAPS = 16, WORDS = 64 * 8 };
+        uint32_t bits[NB_MAPS + 1][WORDS];
+        uint32_t lens[NB_MAPS];
+        wah_t maps[NB_MAPS];
+        const wah_t *srcs[NB_MAPS];
+        wah_t *res;
+
+        p_clear(&bits, 1);
+        for (int i = 0; i < NB_MAPS; i++) {
+            wah_init(&maps[i]);
+            for (int chunk = 0; chunk < WORDS / 8; chunk++) {
+                uint32_t *words = &bits[i][chunk * 8];
+
+                switch (rand() % 3) {
+                  case 0:
+                    break;
+                  case 1:
+                    memset(words, 0xff, 8 * sizeof(uint32_t));
+                    break;
+                  default:
+                    for (int j = 0; j < 8; j++) {
+                        words[j] = rand() % 3 ? rand() : 0;
+                    }
+                    break;
+                }
+            }
+            lens[i] = WORDS * 32 - rand() % 70;
+            wah_add(&maps[i], bits[i], lens[i]);
+            for (uint32_t j = lens[i]; j < WORDS * 32; j++) {
+                RST_BIT(bits[i], j);
+            }
+            srcs[i] = &maps[i];
+        }
+
+        res = wah_multi_or(srcs, NB_MAPS, NULL);
+        p_clear(&bits[NB_MAPS], 1);
+        for (int i = 0; i < NB_MAPS; i++) {
+            for (int j = 0; j < WORDS; j++) {
+                bits[NB_MAPS][j] |= bits[i][j];
+            }
+        }
+        Z_ASSERT_EQ(res->active, membitcount(bits[NB_MAPS], sizeof(bits[0])));
+        for (uint64_t j = 0; j < res->len; j++) {
+            Z_ASSERT_EQ(wah_get(res, j), !!TST_BIT(bits[NB_MAPS], j),
+                        "bad bit at %ju", j);
+        }
+        wah_pool_release(&res);
+
+        for (int i = 0; i + 1 < NB_MAPS; i++) {
+            wah_t map;
+            uint64_t active = 0;
+
+            wah_init(&map);
+            wah_copy(&map, &maps[i]);
+            wah_and_not(&map, &maps[i + 1]);
+            for (uint64_t j = 0; j < map.len; j++) {
+                bool bit = TST_BIT(bits[i], j) && !TST_BIT(bits[i + 1], j);
+
+                Z_ASSERT_EQ(wah_get(&map, j), bit, "bad bit at %ju", j);
+                active += bit;
+            }
+            Z_ASSERT_EQ(map.active, active);
+            wah_wipe(&map);
+        }
+
+        for (int i = 0; i < NB_MAPS; i++) {
+            wah_wipe(&maps[i]);
+        }
+    } Z_TEST_END;
+
+    Z_TEST(expr, "") {
+        t_scope;
+        enum { NB_MAPS = 6, WORDS = 64 * 8 };
+        uint32_t bits[NB_MAPS][WORDS];
+        uint32_t res_bits[WORDS];
+        uint64_t len = 0;
+        wah_t maps[NB_MAPS];
+        wah_expr_t *leaves[NB_MAPS];
+        wah_expr_t *expr;
+        uint64_t chunk_words = _G.expr_chunk_words;
+
+        p_clear(&bits, 1);
+        for (int i = 0; i < NB_MAPS; i++) {
+            uint32_t map_len = WORDS * 32 - rand() % 1000;
+
+            wah_init(&maps[i]);
+            for (int j = 0; j < WORDS; j++) {
+                switch (rand() % 4) {
+                  case 0:
+                    break;
+                  case 1:
+                    bits[i][j] = UINT32_MAX;
+                    break;
+                  default:
+                    bits[i][j] = rand();
+                    break;
+                }
+            }
+            wah_add(&maps[i], bits[i], map_len);
+            for (uint32_t j = map_len; j < WORDS * 32; j++) {
+                RST_BIT(bits[i], j);
+            }
+            leaves[i] = t_wah_expr_map(&maps[i]);
+            len = MAX(len, map_len);
+        }
+
+        /* (m0 & (m1 | m2 | !m3) & !m4) | !(!m5 & m0) */
+        expr = t_wah_expr_or(
+            t_wah_expr_and(leaves[0],
+                           t_wah_expr_or(leaves[1], leaves[2],
+                                         t_wah_expr_not(leaves[3])),
+                           t_wah_expr_not(leaves[4])),
+            t_wah_expr_not(t_wah_expr_and(t_wah_expr_not(leaves[5]),
+                                          leaves[0])));
+        for (int j = 0; j < WORDS; j++) {
+            uint32_t or = bits[1][j] | bits[2][j] | ~bits[3][j];
+
+            res_bits[j] = (bits[0][j] & or & ~bits[4][j])
+                        | ~(~bits[5][j] & bits[0][j]);
+        }
+
+        /* Evaluate it in one piece, then in chunks on the threads. */
+        for (int pass = 0; pass < 2; pass++) {
+            wah_t *res;
+            uint64_t active = 0;
+
+            if (pass) {
+                MODULE_REQUIRE(thr);
+                _G.expr_chunk_words = 8;
+            }
+            res = wah_expr_eval(expr, NULL);
+            if (pass) {
+                _G.expr_chunk_words = chunk_words;
+                MODULE_RELEASE(thr);
+            }
+
+            Z_ASSERT_EQ(res->len, len);
+            for (uint64_t j = 0; j < len; j++) {
+                bool bit = TST_BIT(res_bits, j);
+
+                Z_ASSERT_EQ(wah_get(res, j), bit, "bad bit at %ju", j);
+                active += bit;
+            }
+            Z_ASSERT_EQ(res->active, active);
+            wah_pool_release(&res);
+        }
+
+        for (int i = 0; i < NB_MAPS; i++) {
+            wah_wipe(&maps[i]);
+        }
+    } Z_TEST_END;
+
     Z_TEST(buckets, "") {
         SB_1k(sb);
         wah_t map1;
@@ -2309,6 +2916,8 @@ Z_GROUP_EXPORT(wah)
         CHECK_WAH(4, 4 * 5 * WAH_BIT_IN_WORD + 2);
         wah_pad32(&map1);
         CHECK_WAH(5, (4 * 5 + 1) * WAH_BIT_IN_WORD);
+        Z_ASSERT_GE(wah_memory_footprint(&map1),
+                    wah_get_storage_len(&map1) * sizeof(wah_word_t));
 
         /* Save the wah in a sb. */
         tab_for_each_ptr(bucket, &map1._buckets) {
@@ -2323,6 +2932,8 @@ Z_GROUP_EXPORT(wah)
         tab_for_each_ptr(bucket, &map1._buckets) {
             Z_ASSERT(bucket->mp == ipool(MEM_STATIC));
         }
+        Z_ASSERT_EQ(wah_memory_footprint(&map1),
+                    qv_memory_footprint(&map1._buckets));
         wah_wipe(&map1);
 
         /* Reload it with a lower value of bits_in_bucket; this will stress
@@ -0,0 +1,406 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <math.h>
+#include <lib-common/arith.h>
+#include <lib-common/bloom.h>
+
+#ifdef __HAS_CPUID
+#   pragma push_macro("__leaf")
+#   undef __leaf
+#   include <cpuid.h>
+#   include <x86intrin.h>
+#   pragma pop_macro("__leaf")
+#endif
+
+/* {{{ Blocked Bloom filters */
+
+/* The salts of the Parquet split block Bloom filters: the bit set in the
+ * word i of the block is given by the 5 upper bits of key * salts[i]. */
+static const uint32_t bloom_salts_g[BLOOM_BLOCK_WORDS] = {
+    0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d,
+    0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31,
+};
+
+static ALWAYS_INLINE uint32_t bloom_block(uint32_t nb_blocks, uint64_t hash)
+{
+    return ((hash >> 32) * nb_blocks) >> 32;
+}
+
+/* False positive rate of a filter with lambda keys per block on average:
+ * the number of keys in a block follows a Poisson distribution, and a
+ * block with x keys has a false positive rate of (1 - (31/32)^x)^8. */
+static double bloom_fpr(double lambda)
+{
+    double p = exp(-lambda);
+    double fpr = 0;
+
+    for (int x = 0; x < lambda + 10 * sqrt(lambda) + 20; x++) {
+        fpr += p * pow(1 - pow(31. / 32, x), BLOOM_BLOCK_WORDS);
+        p *= lambda / (x + 1);
+    }
+    return fpr;
+}
+
+uint32_t bloom_nb_blocks(uint64_t nb_keys, double fpr)
+{
+    double lo = 0.01;
+    double hi = 256;
+    double nb;
+
+    assert (fpr > 0 && fpr < 1);
+    /* The rate grows with the load, find the largest acceptable load. */
+    for (int i = 0; i < 40; i++) {
+        double mid = (lo + hi) / 2;
+
+        if (bloom_fpr(mid) > fpr) {
+            hi = mid;
+        } else {
+            lo = mid;
+        }
+    }
+    nb = ceil(nb_keys / lo);
+    return MAX(1, MIN(nb, (double)UINT32_MAX));
+}
+
+bloom_t *bloom_init(bloom_t *bf, uint64_t nb_keys, double fpr)
+{
+    p_clear(bf, 1);
+    bf->nb_blocks = bloom_nb_blocks(nb_keys, fpr);
+    bf->words = mp_new(&mem_pool_cl_aligned, uint32_t,
+                       (size_t)bf->nb_blocks * BLOOM_BLOCK_WORDS);
+    return bf;
+}
+
+void bloom_wipe(bloom_t *bf)
+{
+    mp_delete(&mem_pool_cl_aligned, &bf->words);
+}
+
+void bloom_clear(bloom_t *bf)
+{
+    p_clear(bf->words, (size_t)bf->nb_blocks * BLOOM_BLOCK_WORDS);
+}
+
+void bloom_union(bloom_t *dst, const bloom_t *src)
+{
+    assert (dst->nb_blocks == src->nb_blocks);
+    for (size_t i = 0; i < (size_t)dst->nb_blocks * BLOOM_BLOCK_WORDS; i++) {
+        dst->words[i] |= src->words[i];
+    }
+}
+
+static void bloom_add_scalar(uint32_t *words, uint32_t nb_blocks,
+                             uint64_t hash)
+{
+    uint32_t *block = words + bloom_block(nb_blocks, hash)
+                    * BLOOM_BLOCK_WORDS;
+    uint32_t key = hash;
+
+    for (int i = 0; i < BLOOM_BLOCK_WORDS; i++) {
+        block[i] |= 1U << ((key * bloom_salts_g[i]) >> 27);
+    }
+}
+
+static bool bloom_has_scalar(const uint32_t *words, uint32_t nb_blocks,
+                             uint64_t hash)
+{
+    const uint32_t *block = words + bloom_block(nb_blocks, hash)
+                          * BLOOM_BLOCK_WORDS;
+    uint32_t key = hash;
+
+    for (int i = 0; i < BLOOM_BLOCK_WORDS; i++) {
+        if (!(block[i] & (1U << ((key * bloom_salts_g[i]) >> 27)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef __HAS_CPUID
+
+/* The 8 words of a block are exactly an AVX2 register. */
+__attribute__((target("avx2")))
+static ALWAYS_INLINE __m256i bloom_mask_avx2(uint32_t key)
+{
+    const __m256i salts = _mm256_loadu_si256((const __m256i *)bloom_salts_g);
+    __m256i shifts;
+
+    shifts = _mm256_mullo_epi32(_mm256_set1_epi32(key), salts);
+    shifts = _mm256_srli_epi32(shifts, 27);
+    return _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+}
+
+__attribute__((target("avx2")))
+static void bloom_add_avx2(uint32_t *words, uint32_t nb_blocks,
+                           uint64_t hash)
+{
+    __m256i *block = (__m256i *)(words + bloom_block(nb_blocks, hash)
+                                 * BLOOM_BLOCK_WORDS);
+
+    _mm256_storeu_si256(block, _mm256_or_si256(_mm256_loadu_si256(block),
+                                               bloom_mask_avx2(hash)));
+}
+
+__attribute__((target("avx2")))
+static bool bloom_has_avx2(const uint32_t *words, uint32_t nb_blocks,
+                           uint64_t hash)
+{
+    const __m256i *block = (const __m256i *)(words
+                                             + bloom_block(nb_blocks, hash)
+                                             * BLOOM_BLOCK_WORDS);
+
+    /* testc: all the bits of the mask are set in the block. */
+    return _mm256_testc_si256(_mm256_loadu_si256(block),
+                              bloom_mask_avx2(hash));
+}
+
+__attribute__((target("xsave")))
+static bool bloom_cpu_has_avx2(void)
+{
+    unsigned eax, ebx, ecx, edx;
+
+    __cpuid(1, eax, ebx, ecx, edx);
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) {
+        return false;
+    }
+    if ((_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)
+        && (ebx & bit_AVX2);
+}
+
+static void bloom_add_resolve(uint32_t *words, uint32_t nb_blocks,
+                              uint64_t hash);
+static bool bloom_has_resolve(const uint32_t *words, uint32_t nb_blocks,
+                              uint64_t hash);
+
+static void (*bloom_add_impl)(uint32_t *, uint32_t, uint64_t)
+    = &bloom_add_resolve;
+static bool (*bloom_has_impl)(const uint32_t *, uint32_t, uint64_t)
+    = &bloom_has_resolve;
+
+static void bloom_resolve(void)
+{
+    if (bloom_cpu_has_avx2()) {
+        bloom_has_impl = &bloom_has_avx2;
+        bloom_add_impl = &bloom_add_avx2;
+    } else {
+        bloom_has_impl = &bloom_has_scalar;
+        bloom_add_impl = &bloom_add_scalar;
+    }
+}
+
+static void bloom_add_resolve(uint32_t *words, uint32_t nb_blocks,
+                              uint64_t hash)
+{
+    bloom_resolve();
+    (*bloom_add_impl)(words, nb_blocks, hash);
+}
+
+static bool bloom_has_resolve(const uint32_t *words, uint32_t nb_blocks,
+                              uint64_t hash)
+{
+    bloom_resolve();
+    return (*bloom_has_impl)(words, nb_blocks, hash);
+}
+
+#else
+
+static void (*bloom_add_impl)(uint32_t *, uint32_t, uint64_t)
+    = &bloom_add_scalar;
+static bool (*bloom_has_impl)(const uint32_t *, uint32_t, uint64_t)
+    = &bloom_has_scalar;
+
+#endif
+
+void __bloom_add(uint32_t *words, uint32_t nb_blocks, uint64_t hash)
+{
+    (*bloom_add_impl)(words, nb_blocks, hash);
+}
+
+bool __bloom_has(const uint32_t *words, uint32_t nb_blocks, uint64_t hash)
+{
+    return (*bloom_has_impl)(words, nb_blocks, hash);
+}
+
+/* }}} */
+/* {{{ Cuckoo filters */
+
+/* Partial-key cuckoo hashing: the alternate bucket of a fingerprint is
+ * computed from its bucket and the fingerprint only, so that it can be
+ * moved without knowing its key. The xor makes alt(alt(i)) == i. */
+
+#define CUCKOO_MAX_KICKS  500
+
+static ALWAYS_INLINE uint16_t cuckoo_fp(uint64_t hash)
+{
+    /* 0 is the empty slot. */
+    return (hash >> 48) ?: 1;
+}
+
+static ALWAYS_INLINE uint32_t
+cuckoo_alt(const cuckoo_t *cf, uint32_t bucket, uint16_t fp)
+{
+    return (bucket ^ (fp * 0x5bd1e995U)) & cf->mask;
+}
+
+static ALWAYS_INLINE uint16_t *cuckoo_bucket(const cuckoo_t *cf, uint32_t i)
+{
+    return cf->slots + (size_t)i * CUCKOO_BUCKET_SLOTS;
+}
+
+cuckoo_t *cuckoo_init(cuckoo_t *cf, uint32_t nb_keys)
+{
+    /* Keep the load under 95%. */
+    uint64_t nb_buckets = DIV_ROUND_UP((uint64_t)nb_keys * 20,
+                                       19 * CUCKOO_BUCKET_SLOTS);
+
+    p_clear(cf, 1);
+    nb_buckets = 1ULL << bsr64(MAX(nb_buckets, 2) * 2 - 1);
+    cf->mask  = nb_buckets - 1;
+    cf->slots = p_new(uint16_t, nb_buckets * CUCKOO_BUCKET_SLOTS);
+    return cf;
+}
+
+void cuckoo_wipe(cuckoo_t *cf)
+{
+    p_delete(&cf->slots);
+}
+
+void cuckoo_clear(cuckoo_t *cf)
+{
+    p_clear(cf->slots, (size_t)(cf->mask + 1) * CUCKOO_BUCKET_SLOTS);
+    cf->nb_keys = 0;
+}
+
+static bool cuckoo_bucket_put(uint16_t *bucket, uint16_t fp)
+{
+    for (int i = 0; i < CUCKOO_BUCKET_SLOTS; i++) {
+        if (!bucket[i]) {
+            bucket[i] = fp;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool cuckoo_bucket_del(uint16_t *bucket, uint16_t fp)
+{
+    for (int i = 0; i < CUCKOO_BUCKET_SLOTS; i++) {
+        if (bucket[i] == fp) {
+            bucket[i] = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+int cuckoo_add_hash(cuckoo_t *cf, uint64_t hash)
+{
+    uint16_t fp = cuckoo_fp(hash);
+    uint32_t i1 = hash & cf->mask;
+    uint32_t i2 = cuckoo_alt(cf, i1, fp);
+    uint32_t path[CUCKOO_MAX_KICKS];
+    uint32_t i;
+    int n;
+
+    if (cuckoo_bucket_put(cuckoo_bucket(cf, i1), fp)
+    ||  cuckoo_bucket_put(cuckoo_bucket(cf, i2), fp))
+    {
+        cf->nb_keys++;
+        return 0;
+    }
+
+    /* Both buckets are full: evict a fingerprint to its other bucket, and
+     * so on. The path is recorded to be undone if it is too long. */
+    i = (hash >> 32) & 1 ? i1 : i2;
+    for (n = 0; n < CUCKOO_MAX_KICKS; n++) {
+        uint16_t *slot = &cuckoo_bucket(cf, i)[(hash >> (n & 31)) & 3];
+
+        path[n] = (i << 2) | (slot - cuckoo_bucket(cf, i));
+        SWAP(uint16_t, *slot, fp);
+        i = cuckoo_alt(cf, i, fp);
+        if (cuckoo_bucket_put(cuckoo_bucket(cf, i), fp)) {
+            cf->nb_keys++;
+            return 0;
+        }
+    }
+    while (n-- > 0) {
+        uint16_t *slot = &cuckoo_bucket(cf, path[n] >> 2)[path[n] & 3];
+
+        SWAP(uint16_t, *slot, fp);
+    }
+    return -1;
+}
+
+#if defined(__HAS_CPUID) && defined(__SSE2__)
+
+bool cuckoo_has_hash(const cuckoo_t *cf, uint64_t hash)
+{
+    uint16_t fp = cuckoo_fp(hash);
+    uint32_t i1 = hash & cf->mask;
+    uint32_t i2 = cuckoo_alt(cf, i1, fp);
+    __m128i slots;
+
+    /* The 8 slots of the two buckets are compared at once. */
+    slots = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)
+                                               cuckoo_bucket(cf, i1)),
+                               _mm_loadl_epi64((const __m128i *)
+                                               cuckoo_bucket(cf, i2)));
+    return _mm_movemask_epi8(_mm_cmpeq_epi16(slots, _mm_set1_epi16(fp)));
+}
+
+#else
+
+static ALWAYS_INLINE bool cuckoo_bucket_has(const uint16_t *bucket,
+                                            uint16_t fp)
+{
+    uint64_t v = get_unaligned_cpu64(bucket) ^ (fp * 0x0001000100010001ULL);
+
+    /* Whether one of the 16-bit lanes is zero. */
+    return (v - 0x0001000100010001ULL) & ~v & 0x8000800080008000ULL;
+}
+
+bool cuckoo_has_hash(const cuckoo_t *cf, uint64_t hash)
+{
+    uint16_t fp = cuckoo_fp(hash);
+    uint32_t i1 = hash & cf->mask;
+
+    return cuckoo_bucket_has(cuckoo_bucket(cf, i1), fp)
+        || cuckoo_bucket_has(cuckoo_bucket(cf, cuckoo_alt(cf, i1, fp)), fp);
+}
+
+#endif
+
+int cuckoo_remove_hash(cuckoo_t *cf, uint64_t hash)
+{
+    uint16_t fp = cuckoo_fp(hash);
+    uint32_t i1 = hash & cf->mask;
+
+    if (cuckoo_bucket_del(cuckoo_bucket(cf, i1), fp)
+    ||  cuckoo_bucket_del(cuckoo_bucket(cf, cuckoo_alt(cf, i1, fp)), fp))
+    {
+        cf->nb_keys--;
+        return 0;
+    }
+    return -1;
+}
+
+/* }}} */
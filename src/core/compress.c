@@ -0,0 +1,661 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <zstd.h>
+#include <zdict.h>
+#include <lz4frame.h>
+
+#include <lib-common/compress.h>
+#include <lib-common/thr.h>
+
+/* Beyond this ratio, the size announced by a zstd frame is not trusted to
+ * allocate the output buffer at once. */
+#define ZSTD_TRUSTED_RATIO  64
+
+/* {{{ Per-thread contexts */
+
+/* The contexts are costly to create (several hundreds of KB for zstd), so
+ * the one-shot functions keep one of each per thread. */
+static __thread struct {
+    ZSTD_CCtx *zstd_cctx;
+    ZSTD_DCtx *zstd_dctx;
+    LZ4F_dctx *lz4_dctx;
+} compress_g;
+
+static ZSTD_CCtx *compress_zstd_cctx(void)
+{
+    if (unlikely(!compress_g.zstd_cctx)) {
+        compress_g.zstd_cctx = ZSTD_createCCtx();
+    }
+    return compress_g.zstd_cctx;
+}
+
+static ZSTD_DCtx *compress_zstd_dctx(void)
+{
+    if (unlikely(!compress_g.zstd_dctx)) {
+        compress_g.zstd_dctx = ZSTD_createDCtx();
+    }
+    return compress_g.zstd_dctx;
+}
+
+static LZ4F_dctx *compress_lz4_dctx(void)
+{
+    if (unlikely(!compress_g.lz4_dctx)) {
+        if (LZ4F_isError(LZ4F_createDecompressionContext(&compress_g.lz4_dctx,
+                                                         LZ4F_VERSION)))
+        {
+            compress_g.lz4_dctx = NULL;
+        }
+    }
+    return compress_g.lz4_dctx;
+}
+
+static void compress_thr_wipe(void)
+{
+    ZSTD_freeCCtx(compress_g.zstd_cctx);
+    ZSTD_freeDCtx(compress_g.zstd_dctx);
+    if (compress_g.lz4_dctx) {
+        LZ4F_freeDecompressionContext(compress_g.lz4_dctx);
+    }
+    p_clear(&compress_g, 1);
+}
+thr_hooks(NULL, compress_thr_wipe);
+
+/* }}} */
+/* {{{ Dictionaries */
+
+struct compress_dict_t {
+    ZSTD_CDict *cdict;
+    ZSTD_DDict *ddict;
+    uint32_t    id;
+};
+
+compress_dict_t *compress_dict_new(lstr_t data, int level)
+{
+    compress_dict_t *dict = p_new(compress_dict_t, 1);
+
+    dict->cdict = ZSTD_createCDict(data.s, data.len, level);
+    dict->ddict = ZSTD_createDDict(data.s, data.len);
+    if (!dict->cdict || !dict->ddict) {
+        compress_dict_delete(&dict);
+        return NULL;
+    }
+    dict->id = ZSTD_getDictID_fromDict(data.s, data.len);
+    return dict;
+}
+
+void compress_dict_delete(compress_dict_t **dictp)
+{
+    compress_dict_t *dict = *dictp;
+
+    if (dict) {
+        ZSTD_freeCDict(dict->cdict);
+        ZSTD_freeDDict(dict->ddict);
+        p_delete(dictp);
+    }
+}
+
+uint32_t compress_dict_id(const compress_dict_t *dict)
+{
+    return dict->id;
+}
+
+uint32_t compress_dict_id_from_frame(lstr_t frame)
+{
+    return ZSTD_getDictID_fromFrame(frame.s, frame.len);
+}
+
+int compress_dict_train(sb_t *out, const lstr_t *samples, int nb_samples,
+                        int max_size)
+{
+    SB_8k(buf);
+    size_t *sizes = p_new_raw(size_t, nb_samples);
+    size_t res;
+
+    for (int i = 0; i < nb_samples; i++) {
+        sb_add_lstr(&buf, samples[i]);
+        sizes[i] = samples[i].len;
+    }
+    res = ZDICT_trainFromBuffer(sb_grow(out, max_size), max_size,
+                                buf.data, sizes, nb_samples);
+    sb_wipe(&buf);
+    p_delete(&sizes);
+
+    if (ZDICT_isError(res)) {
+        return -1;
+    }
+    __sb_fixlen(out, out->len + res);
+    return res;
+}
+
+/* }}} */
+/* {{{ zstd */
+
+static int zstd_cctx_setup(ZSTD_CCtx *cctx, int level,
+                           const compress_dict_t *dict)
+{
+    size_t res;
+
+    ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+    if (dict) {
+        /* The compression level is the one of the dictionary. */
+        res = ZSTD_CCtx_refCDict(cctx, dict->cdict);
+    } else {
+        res = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+    }
+    return ZSTD_isError(res) ? -1 : 0;
+}
+
+static int zstd_dctx_setup(ZSTD_DCtx *dctx, const compress_dict_t *dict)
+{
+    ZSTD_DCtx_reset(dctx, ZSTD_reset_session_and_parameters);
+    if (dict && ZSTD_isError(ZSTD_DCtx_refDDict(dctx, dict->ddict))) {
+        return -1;
+    }
+    return 0;
+}
+
+static ssize_t zstd_compress(sb_t *out, int level,
+                             const compress_dict_t *dict,
+                             const void *data, size_t dlen)
+{
+    ZSTD_CCtx *cctx = compress_zstd_cctx();
+    size_t bound = ZSTD_compressBound(dlen);
+    size_t res;
+
+    if (!cctx || bound > INT_MAX || zstd_cctx_setup(cctx, level, dict) < 0) {
+        return -1;
+    }
+    res = ZSTD_compress2(cctx, sb_grow(out, bound), bound, data, dlen);
+    if (ZSTD_isError(res)) {
+        return -1;
+    }
+    __sb_fixlen(out, out->len + res);
+    return res;
+}
+
+/* Streaming compression, with the `op` directive of ZSTD_compressStream2()
+ * (continue, flush or end). */
+static ssize_t zstd_compress_stream(ZSTD_CCtx *cctx, sb_t *out,
+                                    const void *data, size_t dlen,
+                                    ZSTD_EndDirective op)
+{
+    ZSTD_inBuffer in = { .src = data, .size = dlen };
+    int orig_len = out->len;
+
+    for (;;) {
+        ZSTD_outBuffer zout;
+        size_t res;
+
+        zout.dst  = sb_grow(out, ZSTD_CStreamOutSize());
+        zout.size = sb_avail(out);
+        zout.pos  = 0;
+
+        res = ZSTD_compressStream2(cctx, &zout, &in, op);
+        __sb_fixlen(out, out->len + zout.pos);
+        if (ZSTD_isError(res)) {
+            return -1;
+        }
+        if (op == ZSTD_e_continue ? in.pos == in.size : res == 0) {
+            return out->len - orig_len;
+        }
+    }
+}
+
+/* Decompress up to the end of a frame, see decompress_stream_add(). */
+static int zstd_decompress_stream(ZSTD_DCtx *dctx, sb_t *out, pstream_t *ps)
+{
+    for (;;) {
+        ZSTD_inBuffer in = { .src = ps->s, .size = ps_len(ps) };
+        ZSTD_outBuffer zout;
+        size_t res;
+
+        zout.dst  = sb_grow(out, MAX(2 * in.size, 4096u));
+        zout.size = sb_avail(out);
+        zout.pos  = 0;
+
+        res = ZSTD_decompressStream(dctx, &zout, &in);
+        __sb_fixlen(out, out->len + zout.pos);
+        __ps_skip(ps, in.pos);
+        if (ZSTD_isError(res)) {
+            ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
+            return -1;
+        }
+        if (res == 0) {
+            return 1;
+        }
+        if (in.pos == in.size && zout.pos < zout.size) {
+            /* Everything was flushed, more input is needed. */
+            return 0;
+        }
+    }
+}
+
+static ssize_t zstd_decompress(sb_t *out, const compress_dict_t *dict,
+                               const void *data, size_t dlen)
+{
+    ZSTD_DCtx *dctx = compress_zstd_dctx();
+    pstream_t ps = ps_init(data, dlen);
+    unsigned long long size;
+    int orig_len = out->len;
+
+    if (!dctx || zstd_dctx_setup(dctx, dict) < 0) {
+        return -1;
+    }
+
+    /* When the data is a single frame which announces its size, decompress
+     * it at once in an output buffer of the right size. */
+    size = ZSTD_getFrameContentSize(data, dlen);
+    if (size <= (unsigned long long)MAX(dlen * ZSTD_TRUSTED_RATIO, 1 << 20)
+    &&  size <= INT_MAX && ZSTD_findFrameCompressedSize(data, dlen) == dlen)
+    {
+        size_t res = ZSTD_decompressDCtx(dctx, sb_grow(out, size), size,
+                                         data, dlen);
+
+        if (ZSTD_isError(res)) {
+            return -1;
+        }
+        __sb_fixlen(out, out->len + res);
+        return res;
+    }
+
+    while (!ps_done(&ps)) {
+        if (zstd_decompress_stream(dctx, out, &ps) <= 0) {
+            /* Invalid or truncated data. */
+            sb_clip(out, orig_len);
+            return -1;
+        }
+    }
+    return out->len - orig_len;
+}
+
+/* }}} */
+/* {{{ LZ4 */
+
+static void lz4_prefs_init(LZ4F_preferences_t *prefs, int level,
+                           size_t content_size)
+{
+    p_clear(prefs, 1);
+    prefs->frameInfo.blockMode   = LZ4F_blockLinked;
+    prefs->frameInfo.contentSize = content_size;
+    prefs->compressionLevel      = level;
+}
+
+static ssize_t lz4_compress(sb_t *out, int level,
+                            const void *data, size_t dlen)
+{
+    LZ4F_preferences_t prefs;
+    size_t bound;
+    size_t res;
+
+    lz4_prefs_init(&prefs, level, dlen);
+    bound = LZ4F_compressFrameBound(dlen, &prefs);
+    if (bound > INT_MAX) {
+        return -1;
+    }
+    res = LZ4F_compressFrame(sb_grow(out, bound), bound, data, dlen, &prefs);
+    if (LZ4F_isError(res)) {
+        return -1;
+    }
+    __sb_fixlen(out, out->len + res);
+    return res;
+}
+
+/* Decompress up to the end of a frame, see decompress_stream_add(). */
+static int lz4_decompress_stream(LZ4F_dctx *dctx, sb_t *out, pstream_t *ps)
+{
+    for (;;) {
+        size_t src_len = ps_len(ps);
+        size_t dst_len;
+        size_t avail;
+        void *dst;
+        size_t res;
+
+        dst = sb_grow(out, MAX(2 * src_len, 4096u));
+        avail = dst_len = sb_avail(out);
+
+        res = LZ4F_decompress(dctx, dst, &dst_len, ps->s, &src_len, NULL);
+        __sb_fixlen(out, out->len + dst_len);
+        __ps_skip(ps, src_len);
+        if (LZ4F_isError(res)) {
+            LZ4F_resetDecompressionContext(dctx);
+            return -1;
+        }
+        if (res == 0) {
+            return 1;
+        }
+        if (ps_done(ps) && dst_len < avail) {
+            return 0;
+        }
+    }
+}
+
+static ssize_t lz4_decompress(sb_t *out, const void *data, size_t dlen)
+{
+    LZ4F_dctx *dctx = compress_lz4_dctx();
+    pstream_t ps = ps_init(data, dlen);
+    int orig_len = out->len;
+
+    if (!dctx) {
+        return -1;
+    }
+    LZ4F_resetDecompressionContext(dctx);
+    while (!ps_done(&ps)) {
+        if (lz4_decompress_stream(dctx, out, &ps) <= 0) {
+            LZ4F_resetDecompressionContext(dctx);
+            sb_clip(out, orig_len);
+            return -1;
+        }
+    }
+    return out->len - orig_len;
+}
+
+/* }}} */
+/* {{{ One-shot API */
+
+ssize_t sb_add_compress(sb_t *out, compress_algo_t algo, int level,
+                        const compress_dict_t *dict,
+                        const void *data, size_t dlen)
+{
+    switch (algo) {
+      case COMPRESS_ZSTD:
+        return zstd_compress(out, level, dict, data, dlen);
+
+      case COMPRESS_LZ4:
+        if (dict) {
+            return -1;
+        }
+        return lz4_compress(out, level, data, dlen);
+    }
+    return -1;
+}
+
+ssize_t sb_add_decompress(sb_t *out, compress_algo_t algo,
+                          const compress_dict_t *dict,
+                          const void *data, size_t dlen)
+{
+    switch (algo) {
+      case COMPRESS_ZSTD:
+        return zstd_decompress(out, dict, data, dlen);
+
+      case COMPRESS_LZ4:
+        if (dict) {
+            return -1;
+        }
+        return lz4_decompress(out, data, dlen);
+    }
+    return -1;
+}
+
+/* }}} */
+/* {{{ Streaming API */
+
+struct compress_stream_t {
+    compress_algo_t algo;
+    int level;
+    const compress_dict_t *dict;
+
+    /* zstd: the parameters must be set again at the start of each frame.
+     * LZ4: the header of the frame is written along its first data. */
+    bool started;
+    union {
+        ZSTD_CCtx *zstd;
+        LZ4F_cctx *lz4;
+    };
+};
+
+compress_stream_t *compress_stream_new(compress_algo_t algo, int level,
+                                       const compress_dict_t *dict)
+{
+    compress_stream_t *cs = p_new(compress_stream_t, 1);
+
+    assert (algo == COMPRESS_ZSTD || !dict);
+    cs->algo  = algo;
+    cs->level = level;
+    cs->dict  = dict;
+    switch (algo) {
+      case COMPRESS_ZSTD:
+        cs->zstd = ZSTD_createCCtx();
+        break;
+
+      case COMPRESS_LZ4:
+        if (LZ4F_isError(LZ4F_createCompressionContext(&cs->lz4,
+                                                       LZ4F_VERSION)))
+        {
+            cs->lz4 = NULL;
+        }
+        break;
+    }
+    if (!cs->zstd) {
+        /* Both libraries only fail to allocate their contexts on memory
+         * allocation failures. */
+        e_panic("out of memory");
+    }
+    return cs;
+}
+
+void compress_stream_delete(compress_stream_t **csp)
+{
+    compress_stream_t *cs = *csp;
+
+    if (cs) {
+        switch (cs->algo) {
+          case COMPRESS_ZSTD:
+            ZSTD_freeCCtx(cs->zstd);
+            break;
+
+          case COMPRESS_LZ4:
+            LZ4F_freeCompressionContext(cs->lz4);
+            break;
+        }
+        p_delete(csp);
+    }
+}
+
+/* Get the maximum size written by LZ4F_compressUpdate() (or LZ4F_flush()
+ * and LZ4F_compressEnd() when dlen is 0), and make room for it. */
+static void *lz4_grow(compress_stream_t *cs, sb_t *out, size_t dlen,
+                      size_t *bound)
+{
+    LZ4F_preferences_t prefs;
+
+    lz4_prefs_init(&prefs, cs->level, 0);
+    *bound = LZ4F_compressBound(dlen, &prefs);
+    if (*bound > INT_MAX) {
+        return NULL;
+    }
+    return sb_grow(out, *bound);
+}
+
+/* Add the output of the LZ4F functions to the buffer. */
+static int lz4_fixlen(sb_t *out, size_t res)
+{
+    if (LZ4F_isError(res)) {
+        return -1;
+    }
+    __sb_fixlen(out, out->len + res);
+    return 0;
+}
+
+static int compress_stream_start(compress_stream_t *cs, sb_t *out)
+{
+    if (cs->started) {
+        return 0;
+    }
+    switch (cs->algo) {
+      case COMPRESS_ZSTD:
+        RETHROW(zstd_cctx_setup(cs->zstd, cs->level, cs->dict));
+        break;
+
+      case COMPRESS_LZ4: {
+        LZ4F_preferences_t prefs;
+        size_t res;
+
+        lz4_prefs_init(&prefs, cs->level, 0);
+        res = LZ4F_compressBegin(cs->lz4, sb_grow(out, LZ4F_HEADER_SIZE_MAX),
+                                 LZ4F_HEADER_SIZE_MAX, &prefs);
+        RETHROW(lz4_fixlen(out, res));
+      } break;
+    }
+    cs->started = true;
+    return 0;
+}
+
+ssize_t compress_stream_add(compress_stream_t *cs, sb_t *out,
+                            const void *data, size_t dlen)
+{
+    int orig_len = out->len;
+
+    RETHROW(compress_stream_start(cs, out));
+    switch (cs->algo) {
+      case COMPRESS_ZSTD:
+        RETHROW(zstd_compress_stream(cs->zstd, out, data, dlen,
+                                     ZSTD_e_continue));
+        break;
+
+      case COMPRESS_LZ4:
+      {
+        size_t bound;
+        void *dst = lz4_grow(cs, out, dlen, &bound);
+
+        if (!dst) {
+            return -1;
+        }
+        RETHROW(lz4_fixlen(out, LZ4F_compressUpdate(cs->lz4, dst, bound,
+                                                    data, dlen, NULL)));
+      } break;
+    }
+    return out->len - orig_len;
+}
+
+ssize_t compress_stream_flush(compress_stream_t *cs, sb_t *out)
+{
+    int orig_len = out->len;
+
+    RETHROW(compress_stream_start(cs, out));
+    switch (cs->algo) {
+      case COMPRESS_ZSTD:
+        RETHROW(zstd_compress_stream(cs->zstd, out, NULL, 0, ZSTD_e_flush));
+        break;
+
+      case COMPRESS_LZ4: {
+        size_t bound;
+        void *dst = lz4_grow(cs, out, 0, &bound);
+
+        if (!dst) {
+            return -1;
+        }
+        RETHROW(lz4_fixlen(out, LZ4F_flush(cs->lz4, dst, bound, NULL)));
+      } break;
+    }
+    return out->len - orig_len;
+}
+
+ssize_t compress_stream_end(compress_stream_t *cs, sb_t *out)
+{
+    int orig_len = out->len;
+
+    RETHROW(compress_stream_start(cs, out));
+    cs->started = false;
+    switch (cs->algo) {
+      case COMPRESS_ZSTD:
+        RETHROW(zstd_compress_stream(cs->zstd, out, NULL, 0, ZSTD_e_end));
+        break;
+
+      case COMPRESS_LZ4: {
+        size_t bound;
+        void *dst = lz4_grow(cs, out, 0, &bound);
+
+        if (!dst) {
+            return -1;
+        }
+        RETHROW(lz4_fixlen(out, LZ4F_compressEnd(cs->lz4, dst, bound, NULL)));
+      } break;
+    }
+    return out->len - orig_len;
+}
+
+struct decompress_stream_t {
+    compress_algo_t algo;
+    union {
+        ZSTD_DCtx *zstd;
+        LZ4F_dctx *lz4;
+    };
+};
+
+decompress_stream_t *decompress_stream_new(compress_algo_t algo,
+                                           const compress_dict_t *dict)
+{
+    decompress_stream_t *ds = p_new(decompress_stream_t, 1);
+
+    assert (algo == COMPRESS_ZSTD || !dict);
+    ds->algo = algo;
+    switch (algo) {
+      case COMPRESS_ZSTD:
+        ds->zstd = ZSTD_createDCtx();
+        if (ds->zstd && zstd_dctx_setup(ds->zstd, dict) < 0) {
+            ZSTD_freeDCtx(ds->zstd);
+            ds->zstd = NULL;
+        }
+        break;
+
+      case COMPRESS_LZ4:
+        if (LZ4F_isError(LZ4F_createDecompressionContext(&ds->lz4,
+                                                         LZ4F_VERSION)))
+        {
+            ds->lz4 = NULL;
+        }
+        break;
+    }
+    if (!ds->zstd) {
+        e_panic("out of memory");
+    }
+    return ds;
+}
+
+void decompress_stream_delete(decompress_stream_t **dsp)
+{
+    decompress_stream_t *ds = *dsp;
+
+    if (ds) {
+        switch (ds->algo) {
+          case COMPRESS_ZSTD:
+            ZSTD_freeDCtx(ds->zstd);
+            break;
+
+          case COMPRESS_LZ4:
+            LZ4F_freeDecompressionContext(ds->lz4);
+            break;
+        }
+        p_delete(dsp);
+    }
+}
+
+int decompress_stream_add(decompress_stream_t *ds, sb_t *out, pstream_t *in)
+{
+    switch (ds->algo) {
+      case COMPRESS_ZSTD:
+        return zstd_decompress_stream(ds->zstd, out, in);
+
+      case COMPRESS_LZ4:
+        return lz4_decompress_stream(ds->lz4, out, in);
+    }
+    return -1;
+}
+
+/* }}} */
@@ -18,6 +18,212 @@
 
 #include <lib-common/datetime.h>
 
+/* {{{ Formatting */
+
+/* Date of the last second formatted by the thread, followed by the UTC
+ * offset for a local time.
+ */
+typedef struct iso8601_cache_t {
+    time_t      t;
+    const char *tz;
+    bool        valid;
+    char        buf[25];
+} iso8601_cache_t;
+
+static __thread iso8601_cache_t iso8601_gmt_cache_g;
+static __thread iso8601_cache_t iso8601_local_cache_g;
+
+static ALWAYS_INLINE char *iso8601_put2(char *p, int v)
+{
+    p[0] = '0' + v / 10;
+    p[1] = '0' + v % 10;
+    return p + 2;
+}
+
+/* Writes the 19 characters of YYYY-MM-DDThh:mm:ss, the years outside
+ * [0, 9999] are left to snprintf().
+ */
+static int iso8601_put_base(char *p, const struct tm *tm)
+{
+    int year = tm->tm_year + 1900;
+
+    if (year < 0 || year > 9999) {
+        return -1;
+    }
+    p = iso8601_put2(p, year / 100);
+    p = iso8601_put2(p, year % 100);
+    *p++ = '-';
+    p = iso8601_put2(p, tm->tm_mon + 1);
+    *p++ = '-';
+    p = iso8601_put2(p, tm->tm_mday);
+    *p++ = 'T';
+    p = iso8601_put2(p, tm->tm_hour);
+    *p++ = ':';
+    p = iso8601_put2(p, tm->tm_min);
+    *p++ = ':';
+    iso8601_put2(p, tm->tm_sec);
+    return 0;
+}
+
+static const iso8601_cache_t *iso8601_gmt_cache(time_t t)
+{
+    iso8601_cache_t *cache = &iso8601_gmt_cache_g;
+    struct tm tm;
+
+    if (likely(cache->valid && cache->t == t)) {
+        return cache;
+    }
+    cache->valid = false;
+    if (!time_gmtime(t, &tm)) {
+        e_panic("invalid timestamp: %jd", t);
+    }
+    RETHROW_NP(iso8601_put_base(cache->buf, &tm));
+    cache->t = t;
+    cache->valid = true;
+    return cache;
+}
+
+/* Only the system local time is cached, as the TZ environment variable has
+ * to be changed for the other timezones.
+ */
+static const iso8601_cache_t *iso8601_local_cache(time_t t)
+{
+    iso8601_cache_t *cache = &iso8601_local_cache_g;
+    const char *tz = getenv("TZ");
+    int delta_h, delta_m;
+    struct tm tm;
+    char *p;
+
+    if (likely(cache->valid && cache->t == t && cache->tz == tz)) {
+        return cache;
+    }
+    cache->valid = false;
+    RETHROW_P(time_localtime(t, &tm));
+    time_get_gmt_delta(&tm, &delta_h, &delta_m);
+    if (delta_h <= -100 || delta_h >= 100) {
+        return NULL;
+    }
+    RETHROW_NP(iso8601_put_base(cache->buf, &tm));
+
+    p = cache->buf + 19;
+    *p++ = delta_h < 0 ? '-' : '+';
+    p = iso8601_put2(p, abs(delta_h));
+    *p++ = ':';
+    iso8601_put2(p, delta_m);
+
+    cache->t = t;
+    cache->tz = tz;
+    cache->valid = true;
+    return cache;
+}
+
+void time_fmt_iso8601(char buf[static 21], time_t t)
+{
+    const iso8601_cache_t *cache = iso8601_gmt_cache(t);
+    struct tm tm;
+    int len;
+
+    if (likely(cache)) {
+        memcpy(buf, cache->buf, 19);
+        buf[19] = 'Z';
+        buf[20] = '\0';
+        return;
+    }
+
+    time_gmtime(t, &tm);
+    len = snprintf(buf, 21, ISO8601_GMT_FMT, ISO8601_GMT_FMT_ARG(&tm));
+    if (len >= 21) {
+        e_panic("invalid timestamp: %jd", t);
+    }
+}
+
+void time_fmt_localtime_iso8601(char buf[static 26], time_t t,
+                                const char *tz)
+{
+    const iso8601_cache_t *cache;
+    int len;
+    struct tm tm;
+    int delta_h, delta_m;
+
+    if (!tz && likely(cache = iso8601_local_cache(t))) {
+        memcpy(buf, cache->buf, 25);
+        buf[25] = '\0';
+        return;
+    }
+
+    time_get_localtime(&t, &tm, tz);
+    time_get_gmt_delta(&tm, &delta_h, &delta_m);
+
+    len = snprintf(buf, 26, ISO8601_TZ_FMT,
+                   ISO8601_TZ_FMT_ARG(&tm, delta_h, delta_m));
+    if (len >= 26) {
+        e_panic("invalid timestamp: %jd", t);
+    }
+}
+
+void time_fmt_iso8601_msec(char buf[static 25], time_t t, int msec)
+{
+    const iso8601_cache_t *cache;
+    int len;
+    struct tm tm;
+
+    /* XXX %03d gives a minimum width but not a maximum one, so we need to be
+     * careful and not overflow the buffer of size 25 with invalid inputs.
+     */
+    if (msec < 0 || msec >= 1000) {
+        e_panic("invalid msec: %d", msec);
+    }
+    if (likely(cache = iso8601_gmt_cache(t))) {
+        memcpy(buf, cache->buf, 19);
+        buf[19] = '.';
+        buf[20] = '0' + msec / 100;
+        iso8601_put2(buf + 21, msec % 100);
+        buf[23] = 'Z';
+        buf[24] = '\0';
+        return;
+    }
+
+    time_gmtime(t, &tm);
+    len = snprintf(buf, 25, ISO8601_GMT_MSEC_FMT,
+                   ISO8601_GMT_MSEC_FMT_ARG(&tm, msec));
+    if (len >= 25) {
+        e_panic("invalid timestamp: %jd", t);
+    }
+}
+
+void time_fmt_localtime_iso8601_msec(char buf[static 30], time_t t,
+                                     int msec, const char *tz)
+{
+    const iso8601_cache_t *cache;
+    int len;
+    struct tm tm;
+    int delta_h, delta_m;
+
+    if (!tz && msec >= 0 && msec < 1000
+    &&  likely(cache = iso8601_local_cache(t)))
+    {
+        memcpy(buf, cache->buf, 19);
+        buf[19] = '.';
+        buf[20] = '0' + msec / 100;
+        iso8601_put2(buf + 21, msec % 100);
+        memcpy(buf + 23, cache->buf + 19, 6);
+        buf[29] = '\0';
+        return;
+    }
+
+    time_get_localtime(&t, &tm, tz);
+    time_get_gmt_delta(&tm, &delta_h, &delta_m);
+
+    len = snprintf(buf, 30, ISO8601_TZ_MSEC_FMT,
+                   ISO8601_TZ_MSEC_FMT_ARG(&tm, msec, delta_h, delta_m));
+    if (len >= 30) {
+        e_panic("invalid timestamp: %jd", t);
+    }
+}
+
+/* }}} */
+/* {{{ Parsing */
+
 static int time_parse_timezone(pstream_t *ps, int *tz_h, int *tz_m)
 {
     *tz_m = 0;
@@ -112,6 +318,114 @@ static int time_parse_iso8601_tok(pstream_t *ps, int *nb, int *type)
     return 0;
 }
 
+#define ISO8601_DIGIT(s, i)  ((unsigned)((s)[i] - '0'))
+#define ISO8601_NOT_DIGIT(s, i)  (ISO8601_DIGIT(s, i) > 9)
+#define ISO8601_2DIGITS(s, i)                                                \
+    (int)(ISO8601_DIGIT(s, i) * 10 + ISO8601_DIGIT(s, (i) + 1))
+
+/* Parse the fixed layout YYYY-MM-DDThh:mm:ss[.fff](Z|+hh:mm|+hhmm|+hh) of
+ * our bulk imports without branching on every field, and without mktime()
+ * or timegm().
+ *
+ * Returns 1 if the input does not have this exact layout, or if it is not
+ * in the ranges this function handles, so that the generic parser is
+ * used. On success, the stream is left as the generic parser leaves it.
+ */
+static int time_parse_iso8601_fixed(pstream_t *ps, time_t *res)
+{
+    const char *s = ps->s;
+    int len = ps_len(ps);
+    int year, mon, mday, hour, min, sec;
+    int tz = 0;
+    int pos = 19;
+    unsigned bad;
+
+    if (len < 20) {
+        return 1;
+    }
+
+    bad  = ISO8601_NOT_DIGIT(s, 0)  | ISO8601_NOT_DIGIT(s, 1);
+    bad |= ISO8601_NOT_DIGIT(s, 2)  | ISO8601_NOT_DIGIT(s, 3);
+    bad |= ISO8601_NOT_DIGIT(s, 5)  | ISO8601_NOT_DIGIT(s, 6);
+    bad |= ISO8601_NOT_DIGIT(s, 8)  | ISO8601_NOT_DIGIT(s, 9);
+    bad |= ISO8601_NOT_DIGIT(s, 11) | ISO8601_NOT_DIGIT(s, 12);
+    bad |= ISO8601_NOT_DIGIT(s, 14) | ISO8601_NOT_DIGIT(s, 15);
+    bad |= ISO8601_NOT_DIGIT(s, 17) | ISO8601_NOT_DIGIT(s, 18);
+    bad |= (s[4] != '-') | (s[7] != '-') | ((s[10] | 0x20) != 't');
+    bad |= (s[13] != ':') | (s[16] != ':');
+    if (bad) {
+        return 1;
+    }
+
+    year = ISO8601_2DIGITS(s, 0) * 100 + ISO8601_2DIGITS(s, 2);
+    mon  = ISO8601_2DIGITS(s, 5) - 1;
+    mday = ISO8601_2DIGITS(s, 8);
+    hour = ISO8601_2DIGITS(s, 11);
+    min  = ISO8601_2DIGITS(s, 14);
+    sec  = ISO8601_2DIGITS(s, 17);
+
+    /* Out of range times are normalized by the generic parser. */
+    bad  = (year <= 1900) | (year > 2100) | ((unsigned)mon > 11);
+    bad |= (hour > 23) | (min > 59) | (sec > 59);
+    if (bad || !is_mday_valid(mday, mon, year)) {
+        return 1;
+    }
+
+    if (s[pos] == '.') {
+        int start = ++pos;
+
+        while (pos < len && !ISO8601_NOT_DIGIT(s, pos)) {
+            pos++;
+        }
+        if (pos == start || pos - start > 9) {
+            return 1;
+        }
+    }
+
+    switch (len - pos) {
+      case 1:
+        if ((s[pos] | 0x20) != 'z') {
+            return 1;
+        }
+        break;
+
+      case 3:
+      case 5:
+      case 6:
+        bad  = (s[pos] != '+') & (s[pos] != '-');
+        bad |= ISO8601_NOT_DIGIT(s, pos + 1) | ISO8601_NOT_DIGIT(s, pos + 2);
+        tz = ISO8601_2DIGITS(s, pos + 1) * 3600;
+        if (len - pos > 3) {
+            int m = len - pos - 2;
+
+            bad |= (len - pos == 6) & (s[pos + 3] != ':');
+            bad |= ISO8601_NOT_DIGIT(s, pos + m)
+                |  ISO8601_NOT_DIGIT(s, pos + m + 1);
+            tz += ISO8601_2DIGITS(s, pos + m) * 60;
+        }
+        if (bad) {
+            return 1;
+        }
+        if (s[pos] == '-') {
+            tz = -tz;
+        }
+        pos = len;
+        break;
+
+      default:
+        return 1;
+    }
+
+    *res = time_days_from_civil(year, mon, mday) * 86400
+         + hour * 3600 + min * 60 + sec - tz;
+    __ps_skip(ps, pos);
+    return 0;
+}
+
+#undef ISO8601_2DIGITS
+#undef ISO8601_NOT_DIGIT
+#undef ISO8601_DIGIT
+
 int time_parse_iso8601_flags(pstream_t *ps, time_t *res, unsigned flags)
 {
     struct tm t;
@@ -124,6 +438,12 @@ int time_parse_iso8601_flags(pstream_t *ps, time_t *res, unsigned flags)
         return -1;
     }
 
+    if (!(flags & ISO8601_RESTRICT_DAY_DATE_FORMAT)
+    &&  time_parse_iso8601_fixed(ps, res) == 0)
+    {
+        return 0;
+    }
+
     if (*ps->s == 'P') {
         /* Relative date */
         int nb, tok;
@@ -350,3 +670,5 @@ int time_parse(pstream_t *ps, time_t *d)
     }
 #undef PARSE_FORMAT
 }
+
+/* }}} */
@@ -550,20 +550,113 @@ time_t lstrtotime(lstr_t date)
     return mktime(&tm);
 }
 
+int64_t time_days_from_civil(int64_t year, int mon, int mday)
+{
+    /* Count from March 1st so that the leap day is the last day of the
+     * year, in 400 years eras of 146097 days.
+     */
+    int64_t era, yoe, doy, doe;
+
+    mon++;
+    year -= mon <= 2;
+    era = (year >= 0 ? year : year - 399) / 400;
+    yoe = year - era * 400;
+    doy = (153 * (mon > 2 ? mon - 3 : mon + 9) + 2) / 5 + mday - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * 146097 + doe - 719468;
+}
+
+struct tm *time_gmtime(time_t t, struct tm *tm)
+{
+    int64_t days = t / 86400;
+    int64_t secs = t % 86400;
+    int64_t era, doe, yoe, doy, mp, year;
+
+    if (secs < 0) {
+        secs += 86400;
+        days--;
+    }
+
+    /* Inverse of time_days_from_civil() */
+    era = (days + 719468 >= 0 ? days + 719468 : days + 719468 - 146096)
+        / 146097;
+    doe = days + 719468 - era * 146097;
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp  = (5 * doy + 2) / 153;
+    year = yoe + era * 400 + (mp >= 10);
+
+    if (year - 1900 > INT_MAX || year - 1900 < INT_MIN) {
+        errno = EOVERFLOW;
+        return NULL;
+    }
+
+    p_clear(tm, 1);
+    tm->tm_sec  = secs % 60;
+    tm->tm_min  = (secs / 60) % 60;
+    tm->tm_hour = secs / 3600;
+    tm->tm_mday = doy - (153 * mp + 2) / 5 + 1;
+    tm->tm_mon  = mp < 10 ? mp + 2 : mp - 10;
+    tm->tm_year = year - 1900;
+    tm->tm_wday = ((days + 4) % 7 + 7) % 7;
+    tm->tm_yday = days - time_days_from_civil(year, 0, 1);
+    tm->tm_zone = "GMT";
+    return tm;
+}
+
+/* UTC offset of the system timezone for a minute. */
+static __thread struct {
+    const char *tz;
+    int64_t     minute;
+    long        gmtoff;
+    int         isdst;
+    bool        valid;
+    const char *zone;
+} localtime_cache_g;
+
+struct tm *time_localtime(time_t t, struct tm *tm)
+{
+    const char *tz = getenv("TZ");
+    int64_t minute = t >= 0 ? t / 60 : (t - 59) / 60;
+
+    if (localtime_cache_g.valid && localtime_cache_g.minute == minute
+    &&  localtime_cache_g.tz == tz)
+    {
+        RETHROW_P(time_gmtime(t + localtime_cache_g.gmtoff, tm));
+        tm->tm_isdst  = localtime_cache_g.isdst;
+        tm->tm_gmtoff = localtime_cache_g.gmtoff;
+        tm->tm_zone   = localtime_cache_g.zone;
+        return tm;
+    }
+
+    localtime_cache_g.valid = false;
+    RETHROW_P(localtime_r(&t, tm));
+    localtime_cache_g.tz     = tz;
+    localtime_cache_g.minute = minute;
+    localtime_cache_g.gmtoff = tm->tm_gmtoff;
+    localtime_cache_g.isdst  = tm->tm_isdst;
+    localtime_cache_g.zone   = tm->tm_zone;
+    localtime_cache_g.valid  = true;
+    return tm;
+}
+
 struct tm *time_get_localtime(const time_t *p_ts, struct tm *p_tm,
                               const char *tz)
 {
     const char *old_tz;
     bool tz_changed = false;
 
-    if (tz) {
-        old_tz = getenv("TZ");
+    if (!tz) {
+        time_localtime(*p_ts, p_tm);
+        return p_tm;
+    }
 
-        if (!old_tz || !strequal(old_tz, tz)) {
-            setenv("TZ", tz, true);
-            tzset();
-            tz_changed = true;
-        }
+    old_tz = getenv("TZ");
+    if (!old_tz || !strequal(old_tz, tz)) {
+        setenv("TZ", tz, true);
+        tzset();
+        tz_changed = true;
     }
 
     localtime_r(p_ts, p_tm);
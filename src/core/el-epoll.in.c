@@ -21,26 +21,133 @@
 #include <lib-common/unix.h>
 #include <lib-common/thr.h>
 
-static struct {
+typedef struct el_epoll_t {
     int fd;
     int pending;
     int generation;
+    bool initialized;
+    bool use_uring;
+
+    /* spin budgets of the busy polling, in us, see el_fd_set_busy_poll() */
+    int busy_poll_max;
+    int busy_poll_cur;
+
+    /* dispatch budgets of the priorities, see el_fd_set_dispatch_budget() */
+    int read_budget[EV_PRIORITY_HIGH + 1];
+    int time_budget[EV_PRIORITY_HIGH + 1];
+
+    /* per-priority dispatch queues: the positions in events of the ready
+     * fds of each priority, and where the next dispatch of the priority
+     * starts when the previous one ran out of time */
+    int      queue_len[EV_PRIORITY_HIGH + 1];
+    int      queue_start[EV_PRIORITY_HIGH + 1];
+    uint16_t queues[EV_PRIORITY_HIGH + 1][FD_SETSIZE];
+
     struct epoll_event events[FD_SETSIZE];
-} el_epoll_g = {
+} el_epoll_t;
+
+/* the smallest budget of the busy polling when it grows back from 0 */
+#define EL_BUSY_POLL_MIN  10
+
+static struct {
+    atomic_uint64_t spin_ns;
+    atomic_uint64_t spin_hits;
+    atomic_uint64_t sleeps;
+} el_busy_poll_stats_g;
+
+static el_epoll_t el_epoll_main_g = {
     .fd = -1,
+    .read_budget = {
+        [EV_PRIORITY_LOW]    = EL_FD_READ_BUDGET_LOW,
+        [EV_PRIORITY_NORMAL] = EL_FD_READ_BUDGET_NORMAL,
+    },
+    .time_budget = {
+        [EV_PRIORITY_LOW]    = EL_FD_TIME_BUDGET_LOW,
+        [EV_PRIORITY_NORMAL] = EL_FD_TIME_BUDGET_NORMAL,
+    },
 };
+static __thread el_epoll_t *el_epoll_cur_g = &el_epoll_main_g;
+#define el_epoll_g  (*el_epoll_cur_g)
+
+#include "el-uring.in.c"
+
+/* Give its own fds backend to the loop of the calling thread, with the
+ * same kind of backend as the main loop. */
+static void el_fd_loop_init(void)
+{
+    el_epoll_cur_g = p_new(el_epoll_t, 1);
+    el_epoll_g.fd = -1;
+    el_epoll_g.use_uring = el_epoll_main_g.use_uring;
+    p_copy(el_epoll_g.read_budget, el_epoll_main_g.read_budget,
+           countof(el_epoll_g.read_budget));
+    p_copy(el_epoll_g.time_budget, el_epoll_main_g.time_budget,
+           countof(el_epoll_g.time_budget));
+#ifdef EL_HAS_IO_URING
+    el_uring_cur_g = p_new(el_uring_t, 1);
+    el_uring_g.fd = -1;
+#endif
+}
+
+static void el_fd_loop_wipe(void)
+{
+    p_close(&el_epoll_g.fd);
+    p_delete(&el_epoll_cur_g);
+    el_epoll_cur_g = &el_epoll_main_g;
+#ifdef EL_HAS_IO_URING
+    el_uring_wipe();
+    p_delete(&el_uring_cur_g);
+    el_uring_cur_g = &el_uring_main_g;
+#endif
+}
+
+int el_fd_set_backend(el_fd_backend_t backend)
+{
+    bool use_uring = backend == EL_FD_BACKEND_IO_URING;
+
+    if (el_epoll_g.initialized) {
+        return el_epoll_g.use_uring == use_uring ? 0 : -1;
+    }
+#ifdef EL_HAS_IO_URING
+    if (use_uring && el_uring_initialize() < 0) {
+        return -1;
+    }
+    el_epoll_g.use_uring = use_uring;
+    return 0;
+#else
+    return use_uring ? -1 : 0;
+#endif
+}
+
+el_fd_backend_t el_fd_get_backend(void)
+{
+    return el_epoll_g.use_uring ? EL_FD_BACKEND_IO_URING
+                                : EL_FD_BACKEND_EPOLL;
+}
 
 static void el_fd_at_fork(void)
 {
     p_close(&el_epoll_g.fd);
+#ifdef EL_HAS_IO_URING
+    el_uring_wipe();
+#endif
+    el_epoll_g.initialized = false;
     el_epoll_g.generation++;
 }
 
 static void el_fd_initialize(void)
 {
-    if (unlikely(el_epoll_g.fd == -1)) {
+    if (unlikely(!el_epoll_g.initialized)) {
 #ifdef SIGPIPE
         signal(SIGPIPE, SIG_IGN);
+#endif
+        el_epoll_g.initialized = true;
+#ifdef EL_HAS_IO_URING
+        if (el_epoll_g.use_uring) {
+            if (el_uring_g.fd < 0 && el_uring_initialize() < 0) {
+                e_panic("io_uring is not available anymore");
+            }
+            return;
+        }
 #endif
         el_epoll_g.fd = epoll_create(1024);
         if (el_epoll_g.fd < 0)
@@ -64,6 +171,21 @@ el_t el_fd_register_d(int fd, bool own_fd, short events, el_fd_f *cb,
     ev->fd.generation = el_epoll_g.generation;
     ev->events_wanted = events;
     ev->priority = EV_PRIORITY_NORMAL;
+#ifdef EL_HAS_IO_URING
+    if (el_epoll_g.use_uring) {
+        el_uring_register(ev);
+        return ev;
+    }
+#endif
+#ifdef SO_BUSY_POLL
+    if (el_epoll_g.busy_poll_max) {
+        int us = el_epoll_g.busy_poll_max;
+
+        /* fails on the fds that are not sockets, or when the budget is
+         * above net.core.busy_read without CAP_NET_ADMIN */
+        IGNORE(setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us)));
+    }
+#endif
     if (unlikely(epoll_ctl(el_epoll_g.fd, EPOLL_CTL_ADD, fd, &event)))
         e_panic(E_UNIXERR("epoll_ctl"));
     return ev;
@@ -83,6 +205,13 @@ short el_fd_set_mask(ev_t *ev, short events)
             .data.ptr = ev,
             .events   = ev->events_wanted = events,
         };
+
+#ifdef EL_HAS_IO_URING
+        if (el_epoll_g.use_uring) {
+            el_uring_set_mask(ev);
+            return old;
+        }
+#endif
         if (unlikely(epoll_ctl(el_epoll_g.fd, EPOLL_CTL_MOD, ev->fd.fd,
                                &event))) {
             e_panic(E_UNIXERR("epoll_ctl"));
@@ -98,7 +227,14 @@ data_t el_fd_unregister(ev_t **evp)
 
         CHECK_EV_TYPE(ev, EV_FD);
         if (el_epoll_g.generation == ev->fd.generation) {
-            epoll_ctl(el_epoll_g.fd, EPOLL_CTL_DEL, ev->fd.fd, NULL);
+#ifdef EL_HAS_IO_URING
+            if (el_epoll_g.use_uring) {
+                el_uring_disarm(ev);
+            } else
+#endif
+            {
+                epoll_ctl(el_epoll_g.fd, EPOLL_CTL_DEL, ev->fd.fd, NULL);
+            }
         }
         if (ev->fd.owned) {
             close(ev->fd.fd);
@@ -114,15 +250,175 @@ data_t el_fd_unregister(ev_t **evp)
     return (data_t)NULL;
 }
 
+/* {{{ Busy polling */
+
+void el_fd_set_busy_poll(int budget_us)
+{
+    el_epoll_g.busy_poll_max = MAX(budget_us, 0);
+    el_epoll_g.busy_poll_cur = el_epoll_g.busy_poll_max;
+}
+
+void el_fd_get_busy_poll_stats(el_fd_busy_poll_stats_t *stats)
+{
+    stats->spin_ns   = atomic_load(&el_busy_poll_stats_g.spin_ns);
+    stats->spin_hits = atomic_load(&el_busy_poll_stats_g.spin_hits);
+    stats->sleeps    = atomic_load(&el_busy_poll_stats_g.sleeps);
+}
+
+static uint64_t el_busy_poll_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Spin on a non-blocking epoll_wait() for the current budget, then sleep.
+ *
+ * The budget adapts to the traffic as the halt polling of KVM does: when
+ * the sleep is woken up within the maximum budget, a longer spin would have
+ * caught the event and the budget is doubled; when it sleeps longer, the
+ * spin was useless and the budget is halved, down to no spin at all.
+ */
+static int el_fd_busy_poll_wait(int timeout)
+{
+    uint64_t spin = (uint64_t)el_epoll_g.busy_poll_cur * 1000;
+    uint64_t start = el_busy_poll_clock();
+    uint64_t now = start;
+    int res = 0;
+
+    if (timeout >= 0) {
+        spin = MIN(spin, timeout * 1000000ULL);
+    }
+    while (now - start < spin) {
+        res = epoll_wait(el_epoll_g.fd, el_epoll_g.events,
+                         countof(el_epoll_g.events), 0);
+        now = el_busy_poll_clock();
+        if (res != 0) {
+            break;
+        }
+        cpu_relax();
+    }
+    if (now > start) {
+        atomic_fetch_add_explicit(&el_busy_poll_stats_g.spin_ns, now - start,
+                                  memory_order_relaxed);
+    }
+    if (res != 0) {
+        if (res > 0) {
+            atomic_fetch_add_explicit(&el_busy_poll_stats_g.spin_hits, 1,
+                                      memory_order_relaxed);
+        }
+        return res;
+    }
+
+    if (timeout >= 0) {
+        timeout = MAX(timeout - (int)((now - start) / 1000000), 0);
+    }
+    res = epoll_wait(el_epoll_g.fd, el_epoll_g.events,
+                     countof(el_epoll_g.events), timeout);
+    atomic_fetch_add_explicit(&el_busy_poll_stats_g.sleeps, 1,
+                              memory_order_relaxed);
+
+    if (el_busy_poll_clock() - start
+        <= (uint64_t)el_epoll_g.busy_poll_max * 1000)
+    {
+        el_epoll_g.busy_poll_cur = el_epoll_g.busy_poll_cur
+            ? MIN(el_epoll_g.busy_poll_cur * 2, el_epoll_g.busy_poll_max)
+            : MIN(EL_BUSY_POLL_MIN, el_epoll_g.busy_poll_max);
+    } else {
+        el_epoll_g.busy_poll_cur /= 2;
+    }
+    return res;
+}
+
+/* }}} */
+/* {{{ Dispatch budgets */
+
+void el_fd_set_dispatch_budget(ev_priority_t prio, int read_bytes,
+                               int time_us)
+{
+    assert (prio <= EV_PRIORITY_HIGH);
+    el_epoll_g.read_budget[prio] = MAX(read_bytes, 0);
+    el_epoll_g.time_budget[prio] = MAX(time_us, 0);
+}
+
+int el_fd_get_read_budget(ev_t *ev)
+{
+    CHECK_EV_TYPE(ev, EV_FD);
+    return el_epoll_g.read_budget[ev->priority] ?: INT_MAX;
+}
+
+/* Fire the ready fds of a priority, within its time budget.
+ *
+ * When the budget runs out, the fds left are not fired in this iteration,
+ * and the next dispatch of the priority starts with them. The poll reports
+ * them in about the same order each time, so this also takes turns between
+ * the fds when they are all ready at each iteration.
+ */
+static void el_fd_dispatch_queue(ev_priority_t prio)
+{
+    const uint16_t *queue = el_epoll_g.queues[prio];
+    int len = el_epoll_g.queue_len[prio];
+    int start = el_epoll_g.queue_start[prio];
+    uint64_t budget = el_epoll_g.time_budget[prio] * 1000ULL;
+    uint64_t begin;
+
+    if (!len) {
+        return;
+    }
+    begin = budget ? el_busy_poll_clock() : 0;
+    if (start >= len) {
+        start = 0;
+    }
+    el_epoll_g.queue_start[prio] = 0;
+    for (int i = 0; i < len; i++) {
+        int pos = (start + i) % len;
+        ev_t *ev = el_epoll_g.events[queue[pos]].data.ptr;
+
+        /* the callbacks can unregister the fds of the queue */
+        if (unlikely(ev->type != EV_FD)) {
+            continue;
+        }
+        el_fd_fire(ev, el_epoll_g.events[queue[pos]].events);
+
+        if (budget && i + 1 < len
+        &&  el_busy_poll_clock() - begin >= budget)
+        {
+            el_epoll_g.queue_start[prio] = (pos + 1) % len;
+            break;
+        }
+    }
+}
+
+/* }}} */
+
 static void el_loop_fds_poll(int timeout)
 {
-    el_bl_unlock();
+    bool is_main = el_loop_g == &el_main_g;
+
+    if (is_main) {
+        el_bl_unlock();
+        thr_enter_blocking_syscall();
+    }
     timeout = el_signal_has_pending_events() ? 0 : timeout;
-    thr_enter_blocking_syscall();
-    el_epoll_g.pending = epoll_wait(el_epoll_g.fd, el_epoll_g.events,
-                                    countof(el_epoll_g.events), timeout);
-    thr_exit_blocking_syscall();
-    el_bl_lock();
+#ifdef EL_HAS_IO_URING
+    if (el_epoll_g.use_uring) {
+        el_epoll_g.pending = el_uring_wait(el_epoll_g.events,
+                                           countof(el_epoll_g.events),
+                                           timeout);
+    } else
+#endif
+    if (el_epoll_g.busy_poll_max && timeout != 0) {
+        el_epoll_g.pending = el_fd_busy_poll_wait(timeout);
+    } else {
+        el_epoll_g.pending = epoll_wait(el_epoll_g.fd, el_epoll_g.events,
+                                        countof(el_epoll_g.events),
+                                        timeout);
+    }
+    if (is_main) {
+        thr_exit_blocking_syscall();
+        el_bl_lock();
+    }
     assert (el_epoll_g.pending >= 0 || ERR_RW_RETRIABLE(errno));
 }
 
@@ -137,14 +433,16 @@ static bool el_fds_has_pending_events(void)
 static void el_loop_fds(int timeout)
 {
     ev_priority_t prio = EV_PRIORITY_LOW;
-    int res, res2;
+    int res;
     uint64_t before, now;
 
     el_fd_initialize();
 
     if (el_epoll_g.pending == 0) {
         before = get_clock();
+        el_prof_loop_wait();
         el_loop_fds_poll(timeout);
+        el_prof_loop_woken();
         now    = get_clock();
         if (now - before > 100) {
             dlist_splice_tail(&_G.idle, &_G.idle_parked);
@@ -153,33 +451,25 @@ static void el_loop_fds(int timeout)
         now = get_clock();
     }
 
-    res = res2 = el_epoll_g.pending;
+    res = el_epoll_g.pending;
     el_epoll_g.pending = 0;
 
     _G.has_run = false;
     el_timer_process(now);
+
+    p_clear(&el_epoll_g.queue_len, 1);
     while (res-- > 0) {
         ev_t *ev = el_epoll_g.events[res].data.ptr;
-        int  evs = el_epoll_g.events[res].events;
 
         if (unlikely(ev->type != EV_FD))
             continue;
         if (ev->priority > prio)
             prio = ev->priority;
-        if (ev->priority == EV_PRIORITY_HIGH)
-            el_fd_fire(ev, evs);
+        el_epoll_g.queues[ev->priority][el_epoll_g.queue_len[ev->priority]++]
+            = res;
     }
 
-    if (prio == EV_PRIORITY_HIGH) {
-        return;
-    }
-    while (res2-- > 0) {
-        ev_t *ev = el_epoll_g.events[res2].data.ptr;
-        int  evs = el_epoll_g.events[res2].events;
-
-        if (unlikely(ev->type != EV_FD))
-            continue;
-        if (ev->priority == prio)
-            el_fd_fire(ev, evs);
-    }
+    /* only the fds of the highest priority are fired, the others are
+     * reported again by the next polls */
+    el_fd_dispatch_queue(prio);
 }
@@ -0,0 +1,305 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+/* io_uring backend of the fds, used by el-epoll.in.c when selected with
+ * el_fd_set_backend().
+ *
+ * Each watched fd has a one-shot poll request in the ring, that is armed
+ * again each time it completes: as the kernel polls the file when the
+ * request is submitted, this keeps the level-triggered semantics of epoll.
+ * The requests (arming, changes of mask and removals) are only queued in
+ * the submission ring, and submitted with the wait of the loop in a single
+ * io_uring_enter() call.
+ *
+ * The completions are translated into epoll events so that the dispatch of
+ * el_loop_fds() is shared by the backends. Their user data is the ev_t and
+ * a sequence number that is changed each time the request of the ev_t is
+ * replaced, so that the completions of the cancelled and stale requests
+ * can be recognized and ignored. The requests without ev_t (the removals)
+ * have a null user data.
+ */
+
+#if __has_include(<linux/io_uring.h>)
+#  include <linux/io_uring.h>
+#endif
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if defined(IORING_FEAT_EXT_ARG) && defined(__NR_io_uring_setup)
+#  define EL_HAS_IO_URING
+
+#define EL_URING_ENTRIES   256
+#define EL_URING_PTR_MASK  0x0000ffffffffffffULL
+
+typedef struct el_uring_t {
+    int       fd;
+    uint16_t  seq;
+    unsigned  to_submit;
+
+    unsigned  sq_entries;
+    unsigned  sq_mask;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+
+    unsigned  cq_mask;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    struct io_uring_cqe *cqes;
+
+    void     *ring;
+    size_t    ring_size;
+    size_t    sqes_size;
+} el_uring_t;
+
+static el_uring_t el_uring_main_g = {
+    .fd = -1,
+};
+static __thread el_uring_t *el_uring_cur_g = &el_uring_main_g;
+#define el_uring_g  (*el_uring_cur_g)
+
+static unsigned el_uring_load(unsigned *p)
+{
+    return atomic_load_explicit((_Atomic(unsigned) *)p,
+                                memory_order_acquire);
+}
+
+static void el_uring_store(unsigned *p, unsigned v)
+{
+    atomic_store_explicit((_Atomic(unsigned) *)p, v, memory_order_release);
+}
+
+static void el_uring_wipe(void)
+{
+    if (el_uring_g.fd >= 0) {
+        /* after a fork, the rings are shared with the parent */
+        munmap(el_uring_g.sqes, el_uring_g.sqes_size);
+        munmap(el_uring_g.ring, el_uring_g.ring_size);
+        p_close(&el_uring_g.fd);
+    }
+}
+
+static int el_uring_initialize(void)
+{
+    struct io_uring_params params = {
+        .flags      = IORING_SETUP_CQSIZE,
+        .cq_entries = 4 * FD_SETSIZE,
+    };
+    size_t sq_size;
+    size_t cq_size;
+    byte *ring;
+    int fd;
+
+    fd = syscall(__NR_io_uring_setup, EL_URING_ENTRIES, &params);
+    if (fd < 0) {
+        return -1;
+    }
+
+    /* the wait with a timeout needs IORING_FEAT_EXT_ARG (linux 5.11),
+     * which implies the single mmap and the non-dropping completions */
+    if (!(params.features & IORING_FEAT_EXT_ARG)
+    ||  !(params.features & IORING_FEAT_SINGLE_MMAP)
+    ||  !(params.features & IORING_FEAT_NODROP))
+    {
+        close(fd);
+        return -1;
+    }
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes
+            + params.cq_entries * sizeof(struct io_uring_cqe);
+    el_uring_g.ring_size = MAX(sq_size, cq_size);
+    el_uring_g.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    ring = mmap(NULL, el_uring_g.ring_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring == MAP_FAILED) {
+        e_panic(E_UNIXERR("mmap"));
+    }
+    el_uring_g.sqes = mmap(NULL, el_uring_g.sqes_size,
+                           PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (el_uring_g.sqes == MAP_FAILED) {
+        e_panic(E_UNIXERR("mmap"));
+    }
+
+    el_uring_g.ring       = ring;
+    el_uring_g.sq_entries = params.sq_entries;
+    el_uring_g.sq_mask    = *(unsigned *)(ring + params.sq_off.ring_mask);
+    el_uring_g.sq_head    = (unsigned *)(ring + params.sq_off.head);
+    el_uring_g.sq_tail    = (unsigned *)(ring + params.sq_off.tail);
+    el_uring_g.sq_array   = (unsigned *)(ring + params.sq_off.array);
+    el_uring_g.cq_mask    = *(unsigned *)(ring + params.cq_off.ring_mask);
+    el_uring_g.cq_head    = (unsigned *)(ring + params.cq_off.head);
+    el_uring_g.cq_tail    = (unsigned *)(ring + params.cq_off.tail);
+    el_uring_g.cqes = (struct io_uring_cqe *)(ring + params.cq_off.cqes);
+    el_uring_g.to_submit  = 0;
+
+    fd_set_features(fd, O_CLOEXEC);
+    el_uring_g.fd = fd;
+    return 0;
+}
+
+static int el_uring_enter(unsigned min_complete, int timeout)
+{
+    struct __kernel_timespec ts = {
+        .tv_sec  = timeout / 1000,
+        .tv_nsec = (timeout % 1000) * 1000000,
+    };
+    struct io_uring_getevents_arg arg = {
+        .ts = timeout >= 0 ? (uintptr_t)&ts : 0,
+    };
+    unsigned flags = IORING_ENTER_EXT_ARG;
+    int res;
+
+    if (min_complete) {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+    res = syscall(__NR_io_uring_enter, el_uring_g.fd, el_uring_g.to_submit,
+                  min_complete, flags, &arg, sizeof(arg));
+    if (res > 0) {
+        el_uring_g.to_submit -= res;
+    }
+    return res;
+}
+
+static struct io_uring_sqe *el_uring_get_sqe(void)
+{
+    unsigned tail = *el_uring_g.sq_tail;
+    struct io_uring_sqe *sqe;
+
+    while (tail - el_uring_load(el_uring_g.sq_head)
+           >= el_uring_g.sq_entries)
+    {
+        /* the submission ring is full, flush it */
+        if (el_uring_enter(0, -1) < 0 && !ERR_RW_RETRIABLE(errno)
+        &&  errno != EBUSY)
+        {
+            e_panic(E_UNIXERR("io_uring_enter"));
+        }
+    }
+    sqe = &el_uring_g.sqes[tail & el_uring_g.sq_mask];
+    p_clear(sqe, 1);
+    return sqe;
+}
+
+static void el_uring_push_sqe(void)
+{
+    unsigned tail = *el_uring_g.sq_tail;
+
+    el_uring_g.sq_array[tail & el_uring_g.sq_mask] =
+        tail & el_uring_g.sq_mask;
+    el_uring_store(el_uring_g.sq_tail, tail + 1);
+    el_uring_g.to_submit++;
+}
+
+static uint64_t el_uring_user_data(const ev_t *ev)
+{
+    return ((uint64_t)ev->fd.uring_seq << 48) | (uintptr_t)ev;
+}
+
+static void el_uring_arm(ev_t *ev)
+{
+    struct io_uring_sqe *sqe = el_uring_get_sqe();
+
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->fd            = ev->fd.fd;
+    sqe->poll32_events = ev->events_wanted;
+    sqe->user_data     = el_uring_user_data(ev);
+    el_uring_push_sqe();
+}
+
+static void el_uring_disarm(ev_t *ev)
+{
+    struct io_uring_sqe *sqe = el_uring_get_sqe();
+
+    sqe->opcode    = IORING_OP_POLL_REMOVE;
+    sqe->fd        = -1;
+    sqe->addr      = el_uring_user_data(ev);
+    sqe->user_data = 0;
+    el_uring_push_sqe();
+}
+
+static void el_uring_register(ev_t *ev)
+{
+    ev->fd.uring_seq = ++el_uring_g.seq;
+    el_uring_arm(ev);
+}
+
+static void el_uring_set_mask(ev_t *ev)
+{
+    el_uring_disarm(ev);
+    el_uring_register(ev);
+}
+
+/* Translate the completions into epoll events, at most max of them. */
+static int el_uring_reap(struct epoll_event *events, int max)
+{
+    unsigned head = *el_uring_g.cq_head;
+    unsigned tail = el_uring_load(el_uring_g.cq_tail);
+    int res = 0;
+
+    for (; head != tail && res < max; head++) {
+        struct io_uring_cqe *cqe;
+        ev_t *ev;
+
+        cqe = &el_uring_g.cqes[head & el_uring_g.cq_mask];
+        ev = (ev_t *)(uintptr_t)(cqe->user_data & EL_URING_PTR_MASK);
+
+        if (!ev || ev->type != EV_FD
+        ||  ev->fd.uring_seq != (uint16_t)(cqe->user_data >> 48)
+        ||  ev->fd.generation != el_epoll_g.generation)
+        {
+            continue;
+        }
+        if (cqe->res < 0 && cqe->res != -ECANCELED) {
+            errno = -cqe->res;
+            e_panic(E_UNIXERR("io_uring poll"));
+        }
+
+        /* the request is one-shot, it will be armed again with the next
+         * wait, after the callback has run */
+        el_uring_arm(ev);
+        if (cqe->res > 0) {
+            events[res++] = (struct epoll_event){
+                .events   = cqe->res,
+                .data.ptr = ev,
+            };
+        }
+    }
+    el_uring_store(el_uring_g.cq_head, head);
+    return res;
+}
+
+static int el_uring_wait(struct epoll_event *events, int max, int timeout)
+{
+    unsigned ready = el_uring_load(el_uring_g.cq_tail)
+                   - *el_uring_g.cq_head;
+
+    if (el_uring_g.to_submit || (!ready && timeout != 0)) {
+        if (el_uring_enter(ready || timeout == 0 ? 0 : 1, timeout) < 0
+        &&  !ERR_RW_RETRIABLE(errno) && errno != ETIME && errno != EBUSY)
+        {
+            e_panic(E_UNIXERR("io_uring_enter"));
+        }
+    }
+    return el_uring_reap(events, max);
+}
+
+#endif
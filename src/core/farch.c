@@ -20,9 +20,15 @@
 #include <lib-common/container-qhash.h>
 #include <lib-common/qlzo.h>
 
-qm_khptr_ckey_t(persisted, farch_entry_t, lstr_t);
+typedef struct farch_cached_t {
+    lstr_t content;
+    int refcnt;
+} farch_cached_t;
+
+qm_khptr_ckey_t(persisted, farch_entry_t, farch_cached_t);
 
 static struct {
+    spinlock_t lock;
     qm_t(persisted) persisted;
 } farch_g;
 #define _G  farch_g
@@ -54,6 +60,62 @@ static lstr_t t_farch_aggregate(const farch_entry_t *entry)
     return LSTR_INIT_V(contents, entry->compressed_size);
 }
 
+/* Unobfuscate the [start, end[ range of the compressed content. */
+static int farch_aggregate_range(const farch_entry_t *entry, int start,
+                                 int end, char *out)
+{
+    int pos = 0;
+
+    for (int i = 0; i < entry->nb_chunks && pos < end; i++) {
+        lstr_t chunk = entry->chunks[i];
+        int chunk_end = pos + chunk.len;
+
+        if (chunk_end > start) {
+            /* Chunks must be unobfuscated as a whole. */
+            char buf[FARCH_MAX_SYMBOL_SIZE];
+            int from = MAX(start, pos);
+            int to = MIN(end, chunk_end);
+
+            if (!expect(chunk.len <= FARCH_MAX_SYMBOL_SIZE)) {
+                return -1;
+            }
+            lstr_unobfuscate(chunk, chunk.len,
+                             LSTR_INIT_V(buf, chunk.len));
+            memcpy(out + from - start, buf + from - pos, to - from);
+        }
+        pos = chunk_end;
+    }
+
+    return expect(pos >= end) ? 0 : -1;
+}
+
+/* Uncompress the block blk of an entry compressed by blocks. */
+static int farch_unarchive_block(const farch_entry_t *entry, int blk,
+                                 char *out)
+{
+    t_scope;
+    int start = entry->block_offsets[blk];
+    int end = entry->block_offsets[blk + 1];
+    int size = MIN(entry->block_size, entry->size - blk * entry->block_size);
+    char *cbuf;
+
+    if (!expect(start <= end && end <= entry->compressed_size)) {
+        return -1;
+    }
+    if (end - start == size) {
+        return farch_aggregate_range(entry, start, end, out);
+    }
+
+    cbuf = t_new_raw(char, end - start);
+    RETHROW(farch_aggregate_range(entry, start, end, cbuf));
+    if (qlzo1x_decompress_safe(out, size, ps_init(cbuf, end - start))
+        != size)
+    {
+        return -1;
+    }
+    return 0;
+}
+
 char *farch_get_filename(const farch_entry_t *entry, char *name)
 {
     lstr_t out = LSTR_INIT(name, entry->name.len);
@@ -101,6 +163,20 @@ lstr_t t_farch_unarchive(const farch_entry_t *entry)
         t_scope;
         lstr_t contents;
 
+        if (entry->block_size > 0) {
+            int nb_blocks = DIV_ROUND_UP(entry->size, entry->block_size);
+
+            for (int i = 0; i < nb_blocks; i++) {
+                if (farch_unarchive_block(entry, i,
+                                          res.v + i * entry->block_size) < 0)
+                {
+                    goto error;
+                }
+            }
+            res.len = entry->size;
+            break;
+        }
+
         contents = t_farch_aggregate(entry); /* (and unobfuscate) */
         if (!contents.s) {
             goto error;
@@ -128,26 +204,113 @@ lstr_t t_farch_unarchive(const farch_entry_t *entry)
     e_panic("cannot uncompress farch entry `%s`", real_name);
 }
 
-lstr_t farch_unarchive_persist(const farch_entry_t * nonnull entry)
+lstr_t t_farch_unarchive_range(const farch_entry_t *entry, int offset,
+                               int len)
+{
+    lstr_t res;
+    int first;
+    int last;
+    char *blocks;
+
+    if (offset < 0 || offset > entry->size || len < 0) {
+        return LSTR_NULL_V;
+    }
+    len = MIN(len, entry->size - offset);
+
+    if (entry->block_size <= 0) {
+        res = t_farch_unarchive(entry);
+        return LSTR_INIT_V(res.s + offset, len);
+    }
+    if (len == 0) {
+        return LSTR_EMPTY_V;
+    }
+
+    /* Only uncompress the blocks covering the range. */
+    first = offset / entry->block_size;
+    last = (offset + len - 1) / entry->block_size;
+    blocks = t_new_raw(char, (last - first + 1) * entry->block_size + 1);
+    for (int i = first; i <= last; i++) {
+        if (farch_unarchive_block(entry, i,
+                                  blocks + (i - first) * entry->block_size)
+            < 0)
+        {
+            char real_name[FARCH_MAX_FILENAME];
+
+            e_panic("cannot uncompress farch entry `%s`",
+                    farch_get_filename(entry, real_name));
+        }
+    }
+
+    res = LSTR_INIT_V(blocks + offset - first * entry->block_size, len);
+    res.v[len] = '\0';
+    return res;
+}
+
+lstr_t farch_unarchive_acquire(const farch_entry_t *entry)
 {
     t_scope;
+    farch_cached_t *cached;
     lstr_t content;
     uint32_t pos;
 
     assert (MODULE_IS_LOADED(farch));
 
-    pos = qm_reserve(persisted, &_G.persisted, entry, 0);
-    if (pos & QHASH_COLLISION) {
-        return _G.persisted.values[pos ^ QHASH_COLLISION];
+    spin_lock(&_G.lock);
+    cached = qm_get_def_p_safe(persisted, &_G.persisted, entry, NULL);
+    if (cached) {
+        cached->refcnt++;
+        content = cached->content;
+        spin_unlock(&_G.lock);
+        return content;
     }
+    spin_unlock(&_G.lock);
 
+    /* Uncompress without holding the lock; another thread may do the same
+     * for this entry, in which case the first one wins. */
     content = t_farch_unarchive(entry);
-    lstr_persists(&content);
-    _G.persisted.values[pos] = content;
+
+    spin_lock(&_G.lock);
+    pos = qm_reserve(persisted, &_G.persisted, entry, 0);
+    if (pos & QHASH_COLLISION) {
+        cached = &_G.persisted.values[pos ^ QHASH_COLLISION];
+        cached->refcnt++;
+        content = cached->content;
+    } else {
+        lstr_persists(&content);
+        _G.persisted.values[pos] = (farch_cached_t){
+            .content = content,
+            .refcnt = 1,
+        };
+    }
+    spin_unlock(&_G.lock);
 
     return content;
 }
 
+void farch_unarchive_release(const farch_entry_t *entry)
+{
+    int32_t pos;
+
+    spin_lock(&_G.lock);
+    pos = qm_find(persisted, &_G.persisted, entry);
+    if (expect(pos >= 0)) {
+        farch_cached_t *cached = &_G.persisted.values[pos];
+
+        if (--cached->refcnt == 0) {
+            lstr_wipe(&cached->content);
+            qm_del_at(persisted, &_G.persisted, pos);
+        }
+    }
+    spin_unlock(&_G.lock);
+}
+
+lstr_t farch_unarchive_persist(const farch_entry_t * nonnull entry)
+{
+    /* The reference is never released, the content is freed with the
+     * module. */
+    return farch_unarchive_acquire(entry);
+}
+
 lstr_t t_farch_get_data(const farch_entry_t *files, const char *name)
 {
     const farch_entry_t *entry = name ? farch_get_entry(files, name) : files;
@@ -173,7 +336,10 @@ static int farch_initialize(void *arg)
 
 static int farch_shutdown(void)
 {
-    qm_deep_wipe(persisted, &_G.persisted, IGNORE, lstr_wipe);
+    qm_for_each_value_p(persisted, cached, &_G.persisted) {
+        lstr_wipe(&cached->content);
+    }
+    qm_wipe(persisted, &_G.persisted);
     return 0;
 }
 
@@ -17,6 +17,7 @@
 /***************************************************************************/
 
 #include <lib-common/file.h>
+#include <lib-common/file-aio.h>
 #include <lib-common/unix.h>
 
 /****************************************************************************/
@@ -38,6 +39,9 @@ static int file_flush_obuf(file_t *f, int len)
     assert (f->flags & FILE_WRONLY);
     assert (len <= f->obuf.len);
 
+    if (f->aio) {
+        return __file_aio_write(f, len);
+    }
     while (obuf->len > goal) {
         int nb = write(fd, obuf->data, obuf->len);
 
@@ -150,7 +154,12 @@ int file_close(file_t **fp)
     if (*fp) {
         file_t *f = *fp;
         int res = 0;
-        res = file_flush(f) | p_close(&f->fd);
+
+        if (f->aio) {
+            res = __file_aio_close(f);
+        } else {
+            res = file_flush(f) | p_close(&f->fd);
+        }
         sb_wipe(&f->obuf);
         p_delete(fp);
         return res;
@@ -166,8 +175,11 @@ off_t file_seek(file_t *f, off_t offset, int whence)
 {
     off_t res;
 
-    if (f->flags & FILE_WRONLY)
+    if (f->flags & FILE_WRONLY) {
         RETHROW(file_flush(f));
+        /* SEEK_END needs the size of the file */
+        RETHROW(file_aio_wait(f));
+    }
     res = lseek(f->fd, offset, whence);
     if (res != (off_t)-1) {
         f->wpos = res;
@@ -248,6 +260,23 @@ static ssize_t __file_writev(file_t *f, struct iovec *iov, size_t iovcnt)
     return res;
 }
 
+/* The writes of the async files are always buffered, and handed to the
+ * file_aio service once the buffer is large enough. */
+static ssize_t file_writev_async(file_t *f, const struct iovec *iov,
+                                 size_t iovcnt)
+{
+    ssize_t res = 0;
+
+    for (size_t i = 0; i < iovcnt; i++) {
+        sb_add(&f->obuf, iov[i].iov_base, iov[i].iov_len);
+        res += iov[i].iov_len;
+    }
+    if (f->obuf.len >= FILE_AIO_WRITE_BEHIND) {
+        RETHROW(file_flush(f));
+    }
+    return res;
+}
+
 ssize_t file_writev(file_t *f, const struct iovec *iov, size_t iovcnt)
 {
     struct iovec iov2[IOV_MAX];
@@ -260,6 +289,9 @@ ssize_t file_writev(file_t *f, const struct iovec *iov, size_t iovcnt)
         errno = EINVAL;
         return -1;
     }
+    if (f->aio) {
+        return file_writev_async(f, iov, iovcnt);
+    }
 
     iov2[0] = MAKE_IOVEC(f->obuf.data, f->obuf.len);
     p_copy(iov2 + 1, iov, iovcnt);
@@ -292,6 +324,10 @@ ssize_t file_write(file_t *f, const void *data, size_t len)
         errno = EBADF;
         return -1;
     }
+    if (f->aio) {
+        iov[0] = MAKE_IOVEC(data, len);
+        return file_writev_async(f, iov, 1);
+    }
     if (f->obuf.len) {
         iov[0] = MAKE_IOVEC(f->obuf.data, f->obuf.len);
         iov[1] = MAKE_IOVEC(data, len);
@@ -303,6 +339,9 @@ ssize_t file_write(file_t *f, const void *data, size_t len)
 
 int file_truncate(file_t *f, off_t len)
 {
+    /* the pending writes must not land beyond the new size */
+    RETHROW(file_aio_wait(f));
+
     if (len < f->wpos) {
         RETHROW(ftruncate(f->fd, len));
         RETHROW(lseek(f->fd, len, SEEK_SET));
@@ -314,6 +353,7 @@ int file_truncate(file_t *f, off_t len)
         if (len - f->wpos > BUFSIZ) {
             /* Buffer would be too big: flush */
             RETHROW(file_flush(f));
+            RETHROW(file_aio_wait(f));
             RETHROW(ftruncate(f->fd, len));
             RETHROW(lseek(f->fd, len, SEEK_SET));
             f->wpos = len;
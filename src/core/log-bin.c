@@ -0,0 +1,800 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/unix.h>
+#include <lib-common/thr.h>
+#include <lib-common/arith.h>
+#include <lib-common/datetime.h>
+
+#include <lib-common/log.h>
+
+/* File format {{{ */
+
+/* A binary log file starts with LOG_BIN_MAGIC and is followed by records,
+ * all the integers being little endian:
+ *
+ *  <record>  ::= <size:u32> <type:u8> <payload>  (size includes the header)
+ *
+ *  'H' header, written each time the file is opened:
+ *      <pid:u32> <program name>
+ *  'D' call site definition, written once per call site and per opening:
+ *      <id:u32> <level:i32> <line:i32> <nb_args:i8> <arg types:u8[nb_args]>
+ *      <file len:u16> <file> <func len:u16> <func> <format>
+ *  'E' event:
+ *      <id:u32> <timestamp ns:u64> <logger len:u16> <logger> <args>
+ *
+ * The arguments of an event are encoded according to the types of the call
+ * site:
+ *  - INT:    i32;
+ *  - LONG:   i64;
+ *  - DOUBLE: the bits of the double as u64;
+ *  - PTR:    u64;
+ *  - STR:    <len:u32> <bytes> <NUL>, len being UINT32_MAX for NULL;
+ *  - STRN:   as STR, for %.*s;
+ *  - BUF:    <len:u32> <bytes>.
+ *
+ * The call sites that are formatted when called have -1 arguments and their
+ * events have a single BUF argument.
+ *
+ * The call site identifiers are those of the process described by the last
+ * header record.
+ */
+
+#define LOG_BIN_MAGIC      "LCBLOG1\n"
+#define LOG_BIN_HDR_SIZE   5
+
+enum {
+    LOG_BIN_INT = 1,
+    LOG_BIN_LONG,
+    LOG_BIN_DOUBLE,
+    LOG_BIN_PTR,
+    LOG_BIN_STR,
+    LOG_BIN_STRN,
+    LOG_BIN_BUF,
+    LOG_BIN_LSTR,
+};
+
+/** Parse the conversion that starts after a '%' of a format.
+ *
+ * \param[out] types  the types of the arguments of the conversion, in
+ *                    order (stars, then value).
+ * \return the number of arguments of the conversion, or -1 if the
+ *         conversion cannot be logged in binary.
+ */
+static int log_bin_parse_conv(const char *fmt, const char **end,
+                              uint8_t types[static 3])
+{
+    const char *p = fmt;
+    bool is_long = false;
+    bool has_prec = false;
+    bool has_prec_star = false;
+    int nb = 0;
+
+    /* %*p? raw formatters, and %pL, exactly as iprintf parses them. */
+    if (p[0] == '*' && p[1] == 'p'
+    &&  (p[2] == 'M' || p[2] == 'X' || p[2] == 'x'))
+    {
+        types[0] = LOG_BIN_INT;
+        types[1] = LOG_BIN_BUF;
+        *end = p + 3;
+        return 2;
+    }
+    if (p[0] == 'p' && p[1] == 'L') {
+        types[0] = LOG_BIN_LSTR;
+        *end = p + 2;
+        return 1;
+    }
+
+    while (*p && strchr("-+ #0'", *p)) {
+        p++;
+    }
+    if (*p == '*') {
+        types[nb++] = LOG_BIN_INT;
+        p++;
+    } else {
+        while (isdigit((unsigned char)*p)) {
+            p++;
+        }
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            types[nb++] = LOG_BIN_INT;
+            has_prec_star = true;
+            p++;
+        } else {
+            has_prec = true;
+            while (isdigit((unsigned char)*p)) {
+                p++;
+            }
+        }
+    }
+    for (;; p++) {
+        switch (*p) {
+          case 'h':
+            continue;
+          case 'l': case 'j': case 'z': case 't': case 'q':
+            is_long = true;
+            continue;
+        }
+        break;
+    }
+
+    switch (*p) {
+      case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+        types[nb++] = is_long ? LOG_BIN_LONG : LOG_BIN_INT;
+        break;
+
+      case 'c':
+        if (is_long) {
+            return -1;
+        }
+        types[nb++] = LOG_BIN_INT;
+        break;
+
+      case 'e': case 'E': case 'f': case 'F':
+      case 'g': case 'G': case 'a': case 'A':
+        types[nb++] = LOG_BIN_DOUBLE;
+        break;
+
+      case 's':
+        /* A literal precision may bound a string that is not
+         * NUL-terminated, which cannot be copied. */
+        if (is_long || has_prec) {
+            return -1;
+        }
+        types[nb++] = has_prec_star ? LOG_BIN_STRN : LOG_BIN_STR;
+        break;
+
+      case 'p':
+        if (isalnum((unsigned char)p[1])) {
+            return -1;
+        }
+        types[nb++] = LOG_BIN_PTR;
+        break;
+
+      default:
+        /* %m, %n, %L..., %%... */
+        return -1;
+    }
+    *end = p + 1;
+    return nb;
+}
+
+/* }}} */
+/* Writer {{{ */
+
+typedef struct log_bin_buf_t {
+    spinlock_t lock;
+    sb_t       sb;
+    dlist_t    link;
+} log_bin_buf_t;
+
+#define LOG_BIN_BUF_FLUSH_SIZE  (64 << 10)
+
+static struct {
+    _Atomic int fd;
+    atomic_uint gen;
+    uint32_t    next_id;
+
+    /* Protects the registration of the call sites and the list of the
+     * buffers. */
+    spinlock_t  lock;
+    dlist_t     bufs;
+} log_bin_g = {
+    .fd   = -1,
+    .bufs = DLIST_INIT(log_bin_g.bufs),
+};
+
+static __thread log_bin_buf_t *log_bin_buf_g;
+
+static void log_bin_add_str16(sb_t *sb, const char *s)
+{
+    size_t len = strnlen(s, UINT16_MAX);
+
+    sb_add_le16(sb, len);
+    sb_add(sb, s, len);
+}
+
+static void log_bin_add_record_hdr(sb_t *sb, int type, int *pos)
+{
+    *pos = sb->len;
+    sb_growlen(sb, 4);
+    sb_addc(sb, type);
+}
+
+static void log_bin_end_record(sb_t *sb, int pos)
+{
+    put_unaligned_le32(sb->data + pos, sb->len - pos);
+}
+
+/* Must be called with the lock of the buffer. */
+static void log_bin_buf_write(log_bin_buf_t *buf, int fd)
+{
+    if (fd >= 0 && buf->sb.len) {
+        IGNORE(xwrite(fd, buf->sb.data, buf->sb.len));
+    }
+    sb_reset(&buf->sb);
+}
+
+static log_bin_buf_t *log_bin_buf_get(void)
+{
+    log_bin_buf_t *buf = log_bin_buf_g;
+
+    if (unlikely(!buf)) {
+        buf = log_bin_buf_g = p_new(log_bin_buf_t, 1);
+        sb_init(&buf->sb);
+        spin_lock(&log_bin_g.lock);
+        dlist_add_tail(&log_bin_g.bufs, &buf->link);
+        spin_unlock(&log_bin_g.lock);
+    }
+    return buf;
+}
+
+static void log_bin_thr_wipe(void)
+{
+    log_bin_buf_t *buf = log_bin_buf_g;
+
+    if (!buf) {
+        return;
+    }
+    spin_lock(&log_bin_g.lock);
+    dlist_remove(&buf->link);
+    spin_unlock(&log_bin_g.lock);
+
+    spin_lock(&buf->lock);
+    log_bin_buf_write(buf, atomic_load(&log_bin_g.fd));
+    spin_unlock(&buf->lock);
+
+    sb_wipe(&buf->sb);
+    p_delete(&log_bin_buf_g);
+}
+thr_hooks(NULL, log_bin_thr_wipe);
+
+/* Assign an identifier to the call site, and parse its format. */
+static void log_bin_site_register(log_bin_site_t *site)
+{
+    spin_lock(&log_bin_g.lock);
+    if (!site->id) {
+        const char *p = site->fmt;
+        int nb_args = 0;
+
+        while ((p = strchr(p, '%'))) {
+            uint8_t types[3];
+            int nb;
+
+            if (p[1] == '%') {
+                p += 2;
+                continue;
+            }
+            nb = log_bin_parse_conv(p + 1, &p, types);
+            if (nb < 0 || nb_args + nb > LOG_BIN_MAX_ARGS) {
+                nb_args = -1;
+                break;
+            }
+            memcpy(site->args + nb_args, types, nb);
+            nb_args += nb;
+        }
+        site->nb_args = nb_args;
+        atomic_store_explicit(&site->id, ++log_bin_g.next_id,
+                              memory_order_release);
+    }
+    spin_unlock(&log_bin_g.lock);
+}
+
+static void log_bin_add_site(sb_t *sb, const log_bin_site_t *site)
+{
+    int pos;
+
+    log_bin_add_record_hdr(sb, 'D', &pos);
+    sb_add_le32(sb, site->id);
+    sb_add_le32(sb, site->level);
+    sb_add_le32(sb, site->line);
+    sb_addc(sb, site->nb_args);
+    if (site->nb_args > 0) {
+        sb_add(sb, site->args, site->nb_args);
+    }
+    log_bin_add_str16(sb, site->file);
+    log_bin_add_str16(sb, site->func);
+    sb_adds(sb, site->fmt);
+    log_bin_end_record(sb, pos);
+}
+
+static void log_bin_add_args(sb_t *sb, const log_bin_site_t *site,
+                             va_list va)
+{
+    int last_int = 0;
+
+    for (int i = 0; i < site->nb_args; i++) {
+        switch (site->args[i]) {
+          case LOG_BIN_INT:
+            last_int = va_arg(va, int);
+            sb_add_le32(sb, last_int);
+            break;
+
+          case LOG_BIN_LONG:
+            sb_add_le64(sb, va_arg(va, long long));
+            break;
+
+          case LOG_BIN_DOUBLE: {
+            double d = va_arg(va, double);
+            uint64_t u;
+
+            memcpy(&u, &d, sizeof(u));
+            sb_add_le64(sb, u);
+          } break;
+
+          case LOG_BIN_PTR:
+            sb_add_le64(sb, (uintptr_t)va_arg(va, void *));
+            break;
+
+          case LOG_BIN_STR:
+          case LOG_BIN_STRN: {
+            const char *s = va_arg(va, const char *);
+            size_t len;
+
+            if (!s) {
+                sb_add_le32(sb, UINT32_MAX);
+                break;
+            }
+            if (site->args[i] == LOG_BIN_STRN && last_int >= 0) {
+                len = strnlen(s, last_int);
+            } else {
+                len = strlen(s);
+            }
+            sb_add_le32(sb, len);
+            sb_add(sb, s, len);
+            sb_addc(sb, '\0');
+          } break;
+
+          case LOG_BIN_BUF: {
+            const void *data = va_arg(va, const void *);
+            int len = data ? MAX(last_int, 0) : 0;
+
+            sb_add_le32(sb, len);
+            sb_add(sb, data ?: "", len);
+          } break;
+
+          case LOG_BIN_LSTR: {
+            const lstr_t *s = va_arg(va, const lstr_t *);
+
+            sb_add_le32(sb, s->len);
+            sb_add(sb, s->s, s->len);
+          } break;
+        }
+    }
+}
+
+void __logger_log_bin(logger_t *logger, log_bin_site_t *site, ...)
+{
+    log_bin_buf_t *buf;
+    unsigned gen;
+    struct timespec ts;
+    int fd = atomic_load_explicit(&log_bin_g.fd, memory_order_acquire);
+    int pos;
+    va_list va;
+
+    va_start(va, site);
+    if (fd < 0) {
+        logger_vlog(logger, site->level, NULL, -1, site->file, site->func,
+                    site->line, site->fmt, va);
+        va_end(va);
+        return;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    if (unlikely(!atomic_load_explicit(&site->id, memory_order_acquire))) {
+        log_bin_site_register(site);
+    }
+    buf = log_bin_buf_get();
+    spin_lock(&buf->lock);
+
+    /* The call site is described in the buffer of the first thread that
+     * uses it after the opening of the file: the decoder accepts the
+     * definitions after the events. */
+    gen = atomic_load_explicit(&log_bin_g.gen, memory_order_relaxed);
+    if (atomic_exchange_explicit(&site->gen, gen,
+                                 memory_order_relaxed) != gen)
+    {
+        log_bin_add_site(&buf->sb, site);
+    }
+
+    log_bin_add_record_hdr(&buf->sb, 'E', &pos);
+    sb_add_le32(&buf->sb, site->id);
+    sb_add_le64(&buf->sb, ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+    sb_add_le16(&buf->sb, MIN(logger->full_name.len, UINT16_MAX));
+    sb_add(&buf->sb, logger->full_name.s,
+           MIN(logger->full_name.len, UINT16_MAX));
+    if (site->nb_args < 0) {
+        int len_pos = buf->sb.len;
+
+        sb_growlen(&buf->sb, 4);
+        sb_addvf(&buf->sb, site->fmt, va);
+        put_unaligned_le32(buf->sb.data + len_pos,
+                           buf->sb.len - len_pos - 4);
+    } else {
+        log_bin_add_args(&buf->sb, site, va);
+    }
+    log_bin_end_record(&buf->sb, pos);
+
+    if (buf->sb.len >= LOG_BIN_BUF_FLUSH_SIZE) {
+        log_bin_buf_write(buf, atomic_load(&log_bin_g.fd));
+    }
+    spin_unlock(&buf->lock);
+    va_end(va);
+}
+
+static void log_bin_flush_to(int fd)
+{
+    spin_lock(&log_bin_g.lock);
+    dlist_for_each_entry(log_bin_buf_t, buf, &log_bin_g.bufs, link) {
+        spin_lock(&buf->lock);
+        log_bin_buf_write(buf, fd);
+        spin_unlock(&buf->lock);
+    }
+    spin_unlock(&log_bin_g.lock);
+}
+
+int log_bin_open(const char *path)
+{
+    SB_1k(sb);
+    struct stat st;
+    int fd;
+    int pos;
+
+    fd = RETHROW(open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                      0644));
+    if (fstat(fd, &st) < 0) {
+        PROTECT_ERRNO(p_close(&fd));
+        return -1;
+    }
+    if (st.st_size == 0) {
+        sb_adds(&sb, LOG_BIN_MAGIC);
+    }
+    log_bin_add_record_hdr(&sb, 'H', &pos);
+    sb_add_le32(&sb, getpid());
+    sb_adds(&sb, program_invocation_short_name);
+    log_bin_end_record(&sb, pos);
+    if (xwrite(fd, sb.data, sb.len) < 0) {
+        PROTECT_ERRNO(p_close(&fd));
+        return -1;
+    }
+
+    log_bin_close();
+    atomic_fetch_add(&log_bin_g.gen, 1);
+    atomic_store_explicit(&log_bin_g.fd, fd, memory_order_release);
+    return 0;
+}
+
+void log_bin_flush(void)
+{
+    int fd = atomic_load(&log_bin_g.fd);
+
+    if (fd >= 0) {
+        log_bin_flush_to(fd);
+    }
+}
+
+void log_bin_close(void)
+{
+    int fd = atomic_exchange(&log_bin_g.fd, -1);
+
+    if (fd >= 0) {
+        log_bin_flush_to(fd);
+        p_close(&fd);
+    }
+}
+
+void __log_bin_atfork(void)
+{
+    int fd = atomic_exchange(&log_bin_g.fd, -1);
+
+    /* The buffers of the parent must not be written twice, and the other
+     * threads may have held the locks when the process forked. */
+    log_bin_g.lock = 0;
+    dlist_for_each_entry(log_bin_buf_t, buf, &log_bin_g.bufs, link) {
+        buf->lock = 0;
+        sb_reset(&buf->sb);
+    }
+    p_close(&fd);
+}
+
+/* }}} */
+/* Decoder {{{ */
+
+typedef struct log_bin_def_t {
+    int level;
+    int8_t nb_args;
+    const uint8_t *args;
+    lstr_t fmt;
+} log_bin_def_t;
+qvector_t(log_bin_def, log_bin_def_t);
+
+static const char *log_bin_level_name(int level)
+{
+    static const char *names[] = {
+        [LOG_EMERG]   = "emerg",
+        [LOG_ALERT]   = "alert",
+        [LOG_CRIT]    = "crit",
+        [LOG_ERR]     = "error",
+        [LOG_WARNING] = "warn",
+        [LOG_NOTICE]  = "notice",
+        [LOG_INFO]    = "info",
+        [LOG_DEBUG]   = "debug",
+    };
+
+    if (level >= LOG_TRACE) {
+        return "trace";
+    }
+    if (level < 0) {
+        return "?";
+    }
+    return names[level];
+}
+
+static int log_bin_get_record(pstream_t *ps, int *type, pstream_t *rec)
+{
+    uint32_t size;
+
+    RETHROW(ps_get_le32(ps, &size));
+    THROW_ERR_IF(size < LOG_BIN_HDR_SIZE);
+    RETHROW(ps_get_ps(ps, size - 4, rec));
+    *type = __ps_getc(rec);
+    return 0;
+}
+
+/* Load the call site definitions of a process, that is up to its next
+ * header record. */
+static int log_bin_load_defs(pstream_t ps, qv_t(log_bin_def) *defs)
+{
+    qv_clear(defs);
+
+    while (!ps_done(&ps)) {
+        log_bin_def_t def;
+        pstream_t rec;
+        uint32_t id;
+        uint16_t len;
+        int type;
+
+        RETHROW(log_bin_get_record(&ps, &type, &rec));
+        if (type == 'H') {
+            break;
+        }
+        if (type != 'D') {
+            continue;
+        }
+
+        p_clear(&def, 1);
+        RETHROW(ps_get_le32(&rec, &id));
+        THROW_ERR_IF(id == 0 || id > INT32_MAX || !ps_has(&rec, 9));
+        def.level = (int32_t)__ps_get_le32(&rec);
+        __ps_skip(&rec, 4);
+        def.nb_args = (int8_t)__ps_getc(&rec);
+        THROW_ERR_IF(def.nb_args > LOG_BIN_MAX_ARGS);
+        if (def.nb_args > 0) {
+            def.args = RETHROW_PN(ps_get_data(&rec, def.nb_args));
+        }
+        RETHROW(ps_get_le16(&rec, &len));
+        RETHROW(ps_skip(&rec, len));
+        RETHROW(ps_get_le16(&rec, &len));
+        RETHROW(ps_skip(&rec, len));
+        def.fmt = LSTR_PS_V(&rec);
+
+        if (id > (uint32_t)defs->len) {
+            qv_growlen0(defs, id - defs->len);
+        }
+        defs->tab[id - 1] = def;
+    }
+    return 0;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+
+static int log_bin_decode_conv(const char *spec, const uint8_t *types,
+                               int nb, pstream_t *args, sb_t *out)
+{
+    int stars[2] = { 0, 0 };
+    int nb_stars = 0;
+    int type = types[nb - 1];
+
+#define ADDF(...)                                                            \
+    switch (nb_stars) {                                                      \
+      case 0: sb_addf(out, spec, __VA_ARGS__); break;                        \
+      case 1: sb_addf(out, spec, stars[0], __VA_ARGS__); break;              \
+      default: sb_addf(out, spec, stars[0], stars[1], __VA_ARGS__); break;   \
+    }
+
+    for (int i = 0; i < nb - 1; i++) {
+        uint32_t u;
+
+        RETHROW(ps_get_le32(args, &u));
+        stars[nb_stars++] = (int32_t)u;
+    }
+
+    switch (type) {
+      case LOG_BIN_INT: {
+        uint32_t u;
+
+        RETHROW(ps_get_le32(args, &u));
+        ADDF((int32_t)u);
+      } break;
+
+      case LOG_BIN_LONG: {
+        uint64_t u;
+
+        RETHROW(ps_get_le64(args, &u));
+        ADDF((long long)u);
+      } break;
+
+      case LOG_BIN_DOUBLE: {
+        uint64_t u;
+        double d;
+
+        RETHROW(ps_get_le64(args, &u));
+        memcpy(&d, &u, sizeof(d));
+        ADDF(d);
+      } break;
+
+      case LOG_BIN_PTR: {
+        uint64_t u;
+
+        RETHROW(ps_get_le64(args, &u));
+        ADDF((void *)(uintptr_t)u);
+      } break;
+
+      case LOG_BIN_STR:
+      case LOG_BIN_STRN: {
+        uint32_t len;
+        const char *s = NULL;
+
+        RETHROW(ps_get_le32(args, &len));
+        if (len != UINT32_MAX) {
+            s = RETHROW_PN(ps_get_data(args, len + 1));
+            THROW_ERR_IF(s[len] != '\0');
+        }
+        ADDF(s);
+      } break;
+
+      case LOG_BIN_BUF:
+      case LOG_BIN_LSTR: {
+        uint32_t len;
+        const void *data;
+
+        RETHROW(ps_get_le32(args, &len));
+        data = RETHROW_PN(ps_get_data(args, len));
+        if (type == LOG_BIN_LSTR) {
+            sb_add(out, data, len);
+        } else {
+            /* The length is the one that was copied. */
+            sb_addf(out, spec, (int)len, data);
+        }
+      } break;
+
+      default:
+        return -1;
+    }
+#undef ADDF
+    return 0;
+}
+
+#pragma GCC diagnostic pop
+
+static int log_bin_decode_msg(const log_bin_def_t *def, pstream_t *args,
+                              sb_t *out)
+{
+    pstream_t fmt = ps_initlstr(&def->fmt);
+    int arg = 0;
+
+    if (def->nb_args < 0) {
+        uint32_t len;
+
+        RETHROW(ps_get_le32(args, &len));
+        sb_add(out, RETHROW_PN(ps_get_data(args, len)), len);
+        return 0;
+    }
+
+    while (!ps_done(&fmt)) {
+        pstream_t lit;
+        const char *end;
+        uint8_t types[3];
+        char spec[64];
+        int nb;
+        size_t len;
+
+        if (ps_get_ps_chr(&fmt, '%', &lit) < 0) {
+            sb_add_ps(out, fmt);
+            break;
+        }
+        sb_add_ps(out, lit);
+        if (ps_len(&fmt) >= 2 && fmt.s[1] == '%') {
+            sb_addc(out, '%');
+            __ps_skip(&fmt, 2);
+            continue;
+        }
+
+        /* The format of the definition is not NUL-terminated, and a
+         * truncated conversion does not parse. */
+        len = MIN(ps_len(&fmt), sizeof(spec) - 1);
+        pstrcpymem(spec, sizeof(spec), fmt.s, len);
+        nb = log_bin_parse_conv(spec + 1, &end, types);
+        THROW_ERR_IF(nb <= 0 || arg + nb > def->nb_args);
+        THROW_ERR_IF(memcmp(types, def->args + arg, nb));
+        spec[end - spec] = '\0';
+        __ps_skip(&fmt, end - spec);
+        arg += nb;
+
+        RETHROW(log_bin_decode_conv(spec, types, nb, args, out));
+    }
+    return 0;
+}
+
+int log_bin_decode(lstr_t data, sb_t *out)
+{
+    t_scope;
+    pstream_t ps = ps_initlstr(&data);
+    qv_t(log_bin_def) defs;
+    lstr_t prog = LSTR_EMPTY_V;
+    uint32_t pid = 0;
+
+    RETHROW(ps_skipstr(&ps, LOG_BIN_MAGIC));
+    t_qv_init(&defs, 64);
+
+    while (!ps_done(&ps)) {
+        const log_bin_def_t *def;
+        pstream_t rec;
+        pstream_t logger;
+        uint32_t id;
+        uint64_t ns;
+        uint16_t len;
+        int type;
+
+        RETHROW(log_bin_get_record(&ps, &type, &rec));
+        if (type == 'H') {
+            /* The definitions may follow the events that use them. */
+            RETHROW(ps_get_le32(&rec, &pid));
+            prog = LSTR_PS_V(&rec);
+            RETHROW(log_bin_load_defs(ps, &defs));
+            continue;
+        }
+        if (type != 'E') {
+            continue;
+        }
+
+        RETHROW(ps_get_le32(&rec, &id));
+        RETHROW(ps_get_le64(&rec, &ns));
+        RETHROW(ps_get_le16(&rec, &len));
+        RETHROW(ps_get_ps(&rec, len, &logger));
+        THROW_ERR_IF(id == 0 || id > (uint32_t)defs.len);
+        def = &defs.tab[id - 1];
+        THROW_ERR_IF(!def->fmt.s);
+
+        sb_add_time_iso8601_msec(out, ns / 1000000000,
+                                 (ns / 1000000) % 1000);
+        sb_addf(out, " %*pM[%u]: %s: ", LSTR_FMT_ARG(prog), pid,
+                log_bin_level_name(def->level));
+        if (!ps_done(&logger)) {
+            sb_addf(out, "{%*pM} ", PS_FMT_ARG(&logger));
+        }
+        RETHROW(log_bin_decode_msg(def, &rec, out));
+        sb_addc(out, '\n');
+    }
+    return 0;
+}
+
+/* }}} */
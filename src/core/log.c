@@ -56,6 +56,12 @@ qvector_t(buffer_instance, buffer_instance_t);
 
 static log_handler_f log_stderr_raw_handler;
 
+typedef struct log_async_ring_t log_async_ring_t;
+
+static __attr_printf__(2, 0)
+int log_async_putv(const log_ctx_t *ctx, const char *fmt, va_list va);
+static void log_async_wait(long timeout);
+
 _MODULE_ADD_DECLS(log);
 
 static struct {
@@ -105,6 +111,11 @@ static __thread struct {
     qv_t(buffer_instance) vec_buff_stack;
     mem_stack_pool_t mp_stack;
     int nb_buffer_started;
+
+    /* asynchronous logging */
+    log_async_ring_t *async_ring;
+    sb_t async_msg;
+    bool is_async_thread;
 } log_thr_g;
 
 __thread log_thr_ml_t log_thr_ml_g;
@@ -512,6 +523,9 @@ void logger_putv(const log_ctx_t *ctx, bool do_log,
         va_copy(cpy, va);
         logger_vsyslog(ctx->level, fmt, cpy);
         va_end(cpy);
+
+        /* Write the pending asynchronous messages first. */
+        log_async_wait(1000);
     }
 
     if (!do_log) {
@@ -519,6 +533,9 @@ void logger_putv(const log_ctx_t *ctx, bool do_log,
     }
 
     if (!log_thr_g.nb_buffer_started) {
+        if (ctx->level > LOG_CRIT && log_async_putv(ctx, fmt, va) >= 0) {
+            return;
+        }
         (*_G.handler)(ctx, fmt, va);
         return;
     }
@@ -925,6 +942,389 @@ log_handler_f *log_set_handler(log_handler_f *handler)
     return handler;
 }
 
+/* }}} */
+/* Asynchronous logging {{{ */
+
+/* The messages are records in the ring of the thread that logs them. The
+ * positions in the ring only grow: the thread owns the tail, and the logging
+ * thread owns the head. A record that would cross the end of the ring is
+ * preceded by a padding record up to the end.
+ */
+typedef struct log_async_rec_t {
+    uint32_t    size;
+    bool        is_pad    : 1;
+    bool        is_silent : 1;
+    uint16_t    logger_name_len;
+    int         level;
+    int         line;
+    int         pid;
+    int         msg_len;
+    int64_t     ts;
+    const char *file;
+    const char *func;
+    const char *prog_name;
+    char        data[];
+} log_async_rec_t;
+
+struct log_async_ring_t {
+    atomic_size_t tail;
+    atomic_uint64_t dropped;
+
+    atomic_size_t head __attribute__((aligned(CACHE_LINE_SIZE)));
+    atomic_bool dead;
+    size_t size;
+    dlist_t link;
+    char *buf;
+};
+
+qvector_t(log_async_ring, log_async_ring_t *);
+
+static struct {
+    atomic_bool enabled;
+    atomic_bool stopping;
+    bool running;
+    log_async_overflow_t overflow;
+    size_t ring_size;
+    pthread_t thread;
+
+    /* wakes up the logging thread */
+    thr_evc_t ec;
+
+    /* completed flushes */
+    thr_evc_t flush_ec;
+    atomic_uint64_t flush_req;
+    atomic_uint64_t flush_done;
+
+    /* protects the list of rings */
+    spinlock_t lock;
+    dlist_t rings;
+
+    atomic_uint64_t written;
+    atomic_uint64_t dropped;
+} log_async_g = {
+    .rings = DLIST_INIT(log_async_g.rings),
+};
+
+static log_async_ring_t *log_async_ring_get(void)
+{
+    log_async_ring_t *ring = log_thr_g.async_ring;
+
+    if (likely(ring)) {
+        return ring;
+    }
+
+    ring = p_new(log_async_ring_t, 1);
+    ring->size = log_async_g.ring_size;
+    ring->buf = p_new_raw(char, ring->size);
+    spin_lock(&log_async_g.lock);
+    dlist_add_tail(&log_async_g.rings, &ring->link);
+    spin_unlock(&log_async_g.lock);
+
+    return log_thr_g.async_ring = ring;
+}
+
+static void log_async_ring_delete(log_async_ring_t **ring)
+{
+    if (*ring) {
+        atomic_fetch_add(&log_async_g.dropped, (*ring)->dropped);
+        dlist_remove(&(*ring)->link);
+        p_delete(&(*ring)->buf);
+        p_delete(ring);
+    }
+}
+
+__attr_printf__(2, 3)
+static void log_async_call_handler(const log_ctx_t *ctx, const char *fmt,
+                                   ...)
+{
+    va_list va;
+
+    va_start(va, fmt);
+    (*_G.handler)(ctx, fmt, va);
+    va_end(va);
+}
+
+static int log_async_putv(const log_ctx_t *ctx, const char *fmt, va_list va)
+{
+    log_async_ring_t *ring;
+    log_async_rec_t *rec;
+    sb_t *sb = &log_thr_g.async_msg;
+    struct timespec ts;
+    size_t size, head, tail, off, room;
+    int name_len;
+
+    if (likely(!atomic_load_explicit(&log_async_g.enabled,
+                                     memory_order_relaxed))
+    ||  !log_thr_g.inited || log_thr_g.is_async_thread)
+    {
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ring = log_async_ring_get();
+    sb_setvf(sb, fmt, va);
+
+    name_len = MIN(ctx->logger_name.len, 1024);
+    size = sizeof(*rec) + name_len;
+    if (size + sb->len > ring->size / 2) {
+        sb_clip(sb, ring->size / 2 - size);
+    }
+    size = ROUND_UP(size + sb->len, 8);
+
+    for (;;) {
+        head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        off  = tail & (ring->size - 1);
+        room = ring->size - off;
+        if (ring->size - (tail - head) >= (size <= room ? size : room + size))
+        {
+            break;
+        }
+        if (log_async_g.overflow == LOG_ASYNC_DROP) {
+            atomic_fetch_add_explicit(&ring->dropped, 1,
+                                      memory_order_relaxed);
+            sb_reset(sb);
+            return 0;
+        }
+        if (unlikely(!atomic_load(&log_async_g.enabled))) {
+            /* Stopped while waiting. */
+            log_async_call_handler(ctx, "%*pM", sb->len, sb->data);
+            sb_reset(sb);
+            return 0;
+        }
+        thr_ec_signal(&log_async_g.ec);
+        usleep(100);
+    }
+
+    if (size > room) {
+        rec = (log_async_rec_t *)(ring->buf + off);
+        rec->size = room;
+        rec->is_pad = true;
+        tail += room;
+        off = 0;
+    }
+
+    rec = (log_async_rec_t *)(ring->buf + off);
+    *rec = (log_async_rec_t){
+        .size            = size,
+        .is_silent       = ctx->is_silent,
+        .logger_name_len = name_len,
+        .level           = ctx->level,
+        .line            = ctx->line,
+        .pid             = ctx->pid,
+        .msg_len         = sb->len,
+        .ts              = ts.tv_sec * 1000000000L + ts.tv_nsec,
+        .file            = ctx->file,
+        .func            = ctx->func,
+        .prog_name       = ctx->prog_name,
+    };
+    memcpy(rec->data, ctx->logger_name.s, name_len);
+    memcpy(rec->data + name_len, sb->data, sb->len);
+    atomic_store_explicit(&ring->tail, tail + size, memory_order_release);
+    sb_reset(sb);
+
+    /* Do not wait for the next poll of the logging thread to empty a ring
+     * that fills up. */
+    if (tail + size - head > ring->size / 2) {
+        thr_ec_signal_relaxed(&log_async_g.ec);
+    }
+
+    return 0;
+}
+
+static log_async_rec_t *log_async_ring_peek(log_async_ring_t *ring)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    while (head != tail) {
+        log_async_rec_t *rec;
+
+        rec = (log_async_rec_t *)(ring->buf + (head & (ring->size - 1)));
+        if (!rec->is_pad) {
+            return rec;
+        }
+        head += rec->size;
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+    }
+    return NULL;
+}
+
+/* Write the messages of all the rings, in timestamp order, until they are
+ * all empty. */
+static void log_async_drain(qv_t(log_async_ring) *rings)
+{
+    qv_clear(rings);
+    spin_lock(&log_async_g.lock);
+    dlist_for_each_entry(log_async_ring_t, ring, &log_async_g.rings, link) {
+        /* A dead ring has no producer anymore. */
+        if (atomic_load(&ring->dead) && !log_async_ring_peek(ring)) {
+            log_async_ring_delete(&ring);
+        } else {
+            qv_append(rings, ring);
+        }
+    }
+    spin_unlock(&log_async_g.lock);
+
+    for (;;) {
+        log_async_ring_t *best_ring = NULL;
+        log_async_rec_t *best = NULL;
+        log_ctx_t ctx;
+
+        tab_for_each_entry(ring, rings) {
+            log_async_rec_t *rec = log_async_ring_peek(ring);
+
+            if (rec && (!best || rec->ts < best->ts)) {
+                best_ring = ring;
+                best = rec;
+            }
+        }
+        if (!best) {
+            break;
+        }
+
+        ctx = (log_ctx_t){
+            .level       = best->level,
+            .logger_name = LSTR_INIT_V(best->data, best->logger_name_len),
+            .file        = best->file,
+            .func        = best->func,
+            .line        = best->line,
+            .pid         = best->pid,
+            .prog_name   = best->prog_name,
+            .is_silent   = best->is_silent,
+        };
+        log_async_call_handler(&ctx, "%*pM", best->msg_len,
+                               best->data + best->logger_name_len);
+        atomic_fetch_add_explicit(&log_async_g.written, 1,
+                                  memory_order_relaxed);
+        atomic_fetch_add_explicit(&best_ring->head, best->size,
+                                  memory_order_release);
+    }
+}
+
+static void *log_async_main(void *arg)
+{
+    qv_t(log_async_ring) rings;
+
+    qv_init(&rings);
+    log_thr_g.is_async_thread = true;
+
+    for (;;) {
+        uint64_t key = thr_ec_get(&log_async_g.ec);
+        uint64_t req = atomic_load(&log_async_g.flush_req);
+        bool stopping = atomic_load(&log_async_g.stopping);
+
+        log_async_drain(&rings);
+
+        /* All the messages queued before the flush request are written. */
+        atomic_store(&log_async_g.flush_done, req);
+        thr_ec_broadcast_relaxed(&log_async_g.flush_ec);
+
+        if (stopping) {
+            break;
+        }
+        thr_ec_timedwait(&log_async_g.ec, key, 10);
+    }
+
+    qv_wipe(&rings);
+    return NULL;
+}
+
+/* Wait for the logging thread to write the pending messages, at most
+ * timeout milliseconds, or without limit if timeout is negative.
+ */
+static void log_async_wait(long timeout)
+{
+    uint64_t req;
+    struct timeval end;
+
+    if (!log_async_g.running || log_thr_g.is_async_thread) {
+        return;
+    }
+
+    lp_gettv(&end);
+    end = timeval_addmsec(end, MAX(timeout, 0));
+    req = atomic_fetch_add(&log_async_g.flush_req, 1) + 1;
+    thr_ec_signal(&log_async_g.ec);
+
+    while (atomic_load(&log_async_g.flush_done) < req) {
+        uint64_t key = thr_ec_get(&log_async_g.flush_ec);
+        long left = 0;
+
+        if (atomic_load(&log_async_g.flush_done) >= req) {
+            break;
+        }
+        if (timeout >= 0) {
+            struct timeval now;
+
+            lp_gettv(&now);
+            left = timeval_diffmsec(&end, &now);
+            if (left <= 0) {
+                break;
+            }
+        }
+        thr_ec_timedwait(&log_async_g.flush_ec, key, left);
+    }
+}
+
+int log_async_start(int ring_size, log_async_overflow_t overflow)
+{
+    if (log_async_g.running) {
+        return 0;
+    }
+
+    ring_size = MAX(ring_size, 4096);
+    log_async_g.ring_size = 1UL << (bsr32(ring_size - 1) + 1);
+    log_async_g.overflow = overflow;
+    atomic_store(&log_async_g.stopping, false);
+    thr_ec_init(&log_async_g.ec);
+    thr_ec_init(&log_async_g.flush_ec);
+
+    if (thr_create(&log_async_g.thread, NULL, &log_async_main, NULL)) {
+        thr_ec_wipe(&log_async_g.flush_ec);
+        thr_ec_wipe(&log_async_g.ec);
+        return -1;
+    }
+    log_async_g.running = true;
+    atomic_store(&log_async_g.enabled, true);
+    return 0;
+}
+
+void log_async_stop(void)
+{
+    if (!log_async_g.running) {
+        return;
+    }
+
+    atomic_store(&log_async_g.enabled, false);
+    atomic_store(&log_async_g.stopping, true);
+    thr_ec_signal(&log_async_g.ec);
+    pthread_join(log_async_g.thread, NULL);
+    log_async_g.running = false;
+
+    thr_ec_wipe(&log_async_g.flush_ec);
+    thr_ec_wipe(&log_async_g.ec);
+}
+
+void log_async_flush(void)
+{
+    log_async_wait(-1);
+}
+
+void log_async_get_stats(log_async_stats_t *stats)
+{
+    p_clear(stats, 1);
+
+    spin_lock(&log_async_g.lock);
+    stats->written = atomic_load(&log_async_g.written);
+    stats->dropped = atomic_load(&log_async_g.dropped);
+    dlist_for_each_entry(log_async_ring_t, ring, &log_async_g.rings, link) {
+        stats->dropped += atomic_load_explicit(&ring->dropped,
+                                               memory_order_relaxed);
+    }
+    spin_unlock(&log_async_g.lock);
+}
+
 /* }}} */
 /* Backward compatibility e_*() {{{ */
 
@@ -1067,6 +1467,7 @@ static void log_initialize_thread(void)
     if (!log_thr_g.inited) {
         sb_init(&log_thr_g.log);
         sb_init(&log_thr_g.buf);
+        sb_init(&log_thr_g.async_msg);
 
         mem_stack_pool_init(&log_thr_g.mp_stack, "log", 16 << 10);
         qv_init(&log_thr_g.vec_buff_stack);
@@ -1077,7 +1478,13 @@ static void log_initialize_thread(void)
 
 static void log_shutdown_thread(void)
 {
+    if (log_thr_g.async_ring) {
+        /* The logging thread writes the last messages and frees it. */
+        atomic_store(&log_thr_g.async_ring->dead, true);
+        log_thr_g.async_ring = NULL;
+    }
     if (log_thr_g.inited) {
+        sb_wipe(&log_thr_g.async_msg);
         sb_wipe(&log_thr_g.buf);
         sb_wipe(&log_thr_g.log);
 
@@ -1092,6 +1499,13 @@ thr_hooks(log_initialize_thread, log_shutdown_thread);
 static void log_atfork(void)
 {
     _G.pid = getpid();
+
+    /* The logging thread does not exist in the child. */
+    if (log_async_g.running) {
+        atomic_store(&log_async_g.enabled, false);
+        log_async_g.running = false;
+    }
+    __log_bin_atfork();
 }
 
 /** Parse the content of the IS_DEBUG environment variable.
@@ -1200,6 +1614,13 @@ static int log_initialize(void* args)
 
 static int log_shutdown(void)
 {
+    log_async_stop();
+    log_bin_close();
+    dlist_for_each_entry(log_async_ring_t, ring, &log_async_g.rings, link) {
+        log_async_ring_delete(&ring);
+    }
+    log_thr_g.async_ring = NULL;
+
     logger_wipe(&_G.root_logger);
     qm_deep_wipe(level, &_G.pending_levels, lstr_wipe, IGNORE);
     qv_wipe(&_G.specs);
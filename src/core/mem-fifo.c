@@ -20,11 +20,11 @@
 #include <lib-common/el.h>
 #include <lib-common/log.h>
 #include <lib-common/str-buf-pp.h>
+#include <lib-common/thr.h>
 
 #ifdef MEM_BENCH
 
 #include "mem-bench.h"
-#include <lib-common/thr.h>
 
 #define WRITE_PERIOD 256
 #endif
@@ -63,12 +63,20 @@ typedef struct mem_fifo_pool_t {
         mem_pool_t **owner;
     };
     mem_page_t  *current;
-    size_t      occupied:63;
-    bool        alive:1;
+    size_t      occupied;
+    _Atomic(bool) alive;
     size_t      map_size;
     uint32_t    page_size;
     uint32_t    nb_pages;
 
+    /* Blocks freed by other threads than the owner are pushed in
+     * remote_frees, and are actually freed by the owner on its next
+     * allocation. Once the pool is dead, every free is done under
+     * dead_lock. */
+    pthread_t    owner_thread;
+    mpsc_queue_t remote_frees;
+    spinlock_t   dead_lock;
+
     char       *name;
     dlist_t     pool_list;
 
@@ -152,6 +160,8 @@ static uint32_t mem_page_size_left(mem_page_t *page)
     return (page->size - page->used_size);
 }
 
+static bool mfp_drain_remote_frees(mem_fifo_pool_t *mfp);
+
 static void *mfp_alloc(mem_pool_t *_mfp, size_t size, size_t alignment,
                        mem_flags_t flags)
 {
@@ -173,6 +183,10 @@ static void *mfp_alloc(mem_pool_t *_mfp, size_t size, size_t alignment,
         return MEM_EMPTY_ALLOC;
     }
 
+    if (unlikely(!mpsc_queue_looks_empty(&mfp->remote_frees))) {
+        mfp_drain_remote_frees(mfp);
+    }
+
     page = mfp->current;
     /* Must round size up to keep proper alignment */
     size = ROUND_UP((unsigned)size + sizeof(mem_block_t), 8);
@@ -222,9 +236,11 @@ static void *mfp_alloc(mem_pool_t *_mfp, size_t size, size_t alignment,
     return page->last = blk->area;
 }
 
-static void mfp_free(mem_pool_t *_mfp, void *mem)
+/* Returns true when the last page of a dead pool has been released, in which
+ * case the caller must delete the pool.
+ */
+static bool mfp_free_local(mem_fifo_pool_t *mfp, void *mem)
 {
-    mem_fifo_pool_t *mfp = container_of(_mfp, mem_fifo_pool_t, funcs);
     mem_block_t *blk;
     mem_page_t *page;
 
@@ -233,10 +249,6 @@ static void mfp_free(mem_pool_t *_mfp, void *mem)
     proctimer_start(&ptimer);
 #endif
 
-    if (!mem || unlikely(mem == MEM_EMPTY_ALLOC)) {
-        return;
-    }
-
     blk  = container_of(mem, mem_block_t, area);
     mem_tool_allow_memory(blk, sizeof(*blk), true);
     page = pageof(blk);
@@ -254,15 +266,13 @@ static void mfp_free(mem_pool_t *_mfp, void *mem)
         mem_bench_update(&mfp->mem_bench);
         mem_bench_print_csv(&mfp->mem_bench);
 #endif
-        return;
+        return false;
     }
 
     /* specific case for a dying pool */
     if (unlikely(!mfp->alive)) {
         mem_page_delete(mfp, &page);
-        if (mfp->nb_pages == 0)
-            p_delete(mfp->owner);
-        return;
+        return mfp->nb_pages == 0;
     }
 
     /* this was the last block,
@@ -306,6 +316,82 @@ static void mfp_free(mem_pool_t *_mfp, void *mem)
     mem_bench_update(&mfp->mem_bench);
     mem_bench_print_csv(&mfp->mem_bench);
 #endif
+    return false;
+}
+
+static void mfp_free_remote_node(mpsc_node_t *node, data_t data)
+{
+    mfp_free_local(data.ptr, node);
+}
+
+/* Must be called by the owner of the pool, or with the dead_lock held once
+ * the pool is dead. Returns true when the pool must be deleted.
+ */
+static bool mfp_drain_remote_frees(mem_fifo_pool_t *mfp)
+{
+    mpsc_it_t it;
+    bool destroy = false;
+    bool done;
+
+    mpsc_queue_drain_start(&it, &mfp->remote_frees);
+    do {
+        mpsc_node_t *last;
+
+        last = mpsc_queue_drain_fast(&it, &mfp_free_remote_node,
+                                     (data_t){ .ptr = mfp });
+        /* the last node can only be released once the drain is over */
+        done = mpsc_queue_drain_end(&it, NULL);
+        destroy = mfp_free_local(mfp, last);
+    } while (!done);
+
+    return destroy;
+}
+
+static void mfp_free_dead(mem_fifo_pool_t *mfp, void *nullable mem)
+{
+    bool destroy = false;
+
+    spin_lock(&mfp->dead_lock);
+    if (!mpsc_queue_looks_empty(&mfp->remote_frees)) {
+        destroy = mfp_drain_remote_frees(mfp);
+    }
+    if (mem) {
+        destroy = mfp_free_local(mfp, mem);
+    }
+    spin_unlock(&mfp->dead_lock);
+
+    if (destroy) {
+        p_delete(mfp->owner);
+    }
+}
+
+static void mfp_free(mem_pool_t *_mfp, void *mem)
+{
+    mem_fifo_pool_t *mfp = container_of(_mfp, mem_fifo_pool_t, funcs);
+
+    if (!mem || unlikely(mem == MEM_EMPTY_ALLOC)) {
+        return;
+    }
+
+    if (unlikely(!mfp->alive)) {
+        mfp_free_dead(mfp, mem);
+        return;
+    }
+
+    if (unlikely(!pthread_equal(mfp->owner_thread, pthread_self()))) {
+        /* The block is large enough to hold the queue node: allocations
+         * are rounded up to 8 bytes after the block header. */
+        mpsc_queue_push(&mfp->remote_frees, mem);
+
+        /* The pool may have been deleted while we were pushing the block,
+         * in which case the owner may not have seen it. */
+        if (unlikely(!mfp->alive)) {
+            mfp_free_dead(mfp, NULL);
+        }
+        return;
+    }
+
+    mfp_free_local(mfp, mem);
 }
 
 static void *mfp_realloc(mem_pool_t *_mfp, void *mem, size_t oldsize,
@@ -426,10 +512,13 @@ mem_pool_t *mem_fifo_pool_new(const char *name, int page_size_hint)
 
     STATIC_ASSERT((offsetof(mem_page_t, area) % 8) == 0);
     mfp->funcs     = mem_fifo_pool_funcs;
+    mfp->funcs.name = mfp->name;
     mfp->page_size = MAX(16 * PAGE_SIZE,
                          ROUND_UP(page_size_hint, PAGE_SIZE));
     mfp->alive     = true;
     mfp->current   = mem_page_new(mfp, 0);
+    mfp->owner_thread = pthread_self();
+    mpsc_queue_init(&mfp->remote_frees);
 
 #ifdef MEM_BENCH
     mem_bench_init(&mfp->mem_bench, LSTR("fifo"), WRITE_PERIOD);
@@ -467,20 +556,27 @@ void mem_fifo_pool_delete(mem_pool_t **poolp)
 #endif
 
     p_delete(&mfp->name);
+    mfp->funcs.name = NULL;
     mfp->alive = false;
+
+    spin_lock(&mfp->dead_lock);
     mem_page_delete(mfp, &mfp->freepage);
     if (mfp->current && mfp->current->used_blocks == 0) {
         mem_page_delete(mfp, &mfp->current);
     } else {
         mfp->current = NULL;
     }
-
+    mfp->owner = poolp;
+    if (!mpsc_queue_looks_empty(&mfp->remote_frees)) {
+        mfp_drain_remote_frees(mfp);
+    }
     if (mfp->nb_pages) {
         e_trace(0, "keep fifo-pool alive: %d pages in use (mem: %lubytes)",
                 mfp->nb_pages, (unsigned long) mfp->occupied);
-        mfp->owner   = poolp;
+        spin_unlock(&mfp->dead_lock);
         return;
     }
+    spin_unlock(&mfp->dead_lock);
     p_delete(poolp);
 }
 
@@ -0,0 +1,168 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <sys/syscall.h>
+#ifdef __linux__
+# include <linux/mempolicy.h>
+#endif
+
+#include <lib-common/core.h>
+
+/*
+ * NUMA support for the memory pools
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * We do not want to depend on libnuma: the topology is read once from sysfs
+ * when the NUMA mode is enabled, the current node is derived from
+ * sched_getcpu() (which is a vDSO call) and memory is bound using the raw
+ * mbind() system call with a MPOL_PREFERRED policy, so that allocations
+ * still succeed when the preferred node is exhausted.
+ */
+
+static struct {
+    bool     enabled;
+    int      nodes_count;
+    int      cpus_count;
+    uint8_t *cpu_to_node;
+} core_mem_numa_g;
+#define _G  core_mem_numa_g
+
+static int mem_numa_parse_cpulist(int node, uint8_t **cpu_to_node,
+                                  int *cpus_count)
+{
+    char path[PATH_MAX];
+    FILE *f;
+    int start;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+             node);
+    f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+
+    /* cpulist format is a comma separated list of cpus or cpu ranges, for
+     * example "0-7,16-23". */
+    while (fscanf(f, "%d", &start) == 1) {
+        int end = start;
+        int c = fgetc(f);
+
+        if (c == '-') {
+            if (fscanf(f, "%d", &end) != 1) {
+                break;
+            }
+            c = fgetc(f);
+        }
+        if (start < 0 || end < start || end >= 1 << 16) {
+            break;
+        }
+        if (end >= *cpus_count) {
+            p_realloc0(cpu_to_node, *cpus_count, end + 1);
+            *cpus_count = end + 1;
+        }
+        for (int cpu = start; cpu <= end; cpu++) {
+            (*cpu_to_node)[cpu] = node;
+        }
+        if (c != ',') {
+            break;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+int mem_numa_enable(bool enable)
+{
+    uint8_t *cpu_to_node = NULL;
+    int cpus_count = 0;
+    int nodes_count = 0;
+
+    if (!enable) {
+        _G.enabled = false;
+        return 0;
+    }
+    if (_G.enabled) {
+        return 0;
+    }
+
+#ifdef __linux__
+    for (int node = 0; node <= MEM_NUMA_NODES_MAX; node++) {
+        if (mem_numa_parse_cpulist(node, &cpu_to_node, &cpus_count) < 0) {
+            break;
+        }
+        nodes_count++;
+    }
+#endif
+
+    if (nodes_count < 2 || nodes_count > MEM_NUMA_NODES_MAX) {
+        /* Nothing to gain on single-node hosts, and too many nodes to be
+         * accounted in the pools statistics. */
+        p_delete(&cpu_to_node);
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    p_delete(&_G.cpu_to_node);
+    _G.cpu_to_node = cpu_to_node;
+    _G.cpus_count  = cpus_count;
+    _G.nodes_count = nodes_count;
+    _G.enabled     = true;
+    return 0;
+}
+
+bool mem_numa_is_enabled(void)
+{
+    return _G.enabled;
+}
+
+int mem_numa_nodes_count(void)
+{
+    return _G.enabled ? _G.nodes_count : 1;
+}
+
+int mem_numa_current_node(void)
+{
+    int cpu;
+
+    if (!_G.enabled) {
+        return 0;
+    }
+    cpu = sched_getcpu();
+    if (unlikely(cpu < 0 || cpu >= _G.cpus_count)) {
+        return 0;
+    }
+    return _G.cpu_to_node[cpu];
+}
+
+void mem_numa_bind(void *mem, size_t size, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    uintptr_t start = ROUND_UP((uintptr_t)mem, PAGE_SIZE);
+    uintptr_t end   = ROUND((uintptr_t)mem + size, PAGE_SIZE);
+    unsigned long nodemask = 1UL << node;
+
+    if (!_G.enabled || start >= end) {
+        return;
+    }
+
+    /* This is only a hint: memory still gets allocated on another node when
+     * the preferred one is full, and errors are deliberately ignored. */
+    IGNORE(syscall(SYS_mbind, start, end - start, MPOL_PREFERRED, &nodemask,
+                   bitsizeof(nodemask), 0));
+#endif
+}
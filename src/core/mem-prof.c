@@ -0,0 +1,285 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <execinfo.h>
+
+#include <lib-common/core.h>
+#include <lib-common/thr.h>
+
+/*
+ * Allocation profiler
+ * ~~~~~~~~~~~~~~~~~~~
+ *
+ * When enabled, one allocation out of `period` done through mp_imalloc() is
+ * sampled: its size, the name of its pool and its backtrace are recorded in
+ * a ring buffer of the allocating thread. Only the sampling takes a lock (the
+ * one of the buffer of the thread), so that the buffers can be read while the
+ * threads are running.
+ *
+ * The samples of the exited threads are moved into a global buffer.
+ */
+
+#define MEM_PROF_DEPTH     16
+#define MEM_PROF_SAMPLES   1024
+#define MEM_PROF_SKIP      2 /* mem_prof_sample() and __mp_imalloc() */
+
+typedef struct mem_prof_sample_t {
+    uint64_t bytes; /* size of the allocation times the sampling period */
+    char     pool[32];
+    int      depth;
+    void    *frames[MEM_PROF_DEPTH];
+} mem_prof_sample_t;
+qvector_t(mem_prof_sample, mem_prof_sample_t);
+
+typedef struct mem_prof_buf_t {
+    spinlock_t lock;
+    dlist_t    buf_list;
+    uint32_t   pos;
+    uint32_t   len;
+    mem_prof_sample_t samples[MEM_PROF_SAMPLES];
+} mem_prof_buf_t;
+
+unsigned mem_prof_period_g;
+
+static struct {
+    spinlock_t      lock;
+    dlist_t         bufs;
+    mem_prof_buf_t *exited;
+} core_mem_prof_g = {
+#define _G  core_mem_prof_g
+    .bufs = DLIST_INIT(_G.bufs),
+};
+
+static __thread struct {
+    mem_prof_buf_t *buf;
+    unsigned        countdown;
+    bool            in_sample;
+} mem_prof_thr_g;
+
+static mem_prof_buf_t *mem_prof_buf_new(void)
+{
+    mem_prof_buf_t *buf = p_new_raw(mem_prof_buf_t, 1);
+
+    p_clear(buf, 1);
+    dlist_init(&buf->buf_list);
+    return buf;
+}
+
+static void mem_prof_buf_add(mem_prof_buf_t *buf,
+                             const mem_prof_sample_t *sample)
+{
+    buf->samples[buf->pos] = *sample;
+    buf->pos = (buf->pos + 1) % MEM_PROF_SAMPLES;
+    buf->len = MIN(buf->len + 1, MEM_PROF_SAMPLES);
+}
+
+void mem_prof_sample(const mem_pool_t *mp, size_t size)
+{
+    mem_prof_sample_t sample;
+    void *frames[MEM_PROF_DEPTH + MEM_PROF_SKIP];
+    mem_prof_buf_t *buf;
+    int depth;
+
+    if (mem_prof_thr_g.countdown > 1) {
+        mem_prof_thr_g.countdown--;
+        return;
+    }
+    /* the allocations done while sampling must not be sampled */
+    if (mem_prof_thr_g.in_sample) {
+        return;
+    }
+    mem_prof_thr_g.in_sample = true;
+    mem_prof_thr_g.countdown = MAX(mem_prof_period_g, 1U);
+
+    buf = mem_prof_thr_g.buf;
+    if (unlikely(!buf)) {
+        buf = mem_prof_thr_g.buf = mem_prof_buf_new();
+        spin_lock(&_G.lock);
+        dlist_add_tail(&_G.bufs, &buf->buf_list);
+        spin_unlock(&_G.lock);
+    }
+
+    depth = backtrace(frames, countof(frames)) - MEM_PROF_SKIP;
+    sample.bytes = (uint64_t)size * mem_prof_thr_g.countdown;
+    sample.depth = MAX(depth, 0);
+    memcpy(sample.frames, frames + MEM_PROF_SKIP,
+           sample.depth * sizeof(void *));
+    p_clear(sample.frames + sample.depth, MEM_PROF_DEPTH - sample.depth);
+    if (mp->name) {
+        pstrcpy(sample.pool, sizeof(sample.pool), mp->name);
+    } else {
+        bool is_libc = (mp->mem_pool & MEM_POOL_MASK) == MEM_LIBC;
+
+        pstrcpy(sample.pool, sizeof(sample.pool), is_libc ? "libc" : "other");
+    }
+
+    spin_lock(&buf->lock);
+    mem_prof_buf_add(buf, &sample);
+    spin_unlock(&buf->lock);
+
+    mem_prof_thr_g.in_sample = false;
+}
+
+void mem_prof_start(unsigned period)
+{
+    mem_prof_period_g = period;
+}
+
+void mem_prof_stop(void)
+{
+    mem_prof_period_g = 0;
+}
+
+void mem_prof_reset(void)
+{
+    spin_lock(&_G.lock);
+    dlist_for_each_entry(mem_prof_buf_t, buf, &_G.bufs, buf_list) {
+        spin_lock(&buf->lock);
+        buf->pos = buf->len = 0;
+        spin_unlock(&buf->lock);
+    }
+    p_delete(&_G.exited);
+    spin_unlock(&_G.lock);
+}
+
+static void mem_prof_thr_wipe(void)
+{
+    mem_prof_buf_t *buf = mem_prof_thr_g.buf;
+
+    if (!buf) {
+        return;
+    }
+
+    mem_prof_thr_g.in_sample = true;
+    spin_lock(&_G.lock);
+    dlist_remove(&buf->buf_list);
+    if (buf->len) {
+        if (!_G.exited) {
+            _G.exited = mem_prof_buf_new();
+        }
+        for (uint32_t i = 0; i < buf->len; i++) {
+            uint32_t pos = (buf->pos + MEM_PROF_SAMPLES - buf->len + i)
+                         % MEM_PROF_SAMPLES;
+
+            mem_prof_buf_add(_G.exited, &buf->samples[pos]);
+        }
+    }
+    spin_unlock(&_G.lock);
+    p_delete(&mem_prof_thr_g.buf);
+}
+thr_hooks(NULL, mem_prof_thr_wipe);
+
+/* {{{ Collapsed stacks export */
+
+static int mem_prof_sample_cmp(const mem_prof_sample_t *a,
+                               const mem_prof_sample_t *b)
+{
+    int res = strcmp(a->pool, b->pool);
+
+    if (res) {
+        return res;
+    }
+    if (a->depth != b->depth) {
+        return CMP(a->depth, b->depth);
+    }
+    return memcmp(a->frames, b->frames, a->depth * sizeof(void *));
+}
+
+static void mem_prof_collect(mem_prof_buf_t *buf, qv_t(mem_prof_sample) *out)
+{
+    spin_lock(&buf->lock);
+    qv_extend(out, buf->samples, buf->len);
+    spin_unlock(&buf->lock);
+}
+
+/* Keep the function name of a backtrace_symbols() entry, which looks like
+ * "binary(function+0x42) [0x4242]"; fall back on the address. */
+static void sb_add_prof_frame(sb_t *sb, const char *sym, const void *frame)
+{
+    const char *start = strchr(sym, '(');
+    const char *end = start ? strpbrk(start, "+)") : NULL;
+
+    if (start && end && end > start + 1) {
+        sb_add(sb, start + 1, end - start - 1);
+    } else {
+        sb_addf(sb, "%p", frame);
+    }
+}
+
+void mem_prof_dump_collapsed(sb_t *out)
+{
+    qv_t(mem_prof_sample) samples;
+    bool in_sample = mem_prof_thr_g.in_sample;
+
+    /* the allocations done here must not be sampled, as the locks of the
+     * buffers are held */
+    mem_prof_thr_g.in_sample = true;
+    qv_init(&samples);
+
+    spin_lock(&_G.lock);
+    dlist_for_each_entry(mem_prof_buf_t, buf, &_G.bufs, buf_list) {
+        mem_prof_collect(buf, &samples);
+    }
+    if (_G.exited) {
+        mem_prof_collect(_G.exited, &samples);
+    }
+    spin_unlock(&_G.lock);
+
+    qv_qsort(&samples, &mem_prof_sample_cmp);
+
+    for (int i = 0; i < samples.len; ) {
+        const mem_prof_sample_t *sample = &samples.tab[i];
+        uint64_t bytes = 0;
+        char **syms;
+
+        do {
+            bytes += samples.tab[i++].bytes;
+        } while (i < samples.len
+             &&  mem_prof_sample_cmp(sample, &samples.tab[i]) == 0);
+
+        /* one line per stack, from the root frame to the allocation point,
+         * with the estimated amount of allocated bytes */
+        sb_adds(out, sample->pool);
+        syms = backtrace_symbols(sample->frames, sample->depth);
+        for (int j = sample->depth; j-- > 0; ) {
+            sb_addc(out, ';');
+            if (syms) {
+                sb_add_prof_frame(out, syms[j], sample->frames[j]);
+            } else {
+                sb_addf(out, "%p", sample->frames[j]);
+            }
+        }
+        free(syms);
+        sb_addf(out, " %ju\n", bytes);
+    }
+
+    qv_wipe(&samples);
+    mem_prof_thr_g.in_sample = in_sample;
+}
+
+/* }}} */
+
+__attribute__((constructor))
+static void mem_prof_initialize(void)
+{
+    const char *val = getenv("MEM_PROF_PERIOD");
+
+    if (val && *val) {
+        mem_prof_start(atoi(val));
+    }
+}
@@ -58,6 +58,8 @@ typedef struct ring_blk_t {
     void        *start;
     size_t       size;
     dlist_t      blist;
+    uint32_t     node : 31;
+    bool         huge :  1;
     byte         area[];
 } ring_blk_t;
 
@@ -65,6 +67,8 @@ typedef struct frame_t {
     dlist_t      flist;
     ring_blk_t  *blk;
     uintptr_t    rp;
+    /* holders of the frame, see mem_ring_retain() */
+    atomic_uint  refcnt;
 } frame_t;
 #define FRAME_IS_FREE   (1ULL << 0)
 
@@ -78,6 +82,10 @@ struct ring_pool_t {
 
     size_t       minsize;
     size_t       ringsize;
+    size_t       huge_ringsize;
+    unsigned     flags;
+    size_t       node_ringsize[MEM_NUMA_NODES_MAX];
+    mem_window_t window;
 
     size_t       alloc_sz;
     uint32_t     alloc_nb;
@@ -132,7 +140,7 @@ static ring_blk_t *blk_create(ring_pool_t *rp, size_t size_hint)
 {
     size_t blksize = size_hint + sizeof(ring_blk_t);
     size_t alloc_target = MIN(100U << 20, 64 * rp_alloc_mean(rp));
-    ring_blk_t *blk;
+    ring_blk_t *blk = NULL;
 
     if (blksize < rp->minsize) {
         blksize = rp->minsize;
@@ -142,26 +150,47 @@ static ring_blk_t *blk_create(ring_pool_t *rp, size_t size_hint)
     }
     blksize = ROUND_UP(blksize, PAGE_SIZE);
     icheck_alloc(blksize);
-    blk = imalloc(blksize, 0, MEM_RAW | MEM_LIBC);
+    if ((rp->flags & MEM_POOL_HUGE_PAGES) && blksize >= MEM_HUGE_PAGE_SIZE) {
+        blksize = ROUND_UP(blksize, MEM_HUGE_PAGE_SIZE);
+        blk = mem_huge_map(blksize);
+    }
+    if (blk) {
+        blk->huge = true;
+        rp->huge_ringsize += blksize - sizeof(*blk);
+    } else {
+        blk = imalloc(blksize, 0, MEM_RAW | MEM_LIBC);
+        blk->huge = false;
+    }
     blk->start    = blk->area;
     blk->size     = blksize - sizeof(*blk);
+    blk->node     = mem_numa_current_node();
+    mem_numa_bind(blk, blksize, blk->node);
     rp->ringsize += blk->size;
+    rp->node_ringsize[blk->node] += blk->size;
     if (likely(rp->cblk)) {
         dlist_add_after(&rp->cblk->blist, &blk->blist);
     } else {
         dlist_init(&blk->blist);
     }
     rp->nbpages++;
+    mem_window_add_churn(&rp->window);
     return blk;
 }
 
 static void blk_destroy(ring_pool_t *rp, ring_blk_t *blk)
 {
     rp->ringsize -= blk->size;
+    rp->node_ringsize[blk->node] -= blk->size;
     rp->nbpages--;
+    mem_window_add_churn(&rp->window);
     dlist_remove(&blk->blist);
     mem_tool_allow_memory(blk, blk->size + sizeof(*blk), false);
-    ifree(blk, MEM_LIBC);
+    if (blk->huge) {
+        rp->huge_ringsize -= blk->size;
+        mem_huge_unmap(blk, blk->size + sizeof(*blk));
+    } else {
+        ifree(blk, MEM_LIBC);
+    }
 }
 
 static bool blk_contains(const ring_blk_t *blk, const void *ptr)
@@ -180,6 +209,7 @@ frame_get_next_blk(ring_pool_t *rp, size_t size)
 {
     ring_blk_t *cur = rp->cblk;
     frame_t *start = dlist_first_entry(&rp->fhead, frame_t, flist);
+    size_t hwm;
 
     while (!dlist_is_empty(&cur->blist)) {
         ring_blk_t *blk = dlist_next_entry(cur, blist);
@@ -198,6 +228,15 @@ frame_get_next_blk(ring_pool_t *rp, size_t size)
         }
         blk_destroy(rp, blk);
     }
+
+    /* the ring is full: the frames need all its blocks plus the new
+     * allocation; make the new block big enough to reach the recent
+     * high-water mark, so that the next bursts fit in the ring */
+    mem_window_update_hwm(&rp->window, rp->ringsize + size);
+    hwm = MIN(100U << 20, mem_window_hwm(&rp->window));
+    if (hwm > rp->ringsize + size) {
+        size = hwm - rp->ringsize;
+    }
     return blk_create(rp, size);
 }
 
@@ -282,7 +321,9 @@ static void *rp_realloc(mem_pool_t *_rp, void *mem, size_t oldsize,
 
     if (oldsize >= size) {
         if (mem == rp->last) {
+            spin_lock(&rp->lock);
             rp->pos = (byte *)mem + size;
+            spin_unlock(&rp->lock);
         }
         mem_tool_disallow_memory((byte *)mem + size, oldsize - size);
         return size ? mem : MEM_EMPTY_ALLOC;
@@ -292,8 +333,10 @@ static void *rp_realloc(mem_pool_t *_rp, void *mem, size_t oldsize,
     &&  is_aligned_to(mem, align_boundary(size))
     &&  (byte *)rp->last + size <= blk_end(rp->cblk))
     {
+        spin_lock(&rp->lock);
         rp->pos = (byte *)rp->last + size;
         rp->alloc_sz  += size - oldsize;
+        spin_unlock(&rp->lock);
         mem_tool_allow_memory(mem, size, true);
         res = mem;
     } else {
@@ -374,21 +417,29 @@ void ring_reset_to_prevframe(ring_pool_t *rp, frame_t *fprev, frame_t *frame)
 }
 
 static ALWAYS_INLINE
-void ring_setup_frame(ring_pool_t *rp, ring_blk_t *blk, frame_t *frame)
+void __ring_setup_frame(ring_pool_t *rp, ring_blk_t *blk, frame_t *frame)
 {
-    spin_lock(&rp->lock);
     frame->blk = blk;
     frame->rp  = (uintptr_t)rp;
+    atomic_init(&frame->refcnt, 1);
     dlist_add_tail(&rp->fhead, &frame->flist);
 
     rp->ring = frame;
     ring_reset_frame(rp, frame, false);
+}
+
+static ALWAYS_INLINE
+void ring_setup_frame(ring_pool_t *rp, ring_blk_t *blk, frame_t *frame)
+{
+    spin_lock(&rp->lock);
+    __ring_setup_frame(rp, blk, frame);
     spin_unlock(&rp->lock);
 }
 
 /*------ Public API -{{{-*/
 
-mem_pool_t *mem_ring_new(const char *name, int initialsize)
+mem_pool_t *mem_ring_new_flags(const char *name, int initialsize,
+                               unsigned flags)
 {
     ring_pool_t *rp = p_new(ring_pool_t, 1);
     ring_blk_t *blk;
@@ -402,9 +453,12 @@ mem_pool_t *mem_ring_new(const char *name, int initialsize)
         initialsize = 640 << 10;
     }
     rp->minsize    = ROUND_UP(initialsize, PAGE_SIZE);
+    rp->flags      = flags;
     rp->funcs      = pool_funcs;
+    rp->funcs.name = rp->name;
     rp->alloc_nb   = 1; /* avoid the division by 0 */
     rp->frames_cnt  = 0;
+    mem_window_init(&rp->window);
     rp->alive = true;
 
     /* Makes the first frame */
@@ -492,9 +546,12 @@ const void *mem_ring_seal(mem_pool_t *_rp)
     frame_t *frame;
     ring_blk_t *blk;
 
-    /* Makes a new frame */
+    /* Makes a new frame, the ring is locked as the sealed frames may be
+     * released by other threads meanwhile */
+    spin_lock(&rp->lock);
     frame = rp_reserve(rp, sizeof(frame_t), &blk);
-    ring_setup_frame(rp, blk, frame);
+    __ring_setup_frame(rp, blk, frame);
+    spin_unlock(&rp->lock);
 
     return last;
 }
@@ -503,6 +560,7 @@ static void __mem_ring_reset(ring_pool_t *rp)
 {
     size_t saved_size;
     size_t max_size;
+    size_t hwm;
     ring_blk_t *saved_blk = NULL;
     frame_t *start = dlist_first_entry(&rp->fhead, frame_t, flist);
 
@@ -513,6 +571,29 @@ static void __mem_ring_reset(ring_pool_t *rp)
         return;
     }
 
+    /* Keep what the frames recently needed, if they needed more than the
+     * current block.
+     */
+    hwm = mem_window_hwm(&rp->window);
+    if (hwm) {
+        size_t kept = rp->cblk->size;
+
+        dlist_for_each(e, &rp->cblk->blist) {
+            ring_blk_t *blk = blk_entry(e);
+
+            if (blk_contains(blk, start)) {
+                continue;
+            }
+            if (kept < hwm) {
+                kept += blk->size;
+            } else {
+                blk_destroy(rp, blk);
+            }
+        }
+        rp->nb_frames_release = 0;
+        return;
+    }
+
     saved_blk  = NULL;
     saved_size = RESET_MIN * rp_alloc_mean(rp);
     max_size   = RESET_MAX * rp_alloc_mean(rp);
@@ -564,6 +645,10 @@ void mem_ring_release(const void *cookie)
     rp = (ring_pool_t *)frame->rp;
     assert (!(frame->rp & FRAME_IS_FREE));
 
+    if (atomic_fetch_sub(&frame->refcnt, 1) > 1) {
+        return;
+    }
+
     spin_lock(&rp->lock);
     if (rp->ring == frame) {
         if (dlist_is_empty_or_singular(&rp->fhead)) {
@@ -638,6 +723,18 @@ void mem_ring_release(const void *cookie)
     }
 }
 
+const void *mem_ring_retain(const void *cookie)
+{
+    frame_t *frame = (frame_t *)cookie;
+    unsigned refcnt;
+
+    assert (!(frame->rp & FRAME_IS_FREE));
+    refcnt = atomic_fetch_add(&frame->refcnt, 1);
+    assert (refcnt > 0);
+    (void)refcnt;
+    return cookie;
+}
+
 const void *mem_ring_checkpoint(mem_pool_t *_rp)
 {
     ring_pool_t *rp = container_of(_rp, ring_pool_t, funcs);
@@ -775,9 +872,53 @@ size_t mem_ring_memory_footprint(const mem_pool_t *_rp)
     return sizeof(*rp) + rp->ringsize;
 }
 
+size_t mem_ring_memory_footprint_node(const mem_pool_t *_rp, int node)
+{
+    ring_pool_t *rp = container_of(_rp, ring_pool_t, funcs);
+
+    if (node < 0 || node >= MEM_NUMA_NODES_MAX) {
+        return 0;
+    }
+    return rp->node_ringsize[node];
+}
+
+void mem_ring_pools_window_stats(mem_pool_window_cb_f *cb, void *data)
+{
+    spin_lock(&_G.all_pools_lock);
+    dlist_for_each_entry(ring_pool_t, rp, &_G.all_pools, pool_list) {
+        mem_pool_window_stats_t stats = {
+            .name  = rp->name,
+            .pool  = rp,
+            .size  = rp->ringsize,
+            .hwm   = mem_window_hwm(&rp->window),
+            .churn = mem_window_churn(&rp->window),
+        };
+
+        (*cb)(&stats, data);
+    }
+    spin_unlock(&_G.all_pools_lock);
+}
+
 /* }}} */
 /* {{{ Module (for print_state method) */
 
+static lstr_t t_mem_numa_fmt_nodes(const size_t sizes[MEM_NUMA_NODES_MAX])
+{
+    SB_1k(buf);
+
+    if (!mem_numa_is_enabled()) {
+        return LSTR("-");
+    }
+    for (int i = 0; i < mem_numa_nodes_count(); i++) {
+        if (buf.len) {
+            sb_addc(&buf, ' ');
+        }
+        sb_addf(&buf, "%d:", i);
+        sb_add_int_fmt(&buf, sizes[i], ',');
+    }
+    return t_lstr_dup(LSTR_SB_V(&buf));
+}
+
 static void core_mem_ring_print_state(void)
 {
     t_scope;
@@ -791,6 +932,8 @@ static void core_mem_ring_print_state(void)
             .title = LSTR_IMMED("MIN SIZE"),
         }, {
             .title = LSTR_IMMED("RING SIZE"),
+        }, {
+            .title = LSTR_IMMED("HUGE SIZE"),
         }, {
             .title = LSTR_IMMED("NB PAGES"),
         }, {
@@ -799,13 +942,23 @@ static void core_mem_ring_print_state(void)
             .title = LSTR_IMMED("ALLOC NB"),
         }, {
             .title = LSTR_IMMED("ALLOC MEAN"),
+        }, {
+            .title = LSTR_IMMED("FRAME HWM"),
+        }, {
+            .title = LSTR_IMMED("CHURN"),
+        }, {
+            .title = LSTR_IMMED("SIZE PER NODE"),
         }
     };
     uint32_t hdr_size = countof(hdr_data);
+    size_t   total_node_ringsize[MEM_NUMA_NODES_MAX] = { 0 };
     size_t   total_ringsize = 0;
+    size_t   total_huge_size = 0;
     size_t   total_nbpages  = 0;
     size_t   total_alloc_sz = 0;
     uint64_t total_alloc_nb = 0;
+    size_t   total_hwm = 0;
+    uint32_t total_churn = 0;
     int nb_ring_pool = 0;
 
     qv_init_static(&hdr, hdr_data, hdr_size);
@@ -830,16 +983,26 @@ static void core_mem_ring_print_state(void)
 
         ADD_NUMBER_FIELD(rp->minsize);
         ADD_NUMBER_FIELD(rp->ringsize);
+        ADD_NUMBER_FIELD(rp->huge_ringsize);
         ADD_NUMBER_FIELD(rp->nbpages);
         ADD_NUMBER_FIELD(rp->alloc_sz);
         ADD_NUMBER_FIELD(rp->alloc_nb);
         ADD_NUMBER_FIELD(rp_alloc_mean(rp));
+        ADD_NUMBER_FIELD(mem_window_hwm(&rp->window));
+        ADD_NUMBER_FIELD(mem_window_churn(&rp->window));
+        qv_append(tab, t_mem_numa_fmt_nodes(rp->node_ringsize));
 
         nb_ring_pool++;
         total_ringsize  += rp->ringsize;
+        total_huge_size += rp->huge_ringsize;
         total_nbpages   += rp->nbpages;
         total_alloc_sz  += rp->alloc_sz;
         total_alloc_nb  += rp->alloc_nb;
+        total_hwm       += mem_window_hwm(&rp->window);
+        total_churn     += mem_window_churn(&rp->window);
+        for (int i = 0; i < MEM_NUMA_NODES_MAX; i++) {
+            total_node_ringsize[i] += rp->node_ringsize[i];
+        }
     }
 
     spin_unlock(&_G.all_pools_lock);
@@ -854,10 +1017,14 @@ static void core_mem_ring_print_state(void)
         qv_append(tab, LSTR("-"));
 
         ADD_NUMBER_FIELD(total_ringsize);
+        ADD_NUMBER_FIELD(total_huge_size);
         ADD_NUMBER_FIELD(total_nbpages);
         ADD_NUMBER_FIELD(total_alloc_sz);
         ADD_NUMBER_FIELD(total_alloc_nb);
         ADD_NUMBER_FIELD(total_alloc_sz / total_alloc_nb);
+        ADD_NUMBER_FIELD(total_hwm);
+        ADD_NUMBER_FIELD(total_churn);
+        qv_append(tab, t_mem_numa_fmt_nodes(total_node_ringsize));
 
         sb_add_table(&buf, &hdr, &rows);
         sb_shrink(&buf, 1);
@@ -0,0 +1,742 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/core.h>
+#include <lib-common/el.h>
+#include <lib-common/log.h>
+#include <lib-common/str-buf-pp.h>
+#include <lib-common/thr.h>
+
+/*
+ * Slab pool
+ * ~~~~~~~~~
+ *
+ * The allocations are rounded up to a size class (16 bytes steps up to 128
+ * bytes, then 4 classes per power of two) and carved from slabs of
+ * SLAB_SIZE bytes aligned on SLAB_SIZE, so that the slab of an object is
+ * found by masking its address. Allocations bigger than the maximum size of
+ * the pool get a slab of their own.
+ *
+ * Each thread keeps a small magazine of free objects per class and per pool
+ * so that most of the allocations and deallocations do not take any lock.
+ * Magazines are refilled from (and flushed into) the slabs by batches of
+ * SLAB_MAG_SIZE / 2 objects under the lock of the class.
+ */
+
+#define SLAB_SHIFT        16
+#define SLAB_SIZE         (1U << SLAB_SHIFT)
+#define SLAB_MAG_SIZE     16
+#define SLAB_POOLS_MAX    64
+#define SLAB_CLASS_LARGE  UINT16_MAX
+
+typedef struct mem_slab_t {
+    struct mem_slab_pool_t *pool;
+    dlist_t   slab_list;
+    dlist_t   partial_list;
+    void     *free_objs;
+    size_t    size;
+    uint16_t  class_idx;
+    uint32_t  obj_size;
+    uint32_t  nb_objs;
+    uint32_t  bumped;
+    uint32_t  used;
+
+    byte __attribute__((aligned(CACHE_LINE_SIZE))) area[];
+} mem_slab_t;
+
+typedef struct mem_slab_class_t {
+    spinlock_t lock;
+    uint32_t   obj_size;
+    uint32_t   nb_slabs;
+    uint32_t   nb_empty;
+    dlist_t    slabs;
+    dlist_t    partial;
+} mem_slab_class_t;
+
+typedef struct mem_slab_pool_t {
+    mem_pool_t  funcs;
+    int         id;
+    uint16_t    nb_classes;
+    size_t      max_size;
+
+    _Atomic(size_t) map_size;
+    _Atomic(size_t) occupied;
+
+    spinlock_t  large_lock;
+    dlist_t     large;
+    uint32_t    nb_large;
+
+    dlist_t     mags;
+    char       *name;
+    dlist_t     pool_list;
+
+    mem_slab_class_t classes[MEM_SLAB_CLASSES];
+} mem_slab_pool_t;
+
+typedef struct mem_slab_mag_t {
+    mem_slab_pool_t *pool;
+    dlist_t          mag_list;
+    uint8_t          len[MEM_SLAB_CLASSES];
+    void            *objs[MEM_SLAB_CLASSES][SLAB_MAG_SIZE];
+} mem_slab_mag_t;
+
+static struct {
+    logger_t logger;
+
+    /* protects the pools list, the pool ids and the magazines lists */
+    dlist_t all_pools;
+    spinlock_t all_pools_lock;
+    uint64_t pool_ids;
+} core_mem_slab_g = {
+#define _G  core_mem_slab_g
+    .logger = LOGGER_INIT_INHERITS(NULL, "core-mem-slab"),
+    .all_pools = DLIST_INIT(_G.all_pools),
+};
+
+static __thread mem_slab_mag_t *mem_slab_mags_g[SLAB_POOLS_MAX];
+
+/* {{{ Size classes */
+
+static ALWAYS_INLINE int slab_class_of(size_t size)
+{
+    int b;
+
+    if (size <= 128) {
+        return size ? (size - 1) / 16 : 0;
+    }
+    b = bsr64(size - 1);
+    return 8 + (b - 7) * 4 + (((size - 1) >> (b - 2)) & 3);
+}
+
+static uint32_t slab_class_size(int idx)
+{
+    int b;
+
+    if (idx < 8) {
+        return (idx + 1) * 16;
+    }
+    b = 7 + (idx - 8) / 4;
+    return (1U << b) + ((idx - 8) % 4 + 1) * (1U << (b - 2));
+}
+
+static ALWAYS_INLINE mem_slab_t *slab_of(const void *ptr)
+{
+    return (mem_slab_t *)((uintptr_t)ptr & ~(uintptr_t)(SLAB_SIZE - 1));
+}
+
+/* }}} */
+/* {{{ Slabs */
+
+static mem_slab_t *slab_create(mem_slab_pool_t *sp, int idx)
+{
+    mem_slab_class_t *cls = &sp->classes[idx];
+    mem_slab_t *slab = (mem_slab_t *)pa_new_raw(byte, SLAB_SIZE, SLAB_SIZE);
+
+    p_clear(slab, 1);
+    slab->pool      = sp;
+    slab->size      = SLAB_SIZE;
+    slab->class_idx = idx;
+    slab->obj_size  = cls->obj_size;
+    slab->nb_objs   = (SLAB_SIZE - sizeof(mem_slab_t)) / cls->obj_size;
+    mem_tool_disallow_memory(slab->area, SLAB_SIZE - sizeof(mem_slab_t));
+
+    dlist_add(&cls->slabs, &slab->slab_list);
+    dlist_add(&cls->partial, &slab->partial_list);
+    cls->nb_slabs++;
+    cls->nb_empty++;
+    atomic_fetch_add(&sp->map_size, SLAB_SIZE);
+    return slab;
+}
+
+static void slab_destroy(mem_slab_pool_t *sp, mem_slab_t *slab)
+{
+    dlist_remove(&slab->slab_list);
+    dlist_remove(&slab->partial_list);
+    atomic_fetch_sub(&sp->map_size, slab->size);
+    mem_tool_allow_memory(slab, slab->size, true);
+    ifree(slab, MEM_LIBC);
+}
+
+/* must be called with the class lock held */
+static void *slab_class_pop(mem_slab_pool_t *sp, mem_slab_class_t *cls)
+{
+    mem_slab_t *slab;
+    void *obj;
+
+    if (unlikely(dlist_is_empty(&cls->partial))) {
+        slab = slab_create(sp, cls - sp->classes);
+    } else {
+        slab = dlist_first_entry(&cls->partial, mem_slab_t, partial_list);
+    }
+
+    if (slab->free_objs) {
+        obj = slab->free_objs;
+        mem_tool_allow_memory(obj, sizeof(void *), true);
+        slab->free_objs = *(void **)obj;
+        mem_tool_disallow_memory(obj, sizeof(void *));
+    } else {
+        obj = slab->area + slab->bumped++ * slab->obj_size;
+    }
+    if (slab->used++ == 0) {
+        cls->nb_empty--;
+    }
+    if (!slab->free_objs && slab->bumped == slab->nb_objs) {
+        dlist_remove(&slab->partial_list);
+    }
+    return obj;
+}
+
+/* must be called with the class lock held */
+static void slab_class_push(mem_slab_pool_t *sp, mem_slab_class_t *cls,
+                            void *obj)
+{
+    mem_slab_t *slab = slab_of(obj);
+
+    assert (slab->pool == sp && slab->class_idx == cls - sp->classes);
+    mem_tool_allow_memory(obj, sizeof(void *), false);
+    *(void **)obj = slab->free_objs;
+    mem_tool_disallow_memory(obj, sizeof(void *));
+    slab->free_objs = obj;
+
+    if (dlist_is_empty(&slab->partial_list)) {
+        dlist_add(&cls->partial, &slab->partial_list);
+    }
+    if (--slab->used == 0) {
+        /* keep a single empty slab around per class */
+        if (cls->nb_empty) {
+            cls->nb_slabs--;
+            slab_destroy(sp, slab);
+        } else {
+            cls->nb_empty++;
+        }
+    }
+}
+
+/* }}} */
+/* {{{ Magazines */
+
+static void slab_mag_flush(mem_slab_mag_t *mag, int idx, int count)
+{
+    mem_slab_pool_t *sp = mag->pool;
+    mem_slab_class_t *cls = &sp->classes[idx];
+
+    spin_lock(&cls->lock);
+    for (int i = 0; i < count; i++) {
+        slab_class_push(sp, cls, mag->objs[idx][--mag->len[idx]]);
+    }
+    spin_unlock(&cls->lock);
+}
+
+/* must be called with the global lock held */
+static void slab_mag_detach(mem_slab_mag_t *mag)
+{
+    for (int i = 0; i < mag->pool->nb_classes; i++) {
+        if (mag->len[i]) {
+            slab_mag_flush(mag, i, mag->len[i]);
+        }
+    }
+    dlist_remove(&mag->mag_list);
+    mag->pool = NULL;
+}
+
+static __attribute__((noinline)) mem_slab_mag_t *
+slab_mag_attach(mem_slab_pool_t *sp)
+{
+    mem_slab_mag_t *mag = mem_slab_mags_g[sp->id];
+
+    if (!mag) {
+        mag = mem_slab_mags_g[sp->id] = p_new(mem_slab_mag_t, 1);
+        dlist_init(&mag->mag_list);
+    }
+    spin_lock(&_G.all_pools_lock);
+    if (mag->pool) {
+        slab_mag_detach(mag);
+    }
+    mag->pool = sp;
+    dlist_add(&sp->mags, &mag->mag_list);
+    spin_unlock(&_G.all_pools_lock);
+    return mag;
+}
+
+static ALWAYS_INLINE mem_slab_mag_t *slab_mag(mem_slab_pool_t *sp)
+{
+    mem_slab_mag_t *mag;
+
+    if (unlikely(sp->id < 0)) {
+        return NULL;
+    }
+    mag = mem_slab_mags_g[sp->id];
+    if (likely(mag && mag->pool == sp)) {
+        return mag;
+    }
+    return slab_mag_attach(sp);
+}
+
+static void mem_slab_thr_wipe(void)
+{
+    spin_lock(&_G.all_pools_lock);
+    for (int i = 0; i < SLAB_POOLS_MAX; i++) {
+        mem_slab_mag_t *mag = mem_slab_mags_g[i];
+
+        if (mag) {
+            if (mag->pool) {
+                slab_mag_detach(mag);
+            }
+            p_delete(&mem_slab_mags_g[i]);
+        }
+    }
+    spin_unlock(&_G.all_pools_lock);
+}
+thr_hooks(NULL, mem_slab_thr_wipe);
+
+/* }}} */
+/* {{{ Pool functions */
+
+static void *msp_alloc_large(mem_slab_pool_t *sp, size_t size,
+                             size_t alignment, mem_flags_t flags)
+{
+    mem_slab_t *slab;
+    size_t mapsize;
+    byte *res;
+
+    if (alignment > SLAB_SIZE / 2) {
+        e_panic("mem_slab_pool does not support alignments greater than %u",
+                SLAB_SIZE / 2);
+    }
+    mapsize = ROUND_UP(sizeof(mem_slab_t) + alignment + size, PAGE_SIZE);
+    slab = (mem_slab_t *)pa_new_raw(byte, mapsize, SLAB_SIZE);
+    p_clear(slab, 1);
+    slab->pool      = sp;
+    slab->size      = mapsize;
+    slab->class_idx = SLAB_CLASS_LARGE;
+    slab->obj_size  = size;
+    slab->nb_objs   = 1;
+    slab->used      = 1;
+    dlist_init(&slab->partial_list);
+
+    spin_lock(&sp->large_lock);
+    dlist_add(&sp->large, &slab->slab_list);
+    sp->nb_large++;
+    spin_unlock(&sp->large_lock);
+    atomic_fetch_add(&sp->map_size, mapsize);
+    atomic_fetch_add(&sp->occupied, size);
+
+    res = (byte *)ROUND_UP((uintptr_t)slab->area, alignment);
+    if (!(flags & MEM_RAW)) {
+        p_clear(res, size);
+    }
+    return res;
+}
+
+static void msp_free_large(mem_slab_pool_t *sp, mem_slab_t *slab)
+{
+    atomic_fetch_sub(&sp->occupied, slab->obj_size);
+    spin_lock(&sp->large_lock);
+    sp->nb_large--;
+    slab_destroy(sp, slab);
+    spin_unlock(&sp->large_lock);
+}
+
+static void *msp_alloc(mem_pool_t *_sp, size_t size, size_t alignment,
+                       mem_flags_t flags)
+{
+    mem_slab_pool_t *sp = container_of(_sp, mem_slab_pool_t, funcs);
+    mem_slab_class_t *cls;
+    mem_slab_mag_t *mag;
+    void *obj;
+    int idx;
+
+    if (unlikely(size == 0)) {
+        return MEM_EMPTY_ALLOC;
+    }
+    if (size > sp->max_size || alignment > CACHE_LINE_SIZE) {
+        return msp_alloc_large(sp, size, alignment, flags);
+    }
+
+    idx = slab_class_of(size);
+    if (alignment > 16) {
+        /* the bigger classes are multiple of the cache line size */
+        while (sp->classes[idx].obj_size % alignment) {
+            idx++;
+        }
+    }
+    if (unlikely(idx >= sp->nb_classes)) {
+        return msp_alloc_large(sp, size, alignment, flags);
+    }
+    cls = &sp->classes[idx];
+
+    mag = slab_mag(sp);
+    if (likely(mag && mag->len[idx])) {
+        obj = mag->objs[idx][--mag->len[idx]];
+    } else {
+        spin_lock(&cls->lock);
+        if (mag) {
+            while (mag->len[idx] < SLAB_MAG_SIZE / 2) {
+                mag->objs[idx][mag->len[idx]++] = slab_class_pop(sp, cls);
+            }
+            obj = mag->objs[idx][--mag->len[idx]];
+            atomic_fetch_add(&sp->occupied,
+                             SLAB_MAG_SIZE / 2 * cls->obj_size);
+        } else {
+            obj = slab_class_pop(sp, cls);
+            atomic_fetch_add(&sp->occupied, cls->obj_size);
+        }
+        spin_unlock(&cls->lock);
+    }
+
+    mem_tool_malloclike(obj, size, 0, false);
+    if (!(flags & MEM_RAW)) {
+        memset(obj, 0, size);
+    }
+    return obj;
+}
+
+static void msp_free(mem_pool_t *_sp, void *mem)
+{
+    mem_slab_pool_t *sp = container_of(_sp, mem_slab_pool_t, funcs);
+    mem_slab_t *slab;
+    mem_slab_mag_t *mag;
+    int idx;
+
+    if (!mem || unlikely(mem == MEM_EMPTY_ALLOC)) {
+        return;
+    }
+
+    slab = slab_of(mem);
+    if (unlikely(slab->pool != sp)) {
+        e_panic("trying to free %p from the wrong slab pool", mem);
+    }
+    idx = slab->class_idx;
+    if (unlikely(idx == SLAB_CLASS_LARGE)) {
+        msp_free_large(sp, slab);
+        return;
+    }
+    mem_tool_freelike(mem, slab->obj_size, 0);
+
+    mag = slab_mag(sp);
+    if (likely(mag)) {
+        if (unlikely(mag->len[idx] == SLAB_MAG_SIZE)) {
+            slab_mag_flush(mag, idx, SLAB_MAG_SIZE / 2);
+            atomic_fetch_sub(&sp->occupied,
+                             SLAB_MAG_SIZE / 2 * slab->obj_size);
+        }
+        mag->objs[idx][mag->len[idx]++] = mem;
+    } else {
+        mem_slab_class_t *cls = &sp->classes[idx];
+
+        spin_lock(&cls->lock);
+        slab_class_push(sp, cls, mem);
+        spin_unlock(&cls->lock);
+        atomic_fetch_sub(&sp->occupied, cls->obj_size);
+    }
+}
+
+static void *msp_realloc(mem_pool_t *_sp, void *mem, size_t oldsize,
+                         size_t size, size_t alignment, mem_flags_t flags)
+{
+    mem_slab_t *slab;
+    size_t alloced_size;
+    void *res;
+
+    if (unlikely(size == 0)) {
+        msp_free(_sp, mem);
+        return MEM_EMPTY_ALLOC;
+    }
+    if (!mem || unlikely(mem == MEM_EMPTY_ALLOC)) {
+        return msp_alloc(_sp, size, alignment, flags);
+    }
+
+    slab = slab_of(mem);
+    alloced_size = slab->obj_size;
+    if (oldsize == MEM_UNKNOWN) {
+        oldsize = alloced_size;
+    }
+    assert (oldsize <= alloced_size);
+
+    /* the object fits in its current slot */
+    if (size <= alloced_size && ((uintptr_t)mem % alignment) == 0) {
+        mem_tool_freelike(mem, oldsize, 0);
+        mem_tool_malloclike(mem, size, 0, false);
+        mem_tool_allow_memory(mem, MIN(size, oldsize), true);
+        if (!(flags & MEM_RAW) && oldsize < size) {
+            memset((byte *)mem + oldsize, 0, size - oldsize);
+        }
+        return mem;
+    }
+
+    res = msp_alloc(_sp, size, alignment, flags | MEM_RAW);
+    memcpy(res, mem, MIN(size, oldsize));
+    if (!(flags & MEM_RAW) && oldsize < size) {
+        memset((byte *)res + oldsize, 0, size - oldsize);
+    }
+    msp_free(_sp, mem);
+    return res;
+}
+
+static mem_pool_t const mem_slab_pool_funcs = {
+    .malloc   = &msp_alloc,
+    .realloc  = &msp_realloc,
+    .free     = &msp_free,
+    .mem_pool = MEM_OTHER,
+    .min_alignment = 16
+};
+
+mem_pool_t *mem_slab_pool_new(const char *name, size_t max_size)
+{
+    mem_slab_pool_t *sp;
+
+    /* bypass mem_pool if demanded */
+    if (!mem_pool_is_enabled()) {
+        mem_pool_t *mp = p_new(mem_pool_t, 1);
+
+        *mp = mem_pool_libc;
+        return mp;
+    }
+
+    sp = p_new(mem_slab_pool_t, 1);
+    sp->funcs    = mem_slab_pool_funcs;
+    sp->name     = p_strdup(name);
+    sp->funcs.name = sp->name;
+    sp->max_size = MIN(max_size ?: MEM_SLAB_MAX_SIZE, MEM_SLAB_MAX_SIZE);
+    sp->nb_classes = slab_class_of(sp->max_size) + 1;
+    sp->max_size = slab_class_size(sp->nb_classes - 1);
+    for (int i = 0; i < sp->nb_classes; i++) {
+        sp->classes[i].obj_size = slab_class_size(i);
+        dlist_init(&sp->classes[i].slabs);
+        dlist_init(&sp->classes[i].partial);
+    }
+    dlist_init(&sp->large);
+    dlist_init(&sp->mags);
+
+    spin_lock(&_G.all_pools_lock);
+    if (_G.pool_ids == UINT64_MAX) {
+        /* too many pools: this one works without per-thread magazines */
+        sp->id = -1;
+    } else {
+        sp->id = bsf64(~_G.pool_ids);
+        _G.pool_ids |= 1ULL << sp->id;
+    }
+    dlist_add_tail(&_G.all_pools, &sp->pool_list);
+    spin_unlock(&_G.all_pools_lock);
+
+    return &sp->funcs;
+}
+
+void mem_slab_pool_delete(mem_pool_t **poolp)
+{
+    mem_slab_pool_t *sp;
+
+    /* bypass mem_pool if demanded */
+    if (!mem_pool_is_enabled()) {
+        p_delete(poolp);
+        return;
+    }
+
+    if (!*poolp) {
+        return;
+    }
+
+    sp = container_of(*poolp, mem_slab_pool_t, funcs);
+
+    spin_lock(&_G.all_pools_lock);
+    dlist_for_each_entry(mem_slab_mag_t, mag, &sp->mags, mag_list) {
+        slab_mag_detach(mag);
+    }
+    if (sp->id >= 0) {
+        _G.pool_ids &= ~(1ULL << sp->id);
+    }
+    dlist_remove(&sp->pool_list);
+    spin_unlock(&_G.all_pools_lock);
+
+    for (int i = 0; i < sp->nb_classes; i++) {
+        dlist_for_each_entry(mem_slab_t, slab, &sp->classes[i].slabs,
+                             slab_list)
+        {
+            slab_destroy(sp, slab);
+        }
+    }
+    dlist_for_each_entry(mem_slab_t, slab, &sp->large, slab_list) {
+        slab_destroy(sp, slab);
+    }
+
+    p_delete(&sp->name);
+    p_delete(&sp);
+    *poolp = NULL;
+}
+
+void mem_slab_pool_stats(mem_pool_t *mp, ssize_t *allocated, ssize_t *used)
+{
+    mem_slab_pool_t *sp = container_of(mp, mem_slab_pool_t, funcs);
+
+    /* bypass mem_pool if demanded */
+    if (!mem_pool_is_enabled()) {
+        return;
+    }
+
+    *allocated = atomic_load(&sp->map_size);
+    *used      = atomic_load(&sp->occupied);
+}
+
+void mem_slab_pool_print_stats(mem_pool_t *mp)
+{
+    mem_slab_pool_t *sp = container_of(mp, mem_slab_pool_t, funcs);
+
+    /* bypass mem_pool if demanded */
+    if (!mem_pool_is_enabled()) {
+        return;
+    }
+
+    logger_notice(&_G.logger, "slab pool `%s`: %zu bytes allocated, "
+                  "%zu bytes used, %u large allocations", sp->name,
+                  atomic_load(&sp->map_size), atomic_load(&sp->occupied),
+                  sp->nb_large);
+    for (int i = 0; i < sp->nb_classes; i++) {
+        mem_slab_class_t *cls = &sp->classes[i];
+
+        if (cls->nb_slabs) {
+            logger_notice(&_G.logger, "  class %u bytes: %u slabs, "
+                          "%u empty", cls->obj_size, cls->nb_slabs,
+                          cls->nb_empty);
+        }
+    }
+}
+
+void mem_slab_pools_print_stats(void)
+{
+    /* bypass mem_pool if demanded */
+    if (!mem_pool_is_enabled()) {
+        return;
+    }
+
+    spin_lock(&_G.all_pools_lock);
+    dlist_for_each_entry(mem_slab_pool_t, sp, &_G.all_pools, pool_list) {
+        mem_slab_pool_print_stats(&sp->funcs);
+    }
+    spin_unlock(&_G.all_pools_lock);
+}
+
+/* }}} */
+/* {{{ Module (for print_state method) */
+
+static void core_mem_slab_print_state(void)
+{
+    t_scope;
+    qv_t(table_hdr) hdr;
+    qv_t(table_data) rows;
+    table_hdr_t hdr_data[] = { {
+            .title = LSTR_IMMED("SLAB POOL NAME"),
+        }, {
+            .title = LSTR_IMMED("POINTER"),
+        }, {
+            .title = LSTR_IMMED("SIZE"),
+        }, {
+            .title = LSTR_IMMED("OCCUPIED"),
+        }, {
+            .title = LSTR_IMMED("MAX SIZE"),
+        }, {
+            .title = LSTR_IMMED("NB SLABS"),
+        }, {
+            .title = LSTR_IMMED("NB LARGE"),
+        }
+    };
+    uint32_t hdr_size = countof(hdr_data);
+    size_t   total_size = 0;
+    size_t   total_occupied = 0;
+    uint32_t total_nb_slabs = 0;
+    uint32_t total_nb_large = 0;
+    int nb_slab_pool = 0;
+
+    qv_init_static(&hdr, hdr_data, hdr_size);
+    t_qv_init(&rows, 200);
+
+#define ADD_NUMBER_FIELD(_what)  \
+    do {                                                                     \
+        t_SB(_buf, 16);                                                      \
+                                                                             \
+        sb_add_int_fmt(&_buf, _what, ',');                                   \
+        qv_append(tab, LSTR_SB_V(&_buf));                                    \
+    } while (0)
+
+    spin_lock(&_G.all_pools_lock);
+
+    dlist_for_each_entry(mem_slab_pool_t, sp, &_G.all_pools, pool_list) {
+        qv_t(lstr) *tab = qv_growlen(&rows, 1);
+        size_t map_size = atomic_load(&sp->map_size);
+        size_t occupied = atomic_load(&sp->occupied);
+        uint32_t nb_slabs = 0;
+
+        for (int i = 0; i < sp->nb_classes; i++) {
+            nb_slabs += sp->classes[i].nb_slabs;
+        }
+
+        t_qv_init(tab, hdr_size);
+        qv_append(tab, t_lstr_fmt("%s", sp->name));
+        qv_append(tab, t_lstr_fmt("%p", sp));
+
+        ADD_NUMBER_FIELD(map_size);
+        ADD_NUMBER_FIELD(occupied);
+        ADD_NUMBER_FIELD(sp->max_size);
+        ADD_NUMBER_FIELD(nb_slabs);
+        ADD_NUMBER_FIELD(sp->nb_large);
+
+        nb_slab_pool++;
+        total_size     += map_size;
+        total_occupied += occupied;
+        total_nb_slabs += nb_slabs;
+        total_nb_large += sp->nb_large;
+    }
+
+    spin_unlock(&_G.all_pools_lock);
+
+    if (nb_slab_pool) {
+        SB_1k(buf);
+        qv_t(lstr) *tab = qv_growlen(&rows, 1);
+
+        t_qv_init(tab, hdr_size);
+        qv_append(tab, LSTR("TOTAL"));
+        qv_append(tab, LSTR("-"));
+
+        ADD_NUMBER_FIELD(total_size);
+        ADD_NUMBER_FIELD(total_occupied);
+        qv_append(tab, LSTR("-"));
+        ADD_NUMBER_FIELD(total_nb_slabs);
+        ADD_NUMBER_FIELD(total_nb_large);
+
+        sb_add_table(&buf, &hdr, &rows);
+        sb_shrink(&buf, 1);
+        logger_notice(&_G.logger, "slab pools summary:\n%*pM",
+                      SB_FMT_ARG(&buf));
+    }
+#undef ADD_NUMBER_FIELD
+}
+
+static int core_mem_slab_initialize(void *arg)
+{
+    return 0;
+}
+
+static int core_mem_slab_shutdown(void)
+{
+    return 0;
+}
+
+MODULE_BEGIN(core_mem_slab)
+    MODULE_IMPLEMENTS_VOID(print_state, &core_mem_slab_print_state);
+MODULE_END()
+
+/* }}} */
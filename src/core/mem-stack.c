@@ -52,6 +52,80 @@ static struct {
     .all_pools = DLIST_INIT(_G.all_pools),
 };
 
+/* {{{ Frames telemetry */
+
+void mem_window_init(mem_window_t *w)
+{
+    p_clear(w, 1);
+    w->start = lp_getsec();
+}
+
+/* Number of slots started since the current one, bounded by the number of
+ * slots of the window. */
+static uint32_t mem_window_elapsed(const mem_window_t *w, time_t now)
+{
+    if (now <= w->start) {
+        return 0;
+    }
+    return MIN((now - w->start) / MEM_WINDOW_PERIOD, MEM_WINDOW_SLOTS);
+}
+
+static void mem_window_rotate(mem_window_t *w)
+{
+    time_t now = lp_getsec();
+    uint32_t elapsed = mem_window_elapsed(w, now);
+
+    if (likely(!elapsed)) {
+        return;
+    }
+    for (uint32_t i = 0; i < elapsed; i++) {
+        w->pos = (w->pos + 1) % MEM_WINDOW_SLOTS;
+        w->hwm[w->pos]   = 0;
+        w->churn[w->pos] = 0;
+    }
+    w->start = now - (now - w->start) % MEM_WINDOW_PERIOD;
+}
+
+void mem_window_update_hwm(mem_window_t *w, size_t used)
+{
+    mem_window_rotate(w);
+    w->hwm[w->pos] = MAX(w->hwm[w->pos], used);
+}
+
+void mem_window_add_churn(mem_window_t *w)
+{
+    mem_window_rotate(w);
+    w->churn[w->pos]++;
+}
+
+/* The readers do not rotate the window, as they may run on another thread
+ * than the one of the pool: the slots that are too old are skipped instead.
+ */
+size_t mem_window_hwm(const mem_window_t *w)
+{
+    uint32_t elapsed = mem_window_elapsed(w, lp_getsec());
+    size_t hwm = 0;
+
+    for (uint32_t i = 0; i + elapsed < MEM_WINDOW_SLOTS; i++) {
+        hwm = MAX(hwm, w->hwm[(w->pos + MEM_WINDOW_SLOTS - i)
+                              % MEM_WINDOW_SLOTS]);
+    }
+    return hwm;
+}
+
+uint32_t mem_window_churn(const mem_window_t *w)
+{
+    uint32_t elapsed = mem_window_elapsed(w, lp_getsec());
+    uint32_t churn = 0;
+
+    for (uint32_t i = 0; i + elapsed < MEM_WINDOW_SLOTS; i++) {
+        churn += w->churn[(w->pos + MEM_WINDOW_SLOTS - i) % MEM_WINDOW_SLOTS];
+    }
+    return churn;
+}
+
+/* }}} */
+
 static ALWAYS_INLINE size_t sp_alloc_mean(mem_stack_pool_t *sp)
 {
     return sp->alloc_sz / sp->alloc_nb;
@@ -62,25 +136,133 @@ static ALWAYS_INLINE mem_stack_blk_t *blk_entry(dlist_t *l)
     return container_of(l, mem_stack_blk_t, blk_list);
 }
 
+/* {{{ Decay of the destroyed blocks */
+
+int mem_decay_delay_g = 10;
+
+void mem_decay_set_delay(int delay)
+{
+    mem_decay_delay_g = MAX(delay, 0);
+}
+
+static void blk_release(mem_stack_blk_t *blk)
+{
+    mem_tool_allow_memory(blk, blk->size + sizeof(*blk), false);
+    if (blk->huge) {
+        mem_huge_unmap(blk, blk->size + sizeof(*blk));
+    } else {
+        ifree(blk, MEM_LIBC);
+    }
+}
+
+/* Keep a destroyed block for mem_decay_delay_g seconds, with its pages
+ * advised with MADV_FREE, so that the pool can take it back without mapping
+ * new memory if it needs it again. The header stays in its own page, which
+ * is not advised.
+ */
+static void blk_retain(mem_stack_pool_t *sp, mem_stack_blk_t *blk)
+{
+#ifdef MADV_FREE
+    uintptr_t start = ROUND_UP((uintptr_t)blk->area, PAGE_SIZE);
+    uintptr_t end   = ((uintptr_t)blk->area + blk->size) & ~(PAGE_SIZE - 1);
+
+    if (mem_decay_delay_g > 0) {
+        if (end > start) {
+            madvise((void *)start, end - start, MADV_FREE);
+        }
+        mem_tool_disallow_memory(blk->area, blk->size);
+        blk->freed = lp_getsec();
+        sp->retained_size += blk->size;
+        dlist_add_tail(&sp->retained_list, &blk->blk_list);
+        return;
+    }
+#endif
+    blk_release(blk);
+}
+
+/* Release the retained blocks older than the decay delay, or all of them. */
+static void sp_decay(mem_stack_pool_t *sp, bool all)
+{
+    time_t now;
+
+    if (likely(dlist_is_empty(&sp->retained_list))) {
+        return;
+    }
+    now = lp_getsec();
+    dlist_for_each_entry(mem_stack_blk_t, blk, &sp->retained_list, blk_list) {
+        if (!all && blk->freed + mem_decay_delay_g > now) {
+            break;
+        }
+        dlist_remove(&blk->blk_list);
+        sp->retained_size -= blk->size;
+        sp->decayed_size  += blk->size;
+        blk_release(blk);
+    }
+}
+
+/* Take back a retained block of at least blksize bytes (header included),
+ * but not too big so that huge blocks are not wasted on small needs. */
+static mem_stack_blk_t *sp_reuse_blk(mem_stack_pool_t *sp, size_t blksize)
+{
+    uint32_t node = mem_numa_current_node();
+
+    dlist_for_each_entry(mem_stack_blk_t, blk, &sp->retained_list, blk_list) {
+        size_t size = blk->size + sizeof(*blk);
+
+        if (size >= blksize && size <= 4 * blksize && blk->node == node) {
+            dlist_remove(&blk->blk_list);
+            sp->retained_size -= blk->size;
+            return blk;
+        }
+    }
+    return NULL;
+}
+
+/* }}} */
+
 __cold
 static mem_stack_blk_t *blk_create(mem_stack_pool_t *sp,
                                    mem_stack_blk_t *cur, size_t size_hint)
 {
     size_t blksize = size_hint + sizeof(mem_stack_blk_t);
     size_t alloc_target = MIN(100U << 20, ALLOC_MIN * sp_alloc_mean(sp));
-    mem_stack_blk_t *blk;
+    mem_stack_blk_t *blk = NULL;
 
     if (blksize < sp->minsize)
         blksize = sp->minsize;
     if (blksize < alloc_target)
         blksize = alloc_target;
     blksize = ROUND_UP(blksize, PAGE_SIZE);
-    blk = imalloc(blksize, 0, MEM_RAW | MEM_LIBC);
-    blk->size      = blksize - sizeof(*blk);
-    dlist_add_after(&cur->blk_list, &blk->blk_list);
+
+    sp_decay(sp, false);
+    if ((blk = sp_reuse_blk(sp, blksize))) {
+        dlist_add_after(&cur->blk_list, &blk->blk_list);
+    } else {
+        if ((sp->flags & MEM_POOL_HUGE_PAGES)
+        &&  blksize >= MEM_HUGE_PAGE_SIZE)
+        {
+            blksize = ROUND_UP(blksize, MEM_HUGE_PAGE_SIZE);
+            blk = mem_huge_map(blksize);
+        }
+        if (blk) {
+            blk->huge  = true;
+        } else {
+            blk = imalloc(blksize, 0, MEM_RAW | MEM_LIBC);
+            blk->huge  = false;
+        }
+        blk->size      = blksize - sizeof(*blk);
+        blk->node      = mem_numa_current_node();
+        dlist_add_after(&cur->blk_list, &blk->blk_list);
+        mem_numa_bind(blk, blksize, blk->node);
+    }
 
     sp->stacksize += blk->size;
+    sp->node_stacksize[blk->node] += blk->size;
+    if (blk->huge) {
+        sp->huge_stacksize += blk->size;
+    }
     sp->nb_blocks++;
+    mem_window_add_churn(&sp->window);
 
 #ifdef MEM_BENCH
     sp->mem_bench->malloc_calls++;
@@ -108,11 +290,33 @@ static void blk_destroy(mem_stack_pool_t *sp, mem_stack_blk_t *blk)
 #endif
 
     sp->stacksize -= blk->size;
+    sp->node_stacksize[blk->node] -= blk->size;
     sp->nb_blocks--;
+    mem_window_add_churn(&sp->window);
+
+    if (blk->huge) {
+        sp->huge_stacksize -= blk->size;
+    }
 
     dlist_remove(&blk->blk_list);
-    mem_tool_allow_memory(blk, blk->size + sizeof(*blk), false);
-    ifree(blk, MEM_LIBC);
+    blk_retain(sp, blk);
+}
+
+/* Size of the blocks up to (and including) the given one. */
+static size_t sp_blocks_size_upto(mem_stack_pool_t *sp, mem_stack_blk_t *cur)
+{
+    size_t size = 0;
+
+    if (&cur->blk_list == &sp->blk_list) {
+        return 0;
+    }
+    dlist_for_each_entry(mem_stack_blk_t, blk, &sp->blk_list, blk_list) {
+        size += blk->size;
+        if (blk == cur) {
+            break;
+        }
+    }
+    return size;
 }
 
 static ALWAYS_INLINE mem_stack_blk_t *
@@ -120,11 +324,17 @@ frame_get_next_blk(mem_stack_pool_t *sp, mem_stack_blk_t *cur, size_t alignment,
                    size_t size)
 {
     size_t deleted_size = 0;
+    size_t used = sp_blocks_size_upto(sp, cur);
+    size_t hwm;
 
 #ifdef MEM_BENCH
     sp->mem_bench->alloc.nb_slow_path++;
 #endif
 
+    /* the frames need at least the blocks up to the current one, plus the
+     * new allocation */
+    mem_window_update_hwm(&sp->window, used + size);
+
     dlist_for_each_entry_after(cur, blk, &sp->blk_list, blk_list) {
         size_t needed_size = size;
         uint8_t *aligned_area;
@@ -151,6 +361,13 @@ frame_get_next_blk(mem_stack_pool_t *sp, mem_stack_blk_t *cur, size_t alignment,
          */
         size += alignment;
     }
+
+    /* make the new block big enough to reach the recent high-water mark, so
+     * that the next bursts fit in the blocks we already have */
+    hwm = MIN(100U << 20, mem_window_hwm(&sp->window));
+    if (hwm > used + size) {
+        size = hwm - used;
+    }
     return blk_create(sp, cur, size);
 }
 
@@ -471,8 +688,9 @@ static mem_pool_t const pool_funcs_libc = {
 };
 #endif
 
-mem_stack_pool_t *mem_stack_pool_init(mem_stack_pool_t *sp, const char *name,
-                                      int initialsize)
+mem_stack_pool_t *mem_stack_pool_init_flags(mem_stack_pool_t *sp,
+                                            const char *name,
+                                            int initialsize, unsigned flags)
 {
     /* no p_clear is made for two reasons :
      * - there is few objects that shall be zero-initialized
@@ -501,9 +719,16 @@ mem_stack_pool_t *mem_stack_pool_init(mem_stack_pool_t *sp, const char *name,
     if (initialsize <= 0)
         initialsize = 640 << 10;
     sp->minsize   = ROUND_UP(initialsize, PAGE_SIZE);
+    sp->flags     = flags;
 
     sp->stacksize = 0;
     sp->nb_blocks = 0;
+    sp->huge_stacksize = 0;
+    p_clear(&sp->node_stacksize, 1);
+    mem_window_init(&sp->window);
+    dlist_init(&sp->retained_list);
+    sp->retained_size = 0;
+    sp->decayed_size  = 0;
 
 #ifndef NDEBUG
     /* bypass mem_pool if demanded
@@ -522,6 +747,7 @@ mem_stack_pool_t *mem_stack_pool_init(mem_stack_pool_t *sp, const char *name,
 #endif
 
     sp->name = p_strdup(name);
+    sp->funcs.name = sp->name;
     sp->pthread_id = pthread_self();
 
     spin_lock(&_G.all_pools_lock);
@@ -531,17 +757,46 @@ mem_stack_pool_t *mem_stack_pool_init(mem_stack_pool_t *sp, const char *name,
     return sp;
 }
 
+/* Keep the first blocks, up to the high-water mark of the frames over the
+ * window, and destroy the others.
+ */
+static void mem_stack_pool_reset_to_hwm(mem_stack_pool_t *sp, size_t hwm)
+{
+    size_t kept = 0;
+
+    dlist_for_each(e, &sp->blk_list) {
+        mem_stack_blk_t *blk = blk_entry(e);
+
+        if (kept < hwm) {
+            kept += blk->size;
+        } else {
+            blk_destroy(sp, blk);
+        }
+    }
+}
+
 void mem_stack_pool_reset(mem_stack_pool_t *sp)
 {
     mem_stack_blk_t *saved_blk;
     size_t saved_size;
     size_t max_size;
+    size_t hwm;
 
     /* bypass mem_pool if demanded */
     if (!mem_pool_is_enabled()) {
         return;
     }
 
+    /* when the frames recently needed more than one block, keep what they
+     * needed rather than unmapping it to map it again on the next burst */
+    sp->last_reset = lp_getsec();
+    hwm = mem_window_hwm(&sp->window);
+    if (hwm) {
+        mem_stack_pool_reset_to_hwm(sp, hwm);
+        frame_set_blk(&sp->base, blk_entry(sp->blk_list.next));
+        return;
+    }
+
     /* we do not want to wipe everything :
      * we will keep one block, iff
      * its size is more than 56*alloc_mean
@@ -549,7 +804,6 @@ void mem_stack_pool_reset(mem_stack_pool_t *sp)
      * and less than 256*alloc_mean.
      * we keep the biggest in this range.
      */
-    sp->last_reset = lp_getsec();
     saved_blk  = NULL;
     saved_size = RESET_MIN * sp_alloc_mean(sp);
     max_size   = RESET_MAX * sp_alloc_mean(sp);
@@ -584,6 +838,8 @@ void mem_stack_pool_try_reset(mem_stack_pool_t *sp)
         return;
     }
 
+    sp_decay(sp, false);
+
     /* Do not reset small stacks (10 MiB on the main thread, 1 MiB on the
      * others). */
     if (thr_is_on_queue(thr_queue_main_g)) {
@@ -613,6 +869,7 @@ void mem_stack_pool_wipe(mem_stack_pool_t *sp)
     spin_unlock(&_G.all_pools_lock);
 
     p_delete(&sp->name);
+    sp->funcs.name = NULL;
 
 #ifdef MEM_BENCH
     mem_bench_delete(&sp->mem_bench);
@@ -623,6 +880,7 @@ void mem_stack_pool_wipe(mem_stack_pool_t *sp)
     dlist_for_each(e, &sp->blk_list) {
         blk_destroy(sp, blk_entry(e));
     }
+    sp_decay(sp, true);
     assert (sp->stacksize == 0);
 }
 
@@ -661,6 +919,38 @@ const void *mem_stack_pool_push(mem_stack_pool_t *sp)
     return sp->stack = frame;
 }
 
+void mem_stack_pool_rewind(mem_stack_pool_t *sp,
+                           const mem_stack_checkpoint_t *cp)
+{
+    mem_stack_frame_t *frame = sp->stack;
+#ifndef NDEBUG
+    mem_stack_frame_t up_to;
+#endif
+
+    if (unlikely(frame != cp->frame)) {
+        e_panic("rewinding a checkpoint of another stack frame");
+    }
+
+#ifndef NDEBUG
+    /* bypass mem_pool if demanded */
+    if (!mem_pool_is_enabled()) {
+        dlist_for_each_entry_after(cp->blk, blk, &sp->blk_list, blk_list) {
+            uint8_t *ptr = (uint8_t *)(blk + 1) - blk->size;
+
+            dlist_remove(&blk->blk_list);
+            mp_ifree(&mem_pool_libc, ptr);
+        }
+        return;
+    }
+    up_to = *frame;
+#endif
+
+    frame_set_blk(frame, cp->blk);
+    frame->pos  = cp->pos;
+    frame->last = cp->last;
+    mem_stack_pool_protect(sp, &up_to);
+}
+
 #ifdef MEM_BENCH
 void mem_stack_bench_pop(mem_stack_pool_t *sp, mem_stack_frame_t * frame)
 {
@@ -707,20 +997,40 @@ void mem_stack_print_stats(const mem_pool_t *mp) {
 }
 
 void mem_stack_print_pools_stats(void) {
-#ifdef MEM_BENCH
     /* bypass mem_pool if demanded */
     if (!mem_pool_is_enabled()) {
         return;
     }
 
     spin_lock(&_G.all_pools_lock);
-    dlist_for_each(n, &_G.all_pools) {
-        mem_stack_pool_t *mp = mem_stack_get_pool(n);
+    dlist_for_each_entry(mem_stack_pool_t, sp, &_G.all_pools, pool_list) {
+        if (sp->huge_stacksize) {
+            logger_notice(&_G.logger, "stack pool %s: %zu bytes out of %zu "
+                          "in huge pages", sp->name, sp->huge_stacksize,
+                          sp->stacksize);
+        }
+#ifdef MEM_BENCH
+        mem_bench_print_human(sp->mem_bench, MEM_BENCH_PRINT_CURRENT);
+#endif
+    }
+    spin_unlock(&_G.all_pools_lock);
+}
 
-        mem_bench_print_human(mp->mem_bench, MEM_BENCH_PRINT_CURRENT);
+void mem_stack_pools_window_stats(mem_pool_window_cb_f *cb, void *data)
+{
+    spin_lock(&_G.all_pools_lock);
+    dlist_for_each_entry(mem_stack_pool_t, sp, &_G.all_pools, pool_list) {
+        mem_pool_window_stats_t stats = {
+            .name  = sp->name,
+            .pool  = sp,
+            .size  = sp->stacksize,
+            .hwm   = mem_window_hwm(&sp->window),
+            .churn = mem_window_churn(&sp->window),
+        };
+
+        (*cb)(&stats, data);
     }
     spin_unlock(&_G.all_pools_lock);
-#endif
 }
 
 #ifndef NDEBUG
@@ -748,18 +1058,20 @@ void mem_stack_pool_protect(mem_stack_pool_t *sp, const mem_stack_frame_t *up_to
 #endif
 
 static inline mem_stack_pool_t *mem_stack_pool_new(const char *name,
-                                                   int initialsize)
+                                                   int initialsize,
+                                                   unsigned flags)
 {
     mem_stack_pool_t *sp = p_new_raw(mem_stack_pool_t, 1);
 
-    mem_stack_pool_init(sp, name, initialsize);
+    mem_stack_pool_init_flags(sp, name, initialsize, flags);
 
     return sp;
 }
 
-mem_pool_t *mem_stack_new(const char *name, int initialsize)
+mem_pool_t *mem_stack_new_flags(const char *name, int initialsize,
+                                unsigned flags)
 {
-    mem_stack_pool_t *pool = mem_stack_pool_new(name, initialsize);
+    mem_stack_pool_t *pool = mem_stack_pool_new(name, initialsize, flags);
 
     return &pool->funcs;
 }
@@ -810,6 +1122,23 @@ static void mem_stack_all_pools_init_at_fork(void)
 
 /* {{{ Module (for print_state method) */
 
+static lstr_t t_mem_numa_fmt_nodes(const size_t sizes[MEM_NUMA_NODES_MAX])
+{
+    SB_1k(buf);
+
+    if (!mem_numa_is_enabled()) {
+        return LSTR("-");
+    }
+    for (int i = 0; i < mem_numa_nodes_count(); i++) {
+        if (buf.len) {
+            sb_addc(&buf, ' ');
+        }
+        sb_addf(&buf, "%d:", i);
+        sb_add_int_fmt(&buf, sizes[i], ',');
+    }
+    return t_lstr_dup(LSTR_SB_V(&buf));
+}
+
 static void core_mem_stack_print_state(void)
 {
     t_scope;
@@ -821,6 +1150,8 @@ static void core_mem_stack_print_state(void)
             .title = LSTR_IMMED("POINTER"),
         }, {
             .title = LSTR_IMMED("SIZE"),
+        }, {
+            .title = LSTR_IMMED("HUGE SIZE"),
         }, {
             .title = LSTR_IMMED("NB BLOCKS"),
         }, {
@@ -831,13 +1162,29 @@ static void core_mem_stack_print_state(void)
             .title = LSTR_IMMED("ALLOC MEAN"),
         }, {
             .title = LSTR_IMMED("LAST RESET"),
+        }, {
+            .title = LSTR_IMMED("FRAME HWM"),
+        }, {
+            .title = LSTR_IMMED("CHURN"),
+        }, {
+            .title = LSTR_IMMED("RETAINED"),
+        }, {
+            .title = LSTR_IMMED("DECAYED"),
+        }, {
+            .title = LSTR_IMMED("SIZE PER NODE"),
         }
     };
     uint32_t hdr_size = countof(hdr_data);
     size_t   total_stacksize = 0;
+    size_t   total_huge_size = 0;
     uint32_t total_nb_blocks = 0;
     size_t   total_alloc_sz = 0;
     uint32_t total_alloc_nb = 0;
+    size_t   total_hwm = 0;
+    uint32_t total_churn = 0;
+    size_t   total_retained = 0;
+    size_t   total_decayed = 0;
+    size_t   total_node_stacksize[MEM_NUMA_NODES_MAX] = { 0 };
     int nb_stack_pool = 0;
 
     qv_init_static(&hdr, hdr_data, hdr_size);
@@ -861,18 +1208,32 @@ static void core_mem_stack_print_state(void)
         qv_append(tab, t_lstr_fmt("%p", sp));
 
         ADD_NUMBER_FIELD(sp->stacksize);
+        ADD_NUMBER_FIELD(sp->huge_stacksize);
         ADD_NUMBER_FIELD(sp->nb_blocks);
         ADD_NUMBER_FIELD(sp->alloc_sz);
         ADD_NUMBER_FIELD(sp->alloc_nb);
         ADD_NUMBER_FIELD(sp_alloc_mean(sp));
 
         qv_append(tab, t_lstr_fmt("%jd", sp->last_reset));
+        ADD_NUMBER_FIELD(mem_window_hwm(&sp->window));
+        ADD_NUMBER_FIELD(mem_window_churn(&sp->window));
+        ADD_NUMBER_FIELD(sp->retained_size);
+        ADD_NUMBER_FIELD(sp->decayed_size);
+        qv_append(tab, t_mem_numa_fmt_nodes(sp->node_stacksize));
 
         nb_stack_pool++;
         total_stacksize += sp->stacksize;
+        total_huge_size += sp->huge_stacksize;
         total_nb_blocks += sp->nb_blocks;
         total_alloc_sz  += sp->alloc_sz;
         total_alloc_nb  += sp->alloc_nb;
+        total_hwm       += mem_window_hwm(&sp->window);
+        total_churn     += mem_window_churn(&sp->window);
+        total_retained  += sp->retained_size;
+        total_decayed   += sp->decayed_size;
+        for (int i = 0; i < MEM_NUMA_NODES_MAX; i++) {
+            total_node_stacksize[i] += sp->node_stacksize[i];
+        }
     }
 
     spin_unlock(&_G.all_pools_lock);
@@ -886,11 +1247,17 @@ static void core_mem_stack_print_state(void)
         qv_append(tab, LSTR("-"));
 
         ADD_NUMBER_FIELD(total_stacksize);
+        ADD_NUMBER_FIELD(total_huge_size);
         ADD_NUMBER_FIELD(total_nb_blocks);
         ADD_NUMBER_FIELD(total_alloc_sz);
         ADD_NUMBER_FIELD(total_alloc_nb);
         ADD_NUMBER_FIELD(total_alloc_sz / total_alloc_nb);
         qv_append(tab, LSTR("-"));
+        ADD_NUMBER_FIELD(total_hwm);
+        ADD_NUMBER_FIELD(total_churn);
+        ADD_NUMBER_FIELD(total_retained);
+        ADD_NUMBER_FIELD(total_decayed);
+        qv_append(tab, t_mem_numa_fmt_nodes(total_node_stacksize));
 
         sb_add_table(&buf, &hdr, &rows);
         sb_shrink(&buf, 1);
@@ -93,6 +93,9 @@ struct mem_bench_t;
 typedef struct mem_stack_blk_t {
     size_t      size;
     dlist_t     blk_list;
+    uint32_t    node : 31;  /*< NUMA node the block is bound to */
+    bool        huge :  1;  /*< block mapped with mem_huge_map() */
+    time_t      freed;      /*< when it was retained, see sp_decay() */
     uint8_t     area[];
 } mem_stack_blk_t;
 
@@ -114,7 +117,7 @@ typedef struct mem_stack_pool_t {
     size_t               alloc_sz;       /*<  8  (8) : alloc */
     uint32_t             alloc_nb;       /*< 16  (4) : alloc */
     uint32_t             padding;        /*< 20  (4) : never */
-    mem_pool_t           funcs;          /*< 24 (40) : mp_* functions */
+    mem_pool_t           funcs;          /*< 24 (48) : mp_* functions */
 
     /* ---- cache line boundary (offset 64) ---- */
 
@@ -124,10 +127,20 @@ typedef struct mem_stack_pool_t {
 
     mem_stack_frame_t    base;      /*< never */
     uint32_t             minsize;   /*< blk_create */
+    unsigned             flags;     /*< blk_create */
 
     size_t               stacksize;  /*< blk_create / blk_destroy */
     uint32_t             nb_blocks;  /*< blk_create / blk_destroy */
+    size_t               huge_stacksize; /*< blk_create / blk_destroy */
+    /* per NUMA node stacksize, see mem_numa_enable() */
+    size_t               node_stacksize[MEM_NUMA_NODES_MAX];
     time_t               last_reset; /*< mem_stack_pool_(check_)reset */
+    /* frames high-water mark and blocks churn, see mem_window_t */
+    mem_window_t         window;     /*< frame_get_next_blk / blk_create */
+    /* destroyed blocks waiting for the decay delay, oldest first */
+    dlist_t              retained_list; /*< blk_create / blk_destroy */
+    size_t               retained_size; /*< blk_create / blk_destroy */
+    size_t               decayed_size;  /*< sp_decay */
 
     dlist_t        pool_list;
     char * nonnull name;
@@ -139,14 +152,33 @@ typedef struct mem_stack_pool_t {
 #endif
 } mem_stack_pool_t;
 
+/** Initialize a stack pool.
+ *
+ * \param[flags]  Bitfield of mem_pool_create_flags.
+ */
 mem_stack_pool_t * nonnull
-mem_stack_pool_init(mem_stack_pool_t * nonnull, const char * nonnull name,
-                    int initialsize) __leaf;
+mem_stack_pool_init_flags(mem_stack_pool_t * nonnull, const char * nonnull name,
+                          int initialsize, unsigned flags) __leaf;
+
+static inline mem_stack_pool_t * nonnull
+mem_stack_pool_init(mem_stack_pool_t * nonnull sp, const char * nonnull name,
+                    int initialsize)
+{
+    return mem_stack_pool_init_flags(sp, name, initialsize, 0);
+}
+
 void mem_stack_pool_reset(mem_stack_pool_t * nonnull) __leaf;
 void mem_stack_pool_try_reset(mem_stack_pool_t * nonnull) __leaf;
 void mem_stack_pool_wipe(mem_stack_pool_t * nonnull) __leaf;
 
-mem_pool_t *nonnull mem_stack_new(const char *nonnull name, int initialsize);
+mem_pool_t *nonnull mem_stack_new_flags(const char *nonnull name,
+                                        int initialsize, unsigned flags);
+
+static inline
+mem_pool_t *nonnull mem_stack_new(const char *nonnull name, int initialsize)
+{
+    return mem_stack_new_flags(name, initialsize, 0);
+}
 void mem_stack_delete(mem_pool_t *nonnull *nullable mp);
 
 static inline
@@ -231,6 +263,54 @@ static inline const void *nonnull mem_stack_push(mem_pool_t *nonnull mp)
     return mem_stack_pool_push(mem_stack_get_pool(mp));
 }
 
+/*
+ * Checkpoints allow to roll back a part of the current frame: everything
+ * that has been allocated in the frame since the checkpoint is freed by
+ * mem_stack_pool_rewind(), while the allocations done before are kept.
+ *
+ * This is meant for speculative allocations, e.g. trying to unpack a value,
+ * and unpacking it another way if it fails:
+ *
+ *     mem_stack_checkpoint_t cp = t_checkpoint();
+ *
+ *     if (iop_bunpack(t_pool(), st, v, ps, false) < 0) {
+ *         t_rewind(&cp);
+ *         ...
+ *     }
+ *
+ * A checkpoint can only be rewound in the frame where it was taken, and any
+ * frame pushed after it must have been popped. It can be rewound several
+ * times.
+ */
+typedef struct mem_stack_checkpoint_t {
+    const mem_stack_frame_t * nonnull frame;
+    mem_stack_blk_t         * nonnull blk;
+    uint8_t                 * nullable pos;
+    uint8_t                 * nullable last;
+} mem_stack_checkpoint_t;
+
+static ALWAYS_INLINE mem_stack_checkpoint_t
+mem_stack_pool_checkpoint(mem_stack_pool_t * nonnull sp)
+{
+    const mem_stack_frame_t *frame = sp->stack;
+    mem_stack_checkpoint_t cp;
+
+    cp.frame = frame;
+    cp.blk   = frame->blk;
+    cp.pos   = frame->pos;
+    cp.last  = frame->last;
+#ifndef NDEBUG
+    /* bypass mem_pool if demanded: the blocks are the allocations */
+    if (!mem_pool_is_enabled()) {
+        cp.blk = container_of(sp->blk_list.prev, mem_stack_blk_t, blk_list);
+    }
+#endif
+    return cp;
+}
+
+void mem_stack_pool_rewind(mem_stack_pool_t * nonnull sp,
+                           const mem_stack_checkpoint_t * nonnull cp);
+
 extern __thread mem_stack_pool_t t_pool_g;
 
 static ALWAYS_INLINE mem_pool_t * nonnull t_pool(void)
@@ -246,6 +326,9 @@ static ALWAYS_INLINE mem_stack_pool_t * nonnull t_stack_pool(void)
 #define t_seal()      mem_stack_pool_seal(&t_pool_g)
 #define t_unseal()    mem_stack_pool_unseal(&t_pool_g)
 
+#define t_checkpoint()  mem_stack_pool_checkpoint(&t_pool_g)
+#define t_rewind(cp)    mem_stack_pool_rewind(&t_pool_g, (cp))
+
 #define t_fmt(fmt, ...)  mp_fmt(t_pool(), NULL, fmt, ##__VA_ARGS__)
 
 /* Aligned pointers allocation helpers */
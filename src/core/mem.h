@@ -277,6 +277,9 @@ typedef struct mem_pool_t {
     uint32_t    min_alignment;
     struct mem_pool_t * nullable realloc_fallback;
 
+    /* name of the pool, used by the allocation profiler */
+    const char * nullable name;
+
     /* DO NOT USE DIRECTLY, use mp_imalloc/mp_irealloc/mp_ifree instead */
     void * nonnull (* nonnull malloc)(struct mem_pool_t * nonnull, size_t,
                                       size_t, mem_flags_t);
@@ -679,9 +682,247 @@ void core_mem_set_malloc_trim_pad(size_t pad);
 /** Manually call malloc trim. */
 void core_mem_malloc_trim(void);
 
+/* }}} */
+/* NUMA {{{ */
+
+/* Maximum number of NUMA nodes supported by the NUMA mode. */
+#define MEM_NUMA_NODES_MAX  8
+
+/** Enable or disable the NUMA mode.
+ *
+ * When enabled, the qpage allocator keeps one arena per NUMA node, and the
+ * stack and ring pools bind their new blocks to the node of the calling
+ * thread, so that hot paths allocating in t_pool() or r_pool() get
+ * node-local memory. The pools also account their footprint per node.
+ *
+ * This is meant to be called once at startup, before spawning threads.
+ *
+ * \return -1 with errno set to ENOTSUP if the host has only one node (or
+ *         more than MEM_NUMA_NODES_MAX nodes), 0 otherwise.
+ */
+int mem_numa_enable(bool enable);
+
+/** Whether the NUMA mode is enabled. */
+bool mem_numa_is_enabled(void);
+
+/** Number of NUMA nodes, 1 if the NUMA mode is disabled. */
+int mem_numa_nodes_count(void);
+
+/** Node of the CPU the calling thread runs on, 0 if the NUMA mode is
+ * disabled.
+ */
+int mem_numa_current_node(void);
+
+/** Set a preferred node policy on the pages fully contained in the given
+ * memory area. No-op if the NUMA mode is disabled.
+ */
+void mem_numa_bind(void * nonnull mem, size_t size, int node);
+
+/* }}} */
+/* Allocation profiler {{{ */
+
+/** Start sampling the allocations.
+ *
+ * One allocation out of \p period done through mp_imalloc() (whatever the
+ * pool) is sampled: its size, the name of its pool and its backtrace are
+ * recorded in a bounded buffer of the allocating thread, the oldest samples
+ * being dropped.
+ *
+ * The profiler can also be started at startup with the MEM_PROF_PERIOD
+ * environment variable.
+ */
+void mem_prof_start(unsigned period);
+
+/** Stop sampling the allocations, the samples are kept. */
+void mem_prof_stop(void);
+
+/** Drop all the samples. */
+void mem_prof_reset(void);
+
+/** Dump the samples as collapsed stacks.
+ *
+ * Each line is a `;` separated list of frames, beginning with the name of the
+ * memory pool and ending with the allocating function, followed by the
+ * estimated amount of bytes allocated from this stack (the sampled sizes
+ * times the sampling period). This is the input format of flamegraph.pl, and
+ * can be converted for pprof.
+ */
+struct sb_t;
+void mem_prof_dump_collapsed(struct sb_t * nonnull out);
+
+/* private */
+extern unsigned mem_prof_period_g;
+void mem_prof_sample(const mem_pool_t * nonnull mp, size_t size);
+
+/* }}} */
+/* Frame pools telemetry {{{ */
+
+/* The stack and ring pools track, over a sliding window of
+ * MEM_WINDOW_SLOTS * MEM_WINDOW_PERIOD seconds, the high-water mark of the
+ * memory used by their frames and the number of blocks they created and
+ * destroyed (the churn).
+ *
+ * The pools use it to size their new blocks and to choose the blocks they
+ * keep when they are reset, so that a pool that regularly needs a given
+ * amount of memory keeps it instead of unmapping and mapping it again.
+ */
+
+#define MEM_WINDOW_PERIOD  10
+#define MEM_WINDOW_SLOTS    6
+
+typedef struct mem_window_t {
+    time_t   start; /*< start of the current slot */
+    uint32_t pos;   /*< index of the current slot */
+    size_t   hwm[MEM_WINDOW_SLOTS];
+    uint32_t churn[MEM_WINDOW_SLOTS];
+} mem_window_t;
+
+void mem_window_init(mem_window_t * nonnull w);
+void mem_window_update_hwm(mem_window_t * nonnull w, size_t used);
+void mem_window_add_churn(mem_window_t * nonnull w);
+
+/** High-water mark of the window, 0 if nothing was recorded. */
+size_t mem_window_hwm(const mem_window_t * nonnull w);
+
+/** Number of blocks created and destroyed during the window. */
+uint32_t mem_window_churn(const mem_window_t * nonnull w);
+
+typedef struct mem_pool_window_stats_t {
+    const char * nonnull name;
+    const void * nonnull pool;
+    size_t   size;  /*< size of the blocks of the pool */
+    size_t   hwm;   /*< see mem_window_hwm() */
+    uint32_t churn; /*< see mem_window_churn() */
+} mem_pool_window_stats_t;
+
+typedef void (mem_pool_window_cb_f)(const mem_pool_window_stats_t * nonnull,
+                                    void * nullable data);
+
+/** Call \p cb on the telemetry of every stack pool.
+ *
+ * The callback is called with the lock of the list of pools held, so it must
+ * not create or destroy any stack pool.
+ */
+void mem_stack_pools_window_stats(mem_pool_window_cb_f * nonnull cb,
+                                  void * nullable data);
+
+/** Call \p cb on the telemetry of every ring pool.
+ *
+ * Same as mem_stack_pools_window_stats() for the ring pools.
+ */
+void mem_ring_pools_window_stats(mem_pool_window_cb_f * nonnull cb,
+                                 void * nullable data);
+
+/* }}} */
+/* Footprint of the tracked objects {{{ */
+
+/* The long-lived objects of an application (caches, indexes, ...) can be
+ * tracked by name so that their memory footprint, as computed by the
+ * *_memory_footprint() helpers of the containers or by
+ * iop_memory_footprint(), is exported by the prometheus client.
+ */
+
+#ifdef __has_blocks
+typedef size_t (BLOCK_CARET mem_footprint_b)(void);
+
+/** Track the memory footprint of an object.
+ *
+ * \p blk is called each time the footprints are collected, from the thread
+ * of the event loop for the prometheus scrapes, so it must be cheap.
+ *
+ * Tracking an already tracked \p name replaces its block.
+ */
+void mem_footprint_track(const char * nonnull name,
+                         mem_footprint_b nonnull blk);
+#endif
+
+/** Stop tracking the object tracked as \p name, if any. */
+void mem_footprint_untrack(const char * nonnull name);
+
+typedef void (mem_footprint_cb_f)(const char * nonnull name, size_t size,
+                                  void * nullable data);
+
+/** Call \p cb on the footprint of every tracked object.
+ *
+ * The callback is called with the lock of the registry held, so it must
+ * not track or untrack any object.
+ */
+void mem_footprints_get(mem_footprint_cb_f * nonnull cb,
+                        void * nullable data);
+
+/* }}} */
+/* Memory decay {{{ */
+
+/** Set the delay before the free memory is given back to the system.
+ *
+ * The free pages of qpage and the blocks destroyed by the stack pools are
+ * first advised with MADV_FREE, so that they stay mapped and are cheap to
+ * reuse while the system can still reclaim them under memory pressure. They
+ * are only released (madvise(MADV_DONTNEED) for qpage, unmapped for the
+ * stack pools) once they stayed unused for \p delay seconds.
+ *
+ * \param[in] delay  the delay in seconds (10 by default), 0 to release the
+ *                   memory right away as it was done before.
+ */
+void mem_decay_set_delay(int delay);
+
+/* private */
+extern int mem_decay_delay_g;
+
+/* }}} */
+/* Huge pages {{{ */
+
+#define MEM_HUGE_PAGE_SIZE  (2UL << 20)
+
+/** Flags for the creation of the stack and ring pools. */
+enum mem_pool_create_flags {
+    /** Back the blocks of at least MEM_HUGE_PAGE_SIZE bytes with huge pages.
+     *
+     * Those blocks are rounded and aligned to MEM_HUGE_PAGE_SIZE, and mapped
+     * from hugetlbfs if some huge pages are reserved, or else with
+     * transparent huge pages (see mem_huge_map()). This reduces the dTLB
+     * pressure of pools that grow to several megabytes.
+     */
+    MEM_POOL_HUGE_PAGES = 1 << 0,
+};
+
+/** Map an area backed by huge pages.
+ *
+ * \param[in] size  size of the area, multiple of MEM_HUGE_PAGE_SIZE.
+ * \return an area aligned on MEM_HUGE_PAGE_SIZE, NULL on error.
+ */
+void * nullable mem_huge_map(size_t size);
+
+/** Unmap an area returned by mem_huge_map(). */
+void mem_huge_unmap(void * nonnull mem, size_t size);
+
+/* }}} */
+/* Mremap pool {{{ */
+
+/** Pool of anonymous mappings, grown with mremap().
+ *
+ * Every block is its own mapping, so that a reallocation moves the pages
+ * instead of copying the data, and a block of several hundreds of megabytes
+ * does not need twice its size while it grows. The memory is always zeroed.
+ *
+ * The libc-backed qv_t and sb_t buffers move to this pool when they grow
+ * beyond MEM_MREMAP_THRESHOLD bytes (see qv_reserve_huge()), and go back to
+ * the libc once they are reset.
+ */
+extern mem_pool_t mem_pool_mremap;
+
+#define MEM_MREMAP_THRESHOLD  (1U << 20)
+
 /* }}} */
 /* Mem-fifo Pool {{{ */
 
+/** Create a new memory fifo-pool.
+ *
+ * The allocations must be done by the thread that created the pool, but the
+ * blocks can be freed from any thread: the blocks freed by the other threads
+ * are queued without taking any lock, and actually released by the owner
+ * thread on its next allocation.
+ */
 mem_pool_t * nonnull mem_fifo_pool_new(const char * nonnull name,
                                        int page_size_hint)
     __leaf __attribute__((malloc));
@@ -694,6 +935,51 @@ void mem_fifo_pool_stats(mem_pool_t * nonnull mp, ssize_t * nonnull allocated,
 void mem_fifo_pool_print_stats(mem_pool_t * nonnull mp);
 void mem_fifo_pools_print_stats(void);
 
+/* }}} */
+/* Mem-slab Pool {{{ */
+
+#define MEM_SLAB_CLASSES   28
+#define MEM_SLAB_MAX_SIZE  4096
+
+/** Create a new memory slab-pool.
+ *
+ * The slab-pool is suited for many long-lived objects of the same few sizes
+ * that are freed in random order. The allocations are rounded up to a size
+ * class and served from per-class slabs, with per-thread caches of free
+ * objects so that the common path does not take any lock. The pool can be
+ * used from any thread, and an object can be freed from another thread than
+ * the one that allocated it.
+ *
+ * Allocations bigger than \p max_size are served by the pool as well, but
+ * are much less efficient.
+ *
+ * \param[in] name      the name of the pool, used in the statistics.
+ * \param[in] max_size  the biggest size class of the pool, 0 (or anything
+ *                      above MEM_SLAB_MAX_SIZE) for MEM_SLAB_MAX_SIZE.
+ */
+mem_pool_t * nonnull mem_slab_pool_new(const char * nonnull name,
+                                       size_t max_size)
+    __leaf __attribute__((malloc));
+
+/** Delete a slab-pool.
+ *
+ * All the memory of the pool is released, including the objects that were
+ * not freed yet. The pool must not be used concurrently by other threads.
+ */
+void mem_slab_pool_delete(mem_pool_t * nullable * nonnull poolp)
+    __leaf;
+
+/** Get the statistics of a slab-pool.
+ *
+ * The objects cached in the per-thread caches are accounted as used.
+ */
+void mem_slab_pool_stats(mem_pool_t * nonnull mp, ssize_t * nonnull allocated,
+                         ssize_t * nonnull used)
+    __leaf;
+
+void mem_slab_pool_print_stats(mem_pool_t * nonnull mp);
+void mem_slab_pools_print_stats(void);
+
 /* }}} */
 /* Mem-ring Pool {{{ */
 
@@ -707,8 +993,17 @@ void mem_fifo_pools_print_stats(void);
  *
  * \param[name]         Name of the ring pool, used for debug.
  * \param[initialsize]  First memory block size.
+ * \param[flags]        Bitfield of mem_pool_create_flags.
  */
-mem_pool_t * nonnull mem_ring_new(const char * nonnull name, int initialsize);
+mem_pool_t * nonnull mem_ring_new_flags(const char * nonnull name,
+                                        int initialsize, unsigned flags);
+
+/** Create a new memory ring-pool with no mem_pool_create_flags. */
+static inline mem_pool_t * nonnull
+mem_ring_new(const char * nonnull name, int initialsize)
+{
+    return mem_ring_new_flags(name, initialsize, 0);
+}
 
 /** Delete the given memory ring-pool */
 void mem_ring_delete(mem_pool_t * nullable * nonnull) __leaf;
@@ -718,7 +1013,9 @@ void mem_ring_delete(mem_pool_t * nullable * nonnull) __leaf;
  * Adapted from mem_stack_pool_reset().
  *
  * Only keeps the current frame so as the one that fits the best the current
- * needs regarding the mean allocation size (see code for details).
+ * needs regarding the mean allocation size (see code for details), or, when
+ * the ring recently had to grow, the blocks needed to reach its high-water
+ * mark (see mem_window_t).
  *
  * Should be called when the pool is idle: won't do anything if called while
  * there are still some frames not released.
@@ -756,9 +1053,36 @@ const void * nonnull mem_ring_seal(mem_pool_t * nonnull) __leaf;
  *
  * This function will free an existing frame using the given cookie. Be
  * careful that the cookie will be invalidated after the frame release.
+ *
+ * A sealed frame can be released from any thread, which allows to hand the
+ * data built in a frame of the r_pool() of a thread to another thread (a
+ * thr_job for example) without copying it:
+ *
+ *     const void *frame = r_newframe();
+ *     query_t *query = r_unpack_query(...);
+ *
+ *     r_seal();
+ *     thr_schedule_b(^{
+ *         process_query(query);
+ *         mem_ring_release(frame);
+ *     });
+ *
+ * The ring itself can be deleted (or its thread can exit) while some of its
+ * frames are still held: it is then deleted by the last release.
  */
 void mem_ring_release(const void * nonnull cookie) __leaf;
 
+/** Take an extra reference on a frame.
+ *
+ * The frame is released when mem_ring_release() has been called once more
+ * than mem_ring_retain(), so that it can be shared by several threads that
+ * each release it when they are done with the data. The references are
+ * atomic.
+ *
+ * \return the cookie of the frame.
+ */
+const void * nonnull mem_ring_retain(const void * nonnull cookie) __leaf;
+
 /** Seal the ring-pool and return a checkpoint.
  *
  * The returned check point will allow you to restore later the ring-pool at
@@ -786,6 +1110,13 @@ void mem_ring_dump(const mem_pool_t * nonnull) __leaf;
 /** Get the malloc'd size of the memory pool. */
 size_t mem_ring_memory_footprint(const mem_pool_t * nonnull) __leaf;
 
+/** Get the size of the memory pool blocks bound to a given NUMA node.
+ *
+ * When the NUMA mode is disabled, every block is accounted on node 0.
+ */
+size_t mem_ring_memory_footprint_node(const mem_pool_t * nonnull, int node)
+    __leaf;
+
 /** Just like the t_pool() we have the corresponding r_pool() */
 mem_pool_t * nonnull r_pool(void) __leaf;
 
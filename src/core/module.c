@@ -23,6 +23,7 @@
 #include <lib-common/container-qvector.h>
 #include <lib-common/container-qhash.h>
 #include <lib-common/unix.h>
+#include <lib-common/thr.h>
 
 /* {{{ Type definition */
 /* {{{ methods */
@@ -74,6 +75,15 @@ struct module_t {
     int (*constructor)(void *);
     int (*destructor)(void);
     void *constructor_argument;
+
+    /* Parallel initialization, see module_require_parallel() */
+    bool parallel_init;
+    int  par_pending;
+    int  par_res;
+    thr_job_t par_job;
+
+    /* Time spent in the constructor, in nanoseconds */
+    uint64_t init_ns;
 };
 
 static module_t *module_init(module_t *module)
@@ -108,6 +118,15 @@ static struct module_g {
     /* Keep track if we are currently initializing a module */
     int in_initialization;
 
+    /* Held by module_require() so that the constructors run by the thr
+     * workers can require their (loaded) dependencies. */
+    pthread_mutex_t lock;
+
+    /* Modules initialized by the thr workers, not processed yet */
+    pthread_mutex_t par_lock;
+    pthread_cond_t  par_cond;
+    qv_t(module)    par_done;
+
     bool is_shutdown   : 1;
     bool methods_dirty : 1;
 } module_g = {
@@ -115,6 +134,9 @@ static struct module_g {
     .logger = LOGGER_INIT(NULL, "module", LOG_INHERITS),
     .modules     = QM_INIT(module, _G.modules),
     .methods = QM_INIT(methods_impl, _G.methods),
+    .lock     = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP,
+    .par_lock = PTHREAD_MUTEX_INITIALIZER,
+    .par_cond = PTHREAD_COND_INITIALIZER,
 };
 
 /* {{{ Module Registry */
@@ -234,7 +256,28 @@ modules_topo_sort_rev(qm_t(module) *modules, qv_t(module) *sorted, sb_t *err)
     return ret;
 }
 
-void module_require(module_t *module, module_t *required_by)
+static uint64_t module_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int module_construct(module_t *module)
+{
+    uint64_t start = module_now();
+    int res;
+
+    logger_trace(&_G.logger, 1, "calling `%*pM` constructor",
+                 LSTR_FMT_ARG(module->name));
+
+    res = (*module->constructor)(module->constructor_argument);
+    module->init_ns = module_now() - start;
+    return res;
+}
+
+static void module_require_locked(module_t *module, module_t *required_by)
 {
     if (module->state == INITIALIZING) {
         logger_fatal(&_G.logger,
@@ -273,13 +316,10 @@ void module_require(module_t *module, module_t *required_by)
     _G.methods_dirty = true;
 
     tab_for_each_entry(dep, &module->dependent_of) {
-        module_require(dep, module);
+        module_require_locked(dep, module);
     }
 
-    logger_trace(&_G.logger, 1, "calling `%*pM` constructor",
-                 LSTR_FMT_ARG(module->name));
-
-    if ((*module->constructor)(module->constructor_argument) < 0) {
+    if (module_construct(module) < 0) {
         logger_fatal(&_G.logger, "unable to initialize %*pM",
                      LSTR_FMT_ARG(module->name));
     }
@@ -289,6 +329,193 @@ void module_require(module_t *module, module_t *required_by)
     _G.in_initialization--;
 }
 
+void module_require(module_t *module, module_t *required_by)
+{
+    pthread_mutex_lock(&_G.lock);
+    module_require_locked(module, required_by);
+    pthread_mutex_unlock(&_G.lock);
+}
+
+/* {{{ Parallel initialization */
+
+void module_set_parallel_init(module_t *module)
+{
+    module->parallel_init = true;
+}
+
+/* Collects the modules that must be initialized to load module, in
+ * dependency order, and counts their dependencies that are not loaded yet.
+ */
+static void module_par_collect(module_t *module, qv_t(module) *todo)
+{
+    if (module_is_loaded(module) || module->state == INITIALIZING) {
+        return;
+    }
+    if (module->state == SHUTTING) {
+        logger_fatal(&_G.logger, "`%*pM` has been required while shutting "
+                     "down", LSTR_FMT_ARG(module->name));
+    }
+
+    module->state = INITIALIZING;
+    module->par_pending = 0;
+    tab_for_each_entry(dep, &module->dependent_of) {
+        module_par_collect(dep, todo);
+        if (dep->state == INITIALIZING) {
+            module->par_pending++;
+        }
+    }
+    qv_append(todo, module);
+}
+
+static void module_par_job_run(thr_job_t *job, thr_syn_t *syn)
+{
+    module_t *module = container_of(job, module_t, par_job);
+
+    module->par_res = module_construct(module);
+
+    pthread_mutex_lock(&_G.par_lock);
+    qv_append(&_G.par_done, module);
+    pthread_cond_signal(&_G.par_cond);
+    pthread_mutex_unlock(&_G.par_lock);
+}
+
+static void module_par_start(module_t *module)
+{
+    module->par_pending = -1;
+    pthread_mutex_lock(&_G.lock);
+    tab_for_each_entry(dep, &module->dependent_of) {
+        module_require_locked(dep, module);
+    }
+    pthread_mutex_unlock(&_G.lock);
+
+    logger_trace(&_G.logger, 1, "starting `%*pM` initialization%s",
+                 LSTR_FMT_ARG(module->name),
+                 module->parallel_init ? " in a worker" : "");
+}
+
+static void module_par_done(module_t *module, qv_t(module) *todo)
+{
+    if (module->par_res < 0) {
+        logger_fatal(&_G.logger, "unable to initialize %*pM",
+                     LSTR_FMT_ARG(module->name));
+    }
+
+    pthread_mutex_lock(&_G.lock);
+    /* Loaded, the requirers are registered when they start */
+    module->state = AUTO_REQ;
+    _G.methods_dirty = true;
+    pthread_mutex_unlock(&_G.lock);
+
+    tab_for_each_entry(m, todo) {
+        if (m->par_pending <= 0) {
+            continue;
+        }
+        tab_for_each_entry(dep, &m->dependent_of) {
+            if (dep == module) {
+                m->par_pending--;
+            }
+        }
+    }
+}
+
+void module_require_parallel(module_t *module)
+{
+    qv_t(module) todo;
+    qv_t(module) done;
+    module_t *slowest = NULL;
+    uint64_t start = module_now();
+    uint64_t total_ns = 0;
+    int remaining;
+    int running = 0;
+
+    if (module_is_loaded(module) || !MODULE_IS_LOADED(thr)) {
+        module_require(module, NULL);
+        return;
+    }
+
+    qv_init(&todo);
+    qv_init(&done);
+    _G.in_initialization++;
+    module_par_collect(module, &todo);
+    remaining = todo.len;
+
+    while (remaining > 0) {
+        module_t *main_thread = NULL;
+
+        pthread_mutex_lock(&_G.par_lock);
+        SWAP(qv_t(module), done, _G.par_done);
+        pthread_mutex_unlock(&_G.par_lock);
+
+        tab_for_each_entry(m, &done) {
+            running--;
+            remaining--;
+            module_par_done(m, &todo);
+        }
+        qv_clear(&done);
+
+        tab_for_each_entry(m, &todo) {
+            if (m->state != INITIALIZING || m->par_pending) {
+                continue;
+            }
+            if (!m->parallel_init) {
+                if (!main_thread) {
+                    main_thread = m;
+                }
+                continue;
+            }
+            module_par_start(m);
+            m->par_job.run = &module_par_job_run;
+            running++;
+            thr_schedule(&m->par_job);
+        }
+
+        if (main_thread) {
+            module_par_start(main_thread);
+            main_thread->par_res = module_construct(main_thread);
+            remaining--;
+            module_par_done(main_thread, &todo);
+            continue;
+        }
+        if (remaining <= 0) {
+            break;
+        }
+        if (!running) {
+            logger_fatal(&_G.logger, "`%*pM` dependencies cannot be "
+                         "initialized: dependency cycle",
+                         LSTR_FMT_ARG(module->name));
+        }
+
+        pthread_mutex_lock(&_G.par_lock);
+        while (!_G.par_done.len) {
+            pthread_cond_wait(&_G.par_cond, &_G.par_lock);
+        }
+        pthread_mutex_unlock(&_G.par_lock);
+    }
+
+    tab_for_each_entry(m, &todo) {
+        total_ns += m->init_ns;
+        if (!slowest || m->init_ns > slowest->init_ns) {
+            slowest = m;
+        }
+    }
+    if (slowest) {
+        logger_info(&_G.logger, "`%*pM` and its dependencies initialized "
+                    "in %ju ms (%d modules, %ju ms in constructors, "
+                    "slowest: `%*pM` in %ju ms)",
+                    LSTR_FMT_ARG(module->name),
+                    (module_now() - start) / 1000000, todo.len,
+                    total_ns / 1000000, LSTR_FMT_ARG(slowest->name),
+                    slowest->init_ns / 1000000);
+    }
+
+    qv_wipe(&todo);
+    qv_wipe(&done);
+    _G.in_initialization--;
+    module_require(module, NULL);
+}
+
+/* }}} */
+
 void module_provide(module_t *module, void *argument)
 {
     if (module->constructor_argument) {
@@ -472,6 +699,7 @@ static void _module_shutdown(void)
     }
     qm_deep_wipe(methods_impl, &_G.methods, IGNORE, module_method_delete);
     qm_deep_wipe(module, &_G.modules, IGNORE, module_delete);
+    qv_wipe(&_G.par_done);
     logger_wipe(&_G.logger);
     _G.is_shutdown = true;
 }
@@ -710,4 +938,31 @@ void module_debug_dump_hierarchy(sb_t *modules, sb_t *dependencies)
     }
 }
 
+static int module_init_ns_cmp(module_t * const *a, module_t * const *b)
+{
+    return CMP((*b)->init_ns, (*a)->init_ns);
+}
+
+void module_debug_dump_init_times(sb_t *out)
+{
+    qv_t(module) modules;
+
+    qv_init(&modules);
+    qm_for_each_pos(module, pos, &_G.modules) {
+        module_t *module = _G.modules.values[pos];
+
+        if (module->init_ns) {
+            qv_append(&modules, module);
+        }
+    }
+    qv_qsort(&modules, &module_init_ns_cmp);
+
+    sb_sets(out, "nodes;init_us\n");
+    tab_for_each_entry(module, &modules) {
+        sb_addf(out, "%*pM;%ju\n", LSTR_FMT_ARG(module->name),
+                module->init_ns / 1000);
+    }
+    qv_wipe(&modules);
+}
+
 /* }}} */
@@ -235,6 +235,17 @@ void module_run_method(const module_method_t * nonnull method, data_t arg);
 #define MODULE_NEEDED_BY(need)  \
     module_add_dep(MODULE(need), __mod)
 
+/** Allow the constructor of the module to run in a thr worker.
+ *
+ * As \ref MODULE_DEPENDS_ON this macro can only be used in a
+ * MODULE_BEGIN/MODULE_END block. It only matters for the modules initialized
+ * by \ref MODULE_REQUIRE_PARALLEL: the constructor must then be thread-safe
+ * (no event loop calls, no use of the t_stack of the main thread...) and
+ * only require modules it depends on.
+ */
+#define MODULE_PARALLEL_INIT()  \
+    module_set_parallel_init(__mod)
+
 /* {{{ Method */
 
 /** Declare the implementation of the method \p hook.
@@ -389,6 +400,20 @@ void module_implement_method_ptr(module_t * nonnull mod,
  */
 #define MODULE_REQUIRE(name)  module_require(MODULE(name), NULL)
 
+/** Macro for requiring a module, initializing its dependencies in parallel.
+ *
+ * The dependencies are initialized following the dependency graph: each
+ * module is initialized as soon as all its dependencies are, so that the
+ * independent ones are initialized at the same time. The constructors of
+ * the modules flagged with \ref MODULE_PARALLEL_INIT run in thr workers,
+ * the other ones run on the calling thread.
+ *
+ * The end state is the same as with \ref MODULE_REQUIRE, to which it falls
+ * back if the thr module is not loaded. The time spent in the constructors
+ * is logged, see also module_debug_dump_init_times().
+ */
+#define MODULE_REQUIRE_PARALLEL(name)  module_require_parallel(MODULE(name))
+
 /** Macro for releasing a module.
  *
  *  Use:
@@ -428,6 +453,16 @@ const char * nonnull module_get_name(const module_t * nonnull mod);
 __attr_nonnull__((1))
 void module_require(module_t * nonnull mod, module_t * nullable required_by);
 
+/** Require a module, initializing its dependencies in parallel.
+ *
+ * \see MODULE_REQUIRE_PARALLEL
+ */
+__attr_nonnull__((1))
+void module_require_parallel(module_t * nonnull mod);
+
+__attr_nonnull__((1))
+void module_set_parallel_init(module_t * nonnull mod);
+
 __attr_nonnull__((1))
 void module_release(module_t * nonnull mod);
 
@@ -472,6 +507,16 @@ bool module_is_shutting_down(const module_t * nonnull mod);
 void module_debug_dump_hierarchy(sb_t * nonnull modules,
                                  sb_t * nonnull dependencies);
 
+/** Fetch the time spent in the constructors of the modules.
+ *
+ * \param[out] out  The initialized modules, slowest first, formated like a
+ *                  csv file.
+ *                       * nodes;init_us
+ *                  init_us is the duration of the last call to the
+ *                  constructor of the module, in microseconds.
+ */
+void module_debug_dump_init_times(sb_t * nonnull out);
+
 /** Destroy all modules.
  *
  * XXX This is needed when calling C code from Java code using JNI. If not,
@@ -580,6 +625,7 @@ MODULE_DECLARE(core_mem);
 
 MODULE_DECLARE(core_mem_fifo);
 MODULE_DECLARE(core_mem_ring);
+MODULE_DECLARE(core_mem_slab);
 MODULE_DECLARE(core_mem_stack);
 
 /* }}} */
@@ -397,6 +397,143 @@ static void obj_release_(object_t *obj, bool *nullable destroyed)
     }
 }
 
+mem_pool_t *obj_slab_pool(void)
+{
+    static _Atomic(mem_pool_t *) mp;
+    mem_pool_t *res = atomic_load_explicit(&mp, memory_order_acquire);
+
+    if (unlikely(!res)) {
+        static spinlock_t lock;
+
+        spin_lock(&lock);
+        res = atomic_load_explicit(&mp, memory_order_relaxed);
+        if (!res) {
+            res = mem_slab_pool_new("obj", 0);
+            atomic_store_explicit(&mp, res, memory_order_release);
+        }
+        spin_unlock(&lock);
+    }
+    return res;
+}
+
+/* {{{ Class pools */
+
+typedef struct obj_pool_t {
+    mem_pool_t  funcs;
+    mem_pool_t *slab;
+    size_t      type_size;
+
+    spinlock_t  lock;
+    void       *free_list;
+    uint32_t    nb_free;
+    uint32_t    max_free;
+    uint64_t    hits;
+    uint64_t    misses;
+} obj_pool_t;
+
+static void *obj_pool_alloc(mem_pool_t *_mp, size_t size, size_t alignment,
+                            mem_flags_t flags)
+{
+    obj_pool_t *mp = container_of(_mp, obj_pool_t, funcs);
+    void *res = NULL;
+
+    if (size != mp->type_size) {
+        return mp_imalloc(mp->slab, size, alignment, flags);
+    }
+
+    spin_lock(&mp->lock);
+    if ((res = mp->free_list)) {
+        mp->free_list = *(void **)res;
+        mp->nb_free--;
+        mp->hits++;
+    } else {
+        mp->misses++;
+    }
+    spin_unlock(&mp->lock);
+
+    if (!res) {
+        return mp_imalloc(mp->slab, size, alignment, flags);
+    }
+    mem_tool_malloclike(res, size, 0, false);
+    if (!(flags & MEM_RAW)) {
+        memset(res, 0, size);
+    }
+    return res;
+}
+
+static void obj_pool_free(mem_pool_t *_mp, void *mem)
+{
+    obj_pool_t *mp = container_of(_mp, obj_pool_t, funcs);
+    const object_t *o = mem;
+
+    if (!mem || unlikely(mem == MEM_EMPTY_ALLOC)) {
+        return;
+    }
+
+    /* Only objects are allocated in the pool, and their class is still
+     * there after obj_wipe_real(): this tells whether the object has the
+     * size of the free list. */
+    if (o->v.ptr->type_size == mp->type_size) {
+        spin_lock(&mp->lock);
+        if (mp->nb_free < mp->max_free) {
+            mem_tool_freelike(mem, mp->type_size, 0);
+            mem_tool_allow_memory(mem, sizeof(void *), false);
+            *(void **)mem = mp->free_list;
+            mp->free_list = mem;
+            mp->nb_free++;
+            spin_unlock(&mp->lock);
+            return;
+        }
+        spin_unlock(&mp->lock);
+    }
+    mp_ifree(mp->slab, mem);
+}
+
+static void *obj_pool_realloc(mem_pool_t *_mp, void *mem, size_t oldsize,
+                              size_t size, size_t alignment,
+                              mem_flags_t flags)
+{
+    obj_pool_t *mp = container_of(_mp, obj_pool_t, funcs);
+
+    /* The objects of the free list are allocated in the slab pool too. */
+    return mp_irealloc(mp->slab, mem, oldsize, size, alignment, flags);
+}
+
+static mem_pool_t const obj_pool_funcs = {
+    .malloc   = &obj_pool_alloc,
+    .realloc  = &obj_pool_realloc,
+    .free     = &obj_pool_free,
+    .mem_pool = MEM_OTHER,
+    .min_alignment = 16
+};
+
+mem_pool_t *obj_pool_new(const char *name, size_t type_size,
+                         uint32_t max_free)
+{
+    obj_pool_t *mp = p_new(obj_pool_t, 1);
+
+    assert (type_size >= sizeof(object_t));
+    mp->funcs      = obj_pool_funcs;
+    mp->funcs.name = name;
+    mp->slab       = obj_slab_pool();
+    mp->type_size  = type_size;
+    mp->max_free   = max_free;
+    return &mp->funcs;
+}
+
+void obj_pool_get_stats(mem_pool_t *_mp, obj_pool_stats_t *stats)
+{
+    obj_pool_t *mp = container_of(_mp, obj_pool_t, funcs);
+
+    spin_lock(&mp->lock);
+    stats->hits    = mp->hits;
+    stats->misses  = mp->misses;
+    stats->nb_free = mp->nb_free;
+    spin_unlock(&mp->lock);
+}
+
+/* }}} */
+
 const object_class_t *object_class(void)
 {
     static object_class_t const klass = {
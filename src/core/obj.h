@@ -151,6 +151,7 @@
         const superclass##_class_t * nonnull super;                          \
         const char * nonnull type_name;                                      \
         size_t      type_size;                                               \
+        mem_pool_t * nullable type_mp;                                       \
         methods(pfx##_t, ##__VA_ARGS__);                                     \
     };                                                                       \
                                                                              \
@@ -475,6 +476,45 @@ bool cls_inherits(const void * nonnull cls, const void * nonnull vptr)
 /** Call virtual method of an object. */
 #define obj_vcall(o, method, ...)  obj_vmethod(o, method)(o, ##__VA_ARGS__)
 
+/** Type of a cache of a virtual method, for obj_vcall_cached().
+ *
+ * \param pfx     Prefix of the class of the objects the method is called on.
+ * \param method  Method to cache.
+ */
+#define obj_vmethod_cache_t(pfx, method)                                     \
+    struct {                                                                 \
+        const void * nullable cls;                                           \
+        typeof(((pfx##_class_t *)NULL)->method) nullable fn;                 \
+    }
+
+/** Call virtual method of an object, through a cache of the method.
+ *
+ * The method is loaded from the vtable only when the class of the object
+ * is not the one of the previous call made through the cache. In a loop over
+ * objects that are (mostly) of the same class, the indirect call then always
+ * goes to the same, well predicted, target without reading the vtable:
+ *
+ * obj_vmethod_cache_t(my_object, print) cache = { };
+ *
+ * tab_for_each_entry(o, &objects) {
+ *     obj_vcall_cached(&cache, o, print);
+ * }
+ *
+ * \param cache       Pointer on the obj_vmethod_cache_t of the call site.
+ * \param o           Object instance.
+ * \param method      Method to call.
+ * \param __VA_ARGS__ Arguments passed to the method.
+ */
+#define obj_vcall_cached(cache, o, method, ...)                              \
+    ({ typeof(cache) _vc_cache = (cache);                                    \
+       typeof(o) _vc_o = (o);                                                \
+                                                                             \
+       if (unlikely(_vc_cache->cls != (const void *)_vc_o->v.ptr)) {         \
+           _vc_cache->cls = _vc_o->v.ptr;                                    \
+           _vc_cache->fn  = obj_vmethod(_vc_o, method);                      \
+       }                                                                     \
+       (*_vc_cache->fn)(_vc_o, ##__VA_ARGS__); })
+
 /** Cast object to another class type.
  *
  * This macro is to be used only in case the parent object is known to be of
@@ -568,6 +608,70 @@ bool cls_inherits(const void * nonnull cls, const void * nonnull vptr)
 /** Get class descriptor for given class prefix. */
 #define obj_class(pfx)    ((const object_class_t *)pfx##_class())
 
+/** Get the memory pool used by obj_new() for a class.
+ *
+ * This is the libc memory pool unless the class (or one of its parents) set
+ * the `type_mp` field in its vtable, for example to obj_slab_pool().
+ */
+#define obj_class_mp(cls)  ((cls)->type_mp ?: &mem_pool_libc)
+
+/** Shared slab memory pool for the object classes.
+ *
+ * Classes with many long-lived instances created and deleted in random
+ * order can opt into this pool in their vtable:
+ *
+ * OBJ_VTABLE(my_object)
+ *     my_object.type_mp = obj_slab_pool();
+ * OBJ_VTABLE_END()
+ *
+ * The sub-classes inherit the memory pool of their parent.
+ */
+mem_pool_t * nonnull obj_slab_pool(void);
+
+/** Create a free-list memory pool for the instances of a class.
+ *
+ * The pool keeps up to \p max_free deleted instances of \p type_size bytes
+ * in a free list, which the next obj_new() reuse without going through the
+ * allocator. The other allocations are served by obj_slab_pool(), including
+ * the ones of the sub-classes, which inherit the pool of their parent with
+ * a bigger size unless they set their own.
+ *
+ * This is meant for the classes whose instances are created and deleted at
+ * a high rate. The pool can be used from any thread, and lives as long as
+ * the class:
+ *
+ * OBJ_VTABLE(my_object)
+ *     my_object.type_mp = obj_class_pool(my_object, 256);
+ * OBJ_VTABLE_END()
+ *
+ * The memory of the pool must only be used for objects.
+ */
+mem_pool_t * nonnull obj_pool_new(const char * nonnull name,
+                                  size_t type_size, uint32_t max_free);
+
+/** Create the free-list memory pool of a class.
+ *
+ * \see obj_pool_new
+ *
+ * \param pfx       Class prefix.
+ * \param max_free  Maximum number of free instances kept by the pool.
+ */
+#define obj_class_pool(pfx, max_free)                                        \
+    obj_pool_new(#pfx, sizeof(pfx##_t), (max_free))
+
+typedef struct obj_pool_stats_t {
+    /** number of allocations served by the free list */
+    uint64_t hits;
+    /** number of allocations of the class size with an empty free list */
+    uint64_t misses;
+    /** number of instances in the free list */
+    uint32_t nb_free;
+} obj_pool_stats_t;
+
+/** Get the statistics of a pool created by obj_pool_new(). */
+void obj_pool_get_stats(mem_pool_t * nonnull mp,
+                        obj_pool_stats_t * nonnull stats);
+
 /** Create object instance with defined memory pool.
  *
  * The object instance will either be deleted with the frame end for frame
@@ -585,13 +689,14 @@ bool cls_inherits(const void * nonnull cls, const void * nonnull vptr)
                                   _mp));                                     \
     })
 
-/** Create object instance with libc memory pool.
+/** Create object instance with the memory pool of its class.
  *
  * \see obj_mp_new
+ * \see obj_class_mp
  *
  * \param pfx Class prefix of the object.
  */
-#define obj_new(pfx)  obj_mp_new(&mem_pool_libc, pfx)
+#define obj_new(pfx)  obj_mp_new(obj_class_mp(pfx##_class()), pfx)
 
 /** Create object instance of specified class with defined memory pool.
  *
@@ -609,15 +714,17 @@ bool cls_inherits(const void * nonnull cls, const void * nonnull vptr)
                                    _mp)));                                   \
     })
 
-/** Create object instance of specified class with libc memory pool.
+/** Create object instance of specified class with the memory pool of this
+ * class.
  *
  * \see obj_mp_new_of_class
+ * \see obj_class_mp
  *
  * \param pfx Parent class prefix of the object.
  * \param cls Real class descriptor of the object.
  */
 #define obj_new_of_class(pfx, cls)                                           \
-    obj_mp_new_of_class(&mem_pool_libc, pfx, cls)
+    obj_mp_new_of_class(obj_class_mp(cls), pfx, cls)
 
 /** Retain object instance.
  *
@@ -18,32 +18,43 @@
 
 #include <lib-common/arith.h>
 #include <lib-common/qlzo.h>
+#include <lib-common/thr.h>
 
-#define D_BITS          14
-#define D_MASK          ((1u << D_BITS) - 1)
-#define D_HIGH          ((D_MASK >> 1) + 1)
+/* The dictionary is a hash table of 2^D_BITS buckets of D_WAYS positions:
+ * the most recent position of a hash comes first, so that the closest
+ * match is preferred when both are as long. */
+#define D_BITS          15
+#define D_WAYS          2
 
-static ALWAYS_INLINE uint32_t HASH3(const uint8_t *p)
-{
-    const uint32_t s1 = 5;
-    const uint32_t s2 = 5;
-    const uint32_t s3 = 6;
-
-    uint32_t p0 = p[0], p1 = p[1], p2 = p[2], p3 = p[3];
-    uint32_t h;
-
-    h = (p3 << (s1 + s2 + s3))
-      ^ (p2 << (s1 + s2))
-      ^ (p1 << (s1))
-      ^ (p0);
+typedef unsigned lzo_dict_t[1 << D_BITS][D_WAYS];
+_Static_assert(sizeof(lzo_dict_t) <= LZO_BUF_MEM_SIZE,
+               "the dictionary does not fit in LZO_BUF_MEM_SIZE");
 
-    h = (h << 5) + h;
-    return (h >> 5) & D_MASK;
+static ALWAYS_INLINE uint32_t HASH4(uint32_t word)
+{
+    return (word * 0x9e3779b1u) >> (32 - D_BITS);
 }
 
-static ALWAYS_INLINE uint32_t HASH3_SECONDARY(uint32_t h)
+/* Length of the match between m_pos and ip, knowing their first 4 bytes
+ * are equal. The bytes are compared 8 by 8, the first differing one being
+ * found with the trailing zeros of the XOR of the little endian words. */
+static ALWAYS_INLINE uint32_t
+lzo_match_len(const uint8_t *m_pos, const uint8_t *ip, uint32_t m_len_max)
 {
-    return (h & (D_MASK & 0x7ff)) ^ (D_HIGH | 0x1f);
+    uint32_t m_len = 4;
+
+    while (m_len + 8 <= m_len_max) {
+        uint64_t x = le_to_cpu64pu(m_pos + m_len) ^ le_to_cpu64pu(ip + m_len);
+
+        if (x) {
+            return m_len + (bsf64(x) >> 3);
+        }
+        m_len += 8;
+    }
+    while (m_len < m_len_max && m_pos[m_len] == ip[m_len]) {
+        m_len++;
+    }
+    return m_len;
 }
 
 static ALWAYS_INLINE uint8_t *
@@ -82,59 +93,65 @@ lzo_put_m1(uint8_t *out, const uint8_t *in, uint32_t sz)
     return mempcpy(out, in, sz);
 }
 
-static ALWAYS_INLINE uint8_t *compress(uint8_t *out, pstream_t *in, void *buf)
+/* When first_match and body are not NULL, they are set to the input
+ * position of the first match and to its position in the output, see
+ * qlzo1x_compress_mt(). */
+static ALWAYS_INLINE uint8_t *
+compress(uint8_t *out, pstream_t *in, void *buf,
+         const uint8_t **first_match, uint8_t **body)
 {
     const uint8_t * const orig_in = in->b;
     const uint8_t * const ip_end  = in->b_end - LZO_M2_MAX_LEN - 5;
-    unsigned * const dict = buf;
+    lzo_dict_t * const dict = buf;
 
     const uint8_t *ii = in->b;
-    uint32_t dindex;
 
     __ps_skip(in, 4);
-    dindex = HASH3(in->b);
-    goto literal;
 
     while (likely(in->b < ip_end)) {
-        uint32_t word;
-        uint32_t m_off, m_len, m_len_max;
-        const uint8_t *m_pos;
-
-        word   = get_unaligned_cpu32(in->b);
-        dindex = HASH3(in->b);
-        m_pos  = orig_in + dict[dindex];
+        uint32_t word = get_unaligned_cpu32(in->b);
+        unsigned *bucket = (*dict)[HASH4(word)];
+        uint32_t m_off, m_len = 0, m_len_max;
+        const uint8_t *m_pos = NULL;
 
-        if ((size_t)(m_pos + LZO_M4_MAX_OFFSET - in->b) >= LZO_M4_MAX_OFFSET)
-            goto literal;
+        m_len_max = ps_len(in);
+        for (int i = 0; i < D_WAYS; i++) {
+            const uint8_t *pos = orig_in + bucket[i];
+            uint32_t len;
 
-        if (get_unaligned_cpu32(m_pos) == word)
-            goto match;
+            if ((size_t)(pos + LZO_M4_MAX_OFFSET - in->b) >= LZO_M4_MAX_OFFSET
+            ||  get_unaligned_cpu32(pos) != word)
+            {
+                continue;
+            }
+            len = lzo_match_len(pos, in->b, m_len_max);
+            if (len > m_len) {
+                m_len = len;
+                m_pos = pos;
+            }
+        }
+        memmove(bucket + 1, bucket, (D_WAYS - 1) * sizeof(bucket[0]));
+        bucket[0] = in->b - orig_in;
 
-        dindex = HASH3_SECONDARY(dindex);
-        m_pos  = orig_in + dict[dindex];
+        if (!m_pos) {
+            /* Like the reference LZO1X-1 compressor, look for matches less
+             * often as the literal run grows, which speeds up the
+             * compression of incompressible data a lot. */
+            size_t step = 1 + ((in->b - ii) >> 5);
 
-        if ((size_t)(m_pos + LZO_M4_MAX_OFFSET - in->b) >= LZO_M4_MAX_OFFSET
-        ||  get_unaligned_cpu32(m_pos) != word)
-        {
-literal:
-            dict[dindex] = in->b++ - orig_in;
+            if (step >= (size_t)(ip_end - in->b)) {
+                break;
+            }
+            __ps_skip(in, step);
             continue;
         }
 
-match:
-        dict[dindex] = in->b - orig_in;
         if (in->b != ii)
             out = lzo_put_m1(out, ii, in->b - ii);
-
-        m_len_max = ps_len(in);
-        for (m_len = 4; m_len + 2 <= m_len_max; m_len += 2) {
-            if (get_unaligned_cpu16(m_pos + m_len) !=
-                get_unaligned_cpu16(in->b + m_len))
-            {
-                break;
-            }
+        if (body && !*body) {
+            *first_match = in->b;
+            *body = out;
         }
-        m_len += m_len < m_len_max && m_pos[m_len] == in->b[m_len];
 
         m_off  = in->b - m_pos;
         if (m_len <= LZO_M2_MAX_LEN) {
@@ -171,10 +188,28 @@ m2_offset_already_done:
     return out;
 }
 
+/* Add the trailing literals and the end of stream marker. */
+static uint8_t *lzo_put_tail(uint8_t *orig_out, uint8_t *out,
+                             const uint8_t *lit, size_t t)
+{
+    if (t > 0) {
+        if (out == orig_out && t <= 238) {
+            *out++ = (17 + t);
+            out = mempcpy(out, lit, t);
+        } else {
+            out = lzo_put_m1(out, lit, t);
+        }
+    }
+
+    out[0] = LZO_M4_MARKER | 1;
+    out[1] = 0;
+    out[2] = 0;
+    return out + 3;
+}
+
 size_t qlzo1x_compress(void *orig_out, size_t outlen, pstream_t in, void *buf)
 {
     uint8_t *out = orig_out;
-    size_t t;
 
     /* XXX: initializing the dictionnary is absolutely not useful,
      *      algorithm continues to work properly with random data in.
@@ -185,19 +220,101 @@ size_t qlzo1x_compress(void *orig_out, size_t outlen, pstream_t in, void *buf)
         memset(buf, 0, LZO_BUF_MEM_SIZE);
 
     if (likely(ps_has(&in, LZO_M2_MAX_LEN + 5)))
-        out = compress(out, &in, buf);
-    t  = ps_len(&in);
-    if (t > 0) {
-        if (out == orig_out && t <= 238) {
-            *out++ = (17 + t);
-            out = mempcpy(out, in.b, t);
-        } else {
-            out = lzo_put_m1(out, in.b, t);
+        out = compress(out, &in, buf, NULL, NULL);
+    out = lzo_put_tail(orig_out, out, in.b, ps_len(&in));
+    return out - (uint8_t *)orig_out;
+}
+
+/* {{{ Parallel compression */
+
+/* The blocks are compressed independently, each in its own output buffer.
+ * The trailing literals of a block are not written, they are merged with
+ * the leading ones of the next block when the outputs are put together:
+ * LZO does not allow two literal runs in a row. */
+typedef struct lzo_mt_block_t {
+    thr_job_t       job;
+    pstream_t       in;
+    uint8_t        *out;
+    const uint8_t  *first_match;
+    uint8_t        *body;
+    uint8_t        *body_end;
+} lzo_mt_block_t;
+
+static __thread lzo_dict_t *lzo_mt_dict_g;
+
+static void lzo_mt_thr_wipe(void)
+{
+    p_delete(&lzo_mt_dict_g);
+}
+thr_hooks(NULL, lzo_mt_thr_wipe);
+
+static lzo_dict_t *lzo_mt_dict(void)
+{
+    if (unlikely(!lzo_mt_dict_g)) {
+        lzo_mt_dict_g = p_new(lzo_dict_t, 1);
+    }
+    return lzo_mt_dict_g;
+}
+
+static void lzo_mt_block_run(thr_job_t *job, thr_syn_t *syn)
+{
+    lzo_mt_block_t *blk = container_of(job, lzo_mt_block_t, job);
+
+    if (ps_has(&blk->in, LZO_M2_MAX_LEN + 5)) {
+        blk->body_end = compress(blk->out, &blk->in, lzo_mt_dict(),
+                                 &blk->first_match, &blk->body);
+    }
+}
+
+size_t qlzo1x_compress_mt(void *orig_out, size_t outlen, pstream_t in,
+                          size_t block_size)
+{
+    size_t len = ps_len(&in);
+    size_t nb_blocks;
+    lzo_mt_block_t *blocks;
+    uint8_t *tmp;
+    uint8_t *out = orig_out;
+    const uint8_t *lit = in.b;
+    thr_syn_t syn;
+
+    block_size = MAX(block_size ?: LZO_MT_BLOCK_SIZE, 64u << 10);
+    if (len <= block_size || !MODULE_IS_LOADED(thr)) {
+        return qlzo1x_compress(orig_out, outlen, in, lzo_mt_dict());
+    }
+
+    nb_blocks = DIV_ROUND_UP(len, block_size);
+    blocks = p_new(lzo_mt_block_t, nb_blocks);
+    tmp = p_new_raw(uint8_t, nb_blocks * lzo_cbuf_size(block_size));
+
+    thr_syn_init(&syn);
+    for (size_t i = 0; i < nb_blocks; i++) {
+        lzo_mt_block_t *blk = &blocks[i];
+
+        blk->job.run = &lzo_mt_block_run;
+        blk->in  = ps_init(in.b + i * block_size,
+                           MIN(block_size, len - i * block_size));
+        blk->out = tmp + i * lzo_cbuf_size(block_size);
+        thr_syn_schedule(&syn, &blk->job);
+    }
+    thr_syn_wait(&syn);
+    thr_syn_wipe(&syn);
+
+    for (size_t i = 0; i < nb_blocks; i++) {
+        lzo_mt_block_t *blk = &blocks[i];
+
+        if (!blk->first_match) {
+            /* No match, the whole block is made of literals. */
+            continue;
         }
+        out = lzo_put_m1(out, lit, blk->first_match - lit);
+        out = mempcpy(out, blk->body, blk->body_end - blk->body);
+        lit = blk->in.b;
     }
+    out = lzo_put_tail(orig_out, out, lit, in.b_end - lit);
 
-    out[0] = LZO_M4_MARKER | 1;
-    out[1] = 0;
-    out[2] = 0;
-    return out + 3 - (uint8_t *)orig_out;
+    p_delete(&tmp);
+    p_delete(&blocks);
+    return out - (uint8_t *)orig_out;
 }
+
+/* }}} */
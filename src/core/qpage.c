@@ -18,7 +18,12 @@
 
 #include <lib-common/container-qvector.h>
 #include <lib-common/arith.h>
+#include <lib-common/datetime.h>
+#include <lib-common/el.h>
+#include <lib-common/log.h>
 #include <lib-common/qpage.h>
+#include <lib-common/str-buf-pp.h>
+#include <lib-common/thr.h>
 
 /*
  * QPage allocator is inspired by qtlsf (look at qtlsf.[hc] for explanations).
@@ -48,6 +53,14 @@
  * which will likely not done a lot of times per second ;) I don't expect it to
  * be a lot more than twice as slow as qtlsf, which makes it in the 100ns
  * range per allocation (for raw pages).
+ *
+ * Small runs (up to CLASS_SMALL pages) freed as a whole are first kept in a
+ * bounded per-thread cache before going back to the arena: threads that
+ * allocate and free pages in a loop then mostly avoid the global spinlock.
+ * See the "Per-thread page cache" section below.
+ *
+ * Optionally, a background thread keeps a reserve of pre-zeroed small runs
+ * for qpage_alloc_align(), see the "Pre-zeroed reserve" section below.
  */
 
 #define QPAGE_DEBUG 0
@@ -89,15 +102,34 @@ typedef struct page_run_t {
     qpage_t     *mem_pages;
     uint32_t     npages;
     uint32_t     segment;
+    uint32_t     node;
+    /* per QDB_MADVISE_THRESHOLD chunk, time at which the chunk was lazily
+     * freed, 0 if it is not (see qpage_release_pages()) */
+    time_t      *lazy_since;
     page_desc_t  pages[];
 } page_run_t;
 
-static struct {
+/* Free blocks lists. There is a single arena unless the NUMA mode is enabled
+ * (see mem_numa_enable()), in which case there is one arena per node: page
+ * runs are bound to the node of their arena, and free blocks go back to the
+ * arena of their run.
+ */
+typedef struct qpage_arena_t {
 #define BITS_LEN  BITS_TO_ARRAY_LEN(size_t, CLASSES)
     size_t       *bits; /* array of BITS_LEN elements. */
     page_desc_t **blks; /* array of CLASSES elements. */
+} qpage_arena_t;
+
+static struct {
+    qpage_arena_t arenas[MEM_NUMA_NODES_MAX];
     qv_t(pgd)     segs;
     spinlock_t    lock;
+    bool          huge_pages;
+
+    /* lazily freed pages, see qpage_release_pages() */
+    time_t        next_decay;
+    uint64_t      lazy_pages;
+    uint64_t      decayed_pages;
 } qpages_g;
 #define _G  qpages_g
 
@@ -135,16 +167,17 @@ static ALWAYS_INLINE uint32_t mapping_class(uint32_t npages)
     return (npages >> level) + (level << CLASSES_SHIFT) - 1;
 }
 
-static ALWAYS_INLINE page_desc_t *find_suitable_block(uint32_t *class)
+static ALWAYS_INLINE page_desc_t *
+find_suitable_block(qpage_arena_t *arena, uint32_t *class)
 {
     unsigned vec  = *class / bitsizeof(size_t);
     size_t   mask = BITMASK_GE(size_t, *class);
 
     do {
-        size_t tmp = _G.bits[vec] & mask;
+        size_t tmp = arena->bits[vec] & mask;
         if (tmp) {
             *class = vec * bitsizeof(size_t) + bsfsz(tmp);
-            return _G.blks[*class];
+            return arena->blks[*class];
         }
         mask = (size_t)-1;
     } while (++vec < BITS_LEN);
@@ -223,23 +256,24 @@ static void qpages_check(page_run_t *run)
 #  define qpages_check(run)  do { } while (0)
 #endif
 
-static inline void blk_insert(page_desc_t *blk, size_t npages)
+static inline void
+blk_insert(qpage_arena_t *arena, page_desc_t *blk, size_t npages)
 {
     uint32_t class = mapping_class(npages);
 
     blk->flags = npages | BLK_PREV_USED | BLK_FREE;
-    if ((blk->free_next = _G.blks[class])) {
+    if ((blk->free_next = arena->blks[class])) {
         blk->free_next->free_prev_next = &blk->free_next;
     } else {
-        SET_BIT(_G.bits, class);
+        SET_BIT(arena->bits, class);
     }
-    *(blk->free_prev_next = &_G.blks[class]) = blk;
+    *(blk->free_prev_next = &arena->blks[class]) = blk;
 
     blk[npages].flags    |= BLK_PREV_FREE;
     blk[npages].blk_prev  = npages;
 }
 
-static inline uint32_t blk_remove(page_desc_t *blk)
+static inline uint32_t blk_remove(qpage_arena_t *arena, page_desc_t *blk)
 {
     uint32_t npages = blk_size(blk);
     uint32_t class  = mapping_class(npages);
@@ -249,8 +283,8 @@ static inline uint32_t blk_remove(page_desc_t *blk)
     if (blk->free_next) {
         blk->free_next->free_prev_next = blk->free_prev_next;
     } else
-    if (blk->free_prev_next == &_G.blks[class]) {
-        RST_BIT(_G.bits, class);
+    if (blk->free_prev_next == &arena->blks[class]) {
+        RST_BIT(arena->bits, class);
     }
     return npages;
 }
@@ -304,7 +338,18 @@ static inline uint32_t blk_cut(page_desc_t *blk)
     return bsz;
 }
 
-static NEVER_INLINE int create_arena(size_t npages)
+static qpage_arena_t *qpage_get_arena(uint32_t node)
+{
+    qpage_arena_t *arena = &_G.arenas[node];
+
+    if (unlikely(!arena->bits)) {
+        arena->bits = p_new(size_t, BITS_LEN);
+        arena->blks = p_new(page_desc_t *, CLASSES);
+    }
+    return arena;
+}
+
+static NEVER_INLINE int create_arena(uint32_t node, size_t npages)
 {
     size_t pgsize = getpagesize();
     size_t size, offset;
@@ -332,6 +377,14 @@ static NEVER_INLINE int create_arena(size_t npages)
         munmap(pgs, size);
         return -1;
     }
+    run->lazy_since = calloc(DIV_ROUND_UP(npages, QDB_MADVISE_THRESHOLD),
+                             sizeof(time_t));
+    if (run->lazy_since == NULL) {
+        free(run);
+        mem_tool_allow_memory(pgs, size, true);
+        munmap(pgs, size);
+        return -1;
+    }
     if (QPAGE_SIZE > pgsize) {
         offset = (uintptr_t)pgs & QPAGE_MASK;
         if (offset) {
@@ -346,9 +399,16 @@ static NEVER_INLINE int create_arena(size_t npages)
             munmap(pgs + npages, QPAGE_SIZE);
         }
     }
+    mem_numa_bind(pgs, npages * QPAGE_SIZE, node);
+#ifdef MADV_HUGEPAGE
+    if (_G.huge_pages) {
+        madvise(pgs, npages * QPAGE_SIZE, MADV_HUGEPAGE);
+    }
+#endif
     run->mem_pages = pgs;
     run->npages    = npages;
     run->segment   = _G.segs.len;
+    run->node      = node;
     qv_append(&_G.segs, run->pages);
     for (uint32_t i = 0; i <= npages; i++) {
         run->pages[i].blkno = i;
@@ -359,10 +419,124 @@ static NEVER_INLINE int create_arena(size_t npages)
 
     blk->flags = BLK_PREV_USED | BLK_FREE | npages;
     end->flags = BLK_PREV_FREE | BLK_USED;
-    blk_insert(blk, npages);
+    blk_insert(qpage_get_arena(node), blk, npages);
     return 0;
 }
 
+/* {{{ Lazy release of the free pages */
+
+/* The free chunks of pages are not given back to the system right away:
+ * they are first advised with MADV_FREE, which lets the kernel reclaim them
+ * only under memory pressure and is cheap to undo (the pages are just
+ * reused). They are only released with MADV_DONTNEED once they stayed free
+ * for mem_decay_delay_g seconds. This avoids the page faults and syscalls of
+ * the memory that oscillates between used and free under bursty traffic.
+ *
+ * The lazily freed pages are marked dirty, as their content may or may not
+ * survive. All these functions must be called with the arena lock held.
+ */
+
+static uint32_t chunk_npages(const page_run_t *run, size_t chunk)
+{
+    return MIN(QDB_MADVISE_THRESHOLD,
+               run->npages - chunk * QDB_MADVISE_THRESHOLD);
+}
+
+static void
+qpage_dontneed_pages(page_run_t *run, size_t blkno, size_t npages)
+{
+#ifdef __linux__
+    madvise(run->mem_pages + blkno, npages * QPAGE_SIZE, MADV_DONTNEED);
+#else
+    mmap(run->mem_pages + blkno, npages * QPAGE_SIZE, PROT_READ | PROT_WRITE,
+         MAP_PRIVATE | MAP_ANON | MAP_FIXED, -1, 0);
+#endif
+    blk_set_clean(run->pages + blkno, npages);
+}
+
+/* Give the pages of whole chunks back to the system, lazily if possible. */
+static void
+qpage_release_pages(page_run_t *run, size_t blkno, size_t npages)
+{
+#ifdef MADV_FREE
+    if (mem_decay_delay_g > 0
+    &&  madvise(run->mem_pages + blkno, npages * QPAGE_SIZE, MADV_FREE) == 0)
+    {
+        time_t now = lp_getsec();
+
+        blk_set_dirty(run->pages + blkno, npages);
+        for (size_t c = blkno / QDB_MADVISE_THRESHOLD;
+             c * QDB_MADVISE_THRESHOLD < blkno + npages; c++)
+        {
+            if (!run->lazy_since[c]) {
+                _G.lazy_pages += chunk_npages(run, c);
+            }
+            run->lazy_since[c] = now;
+        }
+        return;
+    }
+#endif
+    qpage_dontneed_pages(run, blkno, npages);
+}
+
+/* Forget the lazily freed chunks overlapped by newly used pages. */
+static void qpage_unlazy_pages(page_run_t *run, size_t blkno, size_t npages)
+{
+    if (!_G.lazy_pages) {
+        return;
+    }
+    for (size_t c = blkno / QDB_MADVISE_THRESHOLD;
+         c * QDB_MADVISE_THRESHOLD < blkno + npages; c++)
+    {
+        if (run->lazy_since[c]) {
+            run->lazy_since[c] = 0;
+            _G.lazy_pages -= chunk_npages(run, c);
+        }
+    }
+}
+
+/* Release the chunks that stayed lazily freed for too long. */
+static void qpage_decay(void)
+{
+    time_t now = lp_getsec();
+
+    if (!_G.lazy_pages || now < _G.next_decay) {
+        return;
+    }
+    _G.next_decay = now + 1;
+
+    for (int i = 0; i < _G.segs.len; i++) {
+        page_desc_t *blk = _G.segs.tab[i];
+        page_run_t  *run = run_of(blk, blk_no(blk));
+        size_t nchunks = DIV_ROUND_UP(run->npages, QDB_MADVISE_THRESHOLD);
+
+        for (size_t c = 0; c < nchunks; c++) {
+            uint32_t n;
+
+            if (!run->lazy_since[c]
+            ||  run->lazy_since[c] + mem_decay_delay_g > now)
+            {
+                continue;
+            }
+            n = chunk_npages(run, c);
+            qpage_dontneed_pages(run, c * QDB_MADVISE_THRESHOLD, n);
+            run->lazy_since[c] = 0;
+            _G.lazy_pages    -= n;
+            _G.decayed_pages += n;
+        }
+    }
+}
+
+void qpage_decay_stats(uint64_t *lazy_bytes, uint64_t *decayed_bytes)
+{
+    spin_lock(&_G.lock);
+    *lazy_bytes    = _G.lazy_pages * QPAGE_SIZE;
+    *decayed_bytes = _G.decayed_pages * QPAGE_SIZE;
+    spin_unlock(&_G.lock);
+}
+
+/* }}} */
+
 /**************************************************************************/
 /* Public stuff                                                           */
 /**************************************************************************/
@@ -371,6 +545,7 @@ static void
 free_n(page_run_t *run, page_desc_t *blk, size_t npages, uint32_t seg)
 {
     uint32_t blkno = blk_no(blk);
+    qpage_arena_t *arena = &_G.arenas[run->node];
     page_desc_t *tmp;
     size_t bsz;
 
@@ -388,23 +563,17 @@ free_n(page_run_t *run, page_desc_t *blk, size_t npages, uint32_t seg)
     } else {
         tmp = blk_next(blk, bsz);
         if (tmp->flags & BLK_FREE) {
-            bsz += blk_remove(tmp);
+            bsz += blk_remove(arena, tmp);
         }
     }
     if (blk->flags & BLK_PREV_FREE) {
         blk  = blk_get_prev(blk);
-        bsz += blk_remove(blk);
+        bsz += blk_remove(arena, blk);
     }
-    blk_insert(blk, bsz);
+    blk_insert(arena, blk, bsz);
 
     if (bsz == run->npages) {
-#ifdef __linux__
-        madvise(run->mem_pages, bsz * QPAGE_SIZE, MADV_DONTNEED);
-#else
-        mmap(run->mem_pages, bsz * QPAGE_SIZE, PROT_READ | PROT_WRITE,
-             MAP_PRIVATE | MAP_ANON | MAP_FIXED, -1, 0);
-#endif
-        blk_set_clean(run->pages, bsz);
+        qpage_release_pages(run, 0, bsz);
         mem_tool_disallow_memory(run->mem_pages, bsz * QPAGE_SIZE);
     } else {
         /** Divide virtually the array of run->pages into chunk of size of
@@ -442,15 +611,7 @@ free_n(page_run_t *run, page_desc_t *blk, size_t npages, uint32_t seg)
         if (chunk_begin < chunk_end) {
             const size_t chunk_sz = chunk_end - chunk_begin;
 
-#ifdef __linux__
-            madvise(run->mem_pages + chunk_begin, chunk_sz * QPAGE_SIZE,
-                    MADV_DONTNEED);
-#else
-            mmap(run->mem_pages + chunk_begin, chunk_sz * QPAGE_SIZE,
-                 PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_FIXED,
-                 -1, 0);
-#endif
-            blk_set_clean(run->pages + chunk_begin, chunk_sz);
+            qpage_release_pages(run, chunk_begin, chunk_sz);
             mem_tool_disallow_memory(run->mem_pages + chunk_begin,
                                      chunk_sz * QPAGE_SIZE);
             if (blkno < chunk_begin) {
@@ -470,38 +631,217 @@ free_n(page_run_t *run, page_desc_t *blk, size_t npages, uint32_t seg)
                                      npages * QPAGE_SIZE);
         }
     }
+    qpage_decay();
 
     spin_unlock(&_G.lock);
     qpages_check(run);
 }
 
+/* {{{ Per-thread page cache */
+
+/* Cached runs remain *used* from the arena point of view, they are just
+ * owned by the thread cache instead of the caller. Cache buckets are indexed
+ * by mapping_class(), which is exact for runs of at most CLASS_SMALL pages.
+ */
+#define QPAGE_CACHE_RUNS       8   /* cached runs per class                */
+#define QPAGE_CACHE_MAX_PAGES  256 /* cached pages per thread (1 MiB)      */
+
+typedef struct qpage_cache_run_t {
+    qpage_t  *pages;
+    uint32_t  seg;
+} qpage_cache_run_t;
+
+typedef struct qpage_cache_t {
+    uint8_t            len[CLASS_SMALL];
+    qpage_cache_run_t  runs[CLASS_SMALL][QPAGE_CACHE_RUNS];
+    uint32_t           npages;
+    bool               registered;
+
+    /* Written by the owner thread only, read without synchronization by
+     * core_mem_qpage_print_state(): values are only indicative. */
+    uint64_t           hits;
+    uint64_t           misses;
+
+    pthread_t          pthread_id;
+    dlist_t            cache_list;
+} qpage_cache_t;
+
+static __thread qpage_cache_t qpage_cache_g;
+
+static struct {
+    logger_t   logger;
+
+    dlist_t    all_caches;
+    spinlock_t all_caches_lock;
+
+    /* counters of the caches of the threads that already exited */
+    uint64_t   hits;
+    uint64_t   misses;
+} qpage_caches_g = {
+    .logger     = LOGGER_INIT_INHERITS(NULL, "core-mem-qpage"),
+    .all_caches = DLIST_INIT(qpage_caches_g.all_caches),
+};
+
+static void qpage_release(qpage_t *qp, size_t npages, uint32_t seg);
+
+static void *
+qpage_cache_get(size_t npages, size_t shift, bool zero, uint32_t *seg)
+{
+    qpage_cache_t *cache = &qpage_cache_g;
+    uintptr_t smask = ((uintptr_t)1 << shift) - 1;
+    uint32_t class;
+
+    if (npages == 0 || npages > CLASS_SMALL) {
+        return NULL;
+    }
+
+    class = mapping_class(npages);
+    for (int i = cache->len[class]; i-- > 0; ) {
+        qpage_cache_run_t *run = &cache->runs[class][i];
+        qpage_t *res = run->pages;
+
+        if (((uintptr_t)res >> QPAGE_SHIFT) & smask) {
+            continue;
+        }
+        if (seg) {
+            *seg = run->seg;
+        }
+        *run = cache->runs[class][--cache->len[class]];
+        cache->npages -= npages;
+        cache->hits++;
+
+        mem_tool_allow_memory(res, npages * QPAGE_SIZE, zero);
+        if (zero) {
+            p_clear(res, npages);
+        }
+        return res;
+    }
+    cache->misses++;
+    return NULL;
+}
+
+static bool qpage_cache_put(qpage_t *qp, page_desc_t *blk, size_t npages,
+                            uint32_t seg)
+{
+    qpage_cache_t *cache = &qpage_cache_g;
+    qpage_cache_run_t *run;
+    uint32_t class;
+
+    /* Only cache whole runs: partial frees have to split the page run which
+     * requires the arena lock anyway. Only the size bits of the run header
+     * are read here, other threads can only touch its BLK_PREV_FREE bit. */
+    if (npages > CLASS_SMALL || (blk->flags & BLK_PGINRUN)
+    ||  blk_size(blk) != npages)
+    {
+        return false;
+    }
+    class = mapping_class(npages);
+    if (cache->len[class] >= QPAGE_CACHE_RUNS
+    ||  cache->npages + npages > QPAGE_CACHE_MAX_PAGES)
+    {
+        return false;
+    }
+
+    if (unlikely(!cache->registered)) {
+        cache->registered = true;
+        cache->pthread_id = pthread_self();
+        spin_lock(&qpage_caches_g.all_caches_lock);
+        dlist_add_tail(&qpage_caches_g.all_caches, &cache->cache_list);
+        spin_unlock(&qpage_caches_g.all_caches_lock);
+    }
+
+    run = &cache->runs[class][cache->len[class]++];
+    run->pages = qp;
+    run->seg   = seg;
+    cache->npages += npages;
+    mem_tool_disallow_memory(qp, npages * QPAGE_SIZE);
+    return true;
+}
+
+/** Give all the runs of the calling thread cache back to the arena. */
+static void qpage_cache_flush(void)
+{
+    qpage_cache_t *cache = &qpage_cache_g;
+
+    for (uint32_t class = 0; class < CLASS_SMALL; class++) {
+        while (cache->len[class] > 0) {
+            qpage_cache_run_t *run = &cache->runs[class][--cache->len[class]];
+
+            qpage_release(run->pages, class + 1, run->seg);
+        }
+    }
+    cache->npages = 0;
+}
+
+static void qpage_cache_wipe(void)
+{
+    qpage_cache_t *cache = &qpage_cache_g;
+
+    qpage_cache_flush();
+    if (cache->registered) {
+        spin_lock(&qpage_caches_g.all_caches_lock);
+        dlist_remove(&cache->cache_list);
+        qpage_caches_g.hits   += cache->hits;
+        qpage_caches_g.misses += cache->misses;
+        spin_unlock(&qpage_caches_g.all_caches_lock);
+        cache->registered = false;
+    }
+    cache->hits   = 0;
+    cache->misses = 0;
+}
+thr_hooks(NULL, qpage_cache_wipe);
+
+static void qpage_cache_fix_all_caches_at_fork(void)
+{
+    /* Only the calling thread survives a fork, the runs cached by the other
+     * threads are lost. */
+    dlist_for_each_entry(qpage_cache_t, cache, &qpage_caches_g.all_caches,
+                         cache_list)
+    {
+        if (!pthread_equal(cache->pthread_id, pthread_self())) {
+            dlist_remove(&cache->cache_list);
+        }
+    }
+}
+
+__attribute__((constructor))
+static void qpage_cache_init_at_fork(void)
+{
+    pthread_atfork(NULL, NULL, &qpage_cache_fix_all_caches_at_fork);
+}
+
+/* }}} */
+
 static page_desc_t *
 qpage_alloc_align_impl(size_t npages, size_t shift, bool zero, page_run_t **runp)
 {
     page_desc_t *blk, *next, *split;
     uint32_t class, blkno, size, offs;
     uint32_t smask = (1U << shift) - 1;
+    uint32_t node = mem_numa_current_node();
+    qpage_arena_t *arena;
     page_run_t *run;
 
     if (unlikely(npages == 0 || npages + smask > QPAGE_COUNT_MAX))
         return NULL;
 
     spin_lock(&_G.lock);
+    arena = qpage_get_arena(node);
     class = mapping_class_upper(npages + smask);
-    blk   = find_suitable_block(&class);
+    blk   = find_suitable_block(arena, &class);
     if (unlikely(!blk)) {
-        if (create_arena(npages + smask) < 0) {
+        if (create_arena(node, npages + smask) < 0) {
             spin_unlock(&_G.lock);
             return NULL;
         }
         class = mapping_class_upper(npages + smask);
-        blk   = find_suitable_block(&class);
+        blk   = find_suitable_block(arena, &class);
     }
 
-    if ((_G.blks[class] = blk->free_next)) {
-        blk->free_next->free_prev_next = &_G.blks[class];
+    if ((arena->blks[class] = blk->free_next)) {
+        blk->free_next->free_prev_next = &arena->blks[class];
     } else {
-        RST_BIT(_G.bits, class);
+        RST_BIT(arena->bits, class);
     }
 
     size  = blk_size(blk);
@@ -512,7 +852,7 @@ qpage_alloc_align_impl(size_t npages, size_t shift, bool zero, page_run_t **runp
 
     if (offs) {
         offs   = smask + 1 - offs;
-        blk_insert(blk, offs);
+        blk_insert(arena, blk, offs);
         blk   += offs;
         blkno += offs;
         size  -= offs;
@@ -522,12 +862,13 @@ qpage_alloc_align_impl(size_t npages, size_t shift, bool zero, page_run_t **runp
     }
     if (size > npages) {
         split = blk_next(blk, npages);
-        blk_insert(split, size - npages);
+        blk_insert(arena, split, size - npages);
     } else {
         assert (size == npages);
         next->flags &= ~BLK_PREV_FREE;
     }
 
+    qpage_unlazy_pages(run, blkno, npages);
     mem_tool_allow_memory(run->mem_pages + blk_no(blk), npages * QPAGE_SIZE,
                           zero);
     if (zero) {
@@ -539,11 +880,241 @@ qpage_alloc_align_impl(size_t npages, size_t shift, bool zero, page_run_t **runp
     return blk;
 }
 
+/* {{{ Pre-zeroed reserve */
+
+/* Like the thread caches, the reserved runs are *used* from the arena point
+ * of view. The background thread allocates them raw and zeroes them without
+ * holding the arena lock, then only the runs of the classes that missed
+ * since the reserve was started are refilled.
+ */
+static struct {
+    spinlock_t         lock;
+    uint8_t            len[CLASS_SMALL];
+    qpage_cache_run_t  runs[CLASS_SMALL][QPAGE_ZERO_RESERVE_MAX];
+    uint64_t           npages;
+
+    _Atomic(uint32_t)  depth;
+    _Atomic(uint32_t)  wanted; /* bitmap of the classes to refill */
+    atomic_uint_fast64_t hits;
+    atomic_uint_fast64_t misses;
+
+    thr_evc_t          ec;
+    pthread_t          thread;
+    bool               running;
+} qpage_zero_g;
+
+static void *qpage_zero_get(size_t npages, size_t shift, uint32_t *seg)
+{
+    uintptr_t smask = ((uintptr_t)1 << shift) - 1;
+    uint32_t depth = atomic_load_explicit(&qpage_zero_g.depth,
+                                          memory_order_relaxed);
+    uint32_t class;
+    bool refill;
+    qpage_t *res = NULL;
+
+    if (likely(!depth) || npages == 0 || npages > CLASS_SMALL) {
+        return NULL;
+    }
+
+    class = mapping_class(npages);
+    spin_lock(&qpage_zero_g.lock);
+    for (int i = qpage_zero_g.len[class]; i-- > 0; ) {
+        qpage_cache_run_t *run = &qpage_zero_g.runs[class][i];
+
+        if (((uintptr_t)run->pages >> QPAGE_SHIFT) & smask) {
+            continue;
+        }
+        res = run->pages;
+        if (seg) {
+            *seg = run->seg;
+        }
+        *run = qpage_zero_g.runs[class][--qpage_zero_g.len[class]];
+        qpage_zero_g.npages -= npages;
+        break;
+    }
+    /* only wake the background thread up when half of the reserve of the
+     * class is used, to amortize the wake-ups */
+    refill = qpage_zero_g.len[class] <= depth / 2;
+    spin_unlock(&qpage_zero_g.lock);
+
+    if (res) {
+        atomic_fetch_add(&qpage_zero_g.hits, 1);
+        mem_tool_allow_memory(res, npages * QPAGE_SIZE, true);
+    } else {
+        atomic_fetch_add(&qpage_zero_g.misses, 1);
+        atomic_fetch_or(&qpage_zero_g.wanted, 1U << class);
+    }
+    if (refill) {
+        thr_ec_signal_relaxed(&qpage_zero_g.ec);
+    }
+    return res;
+}
+
+/* Fill one missing run of each wanted class, returns whether some run was
+ * added. */
+static bool qpage_zero_refill(uint32_t depth)
+{
+    uint32_t wanted = atomic_load(&qpage_zero_g.wanted);
+    bool added = false;
+
+    for (uint32_t class = 0; class < CLASS_SMALL; class++) {
+        uint32_t npages = class + 1;
+        page_desc_t *blk;
+        page_run_t *run;
+        qpage_t *qp;
+        bool full;
+
+        if (!(wanted & (1U << class))) {
+            continue;
+        }
+        spin_lock(&qpage_zero_g.lock);
+        full = qpage_zero_g.len[class] >= depth;
+        spin_unlock(&qpage_zero_g.lock);
+        if (full) {
+            continue;
+        }
+
+        blk = qpage_alloc_align_impl(npages, 0, false, &run);
+        if (!blk) {
+            break;
+        }
+        qp = run->mem_pages + blk_no(blk);
+        p_clear(qp, npages);
+        mem_tool_disallow_memory(qp, npages * QPAGE_SIZE);
+
+        spin_lock(&qpage_zero_g.lock);
+        if (qpage_zero_g.len[class] < depth) {
+            qpage_cache_run_t *zrun;
+
+            zrun = &qpage_zero_g.runs[class][qpage_zero_g.len[class]++];
+            zrun->pages = qp;
+            zrun->seg   = run->segment;
+            qpage_zero_g.npages += npages;
+            qp = NULL;
+            added = true;
+        }
+        spin_unlock(&qpage_zero_g.lock);
+        if (qp) {
+            qpage_release(qp, npages, run->segment);
+        }
+    }
+    return added;
+}
+
+static void *qpage_zero_thread(void *arg)
+{
+#ifdef SCHED_IDLE
+    struct sched_param param = { .sched_priority = 0 };
+
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+    for (;;) {
+        uint32_t depth = atomic_load(&qpage_zero_g.depth);
+        uint64_t key;
+
+        if (!depth) {
+            break;
+        }
+        if (qpage_zero_refill(depth)) {
+            continue;
+        }
+        key = thr_ec_get(&qpage_zero_g.ec);
+        if (qpage_zero_refill(depth)) {
+            continue;
+        }
+        thr_ec_wait(&qpage_zero_g.ec, key);
+    }
+    return NULL;
+}
+
+static void qpage_zero_flush(void)
+{
+    spin_lock(&qpage_zero_g.lock);
+    for (uint32_t class = 0; class < CLASS_SMALL; class++) {
+        while (qpage_zero_g.len[class] > 0) {
+            qpage_cache_run_t *run;
+
+            run = &qpage_zero_g.runs[class][--qpage_zero_g.len[class]];
+            qpage_release(run->pages, class + 1, run->seg);
+        }
+    }
+    qpage_zero_g.npages = 0;
+    spin_unlock(&qpage_zero_g.lock);
+}
+
+int qpage_zero_reserve_set_depth(uint32_t depth)
+{
+    depth = MIN(depth, QPAGE_ZERO_RESERVE_MAX);
+    atomic_store(&qpage_zero_g.depth, depth);
+
+    if (!depth) {
+        if (qpage_zero_g.running) {
+            thr_ec_broadcast(&qpage_zero_g.ec);
+            pthread_join(qpage_zero_g.thread, NULL);
+            qpage_zero_g.running = false;
+        }
+        qpage_zero_flush();
+        atomic_store(&qpage_zero_g.wanted, 0);
+        return 0;
+    }
+
+    if (!qpage_zero_g.running) {
+        if (thr_create(&qpage_zero_g.thread, NULL, &qpage_zero_thread,
+                       NULL) != 0)
+        {
+            atomic_store(&qpage_zero_g.depth, 0);
+            return -1;
+        }
+        qpage_zero_g.running = true;
+    }
+    thr_ec_signal(&qpage_zero_g.ec);
+    return 0;
+}
+
+void qpage_zero_reserve_stats(qpage_zero_reserve_stats_t *stats)
+{
+    p_clear(stats, 1);
+    stats->depth  = atomic_load(&qpage_zero_g.depth);
+    stats->hits   = atomic_load(&qpage_zero_g.hits);
+    stats->misses = atomic_load(&qpage_zero_g.misses);
+
+    spin_lock(&qpage_zero_g.lock);
+    for (uint32_t class = 0; class < CLASS_SMALL; class++) {
+        stats->runs += qpage_zero_g.len[class];
+    }
+    stats->pages = qpage_zero_g.npages;
+    spin_unlock(&qpage_zero_g.lock);
+}
+
+static void qpage_zero_fix_at_fork(void)
+{
+    /* The background thread does not survive a fork, its reserve is kept
+     * but not refilled until qpage_zero_reserve_set_depth() is called. */
+    if (qpage_zero_g.running) {
+        qpage_zero_g.running = false;
+        thr_ec_init(&qpage_zero_g.ec);
+    }
+}
+
+__attribute__((constructor))
+static void qpage_zero_init(void)
+{
+    thr_ec_init(&qpage_zero_g.ec);
+    pthread_atfork(NULL, NULL, &qpage_zero_fix_at_fork);
+}
+
+/* }}} */
+
 void *qpage_allocraw_align(size_t npages, size_t shift, uint32_t *seg)
 {
     page_run_t  *run;
     page_desc_t *blk;
+    void *res;
 
+    if ((res = qpage_cache_get(npages, shift, false, seg))) {
+        return res;
+    }
     blk = RETHROW_P(qpage_alloc_align_impl(npages, shift, false, &run));
     if (seg)
         *seg = run->segment;
@@ -554,7 +1125,14 @@ void *qpage_alloc_align(size_t npages, size_t shift, uint32_t *seg)
 {
     page_run_t  *run;
     page_desc_t *blk;
+    void *res;
 
+    if ((res = qpage_cache_get(npages, shift, true, seg))) {
+        return res;
+    }
+    if ((res = qpage_zero_get(npages, shift, seg))) {
+        return res;
+    }
     blk = RETHROW_P(qpage_alloc_align_impl(npages, shift, true, &run));
     if (seg)
         *seg = run->segment;
@@ -607,14 +1185,17 @@ static void *remap(void *ptr, size_t old_n, uint32_t old_seg,
     spin_lock(&_G.lock);
     next = blk_next(blk, bsz);
     if ((next->flags & BLK_FREE) && new_n <= bsz + blk_size(next)) {
-        bsz += blk_remove(next);
+        qpage_arena_t *arena = &_G.arenas[run->node];
+
+        bsz += blk_remove(arena, next);
         if (bsz > new_n) {
             tmp = blk_next(blk, new_n);
-            blk_insert(tmp, bsz - new_n);
+            blk_insert(arena, tmp, bsz - new_n);
         } else {
             next->flags &= ~BLK_PREV_FREE;
         }
         blk_setup_backptrs(blk, (blk->flags & BLK_PREV_FREE), new_n);
+        qpage_unlazy_pages(run, blk_no(blk) + old_n, new_n - old_n);
         spin_unlock(&_G.lock);
         mem_tool_allow_memory(qp + old_n, (new_n - old_n) * QPAGE_SIZE, zero);
 
@@ -668,10 +1249,23 @@ void *qpage_remap(void *ptr, size_t old_n, uint32_t old_seg,
     return remap(ptr, old_n, old_seg, new_n, new_seg, may_move, true);
 }
 
+static void qpage_release(qpage_t *qp, size_t npages, uint32_t seg)
+{
+    page_desc_t *blk, *tmp;
+    page_run_t *run;
+
+    tmp   = _G.segs.tab[seg];
+    run   = run_of(tmp, blk_no(tmp));
+    blk   = run->pages + (qp - run->mem_pages);
+    assert (blk + npages <= run->pages + run->npages);
+    assert (!(blk->flags & BLK_FREE));
+    free_n(run, blk, npages, seg);
+}
+
 void qpage_free_n(void *ptr, size_t npages, uint32_t seg)
 {
     qpage_t *qp = ptr;
-    page_desc_t *blk, *tmp;
+    page_desc_t *tmp;
     page_run_t *run;
 
     if (!ptr)
@@ -682,10 +1276,17 @@ void qpage_free_n(void *ptr, size_t npages, uint32_t seg)
     }
     tmp   = _G.segs.tab[seg];
     run   = run_of(tmp, blk_no(tmp));
-    blk   = run->pages + (qp - run->mem_pages);
-    assert (blk + npages <= run->pages + run->npages);
-    assert (!(blk->flags & BLK_FREE));
-    free_n(run, blk, npages, seg);
+    if (qpage_cache_put(qp, run->pages + (qp - run->mem_pages), npages, seg)) {
+        return;
+    }
+    qpage_release(qp, npages, seg);
+}
+
+void qpage_set_huge_pages(bool enable)
+{
+    spin_lock(&_G.lock);
+    _G.huge_pages = enable;
+    spin_unlock(&_G.lock);
 }
 
 void *qpage_dup_n(const void *ptr, size_t n, uint32_t *seg)
@@ -699,22 +1300,145 @@ void *qpage_dup_n(const void *ptr, size_t n, uint32_t *seg)
 
 static int qpage_initialize(void *arg)
 {
+    bool huge_pages = _G.huge_pages;
+
     p_clear(&_G, 1);
-    _G.bits = p_new(size_t, BITS_LEN);
-    _G.blks = p_new(page_desc_t *, CLASSES);
+    _G.huge_pages = huge_pages;
+    qpage_get_arena(0);
     return 0;
 }
 
 static int qpage_shutdown(void)
 {
+    /* The caches of the other threads are expected to be flushed by their
+     * thr_detach() before the module is shut down. */
+    qpage_cache_wipe();
+    qpage_zero_reserve_set_depth(0);
     for (int i = 0; i < _G.segs.len; i++) {
-        free(run_of(_G.segs.tab[i], 0));
+        page_run_t *run = run_of(_G.segs.tab[i], 0);
+
+        free(run->lazy_since);
+        free(run);
     }
     qv_wipe(&_G.segs);
-    p_delete(&_G.bits);
-    p_delete(&_G.blks);
+    carray_for_each_ptr(arena, _G.arenas) {
+        p_delete(&arena->bits);
+        p_delete(&arena->blks);
+    }
     return 0;
 }
 
+/* {{{ Module (for print_state method) */
+
+static void core_mem_qpage_decay_print_state(void)
+{
+    uint64_t lazy_bytes;
+    uint64_t decayed_bytes;
+
+    qpage_decay_stats(&lazy_bytes, &decayed_bytes);
+    if (!lazy_bytes && !decayed_bytes) {
+        return;
+    }
+    logger_notice(&qpage_caches_g.logger, "qpage free pages: %ju bytes "
+                  "lazily freed, %ju bytes decayed", lazy_bytes,
+                  decayed_bytes);
+}
+
+static void core_mem_qpage_zero_print_state(void)
+{
+    qpage_zero_reserve_stats_t stats;
+
+    qpage_zero_reserve_stats(&stats);
+    if (!stats.depth && !stats.hits && !stats.misses) {
+        return;
+    }
+    logger_notice(&qpage_caches_g.logger, "qpage zero reserve: depth %u, "
+                  "%u runs (%ju pages), %ju hits, %ju misses", stats.depth,
+                  stats.runs, stats.pages, stats.hits, stats.misses);
+}
+
+static void core_mem_qpage_print_state(void)
+{
+    t_scope;
+    qv_t(table_hdr) hdr;
+    qv_t(table_data) rows;
+    table_hdr_t hdr_data[] = { {
+            .title = LSTR_IMMED("THREAD"),
+        }, {
+            .title = LSTR_IMMED("CACHED PAGES"),
+        }, {
+            .title = LSTR_IMMED("HITS"),
+        }, {
+            .title = LSTR_IMMED("MISSES"),
+        }
+    };
+    uint32_t hdr_size = countof(hdr_data);
+    uint64_t total_npages = 0;
+    uint64_t total_hits;
+    uint64_t total_misses;
+    SB_1k(buf);
+
+    core_mem_qpage_decay_print_state();
+    core_mem_qpage_zero_print_state();
+
+    qv_init_static(&hdr, hdr_data, hdr_size);
+    t_qv_init(&rows, 64);
+
+#define ADD_NUMBER_FIELD(_what)  \
+    do {                                                                     \
+        t_SB(_buf, 16);                                                      \
+                                                                             \
+        sb_add_int_fmt(&_buf, _what, ',');                                   \
+        qv_append(tab, LSTR_SB_V(&_buf));                                    \
+    } while (0)
+
+    spin_lock(&qpage_caches_g.all_caches_lock);
+
+    total_hits   = qpage_caches_g.hits;
+    total_misses = qpage_caches_g.misses;
+    dlist_for_each_entry(qpage_cache_t, cache, &qpage_caches_g.all_caches,
+                         cache_list)
+    {
+        qv_t(lstr) *tab = qv_growlen(&rows, 1);
+
+        t_qv_init(tab, hdr_size);
+        qv_append(tab, t_lstr_fmt("%lx", (unsigned long)cache->pthread_id));
+
+        ADD_NUMBER_FIELD(cache->npages);
+        ADD_NUMBER_FIELD(cache->hits);
+        ADD_NUMBER_FIELD(cache->misses);
+
+        total_npages += cache->npages;
+        total_hits   += cache->hits;
+        total_misses += cache->misses;
+    }
+
+    spin_unlock(&qpage_caches_g.all_caches_lock);
+
+    if (!total_hits && !total_misses) {
+        return;
+    }
+
+    {
+        qv_t(lstr) *tab = qv_growlen(&rows, 1);
+
+        t_qv_init(tab, hdr_size);
+        qv_append(tab, LSTR("TOTAL"));
+
+        ADD_NUMBER_FIELD(total_npages);
+        ADD_NUMBER_FIELD(total_hits);
+        ADD_NUMBER_FIELD(total_misses);
+    }
+
+    sb_add_table(&buf, &hdr, &rows);
+    sb_shrink(&buf, 1);
+    logger_notice(&qpage_caches_g.logger, "qpage thread caches summary:\n%*pM",
+                  SB_FMT_ARG(&buf));
+#undef ADD_NUMBER_FIELD
+}
+
 MODULE_BEGIN(qpage)
+    MODULE_IMPLEMENTS_VOID(print_state, &core_mem_qpage_print_state);
 MODULE_END()
+
+/* }}} */
@@ -392,6 +392,257 @@ void qps_bitmap_compute_stats(qps_bitmap_t *map, size_t *_memory,
     *_slots   = slots;
 }
 
+/* }}} */
+/* Bulk operations {{{ */
+
+typedef enum qps_bitmap_op_t {
+    QPS_BITMAP_OP_AND,
+    QPS_BITMAP_OP_OR,
+    QPS_BITMAP_OP_ANDNOT,
+} qps_bitmap_op_t;
+
+/* Combine a leaf of src in a leaf of dst, return the number of bits set in
+ * the result; the loops are vectorized by the compiler. */
+static uint32_t combine_leaf(uint64_t *dst, const uint64_t *src,
+                             qps_bitmap_op_t op)
+{
+    switch (op) {
+      case QPS_BITMAP_OP_AND:
+        for (int i = 0; i < QPS_BITMAP_WORD; i++) {
+            dst[i] &= src[i];
+        }
+        break;
+      case QPS_BITMAP_OP_OR:
+        for (int i = 0; i < QPS_BITMAP_WORD; i++) {
+            dst[i] |= src[i];
+        }
+        break;
+      case QPS_BITMAP_OP_ANDNOT:
+        for (int i = 0; i < QPS_BITMAP_WORD; i++) {
+            dst[i] &= ~src[i];
+        }
+        break;
+    }
+    return membitcount(dst, QPS_PAGE_SIZE);
+}
+
+static void combine_dispatch(qps_bitmap_t *dst, qps_bitmap_t *src,
+                             int root, qps_bitmap_op_t op)
+{
+    qps_bitmap_node_t dst_node = dst->root->roots[root];
+    qps_bitmap_node_t src_node = src->root->roots[root];
+    const qps_bitmap_dispatch_t *src_dispatch = NULL;
+    qps_bitmap_dispatch_t *dispatch;
+    bool empty = true;
+
+    if (src_node) {
+        src_dispatch = qps_pg_deref(src->qps, src_node);
+    } else
+    if (op != QPS_BITMAP_OP_AND) {
+        return;
+    }
+    if (!dst_node) {
+        if (op != QPS_BITMAP_OP_OR) {
+            return;
+        }
+        dst_node = qps_pg_map(dst->qps, 3);
+        qps_pg_zero(dst->qps, dst_node, 3);
+        qps_hptr_w_deref(dst->qps, &dst->root_cache);
+        dst->root->roots[root] = dst_node;
+    }
+    dispatch = qps_pg_deref(dst->qps, dst_node);
+
+    for (int i = 0; i < QPS_BITMAP_DISPATCH; i++) {
+        qps_bitmap_node_t leaf = (*dispatch)[i].node;
+        qps_bitmap_node_t src_leaf = src_dispatch ? (*src_dispatch)[i].node
+                                                  : 0;
+
+        if (!leaf && src_leaf && op == QPS_BITMAP_OP_OR) {
+            leaf = qps_pg_map(dst->qps, 1);
+            memcpy(qps_pg_deref(dst->qps, leaf),
+                   qps_pg_deref(src->qps, src_leaf), QPS_PAGE_SIZE);
+            (*dispatch)[i].node        = leaf;
+            (*dispatch)[i].active_bits = (*src_dispatch)[i].active_bits;
+        } else
+        if (leaf && (src_leaf || op == QPS_BITMAP_OP_AND)) {
+            uint32_t bits = 0;
+
+            if (src_leaf) {
+                bits = combine_leaf(qps_pg_deref(dst->qps, leaf),
+                                    qps_pg_deref(src->qps, src_leaf), op);
+            }
+            if (bits) {
+                (*dispatch)[i].active_bits = bits;
+            } else {
+                qps_pg_unmap(dst->qps, leaf);
+                (*dispatch)[i].node        = 0;
+                (*dispatch)[i].active_bits = 0;
+            }
+        }
+        empty &= !(*dispatch)[i].node;
+    }
+
+    if (empty) {
+        qps_pg_unmap(dst->qps, dst_node);
+        qps_hptr_w_deref(dst->qps, &dst->root_cache);
+        dst->root->roots[root] = 0;
+    }
+}
+
+static void combine(qps_bitmap_t *dst, qps_bitmap_t *src, qps_bitmap_op_t op)
+{
+    dst->bitmap_gen++;
+    qps_hptr_deref(dst->qps, &dst->root_cache);
+    qps_hptr_deref(src->qps, &src->root_cache);
+    assert (!dst->root->is_nullable && !src->root->is_nullable);
+
+    for (int i = 0; i < QPS_BITMAP_ROOTS; i++) {
+        combine_dispatch(dst, src, i, op);
+    }
+}
+
+void qps_bitmap_and(qps_bitmap_t *dst, qps_bitmap_t *src)
+{
+    combine(dst, src, QPS_BITMAP_OP_AND);
+}
+
+void qps_bitmap_or(qps_bitmap_t *dst, qps_bitmap_t *src)
+{
+    combine(dst, src, QPS_BITMAP_OP_OR);
+}
+
+void qps_bitmap_andnot(qps_bitmap_t *dst, qps_bitmap_t *src)
+{
+    combine(dst, src, QPS_BITMAP_OP_ANDNOT);
+}
+
+uint64_t qps_bitmap_cardinality(qps_bitmap_t *map)
+{
+    uint64_t count = 0;
+
+    qps_hptr_deref(map->qps, &map->root_cache);
+    for (int i = 0; i < QPS_BITMAP_ROOTS; i++) {
+        const qps_bitmap_dispatch_t *dispatch;
+
+        if (map->root->roots[i] == 0) {
+            continue;
+        }
+        dispatch = qps_pg_deref(map->qps, map->root->roots[i]);
+        for (int j = 0; j < QPS_BITMAP_DISPATCH; j++) {
+            count += (*dispatch)[j].active_bits;
+        }
+    }
+    return count;
+}
+
+uint64_t qps_bitmap_and_cardinality(qps_bitmap_t *a, qps_bitmap_t *b)
+{
+    uint64_t count = 0;
+
+    qps_hptr_deref(a->qps, &a->root_cache);
+    qps_hptr_deref(b->qps, &b->root_cache);
+    assert (!a->root->is_nullable && !b->root->is_nullable);
+
+    for (int i = 0; i < QPS_BITMAP_ROOTS; i++) {
+        const qps_bitmap_dispatch_t *da;
+        const qps_bitmap_dispatch_t *db;
+
+        if (a->root->roots[i] == 0 || b->root->roots[i] == 0) {
+            continue;
+        }
+        da = qps_pg_deref(a->qps, a->root->roots[i]);
+        db = qps_pg_deref(b->qps, b->root->roots[i]);
+        for (int j = 0; j < QPS_BITMAP_DISPATCH; j++) {
+            const uint64_t *la;
+            const uint64_t *lb;
+
+            if ((*da)[j].node == 0 || (*db)[j].node == 0) {
+                continue;
+            }
+            la = qps_pg_deref(a->qps, (*da)[j].node);
+            lb = qps_pg_deref(b->qps, (*db)[j].node);
+            for (int k = 0; k < QPS_BITMAP_WORD; k++) {
+                count += bitcount64(la[k] & lb[k]);
+            }
+        }
+    }
+    return count;
+}
+
+uint64_t qps_bitmap_rank(qps_bitmap_t *map, uint32_t row)
+{
+    qps_bitmap_key_t key = { .key = row };
+    uint64_t rank = 0;
+
+    qps_hptr_deref(map->qps, &map->root_cache);
+    assert (!map->root->is_nullable);
+
+    for (unsigned i = 0; i <= key.root; i++) {
+        const qps_bitmap_dispatch_t *dispatch;
+        unsigned end = i < key.root ? QPS_BITMAP_DISPATCH : key.dispatch;
+
+        if (map->root->roots[i] == 0) {
+            continue;
+        }
+        dispatch = qps_pg_deref(map->qps, map->root->roots[i]);
+        for (unsigned j = 0; j < end; j++) {
+            rank += (*dispatch)[j].active_bits;
+        }
+        if (i == key.root && (*dispatch)[key.dispatch].node) {
+            const uint64_t *leaf;
+
+            leaf  = qps_pg_deref(map->qps, (*dispatch)[key.dispatch].node);
+            rank += membitcount(leaf, key.word * sizeof(uint64_t));
+            rank += bitcount64(leaf[key.word]
+                               & BITMASK_LT(uint64_t, key.bit));
+        }
+    }
+    return rank;
+}
+
+int qps_bitmap_select(qps_bitmap_t *map, uint64_t rank, uint32_t *row)
+{
+    qps_hptr_deref(map->qps, &map->root_cache);
+    assert (!map->root->is_nullable);
+
+    for (int i = 0; i < QPS_BITMAP_ROOTS; i++) {
+        const qps_bitmap_dispatch_t *dispatch;
+
+        if (map->root->roots[i] == 0) {
+            continue;
+        }
+        dispatch = qps_pg_deref(map->qps, map->root->roots[i]);
+        for (int j = 0; j < QPS_BITMAP_DISPATCH; j++) {
+            const uint64_t *leaf;
+
+            if (rank >= (*dispatch)[j].active_bits) {
+                rank -= (*dispatch)[j].active_bits;
+                continue;
+            }
+            leaf = qps_pg_deref(map->qps, (*dispatch)[j].node);
+            for (int k = 0; k < QPS_BITMAP_WORD; k++) {
+                uint64_t word = leaf[k];
+                qps_bitmap_key_t key;
+
+                if (rank >= bitcount64(word)) {
+                    rank -= bitcount64(word);
+                    continue;
+                }
+                for (; rank > 0; rank--) {
+                    word &= word - 1;
+                }
+                key.root     = i;
+                key.dispatch = j;
+                key.word     = k;
+                key.bit      = bsf64(word);
+                *row = key.key;
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
 /* }}} */
 /* Debugging tool {{{ */
 
@@ -0,0 +1,55 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/qps-bloom.h>
+
+static size_t qps_bloom_pages(uint32_t nb_blocks)
+{
+    return DIV_ROUND_UP((size_t)nb_blocks * BLOOM_BLOCK_WORDS * 4,
+                        QPS_PAGE_SIZE);
+}
+
+qps_handle_t qps_bloom_create(qps_t *qps, uint64_t nb_keys, double fpr)
+{
+    qps_bloom_root_t *root;
+    qps_hptr_t cache;
+    uint32_t nb_blocks = bloom_nb_blocks(nb_keys, fpr);
+
+    nb_blocks = MIN(nb_blocks, QPS_BLOOM_MAX_BLOCKS);
+    root = qps_hptr_alloc(qps, sizeof(qps_bloom_root_t), &cache);
+    p_clear(root, 1);
+    memcpy(root->sig, QPS_BLOOM_SIG, countof(root->sig));
+    root->nb_blocks = nb_blocks;
+    root->words = qps_pg_map(qps, qps_bloom_pages(nb_blocks));
+    qps_pg_zero(qps, root->words, qps_bloom_pages(nb_blocks));
+    return cache.handle;
+}
+
+void qps_bloom_destroy(qps_bloom_t *bf)
+{
+    qps_hptr_deref(bf->qps, &bf->root_cache);
+    qps_pg_unmap(bf->qps, bf->root->words);
+    qps_hptr_free(bf->qps, &bf->root_cache);
+}
+
+void qps_bloom_clear(qps_bloom_t *bf)
+{
+    qps_hptr_deref(bf->qps, &bf->root_cache);
+    qps_pg_zero(bf->qps, bf->root->words,
+                qps_bloom_pages(bf->root->nb_blocks));
+}
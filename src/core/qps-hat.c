@@ -149,6 +149,66 @@ static uint32_t qhat_compact_lookup(const qhat_compacthdr_t *header,
     return from + bisect32(key, header->keys + from, count, NULL);
 }
 
+static ALWAYS_INLINE uint32_t
+qhat_packed_key(const qhat_packedhdr_t *packed, uint32_t pos)
+{
+    uint64_t bit  = (uint64_t)pos * packed->key_bits;
+    uint64_t word = get_unaligned_le64(packed->keys + bit / 8);
+
+    word >>= bit % 8;
+    return packed->key_base + (word & BITMASK_LT(uint64_t, packed->key_bits));
+}
+
+static uint32_t qhat_packed_lookup(const qhat_packedhdr_t *packed,
+                                   uint32_t from, uint32_t key)
+{
+    uint32_t to = packed->count;
+
+    while (from < to) {
+        uint32_t mid = from + (to - from) / 2;
+
+        if (qhat_packed_key(packed, mid) < key) {
+            from = mid + 1;
+        } else {
+            to = mid;
+        }
+    }
+    return from;
+}
+
+static ALWAYS_INLINE const void *
+qhat_packed_values(const qhat_packedhdr_t *packed)
+{
+    return (const byte *)packed + packed->values_offset;
+}
+
+/* The packed leaves are the compact leaves that use less pages. */
+static ALWAYS_INLINE bool qhat_node_is_packed(const qhat_t *hat,
+                                              qhat_node_t node)
+{
+    return node.leaf && node.compact && unlikely(hat->root->has_packed)
+        && qps_pg_sizeof(hat->qps, node.page) < hat->desc->pages_per_compact;
+}
+
+static ALWAYS_INLINE uint32_t
+qhat_compact_key(qhat_node_const_memory_t memory, bool packed, uint32_t pos)
+{
+    if (packed) {
+        return qhat_packed_key(memory.packed, pos);
+    }
+    return memory.compact->keys[pos];
+}
+
+static ALWAYS_INLINE uint32_t
+qhat_leaf_lookup(qhat_node_const_memory_t memory, bool packed,
+                 uint32_t from, uint32_t key)
+{
+    if (packed) {
+        return qhat_packed_lookup(memory.packed, from, key);
+    }
+    return qhat_compact_lookup(memory.compact, from, key);
+}
+
 static uint32_t qhat_depth_shift(const qhat_t *hat, uint32_t depth)
 {
     /* depth 0: shift (20 + leaf_bits)
@@ -270,11 +330,12 @@ qhat_flat_check_consistency(qhat_t *hat, uint32_t from, uint32_t to,
 
 static __must_check__ int
 qhat_compact_check_consistency(qhat_t *hat, uint32_t from, uint32_t to,
-                               qhat_node_memory_t memory,
+                               qhat_node_memory_t memory, bool packed,
                                int flags,
                                bool *nullable is_suboptimal)
 {
     int64_t prev_key = -1;
+    qhat_node_const_memory_t values;
 
     if (flags & QHAT_CHECK_CONTENT) {
         SUBOPTIMAL(memory.compact->count > 0);
@@ -286,8 +347,16 @@ qhat_compact_check_consistency(qhat_t *hat, uint32_t from, uint32_t to,
              "compact overflow: %u > %u",
              memory.compact->count, hat->desc->leaves_per_compact);
 
+    if (packed) {
+        values.raw = qhat_packed_values(memory.packed);
+    } else {
+#define CASE(Size, Compact, Flat)  values.raw = Compact->values;
+        QHAT_VALUE_LEN_SWITCH(hat, memory, CASE);
+#undef CASE
+    }
+
     for (uint32_t i = 0; i < memory.compact->count; i++) {
-        uint32_t k = memory.compact->keys[i];
+        uint32_t k = qhat_compact_key(memory.cst, packed, i);
 
         CRITICAL(k > prev_key, "bad key order: [%d]%jx >= [%d]%x",
                  i - 1, prev_key, i, k);
@@ -295,8 +364,8 @@ qhat_compact_check_consistency(qhat_t *hat, uint32_t from, uint32_t to,
                  i, k, from, to);
 
         if (flags & QHAT_CHECK_CONTENT) {
-#define CASE(Size, Compact, Flat)  SUBOPTIMAL(!IS_ZERO(Size, Compact->values[i]));
-            QHAT_VALUE_LEN_SWITCH(hat, memory, CASE);
+#define CASE(Size, Compact, Flat)  SUBOPTIMAL(!IS_ZERO(Size, Flat[i]));
+            QHAT_VALUE_LEN_SWITCH(hat, values, CASE);
 #undef CASE
         }
 
@@ -364,6 +433,7 @@ qhat_node_check_child(qhat_t *hat, uint32_t key, uint32_t from,
 
     page_sz = qps_pg_sizeof(hat->qps, node.page);
     if (node.leaf && node.compact) {
+        bool packed = qhat_node_is_packed(hat, node);
         size_t exp_size;
 
 #define CASE(Size, Compact, Flat)                                            \
@@ -371,6 +441,11 @@ qhat_node_check_child(qhat_t *hat, uint32_t key, uint32_t from,
 
         QHAT_VALUE_LEN_SWITCH(hat, memory, CASE);
 #undef CASE
+        if (packed) {
+            exp_size = DIV_ROUND_UP(memory.packed->values_offset
+                                    + memory.packed->count
+                                    * hat->desc->value_len, QHAT_SIZE);
+        }
 
         CRITICAL(page_sz == exp_size, "bad page size for compact %zu != %zu",
                  page_sz, exp_size);
@@ -380,7 +455,8 @@ qhat_node_check_child(qhat_t *hat, uint32_t key, uint32_t from,
                  "%u != %u", memory.compact->parent_right, to);
 
         RETHROW(qhat_compact_check_consistency(hat, key_from, key_to,
-                                               memory, flags, is_suboptimal));
+                                               memory, packed, flags,
+                                               is_suboptimal));
     } else if (node.leaf) {
         size_t exp_size;
 
@@ -511,8 +587,11 @@ static void qhat_update_parent(qhat_path_t *path, qhat_node_t to);
 static ALWAYS_INLINE
 qhat_node_memory_t qhat_node_w_deref_(qps_t *qps, qhat_node_t node)
 {
+    void *raw = qps_pg_deref(qps, node.page);
+
+    qps_heat_touch(qps, raw);
     return (qhat_node_memory_t){
-        .raw = qps_pg_deref(qps, node.page),
+        .raw = raw,
     };
 }
 
@@ -1046,6 +1125,54 @@ static void qhat_optimize_parent(qhat_path_t *path)
     }
 }
 
+/* Append the entries of a packed leaf to a compact leaf. */
+static void qhat_packed_append(qhat_t *hat, qhat_node_memory_t memory,
+                               const qhat_packedhdr_t *packed)
+{
+    qhat_compacthdr_t *compact = memory.compact;
+    void *values;
+
+#define CASE(Size, Compact, Flat)  values = Compact->values + Compact->count;
+    QHAT_VALUE_LEN_SWITCH(hat, memory, CASE);
+#undef CASE
+
+    for (uint32_t i = 0; i < packed->count; i++) {
+        compact->keys[compact->count + i] = qhat_packed_key(packed, i);
+    }
+    memcpy(values, qhat_packed_values(packed),
+           packed->count * hat->desc->value_len);
+    compact->count += packed->count;
+}
+
+/* Build the compact leaf of a packed leaf, the caller replaces the packed
+ * leaf by it in the parent. */
+static qhat_node_t qhat_unpack_leaf(qhat_t *hat, qhat_node_t node)
+{
+    qhat_node_t leaf = qhat_alloc_leaf(hat, true);
+    qhat_node_memory_t memory = qhat_node_w_deref_(hat->qps, leaf);
+    const qhat_packedhdr_t *packed = qhat_node_deref_(hat->qps, node).packed;
+
+    memory.compact->count        = 0;
+    memory.compact->parent_left  = packed->parent_left;
+    memory.compact->parent_right = packed->parent_right;
+    qhat_packed_append(hat, memory, packed);
+    e_named_trace(2, "trie/unpack", "unpacked leaf %u in %u", node.page,
+                  leaf.page);
+    return leaf;
+}
+
+/* Unpack the leaf of a path before modifying it. */
+static void qhat_unpack_path(qhat_path_t *path)
+{
+    qhat_node_t packed = PATH_NODE(path);
+    qhat_node_t leaf = qhat_unpack_leaf(path->hat, packed);
+
+    qhat_update_parent(path, leaf);
+    qhat_unmap_node(path->hat, packed);
+    PATH_NODE(path) = leaf;
+    PATH_STRUCTURE_CHANGED("trie/unpack", path);
+}
+
 static void qhat_merge_nodes(qhat_path_t *path, qhat_node_t second)
 {
     qhat_path_t second_path = *path;
@@ -1061,6 +1188,14 @@ static void qhat_merge_nodes(qhat_path_t *path, qhat_node_t second)
     first_memory  = qhat_node_w_deref(path);
     second_memory = qhat_node_deref(&second_path);
 
+    if (qhat_node_is_packed(path->hat, second)) {
+        qhat_packed_append(path->hat, first_memory, second_memory.packed);
+        e_named_trace(2, "trie/optimize/merge", "merged leaf %u in %u",
+                      second.page, PATH_NODE(path).page);
+        qhat_unmap_node(path->hat, second);
+        return;
+    }
+
 #define CASE(Size, Compact, Flat)                                  \
     qhat_compact##Size##_t *first_compact = first_memory.compact##Size;      \
     p_copy(first_compact->keys + first_compact->count,                       \
@@ -1167,6 +1302,12 @@ void qhat_optimize(qhat_path_t *path)
                       PATH_NODE(path).page, from_idx, to_idx, path->depth, max);
 
         PATH_NODE(path) = previous_node = memory.nodes[from_idx];
+        if (qhat_node_is_packed(path->hat, previous_node)) {
+            /* the other slots of the packed leaf are updated below */
+            PATH_NODE(path) = qhat_unpack_leaf(path->hat, previous_node);
+            memory.nodes[from_idx] = PATH_NODE(path);
+            qhat_unmap_node(path->hat, previous_node);
+        }
         for (uint32_t i = from_idx + 1; i < to_idx; i++) {
             qhat_node_t current_node = memory.nodes[i];
             if (current_node.value != previous_node.value
@@ -1358,6 +1499,463 @@ void qhat_unload(qhat_t *hat)
     }
 }
 
+/* }}} */
+/* Bulk load {{{ */
+
+static qhat_node_t qhat_bulk_leaf(qhat_t *hat, bool compact,
+                                  const uint32_t *keys, const byte *values,
+                                  uint32_t count, uint32_t from, uint32_t to)
+{
+    qhat_node_t node = qhat_alloc_leaf(hat, compact);
+    qhat_node_memory_t memory = qhat_node_w_deref_(hat->qps, node);
+    uint32_t vlen = hat->desc->value_len;
+
+    if (compact) {
+#define CASE(Size, Compact, Flat)                                            \
+        Compact->count        = count;                                       \
+        Compact->parent_left  = from;                                        \
+        Compact->parent_right = to;                                          \
+        p_copy(Compact->keys, keys, count);                                  \
+        memcpy(Compact->values, values, count * vlen);
+
+        QHAT_VALUE_LEN_SWITCH(hat, memory, CASE);
+#undef CASE
+        if (hat->do_stats) {
+            hat->root->key_stored_count += count;
+        }
+    } else {
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t pos = keys[i] & hat->desc->leaf_index_mask;
+
+            memcpy(memory.u8 + pos * vlen, values + i * vlen, vlen);
+        }
+        if (hat->do_stats) {
+            hat->root->zero_stored_count += hat->desc->leaves_per_flat
+                                          - count;
+        }
+    }
+    return node;
+}
+
+/* Count the keys from `pos` that fall in the same slot at `depth`. */
+static uint32_t qhat_bulk_slot_end(qhat_t *hat, const uint32_t *keys,
+                                   uint32_t pos, uint32_t count,
+                                   uint32_t depth)
+{
+    uint32_t slot = qhat_get_key_bits(hat, keys[pos], depth);
+
+    while (pos < count && qhat_get_key_bits(hat, keys[pos], depth) == slot) {
+        pos++;
+    }
+    return pos;
+}
+
+/* Fill the slots of a dispatch node (or of the root) with the keys.
+ *
+ * The consecutive slots are packed in the same compact leaf while its keys
+ * stay under the split threshold. A slot with more keys gets a flat leaf at
+ * the last level, and a dispatch node filled the same way otherwise.
+ */
+static void qhat_bulk_dispatch(qhat_t *hat, qhat_node_t *nodes,
+                               uint32_t depth, const uint32_t *keys,
+                               const byte *values, uint32_t count)
+{
+    const uint32_t threshold = hat->desc->split_compact_threshold;
+    const uint32_t vlen = hat->desc->value_len;
+    uint32_t pos = 0;
+
+    while (pos < count) {
+        uint32_t from = qhat_get_key_bits(hat, keys[pos], depth);
+        uint32_t end  = qhat_bulk_slot_end(hat, keys, pos, count, depth);
+        uint32_t last = from;
+        qhat_node_t leaf;
+
+        if (end - pos > threshold) {
+            if (depth == QHAT_DEPTH_MAX - 1) {
+                nodes[from] = qhat_bulk_leaf(hat, false, keys + pos,
+                                             values + pos * vlen, end - pos,
+                                             from, from + 1);
+            } else {
+                qhat_node_t node = qhat_alloc_node(hat);
+                qhat_node_memory_t memory;
+
+                memory = qhat_node_w_deref_(hat->qps, node);
+                p_clear(memory.nodes, QHAT_COUNT);
+                nodes[from] = node;
+                qhat_bulk_dispatch(hat, memory.nodes, depth + 1, keys + pos,
+                                   values + pos * vlen, end - pos);
+            }
+            pos = end;
+            continue;
+        }
+
+        while (end < count) {
+            uint32_t next = qhat_bulk_slot_end(hat, keys, end, count, depth);
+
+            if (next - pos > threshold) {
+                break;
+            }
+            last = qhat_get_key_bits(hat, keys[end], depth);
+            end  = next;
+        }
+        leaf = qhat_bulk_leaf(hat, true, keys + pos, values + pos * vlen,
+                              end - pos, from, last + 1);
+        for (uint32_t i = from; i <= last; i++) {
+            nodes[i] = leaf;
+        }
+        pos = end;
+    }
+}
+
+int qhat_bulk_load(qhat_t *hat, const uint32_t *keys, const void *values,
+                   uint32_t count)
+{
+    const uint32_t vlen = hat->desc->value_len;
+    const byte *vals = values;
+    uint32_t *nz_keys = NULL;
+    byte *nz_vals = NULL;
+    uint32_t nz = 0;
+
+    qps_hptr_w_deref(hat->qps, &hat->root_cache);
+    for (uint32_t i = 0; i < hat->desc->root_node_count; i++) {
+        THROW_ERR_IF(hat->root->nodes[i].value);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        THROW_ERR_IF(i > 0 && keys[i - 1] >= keys[i]);
+        if (!is_memory_zero(vals + i * vlen, vlen)) {
+            nz++;
+        }
+    }
+
+    /* zeros are not stored in the leaves */
+    if (nz < count) {
+        nz_keys = p_new_raw(uint32_t, nz);
+        nz_vals = p_new_raw(byte, nz * vlen);
+        for (uint32_t i = 0, j = 0; i < count; i++) {
+            if (!is_memory_zero(vals + i * vlen, vlen)) {
+                nz_keys[j] = keys[i];
+                memcpy(nz_vals + j * vlen, vals + i * vlen, vlen);
+                j++;
+            }
+        }
+    }
+
+    qhat_bulk_dispatch(hat, hat->root->nodes, 0, nz_keys ?: keys,
+                       nz_vals ?: vals, nz);
+    if (hat->do_stats) {
+        hat->root->entry_count += nz;
+    }
+    hat->struct_gen++;
+    p_delete(&nz_keys);
+    p_delete(&nz_vals);
+
+    if (hat->root->is_nullable) {
+        for (uint32_t i = 0; i < count; i++) {
+            qps_bitmap_set(&hat->bitmap, keys[i]);
+        }
+    }
+    CHECK_CONSISTENCY(hat);
+    return 0;
+}
+
+/* }}} */
+/* Packed leaves {{{ */
+
+/* Pack a compact leaf when that saves pages, return the packed leaf, or the
+ * compact leaf itself. */
+static qhat_node_t qhat_pack_leaf(qhat_t *hat, qhat_node_t node)
+{
+    qhat_node_const_memory_t memory = qhat_node_deref_(hat->qps, node);
+    uint32_t count = memory.compact->count;
+    qhat_node_memory_t packed;
+    const void *values;
+    uint32_t offset;
+    uint32_t pages;
+    uint8_t bits = 0;
+    qps_pg_t page;
+
+    if (count == 0) {
+        return node;
+    }
+    if (count > 1) {
+        bits = bsr32(memory.compact->keys[count - 1]
+                     - memory.compact->keys[0]) + 1;
+    }
+    /* keep 8 bytes after the keys for the unaligned loads of qhat_get() */
+    offset = sizeof(qhat_packedhdr_t)
+           + ROUND_UP(DIV_ROUND_UP(count * bits, 8) + 8, 16);
+    pages  = DIV_ROUND_UP(offset + count * hat->desc->value_len,
+                          QPS_PAGE_SIZE);
+    if (pages >= hat->desc->pages_per_compact) {
+        return node;
+    }
+
+    page = qps_pg_map(hat->qps, pages);
+    qps_pg_zero(hat->qps, page, pages);
+    packed.raw = qps_pg_deref(hat->qps, page);
+    packed.packed->count         = count;
+    packed.packed->parent_left   = memory.compact->parent_left;
+    packed.packed->parent_right  = memory.compact->parent_right;
+    packed.packed->key_base      = memory.compact->keys[0];
+    packed.packed->key_bits      = bits;
+    packed.packed->values_offset = offset;
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t delta = memory.compact->keys[i] - memory.compact->keys[0];
+        uint64_t bit   = (uint64_t)i * bits;
+        uint8_t *p     = packed.packed->keys + bit / 8;
+
+        put_unaligned_le64(p, get_unaligned_le64(p) | delta << (bit % 8));
+    }
+
+#define CASE(Size, Compact, Flat)  values = Compact->values;
+    QHAT_VALUE_LEN_SWITCH(hat, memory, CASE);
+#undef CASE
+    memcpy(packed.u8 + offset, values, count * hat->desc->value_len);
+
+    /* a packed leaf is still counted as a compact one */
+    qps_pg_unmap(hat->qps, node.page);
+    return (qhat_node_t){
+        {
+            .page    = page,
+            .leaf    = true,
+            .compact = true,
+        }
+    };
+}
+
+static uint64_t qhat_pack_nodes(qhat_t *hat, qhat_node_t *nodes,
+                                uint32_t max)
+{
+    uint64_t saved = 0;
+
+    for (uint32_t i = 0; i < max; ) {
+        qhat_node_t node = nodes[i];
+        qhat_node_t packed;
+        uint32_t right;
+
+        if (!node.leaf || !node.compact) {
+            if (node.value && !node.leaf) {
+                saved += qhat_pack_nodes(hat,
+                                         qhat_node_w_deref_(hat->qps,
+                                                            node).nodes,
+                                         QHAT_COUNT);
+            }
+            i++;
+            continue;
+        }
+
+        /* the compact leaves span the slots [parent_left, parent_right) */
+        right = qhat_node_deref_(hat->qps, node).compact->parent_right;
+        if (!qhat_node_is_packed(hat, node)) {
+            packed = qhat_pack_leaf(hat, node);
+            if (packed.value != node.value) {
+                saved += QPS_PAGE_SIZE
+                       * (hat->desc->pages_per_compact
+                          - qps_pg_sizeof(hat->qps, packed.page));
+                for (uint32_t j = i; j < right; j++) {
+                    nodes[j] = packed;
+                }
+            }
+        }
+        i = right;
+    }
+    return saved;
+}
+
+static uint64_t qhat_packed_saved(const qhat_t *hat, const qhat_node_t *nodes,
+                                  uint32_t max)
+{
+    uint64_t saved = 0;
+
+    for (uint32_t i = 0; i < max; i++) {
+        qhat_node_t node = nodes[i];
+
+        if (!node.value || (i > 0 && node.value == nodes[i - 1].value)) {
+            continue;
+        }
+        if (!node.leaf) {
+            saved += qhat_packed_saved(hat,
+                                       qhat_node_deref_(hat->qps,
+                                                        node).nodes,
+                                       QHAT_COUNT);
+        } else
+        if (qhat_node_is_packed(hat, node)) {
+            saved += QPS_PAGE_SIZE
+                   * (hat->desc->pages_per_compact
+                      - qps_pg_sizeof(hat->qps, node.page));
+        }
+    }
+    return saved;
+}
+
+uint64_t qhat_pack(qhat_t *hat)
+{
+    uint64_t saved;
+
+    qps_hptr_w_deref(hat->qps, &hat->root_cache);
+    hat->root->has_packed = true;
+    saved = qhat_pack_nodes(hat, hat->root->nodes,
+                            hat->desc->root_node_count);
+    hat->struct_gen++;
+    return saved;
+}
+
+/* }}} */
+/* Batched lookups {{{ */
+
+/* Distance, in keys, between the stages of the prefetching. */
+#define QHAT_PREFETCH_DIST  8
+
+/* Prefetch the next node of the path of a key: walk `levels` dispatch nodes
+ * (that previous calls prefetched) and prefetch the slot of the next one,
+ * or the leaf when it is reached. */
+static ALWAYS_INLINE
+void qhat_prefetch_path(qhat_t *hat, uint32_t key, uint32_t levels)
+{
+    qhat_node_t node = hat->root->nodes[qhat_get_key_bits(hat, key, 0)];
+
+    for (uint32_t depth = 1; node.value; depth++) {
+        qhat_node_const_memory_t memory = qhat_node_deref_(hat->qps, node);
+
+        if (node.leaf) {
+            if (node.compact) {
+                __builtin_prefetch(memory.compact);
+            } else {
+                __builtin_prefetch(memory.u8 + hat->desc->value_len
+                                   * (key & hat->desc->leaf_index_mask));
+            }
+            return;
+        }
+        if (depth > levels) {
+            __builtin_prefetch(&memory.nodes[qhat_get_key_bits(hat, key,
+                                                               depth)]);
+            return;
+        }
+        node = memory.nodes[qhat_get_key_bits(hat, key, depth)];
+    }
+}
+
+static ALWAYS_INLINE
+void qhat_prefetch_key(qhat_t *hat, const uint32_t *keys, uint32_t pos,
+                       uint32_t count, uint32_t levels)
+{
+    uint32_t shift = hat->desc->leaf_index_bits;
+
+    /* the keys of the same leaf as the previous one are already there */
+    if (pos < count && (!pos || keys[pos] >> shift != keys[pos - 1] >> shift))
+    {
+        qhat_prefetch_path(hat, keys[pos], levels);
+    }
+}
+
+void qhat_get_many(qhat_t *hat, const uint32_t *keys, uint32_t count,
+                   const void **out)
+{
+    const uint32_t dist = QHAT_PREFETCH_DIST;
+    qhat_path_t path;
+    uint32_t prefix = 0;
+
+    qps_hptr_deref(hat->qps, &hat->root_cache);
+    qhat_path_init(&path, hat, 0);
+
+    for (uint32_t i = 0; i < MIN(count, 3 * dist); i++) {
+        qhat_prefetch_key(hat, keys, i, count, 0);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        qhat_prefetch_key(hat, keys, i + dist, count, 2);
+        qhat_prefetch_key(hat, keys, i + 2 * dist, count, 1);
+        qhat_prefetch_key(hat, keys, i + 3 * dist, count, 0);
+
+        /* reuse the path of the previous key when it leads to the same
+         * node, the lookup is done again otherwise */
+        if (!i || qhat_depth_prefix(hat, keys[i], path.depth) != prefix) {
+            path.generation = 0;
+        }
+        path.key = keys[i];
+        out[i] = qhat_get_path(&path);
+        prefix = qhat_depth_prefix(hat, keys[i], path.depth);
+    }
+}
+
+/* }}} */
+/* Parallel enumeration {{{ */
+
+typedef struct qhat_split_t {
+    qv_t(qhat_range) *ranges;
+    uint32_t count;
+    uint64_t total;
+    uint64_t done;
+    bool     cut;
+} qhat_split_t;
+
+/* Start a new range at `key` once the current ones hold their share. */
+static void qhat_split_cut(qhat_split_t *split, uint32_t key)
+{
+    qhat_range_t *last = tab_last(split->ranges);
+    uint32_t len = split->ranges->len;
+
+    if (len < split->count && key > last->from
+    &&  split->done * split->count >= split->total * len)
+    {
+        last->to = key - 1;
+        qv_append(split->ranges, ((qhat_range_t){
+            .from = key,
+            .to   = UINT32_MAX,
+        }));
+    }
+}
+
+static void qhat_split_walk(qhat_t *hat, qhat_split_t *split,
+                            const qhat_node_t *nodes, uint32_t max,
+                            uint32_t depth, uint32_t prefix)
+{
+    for (uint32_t i = 0; i < max; i++) {
+        qhat_node_t node = nodes[i];
+        uint32_t key = prefix | qhat_lshift(hat, i, depth);
+        qhat_node_const_memory_t memory;
+
+        /* the compact leaves span consecutive slots */
+        if (!node.value || (i > 0 && node.value == nodes[i - 1].value)) {
+            continue;
+        }
+        memory = qhat_node_deref_(hat->qps, node);
+        if (!node.leaf) {
+            qhat_split_walk(hat, split, memory.nodes, QHAT_COUNT, depth + 1,
+                            key);
+            continue;
+        }
+        if (split->cut) {
+            qhat_split_cut(split, key);
+        }
+        split->done += node.compact ? memory.compact->count
+                                    : hat->desc->leaves_per_flat;
+    }
+}
+
+void qhat_split_ranges(qhat_t *hat, uint32_t count, qv_t(qhat_range) *ranges)
+{
+    qhat_split_t split = {
+        .ranges = ranges,
+        .count  = MAX(count, 1U),
+    };
+
+    qps_hptr_deref(hat->qps, &hat->root_cache);
+    qv_clear(ranges);
+    qv_append(ranges, ((qhat_range_t){ .from = 0, .to = UINT32_MAX }));
+
+    /* first pass to get the total, second one to cut the ranges */
+    qhat_split_walk(hat, &split, hat->root->nodes,
+                    hat->desc->root_node_count, 0, 0);
+    split.total = split.done;
+    split.done  = 0;
+    split.cut   = true;
+    qhat_split_walk(hat, &split, hat->root->nodes,
+                    hat->desc->root_node_count, 0, 0);
+}
+
+/* }}} */
+/* Value length specializations {{{ */
+
 #define SIZE                    8
 #define PAGES_PER_FLAT          1
 #include "qps-hat.in.c"
@@ -1435,7 +2033,8 @@ qhat_tree_enumerator_get_value_unsafe(const qhat_tree_enumerator_t *en)
     /* If this assert fails, then it means that returned value isn't the value
      * associated to the current key, probably because of changes in the trie.
      * The caller should have used the 'safe' getter. */
-    assert(!en->compact || en->key == en->memory.compact->keys[en->pos]);
+    assert(!en->compact
+        || en->key == qhat_compact_key(en->memory, en->packed, en->pos));
 
     return ((const byte *)en->value_tab) + en->pos * en->value_len;
 }
@@ -1451,7 +2050,7 @@ qhat_tree_enumerator_fixup_compact_pos(qhat_tree_enumerator_t *en)
     en->count = en->memory.compact->count;
 
     if (en->pos <= en->count &&
-        en->key == en->memory.compact->keys[en->pos])
+        en->key == qhat_compact_key(en->memory, en->packed, en->pos))
     {
         /* Nothing to do.
          * The compact *might* have been modified but 'pos' is still right. */
@@ -1459,10 +2058,10 @@ qhat_tree_enumerator_fixup_compact_pos(qhat_tree_enumerator_t *en)
     }
 
     /* The compact has been modified. Update the position. */
-    en->pos = qhat_compact_lookup(en->memory.compact, 0, en->key);
+    en->pos = qhat_leaf_lookup(en->memory, en->packed, 0, en->key);
 
     if (en->pos >= en->count ||
-        en->key != en->memory.compact->keys[en->pos])
+        en->key != qhat_compact_key(en->memory, en->packed, en->pos))
     {
         /* The key has been removed from the compact.
          * We're already at the next key. */
@@ -1504,7 +2103,7 @@ static void qhat_tree_enumerator_find_entry(qhat_tree_enumerator_t *en)
     if (en->compact) {
         if (en->pos < en->count) {
             /* We're still in the current compact. We're done. */
-            en->key = en->memory.compact->keys[en->pos];
+            en->key = qhat_compact_key(en->memory, en->packed, en->pos);
             return;
         }
         next  = en->memory.compact->parent_right;
@@ -1533,7 +2132,7 @@ static void qhat_tree_enumerator_find_entry_from(qhat_tree_enumerator_t *en,
                                                  uint32_t key)
 {
     if (en->compact) {
-        en->pos = qhat_compact_lookup(en->memory.compact, en->pos, key);
+        en->pos = qhat_leaf_lookup(en->memory, en->packed, en->pos, key);
     } else {
         en->pos = key % en->count;
     }
@@ -1567,7 +2166,9 @@ static void qhat_tree_enumerator_find_down_up(qhat_tree_enumerator_t *en,
          * appears only at maximum depth and shift 32 means depth == 0. */
         assert(en->compact);
 
-        if (en->memory.compact->keys[en->memory.compact->count - 1] < key) {
+        uint32_t last = en->memory.compact->count - 1;
+
+        if (qhat_compact_key(en->memory, en->packed, last) < key) {
             en->end = true;
         } else {
             qhat_tree_enumerator_find_entry_from(en, key);
@@ -1811,12 +2412,18 @@ static void qhat_tree_enumerator_enter_leaf(qhat_tree_enumerator_t *en,
 
     if (PATH_NODE(&en->path).compact) {
         en->compact = true;
+        en->packed  = qhat_node_is_packed(en->path.hat, PATH_NODE(&en->path));
         en->count   = en->memory.compact->count;
+        if (en->packed) {
+            en->value_tab = qhat_packed_values(en->memory.packed);
+        } else {
 #define CASE(Size, Compact, Flat) en->value_tab = Compact->values;
-        QHAT_VALUE_LEN_SWITCH(en->path.hat, en->memory, CASE);
+            QHAT_VALUE_LEN_SWITCH(en->path.hat, en->memory, CASE);
 #undef CASE
+        }
     } else {
         en->compact = false;
+        en->packed  = false;
         en->count   = en->path.hat->desc->leaves_per_flat;
 #define CASE(Size, Compact, Flat) en->value_tab = Flat;
         QHAT_VALUE_LEN_SWITCH(en->path.hat, en->memory, CASE);
@@ -2100,6 +2707,10 @@ uint64_t qhat_compute_memory(qhat_t *hat)
     memory  = QPS_PAGE_SIZE * root->node_count;
     memory += desc->pages_per_compact * QPS_PAGE_SIZE * root->compact_count;
     memory += desc->pages_per_flat * QPS_PAGE_SIZE * root->flat_count;
+    if (root->has_packed) {
+        memory -= qhat_packed_saved(hat, root->nodes,
+                                    desc->root_node_count);
+    }
     return memory;
 }
 
@@ -2123,6 +2734,12 @@ uint64_t qhat_compute_memory_overhead(qhat_t *hat)
     memory += compact_slots * 4;
     memory += (compact_slots - root->key_stored_count) * desc->value_len;
 
+    /* the pages saved by the packed leaves were keys or empty entries */
+    if (root->has_packed) {
+        memory -= MIN(memory, qhat_packed_saved(hat, root->nodes,
+                                                desc->root_node_count));
+    }
+
     return memory;
 }
 
@@ -2195,10 +2812,10 @@ static void qhat_debug_print_dispatch_node(const qhat_t *hat, uint32_t flags,
 static void qhat_debug_print_compact_leaf(const qhat_t *hat, uint32_t flags,
                                           int depth, uint32_t prefix,
                                           qhat_node_const_memory_t memory,
-                                          FILE *stream)
+                                          bool packed, FILE *stream)
 {
     uint32_t count    = memory.compact->count;
-    uint32_t previous = memory.compact->keys[0];
+    uint32_t previous = qhat_compact_key(memory, packed, 0);
     uint32_t start    = previous;
     int printed       = 0;
 
@@ -2210,7 +2827,7 @@ static void qhat_debug_print_compact_leaf(const qhat_t *hat, uint32_t flags,
     }
     if ((flags & QHAT_PRINT_KEYS)) {
         for (uint32_t i = 1; i < count; i++) {
-            uint32_t key = memory.compact->keys[i];
+            uint32_t key = qhat_compact_key(memory, packed, i);
             if (key != previous + 1) {
                 if (printed > 9) {
                     fprintf(stream, "\n");
@@ -2241,10 +2858,10 @@ static void qhat_debug_print_compact_leaf(const qhat_t *hat, uint32_t flags,
         }
     } else
     if (count == 1) {
-        fprintf(stream, "%x\n", memory.compact->keys[0]);
+        fprintf(stream, "%x\n", qhat_compact_key(memory, packed, 0));
     } else {
-        fprintf(stream, "%x -> %x\n", memory.compact->keys[0],
-                memory.compact->keys[count - 1]);
+        fprintf(stream, "%x -> %x\n", qhat_compact_key(memory, packed, 0),
+                qhat_compact_key(memory, packed, count - 1));
     }
 }
 
@@ -2311,12 +2928,15 @@ static void qhat_debug_print_node(const qhat_t *hat, uint32_t flags,
     if (node.leaf) {
         fprintf(stream, ", leaf");
         if (node.compact) {
+            bool packed = qhat_node_is_packed(hat, node);
+
             memory.raw = qps_pg_deref(hat->qps, node.page);
-            fprintf(stream, " (compact, %d entries, parent %x -> %x)\n",
+            fprintf(stream, " (%s, %d entries, parent %x -> %x)\n",
+                    packed ? "packed" : "compact",
                     memory.compact->count, memory.compact->parent_left,
                     memory.compact->parent_right - 1);
             qhat_debug_print_compact_leaf(hat, flags, depth, prefix, memory,
-                                          stream);
+                                          packed, stream);
         } else {
             fprintf(stream, " (flat)\n");
             memory.raw = qps_pg_deref(hat->qps, node.page);
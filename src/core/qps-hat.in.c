@@ -229,11 +229,16 @@ static const type_t *get(qhat_path_t *path)
     memory = qhat_node_deref(path);
 
     if (PATH_NODE(path).compact) {
-        uint32_t pos = qhat_compact_lookup(memory.compact, 0, path->key);
+        bool packed = qhat_node_is_packed(path->hat, PATH_NODE(path));
+        uint32_t pos = qhat_leaf_lookup(memory, packed, 0, path->key);
+
         if (pos >= memory.compact->count
-        || memory.compact->keys[pos] != path->key) {
+        || qhat_compact_key(memory, packed, pos) != path->key) {
             return NULL;
         }
+        if (packed) {
+            return (const type_t *)qhat_packed_values(memory.packed) + pos;
+        }
         return &memory.Compact->values[pos];
     } else {
         uint32_t pos = path->key & LEAF_INDEX_MASK;
@@ -255,6 +260,9 @@ static type_t *set(qhat_path_t *path)
     qhat_node_memory_t memory;
     update_path(path, true);
 
+    if (unlikely(qhat_node_is_packed(path->hat, PATH_NODE(path)))) {
+        qhat_unpack_path(path);
+    }
     for (;;) {
         if (PATH_NODE(path).value == 0) {
             e_named_trace(2, "trie/insert",
@@ -340,6 +348,9 @@ static bool remove(qhat_path_t *path, type_t *ptr)
         }
         return false;
     }
+    if (unlikely(qhat_node_is_packed(path->hat, PATH_NODE(path)))) {
+        qhat_unpack_path(path);
+    }
 
     memory = qhat_node_w_deref(path);
 
@@ -0,0 +1,618 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <math.h>
+#include <lib-common/sketch.h>
+#include <lib-common/sort.h>
+
+#if defined(__HAS_CPUID) && defined(__SSE2__)
+#   pragma push_macro("__leaf")
+#   undef __leaf
+#   include <x86intrin.h>
+#   pragma pop_macro("__leaf")
+#endif
+
+/* {{{ HyperLogLog */
+
+/* The registers hold the rank of the first bit set after the index bits,
+ * so that they range from 0 (empty) to 64 - precision + 1. */
+#define HLL_SPARSE_RANK_BITS  6
+#define HLL_SPARSE_RANK_MASK  ((1U << HLL_SPARSE_RANK_BITS) - 1)
+#define HLL_MAX_RANK(p)       (64 - (p) + 1)
+
+static ALWAYS_INLINE uint32_t hll_nb_regs(const hll_t *hll)
+{
+    return 1U << hll->precision;
+}
+
+static ALWAYS_INLINE uint8_t hll_rank(uint64_t hash, int precision)
+{
+    /* The guard bit bounds the rank when all the bits are 0. */
+    return __builtin_clzll((hash << precision)
+                           | (1ULL << (precision - 1))) + 1;
+}
+
+static ALWAYS_INLINE uint32_t hll_sparse_entry(uint64_t hash)
+{
+    uint32_t idx = hash >> (64 - HLL_SPARSE_PRECISION);
+
+    return (idx << HLL_SPARSE_RANK_BITS)
+         | hll_rank(hash, HLL_SPARSE_PRECISION);
+}
+
+/* Convert a sparse entry to the register it updates at precision p: the
+ * low bits of the sparse index are the first bits counted in the rank. */
+static ALWAYS_INLINE void
+hll_sparse_to_dense(uint32_t entry, int p, uint32_t *idx, uint8_t *rank)
+{
+    uint32_t sidx = entry >> HLL_SPARSE_RANK_BITS;
+    int shift = HLL_SPARSE_PRECISION - p;
+    uint32_t low = sidx & ((1U << shift) - 1);
+
+    *idx = sidx >> shift;
+    if (low) {
+        *rank = shift - bsr32(low);
+    } else {
+        *rank = shift + (entry & HLL_SPARSE_RANK_MASK);
+    }
+}
+
+static ALWAYS_INLINE void hll_dense_set(uint8_t *regs, uint32_t idx,
+                                        uint8_t rank)
+{
+    if (regs[idx] < rank) {
+        regs[idx] = rank;
+    }
+}
+
+hll_t *hll_init(hll_t *hll, int precision)
+{
+    assert (precision >= HLL_PRECISION_MIN
+        &&  precision <= HLL_PRECISION_MAX);
+    p_clear(hll, 1);
+    hll->precision = precision;
+    qv_init(&hll->sparse);
+    qv_init(&hll->pending);
+    return hll;
+}
+
+void hll_wipe(hll_t *hll)
+{
+    qv_wipe(&hll->sparse);
+    qv_wipe(&hll->pending);
+    p_delete(&hll->dense);
+}
+
+void hll_clear(hll_t *hll)
+{
+    int precision = hll->precision;
+
+    hll_wipe(hll);
+    hll_init(hll, precision);
+}
+
+static void hll_to_dense(hll_t *hll)
+{
+    hll->dense = p_new(uint8_t, hll_nb_regs(hll));
+    tab_for_each_entry(entry, &hll->sparse) {
+        uint32_t idx;
+        uint8_t rank;
+
+        hll_sparse_to_dense(entry, hll->precision, &idx, &rank);
+        hll_dense_set(hll->dense, idx, rank);
+    }
+    qv_wipe(&hll->sparse);
+    qv_wipe(&hll->pending);
+    hll->is_dense = true;
+}
+
+/* Sort the sparse entries, and only keep the highest rank of each index:
+ * the entries are sorted by index then rank, so it is the last one. */
+static void hll_sparse_normalize(hll_t *hll)
+{
+    uint32_t *tab = hll->sparse.tab;
+    int len = 0;
+
+    dsort32(tab, hll->sparse.len);
+    for (int i = 0; i < hll->sparse.len; i++) {
+        if (len > 0 && (tab[len - 1] >> HLL_SPARSE_RANK_BITS)
+                    == (tab[i] >> HLL_SPARSE_RANK_BITS))
+        {
+            len--;
+        }
+        tab[len++] = tab[i];
+    }
+    qv_clip(&hll->sparse, len);
+
+    /* The sparse list is worth it as long as it is smaller than the
+     * registers. */
+    if ((uint32_t)hll->sparse.len * 4 > hll_nb_regs(hll)) {
+        hll_to_dense(hll);
+    }
+}
+
+static void hll_flush(hll_t *hll)
+{
+    if (!hll->is_dense && hll->pending.len) {
+        qv_extend(&hll->sparse, hll->pending.tab, hll->pending.len);
+        qv_clear(&hll->pending);
+        hll_sparse_normalize(hll);
+    }
+}
+
+void hll_add_hash(hll_t *hll, uint64_t hash)
+{
+    if (hll->is_dense) {
+        hll_dense_set(hll->dense, hash >> (64 - hll->precision),
+                      hll_rank(hash, hll->precision));
+        return;
+    }
+    qv_append(&hll->pending, hll_sparse_entry(hash));
+    if ((uint32_t)hll->pending.len >= MIN(256U, hll_nb_regs(hll) / 4)) {
+        hll_flush(hll);
+    }
+}
+
+static double hll_sigma(double x)
+{
+    double y = 1;
+    double z = x;
+    double zp;
+
+    if (x == 1) {
+        return INFINITY;
+    }
+    do {
+        x *= x;
+        zp = z;
+        z += x * y;
+        y += y;
+    } while (zp != z);
+    return z;
+}
+
+static double hll_tau(double x)
+{
+    double y = 1;
+    double z = 1 - x;
+    double zp;
+
+    if (x == 0 || x == 1) {
+        return 0;
+    }
+    do {
+        x = sqrt(x);
+        zp = z;
+        y *= 0.5;
+        z -= (1 - x) * (1 - x) * y;
+    } while (zp != z);
+    return z / 3;
+}
+
+/* Improved estimator of "New cardinality estimation algorithms for
+ * HyperLogLog sketches" (Otmar Ertl, 2017), from the histogram of the
+ * 2^p registers, that is accurate on the whole range of cardinalities. */
+static uint64_t hll_estimate(const uint32_t *histo, int p)
+{
+    double m = 1U << p;
+    int q = 64 - p;
+    double z = m * hll_tau((m - histo[q + 1]) / m);
+
+    for (int k = q; k >= 1; k--) {
+        z += histo[k];
+        z *= 0.5;
+    }
+    z += m * hll_sigma(histo[0] / m);
+    return llround(m * m / (2 * M_LN2 * z));
+}
+
+uint64_t hll_count(hll_t *hll)
+{
+    uint32_t histo[HLL_MAX_RANK(HLL_PRECISION_MIN) + 1] = { 0 };
+
+    hll_flush(hll);
+    if (hll->is_dense) {
+        for (uint32_t i = 0; i < hll_nb_regs(hll); i++) {
+            histo[hll->dense[i]]++;
+        }
+        return hll_estimate(histo, hll->precision);
+    }
+
+    /* The sparse entries are the non-empty registers of a sketch of
+     * precision HLL_SPARSE_PRECISION. */
+    histo[0] = (1U << HLL_SPARSE_PRECISION) - hll->sparse.len;
+    tab_for_each_entry(entry, &hll->sparse) {
+        histo[entry & HLL_SPARSE_RANK_MASK]++;
+    }
+    return hll_estimate(histo, HLL_SPARSE_PRECISION);
+}
+
+static void hll_dense_merge(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+    uint32_t i = 0;
+
+#if defined(__HAS_CPUID) && defined(__SSE2__)
+    /* There are at least 16 registers. */
+    for (; i < len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_max_epu8(a, b));
+    }
+#endif
+    for (; i < len; i++) {
+        dst[i] = MAX(dst[i], src[i]);
+    }
+}
+
+int hll_merge(hll_t *dst, hll_t *src)
+{
+    if (dst->precision != src->precision) {
+        return -1;
+    }
+    hll_flush(dst);
+    hll_flush(src);
+
+    if (!src->is_dense) {
+        if (dst->is_dense) {
+            tab_for_each_entry(entry, &src->sparse) {
+                uint32_t idx;
+                uint8_t rank;
+
+                hll_sparse_to_dense(entry, dst->precision, &idx, &rank);
+                hll_dense_set(dst->dense, idx, rank);
+            }
+        } else {
+            qv_extend(&dst->sparse, src->sparse.tab, src->sparse.len);
+            hll_sparse_normalize(dst);
+        }
+        return 0;
+    }
+
+    if (!dst->is_dense) {
+        hll_to_dense(dst);
+    }
+    hll_dense_merge(dst->dense, src->dense, hll_nb_regs(dst));
+    return 0;
+}
+
+void hll_to_iop(hll_t *hll, core__hll_sketch__t *out)
+{
+    hll_flush(hll);
+    iop_init(core__hll_sketch, out);
+    out->precision = hll->precision;
+    if (hll->is_dense) {
+        out->dense = LSTR_INIT_V((const char *)hll->dense,
+                                 hll_nb_regs(hll));
+    } else {
+        out->sparse = IOP_TYPED_ARRAY_TAB(u32, &hll->sparse);
+    }
+}
+
+int hll_init_from_iop(hll_t *hll, const core__hll_sketch__t *in)
+{
+    int p = in->precision;
+
+    if (p < HLL_PRECISION_MIN || p > HLL_PRECISION_MAX) {
+        hll_init(hll, HLL_PRECISION_DEFAULT);
+        return -1;
+    }
+    hll_init(hll, p);
+
+    if (in->dense.len) {
+        if (in->sparse.len || in->dense.len != (int)hll_nb_regs(hll)) {
+            return -1;
+        }
+        const uint8_t *regs = in->dense.data;
+
+        for (int i = 0; i < in->dense.len; i++) {
+            if (regs[i] > HLL_MAX_RANK(p)) {
+                return -1;
+            }
+        }
+        hll->dense = p_dup(regs, in->dense.len);
+        hll->is_dense = true;
+        return 0;
+    }
+
+    for (int i = 0; i < in->sparse.len; i++) {
+        uint32_t entry = in->sparse.tab[i];
+        uint32_t rank = entry & HLL_SPARSE_RANK_MASK;
+
+        if (!rank || rank > HLL_MAX_RANK(HLL_SPARSE_PRECISION)
+        ||  (i > 0 && (in->sparse.tab[i - 1] >> HLL_SPARSE_RANK_BITS)
+                   >= (entry >> HLL_SPARSE_RANK_BITS)))
+        {
+            qv_clear(&hll->sparse);
+            return -1;
+        }
+        qv_append(&hll->sparse, entry);
+    }
+    if ((uint32_t)hll->sparse.len * 4 > hll_nb_regs(hll)) {
+        hll_to_dense(hll);
+    }
+    return 0;
+}
+
+/* }}} */
+/* {{{ Count-min sketch */
+
+cms_t *cms_init(cms_t *cms, uint32_t width, uint32_t depth)
+{
+    assert (width > 0 && depth > 0);
+    p_clear(cms, 1);
+    cms->width = width;
+    cms->depth = depth;
+    cms->counters = p_new(uint64_t, (size_t)width * depth);
+    return cms;
+}
+
+void cms_wipe(cms_t *cms)
+{
+    p_delete(&cms->counters);
+}
+
+void cms_dimensions(double epsilon, double delta,
+                    uint32_t *width, uint32_t *depth)
+{
+    assert (epsilon > 0 && epsilon < 1);
+    assert (delta > 0 && delta < 1);
+    *width = ceil(M_E / epsilon);
+    *depth = MAX(1, ceil(log(1 / delta)));
+}
+
+void cms_clear(cms_t *cms)
+{
+    p_clear(cms->counters, (size_t)cms->width * cms->depth);
+    cms->total = 0;
+}
+
+/* The columns of the rows are derived from the two halves of the hash
+ * (Kirsch and Mitzenmacher), the second one being odd so that the rows
+ * differ. */
+static ALWAYS_INLINE uint64_t *
+cms_counter(const cms_t *cms, uint64_t hash, uint32_t row)
+{
+    uint32_t h = (uint32_t)hash + row * ((uint32_t)(hash >> 32) | 1);
+    uint32_t col = ((uint64_t)h * cms->width) >> 32;
+
+    return &cms->counters[(size_t)row * cms->width + col];
+}
+
+uint64_t cms_add_hash(cms_t *cms, uint64_t hash, uint64_t count)
+{
+    uint64_t res = UINT64_MAX;
+
+    for (uint32_t row = 0; row < cms->depth; row++) {
+        uint64_t *counter = cms_counter(cms, hash, row);
+
+        *counter += count;
+        res = MIN(res, *counter);
+    }
+    cms->total += count;
+    return res;
+}
+
+uint64_t cms_count_hash(const cms_t *cms, uint64_t hash)
+{
+    uint64_t res = UINT64_MAX;
+
+    for (uint32_t row = 0; row < cms->depth; row++) {
+        res = MIN(res, *cms_counter(cms, hash, row));
+    }
+    return res;
+}
+
+int cms_merge(cms_t *dst, const cms_t *src)
+{
+    size_t len = (size_t)dst->width * dst->depth;
+
+    if (dst->width != src->width || dst->depth != src->depth) {
+        return -1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        dst->counters[i] += src->counters[i];
+    }
+    dst->total += src->total;
+    return 0;
+}
+
+void cms_to_iop(const cms_t *cms, core__count_min_sketch__t *out)
+{
+    iop_init(core__count_min_sketch, out);
+    out->width = cms->width;
+    out->depth = cms->depth;
+    out->total = cms->total;
+    out->counters = IOP_TYPED_ARRAY(u64, cms->counters,
+                                    cms->width * cms->depth);
+}
+
+int cms_init_from_iop(cms_t *cms, const core__count_min_sketch__t *in)
+{
+    if (!in->width || !in->depth
+    ||  (uint64_t)in->width * in->depth != (uint64_t)in->counters.len)
+    {
+        return -1;
+    }
+    cms_init(cms, in->width, in->depth);
+    p_copy(cms->counters, in->counters.tab, in->counters.len);
+    cms->total = in->total;
+    return 0;
+}
+
+/* }}} */
+/* {{{ Top-k */
+
+topk_t *topk_init(topk_t *topk, uint32_t k, uint32_t width, uint32_t depth)
+{
+    assert (k > 0);
+    p_clear(topk, 1);
+    topk->k = k;
+    cms_init(&topk->cms, width, depth);
+    qv_init(&topk->entries);
+    qm_init(topk_pos, &topk->pos);
+    return topk;
+}
+
+void topk_wipe(topk_t *topk)
+{
+    tab_for_each_ptr(entry, &topk->entries) {
+        lstr_wipe(&entry->key);
+    }
+    qv_wipe(&topk->entries);
+    qm_wipe(topk_pos, &topk->pos);
+    cms_wipe(&topk->cms);
+}
+
+void topk_clear(topk_t *topk)
+{
+    tab_for_each_ptr(entry, &topk->entries) {
+        lstr_wipe(&entry->key);
+    }
+    qv_clear(&topk->entries);
+    qm_clear(topk_pos, &topk->pos);
+    cms_clear(&topk->cms);
+}
+
+static void topk_append(topk_t *topk, lstr_t key, uint64_t count)
+{
+    topk_entry_t *entry = qv_growlen(&topk->entries, 1);
+
+    entry->key = lstr_dup(key);
+    entry->count = count;
+    qm_add(topk_pos, &topk->pos, &entry->key, topk->entries.len - 1);
+}
+
+void topk_add(topk_t *topk, lstr_t key, uint64_t count)
+{
+    uint64_t est = cms_add_hash(&topk->cms, wyhash64(key.s, key.len, 0),
+                                count);
+    int pos = qm_find(topk_pos, &topk->pos, &key);
+    topk_entry_t *min = NULL;
+
+    if (pos >= 0) {
+        topk->entries.tab[topk->pos.values[pos]].count = est;
+        return;
+    }
+    if (topk->entries.len < (int)topk->k) {
+        topk_append(topk, key, est);
+        return;
+    }
+
+    /* The new key replaces the candidate with the lowest count if it is
+     * more frequent. */
+    tab_for_each_ptr(entry, &topk->entries) {
+        if (!min || entry->count < min->count) {
+            min = entry;
+        }
+    }
+    if (est <= min->count) {
+        return;
+    }
+    qm_del_key(topk_pos, &topk->pos, &min->key);
+    lstr_wipe(&min->key);
+    min->key = lstr_dup(key);
+    min->count = est;
+    qm_add(topk_pos, &topk->pos, &min->key, min - topk->entries.tab);
+}
+
+static int topk_entry_cmp(const topk_entry_t *a, const topk_entry_t *b)
+{
+    return CMP(b->count, a->count) ?: lstr_cmp(a->key, b->key);
+}
+
+static void topk_sort(topk_t *topk)
+{
+    qv_qsort(&topk->entries, topk_entry_cmp);
+    qm_clear(topk_pos, &topk->pos);
+    tab_enumerate_ptr(i, entry, &topk->entries) {
+        qm_add(topk_pos, &topk->pos, &entry->key, i);
+    }
+}
+
+const qv_t(topk_entry) *topk_get(topk_t *topk)
+{
+    topk_sort(topk);
+    return &topk->entries;
+}
+
+int topk_merge(topk_t *dst, const topk_t *src)
+{
+    RETHROW(cms_merge(&dst->cms, &src->cms));
+
+    tab_for_each_ptr(entry, &src->entries) {
+        if (qm_find(topk_pos, &dst->pos, &entry->key) < 0) {
+            topk_append(dst, entry->key, 0);
+        }
+    }
+    tab_for_each_ptr(entry, &dst->entries) {
+        entry->count = cms_count_hash(&dst->cms,
+                                      wyhash64(entry->key.s,
+                                               entry->key.len, 0));
+    }
+    if (dst->entries.len > (int)dst->k) {
+        qv_qsort(&dst->entries, topk_entry_cmp);
+        for (int i = dst->k; i < dst->entries.len; i++) {
+            lstr_wipe(&dst->entries.tab[i].key);
+        }
+        qv_clip(&dst->entries, dst->k);
+        topk_sort(dst);
+    }
+    return 0;
+}
+
+void t_topk_to_iop(const topk_t *topk, core__top_k_sketch__t *out)
+{
+    core__top_k_entry__t *entries;
+
+    entries = t_new(core__top_k_entry__t, topk->entries.len);
+    tab_enumerate_ptr(i, entry, &topk->entries) {
+        iop_init(core__top_k_entry, &entries[i]);
+        entries[i].key = entry->key;
+        entries[i].count = entry->count;
+    }
+
+    iop_init(core__top_k_sketch, out);
+    out->k = topk->k;
+    cms_to_iop(&topk->cms, &out->cms);
+    out->entries = IOP_TYPED_ARRAY(core__top_k_entry, entries,
+                                   topk->entries.len);
+}
+
+int topk_init_from_iop(topk_t *topk, const core__top_k_sketch__t *in)
+{
+    if (!in->k || in->entries.len > (int)in->k) {
+        return -1;
+    }
+    p_clear(topk, 1);
+    RETHROW(cms_init_from_iop(&topk->cms, &in->cms));
+    topk->k = in->k;
+    qv_init(&topk->entries);
+    qm_init(topk_pos, &topk->pos);
+
+    tab_for_each_ptr(entry, &in->entries) {
+        if (qm_find(topk_pos, &topk->pos, &entry->key) >= 0) {
+            topk_wipe(topk);
+            return -1;
+        }
+        topk_append(topk, entry->key, entry->count);
+    }
+    return 0;
+}
+
+/* }}} */
@@ -20,50 +20,68 @@
 # error "you must include sort.h instead"
 #endif
 
+/* The small arrays are scanned without branches, which the compiler
+ * vectorizes, the larger ones are bisected with a conditional move instead
+ * of a branch at each step.
+ */
 static inline size_t (bisect)(type_t what, const type_t data[], size_t len,
                               bool *found)
 {
-    size_t l = 0, r = len;
+    size_t pos = 0;
 
-    while (l < r) {
-        size_t i = (l + r) / 2;
-
-        if (what == data[i]) {
-            if (found) {
-                *found = true;
-            }
-            return i;
+    if (len <= BISECT_SCAN_MAX) {
+        for (size_t i = 0; i < len; i++) {
+            pos += data[i] < what;
         }
-        if (what < data[i]) {
-            r = i;
-        } else {
-            l = i + 1;
+    } else {
+        const type_t *base = data;
+        size_t n = len;
+
+        while (n > 1) {
+            size_t half = n / 2;
+
+            base += base[half] < what ? half : 0;
+            n    -= half;
         }
+        pos = base - data + (*base < what);
     }
     if (found) {
-        *found = false;
+        *found = pos < len && data[pos] == what;
     }
-    return r;
+    return pos;
 }
 
 static inline bool (contains)(type_t what, const type_t data[], size_t len)
 {
-    size_t l = 0, r = len;
+    bool found;
+
+    bisect(what, data, len, &found);
+    return found;
+}
+
+/* Each value is searched from the position of the previous one with steps
+ * of 1, 2, 4... items, and the last step is bisected.
+ */
+static inline void
+(bisect_many)(const type_t what[], size_t nb, const type_t data[], size_t len,
+              size_t pos[])
+{
+    size_t from = 0;
 
-    while (l < r) {
-        size_t i = (l + r) / 2;
+    for (size_t i = 0; i < nb; i++) {
+        size_t step = 1;
 
-        if (what == data[i])
-            return true;
-        if (what < data[i]) {
-            r = i;
-        } else {
-            l = i + 1;
+        while (from + step <= len && data[from + step - 1] < what[i]) {
+            from += step;
+            step *= 2;
         }
+        from  += bisect(what[i], data + from, MIN(step - 1, len - from),
+                        NULL);
+        pos[i] = from;
     }
-    return false;
 }
 
 #undef type_t
 #undef bisect
 #undef contains
+#undef bisect_many
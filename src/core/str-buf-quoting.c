@@ -20,6 +20,14 @@
 #include <lib-common/container-qvector.h>
 #include <lib-common/sort.h>
 
+#ifdef __HAS_CPUID
+#   pragma push_macro("__leaf")
+#   undef __leaf
+#   include <cpuid.h>
+#   include <x86intrin.h>
+#   pragma pop_macro("__leaf")
+#endif
+
 static const char __b64[] =
     "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
@@ -111,22 +119,314 @@ static int test_xml_printable(int x) {
 #undef QP
 #undef XP
 
+/*{{{ SSSE3 kernels */
+
+/* These kernels process the bulk of the hexadecimal, base64 and URL codecs
+ * 16 bytes at a time, the encoding functions below use them when the CPU
+ * has SSSE3 and finish the work with the generic code. They stop before the
+ * first block they cannot handle, and return the length they processed. */
+
+#ifdef __HAS_CPUID
+
+static bool sb_has_ssse3(void)
+{
+    static int has_ssse3 = -1;
+
+    if (unlikely(has_ssse3 < 0)) {
+        int eax, ebx, ecx, edx;
+
+        __cpuid(1, eax, ebx, ecx, edx);
+        has_ssse3 = !!(ecx & bit_SSSE3);
+    }
+    return has_ssse3;
+}
+
+/* Tells which bytes of `x` are in [from, from + width], as a mask. */
+__attribute__((target("ssse3")))
+static inline __m128i mm_in_range(__m128i x, char from, char width,
+                                  __m128i *offset)
+{
+    *offset = _mm_sub_epi8(x, _mm_set1_epi8(from));
+    return _mm_cmpeq_epi8(_mm_min_epu8(*offset, _mm_set1_epi8(width)),
+                          *offset);
+}
+
+/* Length of the prefix of `p` made of the characters that are not escaped
+ * in URLs: [-./0-9A-Z_a-z]. */
+__attribute__((target("ssse3")))
+static int url_span_ssse3(const byte *p, int len)
+{
+    int pos = 0;
+
+    for (; pos + 16 <= len; pos += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + pos));
+        __m128i off, ok;
+        unsigned mask;
+
+        ok   = mm_in_range(x, '-', '9' - '-', &off);
+        ok   = _mm_or_si128(ok, mm_in_range(x, 'A', 'Z' - 'A', &off));
+        ok   = _mm_or_si128(ok, mm_in_range(x, 'a', 'z' - 'a', &off));
+        ok   = _mm_or_si128(ok, _mm_cmpeq_epi8(x, _mm_set1_epi8('_')));
+        mask = _mm_movemask_epi8(ok);
+        if (mask != 0xffff) {
+            return pos + bsf32(~mask);
+        }
+    }
+    return pos;
+}
+
+/* Writes 32 digits for every 16 bytes of `src`. */
+__attribute__((target("ssse3")))
+static int hex_encode_ssse3(char *dst, const byte *src, int len)
+{
+    const __m128i digits = _mm_loadu_si128((const void *)__str_digits_upper);
+    const __m128i lo_4bits = _mm_set1_epi8(0x0f);
+    int pos = 0;
+
+    for (; pos + 16 <= len; pos += 16) {
+        __m128i x  = _mm_loadu_si128((const __m128i *)(src + pos));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), lo_4bits);
+        __m128i lo = _mm_and_si128(x, lo_4bits);
+
+        hi = _mm_shuffle_epi8(digits, hi);
+        lo = _mm_shuffle_epi8(digits, lo);
+        _mm_storeu_si128((__m128i *)(dst + 2 * pos),
+                         _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(dst + 2 * pos + 16),
+                         _mm_unpackhi_epi8(hi, lo));
+    }
+    return pos;
+}
+
+/* Values of 16 hexadecimal digits, `*ok` tells which ones are digits. */
+__attribute__((target("ssse3")))
+static inline __m128i hex_values_ssse3(__m128i x, __m128i *ok)
+{
+    __m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+    __m128i digit, alpha, is_digit, is_alpha;
+
+    is_digit = mm_in_range(x, '0', 9, &digit);
+    is_alpha = mm_in_range(lower, 'a', 5, &alpha);
+    alpha    = _mm_add_epi8(alpha, _mm_set1_epi8(10));
+    *ok      = _mm_or_si128(is_digit, is_alpha);
+    return _mm_or_si128(_mm_and_si128(is_digit, digit),
+                        _mm_and_si128(is_alpha, alpha));
+}
+
+/* Writes 16 bytes for every 32 digits of `src`. */
+__attribute__((target("ssse3")))
+static int hex_decode_ssse3(char *dst, const byte *src, int len)
+{
+    /* multiplies the first digit of each pair by 16, the second by 1 */
+    const __m128i weights = _mm_set1_epi16(0x0110);
+    int pos = 0;
+
+    for (; pos + 32 <= len; pos += 32) {
+        __m128i ok1, ok2, v1, v2;
+
+        v1 = hex_values_ssse3(_mm_loadu_si128((const __m128i *)(src + pos)),
+                              &ok1);
+        v2 = hex_values_ssse3(_mm_loadu_si128((const __m128i *)
+                                              (src + pos + 16)), &ok2);
+        if (_mm_movemask_epi8(_mm_and_si128(ok1, ok2)) != 0xffff) {
+            break;
+        }
+        v1 = _mm_maddubs_epi16(v1, weights);
+        v2 = _mm_maddubs_epi16(v2, weights);
+        _mm_storeu_si128((__m128i *)(dst + pos / 2),
+                         _mm_packus_epi16(v1, v2));
+    }
+    return pos;
+}
+
+/* Encodes groups of 4 packs (12 bytes read as 16) into 16 characters, as
+ * described by W. Muła and D. Lemire in "Faster Base64 Encoding and
+ * Decoding using AVX2 Instructions", for at most `packs` packs. */
+__attribute__((target("ssse3")))
+static int b64_encode_ssse3(char *dst, const byte *src, int len, int packs,
+                            const char table[64])
+{
+    const __m128i spread = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4,
+                                         7, 6, 8, 7, 10, 9, 11, 10);
+    /* offsets to add to the 6-bits values, indexed by the value minus 51
+     * (saturated), except for [0, 26[ that use the index 13 */
+    const __m128i shifts = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52,
+                                         '0' - 52, '0' - 52, '0' - 52,
+                                         '0' - 52, '0' - 52, '0' - 52,
+                                         '0' - 52, '0' - 52,
+                                         table[62] - 62, table[63] - 63,
+                                         'A', 0, 0);
+    int done = 0;
+
+    for (; done + 4 <= packs && 3 * done + 16 <= len; done += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + 3 * done));
+        __m128i t0, t1, idx, lut;
+
+        /* puts the 4 6-bits values of each pack in the 4 bytes of a 32-bits
+         * word */
+        x   = _mm_shuffle_epi8(x, spread);
+        t0  = _mm_and_si128(x, _mm_set1_epi32(0x0fc0fc00));
+        t0  = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        t1  = _mm_and_si128(x, _mm_set1_epi32(0x003f03f0));
+        t1  = _mm_mullo_epi16(t1, _mm_set1_epi32(0x01000010));
+        idx = _mm_or_si128(t0, t1);
+
+        t0  = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+        lut = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+        lut = _mm_or_si128(lut, _mm_and_si128(t0, _mm_set1_epi8(13)));
+        lut = _mm_shuffle_epi8(shifts, lut);
+        _mm_storeu_si128((__m128i *)(dst + 4 * done),
+                         _mm_add_epi8(idx, lut));
+    }
+    return done;
+}
+
+/* Decodes blocks of 16 characters of the alphabet `table` (no spaces, no
+ * padding) into 12 bytes, 16 bytes are written for each block. */
+__attribute__((target("ssse3")))
+static int b64_decode_ssse3(char *dst, const byte *src, int len,
+                            const char table[64])
+{
+    const __m128i c62 = _mm_set1_epi8(table[62]);
+    const __m128i c63 = _mm_set1_epi8(table[63]);
+    const __m128i gather = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+                                         14, 13, 12, -1, -1, -1, -1);
+    int pos = 0;
+
+    for (; pos + 16 <= len; pos += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + pos));
+        __m128i upper, lower, digit, is_upper, is_lower, is_digit;
+        __m128i is_62, is_63, v;
+
+        is_upper = mm_in_range(x, 'A', 25, &upper);
+        is_lower = mm_in_range(x, 'a', 25, &lower);
+        is_digit = mm_in_range(x, '0', 9, &digit);
+        is_62    = _mm_cmpeq_epi8(x, c62);
+        is_63    = _mm_cmpeq_epi8(x, c63);
+        v = _mm_or_si128(_mm_or_si128(is_upper, is_lower),
+                         _mm_or_si128(is_digit,
+                                      _mm_or_si128(is_62, is_63)));
+        if (_mm_movemask_epi8(v) != 0xffff) {
+            break;
+        }
+
+        lower = _mm_add_epi8(lower, _mm_set1_epi8(26));
+        digit = _mm_add_epi8(digit, _mm_set1_epi8(52));
+        v = _mm_and_si128(is_upper, upper);
+        v = _mm_or_si128(v, _mm_and_si128(is_lower, lower));
+        v = _mm_or_si128(v, _mm_and_si128(is_digit, digit));
+        v = _mm_or_si128(v, _mm_and_si128(is_62, _mm_set1_epi8(62)));
+        v = _mm_or_si128(v, _mm_and_si128(is_63, _mm_set1_epi8(63)));
+
+        /* merges the 4 6-bits values of each 32-bits word in 24 bits */
+        v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+        v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128((__m128i *)(dst + pos / 4 * 3),
+                         _mm_shuffle_epi8(v, gather));
+    }
+    return pos;
+}
+
+#endif
+
+/*}}} */
+/*{{{ Escaping scanner */
+
+/* The characters an escaping function has to look at, with the nibble
+ * tables of the SSSE3 scanner: lo[c >> 7][c & 0xf] has the bit
+ * (c >> 4) & 7 set for each character c of the set. */
+typedef struct sb_esc_set_t {
+    ctype_desc_t chars;
+    uint8_t      lo[2][16];
+} sb_esc_set_t;
+
+static sb_esc_set_t sb_xml_esc_g;
+
+static void sb_esc_set_add(sb_esc_set_t *set, byte c)
+{
+    SET_BIT(set->chars.tab, c);
+    set->lo[c >> 7][c & 0xf] |= 1 << ((c >> 4) & 7);
+}
+
+#ifdef __HAS_CPUID
+
+/* Length of the prefix of `p` without characters of the set. */
+__attribute__((target("ssse3")))
+static int sb_esc_span_ssse3(const sb_esc_set_t *set, const byte *p, int len)
+{
+    const __m128i lo0 = _mm_loadu_si128((const void *)set->lo[0]);
+    const __m128i lo1 = _mm_loadu_si128((const void *)set->lo[1]);
+    const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                       1, 2, 4, 8, 16, 32, 64, -128);
+    int pos = 0;
+
+    for (; pos + 16 <= len; pos += 16) {
+        __m128i x  = _mm_loadu_si128((const __m128i *)(p + pos));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), _mm_set1_epi8(0xf));
+        __m128i row;
+        unsigned mask;
+
+        /* pshufb yields 0 for the indexes with the bit 7 set, so that lo0
+         * only answers for the characters below 0x80 and lo1 for the
+         * other ones */
+        row  = _mm_xor_si128(x, _mm_set1_epi8((char)0x80));
+        row  = _mm_shuffle_epi8(lo1, row);
+        row  = _mm_or_si128(row, _mm_shuffle_epi8(lo0, x));
+        row  = _mm_and_si128(row, _mm_shuffle_epi8(bits, hi));
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(row, _mm_setzero_si128()));
+        if (mask != 0xffff) {
+            return pos + bsf32(~mask);
+        }
+    }
+    return pos;
+}
+
+#endif
+
+/* Returns the first character of [p, end[ that is in the set, or end. */
+static const byte *
+sb_esc_find(const sb_esc_set_t *set, const byte *p, const byte *end)
+{
+#ifdef __HAS_CPUID
+    if (end - p >= 16 && sb_has_ssse3()) {
+        p += sb_esc_span_ssse3(set, p, end - p);
+    }
+#endif
+    while (p < end && !TST_BIT(set->chars.tab, *p)) {
+        p++;
+    }
+    return p;
+}
+
+__attribute__((constructor))
+static void sb_xml_esc_init(void)
+{
+    for (int c = 0; c < 256; c++) {
+        if (!test_xml_printable(c)) {
+            sb_esc_set_add(&sb_xml_esc_g, c);
+        }
+    }
+}
+
+/*}}} */
+
 
 void sb_add_slashes(sb_t *sb, const void *_data, int len,
                     const char *toesc, const char *esc)
 {
-    uint32_t buf[BITS_TO_ARRAY_LEN(uint32_t, 256)] = { 0, };
+    sb_esc_set_t set;
     uint8_t  repl[256];
     const byte *p = _data, *end = p + len;
 
+    p_clear(&set, 1);
     while (*toesc) {
         byte c = *toesc++;
-        SET_BIT(buf, c);
+        sb_esc_set_add(&set, c);
         repl[c] = *esc++;
     }
 
-    if (!TST_BIT(buf, '\\')) {
-        SET_BIT(buf, '\\');
+    if (!TST_BIT(set.chars.tab, '\\')) {
+        sb_esc_set_add(&set, '\\');
         repl['\\'] = '\\';
     }
 
@@ -134,11 +434,10 @@ void sb_add_slashes(sb_t *sb, const void *_data, int len,
     while (p < end) {
         const byte *q = p;
 
-        while (p < end && !TST_BIT(buf, *p))
-            p++;
+        p = sb_esc_find(&set, p, end);
         sb_add(sb, q, p - q);
 
-        while (p < end && TST_BIT(buf, *p)) {
+        while (p < end && TST_BIT(set.chars.tab, *p)) {
             byte c = repl[*p++];
 
             if (c) {
@@ -345,6 +644,11 @@ void sb_add_urlencode(sb_t *sb, const void *_data, int len)
     while (p < end) {
         const byte *q = p;
 
+#ifdef __HAS_CPUID
+        if (end - p >= 16 && sb_has_ssse3()) {
+            p += url_span_ssse3(p, end - p);
+        }
+#endif
         while (p < end && __str_url_invalid[*p] != 255)
             p++;
         sb_add(sb, q, p - q);
@@ -429,8 +733,17 @@ void sb_urldecode(sb_t *sb)
 void sb_add_hex(sb_t *sb, const void *data, int len)
 {
     char *s = sb_growlen(sb, len * 2);
+    const byte *p = data;
 
-    for (const byte *p = data, *end = p + len; p < end; p++) {
+#ifdef __HAS_CPUID
+    if (len >= 16 && sb_has_ssse3()) {
+        int done = hex_encode_ssse3(s, p, len);
+
+        s += 2 * done;
+        p += done;
+    }
+#endif
+    for (const byte *end = (const byte *)data + len; p < end; p++) {
         *s++ = __str_digits_upper[(*p >> 4) & 0x0f];
         *s++ = __str_digits_upper[(*p >> 0) & 0x0f];
     }
@@ -440,13 +753,22 @@ SB_DEFINE_ADDS(hex);
 int sb_add_unhex(sb_t *sb, const void *data, int len)
 {
     sb_t orig = *sb;
+    const char *p = data;
     char *s;
 
     if (unlikely(len & 1))
         return -1;
 
     s = sb_growlen(sb, len / 2);
-    for (const char *p = data, *end = p + len; p < end; p += 2) {
+#ifdef __HAS_CPUID
+    if (len >= 32 && sb_has_ssse3()) {
+        int done = hex_decode_ssse3(s, data, len);
+
+        s += done / 2;
+        p += done;
+    }
+#endif
+    for (const char *end = (const char *)data + len; p < end; p += 2) {
         int c = hexdecode(p);
 
         if (unlikely(c < 0))
@@ -465,8 +787,7 @@ void sb_add_xmlescape(sb_t *sb, const void *data, int len)
     while (p < end) {
         const byte *q = p;
 
-        while (p < end && test_xml_printable(*p))
-            p++;
+        p = sb_esc_find(&sb_xml_esc_g, p, end);
         sb_add(sb, q, p - q);
 
         while (p < end && !test_xml_printable(*p)) {
@@ -764,6 +1085,26 @@ static void _sb_add_b64_update(sb_t *dst, const void *src0, int len,
     }
 
     do {
+#ifdef __HAS_CPUID
+        if (end - src >= 16 && sb_has_ssse3()) {
+            int packs = (end - src) / 3;
+
+            if (ppline > 0) {
+                packs = MIN(packs, ppline - pack_num);
+            }
+            packs = b64_encode_ssse3(data, src, end - src, packs, table);
+            src  += 3 * packs;
+            data += 4 * packs;
+            if (ppline > 0 && (pack_num += packs) >= ppline) {
+                pack_num = 0;
+                *data++ = '\r';
+                *data++ = '\n';
+            }
+            if (src + 3 > end) {
+                break;
+            }
+        }
+#endif
         pack  = *src++ << 16;
         pack |= *src++ <<  8;
         pack |= *src++ <<  0;
@@ -863,7 +1204,8 @@ void sb_add_lstr_b64url(sb_t * nonnull sb, lstr_t data, int width)
 }
 
 static int _sb_add_unb64(sb_t *sb, const void *data, int len,
-                         const unsigned char table[256])
+                         const unsigned char table[256],
+                         const char alphabet[64])
 {
     const byte *src = data, *end = src + len;
     sb_t orig = *sb;
@@ -873,6 +1215,17 @@ static int _sb_add_unb64(sb_t *sb, const void *data, int len,
         int ilen = 0;
         char *s;
 
+#ifdef __HAS_CPUID
+        if (end - src >= 16 && sb_has_ssse3()) {
+            int done;
+
+            /* the blocks are written 16 bytes at a time */
+            s     = sb_grow(sb, (end - src) / 16 * 12 + 4);
+            done  = b64_decode_ssse3(s, src, end - src, alphabet);
+            src  += done;
+            __sb_fixlen(sb, sb->len + done / 4 * 3);
+        }
+#endif
         while (ilen < 4 && src < end) {
             int c = *src++;
 
@@ -932,26 +1285,29 @@ error:
 
 int sb_add_unb64(sb_t *sb, const void *data, int len)
 {
-    return _sb_add_unb64(sb, data, len, __decode_base64);
+    return _sb_add_unb64(sb, data, len, __decode_base64, __b64);
 }
 SB_DEFINE_ADDS_ERR(unb64);
 
 int sb_add_unb64url(sb_t *sb, const void *data, int len)
 {
-    return _sb_add_unb64(sb, data, len, __decode_base64url);
+    return _sb_add_unb64(sb, data, len, __decode_base64url, __b64url);
 }
 SB_DEFINE_ADDS_ERR(unb64url);
 
 void sb_add_csvescape(sb_t *sb, int sep, const void *data, int len)
 {
-    static ctype_desc_t ctype_needs_escape;
+    sb_esc_set_t needs_escape;
     pstream_t ps = ps_init(data, len);
     pstream_t cspan;
 
-    ctype_desc_build(&ctype_needs_escape, "\"\n\r");
-    SET_BIT(ctype_needs_escape.tab, sep);
+    p_clear(&needs_escape, 1);
+    sb_esc_set_add(&needs_escape, '"');
+    sb_esc_set_add(&needs_escape, '\n');
+    sb_esc_set_add(&needs_escape, '\r');
+    sb_esc_set_add(&needs_escape, sep);
 
-    cspan = ps_get_cspan(&ps, &ctype_needs_escape);
+    cspan = __ps_get_ps_upto(&ps, sb_esc_find(&needs_escape, ps.b, ps.b_end));
     if (ps_done(&ps)) {
         /* No caracter needing escaping was found, just copy the input
          * string. */
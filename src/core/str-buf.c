@@ -16,9 +16,11 @@
 /*                                                                         */
 /***************************************************************************/
 
+#include <malloc.h>
 #include <math.h>
 
 #include <lib-common/net.h>
+#include <lib-common/thr.h>
 #include <lib-common/unix.h>
 
 const char __sb_slop[1];
@@ -57,7 +59,9 @@ static void __sb_reset(sb_t *sb, int threshold)
         if (ptr != __sb_slop) {
             mp_delete(mp, &ptr);
         }
-        sb_init_full(sb, (char *)__sb_slop, 0, 1, sb->mp);
+        /* a huge buffer goes back to the libc, see __sb_grow */
+        sb_init_full(sb, (char *)__sb_slop, 0, 1,
+                     mp == &mem_pool_mremap ? &mem_pool_libc : sb->mp);
     } else {
         sb_reset_keep_mem(sb);
     }
@@ -128,9 +132,12 @@ void __sb_optimize(sb_t *sb, size_t len)
     if ((mp->mem_pool & MEM_BY_FRAME)) {
         return;
     }
+    if (mp == &mem_pool_mremap && sz < MEM_MREMAP_THRESHOLD) {
+        mp = &mem_pool_libc;
+    }
     buf = mp_new_raw(mp, char, sz);
     p_copy(buf, sb->data, sb->len + 1);
-    mp_ifree(mp, sb->data - sb->skip);
+    mp_ifree(mp_ipool(sb->mp), sb->data - sb->skip);
     sb_init_full(sb, buf, sb->len, sz, mp);
 }
 
@@ -161,6 +168,22 @@ void __sb_grow(sb_t *sb, int extra)
     }
     /* TODO: avoid memmove + memcpy in case of a fallback */
     sb_destroy_skip(sb);
+    if (unlikely(newsz >= (int)MEM_MREMAP_THRESHOLD)
+    &&  mp == &mem_pool_libc)
+    {
+        /* Large buffers move to mappings that are grown with mremap(),
+         * without copying the data again. */
+        char *buf = mp_new_raw(&mem_pool_mremap, char, newsz);
+
+        if (sb->data == __sb_slop) {
+            buf[0] = '\0';
+        } else {
+            p_copy(buf, sb->data, sb->len + 1);
+            mp_ifree(mp, sb->data);
+        }
+        sb->data = buf;
+        sb->mp = &mem_pool_mremap;
+    } else
     if (sb->data == __sb_slop) {
         sb->data = mp_new_raw(sb->mp, char, newsz);
         sb->data[0] = '\0';
@@ -253,6 +276,37 @@ int sb_addf(sb_t *sb, const char *fmt, ...)
     return res;
 }
 
+int sb_addvf_fmt(sb_t *sb, const iprintf_fmt_t *fmt, va_list ap)
+{
+    int len;
+
+    len = sb_avail(sb);
+    if (len != 0) {
+        len = len + 1;
+    }
+
+    len = ivsnprintf_fmt(sb_end(sb), len, fmt, ap);
+
+    if (len <= sb_avail(sb)) {
+        __sb_fixlen(sb, sb->len + len);
+    } else {
+        ivsnprintf_fmt(sb_growlen(sb, len), len + 1, fmt, ap);
+    }
+    return len;
+}
+
+int sb_addf_fmt(sb_t *sb, const iprintf_fmt_t *fmt, ...)
+{
+    int res;
+    va_list args;
+
+    va_start(args, fmt);
+    res = sb_addvf_fmt(sb, fmt, args);
+    va_end(args);
+
+    return res;
+}
+
 int sb_prependvf(sb_t *sb, const char *fmt, va_list ap)
 {
     char buf[BUFSIZ];
@@ -606,3 +660,224 @@ int sb_recv(sb_t *sb, int fd, int hint, int flags)
 {
     return sb_recvfrom(sb, fd, hint, flags, NULL, NULL);
 }
+
+/**************************************************************************/
+/* shared read buffers                                                    */
+/**************************************************************************/
+
+/* The borrowed buffers are allocated by the libc through a pool that keeps
+ * track of their usable size, so that they can grow or be wiped by the
+ * usual string buffer functions. The buffers of the exact size of a class
+ * are cached per thread when they are released, and are linked through
+ * their first word.
+ */
+
+#define SB_RBUF_CACHE_MAX  64
+
+static int const sb_rbuf_sizes_g[] = { 16 << 10, 128 << 10 };
+
+static struct {
+    atomic_size_t borrowed;
+    atomic_size_t cached;
+} sb_rbuf_g;
+
+static __thread struct {
+    void *head;
+    int   count;
+} sb_rbuf_cache_g[countof(sb_rbuf_sizes_g)];
+
+static void sb_rbuf_account(atomic_size_t *counter, void *mem, bool add)
+{
+    size_t size;
+
+    if (mem == MEM_EMPTY_ALLOC) {
+        return;
+    }
+    size = malloc_usable_size(mem);
+    if (add) {
+        atomic_fetch_add_explicit(counter, size, memory_order_relaxed);
+    } else {
+        atomic_fetch_sub_explicit(counter, size, memory_order_relaxed);
+    }
+}
+
+static void *sb_rbuf_malloc(mem_pool_t *mp, size_t size, size_t alignment,
+                            mem_flags_t flags)
+{
+    void *res = mp_imalloc(&mem_pool_libc, size, alignment, flags);
+
+    sb_rbuf_account(&sb_rbuf_g.borrowed, res, true);
+    return res;
+}
+
+static void *sb_rbuf_realloc(mem_pool_t *mp, void *mem, size_t oldsize,
+                             size_t size, size_t alignment, mem_flags_t flags)
+{
+    void *res;
+
+    if (mem) {
+        sb_rbuf_account(&sb_rbuf_g.borrowed, mem, false);
+    }
+    res = mp_irealloc(&mem_pool_libc, mem, oldsize, size, alignment, flags);
+    if (res) {
+        sb_rbuf_account(&sb_rbuf_g.borrowed, res, true);
+    }
+    return res;
+}
+
+static void sb_rbuf_free(mem_pool_t *mp, void *mem)
+{
+    if (mem) {
+        sb_rbuf_account(&sb_rbuf_g.borrowed, mem, false);
+    }
+    mp_ifree(&mem_pool_libc, mem);
+}
+
+static mem_pool_t sb_rbuf_pool_g = {
+    .malloc   = &sb_rbuf_malloc,
+    .realloc  = &sb_rbuf_realloc,
+    .free     = &sb_rbuf_free,
+    .mem_pool = MEM_OTHER | MEM_EFFICIENT_REALLOC,
+    .min_alignment = sizeof(void *),
+    .name     = "sb_rbuf",
+};
+
+void sb_rbuf_borrow(sb_t *sb, int hint)
+{
+    int size = hint <= 0 ? BUFSIZ : hint;
+    char *buf;
+
+    if (sb->data != __sb_slop) {
+        return;
+    }
+    for (int i = 0; i < countof(sb_rbuf_sizes_g); i++) {
+        if (size < sb_rbuf_sizes_g[i]) {
+            buf = sb_rbuf_cache_g[i].head;
+            if (buf) {
+                sb_rbuf_cache_g[i].head = *(void **)buf;
+                sb_rbuf_cache_g[i].count--;
+                sb_rbuf_account(&sb_rbuf_g.cached, buf, false);
+                sb_rbuf_account(&sb_rbuf_g.borrowed, buf, true);
+            } else {
+                buf = mp_new_raw(&sb_rbuf_pool_g, char, sb_rbuf_sizes_g[i]);
+            }
+            sb_init_full(sb, buf, 0, sb_rbuf_sizes_g[i], &sb_rbuf_pool_g);
+            return;
+        }
+    }
+    /* too big for the classes, let the buffer grow as usual */
+}
+
+void sb_rbuf_release(sb_t *sb)
+{
+    char *buf = sb->data - sb->skip;
+    int size = sb->size + sb->skip;
+
+    if (sb->len || sb->data == __sb_slop) {
+        return;
+    }
+    if (sb->mp != &sb_rbuf_pool_g) {
+        if (mp_ipool(sb->mp) == &mem_pool_libc
+        ||  sb->mp == &mem_pool_mremap)
+        {
+            sb_wipe(sb);
+        }
+        return;
+    }
+
+    for (int i = 0; i < countof(sb_rbuf_sizes_g); i++) {
+        if (size == sb_rbuf_sizes_g[i]
+        &&  sb_rbuf_cache_g[i].count < SB_RBUF_CACHE_MAX)
+        {
+            sb_rbuf_account(&sb_rbuf_g.borrowed, buf, false);
+            sb_rbuf_account(&sb_rbuf_g.cached, buf, true);
+            *(void **)buf = sb_rbuf_cache_g[i].head;
+            sb_rbuf_cache_g[i].head = buf;
+            sb_rbuf_cache_g[i].count++;
+            sb_init(sb);
+            return;
+        }
+    }
+    /* the buffer grew, or the cache is full */
+    sb_wipe(sb);
+}
+
+void sb_rbuf_get_stats(sb_rbuf_stats_t *stats)
+{
+    size_t borrowed = atomic_load(&sb_rbuf_g.borrowed);
+
+    stats->borrowed_bytes = borrowed;
+    stats->resident_bytes = borrowed + atomic_load(&sb_rbuf_g.cached);
+}
+
+static void sb_rbuf_thr_wipe(void)
+{
+    for (int i = 0; i < countof(sb_rbuf_sizes_g); i++) {
+        while (sb_rbuf_cache_g[i].head) {
+            void *buf = sb_rbuf_cache_g[i].head;
+
+            sb_rbuf_cache_g[i].head = *(void **)buf;
+            sb_rbuf_account(&sb_rbuf_g.cached, buf, false);
+            mp_ifree(&mem_pool_libc, buf);
+        }
+        sb_rbuf_cache_g[i].count = 0;
+    }
+}
+thr_hooks(NULL, sb_rbuf_thr_wipe);
+
+/**************************************************************************/
+/* ropes                                                                  */
+/**************************************************************************/
+
+void __sb_rope_seal(sb_rope_t *rope)
+{
+    sb_rope_block_t *block;
+
+    if (!rope->sb.len) {
+        return;
+    }
+    if (rope->nb_blocks >= rope->size_blocks) {
+        rope->size_blocks = p_alloc_nr(rope->size_blocks);
+        p_realloc(&rope->blocks, rope->size_blocks);
+    }
+    block = &rope->blocks[rope->nb_blocks++];
+    block->data = sb_detach(&rope->sb, &block->len);
+    rope->blocks_len += block->len;
+
+    /* the next block is allocated at once, and filled without realloc */
+    sb_grow(&rope->sb, rope->block_size);
+}
+
+void sb_rope_reset(sb_rope_t *rope)
+{
+    for (int i = 0; i < rope->nb_blocks; i++) {
+        p_delete(&rope->blocks[i].data);
+    }
+    rope->nb_blocks  = 0;
+    rope->blocks_len = 0;
+    sb_reset(&rope->sb);
+}
+
+void sb_rope_wipe(sb_rope_t *rope)
+{
+    sb_rope_reset(rope);
+    p_delete(&rope->blocks);
+    rope->size_blocks = 0;
+    sb_wipe(&rope->sb);
+}
+
+void sb_rope_flatten(sb_rope_t *rope, sb_t *sb)
+{
+    int64_t len = sb_rope_len(rope);
+    char *p;
+
+    if (unlikely(sb->len + len > INT_MAX - 1)) {
+        e_panic("trying to allocate insane amount of memory");
+    }
+    p = sb_growlen(sb, len);
+    for (int i = 0; i < rope->nb_blocks; i++) {
+        p = mempcpy(p, rope->blocks[i].data, rope->blocks[i].len);
+    }
+    memcpy(p, rope->sb.data, rope->sb.len);
+    sb_rope_reset(rope);
+}
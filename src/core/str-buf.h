@@ -182,6 +182,19 @@ void sb_wipe(sb_t * nonnull sb) __leaf;
 
 GENERIC_NEW(sb_t, sb);
 GENERIC_DELETE(sb_t, sb);
+
+/** Get the memory allocated for the buffer of a strbuf.
+ *
+ * A strbuf on a static or stack buffer (SB()) has no allocated memory.
+ */
+static inline size_t sb_memory_footprint(const sb_t * nonnull sb)
+{
+    if (sb->data == __sb_slop || sb->mp == &mem_pool_static) {
+        return 0;
+    }
+    return sb->skip + sb->size;
+}
+
 #ifdef __cplusplus
 sb_t::sb_t() :
     data((char *)__sb_slop),
@@ -467,6 +480,22 @@ int sb_addvf(sb_t * nonnull sb, const char * nonnull fmt, va_list ap)
     __leaf __attr_printf__(2, 0);
 int sb_addf(sb_t * nonnull sb, const char * nonnull fmt, ...)
     __leaf __attr_printf__(2, 3);
+int sb_addvf_fmt(sb_t * nonnull sb, const iprintf_fmt_t * nonnull fmt,
+                 va_list ap)
+    __leaf;
+int sb_addf_fmt(sb_t * nonnull sb, const iprintf_fmt_t * nonnull fmt, ...)
+    __leaf;
+
+/** sb_addf() with a format parsed once per call site.
+ *
+ * See IPRINTF_FMT().
+ */
+#define sb_addf_cached(sb, fmt, ...)                                         \
+    ({  if (0) {                                                             \
+            sb_addf(sb, fmt, ##__VA_ARGS__);                                 \
+        }                                                                    \
+        sb_addf_fmt(sb, IPRINTF_FMT(fmt), ##__VA_ARGS__);                    \
+    })
 
 /** Reset and optimize a string buffer for sb_prepend().
  *
@@ -695,6 +724,31 @@ int sb_recvfrom(sb_t * nonnull sb, int fd, int hint, int flags,
                 struct sockaddr * nullable addr, socklen_t * nullable alen)
     __leaf;
 
+/** Borrow a read buffer from the shared pool.
+ *
+ * The connections keep their read buffer only while it holds pending data,
+ * so that the idle ones do not use any memory for it: they borrow a buffer
+ * before reading, and release it once the parser consumed the data.
+ *
+ * When \p sb has no memory, it gets a buffer able to read \p hint bytes
+ * (BUFSIZ when \p hint is 0) from a cache of size-classed buffers. The
+ * buffer can grow and be wiped as usual.
+ */
+void sb_rbuf_borrow(sb_t * nonnull sb, int hint) __leaf;
+
+/** Give the memory of an empty read buffer back to the shared pool.
+ *
+ * It does nothing when \p sb still holds data.
+ */
+void sb_rbuf_release(sb_t * nonnull sb) __leaf;
+
+typedef struct sb_rbuf_stats_t {
+    size_t borrowed_bytes;  /* memory of the buffers held by connections */
+    size_t resident_bytes;  /* the same plus the cached buffers */
+} sb_rbuf_stats_t;
+
+void sb_rbuf_get_stats(sb_rbuf_stats_t * nonnull stats) __leaf;
+
 
 /**************************************************************************/
 /* usual quoting mechanisms (base64, addslashes, ...)                     */
@@ -1026,6 +1080,89 @@ int sb_add_utf8_tolower(sb_t * nonnull sb, const char * nonnull s, int len);
 /** append to \p sb the string describe by \p s with an upper case */
 int sb_add_utf8_toupper(sb_t * nonnull sb, const char * nonnull s, int len);
 
+/**************************************************************************/
+/* Ropes                                                                  */
+/**************************************************************************/
+
+/* A rope is a string buffer made of blocks of about block_size bytes.
+ *
+ * The filled blocks are never moved nor copied again when the rope grows,
+ * and can be handed as they are to an outbuf_t (see ob_add_rope()). This is
+ * meant for the very large outputs, like JSon exports of hundreds of MB,
+ * that a sb_t would copy again on each reallocation, with a peak memory of
+ * twice their size.
+ *
+ * The sb_rope_add*() helpers wrap the sb_add*() ones: they append to the
+ * current block, which is sealed once it is nearly full. The appends
+ * smaller than an eighth of the block size never reallocate a block.
+ */
+typedef struct sb_rope_block_t {
+    char * nonnull data;
+    int len;
+} sb_rope_block_t;
+
+typedef struct sb_rope_t {
+    sb_t sb;                    /* block being filled */
+    int  block_size;
+    int  seal_at;
+
+    int  nb_blocks;             /* sealed blocks */
+    int  size_blocks;
+    sb_rope_block_t * nullable blocks;
+    int64_t blocks_len;
+} sb_rope_t;
+
+#define SB_ROPE_BLOCK_SIZE  (1 << 20)
+
+/** Initializes a rope.
+ *
+ * \param[in] block_size  size of the blocks, SB_ROPE_BLOCK_SIZE if <= 0.
+ */
+static inline sb_rope_t * nonnull
+sb_rope_init(sb_rope_t * nonnull rope, int block_size)
+{
+    p_clear(rope, 1);
+    sb_init(&rope->sb);
+    rope->block_size = block_size > 0 ? block_size : SB_ROPE_BLOCK_SIZE;
+    rope->seal_at    = rope->block_size - rope->block_size / 8;
+    return rope;
+}
+
+void sb_rope_wipe(sb_rope_t * nonnull rope) __leaf;
+void sb_rope_reset(sb_rope_t * nonnull rope) __leaf;
+void __sb_rope_seal(sb_rope_t * nonnull rope) __leaf;
+
+static inline int64_t sb_rope_len(const sb_rope_t * nonnull rope)
+{
+    return rope->blocks_len + rope->sb.len;
+}
+
+#define SB_ROPE_WRAP(sb_fun, rope, ...) \
+    do {                                                 \
+        sb_rope_t *__rope = (rope);                      \
+                                                         \
+        sb_fun(&__rope->sb, ##__VA_ARGS__);              \
+        if (__rope->sb.len >= __rope->seal_at) {         \
+            __sb_rope_seal(__rope);                      \
+        }                                                \
+    } while (0)
+
+#define sb_rope_add(rope, data, len)  SB_ROPE_WRAP(sb_add,   rope, data, len)
+#define sb_rope_adds(rope, s)         SB_ROPE_WRAP(sb_adds,  rope, s)
+#define sb_rope_addc(rope, c)         SB_ROPE_WRAP(sb_addc,  rope, c)
+#define sb_rope_add_lstr(rope, s)     SB_ROPE_WRAP(sb_add_lstr, rope, s)
+#define sb_rope_addsb(rope, sb)       SB_ROPE_WRAP(sb_addsb, rope, sb)
+#define sb_rope_addf(rope, fmt, ...) \
+    SB_ROPE_WRAP(sb_addf, rope, fmt, ##__VA_ARGS__)
+#define sb_rope_addvf(rope, fmt, ap)  SB_ROPE_WRAP(sb_addvf, rope, fmt, ap)
+
+/** Appends the content of \p rope to \p sb, and empties \p rope.
+ *
+ * This is meant for the users that need a contiguous buffer: the content is
+ * copied once, in a buffer allocated at its final size.
+ */
+void sb_rope_flatten(sb_rope_t * nonnull rope, sb_t * nonnull sb) __leaf;
+
 /**************************************************************************/
 /* misc helpers                                                           */
 /**************************************************************************/
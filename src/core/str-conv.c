@@ -19,6 +19,13 @@
 #include <lib-common/core.h>
 #include <lib-common/arith.h>
 
+#ifdef __SSE2__
+#   pragma push_macro("__leaf")
+#   undef __leaf
+#   include <emmintrin.h>
+#   pragma pop_macro("__leaf")
+#endif
+
 uint8_t const __utf8_mark[7] = { 0x00, 0x00, 0xc0, 0xe0, 0xf0, 0xf8, 0xfc };
 
 uint8_t const __utf8_clz_to_charlen[32] = {
@@ -50,6 +57,78 @@ uint32_t const __utf8_offs[6] = {
     0x03c82080UL, 0xfa082080UL, 0x82082080UL
 };
 
+/* The validation follows the one of utf8_charlen(): each leading byte of 2,
+ * 3 or 4 bytes must be followed by as many continuation bytes, and the
+ * continuation bytes can't be anywhere else. It is done for 16 bytes at a
+ * time by comparing the continuation bytes of a block to the bytes that
+ * follow the leading bytes of the block and of the end of the previous one,
+ * and the blocks of ASCII characters are just skipped.
+ */
+size_t __utf8_skip_valid_blocks(const char *s, size_t len, size_t *nchars)
+{
+    size_t pos = 0;
+    size_t count = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    __m128i prev = zero;
+
+    for (; pos + 16 <= len; pos += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s + pos));
+        __m128i p1, p2, p3, must, cont, ok;
+        unsigned cont_mask;
+
+        if (!_mm_movemask_epi8(_mm_or_si128(x, prev))) {
+            count += 16;
+            prev   = x;
+            continue;
+        }
+
+        /* the 3 bytes before each byte */
+        p1 = _mm_or_si128(_mm_slli_si128(x, 1), _mm_srli_si128(prev, 15));
+        p2 = _mm_or_si128(_mm_slli_si128(x, 2), _mm_srli_si128(prev, 14));
+        p3 = _mm_or_si128(_mm_slli_si128(x, 3), _mm_srli_si128(prev, 13));
+
+        /* must is 0 where the byte must not be a continuation byte */
+        p1   = _mm_subs_epu8(p1, _mm_set1_epi8((char)0xbf));
+        p2   = _mm_subs_epu8(p2, _mm_set1_epi8((char)0xdf));
+        p3   = _mm_subs_epu8(p3, _mm_set1_epi8((char)0xef));
+        must = _mm_or_si128(_mm_or_si128(p1, p2), p3);
+        /* [0x80, 0xbf] are below 0xc0 as signed bytes */
+        cont = _mm_cmpgt_epi8(_mm_set1_epi8((char)0xc0), x);
+        ok   = _mm_xor_si128(_mm_cmpeq_epi8(must, zero), cont);
+        /* and there are no leading bytes of more than 4 bytes */
+        p1   = _mm_subs_epu8(x, _mm_set1_epi8((char)0xf7));
+        ok   = _mm_and_si128(ok, _mm_cmpeq_epi8(p1, zero));
+        if (_mm_movemask_epi8(ok) != 0xffff) {
+            break;
+        }
+        cont_mask = _mm_movemask_epi8(cont);
+        count    += 16 - bitcount32(cont_mask);
+        prev      = x;
+    }
+
+    /* do not stop in the middle of a character */
+    for (size_t i = 1; i <= 3 && i <= pos; i++) {
+        uint8_t c = s[pos - i];
+
+        if (c < 0x80) {
+            break;
+        }
+        if (c >= 0xc0) {
+            if (__utf8_char_len[c >> 3] > i) {
+                pos -= i;
+                count--;
+            }
+            break;
+        }
+    }
+#endif
+
+    *nchars = count;
+    return pos;
+}
+
 uint8_t const __str_digit_value[128 + 256] = {
 #define REPEAT16(x)  x,x,x,x,x,x,x,x,x,x,x,x,x,x,x,x
     REPEAT16(255), REPEAT16(255), REPEAT16(255), REPEAT16(255),
@@ -672,6 +751,36 @@ int sb_conv_to_latin1(sb_t *sb, const void *data, int len, int rep)
     return 0;
 }
 
+/* Writes the UCS-2 characters of the ASCII prefix of `s` by blocks of 16,
+ * and returns the length of the prefix. */
+static int ucs2_put_ascii_blocks(char *dst, const char *s, int len, bool be)
+{
+    int pos = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; pos + 16 <= len; pos += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s + pos));
+        __m128i lo, hi;
+
+        if (_mm_movemask_epi8(x)) {
+            break;
+        }
+        if (be) {
+            lo = _mm_unpacklo_epi8(zero, x);
+            hi = _mm_unpackhi_epi8(zero, x);
+        } else {
+            lo = _mm_unpacklo_epi8(x, zero);
+            hi = _mm_unpackhi_epi8(x, zero);
+        }
+        _mm_storeu_si128((__m128i *)(dst + 2 * pos), lo);
+        _mm_storeu_si128((__m128i *)(dst + 2 * pos + 16), hi);
+    }
+#endif
+    return pos;
+}
+
 int sb_conv_to_ucs2le(sb_t *sb, const void *data, int len)
 {
     sb_t orig = *sb;
@@ -683,6 +792,10 @@ int sb_conv_to_ucs2le(sb_t *sb, const void *data, int len)
         const char *p = s;
         char *buf;
 
+        /* the output is never longer than 2 * len */
+        s += ucs2_put_ascii_blocks(sb_end(sb), s, end - s, false);
+        __sb_fixlen(sb, sb->len + (s - p) * 2);
+        p = s;
         while (s < end && !(*s & 0x80))
             s++;
         buf = sb_growlen(sb, (s - p) * 2);
@@ -718,6 +831,10 @@ int sb_conv_to_ucs2be(sb_t *sb, const void *data, int len)
         const char *p = s;
         char *buf;
 
+        /* the output is never longer than 2 * len */
+        s += ucs2_put_ascii_blocks(sb_end(sb), s, end - s, true);
+        __sb_fixlen(sb, sb->len + (s - p) * 2);
+        p = s;
         while (s < end && !(*s & 0x80))
             s++;
         buf = sb_growlen(sb, (s - p) * 2);
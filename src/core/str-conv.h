@@ -152,6 +152,22 @@ static inline uint8_t utf8_charlen(const char * nonnull s, int len)
     }
 }
 
+/* Inputs from which the UTF8 scans check the string by blocks. */
+#define UTF8_BLOCKS_MIN  64
+
+/** Skip the valid UTF8 characters of a string by blocks of 16 bytes.
+ *
+ * This is the fast path of utf8_strnlen() and utf8_skip_valid(), it stops
+ * before the first block that has an invalid character, before the last
+ * incomplete block, and never in the middle of a character. The caller has
+ * to finish the work character by character.
+ *
+ * \param[out] nchars  the number of characters skipped.
+ * \return the number of bytes skipped.
+ */
+size_t __utf8_skip_valid_blocks(const char * nonnull s, size_t len,
+                                size_t * nonnull nchars) __leaf;
+
 /** Get the number of UTF8 characters contained in a string.
  *
  * \return -1 in case of invalid UTF8.
@@ -161,6 +177,9 @@ static inline ssize_t utf8_strnlen(const char * nonnull s, size_t len)
     const char *end = s + len;
 
     len = 0;
+    if (end - s >= UTF8_BLOCKS_MIN) {
+        s += __utf8_skip_valid_blocks(s, end - s, &len);
+    }
     while (s < end) {
         uint8_t charlen = utf8_charlen(s, end - s);
 
@@ -261,6 +280,11 @@ static inline int utf8_vgetc(char * nonnull s, char * nullable * nullable out)
 static inline const char * nonnull utf8_skip_valid(const char * nonnull s,
                                                    const char * nonnull end)
 {
+    if (end - s >= UTF8_BLOCKS_MIN) {
+        size_t nchars;
+
+        s += __utf8_skip_valid_blocks(s, end - s, &nchars);
+    }
     while (s < end) {
         if (utf8_ngetc(s, end - s, &s) < 0)
             return s;
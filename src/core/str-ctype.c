@@ -18,6 +18,14 @@
 
 #include <lib-common/core.h>
 
+#ifdef __HAS_CPUID
+#   pragma push_macro("__leaf")
+#   undef __leaf
+#   include <cpuid.h>
+#   include <x86intrin.h>
+#   pragma pop_macro("__leaf")
+#endif
+
 /* ctype description for tokens "abcdefghijklmnopqrstuvwxyz" */
 ctype_desc_t const ctype_islower = {
     {
@@ -142,3 +150,80 @@ ctype_desc_t const ctype_iswordpart = {
         0xffffffff,
     }
 };
+
+/* {{{ Spans */
+
+#ifdef __HAS_CPUID
+
+static bool ctype_has_ssse3(void)
+{
+    static int has_ssse3 = -1;
+
+    if (unlikely(has_ssse3 < 0)) {
+        int eax, ebx, ecx, edx;
+
+        __cpuid(1, eax, ebx, ecx, edx);
+        has_ssse3 = !!(ecx & bit_SSSE3);
+    }
+    return has_ssse3;
+}
+
+/* The byte c is in d if the bit c % 8 of the byte c / 8 of d is set. The
+ * byte c / 8 is looked up with PSHUFB in the first 16 bytes of d for
+ * c < 128, in the last 16 bytes for the others, PSHUFB giving 0 for the
+ * lanes whose index has the high bit set. */
+__attribute__((target("ssse3")))
+static size_t ctype_desc_span_ssse3(const ctype_desc_t *d, const byte *p,
+                                    size_t len, bool in)
+{
+    const __m128i lo_tab = _mm_loadu_si128((const __m128i *)d->tab);
+    const __m128i hi_tab = _mm_loadu_si128((const __m128i *)d->tab + 1);
+    const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                       1, 2, 4, 8, 16, 32, 64, -128);
+    const __m128i hi_bit = _mm_set1_epi8(-128);
+    const __m128i lo_3bits = _mm_set1_epi8(0x07);
+    const __m128i lo_4bits = _mm_set1_epi8(0x0f);
+    const unsigned stop = in ? 0 : 0xffff;
+    size_t pos = 0;
+
+    for (; pos + 16 <= len; pos += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + pos));
+        __m128i idx, bit, row;
+        unsigned mask;
+
+        idx  = _mm_and_si128(_mm_srli_epi16(x, 3), lo_4bits);
+        idx  = _mm_or_si128(idx, _mm_and_si128(x, hi_bit));
+        row  = _mm_or_si128(_mm_shuffle_epi8(lo_tab, idx),
+                            _mm_shuffle_epi8(hi_tab,
+                                             _mm_xor_si128(idx, hi_bit)));
+        bit  = _mm_shuffle_epi8(bits, _mm_and_si128(x, lo_3bits));
+        row  = _mm_and_si128(row, bit);
+        /* bytes not in d */
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(row, _mm_setzero_si128()));
+        mask ^= stop;
+        if (mask) {
+            return pos + bsf32(mask);
+        }
+    }
+    return pos;
+}
+
+#endif
+
+size_t __ctype_desc_span(const ctype_desc_t *d, const byte *p, size_t len,
+                         bool in)
+{
+    size_t pos = 0;
+
+#ifdef __HAS_CPUID
+    if (len >= 16 && ctype_has_ssse3()) {
+        pos = ctype_desc_span_ssse3(d, p, len, in);
+    }
+#endif
+    while (pos < len && ctype_desc_contains(d, p[pos]) == in) {
+        pos++;
+    }
+    return pos;
+}
+
+/* }}} */
@@ -91,6 +91,48 @@ static inline bool ctype_desc_contains(const ctype_desc_t * nonnull d, byte b)
     return TST_BIT(d->tab, b);
 }
 
+/** Length of the prefix of \p p made of bytes of \p d if \p in is true, of
+ * bytes not in \p d otherwise.
+ *
+ * Use ctype_desc_span() and ctype_desc_cspan(). The spans are checked 16
+ * bytes at a time when the CPU has SSSE3, with the 32 bytes of \p d used as
+ * two PSHUFB lookup tables: there is no table to precompute per ctype.
+ */
+size_t __ctype_desc_span(const ctype_desc_t * nonnull d,
+                         const byte * nonnull p, size_t len, bool in)
+    __leaf;
+
+/** Length of the prefix of \p p made of bytes of \p d. */
+static inline size_t ctype_desc_span(const ctype_desc_t * nonnull d,
+                                     const void * nonnull p, size_t len)
+{
+    const byte *b = (const byte *)p;
+    size_t l = 0;
+
+    /* most spans are short, their first bytes are checked inline */
+    for (; l < len && l < 8; l++) {
+        if (!ctype_desc_contains(d, b[l])) {
+            return l;
+        }
+    }
+    return l < len ? l + __ctype_desc_span(d, b + l, len - l, true) : l;
+}
+
+/** Length of the prefix of \p p made of bytes that are not in \p d. */
+static inline size_t ctype_desc_cspan(const ctype_desc_t * nonnull d,
+                                      const void * nonnull p, size_t len)
+{
+    const byte *b = (const byte *)p;
+    size_t l = 0;
+
+    for (; l < len && l < 8; l++) {
+        if (ctype_desc_contains(d, b[l])) {
+            return l;
+        }
+    }
+    return l < len ? l + __ctype_desc_span(d, b + l, len - l, false) : l;
+}
+
 /* @func ctype_desc_combine
  * param[in] d1
  * param[in] d2
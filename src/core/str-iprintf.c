@@ -190,17 +190,45 @@ char *dtoa(double d, int mode, int ndigits, int *decpt, int *sign, char **rve);
 
 /*---------------- helpers ----------------*/
 
+/* Decimal digits of 0 to 99 */
+static const char digit_pairs_g[200] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* Writes the decimal digits of value before p, two at a time. Nothing is
+ * written for 0. */
+static ALWAYS_INLINE char *convert_uint10(char *p, unsigned int value)
+{
+    while (value >= 100) {
+        unsigned int quot = value / 100;
+
+        p -= 2;
+        memcpy(p, digit_pairs_g + 2 * (value - quot * 100), 2);
+        value = quot;
+    }
+    if (value >= 10) {
+        p -= 2;
+        memcpy(p, digit_pairs_g + 2 * value, 2);
+    } else
+    if (value > 0) {
+        *--p = '0' + value;
+    }
+    return p;
+}
+
 static ALWAYS_INLINE char *convert_int10(char *p, int value)
 {
     /* compute absolute value without tests */
     unsigned int bits = value >> (bitsizeof(int) - 1);
     unsigned int num = (value ^ bits) + (bits & 1);
 
-    while (num >= 10) {
-        *--p = '0' + (num % 10);
-        num = num / 10;
+    p = convert_uint10(p, num);
+    if (num == 0) {
+        *--p = '0';
     }
-    *--p = '0' + num;
     if (value < 0) {
         *--p = '-';
     }
@@ -211,10 +239,7 @@ static ALWAYS_INLINE
 char *convert_uint(char *p, unsigned int value, int base)
 {
     if (base == 10) {
-        while (value > 0) {
-            *--p = '0' + (value % 10);
-            value = value / 10;
-        }
+        return convert_uint10(p, value);
     } else
     if (base == 16) {
         while (value > 0) {
@@ -233,13 +258,13 @@ char *convert_uint(char *p, unsigned int value, int base)
 static ALWAYS_INLINE char *
 convert_uint_10_8_0(char *p, unsigned int value)
 {
-    int i;
+    for (int i = 0; i < 4; i++) {
+        unsigned int quot = value / 100;
 
-    for (i = 7; i-- > 0; ) {
-        *--p = '0' + (value % 10);
-        value /= 10;
+        p -= 2;
+        memcpy(p, digit_pairs_g + 2 * (value - quot * 100), 2);
+        value = quot;
     }
-    *--p = '0' + value;
     return p;
 }
 
@@ -442,67 +467,65 @@ static struct formatter_t put_memory_fmt_g[256] = {
     ['L'] = { { .ptr_formatter = &fmt_output_lstr }, .is_raw = false }
 };
 
+static ALWAYS_INLINE
+ssize_t fmt_output_formatter(FILE *stream, char *str, size_t size,
+                             size_t count, const struct formatter_t *format,
+                             int modifier, const char *lp, size_t len)
+{
+    size_t out_len;
+
+    size = count >= size ? 0 : size - count - 1;
+    str += count;
+    if (format->is_raw) {
+        if (!expect(format->raw_formatter)) {
+            return -1;
+        }
+
+        out_len = RETHROW((*format->raw_formatter)(modifier, lp, len,
+                                                   stream, str, size));
+    } else {
+        if (!expect(format->ptr_formatter)) {
+            return -1;
+        }
+        out_len = RETHROW((*format->ptr_formatter)(modifier, lp, stream,
+                                                   str, size));
+    }
+
+    return count + out_len;
+}
+
 static ALWAYS_INLINE
 ssize_t fmt_output_chunk(FILE *stream, char *str, size_t size,
                          size_t count, const char *lp, size_t len,
                          int modifier)
 {
-    const struct formatter_t *format;
     size_t out_len;
 
-    size = count >= size ? 0 : size - count - 1;
-    str += count;
     if (likely(modifier == 'M')) {
+        size = count >= size ? 0 : size - count - 1;
+        str += count;
         out_len = RETHROW(fmt_output_raw(modifier, lp, len, stream,
                                          str, size));
-    } else {
-        format = &put_memory_fmt_g[(unsigned char)modifier];
-
-        if (format->is_raw) {
-            if (!expect(format->raw_formatter)) {
-                return -1;
-            }
-
-            out_len = RETHROW((*format->raw_formatter)(modifier, lp, len,
-                                                       stream, str, size));
-        } else {
-            if (!expect(format->ptr_formatter)) {
-                return -1;
-            }
-            out_len = RETHROW((*format->ptr_formatter)(modifier, lp, stream,
-                                                       str, size));
-        }
+        return count + out_len;
     }
 
-    return count + out_len;
+    return fmt_output_formatter(stream, str, size, count,
+                                &put_memory_fmt_g[(unsigned char)modifier],
+                                modifier, lp, len);
 }
 
-static int fmt_output(FILE *stream, char *str, size_t size,
-                      const char *format, va_list ap)
+/* Formats \p format after the \p count characters already output, consuming
+ * its arguments from \p ap. The output is not zero-terminated.
+ */
+static int fmt_output_at(FILE *stream, char *str, size_t size, int count,
+                         int save_errno, const char *format, va_list *ap)
 {
     char buf[64];
-    int c, count, len, width, prec, base, flags, type_flags;
+    int c, len, width, prec, base, flags, type_flags;
     int left_pad, prefix_len, zero_pad, right_pad;
     const char *lp;
     int sign;
-    int save_errno = errno;
 
-    if (size > INT_MAX) {
-        size = 0;
-    }
-
-    if (!format) {
-        /* set output to empty string out of compatibility with side
-         * effect in glibc.  NULL format is really an error
-         */
-        if (!stream && size > 0) {
-            str[0] = '\0';
-        }
-        errno = EINVAL;
-        return -1;
-    }
-
-    count = 0;
     right_pad = 0;
 
 #if 0
@@ -539,13 +562,13 @@ static int fmt_output(FILE *stream, char *str, size_t size,
         /* special case naked %d and %s formats */
         if (*format == 'd') {
             format++;
-            lp = convert_int10(buf + sizeof(buf), va_arg(ap, int));
+            lp = convert_int10(buf + sizeof(buf), va_arg(*ap, int));
             len = buf + sizeof(buf) - lp;
             goto haslp;
         }
         if (*format == 's') {
             format++;
-            lp = va_arg(ap, const char *);
+            lp = va_arg(*ap, const char *);
             if (lp == NULL)
                 lp = "(null)";
             len = strlen(lp);
@@ -554,8 +577,8 @@ static int fmt_output(FILE *stream, char *str, size_t size,
         /* also special case %.*s */
         if (format[0] == '.' && format[1] == '*' && format[2] == 's') {
             format += 3;
-            len = va_arg(ap, int);
-            lp = va_arg(ap, const char *);
+            len = va_arg(*ap, int);
+            lp = va_arg(*ap, const char *);
             if (lp == NULL) {
                 lp = "(null)";
                 len = 6;
@@ -574,8 +597,8 @@ static int fmt_output(FILE *stream, char *str, size_t size,
         {
             modifier = format[2];
             format += 3;
-            len = va_arg(ap, int);
-            lp  = va_arg(ap, const char *);
+            len = va_arg(*ap, int);
+            lp  = va_arg(*ap, const char *);
 
             /* XXX No "trailing garbage" consumption: we support only single
              *     character modifiers for now.
@@ -589,7 +612,7 @@ static int fmt_output(FILE *stream, char *str, size_t size,
             modifier = format[1];
             format += 2;
             len = 0;
-            lp  = va_arg(ap, const char *);
+            lp  = va_arg(*ap, const char *);
 
             goto haslp;
         }
@@ -618,7 +641,7 @@ static int fmt_output(FILE *stream, char *str, size_t size,
         if (*format == '*') {
             format++;
             flags |= FLAG_WIDTH;
-            width = va_arg(ap, int);
+            width = va_arg(*ap, int);
             if (width < 0) {
                 flags |= FLAG_MINUS;
                 width = -width;
@@ -641,7 +664,7 @@ static int fmt_output(FILE *stream, char *str, size_t size,
             flags |= FLAG_PREC;
             if (*format == '*') {
                 format++;
-                prec = va_arg(ap, int);
+                prec = va_arg(*ap, int);
                 if (prec < 0) {
                     /* OG: should be treated as if precision were
                      * omitted, ie: prec = 1, flags &= ~FLAG_PREC
@@ -717,31 +740,31 @@ static int fmt_output(FILE *stream, char *str, size_t size,
         case 'n':
 #if 0
             /* Consume pointer to int from argument list, but ignore it */
-            (void)va_arg(ap, int *);
+            (void)va_arg(*ap, int *);
 #else
             /* The type of pointer defaults to int* but can be
              * specified with the TYPE_xxx prefixes */
             switch (type_flags) {
               case TYPE_char:
-                *va_arg(ap, char *) = count;
+                *va_arg(*ap, char *) = count;
                 break;
 
               case TYPE_short:
-                *va_arg(ap, short *) = count;
+                *va_arg(*ap, short *) = count;
                 break;
 
               case TYPE_int:
               default:
-                *va_arg(ap, int *) = count;
+                *va_arg(*ap, int *) = count;
                 break;
 #ifdef WANT_long
               case TYPE_long:
-                *va_arg(ap, long *) = count;
+                *va_arg(*ap, long *) = count;
                 break;
 #endif
 #ifdef WANT_llong
               case TYPE_llong:
-                *va_arg(ap, long long *) = count;
+                *va_arg(*ap, long long *) = count;
                 break;
 #endif
             }
@@ -750,7 +773,7 @@ static int fmt_output(FILE *stream, char *str, size_t size,
 
         case 'c':
             /* ignore 'l' prefix for wide char converted with wcrtomb() */
-            c = (unsigned char)va_arg(ap, int);
+            c = (unsigned char)va_arg(*ap, int);
             goto has_char;
 
         case '%':
@@ -767,7 +790,7 @@ static int fmt_output(FILE *stream, char *str, size_t size,
 
         case 's':
             /* ignore 'l' prefix for wide char string */
-            lp = va_arg(ap, char *);
+            lp = va_arg(*ap, char *);
             if (lp == NULL) {
                 lp = "(null)";
             }
@@ -795,15 +818,15 @@ static int fmt_output(FILE *stream, char *str, size_t size,
                 int int_value;
 
               case TYPE_char:
-                int_value = (char)va_arg(ap, int);
+                int_value = (char)va_arg(*ap, int);
                 goto convert_int;
 
               case TYPE_short:
-                int_value = (short)va_arg(ap, int);
+                int_value = (short)va_arg(*ap, int);
                 goto convert_int;
 
               case TYPE_int:
-                int_value = va_arg(ap, int);
+                int_value = va_arg(*ap, int);
               convert_int:
                 {
                     unsigned int bits = int_value >> (bitsizeof(int_value) - 1);
@@ -815,7 +838,7 @@ static int fmt_output(FILE *stream, char *str, size_t size,
 #ifdef WANT_long
               case TYPE_long:
                 {
-                    long value = va_arg(ap, long);
+                    long value = va_arg(*ap, long);
                     unsigned long bits = value >> (bitsizeof(value) - 1);
                     unsigned long num = (value ^ bits) + (bits & 1);
                     sign = '-' & bits;
@@ -826,7 +849,7 @@ static int fmt_output(FILE *stream, char *str, size_t size,
 #ifdef WANT_llong
               case TYPE_llong:
                 {
-                    long long value = va_arg(ap, long long);
+                    long long value = va_arg(*ap, long long);
                     unsigned long long bits = value >> (bitsizeof(value) - 1);
                     unsigned long long num = (value ^ bits) + (bits & 1);
                     sign = '-' & bits;
@@ -837,7 +860,7 @@ static int fmt_output(FILE *stream, char *str, size_t size,
 #ifdef WANT_int32
               case TYPE_int32:
                 {
-                    int32_t value = va_arg(ap, int32_t);
+                    int32_t value = va_arg(*ap, int32_t);
                     uint32_t bits = value >> (bitsizeof(value) - 1);
                     uint32_t num = (value ^ bits) + (bits & 1);
                     sign = '-' & bits;
@@ -848,7 +871,7 @@ static int fmt_output(FILE *stream, char *str, size_t size,
 #ifdef WANT_int64
               case TYPE_int64:
                 {
-                    int64_t value = va_arg(ap, int64_t);
+                    int64_t value = va_arg(*ap, int64_t);
                     uint64_t bits = value >> (bitsizeof(value) - 1);
                     uint64_t num = (value ^ bits) + (bits & 1);
                     sign = '-' & bits;
@@ -872,15 +895,15 @@ static int fmt_output(FILE *stream, char *str, size_t size,
                 int int_value;
 
               case TYPE_char:
-                int_value = (char)va_arg(ap, int);
+                int_value = (char)va_arg(*ap, int);
                 goto convert_quoted_int;
 
               case TYPE_short:
-                int_value = (short)va_arg(ap, int);
+                int_value = (short)va_arg(*ap, int);
                 goto convert_quoted_int;
 
               case TYPE_int:
-                int_value = va_arg(ap, int);
+                int_value = va_arg(*ap, int);
               convert_quoted_int:
                 {
                     unsigned int bits = int_value >> (bitsizeof(int_value) - 1);
@@ -892,7 +915,7 @@ static int fmt_output(FILE *stream, char *str, size_t size,
 #ifdef WANT_long
               case TYPE_long:
                 {
-                    long value = va_arg(ap, long);
+                    long value = va_arg(*ap, long);
                     unsigned long bits = value >> (bitsizeof(value) - 1);
                     unsigned long num = (value ^ bits) + (bits & 1);
                     sign = '-' & bits;
@@ -903,7 +926,7 @@ static int fmt_output(FILE *stream, char *str, size_t size,
 #ifdef WANT_llong
               case TYPE_llong:
                 {
-                    long long value = va_arg(ap, long long);
+                    long long value = va_arg(*ap, long long);
                     unsigned long long bits = value >> (bitsizeof(value) - 1);
                     unsigned long long num = (value ^ bits) + (bits & 1);
                     sign = '-' & bits;
@@ -914,7 +937,7 @@ static int fmt_output(FILE *stream, char *str, size_t size,
 #ifdef WANT_int32
               case TYPE_int32:
                 {
-                    int32_t value = va_arg(ap, int32_t);
+                    int32_t value = va_arg(*ap, int32_t);
                     uint32_t bits = value >> (bitsizeof(value) - 1);
                     uint32_t num = (value ^ bits) + (bits & 1);
                     sign = '-' & bits;
@@ -925,7 +948,7 @@ static int fmt_output(FILE *stream, char *str, size_t size,
 #ifdef WANT_int64
               case TYPE_int64:
                 {
-                    int64_t value = va_arg(ap, int64_t);
+                    int64_t value = va_arg(*ap, int64_t);
                     uint64_t bits = value >> (bitsizeof(value) - 1);
                     uint64_t num = (value ^ bits) + (bits & 1);
                     sign = '-' & bits;
@@ -996,7 +1019,7 @@ static int fmt_output(FILE *stream, char *str, size_t size,
                 do { format++; } while (isalnum((unsigned char)*format));
             }
             {
-                void *vp = va_arg(ap, void *);
+                void *vp = va_arg(*ap, void *);
 
                 if (vp == NULL) {
                     lp = "(nil)";
@@ -1031,40 +1054,40 @@ static int fmt_output(FILE *stream, char *str, size_t size,
                 unsigned uint_value;
 
               case TYPE_char:
-                uint_value = (unsigned char)va_arg(ap, unsigned int);
+                uint_value = (unsigned char)va_arg(*ap, unsigned int);
                 goto convert_uint;
 
               case TYPE_short:
-                uint_value = (unsigned short)va_arg(ap, unsigned int);
+                uint_value = (unsigned short)va_arg(*ap, unsigned int);
                 goto convert_uint;
 
               case TYPE_int:
-                uint_value = va_arg(ap, unsigned int);
+                uint_value = va_arg(*ap, unsigned int);
               convert_uint:
                 lp = convert_uint(buf + sizeof(buf), uint_value, base);
                 break;
 #ifdef WANT_long
               case TYPE_long:
                 lp = convert_ulong(buf + sizeof(buf),
-                                   va_arg(ap, unsigned long), base);
+                                   va_arg(*ap, unsigned long), base);
                 break;
 #endif
 #ifdef WANT_llong
               case TYPE_llong:
                 lp = convert_ullong(buf + sizeof(buf),
-                                    va_arg(ap, unsigned long long), base);
+                                    va_arg(*ap, unsigned long long), base);
                 break;
 #endif
 #ifdef WANT_int32
               case TYPE_int32:
                 lp = convert_uint32(buf + sizeof(buf),
-                                    va_arg(ap, uint32_t), base);
+                                    va_arg(*ap, uint32_t), base);
                 break;
 #endif
 #ifdef WANT_int64
               case TYPE_int64:
                 lp = convert_uint64(buf + sizeof(buf),
-                                    va_arg(ap, uint64_t), base);
+                                    va_arg(*ap, uint64_t), base);
                 break;
 #endif
               default:
@@ -1083,41 +1106,41 @@ static int fmt_output(FILE *stream, char *str, size_t size,
                 unsigned uint_value;
 
               case TYPE_char:
-                uint_value = (unsigned char)va_arg(ap, unsigned int);
+                uint_value = (unsigned char)va_arg(*ap, unsigned int);
                 goto convert_quoted_uint;
 
               case TYPE_short:
-                uint_value = (unsigned short)va_arg(ap, unsigned int);
+                uint_value = (unsigned short)va_arg(*ap, unsigned int);
                 goto convert_quoted_uint;
 
               case TYPE_int:
-                uint_value = va_arg(ap, unsigned int);
+                uint_value = va_arg(*ap, unsigned int);
               convert_quoted_uint:
                 lp = convert_quoted_uint(buf + sizeof(buf), uint_value, base);
                 break;
 #ifdef WANT_long
               case TYPE_long:
                 lp = convert_quoted_uint(buf + sizeof(buf),
-                                         va_arg(ap, unsigned long), base);
+                                         va_arg(*ap, unsigned long), base);
                 break;
 #endif
 #ifdef WANT_llong
               case TYPE_llong:
                 lp = convert_quoted_uint(buf + sizeof(buf),
-                                         va_arg(ap, unsigned long long),
+                                         va_arg(*ap, unsigned long long),
                                          base);
                 break;
 #endif
 #ifdef WANT_int32
               case TYPE_int32:
                 lp = convert_quoted_uint(buf + sizeof(buf),
-                                         va_arg(ap, uint32_t), base);
+                                         va_arg(*ap, uint32_t), base);
                 break;
 #endif
 #ifdef WANT_int64
               case TYPE_int64:
                 lp = convert_quoted_uint(buf + sizeof(buf),
-                                         va_arg(ap, uint64_t), base);
+                                         va_arg(*ap, uint64_t), base);
                 break;
 #endif
               default:
@@ -1239,9 +1262,9 @@ static int fmt_output(FILE *stream, char *str, size_t size,
 
                 /* fetch double value */
                 if (type_flags == TYPE_ldouble) {
-                    fpvalue = (double)va_arg(ap, long double);
+                    fpvalue = (double)va_arg(*ap, long double);
                 } else {
-                    fpvalue = va_arg(ap, double);
+                    fpvalue = va_arg(*ap, double);
                 }
 
 #ifdef FLOATING_POINT
@@ -1431,6 +1454,17 @@ static int fmt_output(FILE *stream, char *str, size_t size,
     }
 
   done:
+#if 0
+    /* Unlock the stream.  */
+    _IO_funlockfile (s);
+    _IO_cleanup_region_end (0);
+#endif
+
+    return count;
+}
+
+static int fmt_output_end(FILE *stream, char *str, size_t size, int count)
+{
     if (!stream) {
         if (count < (int)size) {
             str[count] = '\0';
@@ -1439,15 +1473,38 @@ static int fmt_output(FILE *stream, char *str, size_t size,
             str[size - 1] = '\0';
         }
     }
-#if 0
-    /* Unlock the stream.  */
-    _IO_funlockfile (s);
-    _IO_cleanup_region_end (0);
-#endif
-
     return count;
 }
 
+static int fmt_output(FILE *stream, char *str, size_t size,
+                      const char *format, va_list ap)
+{
+    int save_errno = errno;
+    int count;
+    va_list ap2;
+
+    if (size > INT_MAX) {
+        size = 0;
+    }
+
+    if (!format) {
+        /* set output to empty string out of compatibility with side
+         * effect in glibc.  NULL format is really an error
+         */
+        if (!stream && size > 0) {
+            str[0] = '\0';
+        }
+        errno = EINVAL;
+        return -1;
+    }
+
+    va_copy(ap2, ap);
+    count = fmt_output_at(stream, str, size, 0, save_errno, format, &ap2);
+    va_end(ap2);
+
+    return fmt_output_end(stream, str, size, count);
+}
+
 /*---------------- printf functions ----------------*/
 
 int iprintf(const char *format, ...)
@@ -1593,6 +1650,258 @@ extern char *_ldtoa_r(_LONG_DOUBLE, int, int, int *, int *, char **);
 #define word0(x) ldword0(x)
 #endif
 
+/* {{{ Grisu fast path of dtoa() */
+
+/* Fast path of dtoa() mode 2 (ndigits significant digits), after
+ * F. Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with
+ * Integers" (Grisu), in the "counted" variant of the double-conversion
+ * library.
+ *
+ * The value is scaled by a cached power of ten so that its integral part
+ * fits in 32 bits, and the digits are generated from this 64-bit
+ * approximation. They are kept only if the approximation error cannot change
+ * the rounding of the last digit, which is the case for almost all values;
+ * otherwise dtoa() is used. The result is thus always the correctly rounded
+ * one of dtoa().
+ */
+
+#define GRISU_MAX_DIGITS   17
+
+typedef struct diy_fp_t {
+    uint64_t f;
+    int      e;
+} diy_fp_t;
+
+/* 10^k ~= f * 2^e for k = -348, -340, ..., 340, with f normalized and
+ * rounded to nearest.
+ */
+static const struct {
+    uint64_t f;
+    int16_t  e;
+    int16_t  k;
+} grisu_powers_g[] = {
+    { 0xfa8fd5a0081c0288ULL, -1220, -348 },
+    { 0xbaaee17fa23ebf76ULL, -1193, -340 },
+    { 0x8b16fb203055ac76ULL, -1166, -332 },
+    { 0xcf42894a5dce35eaULL, -1140, -324 },
+    { 0x9a6bb0aa55653b2dULL, -1113, -316 },
+    { 0xe61acf033d1a45dfULL, -1087, -308 },
+    { 0xab70fe17c79ac6caULL, -1060, -300 },
+    { 0xff77b1fcbebcdc4fULL, -1034, -292 },
+    { 0xbe5691ef416bd60cULL, -1007, -284 },
+    { 0x8dd01fad907ffc3cULL,  -980, -276 },
+    { 0xd3515c2831559a83ULL,  -954, -268 },
+    { 0x9d71ac8fada6c9b5ULL,  -927, -260 },
+    { 0xea9c227723ee8bcbULL,  -901, -252 },
+    { 0xaecc49914078536dULL,  -874, -244 },
+    { 0x823c12795db6ce57ULL,  -847, -236 },
+    { 0xc21094364dfb5637ULL,  -821, -228 },
+    { 0x9096ea6f3848984fULL,  -794, -220 },
+    { 0xd77485cb25823ac7ULL,  -768, -212 },
+    { 0xa086cfcd97bf97f4ULL,  -741, -204 },
+    { 0xef340a98172aace5ULL,  -715, -196 },
+    { 0xb23867fb2a35b28eULL,  -688, -188 },
+    { 0x84c8d4dfd2c63f3bULL,  -661, -180 },
+    { 0xc5dd44271ad3cdbaULL,  -635, -172 },
+    { 0x936b9fcebb25c996ULL,  -608, -164 },
+    { 0xdbac6c247d62a584ULL,  -582, -156 },
+    { 0xa3ab66580d5fdaf6ULL,  -555, -148 },
+    { 0xf3e2f893dec3f126ULL,  -529, -140 },
+    { 0xb5b5ada8aaff80b8ULL,  -502, -132 },
+    { 0x87625f056c7c4a8bULL,  -475, -124 },
+    { 0xc9bcff6034c13053ULL,  -449, -116 },
+    { 0x964e858c91ba2655ULL,  -422, -108 },
+    { 0xdff9772470297ebdULL,  -396, -100 },
+    { 0xa6dfbd9fb8e5b88fULL,  -369,  -92 },
+    { 0xf8a95fcf88747d94ULL,  -343,  -84 },
+    { 0xb94470938fa89bcfULL,  -316,  -76 },
+    { 0x8a08f0f8bf0f156bULL,  -289,  -68 },
+    { 0xcdb02555653131b6ULL,  -263,  -60 },
+    { 0x993fe2c6d07b7facULL,  -236,  -52 },
+    { 0xe45c10c42a2b3b06ULL,  -210,  -44 },
+    { 0xaa242499697392d3ULL,  -183,  -36 },
+    { 0xfd87b5f28300ca0eULL,  -157,  -28 },
+    { 0xbce5086492111aebULL,  -130,  -20 },
+    { 0x8cbccc096f5088ccULL,  -103,  -12 },
+    { 0xd1b71758e219652cULL,   -77,   -4 },
+    { 0x9c40000000000000ULL,   -50,    4 },
+    { 0xe8d4a51000000000ULL,   -24,   12 },
+    { 0xad78ebc5ac620000ULL,     3,   20 },
+    { 0x813f3978f8940984ULL,    30,   28 },
+    { 0xc097ce7bc90715b3ULL,    56,   36 },
+    { 0x8f7e32ce7bea5c70ULL,    83,   44 },
+    { 0xd5d238a4abe98068ULL,   109,   52 },
+    { 0x9f4f2726179a2245ULL,   136,   60 },
+    { 0xed63a231d4c4fb27ULL,   162,   68 },
+    { 0xb0de65388cc8ada8ULL,   189,   76 },
+    { 0x83c7088e1aab65dbULL,   216,   84 },
+    { 0xc45d1df942711d9aULL,   242,   92 },
+    { 0x924d692ca61be758ULL,   269,  100 },
+    { 0xda01ee641a708deaULL,   295,  108 },
+    { 0xa26da3999aef774aULL,   322,  116 },
+    { 0xf209787bb47d6b85ULL,   348,  124 },
+    { 0xb454e4a179dd1877ULL,   375,  132 },
+    { 0x865b86925b9bc5c2ULL,   402,  140 },
+    { 0xc83553c5c8965d3dULL,   428,  148 },
+    { 0x952ab45cfa97a0b3ULL,   455,  156 },
+    { 0xde469fbd99a05fe3ULL,   481,  164 },
+    { 0xa59bc234db398c25ULL,   508,  172 },
+    { 0xf6c69a72a3989f5cULL,   534,  180 },
+    { 0xb7dcbf5354e9beceULL,   561,  188 },
+    { 0x88fcf317f22241e2ULL,   588,  196 },
+    { 0xcc20ce9bd35c78a5ULL,   614,  204 },
+    { 0x98165af37b2153dfULL,   641,  212 },
+    { 0xe2a0b5dc971f303aULL,   667,  220 },
+    { 0xa8d9d1535ce3b396ULL,   694,  228 },
+    { 0xfb9b7cd9a4a7443cULL,   720,  236 },
+    { 0xbb764c4ca7a44410ULL,   747,  244 },
+    { 0x8bab8eefb6409c1aULL,   774,  252 },
+    { 0xd01fef10a657842cULL,   800,  260 },
+    { 0x9b10a4e5e9913129ULL,   827,  268 },
+    { 0xe7109bfba19c0c9dULL,   853,  276 },
+    { 0xac2820d9623bf429ULL,   880,  284 },
+    { 0x80444b5e7aa7cf85ULL,   907,  292 },
+    { 0xbf21e44003acdd2dULL,   933,  300 },
+    { 0x8e679c2f5e44ff8fULL,   960,  308 },
+    { 0xd433179d9c8cb841ULL,   986,  316 },
+    { 0x9e19db92b4e31ba9ULL,  1013,  324 },
+    { 0xeb96bf6ebadf77d9ULL,  1039,  332 },
+    { 0xaf87023b9bf0ee6bULL,  1066,  340 },
+};
+
+#define GRISU_POWERS_MIN_K  (-348)
+#define GRISU_POWERS_STEP   8
+
+/* dtoa() digits buffer of the fast path, with room for the trailing zeros
+ * added by cvt(). */
+static __thread char grisu_digits_g[GRISU_MAX_DIGITS + 1];
+
+static ALWAYS_INLINE diy_fp_t diy_fp_mul(diy_fp_t a, diy_fp_t b)
+{
+    unsigned __int128 p = (unsigned __int128)a.f * b.f;
+
+    /* round to nearest */
+    return (diy_fp_t){
+        .f = (uint64_t)(p >> 64) + ((uint64_t)p >> 63),
+        .e = a.e + b.e + 64,
+    };
+}
+
+/* Rounds the last generated digit, rest being what is left of the value in
+ * units of which ten_kappa is the last digit weight and unit the error.
+ */
+static bool grisu_round_weed(char *buf, int len, uint64_t rest,
+                             uint64_t ten_kappa, uint64_t unit, int *kappa)
+{
+    if (unit >= ten_kappa || ten_kappa - unit <= unit) {
+        return false;
+    }
+
+    /* rest + unit is below the half of the last digit: round down */
+    if (ten_kappa - rest > rest && ten_kappa - 2 * rest >= 2 * unit) {
+        return true;
+    }
+
+    /* rest - unit is above the half of the last digit: round up */
+    if (rest > unit && ten_kappa - (rest - unit) <= (rest - unit)) {
+        buf[len - 1]++;
+        for (int i = len - 1; i > 0 && buf[i] == '0' + 10; i--) {
+            buf[i] = '0';
+            buf[i - 1]++;
+        }
+        if (buf[0] == '0' + 10) {
+            buf[0] = '1';
+            (*kappa)++;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+/* Generates the ndigits first digits of the positive finite value v, as
+ * dtoa(v, 2, ndigits, decpt, ...) would, trailing zeros excepted. */
+static bool grisu_counted(double v, int ndigits, char *buf, int *length,
+                          int *decpt)
+{
+    uint64_t bits, one, fractionals, divisor, w_error = 1;
+    uint32_t integrals;
+    diy_fp_t w;
+    int k, idx, mk, kappa, shift, len = 0;
+
+    memcpy(&bits, &v, sizeof(bits));
+    w.f = bits & ((1ULL << 52) - 1);
+    if (bits >> 52) {
+        w.f |= 1ULL << 52;
+        w.e  = (int)(bits >> 52) - 1075;
+    } else {
+        w.e  = -1074;
+    }
+    shift = __builtin_clzll(w.f);
+    w.f <<= shift;
+    w.e  -= shift;
+
+    /* Cached power such that the binary exponent of the scaled value is in
+     * [-60, -32]. */
+    k   = ceil((-60 - (w.e + 64) + 63) * 0.30102999566398114);
+    idx = (k - GRISU_POWERS_MIN_K - 1) / GRISU_POWERS_STEP + 1;
+    mk  = grisu_powers_g[idx].k;
+    w   = diy_fp_mul(w, (diy_fp_t){ grisu_powers_g[idx].f,
+                                    grisu_powers_g[idx].e });
+
+    one         = 1ULL << -w.e;
+    integrals   = w.f >> -w.e;
+    fractionals = w.f & (one - 1);
+
+    /* integrals is at least 4 as w is normalized */
+    kappa = 1;
+    for (divisor = 1; divisor * 10 <= integrals; divisor *= 10) {
+        kappa++;
+    }
+
+    while (kappa > 0) {
+        buf[len++] = '0' + integrals / divisor;
+        integrals %= divisor;
+        kappa--;
+        if (--ndigits == 0) {
+            break;
+        }
+        divisor /= 10;
+    }
+
+    if (ndigits == 0) {
+        if (!grisu_round_weed(buf, len,
+                              ((uint64_t)integrals << -w.e) + fractionals,
+                              divisor << -w.e, w_error, &kappa))
+        {
+            return false;
+        }
+    } else {
+        while (ndigits > 0 && fractionals > w_error) {
+            fractionals *= 10;
+            w_error     *= 10;
+            buf[len++] = '0' + (fractionals >> -w.e);
+            fractionals &= one - 1;
+            ndigits--;
+            kappa--;
+        }
+        if (ndigits > 0
+        ||  !grisu_round_weed(buf, len, fractionals, one, w_error, &kappa))
+        {
+            return false;
+        }
+    }
+
+    *decpt = len + kappa - mk;
+    while (buf[len - 1] == '0') {
+        len--;
+    }
+    *length = len;
+    return true;
+}
+
+/* }}} */
+
 static char *cvt(
 #ifdef _NO_LONGDBL
         double value,
@@ -1605,6 +1914,7 @@ static char *cvt(
     char *digits, *bp, *rve;
 #ifdef _NO_LONGDBL
     union double_union tmp;
+    int len;
 #else
     struct ldieee *ldptr;
 #endif
@@ -1631,7 +1941,14 @@ static char *cvt(
     } else {
         *sign = '\000';
     }
-    digits = dtoa(value, mode, ndigits, decpt, &dsgn, &rve);
+    if (mode == 2 && value != 0 && ndigits <= GRISU_MAX_DIGITS
+    &&  grisu_counted(value, MAX(ndigits, 1), grisu_digits_g, &len, decpt))
+    {
+        digits = grisu_digits_g;
+        rve = digits + len;
+    } else {
+        digits = dtoa(value, mode, ndigits, decpt, &dsgn, &rve);
+    }
 #else /* !_NO_LONGDBL */
     ldptr = (struct ldieee *)&value;
     if (ldptr->sign) { /* this will check for < 0 and -0.0 */
@@ -1758,3 +2075,554 @@ ssize_t formatter_write(FILE *stream, char *buf, size_t buf_len,
 
     return len;
 }
+
+/* {{{ Pre-parsed formats */
+
+enum fmt_op_kind {
+    FMT_OP_CHUNK,           /* literal text */
+    FMT_OP_STR,             /* naked %s */
+    FMT_OP_STR_PREC,        /* %.*s */
+    FMT_OP_CHAR,            /* naked %c */
+    FMT_OP_SIGNED,          /* naked %d or %i, with a length modifier */
+    FMT_OP_UNSIGNED,        /* naked %u, %x or %X, with a length modifier */
+    FMT_OP_FORMATTER,       /* %*p? or %p? of a registered formatter */
+    FMT_OP_SPEC,            /* any other conversion */
+};
+
+typedef struct fmt_op_t {
+    uint8_t kind;
+    uint8_t type;           /* TYPE_xxx of the integer conversions */
+    uint8_t base;
+    bool    upper;
+    uint16_t flags;         /* FLAG_MINUS and FLAG_ZERO only */
+    int     width;
+    int     modifier;
+    int     len;
+    /* Literal text, or zero-terminated conversion for FMT_OP_SPEC. */
+    const char *s;
+    const struct formatter_t *formatter;
+} fmt_op_t;
+
+struct iprintf_fmt_t {
+    int nb_ops;
+    fmt_op_t ops[];
+};
+
+/* Returns the end of the conversion starting at p (just after the '%'),
+ * skipping the same characters as fmt_output_at(). The conversion character
+ * is returned, with the type, flags and width in \p spec, when the only
+ * flags are '-' and '0' and there is no other width than a literal one, and
+ * no precision.
+ */
+static const char *fmt_parse_spec(const char *p, fmt_op_t *spec, int *conv)
+{
+    bool simple = true;
+    int type_flags = 0;
+    int c;
+
+    p_clear(spec, 1);
+    *conv = 0;
+
+    for (;; p++) {
+        switch (*p) {
+          case '-': spec->flags |= FLAG_MINUS; continue;
+          case '0': spec->flags |= FLAG_ZERO;  continue;
+          case '+': case '#': case '\'': case ' ': case 'I':
+            simple = false;
+            continue;
+        }
+        break;
+    }
+    if (*p == '*') {
+        simple = false;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') {
+            spec->width = spec->width * 10 + *p++ - '0';
+        }
+    }
+    if (*p == '.') {
+        simple = false;
+        p++;
+        if (*p == '*') {
+            p++;
+        } else {
+            while (*p >= '0' && *p <= '9') {
+                p++;
+            }
+        }
+    }
+
+    switch (*p) {
+      case 'l':
+        if (p[1] == 'l') {
+            p++;
+            type_flags |= TYPE_llong;
+        } else {
+            type_flags |= TYPE_long;
+        }
+        p++;
+        break;
+      case 'h':
+        if (p[1] == 'h') {
+            p++;
+            type_flags |= TYPE_char;
+        } else {
+            type_flags |= TYPE_short;
+        }
+        p++;
+        break;
+      case 'j':
+        type_flags |= TYPE_intmax_t;
+        p++;
+        break;
+      case 'z':
+        type_flags |= TYPE_size_t;
+        p++;
+        break;
+      case 't':
+        type_flags |= TYPE_ptrdiff_t;
+        p++;
+        break;
+      case 'L':
+        type_flags |= TYPE_ldouble;
+        p++;
+        break;
+    }
+
+    if (*p == '\0') {
+        return p;
+    }
+    c = *p++;
+    if (c == 'p' || c == 'P') {
+        while (isalnum((unsigned char)*p)) {
+            p++;
+        }
+    } else
+    if (simple) {
+        spec->type = type_flags;
+        *conv = c;
+    }
+    return p;
+}
+
+static bool fmt_type_is_naked(int type)
+{
+    /* TYPE_int32/TYPE_int64 only exist on exotic architectures */
+    return type == TYPE_int || type == TYPE_char || type == TYPE_short
+        || type == TYPE_long || type == TYPE_llong;
+}
+
+iprintf_fmt_t *iprintf_fmt_new(const char *format)
+{
+    iprintf_fmt_t *fmt;
+    size_t flen = strlen(format);
+    int max_ops = 1;
+    char *text, *specs;
+    const char *p = format;
+    const char *lit = format;
+
+    for (const char *q = format; (q = strchr(q, '%')); q++) {
+        max_ops += 2;
+    }
+    /* literal text, then the zero-terminated conversions */
+    fmt = p_new_extra(iprintf_fmt_t, max_ops * sizeof(fmt_op_t)
+                      + 3 * flen + 2);
+    text = (char *)&fmt->ops[max_ops];
+    memcpy(text, format, flen);
+    specs = text + flen;
+
+#define FMT_NEW_OP(_kind)                                                    \
+    ({  fmt_op_t *__op = &fmt->ops[fmt->nb_ops++];                           \
+        __op->kind = (_kind);                                                \
+        __op;                                                                \
+    })
+
+    for (;;) {
+        const char *spec;
+        fmt_op_t parsed, *op;
+        int conv;
+        int m;
+
+        p += strcspn(p, "%");
+        if (p > lit) {
+            op = FMT_NEW_OP(FMT_OP_CHUNK);
+            op->s = text + (lit - format);
+            op->len = p - lit;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        spec = p++;
+
+        /* same special cases as fmt_output_at() */
+        if (*p == 'd') {
+            op = FMT_NEW_OP(FMT_OP_SIGNED);
+            op->type = TYPE_int;
+            lit = ++p;
+            continue;
+        }
+        if (*p == 's') {
+            FMT_NEW_OP(FMT_OP_STR);
+            lit = ++p;
+            continue;
+        }
+        if (p[0] == '.' && p[1] == '*' && p[2] == 's') {
+            FMT_NEW_OP(FMT_OP_STR_PREC);
+            lit = p += 3;
+            continue;
+        }
+        m = (unsigned char)p[1];
+        if (p[0] == '*' && p[1] == 'p'
+        &&  put_memory_fmt_g[(unsigned char)p[2]].is_raw
+        &&  put_memory_fmt_g[(unsigned char)p[2]].raw_formatter)
+        {
+            m = (unsigned char)p[2];
+            p += 3;
+        } else
+        if (p[0] == 'p'
+        &&  !put_memory_fmt_g[m].is_raw && put_memory_fmt_g[m].ptr_formatter)
+        {
+            p += 2;
+        } else {
+            m = 0;
+        }
+        if (m) {
+            /* Registered formatters cannot be overloaded, the entry is
+             * stable. */
+            op = FMT_NEW_OP(FMT_OP_FORMATTER);
+            op->modifier = m;
+            op->formatter = &put_memory_fmt_g[m];
+            lit = p;
+            continue;
+        }
+
+        p = fmt_parse_spec(p, &parsed, &conv);
+        switch (conv) {
+          case '%':
+            if (parsed.width <= 1) {
+                /* merge it with the following literal text */
+                lit = p - 1;
+                continue;
+            }
+            break;
+
+          case 'c':
+            if (parsed.type == TYPE_int) {
+                op = FMT_NEW_OP(FMT_OP_CHAR);
+                op->flags = parsed.flags & FLAG_MINUS;
+                op->width = parsed.width;
+                lit = p;
+                continue;
+            }
+            break;
+
+          case 's':
+            op = FMT_NEW_OP(FMT_OP_STR);
+            op->flags = parsed.flags & FLAG_MINUS;
+            op->width = parsed.width;
+            lit = p;
+            continue;
+
+          case 'd':
+          case 'i':
+            if (fmt_type_is_naked(parsed.type)) {
+                op = FMT_NEW_OP(FMT_OP_SIGNED);
+                op->type  = parsed.type;
+                op->flags = parsed.flags;
+                op->width = parsed.width;
+                lit = p;
+                continue;
+            }
+            break;
+
+          case 'u':
+          case 'x':
+          case 'X':
+            if (fmt_type_is_naked(parsed.type)) {
+                op = FMT_NEW_OP(FMT_OP_UNSIGNED);
+                op->type  = parsed.type;
+                op->flags = parsed.flags;
+                op->width = parsed.width;
+                op->base = conv == 'u' ? 10 : 16;
+                op->upper = conv == 'X';
+                lit = p;
+                continue;
+            }
+            break;
+        }
+
+        op = FMT_NEW_OP(FMT_OP_SPEC);
+        op->len = p - spec;
+        op->s = specs;
+        specs = mempcpy(specs, spec, op->len);
+        *specs++ = '\0';
+        lit = p;
+    }
+#undef FMT_NEW_OP
+
+    return fmt;
+}
+
+void iprintf_fmt_delete(iprintf_fmt_t **fmt)
+{
+    p_delete(fmt);
+}
+
+const iprintf_fmt_t *
+__iprintf_fmt_cache(_Atomic(const iprintf_fmt_t *) *slot, const char *format)
+{
+    const iprintf_fmt_t *cur = NULL;
+    iprintf_fmt_t *fmt = iprintf_fmt_new(format);
+
+    if (!atomic_compare_exchange_strong(slot, &cur, fmt)) {
+        /* another thread was faster */
+        iprintf_fmt_delete(&fmt);
+        return cur;
+    }
+    return fmt;
+}
+
+static ALWAYS_INLINE char *fmt_convert_signed(char *p, int type, va_list *ap)
+{
+    int64_t value;
+    uint64_t num;
+
+    switch (type) {
+      case TYPE_char:
+        value = (char)va_arg(*ap, int);
+        break;
+      case TYPE_short:
+        value = (short)va_arg(*ap, int);
+        break;
+#ifdef WANT_long
+      case TYPE_long:
+        value = va_arg(*ap, long);
+        break;
+#endif
+#ifdef WANT_llong
+      case TYPE_llong:
+        value = va_arg(*ap, long long);
+        break;
+#endif
+      default:
+        value = va_arg(*ap, int);
+        break;
+    }
+
+    num = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    p = convert_uint64(p, num, 10);
+    if (num == 0) {
+        *--p = '0';
+    }
+    if (value < 0) {
+        *--p = '-';
+    }
+    return p;
+}
+
+static ALWAYS_INLINE char *fmt_convert_unsigned(char *p, const fmt_op_t *op,
+                                                va_list *ap)
+{
+    char *end = p;
+    uint64_t value;
+
+    switch (op->type) {
+      case TYPE_char:
+        value = (unsigned char)va_arg(*ap, unsigned int);
+        break;
+      case TYPE_short:
+        value = (unsigned short)va_arg(*ap, unsigned int);
+        break;
+#ifdef WANT_long
+      case TYPE_long:
+        value = va_arg(*ap, unsigned long);
+        break;
+#endif
+#ifdef WANT_llong
+      case TYPE_llong:
+        value = va_arg(*ap, unsigned long long);
+        break;
+#endif
+      default:
+        value = va_arg(*ap, unsigned int);
+        break;
+    }
+
+    p = convert_uint64(p, value, op->base);
+    if (value == 0) {
+        *--p = '0';
+    }
+    if (op->base == 16) {
+        int alpha_shift = op->upper ? 'A' - '9' - 1 : 'a' - '9' - 1;
+
+        for (char *q = p; q < end; q++) {
+            if (*q > '9') {
+                *q += alpha_shift;
+            }
+        }
+    }
+    return p;
+}
+
+static int fmt_output_padded(FILE *stream, char *str, size_t size,
+                             int count, const fmt_op_t *op,
+                             const char *lp, int len)
+{
+    int pad = op->width - len;
+
+    if (op->flags & FLAG_MINUS) {
+        count = fmt_output_chunk(stream, str, size, count, lp, len, 'M');
+        return fmt_output_chars(stream, str, size, count, ' ', pad);
+    }
+    if (op->flags & FLAG_ZERO) {
+        if (*lp == '-') {
+            count = fmt_output_chars(stream, str, size, count, '-', 1);
+            lp++;
+            len--;
+        }
+        count = fmt_output_chars(stream, str, size, count, '0', pad);
+    } else {
+        count = fmt_output_chars(stream, str, size, count, ' ', pad);
+    }
+    return fmt_output_chunk(stream, str, size, count, lp, len, 'M');
+}
+
+static int fmt_output_ops(FILE *stream, char *str, size_t size,
+                          const iprintf_fmt_t *fmt, va_list *ap)
+{
+    char buf[64];
+    int count = 0;
+    int save_errno = errno;
+
+    if (size > INT_MAX) {
+        size = 0;
+    }
+
+    for (int i = 0; i < fmt->nb_ops; i++) {
+        const fmt_op_t *op = &fmt->ops[i];
+        const char *lp;
+        int len;
+
+        switch (op->kind) {
+          case FMT_OP_CHUNK:
+            lp  = op->s;
+            len = op->len;
+            break;
+
+          case FMT_OP_STR:
+            lp = va_arg(*ap, const char *);
+            if (lp == NULL) {
+                lp = "(null)";
+            }
+            len = strlen(lp);
+            break;
+
+          case FMT_OP_STR_PREC:
+            len = va_arg(*ap, int);
+            lp  = va_arg(*ap, const char *);
+            if (lp == NULL) {
+                lp = "(null)";
+                len = 6;
+            }
+            len = strnlen(lp, len);
+            break;
+
+          case FMT_OP_CHAR:
+            buf[0] = (unsigned char)va_arg(*ap, int);
+            lp  = buf;
+            len = 1;
+            break;
+
+          case FMT_OP_SIGNED:
+            lp  = fmt_convert_signed(buf + sizeof(buf), op->type, ap);
+            len = buf + sizeof(buf) - lp;
+            break;
+
+          case FMT_OP_UNSIGNED:
+            lp  = fmt_convert_unsigned(buf + sizeof(buf), op, ap);
+            len = buf + sizeof(buf) - lp;
+            break;
+
+          case FMT_OP_FORMATTER:
+            len = op->formatter->is_raw ? va_arg(*ap, int) : 0;
+            lp  = va_arg(*ap, const char *);
+            count = fmt_output_formatter(stream, str, size, count,
+                                         op->formatter, op->modifier,
+                                         lp, len);
+            continue;
+
+          case FMT_OP_SPEC:
+          default:
+            count = fmt_output_at(stream, str, size, count, save_errno,
+                                  op->s, ap);
+            continue;
+        }
+        if (unlikely(op->width > len)) {
+            count = fmt_output_padded(stream, str, size, count, op, lp, len);
+        } else
+        if (!stream && likely((size_t)count + len < size)) {
+            memcpy(str + count, lp, len);
+            count += len;
+        } else {
+            count = fmt_output_chunk(stream, str, size, count, lp, len, 'M');
+        }
+    }
+
+    return fmt_output_end(stream, str, size, count);
+}
+
+int ivfprintf_fmt(FILE *stream, const iprintf_fmt_t *fmt, va_list ap)
+{
+    va_list ap2;
+    int n;
+
+    if (!stream) {
+        errno = EBADF;
+        return -1;
+    }
+    va_copy(ap2, ap);
+    n = fmt_output_ops(stream, NULL, 0, fmt, &ap2);
+    va_end(ap2);
+
+    return n;
+}
+
+int ivsnprintf_fmt(char *str, size_t size, const iprintf_fmt_t *fmt,
+                   va_list ap)
+{
+    va_list ap2;
+    int n;
+
+    va_copy(ap2, ap);
+    n = fmt_output_ops(NULL, str, size, fmt, &ap2);
+    va_end(ap2);
+
+    return n;
+}
+
+int ifprintf_fmt(FILE *stream, const iprintf_fmt_t *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = ivfprintf_fmt(stream, fmt, ap);
+    va_end(ap);
+
+    return n;
+}
+
+int isnprintf_fmt(char *str, size_t size, const iprintf_fmt_t *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = fmt_output_ops(NULL, str, size, fmt, &ap);
+    va_end(ap);
+
+    return n;
+}
+
+/* }}} */
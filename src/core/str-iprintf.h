@@ -203,5 +203,84 @@ ssize_t formatter_write(FILE * nullable stream,
                         char * nullable buf, size_t buf_len,
                         const char * nonnull s, size_t len);
 
+/* }}} */
+/* {{{ Pre-parsed formats */
+
+/** Pre-parsed format.
+ *
+ * The format is split once into literal text and conversions. Formatting
+ * with it then dispatches the common conversions directly to their argument
+ * formatter: %d, %i, %u, %x, %X with their length modifiers, %c and %s, all
+ * with at most the '-' and '0' flags and a literal width, %.*s, and the %*p?
+ * and %p? of the registered formatters. The other conversions are formatted
+ * by the generic code. The output is the one of isnprintf() with the same
+ * format.
+ *
+ * The formatters must be registered before the format is parsed to be
+ * dispatched directly.
+ */
+typedef struct iprintf_fmt_t iprintf_fmt_t;
+
+iprintf_fmt_t * nonnull iprintf_fmt_new(const char * nonnull format)
+        __leaf;
+void iprintf_fmt_delete(iprintf_fmt_t * nullable * nonnull fmt)
+        __leaf;
+
+int ivfprintf_fmt(FILE * nonnull stream, const iprintf_fmt_t * nonnull fmt,
+                  va_list ap)
+        __leaf;
+int ivsnprintf_fmt(char * nullable str, size_t size,
+                   const iprintf_fmt_t * nonnull fmt, va_list ap)
+        __leaf;
+int ifprintf_fmt(FILE * nonnull stream, const iprintf_fmt_t * nonnull fmt,
+                 ...)
+        __leaf;
+int isnprintf_fmt(char * nullable str, size_t size,
+                  const iprintf_fmt_t * nonnull fmt, ...)
+        __leaf;
+
+const iprintf_fmt_t * nonnull
+__iprintf_fmt_cache(_Atomic(const iprintf_fmt_t *) * nonnull slot,
+                    const char * nonnull format)
+        __leaf;
+
+/** Pre-parsed format of the call site.
+ *
+ * \p format must be a string literal. It is parsed on the first call, and
+ * the result is kept for the lifetime of the program.
+ */
+#define IPRINTF_FMT(format)                                                  \
+    ({  static _Atomic(const iprintf_fmt_t *) __ifmt;                        \
+        const iprintf_fmt_t *__f;                                            \
+                                                                             \
+        __f = atomic_load_explicit(&__ifmt, memory_order_acquire);           \
+        if (unlikely(!__f)) {                                                \
+            __f = __iprintf_fmt_cache(&__ifmt, "" format "");                \
+        }                                                                    \
+        __f;                                                                 \
+    })
+
+/** isnprintf() with a format parsed once per call site.
+ *
+ * The arguments are checked against the format at compile time as for
+ * isnprintf().
+ */
+#define isnprintf_cached(str, size, format, ...)                             \
+    ({  if (0) {                                                             \
+            isnprintf(str, size, format, ##__VA_ARGS__);                     \
+        }                                                                    \
+        isnprintf_fmt(str, size, IPRINTF_FMT(format), ##__VA_ARGS__);        \
+    })
+
+/** ifprintf() with a format parsed once per call site. */
+#define ifprintf_cached(stream, format, ...)                                 \
+    ({  if (0) {                                                             \
+            ifprintf(stream, format, ##__VA_ARGS__);                         \
+        }                                                                    \
+        ifprintf_fmt(stream, IPRINTF_FMT(format), ##__VA_ARGS__);            \
+    })
+
+/* }}} */
+
 
 #endif /* IS_LIB_COMMON_STR_IPRINTF_H */
@@ -18,6 +18,9 @@
 
 #include <lib-common/unix.h>
 #include <lib-common/core.h>
+#include <lib-common/arith.h>
+#include <lib-common/hash.h>
+#include <lib-common/thr.h>
 
 /* {{{ Base helpers */
 
@@ -299,20 +302,80 @@ void lstr_transfer_sb(lstr_t *dst, sb_t *sb, bool keep_pool)
 }
 
 
+/* }}} */
+/* {{{ ASCII case folding */
+
+/* The ASCII case conversions work on 8 bytes at a time: the bytes of a
+ * 64-bits word that are in a range of ASCII characters are found without
+ * carry between the bytes, by adding to their 7 low bits the offsets that
+ * set their high bit when they are above each bound. */
+
+#define ASCII_ONES  0x0101010101010101ULL
+
+/* Bytes of w in [lo, hi], as their high bit. */
+static ALWAYS_INLINE uint64_t ascii_in_range64(uint64_t w, int lo, int hi)
+{
+    uint64_t low7 = w & (0x7f * ASCII_ONES);
+    uint64_t ge_lo = low7 + (0x80 - lo) * ASCII_ONES;
+    uint64_t gt_hi = low7 + (0x7f - hi) * ASCII_ONES;
+
+    return ~w & (ge_lo ^ gt_hi) & (0x80 * ASCII_ONES);
+}
+
+static ALWAYS_INLINE uint64_t ascii_tolower64(uint64_t w)
+{
+    return w | (ascii_in_range64(w, 'A', 'Z') >> 2);
+}
+
+static ALWAYS_INLINE uint64_t ascii_toupper64(uint64_t w)
+{
+    return w ^ (ascii_in_range64(w, 'a', 'z') >> 2);
+}
+
+static ALWAYS_INLINE int ascii_tolower(int c)
+{
+    return c >= 'A' && c <= 'Z' ? c + 'a' - 'A' : c;
+}
+
+static ALWAYS_INLINE int ascii_toupper(int c)
+{
+    return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+}
+
+/* Length of the common prefix of s1 and s2, ignoring the ASCII case. */
+static int ascii_icommon_prefix(const char *s1, const char *s2, int len)
+{
+    int i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w1 = get_unaligned_cpu64(s1 + i);
+        uint64_t w2 = get_unaligned_cpu64(s2 + i);
+
+        if (w1 != w2 && ascii_tolower64(w1) != ascii_tolower64(w2)) {
+            break;
+        }
+    }
+    for (; i < len; i++) {
+        if (ascii_tolower((unsigned char)s1[i])
+        !=  ascii_tolower((unsigned char)s2[i]))
+        {
+            break;
+        }
+    }
+    return i;
+}
+
 /* }}} */
 /* {{{ Comparisons */
 
 int lstr_ascii_icmp(const lstr_t s1, const lstr_t s2)
 {
     int min = MIN(s1.len, s2.len);
+    int i = ascii_icommon_prefix(s1.s, s2.s, min);
 
-    for (int i = 0; i < min; i++) {
-        int a = tolower((unsigned char)s1.s[i]);
-        int b = tolower((unsigned char)s2.s[i]);
-
-        if (a != b) {
-            return CMP(a, b);
-        }
+    if (i < min) {
+        return CMP(ascii_tolower((unsigned char)s1.s[i]),
+                   ascii_tolower((unsigned char)s2.s[i]));
     }
 
     return CMP(s1.len, s2.len);
@@ -323,23 +386,12 @@ bool lstr_ascii_iequal(const lstr_t s1, const lstr_t s2)
     if (s1.len != s2.len) {
         return false;
     }
-    for (int i = 0; i < s1.len; i++) {
-        if (tolower((unsigned char)s1.s[i]) != tolower((unsigned char)s2.s[i]))
-        {
-            return false;
-        }
-    }
-    return true;
+    return ascii_icommon_prefix(s1.s, s2.s, s1.len) == s1.len;
 }
 
 bool lstr_match_ctype(lstr_t s, const ctype_desc_t *d)
 {
-    for (int i = 0; i < s.len; i++) {
-        if (!ctype_desc_contains(d, (unsigned char)s.s[i])) {
-            return false;
-        }
-    }
-    return true;
+    return ctype_desc_span(d, s.s, s.len) == (size_t)s.len;
 }
 
 int lstr_dlevenshtein(const lstr_t cs1, const lstr_t cs2, int max_dist)
@@ -424,15 +476,27 @@ lstr_t lstr_utf8_truncate(lstr_t s, int char_len)
 
 void lstr_ascii_tolower(lstr_t *s)
 {
-    for (int i = 0; i < s->len; i++) {
-        s->v[i] = tolower((unsigned char)s->v[i]);
+    int i = 0;
+
+    for (; i + 8 <= s->len; i += 8) {
+        put_unaligned_cpu64(s->v + i,
+                            ascii_tolower64(get_unaligned_cpu64(s->v + i)));
+    }
+    for (; i < s->len; i++) {
+        s->v[i] = ascii_tolower((unsigned char)s->v[i]);
     }
 }
 
 void lstr_ascii_toupper(lstr_t *s)
 {
-    for (int i = 0; i < s->len; i++) {
-        s->v[i] = toupper((unsigned char)s->v[i]);
+    int i = 0;
+
+    for (; i + 8 <= s->len; i += 8) {
+        put_unaligned_cpu64(s->v + i,
+                            ascii_toupper64(get_unaligned_cpu64(s->v + i)));
+    }
+    for (; i < s->len; i++) {
+        s->v[i] = ascii_toupper((unsigned char)s->v[i]);
     }
 }
 
@@ -876,3 +940,220 @@ bool lstr_utf8_is_ilike(const lstr_t s, const lstr_t pattern)
 }
 
 /* }}} */
+/* {{{ Interning */
+
+/* The canonical copies are allocated in blocks that are only freed with the
+ * table. They are published in an open addressing table with release
+ * stores, and a table replaced by a bigger one is retired with thr_epoch, so
+ * that the readers can probe it without taking the lock.
+ */
+
+#define LSTR_INTERN_BLOCK_SIZE  (64 << 10)
+#define LSTR_INTERN_MIN_SLOTS   256
+
+typedef struct lstr_intern_slots_t {
+    uint32_t mask;
+    _Atomic(const lstr_intern_rec_t *) recs[];
+} lstr_intern_slots_t;
+
+typedef struct lstr_intern_block_t {
+    struct lstr_intern_block_t *next;
+    char data[];
+} lstr_intern_block_t;
+
+struct lstr_intern_table_t {
+    _Atomic(lstr_intern_slots_t *) slots;
+
+    spinlock_t lock;
+    int count;
+    lstr_intern_block_t *blocks;
+    int block_used;
+};
+
+static lstr_intern_table_t lstr_intern_g;
+
+lstr_intern_table_t *lstr_intern_table_new(void)
+{
+    return p_new(lstr_intern_table_t, 1);
+}
+
+void lstr_intern_table_delete(lstr_intern_table_t **tablep)
+{
+    lstr_intern_table_t *table = *tablep;
+
+    if (!table) {
+        return;
+    }
+    while (table->blocks) {
+        lstr_intern_block_t *block = table->blocks;
+
+        table->blocks = block->next;
+        p_delete(&block);
+    }
+    thr_epoch_retire_mp(&mem_pool_libc,
+                        atomic_load_explicit(&table->slots,
+                                             memory_order_relaxed));
+    p_delete(tablep);
+}
+
+int lstr_intern_table_count(lstr_intern_table_t *table)
+{
+    int count;
+
+    table = table ?: &lstr_intern_g;
+    spin_lock(&table->lock);
+    count = table->count;
+    spin_unlock(&table->lock);
+    return count;
+}
+
+static const lstr_intern_rec_t *
+lstr_intern_slots_find(const lstr_intern_slots_t *slots, uint32_t hash,
+                       lstr_t s)
+{
+    for (uint32_t pos = hash & slots->mask;; pos = (pos + 1) & slots->mask) {
+        const lstr_intern_rec_t *rec;
+
+        rec = atomic_load_explicit(&slots->recs[pos], memory_order_acquire);
+        if (!rec) {
+            return NULL;
+        }
+        if (rec->hash == hash && rec->len == s.len
+        &&  memcmp(rec->s, s.s, s.len) == 0)
+        {
+            return rec;
+        }
+    }
+}
+
+static void lstr_intern_slots_add(lstr_intern_slots_t *slots,
+                                  const lstr_intern_rec_t *rec)
+{
+    uint32_t pos = rec->hash & slots->mask;
+
+    while (atomic_load_explicit(&slots->recs[pos], memory_order_relaxed)) {
+        pos = (pos + 1) & slots->mask;
+    }
+    atomic_store_explicit(&slots->recs[pos], rec, memory_order_release);
+}
+
+static const lstr_intern_rec_t *
+lstr_intern_lookup(lstr_intern_table_t *table, uint32_t hash, lstr_t s)
+{
+    thr_epoch_scope;
+    const lstr_intern_slots_t *slots;
+
+    slots = atomic_load_explicit(&table->slots, memory_order_acquire);
+    return slots ? lstr_intern_slots_find(slots, hash, s) : NULL;
+}
+
+/* Called with the lock held. */
+static lstr_intern_slots_t *
+lstr_intern_grow(lstr_intern_table_t *table, lstr_intern_slots_t *old)
+{
+    uint32_t size = old ? 2 * (old->mask + 1) : LSTR_INTERN_MIN_SLOTS;
+    lstr_intern_slots_t *slots;
+
+    slots = p_new_extra(lstr_intern_slots_t, size * sizeof(slots->recs[0]));
+    slots->mask = size - 1;
+    if (old) {
+        for (uint32_t i = 0; i <= old->mask; i++) {
+            const lstr_intern_rec_t *rec;
+
+            rec = atomic_load_explicit(&old->recs[i], memory_order_relaxed);
+            if (rec) {
+                lstr_intern_slots_add(slots, rec);
+            }
+        }
+    }
+    atomic_store_explicit(&table->slots, slots, memory_order_release);
+    thr_epoch_retire_mp(&mem_pool_libc, old);
+    return slots;
+}
+
+/* Called with the lock held. */
+static lstr_intern_rec_t *
+lstr_intern_alloc(lstr_intern_table_t *table, int len)
+{
+    int size = ROUND_UP((int)offsetof(lstr_intern_rec_t, s) + len + 1, 8);
+    lstr_intern_block_t *block;
+
+    if (size > LSTR_INTERN_BLOCK_SIZE / 4) {
+        /* big strings get their own block, behind the current one */
+        block = p_new_extra_raw(lstr_intern_block_t, size);
+        if (table->blocks) {
+            block->next = table->blocks->next;
+            table->blocks->next = block;
+        } else {
+            block->next = NULL;
+            table->blocks = block;
+            table->block_used = LSTR_INTERN_BLOCK_SIZE;
+        }
+        return (lstr_intern_rec_t *)block->data;
+    }
+    if (!table->blocks || table->block_used + size > LSTR_INTERN_BLOCK_SIZE) {
+        block = p_new_extra_raw(lstr_intern_block_t, LSTR_INTERN_BLOCK_SIZE);
+        block->next = table->blocks;
+        table->blocks = block;
+        table->block_used = 0;
+    }
+    table->block_used += size;
+    return (lstr_intern_rec_t *)(table->blocks->data + table->block_used
+                                 - size);
+}
+
+lstr_t lstr_intern_find_in(lstr_intern_table_t *table, lstr_t s)
+{
+    const lstr_intern_rec_t *rec;
+
+    if (!s.s) {
+        return LSTR_NULL_V;
+    }
+    rec = lstr_intern_lookup(table ?: &lstr_intern_g,
+                             mem_hash32(s.s, s.len), s);
+    return rec ? LSTR_INIT_V(rec->s, rec->len) : LSTR_NULL_V;
+}
+
+lstr_t lstr_intern_in(lstr_intern_table_t *table, lstr_t s)
+{
+    const lstr_intern_rec_t *rec;
+    uint32_t hash;
+
+    if (!s.s) {
+        return LSTR_NULL_V;
+    }
+    table = table ?: &lstr_intern_g;
+    hash  = mem_hash32(s.s, s.len);
+    rec   = lstr_intern_lookup(table, hash, s);
+    if (likely(rec)) {
+        return LSTR_INIT_V(rec->s, rec->len);
+    }
+
+    spin_lock(&table->lock);
+    {
+        lstr_intern_slots_t *slots;
+
+        slots = atomic_load_explicit(&table->slots, memory_order_relaxed);
+        rec = slots ? lstr_intern_slots_find(slots, hash, s) : NULL;
+        if (!rec) {
+            lstr_intern_rec_t *nrec = lstr_intern_alloc(table, s.len);
+
+            nrec->hash = hash;
+            nrec->len  = s.len;
+            memcpyz(nrec->s, s.s, s.len);
+
+            /* keep the load factor under 1/2 */
+            if (!slots || 2 * (table->count + 1) > (int)slots->mask + 1) {
+                slots = lstr_intern_grow(table, slots);
+            }
+            lstr_intern_slots_add(slots, nrec);
+            table->count++;
+            rec = nrec;
+        }
+    }
+    spin_unlock(&table->lock);
+
+    return LSTR_INIT_V(rec->s, rec->len);
+}
+
+/* }}} */
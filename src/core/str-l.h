@@ -803,6 +803,71 @@ void lstr_obfuscate(lstr_t in, uint64_t key, lstr_t out);
  */
 lstr_t lstr_trim_pkcs7_padding(lstr_t padded);
 
+/* }}} */
+/* Interning {{{ */
+
+/* Interned strings.
+ *
+ * An interning table keeps one canonical copy of each string it is given:
+ * two strings interned in the same table are equal if and only if they have
+ * the same pointer. The canonical copies are NUL-terminated, they are stored
+ * with their hash (the one of mem_hash32(), as qhash_lstr_hash()) and live
+ * until the table is deleted, forever for the global table.
+ *
+ * The lookups of the strings that are already interned don't take any lock,
+ * the tables can be shared by all the threads.
+ */
+
+typedef struct lstr_intern_rec_t {
+    uint32_t hash;
+    int      len;
+    char     s[];
+} lstr_intern_rec_t;
+
+typedef struct lstr_intern_table_t lstr_intern_table_t;
+
+lstr_intern_table_t * nonnull lstr_intern_table_new(void);
+void lstr_intern_table_delete(lstr_intern_table_t * nullable * nonnull table);
+
+/** Number of strings interned in \p table (the global one if NULL). */
+int lstr_intern_table_count(lstr_intern_table_t * nullable table);
+
+/** Returns the canonical copy of \p s in \p table, the global one if NULL.
+ *
+ * The copy is created if \p s was not interned yet. LSTR_NULL_V is returned
+ * for LSTR_NULL_V.
+ */
+lstr_t lstr_intern_in(lstr_intern_table_t * nullable table, lstr_t s);
+
+/** Returns the canonical copy of \p s in \p table if there is one,
+ * LSTR_NULL_V otherwise. */
+lstr_t lstr_intern_find_in(lstr_intern_table_t * nullable table, lstr_t s);
+
+static inline lstr_t lstr_intern(lstr_t s)
+{
+    return lstr_intern_in(NULL, s);
+}
+
+static inline lstr_t lstr_intern_find(lstr_t s)
+{
+    return lstr_intern_find_in(NULL, s);
+}
+
+/** Hash of an interned string, without reading it. */
+static inline uint32_t lstr_intern_hash(lstr_t s)
+{
+    const lstr_intern_rec_t *rec;
+
+    rec = (const lstr_intern_rec_t *)(s.s - offsetof(lstr_intern_rec_t, s));
+    return rec->hash;
+}
+
+/** Equality of two strings interned in the same table. */
+static inline bool lstr_intern_equal(lstr_t s1, lstr_t s2)
+{
+    return s1.s == s2.s;
+}
+
 /* }}} */
 /* Format {{{ */
 
@@ -19,6 +19,28 @@
 #include <math.h>
 
 #include <lib-common/core.h>
+#include <lib-common/arith.h>
+
+/* Parses the 8 bytes at s as a run of 8 decimal digits, 2 then 4 digits at
+ * a time in a 64-bit word. Returns false if one of the bytes is not a digit.
+ */
+static ALWAYS_INLINE bool mem_parse_8digits(const byte *s, uint32_t *out)
+{
+    uint64_t v = get_unaligned_le64(s);
+
+    if (((v & 0xf0f0f0f0f0f0f0f0ULL)
+      | (((v + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL) >> 4))
+        != 0x3333333333333333ULL)
+    {
+        return false;
+    }
+    v -= 0x3030303030303030ULL;
+    v = v * 10 + (v >> 8);
+    v = (((v & 0x000000ff000000ffULL) * 0x000f424000000064ULL)
+      + (((v >> 16) & 0x000000ff000000ffULL) * 0x0000271000000001ULL)) >> 32;
+    *out = v;
+    return true;
+}
 
 static ALWAYS_INLINE int64_t
 memtoip_impl(const byte *s, int _len, const byte **endp,
@@ -50,7 +72,18 @@ memtoip_impl(const byte *s, int _len, const byte **endp,
         }
         value = '0' - *s++;
         while (declen && isdigit((unsigned char)*s)) {
-            int digit = '0' - *s++;
+            int digit;
+            uint32_t digits;
+
+            if (use_len && _len >= 8 && value >= (min + 99999999) / 100000000
+            &&  mem_parse_8digits(s, &digits))
+            {
+                value = value * 100000000 - digits;
+                s += 8;
+                _len -= 7;
+                continue;
+            }
+            digit = '0' - *s++;
             if ((value <= min / 10)
                 &&  (value < min / 10 || digit < min % 10)) {
                 errno = ERANGE;
@@ -71,7 +104,18 @@ memtoip_impl(const byte *s, int _len, const byte **endp,
         }
         value = *s++ - '0';
         while (declen && isdigit((unsigned char)*s)) {
-            int digit = *s++ - '0';
+            int digit;
+            uint32_t digits;
+
+            if (use_len && _len >= 8 && value <= (max - 99999999) / 100000000
+            &&  mem_parse_8digits(s, &digits))
+            {
+                value = value * 100000000 + digits;
+                s += 8;
+                _len -= 7;
+                continue;
+            }
+            digit = *s++ - '0';
             if ((value >= max / 10)
                 &&  (value > max / 10 || digit > max % 10)) {
                 errno = ERANGE;
@@ -186,17 +230,63 @@ static bool mem_startswith_minus(const void *p, int len)
     return ps_peekc(ps) == '-';
 }
 
+/* Parses the plain decimal numbers, without sign or with '+', that fit in
+ * 64 bits. Returns false for the other ones. */
+static bool memtoullp_fast(const byte *s, int len, uint64_t *out,
+                           const byte **endp)
+{
+    const byte *end = s + len;
+    uint64_t value = 0;
+
+    while (s < end && isspace(*s)) {
+        s++;
+    }
+    if (s < end && *s == '+') {
+        s++;
+    }
+    if (s >= end || !isdigit(*s)) {
+        return false;
+    }
+    while (s < end && isdigit(*s)) {
+        uint32_t digits;
+
+        if (end - s >= 8 && value <= (UINT64_MAX - 99999999) / 100000000
+        &&  mem_parse_8digits(s, &digits))
+        {
+            value = value * 100000000 + digits;
+            s += 8;
+            continue;
+        }
+        if (value > (UINT64_MAX - (*s - '0')) / 10) {
+            return false;
+        }
+        value = value * 10 + (*s++ - '0');
+    }
+    *out = value;
+    *endp = s;
+    return true;
+}
+
 uint64_t memtoullp(const void *s, int len, const byte **endp)
 {
     t_scope;
-    const char *str = t_dupz(s, len);
+    const char *str;
     const char *tail;
+    const byte *fast_end;
     uint64_t res;
 
     if (!len) {
         errno = EINVAL;
         return 0;
     }
+    if (len > 0 && memtoullp_fast(s, len, &res, &fast_end)) {
+        if (endp) {
+            *endp = fast_end;
+        }
+        return res;
+    }
+
+    str = t_dupz(s, len);
 
     res = strtoull(str, &tail, 10);
     if ((int64_t)res < 0 && mem_startswith_minus(str, tail - str)) {
@@ -473,11 +563,126 @@ int strtoull_ext(const char *s, uint64_t *out, const char **tail, int base)
     return memtoxll_ext(s, 0, false, out, (const void **)tail, base, false);
 }
 
+bool __memtod_fast(const void *s, int len, double *out, const byte **endptr)
+{
+    /* powers of ten exactly representable in a double */
+    static double const pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21,
+        1e22,
+    };
+    const char *p = s;
+    const char *end = len < 0 ? NULL : p + len;
+    uint64_t mant = 0;
+    int nd = 0, exp10 = 0;
+    bool neg = false, has_digits = false;
+    double res;
+
+#define CUR()  ((!end || p < end) ? *p : '\0')
+#define IS_DIGIT(c)  ((c) >= '0' && (c) <= '9')
+
+    if (CUR() == '-' || CUR() == '+') {
+        neg = *p++ == '-';
+    }
+    while (CUR() == '0') {
+        has_digits = true;
+        p++;
+    }
+    while (IS_DIGIT(CUR())) {
+        if (nd++ == 19) {
+            return false;
+        }
+        mant = mant * 10 + *p++ - '0';
+        has_digits = true;
+    }
+    if (CUR() == '.') {
+        p++;
+        if (!nd) {
+            while (CUR() == '0') {
+                has_digits = true;
+                exp10--;
+                p++;
+            }
+        }
+        while (IS_DIGIT(CUR())) {
+            if (nd++ == 19) {
+                return false;
+            }
+            mant = mant * 10 + *p++ - '0';
+            has_digits = true;
+            exp10--;
+        }
+    }
+    if (!has_digits) {
+        /* spaces, inf, nan, ... */
+        return false;
+    }
+    if (CUR() == 'e' || CUR() == 'E') {
+        bool exp_neg = false;
+        int e = 0;
+
+        p++;
+        if (CUR() == '-' || CUR() == '+') {
+            exp_neg = *p++ == '-';
+        }
+        if (!IS_DIGIT(CUR())) {
+            return false;
+        }
+        while (IS_DIGIT(CUR())) {
+            if (e >= 1000) {
+                return false;
+            }
+            e = e * 10 + *p++ - '0';
+        }
+        exp10 += exp_neg ? -e : e;
+    }
+    if (isalnum((unsigned char)CUR()) || CUR() == '.') {
+        /* hexadecimal float, or anything else strtod() may accept */
+        return false;
+    }
+
+#undef IS_DIGIT
+#undef CUR
+
+    /* The mantissa and the power of ten are exact doubles, the result is
+     * then correctly rounded by a single operation (Clinger's fast path). */
+    if (mant > (1ULL << 53)) {
+        return false;
+    }
+    if (mant == 0) {
+        res = 0;
+    } else
+    if (exp10 < 0) {
+        if (exp10 < -22) {
+            return false;
+        }
+        res = (double)mant / pow10[-exp10];
+    } else {
+        while (exp10 > 22 && mant * 10 <= (1ULL << 53)) {
+            mant *= 10;
+            exp10--;
+        }
+        if (exp10 > 22) {
+            return false;
+        }
+        res = (double)mant * pow10[exp10];
+    }
+
+    *out = neg ? -res : res;
+    if (endptr) {
+        *endptr = (const byte *)p;
+    }
+    return true;
+}
+
 double strtod_allow_subnormal(const char *nptr, char **endptr)
 {
     double res = 0.;
 
     errno = 0;
+    if (__memtod_fast(nptr, -1, &res, (const byte **)endptr)) {
+        return res;
+    }
     res = strtod(nptr, endptr);
 
     if (errno) {
@@ -156,10 +156,22 @@ int strtoull_ext(const char * nonnull s, uint64_t * nonnull out,
 double strtod_allow_subnormal(const char * nonnull nptr,
                               char * nullable * nullable endptr);
 
+/** Exact fast path of memtod().
+ *
+ * Parses the decimal numbers whose significant digits fit in the mantissa of
+ * a double and whose power of ten is small enough, which are computed
+ * exactly without strtod(). Returns false, without parsing anything, when
+ * strtod() must be used.
+ */
+bool __memtod_fast(const void * nonnull s, int len, double * nonnull out,
+                   const byte * nullable * nullable endptr);
+
 __attr_nonnull__((1))
 static inline double memtod(const void * nonnull s, int len,
                             const byte * nullable * nullable endptr)
 {
+    double res;
+
     if (!len) {
         errno = EINVAL;
         if (endptr) {
@@ -167,12 +179,19 @@ static inline double memtod(const void * nonnull s, int len,
         }
         return 0;
     }
+    if (__memtod_fast(s, len, &res, endptr)) {
+        if (len > 0) {
+            errno = 0;
+        }
+        return res;
+    }
     if (len > 0) {
         t_scope;
 
         /* Ensure we have a '\0' */
         const char *duped = (const char *)t_dupz(s, len);
-        double res = strtod_allow_subnormal(duped, (char **)endptr);
+
+        res = strtod_allow_subnormal(duped, (char **)endptr);
 
         if (endptr) {
             *(char **)endptr = (char *)s + (*(char **)endptr - duped);
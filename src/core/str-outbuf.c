@@ -16,9 +16,25 @@
 /*                                                                         */
 /***************************************************************************/
 
+#include <sys/sendfile.h>
+#if __has_include(<linux/errqueue.h>)
+#  include <linux/errqueue.h>
+#endif
+#include <netinet/in.h>
 #include <lib-common/unix.h>
 #include <lib-common/str-outbuf.h>
 
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) \
+ && defined(SO_EE_ORIGIN_ZEROCOPY)
+#  define OB_HAS_ZEROCOPY
+#endif
+
+static struct {
+    _Atomic(uint64_t) sendfile_bytes;
+    _Atomic(uint64_t) zerocopy_bytes;
+    _Atomic(uint64_t) zerocopy_copied;
+} ob_stats_g;
+
 void ob_check_invariants(outbuf_t *ob)
 {
     int len = ob->length, sb_len = ob->sb.len;
@@ -45,6 +61,32 @@ void ob_chunk_wipe(outbuf_chunk_t *obc)
         munmap(obc->u.vp, obc->length);
         break;
     }
+    p_close(&obc->fd);
+}
+
+static void ob_zerocopy_release(outbuf_t *ob, uint32_t done)
+{
+    while (!htlist_is_empty(&ob->zc_chunks)) {
+        outbuf_chunk_t *obc;
+
+        obc = htlist_first_entry(&ob->zc_chunks, outbuf_chunk_t,
+                                 chunks_link);
+        if ((int32_t)(obc->zc_seq - done) > 0) {
+            break;
+        }
+        htlist_pop(&ob->zc_chunks);
+        ob_chunk_delete(&obc);
+    }
+}
+
+static void ob_zerocopy_wipe(outbuf_t *ob)
+{
+    while (!htlist_is_empty(&ob->zc_chunks)) {
+        outbuf_chunk_t *obc;
+
+        obc = htlist_pop_entry(&ob->zc_chunks, outbuf_chunk_t, chunks_link);
+        ob_chunk_delete(&obc);
+    }
 }
 
 static void ob_merge_(outbuf_t *dst, outbuf_t *src, bool wipe)
@@ -66,6 +108,7 @@ static void ob_merge_(outbuf_t *dst, outbuf_t *src, bool wipe)
 
     if (wipe) {
         sb_wipe(&src->sb);
+        ob_zerocopy_wipe(src);
     } else {
         src->length      = 0;
         src->sb_trailing = 0;
@@ -100,6 +143,7 @@ void ob_wipe(outbuf_t *ob)
         obc = htlist_pop_entry(&ob->chunks_list, outbuf_chunk_t, chunks_link);
         ob_chunk_delete(&obc);
     }
+    ob_zerocopy_wipe(ob);
     sb_wipe(&ob->sb);
 }
 
@@ -142,15 +186,36 @@ int ob_add_file(outbuf_t *ob, const char *file, int size)
     } else {
         void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
 
-        PROTECT_ERRNO(close(fd));
-        if (map == MAP_FAILED)
+        if (map == MAP_FAILED) {
+            PROTECT_ERRNO(close(fd));
             return -1;
+        }
         madvise(map, size, MADV_SEQUENTIAL);
-        ob_add_memmap(ob, map, size);
+        ob_add_filemap(ob, fd, map, size);
     }
     return 0;
 }
 
+void ob_add_rope(outbuf_t *ob, sb_rope_t *rope)
+{
+    for (int i = 0; i < rope->nb_blocks; i++) {
+        ob_add_memchunk(ob, rope->blocks[i].data, rope->blocks[i].len,
+                        false);
+    }
+    rope->nb_blocks  = 0;
+    rope->blocks_len = 0;
+
+    if (rope->sb.len > OUTBUF_CHUNK_MIN_SIZE) {
+        int len;
+        char *data = sb_detach(&rope->sb, &len);
+
+        ob_add_memchunk(ob, data, len, false);
+    } else {
+        ob_addsb(ob, &rope->sb);
+        sb_reset(&rope->sb);
+    }
+}
+
 static int ob_consume(outbuf_t *ob, int len)
 {
     ob->length -= len;
@@ -177,7 +242,12 @@ static int ob_consume(outbuf_t *ob, int len)
         len -= (obc->length - obc->offset);
 
         htlist_pop(&ob->chunks_list);
-        ob_chunk_delete(&obc);
+        if (obc->zc_pending) {
+            /* the kernel may still read it */
+            htlist_add_tail(&ob->zc_chunks, &obc->chunks_link);
+        } else {
+            ob_chunk_delete(&obc);
+        }
     }
 
     assert (len <= ob->sb_trailing);
@@ -186,6 +256,125 @@ static int ob_consume(outbuf_t *ob, int len)
     return 0;
 }
 
+static bool ob_chunk_is_sent_alone(const outbuf_t *ob,
+                                   const outbuf_chunk_t *obc)
+{
+    return obc->fd >= 0
+        || (ob->zerocopy
+        &&  obc->length - obc->offset >= OUTBUF_ZEROCOPY_MIN_SIZE);
+}
+
+static ssize_t ob_send_chunk(outbuf_t *ob, int fd, outbuf_chunk_t *obc)
+{
+    size_t len = obc->length - obc->offset;
+    ssize_t res;
+
+    if (obc->fd >= 0) {
+        off_t off = obc->offset;
+
+        res = sendfile(fd, obc->fd, &off, len);
+        if (res >= 0) {
+            atomic_fetch_add_explicit(&ob_stats_g.sendfile_bytes, res,
+                                      memory_order_relaxed);
+            return res;
+        }
+        if (errno != EINVAL && errno != ENOSYS) {
+            return -1;
+        }
+        /* sendfile() is not supported by fd, use the mapping */
+        p_close(&obc->fd);
+    }
+
+#ifdef OB_HAS_ZEROCOPY
+    if (ob->zerocopy && len >= OUTBUF_ZEROCOPY_MIN_SIZE) {
+        struct iovec iov = MAKE_IOVEC(obc->u.b + obc->offset, len);
+        struct msghdr msgh = {
+            .msg_iov    = &iov,
+            .msg_iovlen = 1,
+        };
+
+        res = sendmsg(fd, &msgh, MSG_ZEROCOPY);
+        if (res > 0) {
+            obc->zc_seq     = ob->zc_seq++;
+            obc->zc_pending = true;
+            atomic_fetch_add_explicit(&ob_stats_g.zerocopy_bytes, res,
+                                      memory_order_relaxed);
+            return res;
+        }
+        /* ENOBUFS: the pinned pages exceed the limits, copy this one */
+        if (res == 0 || errno != ENOBUFS) {
+            return res;
+        }
+    }
+#endif
+
+    return write(fd, obc->u.b + obc->offset, len);
+}
+
+int ob_enable_zerocopy(outbuf_t *ob, int fd)
+{
+#ifdef OB_HAS_ZEROCOPY
+    int one = 1;
+
+    RETHROW(setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)));
+    ob->zerocopy = true;
+    return 0;
+#else
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+int ob_zerocopy_reap(outbuf_t *ob, int fd)
+{
+#ifdef OB_HAS_ZEROCOPY
+    for (;;) {
+        char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+        struct msghdr msgh = {
+            .msg_control    = control,
+            .msg_controllen = sizeof(control),
+        };
+
+        if (recvmsg(fd, &msgh, MSG_ERRQUEUE) < 0) {
+            return ERR_RW_RETRIABLE(errno) ? 0 : -1;
+        }
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msgh); cm;
+             cm = CMSG_NXTHDR(&msgh, cm))
+        {
+            struct sock_extended_err *serr;
+
+            if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+            &&  !(cm->cmsg_level == SOL_IPV6
+               && cm->cmsg_type == IPV6_RECVERR))
+            {
+                continue;
+            }
+            serr = (struct sock_extended_err *)CMSG_DATA(cm);
+            if (serr->ee_errno || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                /* zero-copy is useless on this path, avoid its cost */
+                atomic_fetch_add_explicit(&ob_stats_g.zerocopy_copied, 1,
+                                          memory_order_relaxed);
+                ob->zerocopy = false;
+            }
+            /* the completions are ranges [ee_info, ee_data] of sends */
+            ob_zerocopy_release(ob, serr->ee_data);
+        }
+    }
+#else
+    return 0;
+#endif
+}
+
+void ob_get_stats(outbuf_stats_t *stats)
+{
+    stats->sendfile_bytes  = atomic_load(&ob_stats_g.sendfile_bytes);
+    stats->zerocopy_bytes  = atomic_load(&ob_stats_g.zerocopy_bytes);
+    stats->zerocopy_copied = atomic_load(&ob_stats_g.zerocopy_copied);
+}
+
 int ob_write_with(outbuf_t *ob, int fd,
                   ssize_t (*writerv)(int, const struct iovec *, int, void *),
                   void *priv)
@@ -208,6 +397,13 @@ int ob_write_with(outbuf_t *ob, int fd,
             iov_size += len;
         }
 
+        if (!writerv && ob_chunk_is_sent_alone(ob, obc)) {
+            if (iovcnt) {
+                goto doit;
+            }
+            return ob_consume(ob, RETHROW(ob_send_chunk(ob, fd, obc)));
+        }
+
         len = obc->length - obc->offset;
         iov[iovcnt++] = MAKE_IOVEC(obc->u.b + obc->offset, len);
         iov_size += len;
@@ -708,10 +708,8 @@ static inline int ps_skipcasestr(pstream_t * nonnull ps,
 static inline size_t ps_skip_span(pstream_t * nonnull ps,
                                   const ctype_desc_t * nonnull d)
 {
-    size_t l = 0;
+    size_t l = ctype_desc_span(d, ps->b, ps_len(ps));
 
-    while (ps->b + l < ps->b_end && ctype_desc_contains(d, ps->b[l]))
-        l++;
     ps->b += l;
     return l;
 }
@@ -719,10 +717,8 @@ static inline size_t ps_skip_span(pstream_t * nonnull ps,
 static inline size_t ps_skip_cspan(pstream_t * nonnull ps,
                                    const ctype_desc_t * nonnull d)
 {
-    size_t l = 0;
+    size_t l = ctype_desc_cspan(d, ps->b, ps_len(ps));
 
-    while (ps->b + l < ps->b_end && !ctype_desc_contains(d, ps->b[l]))
-        l++;
     ps->b += l;
     return l;
 }
@@ -736,10 +732,8 @@ static inline size_t ps_skip_cspan(pstream_t * nonnull ps,
 static inline pstream_t ps_get_span(pstream_t * nonnull ps,
                                     const ctype_desc_t * nonnull d)
 {
-    const byte *b = ps->b;
+    const byte *b = ps->b + ctype_desc_span(d, ps->b, ps_len(ps));
 
-    while (b < ps->b_end && ctype_desc_contains(d, *b))
-        b++;
     return __ps_get_ps_upto(ps, b);
 }
 
@@ -752,10 +746,8 @@ static inline pstream_t ps_get_span(pstream_t * nonnull ps,
 static inline pstream_t ps_get_cspan(pstream_t * nonnull ps,
                                      const ctype_desc_t * nonnull d)
 {
-    const byte *b = ps->b;
+    const byte *b = ps->b + ctype_desc_cspan(d, ps->b, ps_len(ps));
 
-    while (b < ps->b_end && !ctype_desc_contains(d, *b))
-        b++;
     return __ps_get_ps_upto(ps, b);
 }
 
@@ -769,12 +761,7 @@ static inline bool
 ps_has_char_in_ctype(const pstream_t * nonnull ps,
                      const ctype_desc_t * nonnull d)
 {
-    for (const byte *b = ps->b; b < ps->b_end; b++) {
-        if (ctype_desc_contains(d, *b)) {
-            return true;
-        }
-    }
-    return false;
+    return ctype_desc_cspan(d, ps->b, ps_len(ps)) < ps_len(ps);
 }
 
 static inline pstream_t ps_get_tok(pstream_t * nonnull ps,
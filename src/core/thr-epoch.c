@@ -0,0 +1,288 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+
+#include <lib-common/container-qvector.h>
+#include <lib-common/thr.h>
+
+/* Retirements between two automatic collections. */
+#define THR_EPOCH_COLLECT_EVERY  64
+
+/* the object is freed with free_cb, or with mp_ifree(mp) when it is NULL */
+typedef struct thr_epoch_retired_t {
+    uint64_t    epoch;
+    uint64_t    retired_at;
+    void       *ptr;
+    void      (*free_cb)(void *);
+    mem_pool_t *mp;
+} thr_epoch_retired_t;
+
+qvector_t(epoch_retired, thr_epoch_retired_t);
+
+atomic_uint64_t thr_epoch_g = 1;
+__thread thr_epoch_rec_t *thr_epoch_rec_g;
+
+static struct {
+    spinlock_t lock;
+    dlist_t    recs;
+    qv_t(epoch_retired) retired;
+    int        since_collect;
+    atomic_uint32_t pending;
+    thr_epoch_stats_t stats;
+} thr_epoch_state_g = {
+#define _G  thr_epoch_state_g
+    .recs = DLIST_INIT(_G.recs),
+};
+
+/* {{{ Epochs */
+
+thr_epoch_rec_t *thr_epoch_register(void)
+{
+    thr_epoch_rec_t *rec = mpa_new(&mem_pool_libc, thr_epoch_rec_t, 1,
+                                   CACHE_LINE_SIZE);
+
+    spin_lock(&_G.lock);
+    dlist_add_tail(&_G.recs, &rec->link);
+    spin_unlock(&_G.lock);
+    return thr_epoch_rec_g = rec;
+}
+
+static uint64_t thr_epoch_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void thr_epoch_thr_init(void)
+{
+    if (!thr_epoch_rec_g) {
+        thr_epoch_register();
+    }
+}
+
+static void thr_epoch_thr_wipe(void)
+{
+    thr_epoch_rec_t *rec = thr_epoch_rec_g;
+
+    if (rec) {
+        assert (!rec->depth);
+        spin_lock(&_G.lock);
+        dlist_remove(&rec->link);
+        spin_unlock(&_G.lock);
+        mp_delete(&mem_pool_libc, &rec);
+        thr_epoch_rec_g = NULL;
+    }
+}
+thr_hooks(thr_epoch_thr_init, thr_epoch_thr_wipe);
+
+/* Detach the objects retired before the oldest epoch of the threads in a
+ * critical section, must be called with the lock held. */
+static void thr_epoch_collect_locked(qv_t(epoch_retired) *out)
+{
+    uint64_t min = atomic_load(&thr_epoch_g);
+    uint64_t now;
+    int len = 0;
+
+    dlist_for_each(it, &_G.recs) {
+        thr_epoch_rec_t *rec = container_of(it, thr_epoch_rec_t, link);
+        uint64_t epoch = atomic_load(&rec->epoch);
+
+        if (epoch && epoch < min) {
+            min = epoch;
+        }
+    }
+
+    /* the objects are retired in the order of their epochs */
+    while (len < _G.retired.len && _G.retired.tab[len].epoch < min) {
+        len++;
+    }
+    if (len) {
+        now = thr_epoch_now();
+        for (int i = 0; i < len; i++) {
+            uint64_t ns = now - MIN(now, _G.retired.tab[i].retired_at);
+            uint64_t us = ns / 1000;
+            unsigned bucket = us ? bsr64(us) + 1 : 0;
+
+            bucket = MIN(bucket, THR_EPOCH_BUCKETS - 1U);
+            _G.stats.grace_hist[bucket]++;
+            _G.stats.grace_sum += ns;
+            _G.stats.grace_max = MAX(_G.stats.grace_max, ns);
+        }
+        _G.stats.freed += len;
+        qv_extend(out, _G.retired.tab, len);
+        qv_skip(&_G.retired, len);
+    }
+    atomic_store_explicit(&_G.pending, _G.retired.len, memory_order_relaxed);
+    _G.since_collect = 0;
+}
+
+static void thr_epoch_free(qv_t(epoch_retired) *objs)
+{
+    tab_for_each_ptr(obj, objs) {
+        if (obj->free_cb) {
+            (*obj->free_cb)(obj->ptr);
+        } else {
+            mp_ifree(obj->mp, obj->ptr);
+        }
+    }
+    qv_wipe(objs);
+}
+
+static void thr_epoch_retire_obj(thr_epoch_retired_t obj)
+{
+    qv_t(epoch_retired) objs;
+
+    qv_init(&objs);
+    obj.retired_at = thr_epoch_now();
+    spin_lock(&_G.lock);
+    obj.epoch = atomic_fetch_add(&thr_epoch_g, 1);
+    qv_append(&_G.retired, obj);
+    _G.stats.retired++;
+    if (++_G.since_collect >= THR_EPOCH_COLLECT_EVERY) {
+        thr_epoch_collect_locked(&objs);
+    } else {
+        atomic_store_explicit(&_G.pending, _G.retired.len,
+                              memory_order_relaxed);
+    }
+    spin_unlock(&_G.lock);
+    thr_epoch_free(&objs);
+}
+
+void thr_epoch_retire(void *ptr, void (*free_cb)(void *))
+{
+    thr_epoch_retire_obj((thr_epoch_retired_t){
+        .ptr     = ptr,
+        .free_cb = free_cb,
+    });
+}
+
+void thr_epoch_retire_mp(mem_pool_t *mp, void *ptr)
+{
+    if (ptr) {
+        thr_epoch_retire_obj((thr_epoch_retired_t){
+            .ptr = ptr,
+            .mp  = mp,
+        });
+    }
+}
+
+void thr_epoch_collect(void)
+{
+    qv_t(epoch_retired) objs;
+
+    qv_init(&objs);
+    spin_lock(&_G.lock);
+    thr_epoch_collect_locked(&objs);
+    spin_unlock(&_G.lock);
+    thr_epoch_free(&objs);
+}
+
+void thr_epoch_quiescent(void)
+{
+    assert (!thr_epoch_rec_g || !thr_epoch_rec_g->depth);
+
+    if (atomic_load_explicit(&_G.pending, memory_order_relaxed)) {
+        thr_epoch_collect();
+    }
+}
+
+void thr_epoch_synchronize(void)
+{
+    assert (!thr_epoch_rec_g || !thr_epoch_rec_g->depth);
+
+    for (;;) {
+        bool done;
+
+        thr_epoch_collect();
+        spin_lock(&_G.lock);
+        done = !_G.retired.len;
+        spin_unlock(&_G.lock);
+        if (done) {
+            break;
+        }
+        sched_yield();
+    }
+}
+
+void thr_epoch_get_stats(thr_epoch_stats_t *stats)
+{
+    spin_lock(&_G.lock);
+    *stats = _G.stats;
+    spin_unlock(&_G.lock);
+}
+
+/* }}} */
+/* {{{ Deferred allocator */
+
+static void epoch_mem_free(void *ptr)
+{
+    mp_ifree(&mem_pool_libc, ptr);
+}
+
+static void *epoch_malloc(mem_pool_t *mp, size_t size, size_t alignment,
+                          mem_flags_t flags)
+{
+    return mp_imalloc(&mem_pool_libc, size, alignment, flags);
+}
+
+static void epoch_free(mem_pool_t *mp, void *ptr)
+{
+    if (ptr && ptr != MEM_EMPTY_ALLOC) {
+        thr_epoch_retire(ptr, &epoch_mem_free);
+    }
+}
+
+static void *epoch_realloc(mem_pool_t *mp, void *ptr, size_t oldsize,
+                           size_t size, size_t alignment, mem_flags_t flags)
+{
+    byte *res;
+
+    if (!ptr || ptr == MEM_EMPTY_ALLOC) {
+        return epoch_malloc(mp, size, alignment, flags);
+    }
+    if (unlikely(size == 0)) {
+        epoch_free(mp, ptr);
+        return MEM_EMPTY_ALLOC;
+    }
+    assert (oldsize != MEM_UNKNOWN);
+
+    /* never reallocate in place, the readers may still use the old block */
+    res = mp_imalloc(&mem_pool_libc, size, alignment, flags | MEM_RAW);
+    if (unlikely(!res)) {
+        return NULL;
+    }
+    p_copy(res, (byte *)ptr, MIN(oldsize, size));
+    if (!(flags & MEM_RAW) && oldsize < size) {
+        p_clear(res + oldsize, size - oldsize);
+    }
+    epoch_free(mp, ptr);
+    return res;
+}
+
+mem_pool_t mem_pool_epoch = {
+    .malloc   = &epoch_malloc,
+    .realloc  = &epoch_realloc,
+    .free     = &epoch_free,
+    .mem_pool = MEM_OTHER,
+    .min_alignment = sizeof(void *),
+    .name     = "epoch",
+};
+
+/* }}} */
@@ -0,0 +1,161 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+
+#if !defined(IS_LIB_COMMON_THR_H) || defined(IS_LIB_COMMON_THR_EPOCH_H)
+#  error "you must include thr.h instead"
+#else
+#define IS_LIB_COMMON_THR_EPOCH_H
+
+/*
+ * Epoch based reclamation.
+ *
+ * It lets the readers use objects shared between threads without taking any
+ * lock or reference, while the writers unlink them concurrently:
+ *
+ * #readers
+ *
+ *     thr_epoch_enter();
+ *     obj = <load the shared pointer>;
+ *     use(obj);
+ *     thr_epoch_leave();
+ *
+ * #writers
+ *
+ *     obj = <unlink the shared pointer>;
+ *     thr_epoch_retire(obj, &obj_free);
+ *
+ * A retired object is freed once all the threads that were in a critical
+ * section when it was retired have left it, by the thr_epoch_retire() or
+ * thr_epoch_collect() call that follows. The critical sections nest, and
+ * must be short: they delay the reclamation of everything retired meanwhile.
+ *
+ * The entering of a critical section costs a full memory barrier, on a
+ * cache line of the thread, so the readers don't share any cache line.
+ *
+ * The threads register when they are attached (see thr_attach()), or on
+ * their first critical section, and unregister when they are detached. The
+ * thr_job workers are quiescent between two jobs: they must not leave a
+ * critical section open at the end of a job, and they free the retired
+ * objects when they go idle (see thr_epoch_quiescent()).
+ */
+
+typedef struct thr_epoch_rec_t {
+    atomic_uint64_t epoch;
+    int             depth;
+    dlist_t         link;
+} __attribute__((aligned(CACHE_LINE_SIZE))) thr_epoch_rec_t;
+
+extern atomic_uint64_t thr_epoch_g;
+extern __thread thr_epoch_rec_t *thr_epoch_rec_g;
+
+thr_epoch_rec_t *thr_epoch_register(void);
+
+static ALWAYS_INLINE void thr_epoch_enter(void)
+{
+    thr_epoch_rec_t *rec = thr_epoch_rec_g ?: thr_epoch_register();
+
+    if (rec->depth++ == 0) {
+        atomic_store_explicit(&rec->epoch,
+                              atomic_load_explicit(&thr_epoch_g,
+                                                   memory_order_relaxed),
+                              memory_order_relaxed);
+        /* the loads of the critical section must not be performed before
+         * the epoch is published */
+        atomic_thread_fence(memory_order_seq_cst);
+    }
+}
+
+static ALWAYS_INLINE void thr_epoch_leave(void)
+{
+    thr_epoch_rec_t *rec = thr_epoch_rec_g;
+
+    assert (rec && rec->depth > 0);
+    if (--rec->depth == 0) {
+        atomic_store_explicit(&rec->epoch, 0, memory_order_release);
+    }
+}
+
+static ALWAYS_INLINE void thr_epoch_scope_cleanup(const bool * nonnull unused)
+{
+    thr_epoch_leave();
+}
+
+/** Critical section until the end of the current scope. */
+#define thr_epoch_scope  \
+    const bool PFX_LINE(thr_epoch_scope_)                                    \
+    __attribute__((unused,cleanup(thr_epoch_scope_cleanup)))                 \
+        = (thr_epoch_enter(), true)
+
+/** Free \p ptr with \p free_cb once no thread can use it anymore.
+ *
+ * The object must be unreachable for the threads that enter a critical
+ * section from now on. It may be freed synchronously when no thread is in a
+ * critical section.
+ */
+void thr_epoch_retire(void * nonnull ptr,
+                      void (* nonnull free_cb)(void * nonnull));
+
+/** Free \p ptr with mp_ifree(\p mp) once no thread can use it anymore. */
+void thr_epoch_retire_mp(mem_pool_t * nullable mp, void * nullable ptr);
+
+/** Free the retired objects that no thread can use anymore. */
+void thr_epoch_collect(void);
+
+/** Quiescent point of a thread, out of any critical section.
+ *
+ * It collects the retired objects if there are some, it is called by the
+ * thr_job workers when they go idle.
+ */
+void thr_epoch_quiescent(void);
+
+/** Wait until all the objects retired so far are freed.
+ *
+ * It must not be called from a critical section.
+ */
+void thr_epoch_synchronize(void);
+
+/** Allocator whose frees are deferred with thr_epoch_retire().
+ *
+ * It allocates from the libc and its reallocations always move the blocks,
+ * so that the threads in a critical section can still read the blocks they
+ * reached while another thread frees or reallocates them.
+ */
+extern mem_pool_t mem_pool_epoch;
+
+/** Number of buckets of the grace periods histogram.
+ *
+ * The bucket i counts the grace periods lower than 2^i microseconds (and not
+ * lower than 2^(i - 1) microseconds), the last one counts the grace periods
+ * that don't fit in the others.
+ */
+#define THR_EPOCH_BUCKETS  28
+
+typedef struct thr_epoch_stats_t {
+    uint64_t retired;
+    uint64_t freed;
+    /** grace periods, from the retirement to the free, in nanoseconds */
+    uint64_t grace_sum;
+    uint64_t grace_max;
+    uint64_t grace_hist[THR_EPOCH_BUCKETS];
+} thr_epoch_stats_t;
+
+/** Get the statistics of the reclamation since the start of the program. */
+void thr_epoch_get_stats(thr_epoch_stats_t * nonnull stats);
+
+#endif
@@ -16,8 +16,22 @@
 /*                                                                         */
 /***************************************************************************/
 
+#include <lib-common/datetime.h>
 #include <lib-common/thr.h>
 
+static struct {
+    atomic_uint64_t spins;
+    atomic_uint64_t parks;
+} thr_evc_g;
+
+void thr_ec_get_stats(thr_ec_stats_t *stats)
+{
+    stats->spins = atomic_load_explicit(&thr_evc_g.spins,
+                                        memory_order_relaxed);
+    stats->parks = atomic_load_explicit(&thr_evc_g.parks,
+                                        memory_order_relaxed);
+}
+
 #if defined(__linux__)
 
 /* This code has been adapted from http://atomic-ptr-plus.sourceforge.net/
@@ -79,10 +93,62 @@ void thr_ec_signal_n(thr_evc_t *ec, int count)
 {
     atomic_fetch_add(&ec->key, 1);
 
+    /* the spinning waiters are not accounted, they see the new key */
     if (atomic_load(&ec->waiters))
         futex_wake_private(&ec->key, count);
 }
 
+/* Adaptive spinning {{{ */
+
+/* Upper bound of the spinning budget, in cycles. It is about the cost of a
+ * futex sleep and wake up.
+ */
+#define THR_EC_SPIN_MAX  (1U << 16)
+
+/* Track the latency of the waits of the eventcount: the budget converges to
+ * twice the recent latencies when they are shorter than the maximum budget,
+ * and to 0 when they are longer, so that the eventcounts used for long
+ * waits (idle threads) don't burn any CPU.
+ */
+static void thr_ec_spin_adapt(thr_evc_t *ec, uint64_t latency)
+{
+    int64_t spin = atomic_load_explicit(&ec->spin, memory_order_relaxed);
+    int64_t target = 0;
+
+    if (latency < THR_EC_SPIN_MAX / 2) {
+        target = 2 * latency;
+    }
+    spin += (target - spin) / 8;
+    atomic_store_explicit(&ec->spin, spin, memory_order_relaxed);
+}
+
+/* Spin while the key is "key", within the budget of the eventcount.
+ *
+ * Returns true if the key changed.
+ */
+static bool thr_ec_spin(thr_evc_t *ec, uint64_t key, uint64_t start)
+{
+    unsigned budget = atomic_load_explicit(&ec->spin, memory_order_relaxed);
+
+    if (!budget) {
+        return false;
+    }
+    do {
+        for (int i = 0; i < 16; i++) {
+            cpu_relax();
+            if (atomic_load_explicit(&ec->key, memory_order_acquire) != key) {
+                thr_ec_spin_adapt(ec, hardclock() - start);
+                atomic_fetch_add_explicit(&thr_evc_g.spins, 1,
+                                          memory_order_relaxed);
+                return true;
+            }
+        }
+    } while (hardclock() - start < budget);
+    return false;
+}
+
+/* }}} */
+
 static void thr_ec_wait_cleanup(void *arg)
 {
     thr_evc_t *ec = arg;
@@ -91,6 +157,7 @@ static void thr_ec_wait_cleanup(void *arg)
 
 void thr_ec_timedwait(thr_evc_t *ec, uint64_t key, long timeout)
 {
+    uint64_t start;
     int canceltype, res;
 
     atomic_thread_fence(memory_order_acq_rel);
@@ -106,6 +173,13 @@ void thr_ec_timedwait(thr_evc_t *ec, uint64_t key, long timeout)
         return;
     }
 
+    start = hardclock();
+    if (thr_ec_spin(ec, key, start)) {
+        pthread_testcancel();
+        return;
+    }
+
+    atomic_fetch_add_explicit(&thr_evc_g.parks, 1, memory_order_relaxed);
     atomic_fetch_add(&ec->waiters, 1);
     pthread_cleanup_push(&thr_ec_wait_cleanup, ec);
     pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &canceltype);
@@ -121,6 +195,7 @@ void thr_ec_timedwait(thr_evc_t *ec, uint64_t key, long timeout)
     }
     if (res == 0)
         sched_yield();
+    thr_ec_spin_adapt(ec, hardclock() - start);
 
     /* XXX passing NULL to pthread_setcanceltype() breaks TSAN */
     pthread_setcanceltype(canceltype, &res);
@@ -132,6 +207,7 @@ thr_evc_t *thr_ec_init(thr_evc_t *ec)
     p_clear(ec, 1);
     atomic_init(&ec->key, 0);
     atomic_init(&ec->waiters, 0);
+    atomic_init(&ec->spin, 0);
     return ec;
 }
 
@@ -142,7 +218,6 @@ void thr_ec_wipe(thr_evc_t *ec)
 #else
 
 #include <pthread.h>
-#include <lib-common/datetime.h>
 
 thr_evc_t *thr_ec_init(thr_evc_t *ec)
 {
@@ -189,6 +264,7 @@ void thr_ec_timedwait(thr_evc_t *ec, uint64_t key, long timeout)
         ts.tv_nsec = (usec % 1000000) * 1000;
     }
 
+    atomic_fetch_add_explicit(&thr_evc_g.parks, 1, memory_order_relaxed);
     atomic_fetch_add(&ec->waiters, 1);
     pthread_cleanup_push(&thr_ec_wait_cleanup, ec);
     pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &canceltype);
@@ -67,6 +67,10 @@
  *    until we're signalled. This really works like futex(ec, FUTEX_WAIT, key)
  *    in a way (and indeed is a wrapper around futex(2)), so read futex(2) for
  *    more details.
+ *    On Linux, the waiter spins a little before it sleeps. The spinning
+ *    budget of each eventcount adapts to the latency of its recent waits: it
+ *    spins for the short waits (where sleeping and waking up would cost more
+ *    than the wait itself), and not at all for the long ones.
  *
  *
  * thr_ec_signal_n(ec, n):
@@ -90,7 +94,10 @@
 
 typedef struct thr_evc_t {
     atomic_uint64_t key;
+    /* number of sleeping waiters, the spinning ones are not accounted */
     atomic_uint waiters;
+    /* spinning budget of the waiters, in cycles */
+    atomic_uint spin;
 #ifndef OS_LINUX
     pthread_mutex_t mutex;
     pthread_cond_t  cond;
@@ -100,6 +107,17 @@ typedef struct thr_evc_t {
 thr_evc_t *thr_ec_init(thr_evc_t *ec);
 void thr_ec_wipe(thr_evc_t *ec);
 
+typedef struct thr_ec_stats_t {
+    /* number of waits that ended while spinning */
+    uint64_t spins;
+    /* number of waits that slept */
+    uint64_t parks;
+} thr_ec_stats_t;
+
+/** Get the statistics of the waits of all the eventcounts, since the start
+ * of the process. */
+void thr_ec_get_stats(thr_ec_stats_t *stats);
+
 static ALWAYS_INLINE
 uint64_t thr_ec_get(thr_evc_t *ec)
 {
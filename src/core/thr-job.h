@@ -25,6 +25,19 @@
 
 #define THR_JOB_MAX   256
 
+/** Priority lanes of the jobs.
+ *
+ * Each thread has one deque per lane. The threads always run and steal the
+ * jobs of the high priority lane before the normal ones, so that latency
+ * sensitive jobs (RPC handlers, ...) are not delayed by large batches of
+ * background jobs queued before them.
+ */
+typedef enum thr_prio_t {
+    THR_PRIO_HIGH,
+    THR_PRIO_NORMAL,
+    THR_PRIO__MAX,
+} thr_prio_t;
+
 typedef struct thr_job_t   thr_job_t;
 typedef struct thr_syn_t   thr_syn_t;
 typedef struct thr_queue_t thr_queue_t;
@@ -64,6 +77,8 @@ struct thr_syn_t {
     atomic_uint refcnt;
     /** the eventcount used for the blocking part of the thr_syn_wait() */
     thr_evc_t         ec;
+    /** set by thr_syn_cancel() */
+    atomic_bool       cancelled;
 
 #ifdef __has_blocks
     /** Thread data allocator */
@@ -132,6 +147,13 @@ size_t thr_id(void) __leaf __attribute__((pure));
 void thr_schedule(thr_job_t *job);
 void thr_syn_schedule(thr_syn_t *syn, thr_job_t *job);
 
+/** \brief Schedule one job in a given priority lane.
+ *
+ * thr_schedule() and thr_syn_schedule() use the THR_PRIO_NORMAL lane.
+ */
+void thr_schedule_prio(thr_prio_t prio, thr_job_t *job);
+void thr_syn_schedule_prio(thr_syn_t *syn, thr_prio_t prio, thr_job_t *job);
+
 #ifdef __has_blocks
 static ALWAYS_INLINE void thr_schedule_b(block_t blk)
 {
@@ -141,11 +163,105 @@ static ALWAYS_INLINE void thr_syn_schedule_b(thr_syn_t *syn, block_t blk)
 {
     thr_syn_schedule(syn, thr_job_from_blk(blk));
 }
+static ALWAYS_INLINE void thr_schedule_prio_b(thr_prio_t prio, block_t blk)
+{
+    thr_schedule_prio(prio, thr_job_from_blk(blk));
+}
+static ALWAYS_INLINE
+void thr_syn_schedule_prio_b(thr_syn_t *syn, thr_prio_t prio, block_t blk)
+{
+    thr_syn_schedule_prio(syn, prio, thr_job_from_blk(blk));
+}
 #endif
 
+/** Tag of a kind of jobs.
+ *
+ * The jobs scheduled with a tag account the time they waited in the deques
+ * and the time they ran in the histograms of their tag, see
+ * thr_job_tags_stats(). This costs two clock reads and a few atomic
+ * increments per job, so tag the jobs that are meaningful for the
+ * monitoring rather than every small job.
+ *
+ * A tagged job also runs in a trace span named after its tag (see trace.h),
+ * child of the span that scheduled it.
+ */
+typedef struct thr_job_tag_t thr_job_tag_t;
+
+/** Number of buckets of the histograms of the tags.
+ *
+ * The bucket i counts the durations lower than 2^i microseconds (and not
+ * lower than 2^(i - 1) microseconds), the last one counts the durations
+ * that don't fit in the others.
+ */
+#define THR_JOB_TAG_BUCKETS  28
+
+/** Get the tag with the given name, creating it the first time.
+ *
+ * The name must be a static string. Tags are never destroyed, so the result
+ * can be cached, which THR_JOB_TAG() does.
+ */
+thr_job_tag_t *thr_job_tag(const char *name) __leaf;
+
+#define THR_JOB_TAG(name)                                                    \
+    ({  static thr_job_tag_t *__tag;                                         \
+                                                                             \
+        if (unlikely(!__tag)) {                                              \
+            __tag = thr_job_tag(name);                                       \
+        }                                                                    \
+        __tag;                                                               \
+    })
+
+/** Schedule one job with a tag.
+ *
+ * \p tag can be NULL, in which case this is thr_syn_schedule_prio().
+ */
+void thr_syn_schedule_tagged(thr_syn_t *syn, thr_prio_t prio,
+                             thr_job_tag_t *tag, thr_job_t *job);
+
+#ifdef __has_blocks
+static ALWAYS_INLINE void thr_schedule_tagged_b(thr_job_tag_t *tag,
+                                                block_t blk)
+{
+    thr_syn_schedule_tagged(NULL, THR_PRIO_NORMAL, tag,
+                            thr_job_from_blk(blk));
+}
+static ALWAYS_INLINE
+void thr_syn_schedule_tagged_b(thr_syn_t *syn, thr_job_tag_t *tag,
+                               block_t blk)
+{
+    thr_syn_schedule_tagged(syn, THR_PRIO_NORMAL, tag,
+                            thr_job_from_blk(blk));
+}
+#endif
+
+typedef struct thr_job_tag_stats_t {
+    const char *name;
+    uint64_t    jobs;
+    /** cumulated time waited in the deques and run, in nanoseconds */
+    uint64_t    wait_sum;
+    uint64_t    run_sum;
+    uint64_t    wait_hist[THR_JOB_TAG_BUCKETS];
+    uint64_t    run_hist[THR_JOB_TAG_BUCKETS];
+} thr_job_tag_stats_t;
+
+/** Call \p cb on the statistics of every tag.
+ *
+ * The statistics are cumulated since the creation of the tags.
+ */
+void thr_job_tags_stats(void (*cb)(const thr_job_tag_stats_t *stats,
+                                   void *priv),
+                        void *priv);
+
 thr_queue_t *thr_queue_create(void) __leaf;
 void thr_queue_destroy(thr_queue_t *q, bool wait) __leaf;
 
+/** Set the priority lane in which the jobs of a serial queue run.
+ *
+ * Queues are created in the THR_PRIO_NORMAL lane. This is meaningless for
+ * thr_queue_main_g whose jobs always run in the main thread.
+ */
+void thr_queue_set_prio(thr_queue_t *q, thr_prio_t prio) __leaf;
+
 /** Return true if the queue is currently running on the current thread.
  *
  * This basically means we are inside the queue.
@@ -211,6 +327,7 @@ static ALWAYS_INLINE thr_syn_t *thr_syn_init(thr_syn_t *syn)
     thr_ec_init(&syn->ec);
     atomic_init(&syn->pending, 0);
     atomic_init(&syn->refcnt, 1);
+    atomic_init(&syn->cancelled, false);
     return syn;
 }
 GENERIC_NEW(thr_syn_t, thr_syn);
@@ -218,6 +335,30 @@ GENERIC_NEW(thr_syn_t, thr_syn);
 void thr_syn_wipe(thr_syn_t *syn);
 GENERIC_DELETE(thr_syn_t, thr_syn);
 
+/** \brief cancel the jobs of a thr_syn_t.
+ *
+ * The jobs of \p syn that are queued but not started yet are dropped by the
+ * scheduler: they are not run, but they are accounted as done (and the
+ * blocks are released), so that thr_syn_wait() returns as soon as the
+ * running jobs are done. The jobs scheduled on \p syn after its
+ * cancellation are dropped too.
+ *
+ * The running jobs are not interrupted, long jobs should poll
+ * thr_syn_is_cancelled() to stop early.
+ *
+ * Note that the jobs that are not blocks are dropped as well, so their owner
+ * must not rely on their run() callback to release them.
+ */
+static ALWAYS_INLINE void thr_syn_cancel(thr_syn_t *syn)
+{
+    atomic_store_explicit(&syn->cancelled, true, memory_order_release);
+}
+
+static ALWAYS_INLINE bool thr_syn_is_cancelled(thr_syn_t *syn)
+{
+    return atomic_load_explicit(&syn->cancelled, memory_order_acquire);
+}
+
 /** \brief setup a thr_syn_t to fire an event when finished.
  *
  * This must be called after all the jobs have been queued or it may fire
@@ -335,6 +476,18 @@ void thr_queue_main_drain(void);
  */
 bool thr_job_reload_at_fork(bool enabled);
 
+/** \brief pin the job threads to CPUs.
+ *
+ * When enabled, each job thread (but the main one) is bound to one of the
+ * CPUs the process is allowed to run on. It must be called before the thr
+ * module is loaded, and can also be enabled by setting the THR_PIN_THREADS
+ * environment variable to 1.
+ *
+ * Whether they are pinned or not, the threads steal the jobs of the threads
+ * sharing their L3 cache first.
+ */
+void thr_job_pin_threads(bool enabled);
+
 /** \brief fork() preserving threads-jobs */
 __must_check__
 static inline pid_t thr_job_fork(void)
@@ -354,6 +507,10 @@ static inline pid_t thr_job_fork(void)
  * be temporarilly reduced because the current thread enters a potentially
  * blocking call and that it won't be able to process additional jobs during
  * that call.
+ *
+ * A standby thread takes over the jobs during the call so that
+ * thr_parallelism_g threads keep running, up to thr_parallelism_g blocked
+ * threads at once.
  */
 void thr_enter_blocking_syscall(void);
 
@@ -362,6 +519,20 @@ void thr_enter_blocking_syscall(void);
  */
 void thr_exit_blocking_syscall(void);
 
+typedef struct thr_blocking_stats_t {
+    /* number of threads currently in a blocking section */
+    size_t   blocked;
+    /* number of blocking sections compensated by a standby thread */
+    uint64_t compensations;
+    /* number of blocking sections that were not compensated because
+     * thr_parallelism_g sections were already compensated */
+    uint64_t capped;
+} thr_blocking_stats_t;
+
+/** Get the statistics of the blocking sections since the thr module was
+ * initialized. */
+void thr_get_blocking_stats(thr_blocking_stats_t *stats);
+
 #ifdef __has_blocks
 
 /** Run \p count concurrent jobs.
@@ -374,6 +545,16 @@ void thr_for_each(size_t count, void (BLOCK_CARET blk)(size_t pos));
 
 /*- accounting -----------------------------------------------------------*/
 
+/* In addition to the per thread counters, thr_acc_trace() prints for each
+ * priority lane the number of queued jobs, the maximum depth reached by the
+ * deques and an histogram of the time the jobs waited in the deques (in
+ * powers of two of cycles).
+ *
+ * When the THR_ACC_PERF environment variable is set to 1, the threads also
+ * count their hardware events (see perf_counters_t), and thr_acc_trace()
+ * prints the IPC, the cache and the branch misses of each thread.
+ */
+
 #if !defined(NDEBUG) && !defined(__has_tsan)
 void thr_acc_reset(void);
 void thr_acc_trace(int lvl, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
@@ -0,0 +1,154 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/thr.h>
+
+mpmc_queue_t *mpmc_queue_init(mpmc_queue_t *q, size_t size, bool blocking)
+{
+    size = MAX(size, 2);
+    size = 1UL << (bsr64(size - 1) + 1);
+
+    p_clear(q, 1);
+    q->cells    = p_new_raw(mpmc_cell_t, size);
+    q->mask     = size - 1;
+    q->blocking = blocking;
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&q->cells[i].seq, i);
+    }
+    thr_ec_init(&q->not_full);
+    thr_ec_init(&q->not_empty);
+    return q;
+}
+
+void mpmc_queue_wipe(mpmc_queue_t *q)
+{
+    thr_ec_wipe(&q->not_empty);
+    thr_ec_wipe(&q->not_full);
+    p_delete(&q->cells);
+}
+
+/* Claim up to n consecutive cells from *pos, which are ready when their
+ * sequence is their position plus "lag" (0 on the producer side, 1 on the
+ * consumer side). Returns the number of cells claimed, 0 when the first cell
+ * isn't ready.
+ */
+static size_t mpmc_queue_claim(mpmc_queue_t *q, atomic_size_t *apos,
+                               size_t lag, size_t n, size_t *pos)
+{
+    *pos = atomic_load_explicit(apos, memory_order_relaxed);
+
+    for (;;) {
+        size_t count = 0;
+        size_t seq = 0;
+
+        for (; count < n; count++) {
+            mpmc_cell_t *cell = &q->cells[(*pos + count) & q->mask];
+
+            seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+            if (seq != *pos + count + lag) {
+                break;
+            }
+        }
+        if (count == 0) {
+            if ((ssize_t)(seq - (*pos + lag)) < 0) {
+                return 0;
+            }
+            /* another thread claimed the cell, catch up */
+            *pos = atomic_load_explicit(apos, memory_order_relaxed);
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(apos, pos, *pos + count,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        {
+            return count;
+        }
+    }
+}
+
+size_t mpmc_queue_push_n(mpmc_queue_t *q, void * const *v, size_t n)
+{
+    size_t pos;
+    size_t count;
+
+    if (!n) {
+        return 0;
+    }
+    count = mpmc_queue_claim(q, &q->push_pos, 0, n, &pos);
+    for (size_t i = 0; i < count; i++) {
+        mpmc_cell_t *cell = &q->cells[(pos + i) & q->mask];
+
+        cell->value = v[i];
+        atomic_store_explicit(&cell->seq, pos + i + 1, memory_order_release);
+    }
+    if (count && q->blocking) {
+        thr_ec_signal_n(&q->not_empty, (int)count);
+    }
+    return count;
+}
+
+size_t mpmc_queue_pop_n(mpmc_queue_t *q, void **v, size_t n)
+{
+    size_t pos;
+    size_t count;
+
+    if (!n) {
+        return 0;
+    }
+    count = mpmc_queue_claim(q, &q->pop_pos, 1, n, &pos);
+    for (size_t i = 0; i < count; i++) {
+        mpmc_cell_t *cell = &q->cells[(pos + i) & q->mask];
+
+        v[i] = cell->value;
+        atomic_store_explicit(&cell->seq, pos + i + q->mask + 1,
+                              memory_order_release);
+    }
+    if (count && q->blocking) {
+        thr_ec_signal_n(&q->not_full, (int)count);
+    }
+    return count;
+}
+
+void mpmc_queue_push_wait(mpmc_queue_t *q, void *v)
+{
+    assert (q->blocking);
+    while (!mpmc_queue_push(q, v)) {
+        uint64_t key = thr_ec_get(&q->not_full);
+
+        if (mpmc_queue_push(q, v)) {
+            break;
+        }
+        thr_ec_wait(&q->not_full, key);
+    }
+}
+
+void *mpmc_queue_pop_wait(mpmc_queue_t *q)
+{
+    void *v;
+
+    assert (q->blocking);
+    while (!mpmc_queue_pop(q, &v)) {
+        uint64_t key = thr_ec_get(&q->not_empty);
+
+        if (mpmc_queue_pop(q, &v)) {
+            break;
+        }
+        thr_ec_wait(&q->not_empty, key);
+    }
+    return v;
+}
@@ -0,0 +1,200 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#if !defined(IS_LIB_COMMON_THR_H) || defined(IS_LIB_COMMON_THR_MPMC_H)
+#  error "you must include thr.h instead"
+#else
+#define IS_LIB_COMMON_THR_MPMC_H
+
+/*
+ * This file provides an implementation of:
+ * - bounded: the queue is a ring of a fixed power of 2 number of cells, that
+ *   is allocated once and for all by mpmc_queue_init().
+ * - lock free: push and pop cost one compare-and-swap on the position of
+ *   their side of the queue, and never wait for each other (except for the
+ *   one cell they are working on).
+ * - non blocking: push returns false when the queue is full, and pop returns
+ *   false when it is empty. Blocking versions are provided, based on event
+ *   counts, for the queues initialized with the "blocking" flag.
+ * - MPMC queue: multiple producers, multiple consumers.
+ *
+ * The producers and the consumers positions live in their own cache lines,
+ * so that the two sides of the queue don't false share.
+ *
+ * The batch versions claim as many cells as they can in a single
+ * compare-and-swap, which amortizes the contention on the positions.
+ *
+ * The code is adapted from
+ * http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ */
+
+/*
+ * Copyright (c) 2010-2011 Dmitry Vyukov. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY DMITRY VYUKOV "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+ * NO EVENT SHALL DMITRY VYUKOV OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Dmitry Vyukov
+ */
+
+typedef struct mpmc_cell_t {
+    atomic_size_t seq;
+    void         *value;
+} mpmc_cell_t;
+
+typedef struct mpmc_queue_t {
+    mpmc_cell_t *cells;
+    size_t       mask;
+    bool         blocking;
+
+    /* Producer part */
+    atomic_size_t push_pos __attribute__((aligned(CACHE_LINE_SIZE)));
+    thr_evc_t     not_full;
+
+    /* Consumer part */
+    atomic_size_t pop_pos  __attribute__((aligned(CACHE_LINE_SIZE)));
+    thr_evc_t     not_empty;
+} __attribute__((aligned(CACHE_LINE_SIZE))) mpmc_queue_t;
+
+/** Initialize a queue.
+ *
+ * \param[in] size      the capacity of the queue, rounded up to the next
+ *                      power of 2.
+ * \param[in] blocking  whether mpmc_queue_push_wait() and
+ *                      mpmc_queue_pop_wait() can be used on the queue. It
+ *                      costs an atomic increment of an event count on each
+ *                      successful push and pop, so leave it unset for the
+ *                      queues that are only polled.
+ */
+mpmc_queue_t *mpmc_queue_init(mpmc_queue_t *q, size_t size, bool blocking)
+    __leaf;
+void          mpmc_queue_wipe(mpmc_queue_t *q) __leaf;
+
+/** Push up to \p n values, in order, and return the number pushed, 0 if
+ * the queue is full. */
+size_t mpmc_queue_push_n(mpmc_queue_t *q, void * const *v, size_t n)
+    __leaf;
+
+/** Pop up to \p n values, in order, and return the number popped, 0 if the
+ * queue is empty. */
+size_t mpmc_queue_pop_n(mpmc_queue_t *q, void **v, size_t n) __leaf;
+
+/** Push \p v, waiting for some room when the queue is full. */
+void mpmc_queue_push_wait(mpmc_queue_t *q, void *v);
+
+/** Pop a value, waiting for one when the queue is empty. */
+void *mpmc_queue_pop_wait(mpmc_queue_t *q);
+
+static ALWAYS_INLINE size_t mpmc_queue_capacity(const mpmc_queue_t *q)
+{
+    return q->mask + 1;
+}
+
+static ALWAYS_INLINE bool mpmc_queue_push(mpmc_queue_t *q, void *v)
+{
+    size_t pos = atomic_load_explicit(&q->push_pos, memory_order_relaxed);
+    mpmc_cell_t *cell;
+
+    for (;;) {
+        size_t seq;
+
+        cell = &q->cells[pos & q->mask];
+        seq  = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        if (seq == pos) {
+            if (atomic_compare_exchange_weak_explicit(&q->push_pos, &pos,
+                                                      pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                break;
+            }
+        } else
+        if ((ssize_t)(seq - pos) < 0) {
+            /* the cell still holds the value pushed one lap ago */
+            return false;
+        } else {
+            pos = atomic_load_explicit(&q->push_pos, memory_order_relaxed);
+        }
+    }
+
+    cell->value = v;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    if (q->blocking) {
+        thr_ec_signal(&q->not_empty);
+    }
+    return true;
+}
+
+static ALWAYS_INLINE bool mpmc_queue_pop(mpmc_queue_t *q, void **v)
+{
+    size_t pos = atomic_load_explicit(&q->pop_pos, memory_order_relaxed);
+    mpmc_cell_t *cell;
+
+    for (;;) {
+        size_t seq;
+
+        cell = &q->cells[pos & q->mask];
+        seq  = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        if (seq == pos + 1) {
+            if (atomic_compare_exchange_weak_explicit(&q->pop_pos, &pos,
+                                                      pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                break;
+            }
+        } else
+        if ((ssize_t)(seq - (pos + 1)) < 0) {
+            /* the cell has not been pushed yet */
+            return false;
+        } else {
+            pos = atomic_load_explicit(&q->pop_pos, memory_order_relaxed);
+        }
+    }
+
+    *v = cell->value;
+    atomic_store_explicit(&cell->seq, pos + q->mask + 1,
+                          memory_order_release);
+    if (q->blocking) {
+        thr_ec_signal(&q->not_full);
+    }
+    return true;
+}
+
+#endif
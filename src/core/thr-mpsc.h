@@ -109,6 +109,29 @@ static inline bool mpsc_queue_push(mpsc_queue_t *q, mpsc_node_t *n)
     return prev == &q->head;
 }
 
+/** \brief enqueue a chain of tasks in the queue.
+ *
+ * The nodes must be linked from \p first to \p last through their next
+ * field, which can be done with plain stores as the chain is still private.
+ * The whole chain is published with a single atomic exchange, so this is
+ * much cheaper than pushing the nodes one by one.
+ *
+ * \param[in]   q      the queue
+ * \param[in]   first  the first node of the chain
+ * \param[in]   last   the last node of the chain
+ * \returns true if the queue was empty before the push, false else.
+ */
+static inline bool
+mpsc_queue_push_list(mpsc_queue_t *q, mpsc_node_t *first, mpsc_node_t *last)
+{
+    mpsc_node_t *prev;
+
+    atomic_store_explicit(&last->next, NULL, memory_order_release);
+    prev = atomic_exchange_explicit(&q->tail, last, memory_order_seq_cst);
+    atomic_store_explicit(&prev->next, first, memory_order_seq_cst);
+    return prev == &q->head;
+}
+
 /** \brief type used to enumerate through a queue during a drain.
  */
 typedef struct mpsc_it_t {
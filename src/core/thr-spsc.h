@@ -123,6 +123,34 @@ static ALWAYS_INLINE void spsc_queue_push(spsc_queue_t *q, void *v)
     q->tail = n;
 }
 
+/** Push \p n values at once.
+ *
+ * The nodes are linked together before the chain is published with a single
+ * atomic store, instead of one per value.
+ */
+static inline void spsc_queue_push_n(spsc_queue_t *q, void * const *v,
+                                     size_t n)
+{
+    spsc_node_t *first;
+    spsc_node_t *last;
+
+    if (!n) {
+        return;
+    }
+    first = last = spsc_queue_alloc_node(q);
+    first->value = v[0];
+    for (size_t i = 1; i < n; i++) {
+        spsc_node_t *node = spsc_queue_alloc_node(q);
+
+        node->value = v[i];
+        atomic_init(&last->next, node);
+        last = node;
+    }
+    atomic_init(&last->next, NULL);
+    atomic_store(&q->tail->next, first);
+    q->tail = last;
+}
+
 static ALWAYS_INLINE bool spsc_queue_pop(spsc_queue_t *q, void *v, size_t v_size)
 {
     spsc_node_t *head = atomic_load_explicit(&q->head, memory_order_relaxed);
@@ -153,6 +181,30 @@ static inline void *spsc_queue_pop_ptr(spsc_queue_t *q)
     return NULL;
 }
 
+/** Pop up to \p n pointers at once, and return the number popped.
+ *
+ * The nodes are given back to the producer with a single atomic store.
+ */
+static inline size_t spsc_queue_pop_n(spsc_queue_t *q, void **v, size_t n)
+{
+    spsc_node_t *head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t count = 0;
+
+    while (count < n) {
+        spsc_node_t *next = atomic_load(&head->next);
+
+        if (!next) {
+            break;
+        }
+        v[count++] = next->value;
+        head = next;
+    }
+    if (count) {
+        atomic_store(&q->head, head);
+    }
+    return count;
+}
+
 #define spsc_t(name)    spsc__##name##_t
 
 #define spsc_queue_t(name, type_t) \
@@ -0,0 +1,414 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <sys/syscall.h>
+
+#include <lib-common/thr.h>
+#include <lib-common/trace.h>
+
+/* The records are written in the ring of the thread that ends the span. The
+ * positions only grow: the thread owns the tail, and the exporting thread
+ * owns the head. The ring of an exited thread is dead, the exporting thread
+ * frees it once it is empty.
+ */
+typedef struct trace_ring_t {
+    atomic_uint tail;
+    atomic_uint64_t dropped;
+
+    atomic_uint head __attribute__((aligned(CACHE_LINE_SIZE)));
+    atomic_bool dead;
+    dlist_t link;
+    trace_record_t recs[TRACE_RING_SIZE];
+} trace_ring_t;
+qvector_t(trace_ring, trace_ring_t *);
+
+__thread trace_ctx_t trace_ctx_g;
+uint64_t trace_sample_threshold_g;
+
+static struct {
+    atomic_bool enabled;
+    atomic_bool stopping;
+    bool running;
+    pthread_t thread;
+    trace_export_f *cb;
+    void *priv;
+
+    /* wakes up the exporting thread */
+    thr_evc_t ec;
+
+    /* protects the list of rings */
+    spinlock_t lock;
+    dlist_t rings;
+
+    atomic_uint64_t exported;
+    atomic_uint64_t dropped;
+} trace_g = {
+#define _G  trace_g
+    .rings = DLIST_INIT(_G.rings),
+};
+
+static __thread struct {
+    trace_ring_t *ring;
+    uint64_t rand;
+    int32_t tid;
+} trace_thr_g;
+
+/* {{{ Spans */
+
+/* xorshift64*, seeded once per thread */
+static uint64_t trace_rand(void)
+{
+    uint64_t x = trace_thr_g.rand;
+
+    if (unlikely(!x)) {
+        x = rand64() | 1;
+    }
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    trace_thr_g.rand = x;
+    return x * 0x2545f4914f6cdd1dULL;
+}
+
+static uint64_t trace_new_id(void)
+{
+    uint64_t id;
+
+    do {
+        id = trace_rand();
+    } while (unlikely(!id));
+    return id;
+}
+
+static int64_t trace_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+bool __trace_span_start(trace_span_t *span, const char *name,
+                        const trace_ctx_t *parent)
+{
+    if (!trace_ctx_is_sampled(parent)) {
+        parent = &trace_ctx_g;
+    }
+    if (trace_ctx_is_sampled(parent)) {
+        span->ctx.trace_hi = parent->trace_hi;
+        span->ctx.trace_lo = parent->trace_lo;
+        span->parent_id    = parent->span_id;
+    } else {
+        if (trace_rand() >= trace_sample_threshold_g) {
+            span->ctx = (trace_ctx_t){ .span_id = 0 };
+            return false;
+        }
+        span->ctx.trace_hi = trace_new_id();
+        span->ctx.trace_lo = trace_new_id();
+        span->parent_id    = 0;
+    }
+    span->ctx.span_id = trace_new_id();
+    span->name  = name;
+    span->start = trace_now();
+    return true;
+}
+
+static trace_ring_t *trace_ring_get(void)
+{
+    trace_ring_t *ring = trace_thr_g.ring;
+
+    if (likely(ring)) {
+        return ring;
+    }
+
+    ring = p_new_raw(trace_ring_t, 1);
+    p_clear(ring, 1);
+    trace_thr_g.tid = syscall(SYS_gettid);
+    spin_lock(&_G.lock);
+    dlist_add_tail(&_G.rings, &ring->link);
+    spin_unlock(&_G.lock);
+
+    return trace_thr_g.ring = ring;
+}
+
+void __trace_span_end(trace_span_t *span, int status)
+{
+    trace_ring_t *ring;
+    trace_record_t *rec;
+    unsigned head, tail;
+
+    if (!atomic_load_explicit(&_G.enabled, memory_order_relaxed)) {
+        return;
+    }
+
+    ring = trace_ring_get();
+    head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (unlikely(tail - head >= TRACE_RING_SIZE)) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    rec = &ring->recs[tail % TRACE_RING_SIZE];
+    *rec = (trace_record_t){
+        .ctx       = span->ctx,
+        .parent_id = span->parent_id,
+        .name      = span->name,
+        .start     = span->start,
+        .duration  = trace_now() - span->start,
+        .status    = status,
+        .tid       = trace_thr_g.tid,
+    };
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    /* Do not wait for the next poll of the exporting thread to empty a
+     * ring that fills up. */
+    if (tail + 1 - head == TRACE_RING_SIZE / 2) {
+        thr_ec_signal_relaxed(&_G.ec);
+    }
+}
+
+void trace_set_sample_rate(double rate)
+{
+    if (rate <= 0) {
+        trace_sample_threshold_g = 0;
+    } else
+    if (rate >= 1) {
+        trace_sample_threshold_g = UINT64_MAX;
+    } else {
+        trace_sample_threshold_g = rate * 0x1p64;
+    }
+}
+
+static void trace_thr_exit(void)
+{
+    trace_ring_t *ring = trace_thr_g.ring;
+
+    if (!ring) {
+        return;
+    }
+    trace_thr_g.ring = NULL;
+
+    spin_lock(&_G.lock);
+    if (_G.running) {
+        /* The exporting thread exports the last records and frees it. */
+        atomic_store(&ring->dead, true);
+    } else {
+        atomic_fetch_add(&_G.dropped, atomic_load(&ring->dropped));
+        dlist_remove(&ring->link);
+        p_delete(&ring);
+    }
+    spin_unlock(&_G.lock);
+}
+thr_hooks(NULL, trace_thr_exit);
+
+/* }}} */
+/* {{{ Export */
+
+static void trace_ring_delete(trace_ring_t **ring)
+{
+    if (*ring) {
+        atomic_fetch_add(&_G.dropped, (*ring)->dropped);
+        dlist_remove(&(*ring)->link);
+        p_delete(ring);
+    }
+}
+
+static bool trace_ring_is_empty(trace_ring_t *ring)
+{
+    return atomic_load(&ring->head) == atomic_load(&ring->tail);
+}
+
+/* Copy the records of a ring into the batch, and export the full batches. */
+static void trace_ring_drain(trace_ring_t *ring, trace_record_t *batch,
+                             int *len)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    while (head != tail) {
+        int n = MIN(tail - head, (unsigned)(TRACE_EXPORT_BATCH - *len));
+
+        for (int i = 0; i < n; i++) {
+            batch[(*len)++] = ring->recs[(head + i) % TRACE_RING_SIZE];
+        }
+        head += n;
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+
+        if (*len == TRACE_EXPORT_BATCH) {
+            (*_G.cb)(batch, *len, _G.priv);
+            atomic_fetch_add(&_G.exported, *len);
+            *len = 0;
+        }
+    }
+}
+
+/* Export the records of all the rings. Only this thread frees the rings
+ * while it runs, so that they are read without the lock. */
+static void trace_drain(qv_t(trace_ring) *rings, trace_record_t *batch)
+{
+    int len = 0;
+
+    qv_clear(rings);
+    spin_lock(&_G.lock);
+    dlist_for_each_entry(trace_ring_t, ring, &_G.rings, link) {
+        /* A dead ring has no producer anymore. */
+        if (atomic_load(&ring->dead) && trace_ring_is_empty(ring)) {
+            trace_ring_delete(&ring);
+        } else {
+            qv_append(rings, ring);
+        }
+    }
+    spin_unlock(&_G.lock);
+
+    tab_for_each_entry(ring, rings) {
+        trace_ring_drain(ring, batch, &len);
+    }
+    if (len) {
+        (*_G.cb)(batch, len, _G.priv);
+        atomic_fetch_add(&_G.exported, len);
+    }
+}
+
+static void *trace_export_main(void *arg)
+{
+    trace_record_t *batch = p_new_raw(trace_record_t, TRACE_EXPORT_BATCH);
+    qv_t(trace_ring) rings;
+
+    qv_init(&rings);
+    for (;;) {
+        uint64_t key = thr_ec_get(&_G.ec);
+        bool stopping = atomic_load(&_G.stopping);
+
+        trace_drain(&rings, batch);
+        if (stopping) {
+            break;
+        }
+        thr_ec_timedwait(&_G.ec, key, TRACE_EXPORT_PERIOD);
+    }
+
+    qv_wipe(&rings);
+    p_delete(&batch);
+    return NULL;
+}
+
+int trace_set_exporter(trace_export_f *cb, void *priv)
+{
+    if (_G.running) {
+        atomic_store(&_G.enabled, false);
+        atomic_store(&_G.stopping, true);
+        thr_ec_signal(&_G.ec);
+        pthread_join(_G.thread, NULL);
+        thr_ec_wipe(&_G.ec);
+
+        spin_lock(&_G.lock);
+        _G.running = false;
+        dlist_for_each_entry(trace_ring_t, ring, &_G.rings, link) {
+            if (atomic_load(&ring->dead)) {
+                trace_ring_delete(&ring);
+            }
+        }
+        spin_unlock(&_G.lock);
+    }
+    if (!cb) {
+        return 0;
+    }
+
+    _G.cb   = cb;
+    _G.priv = priv;
+    atomic_store(&_G.stopping, false);
+    thr_ec_init(&_G.ec);
+    if (thr_create(&_G.thread, NULL, &trace_export_main, NULL)) {
+        thr_ec_wipe(&_G.ec);
+        return -1;
+    }
+    _G.running = true;
+    atomic_store(&_G.enabled, true);
+    return 0;
+}
+
+void trace_get_stats(trace_stats_t *stats)
+{
+    p_clear(stats, 1);
+
+    spin_lock(&_G.lock);
+    stats->exported = atomic_load(&_G.exported);
+    stats->dropped  = atomic_load(&_G.dropped);
+    dlist_for_each_entry(trace_ring_t, ring, &_G.rings, link) {
+        stats->dropped += atomic_load_explicit(&ring->dropped,
+                                               memory_order_relaxed);
+    }
+    spin_unlock(&_G.lock);
+}
+
+/* }}} */
+/* {{{ W3C trace context */
+
+static int trace_parse_hex64(const char *s, uint64_t *out)
+{
+    uint64_t v = 0;
+
+    for (int i = 0; i < 16; i++) {
+        int h = hexdigit(s[i]);
+
+        if (h < 0) {
+            return -1;
+        }
+        v = (v << 4) | h;
+    }
+    *out = v;
+    return 0;
+}
+
+/* version "-" trace-id "-" parent-id "-" trace-flags, where the future
+ * versions can append fields */
+int trace_ctx_parse_traceparent(lstr_t s, trace_ctx_t *ctx)
+{
+    int version = s.len >= 2 ? hexdecode(s.s) : -1;
+    int flags;
+
+    p_clear(ctx, 1);
+    if (version < 0 || version == 0xff || s.len < 55
+    ||  (version == 0 && s.len != 55)
+    ||  (s.len > 55 && s.s[55] != '-')
+    ||  s.s[2] != '-' || s.s[35] != '-' || s.s[52] != '-')
+    {
+        return -1;
+    }
+    if (trace_parse_hex64(s.s + 3, &ctx->trace_hi) < 0
+    ||  trace_parse_hex64(s.s + 19, &ctx->trace_lo) < 0
+    ||  trace_parse_hex64(s.s + 36, &ctx->span_id) < 0
+    ||  (flags = hexdecode(s.s + 53)) < 0
+    ||  !(ctx->trace_hi | ctx->trace_lo) || !ctx->span_id)
+    {
+        p_clear(ctx, 1);
+        return -1;
+    }
+    if (!(flags & 1)) {
+        p_clear(ctx, 1);
+    }
+    return 0;
+}
+
+void sb_add_traceparent(sb_t *sb, const trace_ctx_t *ctx)
+{
+    sb_addf(sb, "00-%016jx%016jx-%016jx-01", ctx->trace_hi, ctx->trace_lo,
+            ctx->span_id);
+}
+
+/* }}} */
@@ -20,6 +20,7 @@
 #ifdef __linux__
 
 #include <linux/limits.h>
+#include <linux/perf_event.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/wait.h>
@@ -450,6 +451,115 @@ void close_fds(int fd_min, qv_t(u32) * nullable to_keep)
     closedir(proc_fds);
 }
 
+/* }}} */
+/* {{{ perf_counters */
+
+const char * const perf_counter_names_g[PERF_COUNTER__MAX] = {
+    [PERF_COUNTER_CYCLES]        = "cycles",
+    [PERF_COUNTER_INSTRUCTIONS]  = "instructions",
+    [PERF_COUNTER_CACHE_MISSES]  = "cache-misses",
+    [PERF_COUNTER_BRANCH_MISSES] = "branch-misses",
+};
+
+static uint64_t const perf_counter_configs_g[PERF_COUNTER__MAX] = {
+    [PERF_COUNTER_CYCLES]        = PERF_COUNT_HW_CPU_CYCLES,
+    [PERF_COUNTER_INSTRUCTIONS]  = PERF_COUNT_HW_INSTRUCTIONS,
+    [PERF_COUNTER_CACHE_MISSES]  = PERF_COUNT_HW_CACHE_MISSES,
+    [PERF_COUNTER_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+int perf_counters_open(perf_counters_t *pc)
+{
+    p_clear(pc, 1);
+    for (int i = 0; i < PERF_COUNTER__MAX; i++) {
+        pc->fds[i] = -1;
+    }
+    for (int i = 0; i < PERF_COUNTER__MAX; i++) {
+        struct perf_event_attr attr = {
+            .type           = PERF_TYPE_HARDWARE,
+            .size           = sizeof(attr),
+            .config         = perf_counter_configs_g[i],
+            .read_format    = PERF_FORMAT_GROUP
+                            | PERF_FORMAT_TOTAL_TIME_ENABLED
+                            | PERF_FORMAT_TOTAL_TIME_RUNNING,
+            .exclude_kernel = true,
+            .exclude_hv     = true,
+        };
+
+        pc->fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1,
+                             i ? pc->fds[0] : -1, PERF_FLAG_FD_CLOEXEC);
+        if (pc->fds[0] < 0) {
+            int save_errno = errno;
+
+            perf_counters_close(pc);
+            errno = save_errno;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void perf_counters_close(perf_counters_t *pc)
+{
+    for (int i = PERF_COUNTER__MAX; i-- > 0; ) {
+        if (pc->fds[i] >= 0) {
+            close(pc->fds[i]);
+        }
+        pc->fds[i] = -1;
+    }
+}
+
+int perf_counters_read(const perf_counters_t *pc,
+                       uint64_t counts[PERF_COUNTER__MAX])
+{
+    /* nr, time enabled, time running, then the counts of the group */
+    uint64_t buf[3 + PERF_COUNTER__MAX];
+    unsigned pos = 0;
+    ssize_t len;
+
+    memset(counts, 0, sizeof(uint64_t) * PERF_COUNTER__MAX);
+    if (pc->fds[0] < 0) {
+        errno = EBADF;
+        return -1;
+    }
+    len = read(pc->fds[0], buf, sizeof(buf));
+    if (len < (ssize_t)(3 * sizeof(uint64_t))) {
+        return -1;
+    }
+    for (int i = 0; i < PERF_COUNTER__MAX; i++) {
+        uint64_t count;
+
+        if (pc->fds[i] < 0 || pos >= buf[0]) {
+            continue;
+        }
+        count = buf[3 + pos++];
+        if (buf[2] && buf[2] < buf[1]) {
+            /* the counters were multiplexed, extrapolate */
+            count = (double)count * buf[1] / buf[2];
+        }
+        counts[i] = count;
+    }
+    return 0;
+}
+
+perf_counters_t *perf_counters_start(perf_counters_t *pc)
+{
+    perf_counters_read(pc, pc->start);
+    return pc;
+}
+
+void perf_counters_stop(perf_counters_t *pc)
+{
+    uint64_t now[PERF_COUNTER__MAX];
+
+    if (perf_counters_read(pc, now) < 0) {
+        return;
+    }
+    for (int i = 0; i < PERF_COUNTER__MAX; i++) {
+        pc->counts[i] += now[i] - pc->start[i];
+    }
+}
+
 /* }}} */
 /* {{{ eventfd */
 
@@ -0,0 +1,472 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <elf.h>
+#include <link.h>
+
+#include <lib-common/container-qhash.h>
+#include <lib-common/hash.h>
+#include <lib-common/log.h>
+#include <lib-common/unix.h>
+#include <lib-common/warm-cache.h>
+
+/* The file starts with a header, followed by the entries. An entry is a
+ * warm_cache_entry_t followed by its name, and by its data at the next
+ * WARM_CACHE_ALIGN boundary; the next entry starts at the boundary after
+ * the data.
+ */
+
+#define WARM_CACHE_MAGIC  "LCWARM01"
+#define WARM_CACHE_ALIGN  64
+
+typedef struct warm_cache_hdr_t {
+    char     magic[8];
+    uint64_t size;
+    uint32_t nb_entries;
+    uint32_t build_id_len;
+    uint8_t  build_id[40];
+} warm_cache_hdr_t;
+STATIC_ASSERT(sizeof(warm_cache_hdr_t) == WARM_CACHE_ALIGN);
+
+typedef struct warm_cache_entry_t {
+    uint64_t inputs;
+    uint64_t len;
+    uint32_t version;
+    uint32_t name_len;
+    char     name[];
+} warm_cache_entry_t;
+
+qm_kvec_t(warm_cache_entry, lstr_t, const warm_cache_entry_t *,
+          qhash_lstr_hash, qhash_lstr_equal);
+
+static struct {
+    logger_t logger;
+
+    uint8_t  build_id[40];
+    uint32_t build_id_len;
+
+    char  *path;
+    lstr_t map;
+
+    /* entries of the current file that are still valid */
+    qm_t(warm_cache_entry) entries;
+
+    /* the new file, -1 until an entry is put */
+    int         fd;
+    uint32_t    nb_put;
+    qh_t(lstr)  put;
+
+    warm_cache_stats_t stats;
+} warm_cache_g = {
+#define _G  warm_cache_g
+    .logger = LOGGER_INIT_INHERITS(NULL, "warm-cache"),
+    .fd = -1,
+};
+
+/* {{{ Build id */
+
+static int warm_cache_find_build_id(struct dl_phdr_info *info, size_t size,
+                                    void *priv)
+{
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+        const uint8_t *p = (const uint8_t *)(info->dlpi_addr + ph->p_vaddr);
+        const uint8_t *end = p + ph->p_memsz;
+
+        if (ph->p_type != PT_NOTE) {
+            continue;
+        }
+        while (p + sizeof(ElfW(Nhdr)) <= end) {
+            const ElfW(Nhdr) *nh = (const ElfW(Nhdr) *)p;
+            const uint8_t *desc = p + sizeof(*nh) + ROUND_UP(nh->n_namesz, 4);
+
+            if (nh->n_type == NT_GNU_BUILD_ID && nh->n_namesz == 4
+            &&  memcmp(p + sizeof(*nh), "GNU", 4) == 0)
+            {
+                _G.build_id_len = MIN(nh->n_descsz, sizeof(_G.build_id));
+                memcpy(_G.build_id, desc, _G.build_id_len);
+                return 1;
+            }
+            p = desc + ROUND_UP(nh->n_descsz, 4);
+        }
+    }
+    /* the first object is the program, the libraries are not looked at */
+    return 1;
+}
+
+static void warm_cache_load_build_id(void)
+{
+    struct stat st;
+    uint64_t id[4];
+
+    if (_G.build_id_len) {
+        return;
+    }
+    dl_iterate_phdr(&warm_cache_find_build_id, NULL);
+    if (_G.build_id_len) {
+        return;
+    }
+
+    /* linked without build id, identify the binary by its file */
+    p_clear(&st, 1);
+    if (stat("/proc/self/exe", &st) < 0) {
+        logger_warning(&_G.logger, "cannot stat the program: %m");
+    }
+    id[0] = st.st_dev;
+    id[1] = st.st_ino;
+    id[2] = st.st_size;
+    id[3] = st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+    memcpy(_G.build_id, id, sizeof(id));
+    _G.build_id_len = sizeof(id);
+}
+
+/* }}} */
+/* {{{ Loading */
+
+static size_t warm_cache_entry_size(const warm_cache_entry_t *entry)
+{
+    return ROUND_UP(sizeof(*entry) + entry->name_len, WARM_CACHE_ALIGN)
+         + ROUND_UP(entry->len, WARM_CACHE_ALIGN);
+}
+
+static lstr_t warm_cache_entry_data(const warm_cache_entry_t *entry)
+{
+    const char *data = (const char *)entry
+                     + ROUND_UP(sizeof(*entry) + entry->name_len,
+                                WARM_CACHE_ALIGN);
+
+    return LSTR_DATA_V(data, entry->len);
+}
+
+static int warm_cache_load(void)
+{
+    const warm_cache_hdr_t *hdr = (const warm_cache_hdr_t *)_G.map.s;
+    size_t pos = sizeof(*hdr);
+
+    if (_G.map.len < ssizeof(*hdr)
+    ||  memcmp(hdr->magic, WARM_CACHE_MAGIC, sizeof(hdr->magic)) != 0
+    ||  hdr->size != (uint64_t)_G.map.len)
+    {
+        logger_warning(&_G.logger, "ignoring `%s`: invalid file", _G.path);
+        return -1;
+    }
+    if (hdr->build_id_len != _G.build_id_len
+    ||  memcmp(hdr->build_id, _G.build_id, _G.build_id_len) != 0)
+    {
+        logger_info(&_G.logger, "ignoring `%s`: written by another build",
+                    _G.path);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < hdr->nb_entries; i++) {
+        const warm_cache_entry_t *entry;
+        lstr_t name;
+
+        entry = (const warm_cache_entry_t *)(_G.map.s + pos);
+        if (pos + sizeof(*entry) > (size_t)_G.map.len
+        ||  entry->name_len > (size_t)_G.map.len
+        ||  entry->len > (size_t)_G.map.len
+        ||  pos + warm_cache_entry_size(entry) > (size_t)_G.map.len)
+        {
+            logger_warning(&_G.logger, "ignoring `%s`: truncated entry",
+                           _G.path);
+            qm_clear(warm_cache_entry, &_G.entries);
+            return -1;
+        }
+        name = LSTR_INIT_V(entry->name, entry->name_len);
+        qm_replace(warm_cache_entry, &_G.entries, &name, entry);
+        pos += warm_cache_entry_size(entry);
+    }
+
+    logger_info(&_G.logger, "loaded %d entries from `%s`",
+                qm_len(warm_cache_entry, &_G.entries), _G.path);
+    return 0;
+}
+
+int warm_cache_open(const char *path)
+{
+    if (_G.path) {
+        logger_error(&_G.logger, "`%s` is already opened", _G.path);
+        return -1;
+    }
+
+    warm_cache_load_build_id();
+    _G.path = p_strdup(path);
+    qm_init(warm_cache_entry, &_G.entries);
+    qh_init(lstr, &_G.put);
+
+    if (lstr_init_from_file(&_G.map, path, PROT_READ, MAP_SHARED) < 0) {
+        if (errno != ENOENT) {
+            logger_warning(&_G.logger, "cannot open `%s`: %m", path);
+        }
+        _G.map = LSTR_NULL_V;
+        return 0;
+    }
+    if (warm_cache_load() < 0) {
+        lstr_wipe(&_G.map);
+    }
+    return 0;
+}
+
+lstr_t warm_cache_get(const char *name, uint32_t version, uint64_t inputs)
+{
+    lstr_t key = LSTR(name);
+    const warm_cache_entry_t *entry;
+    int pos;
+
+    if (!_G.path) {
+        return LSTR_NULL_V;
+    }
+    pos = qm_find(warm_cache_entry, &_G.entries, &key);
+    if (pos < 0) {
+        _G.stats.misses++;
+        return LSTR_NULL_V;
+    }
+    entry = _G.entries.values[pos];
+    if (entry->version != version || entry->inputs != inputs) {
+        /* stale, it must not be kept in the next file */
+        qm_del_at(warm_cache_entry, &_G.entries, pos);
+        _G.stats.misses++;
+        return LSTR_NULL_V;
+    }
+    _G.stats.hits++;
+    return warm_cache_entry_data(entry);
+}
+
+/* }}} */
+/* {{{ Saving */
+
+static char *t_warm_cache_tmp_path(void)
+{
+    return t_fmt("%s.tmp", _G.path);
+}
+
+/* Pad the file up to the next WARM_CACHE_ALIGN boundary. */
+static int warm_cache_pad(off_t *pos)
+{
+    static uint8_t const zeros[WARM_CACHE_ALIGN];
+    size_t pad = ROUND_UP(*pos, WARM_CACHE_ALIGN) - *pos;
+
+    if (pad && xwrite(_G.fd, zeros, pad) < 0) {
+        return -1;
+    }
+    *pos += pad;
+    return 0;
+}
+
+static int warm_cache_create(void)
+{
+    t_scope;
+    warm_cache_hdr_t hdr;
+
+    _G.fd = open(t_warm_cache_tmp_path(),
+                 O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (_G.fd < 0) {
+        logger_warning(&_G.logger, "cannot create `%s`: %m",
+                       t_warm_cache_tmp_path());
+        return -1;
+    }
+
+    /* the header is written for real when saving */
+    p_clear(&hdr, 1);
+    if (xwrite(_G.fd, &hdr, sizeof(hdr)) < 0) {
+        logger_warning(&_G.logger, "cannot write `%s`: %m",
+                       t_warm_cache_tmp_path());
+        p_close(&_G.fd);
+        return -1;
+    }
+    return 0;
+}
+
+static int warm_cache_write_entry(const char *name, uint32_t version,
+                                  uint64_t inputs, warm_cache_write_f *cb,
+                                  void *priv, off_t start)
+{
+    warm_cache_entry_t entry = {
+        .inputs   = inputs,
+        .version  = version,
+        .name_len = strlen(name),
+    };
+    off_t pos;
+
+    if (xwrite(_G.fd, &entry, sizeof(entry)) < 0
+    ||  xwrite(_G.fd, name, entry.name_len) < 0)
+    {
+        return -1;
+    }
+    pos = start + sizeof(entry) + entry.name_len;
+    RETHROW(warm_cache_pad(&pos));
+
+    RETHROW((*cb)(_G.fd, priv));
+    entry.len = RETHROW(lseek(_G.fd, 0, SEEK_CUR)) - pos;
+    pos += entry.len;
+    RETHROW(warm_cache_pad(&pos));
+
+    return xpwrite(_G.fd, &entry, sizeof(entry), start) < 0 ? -1 : 0;
+}
+
+int warm_cache_put_cb(const char *name, uint32_t version, uint64_t inputs,
+                      warm_cache_write_f *cb, void *priv)
+{
+    t_scope;
+    lstr_t key = LSTR(name);
+    off_t start;
+
+    if (!_G.path) {
+        return -1;
+    }
+    if (qh_find(lstr, &_G.put, &key) >= 0) {
+        logger_error(&_G.logger, "entry `%s` put twice", name);
+        return -1;
+    }
+    if (_G.fd < 0) {
+        RETHROW(warm_cache_create());
+    }
+
+    start = lseek(_G.fd, 0, SEEK_CUR);
+    if (start < 0
+    ||  warm_cache_write_entry(name, version, inputs, cb, priv, start) < 0)
+    {
+        logger_warning(&_G.logger, "cannot write entry `%s`: %m", name);
+        if (start >= 0 && ftruncate(_G.fd, start) == 0
+        &&  lseek(_G.fd, start, SEEK_SET) == start)
+        {
+            return -1;
+        }
+        /* the file is unusable, the entries put so far are lost */
+        p_close(&_G.fd);
+        unlink(t_warm_cache_tmp_path());
+        qh_deep_clear(lstr, &_G.put, lstr_wipe);
+        _G.nb_put = 0;
+        return -1;
+    }
+
+    key = lstr_dup(key);
+    qh_add(lstr, &_G.put, &key);
+    _G.nb_put++;
+    _G.stats.puts++;
+    return 0;
+}
+
+static int warm_cache_write_buf(int fd, void *priv)
+{
+    const lstr_t *data = priv;
+
+    return xwrite(fd, data->s, data->len) < 0 ? -1 : 0;
+}
+
+int warm_cache_put(const char *name, uint32_t version, uint64_t inputs,
+                   lstr_t data)
+{
+    return warm_cache_put_cb(name, version, inputs, &warm_cache_write_buf,
+                             &data);
+}
+
+/* Copy the valid entries of the current file that were not put again. */
+static int warm_cache_copy_entries(uint32_t *nb_entries)
+{
+    qm_for_each_key_value(warm_cache_entry, name, entry, &_G.entries) {
+        if (qh_find(lstr, &_G.put, &name) >= 0) {
+            continue;
+        }
+        if (xwrite(_G.fd, entry, warm_cache_entry_size(entry)) < 0) {
+            return -1;
+        }
+        (*nb_entries)++;
+    }
+    return 0;
+}
+
+int warm_cache_save(void)
+{
+    t_scope;
+    warm_cache_hdr_t hdr = {
+        .nb_entries   = _G.nb_put,
+        .build_id_len = _G.build_id_len,
+    };
+    off_t size = -1;
+
+    if (_G.fd < 0) {
+        return 0;
+    }
+
+    memcpy(hdr.magic, WARM_CACHE_MAGIC, sizeof(hdr.magic));
+    memcpy(hdr.build_id, _G.build_id, _G.build_id_len);
+    if (warm_cache_copy_entries(&hdr.nb_entries) == 0) {
+        size = lseek(_G.fd, 0, SEEK_CUR);
+    }
+    hdr.size = size;
+    if (size < 0
+    ||  xpwrite(_G.fd, &hdr, sizeof(hdr), 0) < 0
+    ||  fdatasync(_G.fd) < 0
+    ||  p_close(&_G.fd) < 0
+    ||  rename(t_warm_cache_tmp_path(), _G.path) < 0)
+    {
+        logger_warning(&_G.logger, "cannot save `%s`: %m", _G.path);
+        p_close(&_G.fd);
+        unlink(t_warm_cache_tmp_path());
+        return -1;
+    }
+    logger_info(&_G.logger, "saved %u entries in `%s`", hdr.nb_entries,
+                _G.path);
+
+    qh_deep_clear(lstr, &_G.put, lstr_wipe);
+    _G.nb_put = 0;
+    return 0;
+}
+
+void warm_cache_close(void)
+{
+    if (!_G.path) {
+        return;
+    }
+    if (_G.fd >= 0) {
+        t_scope;
+
+        p_close(&_G.fd);
+        unlink(t_warm_cache_tmp_path());
+    }
+    qh_deep_wipe(lstr, &_G.put, lstr_wipe);
+    qm_wipe(warm_cache_entry, &_G.entries);
+    lstr_wipe(&_G.map);
+    p_delete(&_G.path);
+    _G.nb_put = 0;
+}
+
+/* }}} */
+/* {{{ Inputs and statistics */
+
+uint64_t warm_cache_hash_file(uint64_t inputs, const char *path)
+{
+    lstr_t content;
+    uint64_t res;
+
+    if (lstr_init_from_file(&content, path, PROT_READ, MAP_SHARED) < 0) {
+        return wyhash64(path, strlen(path), ~inputs);
+    }
+    res = wyhash64(content.s ?: "", content.len, inputs);
+    lstr_wipe(&content);
+    return res;
+}
+
+void warm_cache_get_stats(warm_cache_stats_t *stats)
+{
+    *stats = _G.stats;
+}
+
+/* }}} */
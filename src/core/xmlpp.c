@@ -18,6 +18,43 @@
 
 #include <lib-common/xmlpp.h>
 
+#define XMLPP_FLUSH_SIZE  (8 << 10)
+
+static void xmlpp_write(xmlpp_t *pp, int len)
+{
+    if (pp->write_res >= 0 && len) {
+        int res = (*pp->writecb)(pp->priv, pp->buf->data, len);
+
+        if (res < 0) {
+            pp->write_res = res;
+        }
+    }
+    sb_skip(pp->buf, len);
+}
+
+/* The last byte is kept in the buffer because it may be the '>' of the
+ * current tag, that is rewritten when adding an attribute. */
+static void xmlpp_maybe_flush(xmlpp_t *pp)
+{
+    if (pp->writecb && pp->buf->len >= XMLPP_FLUSH_SIZE) {
+        xmlpp_write(pp, pp->buf->len - 1);
+    }
+}
+
+void xmlpp_flush(xmlpp_t *pp)
+{
+    if (pp->writecb) {
+        xmlpp_write(pp, pp->buf->len);
+        pp->can_do_attr = false;
+    }
+}
+
+void xmlpp_set_writecb(xmlpp_t *pp, xmlpp_writecb_f *writecb, void *priv)
+{
+    pp->writecb = writecb;
+    pp->priv    = priv;
+}
+
 void xmlpp_open(xmlpp_t *pp, sb_t *buf)
 {
     p_clear(pp, 1);
@@ -31,15 +68,19 @@ void xmlpp_open_banner(xmlpp_t *pp, sb_t *buf)
     sb_adds(buf, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
 }
 
-void xmlpp_close(xmlpp_t *pp)
+int xmlpp_close(xmlpp_t *pp)
 {
     while (pp->stack.len) {
         xmlpp_closetag(pp);
     }
-    if (!pp->nospace && pp->buf->data[pp->buf->len - 1] != '\n') {
+    if (!pp->nospace && pp->buf->len
+    &&  pp->buf->data[pp->buf->len - 1] != '\n')
+    {
         sb_addc(pp->buf, '\n');
     }
+    xmlpp_flush(pp);
     qv_deep_wipe(&pp->stack, lstr_wipe);
+    return pp->write_res;
 }
 
 void xmlpp_opentag(xmlpp_t *pp, const char *tag_)
@@ -80,6 +121,7 @@ void xmlpp_closetag(xmlpp_t *pp)
     pp->can_do_attr = false;
     pp->was_a_tag   = true;
     lstr_wipe(&tag);
+    xmlpp_maybe_flush(pp);
 }
 
 void xmlpp_nl(xmlpp_t *pp)
@@ -141,6 +183,7 @@ void xmlpp_put_cdata(xmlpp_t *pp, const char *s, size_t len)
     }
     sb_add(pp->buf, s, len);
     sb_adds(pp->buf, "]]>");
+    xmlpp_maybe_flush(pp);
 }
 
 void xmlpp_put(xmlpp_t *pp, const void *data, int len)
@@ -148,6 +191,7 @@ void xmlpp_put(xmlpp_t *pp, const void *data, int len)
     pp->can_do_attr = false;
     pp->was_a_tag   = false;
     sb_add_xmlescape(pp->buf, data, len);
+    xmlpp_maybe_flush(pp);
 }
 
 void xmlpp_putf(xmlpp_t *pp, const char *fmt, ...)
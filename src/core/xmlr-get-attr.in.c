@@ -17,26 +17,16 @@
 /***************************************************************************/
 
 __flatten
-int F(xmlr_getattr)(xml_reader_t xr, xmlAttrPtr attr, ARGS_P)
+int F(xmlr_getattr)(xml_reader_t xr, const xmlr_attr_t *attr, ARGS_P)
 {
-    const char *name = (const char *)attr->name;
-    xmlNodePtr  n    = attr->children;
+    const char *s = NULL;
 
     assert (xmlr_on_element(xr, false));
 
-    if (n == NULL)
-        return F(xmlr_attr)(xr, name, NULL, ARGS);
-    if (n->next == NULL
-    &&  (n->type == XML_TEXT_NODE || n->type == XML_CDATA_SECTION_NODE))
-    {
-        return F(xmlr_attr)(xr, name, (const char *)n->content, ARGS);
-    } else {
-        char *s = (char *)xmlNodeListGetString(attr->doc, n, 1);
-        int res = F(xmlr_attr)(xr, name, s, ARGS);
-
-        xmlFree(s);
-        return res;
+    if (attr->value.len) {
+        RETHROW(xmlr_attr_decode(xr, attr, &s));
     }
+    return F(xmlr_attr)(xr, attr->name, s, ARGS);
 }
 
 #undef F
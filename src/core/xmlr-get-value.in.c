@@ -25,23 +25,24 @@ int F(xmlr_get)(PRE_ARGS_P xml_reader_t xr, ARGS_P)
 {
     assert (xmlr_on_element(xr, false));
 
-    if (xmlTextReaderIsEmptyElement(xr) == 1) {
+    if (xr->is_empty) {
         RETHROW(F(xmlr_val)(xr, NULL, ARGS));
         return xmlr_next_node(xr);
     }
 
-    if (RETHROW(xmlTextReaderRead(xr)) != 1)
+    if (RETHROW(xmlr_read(xr)) != 1)
         return xmlr_fail(xr, "expecting text or closing element");
     RETHROW(xmlr_scan_node(xr, true));
-    if (xmlTextReaderNodeType(xr) == XTYPE(TEXT)) {
-        const char *s = (const char *)xmlTextReaderConstValue(xr);
+    if (xr->type == XMLR_NODE_TEXT) {
+        lstr_t s;
 
-        RETHROW(F(xmlr_val)(xr, s, ARGS));
+        RETHROW(xmlr_get_text(xr, &s));
+        RETHROW(F(xmlr_val)(xr, s.s, ARGS));
         RETHROW(xmlr_scan_node(xr, false));
     } else {
         RETHROW(F(xmlr_val)(xr, NULL, ARGS));
     }
-    if (xmlTextReaderNodeType(xr) != XTYPE(END_ELEMENT))
+    if (xr->type != XMLR_NODE_END_ELEMENT)
         return xmlr_fail(xr, "expecting closing tag");
 
     return xmlr_next_node(xr);
@@ -16,6 +16,12 @@
 /*                                                                         */
 /***************************************************************************/
 
+#ifdef __SSE2__
+#   pragma push_macro("__leaf")
+#   undef __leaf
+#   include <emmintrin.h>
+#   pragma pop_macro("__leaf")
+#endif
 #include <lib-common/xmlr.h>
 #include <lib-common/thr.h>
 
@@ -26,7 +32,7 @@
 #endif
 
 /*
- * This libxml wrapper supposes the following:
+ * This XML reader supposes the following:
  *
  * - all is utf8
  * - there is no meaningful interleaved text and nodes like in html:
@@ -41,39 +47,15 @@
 
 __thread xml_reader_t xmlr_g;
 
-#define XMLR_OPTS \
-    (XML_PARSE_NOERROR | XML_PARSE_NOWARNING | \
-     XML_PARSE_NONET | XML_PARSE_NOCDATA | XML_PARSE_NOBLANKS)
-
-#define XTYPE(type)  XML_READER_TYPE_##type
-
 /* Error formatting {{{ */
 
 static __thread sb_t xmlr_err_g;
 
-static __attribute__((format(printf, 2, 3)))
-void xmlr_debug_error(void *ctx, const char *fmt, ...)
-{
-    va_list ap;
-
-    va_start(ap, fmt);
-    sb_addvf(ctx, fmt, ap);
-    va_end(ap);
-
-#ifndef NDEBUG
-    va_start(ap, fmt);
-    vfprintf(stderr, fmt, ap);
-    va_end(ap);
-#endif
-}
-
 static void xmlr_initialize(void)
 {
     if (unlikely(xmlr_err_g.size == 0))
         sb_init(&xmlr_err_g);
     sb_reset(&xmlr_err_g);
-    xmlGenericError = (xmlGenericErrorFunc)xmlr_debug_error;
-    xmlGenericErrorContext = &xmlr_err_g;
 }
 
 static void xmlr_shutdown(void)
@@ -96,36 +78,49 @@ const char *xmlr_get_err(void)
     return NULL;
 }
 
+/* The line numbers are only needed in the errors, they are computed from
+ * the beginning of the document. */
+static int xmlr_get_line(xml_reader_t xr)
+{
+    const char *p = xr->start;
+    const char *end = xr->node_start;
+    int line = 1;
 
-static void xmlr_fmt_loc(xml_reader_t xr, sb_t *sb)
+    if (!p || !end) {
+        return 0;
+    }
+    while ((p = memchr(p, '\n', end - p))) {
+        line++;
+        p++;
+    }
+    return line;
+}
+
+static lstr_t xmlr_split_name(lstr_t name, lstr_t *prefix)
 {
-    xmlNodePtr n[32];
-    int nlen = 0;
+    const char *colon = memchr(name.s, ':', name.len);
 
-    n[0] = xmlTextReaderCurrentNode(xr);
-    for (; n[nlen] && nlen + 1 < countof(n); nlen++) {
-        n[nlen + 1] = n[nlen]->parent;
+    if (!colon) {
+        *prefix = LSTR_NULL_V;
+        return name;
     }
-    sb_addf(sb, "%ld", xmlGetLineNo(n[0]));
-    if (nlen) {
-        if (nlen == countof(n) && n[nlen - 1]->parent) {
-            sb_adds(sb, ": near ...");
-        } else {
-            sb_adds(sb, ": near ");
+    *prefix = LSTR_PTR_V(name.s, colon);
+    return LSTR_PTR_V(colon + 1, name.s + name.len);
+}
+
+static void xmlr_fmt_loc(xml_reader_t xr, sb_t *sb)
+{
+    sb_addf(sb, "%d", xmlr_get_line(xr));
+    if (xr->frames.len) {
+        sb_adds(sb, ": near ");
+        tab_for_each_ptr(frame, &xr->frames) {
+            lstr_t prefix;
+            lstr_t name = xmlr_split_name(frame->name, &prefix);
+
+            sb_addf(sb, "/%*pM", LSTR_FMT_ARG(name));
         }
-        for (int i = nlen; i-- > 0; ) {
-            if (n[i]->type == XML_ELEMENT_NODE) {
-                sb_addf(sb, "/%s", (const char *)n[i]->name);
-            } else
-            if (n[i]->type == XML_TEXT_NODE) {
-                assert (i == 0);
-                sb_adds(sb, "/text()");
-            } else
-            if (n[i]->type == XML_DOCUMENT_NODE) {
-                assert (i == nlen - 1);
-            } else {
-                assert (false);
-            }
+        if (xr->type == XMLR_NODE_TEXT) {
+            sb_adds(sb, "/text()");
         }
     }
 }
@@ -135,7 +130,9 @@ int xmlr_fail(xml_reader_t xr, const char *fmt, ...)
     va_list ap;
 
     sb_reset(&xmlr_err_g);
-    xmlr_fmt_loc(xr, &xmlr_err_g);
+    if (xr) {
+        xmlr_fmt_loc(xr, &xmlr_err_g);
+    }
 
     sb_adds(&xmlr_err_g, ": ");
     va_start(ap, fmt);
@@ -146,23 +143,742 @@ int xmlr_fail(xml_reader_t xr, const char *fmt, ...)
     return XMLR_ERROR;
 }
 
-static void
-xmlr_err_handler(void *arg, const char *msg, xmlParserSeverities lvl,
-                 xmlTextReaderLocatorPtr loc)
+/* Malformed document: the reader cannot be used anymore. */
+static __attr_printf__(3, 4) __cold
+int xmlr_syntax_error(xml_reader_t xr, const char *at, const char *fmt, ...)
 {
-    sb_reset(&xmlr_err_g);
-    xmlParserError(loc, "%s", msg);
+    SB_1k(msg);
+    va_list ap;
+
+    va_start(ap, fmt);
+    sb_addvf(&msg, fmt, ap);
+    va_end(ap);
+
+    xr->node_start = at;
+    xr->failed = true;
+    return xmlr_fail(xr, "%*pM", SB_FMT_ARG(&msg));
+}
+
+/* }}} */
+/* Lexing {{{ */
+
+/* r:45-46 r:48-58 r:65-90 s:'_' r:97-122 r:128-255 */
+static ctype_desc_t const ctype_xml_name = { {
+    0x00000000, 0x07ff6000, 0x87fffffe, 0x07fffffe,
+    0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+} };
+
+static ALWAYS_INLINE bool xmlr_is_space(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+static ALWAYS_INLINE const char *xmlr_skip_spaces(const char *p,
+                                                  const char *end)
+{
+    while (p < end && xmlr_is_space(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static ALWAYS_INLINE bool
+xmlr_startswith(const char *p, const char *end, const char *s, size_t len)
+{
+    return end - p >= (ssize_t)len && !memcmp(p, s, len);
+}
+#define xmlr_startswith_s(p, end, s)  xmlr_startswith(p, end, s, strlen(s))
+
+/* Position after the first occurrence of s, or NULL. */
+static const char *
+xmlr_skip_after(const char *p, const char *end, const char *s, size_t len)
+{
+    p = memmem(p, end - p, s, len);
+    return p ? p + len : NULL;
+}
+
+static lstr_t xmlr_get_name(const char **pp, const char *end)
+{
+    const char *p = *pp;
+    size_t len = ctype_desc_span(&ctype_xml_name, p, end - p);
+
+    *pp = p + len;
+    return LSTR_INIT_V(p, len);
+}
+
+static bool xmlr_name_is_valid(lstr_t name)
+{
+    return name.len && !isdigit((unsigned char)name.s[0])
+        && name.s[0] != '-' && name.s[0] != '.';
+}
+
+/* Position of the first character that needs a special handling in a text
+ * (`<`, `&` and `\r`), or in an attribute value (the same, the quotes, and
+ * the whitespaces that are normalized), scanned 16 bytes at a time. */
+static ALWAYS_INLINE const char *
+xmlr_find_special(const char *p, const char *end, bool in_attr)
+{
+#ifdef __SSE2__
+    const __m128i lt     = _mm_set1_epi8('<');
+    const __m128i amp    = _mm_set1_epi8('&');
+    const __m128i cr     = _mm_set1_epi8('\r');
+    const __m128i dquote = _mm_set1_epi8('"');
+    const __m128i squote = _mm_set1_epi8('\'');
+    const __m128i lf     = _mm_set1_epi8('\n');
+    const __m128i tab    = _mm_set1_epi8('\t');
+
+    for (; end - p >= 16; p += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)p);
+        __m128i special;
+        uint32_t mask;
+
+        special = _mm_or_si128(_mm_cmpeq_epi8(x, lt), _mm_cmpeq_epi8(x, amp));
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(x, cr));
+        if (in_attr) {
+            special = _mm_or_si128(special, _mm_cmpeq_epi8(x, dquote));
+            special = _mm_or_si128(special, _mm_cmpeq_epi8(x, squote));
+            special = _mm_or_si128(special, _mm_cmpeq_epi8(x, lf));
+            special = _mm_or_si128(special, _mm_cmpeq_epi8(x, tab));
+        }
+        mask = _mm_movemask_epi8(special);
+
+        if (mask) {
+            return p + bsf32(mask);
+        }
+    }
+#endif
+
+    for (; p < end; p++) {
+        switch (*p) {
+          case '<': case '&': case '\r':
+            return p;
+          case '"': case '\'': case '\n': case '\t':
+            if (in_attr) {
+                return p;
+            }
+            break;
+          default:
+            break;
+        }
+    }
+    return end;
+}
+
+static int xmlr_decode_ref(xml_reader_t xr, sb_t *sb, const char **pp,
+                           const char *end)
+{
+    const char *p = *pp;
+    const char *semi = memchr(p, ';', MIN(end - p, 32));
+    lstr_t ref;
+
+    if (!semi) {
+        return xmlr_fail(xr, "invalid reference");
+    }
+    ref = LSTR_PTR_V(p, semi);
+    *pp = semi + 1;
+
+    if (ref.len > 1 && ref.s[0] == '#') {
+        int base = 10;
+        int i = 1;
+        int32_t c = 0;
+
+        if (ref.s[1] == 'x') {
+            base = 16;
+            i++;
+        }
+        if (i == ref.len) {
+            return xmlr_fail(xr, "invalid character reference");
+        }
+        for (; i < ref.len; i++) {
+            int digit = base == 16 ? hexdecode(ref.s[i])
+                      : isdigit((unsigned char)ref.s[i]) ? ref.s[i] - '0'
+                      : -1;
+
+            if (digit < 0) {
+                return xmlr_fail(xr, "invalid character reference");
+            }
+            c = c * base + digit;
+            if (c > 0x10ffff) {
+                return xmlr_fail(xr, "invalid character reference");
+            }
+        }
+        if (c == 0 || (c >= 0xd800 && c < 0xe000)) {
+            return xmlr_fail(xr, "invalid character reference");
+        }
+        sb_adduc(sb, c);
+        return 0;
+    }
+
+    if (lstr_equal(ref, LSTR("lt"))) {
+        sb_addc(sb, '<');
+    } else
+    if (lstr_equal(ref, LSTR("gt"))) {
+        sb_addc(sb, '>');
+    } else
+    if (lstr_equal(ref, LSTR("amp"))) {
+        sb_addc(sb, '&');
+    } else
+    if (lstr_equal(ref, LSTR("apos"))) {
+        sb_addc(sb, '\'');
+    } else
+    if (lstr_equal(ref, LSTR("quot"))) {
+        sb_addc(sb, '"');
+    } else {
+        return xmlr_fail(xr, "undefined entity `&%*pM;`", LSTR_FMT_ARG(ref));
+    }
+    return 0;
+}
+
+/* Append the value of a text node or of an attribute, with its references
+ * decoded, its line ends normalized, and the markup of the text removed. */
+static int xmlr_decode(xml_reader_t xr, sb_t *sb, lstr_t raw, bool in_attr)
+{
+    const char *p = raw.s;
+    const char *end = raw.s + raw.len;
+
+    for (;;) {
+        const char *q = xmlr_find_special(p, end, in_attr);
+
+        sb_add(sb, p, q - p);
+        if (q >= end) {
+            return 0;
+        }
+        p = q + 1;
+
+        switch (*q) {
+          case '&':
+            RETHROW(xmlr_decode_ref(xr, sb, &p, end));
+            break;
+
+          case '\r':
+            if (p < end && *p == '\n') {
+                p++;
+            }
+            sb_addc(sb, in_attr ? ' ' : '\n');
+            break;
+
+          case '\n': case '\t':
+            sb_addc(sb, ' ');
+            break;
+
+          case '"': case '\'':
+            sb_addc(sb, *q);
+            break;
+
+          default: {
+            /* Markup of a text, checked by xmlr_lex_text(). */
+            const char *cdata = q + strlen("<![CDATA[");
+
+            if (xmlr_startswith_s(q, end, "<!--")) {
+                p = xmlr_skip_after(p, end, "-->", 3) ?: end;
+            } else
+            if (xmlr_startswith_s(q, end, "<![CDATA[")) {
+                p = xmlr_skip_after(cdata, end, "]]>", 3) ?: end;
+                sb_add(sb, cdata, MAX(p - 3 - cdata, 0));
+            } else {
+                p = xmlr_skip_after(p, end, "?>", 2) ?: end;
+            }
+          } break;
+        }
+    }
+}
+
+static void xmlr_pop_ns(xml_reader_t xr, int nb_ns)
+{
+    if (nb_ns < xr->ns.len) {
+        sb_clip(&xr->ns_buf, xr->ns.tab[nb_ns].prefix_off);
+        qv_clip(&xr->ns, nb_ns);
+    }
+}
+
+static int xmlr_push_ns(xml_reader_t xr, lstr_t prefix, lstr_t uri)
+{
+    sb_t *sb = &xr->ns_buf;
+    xmlr_ns_t *ns = qv_growlen(&xr->ns, 1);
+
+    ns->prefix_off = sb->len;
+    ns->prefix_len = prefix.len;
+    sb_add_lstr(sb, prefix);
+    sb_addc(sb, '\0');
+    ns->uri_off = sb->len;
+    if (xmlr_decode(xr, sb, uri, true) < 0) {
+        xr->failed = true;
+        return XMLR_ERROR;
+    }
+    ns->uri_len = sb->len - ns->uri_off;
+    sb_addc(sb, '\0');
+    return 0;
+}
+
+static lstr_t xmlr_lookup_ns(xml_reader_t xr, lstr_t prefix)
+{
+    tab_for_each_pos_rev(pos, &xr->ns) {
+        const xmlr_ns_t *ns = &xr->ns.tab[pos];
+
+        if (lstr_equal(LSTR_INIT_V(xr->ns_buf.data + ns->prefix_off,
+                                   ns->prefix_len), prefix))
+        {
+            if (!ns->uri_len) {
+                /* xmlns="" undeclares the default namespace */
+                return LSTR_NULL_V;
+            }
+            return LSTR_INIT_V(xr->ns_buf.data + ns->uri_off, ns->uri_len);
+        }
+    }
+    if (lstr_equal(prefix, LSTR("xml"))) {
+        return LSTR("http://www.w3.org/XML/1998/namespace");
+    }
+    return LSTR_NULL_V;
+}
+
+static int xmlr_lex_start_tag(xml_reader_t xr)
+{
+    const char *start = xr->pos;
+    const char *p = start + 1;
+    const char *end = xr->end;
+    int nb_ns = xr->ns.len;
+    sb_t *names = &xr->name_buf;
+    lstr_t name;
+    lstr_t local_name;
+    lstr_t prefix;
+
+    name = xmlr_get_name(&p, end);
+    if (!xmlr_name_is_valid(name)) {
+        return xmlr_syntax_error(xr, start, "invalid element name");
+    }
+
+    qv_clear(&xr->attrs);
+    for (;;) {
+        const char *sep = p;
+        lstr_t attr_name;
+        const char *value;
+        char quote;
+
+        p = xmlr_skip_spaces(p, end);
+        if (p >= end) {
+            return xmlr_syntax_error(xr, start, "unterminated start tag");
+        }
+        if (*p == '>') {
+            p++;
+            xr->is_empty = false;
+            break;
+        }
+        if (*p == '/') {
+            if (p + 1 >= end || p[1] != '>') {
+                return xmlr_syntax_error(xr, start, "expected `>`");
+            }
+            p += 2;
+            xr->is_empty = true;
+            break;
+        }
+        if (p == sep) {
+            return xmlr_syntax_error(xr, start,
+                                     "expected whitespace before attribute");
+        }
+
+        attr_name = xmlr_get_name(&p, end);
+        if (!xmlr_name_is_valid(attr_name)) {
+            return xmlr_syntax_error(xr, start, "invalid attribute name");
+        }
+        p = xmlr_skip_spaces(p, end);
+        if (p >= end || *p != '=') {
+            return xmlr_syntax_error(xr, start,
+                                     "expected `=` after attribute `%*pM`",
+                                     LSTR_FMT_ARG(attr_name));
+        }
+        p = xmlr_skip_spaces(p + 1, end);
+        if (p >= end || (*p != '"' && *p != '\'')) {
+            return xmlr_syntax_error(xr, start,
+                                     "expected quoted value for attribute "
+                                     "`%*pM`", LSTR_FMT_ARG(attr_name));
+        }
+        quote = *p++;
+        value = p;
+        for (;;) {
+            p = xmlr_find_special(p, end, true);
+            if (p >= end) {
+                return xmlr_syntax_error(xr, start,
+                                         "unterminated attribute value");
+            }
+            if (*p == quote) {
+                break;
+            }
+            if (*p == '<') {
+                return xmlr_syntax_error(xr, start,
+                                         "`<` in attribute value");
+            }
+            p++;
+        }
+
+        if (lstr_equal(attr_name, LSTR("xmlns"))) {
+            RETHROW(xmlr_push_ns(xr, LSTR_EMPTY_V, LSTR_PTR_V(value, p)));
+        } else
+        if (lstr_startswith(attr_name, LSTR("xmlns:"))) {
+            RETHROW(xmlr_push_ns(xr, lstr_skip(attr_name, strlen("xmlns:")),
+                                 LSTR_PTR_V(value, p)));
+        } else {
+            xmlr_attr_t *attr = qv_growlen(&xr->attrs, 1);
+
+            attr->name = xmlr_split_name(attr_name, &prefix);
+            attr->value = LSTR_PTR_V(value, p);
+        }
+        p++;
+    }
+
+    if (xr->frames.len) {
+        tab_last(&xr->frames)->has_children = true;
+    }
+    qv_append(&xr->frames, ((xmlr_frame_t){
+        .name  = name,
+        .nb_ns = nb_ns,
+    }));
+    xr->has_root = true;
+
+    /* NUL-terminated copies of the names. */
+    local_name = xmlr_split_name(name, &prefix);
+    sb_reset(names);
+    sb_add_lstr(names, local_name);
+    sb_addc(names, '\0');
+    sb_add_lstr(names, prefix);
+    xr->local_name = LSTR_INIT_V(names->data, local_name.len);
+    xr->prefix = prefix.s ? LSTR_INIT_V(names->data + local_name.len + 1,
+                                        prefix.len) : LSTR_NULL_V;
+
+    xr->type = XMLR_NODE_ELEMENT;
+    xr->node_start = start;
+    xr->pos = p;
+    return 1;
+}
+
+static int xmlr_lex_end_tag(xml_reader_t xr)
+{
+    const char *start = xr->pos;
+    const char *p = start + 2;
+    const char *end = xr->end;
+    lstr_t name = xmlr_get_name(&p, end);
+
+    if (!xr->frames.len) {
+        return xmlr_syntax_error(xr, start, "unexpected end tag `%*pM`",
+                                 LSTR_FMT_ARG(name));
+    }
+    if (!lstr_equal(name, tab_last(&xr->frames)->name)) {
+        return xmlr_syntax_error(xr, start, "opening and ending tag "
+                                 "mismatch: `%*pM` and `%*pM`",
+                                 LSTR_FMT_ARG(tab_last(&xr->frames)->name),
+                                 LSTR_FMT_ARG(name));
+    }
+    p = xmlr_skip_spaces(p, end);
+    if (p >= end || *p != '>') {
+        return xmlr_syntax_error(xr, start, "expected `>`");
+    }
+
+    qv_clear(&xr->attrs);
+    xr->type = XMLR_NODE_END_ELEMENT;
+    xr->is_empty = false;
+    xr->node_start = start;
+    xr->pos = p + 1;
+    return 1;
+}
+
+/* Skip a comment or a processing instruction. */
+static int xmlr_skip_markup(xml_reader_t xr, const char *p, bool is_comment)
+{
+    const char *after;
+
+    if (is_comment) {
+        after = xmlr_skip_after(p + 4, xr->end, "-->", 3);
+    } else {
+        after = xmlr_skip_after(p + 2, xr->end, "?>", 2);
+    }
+    if (!after) {
+        return xmlr_syntax_error(xr, p, is_comment ? "unterminated comment"
+                                 : "unterminated processing instruction");
+    }
+    if (xr->frames.len) {
+        tab_last(&xr->frames)->has_children = true;
+    }
+    xr->pos = after;
+    return 0;
+}
+
+static int xmlr_skip_doctype(xml_reader_t xr, const char *p)
+{
+    const char *start = p;
+    int depth = 0;
+    char quote = 0;
+
+    if (xr->has_root) {
+        return xmlr_syntax_error(xr, p, "misplaced DOCTYPE declaration");
+    }
+    for (; p < xr->end; p++) {
+        if (quote) {
+            if (*p == quote) {
+                quote = 0;
+            }
+            continue;
+        }
+        switch (*p) {
+          case '"': case '\'':
+            quote = *p;
+            break;
+          case '[':
+            depth++;
+            break;
+          case ']':
+            depth--;
+            break;
+          case '>':
+            if (depth <= 0) {
+                xr->pos = p + 1;
+                return 0;
+            }
+            break;
+          default:
+            break;
+        }
+    }
+    return xmlr_syntax_error(xr, start, "unterminated DOCTYPE declaration");
+}
+
+/* Lex a text node: the character data up to the next element or end tag,
+ * with the comments, processing instructions and CDATA sections it
+ * contains.
+ *
+ * As in libxml with XML_PARSE_NOBLANKS, the blank text nodes are dropped,
+ * unless they are the only content of their element.
+ */
+static int xmlr_lex_text(xml_reader_t xr)
+{
+    xmlr_frame_t *frame = tab_last(&xr->frames);
+    const char *start = xr->pos;
+    const char *p = start;
+    const char *end = xr->end;
+    bool blank = true;
+    bool plain = true;
+    bool has_markup = false;
+    bool report;
+
+    for (;;) {
+        const char *q = xmlr_find_special(p, end, false);
+
+        for (; blank && p < q; p++) {
+            blank = xmlr_is_space(*p);
+        }
+        p = q;
+        if (p >= end) {
+            break;
+        }
+        if (*p != '<') {
+            blank &= *p == '\r';
+            plain = false;
+            p++;
+            continue;
+        }
+        if (xmlr_startswith_s(p, end, "<!--")) {
+            p = xmlr_skip_after(p + 4, end, "-->", 3);
+            if (!p) {
+                return xmlr_syntax_error(xr, start, "unterminated comment");
+            }
+            plain = false;
+            has_markup = true;
+        } else
+        if (xmlr_startswith_s(p, end, "<![CDATA[")) {
+            p = xmlr_skip_after(p + 9, end, "]]>", 3);
+            if (!p) {
+                return xmlr_syntax_error(xr, start,
+                                         "unterminated CDATA section");
+            }
+            plain = false;
+            blank = false;
+        } else
+        if (xmlr_startswith_s(p, end, "<?")) {
+            p = xmlr_skip_after(p + 2, end, "?>", 2);
+            if (!p) {
+                return xmlr_syntax_error(xr, start, "unterminated "
+                                         "processing instruction");
+            }
+            plain = false;
+            has_markup = true;
+        } else {
+            break;
+        }
+    }
+
+    report = !blank || (!has_markup && !frame->has_children
+                        && xmlr_startswith_s(p, end, "</"));
+    frame->has_children |= has_markup || report;
+    xr->pos = p;
+    if (!report) {
+        return 0;
+    }
+
+    xr->type = XMLR_NODE_TEXT;
+    xr->node_start = start;
+    xr->text = LSTR_PTR_V(start, p);
+    xr->text_plain = plain;
+    return 1;
+}
+
+/* Go to the next node, like xmlTextReaderRead().
+ *
+ * \return 1 on success, 0 at the end of the document.
+ */
+static int xmlr_read(xml_reader_t xr)
+{
+    if (unlikely(xr->failed)) {
+        return XMLR_ERROR;
+    }
+
+    if (xr->type == XMLR_NODE_END_ELEMENT
+    ||  (xr->type == XMLR_NODE_ELEMENT && xr->is_empty))
+    {
+        xmlr_pop_ns(xr, tab_last(&xr->frames)->nb_ns);
+        qv_remove_last(&xr->frames);
+    }
+    xr->type = XMLR_NODE_NONE;
+
+    for (;;) {
+        const char *p = xr->pos;
+        const char *end = xr->end;
+
+        if (p >= end) {
+            if (xr->frames.len) {
+                lstr_t name = tab_last(&xr->frames)->name;
+
+                return xmlr_syntax_error(xr, end, "premature end of data, "
+                                         "missing end tag `%*pM`",
+                                         LSTR_FMT_ARG(name));
+            }
+            if (!xr->has_root) {
+                return xmlr_syntax_error(xr, end, "document is empty");
+            }
+            xr->node_start = end;
+            return 0;
+        }
+
+        if (*p != '<' || xmlr_startswith_s(p, end, "<![CDATA[")) {
+            if (!xr->frames.len) {
+                p = xmlr_skip_spaces(p, end);
+                if (p < end && (*p != '<' || p == xr->pos)) {
+                    return xmlr_syntax_error(xr, p, "content outside of "
+                                             "the root element");
+                }
+                xr->pos = p;
+                continue;
+            }
+            if (RETHROW(xmlr_lex_text(xr))) {
+                return 1;
+            }
+            continue;
+        }
+
+        if (end - p < 2) {
+            return xmlr_syntax_error(xr, p, "unterminated tag");
+        }
+        switch (p[1]) {
+          case '/':
+            return xmlr_lex_end_tag(xr);
+
+          case '?':
+            RETHROW(xmlr_skip_markup(xr, p, false));
+            break;
+
+          case '!':
+            if (xmlr_startswith_s(p, end, "<!--")) {
+                RETHROW(xmlr_skip_markup(xr, p, true));
+            } else
+            if (xmlr_startswith_s(p, end, "<!DOCTYPE")) {
+                RETHROW(xmlr_skip_doctype(xr, p));
+            } else {
+                return xmlr_syntax_error(xr, p, "invalid markup");
+            }
+            break;
+
+          default:
+            if (!xr->frames.len && xr->has_root) {
+                return xmlr_syntax_error(xr, p, "extra content at the end "
+                                         "of the document");
+            }
+            return xmlr_lex_start_tag(xr);
+        }
+    }
+}
+
+/* Get the value of the current text node, NUL-terminated. */
+static int xmlr_get_text(xml_reader_t xr, lstr_t *out)
+{
+    sb_t *sb = &xr->value_buf;
+
+    sb_reset(sb);
+    if (xr->text_plain) {
+        sb_add_lstr(sb, xr->text);
+    } else {
+        RETHROW(xmlr_decode(xr, sb, xr->text, false));
+    }
+    *out = LSTR_SB_V(sb);
+    return 0;
+}
+
+/* Get the value of an attribute, NUL-terminated. */
+static int xmlr_attr_decode(xml_reader_t xr, const xmlr_attr_t *attr,
+                            const char **out)
+{
+    sb_reset(&xr->value_buf);
+    RETHROW(xmlr_decode(xr, &xr->value_buf, attr->value, true));
+    *out = xr->value_buf.data;
+    return 0;
 }
 
 /* }}} */
 /* Crawling {{{ */
 
+static xmlr_t *xmlr_init(xmlr_t *xr)
+{
+    p_clear(xr, 1);
+    qv_init(&xr->attrs);
+    qv_init(&xr->frames);
+    qv_init(&xr->ns);
+    sb_init(&xr->ns_buf);
+    sb_init(&xr->name_buf);
+    sb_init(&xr->value_buf);
+    return xr;
+}
+GENERIC_NEW(xmlr_t, xmlr);
+
+static void xmlr_wipe(xmlr_t *xr)
+{
+    qv_wipe(&xr->attrs);
+    qv_wipe(&xr->frames);
+    qv_wipe(&xr->ns);
+    sb_wipe(&xr->ns_buf);
+    sb_wipe(&xr->name_buf);
+    sb_wipe(&xr->value_buf);
+}
+DO_DELETE(xmlr_t, xmlr);
+
+static void xmlr_reset(xml_reader_t xr)
+{
+    xr->start = xr->end = xr->pos = NULL;
+    xr->has_root = false;
+    xr->failed = false;
+    xr->type = XMLR_NODE_NONE;
+    xr->node_start = NULL;
+    xr->is_empty = false;
+    xr->local_name = LSTR_NULL_V;
+    xr->prefix = LSTR_NULL_V;
+    xr->text = LSTR_NULL_V;
+    qv_clear(&xr->attrs);
+    qv_clear(&xr->frames);
+    qv_clear(&xr->ns);
+    sb_reset(&xr->ns_buf);
+}
+
 static ALWAYS_INLINE bool xmlr_on_element(xml_reader_t xr, bool allow_closing)
 {
-    switch (xmlTextReaderNodeType(xr)) {
-      case XTYPE(ELEMENT):
+    switch (xr->type) {
+      case XMLR_NODE_ELEMENT:
         return true;
-      case XTYPE(END_ELEMENT):
+      case XMLR_NODE_END_ELEMENT:
         return allow_closing;
       default:
         return false;
@@ -172,31 +888,44 @@ static ALWAYS_INLINE bool xmlr_on_element(xml_reader_t xr, bool allow_closing)
 static ALWAYS_INLINE int xmlr_scan_node(xml_reader_t xr, bool stop_on_text)
 {
     for (;;) {
-        switch (xmlTextReaderNodeType(xr)) {
-          case -1:
-            return xmlr_fail(xr, "unable to get node type");
-          case XTYPE(ELEMENT):
-          case XTYPE(END_ELEMENT):
-          case XTYPE(NONE):
+        if (unlikely(xr->failed)) {
+            return XMLR_ERROR;
+        }
+        switch (xr->type) {
+          case XMLR_NODE_ELEMENT:
+          case XMLR_NODE_END_ELEMENT:
+          case XMLR_NODE_NONE:
             return 0;
-          case XTYPE(TEXT):
+          case XMLR_NODE_TEXT:
             if (stop_on_text)
                 return 0;
             break;
-          default:
-            break;
         }
-        RETHROW(xmlTextReaderRead(xr));
+        RETHROW(xmlr_read(xr));
     }
 }
 
+/* Go to the end tag of the current element. */
+static int xmlr_skip_subtree(xml_reader_t xr)
+{
+    int depth = xr->frames.len;
+
+    if (xr->type != XMLR_NODE_ELEMENT || xr->is_empty) {
+        return 0;
+    }
+    do {
+        RETHROW(xmlr_read(xr));
+    } while (xr->type != XMLR_NODE_END_ELEMENT || xr->frames.len != depth);
+    return 0;
+}
+
 int xmlr_node_close(xml_reader_t xr)
 {
     if (xmlr_node_is_empty(xr) == 1 || xmlr_node_is_closing(xr) == 1) {
         return xmlr_next_node(xr);
     }
-    /* XXX: consider <toto></toto> as autoclosing because libxml doesn't */
-    if (!xmlr_on_element(xr, false) || xmlTextReaderRead(xr) < 0) {
+    /* XXX: consider <toto></toto> as autoclosing */
+    if (!xmlr_on_element(xr, false) || xmlr_read(xr) < 0) {
         return xmlr_fail(xr, "closing tag expected");
     }
     RETHROW(xmlr_scan_node(xr, true));
@@ -212,80 +941,54 @@ int xmlr_setup(xml_reader_t *xrp, const void *buf, int len)
 
     xmlr_initialize();
 
-    if (xr) {
-        if (xmlReaderNewMemory(xr, buf, len, NULL, NULL, XMLR_OPTS) < 0) {
-            xmlFreeTextReader(xr);
-            *xrp = xr = NULL;
-            return xmlr_fail(xr, "unable to allocate parser");
-        }
-    } else {
-        *xrp = xr = xmlReaderForMemory(buf, len, NULL, NULL, XMLR_OPTS);
-        if (!xr)
-            return xmlr_fail(xr, "unable to allocate parser");
+    if (!xr) {
+        *xrp = xr = xmlr_new();
     }
+    xmlr_reset(xr);
+    xr->start = xr->pos = buf;
+    xr->end = xr->start + len;
 
-    xmlTextReaderSetErrorHandler(xr, xmlr_err_handler, xr);
-    if (RETHROW(xmlTextReaderRead(xr)) != 1)
+    /* skip the UTF-8 byte order mark */
+    if (xmlr_startswith_s(xr->pos, xr->end, "\xef\xbb\xbf")) {
+        xr->pos += 3;
+    }
+
+    if (RETHROW(xmlr_read(xr)) != 1)
         return xmlr_fail(xr, "unable to load root node");
     return xmlr_scan_node(xr, false);
 }
 
 void xmlr_close(xml_reader_t *xrp)
 {
-    xml_reader_t xr = *xrp;
-
-    /* when the parsing was interrupted, namespace stack isn't reset properly
-     * leading to bugs, so workaround it when we're not sure the parse ended
-     * well
-     */
-    if (xmlTextReaderRead(xr) == 0 &&
-        xmlTextReaderReadState(xr) == XML_TEXTREADER_MODE_EOF)
-    {
-        xmlTextReaderClose(xr);
-    } else {
-        xmlFreeTextReader(xr);
-        *xrp = NULL;
+    if (*xrp) {
+        xmlr_reset(*xrp);
     }
 }
 
 int xmlr_node_get_local_name(xml_reader_t xr, lstr_t *out)
 {
-    const char *s;
-
     assert (xmlr_on_element(xr, false));
-    s = (const char *)xmlTextReaderConstLocalName(xr);
-    if (s == NULL) {
-        return xmlr_fail(xr, "cannot retrieve char string in %s", __func__);
-    }
-    *out = LSTR(s);
+    *out = xr->local_name;
     return 0;
 }
 
 lstr_t xmlr_node_get_xmlns(xml_reader_t xr)
 {
-    const char *s;
-
     assert (xmlr_on_element(xr, false));
-    s = (const char *)xmlTextReaderConstPrefix(xr);
-
-    return LSTR_OPT(s);
+    return xr->prefix;
 }
 
 lstr_t xmlr_node_get_xmlns_uri(xml_reader_t xr)
 {
-    const char *s;
-
     assert (xmlr_on_element(xr, false));
-    s = (const char *)xmlTextReaderConstNamespaceUri(xr);
-
-    return LSTR_OPT(s);
+    return xmlr_lookup_ns(xr, xr->prefix);
 }
 
 int xmlr_next_node(xml_reader_t xr)
 {
     assert (xmlr_on_element(xr, true));
 
-    RETHROW(xmlTextReaderRead(xr));
+    RETHROW(xmlr_read(xr));
     return xmlr_scan_node(xr, false);
 }
 
@@ -309,7 +1012,8 @@ int xmlr_next_sibling(xml_reader_t xr)
 {
     assert (xmlr_on_element(xr, true));
 
-    if (RETHROW(xmlTextReaderNext(xr)) == 1)
+    RETHROW(xmlr_skip_subtree(xr));
+    if (RETHROW(xmlr_read(xr)) == 1)
         return xmlr_scan_node(xr, false);
     return xmlr_fail(xr, "node has no sibling");
 }
@@ -359,34 +1063,28 @@ int xmlr_node_skip_until(xml_reader_t xr, const char *s, int len)
 __flatten
 int xmlr_get_cstr_start(xml_reader_t xr, bool emptyok, lstr_t *out)
 {
-    const char *s = NULL;
-
     assert (xmlr_on_element(xr, false));
 
     if (!RETHROW(xmlr_node_is_empty(xr))) {
-        if (RETHROW(xmlTextReaderRead(xr)) != 1)
+        if (RETHROW(xmlr_read(xr)) != 1)
             return xmlr_fail(xr, "expecting text or closing element");
         RETHROW(xmlr_scan_node(xr, true));
-        if (RETHROW(xmlTextReaderNodeType(xr)) == XTYPE(TEXT))
-            s = (const char *)xmlTextReaderConstValue(xr);
-    }
-    if (s) {
-        *out = LSTR(s);
-    } else {
-        if (!emptyok)
-            return xmlr_fail(xr, "node value is missing");
-        *out = LSTR_EMPTY_V;
+        if (xr->type == XMLR_NODE_TEXT)
+            return xmlr_get_text(xr, out);
     }
+    if (!emptyok)
+        return xmlr_fail(xr, "node value is missing");
+    *out = LSTR_EMPTY_V;
     return 0;
 }
 
 int xmlr_get_cstr_done(xml_reader_t xr)
 {
     if (!RETHROW(xmlr_node_is_empty(xr))) {
-        if (RETHROW(xmlTextReaderNodeType(xr)) == XTYPE(TEXT)) {
+        if (xr->type == XMLR_NODE_TEXT) {
             RETHROW(xmlr_scan_node(xr, false));
         }
-        if (RETHROW(xmlTextReaderNodeType(xr)) != XTYPE(END_ELEMENT))
+        if (xr->type != XMLR_NODE_END_ELEMENT)
             return xmlr_fail(xr, "expecting closing tag");
     }
     return xmlr_next_node(xr);
@@ -537,61 +1235,66 @@ static int xmlr_val_dbl(xml_reader_t xr, const char *s, double *dblp)
 #define ARGS    dblp
 #include "xmlr-get-value.in.c"
 
-int xmlr_get_inner_xml(xml_reader_t xr, lstr_t *out)
+/* The inner XML is the content of the element as it is in the document. */
+static int xmlr_get_inner_xml_raw(xml_reader_t xr, lstr_t *out)
 {
-    char *res;
+    const char *start = xr->pos;
 
     assert (xmlr_on_element(xr, false));
 
-    res = (char *)xmlTextReaderReadInnerXml(xr);
-    if (!res) {
-        return xmlr_fail(xr, "cannot retrieve char string in %s", __func__);
+    if (xr->is_empty) {
+        *out = LSTR_EMPTY_V;
+    } else {
+        RETHROW(xmlr_skip_subtree(xr));
+        *out = LSTR_PTR_V(start, xr->node_start);
     }
-    *out = lstr_init_(res, strlen(res), MEM_LIBC);
+    return 0;
+}
+
+int xmlr_get_inner_xml(xml_reader_t xr, lstr_t *out)
+{
+    lstr_t res;
+
+    RETHROW(xmlr_get_inner_xml_raw(xr, &res));
+    *out = lstr_dups(res.s, res.len);
     return xmlr_next_sibling(xr);
 }
 
 int mp_xmlr_get_inner_xml(mem_pool_t *mp, xml_reader_t xr, lstr_t *out)
 {
-    char *res;
-
-    assert (xmlr_on_element(xr, false));
+    lstr_t res;
 
-    res = (char *)xmlTextReaderReadInnerXml(xr);
-    if (!res) {
-        return xmlr_fail(xr, "cannot retrieve char string in %s", __func__);
-    }
-    *out = mp_lstr_dups(mp, res, strlen(res));
-    free(res);
+    RETHROW(xmlr_get_inner_xml_raw(xr, &res));
+    *out = mp_lstr_dups(mp, res.s, res.len);
     return xmlr_next_sibling(xr);
 }
 
 /* }}} */
 /* Reading attributes {{{ */
 
-xmlAttrPtr
+const xmlr_attr_t *
 xmlr_find_attr(xml_reader_t xr, const char *name, size_t len, bool needed)
 {
+    lstr_t s = LSTR_INIT_V(name, len);
+
     xmlr_for_each_attr(attr, xr) {
-        if (strlen((char *)attr->name) != len)
-            continue;
-        if (memcmp(attr->name, name, len))
-            continue;
-        return attr;
+        if (lstr_equal(attr->name, s))
+            return attr;
     }
     if (needed)
         xmlr_fail(xr, "missing [%s] attribute", name);
     return NULL;
 }
 
-static int t_xmlr_attr_str(xml_reader_t xr, const char *name, const char *s,
+static int t_xmlr_attr_str(xml_reader_t xr, lstr_t name, const char *s,
                            bool emptyok, lstr_t *out)
 {
     if (s) {
         *out = t_lstr_dups(s, strlen(s));
     } else {
         if (!emptyok)
-            return xmlr_fail(xr, "[%s] value is missing", name);
+            return xmlr_fail(xr, "[%*pM] value is missing",
+                             LSTR_FMT_ARG(name));
         *out = LSTR_EMPTY_V;
     }
     return 0;
@@ -602,19 +1305,21 @@ static int t_xmlr_attr_str(xml_reader_t xr, const char *name, const char *s,
 #include "xmlr-get-attr.in.c"
 
 static int
-xmlr_attr_int_range_base(xml_reader_t xr, const char *name, const char *s,
+xmlr_attr_int_range_base(xml_reader_t xr, lstr_t name, const char *s,
                          int minv, int maxv, int base, int *ip)
 {
     int64_t i64;
 
     if (!s)
-        return xmlr_fail(xr, "[%s] value is missing", name);
+        return xmlr_fail(xr, "[%*pM] value is missing", LSTR_FMT_ARG(name));
     errno = 0;
     i64 = strtoll(s, &s, base);
     if (skipspaces(s)[0] || errno)
-        return xmlr_fail(xr, "[%s] value is not an integer", name);
+        return xmlr_fail(xr, "[%*pM] value is not an integer",
+                         LSTR_FMT_ARG(name));
     if (i64 < minv || i64 > maxv)
-        return xmlr_fail(xr, "[%s] value isn't in the %d .. %d range", name, minv, maxv);
+        return xmlr_fail(xr, "[%*pM] value isn't in the %d .. %d range",
+                         LSTR_FMT_ARG(name), minv, maxv);
     *ip = i64;
     return 0;
 }
@@ -623,10 +1328,11 @@ xmlr_attr_int_range_base(xml_reader_t xr, const char *name, const char *s,
 #define ARGS    minv, maxv, base, ip
 #include "xmlr-get-attr.in.c"
 
-static int xmlr_attr_bool(xml_reader_t xr, const char *name, const char *s, bool *bp)
+static int xmlr_attr_bool(xml_reader_t xr, lstr_t name, const char *s,
+                          bool *bp)
 {
     if (!s)
-        return xmlr_fail(xr, "[%s] value is missing", name);
+        return xmlr_fail(xr, "[%*pM] value is missing", LSTR_FMT_ARG(name));
     s = skipspaces(s);
     if (*s == '0' || *s == '1') {
         *bp = *s++ - '0';
@@ -637,10 +1343,12 @@ static int xmlr_attr_bool(xml_reader_t xr, const char *name, const char *s, bool
     if (stristart(s, "false", &s)) {
         *bp = false;
     } else {
-        return xmlr_fail(xr, "[%s] value is not a valid boolean", name);
+        return xmlr_fail(xr, "[%*pM] value is not a valid boolean",
+                         LSTR_FMT_ARG(name));
     }
     if (skipspaces(s)[0])
-        return xmlr_fail(xr, "[%s] value is not a valid boolean", name);
+        return xmlr_fail(xr, "[%*pM] value is not a valid boolean",
+                         LSTR_FMT_ARG(name));
     return 0;
 }
 #define F(x)    x##_bool
@@ -648,15 +1356,16 @@ static int xmlr_attr_bool(xml_reader_t xr, const char *name, const char *s, bool
 #define ARGS    bp
 #include "xmlr-get-attr.in.c"
 
-static int xmlr_attr_i64_base(xml_reader_t xr, const char *name,
+static int xmlr_attr_i64_base(xml_reader_t xr, lstr_t name,
                               const char *s, int base, int64_t *i64p)
 {
     if (!s)
-        return xmlr_fail(xr, "[%s] value is missing", name);
+        return xmlr_fail(xr, "[%*pM] value is missing", LSTR_FMT_ARG(name));
     errno = 0;
     *i64p = strtoll(s, &s, base);
     if (skipspaces(s)[0] || errno)
-        return xmlr_fail(xr, "[%s] value is not a valid integer", name);
+        return xmlr_fail(xr, "[%*pM] value is not a valid integer",
+                         LSTR_FMT_ARG(name));
     return 0;
 }
 #define F(x)    x##_i64_base
@@ -664,15 +1373,16 @@ static int xmlr_attr_i64_base(xml_reader_t xr, const char *name,
 #define ARGS    base, i64p
 #include "xmlr-get-attr.in.c"
 
-static int xmlr_attr_u64_base(xml_reader_t xr, const char *name,
+static int xmlr_attr_u64_base(xml_reader_t xr, lstr_t name,
                               const char *s, int base, uint64_t *u64p)
 {
     if (!s)
-        return xmlr_fail(xr, "[%s] value is missing", name);
+        return xmlr_fail(xr, "[%*pM] value is missing", LSTR_FMT_ARG(name));
     errno = 0;
     *u64p = strtoull(s, &s, base);
     if (skipspaces(s)[0] || errno)
-        return xmlr_fail(xr, "[%s] value is not a valid integer", name);
+        return xmlr_fail(xr, "[%*pM] value is not a valid integer",
+                         LSTR_FMT_ARG(name));
     return 0;
 }
 #define F(x)    x##_u64_base
@@ -680,15 +1390,16 @@ static int xmlr_attr_u64_base(xml_reader_t xr, const char *name,
 #define ARGS    base, u64p
 #include "xmlr-get-attr.in.c"
 
-static int xmlr_attr_dbl(xml_reader_t xr, const char *name, const char *s,
+static int xmlr_attr_dbl(xml_reader_t xr, lstr_t name, const char *s,
                          double *dblp)
 {
     if (!s)
-        return xmlr_fail(xr, "[%s] value is missing", name);
+        return xmlr_fail(xr, "[%*pM] value is missing", LSTR_FMT_ARG(name));
     errno = 0;
     *dblp = strtod_allow_subnormal(s, (char **)&s);
     if (skipspaces(s)[0] || errno)
-        return xmlr_fail(xr, "[%s] value is not a valid number", name);
+        return xmlr_fail(xr, "[%*pM] value is not a valid number",
+                         LSTR_FMT_ARG(name));
     return 0;
 }
 #define F(x)    x##_dbl
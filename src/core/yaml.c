@@ -144,6 +144,13 @@ qm_kvec_t(yaml_pres_node, lstr_t, const yaml__presentation_node__t * nonnull,
 /* This is a yaml.DocumentPresentation transformed into a hashmap. */
 typedef struct yaml_presentation_t {
     qm_t(yaml_pres_node) nodes;
+
+    /* Paths that have presentation nodes below them, used by the streaming
+     * packer to skip the lookups in the subtrees without presentation. */
+    qh_t(lstr) prefixes;
+
+    /* Whether all the nodes can be applied by the streaming packer. */
+    bool can_stream;
 } yaml_presentation_t;
 
 /* Presentation details currently being constructed */
@@ -591,6 +598,12 @@ typedef struct yaml_parse_t {
 
     /* Hash of unbounded vars in the document. */
     qh_t(lstr) unbounded_vars;
+
+    /* State of the streaming parser.
+     *
+     * Allocated on the first call to yaml_parse_next_event.
+     */
+    struct yaml_stream_t * nullable stream;
 } yaml_parse_t;
 
 /* }}} */
@@ -1517,16 +1530,17 @@ t_handle_binary_tag(yaml_parse_t * nonnull env, yaml_data_t * nonnull data)
     return 0;
 }
 
+/* r:32-127 -s:'[]{}, ' */
+static ctype_desc_t const ctype_yaml_tag_chars = { {
+    0x00000000, 0xffffeffe, 0xd7ffffff, 0xd7ffffff,
+    0x00000000, 0x00000000, 0x00000000, 0x00000000,
+} };
+
 static int
 t_yaml_env_parse_tag(yaml_parse_t * nonnull env, const uint32_t min_indent,
                      yaml_data_t * nonnull out,
                      yaml_tag_type_t * nonnull type)
 {
-    /* r:32-127 -s:'[]{}, ' */
-    static const ctype_desc_t ctype_tag = { {
-        0x00000000, 0xffffeffe, 0xd7ffffff, 0xd7ffffff,
-        0x00000000, 0x00000000, 0x00000000, 0x00000000,
-    } };
     yaml_pos_t tag_pos_start = yaml_env_get_pos(env);
     pstream_t tag;
 
@@ -1543,7 +1557,7 @@ t_yaml_env_parse_tag(yaml_parse_t * nonnull env, const uint32_t min_indent,
                                 "must start with a letter");
     }
 
-    tag = ps_get_span(&env->ps, &ctype_tag);
+    tag = ps_get_span(&env->ps, &ctype_yaml_tag_chars);
     if (!isspace(ps_peekc(env->ps)) && !ps_done(&env->ps)) {
         return yaml_env_set_err(env, YAML_ERR_INVALID_TAG,
                                 "wrong character in tag");
@@ -2961,6 +2975,591 @@ static int t_yaml_env_parse_data(yaml_parse_t *env, const uint32_t min_indent,
 }
 
 /* }}} */
+/* }}} */
+/* {{{ Streaming parser */
+
+/* The streaming parser follows the same grammar as the parser above, but
+ * instead of recursing on the sequences and objects, it keeps a stack of
+ * the containers being parsed, and returns an event each time it goes one
+ * step further. Only the containers on the path to the current data are
+ * thus kept in memory. */
+
+typedef enum yaml_stream_frame_type_t {
+    YAML_STREAM_BLOCK_SEQ,
+    YAML_STREAM_BLOCK_OBJ,
+    YAML_STREAM_FLOW_SEQ,
+    YAML_STREAM_FLOW_OBJ,
+    /* Implicit object of a key-value pair in a flow sequence: [ a: b ] */
+    YAML_STREAM_FLOW_PAIR,
+} yaml_stream_frame_type_t;
+
+typedef struct yaml_stream_frame_t {
+    yaml_stream_frame_type_t type;
+
+    /* Indentation of the block containers. */
+    uint32_t indent;
+
+    /* Number of elements or keys parsed. */
+    int nb_elems;
+
+    /* Keys of the objects, to reject duplicated keys. */
+    qh_t(lstr) keys;
+} yaml_stream_frame_t;
+qvector_t(yaml_stream_frame, yaml_stream_frame_t);
+
+typedef enum yaml_stream_expect_t {
+    YAML_STREAM_EXPECT_NONE,
+    YAML_STREAM_EXPECT_BLOCK_DATA,
+    YAML_STREAM_EXPECT_FLOW_DATA,
+} yaml_stream_expect_t;
+
+typedef struct yaml_stream_t {
+    /* Containers being parsed. The frames above depth are kept allocated,
+     * to be reused by the next containers. */
+    qv_t(yaml_stream_frame) frames;
+    int depth;
+
+    /* Data expected after the last event, and minimum indentation of a
+     * block data. */
+    yaml_stream_expect_t expect;
+    uint32_t min_indent;
+
+    /* Set once the end of the document is reached. */
+    bool done;
+
+    /* Buffers for the unescaped strings and the decoded binaries. */
+    sb_t buf;
+    sb_t bin_buf;
+} yaml_stream_t;
+
+static yaml_stream_t *yaml_stream_new(void)
+{
+    yaml_stream_t *stream = p_new(yaml_stream_t, 1);
+
+    qv_init(&stream->frames);
+    stream->expect = YAML_STREAM_EXPECT_BLOCK_DATA;
+    sb_init(&stream->buf);
+    sb_init(&stream->bin_buf);
+
+    return stream;
+}
+
+static void yaml_stream_delete(yaml_stream_t * nullable * nonnull stream)
+{
+    if (!(*stream)) {
+        return;
+    }
+    tab_for_each_ptr(frame, &(*stream)->frames) {
+        qh_wipe(lstr, &frame->keys);
+    }
+    qv_wipe(&(*stream)->frames);
+    sb_wipe(&(*stream)->buf);
+    sb_wipe(&(*stream)->bin_buf);
+    p_delete(stream);
+}
+
+static void yaml_env_stream_push(yaml_parse_t * nonnull env,
+                                 yaml_stream_frame_type_t type,
+                                 uint32_t indent)
+{
+    yaml_stream_t *stream = env->stream;
+    yaml_stream_frame_t *frame;
+
+    if (stream->depth == stream->frames.len) {
+        frame = qv_growlen(&stream->frames, 1);
+        qh_init(lstr, &frame->keys);
+    } else {
+        frame = &stream->frames.tab[stream->depth];
+        qh_clear(lstr, &frame->keys);
+    }
+    stream->depth++;
+
+    frame->type = type;
+    frame->indent = indent;
+    frame->nb_elems = 0;
+}
+
+static void yaml_env_stream_start(yaml_parse_t * nonnull env,
+                                  yaml_stream_frame_type_t type,
+                                  uint32_t indent, yaml_pos_t pos_start,
+                                  yaml_event_t * nonnull event)
+{
+    yaml_env_stream_push(env, type, indent);
+    switch (type) {
+      case YAML_STREAM_BLOCK_SEQ:
+      case YAML_STREAM_FLOW_SEQ:
+        event->type = YAML_EVENT_SEQ_START;
+        break;
+      default:
+        event->type = YAML_EVENT_OBJ_START;
+        break;
+    }
+    yaml_span_init(&event->span, env, pos_start, yaml_env_get_pos(env));
+}
+
+static void yaml_env_stream_end(yaml_parse_t * nonnull env,
+                                yaml_event_type_t type,
+                                yaml_event_t * nonnull event)
+{
+    yaml_pos_t pos = yaml_env_get_pos(env);
+
+    env->stream->depth--;
+    event->type = type;
+    yaml_span_init(&event->span, env, pos, pos);
+}
+
+static int yaml_env_stream_tag(yaml_parse_t * nonnull env,
+                               yaml_event_t * nonnull event)
+{
+    yaml_pos_t tag_pos_start = yaml_env_get_pos(env);
+    pstream_t tag;
+
+    if (event->tag.s) {
+        return yaml_env_set_err(env, YAML_ERR_WRONG_OBJECT,
+                                "two tags have been declared");
+    }
+
+    assert (ps_peekc(env->ps) == '!');
+    yaml_env_skipc(env);
+
+    if (!isalpha(ps_peekc(env->ps))) {
+        return yaml_env_set_err(env, YAML_ERR_INVALID_TAG,
+                                "must start with a letter");
+    }
+
+    tag = ps_get_span(&env->ps, &ctype_yaml_tag_chars);
+    if (!isspace(ps_peekc(env->ps)) && !ps_done(&env->ps)) {
+        return yaml_env_set_err(env, YAML_ERR_INVALID_TAG,
+                                "wrong character in tag");
+    }
+
+    event->tag = LSTR_PS_V(&tag);
+    yaml_span_init(&event->tag_span, env, tag_pos_start,
+                   yaml_env_get_pos(env));
+
+    if (get_tag_type(event->tag) != YAML_TAG_TYPE_NONE) {
+        return yaml_env_set_err_at(env, &event->tag_span,
+                                   YAML_ERR_INVALID_INCLUDE,
+                                   "cannot use includes in streaming mode");
+    }
+
+    return 0;
+}
+
+static int yaml_env_stream_binary_tag(yaml_parse_t * nonnull env,
+                                      yaml_event_t * nonnull event)
+{
+    sb_t *buf = &env->stream->bin_buf;
+
+    if (event->type != YAML_EVENT_SCALAR
+    ||  event->scalar.type != YAML_SCALAR_STRING)
+    {
+        return yaml_env_set_err_at(env, &event->span, YAML_ERR_WRONG_DATA,
+                                   "binary tag can only be used on strings");
+    }
+
+    sb_reset(buf);
+    if (sb_add_lstr_unb64(buf, event->scalar.s) < 0) {
+        return yaml_env_set_err_at(env, &event->span, YAML_ERR_WRONG_DATA,
+                                   "binary data must be base64 encoded");
+    }
+    event->scalar.s = LSTR_SB_V(buf);
+    event->scalar.type = YAML_SCALAR_BYTES;
+    event->tag = LSTR_NULL_V;
+
+    return 0;
+}
+
+static int yaml_env_stream_scalar(yaml_parse_t * nonnull env, bool in_flow,
+                                  yaml_event_t * nonnull event)
+{
+    yaml_pos_t pos_start = yaml_env_get_pos(env);
+    yaml_scalar_t *scalar = &event->scalar;
+    lstr_t line;
+    pstream_t ps_line;
+
+    event->type = YAML_EVENT_SCALAR;
+
+    if (ps_peekc(env->ps) == '"') {
+        sb_t *buf = &env->stream->buf;
+        qv_t(u8) var_bitmap;
+        bool has_escaped_dollars = false;
+        int res;
+
+        yaml_env_skipc(env);
+        sb_reset(buf);
+        qv_init(&var_bitmap);
+        res = yaml_parse_quoted_string(env, buf, &var_bitmap,
+                                       &has_escaped_dollars);
+        yaml_span_init(&event->span, env, pos_start, yaml_env_get_pos(env));
+        if (res >= 0 && var_bitmap.len > 0) {
+            res = yaml_env_set_err_at(env, &event->span,
+                                      YAML_ERR_FORBIDDEN_VAR,
+                                      "cannot use variables in streaming "
+                                      "mode");
+        }
+        qv_wipe(&var_bitmap);
+        RETHROW(res);
+
+        scalar->type = YAML_SCALAR_STRING;
+        scalar->s = LSTR_SB_V(buf);
+        return 0;
+    }
+
+    ps_line = yaml_env_get_scalar_ps(env, in_flow);
+    if (ps_len(&ps_line) == 0) {
+        return yaml_env_set_err(env, YAML_ERR_MISSING_DATA,
+                                "unexpected character");
+    }
+
+    line = LSTR_PS_V(&ps_line);
+    yaml_span_init(&event->span, env, pos_start, yaml_env_get_pos(env));
+
+    if (yaml_parse_special_scalar(line, scalar) >= 0
+    ||  yaml_parse_numeric_scalar(line, scalar) >= 0)
+    {
+        return 0;
+    }
+
+    if (memmem(line.s, line.len, "$(", 2)) {
+        return yaml_env_set_err_at(env, &event->span, YAML_ERR_FORBIDDEN_VAR,
+                                   "cannot use variables in streaming mode");
+    }
+    scalar->type = YAML_SCALAR_STRING;
+    scalar->s = line;
+
+    return 0;
+}
+
+/* Equivalent of t_yaml_env_parse_data. */
+static int yaml_env_stream_block_data(yaml_parse_t * nonnull env,
+                                      uint32_t min_indent,
+                                      yaml_event_t * nonnull event)
+{
+    yaml_pos_t pos_start;
+    uint32_t cur_indent;
+
+    RETHROW(yaml_env_ltrim(env));
+    pos_start = yaml_env_get_pos(env);
+    cur_indent = yaml_env_get_column_nb(env);
+    if (cur_indent < min_indent || ps_done(&env->ps)) {
+        event->type = YAML_EVENT_SCALAR;
+        event->scalar.type = YAML_SCALAR_NULL;
+        yaml_span_init(&event->span, env, pos_start, pos_start);
+        return 0;
+    }
+
+    if (ps_peekc(env->ps) == '!') {
+        RETHROW(yaml_env_stream_tag(env, event));
+        RETHROW(yaml_env_stream_block_data(env, min_indent, event));
+        event->span.start = event->tag_span.start;
+
+        if (lstr_equal(event->tag, LSTR("bin"))) {
+            RETHROW(yaml_env_stream_binary_tag(env, event));
+        }
+    } else
+    if (ps_startswith_yaml_seq_prefix(&env->ps)) {
+        yaml_env_stream_start(env, YAML_STREAM_BLOCK_SEQ, cur_indent,
+                              pos_start, event);
+    } else
+    if (ps_peekc(env->ps) == '[') {
+        yaml_env_skipc(env);
+        yaml_env_stream_start(env, YAML_STREAM_FLOW_SEQ, 0, pos_start,
+                              event);
+    } else
+    if (ps_peekc(env->ps) == '{') {
+        yaml_env_skipc(env);
+        yaml_env_stream_start(env, YAML_STREAM_FLOW_OBJ, 0, pos_start,
+                              event);
+    } else
+    if (ps_startswith_yaml_key(env->ps)) {
+        yaml_env_stream_start(env, YAML_STREAM_BLOCK_OBJ, cur_indent,
+                              pos_start, event);
+    } else {
+        RETHROW(yaml_env_stream_scalar(env, false, event));
+    }
+
+    return 0;
+}
+
+/* Equivalent of the value part of t_yaml_env_parse_flow_key_data. */
+static int yaml_env_stream_flow_data(yaml_parse_t * nonnull env,
+                                     yaml_event_t * nonnull event)
+{
+    yaml_pos_t pos_start;
+
+    RETHROW(yaml_env_ltrim(env));
+    if (ps_done(&env->ps)) {
+        return yaml_env_set_err(env, YAML_ERR_MISSING_DATA,
+                                "unexpected end of line");
+    }
+
+    pos_start = yaml_env_get_pos(env);
+    if (ps_startswith_yaml_key(env->ps)) {
+        /* a: b: c, point to the second colon */
+        ps_get_span(&env->ps, &ctype_yaml_key_chars);
+        return yaml_env_set_err(env, YAML_ERR_WRONG_DATA,
+                                "unexpected colon");
+    } else
+    if (ps_peekc(env->ps) == '[') {
+        yaml_env_skipc(env);
+        yaml_env_stream_start(env, YAML_STREAM_FLOW_SEQ, 0, pos_start,
+                              event);
+    } else
+    if (ps_peekc(env->ps) == '{') {
+        yaml_env_skipc(env);
+        yaml_env_stream_start(env, YAML_STREAM_FLOW_OBJ, 0, pos_start,
+                              event);
+    } else {
+        RETHROW(yaml_env_stream_scalar(env, true, event));
+    }
+
+    return 0;
+}
+
+static int yaml_env_stream_key(yaml_parse_t * nonnull env,
+                               yaml_stream_frame_t * nonnull frame,
+                               yaml_event_t * nonnull event)
+{
+    lstr_t key;
+
+    RETHROW(yaml_env_parse_key(env, &key, &event->span, NULL));
+    if (lstr_equal(key, LSTR("<<"))) {
+        return yaml_env_set_err_at(env, &event->span, YAML_ERR_BAD_KEY,
+                                   "cannot use merge keys in streaming "
+                                   "mode");
+    }
+    if (qh_add(lstr, &frame->keys, &key) < 0) {
+        return yaml_env_set_err_at(env, &event->span, YAML_ERR_BAD_KEY,
+                                   "key is already declared in the object");
+    }
+    frame->nb_elems++;
+
+    event->type = YAML_EVENT_KEY;
+    event->key = key;
+    return 0;
+}
+
+/* Equivalent of an iteration of t_yaml_env_parse_seq. */
+static int yaml_env_stream_block_seq(yaml_parse_t * nonnull env,
+                                     yaml_stream_frame_t * nonnull frame,
+                                     yaml_event_t * nonnull event)
+{
+    RETHROW(yaml_env_ltrim(env));
+    if (frame->nb_elems > 0) {
+        uint32_t last_indent = yaml_env_get_column_nb(env);
+
+        if (ps_done(&env->ps) || last_indent < frame->indent) {
+            yaml_env_stream_end(env, YAML_EVENT_SEQ_END, event);
+            return 0;
+        }
+        if (last_indent > frame->indent) {
+            return yaml_env_set_err(env, YAML_ERR_WRONG_INDENT,
+                                    "line not aligned with current sequence");
+        }
+        if (!ps_startswith_yaml_seq_prefix(&env->ps)) {
+            /* the next field has the same indentation as the sequence */
+            yaml_env_stream_end(env, YAML_EVENT_SEQ_END, event);
+            return 0;
+        }
+    }
+    frame->nb_elems++;
+
+    /* skip '-' */
+    yaml_env_skipc(env);
+    return yaml_env_stream_block_data(env, frame->indent + 1, event);
+}
+
+/* Equivalent of an iteration of t_yaml_env_parse_obj. */
+static int yaml_env_stream_block_obj(yaml_parse_t * nonnull env,
+                                     yaml_stream_frame_t * nonnull frame,
+                                     yaml_event_t * nonnull event)
+{
+    yaml_stream_t *stream = env->stream;
+
+    RETHROW(yaml_env_ltrim(env));
+    if (frame->nb_elems > 0) {
+        uint32_t last_indent = yaml_env_get_column_nb(env);
+
+        if (ps_done(&env->ps) || last_indent < frame->indent) {
+            yaml_env_stream_end(env, YAML_EVENT_OBJ_END, event);
+            return 0;
+        }
+        if (last_indent > frame->indent) {
+            return yaml_env_set_err(env, YAML_ERR_WRONG_INDENT,
+                                    "line not aligned with current object");
+        }
+    }
+    RETHROW(yaml_env_stream_key(env, frame, event));
+
+    /* A sequence can have the same indentation as its key, see
+     * t_yaml_env_parse_obj. */
+    RETHROW(yaml_env_ltrim(env));
+    stream->expect = YAML_STREAM_EXPECT_BLOCK_DATA;
+    stream->min_indent = frame->indent;
+    if (!ps_startswith_yaml_seq_prefix(&env->ps)) {
+        stream->min_indent++;
+    }
+    return 0;
+}
+
+/* Equivalent of an iteration of t_yaml_env_parse_flow_seq. */
+static int yaml_env_stream_flow_seq(yaml_parse_t * nonnull env,
+                                    yaml_stream_frame_t * nonnull frame,
+                                    yaml_event_t * nonnull event)
+{
+    RETHROW(yaml_env_ltrim(env));
+    if (frame->nb_elems > 0) {
+        switch (ps_peekc(env->ps)) {
+          case ']':
+            break;
+          case ',':
+            yaml_env_skipc(env);
+            RETHROW(yaml_env_ltrim(env));
+            break;
+          default:
+            return yaml_env_set_err(env, YAML_ERR_WRONG_DATA,
+                                    "expected another element of sequence");
+        }
+    }
+    if (ps_peekc(env->ps) == ']') {
+        yaml_env_skipc(env);
+        yaml_env_stream_end(env, YAML_EVENT_SEQ_END, event);
+        return 0;
+    }
+    frame->nb_elems++;
+
+    if (ps_startswith_yaml_key(env->ps)) {
+        yaml_env_stream_start(env, YAML_STREAM_FLOW_PAIR, 0,
+                              yaml_env_get_pos(env), event);
+        return 0;
+    }
+    return yaml_env_stream_flow_data(env, event);
+}
+
+/* Equivalent of an iteration of t_yaml_env_parse_flow_obj. */
+static int yaml_env_stream_flow_obj(yaml_parse_t * nonnull env,
+                                    yaml_stream_frame_t * nonnull frame,
+                                    yaml_event_t * nonnull event)
+{
+    RETHROW(yaml_env_ltrim(env));
+    if (frame->nb_elems > 0) {
+        switch (ps_peekc(env->ps)) {
+          case '}':
+            break;
+          case ',':
+            yaml_env_skipc(env);
+            RETHROW(yaml_env_ltrim(env));
+            break;
+          default:
+            return yaml_env_set_err(env, YAML_ERR_WRONG_DATA,
+                                    "expected another element of object");
+        }
+    }
+    if (ps_peekc(env->ps) == '}') {
+        yaml_env_skipc(env);
+        yaml_env_stream_end(env, YAML_EVENT_OBJ_END, event);
+        return 0;
+    }
+
+    if (!ps_startswith_yaml_key(env->ps)) {
+        if (ps_done(&env->ps)) {
+            return yaml_env_set_err(env, YAML_ERR_MISSING_DATA,
+                                    "unexpected end of line");
+        }
+        return yaml_env_set_err(env, YAML_ERR_WRONG_DATA,
+                                "only key-value mappings are allowed inside "
+                                "an object");
+    }
+    RETHROW(yaml_env_stream_key(env, frame, event));
+    env->stream->expect = YAML_STREAM_EXPECT_FLOW_DATA;
+
+    return 0;
+}
+
+static int yaml_env_stream_next(yaml_parse_t * nonnull env,
+                                yaml_event_t * nonnull event)
+{
+    yaml_stream_t *stream = env->stream;
+    yaml_stream_frame_t *frame;
+
+    switch (stream->expect) {
+      case YAML_STREAM_EXPECT_BLOCK_DATA:
+        stream->expect = YAML_STREAM_EXPECT_NONE;
+        return yaml_env_stream_block_data(env, stream->min_indent, event);
+
+      case YAML_STREAM_EXPECT_FLOW_DATA:
+        stream->expect = YAML_STREAM_EXPECT_NONE;
+        return yaml_env_stream_flow_data(env, event);
+
+      case YAML_STREAM_EXPECT_NONE:
+        break;
+    }
+
+    if (stream->depth == 0) {
+        yaml_pos_t pos;
+
+        if (!stream->done) {
+            RETHROW(yaml_env_ltrim(env));
+            if (!ps_done(&env->ps)) {
+                return yaml_env_set_err(env, YAML_ERR_EXTRA_DATA,
+                                        "expected end of document");
+            }
+            stream->done = true;
+        }
+        pos = yaml_env_get_pos(env);
+        event->type = YAML_EVENT_DOC_END;
+        yaml_span_init(&event->span, env, pos, pos);
+        return 0;
+    }
+
+    frame = &stream->frames.tab[stream->depth - 1];
+    switch (frame->type) {
+      case YAML_STREAM_BLOCK_SEQ:
+        return yaml_env_stream_block_seq(env, frame, event);
+
+      case YAML_STREAM_BLOCK_OBJ:
+        return yaml_env_stream_block_obj(env, frame, event);
+
+      case YAML_STREAM_FLOW_SEQ:
+        return yaml_env_stream_flow_seq(env, frame, event);
+
+      case YAML_STREAM_FLOW_OBJ:
+        return yaml_env_stream_flow_obj(env, frame, event);
+
+      case YAML_STREAM_FLOW_PAIR:
+        if (frame->nb_elems == 0) {
+            RETHROW(yaml_env_stream_key(env, frame, event));
+            stream->expect = YAML_STREAM_EXPECT_FLOW_DATA;
+        } else {
+            yaml_env_stream_end(env, YAML_EVENT_OBJ_END, event);
+        }
+        return 0;
+    }
+
+    assert (false);
+    return -1;
+}
+
+int yaml_parse_next_event(yaml_parse_t *env, yaml_event_t *event,
+                          sb_t *out_err)
+{
+    assert (env->ps.s && "yaml_parse_attach_ps/file must be called first");
+    assert (!(env->flags & YAML_PARSE_GEN_PRES_DATA));
+
+    if (!env->stream) {
+        env->stream = yaml_stream_new();
+    }
+
+    p_clear(event, 1);
+    if (yaml_env_stream_next(env, event) < 0) {
+        sb_setsb(out_err, &env->err);
+        return -1;
+    }
+
+    return 0;
+}
+
 /* }}} */
 /* {{{ Parser public API */
 /* {{{ t_yaml_data_get_presentation */
@@ -3071,6 +3670,7 @@ void yaml_parse_delete(yaml_parse_t **env)
     }
     lstr_wipe(&(*env)->file_contents);
     qv_deep_clear(&(*env)->subfiles, yaml_parse_delete);
+    yaml_stream_delete(&(*env)->stream);
 }
 
 void yaml_parse_attach_ps(yaml_parse_t *env, pstream_t ps)
@@ -3395,6 +3995,33 @@ typedef enum yaml_pack_state_t {
 qm_kvec_t(path_to_checksum, lstr_t, uint64_t, qhash_lstr_hash,
           qhash_lstr_equal);
 
+typedef enum yaml_pack_frame_kind_t {
+    PACK_FRAME_SEQ,
+    PACK_FRAME_OBJ,
+
+    /* A key of an object or an element of a sequence. */
+    PACK_FRAME_ENTRY,
+} yaml_pack_frame_kind_t;
+
+/* Node being written by the streaming packer. */
+typedef struct yaml_pack_frame_t {
+    yaml_pack_frame_kind_t kind;
+
+    /* Whether presentation nodes exist below the path of the node. */
+    bool has_pres;
+
+    /* Number of entries written in a sequence or an object. */
+    int nb_entries;
+
+    /* Length of the path before the node was opened. */
+    int path_len;
+
+    /* Presentation of a sequence or an object, its inline comment is
+     * written once it is closed. */
+    const yaml__presentation_node__t * nullable node;
+} yaml_pack_frame_t;
+qvector_t(yaml_pack_frame, yaml_pack_frame_t);
+
 typedef struct yaml_pack_env_t {
     /* Write callback + priv data. */
     yaml_pack_writecb_f *write_cb;
@@ -3469,6 +4096,12 @@ typedef struct yaml_pack_env_t {
      * order.
      */
     qv_t(active_vars) active_vars;
+
+    /** Stack of the nodes opened by the streaming packer. */
+    qv_t(yaml_pack_frame) frames;
+
+    /** Whether a write failed. */
+    bool write_failed;
 } yaml_pack_env_t;
 
 /* }}} */
@@ -3491,6 +4124,7 @@ static int do_write(yaml_pack_env_t *env, const void *_buf, int len)
             if (ERR_RW_RETRIABLE(errno)) {
                 continue;
             }
+            env->write_failed = true;
             return -1;
         }
         pos += res;
@@ -3511,6 +4145,7 @@ static int do_indent(yaml_pack_env_t *env)
             if (ERR_RW_RETRIABLE(errno)) {
                 continue;
             }
+            env->write_failed = true;
             return -1;
         }
         todo -= res;
@@ -3673,12 +4308,31 @@ t_yaml_doc_pres_to_map(const yaml__document_presentation__t *doc_pres)
     yaml_presentation_t *pres = t_new(yaml_presentation_t, 1);
 
     t_qm_init(yaml_pres_node, &pres->nodes, 0);
+    t_qh_init(lstr, &pres->prefixes, 0);
+    pres->can_stream = true;
     tab_for_each_ptr(mapping, &doc_pres->mappings) {
+        const yaml__presentation_node__t *node = &mapping->node;
+        lstr_t path = mapping->path;
         int res;
 
-        res = qm_add(yaml_pres_node, &pres->nodes, &mapping->path,
-                     &mapping->node);
+        res = qm_add(yaml_pres_node, &pres->nodes, &path, node);
         assert (res >= 0);
+
+        /* Index the paths of all the parents of the node. The keys can
+         * contain the separators, which only adds useless prefixes. */
+        for (int i = 0; i < path.len; i++) {
+            if (path.s[i] == '.' || path.s[i] == '[' || path.s[i] == '!') {
+                lstr_t prefix = LSTR_INIT_V(path.s, i);
+
+                qh_add(lstr, &pres->prefixes, &prefix);
+            }
+        }
+
+        if (node->flow_mode || node->included || node->tpl
+        ||  node->merge_key)
+        {
+            pres->can_stream = false;
+        }
     }
 
     return pres;
@@ -5555,6 +6209,246 @@ static int t_yaml_pack_data(yaml_pack_env_t * nonnull env,
     return res;
 }
 
+/* }}} */
+/* {{{ Streaming pack */
+
+/* The streaming packer writes the same output as t_yaml_pack_data, the
+ * lookups of presentation being restricted to the paths indexed in
+ * yaml_presentation_t::prefixes.
+ */
+
+static bool yaml_pack_stream_has_pres(const yaml_pack_env_t * nonnull env)
+{
+    if (env->frames.len > 0) {
+        return tab_last(&env->frames)->has_pres;
+    }
+    return env->pres && qh_len(lstr, &env->pres->prefixes) > 0;
+}
+
+static bool yaml_pack_stream_path_has_pres(const yaml_pack_env_t *env)
+{
+    lstr_t path = yaml_pack_env_get_curpath(env);
+
+    return qh_find_safe(lstr, &env->pres->prefixes, &path) >= 0;
+}
+
+/* Apply the presentation of the data itself, see t_yaml_pack_data. */
+static int
+yaml_pack_stream_data_start(yaml_pack_env_t * nonnull env, const lstr_t tag,
+                            const yaml__presentation_node__t **node)
+{
+    int res = 0;
+
+    *node = NULL;
+    if (yaml_pack_stream_has_pres(env)) {
+        int path_len = env->absolute_path.len;
+
+        sb_addc(&env->absolute_path, '!');
+        *node = yaml_pack_env_get_pres_node(env);
+        sb_clip(&env->absolute_path, path_len);
+    }
+
+    res += RETHROW(yaml_pack_pres_node_prefix(env, *node));
+    res += RETHROW(yaml_pack_tag(env, tag));
+
+    return res;
+}
+
+/* Close the key or the sequence element whose data was written. */
+static void yaml_pack_stream_close_entry(yaml_pack_env_t * nonnull env)
+{
+    yaml_pack_frame_t *frame;
+
+    if (env->frames.len == 0) {
+        return;
+    }
+    frame = tab_last(&env->frames);
+    if (frame->kind != PACK_FRAME_ENTRY) {
+        return;
+    }
+
+    env->indent_lvl -= YAML_STD_INDENT;
+    sb_clip(&env->absolute_path, frame->path_len);
+    qv_remove_last(&env->frames);
+}
+
+/* Open a key (when key.s is set) or a sequence element, see
+ * t_yaml_pack_key_data and t_yaml_pack_seq. */
+static int
+t_yaml_pack_stream_entry(yaml_pack_env_t * nonnull env, const lstr_t key)
+{
+    const yaml__presentation_node__t *node = NULL;
+    yaml_pack_frame_t *parent;
+    yaml_pack_frame_t *frame;
+    int path_len = env->absolute_path.len;
+    bool has_pres;
+    int res = 0;
+
+    yaml_pack_stream_close_entry(env);
+    assert (env->frames.len > 0);
+    parent = tab_last(&env->frames);
+    assert (parent->kind == (key.s ? PACK_FRAME_OBJ : PACK_FRAME_SEQ));
+
+    has_pres = parent->has_pres;
+    if (has_pres) {
+        if (key.s) {
+            sb_addc(&env->absolute_path, '.');
+            sb_add_lstr(&env->absolute_path, key);
+        } else {
+            sb_addf(&env->absolute_path, "[%d]", parent->nb_entries);
+        }
+        node = yaml_pack_env_get_pres_node(env);
+        has_pres = yaml_pack_stream_path_has_pres(env);
+    }
+    parent->nb_entries++;
+
+    frame = qv_growlen0(&env->frames, 1);
+    frame->kind = PACK_FRAME_ENTRY;
+    frame->has_pres = has_pres;
+    frame->path_len = path_len;
+
+    res += RETHROW(yaml_pack_pres_node_prefix(env, node));
+    if (key.s) {
+        GOTO_STATE(ON_KEY);
+        PUTLSTR(key);
+        PUTS(":");
+    } else {
+        GOTO_STATE(ON_DASH);
+        PUTS("-");
+    }
+
+    env->indent_lvl += YAML_STD_INDENT;
+    res += RETHROW(yaml_pack_pres_node_inline(env, node));
+
+    return res;
+}
+
+static int
+t_yaml_pack_stream_open(yaml_pack_env_t * nonnull env,
+                        yaml_pack_frame_kind_t kind, const lstr_t tag)
+{
+    const yaml__presentation_node__t *node;
+    yaml_pack_frame_t *frame;
+    bool has_pres = yaml_pack_stream_has_pres(env);
+    int res = 0;
+
+    res += RETHROW(yaml_pack_stream_data_start(env, tag, &node));
+
+    frame = qv_growlen0(&env->frames, 1);
+    frame->kind = kind;
+    frame->has_pres = has_pres;
+    frame->path_len = env->absolute_path.len;
+    frame->node = node;
+
+    return res;
+}
+
+static int
+yaml_pack_stream_close(yaml_pack_env_t * nonnull env,
+                       yaml_pack_frame_kind_t kind)
+{
+    const yaml__presentation_node__t *node;
+    yaml_pack_frame_t *frame;
+    int res = 0;
+
+    yaml_pack_stream_close_entry(env);
+    assert (env->frames.len > 0);
+    frame = tab_last(&env->frames);
+    assert (frame->kind == kind);
+
+    if (frame->nb_entries == 0) {
+        GOTO_STATE(CLEAN);
+        PUTS(kind == PACK_FRAME_SEQ ? "[]" : "{}");
+        env->state = PACK_STATE_AFTER_DATA;
+    }
+    node = frame->node;
+    qv_remove_last(&env->frames);
+
+    res += RETHROW(yaml_pack_pres_node_inline(env, node));
+
+    return res;
+}
+
+bool yaml_pack_env_can_stream(const yaml_pack_env_t * nonnull env)
+{
+    return env->overrides.len == 0 && (!env->pres || env->pres->can_stream);
+}
+
+void t_yaml_pack_stream_start(yaml_pack_env_t * nonnull env,
+                              yaml_pack_writecb_f * nonnull writecb,
+                              void * nullable priv)
+{
+    assert (yaml_pack_env_can_stream(env));
+    env->write_cb = writecb;
+    env->priv = priv;
+    env->write_failed = false;
+    qv_clear(&env->frames);
+}
+
+int t_yaml_pack_stream_scalar(yaml_pack_env_t * nonnull env,
+                              const yaml_scalar_t * nonnull scalar,
+                              lstr_t tag)
+{
+    const yaml__presentation_node__t *node;
+    int res = 0;
+
+    if (unlikely(scalar->type == YAML_SCALAR_BYTES)) {
+        tag = LSTR("bin");
+    }
+
+    res += RETHROW(yaml_pack_stream_data_start(env, tag, &node));
+    res += RETHROW(yaml_pack_scalar(env, scalar, tag, node));
+    res += RETHROW(yaml_pack_pres_node_inline(env, node));
+
+    return res;
+}
+
+int t_yaml_pack_stream_seq_start(yaml_pack_env_t * nonnull env,
+                                 const lstr_t tag)
+{
+    return t_yaml_pack_stream_open(env, PACK_FRAME_SEQ, tag);
+}
+
+int t_yaml_pack_stream_seq_elem(yaml_pack_env_t * nonnull env)
+{
+    return t_yaml_pack_stream_entry(env, LSTR_NULL_V);
+}
+
+int t_yaml_pack_stream_seq_end(yaml_pack_env_t * nonnull env)
+{
+    return yaml_pack_stream_close(env, PACK_FRAME_SEQ);
+}
+
+int t_yaml_pack_stream_obj_start(yaml_pack_env_t * nonnull env,
+                                 const lstr_t tag)
+{
+    return t_yaml_pack_stream_open(env, PACK_FRAME_OBJ, tag);
+}
+
+int t_yaml_pack_stream_key(yaml_pack_env_t * nonnull env, const lstr_t key)
+{
+    assert (key.s);
+    return t_yaml_pack_stream_entry(env, key);
+}
+
+int t_yaml_pack_stream_obj_end(yaml_pack_env_t * nonnull env)
+{
+    return yaml_pack_stream_close(env, PACK_FRAME_OBJ);
+}
+
+int yaml_pack_stream_end(yaml_pack_env_t * nonnull env, sb_t * nullable err)
+{
+    if (env->write_failed) {
+        if (err) {
+            sb_setsb(err, &env->err);
+        }
+        return -1;
+    }
+    assert (env->frames.len == 0);
+
+    return 0;
+}
+
 #undef WRITE
 #undef PUTS
 #undef PUTLSTR
@@ -5578,6 +6472,7 @@ yaml_pack_env_t * nonnull t_yaml_pack_env_new(void)
     t_sb_init(&env->err, 1024);
     t_qv_init(&env->overrides, 0);
     t_qv_init(&env->active_vars, 0);
+    t_qv_init(&env->frames, 0);
 
     return env;
 }
@@ -5851,6 +6746,98 @@ static int z_yaml_test_parse_fail(unsigned flags,
     Z_HELPER_END;
 }
 
+/* Describe the events of the streaming parser in a flow-like syntax. */
+static void z_yaml_add_event(sb_t *out, const yaml_event_t *event)
+{
+    if (out->len > 0) {
+        sb_addc(out, ' ');
+    }
+    if (event->tag.s) {
+        sb_addf(out, "!%pL ", &event->tag);
+    }
+
+    switch (event->type) {
+      case YAML_EVENT_SCALAR:
+        switch (event->scalar.type) {
+          case YAML_SCALAR_STRING:
+            sb_add_lstr(out, event->scalar.s);
+            break;
+          case YAML_SCALAR_BYTES:
+            sb_addf(out, "bin:%pL", &event->scalar.s);
+            break;
+          case YAML_SCALAR_NULL:
+            sb_addc(out, '~');
+            break;
+          default:
+            sb_add_lstr(out, yaml_span_to_lstr(&event->span));
+            break;
+        }
+        break;
+      case YAML_EVENT_SEQ_START:
+        sb_addc(out, '[');
+        break;
+      case YAML_EVENT_SEQ_END:
+        sb_addc(out, ']');
+        break;
+      case YAML_EVENT_OBJ_START:
+        sb_addc(out, '{');
+        break;
+      case YAML_EVENT_KEY:
+        sb_addf(out, "%pL:", &event->key);
+        break;
+      case YAML_EVENT_OBJ_END:
+        sb_addc(out, '}');
+        break;
+      case YAML_EVENT_DOC_END:
+        sb_adds(out, "EOF");
+        break;
+    }
+}
+
+static int z_yaml_test_stream(const char *yaml, const char *expected_events)
+{
+    t_scope;
+    yaml_parse_t *env = t_yaml_parse_new(0);
+    yaml_event_t event;
+    SB_1k(events);
+    SB_1k(err);
+
+    yaml_parse_attach_ps(env, ps_initstr(yaml));
+    do {
+        Z_ASSERT_N(yaml_parse_next_event(env, &event, &err),
+                   "cannot parse `%s`: %pL", yaml, &err);
+        z_yaml_add_event(&events, &event);
+    } while (event.type != YAML_EVENT_DOC_END);
+    Z_ASSERT_STREQUAL(events.data, expected_events,
+                      "wrong events on yaml string `%s`", yaml);
+
+    /* The end of the document is returned again. */
+    Z_ASSERT_N(yaml_parse_next_event(env, &event, &err));
+    Z_ASSERT_EQ(event.type, YAML_EVENT_DOC_END);
+    yaml_parse_delete(&env);
+
+    Z_HELPER_END;
+}
+
+static int z_yaml_test_stream_fail(const char *yaml, const char *expected_err)
+{
+    t_scope;
+    yaml_parse_t *env = t_yaml_parse_new(0);
+    yaml_event_t event;
+    SB_1k(err);
+
+    yaml_parse_attach_ps(env, ps_initstr(yaml));
+    while (yaml_parse_next_event(env, &event, &err) >= 0) {
+        Z_ASSERT(event.type != YAML_EVENT_DOC_END,
+                 "parsing of `%s` did not fail", yaml);
+    }
+    Z_ASSERT_STREQUAL(err.data, expected_err,
+                      "wrong error message on yaml string `%s`", yaml);
+    yaml_parse_delete(&env);
+
+    Z_HELPER_END;
+}
+
 static int
 z_create_tmp_subdir(const char *dirpath)
 {
@@ -10624,6 +11611,90 @@ Z_GROUP_EXPORT(yaml)
         ));
     } Z_TEST_END;
 
+    /* }}} */
+    /* {{{ Streaming */
+
+    Z_TEST(streaming, "test the streaming parser") {
+        Z_HELPER_RUN(z_yaml_test_stream("", "~ EOF"));
+        Z_HELPER_RUN(z_yaml_test_stream("# comment\nfoo  ", "foo EOF"));
+        Z_HELPER_RUN(z_yaml_test_stream("[]", "[ ] EOF"));
+
+        Z_HELPER_RUN(z_yaml_test_stream(
+            "a: 1\n"
+            "b:\n"
+            "- !bin Zm9v\n"
+            "- \"s\\n\"\n"
+            "-\n"
+            "c: { d: [ 1, e: 2, ], f: {} }\n"
+            "g: !tag\n"
+            "  h: ~\n"
+            "  i: -2.5\n",
+
+            "{ a: 1 b: [ bin:foo s\n ~ ] c: { d: [ 1 { e: 2 } ] f: { } } "
+            "g: !tag { h: ~ i: -2.5 } } EOF"
+        ));
+        Z_HELPER_RUN(z_yaml_test_stream(
+            "- - 1\n"
+            "  - a: [ b, c ]\n"
+            "    d:\n"
+            "- 3",
+
+            "[ [ 1 { a: [ b c ] d: ~ } ] 3 ] EOF"
+        ));
+
+        /* Same errors as the AST parser. */
+        Z_HELPER_RUN(z_yaml_test_stream_fail(
+            "a: 1\na: 2",
+
+            "<string>:2:1: invalid key, key is already declared in the "
+            "object\n"
+            "a: 2\n"
+            "^"
+        ));
+        Z_HELPER_RUN(z_yaml_test_stream_fail(
+            "a:\n  - 1\n   - 2",
+
+            "<string>:3:4: wrong indentation, "
+            "line not aligned with current sequence\n"
+            "   - 2\n"
+            "   ^"
+        ));
+        Z_HELPER_RUN(z_yaml_test_stream_fail(
+            "[ 1 ] 2",
+
+            "<string>:1:7: extra characters after data, "
+            "expected end of document\n"
+            "[ 1 ] 2\n"
+            "      ^"
+        ));
+
+        /* Features needing the AST. */
+        Z_HELPER_RUN(z_yaml_test_stream_fail(
+            "a: !include:b.yml",
+
+            "<string>:1:4: invalid include, "
+            "cannot use includes in streaming mode\n"
+            "a: !include:b.yml\n"
+            "   ^^^^^^^^^^^^^^"
+        ));
+        Z_HELPER_RUN(z_yaml_test_stream_fail(
+            "<<: { a: 1 }",
+
+            "<string>:1:1: invalid key, "
+            "cannot use merge keys in streaming mode\n"
+            "<<: { a: 1 }\n"
+            "^^"
+        ));
+        Z_HELPER_RUN(z_yaml_test_stream_fail(
+            "a: \"$(b)\"",
+
+            "<string>:1:4: use of variables is forbidden, "
+            "cannot use variables in streaming mode\n"
+            "a: \"$(b)\"\n"
+            "   ^^^^^^"
+        ));
+    } Z_TEST_END;
+
     /* }}} */
 
     MODULE_RELEASE(yaml);
@@ -17,6 +17,9 @@
 /***************************************************************************/
 
 #include <lib-common/zlib-wrapper.h>
+#include <lib-common/arith.h>
+#include <lib-common/hash.h>
+#include <lib-common/thr.h>
 
 ssize_t sb_add_compressed(sb_t *out, const void *data, size_t dlen,
                           int level, bool do_gzip)
@@ -52,3 +55,179 @@ ssize_t sb_add_compressed(sb_t *out, const void *data, size_t dlen,
         }
     }
 }
+
+/* {{{ Parallel compression */
+
+/* Each block is deflated in a raw deflate stream primed with the 32KB
+ * that precede it. All the blocks but the last one are ended by a sync
+ * flush, which byte-aligns them with an empty stored block and does not
+ * set the "last block" bit, so that they can be concatenated. The check
+ * value of each block is computed along, and combined in the trailer.
+ */
+typedef struct zlib_mt_block_t {
+    thr_job_t      job;
+    const uint8_t *data;
+    size_t         len;
+    size_t         dict_len;
+    int            level;
+    bool           last;
+    bool           do_gzip;
+    int            err;
+    uint32_t       check;
+    sb_t           out;
+} zlib_mt_block_t;
+
+static void zlib_mt_block_run(thr_job_t *job, thr_syn_t *syn)
+{
+    zlib_mt_block_t *blk = container_of(job, zlib_mt_block_t, job);
+    z_stream stream = {
+        .next_in   = (Bytef *)blk->data,
+        .avail_in  = blk->len,
+    };
+    int flush = blk->last ? Z_FINISH : Z_SYNC_FLUSH;
+
+    sb_init(&blk->out);
+    blk->err = deflateInit2(&stream, blk->level, Z_DEFLATED, -MAX_WBITS,
+                            MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+    if (blk->err != Z_OK) {
+        return;
+    }
+    if (blk->dict_len) {
+        deflateSetDictionary(&stream, blk->data - blk->dict_len,
+                             blk->dict_len);
+    }
+
+    for (;;) {
+        /* deflateBound() does not account for the sync flush marker. */
+        stream.next_out  = (Bytef *)sb_grow(&blk->out,
+                                            deflateBound(&stream,
+                                                         stream.avail_in)
+                                            + 16);
+        stream.avail_out = sb_avail(&blk->out);
+
+        blk->err = deflate(&stream, flush);
+        __sb_fixlen(&blk->out, stream.total_out);
+        if (blk->err == Z_STREAM_END
+        ||  (blk->err == Z_OK && !stream.avail_in && stream.avail_out))
+        {
+            blk->err = Z_OK;
+            break;
+        }
+        if (blk->err != Z_OK) {
+            break;
+        }
+    }
+    IGNORE(deflateEnd(&stream));
+
+    if (blk->do_gzip) {
+        blk->check = icrc32(0, blk->data, blk->len);
+    } else {
+        blk->check = adler32(1, blk->data, blk->len);
+    }
+}
+
+static void zlib_mt_put_header(sb_t *out, int level, bool do_gzip)
+{
+    if (do_gzip) {
+        /* No name nor timestamp, unknown OS. */
+        static const uint8_t gz_header[] = {
+            0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 0, 0xff,
+        };
+
+        sb_add(out, gz_header, sizeof(gz_header));
+    } else {
+        /* 32KB window, and the level in the FLEVEL bits as zlib does. */
+        uint16_t hdr = ((Z_DEFLATED | ((MAX_WBITS - 8) << 4)) << 8);
+
+        if (level == Z_DEFAULT_COMPRESSION || level == 6) {
+            hdr |= 2 << 6;
+        } else
+        if (level >= 7) {
+            hdr |= 3 << 6;
+        } else
+        if (level >= 2) {
+            hdr |= 1 << 6;
+        }
+        hdr += 31 - hdr % 31;
+        sb_add_be16(out, hdr);
+    }
+}
+
+ssize_t sb_add_compressed_mt(sb_t *out, const void *data, size_t dlen,
+                             int level, bool do_gzip, size_t block_size)
+{
+    sb_t orig = *out;
+    const uint8_t *p = data;
+    size_t nb_blocks;
+    size_t batch;
+    zlib_mt_block_t *blocks;
+    uint32_t check = do_gzip ? 0 : 1;
+    int err = Z_OK;
+
+    block_size = MAX(block_size ?: ZLIB_MT_BLOCK_SIZE, 32u << 10);
+    if (dlen <= block_size || !MODULE_IS_LOADED(thr)) {
+        return sb_add_compressed(out, data, dlen, level, do_gzip);
+    }
+
+    nb_blocks = DIV_ROUND_UP(dlen, block_size);
+    /* The blocks are compressed by batches, so that only a part of the
+     * output is held by the jobs on large inputs. */
+    batch = MIN(nb_blocks, 4 * thr_parallelism_g);
+    blocks = p_new(zlib_mt_block_t, batch);
+
+    zlib_mt_put_header(out, level, do_gzip);
+    for (size_t start = 0; start < nb_blocks; start += batch) {
+        size_t end = MIN(start + batch, nb_blocks);
+        thr_syn_t syn;
+
+        thr_syn_init(&syn);
+        for (size_t i = start; i < end; i++) {
+            zlib_mt_block_t *blk = &blocks[i - start];
+
+            p_clear(blk, 1);
+            blk->job.run  = &zlib_mt_block_run;
+            blk->data     = p + i * block_size;
+            blk->len      = MIN(block_size, dlen - i * block_size);
+            blk->dict_len = i ? 32 << 10 : 0;
+            blk->level    = level;
+            blk->last     = i == nb_blocks - 1;
+            blk->do_gzip  = do_gzip;
+            thr_syn_schedule(&syn, &blk->job);
+        }
+        thr_syn_wait(&syn);
+        thr_syn_wipe(&syn);
+
+        for (size_t i = start; i < end; i++) {
+            zlib_mt_block_t *blk = &blocks[i - start];
+
+            if (blk->err != Z_OK) {
+                err = err ?: blk->err;
+            } else
+            if (!err) {
+                sb_addsb(out, &blk->out);
+                if (do_gzip) {
+                    check = icrc32_combine(check, blk->check, blk->len);
+                } else {
+                    check = adler32_combine(check, blk->check, blk->len);
+                }
+            }
+            sb_wipe(&blk->out);
+        }
+        if (err) {
+            p_delete(&blocks);
+            __sb_rewind_adds(out, &orig);
+            return err;
+        }
+    }
+    p_delete(&blocks);
+
+    if (do_gzip) {
+        sb_add_le32(out, check);
+        sb_add_le32(out, dlen);
+    } else {
+        sb_add_be32(out, check);
+    }
+    return out->len - orig.len;
+}
+
+/* }}} */
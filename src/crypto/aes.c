@@ -37,6 +37,14 @@
 
 #include <lib-common/hash.h>
 
+#ifdef __HAS_CPUID
+#   pragma push_macro("__leaf")
+#   undef __leaf
+#   include <cpuid.h>
+#   include <x86intrin.h>
+#   pragma pop_macro("__leaf")
+#endif
+
 /*
  * Forward S-box
  */
@@ -494,6 +502,141 @@ void aes_setkey_dec(aes_ctx *ctx, const byte *key, int keysize)
                  RT3[ (Y0 >> 24) & 0xFF ];    \
 }
 
+/* {{{ AES-NI */
+
+#ifdef __HAS_CPUID
+
+static bool aes_has_aesni(void)
+{
+    static int has_aesni = -1;
+
+    if (unlikely(has_aesni < 0)) {
+        int eax, ebx, ecx, edx;
+
+        __cpuid(1, eax, ebx, ecx, edx);
+        has_aesni = !!(ecx & bit_AES);
+    }
+    return has_aesni;
+}
+
+static bool aes_has_pclmul(void)
+{
+    static int has_pclmul = -1;
+
+    if (unlikely(has_pclmul < 0)) {
+        int eax, ebx, ecx, edx;
+
+        __cpuid(1, eax, ebx, ecx, edx);
+        has_pclmul = !!(ecx & bit_PCLMUL);
+    }
+    return has_pclmul;
+}
+
+/* The round keys computed by aes_setkey_enc() and aes_setkey_dec() are
+ * exactly the ones expected by the AES-NI instructions: the decryption
+ * keys are the ones of the equivalent inverse cipher. */
+__attribute__((target("aes,sse2")))
+static ALWAYS_INLINE void aesni_load_keys(const aes_ctx *ctx, __m128i rk[15])
+{
+    rk[0] = _mm_loadu_si128((const __m128i *)ctx->rk);
+    for (int i = 1; i <= ctx->nr; i++) {
+        rk[i] = _mm_loadu_si128((const __m128i *)(ctx->rk + 4 * i));
+    }
+}
+
+/* Encrypts (or decrypts) `n` blocks at once, so that the instructions of
+ * the independent blocks are pipelined. */
+__attribute__((target("aes,sse2")))
+static ALWAYS_INLINE void aesni_crypt_blocks(const __m128i rk[15], int nr,
+                                            int mode, __m128i *b, int n)
+{
+    for (int i = 0; i < n; i++) {
+        b[i] = _mm_xor_si128(b[i], rk[0]);
+    }
+    if (mode == AES_DECRYPT) {
+        for (int r = 1; r < nr; r++) {
+            for (int i = 0; i < n; i++) {
+                b[i] = _mm_aesdec_si128(b[i], rk[r]);
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            b[i] = _mm_aesdeclast_si128(b[i], rk[nr]);
+        }
+    } else {
+        for (int r = 1; r < nr; r++) {
+            for (int i = 0; i < n; i++) {
+                b[i] = _mm_aesenc_si128(b[i], rk[r]);
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            b[i] = _mm_aesenclast_si128(b[i], rk[nr]);
+        }
+    }
+}
+
+__attribute__((target("aes,sse2")))
+static void aesni_crypt_ecb(const aes_ctx *ctx, int mode, const byte input[16],
+                            byte output[16])
+{
+    __m128i rk[15];
+    __m128i b = _mm_loadu_si128((const __m128i *)input);
+
+    aesni_load_keys(ctx, rk);
+    aesni_crypt_blocks(rk, ctx->nr, mode, &b, 1);
+    _mm_storeu_si128((__m128i *)output, b);
+}
+
+__attribute__((target("aes,sse2")))
+static void aesni_crypt_cbc(const aes_ctx *ctx, int mode, int length,
+                            byte iv[16], const byte *input, byte *output)
+{
+    __m128i rk[15];
+    __m128i prev = _mm_loadu_si128((const __m128i *)iv);
+
+    aesni_load_keys(ctx, rk);
+
+    if (mode == AES_DECRYPT) {
+        /* Unlike encryption, the decryption of the blocks is independent,
+         * decrypt them 4 by 4. */
+        for (; length >= 64; length -= 64, input += 64, output += 64) {
+            __m128i in[4], b[4];
+
+            for (int i = 0; i < 4; i++) {
+                in[i] = b[i] = _mm_loadu_si128((const __m128i *)input + i);
+            }
+            aesni_crypt_blocks(rk, ctx->nr, AES_DECRYPT, b, 4);
+            b[0] = _mm_xor_si128(b[0], prev);
+            for (int i = 1; i < 4; i++) {
+                b[i] = _mm_xor_si128(b[i], in[i - 1]);
+            }
+            for (int i = 0; i < 4; i++) {
+                _mm_storeu_si128((__m128i *)output + i, b[i]);
+            }
+            prev = in[3];
+        }
+        for (; length > 0; length -= 16, input += 16, output += 16) {
+            __m128i in = _mm_loadu_si128((const __m128i *)input);
+            __m128i b = in;
+
+            aesni_crypt_blocks(rk, ctx->nr, AES_DECRYPT, &b, 1);
+            _mm_storeu_si128((__m128i *)output, _mm_xor_si128(b, prev));
+            prev = in;
+        }
+    } else {
+        for (; length > 0; length -= 16, input += 16, output += 16) {
+            prev = _mm_xor_si128(prev,
+                                 _mm_loadu_si128((const __m128i *)input));
+            aesni_crypt_blocks(rk, ctx->nr, AES_ENCRYPT, &prev, 1);
+            _mm_storeu_si128((__m128i *)output, prev);
+        }
+    }
+    _mm_storeu_si128((__m128i *)iv, prev);
+}
+
+#endif
+
+/* }}} */
+
 /*
  * AES-ECB block encryption/decryption
  */
@@ -509,6 +652,12 @@ void aes_crypt_ecb(aes_ctx *ctx, int mode, const byte input[16],
             return;
     }
 #endif
+#ifdef __HAS_CPUID
+    if (aes_has_aesni()) {
+        aesni_crypt_ecb(ctx, mode, input, output);
+        return;
+    }
+#endif
 
     RK = ctx->rk;
 
@@ -599,6 +748,12 @@ void aes_crypt_cbc(aes_ctx *ctx, int mode, int length, byte iv[16],
             return;
     }
 #endif
+#ifdef __HAS_CPUID
+    if (aes_has_aesni()) {
+        aesni_crypt_cbc(ctx, mode, length, iv, input, output);
+        return;
+    }
+#endif
 
     if (mode == AES_DECRYPT)
     {
@@ -671,3 +826,505 @@ void aes_crypt_cfb(aes_ctx *ctx, int mode, int length, int *iv_off,
 
     *iv_off = n;
 }
+
+/* {{{ CTR mode */
+
+static void aes_ctr_inc128(byte counter[16])
+{
+    for (int i = 16; i-- > 0; ) {
+        if (++counter[i] != 0) {
+            break;
+        }
+    }
+}
+
+#ifdef __HAS_CPUID
+
+/* Encrypts `nb_blocks` blocks in CTR mode 8 by 8, and returns the number of
+ * blocks it processed. */
+__attribute__((target("aes,sse2")))
+static size_t aesni_crypt_ctr(const aes_ctx *ctx, size_t nb_blocks,
+                              byte nonce_counter[16], const byte *input,
+                              byte *output)
+{
+    __m128i rk[15];
+    uint64_t hi = be_to_cpu64pu(nonce_counter);
+    uint64_t lo = be_to_cpu64pu(nonce_counter + 8);
+    size_t done = 0;
+
+    aesni_load_keys(ctx, rk);
+
+    for (; done + 8 <= nb_blocks; done += 8, input += 128, output += 128) {
+        __m128i b[8];
+
+        for (int i = 0; i < 8; i++) {
+            b[i] = _mm_set_epi64x(bswap64(lo), bswap64(hi));
+            if (++lo == 0) {
+                hi++;
+            }
+        }
+        aesni_crypt_blocks(rk, ctx->nr, AES_ENCRYPT, b, 8);
+        for (int i = 0; i < 8; i++) {
+            __m128i in = _mm_loadu_si128((const __m128i *)input + i);
+
+            _mm_storeu_si128((__m128i *)output + i, _mm_xor_si128(b[i], in));
+        }
+    }
+    put_unaligned_be64(nonce_counter, hi);
+    put_unaligned_be64(nonce_counter + 8, lo);
+    return done;
+}
+
+#endif
+
+/*
+ * AES-CTR buffer encryption/decryption
+ */
+void aes_crypt_ctr(aes_ctx *ctx, size_t length, int *nc_off,
+                   byte nonce_counter[16], byte stream_block[16],
+                   const byte *input, byte *output)
+{
+    int n = *nc_off;
+
+    /* Finish the current block first. */
+    for (; n != 0 && length > 0; length--) {
+        *output++ = *input++ ^ stream_block[n];
+        n = (n + 1) & 0x0F;
+    }
+
+#ifdef __HAS_CPUID
+    if (length >= 128 && aes_has_aesni()) {
+        size_t done = aesni_crypt_ctr(ctx, length / 16, nonce_counter,
+                                      input, output);
+
+        input  += done * 16;
+        output += done * 16;
+        length -= done * 16;
+    }
+#endif
+
+    for (; length > 0; length--) {
+        if (n == 0) {
+            aes_crypt_ecb(ctx, AES_ENCRYPT, nonce_counter, stream_block);
+            aes_ctr_inc128(nonce_counter);
+        }
+        *output++ = *input++ ^ stream_block[n];
+        n = (n + 1) & 0x0F;
+    }
+
+    *nc_off = n;
+}
+
+/* }}} */
+/* {{{ GCM mode */
+
+/* The portable GHASH uses the 4-bits tables method: the multiples of H by
+ * the 16 values of a nibble are precomputed in HL/HH. */
+static const uint64_t gcm_last4[16] = {
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0,
+};
+
+static void gcm_gen_table(aes_gcm_ctx *ctx, const byte h[16])
+{
+    uint32_t hi, lo;
+    uint64_t vh, vl;
+
+    GET_U32_BE(hi, h, 0);
+    GET_U32_BE(lo, h, 4);
+    vh = ((uint64_t)hi << 32) | lo;
+    GET_U32_BE(hi, h, 8);
+    GET_U32_BE(lo, h, 12);
+    vl = ((uint64_t)hi << 32) | lo;
+
+    ctx->HL[8] = vl;
+    ctx->HH[8] = vh;
+    ctx->HL[0] = 0;
+    ctx->HH[0] = 0;
+
+    for (int i = 4; i > 0; i >>= 1) {
+        uint32_t t = (vl & 1) * 0xe1000000U;
+
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ ((uint64_t)t << 32);
+        ctx->HL[i] = vl;
+        ctx->HH[i] = vh;
+    }
+    for (int i = 2; i <= 8; i *= 2) {
+        vh = ctx->HH[i];
+        vl = ctx->HL[i];
+        for (int j = 1; j < i; j++) {
+            ctx->HH[i + j] = vh ^ ctx->HH[j];
+            ctx->HL[i + j] = vl ^ ctx->HL[j];
+        }
+    }
+}
+
+static void gcm_mult_tab(const aes_gcm_ctx *ctx, const byte x[16],
+                         byte output[16])
+{
+    byte lo = x[15] & 0x0f;
+    uint64_t zh = ctx->HH[lo];
+    uint64_t zl = ctx->HL[lo];
+
+    for (int i = 15; i >= 0; i--) {
+        byte hi = x[i] >> 4;
+        byte rem;
+
+        lo = x[i] & 0x0f;
+        if (i != 15) {
+            rem = zl & 0x0f;
+            zl = (zh << 60) | (zl >> 4);
+            zh = (zh >> 4) ^ (gcm_last4[rem] << 48);
+            zh ^= ctx->HH[lo];
+            zl ^= ctx->HL[lo];
+        }
+        rem = zl & 0x0f;
+        zl = (zh << 60) | (zl >> 4);
+        zh = (zh >> 4) ^ (gcm_last4[rem] << 48);
+        zh ^= ctx->HH[hi];
+        zl ^= ctx->HL[hi];
+    }
+
+    PUT_U32_BE(zh >> 32, output, 0);
+    PUT_U32_BE(zh,       output, 4);
+    PUT_U32_BE(zl >> 32, output, 8);
+    PUT_U32_BE(zl,       output, 12);
+}
+
+#ifdef __HAS_CPUID
+
+/* The PCLMUL GHASH works on byte-reflected values, see Intel's "Carry-Less
+ * Multiplication and Its Usage for Computing the GCM Mode" white paper. */
+__attribute__((target("pclmul,ssse3")))
+static ALWAYS_INLINE __m128i gcm_bswap(__m128i x)
+{
+    return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+                                            10, 11, 12, 13, 14, 15));
+}
+
+/* 256-bits carry-less product of `a` and `b`, accumulated in lo/hi. */
+__attribute__((target("pclmul,ssse3")))
+static ALWAYS_INLINE void gcm_clmul_acc(__m128i a, __m128i b,
+                                        __m128i *lo, __m128i *hi)
+{
+    __m128i t0 = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i t1 = _mm_clmulepi64_si128(a, b, 0x10);
+    __m128i t2 = _mm_clmulepi64_si128(a, b, 0x01);
+    __m128i t3 = _mm_clmulepi64_si128(a, b, 0x11);
+
+    t1 = _mm_xor_si128(t1, t2);
+    *lo = _mm_xor_si128(*lo, _mm_xor_si128(t0, _mm_slli_si128(t1, 8)));
+    *hi = _mm_xor_si128(*hi, _mm_xor_si128(t3, _mm_srli_si128(t1, 8)));
+}
+
+/* Reduces a 256-bits product modulo the GCM polynomial. As the reduction
+ * is linear, several products can be summed before being reduced. */
+__attribute__((target("pclmul,ssse3")))
+static ALWAYS_INLINE __m128i gcm_reduce(__m128i lo, __m128i hi)
+{
+    __m128i t7, t8, t9, t2, t4, t5;
+
+    /* Shift the product left by one bit for the reflected values. */
+    t7 = _mm_srli_epi32(lo, 31);
+    t8 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    lo = _mm_or_si128(lo, t7);
+    hi = _mm_or_si128(_mm_or_si128(hi, t8), t9);
+
+    t7 = _mm_slli_epi32(lo, 31);
+    t8 = _mm_slli_epi32(lo, 30);
+    t9 = _mm_slli_epi32(lo, 25);
+    t7 = _mm_xor_si128(_mm_xor_si128(t7, t8), t9);
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    lo = _mm_xor_si128(lo, t7);
+
+    t2 = _mm_srli_epi32(lo, 1);
+    t4 = _mm_srli_epi32(lo, 2);
+    t5 = _mm_srli_epi32(lo, 7);
+    t2 = _mm_xor_si128(_mm_xor_si128(t2, t4), _mm_xor_si128(t5, t8));
+    lo = _mm_xor_si128(lo, t2);
+    return _mm_xor_si128(hi, lo);
+}
+
+__attribute__((target("pclmul,ssse3")))
+static ALWAYS_INLINE __m128i gcm_gfmul(__m128i a, __m128i b)
+{
+    __m128i lo = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+
+    gcm_clmul_acc(a, b, &lo, &hi);
+    return gcm_reduce(lo, hi);
+}
+
+__attribute__((target("pclmul,ssse3")))
+static void gcm_gen_powers_clmul(aes_gcm_ctx *ctx, const byte h[16])
+{
+    __m128i h1 = gcm_bswap(_mm_loadu_si128((const __m128i *)h));
+    __m128i hn = h1;
+
+    for (int i = 0; i < 4; i++) {
+        _mm_storeu_si128((__m128i *)ctx->h_pow[i], hn);
+        hn = gcm_gfmul(hn, h1);
+    }
+}
+
+__attribute__((target("pclmul,ssse3")))
+static void gcm_mult_clmul(const aes_gcm_ctx *ctx, const byte x[16],
+                           byte output[16])
+{
+    __m128i h = _mm_loadu_si128((const __m128i *)ctx->h_pow[0]);
+    __m128i y = gcm_bswap(_mm_loadu_si128((const __m128i *)x));
+
+    _mm_storeu_si128((__m128i *)output, gcm_bswap(gcm_gfmul(y, h)));
+}
+
+/* Encrypts (or decrypts) the blocks of the message 4 by 4: the counter
+ * blocks are encrypted together, and the 4 GHASH products are summed
+ * before a single reduction using the powers of H. Returns the number of
+ * blocks it processed. */
+__attribute__((target("aes,pclmul,sse4.1")))
+static size_t aesni_gcm_crypt(aes_gcm_ctx *ctx, size_t nb_blocks,
+                              const byte *input, byte *output)
+{
+    __m128i rk[15];
+    __m128i hp[4];
+    __m128i yb;
+    __m128i y = gcm_bswap(_mm_loadu_si128((const __m128i *)ctx->ghash));
+    uint32_t ctr;
+    size_t done = 0;
+
+    aesni_load_keys(&ctx->aes, rk);
+    for (int i = 0; i < 4; i++) {
+        hp[i] = _mm_loadu_si128((const __m128i *)ctx->h_pow[i]);
+    }
+    yb = _mm_loadu_si128((const __m128i *)ctx->y);
+    GET_U32_BE(ctr, ctx->y, 12);
+
+    for (; done + 4 <= nb_blocks; done += 4, input += 64, output += 64) {
+        __m128i b[4], c[4];
+        __m128i lo = _mm_setzero_si128();
+        __m128i hi = _mm_setzero_si128();
+
+        for (int i = 0; i < 4; i++) {
+            b[i] = _mm_insert_epi32(yb, bswap32(++ctr), 3);
+        }
+        aesni_crypt_blocks(rk, ctx->aes.nr, AES_ENCRYPT, b, 4);
+        for (int i = 0; i < 4; i++) {
+            __m128i in = _mm_loadu_si128((const __m128i *)input + i);
+            __m128i out = _mm_xor_si128(b[i], in);
+
+            _mm_storeu_si128((__m128i *)output + i, out);
+            c[i] = gcm_bswap(ctx->mode == AES_ENCRYPT ? out : in);
+        }
+
+        c[0] = _mm_xor_si128(c[0], y);
+        for (int i = 0; i < 4; i++) {
+            gcm_clmul_acc(c[i], hp[3 - i], &lo, &hi);
+        }
+        y = gcm_reduce(lo, hi);
+    }
+
+    PUT_U32_BE(ctr, ctx->y, 12);
+    _mm_storeu_si128((__m128i *)ctx->ghash, gcm_bswap(y));
+    return done;
+}
+
+#endif
+
+static void gcm_mult(const aes_gcm_ctx *ctx, const byte x[16],
+                     byte output[16])
+{
+#ifdef __HAS_CPUID
+    if (aes_has_pclmul()) {
+        gcm_mult_clmul(ctx, x, output);
+        return;
+    }
+#endif
+    gcm_mult_tab(ctx, x, output);
+}
+
+/* Hashes `length` bytes of `input`, the last block being padded with
+ * zeros. */
+static void gcm_hash(aes_gcm_ctx *ctx, const byte *input, size_t length)
+{
+    for (; length > 0; ) {
+        size_t len = MIN(length, 16u);
+
+        for (size_t i = 0; i < len; i++) {
+            ctx->ghash[i] ^= input[i];
+        }
+        gcm_mult(ctx, ctx->ghash, ctx->ghash);
+        input  += len;
+        length -= len;
+    }
+}
+
+/* Computes the keystream of the next block. */
+static void gcm_next_stream(aes_gcm_ctx *ctx)
+{
+    uint32_t ctr;
+
+    GET_U32_BE(ctr, ctx->y, 12);
+    PUT_U32_BE(ctr + 1, ctx->y, 12);
+    aes_crypt_ecb(&ctx->aes, AES_ENCRYPT, ctx->y, ctx->stream);
+}
+
+void aes_gcm_setkey(aes_gcm_ctx *ctx, const byte *key, int keysize)
+{
+    byte h[16] = { 0 };
+
+    p_clear(ctx, 1);
+    aes_setkey_enc(&ctx->aes, key, keysize);
+
+    /* H = E(K, 0^128) */
+    aes_crypt_ecb(&ctx->aes, AES_ENCRYPT, h, h);
+    gcm_gen_table(ctx, h);
+#ifdef __HAS_CPUID
+    if (aes_has_pclmul()) {
+        gcm_gen_powers_clmul(ctx, h);
+    }
+#endif
+    p_clear(h, 16);
+}
+
+void aes_gcm_starts(aes_gcm_ctx *ctx, int mode, const byte *iv,
+                    size_t iv_len, const byte *add, size_t add_len)
+{
+    ctx->mode = mode;
+    ctx->len = 0;
+    ctx->add_len = add_len;
+    p_clear(ctx->ghash, 16);
+
+    if (iv_len == 12) {
+        memcpy(ctx->y, iv, 12);
+        PUT_U32_BE(1, ctx->y, 12);
+    } else {
+        byte len_block[16] = { 0 };
+
+        gcm_hash(ctx, iv, iv_len);
+        PUT_U32_BE((uint64_t)iv_len >> 29, len_block, 8);
+        PUT_U32_BE(iv_len << 3, len_block, 12);
+        gcm_hash(ctx, len_block, 16);
+        memcpy(ctx->y, ctx->ghash, 16);
+        p_clear(ctx->ghash, 16);
+    }
+    aes_crypt_ecb(&ctx->aes, AES_ENCRYPT, ctx->y, ctx->base_ectr);
+
+    gcm_hash(ctx, add, add_len);
+}
+
+void aes_gcm_update(aes_gcm_ctx *ctx, size_t length, const byte *input,
+                    byte *output)
+{
+    size_t off = ctx->len & 0x0F;
+
+    ctx->len += length;
+
+    /* Finish the current block first. */
+    for (; off != 0 && length > 0; length--) {
+        byte in = *input++;
+        byte out = in ^ ctx->stream[off];
+
+        ctx->ghash[off] ^= ctx->mode == AES_ENCRYPT ? out : in;
+        *output++ = out;
+        if (++off == 16) {
+            gcm_mult(ctx, ctx->ghash, ctx->ghash);
+            off = 0;
+        }
+    }
+
+#ifdef __HAS_CPUID
+    if (length >= 64 && aes_has_aesni() && aes_has_pclmul()) {
+        size_t done = aesni_gcm_crypt(ctx, length / 16, input, output);
+
+        input  += done * 16;
+        output += done * 16;
+        length -= done * 16;
+    }
+#endif
+
+    for (; length > 0; ) {
+        size_t len = MIN(length, 16u);
+
+        gcm_next_stream(ctx);
+        for (size_t i = 0; i < len; i++) {
+            byte in = input[i];
+            byte out = in ^ ctx->stream[i];
+
+            ctx->ghash[i] ^= ctx->mode == AES_ENCRYPT ? out : in;
+            output[i] = out;
+        }
+        if (len == 16) {
+            gcm_mult(ctx, ctx->ghash, ctx->ghash);
+        }
+        input  += len;
+        output += len;
+        length -= len;
+    }
+}
+
+void aes_gcm_finish(aes_gcm_ctx *ctx, byte *tag, size_t tag_len)
+{
+    byte len_block[16];
+    uint64_t add_bits = ctx->add_len << 3;
+    uint64_t bits = ctx->len << 3;
+
+    if (ctx->len & 0x0F) {
+        gcm_mult(ctx, ctx->ghash, ctx->ghash);
+    }
+
+    PUT_U32_BE(add_bits >> 32, len_block, 0);
+    PUT_U32_BE(add_bits,       len_block, 4);
+    PUT_U32_BE(bits >> 32,     len_block, 8);
+    PUT_U32_BE(bits,           len_block, 12);
+    gcm_hash(ctx, len_block, 16);
+
+    for (size_t i = 0; i < MIN(tag_len, 16u); i++) {
+        tag[i] = ctx->ghash[i] ^ ctx->base_ectr[i];
+    }
+}
+
+void aes_gcm_crypt_and_tag(aes_gcm_ctx *ctx, int mode, size_t length,
+                           const byte *iv, size_t iv_len,
+                           const byte *add, size_t add_len,
+                           const byte *input, byte *output,
+                           size_t tag_len, byte *tag)
+{
+    aes_gcm_starts(ctx, mode, iv, iv_len, add, add_len);
+    aes_gcm_update(ctx, length, input, output);
+    aes_gcm_finish(ctx, tag, tag_len);
+}
+
+int aes_gcm_auth_decrypt(aes_gcm_ctx *ctx, size_t length,
+                         const byte *iv, size_t iv_len,
+                         const byte *add, size_t add_len,
+                         const byte *tag, size_t tag_len,
+                         const byte *input, byte *output)
+{
+    byte check_tag[16];
+    byte diff = 0;
+
+    if (tag_len == 0 || tag_len > 16) {
+        return -1;
+    }
+    aes_gcm_crypt_and_tag(ctx, AES_DECRYPT, length, iv, iv_len, add, add_len,
+                          input, output, tag_len, check_tag);
+
+    /* Compare the tags in constant time. */
+    for (size_t i = 0; i < tag_len; i++) {
+        diff |= tag[i] ^ check_tag[i];
+    }
+    if (diff != 0) {
+        p_clear(output, length);
+        return -1;
+    }
+    return 0;
+}
+
+/* }}} */
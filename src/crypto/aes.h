@@ -16,6 +16,23 @@ typedef struct {
     uint32_t buf[68];      /*!<  unaligned data    */
 } aes_ctx;
 
+/**
+ * \brief          AES-GCM context structure
+ */
+typedef struct {
+    aes_ctx aes;            /*!<  AES context (encryption key)   */
+    uint64_t HL[16];        /*!<  GHASH table (low bits)         */
+    uint64_t HH[16];        /*!<  GHASH table (high bits)        */
+    uint64_t h_pow[4][2];   /*!<  H^1..H^4 for the PCLMUL GHASH  */
+    uint64_t len;           /*!<  length of the data             */
+    uint64_t add_len;       /*!<  length of the additional data  */
+    byte base_ectr[16];     /*!<  E(K, Y0), masks the tag        */
+    byte y[16];             /*!<  counter block                  */
+    byte ghash[16];         /*!<  current GHASH value            */
+    byte stream[16];        /*!<  keystream of the current block */
+    int mode;               /*!<  AES_ENCRYPT or AES_DECRYPT     */
+} aes_gcm_ctx;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -80,6 +97,122 @@ void aes_crypt_cfb(aes_ctx * nonnull ctx, int mode, int length,
                    int * nonnull iv_off, byte iv[16],
                    const byte * nonnull input, byte * nonnull output) __leaf;
 
+/**
+ * \brief          AES-CTR buffer encryption/decryption
+ *
+ * The counter is incremented as a 128-bits big endian integer. As in CTR
+ * mode the same function encrypts and decrypts, use aes_setkey_enc() for
+ * both.
+ *
+ * \param ctx            AES context
+ * \param length         length of the input data
+ * \param nc_off         offset in the current stream block (updated after
+ *                       use), must be 0 at the start of a stream
+ * \param nonce_counter  128-bits nonce and counter (updated after use)
+ * \param stream_block   saved stream block for resuming (updated after
+ *                       use)
+ * \param input          buffer holding the input data
+ * \param output         buffer holding the output data
+ */
+void aes_crypt_ctr(aes_ctx * nonnull ctx, size_t length,
+                   int * nonnull nc_off, byte nonce_counter[16],
+                   byte stream_block[16], const byte * nonnull input,
+                   byte * nonnull output) __leaf;
+
+/**
+ * \brief          AES-GCM key schedule
+ *
+ * \param ctx      GCM context to be initialized
+ * \param key      encryption key
+ * \param keysize  must be 128, 192 or 256
+ */
+void aes_gcm_setkey(aes_gcm_ctx * nonnull ctx, const byte * nonnull key,
+                    int keysize) __leaf;
+
+/**
+ * \brief          AES-GCM stream start
+ *
+ * \param ctx      GCM context
+ * \param mode     AES_ENCRYPT or AES_DECRYPT
+ * \param iv       initialization vector, 12 bytes are recommended
+ * \param iv_len   length of the initialization vector
+ * \param add      buffer holding the additional authenticated data
+ * \param add_len  length of the additional data
+ */
+void aes_gcm_starts(aes_gcm_ctx * nonnull ctx, int mode,
+                    const byte * nonnull iv, size_t iv_len,
+                    const byte * nullable add, size_t add_len) __leaf;
+
+/**
+ * \brief          AES-GCM stream encryption/decryption
+ *
+ * The data can be given in chunks of any size.
+ *
+ * \param ctx      GCM context
+ * \param length   length of the input data
+ * \param input    buffer holding the input data
+ * \param output   buffer holding the output data
+ */
+void aes_gcm_update(aes_gcm_ctx * nonnull ctx, size_t length,
+                    const byte * nonnull input, byte * nonnull output)
+    __leaf;
+
+/**
+ * \brief          AES-GCM stream end, computes the authentication tag
+ *
+ * \param ctx      GCM context
+ * \param tag      buffer for the authentication tag
+ * \param tag_len  length of the tag to generate, at most 16
+ */
+void aes_gcm_finish(aes_gcm_ctx * nonnull ctx, byte * nonnull tag,
+                    size_t tag_len) __leaf;
+
+/**
+ * \brief          AES-GCM buffer encryption/decryption
+ *
+ * \param ctx      GCM context
+ * \param mode     AES_ENCRYPT or AES_DECRYPT
+ * \param length   length of the input data
+ * \param iv       initialization vector
+ * \param iv_len   length of the initialization vector
+ * \param add      buffer holding the additional authenticated data
+ * \param add_len  length of the additional data
+ * \param input    buffer holding the input data
+ * \param output   buffer holding the output data
+ * \param tag_len  length of the tag to generate, at most 16
+ * \param tag      buffer for the authentication tag
+ */
+void aes_gcm_crypt_and_tag(aes_gcm_ctx * nonnull ctx, int mode,
+                           size_t length, const byte * nonnull iv,
+                           size_t iv_len, const byte * nullable add,
+                           size_t add_len, const byte * nonnull input,
+                           byte * nonnull output, size_t tag_len,
+                           byte * nonnull tag) __leaf;
+
+/**
+ * \brief          AES-GCM buffer authenticated decryption
+ *
+ * \param ctx      GCM context
+ * \param length   length of the input data
+ * \param iv       initialization vector
+ * \param iv_len   length of the initialization vector
+ * \param add      buffer holding the additional authenticated data
+ * \param add_len  length of the additional data
+ * \param tag      buffer holding the authentication tag
+ * \param tag_len  length of the tag, at most 16
+ * \param input    buffer holding the input data
+ * \param output   buffer holding the output data
+ *
+ * \return         0 if the tag is valid, -1 otherwise (the output is then
+ *                 cleared)
+ */
+int aes_gcm_auth_decrypt(aes_gcm_ctx * nonnull ctx, size_t length,
+                         const byte * nonnull iv, size_t iv_len,
+                         const byte * nullable add, size_t add_len,
+                         const byte * nonnull tag, size_t tag_len,
+                         const byte * nonnull input, byte * nonnull output)
+    __leaf;
+
 #ifdef __cplusplus
 }
 #endif
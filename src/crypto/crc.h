@@ -53,3 +53,63 @@
 #   define S8(x)  ((x) >> 8)
 #   define S32(x) ((x) >> 32)
 #endif
+
+#ifdef __HAS_CPUID
+#pragma push_macro("__leaf")
+#undef __leaf
+#include <cpuid.h>
+#include <x86intrin.h>
+#pragma pop_macro("__leaf")
+
+/* Carry-less multiplication folding of reflected CRCs, as explained in
+ * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+ * Instruction" (Intel, 2009).
+ *
+ * The 128 bits registers are folded 64 bytes forward with the k4 constants
+ * and 16 bytes forward with the k1 constants, the constants of a fold by d
+ * bits being the bit-reflected x^(d + 63) mod P (low) and x^(d - 1) mod P
+ * (high). The initial CRC is xored in the first bytes, and the folded
+ * remainder is written in rem: the CRC of the data is the CRC of rem with a
+ * zero initial state.
+ *
+ * Requires at least 64 bytes, returns the number of bytes consumed.
+ */
+__attribute__((target("pclmul,sse2")))
+static inline size_t
+crc_clmul_fold(__m128i crc, const uint8_t *buf, size_t len,
+               __m128i k4, __m128i k1, uint8_t rem[static 16])
+{
+#define CRC_FOLD(x, k, y)                                                    \
+    (_mm_clmulepi64_si128((x), (k), 0x00)                                    \
+   ^ _mm_clmulepi64_si128((x), (k), 0x11) ^ (y))
+#define CRC_LOAD(p)  _mm_loadu_si128((const __m128i *)(p))
+
+    const uint8_t *start = buf;
+    __m128i x0 = CRC_LOAD(buf + 0x00) ^ crc;
+    __m128i x1 = CRC_LOAD(buf + 0x10);
+    __m128i x2 = CRC_LOAD(buf + 0x20);
+    __m128i x3 = CRC_LOAD(buf + 0x30);
+
+    buf += 64;
+    len -= 64;
+    for (; len >= 64; buf += 64, len -= 64) {
+        x0 = CRC_FOLD(x0, k4, CRC_LOAD(buf + 0x00));
+        x1 = CRC_FOLD(x1, k4, CRC_LOAD(buf + 0x10));
+        x2 = CRC_FOLD(x2, k4, CRC_LOAD(buf + 0x20));
+        x3 = CRC_FOLD(x3, k4, CRC_LOAD(buf + 0x30));
+    }
+
+    x0 = CRC_FOLD(x0, k1, x1);
+    x0 = CRC_FOLD(x0, k1, x2);
+    x0 = CRC_FOLD(x0, k1, x3);
+    for (; len >= 16; buf += 16, len -= 16) {
+        x0 = CRC_FOLD(x0, k1, CRC_LOAD(buf));
+    }
+    _mm_storeu_si128((__m128i *)rem, x0);
+
+    return buf - start;
+#undef CRC_LOAD
+#undef CRC_FOLD
+}
+
+#endif
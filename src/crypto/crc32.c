@@ -38,16 +38,18 @@
 
 #include "crc.h"
 #include "crc32-table.in.c"
+#include "crc32c-table.in.c"
 
 /* Simplistic crc32 calculator, almost compatible with zlib version,
  * except for crc type as uint32_t instead of unsigned long
  */
 static ALWAYS_INLINE
-uint32_t naive_icrc32(uint32_t crc, const uint8_t *buf, ssize_t len)
+uint32_t naive_icrc32_tab(const uint32_t table[8][256], uint32_t crc,
+                          const uint8_t *buf, ssize_t len)
 {
     if (len) {
         do {
-            crc = crc32table[0][*buf++ ^ A(crc)] ^ S8(crc);
+            crc = table[0][*buf++ ^ A(crc)] ^ S8(crc);
         } while (--len);
     }
     return crc;
@@ -57,14 +59,16 @@ uint32_t naive_icrc32(uint32_t crc, const uint8_t *buf, ssize_t len)
  * changes can very easily ruin the performance (and very probably is
  * very compiler dependent).
  */
-static uint32_t fast_icrc32(uint32_t crc, const uint8_t *buf, size_t size)
+static ALWAYS_INLINE
+uint32_t fast_icrc32_tab(const uint32_t table[8][256], uint32_t crc,
+                         const uint8_t *buf, size_t size)
 {
     size_t words;
 
     if (unlikely((uintptr_t)buf & 7)) {
         size -= 8 - ((uintptr_t)buf & 7);
         do {
-            crc = crc32table[0][*buf++ ^ A(crc)] ^ S8(crc);
+            crc = table[0][*buf++ ^ A(crc)] ^ S8(crc);
         } while ((uintptr_t)buf & 7);
     }
 
@@ -75,10 +79,10 @@ static uint32_t fast_icrc32(uint32_t crc, const uint8_t *buf, size_t size)
         crc ^= *(uint32_t *)(buf);
         buf += 4;
 
-        crc = crc32table[7][A(crc)]
-            ^ crc32table[6][B(crc)]
-            ^ crc32table[5][C(crc)]
-            ^ crc32table[4][D(crc)];
+        crc = table[7][A(crc)]
+            ^ table[6][B(crc)]
+            ^ table[5][C(crc)]
+            ^ table[4][D(crc)];
 
         tmp  = *(uint32_t *)(buf);
         buf += 4;
@@ -86,21 +90,204 @@ static uint32_t fast_icrc32(uint32_t crc, const uint8_t *buf, size_t size)
         // At least with some compilers, it is critical for
         // performance, that the crc variable is XORed
         // between the two table-lookup pairs.
-        crc = crc32table[3][A(tmp)]
-            ^ crc32table[2][B(tmp)]
+        crc = table[3][A(tmp)]
+            ^ table[2][B(tmp)]
             ^ crc
-            ^ crc32table[1][C(tmp)]
-            ^ crc32table[0][D(tmp)];
+            ^ table[1][C(tmp)]
+            ^ table[0][D(tmp)];
     } while (--words);
 
-    return naive_icrc32(crc, buf, size & (size_t)7);
+    return naive_icrc32_tab(table, crc, buf, size & (size_t)7);
+}
+
+static ALWAYS_INLINE
+uint32_t naive_icrc32(uint32_t crc, const uint8_t *buf, ssize_t len)
+{
+    return naive_icrc32_tab(crc32table, crc, buf, len);
 }
 
+static uint32_t fast_icrc32(uint32_t crc, const uint8_t *buf, size_t size)
+{
+    return fast_icrc32_tab(crc32table, crc, buf, size);
+}
+
+static uint32_t fast_icrc32c(uint32_t crc, const uint8_t *buf, size_t size)
+{
+    return fast_icrc32_tab(crc32ctable, crc, buf, size);
+}
+
+#ifdef __HAS_CPUID
+
+__attribute__((target("pclmul,sse2")))
+static uint32_t clmul_icrc32(uint32_t crc, const uint8_t *buf, size_t size)
+{
+    const __m128i k4 = _mm_set_epi64x(0xcad38e8f00000000, 0x653d982200000000);
+    const __m128i k1 = _mm_set_epi64x(0x9ba54c6f00000000, 0x65673b4600000000);
+    uint8_t rem[16];
+    size_t done;
+
+    done = crc_clmul_fold(_mm_cvtsi32_si128(crc), buf, size, k4, k1, rem);
+    crc = naive_icrc32(0, rem, sizeof(rem));
+    return naive_icrc32(crc, buf + done, size - done);
+}
+
+/* The crc32 instruction of SSE4.2 uses the Castagnoli polynomial. */
+__attribute__((target("sse4.2")))
+static uint32_t sse42_icrc32c(uint32_t crc, const uint8_t *buf, size_t size)
+{
+    for (; size && ((uintptr_t)buf & 7); size--) {
+        crc = _mm_crc32_u8(crc, *buf++);
+    }
+#ifdef __x86_64__
+    {
+        uint64_t crc64 = crc;
+
+        for (; size >= 8; size -= 8, buf += 8) {
+            crc64 = _mm_crc32_u64(crc64, *(const uint64_t *)buf);
+        }
+        crc = crc64;
+    }
+#else
+    for (; size >= 4; size -= 4, buf += 4) {
+        crc = _mm_crc32_u32(crc, *(const uint32_t *)buf);
+    }
+#endif
+    for (; size; size--) {
+        crc = _mm_crc32_u8(crc, *buf++);
+    }
+    return crc;
+}
+
+static uint32_t resolve_icrc32(uint32_t crc, const uint8_t *buf, size_t size);
+static uint32_t resolve_icrc32c(uint32_t crc, const uint8_t *buf,
+                                size_t size);
+
+static uint32_t (*large_icrc32)(uint32_t, const uint8_t *, size_t)
+    = &resolve_icrc32;
+static uint32_t (*large_icrc32c)(uint32_t, const uint8_t *, size_t)
+    = &resolve_icrc32c;
+
+static uint32_t resolve_icrc32(uint32_t crc, const uint8_t *buf, size_t size)
+{
+    int eax, ebx, ecx, edx;
+
+    __cpuid(1, eax, ebx, ecx, edx);
+    large_icrc32 = &fast_icrc32;
+    if (ecx & bit_PCLMUL) {
+        large_icrc32 = &clmul_icrc32;
+    }
+    return (*large_icrc32)(crc, buf, size);
+}
+
+static uint32_t resolve_icrc32c(uint32_t crc, const uint8_t *buf,
+                                size_t size)
+{
+    int eax, ebx, ecx, edx;
+
+    __cpuid(1, eax, ebx, ecx, edx);
+    large_icrc32c = &fast_icrc32c;
+    if (ecx & bit_SSE4_2) {
+        large_icrc32c = &sse42_icrc32c;
+    }
+    return (*large_icrc32c)(crc, buf, size);
+}
+
+#else
+
+static uint32_t (*large_icrc32)(uint32_t, const uint8_t *, size_t)
+    = &fast_icrc32;
+static uint32_t (*large_icrc32c)(uint32_t, const uint8_t *, size_t)
+    = &fast_icrc32c;
+
+#endif
+
 __flatten
 uint32_t icrc32(uint32_t crc, const void *data, ssize_t len)
 {
     crc = ~le_to_cpu32(crc);
     if (len < 64)
         return ~le_to_cpu32(naive_icrc32(crc, data, len));
-    return ~le_to_cpu32(fast_icrc32(crc, data, len));
+    return ~le_to_cpu32((*large_icrc32)(crc, data, len));
+}
+
+__flatten
+uint32_t icrc32c(uint32_t crc, const void *data, ssize_t len)
+{
+    crc = ~le_to_cpu32(crc);
+    if (len < 64)
+        return ~le_to_cpu32(naive_icrc32_tab(crc32ctable, crc, data, len));
+    return ~le_to_cpu32((*large_icrc32c)(crc, data, len));
+}
+
+/* {{{ Combination */
+
+/* The CRCs are polynomials over GF(2) in the reflected bit order. The CRC
+ * of A.B is the one of A multiplied by x^(8 * len(B)), plus the one of B
+ * (modulo the CRC polynomial), which gives the classic O(log(len))
+ * combination of zlib.
+ */
+
+/* a * b modulo the polynomial. */
+static uint32_t crc32_multmodp(uint32_t poly, uint32_t a, uint32_t b)
+{
+    uint32_t m = 1U << 31;
+    uint32_t p = 0;
+
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) {
+                break;
+            }
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ poly : b >> 1;
+    }
+    return p;
+}
+
+/* x^(2^n) modulo the polynomials, for n in [0, 32[. */
+static const uint32_t crc32_x2n_table[32] = {
+    0x40000000, 0x20000000, 0x08000000, 0x00800000, 0x00008000, 0xedb88320,
+    0xb1e6b092, 0xa06a2517, 0xed627dae, 0x88d14467, 0xd7bbfe6a, 0xec447f11,
+    0x8e7ea170, 0x6427800e, 0x4d47bae0, 0x09fe548f, 0x83852d0f, 0x30362f1a,
+    0x7b5a9cc3, 0x31fec169, 0x9fec022a, 0x6c8dedc4, 0x15d6874d, 0x5fde7a4e,
+    0xbad90e37, 0x2e4e5eef, 0x4eaba214, 0xa8a472c0, 0x429a969e, 0x148d302a,
+    0xc40ba6d0, 0xc4e22c3c,
+};
+
+static const uint32_t crc32c_x2n_table[32] = {
+    0x40000000, 0x20000000, 0x08000000, 0x00800000, 0x00008000, 0x82f63b78,
+    0x6ea2d55c, 0x18b8ea18, 0x510ac59a, 0xb82be955, 0xb8fdb1e7, 0x88e56f72,
+    0x74c360a4, 0xe4172b16, 0x0d65762a, 0x35d73a62, 0x28461564, 0xbf455269,
+    0xe2ea32dc, 0xfe7740e6, 0xf946610b, 0x3c204f8f, 0x538586e3, 0x59726915,
+    0x734d5309, 0xbc1ac763, 0x7d0722cc, 0xd289cabe, 0xe94ca9bc, 0x05b74f3f,
+    0xa51e1f42, 0x40000000,
+};
+
+static ALWAYS_INLINE
+uint32_t crc32_combine_tab(uint32_t poly, const uint32_t x2n_table[32],
+                           uint32_t crc1, uint32_t crc2, uint64_t len2)
+{
+    /* x^(8 * len2), 8 = 2^3. */
+    uint32_t p = 1U << 31;
+
+    for (int k = 3; len2; len2 >>= 1, k++) {
+        if (len2 & 1) {
+            p = crc32_multmodp(poly, x2n_table[k & 31], p);
+        }
+    }
+    return crc32_multmodp(poly, p, crc1) ^ crc2;
+}
+
+uint32_t icrc32_combine(uint32_t crc1, uint32_t crc2, uint64_t len2)
+{
+    return crc32_combine_tab(0xedb88320, crc32_x2n_table, crc1, crc2, len2);
 }
+
+uint32_t icrc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2)
+{
+    return crc32_combine_tab(0x82f63b78, crc32c_x2n_table, crc1, crc2, len2);
+}
+
+/* }}} */
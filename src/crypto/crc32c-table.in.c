@@ -0,0 +1,542 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#define X(x) LE32_T(x)
+const uint32_t crc32ctable[8][256] = {
+    {
+        X(0x00000000), X(0xF26B8303), X(0xE13B70F7), X(0x1350F3F4),
+        X(0xC79A971F), X(0x35F1141C), X(0x26A1E7E8), X(0xD4CA64EB),
+        X(0x8AD958CF), X(0x78B2DBCC), X(0x6BE22838), X(0x9989AB3B),
+        X(0x4D43CFD0), X(0xBF284CD3), X(0xAC78BF27), X(0x5E133C24),
+        X(0x105EC76F), X(0xE235446C), X(0xF165B798), X(0x030E349B),
+        X(0xD7C45070), X(0x25AFD373), X(0x36FF2087), X(0xC494A384),
+        X(0x9A879FA0), X(0x68EC1CA3), X(0x7BBCEF57), X(0x89D76C54),
+        X(0x5D1D08BF), X(0xAF768BBC), X(0xBC267848), X(0x4E4DFB4B),
+        X(0x20BD8EDE), X(0xD2D60DDD), X(0xC186FE29), X(0x33ED7D2A),
+        X(0xE72719C1), X(0x154C9AC2), X(0x061C6936), X(0xF477EA35),
+        X(0xAA64D611), X(0x580F5512), X(0x4B5FA6E6), X(0xB93425E5),
+        X(0x6DFE410E), X(0x9F95C20D), X(0x8CC531F9), X(0x7EAEB2FA),
+        X(0x30E349B1), X(0xC288CAB2), X(0xD1D83946), X(0x23B3BA45),
+        X(0xF779DEAE), X(0x05125DAD), X(0x1642AE59), X(0xE4292D5A),
+        X(0xBA3A117E), X(0x4851927D), X(0x5B016189), X(0xA96AE28A),
+        X(0x7DA08661), X(0x8FCB0562), X(0x9C9BF696), X(0x6EF07595),
+        X(0x417B1DBC), X(0xB3109EBF), X(0xA0406D4B), X(0x522BEE48),
+        X(0x86E18AA3), X(0x748A09A0), X(0x67DAFA54), X(0x95B17957),
+        X(0xCBA24573), X(0x39C9C670), X(0x2A993584), X(0xD8F2B687),
+        X(0x0C38D26C), X(0xFE53516F), X(0xED03A29B), X(0x1F682198),
+        X(0x5125DAD3), X(0xA34E59D0), X(0xB01EAA24), X(0x42752927),
+        X(0x96BF4DCC), X(0x64D4CECF), X(0x77843D3B), X(0x85EFBE38),
+        X(0xDBFC821C), X(0x2997011F), X(0x3AC7F2EB), X(0xC8AC71E8),
+        X(0x1C661503), X(0xEE0D9600), X(0xFD5D65F4), X(0x0F36E6F7),
+        X(0x61C69362), X(0x93AD1061), X(0x80FDE395), X(0x72966096),
+        X(0xA65C047D), X(0x5437877E), X(0x4767748A), X(0xB50CF789),
+        X(0xEB1FCBAD), X(0x197448AE), X(0x0A24BB5A), X(0xF84F3859),
+        X(0x2C855CB2), X(0xDEEEDFB1), X(0xCDBE2C45), X(0x3FD5AF46),
+        X(0x7198540D), X(0x83F3D70E), X(0x90A324FA), X(0x62C8A7F9),
+        X(0xB602C312), X(0x44694011), X(0x5739B3E5), X(0xA55230E6),
+        X(0xFB410CC2), X(0x092A8FC1), X(0x1A7A7C35), X(0xE811FF36),
+        X(0x3CDB9BDD), X(0xCEB018DE), X(0xDDE0EB2A), X(0x2F8B6829),
+        X(0x82F63B78), X(0x709DB87B), X(0x63CD4B8F), X(0x91A6C88C),
+        X(0x456CAC67), X(0xB7072F64), X(0xA457DC90), X(0x563C5F93),
+        X(0x082F63B7), X(0xFA44E0B4), X(0xE9141340), X(0x1B7F9043),
+        X(0xCFB5F4A8), X(0x3DDE77AB), X(0x2E8E845F), X(0xDCE5075C),
+        X(0x92A8FC17), X(0x60C37F14), X(0x73938CE0), X(0x81F80FE3),
+        X(0x55326B08), X(0xA759E80B), X(0xB4091BFF), X(0x466298FC),
+        X(0x1871A4D8), X(0xEA1A27DB), X(0xF94AD42F), X(0x0B21572C),
+        X(0xDFEB33C7), X(0x2D80B0C4), X(0x3ED04330), X(0xCCBBC033),
+        X(0xA24BB5A6), X(0x502036A5), X(0x4370C551), X(0xB11B4652),
+        X(0x65D122B9), X(0x97BAA1BA), X(0x84EA524E), X(0x7681D14D),
+        X(0x2892ED69), X(0xDAF96E6A), X(0xC9A99D9E), X(0x3BC21E9D),
+        X(0xEF087A76), X(0x1D63F975), X(0x0E330A81), X(0xFC588982),
+        X(0xB21572C9), X(0x407EF1CA), X(0x532E023E), X(0xA145813D),
+        X(0x758FE5D6), X(0x87E466D5), X(0x94B49521), X(0x66DF1622),
+        X(0x38CC2A06), X(0xCAA7A905), X(0xD9F75AF1), X(0x2B9CD9F2),
+        X(0xFF56BD19), X(0x0D3D3E1A), X(0x1E6DCDEE), X(0xEC064EED),
+        X(0xC38D26C4), X(0x31E6A5C7), X(0x22B65633), X(0xD0DDD530),
+        X(0x0417B1DB), X(0xF67C32D8), X(0xE52CC12C), X(0x1747422F),
+        X(0x49547E0B), X(0xBB3FFD08), X(0xA86F0EFC), X(0x5A048DFF),
+        X(0x8ECEE914), X(0x7CA56A17), X(0x6FF599E3), X(0x9D9E1AE0),
+        X(0xD3D3E1AB), X(0x21B862A8), X(0x32E8915C), X(0xC083125F),
+        X(0x144976B4), X(0xE622F5B7), X(0xF5720643), X(0x07198540),
+        X(0x590AB964), X(0xAB613A67), X(0xB831C993), X(0x4A5A4A90),
+        X(0x9E902E7B), X(0x6CFBAD78), X(0x7FAB5E8C), X(0x8DC0DD8F),
+        X(0xE330A81A), X(0x115B2B19), X(0x020BD8ED), X(0xF0605BEE),
+        X(0x24AA3F05), X(0xD6C1BC06), X(0xC5914FF2), X(0x37FACCF1),
+        X(0x69E9F0D5), X(0x9B8273D6), X(0x88D28022), X(0x7AB90321),
+        X(0xAE7367CA), X(0x5C18E4C9), X(0x4F48173D), X(0xBD23943E),
+        X(0xF36E6F75), X(0x0105EC76), X(0x12551F82), X(0xE03E9C81),
+        X(0x34F4F86A), X(0xC69F7B69), X(0xD5CF889D), X(0x27A40B9E),
+        X(0x79B737BA), X(0x8BDCB4B9), X(0x988C474D), X(0x6AE7C44E),
+        X(0xBE2DA0A5), X(0x4C4623A6), X(0x5F16D052), X(0xAD7D5351),
+    }, {
+        X(0x00000000), X(0x13A29877), X(0x274530EE), X(0x34E7A899),
+        X(0x4E8A61DC), X(0x5D28F9AB), X(0x69CF5132), X(0x7A6DC945),
+        X(0x9D14C3B8), X(0x8EB65BCF), X(0xBA51F356), X(0xA9F36B21),
+        X(0xD39EA264), X(0xC03C3A13), X(0xF4DB928A), X(0xE7790AFD),
+        X(0x3FC5F181), X(0x2C6769F6), X(0x1880C16F), X(0x0B225918),
+        X(0x714F905D), X(0x62ED082A), X(0x560AA0B3), X(0x45A838C4),
+        X(0xA2D13239), X(0xB173AA4E), X(0x859402D7), X(0x96369AA0),
+        X(0xEC5B53E5), X(0xFFF9CB92), X(0xCB1E630B), X(0xD8BCFB7C),
+        X(0x7F8BE302), X(0x6C297B75), X(0x58CED3EC), X(0x4B6C4B9B),
+        X(0x310182DE), X(0x22A31AA9), X(0x1644B230), X(0x05E62A47),
+        X(0xE29F20BA), X(0xF13DB8CD), X(0xC5DA1054), X(0xD6788823),
+        X(0xAC154166), X(0xBFB7D911), X(0x8B507188), X(0x98F2E9FF),
+        X(0x404E1283), X(0x53EC8AF4), X(0x670B226D), X(0x74A9BA1A),
+        X(0x0EC4735F), X(0x1D66EB28), X(0x298143B1), X(0x3A23DBC6),
+        X(0xDD5AD13B), X(0xCEF8494C), X(0xFA1FE1D5), X(0xE9BD79A2),
+        X(0x93D0B0E7), X(0x80722890), X(0xB4958009), X(0xA737187E),
+        X(0xFF17C604), X(0xECB55E73), X(0xD852F6EA), X(0xCBF06E9D),
+        X(0xB19DA7D8), X(0xA23F3FAF), X(0x96D89736), X(0x857A0F41),
+        X(0x620305BC), X(0x71A19DCB), X(0x45463552), X(0x56E4AD25),
+        X(0x2C896460), X(0x3F2BFC17), X(0x0BCC548E), X(0x186ECCF9),
+        X(0xC0D23785), X(0xD370AFF2), X(0xE797076B), X(0xF4359F1C),
+        X(0x8E585659), X(0x9DFACE2E), X(0xA91D66B7), X(0xBABFFEC0),
+        X(0x5DC6F43D), X(0x4E646C4A), X(0x7A83C4D3), X(0x69215CA4),
+        X(0x134C95E1), X(0x00EE0D96), X(0x3409A50F), X(0x27AB3D78),
+        X(0x809C2506), X(0x933EBD71), X(0xA7D915E8), X(0xB47B8D9F),
+        X(0xCE1644DA), X(0xDDB4DCAD), X(0xE9537434), X(0xFAF1EC43),
+        X(0x1D88E6BE), X(0x0E2A7EC9), X(0x3ACDD650), X(0x296F4E27),
+        X(0x53028762), X(0x40A01F15), X(0x7447B78C), X(0x67E52FFB),
+        X(0xBF59D487), X(0xACFB4CF0), X(0x981CE469), X(0x8BBE7C1E),
+        X(0xF1D3B55B), X(0xE2712D2C), X(0xD69685B5), X(0xC5341DC2),
+        X(0x224D173F), X(0x31EF8F48), X(0x050827D1), X(0x16AABFA6),
+        X(0x6CC776E3), X(0x7F65EE94), X(0x4B82460D), X(0x5820DE7A),
+        X(0xFBC3FAF9), X(0xE861628E), X(0xDC86CA17), X(0xCF245260),
+        X(0xB5499B25), X(0xA6EB0352), X(0x920CABCB), X(0x81AE33BC),
+        X(0x66D73941), X(0x7575A136), X(0x419209AF), X(0x523091D8),
+        X(0x285D589D), X(0x3BFFC0EA), X(0x0F186873), X(0x1CBAF004),
+        X(0xC4060B78), X(0xD7A4930F), X(0xE3433B96), X(0xF0E1A3E1),
+        X(0x8A8C6AA4), X(0x992EF2D3), X(0xADC95A4A), X(0xBE6BC23D),
+        X(0x5912C8C0), X(0x4AB050B7), X(0x7E57F82E), X(0x6DF56059),
+        X(0x1798A91C), X(0x043A316B), X(0x30DD99F2), X(0x237F0185),
+        X(0x844819FB), X(0x97EA818C), X(0xA30D2915), X(0xB0AFB162),
+        X(0xCAC27827), X(0xD960E050), X(0xED8748C9), X(0xFE25D0BE),
+        X(0x195CDA43), X(0x0AFE4234), X(0x3E19EAAD), X(0x2DBB72DA),
+        X(0x57D6BB9F), X(0x447423E8), X(0x70938B71), X(0x63311306),
+        X(0xBB8DE87A), X(0xA82F700D), X(0x9CC8D894), X(0x8F6A40E3),
+        X(0xF50789A6), X(0xE6A511D1), X(0xD242B948), X(0xC1E0213F),
+        X(0x26992BC2), X(0x353BB3B5), X(0x01DC1B2C), X(0x127E835B),
+        X(0x68134A1E), X(0x7BB1D269), X(0x4F567AF0), X(0x5CF4E287),
+        X(0x04D43CFD), X(0x1776A48A), X(0x23910C13), X(0x30339464),
+        X(0x4A5E5D21), X(0x59FCC556), X(0x6D1B6DCF), X(0x7EB9F5B8),
+        X(0x99C0FF45), X(0x8A626732), X(0xBE85CFAB), X(0xAD2757DC),
+        X(0xD74A9E99), X(0xC4E806EE), X(0xF00FAE77), X(0xE3AD3600),
+        X(0x3B11CD7C), X(0x28B3550B), X(0x1C54FD92), X(0x0FF665E5),
+        X(0x759BACA0), X(0x663934D7), X(0x52DE9C4E), X(0x417C0439),
+        X(0xA6050EC4), X(0xB5A796B3), X(0x81403E2A), X(0x92E2A65D),
+        X(0xE88F6F18), X(0xFB2DF76F), X(0xCFCA5FF6), X(0xDC68C781),
+        X(0x7B5FDFFF), X(0x68FD4788), X(0x5C1AEF11), X(0x4FB87766),
+        X(0x35D5BE23), X(0x26772654), X(0x12908ECD), X(0x013216BA),
+        X(0xE64B1C47), X(0xF5E98430), X(0xC10E2CA9), X(0xD2ACB4DE),
+        X(0xA8C17D9B), X(0xBB63E5EC), X(0x8F844D75), X(0x9C26D502),
+        X(0x449A2E7E), X(0x5738B609), X(0x63DF1E90), X(0x707D86E7),
+        X(0x0A104FA2), X(0x19B2D7D5), X(0x2D557F4C), X(0x3EF7E73B),
+        X(0xD98EEDC6), X(0xCA2C75B1), X(0xFECBDD28), X(0xED69455F),
+        X(0x97048C1A), X(0x84A6146D), X(0xB041BCF4), X(0xA3E32483),
+    }, {
+        X(0x00000000), X(0xA541927E), X(0x4F6F520D), X(0xEA2EC073),
+        X(0x9EDEA41A), X(0x3B9F3664), X(0xD1B1F617), X(0x74F06469),
+        X(0x38513EC5), X(0x9D10ACBB), X(0x773E6CC8), X(0xD27FFEB6),
+        X(0xA68F9ADF), X(0x03CE08A1), X(0xE9E0C8D2), X(0x4CA15AAC),
+        X(0x70A27D8A), X(0xD5E3EFF4), X(0x3FCD2F87), X(0x9A8CBDF9),
+        X(0xEE7CD990), X(0x4B3D4BEE), X(0xA1138B9D), X(0x045219E3),
+        X(0x48F3434F), X(0xEDB2D131), X(0x079C1142), X(0xA2DD833C),
+        X(0xD62DE755), X(0x736C752B), X(0x9942B558), X(0x3C032726),
+        X(0xE144FB14), X(0x4405696A), X(0xAE2BA919), X(0x0B6A3B67),
+        X(0x7F9A5F0E), X(0xDADBCD70), X(0x30F50D03), X(0x95B49F7D),
+        X(0xD915C5D1), X(0x7C5457AF), X(0x967A97DC), X(0x333B05A2),
+        X(0x47CB61CB), X(0xE28AF3B5), X(0x08A433C6), X(0xADE5A1B8),
+        X(0x91E6869E), X(0x34A714E0), X(0xDE89D493), X(0x7BC846ED),
+        X(0x0F382284), X(0xAA79B0FA), X(0x40577089), X(0xE516E2F7),
+        X(0xA9B7B85B), X(0x0CF62A25), X(0xE6D8EA56), X(0x43997828),
+        X(0x37691C41), X(0x92288E3F), X(0x78064E4C), X(0xDD47DC32),
+        X(0xC76580D9), X(0x622412A7), X(0x880AD2D4), X(0x2D4B40AA),
+        X(0x59BB24C3), X(0xFCFAB6BD), X(0x16D476CE), X(0xB395E4B0),
+        X(0xFF34BE1C), X(0x5A752C62), X(0xB05BEC11), X(0x151A7E6F),
+        X(0x61EA1A06), X(0xC4AB8878), X(0x2E85480B), X(0x8BC4DA75),
+        X(0xB7C7FD53), X(0x12866F2D), X(0xF8A8AF5E), X(0x5DE93D20),
+        X(0x29195949), X(0x8C58CB37), X(0x66760B44), X(0xC337993A),
+        X(0x8F96C396), X(0x2AD751E8), X(0xC0F9919B), X(0x65B803E5),
+        X(0x1148678C), X(0xB409F5F2), X(0x5E273581), X(0xFB66A7FF),
+        X(0x26217BCD), X(0x8360E9B3), X(0x694E29C0), X(0xCC0FBBBE),
+        X(0xB8FFDFD7), X(0x1DBE4DA9), X(0xF7908DDA), X(0x52D11FA4),
+        X(0x1E704508), X(0xBB31D776), X(0x511F1705), X(0xF45E857B),
+        X(0x80AEE112), X(0x25EF736C), X(0xCFC1B31F), X(0x6A802161),
+        X(0x56830647), X(0xF3C29439), X(0x19EC544A), X(0xBCADC634),
+        X(0xC85DA25D), X(0x6D1C3023), X(0x8732F050), X(0x2273622E),
+        X(0x6ED23882), X(0xCB93AAFC), X(0x21BD6A8F), X(0x84FCF8F1),
+        X(0xF00C9C98), X(0x554D0EE6), X(0xBF63CE95), X(0x1A225CEB),
+        X(0x8B277743), X(0x2E66E53D), X(0xC448254E), X(0x6109B730),
+        X(0x15F9D359), X(0xB0B84127), X(0x5A968154), X(0xFFD7132A),
+        X(0xB3764986), X(0x1637DBF8), X(0xFC191B8B), X(0x595889F5),
+        X(0x2DA8ED9C), X(0x88E97FE2), X(0x62C7BF91), X(0xC7862DEF),
+        X(0xFB850AC9), X(0x5EC498B7), X(0xB4EA58C4), X(0x11ABCABA),
+        X(0x655BAED3), X(0xC01A3CAD), X(0x2A34FCDE), X(0x8F756EA0),
+        X(0xC3D4340C), X(0x6695A672), X(0x8CBB6601), X(0x29FAF47F),
+        X(0x5D0A9016), X(0xF84B0268), X(0x1265C21B), X(0xB7245065),
+        X(0x6A638C57), X(0xCF221E29), X(0x250CDE5A), X(0x804D4C24),
+        X(0xF4BD284D), X(0x51FCBA33), X(0xBBD27A40), X(0x1E93E83E),
+        X(0x5232B292), X(0xF77320EC), X(0x1D5DE09F), X(0xB81C72E1),
+        X(0xCCEC1688), X(0x69AD84F6), X(0x83834485), X(0x26C2D6FB),
+        X(0x1AC1F1DD), X(0xBF8063A3), X(0x55AEA3D0), X(0xF0EF31AE),
+        X(0x841F55C7), X(0x215EC7B9), X(0xCB7007CA), X(0x6E3195B4),
+        X(0x2290CF18), X(0x87D15D66), X(0x6DFF9D15), X(0xC8BE0F6B),
+        X(0xBC4E6B02), X(0x190FF97C), X(0xF321390F), X(0x5660AB71),
+        X(0x4C42F79A), X(0xE90365E4), X(0x032DA597), X(0xA66C37E9),
+        X(0xD29C5380), X(0x77DDC1FE), X(0x9DF3018D), X(0x38B293F3),
+        X(0x7413C95F), X(0xD1525B21), X(0x3B7C9B52), X(0x9E3D092C),
+        X(0xEACD6D45), X(0x4F8CFF3B), X(0xA5A23F48), X(0x00E3AD36),
+        X(0x3CE08A10), X(0x99A1186E), X(0x738FD81D), X(0xD6CE4A63),
+        X(0xA23E2E0A), X(0x077FBC74), X(0xED517C07), X(0x4810EE79),
+        X(0x04B1B4D5), X(0xA1F026AB), X(0x4BDEE6D8), X(0xEE9F74A6),
+        X(0x9A6F10CF), X(0x3F2E82B1), X(0xD50042C2), X(0x7041D0BC),
+        X(0xAD060C8E), X(0x08479EF0), X(0xE2695E83), X(0x4728CCFD),
+        X(0x33D8A894), X(0x96993AEA), X(0x7CB7FA99), X(0xD9F668E7),
+        X(0x9557324B), X(0x3016A035), X(0xDA386046), X(0x7F79F238),
+        X(0x0B899651), X(0xAEC8042F), X(0x44E6C45C), X(0xE1A75622),
+        X(0xDDA47104), X(0x78E5E37A), X(0x92CB2309), X(0x378AB177),
+        X(0x437AD51E), X(0xE63B4760), X(0x0C158713), X(0xA954156D),
+        X(0xE5F54FC1), X(0x40B4DDBF), X(0xAA9A1DCC), X(0x0FDB8FB2),
+        X(0x7B2BEBDB), X(0xDE6A79A5), X(0x3444B9D6), X(0x91052BA8),
+    }, {
+        X(0x00000000), X(0xDD45AAB8), X(0xBF672381), X(0x62228939),
+        X(0x7B2231F3), X(0xA6679B4B), X(0xC4451272), X(0x1900B8CA),
+        X(0xF64463E6), X(0x2B01C95E), X(0x49234067), X(0x9466EADF),
+        X(0x8D665215), X(0x5023F8AD), X(0x32017194), X(0xEF44DB2C),
+        X(0xE964B13D), X(0x34211B85), X(0x560392BC), X(0x8B463804),
+        X(0x924680CE), X(0x4F032A76), X(0x2D21A34F), X(0xF06409F7),
+        X(0x1F20D2DB), X(0xC2657863), X(0xA047F15A), X(0x7D025BE2),
+        X(0x6402E328), X(0xB9474990), X(0xDB65C0A9), X(0x06206A11),
+        X(0xD725148B), X(0x0A60BE33), X(0x6842370A), X(0xB5079DB2),
+        X(0xAC072578), X(0x71428FC0), X(0x136006F9), X(0xCE25AC41),
+        X(0x2161776D), X(0xFC24DDD5), X(0x9E0654EC), X(0x4343FE54),
+        X(0x5A43469E), X(0x8706EC26), X(0xE524651F), X(0x3861CFA7),
+        X(0x3E41A5B6), X(0xE3040F0E), X(0x81268637), X(0x5C632C8F),
+        X(0x45639445), X(0x98263EFD), X(0xFA04B7C4), X(0x27411D7C),
+        X(0xC805C650), X(0x15406CE8), X(0x7762E5D1), X(0xAA274F69),
+        X(0xB327F7A3), X(0x6E625D1B), X(0x0C40D422), X(0xD1057E9A),
+        X(0xABA65FE7), X(0x76E3F55F), X(0x14C17C66), X(0xC984D6DE),
+        X(0xD0846E14), X(0x0DC1C4AC), X(0x6FE34D95), X(0xB2A6E72D),
+        X(0x5DE23C01), X(0x80A796B9), X(0xE2851F80), X(0x3FC0B538),
+        X(0x26C00DF2), X(0xFB85A74A), X(0x99A72E73), X(0x44E284CB),
+        X(0x42C2EEDA), X(0x9F874462), X(0xFDA5CD5B), X(0x20E067E3),
+        X(0x39E0DF29), X(0xE4A57591), X(0x8687FCA8), X(0x5BC25610),
+        X(0xB4868D3C), X(0x69C32784), X(0x0BE1AEBD), X(0xD6A40405),
+        X(0xCFA4BCCF), X(0x12E11677), X(0x70C39F4E), X(0xAD8635F6),
+        X(0x7C834B6C), X(0xA1C6E1D4), X(0xC3E468ED), X(0x1EA1C255),
+        X(0x07A17A9F), X(0xDAE4D027), X(0xB8C6591E), X(0x6583F3A6),
+        X(0x8AC7288A), X(0x57828232), X(0x35A00B0B), X(0xE8E5A1B3),
+        X(0xF1E51979), X(0x2CA0B3C1), X(0x4E823AF8), X(0x93C79040),
+        X(0x95E7FA51), X(0x48A250E9), X(0x2A80D9D0), X(0xF7C57368),
+        X(0xEEC5CBA2), X(0x3380611A), X(0x51A2E823), X(0x8CE7429B),
+        X(0x63A399B7), X(0xBEE6330F), X(0xDCC4BA36), X(0x0181108E),
+        X(0x1881A844), X(0xC5C402FC), X(0xA7E68BC5), X(0x7AA3217D),
+        X(0x52A0C93F), X(0x8FE56387), X(0xEDC7EABE), X(0x30824006),
+        X(0x2982F8CC), X(0xF4C75274), X(0x96E5DB4D), X(0x4BA071F5),
+        X(0xA4E4AAD9), X(0x79A10061), X(0x1B838958), X(0xC6C623E0),
+        X(0xDFC69B2A), X(0x02833192), X(0x60A1B8AB), X(0xBDE41213),
+        X(0xBBC47802), X(0x6681D2BA), X(0x04A35B83), X(0xD9E6F13B),
+        X(0xC0E649F1), X(0x1DA3E349), X(0x7F816A70), X(0xA2C4C0C8),
+        X(0x4D801BE4), X(0x90C5B15C), X(0xF2E73865), X(0x2FA292DD),
+        X(0x36A22A17), X(0xEBE780AF), X(0x89C50996), X(0x5480A32E),
+        X(0x8585DDB4), X(0x58C0770C), X(0x3AE2FE35), X(0xE7A7548D),
+        X(0xFEA7EC47), X(0x23E246FF), X(0x41C0CFC6), X(0x9C85657E),
+        X(0x73C1BE52), X(0xAE8414EA), X(0xCCA69DD3), X(0x11E3376B),
+        X(0x08E38FA1), X(0xD5A62519), X(0xB784AC20), X(0x6AC10698),
+        X(0x6CE16C89), X(0xB1A4C631), X(0xD3864F08), X(0x0EC3E5B0),
+        X(0x17C35D7A), X(0xCA86F7C2), X(0xA8A47EFB), X(0x75E1D443),
+        X(0x9AA50F6F), X(0x47E0A5D7), X(0x25C22CEE), X(0xF8878656),
+        X(0xE1873E9C), X(0x3CC29424), X(0x5EE01D1D), X(0x83A5B7A5),
+        X(0xF90696D8), X(0x24433C60), X(0x4661B559), X(0x9B241FE1),
+        X(0x8224A72B), X(0x5F610D93), X(0x3D4384AA), X(0xE0062E12),
+        X(0x0F42F53E), X(0xD2075F86), X(0xB025D6BF), X(0x6D607C07),
+        X(0x7460C4CD), X(0xA9256E75), X(0xCB07E74C), X(0x16424DF4),
+        X(0x106227E5), X(0xCD278D5D), X(0xAF050464), X(0x7240AEDC),
+        X(0x6B401616), X(0xB605BCAE), X(0xD4273597), X(0x09629F2F),
+        X(0xE6264403), X(0x3B63EEBB), X(0x59416782), X(0x8404CD3A),
+        X(0x9D0475F0), X(0x4041DF48), X(0x22635671), X(0xFF26FCC9),
+        X(0x2E238253), X(0xF36628EB), X(0x9144A1D2), X(0x4C010B6A),
+        X(0x5501B3A0), X(0x88441918), X(0xEA669021), X(0x37233A99),
+        X(0xD867E1B5), X(0x05224B0D), X(0x6700C234), X(0xBA45688C),
+        X(0xA345D046), X(0x7E007AFE), X(0x1C22F3C7), X(0xC167597F),
+        X(0xC747336E), X(0x1A0299D6), X(0x782010EF), X(0xA565BA57),
+        X(0xBC65029D), X(0x6120A825), X(0x0302211C), X(0xDE478BA4),
+        X(0x31035088), X(0xEC46FA30), X(0x8E647309), X(0x5321D9B1),
+        X(0x4A21617B), X(0x9764CBC3), X(0xF54642FA), X(0x2803E842),
+    }, {
+        X(0x00000000), X(0x38116FAC), X(0x7022DF58), X(0x4833B0F4),
+        X(0xE045BEB0), X(0xD854D11C), X(0x906761E8), X(0xA8760E44),
+        X(0xC5670B91), X(0xFD76643D), X(0xB545D4C9), X(0x8D54BB65),
+        X(0x2522B521), X(0x1D33DA8D), X(0x55006A79), X(0x6D1105D5),
+        X(0x8F2261D3), X(0xB7330E7F), X(0xFF00BE8B), X(0xC711D127),
+        X(0x6F67DF63), X(0x5776B0CF), X(0x1F45003B), X(0x27546F97),
+        X(0x4A456A42), X(0x725405EE), X(0x3A67B51A), X(0x0276DAB6),
+        X(0xAA00D4F2), X(0x9211BB5E), X(0xDA220BAA), X(0xE2336406),
+        X(0x1BA8B557), X(0x23B9DAFB), X(0x6B8A6A0F), X(0x539B05A3),
+        X(0xFBED0BE7), X(0xC3FC644B), X(0x8BCFD4BF), X(0xB3DEBB13),
+        X(0xDECFBEC6), X(0xE6DED16A), X(0xAEED619E), X(0x96FC0E32),
+        X(0x3E8A0076), X(0x069B6FDA), X(0x4EA8DF2E), X(0x76B9B082),
+        X(0x948AD484), X(0xAC9BBB28), X(0xE4A80BDC), X(0xDCB96470),
+        X(0x74CF6A34), X(0x4CDE0598), X(0x04EDB56C), X(0x3CFCDAC0),
+        X(0x51EDDF15), X(0x69FCB0B9), X(0x21CF004D), X(0x19DE6FE1),
+        X(0xB1A861A5), X(0x89B90E09), X(0xC18ABEFD), X(0xF99BD151),
+        X(0x37516AAE), X(0x0F400502), X(0x4773B5F6), X(0x7F62DA5A),
+        X(0xD714D41E), X(0xEF05BBB2), X(0xA7360B46), X(0x9F2764EA),
+        X(0xF236613F), X(0xCA270E93), X(0x8214BE67), X(0xBA05D1CB),
+        X(0x1273DF8F), X(0x2A62B023), X(0x625100D7), X(0x5A406F7B),
+        X(0xB8730B7D), X(0x806264D1), X(0xC851D425), X(0xF040BB89),
+        X(0x5836B5CD), X(0x6027DA61), X(0x28146A95), X(0x10050539),
+        X(0x7D1400EC), X(0x45056F40), X(0x0D36DFB4), X(0x3527B018),
+        X(0x9D51BE5C), X(0xA540D1F0), X(0xED736104), X(0xD5620EA8),
+        X(0x2CF9DFF9), X(0x14E8B055), X(0x5CDB00A1), X(0x64CA6F0D),
+        X(0xCCBC6149), X(0xF4AD0EE5), X(0xBC9EBE11), X(0x848FD1BD),
+        X(0xE99ED468), X(0xD18FBBC4), X(0x99BC0B30), X(0xA1AD649C),
+        X(0x09DB6AD8), X(0x31CA0574), X(0x79F9B580), X(0x41E8DA2C),
+        X(0xA3DBBE2A), X(0x9BCAD186), X(0xD3F96172), X(0xEBE80EDE),
+        X(0x439E009A), X(0x7B8F6F36), X(0x33BCDFC2), X(0x0BADB06E),
+        X(0x66BCB5BB), X(0x5EADDA17), X(0x169E6AE3), X(0x2E8F054F),
+        X(0x86F90B0B), X(0xBEE864A7), X(0xF6DBD453), X(0xCECABBFF),
+        X(0x6EA2D55C), X(0x56B3BAF0), X(0x1E800A04), X(0x269165A8),
+        X(0x8EE76BEC), X(0xB6F60440), X(0xFEC5B4B4), X(0xC6D4DB18),
+        X(0xABC5DECD), X(0x93D4B161), X(0xDBE70195), X(0xE3F66E39),
+        X(0x4B80607D), X(0x73910FD1), X(0x3BA2BF25), X(0x03B3D089),
+        X(0xE180B48F), X(0xD991DB23), X(0x91A26BD7), X(0xA9B3047B),
+        X(0x01C50A3F), X(0x39D46593), X(0x71E7D567), X(0x49F6BACB),
+        X(0x24E7BF1E), X(0x1CF6D0B2), X(0x54C56046), X(0x6CD40FEA),
+        X(0xC4A201AE), X(0xFCB36E02), X(0xB480DEF6), X(0x8C91B15A),
+        X(0x750A600B), X(0x4D1B0FA7), X(0x0528BF53), X(0x3D39D0FF),
+        X(0x954FDEBB), X(0xAD5EB117), X(0xE56D01E3), X(0xDD7C6E4F),
+        X(0xB06D6B9A), X(0x887C0436), X(0xC04FB4C2), X(0xF85EDB6E),
+        X(0x5028D52A), X(0x6839BA86), X(0x200A0A72), X(0x181B65DE),
+        X(0xFA2801D8), X(0xC2396E74), X(0x8A0ADE80), X(0xB21BB12C),
+        X(0x1A6DBF68), X(0x227CD0C4), X(0x6A4F6030), X(0x525E0F9C),
+        X(0x3F4F0A49), X(0x075E65E5), X(0x4F6DD511), X(0x777CBABD),
+        X(0xDF0AB4F9), X(0xE71BDB55), X(0xAF286BA1), X(0x9739040D),
+        X(0x59F3BFF2), X(0x61E2D05E), X(0x29D160AA), X(0x11C00F06),
+        X(0xB9B60142), X(0x81A76EEE), X(0xC994DE1A), X(0xF185B1B6),
+        X(0x9C94B463), X(0xA485DBCF), X(0xECB66B3B), X(0xD4A70497),
+        X(0x7CD10AD3), X(0x44C0657F), X(0x0CF3D58B), X(0x34E2BA27),
+        X(0xD6D1DE21), X(0xEEC0B18D), X(0xA6F30179), X(0x9EE26ED5),
+        X(0x36946091), X(0x0E850F3D), X(0x46B6BFC9), X(0x7EA7D065),
+        X(0x13B6D5B0), X(0x2BA7BA1C), X(0x63940AE8), X(0x5B856544),
+        X(0xF3F36B00), X(0xCBE204AC), X(0x83D1B458), X(0xBBC0DBF4),
+        X(0x425B0AA5), X(0x7A4A6509), X(0x3279D5FD), X(0x0A68BA51),
+        X(0xA21EB415), X(0x9A0FDBB9), X(0xD23C6B4D), X(0xEA2D04E1),
+        X(0x873C0134), X(0xBF2D6E98), X(0xF71EDE6C), X(0xCF0FB1C0),
+        X(0x6779BF84), X(0x5F68D028), X(0x175B60DC), X(0x2F4A0F70),
+        X(0xCD796B76), X(0xF56804DA), X(0xBD5BB42E), X(0x854ADB82),
+        X(0x2D3CD5C6), X(0x152DBA6A), X(0x5D1E0A9E), X(0x650F6532),
+        X(0x081E60E7), X(0x300F0F4B), X(0x783CBFBF), X(0x402DD013),
+        X(0xE85BDE57), X(0xD04AB1FB), X(0x9879010F), X(0xA0686EA3),
+    }, {
+        X(0x00000000), X(0xEF306B19), X(0xDB8CA0C3), X(0x34BCCBDA),
+        X(0xB2F53777), X(0x5DC55C6E), X(0x697997B4), X(0x8649FCAD),
+        X(0x6006181F), X(0x8F367306), X(0xBB8AB8DC), X(0x54BAD3C5),
+        X(0xD2F32F68), X(0x3DC34471), X(0x097F8FAB), X(0xE64FE4B2),
+        X(0xC00C303E), X(0x2F3C5B27), X(0x1B8090FD), X(0xF4B0FBE4),
+        X(0x72F90749), X(0x9DC96C50), X(0xA975A78A), X(0x4645CC93),
+        X(0xA00A2821), X(0x4F3A4338), X(0x7B8688E2), X(0x94B6E3FB),
+        X(0x12FF1F56), X(0xFDCF744F), X(0xC973BF95), X(0x2643D48C),
+        X(0x85F4168D), X(0x6AC47D94), X(0x5E78B64E), X(0xB148DD57),
+        X(0x370121FA), X(0xD8314AE3), X(0xEC8D8139), X(0x03BDEA20),
+        X(0xE5F20E92), X(0x0AC2658B), X(0x3E7EAE51), X(0xD14EC548),
+        X(0x570739E5), X(0xB83752FC), X(0x8C8B9926), X(0x63BBF23F),
+        X(0x45F826B3), X(0xAAC84DAA), X(0x9E748670), X(0x7144ED69),
+        X(0xF70D11C4), X(0x183D7ADD), X(0x2C81B107), X(0xC3B1DA1E),
+        X(0x25FE3EAC), X(0xCACE55B5), X(0xFE729E6F), X(0x1142F576),
+        X(0x970B09DB), X(0x783B62C2), X(0x4C87A918), X(0xA3B7C201),
+        X(0x0E045BEB), X(0xE13430F2), X(0xD588FB28), X(0x3AB89031),
+        X(0xBCF16C9C), X(0x53C10785), X(0x677DCC5F), X(0x884DA746),
+        X(0x6E0243F4), X(0x813228ED), X(0xB58EE337), X(0x5ABE882E),
+        X(0xDCF77483), X(0x33C71F9A), X(0x077BD440), X(0xE84BBF59),
+        X(0xCE086BD5), X(0x213800CC), X(0x1584CB16), X(0xFAB4A00F),
+        X(0x7CFD5CA2), X(0x93CD37BB), X(0xA771FC61), X(0x48419778),
+        X(0xAE0E73CA), X(0x413E18D3), X(0x7582D309), X(0x9AB2B810),
+        X(0x1CFB44BD), X(0xF3CB2FA4), X(0xC777E47E), X(0x28478F67),
+        X(0x8BF04D66), X(0x64C0267F), X(0x507CEDA5), X(0xBF4C86BC),
+        X(0x39057A11), X(0xD6351108), X(0xE289DAD2), X(0x0DB9B1CB),
+        X(0xEBF65579), X(0x04C63E60), X(0x307AF5BA), X(0xDF4A9EA3),
+        X(0x5903620E), X(0xB6330917), X(0x828FC2CD), X(0x6DBFA9D4),
+        X(0x4BFC7D58), X(0xA4CC1641), X(0x9070DD9B), X(0x7F40B682),
+        X(0xF9094A2F), X(0x16392136), X(0x2285EAEC), X(0xCDB581F5),
+        X(0x2BFA6547), X(0xC4CA0E5E), X(0xF076C584), X(0x1F46AE9D),
+        X(0x990F5230), X(0x763F3929), X(0x4283F2F3), X(0xADB399EA),
+        X(0x1C08B7D6), X(0xF338DCCF), X(0xC7841715), X(0x28B47C0C),
+        X(0xAEFD80A1), X(0x41CDEBB8), X(0x75712062), X(0x9A414B7B),
+        X(0x7C0EAFC9), X(0x933EC4D0), X(0xA7820F0A), X(0x48B26413),
+        X(0xCEFB98BE), X(0x21CBF3A7), X(0x1577387D), X(0xFA475364),
+        X(0xDC0487E8), X(0x3334ECF1), X(0x0788272B), X(0xE8B84C32),
+        X(0x6EF1B09F), X(0x81C1DB86), X(0xB57D105C), X(0x5A4D7B45),
+        X(0xBC029FF7), X(0x5332F4EE), X(0x678E3F34), X(0x88BE542D),
+        X(0x0EF7A880), X(0xE1C7C399), X(0xD57B0843), X(0x3A4B635A),
+        X(0x99FCA15B), X(0x76CCCA42), X(0x42700198), X(0xAD406A81),
+        X(0x2B09962C), X(0xC439FD35), X(0xF08536EF), X(0x1FB55DF6),
+        X(0xF9FAB944), X(0x16CAD25D), X(0x22761987), X(0xCD46729E),
+        X(0x4B0F8E33), X(0xA43FE52A), X(0x90832EF0), X(0x7FB345E9),
+        X(0x59F09165), X(0xB6C0FA7C), X(0x827C31A6), X(0x6D4C5ABF),
+        X(0xEB05A612), X(0x0435CD0B), X(0x308906D1), X(0xDFB96DC8),
+        X(0x39F6897A), X(0xD6C6E263), X(0xE27A29B9), X(0x0D4A42A0),
+        X(0x8B03BE0D), X(0x6433D514), X(0x508F1ECE), X(0xBFBF75D7),
+        X(0x120CEC3D), X(0xFD3C8724), X(0xC9804CFE), X(0x26B027E7),
+        X(0xA0F9DB4A), X(0x4FC9B053), X(0x7B757B89), X(0x94451090),
+        X(0x720AF422), X(0x9D3A9F3B), X(0xA98654E1), X(0x46B63FF8),
+        X(0xC0FFC355), X(0x2FCFA84C), X(0x1B736396), X(0xF443088F),
+        X(0xD200DC03), X(0x3D30B71A), X(0x098C7CC0), X(0xE6BC17D9),
+        X(0x60F5EB74), X(0x8FC5806D), X(0xBB794BB7), X(0x544920AE),
+        X(0xB206C41C), X(0x5D36AF05), X(0x698A64DF), X(0x86BA0FC6),
+        X(0x00F3F36B), X(0xEFC39872), X(0xDB7F53A8), X(0x344F38B1),
+        X(0x97F8FAB0), X(0x78C891A9), X(0x4C745A73), X(0xA344316A),
+        X(0x250DCDC7), X(0xCA3DA6DE), X(0xFE816D04), X(0x11B1061D),
+        X(0xF7FEE2AF), X(0x18CE89B6), X(0x2C72426C), X(0xC3422975),
+        X(0x450BD5D8), X(0xAA3BBEC1), X(0x9E87751B), X(0x71B71E02),
+        X(0x57F4CA8E), X(0xB8C4A197), X(0x8C786A4D), X(0x63480154),
+        X(0xE501FDF9), X(0x0A3196E0), X(0x3E8D5D3A), X(0xD1BD3623),
+        X(0x37F2D291), X(0xD8C2B988), X(0xEC7E7252), X(0x034E194B),
+        X(0x8507E5E6), X(0x6A378EFF), X(0x5E8B4525), X(0xB1BB2E3C),
+    }, {
+        X(0x00000000), X(0x68032CC8), X(0xD0065990), X(0xB8057558),
+        X(0xA5E0C5D1), X(0xCDE3E919), X(0x75E69C41), X(0x1DE5B089),
+        X(0x4E2DFD53), X(0x262ED19B), X(0x9E2BA4C3), X(0xF628880B),
+        X(0xEBCD3882), X(0x83CE144A), X(0x3BCB6112), X(0x53C84DDA),
+        X(0x9C5BFAA6), X(0xF458D66E), X(0x4C5DA336), X(0x245E8FFE),
+        X(0x39BB3F77), X(0x51B813BF), X(0xE9BD66E7), X(0x81BE4A2F),
+        X(0xD27607F5), X(0xBA752B3D), X(0x02705E65), X(0x6A7372AD),
+        X(0x7796C224), X(0x1F95EEEC), X(0xA7909BB4), X(0xCF93B77C),
+        X(0x3D5B83BD), X(0x5558AF75), X(0xED5DDA2D), X(0x855EF6E5),
+        X(0x98BB466C), X(0xF0B86AA4), X(0x48BD1FFC), X(0x20BE3334),
+        X(0x73767EEE), X(0x1B755226), X(0xA370277E), X(0xCB730BB6),
+        X(0xD696BB3F), X(0xBE9597F7), X(0x0690E2AF), X(0x6E93CE67),
+        X(0xA100791B), X(0xC90355D3), X(0x7106208B), X(0x19050C43),
+        X(0x04E0BCCA), X(0x6CE39002), X(0xD4E6E55A), X(0xBCE5C992),
+        X(0xEF2D8448), X(0x872EA880), X(0x3F2BDDD8), X(0x5728F110),
+        X(0x4ACD4199), X(0x22CE6D51), X(0x9ACB1809), X(0xF2C834C1),
+        X(0x7AB7077A), X(0x12B42BB2), X(0xAAB15EEA), X(0xC2B27222),
+        X(0xDF57C2AB), X(0xB754EE63), X(0x0F519B3B), X(0x6752B7F3),
+        X(0x349AFA29), X(0x5C99D6E1), X(0xE49CA3B9), X(0x8C9F8F71),
+        X(0x917A3FF8), X(0xF9791330), X(0x417C6668), X(0x297F4AA0),
+        X(0xE6ECFDDC), X(0x8EEFD114), X(0x36EAA44C), X(0x5EE98884),
+        X(0x430C380D), X(0x2B0F14C5), X(0x930A619D), X(0xFB094D55),
+        X(0xA8C1008F), X(0xC0C22C47), X(0x78C7591F), X(0x10C475D7),
+        X(0x0D21C55E), X(0x6522E996), X(0xDD279CCE), X(0xB524B006),
+        X(0x47EC84C7), X(0x2FEFA80F), X(0x97EADD57), X(0xFFE9F19F),
+        X(0xE20C4116), X(0x8A0F6DDE), X(0x320A1886), X(0x5A09344E),
+        X(0x09C17994), X(0x61C2555C), X(0xD9C72004), X(0xB1C40CCC),
+        X(0xAC21BC45), X(0xC422908D), X(0x7C27E5D5), X(0x1424C91D),
+        X(0xDBB77E61), X(0xB3B452A9), X(0x0BB127F1), X(0x63B20B39),
+        X(0x7E57BBB0), X(0x16549778), X(0xAE51E220), X(0xC652CEE8),
+        X(0x959A8332), X(0xFD99AFFA), X(0x459CDAA2), X(0x2D9FF66A),
+        X(0x307A46E3), X(0x58796A2B), X(0xE07C1F73), X(0x887F33BB),
+        X(0xF56E0EF4), X(0x9D6D223C), X(0x25685764), X(0x4D6B7BAC),
+        X(0x508ECB25), X(0x388DE7ED), X(0x808892B5), X(0xE88BBE7D),
+        X(0xBB43F3A7), X(0xD340DF6F), X(0x6B45AA37), X(0x034686FF),
+        X(0x1EA33676), X(0x76A01ABE), X(0xCEA56FE6), X(0xA6A6432E),
+        X(0x6935F452), X(0x0136D89A), X(0xB933ADC2), X(0xD130810A),
+        X(0xCCD53183), X(0xA4D61D4B), X(0x1CD36813), X(0x74D044DB),
+        X(0x27180901), X(0x4F1B25C9), X(0xF71E5091), X(0x9F1D7C59),
+        X(0x82F8CCD0), X(0xEAFBE018), X(0x52FE9540), X(0x3AFDB988),
+        X(0xC8358D49), X(0xA036A181), X(0x1833D4D9), X(0x7030F811),
+        X(0x6DD54898), X(0x05D66450), X(0xBDD31108), X(0xD5D03DC0),
+        X(0x8618701A), X(0xEE1B5CD2), X(0x561E298A), X(0x3E1D0542),
+        X(0x23F8B5CB), X(0x4BFB9903), X(0xF3FEEC5B), X(0x9BFDC093),
+        X(0x546E77EF), X(0x3C6D5B27), X(0x84682E7F), X(0xEC6B02B7),
+        X(0xF18EB23E), X(0x998D9EF6), X(0x2188EBAE), X(0x498BC766),
+        X(0x1A438ABC), X(0x7240A674), X(0xCA45D32C), X(0xA246FFE4),
+        X(0xBFA34F6D), X(0xD7A063A5), X(0x6FA516FD), X(0x07A63A35),
+        X(0x8FD9098E), X(0xE7DA2546), X(0x5FDF501E), X(0x37DC7CD6),
+        X(0x2A39CC5F), X(0x423AE097), X(0xFA3F95CF), X(0x923CB907),
+        X(0xC1F4F4DD), X(0xA9F7D815), X(0x11F2AD4D), X(0x79F18185),
+        X(0x6414310C), X(0x0C171DC4), X(0xB412689C), X(0xDC114454),
+        X(0x1382F328), X(0x7B81DFE0), X(0xC384AAB8), X(0xAB878670),
+        X(0xB66236F9), X(0xDE611A31), X(0x66646F69), X(0x0E6743A1),
+        X(0x5DAF0E7B), X(0x35AC22B3), X(0x8DA957EB), X(0xE5AA7B23),
+        X(0xF84FCBAA), X(0x904CE762), X(0x2849923A), X(0x404ABEF2),
+        X(0xB2828A33), X(0xDA81A6FB), X(0x6284D3A3), X(0x0A87FF6B),
+        X(0x17624FE2), X(0x7F61632A), X(0xC7641672), X(0xAF673ABA),
+        X(0xFCAF7760), X(0x94AC5BA8), X(0x2CA92EF0), X(0x44AA0238),
+        X(0x594FB2B1), X(0x314C9E79), X(0x8949EB21), X(0xE14AC7E9),
+        X(0x2ED97095), X(0x46DA5C5D), X(0xFEDF2905), X(0x96DC05CD),
+        X(0x8B39B544), X(0xE33A998C), X(0x5B3FECD4), X(0x333CC01C),
+        X(0x60F48DC6), X(0x08F7A10E), X(0xB0F2D456), X(0xD8F1F89E),
+        X(0xC5144817), X(0xAD1764DF), X(0x15121187), X(0x7D113D4F),
+    }, {
+        X(0x00000000), X(0x493C7D27), X(0x9278FA4E), X(0xDB448769),
+        X(0x211D826D), X(0x6821FF4A), X(0xB3657823), X(0xFA590504),
+        X(0x423B04DA), X(0x0B0779FD), X(0xD043FE94), X(0x997F83B3),
+        X(0x632686B7), X(0x2A1AFB90), X(0xF15E7CF9), X(0xB86201DE),
+        X(0x847609B4), X(0xCD4A7493), X(0x160EF3FA), X(0x5F328EDD),
+        X(0xA56B8BD9), X(0xEC57F6FE), X(0x37137197), X(0x7E2F0CB0),
+        X(0xC64D0D6E), X(0x8F717049), X(0x5435F720), X(0x1D098A07),
+        X(0xE7508F03), X(0xAE6CF224), X(0x7528754D), X(0x3C14086A),
+        X(0x0D006599), X(0x443C18BE), X(0x9F789FD7), X(0xD644E2F0),
+        X(0x2C1DE7F4), X(0x65219AD3), X(0xBE651DBA), X(0xF759609D),
+        X(0x4F3B6143), X(0x06071C64), X(0xDD439B0D), X(0x947FE62A),
+        X(0x6E26E32E), X(0x271A9E09), X(0xFC5E1960), X(0xB5626447),
+        X(0x89766C2D), X(0xC04A110A), X(0x1B0E9663), X(0x5232EB44),
+        X(0xA86BEE40), X(0xE1579367), X(0x3A13140E), X(0x732F6929),
+        X(0xCB4D68F7), X(0x827115D0), X(0x593592B9), X(0x1009EF9E),
+        X(0xEA50EA9A), X(0xA36C97BD), X(0x782810D4), X(0x31146DF3),
+        X(0x1A00CB32), X(0x533CB615), X(0x8878317C), X(0xC1444C5B),
+        X(0x3B1D495F), X(0x72213478), X(0xA965B311), X(0xE059CE36),
+        X(0x583BCFE8), X(0x1107B2CF), X(0xCA4335A6), X(0x837F4881),
+        X(0x79264D85), X(0x301A30A2), X(0xEB5EB7CB), X(0xA262CAEC),
+        X(0x9E76C286), X(0xD74ABFA1), X(0x0C0E38C8), X(0x453245EF),
+        X(0xBF6B40EB), X(0xF6573DCC), X(0x2D13BAA5), X(0x642FC782),
+        X(0xDC4DC65C), X(0x9571BB7B), X(0x4E353C12), X(0x07094135),
+        X(0xFD504431), X(0xB46C3916), X(0x6F28BE7F), X(0x2614C358),
+        X(0x1700AEAB), X(0x5E3CD38C), X(0x857854E5), X(0xCC4429C2),
+        X(0x361D2CC6), X(0x7F2151E1), X(0xA465D688), X(0xED59ABAF),
+        X(0x553BAA71), X(0x1C07D756), X(0xC743503F), X(0x8E7F2D18),
+        X(0x7426281C), X(0x3D1A553B), X(0xE65ED252), X(0xAF62AF75),
+        X(0x9376A71F), X(0xDA4ADA38), X(0x010E5D51), X(0x48322076),
+        X(0xB26B2572), X(0xFB575855), X(0x2013DF3C), X(0x692FA21B),
+        X(0xD14DA3C5), X(0x9871DEE2), X(0x4335598B), X(0x0A0924AC),
+        X(0xF05021A8), X(0xB96C5C8F), X(0x6228DBE6), X(0x2B14A6C1),
+        X(0x34019664), X(0x7D3DEB43), X(0xA6796C2A), X(0xEF45110D),
+        X(0x151C1409), X(0x5C20692E), X(0x8764EE47), X(0xCE589360),
+        X(0x763A92BE), X(0x3F06EF99), X(0xE44268F0), X(0xAD7E15D7),
+        X(0x572710D3), X(0x1E1B6DF4), X(0xC55FEA9D), X(0x8C6397BA),
+        X(0xB0779FD0), X(0xF94BE2F7), X(0x220F659E), X(0x6B3318B9),
+        X(0x916A1DBD), X(0xD856609A), X(0x0312E7F3), X(0x4A2E9AD4),
+        X(0xF24C9B0A), X(0xBB70E62D), X(0x60346144), X(0x29081C63),
+        X(0xD3511967), X(0x9A6D6440), X(0x4129E329), X(0x08159E0E),
+        X(0x3901F3FD), X(0x703D8EDA), X(0xAB7909B3), X(0xE2457494),
+        X(0x181C7190), X(0x51200CB7), X(0x8A648BDE), X(0xC358F6F9),
+        X(0x7B3AF727), X(0x32068A00), X(0xE9420D69), X(0xA07E704E),
+        X(0x5A27754A), X(0x131B086D), X(0xC85F8F04), X(0x8163F223),
+        X(0xBD77FA49), X(0xF44B876E), X(0x2F0F0007), X(0x66337D20),
+        X(0x9C6A7824), X(0xD5560503), X(0x0E12826A), X(0x472EFF4D),
+        X(0xFF4CFE93), X(0xB67083B4), X(0x6D3404DD), X(0x240879FA),
+        X(0xDE517CFE), X(0x976D01D9), X(0x4C2986B0), X(0x0515FB97),
+        X(0x2E015D56), X(0x673D2071), X(0xBC79A718), X(0xF545DA3F),
+        X(0x0F1CDF3B), X(0x4620A21C), X(0x9D642575), X(0xD4585852),
+        X(0x6C3A598C), X(0x250624AB), X(0xFE42A3C2), X(0xB77EDEE5),
+        X(0x4D27DBE1), X(0x041BA6C6), X(0xDF5F21AF), X(0x96635C88),
+        X(0xAA7754E2), X(0xE34B29C5), X(0x380FAEAC), X(0x7133D38B),
+        X(0x8B6AD68F), X(0xC256ABA8), X(0x19122CC1), X(0x502E51E6),
+        X(0xE84C5038), X(0xA1702D1F), X(0x7A34AA76), X(0x3308D751),
+        X(0xC951D255), X(0x806DAF72), X(0x5B29281B), X(0x1215553C),
+        X(0x230138CF), X(0x6A3D45E8), X(0xB179C281), X(0xF845BFA6),
+        X(0x021CBAA2), X(0x4B20C785), X(0x906440EC), X(0xD9583DCB),
+        X(0x613A3C15), X(0x28064132), X(0xF342C65B), X(0xBA7EBB7C),
+        X(0x4027BE78), X(0x091BC35F), X(0xD25F4436), X(0x9B633911),
+        X(0xA777317B), X(0xEE4B4C5C), X(0x350FCB35), X(0x7C33B612),
+        X(0x866AB316), X(0xCF56CE31), X(0x14124958), X(0x5D2E347F),
+        X(0xE54C35A1), X(0xAC704886), X(0x7734CFEF), X(0x3E08B2C8),
+        X(0xC451B7CC), X(0x8D6DCAEB), X(0x56294D82), X(0x1F1530A5),
+    }
+};
@@ -78,11 +78,49 @@ static uint64_t fast_icrc64(uint64_t crc, const uint8_t *buf, size_t size)
     return naive_icrc64(crc, buf, size & (size_t)3);
 }
 
+#ifdef __HAS_CPUID
+
+__attribute__((target("pclmul,sse2")))
+static uint64_t clmul_icrc64(uint64_t crc, const uint8_t *buf, size_t size)
+{
+    const __m128i k4 = _mm_set_epi64x(0x081f6054a7842df4, 0x6ae3efbb9dd441f3);
+    const __m128i k1 = _mm_set_epi64x(0xdabe95afc7875f40, 0xe05dd497ca393ae4);
+    uint8_t rem[16];
+    size_t done;
+
+    done = crc_clmul_fold(_mm_cvtsi64_si128(crc), buf, size, k4, k1, rem);
+    crc = naive_icrc64(0, rem, sizeof(rem));
+    return naive_icrc64(crc, buf + done, size - done);
+}
+
+static uint64_t resolve_icrc64(uint64_t crc, const uint8_t *buf, size_t size);
+static uint64_t (*large_icrc64)(uint64_t, const uint8_t *, size_t)
+    = &resolve_icrc64;
+
+static uint64_t resolve_icrc64(uint64_t crc, const uint8_t *buf, size_t size)
+{
+    int eax, ebx, ecx, edx;
+
+    __cpuid(1, eax, ebx, ecx, edx);
+    large_icrc64 = &fast_icrc64;
+    if (ecx & bit_PCLMUL) {
+        large_icrc64 = &clmul_icrc64;
+    }
+    return (*large_icrc64)(crc, buf, size);
+}
+
+#else
+
+static uint64_t (*large_icrc64)(uint64_t, const uint8_t *, size_t)
+    = &fast_icrc64;
+
+#endif
+
 __flatten
 uint64_t icrc64(uint64_t crc, const void *data, ssize_t len)
 {
     crc = ~le_to_cpu64(crc);
     if (len < 64)
         return ~le_to_cpu64(naive_icrc64(crc, data, len));
-    return ~le_to_cpu64(fast_icrc64(crc, data, len));
+    return ~le_to_cpu64((*large_icrc64)(crc, data, len));
 }
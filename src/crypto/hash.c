@@ -582,6 +582,204 @@ void murmur_hash3_x64_128(const void *key, size_t len,
     ((uint64_t*)out)[1] = h2;
 }
 
+/* {{{ wyhash */
+
+/*
+ * wyhash was written by Wang Yi, and is released into the public domain
+ * (The Unlicense). This follows its "final 4" version, with the default
+ * secret; the values are not meant to be compatible with other
+ * implementations, and must not be persisted.
+ *
+ * From https://github.com/wangyi-fudan/wyhash
+ */
+
+static const uint64_t wyhash_secret_g[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+    0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL,
+};
+#define WYP  wyhash_secret_g
+
+static ALWAYS_INLINE void wymum(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = *a;
+
+    r *= *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32;
+    uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static ALWAYS_INLINE uint64_t wymix(uint64_t a, uint64_t b)
+{
+    wymum(&a, &b);
+    return a ^ b;
+}
+
+static ALWAYS_INLINE uint64_t wyr8(const byte *p)
+{
+    return le_to_cpu64pu(p);
+}
+
+static ALWAYS_INLINE uint64_t wyr4(const byte *p)
+{
+    return le_to_cpu32pu(p);
+}
+
+static ALWAYS_INLINE uint64_t wyr3(const byte *p, size_t k)
+{
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1];
+}
+
+static ALWAYS_INLINE uint64_t wyhash64_seed(uint64_t seed)
+{
+    return seed ^ wymix(seed ^ WYP[0], WYP[1]);
+}
+
+/* Process 48 bytes blocks, while there are some. */
+static ALWAYS_INLINE const byte *
+wyhash64_blocks(uint64_t lanes[static 3], const byte *p, size_t *len)
+{
+    uint64_t seed = lanes[0], see1 = lanes[1], see2 = lanes[2];
+
+    for (; *len >= 48; *len -= 48, p += 48) {
+        seed = wymix(wyr8(p +  0) ^ WYP[1], wyr8(p +  8) ^ seed);
+        see1 = wymix(wyr8(p + 16) ^ WYP[2], wyr8(p + 24) ^ see1);
+        see2 = wymix(wyr8(p + 32) ^ WYP[3], wyr8(p + 40) ^ see2);
+    }
+    lanes[0] = seed;
+    lanes[1] = see1;
+    lanes[2] = see2;
+    return p;
+}
+
+/* Hash the last len (< 48) bytes at p, the 16 bytes before p being readable
+ * if len < 16. */
+static ALWAYS_INLINE uint64_t
+wyhash64_tail(uint64_t seed, const byte *p, size_t len, uint64_t total)
+{
+    uint64_t a, b;
+
+    for (; len > 16; len -= 16, p += 16) {
+        seed = wymix(wyr8(p) ^ WYP[1], wyr8(p + 8) ^ seed);
+    }
+    a = wyr8(p + len - 16);
+    b = wyr8(p + len - 8);
+
+    a ^= WYP[1];
+    b ^= seed;
+    wymum(&a, &b);
+    return wymix(a ^ WYP[0] ^ total, b ^ WYP[1]);
+}
+
+static ALWAYS_INLINE uint64_t
+wyhash64_short(uint64_t seed, const byte *p, size_t len)
+{
+    uint64_t a, b;
+
+    if (likely(len >= 4)) {
+        a = (wyr4(p) << 32) | wyr4(p + ((len >> 3) << 2));
+        b = (wyr4(p + len - 4) << 32) | wyr4(p + len - 4 - ((len >> 3) << 2));
+    } else
+    if (likely(len > 0)) {
+        a = wyr3(p, len);
+        b = 0;
+    } else {
+        a = b = 0;
+    }
+
+    a ^= WYP[1];
+    b ^= seed;
+    wymum(&a, &b);
+    return wymix(a ^ WYP[0] ^ len, b ^ WYP[1]);
+}
+
+uint64_t wyhash64(const void *data, size_t len, uint64_t seed)
+{
+    const byte *p = data;
+    size_t rem = len;
+    uint64_t lanes[3];
+
+    seed = wyhash64_seed(seed);
+    if (likely(len <= 16)) {
+        return wyhash64_short(seed, p, len);
+    }
+    if (unlikely(len >= 48)) {
+        lanes[0] = lanes[1] = lanes[2] = seed;
+        p = wyhash64_blocks(lanes, p, &rem);
+        seed = lanes[0] ^ lanes[1] ^ lanes[2];
+    }
+    return wyhash64_tail(seed, p, rem, len);
+}
+
+void wyhash64_starts(wyhash64_ctx *ctx, uint64_t seed)
+{
+    p_clear(ctx, 1);
+    seed = wyhash64_seed(seed);
+    ctx->lanes[0] = ctx->lanes[1] = ctx->lanes[2] = seed;
+}
+
+void wyhash64_update(wyhash64_ctx *ctx, const void *data, size_t len)
+{
+    const byte *p = data;
+
+    ctx->len += len;
+    if (ctx->buf_len) {
+        size_t n = MIN(len, sizeof(ctx->buf) - ctx->buf_len);
+
+        memcpy(ctx->buf + ctx->buf_len, p, n);
+        ctx->buf_len += n;
+        p += n;
+        len -= n;
+        if (ctx->buf_len < sizeof(ctx->buf)) {
+            return;
+        }
+        wyhash64_blocks(ctx->lanes, ctx->buf, &(size_t){ sizeof(ctx->buf) });
+        memcpy(ctx->last, ctx->buf + sizeof(ctx->buf) - sizeof(ctx->last),
+               sizeof(ctx->last));
+        ctx->buf_len = 0;
+    }
+    if (len >= sizeof(ctx->buf)) {
+        p = wyhash64_blocks(ctx->lanes, p, &len);
+        memcpy(ctx->last, p - sizeof(ctx->last), sizeof(ctx->last));
+    }
+    memcpy(ctx->buf, p, len);
+    ctx->buf_len = len;
+}
+
+uint64_t wyhash64_finish(wyhash64_ctx *ctx)
+{
+    byte tail[sizeof(ctx->last) + sizeof(ctx->buf)];
+    uint64_t seed = ctx->lanes[0];
+
+    if (ctx->len <= 16) {
+        return wyhash64_short(seed, ctx->buf, ctx->len);
+    }
+    if (ctx->len >= 48) {
+        seed ^= ctx->lanes[1] ^ ctx->lanes[2];
+    }
+
+    /* The tail may read up to 16 bytes before the remaining ones. */
+    memcpy(tail, ctx->last, sizeof(ctx->last));
+    memcpy(tail + sizeof(ctx->last), ctx->buf, ctx->buf_len);
+    return wyhash64_tail(seed, tail + sizeof(ctx->last), ctx->buf_len,
+                         ctx->len);
+}
+
+#undef WYP
+
+/* }}} */
 /* {{{ Hashers */
 
 uint64_t identity_hash_64(const void *data, ssize_t len)
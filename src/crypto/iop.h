@@ -42,4 +42,45 @@ enum {
 #undef F
 #undef ATTRS
 
+/** Cache of the digests of the sub-values of IOP objects.
+ *
+ * iop_hash64_cached() computes a Merkle-style 64-bit digest of an object:
+ * the sub-structures and the chunks of the large repeated fields are hashed
+ * separately, and their digests, cached by address, are hashed in place of
+ * their contents. Once an object has been hashed, hashing it again after a
+ * modification only rehashes the values on the path of the modification,
+ * provided the modification was declared with iop_hash_cache_invalidate().
+ *
+ * The digests are not the ones of iop_hash64(), but they are equal for
+ * equal objects whatever the state of the cache. A cache is not
+ * thread-safe.
+ */
+typedef struct iop_hash_cache_t iop_hash_cache_t;
+
+/** Create a cache; \p flags are the IOP_HASH_* flags of the digests. */
+iop_hash_cache_t * nonnull iop_hash_cache_new(unsigned flags);
+void iop_hash_cache_delete(iop_hash_cache_t * nullable * nonnull cache);
+
+/** Forget all the digests, to be called when the hashed objects are freed.
+ */
+void iop_hash_cache_clear(iop_hash_cache_t * nonnull cache);
+
+uint64_t iop_hash64_cached(iop_hash_cache_t * nonnull cache,
+                           const struct iop_struct_t * nonnull st,
+                           const void * nonnull v);
+
+/** Forget the digests of the values on a field path of an object.
+ *
+ * It must be called before modifying the value at \p path in \p v (the
+ * empty path for the whole object), while the path still leads to the
+ * values to modify: the digests of the structures on the path, of the
+ * chunks containing the array elements on the path, and of everything
+ * below the value at \p path, are forgotten.
+ *
+ * \return -1 if the path is invalid.
+ */
+int iop_hash_cache_invalidate(iop_hash_cache_t * nonnull cache,
+                              const struct iop_struct_t * nonnull st,
+                              const void * nonnull v, lstr_t path);
+
 #endif
@@ -64,6 +64,18 @@ ATTRS static inline void F(iop_hash_murmur_hash3_x86_32)(HASH_ARGS(4),
 
 ATTRS static inline void F(iop_hash32)(HASH_ARGS(4))       { HASH(hash32); }
 
+ATTRS static inline uint64_t
+F(iop_hash64)(const struct iop_struct_t * nonnull st, const void * nonnull v,
+              unsigned flags)
+{
+    wyhash64_ctx ctx;
+
+    F(wyhash64_starts)(&ctx, 0);
+    F(iop_hash)(st, v, (iop_hash_f *)&F(wyhash64_update), (void *)&ctx,
+                flags);
+    return F(wyhash64_finish)(&ctx);
+}
+
 ATTRS static inline void F(iop_hash_md5)(HASH_ARGS(16))    { HASH(md5); }
 ATTRS static inline void F(iop_hmac_md5)(HMAC_ARGS(16))    { HMAC(md5); }
 
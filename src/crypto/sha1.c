@@ -37,6 +37,14 @@
 #include <lib-common/z.h>
 #include <lib-common/hash.h>
 
+#ifdef __HAS_CPUID
+#   pragma push_macro("__leaf")
+#   undef __leaf
+#   include <cpuid.h>
+#   include <x86intrin.h>
+#   pragma pop_macro("__leaf")
+#endif
+
 /*
  * SHA-1 context setup
  */
@@ -52,7 +60,7 @@ void sha1_starts( sha1_ctx *ctx )
     ctx->state[4] = 0xC3D2E1F0;
 }
 
-static void sha1_process( sha1_ctx *ctx, const byte data[64] )
+static void sha1_process( uint32_t state[5], const byte data[64] )
 {
     uint32_t temp, W[16], A, B, C, D, E;
 
@@ -87,11 +95,11 @@ static void sha1_process( sha1_ctx *ctx, const byte data[64] )
     e += S(a,5) + F(b,c,d) + K + x; b = S(b,30);        \
 }
 
-    A = ctx->state[0];
-    B = ctx->state[1];
-    C = ctx->state[2];
-    D = ctx->state[3];
-    E = ctx->state[4];
+    A = state[0];
+    B = state[1];
+    C = state[2];
+    D = state[3];
+    E = state[4];
 
 #define F(x,y,z) (z ^ (x & (y ^ z)))
 #define K 0x5A827999
@@ -201,13 +209,128 @@ static void sha1_process( sha1_ctx *ctx, const byte data[64] )
 #undef K
 #undef F
 
-    ctx->state[0] += A;
-    ctx->state[1] += B;
-    ctx->state[2] += C;
-    ctx->state[3] += D;
-    ctx->state[4] += E;
+    state[0] += A;
+    state[1] += B;
+    state[2] += C;
+    state[3] += D;
+    state[4] += E;
+}
+
+static void sha1_process_blocks_c(uint32_t state[5], const byte *data,
+                                  size_t nb_blocks)
+{
+    for (; nb_blocks-- > 0; data += 64) {
+        sha1_process(state, data);
+    }
+}
+
+#ifdef __HAS_CPUID
+
+/* Rounds 4k to 4k + 3 using the SHA extensions, the message schedule for
+ * the next rounds is interleaved with the rounds computation. `E` is the
+ * register holding the E value of the current rounds and `E_next` receives
+ * the one of the next rounds. */
+#define SHA1_NI_ROUNDS(k, E, E_next)                                         \
+    do {                                                                     \
+        if (k < 4) {                                                         \
+            M[k] = _mm_shuffle_epi8(                                         \
+                _mm_loadu_si128((const __m128i *)(data + 16 * k)), mask);    \
+        }                                                                    \
+        if (k == 0) {                                                        \
+            E = _mm_add_epi32(E, M[0]);                                      \
+        } else {                                                             \
+            E = _mm_sha1nexte_epu32(E, M[k & 3]);                            \
+        }                                                                    \
+        E_next = abcd;                                                       \
+        if (k >= 3 && k <= 18) {                                             \
+            M[(k + 1) & 3] = _mm_sha1msg2_epu32(M[(k + 1) & 3], M[k & 3]);   \
+        }                                                                    \
+        abcd = _mm_sha1rnds4_epu32(abcd, E, k / 5);                          \
+        if (k >= 1 && k <= 16) {                                             \
+            M[(k - 1) & 3] = _mm_sha1msg1_epu32(M[(k - 1) & 3], M[k & 3]);   \
+        }                                                                    \
+        if (k >= 2 && k <= 17) {                                             \
+            M[(k - 2) & 3] = _mm_xor_si128(M[(k - 2) & 3], M[k & 3]);        \
+        }                                                                    \
+    } while (0)
+
+__attribute__((target("sha,sse4.1")))
+static void sha1_process_blocks_ni(uint32_t state[5], const byte *data,
+                                   size_t nb_blocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,
+                                        0x08090a0b0c0d0e0fULL);
+    __m128i abcd, e0, e1;
+    __m128i M[4];
+
+    abcd = _mm_loadu_si128((const __m128i *)state);
+    abcd = _mm_shuffle_epi32(abcd, 0x1b);
+    e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+    for (; nb_blocks-- > 0; data += 64) {
+        __m128i abcd_save = abcd;
+        __m128i e0_save = e0;
+
+        SHA1_NI_ROUNDS( 0, e0, e1);
+        SHA1_NI_ROUNDS( 1, e1, e0);
+        SHA1_NI_ROUNDS( 2, e0, e1);
+        SHA1_NI_ROUNDS( 3, e1, e0);
+        SHA1_NI_ROUNDS( 4, e0, e1);
+        SHA1_NI_ROUNDS( 5, e1, e0);
+        SHA1_NI_ROUNDS( 6, e0, e1);
+        SHA1_NI_ROUNDS( 7, e1, e0);
+        SHA1_NI_ROUNDS( 8, e0, e1);
+        SHA1_NI_ROUNDS( 9, e1, e0);
+        SHA1_NI_ROUNDS(10, e0, e1);
+        SHA1_NI_ROUNDS(11, e1, e0);
+        SHA1_NI_ROUNDS(12, e0, e1);
+        SHA1_NI_ROUNDS(13, e1, e0);
+        SHA1_NI_ROUNDS(14, e0, e1);
+        SHA1_NI_ROUNDS(15, e1, e0);
+        SHA1_NI_ROUNDS(16, e0, e1);
+        SHA1_NI_ROUNDS(17, e1, e0);
+        SHA1_NI_ROUNDS(18, e0, e1);
+        SHA1_NI_ROUNDS(19, e1, e0);
+
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    abcd = _mm_shuffle_epi32(abcd, 0x1b);
+    _mm_storeu_si128((__m128i *)state, abcd);
+    state[4] = _mm_extract_epi32(e0, 3);
+}
+
+#undef SHA1_NI_ROUNDS
+
+static void sha1_process_blocks_resolve(uint32_t state[5], const byte *data,
+                                        size_t nb_blocks);
+
+static void (*sha1_process_blocks)(uint32_t[5], const byte *, size_t)
+    = &sha1_process_blocks_resolve;
+
+static void sha1_process_blocks_resolve(uint32_t state[5], const byte *data,
+                                        size_t nb_blocks)
+{
+    unsigned eax, ebx, ecx, edx;
+
+    sha1_process_blocks = &sha1_process_blocks_c;
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA)) {
+        __cpuid(1, eax, ebx, ecx, edx);
+        if (ecx & bit_SSE4_1) {
+            sha1_process_blocks = &sha1_process_blocks_ni;
+        }
+    }
+    (*sha1_process_blocks)(state, data, nb_blocks);
 }
 
+#else
+
+static void (*sha1_process_blocks)(uint32_t[5], const byte *, size_t)
+    = &sha1_process_blocks_c;
+
+#endif
+
 /*
  * SHA-1 process buffer
  */
@@ -233,17 +356,17 @@ void sha1_update( sha1_ctx *ctx, const void *_input, ssize_t ilen )
     {
         memcpy( (void *) (ctx->buffer + left),
                 (void *) input, fill );
-        sha1_process( ctx, ctx->buffer );
+        (*sha1_process_blocks)( ctx->state, ctx->buffer, 1 );
         input += fill;
         ilen  -= fill;
         left = 0;
     }
 
-    while( ilen >= 64 )
+    if( ilen >= 64 )
     {
-        sha1_process( ctx, input );
-        input += 64;
-        ilen  -= 64;
+        (*sha1_process_blocks)( ctx->state, input, ilen / 64 );
+        input += ilen & ~63;
+        ilen  &= 63;
     }
 
     if( ilen > 0 )
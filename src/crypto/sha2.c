@@ -37,6 +37,19 @@
 #include <lib-common/z.h>
 #include <lib-common/hash.h>
 
+#ifdef __HAS_CPUID
+#   pragma push_macro("__leaf")
+#   undef __leaf
+#   include <cpuid.h>
+#   include <x86intrin.h>
+#   pragma pop_macro("__leaf")
+#endif
+
+/* sha2_process_blocks() is selected at runtime, see below. */
+#define SHA2_HAS_PROCESS_BLOCKS
+static void sha2_process_blocks(uint32_t state[8], const byte *data,
+                                size_t nb_blocks);
+
 #define ATTRS
 #define F(x)  x
 
@@ -45,6 +58,326 @@
 #undef F
 #undef ATTRS
 
+/* {{{ Accelerated implementations */
+
+static const uint32_t sha2_k_g[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5,
+    0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+    0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC,
+    0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7,
+    0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+    0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3,
+    0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5,
+    0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+    0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+static void sha2_process_blocks_c(uint32_t state[8], const byte *data,
+                                  size_t nb_blocks)
+{
+    for (; nb_blocks-- > 0; data += 64) {
+        sha2_process(state, data);
+    }
+}
+
+/* Processes 8 blocks of 8 independent messages, `state[i][lane]` is the
+ * i-th word of the state of the message in `lane`. */
+typedef void (sha2_process_x8_f)(uint32_t state[8][8],
+                                 const byte * const blocks[8]);
+
+static void sha2_process_x8_seq(uint32_t state[8][8],
+                              const byte * const blocks[8])
+{
+    for (int lane = 0; lane < 8; lane++) {
+        uint32_t lane_state[8];
+
+        for (int i = 0; i < 8; i++) {
+            lane_state[i] = state[i][lane];
+        }
+        sha2_process_blocks(lane_state, blocks[lane], 1);
+        for (int i = 0; i < 8; i++) {
+            state[i][lane] = lane_state[i];
+        }
+    }
+}
+
+#ifdef __HAS_CPUID
+
+/* Rounds 4k to 4k + 3 using the SHA extensions, the message schedule for
+ * the next rounds is interleaved with the rounds computation. */
+#define SHA2_NI_ROUNDS(k)                                                    \
+    do {                                                                     \
+        __m128i msg;                                                         \
+                                                                             \
+        if (k < 4) {                                                         \
+            M[k] = _mm_shuffle_epi8(                                         \
+                _mm_loadu_si128((const __m128i *)(data + 16 * k)), mask);    \
+        }                                                                    \
+        msg = _mm_add_epi32(M[k & 3],                                        \
+                            _mm_loadu_si128((const __m128i *)&sha2_k_g[4 * k])); \
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);                 \
+        if (k >= 3 && k <= 14) {                                             \
+            M[(k + 1) & 3] = _mm_add_epi32(M[(k + 1) & 3],                   \
+                _mm_alignr_epi8(M[k & 3], M[(k - 1) & 3], 4));               \
+            M[(k + 1) & 3] = _mm_sha256msg2_epu32(M[(k + 1) & 3], M[k & 3]); \
+        }                                                                    \
+        msg = _mm_shuffle_epi32(msg, 0x0e);                                  \
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);                 \
+        if (k >= 1 && k <= 12) {                                             \
+            M[(k - 1) & 3] = _mm_sha256msg1_epu32(M[(k - 1) & 3], M[k & 3]); \
+        }                                                                    \
+    } while (0)
+
+__attribute__((target("sha,sse4.1")))
+static void sha2_process_blocks_ni(uint32_t state[8], const byte *data,
+                                   size_t nb_blocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                        0x0405060700010203ULL);
+    __m128i state0, state1, tmp;
+    __m128i M[4];
+
+    /* The instructions work on the ABEF and CDGH halves of the state. */
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]),
+                            0xb1);
+    state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]),
+                               0x1b);
+    state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+    for (; nb_blocks-- > 0; data += 64) {
+        __m128i abef_save = state0;
+        __m128i cdgh_save = state1;
+
+        SHA2_NI_ROUNDS( 0);
+        SHA2_NI_ROUNDS( 1);
+        SHA2_NI_ROUNDS( 2);
+        SHA2_NI_ROUNDS( 3);
+        SHA2_NI_ROUNDS( 4);
+        SHA2_NI_ROUNDS( 5);
+        SHA2_NI_ROUNDS( 6);
+        SHA2_NI_ROUNDS( 7);
+        SHA2_NI_ROUNDS( 8);
+        SHA2_NI_ROUNDS( 9);
+        SHA2_NI_ROUNDS(10);
+        SHA2_NI_ROUNDS(11);
+        SHA2_NI_ROUNDS(12);
+        SHA2_NI_ROUNDS(13);
+        SHA2_NI_ROUNDS(14);
+        SHA2_NI_ROUNDS(15);
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128((__m128i *)&state[0], state0);
+    _mm_storeu_si128((__m128i *)&state[4], state1);
+}
+
+#undef SHA2_NI_ROUNDS
+
+#define MM256_ROTR(x, n)                                                     \
+    _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+
+/* Transposes the 8x8 matrix of 32-bits words in `r`. */
+__attribute__((target("avx2")))
+static ALWAYS_INLINE void mm256_transpose8x32(__m256i r[8])
+{
+    __m256i t[8], u[8];
+
+    for (int i = 0; i < 4; i++) {
+        t[2 * i]     = _mm256_unpacklo_epi32(r[2 * i], r[2 * i + 1]);
+        t[2 * i + 1] = _mm256_unpackhi_epi32(r[2 * i], r[2 * i + 1]);
+    }
+    for (int i = 0; i < 2; i++) {
+        u[4 * i]     = _mm256_unpacklo_epi64(t[4 * i],     t[4 * i + 2]);
+        u[4 * i + 1] = _mm256_unpackhi_epi64(t[4 * i],     t[4 * i + 2]);
+        u[4 * i + 2] = _mm256_unpacklo_epi64(t[4 * i + 1], t[4 * i + 3]);
+        u[4 * i + 3] = _mm256_unpackhi_epi64(t[4 * i + 1], t[4 * i + 3]);
+    }
+    for (int i = 0; i < 4; i++) {
+        r[i]     = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+        r[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+    }
+}
+
+/* Each 32-bits lane of the AVX2 registers computes the rounds of one of the
+ * 8 messages. */
+__attribute__((target("avx2")))
+static void sha2_process_x8_avx2(uint32_t state[8][8],
+                                 const byte * const blocks[8])
+{
+    const __m256i bswap = _mm256_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                            0x0405060700010203ULL,
+                                            0x0c0d0e0f08090a0bULL,
+                                            0x0405060700010203ULL);
+    __m256i W[16];
+    __m256i s[8];
+    __m256i a, b, c, d, e, f, g, h;
+
+    for (int half = 0; half < 2; half++) {
+        __m256i *r = &W[8 * half];
+
+        for (int lane = 0; lane < 8; lane++) {
+            r[lane] = _mm256_loadu_si256((const __m256i *)
+                                         (blocks[lane] + 32 * half));
+        }
+        mm256_transpose8x32(r);
+        for (int i = 0; i < 8; i++) {
+            r[i] = _mm256_shuffle_epi8(r[i], bswap);
+        }
+    }
+
+    for (int i = 0; i < 8; i++) {
+        s[i] = _mm256_loadu_si256((const __m256i *)state[i]);
+    }
+    a = s[0]; b = s[1]; c = s[2]; d = s[3];
+    e = s[4]; f = s[5]; g = s[6]; h = s[7];
+
+    for (int t = 0; t < 64; t++) {
+        __m256i t1, t2;
+
+        if (t >= 16) {
+            __m256i w2  = W[(t - 2) & 15];
+            __m256i w15 = W[(t - 15) & 15];
+            __m256i s0, s1;
+
+            s0 = _mm256_xor_si256(_mm256_xor_si256(MM256_ROTR(w15, 7),
+                                                   MM256_ROTR(w15, 18)),
+                                  _mm256_srli_epi32(w15, 3));
+            s1 = _mm256_xor_si256(_mm256_xor_si256(MM256_ROTR(w2, 17),
+                                                   MM256_ROTR(w2, 19)),
+                                  _mm256_srli_epi32(w2, 10));
+            W[t & 15] = _mm256_add_epi32(
+                _mm256_add_epi32(W[t & 15], s0),
+                _mm256_add_epi32(W[(t - 7) & 15], s1));
+        }
+
+        t1 = _mm256_xor_si256(_mm256_xor_si256(MM256_ROTR(e, 6),
+                                               MM256_ROTR(e, 11)),
+                              MM256_ROTR(e, 25));
+        t1 = _mm256_add_epi32(_mm256_add_epi32(h, t1),
+                              _mm256_xor_si256(g, _mm256_and_si256(e,
+                                  _mm256_xor_si256(f, g))));
+        t1 = _mm256_add_epi32(t1, _mm256_add_epi32(
+                _mm256_set1_epi32(sha2_k_g[t]), W[t & 15]));
+        t2 = _mm256_xor_si256(_mm256_xor_si256(MM256_ROTR(a, 2),
+                                               MM256_ROTR(a, 13)),
+                              MM256_ROTR(a, 22));
+        t2 = _mm256_add_epi32(t2, _mm256_or_si256(_mm256_and_si256(a, b),
+                 _mm256_and_si256(c, _mm256_or_si256(a, b))));
+
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+
+    s[0] = _mm256_add_epi32(s[0], a);
+    s[1] = _mm256_add_epi32(s[1], b);
+    s[2] = _mm256_add_epi32(s[2], c);
+    s[3] = _mm256_add_epi32(s[3], d);
+    s[4] = _mm256_add_epi32(s[4], e);
+    s[5] = _mm256_add_epi32(s[5], f);
+    s[6] = _mm256_add_epi32(s[6], g);
+    s[7] = _mm256_add_epi32(s[7], h);
+    for (int i = 0; i < 8; i++) {
+        _mm256_storeu_si256((__m256i *)state[i], s[i]);
+    }
+}
+
+#undef MM256_ROTR
+
+__attribute__((target("xsave")))
+static bool sha2_cpu_has_avx2(void)
+{
+    unsigned eax, ebx, ecx, edx;
+
+    __cpuid(1, eax, ebx, ecx, edx);
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) {
+        return false;
+    }
+    /* The OS must save the YMM registers on context switches. */
+    if ((_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)
+        && (ebx & bit_AVX2);
+}
+
+static bool sha2_cpu_has_sha_ni(void)
+{
+    unsigned eax, ebx, ecx, edx;
+
+    __cpuid(1, eax, ebx, ecx, edx);
+    if (!(ecx & bit_SSE4_1)) {
+        return false;
+    }
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)
+        && (ebx & bit_SHA);
+}
+
+static void sha2_process_blocks_resolve(uint32_t state[8], const byte *data,
+                                        size_t nb_blocks);
+static void sha2_process_x8_resolve(uint32_t state[8][8],
+                                    const byte * const blocks[8]);
+
+static void (*sha2_process_blocks_impl)(uint32_t[8], const byte *, size_t)
+    = &sha2_process_blocks_resolve;
+static sha2_process_x8_f *sha2_process_x8 = &sha2_process_x8_resolve;
+
+static void sha2_process_blocks_resolve(uint32_t state[8], const byte *data,
+                                        size_t nb_blocks)
+{
+    sha2_process_blocks_impl = &sha2_process_blocks_c;
+    if (sha2_cpu_has_sha_ni()) {
+        sha2_process_blocks_impl = &sha2_process_blocks_ni;
+    }
+    (*sha2_process_blocks_impl)(state, data, nb_blocks);
+}
+
+static void sha2_process_x8_resolve(uint32_t state[8][8],
+                                    const byte * const blocks[8])
+{
+    /* A single lane with the SHA extensions is as fast as AVX2 on 8. */
+    sha2_process_x8 = &sha2_process_x8_seq;
+    if (!sha2_cpu_has_sha_ni() && sha2_cpu_has_avx2()) {
+        sha2_process_x8 = &sha2_process_x8_avx2;
+    }
+    (*sha2_process_x8)(state, blocks);
+}
+
+#else
+
+static void (*sha2_process_blocks_impl)(uint32_t[8], const byte *, size_t)
+    = &sha2_process_blocks_c;
+static sha2_process_x8_f *sha2_process_x8 = &sha2_process_x8_seq;
+
+#endif
+
+static void sha2_process_blocks(uint32_t state[8], const byte *data,
+                                size_t nb_blocks)
+{
+    (*sha2_process_blocks_impl)(state, data, nb_blocks);
+}
+
+/* }}} */
+
 void sha2_finish_hex( sha2_ctx *ctx, char output[65] )
 {
     byte digest[32];
@@ -126,6 +459,158 @@ void sha2_hmac( const void *key, int keylen,
     memset( &ctx, 0, sizeof( sha2_ctx ) );
 }
 
+/* {{{ Multi-buffer hashing */
+
+/* A lane hashes one message: its full blocks are read in place, and the
+ * last bytes are copied with the padding in `tail`. */
+typedef struct sha2_lane_t {
+    const byte *data;
+    size_t nb_full;
+    size_t nb_blocks;
+    size_t pos;
+    int msg;
+    byte tail[128];
+} sha2_lane_t;
+
+/* `prefix_len` is the number of bytes already hashed in the initial state,
+ * which is taken into account in the padding. */
+static void sha2_lane_init(sha2_lane_t *lane, int msg, const void *input,
+                           size_t ilen, size_t prefix_len)
+{
+    size_t rem = ilen % 64;
+    size_t nb_tail = rem < 56 ? 1 : 2;
+    uint64_t bits = (uint64_t)(prefix_len + ilen) << 3;
+
+    lane->data = input;
+    lane->nb_full = ilen / 64;
+    lane->nb_blocks = lane->nb_full + nb_tail;
+    lane->pos = 0;
+    lane->msg = msg;
+
+    p_copy(lane->tail, (const byte *)input + ilen - rem, rem);
+    lane->tail[rem] = 0x80;
+    p_clear(lane->tail + rem + 1, nb_tail * 64 - rem - 1);
+    PUT_U32_BE(bits >> 32, lane->tail, nb_tail * 64 - 8);
+    PUT_U32_BE(bits,       lane->tail, nb_tail * 64 - 4);
+}
+
+static const byte *sha2_lane_block(const sha2_lane_t *lane)
+{
+    if (lane->pos < lane->nb_full) {
+        return lane->data + 64 * lane->pos;
+    }
+    return lane->tail + 64 * (lane->pos - lane->nb_full);
+}
+
+/* Hashes `count` messages from the initial state `iv`, 8 at a time. */
+static void sha2_multi_from(const uint32_t iv[8], size_t prefix_len,
+                            const void * const *inputs, const ssize_t *ilens,
+                            int count, byte (*outputs)[32], int is224)
+{
+    static const byte idle_block[64];
+    sha2_lane_t lanes[8];
+    uint32_t state[8][8];
+    int next = 0;
+    int active = 0;
+
+    for (int lane = 0; lane < 8; lane++) {
+        lanes[lane].msg = -1;
+    }
+
+    for (;;) {
+        const byte *blocks[8];
+
+        /* Feed the idle lanes with the next messages. */
+        for (int lane = 0; lane < 8 && next < count; lane++) {
+            if (lanes[lane].msg >= 0) {
+                continue;
+            }
+            assert (ilens[next] >= 0);
+            sha2_lane_init(&lanes[lane], next, inputs[next], ilens[next],
+                           prefix_len);
+            for (int i = 0; i < 8; i++) {
+                state[i][lane] = iv[i];
+            }
+            next++;
+            active++;
+        }
+        if (!active) {
+            break;
+        }
+
+        for (int lane = 0; lane < 8; lane++) {
+            if (lanes[lane].msg >= 0) {
+                blocks[lane] = sha2_lane_block(&lanes[lane]);
+            } else {
+                blocks[lane] = idle_block;
+            }
+        }
+        (*sha2_process_x8)(state, blocks);
+
+        for (int lane = 0; lane < 8; lane++) {
+            sha2_lane_t *l = &lanes[lane];
+
+            if (l->msg < 0 || ++l->pos < l->nb_blocks) {
+                continue;
+            }
+            for (int i = 0; i < 7 + !is224; i++) {
+                PUT_U32_BE(state[i][lane], outputs[l->msg], 4 * i);
+            }
+            l->msg = -1;
+            active--;
+        }
+    }
+
+    p_clear(&lanes, 1);
+    p_clear(&state, 1);
+}
+
+void sha2_multi(const void * const *inputs, const ssize_t *ilens, int count,
+                byte (*outputs)[32], int is224)
+{
+    sha2_ctx ctx;
+
+    sha2_starts(&ctx, is224);
+    sha2_multi_from(ctx.state, 0, inputs, ilens, count, outputs, is224);
+}
+
+void sha2_hmac_multi(const void *key, int keylen,
+                     const void * const *inputs, const ssize_t *ilens,
+                     int count, byte (*outputs)[32], int is224)
+{
+    const int hlen = is224 ? 28 : 32;
+    uint32_t inner[8];
+    uint32_t outer[8];
+    sha2_ctx ctx;
+
+    /* Both padded keys are hashed once for all the messages. */
+    sha2_hmac_starts(&ctx, key, keylen, is224);
+    memcpy(inner, ctx.state, sizeof(inner));
+    sha2_starts(&ctx, is224);
+    sha2_process_blocks(ctx.state, ctx.opad, 1);
+    memcpy(outer, ctx.state, sizeof(outer));
+
+    sha2_multi_from(inner, 64, inputs, ilens, count, outputs, is224);
+
+    for (int i = 0; i < count; i += 64) {
+        const void *digests[64];
+        ssize_t lens[64];
+        int n = MIN(count - i, 64);
+
+        for (int j = 0; j < n; j++) {
+            digests[j] = outputs[i + j];
+            lens[j] = hlen;
+        }
+        sha2_multi_from(outer, 64, digests, lens, n, outputs + i, is224);
+    }
+
+    p_clear(&ctx, 1);
+    p_clear(&inner, 1);
+    p_clear(&outer, 1);
+}
+
+/* }}} */
+
 /* {{{ SHA-256 Crypt */
 
 /* Based on Ulrich Drepper's Unix crypt with SHA256, version 0.4 2008-4-3,
@@ -144,6 +144,42 @@ void sha2_hmac(const void * nonnull key, int keylen,
                const void * nonnull input, ssize_t ilen,
                byte output[32], int is224) __leaf;
 
+/**
+ * \brief          SHA-256 of several independent messages
+ *
+ * The messages are hashed in parallel lanes, which is much faster than
+ * hashing them one by one when they are small and the CPU supports AVX2.
+ *
+ * \param inputs   buffers holding the messages
+ * \param ilens    lengths of the messages
+ * \param count    number of messages
+ * \param outputs  SHA-224/256 checksum results, one per message
+ * \param is224    0 = use SHA256, 1 = use SHA224
+ */
+void sha2_multi(const void * nonnull const * nonnull inputs,
+                const ssize_t * nonnull ilens, int count,
+                byte (* nonnull outputs)[32], int is224) __leaf;
+
+/**
+ * \brief          HMAC-SHA-256 of several independent messages with the
+ *                 same key
+ *
+ * Same as calling sha2_hmac() for each message, but the padded key is
+ * hashed only once and the messages are processed as in sha2_multi().
+ *
+ * \param key      HMAC secret key
+ * \param keylen   length of the HMAC key
+ * \param inputs   buffers holding the messages
+ * \param ilens    lengths of the messages
+ * \param count    number of messages
+ * \param outputs  HMAC-SHA-224/256 results, one per message
+ * \param is224    0 = use SHA256, 1 = use SHA224
+ */
+void sha2_hmac_multi(const void * nonnull key, int keylen,
+                     const void * nonnull const * nonnull inputs,
+                     const ssize_t * nonnull ilens, int count,
+                     byte (* nonnull outputs)[32], int is224) __leaf;
+
 #define SHA256_CRYPT_SALT_LEN_MAX    16
 #define SHA256_CRYPT_DEFAULT_ROUNDS  5000
 #define SHA256_CRYPT_MIN_ROUNDS      1000
@@ -76,7 +76,7 @@ void F(sha2_starts)( sha2_ctx *ctx, int is224 )
 }
 
 ATTRS
-static void F(sha2_process)( sha2_ctx *ctx, const byte data[64] )
+static void F(sha2_process)( uint32_t state[8], const byte data[64] )
 {
     uint32_t temp1, temp2, W[64];
     uint32_t A, B, C, D, E, F, G, H;
@@ -123,14 +123,14 @@ static void F(sha2_process)( sha2_ctx *ctx, const byte data[64] )
     d += temp1; h = temp1 + temp2;              \
 }
 
-    A = ctx->state[0];
-    B = ctx->state[1];
-    C = ctx->state[2];
-    D = ctx->state[3];
-    E = ctx->state[4];
-    F = ctx->state[5];
-    G = ctx->state[6];
-    H = ctx->state[7];
+    A = state[0];
+    B = state[1];
+    C = state[2];
+    D = state[3];
+    E = state[4];
+    F = state[5];
+    G = state[6];
+    H = state[7];
 
     P( A, B, C, D, E, F, G, H, W[ 0], 0x428A2F98 );
     P( H, A, B, C, D, E, F, G, W[ 1], 0x71374491 );
@@ -197,16 +197,30 @@ static void F(sha2_process)( sha2_ctx *ctx, const byte data[64] )
     P( C, D, E, F, G, H, A, B, R(62), 0xBEF9A3F7 );
     P( B, C, D, E, F, G, H, A, R(63), 0xC67178F2 );
 
-    ctx->state[0] += A;
-    ctx->state[1] += B;
-    ctx->state[2] += C;
-    ctx->state[3] += D;
-    ctx->state[4] += E;
-    ctx->state[5] += F;
-    ctx->state[6] += G;
-    ctx->state[7] += H;
+    state[0] += A;
+    state[1] += B;
+    state[2] += C;
+    state[3] += D;
+    state[4] += E;
+    state[5] += F;
+    state[6] += G;
+    state[7] += H;
 }
 
+#ifndef SHA2_HAS_PROCESS_BLOCKS
+/* The includer can provide its own (accelerated) implementation of
+ * sha2_process_blocks() by declaring it and defining SHA2_HAS_PROCESS_BLOCKS.
+ */
+ATTRS
+static void F(sha2_process_blocks)( uint32_t state[8], const byte *data,
+                                    size_t nb_blocks )
+{
+    for (; nb_blocks-- > 0; data += 64) {
+        F(sha2_process)(state, data);
+    }
+}
+#endif
+
 /*
  * SHA-256 process buffer
  */
@@ -236,17 +250,17 @@ void F(sha2_update)( sha2_ctx *ctx, const void *_input, ssize_t ilen )
     {
         memcpy( (void *) (ctx->buffer + left),
                 (void *) input, fill );
-        F(sha2_process)( ctx, ctx->buffer );
+        F(sha2_process_blocks)( ctx->state, ctx->buffer, 1 );
         input += fill;
         ilen  -= fill;
         left = 0;
     }
 
-    while( ilen >= 64 )
+    if( ilen >= 64 )
     {
-        F(sha2_process)( ctx, input );
-        input += 64;
-        ilen  -= 64;
+        F(sha2_process_blocks)( ctx->state, input, ilen / 64 );
+        input += ilen & ~63;
+        ilen  &= 63;
     }
 
     if( ilen > 0 )
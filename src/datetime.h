@@ -191,6 +191,35 @@ time_t lstrtotime(lstr_t date);
 struct tm *time_get_localtime(const time_t *p_ts, struct tm *p_tm,
                               const char *tz);
 
+/** Thread-safe gmtime_r() replacement.
+ *
+ * The calendar is computed arithmetically, without going through the libc
+ * and its timezone lock.
+ *
+ * \return \p tm, or NULL if the year does not fit in an int.
+ */
+struct tm *time_gmtime(time_t t, struct tm *tm);
+
+/** localtime_r() replacement for the system local time.
+ *
+ * The UTC offset of the system timezone is kept per thread for the current
+ * minute, so that consecutive calls in a given minute only compute the
+ * calendar, as time_gmtime() does. The cache is dropped when the TZ
+ * environment variable is changed.
+ *
+ * \return \p tm, or NULL on error.
+ */
+struct tm *time_localtime(time_t t, struct tm *tm);
+
+/** Count the number of days between January 1st, 1970 and a date.
+ *
+ * \param[in] year  the year.
+ * \param[in] mon   the month [0, 11].
+ * \param[in] mday  the day of the month.
+ * \return the number of days, negative for dates before 1970.
+ */
+int64_t time_days_from_civil(int64_t year, int mon, int mday);
+
 /* Format a timestamp according to given locale and format.
  * locale should be a string similar to the output of the locale (unix)
  * command. If empty the system locale will be used.
@@ -360,86 +389,29 @@ time_get_gmt_delta(const struct tm *tm, int *delta_h, int *delta_m)
 /* XXX: Array parameter qualifiers are not supported in C++98. */
 #ifndef __cplusplus
 
-static inline void time_fmt_iso8601(char buf[static 21], time_t t)
-{
-    int len;
-    struct tm tm;
-
-    if (!gmtime_r(&t, &tm)) {
-        e_panic("invalid timestamp: %jd", t);
-    }
-    len = snprintf(buf, 21, ISO8601_GMT_FMT, ISO8601_GMT_FMT_ARG(&tm));
-    if (len >= 21) {
-        e_panic("invalid timestamp: %jd", t);
-    }
-}
-
-/* Format a timestamp into a local ISO 8601 time. This function calls the
- * time_get_localtime function, so you should not call it concurrently to
- * another call of it or to a call to the time_get_localtime or to the
- * localtime_r function. See time_get_localtime for more information.
+/* The formatting functions below keep the date of the last second they
+ * formatted per thread, so that formatting timestamps of the same second
+ * only costs a copy.
  */
-static inline void time_fmt_localtime_iso8601(char buf[static 26], time_t t,
-                                              const char *tz)
-{
-    int len;
-    struct tm tm;
-    int delta_h, delta_m;
 
-    time_get_localtime(&t, &tm, tz);
-    time_get_gmt_delta(&tm, &delta_h, &delta_m);
+void time_fmt_iso8601(char buf[static 21], time_t t);
 
-    len = snprintf(buf, 26, ISO8601_TZ_FMT,
-                   ISO8601_TZ_FMT_ARG(&tm, delta_h, delta_m));
-    if (len >= 26) {
-        e_panic("invalid timestamp: %jd", t);
-    }
-}
+/* Format a timestamp into a local ISO 8601 time. When \p tz is not NULL,
+ * this function calls the time_get_localtime function, so you should not
+ * call it concurrently to another call of it or to a call to the
+ * time_get_localtime or to the localtime_r function. See time_get_localtime
+ * for more information.
+ */
+void time_fmt_localtime_iso8601(char buf[static 26], time_t t,
+                                const char *tz);
 
-static inline void time_fmt_iso8601_msec(char buf[static 25], time_t t,
-                                         int msec)
-{
-    int len;
-    struct tm tm;
+void time_fmt_iso8601_msec(char buf[static 25], time_t t, int msec);
 
-    /* XXX %03d gives a minimum width but not a maximum one, so we need to be
-     * careful and not overflow the buffer of size 25 with invalid inputs.
-     */
-    if (msec < 0 || msec >= 1000) {
-        e_panic("invalid msec: %d", msec);
-    }
-    if (!gmtime_r(&t, &tm)) {
-        e_panic("invalid timestamp: %jd", t);
-    }
-    len = snprintf(buf, 25, ISO8601_GMT_MSEC_FMT,
-                   ISO8601_GMT_MSEC_FMT_ARG(&tm, msec));
-    if (len >= 25) {
-        e_panic("invalid timestamp: %jd", t);
-    }
-}
-
-/* Format a timestamp into a local ISO 8601 time. This function calls the
- * time_get_localtime function, so you should not call it concurrently to
- * another call of it or to a call to the time_get_localtime or to the
- * localtime_r function. See time_get_localtime for more information.
+/* Format a timestamp into a local ISO 8601 time. See
+ * time_fmt_localtime_iso8601 for the thread-safety when \p tz is not NULL.
  */
-static inline
 void time_fmt_localtime_iso8601_msec(char buf[static 30], time_t t,
-                                     int msec, const char *tz)
-{
-    int len;
-    struct tm tm;
-    int delta_h, delta_m;
-
-    time_get_localtime(&t, &tm, tz);
-    time_get_gmt_delta(&tm, &delta_h, &delta_m);
-
-    len = snprintf(buf, 30, ISO8601_TZ_MSEC_FMT,
-                   ISO8601_TZ_MSEC_FMT_ARG(&tm, msec, delta_h, delta_m));
-    if (len >= 30) {
-        e_panic("invalid timestamp: %jd", t);
-    }
-}
+                                     int msec, const char *tz);
 
 static inline void sb_add_time_iso8601(sb_t *sb, time_t t)
 {
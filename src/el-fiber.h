@@ -0,0 +1,97 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_EL_FIBER_H
+#define IS_LIB_COMMON_EL_FIBER_H
+
+#include <lib-common/el.h>
+#include <lib-common/thr.h>
+
+/* Event loop fibers
+ * ~~~~~~~~~~~~~~~~~
+ *
+ * A fiber is a block that runs on its own small stack, and that can wait
+ * for an event of the event loop (a file descriptor readiness, a timeout,
+ * the completion of a thr_syn_t, the answer to an ic query, ...) in the
+ * middle of its code instead of splitting it in callbacks. While it waits,
+ * the event loop runs the other events; when the event fires, the fiber is
+ * resumed from the callback of the event loop, on the same thread.
+ *
+ * Restrictions:
+ *  - the fibers live on the thread of the event loop; they must neither be
+ *    created nor woken up from another thread (use thr_queue_main_g or
+ *    el_wake to get back to the event loop);
+ *  - the stacks are small (EL_FIBER_STACK_SIZE, with a guard page), so big
+ *    buffers must be allocated on the heap;
+ *  - a t_scope must not be open across a wait: the t_stack is shared with
+ *    the event loop that runs in the meantime. Frames that are opened and
+ *    closed between two waits are fine;
+ *  - no lock must be held across a wait.
+ */
+
+#define EL_FIBER_STACK_SIZE  (64 << 10)
+
+typedef struct el_fiber_t el_fiber_t;
+
+#ifdef __has_blocks
+/** Create a new fiber running \p blk.
+ *
+ * The fiber starts immediately, and el_fiber_spawn() returns when it either
+ * ends or waits for the first time. The fiber is destroyed when the block
+ * returns.
+ */
+el_fiber_t * nonnull el_fiber_spawn(block_t nonnull blk);
+#endif
+
+/** Get the running fiber, NULL when not called from a fiber. */
+el_fiber_t * nullable el_fiber_self(void);
+
+/** Suspend the running fiber until el_fiber_wake() is called on it.
+ *
+ * This is the primitive the other waits are built upon, to integrate the
+ * fibers with other event sources.
+ */
+void el_fiber_suspend(void);
+
+/** Resume a fiber suspended with el_fiber_suspend().
+ *
+ * The fiber runs until it waits again or ends, then el_fiber_wake() returns.
+ * It must be called from the thread of the event loop.
+ */
+void el_fiber_wake(el_fiber_t * nonnull fiber);
+
+/** Wait until \p fd is ready. \see el_fd_register.
+ *
+ * \param[in] fd       the file descriptor to watch.
+ * \param[in] events   the events to wait for, as in el_fd_register().
+ * \param[in] timeout  timeout in ms, negative for no timeout.
+ * \return the events that fired, 0 on timeout.
+ */
+short el_fiber_wait_fd(int fd, short events, int64_t timeout);
+
+/** Put the running fiber to sleep for \p msec milliseconds. */
+void el_fiber_sleep(int64_t msec);
+
+/** Wait until a thr_syn_t is done. \see thr_syn_notify.
+ *
+ * Unlike thr_syn_wait(), the thread is not blocked: the event loop keeps
+ * running while the jobs of \p syn are executed.
+ */
+void el_fiber_wait_syn(thr_syn_t * nonnull syn);
+
+#endif
@@ -150,6 +150,11 @@ el_t nonnull el_child_register_blk(pid_t pid, el_child_b nonnull,
  * \param[in]  blk     the callback to run in the parent when the child exits.
  * \param[in]  wipe    optional block to wipe the environment of the callback.
  *
+ * Without \p child, the command is spawned with posix_spawn(), that does not
+ * copy the page tables of the process as fork() does, which is much faster
+ * for the processes with huge mappings. Note that the PATH used to look for
+ * \p file is then the one of the current process, even if \p envp is set.
+ *
  * \return the pid
  */
 pid_t el_spawn_child(const char * nonnull file, const char * nullable argv[],
@@ -173,6 +178,10 @@ typedef void (BLOCK_CARET el_child_output_b)(el_t nonnull, pid_t, int status,
  *                     it takes the child stdout/stderr capture as argument.
  * \param[in]  wipe    optional block to wipe the environment of the callback.
  *
+ * As for \ref el_spawn_child, posix_spawn() is used when there is no
+ * \p child callback (when the libc can close the file descriptors of the
+ * child).
+ *
  * \return the pid
  */
 pid_t el_spawn_child_capture(const char * nonnull file,
@@ -245,6 +254,110 @@ typedef enum ev_priority_t {
     EV_PRIORITY_HIGH   = 2
 } ev_priority_t;
 
+typedef enum el_fd_backend_t {
+    EL_FD_BACKEND_EPOLL,
+    EL_FD_BACKEND_IO_URING,
+} el_fd_backend_t;
+
+/** Select the kernel interface used to watch the file descriptors.
+ *
+ * The default is epoll. With io_uring, the readiness of the fds is watched
+ * with poll requests queued in a ring, the changes of the watched events
+ * are batched and submitted with the wait of the event loop, all of them
+ * in a single system call.
+ *
+ * This must be called before the first file descriptor is registered,
+ * which means before the el module is initialized.
+ *
+ * \return -1 if the backend is not supported by the system (in which case
+ *         epoll will be used), or if the event loop is already running with
+ *         another backend.
+ */
+int el_fd_set_backend(el_fd_backend_t backend);
+
+/** Get the backend used to watch the file descriptors. */
+el_fd_backend_t el_fd_get_backend(void);
+
+/** Busy poll the file descriptors before sleeping.
+ *
+ * When the loop of the calling thread waits for events, it first spins on
+ * a non-blocking epoll_wait() for up to \p budget_us microseconds, which
+ * saves the wake-up latency of a sleep. The sockets registered afterwards
+ * get SO_BUSY_POLL with the same budget, so that the kernel also polls
+ * their device queue.
+ *
+ * The spin budget adapts to the traffic: it shrinks down to no spin at all
+ * when the events come later than the budget, and grows back up to
+ * \p budget_us when they come within it.
+ *
+ * It is ignored by the io_uring backend.
+ *
+ * \param[in]  budget_us  the maximum spin budget, 0 to disable busy
+ *                        polling.
+ */
+void el_fd_set_busy_poll(int budget_us);
+
+typedef struct el_fd_busy_poll_stats_t {
+    uint64_t spin_ns;   /**< time spent spinning */
+    uint64_t spin_hits; /**< waits that got events while spinning */
+    uint64_t sleeps;    /**< waits that slept once the spin was over */
+} el_fd_busy_poll_stats_t;
+
+/** Get the statistics of the busy polling of all the loops. */
+void el_fd_get_busy_poll_stats(el_fd_busy_poll_stats_t * nonnull stats);
+
+/** Profile the callbacks of the event loops.
+ *
+ * While the profiling is on, the loops measure the wall time of the
+ * callbacks of their events, accounted per callback function (the blocks
+ * are accounted with the function implementing them), and the lag of their
+ * iterations: the time between the wake-up of a loop and its next wait for
+ * events, during which the new events are not looked at.
+ *
+ * The callbacks longer than \p slow_ms milliseconds are logged with a
+ * warning naming the callback and its event, so that they can be matched
+ * with the traces of el_set_trace(). 0 does not log any callback.
+ *
+ * When it is off, the profiling costs a test per callback. It can also be
+ * started at startup with the EL_PROFILE_SLOW_MS environment variable.
+ */
+void el_profile_start(int slow_ms);
+
+/** Stop profiling the callbacks, the statistics are kept. */
+void el_profile_stop(void);
+
+/** Number of buckets of the histogram of the lags.
+ *
+ * The bucket i counts the lags lower than 2^i microseconds (and not lower
+ * than 2^(i - 1) microseconds), the last one counts the lags that don't fit
+ * in the others.
+ */
+#define EL_PROFILE_BUCKETS  28
+
+typedef struct el_profile_stats_t {
+    uint64_t slow;      /**< callbacks longer than the slow threshold */
+    uint64_t lag_sum;   /**< cumulated lag of the iterations, in ns */
+    uint64_t lag_hist[EL_PROFILE_BUCKETS];
+} el_profile_stats_t;
+
+/** Get the lag statistics of all the loops, since the startup. */
+void el_profile_get_stats(el_profile_stats_t * nonnull stats);
+
+typedef struct el_profile_cb_stats_t {
+    const void * nonnull cb;
+    /** symbol of the callback, or its address when it is not exported */
+    const char * nonnull name;
+    uint64_t calls;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+} el_profile_cb_stats_t;
+
+/** Call \p cb on the statistics of every profiled callback. */
+void el_profile_callbacks_stats(void (* nonnull cb)
+                                    (const el_profile_cb_stats_t * nonnull,
+                                     void * nullable),
+                                void * nullable priv);
+
 el_t nonnull el_fd_register_d(int fd, bool own_fd, short events,
                               el_fd_f * nonnull, data_t) __leaf;
 #ifdef __has_blocks
@@ -278,6 +391,43 @@ ev_priority_t el_fd_set_priority(el_t nonnull, ev_priority_t priority);
 #define el_fd_set_priority(el, prio)  \
     (el_fd_set_priority)((el), EV_PRIORITY_##prio)
 
+/* default dispatch budgets of the priorities, the high one has none */
+#define EL_FD_READ_BUDGET_LOW     (256 << 10)
+#define EL_FD_READ_BUDGET_NORMAL  (1 << 20)
+#define EL_FD_TIME_BUDGET_LOW     10000 /* us */
+#define EL_FD_TIME_BUDGET_NORMAL  50000 /* us */
+
+/** Set the dispatch budgets of the fds of a priority in the current loop.
+ *
+ * The ready fds are queued by priority, and only the ones of the highest
+ * priority are fired in an iteration of the loop. Once their callbacks ran
+ * for \p time_us, the fds left in the queue wait for the next iteration,
+ * that starts with them: they are level-triggered, so the next poll reports
+ * them again.
+ *
+ * \p read_bytes is the amount of data the callbacks of the priority should
+ * read in a call, see el_fd_get_read_budget().
+ *
+ * \param[in]  prio        the priority.
+ * \param[in]  read_bytes  the read budget of a callback, 0 for no limit.
+ * \param[in]  time_us     the time budget of an iteration, 0 for no limit.
+ */
+void el_fd_set_dispatch_budget(ev_priority_t prio, int read_bytes,
+                               int time_us);
+
+/** Get the amount of data the callback of a fd should read in a call.
+ *
+ * A callback that reads in a loop until the fd is drained should stop
+ * there, so that a bulk transfer does not monopolize the loop: the data left
+ * in the kernel is reported by the next poll, and the callback should
+ * el_fd_mark_fired() the fd if it keeps data to process in its own buffers
+ * (TLS records, ...).
+ *
+ * \return the read budget of the priority of \p ev, INT_MAX when it has
+ *         none.
+ */
+int el_fd_get_read_budget(el_t nonnull ev);
+
 /*
  * \param[in]  ev       a file descriptor el_t.
  * \param[in]  mask     the POLL* mask of events that resets activity to 0
@@ -322,6 +472,59 @@ el_wake_register(el_cb_f * nonnull cb, void * nullable ptr)
 
 void el_wake_fire(el_t nonnull);
 
+/*----- reactors -----*/
+
+/* Multi-reactor mode
+ * ~~~~~~~~~~~~~~~~~~
+ *
+ * In this opt-in mode, N other event loops (the reactors) run in dedicated
+ * threads, next to the main loop. The el functions called from the thread of
+ * a reactor work on the loop of that reactor: the fds, timers, wakers,
+ * proxies, before and idle hooks registered from a reactor belong to it,
+ * and must only be touched from its thread. The signals, the children and
+ * the fs watches remain handled by the main loop only.
+ *
+ * The listeners created by httpd_listen() or ic_listento() in a reactor use
+ * SO_REUSEPORT, so that each reactor can have its own listening socket on the
+ * same address, the kernel sharding the connections among the reactors. An
+ * accepted connection stays on the loop that accepted it. The objects that
+ * configure the listeners (httpd_cfg_t, ...) must not be shared between the
+ * reactors: each one must create its own in its init callback.
+ *
+ * The reactors communicate with el_reactor_post() (built upon a waker), and
+ * with thr_queue_main_g to post jobs to the main loop.
+ */
+
+#ifdef __has_blocks
+typedef void (BLOCK_CARET el_reactor_b)(int idx);
+
+/** Start \p count reactors.
+ *
+ * \param[in] count  the number of reactors.
+ * \param[in] init   run in the thread of each reactor, with its index in
+ *                   [0, count[, before it starts to loop; typically to
+ *                   create its listeners. el_reactors_start() returns when
+ *                   all the reactors have run it.
+ * \param[in] wipe   run in the thread of each reactor when it is stopped.
+ * \return -1 if the reactors are already started.
+ */
+int el_reactors_start(int count, el_reactor_b nonnull init,
+                      el_reactor_b nullable wipe);
+
+/** Run \p blk in the thread of the reactor \p idx, from any thread. */
+void el_reactor_post(int idx, block_t nonnull blk);
+#endif
+
+/** Stop the reactors and wait for their threads to end. */
+void el_reactors_stop(void);
+
+/** Get the number of running reactors. */
+int el_reactors_count(void) __attribute__((pure));
+
+/** Get the index of the reactor of the calling thread, -1 if the thread
+ * is not the one of a reactor. */
+int el_reactor_self(void) __attribute__((pure));
+
 /** \} */
 
 /**
@@ -362,6 +565,12 @@ const char * nonnull el_fs_watch_get_path(el_t nonnull el);
 typedef enum ev_timer_flags_t {
     EL_TIMER_NOMISS = (1 << 0),
     EL_TIMER_LOWRES = (1 << 1),
+    /* The timer tolerates a few milliseconds of slack (it can fire up to
+     * 4ms late): it is stored in a timing wheel where registering,
+     * restarting and unregistering it are O(1), instead of the heap of the
+     * precise timers. Suited for the many timeouts that are restarted on
+     * every activity and seldom fire. */
+    EL_TIMER_COARSE = (1 << 2),
 } ev_timer_flags_t;
 
 
@@ -430,6 +639,16 @@ bool el_set_trace(el_t nonnull, bool trace) __leaf;
 #else
 #define el_set_trace(ev, trace)
 #endif
+
+/** Run the callbacks of an fd or timer event in trace spans.
+ *
+ * The spans are named "el:fd" or "el:timer", and are the parents of the
+ * spans started by the callbacks. Like any root span they are sampled with
+ * the rate set by trace_set_sample_rate() (see trace.h).
+ *
+ * \return whether the callbacks were already run in spans.
+ */
+bool el_set_span(el_t nonnull, bool span) __leaf;
 data_t el_set_priv(el_t nonnull, data_t) __leaf;
 
 void el_bl_use(void) __leaf;
@@ -49,6 +49,13 @@
  * single file with its obfuscated filename, its contents as described above,
  * and the size of the contents after and before compression. The obfuscation
  * method for the filename is the same than for the contents.
+ *
+ * The contents can be compressed as a whole, or by independent blocks of
+ * block_size bytes (the last one being possibly smaller) so that a part of
+ * the file can be read without uncompressing all of it. In the latter case,
+ * block_offsets gives the offset of each compressed block in the compressed
+ * contents, plus a last element which is the compressed size. A block whose
+ * compressed size is its uncompressed size is stored as is.
  */
 typedef lstr_t farch_data_t;
 
@@ -58,6 +65,8 @@ typedef struct farch_entry_t {
     int compressed_size;
     int size;
     int nb_chunks;
+    int block_size; /* 0 if the contents are compressed as a whole */
+    const int * nullable block_offsets;
 } farch_entry_t;
 
 /* }}} */
@@ -92,13 +101,48 @@ lstr_t t_farch_unarchive(const farch_entry_t * nonnull entry);
 
 /** Similar to t_farch_unarchive, but make the data persistent.
  *
- * The persisted data will be freed when the farch module is released.
+ * The persisted data will be freed when the farch module is released. It
+ * is shared with \ref farch_unarchive_acquire.
  *
  * \param[in]  entry  the farch entry.
  * \return  the uncompressed content.
  */
 lstr_t farch_unarchive_persist(const farch_entry_t * nonnull entry);
 
+/** Get a part of the uncompressed content of a farch entry.
+ *
+ * Only the blocks covering the requested part are uncompressed when the
+ * entry is compressed by blocks.
+ *
+ * \param[in]  entry   the farch entry.
+ * \param[in]  offset  the offset of the part to get.
+ * \param[in]  len     the length of the part to get, it is truncated at the
+ *                     end of the content.
+ * \return  the uncompressed part, LSTR_NULL if offset is out of bounds.
+ */
+lstr_t t_farch_unarchive_range(const farch_entry_t * nonnull entry,
+                               int offset, int len);
+
+/** Get the uncompressed content of a farch entry, and take a reference on
+ * it.
+ *
+ * The content is uncompressed once, and shared by all the users of the
+ * entry until the last reference is released with
+ * \ref farch_unarchive_release.
+ *
+ * This function is thread-safe.
+ *
+ * \param[in]  entry  the farch entry.
+ * \return  the uncompressed content.
+ */
+lstr_t farch_unarchive_acquire(const farch_entry_t * nonnull entry);
+
+/** Release a reference taken with \ref farch_unarchive_acquire.
+ *
+ * \param[in]  entry  the farch entry.
+ */
+void farch_unarchive_release(const farch_entry_t * nonnull entry);
+
 /** Get the uncompressed content of a farch entry by its name.
  *
  * Finds a farch entry by its name in a farch archive, and return its
@@ -129,7 +173,8 @@ lstr_t farch_get_data_persist(const farch_entry_t * nonnull files,
 
 /** Farch module.
  *
- * Using it is necessary only if \ref t_farch_uncompress_persist is used.
+ * Using it is necessary only if \ref farch_unarchive_persist or
+ * \ref farch_unarchive_acquire are used.
  */
 MODULE_DECLARE(farch);
 
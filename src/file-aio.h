@@ -0,0 +1,140 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_FILE_AIO_H
+#define IS_LIB_COMMON_FILE_AIO_H
+
+#include <lib-common/file.h>
+#include <lib-common/el.h>
+
+/* Asynchronous file writes
+ * ~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * The file_aio module writes the files without blocking the event loop. The
+ * writes are submitted to an io_uring ring when the kernel supports it, and
+ * otherwise run by the thr jobs, within thr_enter_blocking_syscall() so that
+ * a slow disk does not starve the other jobs.
+ *
+ * The completions are delivered in the thread that loaded the module (in
+ * practice the main thread of the event loop), which is also the only one
+ * allowed to use the asynchronous files.
+ *
+ * The requests of a same file are run in order, one at a time: the writes
+ * issued while another request of the file runs are gathered in a single
+ * write (write-behind), and a sync only completes once the writes that
+ * precede it are on the disk.
+ *
+ * The requests of xwrite_file_async() and xappend_to_file_async() are also
+ * run in the order of their calls.
+ */
+
+/* the writes that follow each other are gathered up to this size */
+#define FILE_AIO_COALESCE_MAX     (1 << 20)
+/* file_write() submits the buffer of an async file beyond this size */
+#define FILE_AIO_WRITE_BEHIND     (64 << 10)
+#define FILE_AIO_LATENCY_BUCKETS  20
+
+/** Callback called when an asynchronous request completes.
+ *
+ * \param[in] err  0, or the errno of the failure.
+ */
+typedef void (file_aio_cb_f)(int err, data_t priv);
+
+/** Make the writes of a file asynchronous.
+ *
+ * The data written afterwards is buffered as usual, and file_flush() hands
+ * it to the file_aio service instead of writing it. The offsets of the
+ * writes are the ones of file_tell() at the time of the flush, so
+ * file_seek() keeps working.
+ *
+ * The failures of the background writes are sticky: the calls that follow
+ * fail with the errno of the first one.
+ *
+ * file_close() returns immediately, the file descriptor being closed once
+ * the pending writes are done. file_seek() and file_truncate() wait for
+ * them.
+ */
+int file_set_async(file_t * nonnull f);
+
+/** Call \p cb once the data written in \p f so far is in the file. */
+void file_flush_async(file_t * nonnull f, file_aio_cb_f * nullable cb,
+                      data_t priv);
+
+/** Call \p cb once the data written in \p f so far is on the disk. */
+void file_sync_async(file_t * nonnull f, file_aio_cb_f * nullable cb,
+                     data_t priv);
+
+/** Wait for the pending requests of an asynchronous file.
+ *
+ * The completions of the other requests that arrive meanwhile are
+ * delivered as well.
+ *
+ * \return -1 with errno set if one of the writes failed, 0 otherwise.
+ */
+int file_aio_wait(file_t * nonnull f);
+
+/** Asynchronous version of xwrite_file_extended().
+ *
+ * The data is copied, \p cb is called with the result of the write.
+ */
+void xwrite_file_extended_async(const char * nonnull path,
+                                const void * nonnull data, ssize_t dlen,
+                                int flags, mode_t mode,
+                                file_aio_cb_f * nullable cb, data_t priv);
+
+static inline void
+xwrite_file_async(const char * nonnull path, const void * nonnull data,
+                  ssize_t dlen, file_aio_cb_f * nullable cb, data_t priv)
+{
+    xwrite_file_extended_async(path, data, dlen,
+                               O_WRONLY | O_CREAT | O_TRUNC, 0644, cb, priv);
+}
+
+static inline void
+xappend_to_file_async(const char * nonnull path, const void * nonnull data,
+                      ssize_t dlen, file_aio_cb_f * nullable cb, data_t priv)
+{
+    xwrite_file_extended_async(path, data, dlen,
+                               O_WRONLY | O_CREAT | O_APPEND, 0644, cb, priv);
+}
+
+typedef struct file_aio_stats_t {
+    bool     io_uring;    /* whether the requests go through io_uring */
+    uint32_t inflight;    /* requests submitted and not completed yet */
+    uint32_t queued;      /* requests waiting for another of their file */
+    uint64_t writes;      /* write requests, once gathered */
+    uint64_t syncs;
+    uint64_t bytes;       /* bytes written */
+    uint64_t errors;      /* failed requests */
+
+    /* the bucket i counts the requests below 2^i us, the last one the
+     * slower ones */
+    uint64_t latency_hist[FILE_AIO_LATENCY_BUCKETS + 1];
+    uint64_t latency_sum; /* in us */
+} file_aio_stats_t;
+
+/** Get the statistics of the file_aio service. */
+void file_aio_get_stats(file_aio_stats_t * nonnull stats);
+
+/* used by file.c */
+int __file_aio_write(file_t * nonnull f, int len);
+int __file_aio_close(file_t * nonnull f);
+
+MODULE_DECLARE(file_aio);
+
+#endif
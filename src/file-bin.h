@@ -78,6 +78,20 @@ typedef struct file_bin_t {
     uint32_t  length;
     byte     *map;
     sb_t      record_buf;
+
+    /* Write mode fields, used when the records are laid out in memory
+     * instead of being written in f (see file_bin_gc_t). wbuf_off is the
+     * offset in the file of the first byte of wbuf. */
+    sb_t     *wbuf;
+    off_t     wbuf_off;
+
+    /* Sidecar index fields (see file_bin_index_enable and
+     * file_bin_index_load). */
+    uint32_t  idx_stride;
+    int       idx_fd;
+    uint64_t  idx_nb_records;
+    byte     *idx_map;
+    size_t    idx_map_size;
 } file_bin_t;
 static inline file_bin_t *file_bin_init(file_bin_t *var)
 {
@@ -140,6 +154,153 @@ int file_bin_flush(file_bin_t *file);
 __must_check__
 int file_bin_sync(file_bin_t *file);
 
+/* }}} */
+/* {{{ Sidecar index */
+
+/** Sampling interval of the sidecar index of binary files. */
+#define FILE_BIN_DEFAULT_INDEX_STRIDE  1024
+
+/** Maintain a sidecar index of a binary file being written.
+ *
+ * The index is stored in the file "<path>.idx". It contains the offset of
+ * every \p stride-th record of the binary file, and is updated by each call
+ * to \ref file_bin_put_record. It allows readers to seek to a given record
+ * (see \ref file_bin_seek_record and \ref file_bin_seek_lower_bound) without
+ * walking through the whole file.
+ *
+ * If the index already exists, it is checked against the binary file and
+ * completed if needed; it is rebuilt if it was created with another stride.
+ *
+ * \param[in] file    The binary file, opened with \ref file_bin_create.
+ * \param[in] stride  The sampling interval of the index. Use 0 to use
+ *                    FILE_BIN_DEFAULT_INDEX_STRIDE.
+ *
+ * \return  0 on success, negative value otherwise.
+ */
+__must_check__
+int file_bin_index_enable(file_bin_t *file, uint32_t stride);
+
+/** Map the sidecar index of a binary file opened for reading.
+ *
+ * The index is remapped by \ref file_bin_refresh when the file has changed.
+ *
+ * \return  0 on success, negative value if there is no usable index.
+ */
+__must_check__
+int file_bin_index_load(file_bin_t *file);
+
+/** Move the reading position of a binary file to a given record.
+ *
+ * The cost of the seek is bounded by the stride of the index loaded with
+ * \ref file_bin_index_load; without index, the file is walked from its
+ * beginning.
+ *
+ * \param[in] file   The binary file.
+ * \param[in] recno  The number of the record, starting at 0.
+ *
+ * \return  0 on success, negative value if the file has not that many
+ *          records (the reading position is left unchanged in that case).
+ */
+__must_check__
+int file_bin_seek_record(file_bin_t *file, uint64_t recno);
+
+/** Comparison callback for \ref file_bin_seek_lower_bound.
+ *
+ * \return  a negative value if \p record is before the looked up one, a
+ *          positive or null value otherwise.
+ */
+typedef int (file_bin_cmp_f)(lstr_t record, void *priv);
+
+/** Move the reading position to the first record not before a given one.
+ *
+ * The records of the file must be sorted with respect to \p cmp, typically
+ * because they embed their timestamp. A binary search is done on the sampled
+ * records of the index loaded with \ref file_bin_index_load, and the file is
+ * then walked from the closest sample (from its beginning without index).
+ *
+ * \return  0 if a matching record was found, the reading position being
+ *          the one of the matching record, negative value otherwise (the
+ *          reading position is left unchanged in that case).
+ */
+__must_check__
+int file_bin_seek_lower_bound(file_bin_t *file, file_bin_cmp_f *cmp,
+                              void *priv);
+
+/* }}} */
+/* {{{ Group commit */
+
+/** Group commit writer of binary files.
+ *
+ * With \ref file_bin_put_record followed by \ref file_bin_sync, each writer
+ * pays for its own write and fsync. A group commit writer lets several
+ * producers (possibly in different threads) share them: the records are
+ * laid out in an in-memory buffer, and a dedicated writer thread flushes all
+ * the records accumulated since its last run with a single write followed
+ * by a single fdatasync.
+ *
+ * Each record comes with a completion callback which is called in the main
+ * thread (from the event loop) once the group containing the record has been
+ * synced on disk.
+ *
+ * In O_DIRECT mode, the page cache is bypassed: the groups are written by
+ * blocks of the file system block size, the last partial block of a group
+ * being rewritten along with the next group. This requires the slot size of
+ * the file to be a multiple of the file system block size.
+ */
+typedef struct file_bin_gc_t file_bin_gc_t;
+
+/** Completion callback of a record put in a group commit writer.
+ *
+ * \param[in] res   0 if the record is on disk, a negative value if the
+ *                  write of its group failed.
+ * \param[in] priv  the private data given to \ref file_bin_gc_put_record.
+ */
+typedef void (file_bin_gc_cb_f)(int res, void *priv);
+
+/** Open a binary file for writing through a group commit writer.
+ *
+ * \param[in] path       The path to the binary file to write.
+ * \param[in] slot_size  The slot size to use for this file. Use 0 to use
+ *                       FILE_BIN_DEFAULT_SLOT_SIZE.
+ * \param[in] truncate   Tells if the file should be truncated if it already
+ *                       exists.
+ * \param[in] direct     Write the file with O_DIRECT.
+ *
+ * \return the newly created writer on success, NULL otherwise.
+ */
+file_bin_gc_t *file_bin_gc_create(lstr_t path, uint32_t slot_size,
+                                  bool truncate, bool direct);
+
+/** Put a record in a group commit writer.
+ *
+ * This function is thread-safe. It does not perform any I/O: the record is
+ * added to the group being built, and will be written by the writer thread.
+ *
+ * \param[in] gc    The group commit writer.
+ * \param[in] data  Binary data.
+ * \param[in] len   Length of the data.
+ * \param[in] cb    Callback called in the main thread once the record is
+ *                  durable, can be NULL.
+ * \param[in] priv  Private data given to \p cb.
+ *
+ * \return  0 on success, negative value otherwise (the callback is not
+ *          called in that case).
+ */
+__must_check__
+int file_bin_gc_put_record(file_bin_gc_t *gc, const void *data, uint32_t len,
+                           file_bin_gc_cb_f *cb, void *priv);
+
+/** Close a group commit writer.
+ *
+ * The pending records are written and synced before the file is closed. When
+ * called from the main thread, their completion callbacks are run before
+ * returning; otherwise they are run later on, from the event loop.
+ *
+ * \return  0 on success, a negative value on failure.
+ */
+__must_check__
+int file_bin_gc_close(file_bin_gc_t **gc);
+
 /* }}} */
 /* {{{ Reading */
 
@@ -213,6 +374,34 @@ lstr_t file_bin_get_next_record(file_bin_t *file);
     for (lstr_t entry = file_bin_get_next_record(file);                      \
          entry.s; entry = file_bin_get_next_record(file))
 
+#ifdef __has_blocks
+
+/** Scan the records of a binary file in parallel.
+ *
+ * The file is split in partitions on slot boundaries (the slot headers
+ * allowing to find the first record starting in a slot), and each partition
+ * is parsed by a thr job. The scan starts from the current reading
+ * position, which is moved after the last record found.
+ *
+ * \param[in] file      The binary file, opened with \ref file_bin_open.
+ * \param[in] nthreads  The number of partitions to parse in parallel. Use 0
+ *                      to use thr_parallelism_g.
+ * \param[in] ordered   If false, each worker calls \p blk concurrently on
+ *                      the records of its partition, in order. If true,
+ *                      \p blk is called in the calling thread on all the
+ *                      records of the file, in order; only the parsing is
+ *                      done in parallel.
+ * \param[in] blk       The block called on each record, with the index of
+ *                      the worker that parsed it (always 0 in ordered
+ *                      mode). The record is only valid during the call.
+ *
+ * \return  0 on success, a negative value otherwise.
+ */
+int file_bin_parallel_scan(file_bin_t *file, int nthreads, bool ordered,
+                           void (BLOCK_CARET blk)(int worker, lstr_t record));
+
+#endif
+
 /** Tell if the parsing of a binary file is finished or not.
  *
  * \return  true if the current offset of the file has reached the end of the
@@ -42,6 +42,15 @@ enum log_file_flags {
 
     /* Force a rotation when opening the log_file_t. */
     LOG_FILE_FORCE_ROTATE = (1U << 4),
+
+    /* Write the log files compressed with gzip (text log files only).
+     *
+     * The data is compressed by segments of 1MB on a background serial
+     * queue, each segment being a complete gzip member: the files are
+     * readable with gzip, and can be read from any segment boundary. The
+     * size for the rotation is the uncompressed one.
+     */
+    LOG_FILE_COMPRESS_STREAM = (1U << 5),
 };
 
 enum log_file_event {
@@ -91,6 +100,14 @@ typedef struct log_file_t {
     /* Internal usage. */
     qh_t(u64) files_being_compressed;
     int refcnt;
+
+    /* Streaming compression, see LOG_FILE_COMPRESS_STREAM. */
+    struct {
+        struct thr_queue_t *queue;
+        sb_t        pending;
+        off_t       pos;
+        atomic_int  inflight;
+    } gz;
 } log_file_t;
 
 log_file_t *log_file_init(log_file_t *, const char *nametpl, int flags);
@@ -165,6 +182,9 @@ static inline off_t log_file_tell(log_file_t *log_file)
     }
     if (log_file->is_file_bin) {
         return log_file->_bin_internal->cur;
+    } else
+    if (log_file->gz.queue) {
+        return log_file->gz.pos + log_file->gz.pending.len;
     } else {
         return file_tell(log_file->_internal);
     }
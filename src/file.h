@@ -41,6 +41,7 @@ typedef struct file_t {
     int fd;
     off_t wpos;
     sb_t obuf;
+    struct file_aio_t *aio; /* see file_set_async() in file-aio.h */
 } file_t;
 
 /*----- helpers -----*/
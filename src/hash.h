@@ -93,6 +93,27 @@ void murmur_hash3_x86_32_finish(murmur_hash3_x86_32_ctx * nonnull ctx,
 
 #define MEM_HASH32_MURMUR_SEED  0xdeadc0de
 
+/** 64-bit non-cryptographic hash (wyhash).
+ *
+ * This is much faster than the 32-bit hashes above on long keys, and at
+ * least as fast on short ones. The streaming API gives the same results as
+ * the one-shot wyhash64().
+ */
+typedef struct wyhash64_ctx {
+    uint64_t lanes[3];
+    uint64_t len;
+    byte     buf[48];
+    byte     last[16];
+    uint8_t  buf_len;
+} wyhash64_ctx;
+
+uint64_t wyhash64(const void * nonnull data, size_t len, uint64_t seed)
+    __leaf;
+void wyhash64_starts(wyhash64_ctx * nonnull ctx, uint64_t seed) __leaf;
+void wyhash64_update(wyhash64_ctx * nonnull ctx, const void * nonnull data,
+                     size_t len) __leaf;
+uint64_t wyhash64_finish(wyhash64_ctx * nonnull ctx) __leaf;
+
 #define HASH32_IMPL(method, ...)                                             \
 typedef struct hash32_ctx {                                                  \
     method##_ctx ctx;                                                        \
@@ -121,9 +142,25 @@ static inline void hash32_finish(hash32_ctx *nonnull ctx, byte output[4])    \
 
 #include "crypto/iop.h"
 
+/* CRCs, computed with carry-less multiplications (or the SSE4.2 crc32
+ * instruction for icrc32c) when the CPU supports it.
+ *
+ * icrc32 uses the zlib polynomial, icrc32c the Castagnoli one (iSCSI, ext4,
+ * ...), and icrc64 the ECMA-182 one (xz).
+ */
 uint32_t icrc32(uint32_t crc, const void * nonnull data, ssize_t len) __leaf;
+uint32_t icrc32c(uint32_t crc, const void * nonnull data, ssize_t len) __leaf;
 uint64_t icrc64(uint64_t crc, const void * nonnull data, ssize_t len) __leaf;
 
+/** Combine the CRCs of two consecutive buffers.
+ *
+ * Given crc1 = icrc32(0, A, len(A)) and crc2 = icrc32(0, B, len2), compute
+ * icrc32(0, A.B, len(A) + len2) in O(log(len2)), without the data. This
+ * allows computing the CRC of large buffers by chunks in parallel.
+ */
+uint32_t icrc32_combine(uint32_t crc1, uint32_t crc2, uint64_t len2) __leaf;
+uint32_t icrc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2) __leaf;
+
 uint32_t hsieh_hash(const void * nonnull s, ssize_t len) __leaf;
 uint32_t jenkins_hash(const void * nonnull s, ssize_t len) __leaf;
 
@@ -159,6 +196,13 @@ static inline uint32_t mem_hash32(const void * nonnull data, ssize_t len)
 #endif
 }
 
+static inline uint64_t mem_hash64(const void * nonnull data, ssize_t len)
+{
+    if (unlikely(len < 0))
+        len = strlen((const char *)data);
+    return wyhash64(data, len, 0);
+}
+
 static inline uint32_t u64_hash32(uint64_t u64)
 {
     return (uint32_t)(u64) ^ (uint32_t)(u64 >> 32);
@@ -173,6 +217,11 @@ static inline uint64_t crc64_hash_64(const void * nonnull data, ssize_t len)
     return icrc64(0, data, len);
 }
 
+static inline uint64_t wyhash_hash_64(const void * nonnull data, ssize_t len)
+{
+    return wyhash64(data, len, 0);
+}
+
 static inline uint64_t hsieh_hash_64(const void * nonnull data, ssize_t len)
 {
     return hsieh_hash(data, len);
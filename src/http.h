@@ -25,6 +25,7 @@
 #include <lib-common/net.h>
 #include <lib-common/container-qhash.h>
 #include <lib-common/ssl.h>
+#include <lib-common/trace.h>
 
 #if __has_feature(nullability)
 #pragma GCC diagnostic push
@@ -230,6 +231,7 @@ enum httpd_query_status {
 };
 
 typedef struct httpd_http2_ctx_t httpd_http2_ctx_t;
+typedef struct httpd_zstream_t httpd_zstream_t;
 
 /** Type of HTTP server.
  *
@@ -260,6 +262,10 @@ typedef struct httpd_http2_ctx_t httpd_http2_ctx_t;
     bool               connection_close   : 1;                               \
     bool               compressed         : 1;                               \
     bool               want_write         : 1;                               \
+    bool               ktls               : 1;                               \
+    bool               in_batch           : 1;                               \
+    bool               body_paused        : 1;                               \
+    bool               body_resumed       : 1;                               \
     uint8_t            state;                                                \
     uint16_t           queries;                                              \
     uint16_t           queries_done;                                         \
@@ -350,6 +356,9 @@ struct httpd_trigger_t {
     lstr_t                auth_realm;
     httpd_trigger_auth_f * nullable auth;
     const object_class_t * nullable query_cls;
+    /* admission filter: the queries are rejected with a 429 when the
+     * bucket is empty, see net_tbucket_fire() */
+    net_tbucket_t        * nullable admission;
 
     void (* nonnull cb)(httpd_trigger_t * nonnull,
                         struct httpd_query_t * nonnull,
@@ -379,6 +388,28 @@ struct httpd_cfg_t {
     unsigned header_size_max;
     lstr_t cert;
     lstr_t key;
+    /* send the big answers of the clear text connections with
+     * MSG_ZEROCOPY, see ob_enable_zerocopy() */
+    bool   zerocopy;
+    /* ask for the kernel TLS offload of the TLS connections, so that
+     * their answers are sent in plain text, see ssl_ctx_enable_ktls() */
+    bool   ktls;
+    /* the settings announced on the HTTP/2 connections, 0 for the
+     * defaults of RFC 9113: a bigger initial window lifts the throughput
+     * of the uploads on the links with a high bandwidth-delay product; the
+     * new streams beyond max_concurrent_streams are refused */
+    uint32_t http2_initial_window_size;
+    uint32_t http2_max_concurrent_streams;
+    uint32_t http2_max_frame_size;
+    /* the value of the Alt-Svc header of the answers (RFC 7838), that
+     * advertises the other endpoints of the origin, such as an HTTP/3 one,
+     * empty to send none */
+    lstr_t alt_svc;
+    /* the priority of the fds of the listener and the connections in the
+     * event loop, see el_fd_set_priority(): a dedicated configuration with
+     * a high priority keeps the health checks answered during the bulk
+     * transfers of the other connections */
+    ev_priority_t priority;
 
     SSL_CTX * nullable ssl_ctx;
     dlist_t httpd_list;
@@ -546,6 +577,8 @@ struct httpd_qinfo_t {
     sb_t                payload;                                             \
     outbuf_t           * nullable ob;                                        \
     httpd_qinfo_t      * nullable qinfo;                                     \
+    httpd_zstream_t    * nullable zstream;                                   \
+    trace_span_t        trace_span;                                          \
     void               * nullable priv;                                      \
                                                                              \
     void              (*nullable on_data)(httpd_query_t * nonnull q,         \
@@ -579,6 +612,30 @@ OBJ_CLASS(httpd_query, object, HTTPD_QUERY_FIELDS, HTTPD_QUERY_METHODS);
  */
 void httpd_bufferize(httpd_query_t * nonnull q, unsigned maxsize);
 
+/** Pause the reception of the body of a query.
+ *
+ * To be called from the httpd_query_t#on_data callback of a query that
+ * streams its body when the consumer is behind (e.g. the data is written by
+ * a job of another thread), so that a big upload is not accumulated in
+ * memory: the connection stops reading and on_data is no longer called
+ * until httpd_query_resume().
+ *
+ * On an HTTP/2 stream, the flow control window of the stream is no longer
+ * updated, so the peer stops sending once it is exhausted; the DATA frames
+ * already received (at most the initial window size) are still passed to
+ * on_data.
+ *
+ * The reception is resumed when the query is answered.
+ */
+void httpd_query_pause(httpd_query_t * nonnull q);
+
+/** Resume the reception of the body paused with httpd_query_pause().
+ *
+ * The body received before the pause is passed to on_data at the next
+ * iteration of the event loop.
+ */
+void httpd_query_resume(httpd_query_t * nonnull q);
+
 /*---- headers utils ----*/
 
 httpd_qinfo_t * nonnull httpd_qinfo_dup(const httpd_qinfo_t * nonnull info);
@@ -644,6 +701,31 @@ void httpd_put_date_hdr(outbuf_t * nonnull ob, const char * nonnull hdr,
  */
 void httpd_reply_hdrs_done(httpd_query_t * nonnull q, int content_length,
                            bool chunked);
+
+#define HTTPD_ZSTREAM_JOB_MIN  (64 << 10)
+
+/** Compresses the body of a chunked answer.
+ *
+ * To be called between #httpd_reply_hdrs_start() and
+ * #httpd_reply_hdrs_done(). When the client accepts it, and the answer is
+ * chunked (negative \a content_length and \a chunked), the data of the
+ * chunks is compressed with gzip (or deflate) on the fly, and a
+ * Content-Encoding header is added. Otherwise, the answer is sent as is.
+ *
+ * The data of the chunks is accumulated until there are at least
+ * \a min_size bytes (or until #httpd_reply_done()), so that the small chunks
+ * do not pay a compressor flush each. The batches of at least
+ * HTTPD_ZSTREAM_JOB_MIN bytes are compressed by a #thr_job_t when the thr
+ * module is loaded, so that the event loop is not blocked; the answer is
+ * then flushed asynchronously.
+ *
+ * \param[in]  q         the query
+ * \param[in]  level     the zlib compression level (Z_DEFAULT_COMPRESSION,
+ *                       or from Z_BEST_SPEED to Z_BEST_COMPRESSION).
+ * \param[in]  min_size  the minimum size of the compressed batches.
+ */
+void httpd_reply_compress(httpd_query_t * nonnull q, int level,
+                          unsigned min_size);
 void httpd_reply_done(httpd_query_t * nonnull q);
 void httpd_signal_write(httpd_query_t * nonnull q);
 
@@ -658,7 +740,13 @@ static inline void httpd_reply_chunk_start(httpd_query_t * nonnull q,
         return;
     assert (!q->chunk_started);
     q->chunk_started     = true;
-    q->chunk_hdr_offs    = ob_reserve(ob, 12);
+    if (q->zstream) {
+        /* the data of the chunk is taken for compression by
+         * httpd_reply_chunk_done() */
+        q->chunk_hdr_offs = ob->sb.len;
+    } else {
+        q->chunk_hdr_offs = ob_reserve(ob, 12);
+    }
     q->chunk_prev_length = ob->length;
 }
 
@@ -707,6 +795,19 @@ int t_ps_get_http_var(pstream_t * nonnull ps, lstr_t * nonnull key,
 /*---- high level httpd_query reply functions ----*/
 
 void httpd_reply_100continue(httpd_query_t * nonnull q);
+
+/** Send a 103 Early Hints informational answer (RFC 8297).
+ *
+ * It lets the client fetch the resources the final answer will depend on
+ * while this answer is computed. To be called before
+ * httpd_reply_hdrs_start(), it does nothing for the HTTP/1.0 clients that
+ * do not support the informational answers.
+ *
+ * \param[in] links  the values of the Link headers to send, e.g.
+ *                   "</style.css>; rel=preload; as=style".
+ */
+void httpd_reply_103early_hints(httpd_query_t * nonnull q,
+                                const lstr_t * nonnull links, int count);
 void httpd_reply_202accepted(httpd_query_t * nonnull q);
 
 __attribute__((format(printf, 3, 4)))
@@ -722,6 +823,14 @@ void httpd_reply_make_index(httpd_query_t * nonnull q, int dirfd, bool head);
 void httpd_reply_file(httpd_query_t * nonnull q, int dirfd,
                       const char * nonnull file, bool head);
 
+/** Drop the static files cached by httpd_reply_file().
+ *
+ * The regular files of at most 1MB served with an absolute path are kept in
+ * memory (with their .gz sibling if any), and dropped when inotify reports
+ * a change in their directory.
+ */
+void httpd_file_cache_flush(void);
+
 httpd_trigger_t * nonnull
 httpd_trigger__static_dir_new(const char * nonnull path);
 
@@ -738,6 +847,8 @@ typedef struct httpc_cfg_t {
     http_mode_t  http_mode;
 
     bool         use_proxy : 1;
+    /* ask for the kernel TLS offload, see ssl_ctx_enable_ktls() */
+    bool         ktls      : 1;
     uint16_t     pipeline_depth;
     unsigned     noact_delay;
     unsigned     max_queries;
@@ -790,6 +901,7 @@ typedef struct httpc_http2_ctx_t httpc_http2_ctx_t;
     dlist_t       pool_link;                                                 \
     httpc_http2_ctx_t *nullable http2_ctx;                                   \
     el_t          nullable ev;                                               \
+    net_connect_t *nullable connecting;                                      \
     sb_t          ibuf;                                                      \
     z_stream      zs;                                                        \
                                                                              \
@@ -797,6 +909,7 @@ typedef struct httpc_http2_ctx_t httpc_http2_ctx_t;
     bool          busy             : 1;                                      \
     bool          compressed       : 1;                                      \
     bool          connected_as_http2 : 1;                                    \
+    bool          ktls             : 1;                                      \
     uint8_t       state;                                                     \
     uint16_t      queries;                                                   \
     int           chunk_length;                                              \
@@ -832,6 +945,21 @@ httpc_t * nullable httpc_connect(const sockunion_t * nonnull,
                                  httpc_cfg_t * nonnull,
                                  httpc_pool_t * nullable);
 
+/** Connect to the first reachable address among several.
+ *
+ * The connections to the addresses are raced with \ref net_connect_start(),
+ * \p delay milliseconds apart (NET_CONNECT_DELAY_DFL if 0), and with the
+ * inactivity timeout of the configuration as overall timeout. The latency
+ * of each attempt is traced.
+ *
+ * \param[in] addrs  the addresses, reordered so that their families
+ *                   alternate.
+ */
+httpc_t * nullable httpc_connect_any_as(sockunion_t * nonnull addrs, int cnt,
+                                        const sockunion_t * nullable src_addr,
+                                        int delay, httpc_cfg_t * nonnull,
+                                        httpc_pool_t * nullable);
+
 /** gently close an httpc connection.
  *
  * The httpc_t is never destroyed after this function call to ensure
@@ -873,6 +1001,27 @@ struct httpc_pool_t {
      */
     bool resolve_on_connect;
 
+    /** Race the connections to all the addresses of \ref host.
+     *
+     * When set along with \ref resolve_on_connect, all the addresses of
+     * \ref host are resolved and \ref httpc_pool_launch() connects to them
+     * with \ref httpc_connect_any_as(), this being the delay in ms between
+     * two attempts, so that an unreachable address does not stall the
+     * connection for a whole timeout.
+     */
+    int connect_race_delay;
+
+    /** Launch a connection before the ready ones are used up.
+     *
+     * When none of the ready connections can send more than this number of
+     * queries before reaching \ref httpc_cfg_t#max_queries, \ref
+     * httpc_pool_get() launches a new connection in advance (if the limits
+     * allow it and no connection is being established), so that the
+     * queries do not wait for a connection once they are used up. 0
+     * disables it.
+     */
+    unsigned max_queries_margin;
+
     /** To connect using a specific network interface. */
     sockunion_t * nullable su_src;
 
@@ -904,8 +1053,32 @@ static inline void httpc_pool_delete(httpc_pool_t * nullable * nonnull hpcp,
 void httpc_pool_detach(httpc_t * nonnull w);
 void httpc_pool_attach(httpc_t * nonnull w, httpc_pool_t * nonnull pool);
 httpc_t * nullable httpc_pool_launch(httpc_pool_t * nonnull pool);
+
+/** Get a ready connection of the pool.
+ *
+ * The least loaded ready connection is returned, the one with the fewest
+ * queries in flight. Among the idle ones, the most recently used one is
+ * preferred: the load is concentrated on as few connections as possible
+ * when it is low, so that the others are closed by their inactivity
+ * timeout.
+ *
+ * When no connection is ready, a new one is launched if the limits of the
+ * pool allow it; as it is not connected yet, NULL is returned anyway.
+ */
 httpc_t * nullable httpc_pool_get(httpc_pool_t * nonnull pool);
 
+typedef struct httpc_pool_stats_t {
+    int len;            /* connections of the pool */
+    int ready;          /* connections that can send a query */
+    int connecting;     /* connections being established */
+    int queries;        /* queries in flight on the connections */
+    int queries_max;    /* most queries in flight on one connection */
+} httpc_pool_stats_t;
+
+/** Get the occupancy of a pool. */
+void httpc_pool_get_stats(const httpc_pool_t * nonnull pool,
+                          httpc_pool_stats_t * nonnull stats);
+
 /** Check if the pool has a connection ready.
  *
  * \param[in] pool a httpc_pool_t
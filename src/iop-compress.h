@@ -0,0 +1,129 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_IOP_COMPRESS_H
+#define IS_LIB_COMMON_IOP_COMPRESS_H
+
+#include <lib-common/iop.h>
+#include <lib-common/compress.h>
+
+/* Compression of single bpacked IOP messages with zstd dictionaries.
+ *
+ * Small messages compress badly on their own: there is not enough data
+ * for the compressor to find repetitions. A dictionary trained on a sample
+ * of bpacked messages of the same type fixes that, and typically divides
+ * their size by 2 to 5 where plain zstd barely gains anything.
+ *
+ * The dictionaries are trained offline (see the iop-dict-train tool, or
+ * iop_bpack_dict_train()), shipped with the product (in a farch for
+ * example), and registered for their IOP structure at initialization.
+ * The compressed messages are standard zstd frames that carry the
+ * identifier of their dictionary, so that several generations of
+ * dictionaries can be registered for the same structure: messages are
+ * always compressed with the last one, and decompressed with the one they
+ * were compressed with.
+ */
+
+/** Train a dictionary for an IOP structure.
+ *
+ * \param[out] out        buffer where the dictionary is appended.
+ * \param[in]  st         the IOP structure description.
+ * \param[in]  values     the sample values, that are bpacked for the
+ *                        training.
+ * \param[in]  nb_values  the number of samples.
+ * \param[in]  max_size   the maximum size of the dictionary.
+ *
+ * \return the size of the dictionary, -1 if the training failed.
+ */
+int iop_bpack_dict_train(sb_t * nonnull out, const iop_struct_t * nonnull st,
+                         const void * nonnull const * nonnull values,
+                         int nb_values, int max_size);
+
+/** Register a dictionary for an IOP structure.
+ *
+ * The dictionary becomes the one used by iop_bpack_compress() for \p st,
+ * and the previous ones stay available for the decompression.
+ *
+ * The registration is not thread-safe: the dictionaries must be
+ * registered at initialization, before any compression or decompression
+ * of the structure.
+ *
+ * \param[in] st     the IOP structure description.
+ * \param[in] dict   the dictionary, as produced by iop_bpack_dict_train().
+ *                   It is copied.
+ * \param[in] level  the compression level to use with the dictionary, see
+ *                   COMPRESS_LEVEL_DEFAULT.
+ *
+ * \return 0 on success, -1 if the dictionary is invalid, has no
+ *         identifier (raw dictionary), or has the identifier of a
+ *         dictionary already registered.
+ */
+int iop_bpack_dict_register(const iop_struct_t * nonnull st, lstr_t dict,
+                            int level);
+
+/** Get the dictionary used to compress an IOP structure, if any. */
+const compress_dict_t * nullable
+iop_bpack_dict_get(const iop_struct_t * nonnull st);
+
+/** Bpack and compress an IOP structure.
+ *
+ * The value is packed with iop_bpack_sb() and compressed in a zstd frame
+ * with the dictionary registered for \p st (without dictionary if there
+ * is none).
+ *
+ * \param[out] out    buffer where the compressed message is appended.
+ * \param[in]  st     the IOP structure description.
+ * \param[in]  v      the IOP structure to pack.
+ * \param[in]  flags  packer modifiers (see iop_bpack_flags).
+ *
+ * \return the length of the compressed message, -1 in case of error (in
+ *         which case \p out is left untouched).
+ */
+int iop_bpack_compress(sb_t * nonnull out, const iop_struct_t * nonnull st,
+                       const void * nonnull v, unsigned flags);
+
+/** Decompress and unpack an IOP structure.
+ *
+ * This is the counterpart of iop_bpack_compress(). The dictionary is
+ * looked up from the identifier stored in the frame. The same rules as
+ * for iop_bunpack_flags() apply, with the difference that strings can
+ * never point to \p ps, so IOP_UNPACK_COPY_STRINGS is implied.
+ *
+ * \param[in] mp     the memory pool to use for the unpacked data.
+ * \param[in] st     the IOP structure description.
+ * \param[in] value  pointer on the destination structure.
+ * \param[in] ps     the compressed message.
+ * \param[in] flags  a combination of \ref iop_unpack_flags.
+ *
+ * \return 0 on success, -1 if the message cannot be decompressed (corrupted
+ *         data or unknown dictionary) or unpacked.
+ */
+__must_check__
+int iop_bunpack_decompress(mem_pool_t * nonnull mp,
+                           const iop_struct_t * nonnull st,
+                           void * nonnull value, pstream_t ps,
+                           unsigned flags);
+
+__must_check__ static inline int
+t_iop_bunpack_decompress(const iop_struct_t * nonnull st,
+                         void * nonnull value, pstream_t ps, unsigned flags)
+{
+    return iop_bunpack_decompress(t_pool(), st, value, ps, flags);
+}
+
+#endif /* IS_LIB_COMMON_IOP_COMPRESS_H */
@@ -61,6 +61,9 @@ typedef enum iop_json_error {
 
     /* Various errors (information is in err_str) */
     IOP_JERR_VARIOUS                         = -21,
+
+    /* the data ends before the next element, see iop_junpack_next() */
+    IOP_JERR_AGAIN                           = -22,
 } iop_json_error;
 
 typedef struct iop_json_lex_ctx_t {
@@ -97,6 +100,11 @@ typedef struct iop_json_lex_t {
     iop_json_lex_ctx_t  cur_ctx;
     iop_json_lex_ctx_t  peeked_ctx;
     iop_json_lex_ctx_t * nullable ctx;
+
+    /* State of iop_junpack_next() */
+    int    arr_state;
+    int    arr_depth;
+    lstr_t arr_path;
 } iop_json_lex_t;
 
 qvector_t(iop_json_subfile, iop_json_subfile__t);
@@ -322,6 +330,100 @@ int t_iop_junpack_ptr_file(const char * nonnull filename,
                            qv_t(iop_json_subfile) * nullable subfiles,
                            sb_t * nullable errb);
 
+/** Start unpacking the elements of an array one at a time.
+ *
+ * The elements are then unpacked by iop_junpack_next(), from the pstream_t
+ * attached to the parser. The document is either:
+ *  - an array of objects, when \p path is empty;
+ *  - a sequence of objects (NDJSON), when \p path is empty and the
+ *    document does not start with `[';
+ *  - an object whose member at \p path is an array of objects, \p path
+ *    being the names of the members leading to it, separated by dots
+ *    ("foo.bar"). The members that precede it are skipped, the rest of the
+ *    document is not read.
+ *
+ * \param[in] ll    The JSon parser.
+ * \param[in] path  The path of the array, that must outlive the iteration.
+ */
+void iop_jlex_start_array(iop_json_lex_t * nonnull ll, lstr_t path);
+
+/** Unpack the next element of an array.
+ *
+ * The attached pstream_t may only hold the beginning of the rest of the
+ * document: when it ends within the next element, IOP_JERR_AGAIN is
+ * returned and the pstream_t is left at the start of that element. The
+ * caller then appends more data, and calls this function again with the
+ * attached pstream_t starting at the same position. Only the element being
+ * unpacked has to be in memory.
+ *
+ * As with iop_junpack(), the memory pool of the parser must be a
+ * frame-based pool, and using a frame per element keeps the memory bounded
+ * by the size of an element.
+ *
+ * This function cannot be used to unpack a class; use
+ * `iop_junpack_next_ptr` instead.
+ *
+ * \param[in]  ll    The JSon parser.
+ * \param[in]  st    The IOP structure description of the elements.
+ * \param[out] out   Pointer on the IOP structure to write.
+ * \param[in]  last  Whether the attached pstream_t holds the whole rest of
+ *                   the document.
+ *
+ * \return 1 when an element was unpacked, 0 at the end of the array,
+ *         IOP_JERR_AGAIN when more data is needed, and another error
+ *         otherwise.
+ */
+__must_check__
+int iop_junpack_next(iop_json_lex_t * nonnull ll,
+                     const iop_struct_t * nonnull st, void * nonnull out,
+                     bool last);
+
+/** Unpack the next element of an array.
+ *
+ * This function acts exactly as `iop_junpack_next` but allocates (or
+ * reallocates) the destination structure, as `iop_junpack_ptr` does.
+ */
+__must_check__
+int iop_junpack_next_ptr(iop_json_lex_t * nonnull ll,
+                         const iop_struct_t * nonnull st,
+                         void * nullable * nonnull out, bool last);
+
+typedef int (BLOCK_CARET iop_junpack_elem_b)(void * nonnull elem);
+
+/** Unpack the elements of an array stored in a file, one at a time.
+ *
+ * The file is read by chunks with iop_junpack_next_ptr(), so that huge
+ * arrays and NDJSON files can be processed with the memory of one element.
+ *
+ * \param[in]  filename  The file to read.
+ * \param[in]  st        The IOP structure description of the elements.
+ * \param[in]  path      The path of the array, see iop_jlex_start_array().
+ * \param[in]  flags     The unpacker flags, see iop_unpack_flags.
+ * \param[in]  on_elem   Called for each element, that is allocated in a
+ *                       t_scope left once it returns. A negative result
+ *                       stops the iteration and is returned.
+ * \param[out] errb      Buffer for the parsing errors (can be NULL).
+ *
+ * \return the number of elements, or a negative value on errors.
+ */
+int iop_junpack_file_each(const char * nonnull filename,
+                          const iop_struct_t * nonnull st, lstr_t path,
+                          int flags, iop_junpack_elem_b nonnull on_elem,
+                          sb_t * nullable errb);
+
+/** Enable or disable the cache of the included files.
+ *
+ * When enabled, the structs, unions and classes included with
+ * `@include(...)` are kept packed in binary, with the inode, size and
+ * modification time of the files they were read from (the included file,
+ * and recursively the files it includes). A configuration reloaded with
+ * t_iop_junpack_file() then only parses the included files that changed.
+ *
+ * The cache is per-thread, and is not used when the subfiles are
+ * requested. Disabling it releases its memory.
+ */
+void iop_junpack_set_include_cache(bool enable);
+
 /** Print a textual error after iop_junpack() failure.
  *
  * When iop_junpack() fails, you can print the error textual description in
@@ -483,6 +585,26 @@ iop_sb_jpack(sb_t * nonnull sb, const iop_struct_t * nonnull st,
     return iop_jpack(st, value, &iop_sb_write, sb, flags);
 }
 
+/** Callback to use for writing JSon into a sb_rope_t. */
+static inline int iop_sb_rope_write(void * nonnull _r,
+                                    const void * nonnull buf, int len)
+{
+    sb_rope_add((sb_rope_t *)_r, buf, len);
+    return len;
+}
+
+/** Pack an IOP C structure to IOP-JSon in a sb_rope_t.
+ *
+ * Unlike iop_sb_jpack(), the packed JSon is never copied while it grows,
+ * which suits the very large exports. See iop_jpack().
+ */
+static inline int
+iop_sb_rope_jpack(sb_rope_t * nonnull rope, const iop_struct_t * nonnull st,
+                  const void * nonnull value, unsigned flags)
+{
+    return iop_jpack(st, value, &iop_sb_rope_write, rope, flags);
+}
+
 /** Dump IOP structures in JSon format using e_trace */
 #ifndef NDEBUG
 void iop_jtrace_(int lvl, const char * nonnull fname, int lno,
@@ -45,6 +45,8 @@ typedef enum ic_status_t {
     IC_MSG_PROXY_ERROR    = 7,
     IC_MSG_TIMEDOUT       = 8,
     IC_MSG_CANCELED       = 9,
+    /* a chunk of a streamed answer, see ic_reply_chunk() */
+    IC_MSG_PARTIAL        = 10,
 
     /* XXX: think to update ic_status_to_string too */
 #define IC_MSG_STREAM_CONTROL   INT32_MIN
@@ -73,6 +75,7 @@ static inline const char * nonnull ic_status_to_string(ic_status_t s)
         CASE(PROXY_ERROR);
         CASE(TIMEDOUT);
         CASE(CANCELED);
+        CASE(PARTIAL);
       default:
         return "UNKNOWN";
     }
@@ -118,6 +118,53 @@ t_iop_yunpack_ptr_yaml_data(const yaml_data_t * nonnull data,
                             void * nullable * nonnull out, unsigned flags,
                             sb_t * nonnull out_err);
 
+/** Convert IOP-YAML to an IOP C structure using the t_pool(), without
+ * building the YAML AST.
+ *
+ * This function acts as `t_iop_yunpack_ps`, but the document is unpacked
+ * while it is parsed, with yaml_parse_next_event, so that the memory used
+ * is the one of the unpacked IOP, and not several times the size of the
+ * document. This is meant for large documents.
+ *
+ * The documents using includes, variables or merge keys are rejected, and
+ * no presentation data can be generated: use `t_iop_yunpack_ps` for them.
+ */
+__must_check__
+int t_iop_yunpack_stream_ps(pstream_t * nonnull ps,
+                            const iop_struct_t * nonnull st,
+                            void * nonnull out, unsigned flags,
+                            sb_t * nonnull out_err);
+
+/** Streaming version of `t_iop_yunpack_ptr_ps`.
+ *
+ * See t_iop_yunpack_stream_ps.
+ */
+__must_check__
+int t_iop_yunpack_ptr_stream_ps(pstream_t * nonnull ps,
+                                const iop_struct_t * nonnull st,
+                                void * nullable * nonnull out,
+                                unsigned flags, sb_t * nonnull out_err);
+
+/** Streaming version of `t_iop_yunpack_file`.
+ *
+ * See t_iop_yunpack_stream_ps.
+ */
+__must_check__
+int t_iop_yunpack_stream_file(const char * nonnull filename,
+                              const iop_struct_t * nonnull st,
+                              void * nonnull out, unsigned flags,
+                              sb_t * nonnull out_err);
+
+/** Streaming version of `t_iop_yunpack_ptr_file`.
+ *
+ * See t_iop_yunpack_stream_ps.
+ */
+__must_check__
+int t_iop_yunpack_ptr_stream_file(const char * nonnull filename,
+                                  const iop_struct_t * nonnull st,
+                                  void * nullable * nonnull out,
+                                  unsigned flags, sb_t * nonnull out_err);
+
 /* }}} */
 /* {{{ Generating YAML */
 
@@ -142,6 +189,25 @@ void t_iop_sb_ypack(sb_t * nonnull sb, const iop_struct_t * nonnull st,
                     const void * nonnull value,
                     const yaml__document_presentation__t * nullable pres);
 
+/** Pack an IOP C structure to IOP-YAML with a custom writer.
+ *
+ * The YAML is written while walking the structure, without building its
+ * yaml_data_t AST first, unless \p pres uses features that require it (see
+ * yaml_pack_env_can_stream).
+ *
+ * \param[in]  st       IOP structure description.
+ * \param[in]  value    Pointer on the IOP structure to pack.
+ * \param[in]  pres     Optional presentation details, see iop_ypack_file.
+ * \param[in]  writecb  Callback called on every buffer that must be written.
+ * \param[in]  priv     Private data passed to \p writecb.
+ * \param[out] err      Filled with the error of \p writecb in case of error.
+ * \return -1 if \p writecb failed, the number of bytes written otherwise.
+ */
+int t_iop_ypack(const iop_struct_t * nonnull st, const void * nonnull value,
+                const yaml__document_presentation__t * nullable pres,
+                yaml_pack_writecb_f * nonnull writecb, void * nullable priv,
+                sb_t * nullable err);
+
 /** Pack an IOP C structure in an IOP-YAML file.
  *
  * \param[in]  filename   The file in which the value is packed.
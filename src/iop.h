@@ -286,6 +286,36 @@ int iop_skip_absent_field_desc(mem_pool_t * nonnull mp, void * nonnull value,
 
 int iop_ranges_search(int const * nonnull ranges, int ranges_len, int tag);
 
+/** What can be reached from the fields of the values of a struct. */
+enum iop_struct_contents_t {
+    /** String, bytes or xml fields. */
+    IOP_CONTAINS_STRING  = 1 << 0,
+    /** Class instances. */
+    IOP_CONTAINS_CLASS   = 1 << 1,
+    /** Memory allocated apart from the value itself: strings, arrays,
+     * optional structs, references or classes. A struct that contains no
+     * pointer is flat, and is copied with a memcpy. */
+    IOP_CONTAINS_POINTER = 1 << 2,
+
+    IOP_CONTAINS_ALL     = IOP_CONTAINS_STRING | IOP_CONTAINS_CLASS
+                         | IOP_CONTAINS_POINTER,
+};
+
+/** Get what can be reached from the fields of the values of a struct.
+ *
+ * The whole tree of the types of \p st is walked, a class field containing
+ * anything since its value can be an instance of any child class. For a
+ * class, the fields of its parents are taken into account.
+ *
+ * The result is computed once per struct and cached while the iop module is
+ * initialized, so that the traversals of the values can cheaply skip the
+ * subtrees that cannot contain what they look for. The cache is flushed
+ * when packages are unregistered.
+ *
+ * \return a bitfield of iop_struct_contents_t.
+ */
+unsigned iop_struct_get_contents(const iop_struct_t * nonnull st);
+
 /* }}} */
 /* {{{ IOP Introspection: iop_for_each_(field|st|obj) */
 
@@ -855,6 +885,10 @@ enum iop_sort_flags {
      * beginning of the vector (otherwise they are left at the end)
      */
     IOP_SORT_NULL_FIRST = (1U << 1),
+    /* Sort with thr_parallel_sort(): the thr module must be loaded for it to
+     * be useful. Taken into account if set on any of the sorting fields.
+     */
+    IOP_SORT_PARALLEL = (1U << 2),
 };
 
 /** Sort a vector of IOP structures or unions based on a given field or
@@ -1094,6 +1128,138 @@ void iop_filter_bitmap_apply(const iop_struct_t * nonnull st,
                              void * nonnull vec, int * nonnull len,
                              const byte * nonnull bitmap);
 
+/** Compiled predicate on IOP values.
+ *
+ * A predicate is a boolean expression on the fields of an IOP structure,
+ * written with the syntax of the field paths:
+ *
+ *     a > 10 AND (b.c IN ("x", "y") OR NOT d PREFIX "foo") AND e IS SET
+ *
+ * The leaves are comparisons of a field with a constant (==, !=, <, <=, >,
+ * >=), tests of membership to a set of constants (IN), of prefix for the
+ * strings (PREFIX) and of presence for the optional or repeated fields
+ * (IS [NOT] SET); they are combined with AND, OR and NOT. The constants are
+ * integers, doubles, double-quoted strings, true/false, and the names of
+ * the values for the enums. As in \ref iop_filter, a leaf on a repeated field
+ * is true if one of the elements matches, and the comparisons of a field
+ * that is not set are false.
+ *
+ * The expression is compiled once into a tree of functions specialised on
+ * the types of the fields, so that it is cheaply evaluated on a lot of
+ * elements, instead of calling a block per element.
+ */
+typedef struct iop_pred_t iop_pred_t;
+
+/** Compile a predicate on the t_stack.
+ *
+ * \param[in]  st    The IOP structure definition (__s).
+ * \param[in]  expr  The expression of the predicate.
+ * \param[out] err   Buffer filled in case of error.
+ *
+ * \return NULL if the expression is invalid.
+ */
+iop_pred_t * nullable t_iop_pred_compile(const iop_struct_t * nonnull st,
+                                         lstr_t expr, sb_t * nullable err);
+
+/** Evaluate a predicate on an IOP value. */
+bool iop_pred_match(const iop_pred_t * nonnull pred, const void * nonnull val);
+
+/** Evaluate a predicate on a vector of IOP values, and fill a bitmap
+ *  accordingly.
+ *
+ * Same as \ref t_iop_filter_bitmap, with a predicate instead of a list of
+ * values. The large vectors are split into chunks evaluated concurrently
+ * when the thread jobs are enabled.
+ *
+ * \param[in] vec  The values; if the structure is a class, this must be an
+ *                 array of pointers on the elements.
+ */
+void t_iop_pred_filter_bitmap(const iop_pred_t * nonnull pred,
+                              const void * nonnull vec, int len,
+                              iop_filter_bitmap_op_t bitmap_op,
+                              byte * nonnull * nullable bitmap);
+
+/** Filter in-place a vector of IOP values with a predicate.
+ *
+ * Only the values matching the predicate are kept.
+ */
+void iop_pred_filter(const iop_pred_t * nonnull pred, void * nonnull vec,
+                     int * nonnull len);
+
+/** Columnar batch of IOP values.
+ *
+ * A batch transposes a vector of IOP values into one contiguous column of
+ * values per field, so that the passes on a few fields of many values
+ * (filters, aggregations) read these fields only.
+ *
+ * The columns are built for the non-repeated scalar fields (integers,
+ * enums, booleans, doubles and strings) of the structure, and of its
+ * parents for a class; the optional fields have a bitmap of the rows in
+ * which they are set. The strings of the columns point to the strings of
+ * the rows, and the rows are referenced: they must outlive the batch, and
+ * the batch is not updated when they are modified.
+ *
+ * The bitmaps computed on a batch are indexed by the rows, so they are
+ * combined with the ones of \ref t_iop_filter_bitmap and applied to the
+ * rows with \ref iop_filter_bitmap_apply.
+ */
+typedef struct iop_batch_t iop_batch_t;
+
+/** Build a batch on the t_stack.
+ *
+ * \param[in] st   The IOP structure definition (__s).
+ * \param[in] vec  The rows; if st is a class, this must be an array of
+ *                 pointers on the elements.
+ * \param[in] len  The number of rows.
+ */
+iop_batch_t * nonnull t_iop_batch_new(const iop_struct_t * nonnull st,
+                                      const void * nonnull vec, int len);
+
+/** Get the number of rows of a batch. */
+int iop_batch_get_len(const iop_batch_t * nonnull batch);
+
+/** Get a row of a batch (the element itself for the classes). */
+const void * nonnull iop_batch_get_row(const iop_batch_t * nonnull batch,
+                                       int i);
+
+/** Get the column of a field.
+ *
+ * \param[out] is_set  The bitmap of the rows in which the field is set, NULL
+ *                     for a mandatory field; the values of a column are
+ *                     zeroed in the rows in which the field is not set.
+ *
+ * \return the values of the field (int32_t for the enums, bool for the
+ *         booleans, lstr_t for the strings), NULL if the field has no
+ *         column.
+ */
+const void * nullable
+iop_batch_get_column(const iop_batch_t * nonnull batch, lstr_t field_name,
+                     const byte * nullable * nullable is_set);
+
+/** Filter the rows of a batch on the value of a field.
+ *
+ * Same as \ref t_iop_filter_bitmap on the field \p field_name of the rows,
+ * the integer fields are compared a whole column at a time.
+ */
+int t_iop_batch_filter_bitmap(const iop_batch_t * nonnull batch,
+                              lstr_t field_name,
+                              void * const nonnull * nonnull values,
+                              int values_len, unsigned flags,
+                              iop_filter_bitmap_op_t bitmap_op,
+                              byte * nonnull * nullable bitmap,
+                              sb_t * nullable err);
+
+/** Filter the rows of a batch on the presence of an optional field.
+ *
+ * Same as \ref t_iop_filter_opt_bitmap on the field \p field_name of the
+ * rows.
+ */
+int t_iop_batch_filter_opt_bitmap(const iop_batch_t * nonnull batch,
+                                  lstr_t field_name, bool is_set,
+                                  iop_filter_bitmap_op_t bitmap_op,
+                                  byte * nonnull * nullable bitmap,
+                                  sb_t * nullable err);
+
 /* Remove fields tagged with the `gen_attr` generic attribute.
  *
  * Walk recursively through the IOP object.
@@ -1209,6 +1375,23 @@ mp_iop_dup_desc_sz(mem_pool_t * nullable mp, const iop_struct_t * nonnull st,
 #define t_iop_shallow_dup(pfx, v)  mp_iop_shallow_dup(t_pool(), pfx, (v))
 #define r_iop_shallow_dup(pfx, v)  mp_iop_shallow_dup(r_pool(), pfx, (v))
 
+/** Get the memory used by an IOP structure and everything it points to.
+ *
+ * This is the size of the block iop_dup() would allocate for \p v, that is
+ * its deep size, padding included, whether \p v actually lives in one block
+ * or not.
+ *
+ * Prefer the macro version instead of this low-level API.
+ */
+size_t iop_memory_footprint_desc(const iop_struct_t * nonnull st,
+                                 const void * nonnull v);
+
+#define iop_memory_footprint(pfx, v)  ({                                     \
+        const pfx##__t *_imf_v = (v);                                        \
+                                                                             \
+        iop_memory_footprint_desc(&pfx##__s, (const void *)_imf_v);          \
+    })
+
 /** Copy an IOP structure into another one.
  *
  * The destination IOP structure will reallocated to handle the source
@@ -1295,6 +1478,55 @@ mp_iop_copy_desc_sz(mem_pool_t * nullable mp, const iop_struct_t * nonnull st,
 #define iop_shallow_copy_v(pfx, out, v)                                      \
     mp_iop_copy_v_flags(NULL, pfx, (out), (v), IOP_COPY_SHALLOW)
 
+/** Interning arena of IOP values.
+ *
+ * An interning arena keeps a single canonical copy of equal IOP values
+ * (in the sense of iop_equals): interning a value returns the canonical
+ * copy, created on the first call, so that equal values share the same
+ * memory and can be compared by pointer.
+ *
+ * The pointed sub-objects (optional and reference fields, class fields) of
+ * the canonical copies are interned too, so that the values that have equal
+ * sub-objects share them.
+ *
+ * The canonical copies are refcounted: each call to iop_intern must be
+ * balanced by a call to iop_intern_release, and a canonical copy is freed
+ * with its last reference. The canonical copies must never be modified, and
+ * an arena must not be used by several threads concurrently.
+ */
+typedef struct iop_intern_t iop_intern_t;
+
+iop_intern_t * nonnull iop_intern_new(void);
+
+/** Delete an interning arena, with all its canonical copies. */
+void iop_intern_delete(iop_intern_t * nullable * nonnull in);
+
+/** Get the canonical copy of an IOP value, and take a reference on it.
+ *
+ * \param[in] in  The interning arena.
+ * \param[in] st  The IOP structure definition (__s).
+ * \param[in] v   The IOP value, which is not modified nor referenced.
+ */
+const void * nonnull iop_intern_desc(iop_intern_t * nonnull in,
+                                     const iop_struct_t * nonnull st,
+                                     const void * nonnull v);
+
+#define iop_intern(in, pfx, v)                                               \
+    ({  const pfx##__t *__v = (v);                                           \
+        (const pfx##__t *)iop_intern_desc((in), &pfx##__s, __v); })
+
+/** Release a reference on a canonical copy returned by iop_intern. */
+void iop_intern_release_desc(iop_intern_t * nonnull in,
+                             const iop_struct_t * nonnull st,
+                             const void * nonnull v);
+
+#define iop_intern_release(in, pfx, v)                                       \
+    ({  const pfx##__t *__v = (v);                                           \
+        iop_intern_release_desc((in), &pfx##__s, __v); })
+
+/** Get the number of canonical copies of an interning arena. */
+int iop_intern_get_count(const iop_intern_t * nonnull in);
+
 /** Find a generic attribute value for an IOP structure.
  *
  * See \ref iop_field_get_gen_attr for the description of exp_type and
@@ -2239,6 +2471,10 @@ struct iop_enum_value {
 /* {{{ IOP binary packing/unpacking */
 
 /** Set the multithreaded packing threshold, for testing purposes.
+ *
+ * The arrays of structs, unions and classes having at least this number of
+ * elements are packed in threads, and so are they unpacked when they are
+ * unpacked in a frame based pool (see IOP_UNPACK_MONOTHREAD).
  *
  * \param[in]  threshold  Arrays smaller than this be packed in threads.
  */
@@ -2262,6 +2498,13 @@ enum iop_bpack_flags {
     /** With this flag on, packing will not be multi-threaded.
      */
     IOP_BPACK_MONOTHREAD    = (1U << 3),
+
+    /** With this flag on, the single pass packer (iop_bpack_sb) writes the
+     * lengths of the struct, union and class blocks on 4 bytes instead of
+     * moving the blocks to use the shortest encoding. The result is bigger
+     * but the packing is cheaper for deeply nested structures; it is still
+     * understood by all the unpackers. */
+    IOP_BPACK_WIDE_LENGTHS  = (1U << 4),
 };
 
 /** Do some preliminary work to pack an IOP structure into IOP binary format.
@@ -2349,6 +2592,27 @@ static inline lstr_t t_iop_bpack_struct(const iop_struct_t * nonnull st,
     return t_iop_bpack_struct_flags(st, v, 0);
 }
 
+/** Pack an IOP structure into IOP binary format in a single pass.
+ *
+ * Unlike `iop_bpack`, this function does not need the sizes computed by
+ * `iop_bpack_size_flags`: the packed structure is appended to the buffer,
+ * that grows as needed. Without IOP_BPACK_WIDE_LENGTHS, the result is the
+ * same as the one of `iop_bpack`. The packing is never multi-threaded.
+ *
+ * An outbuf_t can be used with OB_WRAP(iop_bpack_sb, ob, st, v, flags).
+ *
+ * \param[in] sb    The buffer the packed structure is appended to.
+ * \param[in] st    The IOP structure definition (__s).
+ * \param[in] v     The IOP structure to pack.
+ * \param[in] flags Packer modifiers (see iop_bpack_flags).
+ *
+ * \return
+ *   The length of the packed structure, or -1 if the IOP_BPACK_STRICT flag
+ *   was used and a constraint was violated (nothing is appended then).
+ */
+int iop_bpack_sb(sb_t * nonnull sb, const iop_struct_t * nonnull st,
+                 const void * nonnull v, unsigned flags);
+
 /** Flags for IOP (un)packers. */
 enum iop_unpack_flags {
     /** Allow the unpacker to skip unknown fields.
@@ -2376,6 +2640,14 @@ enum iop_unpack_flags {
      * This flag applies to the json unpacker.
      */
     IOP_UNPACK_USE_C_CASE = (1U << 3),
+
+    /** With this flag on, unpacking will not be multi-threaded.
+     *
+     * The binary unpacker only uses threads for the big arrays of structs,
+     * unions or classes, when unpacking in a pool that releases its memory
+     * by frame (the t_pool() for example).
+     */
+    IOP_UNPACK_MONOTHREAD = (1U << 4),
 };
 
 /** Unpack a packed IOP structure.
@@ -2551,6 +2823,134 @@ void iop_union_set_tag(const iop_struct_t *nonnull desc, int value,
 int iop_union_get_tag(const iop_struct_t *nonnull desc,
                       const void *nonnull st);
 
+/* }}} */
+/* {{{ IOP binary lazy views */
+
+/** Lazy view over a packed IOP structure, class or union.
+ *
+ * A view reads the fields of a packed value on demand, without unpacking the
+ * whole value and without any allocation: the strings point into the packed
+ * buffer, and the nested structures and the repeated fields are read through
+ * other views and iterators. This is meant for the code that only needs a
+ * few fields of big values, as a proxy that routes a message.
+ *
+ * The packed fields are not indexed: a lookup reads the packed fields from a
+ * cursor left by the previous lookup, so that looking up the fields in the
+ * order of their tags (level by level from the real class for the classes)
+ * only reads the buffer once.
+ *
+ * As with `iop_bskip`, the packed content is not fully checked: only the
+ * values that are read are.
+ *
+ * The getters return 1 when the field is packed, 0 when it is not, in which
+ * case the output is set to the default value of the field if it has one and
+ * is left untouched otherwise, and -1 when the packed value is invalid.
+ * The fields must be fields of the type of the view (or of its parents) and
+ * have the type of the getter.
+ */
+typedef struct iop_view_t {
+    /** Type of the value, the real class for the classes. */
+    const iop_struct_t * nonnull st;
+    pstream_t ps;
+
+    /* lookup cursor: first packed field not before the last looked up one,
+     * with its class level */
+    const byte * nonnull cur;
+    const iop_struct_t * nonnull cur_level;
+    uint16_t cur_depth;
+    uint16_t key_depth;
+    uint32_t key_tag;
+} iop_view_t;
+
+/** Iterator on the elements of a packed repeated field. */
+typedef struct iop_view_array_t {
+    const iop_field_t * nullable f;
+    /** Number of elements left. */
+    uint32_t len;
+    /* the small integers are packed in one block, otherwise wt is the wire
+     * type of the next element */
+    bool packed;
+    iop_wire_type_t wt;
+    pstream_t ps;
+} iop_view_array_t;
+
+/** Initialize a view over a packed IOP structure, class or union.
+ *
+ * \param[out] view  The view.
+ * \param[in]  st    The IOP structure definition (__s).
+ * \param[in]  data  The packed value, that must outlive the view.
+ * \return -1 if the real class of a packed class cannot be read or is not a
+ *         child of st, 0 otherwise.
+ */
+__must_check__
+int iop_view_init(iop_view_t * nonnull view, const iop_struct_t * nonnull st,
+                  lstr_t data);
+
+/** Get the field selected in the view of an IOP union.
+ *
+ * \return the selected field, NULL if the packed union is invalid.
+ */
+const iop_field_t * nullable
+iop_view_get_union_field(const iop_view_t * nonnull view);
+
+/** Get an integer, boolean or enum field. */
+__must_check__
+int iop_view_get_int(iop_view_t * nonnull view, const iop_field_t * nonnull f,
+                     int64_t * nonnull out);
+
+/** Get a double field. */
+__must_check__
+int iop_view_get_double(iop_view_t * nonnull view,
+                        const iop_field_t * nonnull f, double * nonnull out);
+
+/** Get a string, bytes or xml field, pointing into the packed buffer. */
+__must_check__
+int iop_view_get_lstr(iop_view_t * nonnull view,
+                      const iop_field_t * nonnull f, lstr_t * nonnull out);
+
+/** Get a view over a struct, class or union field. */
+__must_check__
+int iop_view_get_view(iop_view_t * nonnull view,
+                      const iop_field_t * nonnull f,
+                      iop_view_t * nonnull out);
+
+/** Get an iterator on the elements of a repeated field.
+ *
+ * The iterator is empty when the field is not packed.
+ *
+ * <code>
+ * iop_view_array_t it;
+ * int64_t i;
+ *
+ * RETHROW(iop_view_get_array(&view, f, &it));
+ * while (RETHROW(iop_view_array_next_int(&it, &i))) {
+ *     ...
+ * }
+ * </code>
+ */
+__must_check__
+int iop_view_get_array(iop_view_t * nonnull view,
+                       const iop_field_t * nonnull f,
+                       iop_view_array_t * nonnull out);
+
+/** Get the next element of a repeated field.
+ *
+ * These functions return 1 when an element was read, 0 at the end of the
+ * array and -1 when the packed value is invalid.
+ */
+__must_check__
+int iop_view_array_next_int(iop_view_array_t * nonnull it,
+                            int64_t * nonnull out);
+__must_check__
+int iop_view_array_next_double(iop_view_array_t * nonnull it,
+                               double * nonnull out);
+__must_check__
+int iop_view_array_next_lstr(iop_view_array_t * nonnull it,
+                             lstr_t * nonnull out);
+__must_check__
+int iop_view_array_next_view(iop_view_array_t * nonnull it,
+                             iop_view_t * nonnull out);
+
 /* }}} */
 /* {{{ IOP packages registration / manipulation */
 
@@ -0,0 +1,306 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_IOP_CODEC_H
+#define IS_LIB_COMMON_IOP_CODEC_H
+
+#include <lib-common/arith.h>
+#include <lib-common/iop.h>
+
+/* Binary packing primitives
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * These are the primitives of the IOP binary wire format. They are shared
+ * by the generic (un)packer of iop.blk, that interprets the iop_struct_t
+ * descriptions, and by the specialized (un)packers that iopc generates with
+ * --c-codecs for the structures that only have scalar and string fields
+ * (see iop_struct_codec_t).
+ */
+
+#define IOP_WIRE_FMT(o)          ((uint8_t)(o) >> 5)
+#define IOP_WIRE_MASK(m)         (IOP_WIRE_##m << 5)
+#define IOP_TAG(o)               ((o) & ((1 << 5) - 1))
+#define IOP_LONG_TAG(n)          ((1 << 5) - 3 + (n))
+
+#define IOP_MAKE_U32(a, b, c, d) \
+    ((a) | ((unsigned)(b) << 8) | ((unsigned)(c) << 16) | ((unsigned)(d) << 24))
+
+/* {{{ Sizes */
+
+static ALWAYS_INLINE uint8_t iop_codec_len_len(uint32_t u)
+{
+    uint8_t bits = bsr32(u | 1);
+    return 0x04040201 >> (bits & -8);
+}
+
+static ALWAYS_INLINE uint8_t iop_codec_vint32_len(int32_t i)
+{
+    const uint8_t zzbits = bsr32(((i >> 31) ^ (i << 1)) | 1);
+    return 0x04040201 >> (zzbits & -8);
+}
+
+static ALWAYS_INLINE unsigned iop_codec_vint64_len(int64_t i)
+{
+    static uint8_t const sizes[8] = { 1, 2, 4, 4, 8, 8, 8, 8 };
+    return sizes[bsr64(((i >> 63) ^ (i << 1)) | 1) / 8];
+}
+
+/** Size of a string value, without its tag. */
+static ALWAYS_INLINE int iop_codec_str_len(const lstr_t *s)
+{
+    return iop_codec_len_len(s->len + 1) + s->len + 1;
+}
+
+static inline bool
+iop_codec_field_is_defval(const iop_field_t *fdesc, const void *ptr,
+                          bool deep)
+{
+    assert (fdesc->repeat == IOP_R_DEFVAL);
+
+    switch (fdesc->type) {
+      case IOP_T_I8: case IOP_T_U8:
+        return *(uint8_t *)ptr == (uint8_t)fdesc->u1.defval_u64;
+      case IOP_T_I16: case IOP_T_U16:
+        return *(uint16_t *)ptr == (uint16_t)fdesc->u1.defval_u64;
+      case IOP_T_ENUM:
+        return *(int *)ptr == fdesc->u0.defval_enum;
+      case IOP_T_I32: case IOP_T_U32:
+        return *(uint32_t *)ptr == (uint32_t)fdesc->u1.defval_u64;
+      case IOP_T_I64: case IOP_T_U64:
+      case IOP_T_DOUBLE:
+        /* XXX double is handled like U64 because we want to compare them as
+         * bit to bit */
+        return *(uint64_t *)ptr == fdesc->u1.defval_u64;
+      case IOP_T_BOOL:
+        return fdesc->u1.defval_u64 ? *(bool *)ptr : !*(bool *)ptr;
+      case IOP_T_STRING:
+      case IOP_T_XML:
+      case IOP_T_DATA:
+        if (!fdesc->u0.defval_len) {
+            /* In this case we don't care about the string pointer. An empty
+             * string is an empty string whatever its pointer is. */
+            return !((lstr_t *)ptr)->len;
+        } else {
+            /* We consider a NULL string as “take the default value please”;
+             * otherwise we first check for the pointer equality and finally
+             * for the string equality. */
+            if (!((lstr_t *)ptr)->data) {
+                return true;
+            }
+            if (((lstr_t *)ptr)->len != fdesc->u0.defval_len) {
+                return false;
+            }
+            if (((lstr_t *)ptr)->data == fdesc->u1.defval_data) {
+                return true;
+            }
+            if (deep) {
+                return memcmp(((lstr_t *)ptr)->s, fdesc->u1.defval_data,
+                              fdesc->u0.defval_len) == 0;
+            }
+            return false;
+        }
+      default:
+        e_panic("unsupported");
+    }
+}
+
+/* }}} */
+/* {{{ Packing */
+
+static ALWAYS_INLINE uint8_t *
+iop_codec_pack_tag(uint8_t *dst, uint32_t tag, uint32_t taglen, uint8_t wt)
+{
+    if (likely(taglen < 1)) {
+        *dst++ = wt | tag;
+        return dst;
+    }
+    if (likely(taglen == 1)) {
+        *dst++ = wt | IOP_LONG_TAG(1);
+        *dst++ = tag;
+        return dst;
+    }
+    *dst++ = wt | IOP_LONG_TAG(2);
+    return (uint8_t *)put_unaligned_le16((void *)dst, tag);
+}
+
+static ALWAYS_INLINE uint8_t *
+iop_codec_pack_len(uint8_t *dst, uint32_t tag, uint32_t taglen, uint32_t i)
+{
+    const uint32_t tags  =
+        IOP_MAKE_U32(IOP_WIRE_MASK(BLK1), IOP_WIRE_MASK(BLK2),
+                     IOP_WIRE_MASK(BLK4), IOP_WIRE_MASK(BLK4));
+    const uint8_t  bits = bsr32(i | 1) & -8;
+
+    dst = iop_codec_pack_tag(dst, tag, taglen, tags >> bits);
+    if (likely(bits < 8)) {
+        *dst++ = i;
+        return dst;
+    }
+    if (likely(bits == 8))
+        return (uint8_t *)put_unaligned_le16((void *)dst, i);
+    return (uint8_t *)put_unaligned_le32((void *)dst, i);
+}
+
+static ALWAYS_INLINE uint8_t *
+iop_codec_pack_int32(uint8_t *dst, uint32_t tag, uint32_t taglen, int32_t i)
+{
+    const uint32_t tags  =
+        IOP_MAKE_U32(IOP_WIRE_MASK(INT1), IOP_WIRE_MASK(INT2),
+                     IOP_WIRE_MASK(INT4), IOP_WIRE_MASK(INT4));
+    const uint8_t zzbits = (bsr32(((i >> 31) ^ (i << 1)) | 1)) & -8;
+
+    dst = iop_codec_pack_tag(dst, tag, taglen, tags >> zzbits);
+
+    if (likely(zzbits < 8)) {
+        *dst++ = i;
+        return dst;
+    }
+    if (likely(zzbits == 8))
+        return (uint8_t *)put_unaligned_le16((void *)dst, i);
+    return (uint8_t *)put_unaligned_le32((void *)dst, i);
+}
+
+static ALWAYS_INLINE uint8_t *
+iop_codec_pack_int64(uint8_t *dst, uint32_t tag, uint32_t taglen, int64_t i)
+{
+    if ((int64_t)(int32_t)i == i)
+        return iop_codec_pack_int32(dst, tag, taglen, i);
+    dst = iop_codec_pack_tag(dst, tag, taglen, IOP_WIRE_MASK(QUAD));
+    return (uint8_t *)put_unaligned_le64((uint8_t *)dst, i);
+}
+
+/** Pack a byte or a boolean. */
+static ALWAYS_INLINE uint8_t *
+iop_codec_pack_int1(uint8_t *dst, uint32_t tag, uint32_t taglen, uint8_t i)
+{
+    dst    = iop_codec_pack_tag(dst, tag, taglen, IOP_WIRE_MASK(INT1));
+    *dst++ = i;
+    return dst;
+}
+
+static ALWAYS_INLINE uint8_t *
+iop_codec_pack_double(uint8_t *dst, uint32_t tag, uint32_t taglen, double d)
+{
+    dst = iop_codec_pack_tag(dst, tag, taglen, IOP_WIRE_MASK(QUAD));
+    return put_unaligned_double_le(dst, d);
+}
+
+static ALWAYS_INLINE uint8_t *
+iop_codec_pack_str(uint8_t *dst, uint32_t tag, uint32_t taglen,
+                   const lstr_t *s)
+{
+    dst = iop_codec_pack_len(dst, tag, taglen, s->len + 1);
+    return mempcpyz(dst, s->data, s->len);
+}
+
+/* }}} */
+/* {{{ Unpacking */
+
+/* The specialized unpackers only accept the values in the form the packer
+ * writes them, anything else (unknown tags, repeated values, ...) makes them
+ * fail so that the generic unpacker takes over. */
+
+/** Read the next tag, tag is UINT32_MAX at the end of the stream. */
+static ALWAYS_INLINE int
+iop_codec_get_tag(pstream_t *ps, uint32_t *tag, iop_wire_type_t *wt)
+{
+    uint16_t u16;
+
+    if (ps_done(ps)) {
+        *tag = UINT32_MAX;
+        return 0;
+    }
+    *wt  = IOP_WIRE_FMT(ps->b[0]);
+    *tag = IOP_TAG(__ps_getc(ps));
+    if (likely(*tag < IOP_LONG_TAG(1)))
+        return 0;
+    if (likely(*tag == IOP_LONG_TAG(1))) {
+        *tag = RETHROW(ps_getc(ps));
+        return 0;
+    }
+    RETHROW(ps_get_le16(ps, &u16));
+    *tag = u16;
+    return 0;
+}
+
+static ALWAYS_INLINE int
+iop_codec_get_int(pstream_t *ps, iop_wire_type_t wt, int64_t min,
+                  int64_t max, int64_t *i64)
+{
+    switch (wt) {
+      case IOP_WIRE_INT1:
+        PS_WANT(ps_has(ps, 1));
+        *i64 = (int8_t)__ps_getc(ps);
+        break;
+      case IOP_WIRE_INT2:
+        PS_WANT(ps_has(ps, 2));
+        *i64 = (int16_t)__ps_get_le16(ps);
+        break;
+      case IOP_WIRE_INT4:
+        PS_WANT(ps_has(ps, 4));
+        *i64 = (int32_t)__ps_get_le32(ps);
+        break;
+      case IOP_WIRE_QUAD:
+        PS_WANT(ps_has(ps, 8));
+        *i64 = __ps_get_le64(ps);
+        break;
+      default:
+        return -1;
+    }
+    THROW_ERR_IF(*i64 < min || *i64 > max);
+    return 0;
+}
+
+static ALWAYS_INLINE int
+iop_codec_get_double(pstream_t *ps, iop_wire_type_t wt, double *d)
+{
+    PS_WANT(wt == IOP_WIRE_QUAD);
+    return ps_get_double_le(ps, d);
+}
+
+static ALWAYS_INLINE int
+iop_codec_get_str(mem_pool_t *mp, pstream_t *ps, iop_wire_type_t wt,
+                  unsigned flags, lstr_t *s)
+{
+    uint32_t len;
+
+    switch (wt) {
+      case IOP_WIRE_BLK1:
+        PS_WANT(ps_has(ps, 1));
+        len = __ps_getc(ps);
+        break;
+      case IOP_WIRE_BLK2:
+        PS_WANT(ps_has(ps, 2));
+        len = __ps_get_le16(ps);
+        break;
+      case IOP_WIRE_BLK4:
+        PS_WANT(ps_has(ps, 4));
+        len = __ps_get_le32(ps);
+        break;
+      default:
+        return -1;
+    }
+    PS_WANT(len >= 1 && ps_has(ps, len));
+    *s = LSTR_INIT_V((flags & IOP_UNPACK_COPY_STRINGS)
+                     ? mp_dup(mp, ps->s, len) : ps->p, len - 1);
+    return __ps_skip(ps, len);
+}
+
+/* }}} */
+
+#endif
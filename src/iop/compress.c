@@ -0,0 +1,150 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/iop-compress.h>
+
+qm_k32_t(iop_dict_by_id, compress_dict_t * nonnull);
+qm_kvec_t(iop_dict_by_st, lstr_t, const compress_dict_t * nonnull,
+          qhash_lstr_hash, qhash_lstr_equal);
+
+static struct {
+    /* All the registered dictionaries, that own them. */
+    qm_t(iop_dict_by_id) by_id;
+
+    /* Current dictionary of the structures, by fullname: the DSOs can be
+     * reloaded, so the iop_struct_t pointers are not stable. */
+    qm_t(iop_dict_by_st) by_st;
+} iop_compress_g = {
+#define _G  iop_compress_g
+    .by_id = QM_INIT(iop_dict_by_id, _G.by_id),
+    .by_st = QM_INIT(iop_dict_by_st, _G.by_st),
+};
+
+/* {{{ Dictionaries */
+
+int iop_bpack_dict_train(sb_t *out, const iop_struct_t *st,
+                         const void * const *values, int nb_values,
+                         int max_size)
+{
+    t_scope;
+    lstr_t *samples = t_new_raw(lstr_t, nb_values);
+    SB_8k(buf);
+    int *offsets = t_new_raw(int, nb_values + 1);
+    int res;
+
+    /* Pack everything first, the buffer moves while it grows. */
+    for (int i = 0; i < nb_values; i++) {
+        offsets[i] = buf.len;
+        iop_bpack_sb(&buf, st, values[i], 0);
+    }
+    offsets[nb_values] = buf.len;
+    for (int i = 0; i < nb_values; i++) {
+        samples[i] = LSTR_INIT_V(buf.data + offsets[i],
+                                 offsets[i + 1] - offsets[i]);
+    }
+
+    res = compress_dict_train(out, samples, nb_values, max_size);
+    sb_wipe(&buf);
+    return res;
+}
+
+int iop_bpack_dict_register(const iop_struct_t *st, lstr_t data, int level)
+{
+    compress_dict_t *dict = compress_dict_new(data, level);
+    uint32_t id;
+    int pos;
+
+    if (!dict) {
+        return -1;
+    }
+    id = compress_dict_id(dict);
+    if (!id || qm_add(iop_dict_by_id, &_G.by_id, id, dict) < 0) {
+        compress_dict_delete(&dict);
+        return -1;
+    }
+
+    pos = qm_reserve(iop_dict_by_st, &_G.by_st, &st->fullname, 0);
+    if (pos & QHASH_COLLISION) {
+        pos &= ~QHASH_COLLISION;
+    } else {
+        _G.by_st.keys[pos] = lstr_dup(st->fullname);
+    }
+    _G.by_st.values[pos] = dict;
+    return 0;
+}
+
+const compress_dict_t *iop_bpack_dict_get(const iop_struct_t *st)
+{
+    return qm_get_def(iop_dict_by_st, &_G.by_st, &st->fullname, NULL);
+}
+
+__attribute__((destructor))
+static void iop_compress_shutdown(void)
+{
+    qm_deep_wipe(iop_dict_by_id, &_G.by_id, IGNORE, compress_dict_delete);
+    qm_deep_wipe(iop_dict_by_st, &_G.by_st, lstr_wipe, IGNORE);
+}
+
+/* }}} */
+/* {{{ Compression */
+
+int iop_bpack_compress(sb_t *out, const iop_struct_t *st, const void *v,
+                       unsigned flags)
+{
+    const compress_dict_t *dict = iop_bpack_dict_get(st);
+    SB_8k(buf);
+    ssize_t res;
+
+    if (iop_bpack_sb(&buf, st, v, flags) < 0) {
+        sb_wipe(&buf);
+        return -1;
+    }
+    /* The level is the one of the dictionary when there is one. */
+    res = sb_add_compress(out, COMPRESS_ZSTD, COMPRESS_LEVEL_DEFAULT, dict,
+                          buf.data, buf.len);
+    sb_wipe(&buf);
+    return res;
+}
+
+int iop_bunpack_decompress(mem_pool_t *mp, const iop_struct_t *st,
+                           void *value, pstream_t ps, unsigned flags)
+{
+    const compress_dict_t *dict = NULL;
+    uint32_t id = compress_dict_id_from_frame(LSTR_PS_V(&ps));
+    SB_8k(buf);
+    int res;
+
+    if (id) {
+        dict = qm_get_def(iop_dict_by_id, &_G.by_id, id, NULL);
+        if (!dict) {
+            sb_wipe(&buf);
+            return -1;
+        }
+    }
+    if (sb_add_decompress(&buf, COMPRESS_ZSTD, dict, ps.s, ps_len(&ps)) < 0)
+    {
+        sb_wipe(&buf);
+        return -1;
+    }
+    res = iop_bunpack_flags(mp, st, value, ps_initsb(&buf),
+                            flags | IOP_UNPACK_COPY_STRINGS);
+    sb_wipe(&buf);
+    return res;
+}
+
+/* }}} */
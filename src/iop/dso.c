@@ -400,8 +400,10 @@ void iop_dso_close(iop_dso_t **dsop)
 static int iop_dso_register_(iop_dso_t *dso, sb_t *err)
 {
     if (!dso->is_registered) {
+        t_scope;
         iop_env_t env;
         iop_pkg_t **pkgp = dlsym(dso->handle, "iop_packages");
+        qv_t(cvoid) classes;
 
         if (!pkgp) {
             /* This should not happen because this was checked before. */
@@ -416,7 +418,23 @@ static int iop_dso_register_(iop_dso_t *dso, sb_t *err)
                 return -1;
             }
         }
-        RETHROW(iop_check_registered_classes(&env, err));
+
+        /* The current environment is consistent, only the classes of this
+         * DSO need to be checked, not all the classes of all the DSOs
+         * loaded so far. */
+        t_qv_init(&classes, qm_len(iop_struct, &dso->struct_h));
+        qm_for_each_value(iop_struct, st, &dso->struct_h) {
+            if (iop_struct_is_class(st)) {
+                qv_append(&classes, st);
+            }
+        }
+        if (iop_check_registered_classes_tab(
+                &env, (const iop_struct_t *const *)classes.tab, classes.len,
+                err) < 0)
+        {
+            iop_env_wipe(&env);
+            return -1;
+        }
         iop_env_set(&env);
         dso->is_registered = true;
     }
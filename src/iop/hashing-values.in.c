@@ -18,11 +18,57 @@
 
 #include "helpers.in.c"
 
+/* {{{ Digests cache */
+
+/* The repeated fields having more elements than this are hashed by chunks
+ * when a cache is used. */
+#define IOP_HASH_CHUNK_LEN  64
+
+/* The entries are the digests of the values of the structures (desc is the
+ * iop_struct_t, of the actual class for the classes) and of the chunks of
+ * the repeated fields (desc is the iop_field_t, v the first element). */
+typedef struct iop_hash_cache_key_t {
+    const void *v;
+    const void *desc;
+} iop_hash_cache_key_t;
+
+typedef struct iop_hash_cache_val_t {
+    uint64_t digest;
+    int32_t  n;
+} iop_hash_cache_val_t;
+
+static inline uint32_t
+iop_hash_cache_key_hash(const qhash_t *qh, const iop_hash_cache_key_t *k)
+{
+    return qhash_hash_ptr(qh, k->v) ^ qhash_hash_ptr(qh, k->desc);
+}
+
+static inline bool
+iop_hash_cache_key_equal(const qhash_t *qh, const iop_hash_cache_key_t *k1,
+                         const iop_hash_cache_key_t *k2)
+{
+    return k1->v == k2->v && k1->desc == k2->desc;
+}
+
+qm_kvec_t(iop_hash_cache, iop_hash_cache_key_t, iop_hash_cache_val_t,
+          iop_hash_cache_key_hash, iop_hash_cache_key_equal);
+
+struct iop_hash_cache_t {
+    unsigned flags;
+    qm_t(iop_hash_cache) digests;
+};
+
+/* }}} */
+
 struct iop_hash_ctx {
     size_t   pos;
     uint8_t  buf[1024];
     void   (*hfun)(void *ctx, const void *input, ssize_t len);
     void    *ctx;
+
+    /* When set, the digests of the sub-structures and of the chunks of the
+     * large repeated fields are hashed instead of their contents. */
+    struct iop_hash_cache_t *cache;
 };
 
 ATTRS
@@ -151,6 +197,15 @@ ATTRS
 static void F(__iop_hash)(struct iop_hash_ctx *ctx, const iop_struct_t *st,
                           const uint8_t *v, unsigned flags);
 
+ATTRS
+static uint64_t F(iop_hash_cache_struct)(struct iop_hash_cache_t *cache,
+                                         const iop_struct_t *st,
+                                         const uint8_t *v, bool is_class);
+ATTRS
+static uint64_t F(iop_hash_cache_chunk)(struct iop_hash_cache_t *cache,
+                                        const iop_field_t *fdesc,
+                                        const uint8_t *r, int n);
+
 ATTRS
 static inline void
 F(__iop_hash_class)(struct iop_hash_ctx *ctx, const iop_struct_t *st,
@@ -165,6 +220,106 @@ F(__iop_hash_class)(struct iop_hash_ctx *ctx, const iop_struct_t *st,
     } while ((st = st->class_attrs->parent));
 }
 
+ATTRS
+static void
+F(__iop_hash_values)(struct iop_hash_ctx *ctx, const iop_field_t *fdesc,
+                     const void *r, int n, unsigned flags)
+{
+    switch (fdesc->type) {
+      case IOP_T_I8:
+        for (int i = 0; i < n; i++) {
+            F(iop_hash_update_i64)(ctx, ((int8_t *)r)[i]);
+        }
+        break;
+      case IOP_T_BOOL:
+        for (int i = 0; i < n; i++) {
+            F(iop_hash_update_i64)(ctx, !!((bool *)r)[i]);
+        }
+        break;
+      case IOP_T_U8:
+        for (int i = 0; i < n; i++) {
+            F(iop_hash_update_i64)(ctx, ((uint8_t *)r)[i]);
+        }
+        break;
+      case IOP_T_I16:
+        for (int i = 0; i < n; i++) {
+            F(iop_hash_update_i64)(ctx, ((int16_t *)r)[i]);
+        }
+        break;
+      case IOP_T_U16:
+        for (int i = 0; i < n; i++) {
+            F(iop_hash_update_i64)(ctx, ((uint16_t *)r)[i]);
+        }
+        break;
+      case IOP_T_I32: case IOP_T_ENUM:
+        for (int i = 0; i < n; i++) {
+            F(iop_hash_update_i64)(ctx, ((int32_t *)r)[i]);
+        }
+        break;
+      case IOP_T_U32:
+        for (int i = 0; i < n; i++) {
+            F(iop_hash_update_i64)(ctx, ((uint32_t *)r)[i]);
+        }
+        break;
+      case IOP_T_I64:
+        for (int i = 0; i < n; i++) {
+            F(iop_hash_update_i64)(ctx, ((int64_t *)r)[i]);
+        }
+        break;
+      case IOP_T_U64:
+        for (int i = 0; i < n; i++) {
+            F(iop_hash_update_i64)(ctx, ((uint64_t *)r)[i]);
+        }
+        break;
+      case IOP_T_DOUBLE:
+        for (int i = 0; i < n; i++) {
+            iop_hash_update_dbl(ctx, ((double *)r)[i]);
+        }
+        break;
+      case IOP_T_UNION:
+      case IOP_T_STRUCT: {
+        bool is_class = iop_field_is_class(fdesc);
+        bool is_ref   = iop_field_is_reference(fdesc);
+
+        for (int i = 0; i < n; i++) {
+            const uint8_t *v2;
+
+            v2 = &IOP_FIELD(const uint8_t, r, i * fdesc->size);
+
+            if ((is_class || is_ref) && fdesc->repeat != IOP_R_OPTIONAL) {
+                /* Non-optional class fields have to be dereferenced
+                 * (dereferencing of optional fields was already done by
+                 *  the caller).
+                 */
+                v2 = *(void **)v2;
+            }
+            if (ctx->cache) {
+                F(iop_hash_update_i64)(ctx, F(iop_hash_cache_struct)(
+                    ctx->cache, fdesc->u1.st_desc, v2, is_class));
+            } else
+            if (is_class) {
+                F(__iop_hash_class)(ctx, fdesc->u1.st_desc, v2, flags);
+            } else {
+                F(__iop_hash)(ctx, fdesc->u1.st_desc, v2, flags);
+            }
+        }
+        break;
+      }
+      case IOP_T_XML:
+      case IOP_T_STRING:
+      case IOP_T_DATA:
+        for (int i = 0; i < n; i++) {
+            const lstr_t *s = &IOP_FIELD(const lstr_t, r, i);
+
+            F(iop_hash_update_u32)(ctx, s->len);
+            F(iop_hash_update)(ctx, s->data, s->len);
+        }
+        break;
+      case IOP_T_VOID:
+        break;
+    }
+}
+
 ATTRS
 static void
 F(__iop_hash)(struct iop_hash_ctx *ctx, const iop_struct_t *st,
@@ -226,94 +381,15 @@ F(__iop_hash)(struct iop_hash_ctx *ctx, const iop_struct_t *st,
             }
         }
 
-        switch (fdesc->type) {
-          case IOP_T_I8:
-            for (int i = 0; i < n; i++) {
-                F(iop_hash_update_i64)(ctx, ((int8_t *)r)[i]);
-            }
-            break;
-          case IOP_T_BOOL:
-            for (int i = 0; i < n; i++) {
-                F(iop_hash_update_i64)(ctx, !!((bool *)r)[i]);
-            }
-            break;
-          case IOP_T_U8:
-            for (int i = 0; i < n; i++) {
-                F(iop_hash_update_i64)(ctx, ((uint8_t *)r)[i]);
-            }
-            break;
-          case IOP_T_I16:
-            for (int i = 0; i < n; i++) {
-                F(iop_hash_update_i64)(ctx, ((int16_t *)r)[i]);
-            }
-            break;
-          case IOP_T_U16:
-            for (int i = 0; i < n; i++) {
-                F(iop_hash_update_i64)(ctx, ((uint16_t *)r)[i]);
-            }
-            break;
-          case IOP_T_I32: case IOP_T_ENUM:
-            for (int i = 0; i < n; i++) {
-                F(iop_hash_update_i64)(ctx, ((int32_t *)r)[i]);
-            }
-            break;
-          case IOP_T_U32:
-            for (int i = 0; i < n; i++) {
-                F(iop_hash_update_i64)(ctx, ((uint32_t *)r)[i]);
-            }
-            break;
-          case IOP_T_I64:
-            for (int i = 0; i < n; i++) {
-                F(iop_hash_update_i64)(ctx, ((int64_t *)r)[i]);
-            }
-            break;
-          case IOP_T_U64:
-            for (int i = 0; i < n; i++) {
-                F(iop_hash_update_i64)(ctx, ((uint64_t *)r)[i]);
-            }
-            break;
-          case IOP_T_DOUBLE:
-            for (int i = 0; i < n; i++) {
-                iop_hash_update_dbl(ctx, ((double *)r)[i]);
-            }
-            break;
-          case IOP_T_UNION:
-          case IOP_T_STRUCT: {
-            bool is_class = iop_field_is_class(fdesc);
-            bool is_ref   = iop_field_is_reference(fdesc);
-
-            for (int i = 0; i < n; i++) {
-                const uint8_t *v2;
-
-                v2 = &IOP_FIELD(const uint8_t, r, i * fdesc->size);
-
-                if ((is_class || is_ref) && fdesc->repeat != IOP_R_OPTIONAL) {
-                    /* Non-optional class fields have to be dereferenced
-                     * (dereferencing of optional fields was already done just
-                     *  above).
-                     */
-                    v2 = *(void **)v2;
-                }
-                if (is_class) {
-                    F(__iop_hash_class)(ctx, fdesc->u1.st_desc, v2, flags);
-                } else {
-                    F(__iop_hash)(ctx, fdesc->u1.st_desc, v2, flags);
-                }
-            }
-            break;
-          }
-          case IOP_T_XML:
-          case IOP_T_STRING:
-          case IOP_T_DATA:
-            for (int i = 0; i < n; i++) {
-                const lstr_t *s = &IOP_FIELD(const lstr_t, r, i);
-
-                F(iop_hash_update_u32)(ctx, s->len);
-                F(iop_hash_update)(ctx, s->data, s->len);
+        if (ctx->cache && n > IOP_HASH_CHUNK_LEN) {
+            for (int i = 0; i < n; i += IOP_HASH_CHUNK_LEN) {
+                const uint8_t *chunk = (const uint8_t *)r + i * fdesc->size;
+
+                F(iop_hash_update_i64)(ctx, F(iop_hash_cache_chunk)(
+                    ctx->cache, fdesc, chunk, MIN(n - i, IOP_HASH_CHUNK_LEN)));
             }
-            break;
-          case IOP_T_VOID:
-            break;
+        } else {
+            F(__iop_hash_values)(ctx, fdesc, r, n, flags);
         }
     }
 }
@@ -339,3 +415,284 @@ void F(iop_hash)(const iop_struct_t *st, const void *v,
     if (ctx.pos)
         hfun(hctx, ctx.buf, ctx.pos);
 }
+
+/* {{{ Cached digests */
+
+ATTRS
+static uint64_t
+F(iop_hash_cache_compute)(struct iop_hash_cache_t *cache,
+                          const iop_struct_t *st, const iop_field_t *fdesc,
+                          const uint8_t *v, int n)
+{
+    wyhash64_ctx wctx;
+    struct iop_hash_ctx ctx = {
+        .hfun  = (iop_hash_f *)&wyhash64_update,
+        .ctx   = &wctx,
+        .cache = cache,
+    };
+
+    wyhash64_starts(&wctx, 0);
+    if (fdesc) {
+        F(__iop_hash_values)(&ctx, fdesc, v, n, cache->flags);
+    } else
+    if (iop_struct_is_class(st)) {
+        F(__iop_hash_class)(&ctx, st, v, cache->flags);
+    } else {
+        F(__iop_hash)(&ctx, st, v, cache->flags);
+    }
+    if (ctx.pos) {
+        wyhash64_update(&wctx, ctx.buf, ctx.pos);
+    }
+    return wyhash64_finish(&wctx);
+}
+
+ATTRS
+static uint64_t F(iop_hash_cache_struct)(struct iop_hash_cache_t *cache,
+                                         const iop_struct_t *st,
+                                         const uint8_t *v, bool is_class)
+{
+    iop_hash_cache_key_t key = {
+        .v    = v,
+        .desc = is_class ? *(const iop_struct_t **)v : st,
+    };
+    iop_hash_cache_val_t val;
+    int pos = qm_find(iop_hash_cache, &cache->digests, &key);
+
+    if (pos >= 0) {
+        return cache->digests.values[pos].digest;
+    }
+    /* the table can grow while the sub-values are hashed: the digest is
+     * added afterwards */
+    val.digest = F(iop_hash_cache_compute)(cache, st, NULL, v, 1);
+    val.n = 0;
+    qm_add(iop_hash_cache, &cache->digests, &key, val);
+    return val.digest;
+}
+
+ATTRS
+static uint64_t F(iop_hash_cache_chunk)(struct iop_hash_cache_t *cache,
+                                        const iop_field_t *fdesc,
+                                        const uint8_t *r, int n)
+{
+    iop_hash_cache_key_t key = {
+        .v    = r,
+        .desc = fdesc,
+    };
+    iop_hash_cache_val_t val;
+    int pos = qm_find(iop_hash_cache, &cache->digests, &key);
+
+    if (pos >= 0) {
+        /* the last chunk of an array that grew in place */
+        if (cache->digests.values[pos].n == n) {
+            return cache->digests.values[pos].digest;
+        }
+        qm_del_at(iop_hash_cache, &cache->digests, pos);
+    }
+    val.digest = F(iop_hash_cache_compute)(cache, NULL, fdesc, r, n);
+    val.n = n;
+    qm_add(iop_hash_cache, &cache->digests, &key, val);
+    return val.digest;
+}
+
+ATTRS
+static void F(iop_hash_cache_forget)(struct iop_hash_cache_t *cache,
+                                     const void *v, const void *desc)
+{
+    iop_hash_cache_key_t key = {
+        .v    = v,
+        .desc = desc,
+    };
+
+    qm_del_key(iop_hash_cache, &cache->digests, &key);
+}
+
+ATTRS
+static void F(iop_hash_cache_forget_struct)(struct iop_hash_cache_t *cache,
+                                            const iop_struct_t *st,
+                                            const uint8_t *v);
+
+/* Forgets the digests of the chunks of a repeated field, and of all the
+ * values below it. */
+ATTRS
+static void F(iop_hash_cache_forget_values)(struct iop_hash_cache_t *cache,
+                                            const iop_field_t *fdesc,
+                                            const void *r, int n)
+{
+    bool is_st = fdesc->type == IOP_T_STRUCT || fdesc->type == IOP_T_UNION;
+
+    if (fdesc->repeat == IOP_R_REPEATED && n > IOP_HASH_CHUNK_LEN) {
+        for (int i = 0; i < n; i += IOP_HASH_CHUNK_LEN) {
+            F(iop_hash_cache_forget)(cache, (const uint8_t *)r +
+                                     i * fdesc->size, fdesc);
+        }
+    }
+    if (!is_st) {
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        const uint8_t *v = &IOP_FIELD(const uint8_t, r, i * fdesc->size);
+
+        if (iop_field_is_pointed(fdesc)) {
+            v = *(const uint8_t **)v;
+        }
+        if (v) {
+            F(iop_hash_cache_forget_struct)(cache, fdesc->u1.st_desc, v);
+        }
+    }
+}
+
+ATTRS
+static void F(iop_hash_cache_forget_struct)(struct iop_hash_cache_t *cache,
+                                            const iop_struct_t *st,
+                                            const uint8_t *v)
+{
+    if (iop_struct_is_class(st)) {
+        st = *(const iop_struct_t **)v;
+    }
+    F(iop_hash_cache_forget)(cache, v, st);
+
+    do {
+        const iop_field_t *fdesc = st->fields;
+        const iop_field_t *end = fdesc + st->fields_len;
+
+        if (st->is_union) {
+            fdesc = get_union_field(st, v);
+            end   = fdesc + 1;
+        }
+        for (; fdesc < end; fdesc++) {
+            const void *r = v + fdesc->data_offs;
+            int n = 1;
+
+            if (fdesc->repeat == IOP_R_REPEATED) {
+                n = ((lstr_t *)r)->len;
+                r = ((lstr_t *)r)->data;
+            }
+            F(iop_hash_cache_forget_values)(cache, fdesc, r, n);
+        }
+    } while (iop_struct_is_class(st) && (st = st->class_attrs->parent));
+}
+
+ATTRS
+#ifdef ALL_STATIC
+static
+#endif
+struct iop_hash_cache_t *F(iop_hash_cache_new)(unsigned flags)
+{
+    struct iop_hash_cache_t *cache = p_new(struct iop_hash_cache_t, 1);
+
+    cache->flags = flags;
+    qm_init(iop_hash_cache, &cache->digests);
+    return cache;
+}
+
+ATTRS
+#ifdef ALL_STATIC
+static
+#endif
+void F(iop_hash_cache_delete)(struct iop_hash_cache_t **cachep)
+{
+    if (*cachep) {
+        qm_wipe(iop_hash_cache, &(*cachep)->digests);
+        p_delete(cachep);
+    }
+}
+
+ATTRS
+#ifdef ALL_STATIC
+static
+#endif
+void F(iop_hash_cache_clear)(struct iop_hash_cache_t *cache)
+{
+    qm_clear(iop_hash_cache, &cache->digests);
+}
+
+ATTRS
+#ifdef ALL_STATIC
+static
+#endif
+uint64_t F(iop_hash64_cached)(struct iop_hash_cache_t *cache,
+                              const iop_struct_t *st, const void *v)
+{
+    return F(iop_hash_cache_struct)(cache, st, v, iop_struct_is_class(st));
+}
+
+ATTRS
+#ifdef ALL_STATIC
+static
+#endif
+int F(iop_hash_cache_invalidate)(struct iop_hash_cache_t *cache,
+                                 const iop_struct_t *st, const void *v,
+                                 lstr_t path)
+{
+    pstream_t ps = ps_initlstr(&path);
+
+    for (;;) {
+        iop_field_path_parse_t field_parse;
+        const iop_field_t *fdesc;
+        const void *r;
+        bool is_array = false;
+        int n = 1;
+
+        if (ps_done(&ps)) {
+            F(iop_hash_cache_forget_struct)(cache, st, v);
+            return 0;
+        }
+        if (iop_struct_is_class(st)) {
+            st = *(const iop_struct_t **)v;
+        }
+        F(iop_hash_cache_forget)(cache, v, st);
+
+        RETHROW(parse_field_from_path(&ps, st, &field_parse, NULL));
+        RETHROW(iop_field_find_by_name(st, LSTR_PS_V(&field_parse.field_name),
+                                       NULL, &fdesc));
+        if (st->is_union && *(int16_t *)v != fdesc->tag) {
+            /* nothing is cached below a field that is not selected */
+            return 0;
+        }
+        r = (const uint8_t *)v + fdesc->data_offs;
+
+        if (fdesc->repeat == IOP_R_REPEATED) {
+            const iop_array_i8_t *array = r;
+
+            r = array->tab;
+            n = array->len;
+            if (OPT_ISSET(field_parse.array_index)) {
+                int i = OPT_VAL(field_parse.array_index);
+
+                if (i < 0) {
+                    i += n;
+                }
+                THROW_ERR_IF(i < 0 || i >= n);
+                if (n > IOP_HASH_CHUNK_LEN) {
+                    F(iop_hash_cache_forget)(cache, (const uint8_t *)r +
+                                             ROUND(i, IOP_HASH_CHUNK_LEN) *
+                                             fdesc->size, fdesc);
+                }
+                r = (const uint8_t *)r + i * fdesc->size;
+                n = 1;
+            } else {
+                is_array = true;
+            }
+        } else {
+            THROW_ERR_IF(OPT_ISSET(field_parse.array_index));
+        }
+
+        if (is_array
+        ||  (fdesc->type != IOP_T_STRUCT && fdesc->type != IOP_T_UNION))
+        {
+            THROW_ERR_IF(!ps_done(&ps));
+            F(iop_hash_cache_forget_values)(cache, fdesc, r, n);
+            return 0;
+        }
+        if (iop_field_is_pointed(fdesc)) {
+            r = *(const void **)r;
+            if (!r) {
+                return 0;
+            }
+        }
+        st = fdesc->u1.st_desc;
+        v  = r;
+    }
+}
+
+/* }}} */
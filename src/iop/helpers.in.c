@@ -20,11 +20,18 @@
 #define IS_IOP_HELPERS_IN1_C
 
 #include <lib-common/arith.h>
-
-#define IOP_WIRE_FMT(o)          ((uint8_t)(o) >> 5)
-#define IOP_WIRE_MASK(m)         (IOP_WIRE_##m << 5)
-#define IOP_TAG(o)               ((o) & ((1 << 5) - 1))
-#define IOP_LONG_TAG(n)          ((1 << 5) - 3 + (n))
+#include <lib-common/iop/codec.h>
+
+/* The binary packing primitives are shared with the packers generated by
+ * iopc, see <lib-common/iop/codec.h>. */
+#define get_len_len          iop_codec_len_len
+#define get_vint32_len       iop_codec_vint32_len
+#define get_vint64_len       iop_codec_vint64_len
+#define iop_field_is_defval  iop_codec_field_is_defval
+#define pack_tag             iop_codec_pack_tag
+#define pack_len             iop_codec_pack_len
+#define pack_int32           iop_codec_pack_int32
+#define pack_int64           iop_codec_pack_int64
 
 #define TO_BIT(type)  (1 << (IOP_T_##type))
 #define IOP_INT_OK    0x103ff
@@ -34,27 +41,9 @@
 #define IOP_STRUCTS_OK    (TO_BIT(STRUCT) | TO_BIT(UNION))
 #define IOP_REPEATED_OPTIMIZE_OK  (TO_BIT(I8) | TO_BIT(U8) | TO_BIT(I16) \
                                    | TO_BIT(U16) | TO_BIT(BOOL))
-
-#define IOP_MAKE_U32(a, b, c, d) \
-    ((a) | ((unsigned)(b) << 8) | ((unsigned)(c) << 16) | ((unsigned)(d) << 24))
-
-static ALWAYS_INLINE uint8_t get_len_len(uint32_t u)
-{
-    uint8_t bits = bsr32(u | 1);
-    return 0x04040201 >> (bits & -8);
-}
-
-static ALWAYS_INLINE uint8_t get_vint32_len(int32_t i)
-{
-    const uint8_t zzbits = bsr32(((i >> 31) ^ (i << 1)) | 1);
-    return 0x04040201 >> (zzbits & -8);
-}
-
-static ALWAYS_INLINE unsigned get_vint64_len(int64_t i)
-{
-    static uint8_t const sizes[8] = { 1, 2, 4, 4, 8, 8, 8, 8 };
-    return sizes[bsr64(((i >> 63) ^ (i << 1)) | 1) / 8];
-}
+/* repeated integers (un)packed in bulk */
+#define IOP_VEC_INT_OK  (TO_BIT(I32) | TO_BIT(ENUM) | TO_BIT(U32) \
+                         | TO_BIT(I64) | TO_BIT(U64))
 
 static inline bool iop_type_is_string(iop_type_t type)
 {
@@ -268,68 +257,6 @@ static inline void iop_field_set_absent(const iop_field_t *f, void *v)
     }
 }
 
-static ALWAYS_INLINE uint8_t *
-pack_tag(uint8_t *dst, uint32_t tag, uint32_t taglen, uint8_t wt)
-{
-    if (likely(taglen < 1)) {
-        *dst++ = wt | tag;
-        return dst;
-    }
-    if (likely(taglen == 1)) {
-        *dst++ = wt | IOP_LONG_TAG(1);
-        *dst++ = tag;
-        return dst;
-    }
-    *dst++ = wt | IOP_LONG_TAG(2);
-    return (uint8_t *)put_unaligned_le16((void *)dst, tag);
-}
-
-static ALWAYS_INLINE uint8_t *
-pack_len(uint8_t *dst, uint32_t tag, uint32_t taglen, uint32_t i)
-{
-    const uint32_t tags  =
-        IOP_MAKE_U32(IOP_WIRE_MASK(BLK1), IOP_WIRE_MASK(BLK2),
-                     IOP_WIRE_MASK(BLK4), IOP_WIRE_MASK(BLK4));
-    const uint8_t  bits = bsr32(i | 1) & -8;
-
-    dst = pack_tag(dst, tag, taglen, tags >> bits);
-    if (likely(bits < 8)) {
-        *dst++ = i;
-        return dst;
-    }
-    if (likely(bits == 8))
-        return (uint8_t *)put_unaligned_le16((void *)dst, i);
-    return (uint8_t *)put_unaligned_le32((void *)dst, i);
-}
-
-static ALWAYS_INLINE uint8_t *
-pack_int32(uint8_t *dst, uint32_t tag, uint32_t taglen, int32_t i)
-{
-    const uint32_t tags  =
-        IOP_MAKE_U32(IOP_WIRE_MASK(INT1), IOP_WIRE_MASK(INT2),
-                     IOP_WIRE_MASK(INT4), IOP_WIRE_MASK(INT4));
-    const uint8_t zzbits = (bsr32(((i >> 31) ^ (i << 1)) | 1)) & -8;
-
-    dst = pack_tag(dst, tag, taglen, tags >> zzbits);
-
-    if (likely(zzbits < 8)) {
-        *dst++ = i;
-        return dst;
-    }
-    if (likely(zzbits == 8))
-        return (uint8_t *)put_unaligned_le16((void *)dst, i);
-    return (uint8_t *)put_unaligned_le32((void *)dst, i);
-}
-
-static ALWAYS_INLINE uint8_t *
-pack_int64(uint8_t *dst, uint32_t tag, uint32_t taglen, int64_t i)
-{
-    if ((int64_t)(int32_t)i == i)
-        return pack_int32(dst, tag, taglen, i);
-    dst = pack_tag(dst, tag, taglen, IOP_WIRE_MASK(QUAD));
-    return (uint8_t *)put_unaligned_le64((uint8_t *)dst, i);
-}
-
 /* Read in a buffer the selected field of a union */
 static ALWAYS_INLINE const iop_field_t *
 get_union_field(const iop_struct_t *desc, const void *val)
@@ -363,56 +290,4 @@ get_field_by_name(const iop_struct_t *desc, const iop_field_t *start,
     return NULL;
 }
 
-static inline bool
-iop_field_is_defval(const iop_field_t *fdesc, const void *ptr, bool deep)
-{
-    assert (fdesc->repeat == IOP_R_DEFVAL);
-
-    switch (fdesc->type) {
-      case IOP_T_I8: case IOP_T_U8:
-        return *(uint8_t *)ptr == (uint8_t)fdesc->u1.defval_u64;
-      case IOP_T_I16: case IOP_T_U16:
-        return *(uint16_t *)ptr == (uint16_t)fdesc->u1.defval_u64;
-      case IOP_T_ENUM:
-        return *(int *)ptr == fdesc->u0.defval_enum;
-      case IOP_T_I32: case IOP_T_U32:
-        return *(uint32_t *)ptr == (uint32_t)fdesc->u1.defval_u64;
-      case IOP_T_I64: case IOP_T_U64:
-      case IOP_T_DOUBLE:
-        /* XXX double is handled like U64 because we want to compare them as
-         * bit to bit */
-        return *(uint64_t *)ptr == fdesc->u1.defval_u64;
-      case IOP_T_BOOL:
-        return fdesc->u1.defval_u64 ? *(bool *)ptr : !*(bool *)ptr;
-      case IOP_T_STRING:
-      case IOP_T_XML:
-      case IOP_T_DATA:
-        if (!fdesc->u0.defval_len) {
-            /* In this case we don't care about the string pointer. An empty
-             * string is an empty string whatever its pointer is. */
-            return !((lstr_t *)ptr)->len;
-        } else {
-            /* We consider a NULL string as “take the default value please”;
-             * otherwise we first check for the pointer equality and finally
-             * for the string equality. */
-            if (!((lstr_t *)ptr)->data) {
-                return true;
-            }
-            if (((lstr_t *)ptr)->len != fdesc->u0.defval_len) {
-                return false;
-            }
-            if (((lstr_t *)ptr)->data == fdesc->u1.defval_data) {
-                return true;
-            }
-            if (deep) {
-                return memcmp(((lstr_t *)ptr)->s, fdesc->u1.defval_data,
-                              fdesc->u0.defval_len) == 0;
-            }
-            return false;
-        }
-      default:
-        e_panic("unsupported");
-    }
-}
-
 #endif
@@ -0,0 +1,274 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/hash.h>
+#include <lib-common/iop.h>
+
+#include "helpers.in.c"
+
+/* The canonical copy of an interned value is allocated right after its
+ * entry, so that the entry is found back from the value. The arrays and the
+ * strings of the canonical copies are allocated separately, and their
+ * pointed sub-objects are interned values themselves. */
+typedef struct iop_intern_entry_t {
+    const iop_struct_t *st;
+    const void *v;
+    uint32_t hash;
+    int refcnt;
+    byte value[] __attribute__((aligned(8)));
+} iop_intern_entry_t;
+
+static uint32_t qhash_iop_intern_hash(const qhash_t *qh,
+                                      const iop_intern_entry_t *e)
+{
+    return e->hash;
+}
+
+static bool qhash_iop_intern_equal(const qhash_t *qh,
+                                   const iop_intern_entry_t *e1,
+                                   const iop_intern_entry_t *e2)
+{
+    return e1->hash == e2->hash && e1->st == e2->st
+        && iop_equals_desc(e1->st, e1->v, e2->v);
+}
+
+qh_kptr_t(iop_intern, iop_intern_entry_t, qhash_iop_intern_hash,
+          qhash_iop_intern_equal);
+
+struct iop_intern_t {
+    qh_t(iop_intern) entries;
+};
+
+/* {{{ Canonical copies */
+
+static void iop_intern_fields(iop_intern_t *in, const iop_struct_t *st,
+                              void *v);
+
+static void iop_intern_value(iop_intern_t *in, const iop_field_t *fdesc,
+                             void *v)
+{
+    switch (fdesc->type) {
+      case IOP_T_STRING:
+      case IOP_T_XML:
+      case IOP_T_DATA: {
+        lstr_t *s = v;
+
+        if (s->s) {
+            s->data = p_dupz(s->s, s->len);
+            s->mem_pool = MEM_STATIC;
+        }
+      } break;
+
+      case IOP_T_STRUCT:
+      case IOP_T_UNION:
+        if (iop_field_is_pointed(fdesc)) {
+            if (*(void **)v) {
+                *(const void **)v = iop_intern_desc(in, fdesc->u1.st_desc,
+                                                    *(void **)v);
+            }
+        } else {
+            iop_intern_fields(in, fdesc->u1.st_desc, v);
+        }
+        break;
+
+      default:
+        break;
+    }
+}
+
+/* Make the fields of a shallow copy own their arrays and strings, and
+ * point to interned sub-objects. */
+static void iop_intern_fields(iop_intern_t *in, const iop_struct_t *st,
+                              void *v)
+{
+    do {
+        const iop_field_t *fdesc = st->fields;
+        const iop_field_t *end = fdesc + st->fields_len;
+
+        if (st->is_union) {
+            fdesc = get_union_field(st, v);
+            end   = fdesc + 1;
+        }
+        for (; fdesc < end; fdesc++) {
+            void *ptr = (byte *)v + fdesc->data_offs;
+
+            if (fdesc->repeat == IOP_R_REPEATED) {
+                iop_array_u8_t *arr = ptr;
+                size_t sz = arr->len * fdesc->size;
+
+                if (!arr->len) {
+                    arr->tab = NULL;
+                    continue;
+                }
+                arr->tab = memcpy(p_new_raw(byte, sz), arr->tab, sz);
+                for (int i = 0; i < arr->len; i++) {
+                    iop_intern_value(in, fdesc, arr->tab + i * fdesc->size);
+                }
+            } else {
+                iop_intern_value(in, fdesc, ptr);
+            }
+        }
+    } while (iop_struct_is_class(st) && (st = st->class_attrs->parent));
+}
+
+static void iop_intern_wipe_fields(iop_intern_t *in, const iop_struct_t *st,
+                                   void *v, bool release);
+
+static void iop_intern_wipe_value(iop_intern_t *in, const iop_field_t *fdesc,
+                                  void *v, bool release)
+{
+    switch (fdesc->type) {
+      case IOP_T_STRING:
+      case IOP_T_XML:
+      case IOP_T_DATA:
+        p_delete(&((lstr_t *)v)->v);
+        break;
+
+      case IOP_T_STRUCT:
+      case IOP_T_UNION:
+        if (iop_field_is_pointed(fdesc)) {
+            if (release && *(void **)v) {
+                iop_intern_release_desc(in, fdesc->u1.st_desc,
+                                        *(void **)v);
+            }
+        } else {
+            iop_intern_wipe_fields(in, fdesc->u1.st_desc, v, release);
+        }
+        break;
+
+      default:
+        break;
+    }
+}
+
+/* Free the arrays and the strings of a canonical copy, and release its
+ * sub-objects when release is set (when the whole arena is deleted, each
+ * sub-object is freed with its own entry instead). */
+static void iop_intern_wipe_fields(iop_intern_t *in, const iop_struct_t *st,
+                                   void *v, bool release)
+{
+    do {
+        const iop_field_t *fdesc = st->fields;
+        const iop_field_t *end = fdesc + st->fields_len;
+
+        if (st->is_union) {
+            fdesc = get_union_field(st, v);
+            end   = fdesc + 1;
+        }
+        for (; fdesc < end; fdesc++) {
+            void *ptr = (byte *)v + fdesc->data_offs;
+
+            if (fdesc->repeat == IOP_R_REPEATED) {
+                iop_array_u8_t *arr = ptr;
+
+                for (int i = 0; i < arr->len; i++) {
+                    iop_intern_wipe_value(in, fdesc,
+                                          arr->tab + i * fdesc->size,
+                                          release);
+                }
+                p_delete(&arr->tab);
+            } else {
+                iop_intern_wipe_value(in, fdesc, ptr, release);
+            }
+        }
+    } while (iop_struct_is_class(st) && (st = st->class_attrs->parent));
+}
+
+/* }}} */
+/* {{{ Public API */
+
+iop_intern_t *iop_intern_new(void)
+{
+    iop_intern_t *in = p_new(iop_intern_t, 1);
+
+    qh_init(iop_intern, &in->entries);
+    return in;
+}
+
+void iop_intern_delete(iop_intern_t **inp)
+{
+    iop_intern_t *in = *inp;
+
+    if (!in) {
+        return;
+    }
+    qh_for_each_pos(iop_intern, pos, &in->entries) {
+        iop_intern_entry_t *e = in->entries.keys[pos];
+
+        iop_intern_wipe_fields(in, e->st, e->value, false);
+        p_delete(&e);
+    }
+    qh_wipe(iop_intern, &in->entries);
+    p_delete(inp);
+}
+
+const void *iop_intern_desc(iop_intern_t *in, const iop_struct_t *st,
+                            const void *v)
+{
+    iop_intern_entry_t key;
+    iop_intern_entry_t *e;
+    int pos;
+
+    if (iop_struct_is_class(st)) {
+        st = *(const iop_struct_t **)v;
+    }
+
+    key = (iop_intern_entry_t){
+        .st   = st,
+        .v    = v,
+        .hash = u64_hash32(iop_hash64(st, v, 0)),
+    };
+    pos = qh_find(iop_intern, &in->entries, &key);
+    if (pos >= 0) {
+        e = in->entries.keys[pos];
+        e->refcnt++;
+        return e->v;
+    }
+
+    e = p_new_extra(iop_intern_entry_t, st->size);
+    e->st     = st;
+    e->v      = e->value;
+    e->hash   = key.hash;
+    e->refcnt = 1;
+    memcpy(e->value, v, st->size);
+    iop_intern_fields(in, st, e->value);
+    qh_add(iop_intern, &in->entries, e);
+
+    return e->v;
+}
+
+void iop_intern_release_desc(iop_intern_t *in, const iop_struct_t *st,
+                             const void *v)
+{
+    iop_intern_entry_t *e = container_of(v, iop_intern_entry_t, value);
+
+    assert (e->v == v && e->refcnt > 0);
+    if (--e->refcnt > 0) {
+        return;
+    }
+    qh_del_key(iop_intern, &in->entries, e);
+    iop_intern_wipe_fields(in, e->st, e->value, true);
+    p_delete(&e);
+}
+
+int iop_intern_get_count(const iop_intern_t *in)
+{
+    return qh_len(iop_intern, &in->entries);
+}
+
+/* }}} */
@@ -340,6 +340,28 @@ typedef struct iop_snmp_attrs_t {
     uint16_t            type;   /**< iop_type_t                             */
 } iop_snmp_attrs_t;
 
+/* Specialized binary (un)packers of a struct
+ *
+ * iopc generates them with --c-codecs for the structs that only have scalar
+ * and string fields, the generic (un)packer dispatches to them.
+ */
+typedef struct iop_struct_codec_t {
+    /** Get the packed size of the struct, for the given packing flags. */
+    int (*nonnull bpack_size)(const void * nonnull val, unsigned flags);
+    /** Pack the struct, with the flags given to bpack_size. */
+    uint8_t * nonnull (*nonnull bpack)(uint8_t * nonnull dst,
+                                       const void * nonnull val,
+                                       unsigned flags);
+    /** Unpack the struct.
+     *
+     * \return 0 on success, 1 if the stream is not in the form written by
+     *         the packer (unknown tags, other wire types, errors, ...), the
+     *         generic unpacker has then to be used.
+     */
+    int (*nonnull bunpack)(mem_pool_t * nonnull mp, void * nonnull val,
+                           pstream_t ps, unsigned flags);
+} iop_struct_codec_t;
+
 struct iop_struct_t {
     const lstr_t        fullname;
     const iop_field_t  * nonnull fields;
@@ -361,6 +383,9 @@ struct iop_struct_t {
          * iop_struct_is_snmp_obj(this) first */
         const iop_snmp_attrs_t * nullable snmp_attrs;
     };
+    /* XXX do not dereference the following member without checking
+     * TST_BIT(this->flags, IOP_STRUCT_HAS_CODEC) first */
+    const iop_struct_codec_t * nullable codec;
 };
 
 enum iop_struct_flags_t {
@@ -372,6 +397,7 @@ enum iop_struct_flags_t {
     IOP_STRUCT_IS_SNMP_OBJ,     /**< is it a snmpObj? */
     IOP_STRUCT_IS_SNMP_TBL,     /**< is it a snmpTbl? */
     IOP_STRUCT_IS_SNMP_PARAM,   /**< does it have @snmpParam? */
+    IOP_STRUCT_HAS_CODEC,       /**< codec exists */
 };
 
 /*}}}*/
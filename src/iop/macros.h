@@ -653,11 +653,7 @@
     qhash_iop_hash_fn(name, pfx)(const qhash_t * nullable qhash,             \
                                  const pfx##__t * nonnull key)               \
     {                                                                        \
-        uint8_t hash[4];                                                     \
-                                                                             \
-        iop_hash32(&pfx##__s, key, hash, 0);                                 \
-                                                                             \
-        return get_unaligned_cpu32(hash);                                    \
+        return u64_hash32(iop_hash64(&pfx##__s, key, 0));                    \
     }                                                                        \
     static inline bool                                                       \
     qhash_iop_equals_fn(name, pfx)(const qhash_t * nullable qhash,           \
@@ -67,6 +67,15 @@ void iop_env_get(iop_env_t *env);
 const iop_pkg_t *iop_get_pkg_env(lstr_t pkgname, const iop_env_t *env);
 int iop_check_registered_classes(const iop_env_t *env, sb_t *err);
 
+/** Same as iop_check_registered_classes() restricted to \p classes.
+ *
+ * This is enough when the environment was valid before \p classes were
+ * registered in it.
+ */
+int iop_check_registered_classes_tab(const iop_env_t *env,
+                                     const iop_struct_t *const *classes,
+                                     int len, sb_t *err);
+
 iop_dso_t *iop_dso_get_from_pkg(const iop_pkg_t *pkg);
 
 int iop_register_packages_env(const iop_pkg_t **pkgs, int len,
@@ -93,6 +102,16 @@ static inline size_t iop_int_type_size(iop_type_t type)
     return 1 << (type >> 1);
 }
 
+/* }}} */
+/* {{{ Multi-threading */
+
+/** Tell whether an array of n structs, unions or classes is big enough to
+ * be (un)packed in thread jobs (see iop_bpack_set_threaded_threshold). */
+bool iop_array_is_threadable(size_t n);
+
+/** Number of thread jobs to use to (un)pack an array of n elements. */
+int iop_array_get_chunk_count(size_t n);
+
 /* }}} */
 
 #endif
@@ -63,7 +63,7 @@
  * of four bytes in little endian.
  *
  *     Flags   8 bits reserved for Flags. Defined flags      +-+-+-+-+-+-+-+-+
- *             are:                                          |  0  | D |C|B|A|
+ *             are:                                          |0|S|E| D |C|B|A|
  *               - A (IC_MSG_HAS_FD): the IC embed a         +-+-+-+-+-+-+-+-+
  *                 file descriptor (Unix sockets only),
  *               - B (IC_MSG_HAS_HDR): the payload starts with an IC header,
@@ -72,6 +72,12 @@
  *                 priority (in the sense of EV_PRIORITY) are sent first; this
  *                 field propagate the priority such that high priority
  *                 responses are also sent first (but not parsed first).
+ *               - E (IC_MSG_IS_COMPRESSED): the payload is compressed, see
+ *                 1.6; it is only sent to the peers that announced they can
+ *                 read compressed messages (see 1.5.3).
+ *               - S (IC_MSG_STREAM): the query accepts a streamed reply, see
+ *                 1.7; it is only sent to the peers that announced they can
+ *                 stream their replies (see 1.5.3).
  *
  *     Reserved  Depends on the Command.
  *
@@ -185,7 +191,7 @@
  * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
  * |                        Data length = 2                        |
  * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
- * |          Version = 1          |T|          Reserved           | } 2x16LE
+ * |          Version = 1          |T|Z|S|        Reserved         | } 2x16LE
  * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
  *
  * This MUST be the very first message sent by both the server and the
@@ -202,8 +208,50 @@
  *             require TLS, then both peers proceed to the TLS handshake (or
  *             close the connection).
  *
+ *     Z       Indicate that the peer can read compressed messages (see 1.6).
+ *
+ *     S       Indicate that the peer can stream its replies (see 1.7).
+ *
  *     Reserved  MUST be set to 0, reserved for future use.
  *
+ * 1.6  Compressed payload
+ * -----------------------
+ *
+ * When E (IC_MSG_IS_COMPRESSED) is set, the payload is replaced by:
+ *
+ *  0                   1                   2                   3
+ *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |0|                    Uncompressed length                      | } 32LE
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * | LZO1X stream...
+ * +-+-+-+-+-+-+-
+ *
+ * and Data length is the length of this compressed payload. Only the
+ * payloads of at least compress_threshold bytes that shrink are compressed.
+ *
+ * 1.7  Streamed replies
+ * ---------------------
+ *
+ * The server can answer a query that has the S flag with a sequence of
+ * reply messages with the IC_MSG_PARTIAL status, each one carrying a chunk
+ * of the result (with the type of the result of the RPC), followed by a
+ * regular reply that ends the query.
+ *
+ * The chunks are flow-controlled by credits: the server starts with
+ * IC_STREAM_CREDITS credits for each streamed query and MUST NOT send a
+ * chunk without a credit. The client grants the credits of the chunks it
+ * processed with IC_SC_STREAM_CREDIT stream control messages, whose payload
+ * is:
+ *
+ *  0                   1                   2                   3
+ *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |                        Slot of the query                      | } 32LE
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |                        Granted credits                        | } 32LE
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *
  * 2  IChannel connection establishment
  * ====================================
  *
@@ -234,6 +282,27 @@
  * that you may use either SOCK_STREAM or SOCK_SEQPACKETS (the latter may be
  * used to send file descriptors).
  *
+ * 2.3 Shared-memory rings
+ * -----------------------
+ *
+ * Once a Unix ichannel is connected, each peer creates a ring of
+ * shm_ring_size bytes in a memfd and sends it with an IC_SC_SHM stream
+ * control message, whose payload is the 32LE size of the ring. All the
+ * messages sent after this one are copied into the ring instead of being
+ * written on the socket, except:
+ *  - the messages with a file descriptor and the ones larger than a quarter
+ *    of the ring. They still go through the socket, but a placeholder
+ *    record is put in the ring first so that the receiver keeps the order
+ *    of the messages;
+ *  - the IC_SC_SHM_KICK stream control messages, without payload, sent on
+ *    the socket to wake the peer up: by the writer when the reader of the
+ *    ring sleeps, and by the reader when it made room in a ring whose
+ *    writer waits.
+ *
+ * The records of a ring are IC messages (header and payload) aligned on 16
+ * bytes. A record never wraps: the end of the ring is skipped with a
+ * padding record.
+ *
  * 3  Extensibility
  * ================
  *
@@ -283,7 +352,9 @@
 #else
 #define IS_LIB_COMMON_IOP_RPC_CHANNEL_H
 
+#include <lib-common/container-dlist.h>
 #include <lib-common/container-htlist.h>
+#include <lib-common/el-fiber.h>
 #include <openssl/ssl.h>
 
 #if 0
@@ -321,8 +392,22 @@ typedef enum ic_event_t {
 #define IC_MSG_PRIORITY_SHIFT   27
 #define IC_MSG_PRIORITY_MASK    (BITMASK_LT(uint32_t,                        \
                                             2) << IC_MSG_PRIORITY_SHIFT)
+#define IC_MSG_IS_COMPRESSED    (1U << 29)
+#define IC_MSG_STREAM           (1U << 30)
+
+#define IC_SC_VERSION_TLS       (1U << 15)
+#define IC_SC_VERSION_COMPRESS  (1U << 14)
+#define IC_SC_VERSION_STREAM    (1U << 13)
+
+/* Credits of a streamed query before the client grants more, see 1.7. */
+#define IC_STREAM_CREDITS       16
+
+/* The compression of the replies with payloads of at least this many bytes
+ * runs in a thread. */
+#define IC_COMPRESS_JOB_MIN     (1 << 20)
 
-#define IC_SC_VERSION_TLS  (1U << 15)
+/* Default size of the shared-memory rings of the Unix ichannels. */
+#define IC_SHM_RING_SIZE        (1 << 20)
 
 #define IC_PROXY_MAGIC_CB       ((ic_msg_cb_f *)-1)
 
@@ -364,6 +449,13 @@ struct ic_msg_t {
     bool          trace      :  1; /**< Activate tracing for this message. */
     bool          canceled   :  1; /**< Is the query canceled ? */
     ev_priority_t priority   :  2; /**< Priority of the message. */
+    bool          stream     :  1; /**< accept a streamed answer: the
+                                        callback is called with
+                                        IC_MSG_PARTIAL for each chunk of the
+                                        result before the final answer. */
+    bool          trace_hdr  :  1; /**< private: the packed query has a
+                                        header carrying the trace context
+                                        though hdr is NULL */
     int32_t  cmd;                  /**< automatically filled by ic_query/reply
                                         */
     uint32_t slot;                 /**< automatically filled by ic_query/reply
@@ -371,6 +463,8 @@ struct ic_msg_t {
     uint32_t timeout;              /**< max lifetime of the query */
     ichannel_t * nullable ic;      /**< the ichannel_t used for the query */
     el_t nullable timeout_timer;
+    void * nullable group_query;   /**< private field used by ic_group_t */
+    int      stream_unacked;       /**< private: chunks not yet credited */
     unsigned dlen;
     void    * nullable data;
     pstream_t raw_res;
@@ -440,7 +534,29 @@ ic_msg_t * nonnull ic_msg_set_timeout(ic_msg_t * nonnull msg,
 ic_msg_t * nonnull ic_msg_set_priority(ic_msg_t * nonnull msg,
                                        ev_priority_t priority);
 
-qm_k32_t(ic_msg, ic_msg_t * nonnull);
+/* Table of pending objects indexed by their slots, used for the queries
+ * waiting for an answer and for the ichannels ids.
+ *
+ * A slot is the index of its entry in the table plus a multiple of the size
+ * of the table, increased each time the entry is reused: matching a slot is
+ * a single indexed load, without hashing, and a late answer to a reused
+ * entry does not match. The free entries are reused in FIFO order so that a
+ * slot comes back as late as possible.
+ */
+typedef struct ic_slot_t {
+    void * nullable ptr;
+    uint32_t slot;      /**< slot of ptr, or last slot of a free entry */
+    uint32_t next_free;
+} ic_slot_t;
+
+typedef struct ic_slots_t {
+    ic_slot_t * nullable tab;
+    uint32_t size;      /**< size of the table, a power of 2 */
+    uint32_t len;       /**< number of used entries */
+    uint32_t mask;      /**< mask of the valid slots, 2^n - 1 */
+    uint32_t free_head;
+    uint32_t free_tail;
+} ic_slots_t;
 
 struct ic_hook_ctx_t {
     uint64_t         slot;
@@ -481,9 +597,45 @@ typedef ic_dynproxy_t (ic_dynproxy_f)(ic__hdr__t * nullable hdr,
 #define IC_DYNPROXY_HDR(_ic, _hdr) \
     ((ic_dynproxy_t){ .ic = (_ic), .hdr = (_hdr) })
 
+/** Generic attribute of the RPCs to implement in the thread jobs workers.
+ *
+ * The queries of an RPC with the attribute `@(ic:worker, true)` are unpacked
+ * by the thread of the channel, then handed by batches to the thr_job
+ * workers, so that the CPU-heavy implementations do not stall the event
+ * loop. The replies are packed by the workers and queued back by the thread
+ * of the channel once per loop iteration.
+ *
+ * Such an implementation runs concurrently with the event loop, so:
+ *  - it must reply with ic_reply() or ic_throw() before returning, the
+ *    other queries are answered with IC_MSG_SERVER_ERROR;
+ *  - it must not use the ichannel, but to reply.
+ *
+ * The RPCs with hooks and the queries of the local channels are run by the
+ * thread of the channel anyway.
+ */
+#define IC_WORKER_ATTR  "ic:worker"
+
+/** Tell whether the RPC has the IC_WORKER_ATTR attribute. */
+bool ic_rpc_in_worker(const iop_iface_t * nonnull iface,
+                      const iop_rpc_t * nonnull rpc);
+
+/** Metrics of an RPC implemented locally, see ic_rpcs_stats(). */
+typedef struct ic_rpc_metrics_t ic_rpc_metrics_t;
+
+/** Get the metrics of an RPC, creating them the first time.
+ *
+ * The metrics are never destroyed, so ic_register() resolves them once for
+ * all the queries of the RPC.
+ */
+ic_rpc_metrics_t * nonnull ic_rpc_metrics(const iop_iface_t * nonnull iface,
+                                          const iop_rpc_t * nonnull rpc);
+
 typedef struct ic_cb_entry_t {
     ic_cb_entry_type_t cb_type;
     const iop_rpc_t * nonnull rpc;
+    /** Run the implementation in the workers, see IC_WORKER_ATTR. */
+    bool in_worker;
+    ic_rpc_metrics_t * nullable metrics;
 
     ic_pre_hook_f  * nullable pre_hook;
     ic_post_hook_f * nullable post_hook;
@@ -535,6 +687,27 @@ typedef struct ic_cb_entry_t {
 qm_k32_t(ic_cbs, ic_cb_entry_t);
 extern qm_t(ic_cbs) const ic_no_impl;
 
+/** Compression statistics of an ichannel, see compress_threshold. */
+typedef struct ic_compress_stats_t {
+    uint64_t tx_msgs;   /**< number of compressed messages sent */
+    uint64_t tx_raw;    /**< their payload bytes before compression */
+    uint64_t tx_bytes;  /**< their payload bytes after compression */
+    uint64_t tx_cpu_us; /**< CPU time spent compressing (µs), including
+                             the payloads that did not shrink */
+    uint64_t rx_msgs;   /**< number of compressed messages received */
+    uint64_t rx_raw;    /**< their payload bytes after decompression */
+    uint64_t rx_bytes;  /**< their payload bytes before decompression */
+    uint64_t rx_cpu_us; /**< CPU time spent decompressing (µs) */
+} ic_compress_stats_t;
+
+/** Write statistics of an ichannel, msgs / calls is the number of messages
+ * per system call. */
+typedef struct ic_write_stats_t {
+    uint64_t calls;     /**< number of writes on the socket */
+    uint64_t msgs;      /**< number of messages written on the socket */
+    uint64_t bytes;     /**< number of bytes written on the socket */
+} ic_write_stats_t;
+
 struct ichannel_t {
     uint32_t id;
 
@@ -594,8 +767,10 @@ struct ichannel_t {
     bool hdr_checked  :  1;   /**< read checks are successful */
     bool tls_required :  1;   /**< ignored on non TCP sockets */
     bool is_connected :  1;   /**< true if handshakes are completed */
-
-    unsigned nextslot;          /**< next slot id to try                    */
+    bool peer_compress : 1;   /**< the peer reads compressed messages */
+    bool peer_stream  :  1;   /**< the peer streams its replies */
+    bool shm_tx_on    :  1;   /**< the messages go in the shm_tx ring */
+    bool shm_kick     :  1;   /**< an IC_SC_SHM_KICK must be sent */
 
     el_t              nullable elh;
     el_t              nullable timer;
@@ -621,9 +796,30 @@ struct ichannel_t {
     ic_hook_f   * nonnull on_event;
     ic_creds_f  * nullable on_creds;
     void        (* nullable on_wipe)(ichannel_t * nonnull ic);
+    net_tbucket_t * nullable admission;
+                               /**< admission filter of the incoming
+                                * queries, that are answered with
+                                * IC_MSG_RETRY when the bucket is empty. It
+                                * can be nested under a bucket shared by all
+                                * the channels, see net_tbucket_init().
+                                */
+    int compress_threshold;    /**< compress the payloads of at least this
+                                * many bytes with LZO when the peer can read
+                                * them (TCP ichannels only), 0 to never
+                                * compress.
+                                */
+    ic_compress_stats_t compress_stats;
+    ic_write_stats_t    write_stats;
+    int shm_ring_size;         /**< size of the shared-memory rings used to
+                                * exchange the messages with a peer on the
+                                * same host (Unix ichannels only, see 2.3),
+                                * rounded up to a power of 2;
+                                * IC_SHM_RING_SIZE by default, 0 to only
+                                * use the socket.
+                                */
 
     /* private */
-    qm_t(ic_msg) queries;      /**< hash of queries waiting for an answer  */
+    ic_slots_t   queries;      /**< queries waiting for an answer          */
     htlist_t     iov_list;     /**< list of messages to send, in iov       */
     htlist_t     msg_list;     /**< list of messages to send               */
     htnode_t    * nullable last_normal_prio_msg;
@@ -641,6 +837,19 @@ struct ichannel_t {
     int pending;    /**< number of pending queries (for peak warning)       */
     int queue_len;  /**< length of the query queue, without canceled        */
     SSL * nullable ssl; /**< TLS context, if any. */
+    struct ic_shm_t * nullable shm_tx; /**< ring of the sent messages */
+    struct ic_shm_t * nullable shm_rx; /**< ring of the received messages */
+
+    /* Write coalescing: the messages queued on a connected channel are
+     * written once before the event loop sleeps, or as soon as IC_PKT_MAX
+     * bytes are queued. */
+    dlist_t dirty_link; /**< link in the list of the channels to flush    */
+    int     wqueued;    /**< bytes queued since the last write            */
+
+    /** start of the queries being processed, see ic_rpcs_stats() */
+    struct ic_rpc_queries_t * nullable rpc_queries;
+    /** credits of the streamed replies being sent, see ic_reply_chunk() */
+    struct ic_streams_t * nullable streams;
 
     /* Buffers */
     qv_t(i32)    fds;
@@ -731,6 +940,100 @@ static inline bool ic_slot_is_async(uint64_t slot) {
 void ic_watch_activity(ichannel_t * nonnull ic, int timeout_soft,
                        int timeout_hard);
 
+/** Adaptive concurrency limit of the queries of an interface.
+ *
+ * The synchronous queries of a limited interface that would exceed its
+ * limit of queries being processed are answered at once with IC_MSG_RETRY,
+ * before their payload is unpacked, so that a saturated server sheds the
+ * load cheaply instead of queueing it until the clients time out.
+ *
+ * The limit adapts to the processing latency of the queries, the way of
+ * the gradient algorithms of TCP Vegas: it grows while the latency of the
+ * last queries stays close to its long-term average, and it shrinks when
+ * the latency rises because the queries queue up.
+ *
+ * The interfaces are identified by their tag, so the interfaces of the
+ * different modules served by a process with the same tag share their
+ * limit.
+ */
+typedef struct ic_limit_cfg_t {
+    int    min_limit;     /**< 1 if 0 */
+    int    max_limit;     /**< 1000 if 0 */
+    int    initial_limit; /**< 20 if 0 */
+    /** Increase of the limit allowed at each update, 4 if 0. */
+    int    queue_size;
+    /** Tolerated ratio of the recent latency to the long-term one before
+     * the limit shrinks, 1.5 if 0. */
+    double tolerance;
+} ic_limit_cfg_t;
+
+typedef struct ic_limit_stats_t {
+    lstr_t   name;
+    int      limit;
+    int      inflight;
+    uint64_t accepted;
+    uint64_t rejected;
+} ic_limit_stats_t;
+
+/** Limit the concurrency of the queries of an interface.
+ *
+ * \param[in]  iface_tag  the tag of the interface in its module.
+ * \param[in]  name       the name of the interface in the statistics.
+ * \param[in]  cfg        the configuration, NULL for the defaults.
+ */
+void ic_limit_iface(uint16_t iface_tag, lstr_t name,
+                    const ic_limit_cfg_t * nullable cfg);
+#define ic_limit_register(_mod, _if, cfg) \
+    ic_limit_iface(_mod##__##_if##__TAG, LSTR(#_mod "." #_if), (cfg))
+
+/** Remove the limit of an interface. */
+void ic_unlimit_iface(uint16_t iface_tag);
+#define ic_limit_unregister(_mod, _if) \
+    ic_unlimit_iface(_mod##__##_if##__TAG)
+
+/** Call \p cb with the statistics of each limited interface. */
+void ic_limits_stats(void (* nonnull cb)(const ic_limit_stats_t * nonnull,
+                                         void * nullable),
+                     void * nullable priv);
+
+/** Number of buckets of the histograms of the RPCs.
+ *
+ * The bucket i counts the values lower than 2^i (and not lower than
+ * 2^(i - 1)), in microseconds for the latencies and in bytes for the sizes;
+ * the last one counts the values that don't fit in the others.
+ */
+#define IC_RPC_STATS_BUCKETS  28
+
+/** Statistics of an RPC implemented locally.
+ *
+ * The queries are accounted from their reception to their reply, on the
+ * channels that are not local. The asynchronous queries are only counted in
+ * the query sizes and as IC_MSG_OK.
+ */
+typedef struct ic_rpc_stats_t {
+    lstr_t   iface;
+    lstr_t   rpc;
+    /** number of queries being processed */
+    int64_t  inflight;
+    /** number of replies of each status */
+    uint64_t statuses[IC_MSG_CANCELED + 1];
+    /** cumulated latency in microseconds, and sizes in bytes */
+    uint64_t latency_sum;
+    uint64_t query_size_sum;
+    uint64_t reply_size_sum;
+    uint64_t latency_hist[IC_RPC_STATS_BUCKETS];
+    uint64_t query_size_hist[IC_RPC_STATS_BUCKETS];
+    uint64_t reply_size_hist[IC_RPC_STATS_BUCKETS];
+} ic_rpc_stats_t;
+
+/** Call \p cb on the statistics of every RPC registered with ic_register().
+ *
+ * The statistics are cumulated since the creation of the metrics.
+ */
+void ic_rpcs_stats(void (* nonnull cb)(const ic_rpc_stats_t * nonnull,
+                                       void * nullable),
+                   void * nullable priv);
+
 ev_priority_t ic_set_priority(ichannel_t * nonnull ic, ev_priority_t prio);
 ichannel_t * nullable ic_get_by_id(uint32_t id);
 ichannel_t * nonnull ic_init(ichannel_t * nonnull);
@@ -997,6 +1300,10 @@ void ic_mark_disconnected(ichannel_t * nonnull ic);
         ic_cb_entry_t e = {                                                  \
             .cb_type = IC_CB_NORMAL,                                         \
             .rpc = IOP_RPC(_mod, _if, _rpc),                                 \
+            .in_worker = ic_rpc_in_worker(IOP_IFACE(_mod, _if),              \
+                                          IOP_RPC(_mod, _if, _rpc)),         \
+            .metrics = ic_rpc_metrics(IOP_IFACE(_mod, _if),                  \
+                                      IOP_RPC(_mod, _if, _rpc)),             \
             .pre_hook = _pre_cb,                                             \
             .post_hook = _post_cb,                                           \
             .pre_hook_args = _pre_arg,                                       \
@@ -1355,6 +1662,56 @@ size_t __ic_reply(ichannel_t * nullable, uint64_t slot, int cmd, int fd,
  */
 void ic_reply_err(ichannel_t * nullable ic, uint64_t slot, int err);
 
+/* Streamed replies
+ * ~~~~~~~~~~~~~~~~
+ *
+ * A query sent with msg->stream set to a peer that can stream its replies
+ * can be answered by chunks: the implementation sends each chunk of the
+ * result with ic_reply_chunk(), then ends the query with a regular reply
+ * (ic_reply(), ic_throw() or ic_reply_err()). The callback of the query is
+ * called with IC_MSG_PARTIAL and the chunk as result for each chunk, then
+ * once more with the final status.
+ *
+ * Each chunk is packed and freed on its own, and the chunks are
+ * flow-controlled (see 1.7): at most IC_STREAM_CREDITS chunks are on the
+ * way, the client granting more credits as the chunks are processed. So the
+ * memory of both sides stays bounded, and the client can process the first
+ * chunks while the next ones are built.
+ */
+
+/** Tell whether the query accepts a streamed reply. */
+static inline bool ic_slot_can_stream(uint64_t slot)
+{
+    return slot & IC_MSG_STREAM;
+}
+
+/** Callback called when the client granted credits to a streamed reply.
+ *
+ * It is called with a NULL ichannel and negative credits when the query
+ * can no longer be answered (the channel was disconnected).
+ */
+typedef void (ic_stream_cb_f)(ichannel_t * nullable ic, uint64_t slot,
+                              int credits, void * nullable priv);
+
+/** Watch the credits of a streamed reply.
+ *
+ * \param[in]  ic    the #ichannel_t of the query, #NULL if the reply is
+ *                   asynchronous.
+ * \param[in]  slot  the slot of the query.
+ * \param[in]  cb    called each time credits are granted, until the query
+ *                   is answered.
+ *
+ * \return the credits left, -1 if the query does not accept a streamed
+ *         reply.
+ */
+int ic_stream_watch(ichannel_t * nullable ic, uint64_t slot,
+                    ic_stream_cb_f * nullable cb, void * nullable priv);
+
+/** \brief internal do not use directly, or know what you're doing. */
+int __ic_reply_chunk(ichannel_t * nullable ic, uint64_t slot,
+                     const iop_struct_t * nonnull st,
+                     const void * nonnull arg);
+
 /** \brief helper to set ctx and execute the pre hook of the query.
  *
  * \param[in]     ic   the #ichannel_t to send the query to.
@@ -1484,6 +1841,7 @@ bool __ic_rpc_is_traced(const iop_iface_t * nonnull iface,
         __msg->async      = __msg_src->async;                               \
         __msg->cmd        = __msg_src->cmd;                                 \
         __msg->trace      = __msg_src->trace;                               \
+        __msg->trace_hdr  = __msg_src->trace_hdr;                           \
         __msg->force_pack = true;                                           \
         __ic_msg_build_from(__msg, __msg_src);                              \
         __msg;                                                              \
@@ -1560,6 +1918,205 @@ bool __ic_rpc_is_traced(const iop_iface_t * nonnull iface,
             IOP_RPC_CB_REF(_mod, _if, _rpc), _mod, _if, _rpc, v)); \
     })
 
+/*----- groups of ichannels -----*/
+
+/* Groups of ichannels
+ * ~~~~~~~~~~~~~~~~~~~
+ *
+ * A group spreads the queries over ichannels connected to replicas of the
+ * same service, so that the callers do not have to choose a channel and to
+ * handle the failover themselves. The channels are created, connected and
+ * reconnected by the caller as usual, the group only references them.
+ *
+ * Each query goes to the best of two channels picked at random among the
+ * ready ones (the "power of two choices"), the best being the one with the
+ * lowest pending queries count weighted by its latency EWMA.
+ *
+ * A channel whose queries fail several times in a row (the exceptions are
+ * answers, not failures), or whose latency is much higher than the one of
+ * the fastest channel, is ejected from the group for a while, longer each
+ * time it is ejected again. At most half of the channels are ejected.
+ *
+ * The idempotent queries can be hedged: when the answer did not come after
+ * a delay, the query is sent again to another channel and the first answer
+ * wins, the other query is canceled. The latency of an overloaded replica
+ * then has a lower impact on the tail latency of the queries.
+ */
+
+typedef struct ic_group_t ic_group_t;
+
+typedef struct ic_group_cfg_t {
+    /** Consecutive failures ejecting a channel, 5 if 0. */
+    int     eject_errors;
+    /** Ratio of the latency of a channel to the latency of the fastest one
+     * ejecting it, 4 if 0; a negative value disables it. */
+    double  eject_slow_ratio;
+    /** Base duration of the ejections in ms, 10s if 0. */
+    int     eject_time;
+    /** Delay before hedging a query in ms; twice the latency EWMA of the
+     * channel of the query if 0. */
+    int     hedge_delay;
+} ic_group_cfg_t;
+
+typedef struct ic_group_stats_t {
+    uint64_t queries;
+    uint64_t failures;
+    uint64_t hedged;
+    /** Hedges whose answer came first. */
+    uint64_t hedge_wins;
+    uint32_t ejections;
+    /** Latency EWMA in µs. */
+    int64_t  latency;
+    bool     ejected;
+} ic_group_stats_t;
+
+/** Create a group of ichannels.
+ *
+ * \param[in]  cfg  the configuration of the group, NULL for the defaults.
+ */
+ic_group_t * nonnull ic_group_new(const ic_group_cfg_t * nullable cfg);
+
+/** Delete a group.
+ *
+ * The pending queries go on, the group is destroyed once they are done.
+ */
+void ic_group_delete(ic_group_t * nullable * nonnull g);
+
+/** Add a channel to a group, it must stay valid until it is removed. */
+void ic_group_add(ic_group_t * nonnull g, ichannel_t * nonnull ic);
+
+/** Remove a channel from a group, its pending queries go on. */
+void ic_group_remove(ic_group_t * nonnull g, ichannel_t * nonnull ic);
+
+/** Choose the channel of the next query.
+ *
+ * \return the chosen channel, NULL if no channel of the group is ready.
+ */
+ichannel_t * nullable ic_group_pick(ic_group_t * nonnull g);
+
+/** Get the statistics of a channel of a group.
+ *
+ * \return -1 if the channel is not in the group.
+ */
+int ic_group_get_stats(const ic_group_t * nonnull g,
+                       const ichannel_t * nonnull ic,
+                       ic_group_stats_t * nonnull stats);
+
+/** \brief internal do not use directly, or know what you're doing. */
+void __ic_group_query(ic_group_t * nonnull g, ichannel_t * nonnull ic,
+                      ic_msg_t * nonnull msg, bool hedge);
+
+#define __ic_group_query_p(_g, _msg, _hedge, _cb, _mod, _if, _rpc, v) \
+    ({  ic_group_t *_grp = (_g);                                            \
+        ichannel_t *_gic = ic_group_pick(_grp);                             \
+        bool _hdg = (_hedge);                                               \
+                                                                            \
+        if (_gic) {                                                         \
+            ic_msg_t *_gmsg = (_msg);                                       \
+                                                                            \
+            /* the hedged queries are packed to be duplicated */            \
+            _gmsg->force_pack |= _hdg;                                      \
+            __ic_group_query(_grp, _gic,                                    \
+                             ic_build_query_p(_gic, _gmsg, _cb, _mod, _if,  \
+                                              _rpc, v), _hdg);              \
+        }                                                                   \
+        _gic ? 0 : -1;                                                      \
+    })
+
+/** \brief helper to send a query to a group of ichannels.
+ *
+ * \param[in]  _g     the #ic_group_t to send the query to.
+ * \param[in]  _msg   the #ic_msg_t to fill, evaluated only when a channel
+ *                    is ready.
+ * \param[in]  _cb    the rpc reply callback to use, called with the channel
+ *                    that answered.
+ * \param[in]  _mod   name of the package+module of the RPC
+ * \param[in]  _if    name of the interface of the RPC
+ * \param[in]  _rpc   name of the rpc
+ * \param[in]  v      a <tt>${_mod}__${_if}__${_rpc}_args__t *</tt> value.
+ *
+ * \return -1 if no channel of the group is ready, the message is then left
+ *         to the caller.
+ */
+#define ic_group_query_p(_g, _msg, _cb, _mod, _if, _rpc, v) \
+    __ic_group_query_p(_g, _msg, false, _cb, _mod, _if, _rpc, v)
+
+/** \brief helper to send a query to a group of ichannels.
+ *
+ * \see ic_group_query_p
+ */
+#define ic_group_query(_g, _msg, _cb, _mod, _if, _rpc, ...) \
+    ({  const IOP_RPC_T(_mod, _if, _rpc, args) *_gv =                       \
+            &((IOP_RPC_T(_mod, _if, _rpc, args)){ __VA_ARGS__ });           \
+                                                                            \
+        ic_group_query_p(_g, _msg, _cb, _mod, _if, _rpc, _gv);              \
+    })
+
+/** \brief helper to send a hedged query to a group of ichannels.
+ *
+ * The RPC must be idempotent: it can be run by two replicas.
+ *
+ * \see ic_group_query_p
+ */
+#define ic_group_query_hedged_p(_g, _msg, _cb, _mod, _if, _rpc, v) \
+    __ic_group_query_p(_g, _msg, true, _cb, _mod, _if, _rpc, v)
+
+/** \brief helper to send a hedged query to a group of ichannels.
+ *
+ * \see ic_group_query_hedged_p
+ */
+#define ic_group_query_hedged(_g, _msg, _cb, _mod, _if, _rpc, ...) \
+    ({  const IOP_RPC_T(_mod, _if, _rpc, args) *_gv =                       \
+            &((IOP_RPC_T(_mod, _if, _rpc, args)){ __VA_ARGS__ });           \
+                                                                            \
+        ic_group_query_hedged_p(_g, _msg, _cb, _mod, _if, _rpc, _gv);       \
+    })
+
+/** Answer of a query sent by ic_fiber_query(). */
+typedef struct ic_fiber_wait_t {
+    el_fiber_t  * nullable fiber;
+    mem_pool_t  * nullable mp;
+    ic_status_t status;
+    bool        done;
+    void        * nullable res;
+} ic_fiber_wait_t;
+
+void ic_fiber_query_cb(ichannel_t * nonnull ic, ic_msg_t * nonnull msg,
+                       ic_status_t status, void * nullable res,
+                       void * nullable exn);
+ic_status_t __ic_fiber_wait(ic_fiber_wait_t * nonnull w,
+                            void * nullable * nullable res);
+
+/** \brief helper to send a query from a fiber and wait for its answer.
+ *
+ * The fiber is suspended until the answer is received, the event loop
+ * running in the meantime (\see el_fiber_spawn).
+ *
+ * \param[in]  _ic    the #ichannel_t to send the query to.
+ * \param[in]  _mp    the memory pool used to duplicate the answer.
+ * \param[out] _res   a <tt>void **</tt> set to the result when the status
+ *                    is #IC_MSG_OK, to the exception when it is
+ *                    #IC_MSG_EXN, and to NULL otherwise. Can be NULL.
+ * \param[in]  _mod   name of the package+module of the RPC
+ * \param[in]  _if    name of the interface of the RPC
+ * \param[in]  _rpc   name of the rpc
+ * \param[in]  ...
+ *   the initializers of the value on the form <tt>.field = value</tt>
+ * \return the status of the answer.
+ */
+#define ic_fiber_query(_ic, _mp, _res, _mod, _if, _rpc, ...) \
+    ({  ichannel_t *_ich = (_ic);                                            \
+        const IOP_RPC_T(_mod, _if, _rpc, args) *_v =                         \
+            &((IOP_RPC_T(_mod, _if, _rpc, args)){ __VA_ARGS__ });            \
+        ic_fiber_wait_t _w = { .mp = (_mp) };                                \
+        ic_msg_t *_m = ic_msg(ic_fiber_wait_t *, &_w);                       \
+                                                                             \
+        ic_build_query_p(_ich, _m, NULL, _mod, _if, _rpc, _v);               \
+        _m->cb = &ic_fiber_query_cb;                                         \
+        __ic_query(_ich, _m);                                                \
+        __ic_fiber_wait(&_w, (_res));                                        \
+    })
+
 /** \brief helper to send a query to a given ic.
  *
  * Same as #ic_query but waits for the query to be sent before the call
@@ -1685,6 +2242,27 @@ bool __ic_rpc_is_traced(const iop_iface_t * nonnull iface,
     ic_reply_p(ic, slot, _mod, _if, _rpc,                                   \
                (&(IOP_RPC_T(_mod, _if, _rpc, res)){ __VA_ARGS__ }))
 
+/** \brief helper to send a chunk of a streamed reply (server-side).
+ *
+ * \param[in]  ic
+ *   the #ichannel_t of the query, #NULL if the reply is asynchronous.
+ * \param[in]  slot   the slot of the query we're answering to.
+ * \param[in]  _mod   name of the package+module of the RPC
+ * \param[in]  _if    name of the interface of the RPC
+ * \param[in]  _rpc   name of the rpc
+ * \param[in]  v      a <tt>${_mod}__${_if}__${_rpc}_res__t *</tt> value.
+ *
+ * \return the credits left, -1 if the chunk was not sent because no credit
+ *         is left or the query does not accept a streamed reply.
+ */
+#define ic_reply_chunk_p(ic, slot, _mod, _if, _rpc, v) \
+    ({  const IOP_RPC_T(_mod, _if, _rpc, res) *__v = (v);                   \
+        STATIC_ASSERT(_mod##__##_if(_rpc##__rpc__async) == 0);              \
+        __ic_reply_chunk(ic, slot, IOP_RPC(_mod, _if, _rpc)->result, __v); })
+#define ic_reply_chunk(ic, slot, _mod, _if, _rpc, ...) \
+    ic_reply_chunk_p(ic, slot, _mod, _if, _rpc,                             \
+                     (&(IOP_RPC_T(_mod, _if, _rpc, res)){ __VA_ARGS__ }))
+
 /** \brief helper to reply to a given query (server-side), with fd.
  *
  * \param[in]  ic
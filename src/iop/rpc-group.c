@@ -0,0 +1,459 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/log.h>
+#include <lib-common/iop-rpc.h>
+
+#define IC_GROUP_EJECT_ERRORS_DFL     5
+#define IC_GROUP_EJECT_SLOW_RATIO_DFL 4.
+#define IC_GROUP_EJECT_TIME_DFL       10000
+#define IC_GROUP_EJECT_TIME_MUL_MAX   8
+
+/* answers of a channel before it can be ejected because it is slow */
+#define IC_GROUP_SLOW_MIN_ANSWERS     16
+
+/* hedge delay when the latency of a channel is not known yet, in ms */
+#define IC_GROUP_HEDGE_DELAY_DFL      10
+
+typedef struct ic_group_peer_t {
+    ichannel_t *ic;
+    /* consecutive failures */
+    int         errors;
+    /* answers since the channel was added or came back */
+    int         answers;
+    /* µs, 0 when the channel is not ejected */
+    int64_t     ejected_until;
+    ic_group_stats_t stats;
+} ic_group_peer_t;
+qvector_t(ic_group_peer, ic_group_peer_t);
+
+struct ic_group_t {
+    ic_group_cfg_t cfg;
+    qv_t(ic_group_peer) peers;
+    int  nb_ejected;
+
+    /* pending queries, the group is destroyed once deleted and idle */
+    int  pending;
+    bool deleted;
+};
+
+/* A query sent to a group, and its hedge. */
+typedef struct ic_group_query_t {
+    ic_group_t  *g;
+    ic_msg_t    *msg;
+    ic_msg_cb_f *cb;
+    ichannel_t  *ic;
+    int64_t      start;
+
+    /* copy of the query, built beforehand because the payload of the query
+     * may be compressed once it is queued */
+    ic_msg_t    *hedge;
+    el_t         hedge_timer;
+    int64_t      hedge_start;
+    bool         hedge_sent;
+
+    /* queries of the group query which did not call back yet */
+    int          legs;
+    bool         done;
+} ic_group_query_t;
+
+static struct {
+    logger_t logger;
+} ic_group_g = {
+#define _G  ic_group_g
+    .logger = LOGGER_INIT_INHERITS(NULL, "ic-group"),
+};
+
+static int64_t ic_group_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* {{{ Channels */
+
+ic_group_t *ic_group_new(const ic_group_cfg_t *cfg)
+{
+    ic_group_t *g = p_new(ic_group_t, 1);
+
+    if (cfg) {
+        g->cfg = *cfg;
+    }
+    g->cfg.eject_errors = g->cfg.eject_errors ?: IC_GROUP_EJECT_ERRORS_DFL;
+    if (!g->cfg.eject_slow_ratio) {
+        g->cfg.eject_slow_ratio = IC_GROUP_EJECT_SLOW_RATIO_DFL;
+    }
+    g->cfg.eject_time = g->cfg.eject_time ?: IC_GROUP_EJECT_TIME_DFL;
+    qv_init(&g->peers);
+    return g;
+}
+
+static void ic_group_destroy(ic_group_t *g)
+{
+    qv_wipe(&g->peers);
+    p_delete(&g);
+}
+
+void ic_group_delete(ic_group_t **gp)
+{
+    ic_group_t *g = *gp;
+
+    if (!g) {
+        return;
+    }
+    *gp = NULL;
+    if (g->pending) {
+        /* destroyed by the last pending query */
+        g->deleted = true;
+        return;
+    }
+    ic_group_destroy(g);
+}
+
+static ic_group_peer_t *ic_group_find(const ic_group_t *g,
+                                      const ichannel_t *ic)
+{
+    tab_for_each_ptr(peer, &g->peers) {
+        if (peer->ic == ic) {
+            return peer;
+        }
+    }
+    return NULL;
+}
+
+void ic_group_add(ic_group_t *g, ichannel_t *ic)
+{
+    assert (!ic_group_find(g, ic));
+    qv_append(&g->peers, (ic_group_peer_t){ .ic = ic });
+}
+
+void ic_group_remove(ic_group_t *g, ichannel_t *ic)
+{
+    ic_group_peer_t *peer = ic_group_find(g, ic);
+
+    if (peer) {
+        if (peer->ejected_until) {
+            g->nb_ejected--;
+        }
+        qv_remove(&g->peers, peer - g->peers.tab);
+    }
+}
+
+int ic_group_get_stats(const ic_group_t *g, const ichannel_t *ic,
+                       ic_group_stats_t *stats)
+{
+    const ic_group_peer_t *peer = RETHROW_PN(ic_group_find(g, ic));
+
+    *stats = peer->stats;
+    stats->ejected = peer->ejected_until;
+    return 0;
+}
+
+/* }}} */
+/* {{{ Ejections */
+
+static void ic_group_eject(ic_group_t *g, ic_group_peer_t *peer,
+                           const char *why)
+{
+    int mul;
+
+    if (peer->ejected_until || 2 * (g->nb_ejected + 1) > g->peers.len) {
+        return;
+    }
+    peer->stats.ejections++;
+    mul = MIN(peer->stats.ejections, IC_GROUP_EJECT_TIME_MUL_MAX);
+    peer->ejected_until = ic_group_now()
+                        + (int64_t)g->cfg.eject_time * mul * 1000;
+    g->nb_ejected++;
+    logger_notice(&_G.logger, "channel %u ejected for %d ms: %s",
+                  peer->ic->id, g->cfg.eject_time * mul, why);
+}
+
+/* Bring back the channels whose ejection is over, with a clean slate. */
+static void ic_group_refresh(ic_group_t *g)
+{
+    int64_t now = ic_group_now();
+
+    tab_for_each_ptr(peer, &g->peers) {
+        if (peer->ejected_until && peer->ejected_until <= now) {
+            peer->ejected_until = 0;
+            peer->errors        = 0;
+            peer->answers       = 0;
+            peer->stats.latency = 0;
+            g->nb_ejected--;
+        }
+    }
+}
+
+static bool ic_group_is_slow(const ic_group_t *g,
+                             const ic_group_peer_t *peer)
+{
+    int64_t fastest = INT64_MAX;
+
+    if (g->cfg.eject_slow_ratio < 0
+    ||  peer->answers < IC_GROUP_SLOW_MIN_ANSWERS)
+    {
+        return false;
+    }
+    tab_for_each_ptr(other, &g->peers) {
+        if (other != peer && !other->ejected_until
+        &&  other->answers >= IC_GROUP_SLOW_MIN_ANSWERS)
+        {
+            fastest = MIN(fastest, other->stats.latency);
+        }
+    }
+    return fastest != INT64_MAX
+        && peer->stats.latency > g->cfg.eject_slow_ratio * fastest;
+}
+
+static bool ic_group_status_is_answer(ic_status_t status)
+{
+    return status == IC_MSG_OK || status == IC_MSG_EXN;
+}
+
+static void ic_group_account(ic_group_t *g, ichannel_t *ic,
+                             ic_status_t status, int64_t latency)
+{
+    ic_group_peer_t *peer = ic_group_find(g, ic);
+
+    if (!peer || status == IC_MSG_CANCELED) {
+        return;
+    }
+    if (!ic_group_status_is_answer(status)) {
+        peer->stats.failures++;
+        if (++peer->errors >= g->cfg.eject_errors) {
+            ic_group_eject(g, peer, ic_status_to_string(status));
+        }
+        return;
+    }
+
+    peer->errors = 0;
+    peer->answers++;
+    if (peer->stats.latency) {
+        peer->stats.latency += (latency - peer->stats.latency) / 8;
+    } else {
+        peer->stats.latency = MAX(latency, 1);
+    }
+    if (ic_group_is_slow(g, peer)) {
+        ic_group_eject(g, peer, "slow answers");
+    }
+}
+
+/* }}} */
+/* {{{ Choice of the channels */
+
+static bool ic_group_can_pick(const ic_group_peer_t *peer,
+                              const ichannel_t *exclude, bool ejected)
+{
+    return peer->ic != exclude && (ejected || !peer->ejected_until)
+        && ic_is_ready(peer->ic);
+}
+
+static int64_t ic_group_score(ic_group_peer_t *peer)
+{
+    return (int64_t)(ic_queue_len(peer->ic) + 1) * (peer->stats.latency + 1);
+}
+
+static ic_group_peer_t *ic_group_pick_peer(ic_group_t *g,
+                                           const ichannel_t *exclude)
+{
+    ic_group_peer_t *choices[2] = { NULL, NULL };
+    bool ejected = false;
+    int r[2];
+    int cnt;
+    int pos;
+
+    if (g->nb_ejected) {
+        ic_group_refresh(g);
+    }
+
+    for (;;) {
+        cnt = 0;
+        tab_for_each_ptr(peer, &g->peers) {
+            cnt += ic_group_can_pick(peer, exclude, ejected);
+        }
+        if (cnt || ejected) {
+            break;
+        }
+        /* fallback on the ejected channels rather than failing */
+        ejected = true;
+    }
+    if (!cnt) {
+        return NULL;
+    }
+
+    /* draw two different channels among the candidates */
+    r[0] = rand_range(0, cnt - 1);
+    r[1] = cnt > 1 ? rand_range(0, cnt - 2) : r[0];
+    if (cnt > 1 && r[1] >= r[0]) {
+        r[1]++;
+    }
+    pos = 0;
+    tab_for_each_ptr(peer, &g->peers) {
+        if (!ic_group_can_pick(peer, exclude, ejected)) {
+            continue;
+        }
+        for (int i = 0; i < 2; i++) {
+            if (r[i] == pos) {
+                choices[i] = peer;
+            }
+        }
+        pos++;
+    }
+
+    if (ic_group_score(choices[1]) < ic_group_score(choices[0])) {
+        return choices[1];
+    }
+    return choices[0];
+}
+
+ichannel_t *ic_group_pick(ic_group_t *g)
+{
+    ic_group_peer_t *peer = ic_group_pick_peer(g, NULL);
+
+    return peer ? peer->ic : NULL;
+}
+
+/* }}} */
+/* {{{ Queries */
+
+static void ic_group_query_delete(ic_group_query_t **qp)
+{
+    ic_group_query_t *q = *qp;
+    ic_group_t *g = q->g;
+
+    el_unregister(&q->hedge_timer);
+    if (!q->hedge_sent) {
+        ic_msg_delete(&q->hedge);
+    }
+    p_delete(qp);
+
+    if (!--g->pending && g->deleted) {
+        ic_group_destroy(g);
+    }
+}
+
+static void ic_group_query_cb(ichannel_t *ic, ic_msg_t *msg,
+                              ic_status_t status, void *res, void *exn)
+{
+    ic_group_query_t *q = msg->group_query;
+    bool is_hedge = msg != q->msg;
+    int64_t start = is_hedge ? q->hedge_start : q->start;
+
+    ic_group_account(q->g, ic, status, ic_group_now() - start);
+
+    /* a failed hedge lets the query go on; but the query of the caller
+     * cannot wait for its hedge since it is deleted once it called back */
+    if (!q->done && (!is_hedge || ic_group_status_is_answer(status))) {
+        q->done = true;
+        el_unregister(&q->hedge_timer);
+        if (is_hedge) {
+            ic_group_peer_t *peer = ic_group_find(q->g, ic);
+
+            if (peer) {
+                peer->stats.hedge_wins++;
+            }
+        }
+        (*q->cb)(ic, q->msg, status, res, exn);
+
+        /* the other query calls back with IC_MSG_CANCELED */
+        if (q->legs > 1) {
+            ic_msg_cancel(is_hedge ? q->msg : q->hedge);
+        }
+    }
+
+    if (!--q->legs) {
+        ic_group_query_delete(&q);
+    }
+}
+
+static void ic_group_on_hedge(el_t ev, el_data_t data)
+{
+    ic_group_query_t *q = data.ptr;
+    ic_group_peer_t *peer;
+
+    /* the one-shot timer is unregistered by the event loop */
+    q->hedge_timer = NULL;
+    peer = ic_group_pick_peer(q->g, q->ic);
+    if (!peer) {
+        return;
+    }
+    peer->stats.queries++;
+    peer->stats.hedged++;
+    q->hedge_sent  = true;
+    q->hedge_start = ic_group_now();
+    q->legs++;
+    __ic_query(peer->ic, q->hedge);
+}
+
+static int ic_group_hedge_delay(const ic_group_t *g,
+                                const ic_group_peer_t *peer)
+{
+    if (g->cfg.hedge_delay) {
+        return g->cfg.hedge_delay;
+    }
+    if (!peer->stats.latency) {
+        return IC_GROUP_HEDGE_DELAY_DFL;
+    }
+    return DIV_ROUND_UP(2 * peer->stats.latency, 1000);
+}
+
+void __ic_group_query(ic_group_t *g, ichannel_t *ic, ic_msg_t *msg,
+                      bool hedge)
+{
+    ic_group_peer_t *peer = ic_group_find(g, ic);
+    ic_group_query_t *q;
+
+    assert (peer);
+    peer->stats.queries++;
+    if (msg->async) {
+        /* no answer to wait for */
+        assert (!hedge);
+        __ic_query(ic, msg);
+        return;
+    }
+
+    q = p_new(ic_group_query_t, 1);
+    q->g     = g;
+    q->msg   = msg;
+    q->cb    = msg->cb;
+    q->ic    = ic;
+    q->start = ic_group_now();
+    q->legs  = 1;
+    g->pending++;
+
+    if (hedge && g->peers.len > 1) {
+        q->hedge = ic_msg_new(0);
+        q->hedge->timeout  = msg->timeout;
+        q->hedge->priority = msg->priority;
+        ic_build_query_from(q->hedge, msg);
+        q->hedge->cb = &ic_group_query_cb;
+        q->hedge->group_query = q;
+        q->hedge_timer = el_timer_register(ic_group_hedge_delay(g, peer), 0,
+                                           0, &ic_group_on_hedge, q);
+        el_unref(q->hedge_timer);
+    }
+
+    msg->cb = &ic_group_query_cb;
+    msg->group_query = q;
+    __ic_query(ic, msg);
+}
+
+/* }}} */
@@ -440,15 +440,35 @@ void __ichttp_err_ctx_clear(void)
     err_ctx_g = LSTR_NULL_V;
 }
 
-static void ichttp_serialize_soap(sb_t *sb, ichttp_query_t *iq, int cmd,
-                                  const iop_struct_t *st, const void *v)
+static void ichttp_xpack(xmlpp_t *pp, const iop_struct_t *st, const void *v,
+                         unsigned flags)
+{
+    if (pp->writecb) {
+        xmlpp_flush(pp);
+        if (pp->write_res >= 0) {
+            pp->write_res = iop_xpack_cb(st, v, pp->writecb, pp->priv, flags);
+        }
+    } else {
+        iop_xpack_flags(pp->buf, st, v, flags);
+    }
+}
+
+/* When writecb is set, sb is only a working buffer and the answer is
+ * streamed to the callback. */
+static int ichttp_serialize_soap(sb_t *sb, xmlpp_writecb_f *writecb,
+                                 void *priv, ichttp_query_t *iq, int cmd,
+                                 const iop_struct_t *st, const void *v)
 {
     xmlpp_t pp;
     httpd_trigger__ic_t *tcb;
+    int res;
 
     tcb = container_of(iq->trig_cb, httpd_trigger__ic_t, cb);
 
     xmlpp_open_banner(&pp, sb);
+    if (writecb) {
+        xmlpp_set_writecb(&pp, writecb, priv);
+    }
     pp.nospace = true;
     xmlpp_opentag(&pp, "s:Envelope");
     xmlpp_putattr(&pp, "xmlns:s", "http://schemas.xmlsoap.org/soap/envelope/");
@@ -470,7 +490,7 @@ static void ichttp_serialize_soap(sb_t *sb, ichttp_query_t *iq, int cmd,
             } else {
                 sb_addf(sb, "<n:%*pM>", LSTR_FMT_ARG(cbe->name_res));
             }
-            iop_xpack_flags(sb, st, v, tcb->xpack_flags);
+            ichttp_xpack(&pp, st, v, tcb->xpack_flags);
             sb_addf(sb, "</n:%*pM>", LSTR_FMT_ARG(cbe->name_res));
         } else {
             sb_addf(sb, "<n:%*pM />", LSTR_FMT_ARG(cbe->name_res));
@@ -495,15 +515,106 @@ static void ichttp_serialize_soap(sb_t *sb, ichttp_query_t *iq, int cmd,
             } else {
                 sb_addf(sb, "<n:%*pM>", LSTR_FMT_ARG(cbe->name_exn));
             }
-            iop_xpack_flags(sb, st, v, tcb->xpack_flags);
+            ichttp_xpack(&pp, st, v, tcb->xpack_flags);
             sb_addf(sb, "</n:%*pM>", LSTR_FMT_ARG(cbe->name_exn));
         } else {
             sb_addf(sb, "<n:%*pM />", LSTR_FMT_ARG(cbe->name_exn));
         }
     }
     pp.can_do_attr = false;
-    xmlpp_close(&pp);
+    res = xmlpp_close(&pp);
     iq->iop_answered = true;
+    return res;
+}
+
+/* The compressed answers are packed through a small buffer that is
+ * deflated on the fly into the outbuf, instead of packing the whole
+ * answer in a temporary buffer first. */
+typedef struct ichttp_zwriter_t {
+    z_stream zs;
+    sb_t    *out;
+    sb_t    *buf;
+} ichttp_zwriter_t;
+
+static int ichttp_zwriter_deflate(ichttp_zwriter_t *w, const void *data,
+                                  int len, int flush)
+{
+    w->zs.next_in  = (Bytef *)data;
+    w->zs.avail_in = len;
+
+    for (;;) {
+        int res;
+
+        w->zs.next_out  = (Bytef *)sb_grow(w->out,
+                                           MAX(w->zs.avail_in / 2, 128));
+        w->zs.avail_out = sb_avail(w->out);
+        res = deflate(&w->zs, flush);
+        __sb_fixlen(w->out, (char *)w->zs.next_out - w->out->data);
+
+        switch (res) {
+          case Z_STREAM_END:
+            return 0;
+          case Z_OK:
+          case Z_BUF_ERROR:
+            if (flush == Z_NO_FLUSH && w->zs.avail_out) {
+                return 0;
+            }
+            break;
+          default:
+            return -1;
+        }
+    }
+}
+
+static int ichttp_zwriter_write(void *priv, const void *data, int len)
+{
+    ichttp_zwriter_t *w = priv;
+
+    if (len > sb_avail(w->buf)) {
+        RETHROW(ichttp_zwriter_deflate(w, w->buf->data, w->buf->len,
+                                       Z_NO_FLUSH));
+        sb_reset(w->buf);
+        if (len > sb_avail(w->buf)) {
+            /* the big strings are deflated from the value */
+            RETHROW(ichttp_zwriter_deflate(w, data, len, Z_NO_FLUSH));
+            return len;
+        }
+    }
+    sb_add(w->buf, data, len);
+    return len;
+}
+
+static void
+ichttp_pack_compressed(sb_t *out, ichttp_query_t *iq, int cmd,
+                       const iop_struct_t *st, const void *v, bool is_gzip)
+{
+    httpd_trigger__ic_t *tcb;
+    SB_8k(buf);
+    ichttp_zwriter_t w = { .out = out, .buf = &buf };
+    int res;
+
+    tcb = container_of(iq->trig_cb, httpd_trigger__ic_t, cb);
+    if (deflateInit2(&w.zs, Z_BEST_COMPRESSION, Z_DEFLATED,
+                     MAX_WBITS + (is_gzip ? 16 : 0), MAX_MEM_LEVEL,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        e_panic("zlib error");
+    }
+    if (iq->json) {
+        res = iop_jpack(st, v, &ichttp_zwriter_write, &w, tcb->jpack_flags);
+        iq->iop_answered = true;
+    } else {
+        SB_8k(xml);
+
+        res = ichttp_serialize_soap(&xml, &ichttp_zwriter_write, &w,
+                                    iq, cmd, st, v);
+    }
+    if (res < 0 || ichttp_zwriter_deflate(&w, buf.data, buf.len,
+                                          Z_FINISH) < 0)
+    {
+        e_panic("zlib error");
+    }
+    IGNORE(deflateEnd(&w.zs));
 }
 
 void
@@ -566,23 +677,13 @@ __ichttp_reply(uint64_t slot, int cmd, const iop_struct_t *st, const void *v)
     tcb = container_of(iq->trig_cb, httpd_trigger__ic_t, cb);
 
     if (gzenc) {
-        t_scope;
-        sb_t buf;
-
-        t_sb_init(&buf, BUFSIZ);
-        if (iq->json) {
-            iop_jpack(st, v, iop_sb_write, &buf, tcb->jpack_flags);
-            iq->iop_answered = true;
-        } else {
-            ichttp_serialize_soap(&buf, iq, cmd, st, v);
-        }
-        sb_add_compressed(out, buf.data, buf.len, Z_BEST_COMPRESSION, is_gzip);
+        ichttp_pack_compressed(out, iq, cmd, st, v, is_gzip);
     } else
     if (iq->json) {
         iop_jpack(st, v, iop_sb_write, out, tcb->jpack_flags);
         iq->iop_answered = true;
     } else {
-        ichttp_serialize_soap(out, iq, cmd, st, v);
+        ichttp_serialize_soap(out, NULL, NULL, iq, cmd, st, v);
     }
     outbuf_sb_end(ob, oldlen);
 
@@ -20,12 +20,42 @@
 #include <lib-common/iop.h>
 #include "helpers.in.c"
 
-static void xpack_struct(sb_t *, const iop_struct_t *, const void *, unsigned);
-static void xpack_class(sb_t *, const iop_struct_t *, const void *, unsigned);
-static void xpack_union(sb_t *, const iop_struct_t *, const void *, unsigned);
+/* When packing through a callback, the XML is generated in a small buffer
+ * that is flushed after each field once it exceeds XPACK_FLUSH_SIZE, so
+ * that the memory used does not depend on the size of the value. */
+#define XPACK_FLUSH_SIZE  (8 << 10)
+
+typedef struct xpack_t {
+    sb_t                *sb;
+    iop_xpack_writecb_f *writecb;
+    void                *priv;
+    int                  res;
+} xpack_t;
+
+static void xpack_flush(xpack_t *xp, bool force)
+{
+    if (!xp->writecb || (!force && xp->sb->len < XPACK_FLUSH_SIZE)) {
+        return;
+    }
+    if (xp->res >= 0 && xp->sb->len) {
+        int res = (*xp->writecb)(xp->priv, xp->sb->data, xp->sb->len);
+
+        if (res < 0) {
+            xp->res = res;
+        }
+    }
+    sb_reset(xp->sb);
+}
+
+static void xpack_struct(xpack_t *, const iop_struct_t *, const void *,
+                         unsigned);
+static void xpack_class(xpack_t *, const iop_struct_t *, const void *,
+                        unsigned);
+static void xpack_union(xpack_t *, const iop_struct_t *, const void *,
+                        unsigned);
 
 static void
-xpack_value(sb_t *sb, const iop_struct_t *desc, const iop_field_t *f,
+xpack_value(xpack_t *xp, const iop_struct_t *desc, const iop_field_t *f,
             const void *v, unsigned flags)
 {
     static lstr_t const types[] = {
@@ -47,6 +77,7 @@ xpack_value(sb_t *sb, const iop_struct_t *desc, const iop_field_t *f,
         [IOP_T_STRUCT] = LSTR_IMMED(">"),
         [IOP_T_VOID]   = LSTR_IMMED(" xsi:nil=\"true\">"),
     };
+    sb_t *sb = xp->sb;
     const lstr_t *s;
     const iop_field_attrs_t *attrs;
     bool is_class = iop_field_is_class(f);
@@ -147,15 +178,15 @@ xpack_value(sb_t *sb, const iop_struct_t *desc, const iop_field_t *f,
         sb_add(sb, s->s, s->len);
         break;
       case IOP_T_UNION:
-        xpack_union(sb, f->u1.st_desc, v, flags);
+        xpack_union(xp, f->u1.st_desc, v, flags);
         break;
       case IOP_T_VOID:
         break;
       case IOP_T_STRUCT:
         if (is_class) {
-            xpack_class(sb, f->u1.st_desc, v, flags);
+            xpack_class(xp, f->u1.st_desc, v, flags);
         } else {
-            xpack_struct(sb, f->u1.st_desc, v, flags);
+            xpack_struct(xp, f->u1.st_desc, v, flags);
         }
         break;
     }
@@ -165,7 +196,7 @@ xpack_value(sb_t *sb, const iop_struct_t *desc, const iop_field_t *f,
 }
 
 static void
-xpack_struct(sb_t *sb, const iop_struct_t *desc, const void *v,
+xpack_struct(xpack_t *xp, const iop_struct_t *desc, const void *v,
              unsigned flags)
 {
     for (int i = 0; i < desc->fields_len; i++) {
@@ -194,15 +225,16 @@ xpack_struct(sb_t *sb, const iop_struct_t *desc, const void *v,
 
         while (len-- > 0) {
             if (!(f->type == IOP_T_VOID && f->repeat == IOP_R_REQUIRED)) {
-                xpack_value(sb, desc, f, ptr, flags);
+                xpack_value(xp, desc, f, ptr, flags);
+                xpack_flush(xp, false);
             }
             ptr = (const char *)ptr + f->size;
         }
     }
 }
 
-static void xpack_class(sb_t *sb, const iop_struct_t *desc, const void *v,
-                        unsigned flags)
+static void xpack_class(xpack_t *xp, const iop_struct_t *desc,
+                        const void *v, unsigned flags)
 {
     qv_t(iop_struct) parents;
     const iop_struct_t *real_desc = *(const iop_struct_t **)v;
@@ -221,33 +253,56 @@ static void xpack_class(sb_t *sb, const iop_struct_t *desc, const void *v,
 
     /* Write fields of different levels */
     for (int pos = parents.len; pos-- > 0; ) {
-        xpack_struct(sb, parents.tab[pos], v, flags);
+        xpack_struct(xp, parents.tab[pos], v, flags);
     }
     qv_wipe(&parents);
 }
 
 static void
-xpack_union(sb_t *sb, const iop_struct_t *desc, const void *v,
+xpack_union(xpack_t *xp, const iop_struct_t *desc, const void *v,
             unsigned flags)
 {
     const iop_field_t *f = get_union_field(desc, v);
 
-    xpack_value(sb, desc, f, (char *)v + f->data_offs, flags);
+    xpack_value(xp, desc, f, (char *)v + f->data_offs, flags);
 }
 
-void iop_xpack_flags(sb_t *sb, const iop_struct_t *desc, const void *v,
-                     unsigned flags)
+static void xpack(xpack_t *xp, const iop_struct_t *desc, const void *v,
+                  unsigned flags)
 {
     if (desc->is_union) {
-        xpack_union(sb, desc, v, flags);
+        xpack_union(xp, desc, v, flags);
     } else
     if (iop_struct_is_class(desc)) {
-        xpack_class(sb, desc, v, flags);
+        xpack_class(xp, desc, v, flags);
     } else {
-        xpack_struct(sb, desc, v, flags);
+        xpack_struct(xp, desc, v, flags);
     }
 }
 
+void iop_xpack_flags(sb_t *sb, const iop_struct_t *desc, const void *v,
+                     unsigned flags)
+{
+    xpack_t xp = { .sb = sb };
+
+    xpack(&xp, desc, v, flags);
+}
+
+int iop_xpack_cb(const iop_struct_t *desc, const void *v,
+                 iop_xpack_writecb_f *writecb, void *priv, unsigned flags)
+{
+    SB(sb, XPACK_FLUSH_SIZE + BUFSIZ);
+    xpack_t xp = {
+        .sb      = &sb,
+        .writecb = writecb,
+        .priv    = priv,
+    };
+
+    xpack(&xp, desc, v, flags);
+    xpack_flush(&xp, true);
+    return xp.res;
+}
+
 void iop_xpack(sb_t *sb, const iop_struct_t *desc, const void *v,
                bool verbose, bool with_enums)
 {
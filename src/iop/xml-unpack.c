@@ -46,7 +46,8 @@ static int parse_int(xml_reader_t xr, const char *s, int64_t *i64p)
  * associated message part found in parts_g qm.
  * Example: href="cid:12345"
  */
-static int get_part_from_href(xml_reader_t xr, xmlAttrPtr *attr, lstr_t *part)
+static int get_part_from_href(xml_reader_t xr, const xmlr_attr_t **attr,
+                              lstr_t *part)
 {
     t_scope;
 
@@ -76,7 +77,7 @@ static int get_part_from_href(xml_reader_t xr, xmlAttrPtr *attr, lstr_t *part)
 /* unpack a string value, supporting references to message parts */
 static int get_text(xml_reader_t xr, mem_pool_t *mp, bool b64, lstr_t *str)
 {
-    xmlAttrPtr attr;
+    const xmlr_attr_t *attr;
     lstr_t part;
 
     if (RETHROW(xmlr_node_is_empty(xr))) {
@@ -552,7 +553,7 @@ xunpack_class(xml_reader_t xr, mem_pool_t *mp, const iop_struct_t *desc,
      * is most of time) t_pool(). */
     {
         t_scope;
-        xmlAttrPtr attr = xmlr_find_attr_s(xr, "type", false);
+        const xmlr_attr_t *attr = xmlr_find_attr_s(xr, "type", false);
         lstr_t    real_type_str;
         pstream_t ps;
 
@@ -214,6 +214,28 @@ void iop_xpack_flags(sb_t * nonnull sb, const iop_struct_t * nonnull st,
 void iop_xpack(sb_t * nonnull sb, const iop_struct_t * nonnull st,
                const void * nonnull v, bool verbose, bool with_enums);
 
+typedef int (iop_xpack_writecb_f)(void * nonnull priv,
+                                  const void * nonnull buf, int len);
+
+/** Convert an IOP C structure to IOP-XML through a write callback.
+ *
+ * Same as iop_xpack_flags(), but the XML is generated in a small buffer
+ * that is regularly flushed to \p writecb (like iop_sb_write), so that
+ * large values can be streamed without being packed in memory first.
+ *
+ * \param[in] st       IOP structure definition.
+ * \param[in] v        Pointer on the IOP structure to pack.
+ * \param[in] writecb  Callback to call when writing.
+ * \param[in] priv     Private data to give to the callback.
+ * \param[in] flags    Bitfield of iop_xpack_flags.
+ *
+ * \return the first negative value returned by \p writecb (nothing more
+ *         is written after it), 0 otherwise.
+ */
+int iop_xpack_cb(const iop_struct_t * nonnull st, const void * nonnull v,
+                 iop_xpack_writecb_f * nonnull writecb, void * nonnull priv,
+                 unsigned flags);
+
 
 /** RPC set for WSDL generation */
 qh_k32_t(xwsdl_impl);
@@ -53,8 +53,27 @@ iopc_set_path(const char *outdir, const iopc_pkg_t *pkg,
     return res;
 }
 
+/* Whether the file at `path` already has the content of `buf`. */
+static bool iopc_file_is_uptodate(const sb_t *buf, const char *path)
+{
+    lstr_t content;
+    bool res;
+
+    if (lstr_init_from_file(&content, path, PROT_READ, MAP_SHARED) < 0) {
+        return false;
+    }
+    res = lstr_equal(content, LSTR_SB_V(buf));
+    lstr_wipe(&content);
+    return res;
+}
+
 int iopc_write_file(const sb_t *buf, const char *path)
 {
+    /* Leave unchanged outputs untouched, so that their mtime does not
+     * trigger the recompilation of everything that depends on them. */
+    if (iopc_file_is_uptodate(buf, path)) {
+        return 0;
+    }
     if (unlink(path) < 0 && errno != ENOENT) {
         throw_error("unable to remove existing file `%s`: %m", path);
     }
@@ -60,6 +60,8 @@ static popt_t options[] = {
              "try to generate relative includes"),
     OPT_STR(0,    "c-output-path", &opts.c_outpath,
             "base of the compiled hierarchy for C files"),
+    OPT_FLAG(0,   "c-codecs", &iopc_do_c_g.gen_codecs,
+             "generate specialized binary packers for the simple structs"),
 
     OPT_GROUP("JSON backend options"),
     OPT_STR(0,    "json-output-path", &opts.json_outpath,
@@ -1138,6 +1138,10 @@ extern struct iopc_do_c_globs {
      *  lib-common/iop-internals.h
      */
     const char *iop_compat_header;
+
+    /** generate specialized binary (un)packers for the structs with only
+     * scalar and string fields */
+    bool gen_codecs;
 } iopc_do_c_g;
 
 extern struct iopc_do_typescript_globs {
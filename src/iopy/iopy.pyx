@@ -27,6 +27,9 @@ from cpython.object cimport (
 )
 from cpython.ref cimport PyObject, Py_INCREF, Py_DECREF
 from cpython.mem cimport PyMem_Malloc, PyMem_Free
+from cpython.buffer cimport (
+    PyObject_CheckBuffer, PyObject_GetBuffer, PyBuffer_Release, PyBUF_SIMPLE
+)
 from cpython.pylifecycle cimport Py_IsInitialized, Py_AtExit
 from cpython.ceval cimport PyEval_InitThreads
 from cpython cimport bool
@@ -3127,10 +3130,24 @@ cdef StructUnionBase parse_special_val(object cls, const iop_struct_t *st,
     """
     cdef t_scope_t t_scope_guard = t_scope_init()
     cdef lstr_t val_lstr
+    cdef Py_buffer view
 
     # Required to ignore cython error about unused entry t_scope_guard
     t_scope_ignore(t_scope_guard)
 
+    if ((val_type == IOPY_SPECIAL_KWARGS_BIN or
+         val_type == IOPY_SPECIAL_KWARGS_HEX) and
+        not isinstance(val, (bytes, str)) and PyObject_CheckBuffer(val)):
+        # bytearray, memoryview, mmap...: unpack from the buffer in place,
+        # the python object is built before the buffer is released.
+        PyObject_GetBuffer(val, &view, PyBUF_SIMPLE)
+        try:
+            val_lstr = LSTR_INIT_V(<const char *>view.buf, view.len)
+            return parse_special_val_lstr(cls, st, plugin, val_type,
+                                          val_lstr)
+        finally:
+            PyBuffer_Release(&view)
+
     val_lstr = t_py_obj_to_lstr(val)
     return parse_special_val_lstr(cls, st, plugin, val_type, val_lstr)
 
@@ -3985,12 +4002,14 @@ cdef bytes format_py_obj_to_bin(StructUnionBase py_obj):
         The formatted string.
     """
     cdef t_scope_t t_scope_guard = t_scope_init()
+    cdef const iop_struct_t *st = struct_union_get_desc(py_obj)
     cdef void *val = NULL
     cdef lstr_t bin_lstr
 
     t_scope_ignore(t_scope_guard)
     mp_iop_py_obj_to_c_val(t_pool(), False, py_obj, &val)
-    bin_lstr = t_iop_bpack_struct(struct_union_get_desc(py_obj), val)
+    with nogil:
+        bin_lstr = t_iop_bpack_struct(st, val)
     return lstr_to_py_bytes(bin_lstr)
 
 
@@ -4007,6 +4026,7 @@ cdef str format_py_obj_to_hex(StructUnionBase py_obj):
         The formatted string.
     """
     cdef t_scope_t t_scope_guard = t_scope_init()
+    cdef const iop_struct_t *st = struct_union_get_desc(py_obj)
     cdef void *val = NULL
     cdef lstr_t bin_lstr
     cdef int hsize
@@ -4015,11 +4035,13 @@ cdef str format_py_obj_to_hex(StructUnionBase py_obj):
 
     t_scope_ignore(t_scope_guard)
     mp_iop_py_obj_to_c_val(t_pool(), False, py_obj, &val)
-    bin_lstr = t_iop_bpack_struct(struct_union_get_desc(py_obj), val)
+    with nogil:
+        bin_lstr = t_iop_bpack_struct(st, val)
 
-    hsize = bin_lstr.len * 2 + 1
-    hex_str = t_new_char(hsize)
-    res_size = strconv_hexencode(hex_str, hsize, bin_lstr.s, bin_lstr.len)
+        hsize = bin_lstr.len * 2 + 1
+        hex_str = t_new_char(hsize)
+        res_size = strconv_hexencode(hex_str, hsize, bin_lstr.s,
+                                     bin_lstr.len)
     cassert (res_size == (hsize - 1))
 
     return lstr_to_py_str(LSTR_INIT_V(hex_str, res_size))
@@ -5436,7 +5458,9 @@ cdef class StructBase(StructUnionBase):
     structure.
     You can also create new instances from json, yaml, bin, xml or
     hexadecimal iop packed strings by creating the object with a single
-    argument named _json, _yaml, _xml, _bin or _hex.
+    argument named _json, _yaml, _xml, _bin or _hex. _bin and _hex also
+    accept objects supporting the buffer protocol (bytearray, memoryview,
+    mmap...), which are unpacked without being copied.
 
     You can dump thoses struct into json, yaml, bin, xml or hexadecimal
     iop-packed string using methods to_json(), to_yaml(), to_bin(), to_xml()
@@ -450,6 +450,155 @@ static inline void __logger_exits(logger_t * nonnull logger,
 #define logger_trace(Logger, Level, Fmt, ...)                                \
     __LOGGER_LOG(Logger, LOG_TRACE + (Level),, Fmt, ##__VA_ARGS__)
 
+/* }}} */
+/* Rate-limited and sampled logging {{{ */
+
+/** Token bucket of a rate-limited call site.
+ *
+ * The bucket holds at most \p burst messages and is refilled with \p rate
+ * messages per second. It is implemented as a GCRA (the "theoretical
+ * arrival time" of the next message), which only takes an atomic word.
+ */
+typedef struct log_ratelimit_t {
+    int burst;
+    int rate;
+
+    /* private */
+    _Atomic int64_t tat;
+    atomic_uint suppressed;
+} log_ratelimit_t;
+
+#define LOG_RATELIMIT_BURST  10
+#define LOG_RATELIMIT_RATE   1
+
+/** Take a token from the bucket.
+ *
+ * \return -1 if the message must be suppressed, else the number of messages
+ *         suppressed since the last one that was not.
+ */
+static ALWAYS_INLINE int log_ratelimit_check(log_ratelimit_t * nonnull rl)
+{
+    struct timespec ts;
+    int64_t interval = 1000000 / rl->rate;
+    int64_t now;
+    int64_t tat;
+
+    /* The coarse clock does not need a system call. */
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    now = ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    tat = atomic_load_explicit(&rl->tat, memory_order_relaxed);
+    do {
+        if (tat - now > interval * (rl->burst - 1)) {
+            atomic_fetch_add_explicit(&rl->suppressed, 1,
+                                      memory_order_relaxed);
+            return -1;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&rl->tat, &tat,
+                                                    MAX(tat, now) + interval,
+                                                    memory_order_relaxed,
+                                                    memory_order_relaxed));
+
+    if (likely(!atomic_load_explicit(&rl->suppressed, memory_order_relaxed)))
+    {
+        return 0;
+    }
+    return atomic_exchange_explicit(&rl->suppressed, 0,
+                                    memory_order_relaxed);
+}
+
+/** Rate-limited logging.
+ *
+ * The messages of a call site that exceed its token bucket are dropped
+ * before being formatted, and the number of dropped messages is logged
+ * by the call site with its next message, that is at most \p Rate times
+ * per second during a flood. Burst and Rate must be positive constants.
+ */
+#define __LOGGER_LOG_RATELIMITED(Logger, Level, Mark, Burst, Rate, Fmt, ...) \
+    ({  static log_ratelimit_t __log_rl = {                                  \
+            .burst = (Burst),                                                \
+            .rate  = (Rate),                                                 \
+        };                                                                   \
+        const logger_t *__clogger = (Logger);                                \
+        logger_t *__logger = (logger_t *)__clogger;                          \
+        int __log_suppressed;                                                \
+                                                                             \
+        Mark;                                                                \
+        if (__LOGGER_HAS_LEVEL(__logger, (Level))                            \
+        &&  (__log_suppressed = log_ratelimit_check(&__log_rl)) >= 0)        \
+        {                                                                    \
+            if (unlikely(__log_suppressed > 0)) {                            \
+                __logger_log(__logger, (Level), NULL, -1, __FILE__,          \
+                             __func__, __LINE__,                             \
+                             "%d similar messages suppressed",               \
+                             __log_suppressed);                              \
+            }                                                                \
+            __logger_log(__logger, (Level), NULL, -1, __FILE__, __func__,    \
+                         __LINE__, Fmt, ##__VA_ARGS__);                      \
+        }                                                                    \
+        (Level) <= LOG_WARNING ? -1 : 0;                                     \
+    })
+
+#define logger_log_ratelimited(Logger, Level, Burst, Rate, Fmt, ...)         \
+    __LOGGER_LOG_RATELIMITED(Logger, Level,, Burst, Rate, Fmt, ##__VA_ARGS__)
+
+#define logger_error_ratelimited(Logger, Fmt, ...)                           \
+    __LOGGER_LOG_RATELIMITED(Logger, LOG_ERR, __logger_cold(),               \
+                             LOG_RATELIMIT_BURST, LOG_RATELIMIT_RATE,        \
+                             Fmt, ##__VA_ARGS__)
+
+#define logger_warning_ratelimited(Logger, Fmt, ...)                         \
+    __LOGGER_LOG_RATELIMITED(Logger, LOG_WARNING, __logger_cold(),           \
+                             LOG_RATELIMIT_BURST, LOG_RATELIMIT_RATE,        \
+                             Fmt, ##__VA_ARGS__)
+
+#define logger_notice_ratelimited(Logger, Fmt, ...)                          \
+    __LOGGER_LOG_RATELIMITED(Logger, LOG_NOTICE,,                            \
+                             LOG_RATELIMIT_BURST, LOG_RATELIMIT_RATE,        \
+                             Fmt, ##__VA_ARGS__)
+
+#define logger_info_ratelimited(Logger, Fmt, ...)                            \
+    __LOGGER_LOG_RATELIMITED(Logger, LOG_INFO,,                              \
+                             LOG_RATELIMIT_BURST, LOG_RATELIMIT_RATE,        \
+                             Fmt, ##__VA_ARGS__)
+
+/** Sampled logging.
+ *
+ * Only one message out of \p Every of the call site is logged, starting
+ * with the first one.
+ */
+#define __LOGGER_LOG_SAMPLED(Logger, Level, Mark, Every, Fmt, ...)  ({       \
+        static atomic_uint __log_sample_cnt;                                 \
+        const logger_t *__clogger = (Logger);                                \
+        logger_t *__logger = (logger_t *)__clogger;                          \
+                                                                             \
+        Mark;                                                                \
+        if (__LOGGER_HAS_LEVEL(__logger, (Level))                            \
+        &&  atomic_fetch_add_explicit(&__log_sample_cnt, 1,                  \
+                                      memory_order_relaxed)                  \
+            % (unsigned)(Every) == 0)                                        \
+        {                                                                    \
+            __logger_log(__logger, (Level), NULL, -1, __FILE__, __func__,    \
+                         __LINE__, Fmt, ##__VA_ARGS__);                      \
+        }                                                                    \
+        (Level) <= LOG_WARNING ? -1 : 0;                                     \
+    })
+
+#define logger_log_sampled(Logger, Level, Every, Fmt, ...)                   \
+    __LOGGER_LOG_SAMPLED(Logger, Level,, Every, Fmt, ##__VA_ARGS__)
+
+#define logger_warning_sampled(Logger, Every, Fmt, ...)                      \
+    __LOGGER_LOG_SAMPLED(Logger, LOG_WARNING, __logger_cold(), Every,        \
+                         Fmt, ##__VA_ARGS__)
+
+#define logger_notice_sampled(Logger, Every, Fmt, ...)                       \
+    __LOGGER_LOG_SAMPLED(Logger, LOG_NOTICE,, Every, Fmt, ##__VA_ARGS__)
+
+#define logger_info_sampled(Logger, Every, Fmt, ...)                         \
+    __LOGGER_LOG_SAMPLED(Logger, LOG_INFO,, Every, Fmt, ##__VA_ARGS__)
+
+#define logger_debug_sampled(Logger, Every, Fmt, ...)                        \
+    __LOGGER_LOG_SAMPLED(Logger, LOG_DEBUG,, Every, Fmt, ##__VA_ARGS__)
+
 /* }}} */
 /* Multi-line logging {{{ */
 
@@ -686,6 +835,169 @@ extern int log_stderr_handler_teefd_g;
  */
 log_handler_f * nonnull log_set_handler(log_handler_f * nonnull handler);
 
+/* }}} */
+/* Asynchronous logging {{{ */
+
+/** Behavior of a thread that logs while its ring is full. */
+typedef enum log_async_overflow_t {
+    /** Drop the message, and count it in the statistics. */
+    LOG_ASYNC_DROP,
+    /** Wait for the logging thread to make room for the message. */
+    LOG_ASYNC_BLOCK,
+} log_async_overflow_t;
+
+typedef struct log_async_stats_t {
+    /** Number of messages passed to the log handler. */
+    uint64_t written;
+    /** Number of messages dropped because a ring was full. */
+    uint64_t dropped;
+} log_async_stats_t;
+
+/** Start the asynchronous logging.
+ *
+ * Once started, a thread that logs formats its message into a ring buffer
+ * of its own, without taking any lock, and a dedicated logging thread
+ * passes the messages of all the rings to the log handler, in timestamp
+ * order.
+ *
+ * The handler is then always called from the logging thread, with the
+ * already formatted message. The file, function and program names of the
+ * log context must be static strings, which is the case of the ones given
+ * by the logging macros.
+ *
+ * The critical messages (panics and fatal errors) are still written
+ * synchronously, after the pending messages are flushed, and so are the
+ * messages of a thread that is buffering its logs (see
+ * \ref log_start_buffering).
+ *
+ * \param[in] ring_size  size of the ring of each thread, in bytes; it is
+ *                       rounded up to a power of 2. The messages that do not
+ *                       fit in half a ring are truncated.
+ * \param[in] overflow   what to do when a ring is full.
+ * \return -1 if the logging thread cannot be created.
+ */
+int log_async_start(int ring_size, log_async_overflow_t overflow);
+
+/** Stop the asynchronous logging.
+ *
+ * The pending messages are written before this function returns.
+ */
+void log_async_stop(void);
+
+/** Wait until the messages logged before the call are written. */
+void log_async_flush(void);
+
+/** Get the statistics of the asynchronous logging, since the start of the
+ * process.
+ */
+void log_async_get_stats(log_async_stats_t * nonnull stats);
+
+/* }}} */
+/* Binary logging {{{ */
+
+/** Binary logging.
+ *
+ * The binary logging macros (logger_notice_bin(), ...) do not format the
+ * message: they store the identifier of the call site and the raw values of
+ * the arguments in a buffer of the calling thread, which is appended to a
+ * binary log file by blocks. Each call site is described once per file, and
+ * log_bin_decode() renders the messages later on, in the process or
+ * offline, so that the cost of the formatting is only paid for the logs
+ * that are read.
+ *
+ * The arguments are stored as follows:
+ *  - the integers, floating point numbers and plain pointers by value;
+ *  - the strings (%s, %.*s) by copy;
+ *  - the memory of the %*p formatters (%*pM, %*pX...) and the lstr_t of %pL
+ *    by copy.
+ *
+ * A call site whose format has other conversions (%m, %n, the %p formatters
+ * other than %pL, long double...) is formatted when called and stored as a
+ * string.
+ *
+ * When no binary log file is opened, the macros log the message as the text
+ * logging macros do.
+ */
+
+#define LOG_BIN_MAX_ARGS  16
+
+typedef struct log_bin_site_t {
+    const char * nonnull fmt;
+    const char * nonnull file;
+    const char * nonnull func;
+    int line;
+    int level;
+
+    /* private */
+    atomic_uint id;
+    atomic_uint gen;
+    int8_t nb_args;
+    uint8_t args[LOG_BIN_MAX_ARGS];
+} log_bin_site_t;
+
+void __logger_log_bin(logger_t * nonnull logger,
+                      log_bin_site_t * nonnull site, ...);
+
+/* Called in the child process after a fork(). */
+void __log_bin_atfork(void);
+
+#define __LOGGER_LOG_BIN(Logger, Level, Fmt, ...)  ({                        \
+        static log_bin_site_t __log_bin_site = {                             \
+            .fmt   = (Fmt),                                                  \
+            .file  = __FILE__,                                               \
+            .func  = __func__,                                               \
+            .line  = __LINE__,                                               \
+            .level = (Level),                                                \
+        };                                                                   \
+        const logger_t *__clogger = (Logger);                                \
+        logger_t *__logger = (logger_t *)__clogger;                          \
+                                                                             \
+        if (0) {                                                             \
+            isnprintf(NULL, 0, Fmt, ##__VA_ARGS__);                          \
+        }                                                                    \
+        if (__LOGGER_HAS_LEVEL(__logger, (Level))) {                         \
+            __logger_log_bin(__logger, &__log_bin_site, ##__VA_ARGS__);      \
+        }                                                                    \
+        0;                                                                   \
+    })
+
+#define logger_notice_bin(Logger, Fmt, ...)                                  \
+    __LOGGER_LOG_BIN(Logger, LOG_NOTICE, Fmt, ##__VA_ARGS__)
+
+#define logger_info_bin(Logger, Fmt, ...)                                    \
+    __LOGGER_LOG_BIN(Logger, LOG_INFO, Fmt, ##__VA_ARGS__)
+
+#define logger_debug_bin(Logger, Fmt, ...)                                   \
+    __LOGGER_LOG_BIN(Logger, LOG_DEBUG, Fmt, ##__VA_ARGS__)
+
+/* Level must be a constant. */
+#define logger_trace_bin(Logger, Level, Fmt, ...)                            \
+    __LOGGER_LOG_BIN(Logger, LOG_TRACE + (Level), Fmt, ##__VA_ARGS__)
+
+/** Open the binary log file.
+ *
+ * The binary logs are appended to \p path from now on, and the previous
+ * file, if any, is closed.
+ *
+ * \return -1 if the file cannot be opened.
+ */
+int log_bin_open(const char * nonnull path);
+
+/** Write the buffered binary logs of all the threads to the file. */
+void log_bin_flush(void);
+
+/** Flush and close the binary log file. */
+void log_bin_close(void);
+
+/** Render the content of a binary log file.
+ *
+ * Each message is rendered on its own line, in the order of the file, as:
+ * <iso8601 date> <program>[<pid>]: <level>: [{<logger>} ]<message>
+ *
+ * \return -1 if \p data is not a binary log file, or is corrupted.
+ */
+int log_bin_decode(lstr_t data, sb_t * nonnull out);
+
 /* }}} */
 /* Log buffer {{{ */
 
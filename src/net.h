@@ -44,6 +44,9 @@
 #include "net/socket.h"
 #include "net/sctp.h"
 #include "net/rate.h"
+#include "net/dgram.h"
+#include "net/connect.h"
+#include "net/dns.h"
 
 #if __has_feature(nullability)
 #pragma GCC diagnostic pop
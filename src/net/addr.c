@@ -170,6 +170,32 @@ int addr_resolve2(const char * nonnull what, const lstr_t s,
     return 0;
 }
 
+int addr_resolve_all(const char * nonnull what, const lstr_t s,
+                     sockunion_t * nonnull sus, int max,
+                     sb_t * nullable err)
+{
+    pstream_t host;
+    in_port_t port;
+    int res;
+
+    if (addr_parse_minport(ps_init(s.s, s.len), &host, &port, 1, -1) < 0) {
+        if (err) {
+            sb_addf(err, "unable to parse %s address `%*pM`",
+                    what, LSTR_FMT_ARG(s));
+        }
+        return -1;
+    }
+    res = addr_info_all(sus, max, AF_UNSPEC, host, port);
+    if (res <= 0) {
+        if (err) {
+            sb_addf(err, "unable to resolve %s address `%*pM`",
+                    what, LSTR_FMT_ARG(s));
+        }
+        return -1;
+    }
+    return res;
+}
+
 const char *t_addr_fmt(const sockunion_t *su, int *slen)
 {
     char buf[BUFSIZ];
@@ -224,20 +250,32 @@ const char *t_addr_fmt(const sockunion_t *su, int *slen)
     return t_dupz(buf, pos);
 }
 
-int addr_info(sockunion_t *su, sa_family_t af, pstream_t host, in_port_t port)
+int addr_info_all(sockunion_t *sus, int max, sa_family_t af, pstream_t host,
+                  in_port_t port)
 {
     t_scope;
     struct addrinfo *ai = NULL;
-    struct addrinfo *cur;
-    struct addrinfo hint = { .ai_family = af };
+    struct addrinfo hint = { .ai_family = af, .ai_socktype = SOCK_STREAM };
+    int res = 0;
+
+    if (MODULE_IS_LOADED(dns) && af != AF_UNIX) {
+        /* answer from the cache of the resolver, a miss starts the
+         * resolution in the background so that only the first call for a
+         * name blocks */
+        res = dns_lookup(LSTR_PS_V(&host), af, port, sus, max);
+        if (res > 0 || (res < 0 && errno == ENOENT)) {
+            return res > 0 ? res : -1;
+        }
+        res = 0;
+    }
 
     RETHROW(getaddrinfo(t_dupz(host.p, ps_len(&host)), NULL, &hint, &ai));
-    for (cur = ai; cur != NULL; cur = cur->ai_next) {
+    for (struct addrinfo *cur = ai; cur && res < max; cur = cur->ai_next) {
         switch (cur->ai_family) {
           case AF_INET:
           case AF_INET6:
           case AF_UNIX:
-            if (cur->ai_addrlen > ssizeof(*su)) {
+            if (cur->ai_addrlen > ssizeof(*sus)) {
                 continue;
             }
             break;
@@ -246,15 +284,17 @@ int addr_info(sockunion_t *su, sa_family_t af, pstream_t host, in_port_t port)
 
             continue;
         }
-        break;
-    }
-
-    if (cur) {
-        memcpy(su, cur->ai_addr, cur->ai_addrlen);
-        sockunion_setport(su, port);
+        memcpy(&sus[res], cur->ai_addr, cur->ai_addrlen);
+        sockunion_setport(&sus[res], port);
+        res++;
     }
     freeaddrinfo(ai);
-    return cur ? 0 : -1;
+    return res;
+}
+
+int addr_info(sockunion_t *su, sa_family_t af, pstream_t host, in_port_t port)
+{
+    return RETHROW(addr_info_all(su, 1, af, host, port)) ? 0 : -1;
 }
 
 int addr_filter_build(lstr_t subnet, addr_filter_t *filter)
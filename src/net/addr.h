@@ -128,6 +128,14 @@ static inline int addr_parse(pstream_t ps, pstream_t * nonnull host,
 }
 int addr_info(sockunion_t * nonnull, sa_family_t, pstream_t host, in_port_t);
 
+/** Resolve all the addresses of a host, in the order of getaddrinfo().
+ *
+ * \return the number of addresses written in sus (at most max), -1 if the
+ *         resolution failed.
+ */
+int addr_info_all(sockunion_t * nonnull sus, int max, sa_family_t af,
+                  pstream_t host, in_port_t port);
+
 /** Convert a TCP/IPv4, TCP/IPv6 or UNIX address into a string.
  *
  * Examples:
@@ -213,6 +221,17 @@ addr_resolve_with_err(const char * nonnull what, const lstr_t s,
     return addr_resolve2(what, s, 1, -1, out, NULL, NULL, err);
 }
 
+/** Resolve all the addresses of a host.
+ *
+ * Like \ref addr_resolve_with_err() but gets up to \p max addresses, to
+ * connect to them with \ref net_connect_start().
+ *
+ * \return the number of addresses, -1 if error.
+ */
+int addr_resolve_all(const char * nonnull what, const lstr_t s,
+                     sockunion_t * nonnull sus, int max,
+                     sb_t * nullable err);
+
 static inline int addr_resolve(const char * nonnull what, const lstr_t s,
                                sockunion_t * nonnull out)
 {
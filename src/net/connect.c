@@ -0,0 +1,233 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/el.h>
+#include <lib-common/net.h>
+#include <lib-common/unix.h>
+
+typedef struct net_connect_try_t {
+    net_connect_t *nc;
+    el_t           ev;
+    int            fd;
+    int64_t        start;
+} net_connect_try_t;
+
+struct net_connect_t {
+    int         cnt;
+    int         started;
+    int         running;
+    int         delay;
+    bool        has_src;
+    sockunion_t src;
+    el_t        stagger;
+    el_t        timeout;
+
+    net_connect_on_done_f *on_done;
+    data_t      priv;
+
+    net_connect_attempt_t attempts[NET_CONNECT_ADDRS_MAX];
+    net_connect_try_t     tries[NET_CONNECT_ADDRS_MAX];
+};
+
+void net_connect_sort_addrs(sockunion_t *addrs, int cnt)
+{
+    t_scope;
+    const sockunion_t *tmp = t_dup(addrs, cnt);
+    sa_family_t family = cnt ? addrs[0].family : AF_UNSPEC;
+    int first = 0;
+    int other = 0;
+
+    /* take alternately the next address of the family of the first one and
+     * the next address of another family, while there are some */
+    for (int pos = 0; pos < cnt; pos++) {
+        while (first < cnt && tmp[first].family != family) {
+            first++;
+        }
+        while (other < cnt && tmp[other].family == family) {
+            other++;
+        }
+        if (other >= cnt || (first < cnt && !(pos & 1))) {
+            addrs[pos] = tmp[first++];
+        } else {
+            addrs[pos] = tmp[other++];
+        }
+    }
+}
+
+static int64_t net_connect_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void net_connect_wipe(net_connect_t *nc, int keep)
+{
+    for (int i = 0; i < nc->started; i++) {
+        net_connect_try_t *t = &nc->tries[i];
+
+        el_unregister(&t->ev);
+        if (i != keep) {
+            p_close(&t->fd);
+        }
+    }
+    el_unregister(&nc->stagger);
+    el_unregister(&nc->timeout);
+}
+
+static void net_connect_done(net_connect_t *nc, int winner, int err)
+{
+    int fd = winner >= 0 ? nc->tries[winner].fd : -1;
+
+    net_connect_wipe(nc, winner);
+    (*nc->on_done)(fd, err, nc->attempts, nc->started, nc->priv);
+    p_delete(&nc);
+}
+
+static void net_connect_on_stagger(el_t ev, data_t priv);
+static int net_connect_on_event(el_t ev, int fd, short events, data_t priv);
+
+/* Start the next attempts until one is running, so that the attempts that
+ * fail immediately (ENETUNREACH, ...) do not wait for the delay. */
+static void net_connect_next(net_connect_t *nc)
+{
+    el_unregister(&nc->stagger);
+    while (nc->started < nc->cnt) {
+        int i = nc->started++;
+        net_connect_try_t *t = &nc->tries[i];
+        net_connect_attempt_t *attempt = &nc->attempts[i];
+
+        t->nc    = nc;
+        t->start = net_connect_now();
+        t->fd    = connectx_as(-1, &attempt->su, 1,
+                               nc->has_src ? &nc->src : NULL,
+                               SOCK_STREAM, IPPROTO_TCP, O_NONBLOCK, 0);
+        if (t->fd < 0) {
+            attempt->latency = net_connect_now() - t->start;
+            attempt->err = errno;
+            continue;
+        }
+        t->ev = el_fd_register(t->fd, false, POLLOUT,
+                               &net_connect_on_event, t);
+        nc->running++;
+        break;
+    }
+    if (nc->started < nc->cnt) {
+        nc->stagger = el_timer_register(nc->delay, 0, 0,
+                                        &net_connect_on_stagger, nc);
+    }
+}
+
+static void net_connect_on_stagger(el_t ev, data_t priv)
+{
+    net_connect_t *nc = priv.ptr;
+
+    /* the one-shot timer is unregistered by the event loop */
+    nc->stagger = NULL;
+    net_connect_next(nc);
+    if (!nc->running) {
+        net_connect_done(nc, -1, nc->attempts[nc->started - 1].err);
+    }
+}
+
+static int net_connect_on_event(el_t ev, int fd, short events, data_t priv)
+{
+    net_connect_try_t *t = priv.ptr;
+    net_connect_t *nc = t->nc;
+    int i = t - nc->tries;
+    int res = socket_connect_status(fd);
+
+    if (res == 0) {
+        return 0;
+    }
+    nc->attempts[i].latency = net_connect_now() - t->start;
+    if (res > 0) {
+        net_connect_done(nc, i, 0);
+        return 0;
+    }
+
+    nc->attempts[i].err = errno;
+    el_unregister(&t->ev);
+    p_close(&t->fd);
+    if (!--nc->running) {
+        /* do not wait for the delay when the last attempt failed */
+        net_connect_next(nc);
+    }
+    if (!nc->running) {
+        net_connect_done(nc, -1, nc->attempts[nc->started - 1].err);
+    }
+    return 0;
+}
+
+static void net_connect_on_timeout(el_t ev, data_t priv)
+{
+    net_connect_t *nc = priv.ptr;
+
+    /* the one-shot timer is unregistered by the event loop */
+    nc->timeout = NULL;
+    for (int i = 0; i < nc->started; i++) {
+        if (nc->tries[i].ev) {
+            nc->attempts[i].err = ETIMEDOUT;
+        }
+    }
+    net_connect_done(nc, -1, ETIMEDOUT);
+}
+
+net_connect_t *
+net_connect_start(const sockunion_t *addrs, int cnt,
+                  const sockunion_t *src, int delay, int timeout,
+                  net_connect_on_done_f *on_done, data_t priv)
+{
+    net_connect_t *nc = p_new(net_connect_t, 1);
+
+    nc->cnt     = MIN(cnt, NET_CONNECT_ADDRS_MAX);
+    nc->delay   = delay ?: NET_CONNECT_DELAY_DFL;
+    nc->on_done = on_done;
+    nc->priv    = priv;
+    if (src) {
+        nc->has_src = true;
+        nc->src = *src;
+    }
+    for (int i = 0; i < nc->cnt; i++) {
+        nc->attempts[i].su = addrs[i];
+        nc->attempts[i].latency = -1;
+    }
+
+    net_connect_next(nc);
+    if (!nc->running) {
+        int err = nc->started ? nc->attempts[nc->started - 1].err : EINVAL;
+
+        p_delete(&nc);
+        errno = err;
+        return NULL;
+    }
+    if (timeout > 0) {
+        nc->timeout = el_timer_register(timeout, 0, 0,
+                                        &net_connect_on_timeout, nc);
+    }
+    return nc;
+}
+
+void net_connect_cancel(net_connect_t **ncp)
+{
+    if (*ncp) {
+        net_connect_wipe(*ncp, -1);
+        p_delete(ncp);
+    }
+}
@@ -0,0 +1,97 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#if !defined(IS_LIB_COMMON_NET_H) || defined(IS_LIB_COMMON_NET_CONNECT_H)
+#  error "you must include net.h instead"
+#else
+#define IS_LIB_COMMON_NET_CONNECT_H
+
+/* Parallel connections
+ * ~~~~~~~~~~~~~~~~~~~~
+ *
+ * A parallel connection races non-blocking TCP connections to several
+ * addresses of the same service in the event loop, the way of the "happy
+ * eyeballs" of RFC 8305:
+ *  - the addresses are reordered so that the address families alternate;
+ *  - a new attempt is started every `delay` milliseconds, or as soon as the
+ *    last started one fails, while the previous ones go on;
+ *  - the first established connection wins, the other attempts are
+ *    cancelled.
+ *
+ * So an unreachable (blackholed) address only delays the connection by
+ * `delay` instead of a full connection timeout.
+ */
+
+#define NET_CONNECT_ADDRS_MAX   16
+#define NET_CONNECT_DELAY_DFL   250
+
+typedef struct net_connect_t net_connect_t;
+
+typedef struct net_connect_attempt_t {
+    sockunion_t su;
+    /** Time from the start of the attempt to its completion in µs, -1 if
+     * the attempt was not started or was cancelled. */
+    int64_t     latency;
+    /** errno of the failed attempt, 0 otherwise. */
+    int         err;
+} net_connect_attempt_t;
+
+/** Callback called once the parallel connection is done.
+ *
+ * \param[in] fd        the connected non-blocking socket, owned by the
+ *                      callback, -1 if all the attempts failed.
+ * \param[in] err       the errno of the failure when fd is -1 (ETIMEDOUT
+ *                      when the timeout expired).
+ * \param[in] attempts  the attempts in the order they were started.
+ *
+ * The connector is destroyed when the callback returns.
+ */
+typedef void (net_connect_on_done_f)(int fd, int err,
+                                     const net_connect_attempt_t * nonnull
+                                     attempts, int count, data_t priv);
+
+/** Reorder addresses so that the address families alternate.
+ *
+ * The first address keeps its place and the relative order of the addresses
+ * of each family is kept, as recommended by RFC 8305 section 4.
+ */
+void net_connect_sort_addrs(sockunion_t * nonnull addrs, int cnt);
+
+/** Start a parallel TCP connection.
+ *
+ * \param[in] addrs    the addresses to connect to, reordered with
+ *                     net_connect_sort_addrs(); at most
+ *                     NET_CONNECT_ADDRS_MAX are used.
+ * \param[in] src      the source address, NULL for any.
+ * \param[in] delay    the delay between the starts of two attempts in ms,
+ *                     NET_CONNECT_DELAY_DFL if 0.
+ * \param[in] timeout  the timeout of the whole connection in ms, no timeout
+ *                     if 0.
+ *
+ * \return the connector, NULL with errno set when no attempt could be
+ *         started; the callback is never called synchronously.
+ */
+net_connect_t * nullable
+net_connect_start(const sockunion_t * nonnull addrs, int cnt,
+                  const sockunion_t * nullable src, int delay, int timeout,
+                  net_connect_on_done_f * nonnull on_done, data_t priv);
+
+/** Cancel a parallel connection, the callback is not called. */
+void net_connect_cancel(net_connect_t * nullable * nonnull nc);
+
+#endif
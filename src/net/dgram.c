@@ -0,0 +1,281 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/container-qvector.h>
+#include <lib-common/el.h>
+#include <lib-common/net.h>
+#include <lib-common/unix.h>
+
+typedef struct net_dgram_out_t {
+    int         offset;
+    int         len;
+    socklen_t   su_len;
+    sockunion_t su;
+} net_dgram_out_t;
+qvector_t(net_dgram_out, net_dgram_out_t);
+
+struct net_dgram_t {
+    el_t   ev;
+    el_t   before;
+    int    batch;
+    int    mtu;
+    net_dgram_on_recv_f *on_recv;
+    data_t priv;
+
+    /* frames of the received batches */
+    mem_pool_t *ring;
+    const void *frame;
+    bool        keep_frame : 1;
+    bool        in_recv    : 1;
+    bool        deleted    : 1;
+
+    /* send queue, waits for POLLOUT when blocked */
+    bool        blocked    : 1;
+    sb_t        out;
+    qv_t(net_dgram_out) queue;
+
+    net_dgram_stats_t stats;
+};
+
+/* {{{ Reception */
+
+static void net_dgram_destroy(net_dgram_t *dg)
+{
+    mem_ring_delete(&dg->ring);
+    sb_wipe(&dg->out);
+    qv_wipe(&dg->queue);
+    p_delete(&dg);
+}
+
+static void net_dgram_recv(net_dgram_t *dg, int fd)
+{
+    struct mmsghdr  hdrs[NET_DGRAM_BATCH_MAX];
+    struct iovec    iov[NET_DGRAM_BATCH_MAX];
+    net_dgram_msg_t msgs[NET_DGRAM_BATCH_MAX];
+    const void *frame;
+    byte *buf;
+    int res;
+
+    dg->frame = mem_ring_newframe(dg->ring);
+    buf = mp_new_raw(dg->ring, byte, dg->batch * dg->mtu);
+    for (int i = 0; i < dg->batch; i++) {
+        iov[i] = MAKE_IOVEC(buf + i * dg->mtu, dg->mtu);
+        hdrs[i] = (struct mmsghdr){
+            .msg_hdr = {
+                .msg_name    = &msgs[i].su,
+                .msg_namelen = sizeof(msgs[i].su),
+                .msg_iov     = &iov[i],
+                .msg_iovlen  = 1,
+            },
+        };
+    }
+
+    res = recvmmsg(fd, hdrs, dg->batch, MSG_DONTWAIT, NULL);
+    dg->stats.recv_calls++;
+    if (res > 0) {
+        for (int i = 0; i < res; i++) {
+            msgs[i].data = LSTR_INIT_V((const char *)iov[i].iov_base,
+                                       hdrs[i].msg_len);
+            msgs[i].truncated = hdrs[i].msg_hdr.msg_flags & MSG_TRUNC;
+        }
+        dg->stats.recv_msgs += res;
+        dg->keep_frame = false;
+        dg->in_recv = true;
+        (*dg->on_recv)(dg, msgs, res, dg->priv);
+        dg->in_recv = false;
+    }
+
+    frame = mem_ring_seal(dg->ring);
+    if (!dg->keep_frame) {
+        mem_ring_release(frame);
+    }
+    dg->frame = NULL;
+    dg->keep_frame = false;
+    if (dg->deleted) {
+        net_dgram_destroy(dg);
+    }
+}
+
+const void *net_dgram_keep_frame(net_dgram_t *dg)
+{
+    assert (dg->in_recv);
+    dg->keep_frame = true;
+    return dg->frame;
+}
+
+/* }}} */
+/* {{{ Emission */
+
+int net_dgram_flush(net_dgram_t *dg)
+{
+    int fd = el_fd_get_fd(dg->ev);
+    int sent = 0;
+    int skip;
+
+    while (sent < dg->queue.len) {
+        struct mmsghdr hdrs[NET_DGRAM_BATCH_MAX];
+        struct iovec   iov[NET_DGRAM_BATCH_MAX];
+        int count = MIN(dg->queue.len - sent, dg->batch);
+        int res;
+
+        for (int i = 0; i < count; i++) {
+            net_dgram_out_t *out = &dg->queue.tab[sent + i];
+
+            iov[i] = MAKE_IOVEC(dg->out.data + out->offset, out->len);
+            hdrs[i] = (struct mmsghdr){
+                .msg_hdr = {
+                    .msg_name    = out->su_len ? &out->su : NULL,
+                    .msg_namelen = out->su_len,
+                    .msg_iov     = &iov[i],
+                    .msg_iovlen  = 1,
+                },
+            };
+        }
+
+        res = sendmmsg(fd, hdrs, count, MSG_DONTWAIT);
+        dg->stats.send_calls++;
+        if (res < 0) {
+            if (ERR_RW_RETRIABLE(errno)) {
+                break;
+            }
+            /* the first datagram is rejected (ECONNREFUSED, EMSGSIZE, ...),
+             * drop it and go on with the next ones */
+            dg->stats.send_errors++;
+            sent++;
+            continue;
+        }
+        dg->stats.send_msgs += res;
+        sent += res;
+    }
+
+    if (sent == dg->queue.len) {
+        qv_clear(&dg->queue);
+        sb_reset(&dg->out);
+    } else {
+        skip = dg->queue.tab[sent].offset;
+        qv_splice(&dg->queue, 0, sent, NULL, 0);
+        tab_for_each_ptr(out, &dg->queue) {
+            out->offset -= skip;
+        }
+        sb_skip(&dg->out, skip);
+    }
+
+    dg->blocked = dg->queue.len > 0;
+    el_fd_set_mask(dg->ev, dg->blocked ? POLLIN | POLLOUT : POLLIN);
+    return dg->queue.len;
+}
+
+void net_dgram_send(net_dgram_t *dg, const sockunion_t *su,
+                    const void *data, int len)
+{
+    net_dgram_out_t *out = qv_growlen(&dg->queue, 1);
+
+    out->offset = dg->out.len;
+    out->len    = len;
+    if (su) {
+        out->su_len = sockunion_len(su);
+        p_copy(&out->su, su, 1);
+    } else {
+        out->su_len = 0;
+    }
+    sb_add(&dg->out, data, len);
+
+    if (dg->queue.len >= dg->batch && !dg->blocked) {
+        net_dgram_flush(dg);
+    }
+}
+
+static void net_dgram_on_before(el_t ev, data_t priv)
+{
+    net_dgram_t *dg = priv.ptr;
+
+    if (dg->queue.len && !dg->blocked) {
+        net_dgram_flush(dg);
+    }
+}
+
+/* }}} */
+/* {{{ Life cycle */
+
+static int net_dgram_on_event(el_t ev, int fd, short events, data_t priv)
+{
+    net_dgram_t *dg = priv.ptr;
+
+    if (events & POLLOUT) {
+        net_dgram_flush(dg);
+    }
+    if (events & POLLIN) {
+        net_dgram_recv(dg, fd);
+    }
+    return 0;
+}
+
+net_dgram_t *net_dgram_new(int fd, int batch, int mtu,
+                           net_dgram_on_recv_f *on_recv, data_t priv)
+{
+    net_dgram_t *dg = p_new(net_dgram_t, 1);
+
+    assert (0 < batch && batch <= NET_DGRAM_BATCH_MAX);
+    dg->batch   = batch;
+    dg->mtu     = mtu;
+    dg->on_recv = on_recv;
+    dg->priv    = priv;
+    dg->ring    = mem_ring_new("net-dgram", batch * mtu);
+    sb_init(&dg->out);
+    qv_init(&dg->queue);
+
+    dg->ev = el_fd_register_d(fd, true, POLLIN, &net_dgram_on_event,
+                              (data_t){ .ptr = dg });
+    dg->before = el_before_register(&net_dgram_on_before, dg);
+    el_unref(dg->before);
+    return dg;
+}
+
+void net_dgram_delete(net_dgram_t **dgp)
+{
+    net_dgram_t *dg = *dgp;
+
+    if (!dg) {
+        return;
+    }
+    if (dg->queue.len && !dg->blocked) {
+        net_dgram_flush(dg);
+    }
+    el_unregister(&dg->before);
+    el_fd_unregister(&dg->ev);
+    *dgp = NULL;
+
+    if (dg->in_recv) {
+        /* destroyed once the receive callback returns */
+        dg->deleted = true;
+        return;
+    }
+    net_dgram_destroy(dg);
+}
+
+int net_dgram_get_fd(const net_dgram_t *dg)
+{
+    return el_fd_get_fd(dg->ev);
+}
+
+void net_dgram_get_stats(const net_dgram_t *dg, net_dgram_stats_t *stats)
+{
+    *stats = dg->stats;
+}
+
+/* }}} */
@@ -0,0 +1,117 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#if !defined(IS_LIB_COMMON_NET_H) || defined(IS_LIB_COMMON_NET_DGRAM_H)
+#  error "you must include net.h instead"
+#else
+#define IS_LIB_COMMON_NET_DGRAM_H
+
+/* Datagram endpoints
+ * ~~~~~~~~~~~~~~~~~~
+ *
+ * A datagram endpoint wraps a datagram (UDP, unix) or a one-to-many SCTP
+ * socket registered in the event loop, and batches its I/O:
+ *  - each time the socket is readable, up to `batch` datagrams are received
+ *    with a single recvmmsg() into a frame of a ring pool, and passed at once
+ *    to the receive callback;
+ *  - the datagrams sent with net_dgram_send() are queued and sent by
+ *    sendmmsg() before the event loop waits for events (or as soon as a
+ *    batch is full).
+ *
+ * The ancillary data (SCTP notifications and stream information, ...) is not
+ * handled.
+ */
+
+#define NET_DGRAM_BATCH_MAX  64
+
+typedef struct net_dgram_t net_dgram_t;
+
+typedef struct net_dgram_msg_t {
+    lstr_t      data;
+    sockunion_t su;         /* source address of the datagram */
+    bool        truncated;  /* the datagram was bigger than the mtu */
+} net_dgram_msg_t;
+
+typedef struct net_dgram_stats_t {
+    uint64_t recv_calls;
+    uint64_t recv_msgs;
+    uint64_t send_calls;
+    uint64_t send_msgs;
+    uint64_t send_errors;   /* datagrams rejected by the kernel */
+} net_dgram_stats_t;
+
+/** Callback called with each batch of received datagrams.
+ *
+ * The data of the datagrams lives in the frame of the batch, that is
+ * released when the callback returns unless it calls net_dgram_keep_frame().
+ */
+typedef void (net_dgram_on_recv_f)(net_dgram_t * nonnull dg,
+                                   const net_dgram_msg_t * nonnull msgs,
+                                   int count, data_t priv);
+
+/** Create a datagram endpoint.
+ *
+ * \param[in] fd       the socket, owned by the endpoint.
+ * \param[in] batch    the maximum number of datagrams received or sent per
+ *                     system call, at most NET_DGRAM_BATCH_MAX.
+ * \param[in] mtu      the maximum size of the received datagrams.
+ * \param[in] on_recv  the receive callback.
+ * \param[in] priv     the private data of the callback.
+ */
+net_dgram_t * nonnull net_dgram_new(int fd, int batch, int mtu,
+                                    net_dgram_on_recv_f * nonnull on_recv,
+                                    data_t priv);
+
+/** Delete a datagram endpoint, after a last attempt to send its queue.
+ *
+ * It can be called from the receive callback. The frames kept with
+ * net_dgram_keep_frame() must have been released before.
+ */
+void net_dgram_delete(net_dgram_t * nullable * nonnull dg);
+
+/** Keep the frame of the batch being received.
+ *
+ * To be called from the receive callback, to use the data of the datagrams
+ * after it returns (e.g. in a job of another thread).
+ *
+ * \return the frame, to release with mem_ring_release().
+ */
+const void * nonnull net_dgram_keep_frame(net_dgram_t * nonnull dg);
+
+/** Queue a datagram.
+ *
+ * \param[in] su    the destination, NULL for a connected socket.
+ * \param[in] data  the datagram, copied in the queue.
+ */
+void net_dgram_send(net_dgram_t * nonnull dg, const sockunion_t * nullable su,
+                    const void * nonnull data, int len);
+
+/** Send the queued datagrams now.
+ *
+ * \return the number of datagrams still queued because the socket is full,
+ *         they are sent when it becomes writable again.
+ */
+int net_dgram_flush(net_dgram_t * nonnull dg);
+
+/** Get the file descriptor of a datagram endpoint. */
+int net_dgram_get_fd(const net_dgram_t * nonnull dg);
+
+void net_dgram_get_stats(const net_dgram_t * nonnull dg,
+                         net_dgram_stats_t * nonnull stats);
+
+#endif
@@ -0,0 +1,1102 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <pthread.h>
+
+#include <lib-common/arith.h>
+#include <lib-common/container-qhash.h>
+#include <lib-common/el.h>
+#include <lib-common/log.h>
+#include <lib-common/net.h>
+#include <lib-common/unix.h>
+
+#define DNS_TYPE_A        1
+#define DNS_TYPE_CNAME    5
+#define DNS_TYPE_SOA      6
+#define DNS_TYPE_AAAA    28
+#define DNS_CLASS_IN      1
+
+#define DNS_FLAG_QR       0x8000
+#define DNS_FLAG_TC       0x0200
+#define DNS_FLAG_RD       0x0100
+#define DNS_RCODE_MASK    0x000f
+#define DNS_RCODE_NXDOMAIN     3
+
+#define DNS_PORT          53
+#define DNS_NAME_MAX     253
+#define DNS_LABEL_MAX     63
+#define DNS_TTL_MAX    86400
+#define DNS_CACHE_MAX   4096
+
+typedef struct dns_addr_t {
+    sa_family_t family;
+    union {
+        struct in_addr  v4;
+        struct in6_addr v6;
+    };
+} dns_addr_t;
+
+typedef struct dns_entry_t dns_entry_t;
+
+/* A question of a resolution, there are two of them (A and AAAA) for
+ * AF_UNSPEC. */
+typedef struct dns_question_t {
+    dns_entry_t *e;
+    uint16_t     id;
+    uint16_t     qtype;
+    bool         done;
+
+    /* TCP fallback when the answer is truncated */
+    el_t         tcp;
+    sb_t         tcp_buf;
+    int          tcp_sent;
+
+    int          err;
+    int          cnt;
+    uint32_t     ttl;
+    dns_addr_t   addrs[DNS_ADDRS_MAX];
+} dns_question_t;
+
+struct dns_query_t {
+    dlist_t          link;
+    in_port_t        port;
+    dns_on_result_f *cb;
+    data_t           priv;
+};
+
+struct dns_entry_t {
+    lstr_t      key;
+    lstr_t      name;       /* points in the key */
+    sa_family_t af;
+    bool        from_hosts;
+
+    /* cached answer, err is ENOENT for the unknown names */
+    int         err;
+    int         cnt;
+    int64_t     expiry;     /* ms, 0 if never resolved */
+    dns_addr_t  addrs[DNS_ADDRS_MAX];
+
+    /* running resolution */
+    bool        running;
+    int         attempt;
+    int64_t     start;
+    el_t        timer;
+    int         nb_questions;
+    dns_question_t questions[2];
+    dlist_t     waiters;
+};
+
+qm_kvec_t(dns_cache, lstr_t, dns_entry_t * nonnull,
+          qhash_lstr_hash, qhash_lstr_equal);
+qm_k32_t(dns_ids, dns_question_t * nonnull);
+
+static struct {
+    logger_t    logger;
+    pthread_t   thread;
+
+    sockunion_t servers[DNS_SERVERS_MAX];
+    el_t        socks[DNS_SERVERS_MAX];
+    int         nb_servers;
+    int         timeout;    /* ms, for each attempt */
+    int         attempts;   /* on each server */
+
+    qm_t(dns_cache) cache;
+    qm_t(dns_ids)   ids;
+    dns_stats_t stats;
+} dns_g = {
+    .logger = LOGGER_INIT_INHERITS(NULL, "dns"),
+    .cache  = QM_INIT(dns_cache, dns_g.cache),
+    .ids    = QM_INIT(dns_ids, dns_g.ids),
+};
+#define _G  dns_g
+
+static int64_t dns_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* {{{ Names and addresses */
+
+static int dns_parse_addr(lstr_t s, dns_addr_t *addr)
+{
+    t_scope;
+    const char *str = t_dupz(s.s, s.len);
+
+    p_clear(addr, 1);
+    if (inet_pton(AF_INET, str, &addr->v4) == 1) {
+        addr->family = AF_INET;
+        return 0;
+    }
+    if (inet_pton(AF_INET6, str, &addr->v6) == 1) {
+        addr->family = AF_INET6;
+        return 0;
+    }
+    return -1;
+}
+
+static void dns_addr_to_su(const dns_addr_t *addr, in_port_t port,
+                           sockunion_t *su)
+{
+    p_clear(su, 1);
+    su->family = addr->family;
+    if (addr->family == AF_INET) {
+        su->sin.sin_addr = addr->v4;
+    } else {
+        su->sin6.sin6_addr = addr->v6;
+    }
+    sockunion_setport(su, port);
+}
+
+/* Only the host names are resolved, the other strings (numeric IPv6
+ * addresses with a scope, service names...) are left to getaddrinfo(). */
+static int dns_check_name(lstr_t name)
+{
+    int label = 0;
+
+    if (!name.len || name.len > DNS_NAME_MAX) {
+        return -1;
+    }
+    for (int i = 0; i < name.len; i++) {
+        int c = (unsigned char)name.s[i];
+
+        if (c == '.') {
+            THROW_ERR_IF(!label);
+            label = 0;
+            continue;
+        }
+        THROW_ERR_IF(!isalnum(c) && c != '-' && c != '_');
+        THROW_ERR_IF(++label > DNS_LABEL_MAX);
+    }
+    return 0;
+}
+
+/* Read the name at the position of ps in the message, following the
+ * compression pointers. */
+static int dns_get_name(pstream_t msg, pstream_t *ps, sb_t *out)
+{
+    pstream_t cur = *ps;
+    bool jumped = false;
+    int hops = 0;
+
+    sb_reset(out);
+    for (;;) {
+        int len = RETHROW(ps_getc(&cur));
+
+        if (len == 0) {
+            break;
+        }
+        if ((len & 0xc0) == 0xc0) {
+            int off = RETHROW(ps_getc(&cur)) | ((len & 0x3f) << 8);
+
+            if (!jumped) {
+                *ps = cur;
+                jumped = true;
+            }
+            THROW_ERR_IF(++hops > 64 || off >= (int)ps_len(&msg));
+            cur = msg;
+            __ps_skip(&cur, off);
+            continue;
+        }
+        THROW_ERR_IF(len & 0xc0);
+        THROW_ERR_IF(!ps_has(&cur, len) || out->len + len >= DNS_NAME_MAX);
+        if (out->len) {
+            sb_addc(out, '.');
+        }
+        sb_add(out, cur.s, len);
+        __ps_skip(&cur, len);
+    }
+    if (!jumped) {
+        *ps = cur;
+    }
+    return 0;
+}
+
+static void dns_add_query(sb_t *out, uint16_t id, lstr_t name, uint16_t qtype)
+{
+    pstream_t ps = ps_initlstr(&name);
+
+    sb_add_be16(out, id);
+    sb_add_be16(out, DNS_FLAG_RD);
+    sb_add_be16(out, 1);
+    sb_add_be16(out, 0);
+    sb_add_be16(out, 0);
+    sb_add_be16(out, 0);
+    while (!ps_done(&ps)) {
+        pstream_t label;
+
+        if (ps_get_ps_chr_and_skip(&ps, '.', &label) < 0) {
+            label = ps;
+            ps = ps_init(ps.s_end, 0);
+        }
+        sb_addc(out, ps_len(&label));
+        sb_add(out, label.s, ps_len(&label));
+    }
+    sb_addc(out, 0);
+    sb_add_be16(out, qtype);
+    sb_add_be16(out, DNS_CLASS_IN);
+}
+
+/* }}} */
+/* {{{ Cache */
+
+static bool dns_entry_is_fresh(const dns_entry_t *e)
+{
+    return e->expiry && e->expiry > dns_now();
+}
+
+static void dns_question_stop(dns_question_t *q)
+{
+    if (q->id) {
+        qm_del_key(dns_ids, &_G.ids, q->id);
+        q->id = 0;
+    }
+    el_unregister(&q->tcp);
+    sb_wipe(&q->tcp_buf);
+}
+
+static void dns_entry_delete(dns_entry_t **ep)
+{
+    dns_entry_t *e = *ep;
+
+    if (!e) {
+        return;
+    }
+    for (int i = 0; i < e->nb_questions; i++) {
+        dns_question_stop(&e->questions[i]);
+    }
+    el_unregister(&e->timer);
+    dlist_for_each_entry(dns_query_t, q, &e->waiters, link) {
+        p_delete(&q);
+    }
+    lstr_wipe(&e->key);
+    p_delete(ep);
+}
+
+/* Remove the idle entries, only the expired ones if expired_only is set;
+ * the entries of /etc/hosts are kept. */
+static void dns_cache_clear(bool expired_only)
+{
+    int64_t now = dns_now();
+
+    qm_for_each_pos(dns_cache, pos, &_G.cache) {
+        dns_entry_t *e = _G.cache.values[pos];
+
+        if (e->running || e->from_hosts
+        ||  (expired_only && e->expiry > now))
+        {
+            continue;
+        }
+        qm_del_at(dns_cache, &_G.cache, pos);
+        dns_entry_delete(&e);
+    }
+}
+
+static dns_entry_t *dns_entry_get(lstr_t host, sa_family_t af)
+{
+    t_scope;
+    lstr_t name = host;
+    lstr_t key;
+    dns_entry_t *e;
+    int pos;
+
+    if (name.len && name.s[name.len - 1] == '.') {
+        name.len--;
+    }
+    if (dns_check_name(name) < 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    key = t_lstr_fmt("%d/%*pM", af, LSTR_FMT_ARG(name));
+    lstr_ascii_tolower(&key);
+    pos = qm_find(dns_cache, &_G.cache, &key);
+    if (pos >= 0) {
+        return _G.cache.values[pos];
+    }
+
+    if (qm_len(dns_cache, &_G.cache) >= DNS_CACHE_MAX) {
+        dns_cache_clear(true);
+        if (qm_len(dns_cache, &_G.cache) >= DNS_CACHE_MAX) {
+            dns_cache_clear(false);
+        }
+    }
+    e = p_new(dns_entry_t, 1);
+    e->key  = lstr_dup(key);
+    e->name = LSTR_INIT_V(e->key.s + key.len - name.len, name.len);
+    e->af   = af;
+    dlist_init(&e->waiters);
+    qm_add(dns_cache, &_G.cache, &e->key, e);
+    return e;
+}
+
+static void dns_query_deliver(dns_query_t *q, const dns_addr_t *addrs,
+                              int cnt, int err)
+{
+    t_scope;
+    sockunion_t *sus = t_new_raw(sockunion_t, MAX(cnt, 1));
+    dns_on_result_f *cb = q->cb;
+    data_t priv = q->priv;
+
+    for (int i = 0; i < cnt; i++) {
+        dns_addr_to_su(&addrs[i], q->port, &sus[i]);
+    }
+    p_delete(&q);
+    (*cb)(cnt ? sus : NULL, cnt, err, priv);
+}
+
+/* Call the waiters of a resolution; they may start other resolutions,
+ * cancel the other waiters or flush the cache. */
+static void dns_entry_deliver(dns_entry_t *e, int err)
+{
+    t_scope;
+    int cnt = err ? 0 : e->cnt;
+    const dns_addr_t *addrs = t_dup(e->addrs, cnt);
+    dlist_t waiters = DLIST_INIT(waiters);
+
+    dlist_splice(&waiters, &e->waiters);
+    while (!dlist_is_empty(&waiters)) {
+        dns_query_t *q = dlist_first_entry(&waiters, dns_query_t, link);
+
+        dlist_remove(&q->link);
+        dns_query_deliver(q, addrs, cnt, err);
+    }
+}
+
+/* }}} */
+/* {{{ Resolutions */
+
+static int dns_on_udp(el_t ev, int fd, short events, data_t priv);
+
+static el_t dns_server_sock(int srv)
+{
+    if (!_G.socks[srv]) {
+        int fd = connectx(-1, &_G.servers[srv], 1, SOCK_DGRAM, IPPROTO_UDP,
+                          O_NONBLOCK);
+
+        if (fd < 0) {
+            logger_warning(&_G.logger, "cannot connect to name server %s: "
+                           "%m", t_addr_fmt(&_G.servers[srv], NULL));
+            return NULL;
+        }
+        _G.socks[srv] = el_fd_register_d(fd, true, POLLIN, &dns_on_udp,
+                                         DATA_U32(srv));
+        el_unref(_G.socks[srv]);
+    }
+    return _G.socks[srv];
+}
+
+static int dns_question_send(dns_question_t *q, int srv)
+{
+    SB_1k(buf);
+    el_t sock = dns_server_sock(srv);
+
+    el_unregister(&q->tcp);
+    if (!sock) {
+        return -1;
+    }
+    dns_add_query(&buf, q->id, q->e->name, q->qtype);
+    if (send(el_fd_get_fd(sock), buf.data, buf.len, 0) < 0) {
+        return -1;
+    }
+    _G.stats.queries++;
+    return 0;
+}
+
+/* Send the unanswered questions to the server of the current attempt.
+ *
+ * \return the number of questions sent.
+ */
+static int dns_entry_send(dns_entry_t *e)
+{
+    int srv;
+    int sent = 0;
+
+    if (!_G.nb_servers) {
+        return 0;
+    }
+    srv = e->attempt % _G.nb_servers;
+    for (int i = 0; i < e->nb_questions; i++) {
+        dns_question_t *q = &e->questions[i];
+
+        if (!q->done && dns_question_send(q, srv) >= 0) {
+            sent++;
+        }
+    }
+    return sent;
+}
+
+static void dns_entry_finish(dns_entry_t *e)
+{
+    int64_t now = dns_now();
+    int64_t latency = now - e->start;
+    uint32_t ttl = DNS_TTL_MAX;
+    int cnt = 0;
+    int err = ENOENT;
+
+    for (int i = 0; i < e->nb_questions; i++) {
+        dns_question_t *q = &e->questions[i];
+
+        dns_question_stop(q);
+        if (q->cnt) {
+            int n = MIN(q->cnt, DNS_ADDRS_MAX - cnt);
+
+            p_copy(e->addrs + cnt, q->addrs, n);
+            cnt += n;
+            err = 0;
+        } else
+        if (err == ENOENT && q->err != ENOENT) {
+            err = q->err;
+        }
+        if (q->cnt || q->err == ENOENT) {
+            ttl = MIN(ttl, q->ttl);
+        }
+    }
+    el_unregister(&e->timer);
+    e->running = false;
+
+    _G.stats.latency_sum += latency;
+    _G.stats.latency_hist[latency > 0 ? MIN(bsr64(latency) + 1,
+                                            DNS_LATENCY_BUCKETS) : 0]++;
+
+    switch (err) {
+      case 0:
+        /* the addresses of the questions are in e->addrs */
+        e->cnt = cnt;
+        /* FALLTHROUGH */
+      case ENOENT:
+        e->err = err;
+        e->expiry = now + ttl * 1000;
+        break;
+
+      default:
+        if (err == ETIMEDOUT) {
+            _G.stats.timeouts++;
+        } else {
+            _G.stats.failures++;
+        }
+        logger_trace(&_G.logger, 1, "cannot resolve `%pL`: %s", &e->name,
+                     strerror(err));
+        /* serve the stale addresses rather than nothing */
+        if (e->expiry && !e->err && e->cnt) {
+            err = 0;
+        }
+        break;
+    }
+    dns_entry_deliver(e, err);
+}
+
+static void dns_on_timer(el_t ev, data_t priv)
+{
+    dns_entry_t *e = priv.ptr;
+
+    if (++e->attempt >= _G.nb_servers * _G.attempts) {
+        for (int i = 0; i < e->nb_questions; i++) {
+            dns_question_t *q = &e->questions[i];
+
+            if (!q->done) {
+                q->done = true;
+                q->err  = q->err ?: ETIMEDOUT;
+            }
+        }
+        dns_entry_finish(e);
+        return;
+    }
+    dns_entry_send(e);
+}
+
+static void dns_question_init(dns_entry_t *e, uint16_t qtype)
+{
+    dns_question_t *q = &e->questions[e->nb_questions++];
+
+    p_clear(q, 1);
+    q->e     = e;
+    q->qtype = qtype;
+    sb_init(&q->tcp_buf);
+    do {
+        q->id = rand32();
+    } while (!q->id || qm_add(dns_ids, &_G.ids, q->id, q) < 0);
+}
+
+static int dns_entry_start(dns_entry_t *e)
+{
+    e->running = true;
+    e->attempt = 0;
+    e->start   = dns_now();
+    e->nb_questions = 0;
+    if (e->af != AF_INET6) {
+        dns_question_init(e, DNS_TYPE_A);
+    }
+    if (e->af != AF_INET) {
+        dns_question_init(e, DNS_TYPE_AAAA);
+    }
+
+    while (!dns_entry_send(e)) {
+        if (++e->attempt >= _G.nb_servers * _G.attempts) {
+            for (int i = 0; i < e->nb_questions; i++) {
+                dns_question_stop(&e->questions[i]);
+            }
+            e->running = false;
+            _G.stats.failures++;
+            errno = EAGAIN;
+            return -1;
+        }
+    }
+    e->timer = el_timer_register(_G.timeout, _G.timeout, 0, &dns_on_timer,
+                                 e);
+    return 0;
+}
+
+/* }}} */
+/* {{{ Answers */
+
+/* TTL of a negative answer, see RFC 2308: the TTL of the SOA record of the
+ * authority section, bounded by its minimum field. */
+static uint32_t dns_negative_ttl(pstream_t msg, pstream_t ps, int nscount)
+{
+    SB_1k(name);
+
+    for (int i = 0; i < nscount; i++) {
+        uint16_t type;
+        uint16_t class;
+        uint32_t ttl;
+        uint32_t minimum;
+        uint16_t rdlen;
+        pstream_t rdata;
+
+        if (dns_get_name(msg, &ps, &name) < 0
+        ||  ps_get_be16(&ps, &type) < 0 || ps_get_be16(&ps, &class) < 0
+        ||  ps_get_be32(&ps, &ttl) < 0 || ps_get_be16(&ps, &rdlen) < 0
+        ||  ps_get_ps(&ps, rdlen, &rdata) < 0)
+        {
+            break;
+        }
+        if (type != DNS_TYPE_SOA) {
+            continue;
+        }
+        /* mname, rname, serial, refresh, retry, expire, minimum */
+        if (dns_get_name(msg, &rdata, &name) < 0
+        ||  dns_get_name(msg, &rdata, &name) < 0
+        ||  ps_skip(&rdata, 16) < 0 || ps_get_be32(&rdata, &minimum) < 0)
+        {
+            break;
+        }
+        return MIN3(ttl, minimum, DNS_TTL_MAX);
+    }
+    return DNS_NEGATIVE_TTL_DFL;
+}
+
+/* Get the addresses of the answer section, following the CNAME chain of
+ * the name. */
+static int dns_parse_answers(dns_question_t *q, pstream_t msg,
+                             pstream_t *ps, int ancount)
+{
+    t_scope;
+    SB_1k(owner);
+    lstr_t current = q->e->name;
+
+    for (int i = 0; i < ancount; i++) {
+        uint16_t type;
+        uint16_t class;
+        uint32_t ttl;
+        uint16_t rdlen;
+        pstream_t rdata;
+
+        if (dns_get_name(msg, ps, &owner) < 0
+        ||  ps_get_be16(ps, &type) < 0 || ps_get_be16(ps, &class) < 0
+        ||  ps_get_be32(ps, &ttl) < 0 || ps_get_be16(ps, &rdlen) < 0
+        ||  ps_get_ps(ps, rdlen, &rdata) < 0)
+        {
+            return -1;
+        }
+        /* the TTLs with the high bit set are 0, see RFC 2181 */
+        ttl = ttl > INT32_MAX ? 0 : MIN(ttl, DNS_TTL_MAX);
+        if (class != DNS_CLASS_IN
+        ||  !lstr_ascii_iequal(LSTR_SB_V(&owner), current))
+        {
+            continue;
+        }
+
+        if (type == DNS_TYPE_CNAME) {
+            RETHROW(dns_get_name(msg, &rdata, &owner));
+            current = t_lstr_dup(LSTR_SB_V(&owner));
+            q->ttl = MIN(q->ttl, ttl);
+        } else
+        if (type == q->qtype && q->cnt < DNS_ADDRS_MAX) {
+            dns_addr_t *addr = &q->addrs[q->cnt];
+
+            p_clear(addr, 1);
+            if (type == DNS_TYPE_A && ps_len(&rdata) == 4) {
+                addr->family = AF_INET;
+                memcpy(&addr->v4, rdata.s, 4);
+            } else
+            if (type == DNS_TYPE_AAAA && ps_len(&rdata) == 16) {
+                addr->family = AF_INET6;
+                memcpy(&addr->v6, rdata.s, 16);
+            } else {
+                continue;
+            }
+            q->cnt++;
+            q->ttl = MIN(q->ttl, ttl);
+        }
+    }
+    return 0;
+}
+
+static void dns_question_send_tcp(dns_question_t *q, int srv);
+
+static void dns_on_answer(pstream_t msg, int srv, bool tcp)
+{
+    SB_1k(name);
+    pstream_t ps = msg;
+    dns_question_t *q;
+    dns_entry_t *e;
+    uint16_t id;
+    uint16_t flags;
+    uint16_t qdcount;
+    uint16_t ancount;
+    uint16_t nscount;
+    uint16_t qtype;
+    int rcode;
+
+    if (ps_get_be16(&ps, &id) < 0 || ps_get_be16(&ps, &flags) < 0
+    ||  ps_get_be16(&ps, &qdcount) < 0 || ps_get_be16(&ps, &ancount) < 0
+    ||  ps_get_be16(&ps, &nscount) < 0 || ps_skip(&ps, 2) < 0)
+    {
+        return;
+    }
+    q = qm_get_def(dns_ids, &_G.ids, id, NULL);
+    if (!q || !(flags & DNS_FLAG_QR) || qdcount != 1) {
+        return;
+    }
+    /* the question must be ours */
+    if (dns_get_name(msg, &ps, &name) < 0
+    ||  !lstr_ascii_iequal(LSTR_SB_V(&name), q->e->name)
+    ||  ps_get_be16(&ps, &qtype) < 0 || qtype != q->qtype
+    ||  ps_skip(&ps, 2) < 0)
+    {
+        return;
+    }
+
+    if ((flags & DNS_FLAG_TC) && !tcp) {
+        dns_question_send_tcp(q, srv);
+        return;
+    }
+    rcode = flags & DNS_RCODE_MASK;
+    q->cnt = 0;
+    q->ttl = DNS_TTL_MAX;
+    if ((rcode != 0 && rcode != DNS_RCODE_NXDOMAIN)
+    ||  dns_parse_answers(q, msg, &ps, ancount) < 0)
+    {
+        /* SERVFAIL, REFUSED...: sent again at the next attempt */
+        q->cnt = 0;
+        q->err = EAGAIN;
+        el_unregister(&q->tcp);
+        return;
+    }
+    if (rcode == DNS_RCODE_NXDOMAIN) {
+        q->cnt = 0;
+    }
+    if (q->cnt) {
+        q->err = 0;
+    } else {
+        /* unknown name, or no address of this family */
+        q->err = ENOENT;
+        q->ttl = dns_negative_ttl(msg, ps, nscount);
+    }
+
+    q->done = true;
+    dns_question_stop(q);
+    e = q->e;
+    for (int i = 0; i < e->nb_questions; i++) {
+        if (!e->questions[i].done) {
+            return;
+        }
+    }
+    dns_entry_finish(e);
+}
+
+static int dns_on_udp(el_t ev, int fd, short events, data_t priv)
+{
+    char buf[4096];
+
+    for (int i = 0; i < 64; i++) {
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+
+        if (len < 0) {
+            break;
+        }
+        dns_on_answer(ps_init(buf, len), priv.u32, false);
+    }
+    return 0;
+}
+
+static int dns_on_tcp(el_t ev, int fd, short events, data_t priv)
+{
+    dns_question_t *q = priv.ptr;
+    pstream_t ps;
+    uint16_t len;
+    ssize_t res;
+
+    if (q->tcp_sent < q->tcp_buf.len) {
+        res = write(fd, q->tcp_buf.data + q->tcp_sent,
+                    q->tcp_buf.len - q->tcp_sent);
+
+        if (res < 0) {
+            if (ERR_RW_RETRIABLE(errno)) {
+                return 0;
+            }
+            goto error;
+        }
+        q->tcp_sent += res;
+        if (q->tcp_sent == q->tcp_buf.len) {
+            sb_reset(&q->tcp_buf);
+            el_fd_set_mask(ev, POLLIN);
+        }
+        return 0;
+    }
+
+    res = sb_read(&q->tcp_buf, fd, 0);
+    if (res < 0 && ERR_RW_RETRIABLE(errno)) {
+        return 0;
+    }
+    if (res <= 0) {
+        goto error;
+    }
+    ps = ps_initsb(&q->tcp_buf);
+    if (ps_get_be16(&ps, &len) < 0 || ps_len(&ps) < len) {
+        return 0;
+    }
+    /* q is not used after that, the entry can be deleted by its waiters */
+    dns_on_answer(__ps_get_ps(&ps, len), 0, true);
+    return 0;
+
+  error:
+    /* sent again over UDP at the next attempt */
+    q->err = EAGAIN;
+    el_unregister(&q->tcp);
+    return 0;
+}
+
+static void dns_question_send_tcp(dns_question_t *q, int srv)
+{
+    int fd;
+
+    el_unregister(&q->tcp);
+    fd = connectx_as(-1, &_G.servers[srv], 1, NULL, SOCK_STREAM,
+                     IPPROTO_TCP, O_NONBLOCK, 0);
+    if (fd < 0) {
+        q->err = EAGAIN;
+        return;
+    }
+    sb_reset(&q->tcp_buf);
+    sb_add_be16(&q->tcp_buf, 0);
+    dns_add_query(&q->tcp_buf, q->id, q->e->name, q->qtype);
+    put_unaligned_be16(q->tcp_buf.data, q->tcp_buf.len - 2);
+    q->tcp_sent = 0;
+    q->tcp = el_fd_register(fd, true, POLLOUT, &dns_on_tcp, q);
+    _G.stats.tcp_queries++;
+}
+
+/* }}} */
+/* {{{ API */
+
+static bool dns_is_own_thread(void)
+{
+    return MODULE_IS_LOADED(dns) && pthread_equal(pthread_self(), _G.thread);
+}
+
+dns_query_t *dns_resolve(lstr_t host, sa_family_t af, in_port_t port,
+                         dns_on_result_f *cb, data_t priv)
+{
+    dns_addr_t addr;
+    dns_query_t *q = p_new(dns_query_t, 1);
+    dns_entry_t *e;
+
+    assert (dns_is_own_thread());
+    q->port = port;
+    q->cb   = cb;
+    q->priv = priv;
+
+    if (dns_parse_addr(host, &addr) >= 0) {
+        if (af != AF_UNSPEC && af != addr.family) {
+            dns_query_deliver(q, NULL, 0, ENOENT);
+        } else {
+            dns_query_deliver(q, &addr, 1, 0);
+        }
+        return NULL;
+    }
+
+    _G.stats.lookups++;
+    e = dns_entry_get(host, af);
+    if (!e) {
+        dns_query_deliver(q, NULL, 0, EINVAL);
+        return NULL;
+    }
+    if (dns_entry_is_fresh(e)) {
+        if (e->err) {
+            _G.stats.negative_hits++;
+            dns_query_deliver(q, NULL, 0, e->err);
+        } else {
+            _G.stats.hits++;
+            dns_query_deliver(q, e->addrs, e->cnt, 0);
+        }
+        return NULL;
+    }
+
+    if (e->running) {
+        _G.stats.coalesced++;
+    } else
+    if (dns_entry_start(e) < 0) {
+        dns_query_deliver(q, NULL, 0, errno);
+        return NULL;
+    }
+    dlist_add_tail(&e->waiters, &q->link);
+    return q;
+}
+
+void dns_query_cancel(dns_query_t **qp)
+{
+    if (*qp) {
+        dlist_remove(&(*qp)->link);
+        p_delete(qp);
+    }
+}
+
+int dns_lookup(lstr_t host, sa_family_t af, in_port_t port,
+               sockunion_t *sus, int max)
+{
+    dns_addr_t addr;
+    dns_entry_t *e;
+    int cnt;
+
+    if (!dns_is_own_thread()) {
+        errno = EAGAIN;
+        return -1;
+    }
+    if (dns_parse_addr(host, &addr) >= 0) {
+        if (af != AF_UNSPEC && af != addr.family) {
+            errno = ENOENT;
+            return -1;
+        }
+        if (max > 0) {
+            dns_addr_to_su(&addr, port, sus);
+        }
+        return MIN(max, 1);
+    }
+    _G.stats.lookups++;
+    e = dns_entry_get(host, af);
+    if (!e) {
+        return -1;
+    }
+
+    if (!dns_entry_is_fresh(e)) {
+        if (e->running) {
+            _G.stats.coalesced++;
+        } else {
+            dns_entry_start(e);
+        }
+        /* serve the expired addresses while they are refreshed */
+        if (!e->expiry || e->err || !e->cnt) {
+            errno = EAGAIN;
+            return -1;
+        }
+    } else
+    if (e->err) {
+        _G.stats.negative_hits++;
+        errno = e->err;
+        return -1;
+    }
+
+    _G.stats.hits++;
+    cnt = MIN(e->cnt, max);
+    for (int i = 0; i < cnt; i++) {
+        dns_addr_to_su(&e->addrs[i], port, &sus[i]);
+    }
+    return cnt;
+}
+
+static void dns_close_servers(void)
+{
+    for (int i = 0; i < _G.nb_servers; i++) {
+        el_unregister(&_G.socks[i]);
+    }
+    _G.nb_servers = 0;
+}
+
+void dns_set_servers(const sockunion_t *servers, int cnt)
+{
+    dns_close_servers();
+    _G.nb_servers = MIN(cnt, DNS_SERVERS_MAX);
+    p_copy(_G.servers, servers, _G.nb_servers);
+}
+
+void dns_cache_flush(void)
+{
+    dns_cache_clear(false);
+}
+
+void dns_get_stats(dns_stats_t *stats)
+{
+    *stats = _G.stats;
+    stats->cache_len = qm_len(dns_cache, &_G.cache);
+}
+
+/* }}} */
+/* {{{ Configuration files */
+
+static pstream_t dns_get_line(pstream_t *ps)
+{
+    pstream_t line;
+
+    if (ps_get_ps_chr_and_skip(ps, '\n', &line) < 0) {
+        line = *ps;
+        *ps = ps_init(ps->s_end, 0);
+    }
+    /* strip the comments */
+    ps_get_ps_chr(&line, '#', &line);
+    ps_get_ps_chr(&line, ';', &line);
+    ps_ltrim(&line);
+    return line;
+}
+
+static void dns_load_resolv_conf(const char *path)
+{
+    lstr_t file;
+    pstream_t ps;
+
+    _G.nb_servers = 0;
+    if (lstr_init_from_file(&file, path, PROT_READ, MAP_SHARED) < 0) {
+        file = LSTR_NULL_V;
+    }
+    ps = ps_initlstr(&file);
+    while (!ps_done(&ps)) {
+        pstream_t line = dns_get_line(&ps);
+        pstream_t tok = ps_get_tok(&line, &ctype_isspace);
+
+        if (ps_is_equal(tok, ps_initstr("nameserver"))) {
+            dns_addr_t addr;
+
+            tok = ps_get_tok(&line, &ctype_isspace);
+            if (_G.nb_servers < DNS_SERVERS_MAX
+            &&  dns_parse_addr(LSTR_PS_V(&tok), &addr) >= 0)
+            {
+                dns_addr_to_su(&addr, DNS_PORT,
+                               &_G.servers[_G.nb_servers++]);
+            }
+        } else
+        if (ps_is_equal(tok, ps_initstr("options"))) {
+            while (!ps_done(&line)) {
+                int val;
+
+                tok = ps_get_tok(&line, &ctype_isspace);
+                if (ps_skipstr(&tok, "timeout:") >= 0
+                &&  lstr_to_int(LSTR_PS_V(&tok), &val) >= 0)
+                {
+                    _G.timeout = CLIP(val, 1, 30) * 1000;
+                } else
+                if (ps_skipstr(&tok, "attempts:") >= 0
+                &&  lstr_to_int(LSTR_PS_V(&tok), &val) >= 0)
+                {
+                    _G.attempts = CLIP(val, 1, 5);
+                }
+            }
+        }
+    }
+    lstr_wipe(&file);
+
+    if (!_G.nb_servers) {
+        dns_addr_t addr;
+
+        /* same default as the libc */
+        dns_parse_addr(LSTR("127.0.0.1"), &addr);
+        dns_addr_to_su(&addr, DNS_PORT, &_G.servers[_G.nb_servers++]);
+    }
+}
+
+static void dns_hosts_add(lstr_t name, sa_family_t af, const dns_addr_t *addr)
+{
+    dns_entry_t *e = dns_entry_get(name, af);
+
+    if (!e) {
+        return;
+    }
+    e->from_hosts = true;
+    e->expiry = INT64_MAX;
+    e->err = 0;
+    if (e->cnt < DNS_ADDRS_MAX) {
+        e->addrs[e->cnt++] = *addr;
+    }
+}
+
+static void dns_load_hosts(const char *path)
+{
+    lstr_t file;
+    pstream_t ps;
+
+    if (lstr_init_from_file(&file, path, PROT_READ, MAP_SHARED) < 0) {
+        return;
+    }
+    ps = ps_initlstr(&file);
+    while (!ps_done(&ps)) {
+        pstream_t line = dns_get_line(&ps);
+        pstream_t tok = ps_get_tok(&line, &ctype_isspace);
+        dns_addr_t addr;
+
+        if (dns_parse_addr(LSTR_PS_V(&tok), &addr) < 0) {
+            continue;
+        }
+        while (!ps_done(&line)) {
+            lstr_t name;
+
+            tok = ps_get_tok(&line, &ctype_isspace);
+            name = LSTR_PS_V(&tok);
+            dns_hosts_add(name, AF_UNSPEC, &addr);
+            dns_hosts_add(name, addr.family, &addr);
+        }
+    }
+    lstr_wipe(&file);
+}
+
+/* }}} */
+/* {{{ Module */
+
+static int dns_initialize(void *arg)
+{
+    _G.thread   = pthread_self();
+    _G.timeout  = 5000;
+    _G.attempts = 2;
+    dns_load_resolv_conf("/etc/resolv.conf");
+    dns_load_hosts("/etc/hosts");
+    return 0;
+}
+
+static int dns_shutdown(void)
+{
+    qm_deep_wipe(dns_cache, &_G.cache, IGNORE, dns_entry_delete);
+    qm_wipe(dns_ids, &_G.ids);
+    dns_close_servers();
+    return 0;
+}
+
+MODULE_BEGIN(dns)
+    MODULE_DEPENDS_ON(el);
+MODULE_END()
+
+/* }}} */
@@ -0,0 +1,126 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#if !defined(IS_LIB_COMMON_NET_H) || defined(IS_LIB_COMMON_NET_DNS_H)
+#  error "you must include net.h instead"
+#else
+#define IS_LIB_COMMON_NET_DNS_H
+
+/* Asynchronous DNS resolver
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * The dns module resolves the host names without blocking the event loop:
+ * the queries are sent over UDP to the name servers of /etc/resolv.conf
+ * from sockets registered in the event loop, and sent again over TCP when
+ * the answer is truncated. The names of /etc/hosts are answered without any
+ * query.
+ *
+ * The addresses are cached for the TTL of the answer, and the unknown names
+ * for the TTL of the SOA record of their zone (DNS_NEGATIVE_TTL_DFL when
+ * there is none). The concurrent resolutions of a same name share the same
+ * queries.
+ *
+ * The resolver lives in the thread that loaded the module. Once it is
+ * loaded, addr_info_all() (thus addr_resolve(), the HTTP clients, the
+ * ichannels...) answers from its cache in that thread, and only falls back
+ * to the blocking getaddrinfo() on a miss, while the cache is filled in the
+ * background.
+ *
+ * The search domains of resolv.conf are not used: the names are always
+ * queried as absolute names.
+ */
+
+#define DNS_ADDRS_MAX         16
+#define DNS_SERVERS_MAX        3
+#define DNS_NEGATIVE_TTL_DFL  30   /* seconds */
+#define DNS_LATENCY_BUCKETS   16
+
+typedef struct dns_query_t dns_query_t;
+
+/** Callback called with the result of a resolution.
+ *
+ * \param[in] sus    the addresses, with the port of the resolution.
+ * \param[in] cnt    the number of addresses, 0 on errors.
+ * \param[in] err    0, or the errno of the failure: ENOENT for an unknown
+ *                   name (or a name without an address of the family),
+ *                   ETIMEDOUT when no server answered, EAGAIN when the
+ *                   servers failed.
+ */
+typedef void (dns_on_result_f)(const sockunion_t * nullable sus, int cnt,
+                               int err, data_t priv);
+
+/** Resolve a host name.
+ *
+ * The callback is called synchronously when the result is already known (a
+ * numeric host, an entry of /etc/hosts or of the cache), in which case NULL
+ * is returned. Otherwise the query is returned, and destroyed once its
+ * callback has been called.
+ *
+ * \param[in] af    AF_INET, AF_INET6, or AF_UNSPEC for both.
+ */
+dns_query_t * nullable
+dns_resolve(lstr_t host, sa_family_t af, in_port_t port,
+            dns_on_result_f * nonnull cb, data_t priv);
+
+/** Cancel a resolution, the callback is not called. */
+void dns_query_cancel(dns_query_t * nullable * nonnull q);
+
+/** Get the addresses of a host name from the cache, without blocking.
+ *
+ * On a miss, the resolution of the name is started so that a next lookup
+ * finds it. An expired entry is still returned while it is refreshed.
+ *
+ * \return the number of addresses written in \p sus, or -1 with errno set
+ *         to EAGAIN on a miss (or when not called from the thread of the
+ *         resolver), ENOENT if the name is known not to exist.
+ */
+int dns_lookup(lstr_t host, sa_family_t af, in_port_t port,
+               sockunion_t * nonnull sus, int max);
+
+/** Replace the name servers of /etc/resolv.conf.
+ *
+ * The pending resolutions are sent again to the new servers.
+ */
+void dns_set_servers(const sockunion_t * nonnull servers, int cnt);
+
+/** Forget the cached answers, except the ones of /etc/hosts. */
+void dns_cache_flush(void);
+
+typedef struct dns_stats_t {
+    uint64_t lookups;       /* calls to dns_resolve() and dns_lookup() */
+    uint64_t hits;          /* answered from the cache or /etc/hosts */
+    uint64_t negative_hits; /* answered ENOENT from the cache */
+    uint64_t coalesced;     /* joined a running resolution */
+    uint64_t queries;       /* questions sent over UDP, retries included */
+    uint64_t tcp_queries;   /* questions sent again over TCP */
+    uint64_t timeouts;      /* resolutions without any answer */
+    uint64_t failures;      /* resolutions failed by the servers */
+    uint32_t cache_len;
+
+    /* the bucket i counts the resolutions below 2^i ms, the last one the
+     * slower ones */
+    uint64_t latency_hist[DNS_LATENCY_BUCKETS + 1];
+    uint64_t latency_sum;   /* in ms */
+} dns_stats_t;
+
+/** Get the statistics of the resolver. */
+void dns_get_stats(dns_stats_t * nonnull stats);
+
+MODULE_DECLARE(dns);
+
+#endif
@@ -21,10 +21,10 @@
 HPACK algorithm (of RFC-7541) as c arrays in autogenerated c files. The script
 accepts as parameter the text of RFC-7541 which can be shortened to the
 appendix section. For encoding, it generates the char-to-huffman-string
-mapping. For decoding, it generates the decoder's state-transition table
-based on input chunks of 1 or 2 or 4 bits at a time. This script is meant to
-generate the '.c' files during the build step and accepts as parameter
-a preamble text that '#include's a common '.h' file. For example:
+mapping. For decoding, it generates the decoder's state-transition table based
+on input chunks of 1 or 2 or 4 or 8 bits at a time. This script is meant to
+generate the '.c' files during the build step and accepts as parameter a
+preamble text that '#include's a common '.h' file. For example:
 
 file: hpack-priv.h
 =========================================================================
@@ -56,6 +56,17 @@ extern const hpack_huffcode_t hpack_huffcode_tab_g[256 + 1];
 
 // 16 is compatible with input chunks of 4 bits.
 extern const hpack_huffdec_trans_t hpack_huffdec_trans_tab_g[256][16];
+
+// With input chunks of 8 bits, a transition emits up to 2 symbols:
+typedef struct hpack_huffdec8_trans_t {
+    uint8_t state;
+    uint8_t sym[2];
+    uint8_t nsyms : 2;
+    uint8_t final : 1;
+    uint8_t error : 1;
+} hpack_huffdec8_trans_t;
+
+extern const hpack_huffdec8_trans_t hpack_huffdec8_trans_tab_g[256][256];
 ========================================================================
 
 See 'options' for further details on command line paramters.
@@ -207,7 +218,7 @@ def gen_huffman_st_table(tree, chunk_bits):
             [{'next': None, 'sym': [], 'final': False, 'error': False}
              for _ in range(inputs)])
 
-    assert(chunk_bits in [1, 2, 4])
+    assert(chunk_bits in [1, 2, 4, 8])
     inputs = 2 ** chunk_bits
     root = tree
     st_tab = []
@@ -263,13 +274,24 @@ def get_huffman_st_table_as_c_array(rfc_fn, tbl_elem_t, tbl_name, chunk_bits):
             chunk_code = int(chunk_str, 2)
 
             trans = state[chunk_code]
-            assert(len(trans['sym']) < 2)
-
-            next_idx, emitter, = trans['next']['IDX'], len(trans['sym']) > 0
+            next_idx = trans['next']['IDX']
             final, error = trans['final'], trans['error']
+            prefix = compact_prefix(trans['next']['prefix'])
+
+            if chunk_bits == 8:
+                # the shortest code is 5-bit long: a byte emits at most 2
+                # symbols
+                syms = trans['sym'] + [0, 0]
+                assert(len(trans['sym']) <= 2)
+                cols.append(
+                    "/* %02X */ {/* %-10s */ %3d, {%3d, %3d}, %d, %d, %d}" %
+                    (chunk_code, prefix, next_idx, syms[0], syms[1],
+                     len(trans['sym']), final, error))
+                continue
 
+            assert(len(trans['sym']) < 2)
+            emitter = len(trans['sym']) > 0
             sym = trans['sym'][0] if emitter else 0
-            prefix = compact_prefix(trans['next']['prefix'])
 
             cols.append("/* %s */ {/* %-10s */ %3d, %3d, %d, %d, %d}" %
                         (chunk_str, prefix, next_idx, sym, emitter,
@@ -336,7 +358,7 @@ def options(args):
                     dest='elem_t', default=DEF_DECODE_ELEM_T)
     sp.add_argument('-n', '--name', help="name of table variable",
                     dest='name', default=DEF_DECODE_TABLE_NAME)
-    sp.add_argument('-c', '--chunkbits', type=int, choices=[1, 2, 4],
+    sp.add_argument('-c', '--chunkbits', type=int, choices=[1, 2, 4, 8],
                     default=DEF_CHUNKBITS)
     return op.parse_args(args)
 
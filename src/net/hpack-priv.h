@@ -52,6 +52,27 @@ typedef struct hpack_huffdec_trans_t {
 /* Huffman state-transition table based on 4-bit chunks (i.e., nibbles) */
 extern const hpack_huffdec_trans_t hpack_huffdec_trans_tab_g[256][16];
 
+/* Huffman decoder's state-transition table entries for 8-bit chunks */
+/* The states are the same as the ones of the 4-bit table, but a whole byte
+ * of input is consumed by each transition: as the shortest code is 5-bit
+ * long, it emits up to 2 decoded bytes.
+ */
+typedef struct hpack_huffdec8_trans_t {
+    /* new state after consuming the byte */
+    uint8_t state;
+    /* emitted symbols (bytes), the first nsyms ones are valid */
+    uint8_t sym[2];
+    /* number of emitted symbols: 0, 1 or 2 */
+    uint8_t nsyms : 2;
+    /* is this a final transition? */
+    uint8_t final : 1;
+    /* is this an error transition? */
+    uint8_t error : 1;
+} hpack_huffdec8_trans_t;
+
+/* Huffman state-transition table based on 8-bit chunks (i.e., bytes) */
+extern const hpack_huffdec8_trans_t hpack_huffdec8_trans_tab_g[256][256];
+
 /** Return the length of the huffman-coded version of \p str */
 static inline size_t hpack_get_huffman_len(lstr_t str)
 {
@@ -88,6 +109,13 @@ int hpack_encode_huffman(lstr_t str, void *out, int len);
  */
 int hpack_decode_huffman(lstr_t str, void *out);
 
+/** Decode the huffman-coded \p str into \p out, a nibble at a time
+ *
+ * Same as \ref hpack_decode_huffman, with the 4-bit state-transition table.
+ * It is twice slower, and kept as a reference for the tests and benchmarks.
+ */
+int hpack_decode_huffman_nibbles(lstr_t str, void *out);
+
 /* }}} */
 /* {{{ Integer encoding & decoding */
 
@@ -74,6 +74,31 @@ int hpack_encode_huffman(lstr_t str, void *out_, int len)
 }
 
 int hpack_decode_huffman(lstr_t str, void *out_)
+{
+    uint8_t *out = (uint8_t *)out_;
+    uint8_t state = 0;
+    unsigned final = 1;
+
+    for (int i = 0; i != str.len; i++) {
+        const hpack_huffdec8_trans_t *trans;
+
+        trans = &hpack_huffdec8_trans_tab_g[state][(uint8_t)str.s[i]];
+        THROW_ERR_IF(trans->error);
+        if (trans->nsyms) {
+            out[0] = trans->sym[0];
+            if (trans->nsyms == 2) {
+                out[1] = trans->sym[1];
+            }
+            out += trans->nsyms;
+        }
+        state = trans->state;
+        final = trans->final;
+    }
+    THROW_ERR_UNLESS(final);
+    return out - (uint8_t *)out_;
+}
+
+int hpack_decode_huffman_nibbles(lstr_t str, void *out_)
 {
     uint8_t *out = (uint8_t *)out_;
     uint8_t state;
@@ -752,9 +777,33 @@ static int hpack_write_str(lstr_t s, int zlen, byte *out_)
     return out - out_;
 }
 
+/* Write a string with a precomputed Huffman-coded form, empty when the raw
+ * string is shorter. */
+static int hpack_write_str_z(lstr_t s, lstr_t z, byte *out_)
+{
+    byte *out = out_;
+
+    if (!z.len) {
+        return hpack_write_str(s, 0, out);
+    }
+    out += hpack_write_int(z.len, 7, 0x80u, out);
+    p_copy(out, z.s, z.len);
+    out += z.len;
+    return out - out_;
+}
+
 int hpack_encoder_write_hdr(hpack_enc_dtbl_t *nonnull dtbl, lstr_t key,
                             lstr_t val, uint16_t key_id, uint16_t val_id,
-                            unsigned flags, byte *out_)
+                            unsigned flags, byte *out)
+{
+    return hpack_encoder_write_hdr_z(dtbl, key, val, key_id, val_id, flags,
+                                     LSTR_NULL_V, LSTR_NULL_V, out);
+}
+
+int hpack_encoder_write_hdr_z(hpack_enc_dtbl_t *nonnull dtbl, lstr_t key,
+                              lstr_t val, uint16_t key_id, uint16_t val_id,
+                              unsigned flags, lstr_t zkey, lstr_t zval,
+                              byte *out_)
 {
     t_scope;
     byte *out = out_;
@@ -840,6 +889,10 @@ encode:
     }
     /* encode key: New Name */
     assert(!idx_stbl && !idx_dtbl);
+    if (zkey.s) {
+        out += hpack_write_str_z(key, zkey, out);
+        goto encode_value;
+    }
     if (flags & HPACK_FLG_LWR_KEY) {
         key = t_lstr_dup(key);
         lstr_ascii_tolower(&key);
@@ -857,6 +910,10 @@ encode:
     /* zip key if zlen > 0 */
     out += hpack_write_str(key, zlen, out);
 encode_value:
+    if (zval.s) {
+        out += hpack_write_str_z(val, zval, out);
+        goto done;
+    }
     /* encode value: Q: shall we zip? */
     /* A: Don't zip if prevented by flags, if not, ...*/
     if (flags & HPACK_FLG_NOZIP_VAL) {
@@ -873,6 +930,182 @@ done:
     return out - out_;
 }
 
+/* }}} */
+/* {{{ Encoder policy */
+
+hpack_enc_policy_t *hpack_enc_policy_init(hpack_enc_policy_t *policy)
+{
+    p_clear(policy, 1);
+    qm_init(hpack_enc_keys, &policy->keys);
+    qm_init(hpack_enc_vals, &policy->vals);
+    return policy;
+}
+
+static void hpack_enc_key_wipe(hpack_enc_key_t *key)
+{
+    lstr_wipe(&key->zkey);
+}
+
+static void hpack_enc_val_wipe(hpack_enc_val_t *val)
+{
+    lstr_wipe(&val->zval);
+}
+
+void hpack_enc_policy_wipe(hpack_enc_policy_t *policy)
+{
+    qm_deep_wipe(hpack_enc_keys, &policy->keys, lstr_wipe,
+                 hpack_enc_key_wipe);
+    qm_deep_wipe(hpack_enc_vals, &policy->vals, lstr_wipe,
+                 hpack_enc_val_wipe);
+}
+
+/* Get the Huffman-coded form of a string if it is shorter, or an empty
+ * string. */
+static lstr_t hpack_enc_policy_zip(lstr_t s)
+{
+    int zlen = hpack_get_huffman_len(s);
+    char *z;
+
+    if (zlen >= s.len) {
+        return LSTR_EMPTY_V;
+    }
+    z = p_new_raw(char, zlen);
+    hpack_encode_huffman(s, z, zlen);
+    return lstr_init_(z, zlen, MEM_LIBC);
+}
+
+static const lstr_t hpack_enc_sensitive_keys_g[] = {
+    LSTR_IMMED("authorization"),
+    LSTR_IMMED("proxy-authorization"),
+    LSTR_IMMED("cookie"),
+    LSTR_IMMED("set-cookie"),
+};
+
+static const lstr_t hpack_enc_high_cardinality_keys_g[] = {
+    LSTR_IMMED("content-length"),
+    LSTR_IMMED("date"),
+    LSTR_IMMED("etag"),
+    LSTR_IMMED("expires"),
+    LSTR_IMMED("last-modified"),
+    LSTR_IMMED("if-modified-since"),
+};
+
+static hpack_enc_key_t *
+hpack_enc_policy_get_key(hpack_enc_policy_t *policy, lstr_t key)
+{
+    hpack_enc_key_t *k;
+    int pos;
+
+    pos = qm_find(hpack_enc_keys, &policy->keys, &key);
+    if (pos >= 0) {
+        return &policy->keys.values[pos];
+    }
+    if (qm_len(hpack_enc_keys, &policy->keys) >= HPACK_ENC_POLICY_KEYS_MAX)
+    {
+        return NULL;
+    }
+
+    key = lstr_dup(key);
+    pos = qm_reserve(hpack_enc_keys, &policy->keys, &key, 0);
+    k = &policy->keys.values[pos];
+    p_clear(k, 1);
+    k->key_id = qm_len(hpack_enc_keys, &policy->keys);
+    k->zkey = hpack_enc_policy_zip(key);
+
+    carray_for_each_ptr(name, hpack_enc_sensitive_keys_g) {
+        if (lstr_ascii_iequal(key, *name)) {
+            k->sensitive = true;
+            k->high_cardinality = true;
+        }
+    }
+    carray_for_each_ptr(name, hpack_enc_high_cardinality_keys_g) {
+        if (lstr_ascii_iequal(key, *name)) {
+            k->high_cardinality = true;
+        }
+    }
+    return k;
+}
+
+static hpack_enc_val_t *
+hpack_enc_policy_get_val(hpack_enc_policy_t *policy, hpack_enc_key_t *k,
+                         lstr_t val)
+{
+    t_scope;
+    hpack_enc_val_t *v;
+    lstr_t id_val;
+    char *buf;
+    int pos;
+
+    /* the values are prefixed by the id of their key */
+    buf = t_new_raw(char, 2 + val.len);
+    put_unaligned_le16(buf, k->key_id);
+    p_copy(buf + 2, val.s, val.len);
+    id_val = LSTR_DATA_V(buf, 2 + val.len);
+
+    pos = qm_find(hpack_enc_vals, &policy->vals, &id_val);
+    if (pos >= 0) {
+        v = &policy->vals.values[pos];
+        v->hits++;
+        return v;
+    }
+    if (k->nb_vals >= HPACK_ENC_POLICY_KEY_VALS_MAX) {
+        /* too many distinct values, stop indexing the values of this key */
+        k->high_cardinality = true;
+        return NULL;
+    }
+    if (qm_len(hpack_enc_vals, &policy->vals) >= HPACK_ENC_POLICY_VALS_MAX)
+    {
+        return NULL;
+    }
+
+    id_val = lstr_dup(id_val);
+    pos = qm_reserve(hpack_enc_vals, &policy->vals, &id_val, 0);
+    v = &policy->vals.values[pos];
+    v->val_id = qm_len(hpack_enc_vals, &policy->vals);
+    v->hits   = 1;
+    v->zval   = hpack_enc_policy_zip(val);
+    k->nb_vals++;
+    return v;
+}
+
+int hpack_enc_policy_write_hdr(hpack_enc_policy_t *policy,
+                               hpack_enc_dtbl_t *dtbl, lstr_t key,
+                               lstr_t val, byte *out)
+{
+    hpack_enc_key_t *k = hpack_enc_policy_get_key(policy, key);
+    hpack_enc_val_t *v = NULL;
+    unsigned flags = 0;
+    int len;
+
+    if (!k) {
+        /* too many keys: encode as is */
+        len = hpack_encoder_write_hdr(dtbl, key, val, 0, 0, 0, out);
+        goto done;
+    }
+    if (!k->high_cardinality) {
+        v = hpack_enc_policy_get_val(policy, k, val);
+    }
+    if (k->sensitive) {
+        flags |= HPACK_FLG_NVRADD_DTBL;
+    } else
+    if (!v || v->hits < 2) {
+        /* only index the fields seen at least twice */
+        flags |= HPACK_FLG_NOADD_DTBL;
+    }
+    len = hpack_encoder_write_hdr_z(dtbl, key, val, k->key_id,
+                                    v ? v->val_id : 0, flags, k->zkey,
+                                    v ? v->zval : LSTR_NULL_V, out);
+
+  done:
+    if (out[0] & 0x80u) {
+        /* Indexed Header Representation */
+        policy->indexed++;
+    }
+    policy->hdrs++;
+    policy->bytes += len;
+    return len;
+}
+
 /* }}} */
 /* {{{ Decoding API */
 
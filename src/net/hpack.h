@@ -200,6 +200,87 @@ int hpack_encoder_write_hdr(hpack_enc_dtbl_t *nonnull dtbl, lstr_t key,
                             lstr_t val, uint16_t key_id, uint16_t val_id,
                             unsigned flags, byte *out);
 
+/** Write a single hdr like \ref hpack_encoder_write_hdr with precomputed
+ * Huffman-coded forms of its strings.
+ *
+ * \param zkey: Huffman-coded \p key, LSTR_EMPTY_V to write the raw key or
+ *              LSTR_NULL_V to choose according to the flags.
+ * \param zval: same for \p val.
+ */
+int hpack_encoder_write_hdr_z(hpack_enc_dtbl_t *nonnull dtbl, lstr_t key,
+                              lstr_t val, uint16_t key_id, uint16_t val_id,
+                              unsigned flags, lstr_t zkey, lstr_t zval,
+                              byte *out);
+
+/* {{{ Encoder policy */
+
+/* The encoder policy chooses the ids and flags of the headers of a
+ * connection, so that the dynamic table is used for the ones that recur:
+ *  - a header field is added to the dynamic table the second time it is
+ *    seen, so that the fields sent once do not evict the recurring ones;
+ *  - the values of the keys with too many distinct values (and of the well
+ *    known high-cardinality keys like content-length or date) are never
+ *    indexed, only their keys can be;
+ *  - the sensitive headers (authorization, cookies) are never indexed, as
+ *    required by RFC 7541 §7.1.3;
+ *  - the Huffman-coded forms of the tracked keys and values are computed
+ *    once.
+ */
+
+#define HPACK_ENC_POLICY_KEYS_MAX      256
+#define HPACK_ENC_POLICY_VALS_MAX      1024
+#define HPACK_ENC_POLICY_KEY_VALS_MAX  16
+
+typedef struct hpack_enc_key_t {
+    uint16_t key_id;
+    uint16_t nb_vals;
+    /* never index the values of this key */
+    bool     high_cardinality;
+    bool     sensitive;
+    lstr_t   zkey;
+} hpack_enc_key_t;
+
+typedef struct hpack_enc_val_t {
+    uint16_t val_id;
+    uint32_t hits;
+    lstr_t   zval;
+} hpack_enc_val_t;
+
+qm_kvec_t(hpack_enc_keys, lstr_t, hpack_enc_key_t, qhash_lstr_hash,
+          qhash_lstr_equal);
+qm_kvec_t(hpack_enc_vals, lstr_t, hpack_enc_val_t, qhash_lstr_hash,
+          qhash_lstr_equal);
+
+typedef struct hpack_enc_policy_t {
+    /* tracked keys, and values prefixed by the id of their key */
+    qm_t(hpack_enc_keys) keys;
+    qm_t(hpack_enc_vals) vals;
+
+    /* statistics */
+    uint64_t hdrs;
+    uint64_t indexed;   /* hdrs written as an index of a table */
+    uint64_t bytes;
+} hpack_enc_policy_t;
+
+hpack_enc_policy_t *hpack_enc_policy_init(hpack_enc_policy_t *policy);
+void hpack_enc_policy_wipe(hpack_enc_policy_t *policy);
+
+GENERIC_NEW(hpack_enc_policy_t, hpack_enc_policy)
+GENERIC_DELETE(hpack_enc_policy_t, hpack_enc_policy)
+
+/** Write a single hdr to \p out, its encoding being chosen by \p policy
+ *
+ * \return the number of bytes written to \p out
+ *
+ * \note caller must ensure that \p out has enough capacity, e.g, using \ref
+ * hpack_buflen_to_write_hdr.
+ */
+int hpack_enc_policy_write_hdr(hpack_enc_policy_t *nonnull policy,
+                               hpack_enc_dtbl_t *nonnull dtbl, lstr_t key,
+                               lstr_t val, byte *out);
+
+/* }}} */
+
 
 int hpack_decoder_read_dts_update_(hpack_dec_dtbl_t *dtbl, pstream_t *in);
 
@@ -16,8 +16,10 @@
 /*                                                                         */
 /***************************************************************************/
 
+#include <sys/inotify.h>
 #include <lib-common/datetime.h>
 #include <lib-common/http.h>
+#include <lib-common/unix.h>
 
 static void mime_put_http_ctype(outbuf_t *ob, const char *path)
 {
@@ -151,13 +153,332 @@ void httpd_reply_make_index(httpd_query_t *q, int dfd, bool head)
     }
 }
 
+/* {{{ ETags */
+
+static void sb_add_etag(sb_t *sb, ino_t ino, off_t size, time_t mtime,
+                        bool gz)
+{
+    /* the file may be modified again within the same second */
+    if (mtime >= lp_getsec() - 10) {
+        sb_adds(sb, "W/");
+    }
+    sb_addf(sb, "\"%jx-%jxx-%lx%s\"", (int64_t)ino, (int64_t)size, mtime,
+            gz ? "-gz" : "");
+}
+
+/* rfc 7232: §3.2: the weak comparison of the tags of If-None-Match */
+static bool http_etag_none_match(pstream_t ps, lstr_t etag)
+{
+    if (lstr_startswith(etag, LSTR("W/"))) {
+        etag = LSTR_INIT_V(etag.s + 2, etag.len - 2);
+    }
+    ps_trim(&ps);
+    if (ps_memequal(&ps, "*", 1)) {
+        return false;
+    }
+    while (!ps_done(&ps)) {
+        pstream_t tag;
+
+        if (ps_get_ps_chr_and_skip(&ps, ',', &tag) < 0) {
+            tag = ps;
+            __ps_skip(&ps, ps_len(&ps));
+        }
+        ps_trim(&tag);
+        ps_skipstr(&tag, "W/");
+        if (lstr_equal(LSTR_PS_V(&tag), etag)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Answer "Not Modified" when the ETag matches one of If-None-Match. */
+static bool httpd_reply_not_modified(httpd_query_t *q, lstr_t etag)
+{
+    const httpd_qinfo_t *info = q->qinfo;
+    const http_qhdr_t *hdr;
+    outbuf_t *ob;
+
+    if (!info) {
+        return false;
+    }
+    hdr = http_qhdr_find(info->hdrs, info->hdrs_len,
+                         HTTP_WKHDR_IF_NONE_MATCH);
+    if (!hdr || http_etag_none_match(hdr->val, etag)) {
+        return false;
+    }
+    ob = httpd_reply_hdrs_start(q, HTTP_CODE_NOT_MODIFIED, false);
+    ob_addf(ob, "ETag: %pL\r\n", &etag);
+    httpd_reply_hdrs_done(q, 0, false);
+    httpd_reply_done(q);
+    return true;
+}
+
+/* }}} */
+/* {{{ Cache of the static files */
+
+/* The small files served by absolute path are kept in memory with their
+ * ".gz" sibling if any, so that their answers do not touch the disk. Their
+ * directories are watched, so that an entry is dropped as soon as the file
+ * or its sibling is modified, created, renamed or deleted.
+ */
+
+#define HTTPD_FILE_CACHE_FILE_MAX  (1 << 20)
+#define HTTPD_FILE_CACHE_SIZE_MAX  (64 << 20)
+
+#define HTTPD_FILE_CACHE_WATCH                                               \
+    (IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_DELETE_SELF    \
+   | IN_MODIFY | IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO)
+
+typedef struct httpd_file_t {
+    dlist_t lru_link;
+    lstr_t  path;
+    ino_t   ino;
+    off_t   size;
+    time_t  mtime;
+    bool    has_gz;
+    sb_t    data;
+    sb_t    gz_data;
+} httpd_file_t;
+
+qm_kvec_t(httpd_files, lstr_t, httpd_file_t * nonnull,
+          qhash_lstr_hash, qhash_lstr_equal);
+qm_kvec_t(httpd_file_dirs, lstr_t, el_t nonnull,
+          qhash_lstr_hash, qhash_lstr_equal);
+
+static struct {
+    qm_t(httpd_files)     files;
+    qm_t(httpd_file_dirs) dirs;
+    dlist_t               lru;
+    size_t                size;
+} httpd_file_cache_g = {
+#define _G  httpd_file_cache_g
+    .files = QM_INIT(httpd_files, _G.files),
+    .dirs  = QM_INIT(httpd_file_dirs, _G.dirs),
+    .lru   = DLIST_INIT(_G.lru),
+};
+
+static void httpd_file_delete(httpd_file_t **fp)
+{
+    httpd_file_t *f = *fp;
+
+    if (f) {
+        _G.size -= f->data.len + f->gz_data.len;
+        dlist_remove(&f->lru_link);
+        lstr_wipe(&f->path);
+        sb_wipe(&f->data);
+        sb_wipe(&f->gz_data);
+        p_delete(fp);
+    }
+}
+
+static void httpd_file_cache_drop(lstr_t path)
+{
+    int pos = qm_find(httpd_files, &_G.files, &path);
+
+    if (pos >= 0) {
+        httpd_file_t *f = _G.files.values[pos];
+
+        qm_del_at(httpd_files, &_G.files, pos);
+        httpd_file_delete(&f);
+    }
+}
+
+void httpd_file_cache_flush(void)
+{
+    qm_for_each_value(httpd_file_dirs, ev, &_G.dirs) {
+        el_fs_watch_unregister(&ev);
+    }
+    qm_deep_clear(httpd_file_dirs, &_G.dirs, lstr_wipe, IGNORE);
+    /* the keys are the paths of the files */
+    qm_deep_clear(httpd_files, &_G.files, IGNORE, httpd_file_delete);
+}
+
+static void httpd_file_cache_on_event(el_t ev, uint32_t mask, uint32_t cookie,
+                                      lstr_t name, data_t priv)
+{
+    t_scope;
+    const char *dir = el_fs_watch_get_path(ev);
+    lstr_t path;
+
+    if (mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+        /* the paths of the whole directory are gone */
+        httpd_file_cache_flush();
+        return;
+    }
+    if (!name.len) {
+        return;
+    }
+    path = t_lstr_fmt("%s%s%pL", dir, strequal(dir, "/") ? "" : "/", &name);
+    httpd_file_cache_drop(path);
+    if (lstr_endswith(path, LSTR(".gz"))) {
+        httpd_file_cache_drop(LSTR_INIT_V(path.s, path.len - 3));
+    }
+}
+
+static int httpd_file_cache_watch(const char *path)
+{
+    char dir[PATH_MAX];
+    lstr_t key;
+    el_t ev;
+    int pos;
+
+    path_dirname(dir, sizeof(dir), path);
+    key = LSTR(dir);
+    if (qm_find(httpd_file_dirs, &_G.dirs, &key) >= 0) {
+        return 0;
+    }
+    ev = RETHROW_PN(el_fs_watch_register(dir, HTTPD_FILE_CACHE_WATCH,
+                                         &httpd_file_cache_on_event, NULL));
+    el_unref(ev);
+    key = lstr_dup(key);
+    pos = qm_reserve(httpd_file_dirs, &_G.dirs, &key, 0);
+    _G.dirs.values[pos] = ev;
+    return 0;
+}
+
+static int httpd_file_read(sb_t *sb, int fd, const struct stat *st)
+{
+    if (!S_ISREG(st->st_mode) || st->st_size > HTTPD_FILE_CACHE_FILE_MAX) {
+        return -1;
+    }
+    sb_init(sb);
+    if (sb_read_fd(sb, fd) < 0 || sb->len != st->st_size) {
+        sb_wipe(sb);
+        return -1;
+    }
+    return 0;
+}
+
+/* Add a file to the cache, from its opened descriptor. */
+static httpd_file_t * nullable
+httpd_file_cache_add(const char *path, int fd, const struct stat *st)
+{
+    t_scope;
+    httpd_file_t *f;
+    struct stat gz_st;
+    lstr_t key;
+    int gz_fd;
+    int pos;
+
+    if (st->st_size > HTTPD_FILE_CACHE_FILE_MAX
+    ||  httpd_file_cache_watch(path) < 0)
+    {
+        return NULL;
+    }
+
+    f = p_new(httpd_file_t, 1);
+    dlist_init(&f->lru_link);
+    f->ino   = st->st_ino;
+    f->size  = st->st_size;
+    f->mtime = st->st_mtime;
+    if (httpd_file_read(&f->data, fd, st) < 0) {
+        p_delete(&f);
+        return NULL;
+    }
+    gz_fd = open(t_fmt("%s.gz", path), O_RDONLY);
+    if (gz_fd >= 0) {
+        f->has_gz = !fstat(gz_fd, &gz_st)
+                 && !httpd_file_read(&f->gz_data, gz_fd, &gz_st);
+        close(gz_fd);
+    }
+    if (!f->has_gz) {
+        sb_init(&f->gz_data);
+    }
+
+    f->path = lstr_dups(path, -1);
+    key = f->path;
+    pos = qm_reserve(httpd_files, &_G.files, &key, QHASH_OVERWRITE);
+    if (pos & QHASH_COLLISION) {
+        pos &= ~QHASH_COLLISION;
+        httpd_file_delete(&_G.files.values[pos]);
+        _G.files.keys[pos] = key;
+    }
+    _G.files.values[pos] = f;
+    dlist_add(&_G.lru, &f->lru_link);
+    _G.size += f->data.len + f->gz_data.len;
+
+    /* evict the least recently used files */
+    while (_G.size > HTTPD_FILE_CACHE_SIZE_MAX) {
+        httpd_file_t *last = dlist_last_entry(&_G.lru, httpd_file_t,
+                                              lru_link);
+
+        httpd_file_cache_drop(last->path);
+    }
+    return f;
+}
+
+static httpd_file_t * nullable httpd_file_cache_get(const char *path)
+{
+    lstr_t key = LSTR(path);
+    int pos = qm_find(httpd_files, &_G.files, &key);
+    httpd_file_t *f;
+
+    if (pos < 0) {
+        return NULL;
+    }
+    f = _G.files.values[pos];
+    dlist_move(&_G.lru, &f->lru_link);
+    return f;
+}
+
+static void httpd_reply_cached_file(httpd_query_t *q, const httpd_file_t *f,
+                                    bool head)
+{
+    SB_1k(etag);
+    bool gz = f->has_gz && q->qinfo
+           && (httpd_qinfo_accept_enc_get(q->qinfo) & HTTPD_ACCEPT_ENC_GZIP);
+    const sb_t *data = gz ? &f->gz_data : &f->data;
+    outbuf_t *ob;
+
+    sb_add_etag(&etag, f->ino, f->size, f->mtime, gz);
+    if (httpd_reply_not_modified(q, LSTR_SB_V(&etag))) {
+        return;
+    }
+
+    ob = httpd_reply_hdrs_start(q, HTTP_CODE_OK, false);
+    httpd_put_date_hdr(ob, "Last-Modified", f->mtime);
+    ob_addf(ob, "ETag: %*pM\r\n", SB_FMT_ARG(&etag));
+    if (f->has_gz) {
+        ob_adds(ob, "Vary: Accept-Encoding\r\n");
+    }
+    if (gz) {
+        ob_adds(ob, "Content-Encoding: gzip\r\n");
+    }
+    mime_put_http_ctype(ob, f->path.s);
+    httpd_reply_hdrs_done(q, data->len, false);
+    if (!head) {
+        ob_add(ob, data->data, data->len);
+    }
+    httpd_reply_done(q);
+}
+
+#undef _G
+
+/* }}} */
+
 void httpd_reply_file(httpd_query_t *q, int dfd, const char *file, bool head)
 {
-    int fd = openat(dfd, file, O_RDONLY);
+    t_scope;
+    int fd;
     struct stat st;
     outbuf_t *ob;
     void *map = NULL;
+    char *path = NULL;
+    httpd_file_t *f;
+    SB_1k(etag);
 
+    /* the absolute paths do not depend on dfd, they are cached */
+    if (file[0] == '/') {
+        path = t_strdup(file);
+        path_simplify2(path, true);
+        if ((f = httpd_file_cache_get(path))) {
+            httpd_reply_cached_file(q, f, head);
+            return;
+        }
+    }
+
+    fd = openat(dfd, file, O_RDONLY);
     if (fd < 0)
         goto ret404;
 
@@ -171,6 +492,17 @@ void httpd_reply_file(httpd_query_t *q, int dfd, const char *file, bool head)
     }
     if (!S_ISREG(st.st_mode))
         goto ret404;
+    if (path && (f = httpd_file_cache_add(path, fd, &st))) {
+        close(fd);
+        httpd_reply_cached_file(q, f, head);
+        return;
+    }
+
+    sb_add_etag(&etag, st.st_ino, st.st_size, st.st_mtime, false);
+    if (httpd_reply_not_modified(q, LSTR_SB_V(&etag))) {
+        close(fd);
+        return;
+    }
     if (!head && st.st_size > (16 << 10)) {
         map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
         if (map == MAP_FAILED) {
@@ -183,24 +515,19 @@ void httpd_reply_file(httpd_query_t *q, int dfd, const char *file, bool head)
 
     ob = httpd_reply_hdrs_start(q, HTTP_CODE_OK, false);
     httpd_put_date_hdr(ob, "Last-Modified", st.st_mtime);
-    if (st.st_mtime >= lp_getsec() - 10) {
-        ob_addf(ob, "ETag: W/\"%jx-%jxx-%lx\"\r\n",
-                (int64_t)st.st_ino, st.st_size, st.st_mtime);
-    } else {
-        ob_addf(ob, "ETag: \"%jx-%jxx-%lx\"\r\n",
-                (int64_t)st.st_ino, st.st_size, st.st_mtime);
-    }
+    ob_addf(ob, "ETag: %*pM\r\n", SB_FMT_ARG(&etag));
     mime_put_http_ctype(ob, file);
     httpd_reply_hdrs_done(q, st.st_size, false);
     if (!head) {
         if (map) {
-            ob_add_memmap(ob, map, st.st_size);
+            ob_add_filemap(ob, fd, map, st.st_size);
+            fd = -1;
         } else {
             ob_xread(ob, fd, st.st_size);
         }
     }
     httpd_reply_done(q);
-    close(fd);
+    p_close(&fd);
     return;
 
   ret404:
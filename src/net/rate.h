@@ -67,4 +67,54 @@ void net_rctl_start(net_rctl_t * nonnull rctl);
 void net_rctl_stop(net_rctl_t * nonnull rctl);
 void net_rctl_wipe(net_rctl_t * nonnull rctl);
 
+/* {{{ Token buckets */
+
+/** Hierarchical token bucket.
+ *
+ * A bucket holds up to `burst` tokens and is refilled with `rate` tokens
+ * per second. The refill is computed lazily from the time elapsed since
+ * the last check, so that a bucket costs no timer.
+ *
+ * A bucket can be nested under a parent one, e.g. the buckets of the
+ * clients under a global bucket shared by all of them: a fire then takes a
+ * token from the bucket and from each of its ancestors, and is refused if
+ * any of them is empty.
+ *
+ * The check of a bucket is O(1) (times the depth of the hierarchy, that is
+ * expected to be small).
+ */
+typedef struct net_tbucket_t {
+    struct net_tbucket_t * nullable parent;
+    uint64_t rate;      /* tokens per second */
+    uint64_t burst;     /* maximum number of tokens */
+    uint64_t level;     /* available tokens, in millionths of a token */
+    uint64_t last;      /* time of the last refill, in microseconds */
+} net_tbucket_t;
+
+/** Initialize a token bucket, full.
+ *
+ * \param[in] parent  the parent bucket, NULL for a root bucket.
+ * \param[in] rate    the refill rate, in tokens per second.
+ * \param[in] burst   the capacity of the bucket, at least 1.
+ */
+net_tbucket_t * nonnull
+net_tbucket_init(net_tbucket_t * nonnull tb,
+                 net_tbucket_t * nullable parent, uint64_t rate,
+                 uint64_t burst);
+
+/** Change the rate and the capacity of a token bucket. */
+void net_tbucket_set_rate(net_tbucket_t * nonnull tb, uint64_t rate,
+                          uint64_t burst);
+
+/** Tell whether a token can be taken from a bucket and its ancestors. */
+bool net_tbucket_can_fire(net_tbucket_t * nonnull tb);
+
+/** Take a token from a bucket and from its ancestors.
+ *
+ * \return false, and take nothing, when any of them is empty.
+ */
+bool net_tbucket_fire(net_tbucket_t * nonnull tb);
+
+/* }}} */
+
 #endif
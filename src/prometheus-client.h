@@ -37,6 +37,7 @@
 /* {{{ Base metric class */
 
 struct prom_metric_t;
+struct prom_shards_t;
 union qm_prom_metric_t;
 
 #define PROM_METRIC_FIELDS(pfx) \
@@ -48,6 +49,12 @@ union qm_prom_metric_t;
     qv_t(cstr) label_names;                                                  \
     union qm_prom_metric_t * nullable children_by_labels;                    \
     dlist_t children_list;                                                   \
+    /* Changed when children are added or removed */                         \
+    uint32_t children_gen;                                                   \
+    /* Text exposition of the metric at the last scrape, reused as long as   \
+     * the hash of its values does not change */                            \
+    sb_t text_cache;                                                         \
+    uint64_t text_cache_hash;                                                \
                                                                              \
     /* Children fields */                                                    \
     qv_t(cstr) label_values;                                                 \
@@ -69,6 +76,15 @@ union qm_prom_metric_t;
      */                                                                      \
     spinlock_t lock;                                                         \
                                                                              \
+    /** Per-thread values of the counters and histograms.                    \
+     *                                                                       \
+     * The thr_job workers (but the main thread) update their own shard      \
+     * instead of taking the lock, so that they do not contend when they     \
+     * update the same metric. The shards are folded into the metric values  \
+     * when they are read (get_value() and scraping).                        \
+     */                                                                      \
+    _Atomic(struct prom_shards_t *) shards;                                  \
+                                                                             \
     /* Common fields */                                                      \
     dlist_t siblings_list;                                                   \
 
@@ -176,7 +192,9 @@ prom_metric_t *prom_metric_new(const object_class_t *cls,
     /** Metric value.                                                        \
      *                                                                       \
      * You can safely directy modify it in non multi-threaded environments.  \
-     * If you need thread safety, use the provided helpers.                  \
+     * If you need thread safety, use the provided helpers. For counters     \
+     * updated from thr_job workers, it does not include their shards       \
+     * until get_value() is called.                                          \
      */                                                                      \
     double value;                                                            \
 
@@ -367,7 +385,8 @@ OBJ_CLASS(prom_gauge, prom_simple_value_metric,
      *                                                                       \
      * These fields MUST NOT be modified manually; always use the provided   \
      * observe() method.                                                     \
-     * They are only set in observable metrics.                              \
+     * They are only set in observable metrics, and do not include the       \
+     * observations of the thr_job workers until the metric is scraped.     \
      */                                                                      \
     double count;                                                            \
     double sum;                                                              \
@@ -520,10 +539,145 @@ void prom_histogram_timer_finish(prom_histogram_timer_ctx_t *ctx);
     prom_histogram_timer_ctx_t PFX_LINE(rom_histogram_timer_ctx_) =          \
         prom_histogram_timer_start(_histogram)
 
+/* }}} */
+/* {{{ Native histogram metric */
+
+/* A native histogram is a histogram whose buckets are not configured but
+ * follow an exponential schema: the upper bound of the bucket i is
+ * base^i, where base = 2^(2^-schema). Only the buckets that were observed
+ * exist, so the resolution can be high without costing one series per
+ * bucket. The buckets are allocated as a window that covers the observed
+ * values, so the memory used by a histogram depends on their range.
+ *
+ * The buckets are only exposed in the protobuf exposition format, the text
+ * format exposes the count and the sum (and the +Inf bucket).
+ *
+ * More details here:
+ * https://prometheus.io/docs/specs/native_histograms/
+ */
+
+/** Buckets of one sign of a native histogram.
+ *
+ * counts.tab[i] is the number of observations in the bucket of index
+ * offset + i.
+ */
+typedef struct prom_native_buckets_t {
+    int32_t offset;
+    qv_t(u64) counts;
+} prom_native_buckets_t;
+
+#define PROM_NATIVE_HISTOGRAM_FIELDS(pfx) \
+    PROM_METRIC_FIELDS(pfx);                                                 \
+                                                                             \
+    /* Schema configuration (only set in parent metric) */                   \
+    int8_t schema;                                                           \
+    double zero_threshold;                                                   \
+                                                                             \
+    /* Histogram value and buckets.                                          \
+     *                                                                       \
+     * These fields MUST NOT be modified manually; always use the provided   \
+     * observe() and merge() methods.                                        \
+     * The values whose absolute value is at most zero_threshold are counted \
+     * in zero_count.                                                        \
+     */                                                                      \
+    uint64_t count;                                                          \
+    double sum;                                                              \
+    uint64_t zero_count;                                                     \
+    prom_native_buckets_t positive;                                          \
+    prom_native_buckets_t negative;                                          \
+
+
+#define PROM_NATIVE_HISTOGRAM_METHODS(type_t) \
+    PROM_METRIC_METHODS(type_t);                                             \
+                                                                             \
+    /** Observe the given value. */                                          \
+    void (*observe)(type_t *self, double value);                             \
+                                                                             \
+    /** Add the observations of another native histogram.                    \
+     *                                                                       \
+     * Both histograms MUST have the same schema and zero threshold.         \
+     */                                                                      \
+    void (*merge)(type_t *self, type_t *other);                              \
+
+
+OBJ_CLASS(prom_native_histogram, prom_metric,
+          PROM_NATIVE_HISTOGRAM_FIELDS, PROM_NATIVE_HISTOGRAM_METHODS);
+
+/** Default schema of the native histograms.
+ *
+ * With the schema 3, each power of two is split in 8 buckets, that is a
+ * relative error below 5%.
+ */
+#define PROM_NATIVE_HISTOGRAM_DEFAULT_SCHEMA  3
+
+/** All-in-one helper to declare and register a native histogram metric.
+ *
+ * The histogram uses the default schema and zero threshold, that can be
+ * changed with \ref prom_native_histogram_set_schema before observing it.
+ *
+ * \param[in]  name           name of the histogram
+ * \param[in]  documentation  description of the histogram
+ * \param[in]  ...            the label names of the histogram (empty if the
+ *                            histogram has no label)
+ *
+ * \return  the newly created metric, that was registered in the collector
+ */
+#define prom_native_histogram_new(name, documentation, ...)  \
+    ({                                                                       \
+        const char *__labels[] = { __VA_ARGS__ };                            \
+        prom_metric_t *__new_metric;                                         \
+                                                                             \
+        __new_metric = prom_metric_new(obj_class(prom_native_histogram),     \
+                                       name, documentation,                  \
+                                       __labels, countof(__labels));         \
+        (prom_native_histogram_t *)__new_metric;                             \
+    })
+
+/** Set the schema of a native histogram metric.
+ *
+ * This MUST be called on the parent metric before observing values.
+ *
+ * \p schema MUST be between -4 (buckets growing by a factor 65536) and 8
+ * (buckets growing by a factor 2^(1/256)).
+ * \p zero_threshold MUST be a positive finite number.
+ */
+void prom_native_histogram_set_schema(prom_native_histogram_t *histogram,
+                                      int schema, double zero_threshold);
+
+/** Get the index of the bucket of a native histogram schema containing the
+ *  given (strictly positive and finite) value.
+ *
+ * Exposed for tests.
+ */
+int32_t prom_native_histogram_bucket_idx(int schema, double value);
+
+/** Get the child native histogram corresponding to the given label values.
+ *
+ * This a convenience wrapper around the labels() method of the prom_metric_t
+ * class.
+ *
+ * \param[in]  histogram  the parent native histogram
+ * \param[in]  ...        the label values (must be in the same number as the
+ *                        label names in the parent).
+ *
+ * \return  the child native histogram
+ */
+#define prom_native_histogram_labels(histogram, ...)  \
+    (prom_native_histogram_t *)                                              \
+    prom_metric_labels(obj_vcast(prom_metric, histogram), __VA_ARGS__)
+
 /* }}} */
 /* {{{ HTTP server for scraping */
 
 /** Start the HTTP server for scraping.
+ *
+ * The metrics are served on "/metrics", in the protobuf exposition format
+ * when the scraper accepts it and in the text format otherwise. When the thr
+ * module is loaded, they are formatted by a thr_job and not by the event
+ * loop; the answer is chunked, and gzipped if the scraper accepts it.
+ *
+ * The server also exports the samples of the allocation profiler as
+ * collapsed stacks on "/memprof" (see mem_prof_start()).
  *
  * \param[in]  cfg  HTTP configuration of the server.
  * \param[out] err  error buffer, filled in case of error.
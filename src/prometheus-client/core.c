@@ -21,6 +21,7 @@
 logger_t prom_logger_g = LOGGER_INIT_INHERITS(NULL, "prometheus");
 
 dlist_t prom_collector_g;
+pthread_mutex_t prom_collector_lock_g = PTHREAD_MUTEX_INITIALIZER;
 
 
 static int prometheus_client_initialize(void *arg)
@@ -31,11 +32,14 @@ static int prometheus_client_initialize(void *arg)
 
 static int prometheus_client_shutdown(void)
 {
+    /* A scrape may still be running in a thr_job */
+    pthread_mutex_lock(&prom_collector_lock_g);
     dlist_for_each_entry(prom_metric_t, metric, &prom_collector_g,
                          siblings_list)
     {
         obj_delete(&metric);
     }
+    pthread_mutex_unlock(&prom_collector_lock_g);
 
     return 0;
 }
@@ -0,0 +1,93 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/net.h>
+
+#include "priv.h"
+
+/* Metrics of the cache and of the queries of the DNS resolver, see
+ * dns_get_stats(), pulled each time they are scraped.
+ */
+
+static struct {
+    prom_gauge_t *lookups;
+    prom_gauge_t *hits;
+    prom_gauge_t *coalesced;
+    prom_gauge_t *queries;
+    prom_gauge_t *failures;
+    prom_gauge_t *cache_len;
+    prom_histogram_t *latency;
+} prom_dns_g;
+#define _G  prom_dns_g
+
+void prom_dns_metrics_register(void)
+{
+    _G.lookups = prom_gauge_new("lib_common_dns_lookups",
+                                "Number of resolutions of host names");
+    _G.hits = prom_gauge_new("lib_common_dns_cache_hits",
+                             "Number of resolutions answered by the cache",
+                             "kind");
+    _G.coalesced = prom_gauge_new("lib_common_dns_coalesced_lookups",
+                                  "Number of resolutions that joined a "
+                                  "running one for the same name");
+    _G.queries = prom_gauge_new("lib_common_dns_queries",
+                                "Number of questions sent to the name "
+                                "servers", "transport");
+    _G.failures = prom_gauge_new("lib_common_dns_failed_resolutions",
+                                 "Number of resolutions without an answer",
+                                 "reason");
+    _G.cache_len = prom_gauge_new("lib_common_dns_cache_entries",
+                                  "Number of names in the cache");
+    /* the bucket i counts the resolutions below 2^i ms, the last one is the
+     * +Inf bucket */
+    _G.latency = prom_histogram_new("lib_common_dns_resolution_seconds",
+                                    "Duration of the resolutions sent to "
+                                    "the name servers");
+    prom_histogram_set_exponential_buckets(_G.latency, 1e-3, 2,
+                                           DNS_LATENCY_BUCKETS);
+}
+
+void prom_dns_metrics_wipe(void)
+{
+    /* the metrics themselves are destroyed with the collector */
+    p_clear(&_G, 1);
+}
+
+void prom_dns_metrics_refresh(void)
+{
+    dns_stats_t stats;
+
+    if (!_G.lookups || !MODULE_IS_LOADED(dns)) {
+        return;
+    }
+    dns_get_stats(&stats);
+    obj_vcall(_G.lookups, set, stats.lookups);
+    obj_vcall(prom_gauge_labels(_G.hits, "positive"), set, stats.hits);
+    obj_vcall(prom_gauge_labels(_G.hits, "negative"), set,
+              stats.negative_hits);
+    obj_vcall(_G.coalesced, set, stats.coalesced);
+    obj_vcall(prom_gauge_labels(_G.queries, "udp"), set, stats.queries);
+    obj_vcall(prom_gauge_labels(_G.queries, "tcp"), set, stats.tcp_queries);
+    obj_vcall(prom_gauge_labels(_G.failures, "timeout"), set,
+              stats.timeouts);
+    obj_vcall(prom_gauge_labels(_G.failures, "server"), set,
+              stats.failures);
+    obj_vcall(_G.cache_len, set, stats.cache_len);
+    prom_histogram_set_counts(_G.latency, stats.latency_hist,
+                              stats.latency_sum / 1e3);
+}
@@ -0,0 +1,105 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/el.h>
+
+#include "priv.h"
+
+/* Metrics of the busy polling and of the profiling of the event loops.
+ *
+ * The event loop cannot depend on the prometheus client, so its statistics
+ * are pulled into the metrics each time they are scraped.
+ */
+
+static struct {
+    prom_gauge_t *spin;
+    prom_gauge_t *waits;
+    prom_gauge_t *cb_seconds;
+    prom_gauge_t *cb_calls;
+    prom_gauge_t *cb_max;
+    prom_gauge_t *slow;
+    prom_histogram_t *lag;
+} prom_el_g;
+#define _G  prom_el_g
+
+void prom_el_metrics_register(void)
+{
+    _G.spin = prom_gauge_new("lib_common_el_busy_poll_spin_seconds",
+                             "Time spent spinning by the busy polling of "
+                             "the event loops");
+    _G.waits = prom_gauge_new("lib_common_el_busy_poll_waits",
+                              "Number of busy polled waits that got events "
+                              "while spinning or that slept", "how");
+
+    /* see el_profile_start(), these stay at zero when it is off */
+    _G.cb_seconds = prom_gauge_new("lib_common_el_callback_seconds",
+                                   "Time spent in the callbacks of the "
+                                   "events", "callback");
+    _G.cb_calls = prom_gauge_new("lib_common_el_callback_calls",
+                                 "Number of calls of the callbacks of the "
+                                 "events", "callback");
+    _G.cb_max = prom_gauge_new("lib_common_el_callback_max_seconds",
+                               "Longest call of the callbacks of the "
+                               "events", "callback");
+    _G.slow = prom_gauge_new("lib_common_el_slow_callbacks",
+                             "Number of calls of callbacks longer than the "
+                             "slow threshold");
+    /* the bucket i counts the lags below 2^i us, the last one is the +Inf
+     * bucket */
+    _G.lag = prom_histogram_new("lib_common_el_loop_lag_seconds",
+                                "Time between the wake-up of the event "
+                                "loops and their next wait for events");
+    prom_histogram_set_exponential_buckets(_G.lag, 1e-6, 2,
+                                           EL_PROFILE_BUCKETS - 1);
+}
+
+void prom_el_metrics_wipe(void)
+{
+    /* the metrics themselves are destroyed with the collector */
+    p_clear(&_G, 1);
+}
+
+static void prom_el_callback_refresh(const el_profile_cb_stats_t *stats,
+                                     void *priv)
+{
+    obj_vcall(prom_gauge_labels(_G.cb_seconds, stats->name), set,
+              stats->sum_ns / 1e9);
+    obj_vcall(prom_gauge_labels(_G.cb_calls, stats->name), set,
+              stats->calls);
+    obj_vcall(prom_gauge_labels(_G.cb_max, stats->name), set,
+              stats->max_ns / 1e9);
+}
+
+void prom_el_metrics_refresh(void)
+{
+    el_fd_busy_poll_stats_t stats;
+    el_profile_stats_t prof;
+
+    if (!_G.spin) {
+        return;
+    }
+    el_fd_get_busy_poll_stats(&stats);
+    obj_vcall(_G.spin, set, stats.spin_ns / 1e9);
+    obj_vcall(prom_gauge_labels(_G.waits, "spin"), set, stats.spin_hits);
+    obj_vcall(prom_gauge_labels(_G.waits, "sleep"), set, stats.sleeps);
+
+    el_profile_get_stats(&prof);
+    obj_vcall(_G.slow, set, prof.slow);
+    prom_histogram_set_counts(_G.lag, prof.lag_hist, prof.lag_sum / 1e9);
+    el_profile_callbacks_stats(&prom_el_callback_refresh, NULL);
+}
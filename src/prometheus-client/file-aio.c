@@ -0,0 +1,80 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+
+#include <lib-common/file-aio.h>
+
+#include "priv.h"
+
+/* Metrics of the asynchronous file writes, see file_aio_get_stats(), pulled
+ * each time they are scraped.
+ */
+
+static struct {
+    prom_gauge_t *queue_depth;
+    prom_gauge_t *requests;
+    prom_gauge_t *bytes;
+    prom_gauge_t *errors;
+    prom_histogram_t *latency;
+} prom_file_aio_g;
+#define _G  prom_file_aio_g
+
+void prom_file_aio_metrics_register(void)
+{
+    _G.queue_depth = prom_gauge_new("lib_common_file_aio_queue_depth",
+                                    "Number of pending file requests",
+                                    "state");
+    _G.requests = prom_gauge_new("lib_common_file_aio_requests",
+                                 "Number of file requests run", "kind");
+    _G.bytes = prom_gauge_new("lib_common_file_aio_written_bytes",
+                              "Number of bytes written to the files");
+    _G.errors = prom_gauge_new("lib_common_file_aio_failed_requests",
+                               "Number of file requests that failed");
+    /* the bucket i counts the requests below 2^i us, the last one is the
+     * +Inf bucket */
+    _G.latency = prom_histogram_new("lib_common_file_aio_request_seconds",
+                                    "Duration of the file requests");
+    prom_histogram_set_exponential_buckets(_G.latency, 1e-6, 2,
+                                           FILE_AIO_LATENCY_BUCKETS);
+}
+
+void prom_file_aio_metrics_wipe(void)
+{
+    /* the metrics themselves are destroyed with the collector */
+    p_clear(&_G, 1);
+}
+
+void prom_file_aio_metrics_refresh(void)
+{
+    file_aio_stats_t stats;
+
+    if (!_G.queue_depth || !MODULE_IS_LOADED(file_aio)) {
+        return;
+    }
+    file_aio_get_stats(&stats);
+    obj_vcall(prom_gauge_labels(_G.queue_depth, "inflight"), set,
+              stats.inflight);
+    obj_vcall(prom_gauge_labels(_G.queue_depth, "queued"), set,
+              stats.queued);
+    obj_vcall(prom_gauge_labels(_G.requests, "write"), set, stats.writes);
+    obj_vcall(prom_gauge_labels(_G.requests, "sync"), set, stats.syncs);
+    obj_vcall(_G.bytes, set, stats.bytes);
+    obj_vcall(_G.errors, set, stats.errors);
+    prom_histogram_set_counts(_G.latency, stats.latency_hist,
+                              stats.latency_sum / 1e6);
+}
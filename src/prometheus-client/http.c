@@ -28,6 +28,8 @@ static struct {
 
     el_t httpd;
     httpd_cfg_t *httpd_cfg;
+
+    bool mem_metrics;
 } prom_http_g = {
 #define _G  prom_http_g
     .logger = LOGGER_INIT_INHERITS(&prom_logger_g, "http"),
@@ -35,27 +37,145 @@ static struct {
 
 /* {{{ "metrics/" query */
 
+#define PROM_PB_CONTENT_TYPE  \
+    "application/vnd.google.protobuf; "                                      \
+    "proto=io.prometheus.client.MetricFamily; encoding=delimited"
+
+/* The protobuf format is used when the scraper accepts it, for the native
+ * histograms. */
+static bool metrics_query_accepts_pb(const httpd_query_t *q)
+{
+    const http_qhdr_t *accept;
+
+    accept = http_qhdr_find(q->qinfo->hdrs, q->qinfo->hdrs_len,
+                            HTTP_WKHDR_ACCEPT);
+    return accept && lstr_contains(LSTR_PS_V(&accept->val),
+                                   LSTR("application/vnd.google.protobuf"));
+}
+
+/* The metrics are formatted by a thr_job, so that the event loop is not
+ * blocked by the big collectors, and then streamed in chunks (compressed
+ * when the scraper accepts it). */
+typedef struct prom_scrape_t {
+    httpd_query_t *q;
+    bool pb;
+    sb_t buf;
+    thr_job_t job;
+    thr_job_t job_done;
+} prom_scrape_t;
+
+#define PROM_SCRAPE_CHUNK_SIZE  (64 << 10)
+
+static void prom_scrape_bridge(prom_scrape_t *scrape)
+{
+    if (scrape->pb) {
+        prom_collector_bridge_pb(&prom_collector_g, &scrape->buf);
+    } else {
+        prom_collector_bridge(&prom_collector_g, &scrape->buf);
+    }
+}
+
+static void prom_scrape_reply(prom_scrape_t *scrape)
+{
+    httpd_query_t *q = scrape->q;
+    outbuf_t *ob = httpd_get_ob(q);
+
+    for (int pos = 0; pos < scrape->buf.len; pos += PROM_SCRAPE_CHUNK_SIZE) {
+        httpd_reply_chunk_start(q, ob);
+        ob_add(ob, scrape->buf.data + pos,
+               MIN(scrape->buf.len - pos, PROM_SCRAPE_CHUNK_SIZE));
+        httpd_reply_chunk_done(q, ob);
+    }
+    httpd_reply_done(q);
+
+    obj_release(&scrape->q);
+    sb_wipe(&scrape->buf);
+    p_delete(&scrape);
+}
+
+static void prom_scrape_run(thr_job_t *job, thr_syn_t *syn)
+{
+    prom_scrape_t *scrape = container_of(job, prom_scrape_t, job);
+
+    prom_scrape_bridge(scrape);
+    thr_queue(thr_queue_main_g, &scrape->job_done);
+}
+
+static void prom_scrape_on_job_done(thr_job_t *job, thr_syn_t *syn)
+{
+    prom_scrape_reply(container_of(job, prom_scrape_t, job_done));
+}
+
 static void metrics_query_on_done(httpd_query_t *q)
 {
-    SB_8k(buf);
+    prom_scrape_t *scrape;
     outbuf_t *ob;
 
+    obj_retain(q);
+    scrape = p_new(prom_scrape_t, 1);
+    scrape->q = q;
+    scrape->pb = metrics_query_accepts_pb(q);
+    scrape->job.run = &prom_scrape_run;
+    scrape->job_done.run = &prom_scrape_on_job_done;
+    sb_init(&scrape->buf);
+
     /* Send request headers */
     ob = httpd_reply_hdrs_start(q, HTTP_CODE_OK, true);
-    ob_adds(ob, "Content-Type: text/plain; version=0.0.4\n");
+    if (scrape->pb) {
+        ob_adds(ob, "Content-Type: " PROM_PB_CONTENT_TYPE "\n");
+    } else {
+        ob_adds(ob, "Content-Type: text/plain; version=0.0.4\n");
+    }
+    httpd_reply_compress(q, Z_BEST_SPEED, HTTPD_ZSTREAM_JOB_MIN);
+    httpd_reply_hdrs_done(q, -1, true);
+
+    /* The statistics of the other modules are pulled from the event loop */
+    prom_mem_metrics_refresh();
+    prom_thr_metrics_refresh();
+    prom_el_metrics_refresh();
+    prom_ic_metrics_refresh();
+    prom_dns_metrics_refresh();
+    prom_ssl_metrics_refresh();
+    prom_file_aio_metrics_refresh();
+
+    if (MODULE_IS_LOADED(thr)) {
+        thr_schedule(&scrape->job);
+    } else {
+        prom_scrape_bridge(scrape);
+        prom_scrape_reply(scrape);
+    }
+}
+
+static void metrics_query_hook(httpd_trigger_t *tcb, struct httpd_query_t *q,
+                               const httpd_qinfo_t *qi)
+{
+    q->on_done = metrics_query_on_done;
+    q->qinfo   = httpd_qinfo_dup(qi);
+}
+
+/* }}} */
+/* {{{ "memprof/" query */
+
+static void memprof_query_on_done(httpd_query_t *q)
+{
+    SB_8k(buf);
+    outbuf_t *ob;
+
+    ob = httpd_reply_hdrs_start(q, HTTP_CODE_OK, true);
+    ob_adds(ob, "Content-Type: text/plain\n");
     httpd_reply_hdrs_done(q, -1, false);
 
-    /* Reply with metrics data */
-    prom_collector_bridge(&prom_collector_g, &buf);
+    /* Reply with the allocations samples as collapsed stacks */
+    mem_prof_dump_collapsed(&buf);
     ob_addsb(ob, &buf);
 
     httpd_reply_done(q);
 }
 
-static void metrics_query_hook(httpd_trigger_t *tcb, struct httpd_query_t *q,
+static void memprof_query_hook(httpd_trigger_t *tcb, struct httpd_query_t *q,
                                const httpd_qinfo_t *qi)
 {
-    q->on_done = metrics_query_on_done;
+    q->on_done = memprof_query_on_done;
     q->qinfo   = httpd_qinfo_dup(qi);
 }
 
@@ -105,6 +225,22 @@ int prom_http_start_server(const core__httpd_cfg__t *cfg,
     trigger->cb = metrics_query_hook;
     httpd_trigger_register(_G.httpd_cfg, GET, "/metrics", trigger);
 
+    /* Register "memprof/" trigger, see mem_prof_start() */
+    trigger     = httpd_trigger_new();
+    trigger->cb = memprof_query_hook;
+    httpd_trigger_register(_G.httpd_cfg, GET, "/memprof", trigger);
+
+    if (!_G.mem_metrics) {
+        prom_mem_metrics_register();
+        prom_thr_metrics_register();
+        prom_el_metrics_register();
+        prom_ic_metrics_register();
+        prom_dns_metrics_register();
+        prom_ssl_metrics_register();
+        prom_file_aio_metrics_register();
+        _G.mem_metrics = true;
+    }
+
     logger_notice(&_G.logger, "listening for prometheus scraping on %*pM",
                   LSTR_FMT_ARG(addr));
     return 0;
@@ -142,6 +278,14 @@ static int prometheus_client_http_shutdown(void)
     lstr_wipe(&_G.listen_host);
     httpd_unlisten(&_G.httpd);
     httpd_cfg_delete(&_G.httpd_cfg);
+    prom_mem_metrics_wipe();
+    prom_thr_metrics_wipe();
+    prom_el_metrics_wipe();
+    prom_ic_metrics_wipe();
+    prom_dns_metrics_wipe();
+    prom_ssl_metrics_wipe();
+    prom_file_aio_metrics_wipe();
+    _G.mem_metrics = false;
     return 0;
 }
 
@@ -0,0 +1,135 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/iop-rpc.h>
+
+#include "priv.h"
+
+/* Metrics of the RPCs implemented by the ichannels, see ic_rpcs_stats(),
+ * and of the adaptive concurrency limits of their interfaces, see
+ * ic_limit_iface().
+ *
+ * The ichannels cannot depend on the prometheus client, so their
+ * statistics are pulled into the metrics each time they are scraped.
+ */
+
+static struct {
+    prom_gauge_t *limit;
+    prom_gauge_t *inflight;
+    prom_gauge_t *queries;
+
+    prom_gauge_t     *rpc_inflight;
+    prom_gauge_t     *rpc_replies;
+    prom_histogram_t *rpc_latency;
+    prom_histogram_t *rpc_query_size;
+    prom_histogram_t *rpc_reply_size;
+} prom_ic_g;
+#define _G  prom_ic_g
+
+void prom_ic_metrics_register(void)
+{
+    _G.limit = prom_gauge_new("lib_common_ic_concurrency_limit",
+                              "Adaptive limit of the queries of the "
+                              "interface processed concurrently", "iface");
+    _G.inflight = prom_gauge_new("lib_common_ic_concurrency_inflight",
+                                 "Number of queries of the interface being "
+                                 "processed", "iface");
+    _G.queries = prom_gauge_new("lib_common_ic_concurrency_queries",
+                                "Number of queries of the interface accepted "
+                                "or rejected by its limit", "iface",
+                                "result");
+
+    /* the bucket i of the RPCs counts the values below 2^i us or bytes,
+     * the last one is the +Inf bucket */
+    _G.rpc_inflight = prom_gauge_new("lib_common_ic_rpc_inflight",
+                                     "Number of queries of the RPC being "
+                                     "processed", "iface", "rpc");
+    _G.rpc_replies = prom_gauge_new("lib_common_ic_rpc_replies",
+                                    "Number of replies of the RPC by status",
+                                    "iface", "rpc", "status");
+    _G.rpc_latency = prom_histogram_new("lib_common_ic_rpc_latency_seconds",
+                                        "Time from the reception of the "
+                                        "queries of the RPC to their reply",
+                                        "iface", "rpc");
+    prom_histogram_set_exponential_buckets(_G.rpc_latency, 1e-6, 2,
+                                           IC_RPC_STATS_BUCKETS - 1);
+    _G.rpc_query_size = prom_histogram_new("lib_common_ic_rpc_query_bytes",
+                                           "Size of the queries of the RPC",
+                                           "iface", "rpc");
+    prom_histogram_set_exponential_buckets(_G.rpc_query_size, 1, 2,
+                                           IC_RPC_STATS_BUCKETS - 1);
+    _G.rpc_reply_size = prom_histogram_new("lib_common_ic_rpc_reply_bytes",
+                                           "Size of the replies of the RPC",
+                                           "iface", "rpc");
+    prom_histogram_set_exponential_buckets(_G.rpc_reply_size, 1, 2,
+                                           IC_RPC_STATS_BUCKETS - 1);
+}
+
+void prom_ic_metrics_wipe(void)
+{
+    /* the metrics themselves are destroyed with the collector */
+    p_clear(&_G, 1);
+}
+
+static void prom_ic_limit_refresh(const ic_limit_stats_t *stats, void *priv)
+{
+    const char *name = stats->name.s;
+
+    obj_vcall(prom_gauge_labels(_G.limit, name), set, stats->limit);
+    obj_vcall(prom_gauge_labels(_G.inflight, name), set, stats->inflight);
+    obj_vcall(prom_gauge_labels(_G.queries, name, "accepted"), set,
+              stats->accepted);
+    obj_vcall(prom_gauge_labels(_G.queries, name, "rejected"), set,
+              stats->rejected);
+}
+
+static void prom_ic_rpc_refresh(const ic_rpc_stats_t *stats, void *priv)
+{
+    const char *iface = stats->iface.s;
+    const char *rpc = stats->rpc.s;
+
+    /* the labels of an RPC are created at the first scrape after its
+     * registration */
+    obj_vcall(prom_gauge_labels(_G.rpc_inflight, iface, rpc), set,
+              stats->inflight);
+    for (int i = 0; i < countof(stats->statuses); i++) {
+        if (stats->statuses[i]) {
+            obj_vcall(prom_gauge_labels(_G.rpc_replies, iface, rpc,
+                                        ic_status_to_string(i)),
+                      set, stats->statuses[i]);
+        }
+    }
+    prom_histogram_set_counts(prom_histogram_labels(_G.rpc_latency,
+                                                    iface, rpc),
+                              stats->latency_hist, stats->latency_sum / 1e6);
+    prom_histogram_set_counts(prom_histogram_labels(_G.rpc_query_size,
+                                                    iface, rpc),
+                              stats->query_size_hist, stats->query_size_sum);
+    prom_histogram_set_counts(prom_histogram_labels(_G.rpc_reply_size,
+                                                    iface, rpc),
+                              stats->reply_size_hist, stats->reply_size_sum);
+}
+
+void prom_ic_metrics_refresh(void)
+{
+    if (!_G.limit) {
+        return;
+    }
+    ic_limits_stats(&prom_ic_limit_refresh, NULL);
+    ic_rpcs_stats(&prom_ic_rpc_refresh, NULL);
+}
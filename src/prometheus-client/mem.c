@@ -0,0 +1,145 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/qpage.h>
+
+#include "priv.h"
+
+/* Metrics of the stack and ring pools, of the qpage zero reserve, of the
+ * shared read buffers of the connections and of the tracked objects.
+ *
+ * The memory pools cannot depend on the prometheus client, so their
+ * telemetry is pulled into these gauges each time the metrics are scraped.
+ * The pools come and go with their threads, and the objects with their
+ * owners: the children of these gauges are rebuilt from scratch on every
+ * scrape.
+ */
+
+static struct {
+    prom_gauge_t *size;
+    prom_gauge_t *hwm;
+    prom_gauge_t *churn;
+
+    prom_gauge_t *qpage_zero_runs;
+    prom_gauge_t *qpage_zero_pages;
+    prom_gauge_t *qpage_zero_hit_ratio;
+
+    prom_gauge_t *rbuf_borrowed;
+    prom_gauge_t *rbuf_resident;
+
+    prom_gauge_t *footprint;
+} prom_mem_g;
+#define _G  prom_mem_g
+
+void prom_mem_metrics_register(void)
+{
+    _G.size = prom_gauge_new("lib_common_mem_pool_size_bytes",
+                             "Size of the blocks of the memory pool",
+                             "type", "name", "pool");
+    _G.hwm = prom_gauge_new("lib_common_mem_pool_frame_hwm_bytes",
+                            "High-water mark of the memory used by the "
+                            "frames of the pool over the last minute",
+                            "type", "name", "pool");
+    _G.churn = prom_gauge_new("lib_common_mem_pool_block_churn",
+                              "Number of blocks created and destroyed by "
+                              "the pool over the last minute",
+                              "type", "name", "pool");
+
+    _G.qpage_zero_runs =
+        prom_gauge_new("lib_common_qpage_zero_reserve_runs",
+                       "Number of runs in the qpage pre-zeroed reserve");
+    _G.qpage_zero_pages =
+        prom_gauge_new("lib_common_qpage_zero_reserve_pages",
+                       "Number of pages in the qpage pre-zeroed reserve");
+    _G.qpage_zero_hit_ratio =
+        prom_gauge_new("lib_common_qpage_zero_reserve_hit_ratio",
+                       "Ratio of the zeroed qpage allocations served by the "
+                       "pre-zeroed reserve");
+
+    _G.rbuf_borrowed =
+        prom_gauge_new("lib_common_sb_rbuf_borrowed_bytes",
+                       "Memory of the shared read buffers held by the "
+                       "connections");
+    _G.rbuf_resident =
+        prom_gauge_new("lib_common_sb_rbuf_resident_bytes",
+                       "Memory of the shared read buffers, held by the "
+                       "connections or cached");
+
+    _G.footprint =
+        prom_gauge_new("lib_common_mem_object_footprint_bytes",
+                       "Memory used by the tracked objects",
+                       "name");
+}
+
+static void prom_mem_pool_refresh(const mem_pool_window_stats_t *stats,
+                                  void *type)
+{
+    char addr[32];
+
+    snprintf(addr, sizeof(addr), "%p", stats->pool);
+    obj_vcall(prom_gauge_labels(_G.size, type, stats->name, addr),
+              set, stats->size);
+    obj_vcall(prom_gauge_labels(_G.hwm, type, stats->name, addr),
+              set, stats->hwm);
+    obj_vcall(prom_gauge_labels(_G.churn, type, stats->name, addr),
+              set, stats->churn);
+}
+
+static void prom_mem_footprint_refresh(const char *name, size_t size,
+                                       void *data)
+{
+    obj_vcall(prom_gauge_labels(_G.footprint, name), set, size);
+}
+
+void prom_mem_metrics_wipe(void)
+{
+    /* the metrics themselves are destroyed with the collector */
+    p_clear(&_G, 1);
+}
+
+void prom_mem_metrics_refresh(void)
+{
+    qpage_zero_reserve_stats_t qpage_zero;
+    sb_rbuf_stats_t rbuf;
+
+    if (!_G.size) {
+        return;
+    }
+    obj_vcall(_G.size, clear);
+    obj_vcall(_G.hwm, clear);
+    obj_vcall(_G.churn, clear);
+
+    mem_stack_pools_window_stats(&prom_mem_pool_refresh, (void *)"stack");
+    mem_ring_pools_window_stats(&prom_mem_pool_refresh, (void *)"ring");
+
+    qpage_zero_reserve_stats(&qpage_zero);
+    obj_vcall(_G.qpage_zero_runs, set, qpage_zero.runs);
+    obj_vcall(_G.qpage_zero_pages, set, qpage_zero.pages);
+    if (qpage_zero.hits + qpage_zero.misses) {
+        obj_vcall(_G.qpage_zero_hit_ratio, set,
+                  (double)qpage_zero.hits
+                / (qpage_zero.hits + qpage_zero.misses));
+    }
+
+    sb_rbuf_get_stats(&rbuf);
+    obj_vcall(_G.rbuf_borrowed, set, rbuf.borrowed_bytes);
+    obj_vcall(_G.rbuf_resident, set, rbuf.resident_bytes);
+
+    obj_vcall(_G.footprint, clear);
+    mem_footprints_get(&prom_mem_footprint_refresh, NULL);
+}
@@ -16,10 +16,14 @@
 /*                                                                         */
 /***************************************************************************/
 
+#include <float.h>
 #include <math.h>
 
+#include <lib-common/arith.h>
 #include <lib-common/container-qhash.h>
 #include <lib-common/datetime.h>
+#include <lib-common/hash.h>
+#include <lib-common/thr.h>
 
 #include "priv.h"
 
@@ -62,6 +66,112 @@ qv_lstr_equal(const qhash_t *qh,
 qm_kptr_ckey_t(prom_metric, qv_t(cstr), prom_metric_t *,
                qv_lstr_hash, qv_lstr_equal);
 
+/* }}} */
+/* {{{ per-thread shards */
+
+/* Values of a counter or of a histogram updated by a thr_job worker. The
+ * value is the counter value or the histogram count. */
+typedef struct prom_shard_t {
+    _Atomic(double) value;
+    _Atomic(double) sum;
+    _Atomic(double) bucket_counts[];
+} prom_shard_t;
+
+struct prom_shards_t {
+    int nb_shards;
+    int nb_buckets;
+    int stride;
+    uint8_t data[] __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+
+static ALWAYS_INLINE prom_shard_t *
+prom_shards_get(struct prom_shards_t *shards, int i)
+{
+    return (prom_shard_t *)(shards->data + i * shards->stride);
+}
+
+static void prom_shard_add(_Atomic(double) *v, double to_add)
+{
+    double cur = atomic_load_explicit(v, memory_order_relaxed);
+
+    /* The shard may be shared by two threads if there are more workers
+     * than shards, and the folding resets it from the scraping thread. */
+    while (!atomic_compare_exchange_weak_explicit(v, &cur, cur + to_add,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+    {
+    }
+}
+
+static double prom_shard_take(_Atomic(double) *v)
+{
+    return atomic_exchange_explicit(v, 0., memory_order_relaxed);
+}
+
+/* Get the shard of the current thread, or NULL if the metric must be
+ * updated under its lock. */
+static prom_shard_t *prom_metric_get_shard(prom_metric_t *self,
+                                           int nb_buckets)
+{
+    size_t id = thr_id();
+    struct prom_shards_t *shards;
+
+    /* The main thread keeps updating the metric values directly, they can
+     * then be read without folding in single-threaded code. */
+    if (id == 0 || id == SIZE_MAX) {
+        return NULL;
+    }
+
+    shards = atomic_load_explicit(&self->shards, memory_order_acquire);
+    if (unlikely(!shards)) {
+        int stride = ROUND_UP(sizeof(prom_shard_t)
+                              + nb_buckets * sizeof(_Atomic(double)),
+                              CACHE_LINE_SIZE);
+
+        spin_lock(&self->lock);
+        shards = atomic_load_explicit(&self->shards, memory_order_relaxed);
+        if (!shards) {
+            shards = pa_new_extra(struct prom_shards_t,
+                                  thr_parallelism_g * stride,
+                                  CACHE_LINE_SIZE);
+            shards->nb_shards = thr_parallelism_g;
+            shards->nb_buckets = nb_buckets;
+            shards->stride = stride;
+            atomic_store_explicit(&self->shards, shards,
+                                  memory_order_release);
+        }
+        spin_unlock(&self->lock);
+    }
+
+    return prom_shards_get(shards, id % shards->nb_shards);
+}
+
+/* Fold the shards of the metric into its values.
+ *
+ * The metric lock must be held.
+ */
+static void prom_metric_fold_shards(prom_metric_t *self, double *value,
+                                    double *sum, double *bucket_counts)
+{
+    struct prom_shards_t *shards;
+
+    shards = atomic_load_explicit(&self->shards, memory_order_acquire);
+    if (!shards) {
+        return;
+    }
+    for (int i = 0; i < shards->nb_shards; i++) {
+        prom_shard_t *shard = prom_shards_get(shards, i);
+
+        *value += prom_shard_take(&shard->value);
+        if (sum) {
+            *sum += prom_shard_take(&shard->sum);
+        }
+        for (int j = 0; j < shards->nb_buckets; j++) {
+            bucket_counts[j] += prom_shard_take(&shard->bucket_counts[j]);
+        }
+    }
+}
+
 /* }}} */
 /* {{{ base metric classes */
 
@@ -69,11 +179,14 @@ static prom_metric_t *prom_metric_init(prom_metric_t *self)
 {
     dlist_init(&self->children_list);
     dlist_init(&self->siblings_list);
+    sb_init(&self->text_cache);
     return self;
 }
 
 static void prom_metric_wipe(prom_metric_t *self)
 {
+    struct prom_shards_t *shards;
+
     /* Remove self from parent's children. */
     if (self->parent) {
         qm_del_key(prom_metric, self->parent->children_by_labels,
@@ -83,6 +196,7 @@ static void prom_metric_wipe(prom_metric_t *self)
     /* Wipe */
     lstr_wipe(&self->name);
     lstr_wipe(&self->documentation);
+    sb_wipe(&self->text_cache);
 
 #define cstr_wipe(str)  p_delete((char **)str)
     qv_deep_wipe(&self->label_names, cstr_wipe);
@@ -94,6 +208,9 @@ static void prom_metric_wipe(prom_metric_t *self)
 
     qm_deep_delete(prom_metric, &self->children_by_labels, IGNORE,
                    obj_delete);
+
+    shards = atomic_load(&self->shards);
+    p_delete(&shards);
 }
 
 int prom_metric_check_name(lstr_t name)
@@ -188,10 +305,12 @@ static void prom_metric_register(prom_metric_t *self)
     }
 
     /* Register */
-    dlist_add_tail(&prom_collector_g, &self->siblings_list);
     if (self->label_names.len) {
         self->children_by_labels = qm_new(prom_metric, 0);
     }
+    pthread_mutex_lock(&prom_collector_lock_g);
+    dlist_add_tail(&prom_collector_g, &self->siblings_list);
+    pthread_mutex_unlock(&prom_collector_lock_g);
 }
 
 static void prom_metric_unregister(prom_metric_t *self)
@@ -203,7 +322,9 @@ static void prom_metric_unregister(prom_metric_t *self)
     }
 
     /* Unregister */
+    pthread_mutex_lock(&prom_collector_lock_g);
     dlist_remove(&self->siblings_list);
+    pthread_mutex_unlock(&prom_collector_lock_g);
 }
 
 static void prom_metric_check_labels(prom_metric_t *self, const char *func,
@@ -252,6 +373,7 @@ static prom_metric_t *
 
     self->children_by_labels->keys[pos] = &child->label_values;
     self->children_by_labels->values[pos] = child;
+    self->children_gen++;
 
     spin_unlock(&self->lock);
 
@@ -266,11 +388,14 @@ static void
     /* Consistency checks */
     prom_metric_check_labels(self, "labels", label_values);
 
-    /* Remove child */
+    /* Remove child, the lock protects the children from the scrapes */
+    spin_lock(&self->lock);
     pos = qm_del_key(prom_metric, self->children_by_labels, label_values);
     if (pos >= 0) {
         obj_delete(&self->children_by_labels->values[pos]);
+        self->children_gen++;
     }
+    spin_unlock(&self->lock);
 }
 
 static void prom_metric_clear(prom_metric_t *self)
@@ -281,7 +406,10 @@ static void prom_metric_clear(prom_metric_t *self)
     }
 
     /* Clear */
+    spin_lock(&self->lock);
     qm_deep_clear(prom_metric, self->children_by_labels, IGNORE, obj_delete);
+    self->children_gen++;
+    spin_unlock(&self->lock);
 }
 
 OBJ_VTABLE(prom_metric)
@@ -336,6 +464,8 @@ prom_simple_value_metric_get_value(prom_simple_value_metric_t *self)
     double res;
 
     spin_lock(&self->lock);
+    prom_metric_fold_shards(obj_vcast(prom_metric, self), &self->value,
+                            NULL, NULL);
     res = self->value;
     spin_unlock(&self->lock);
 
@@ -349,21 +479,34 @@ OBJ_VTABLE_END()
 /* }}} */
 /* {{{ prom_counter_t */
 
+static void prom_counter_add_value(prom_counter_t *self, double value)
+{
+    prom_shard_t *shard;
+
+    shard = prom_metric_get_shard(obj_vcast(prom_metric, self), 0);
+    if (shard) {
+        prom_shard_add(&shard->value, value);
+    } else {
+        simple_value_metric_add(&self->super, value);
+    }
+}
+
 static void prom_counter_add(prom_counter_t *self, double value)
 {
     if (expect(is_metric_observable(&self->super.super) && value >= 0)) {
-        simple_value_metric_add(&self->super, value);
+        prom_counter_add_value(self, value);
     }
 }
 
 static void prom_counter_inc(prom_counter_t *self)
 {
     if (expect(is_metric_observable(&self->super.super))) {
-        simple_value_metric_add(&self->super, 1.);
+        prom_counter_add_value(self, 1.);
     }
 }
 
 OBJ_VTABLE(prom_counter)
+    prom_counter.type_mp = obj_class_pool(prom_counter, 1024);
     prom_counter.add = prom_counter_add;
     prom_counter.inc = prom_counter_inc;
 OBJ_VTABLE_END()
@@ -409,6 +552,7 @@ static void prom_gauge_set(prom_gauge_t *self, double value)
 }
 
 OBJ_VTABLE(prom_gauge)
+    prom_gauge.type_mp = obj_class_pool(prom_gauge, 1024);
     prom_gauge.add = prom_gauge_add;
     prom_gauge.inc = prom_gauge_inc;
     prom_gauge.sub = prom_gauge_sub;
@@ -425,19 +569,23 @@ static void prom_histogram_wipe(prom_histogram_t *self)
     p_delete(&self->bucket_counts);
 }
 
-static void prom_histogram_register(prom_histogram_t *self)
+static void prom_metric_check_histogram_labels(prom_metric_t *self)
 {
-    super_call(prom_histogram, self, do_register);
-
     /* Check that "le" is not used as a label name */
     tab_for_each_entry(label, &self->label_names) {
         if (strequal(label, "le")) {
-            prom_metric_panic(obj_vcast(prom_metric, self), "do_register",
+            prom_metric_panic(self, "do_register",
                               "label name `le` is reserved for histograms");
         }
     }
 }
 
+static void prom_histogram_register(prom_histogram_t *self)
+{
+    super_call(prom_histogram, self, do_register);
+    prom_metric_check_histogram_labels(obj_vcast(prom_metric, self));
+}
+
 static void (prom_histogram_set_buckets)(prom_histogram_t *self,
                                          const qv_t(double) *upper_bounds)
 {
@@ -550,11 +698,14 @@ static prom_histogram_t *
     child_metric = super_call(prom_histogram, self, labels, label_values);
     child = obj_vcast(prom_histogram, child_metric);
 
-    /* Create the buckets counts if the child was just created */
+    /* Create the buckets counts if the child was just created; the child
+     * can already be scraped. */
+    spin_lock(&child->lock);
     if (!child->bucket_counts) {
-        child->nb_buckets = self->nb_buckets;
         child->bucket_counts = p_new(double, self->nb_buckets);
+        child->nb_buckets = self->nb_buckets;
     }
+    spin_unlock(&child->lock);
 
     return child;
 }
@@ -562,6 +713,7 @@ static prom_histogram_t *
 static void prom_histogram_observe(prom_histogram_t *self, double value)
 {
     prom_histogram_t *parent = self->parent ?: self;
+    prom_shard_t *shard;
 
     if (!is_metric_observable(obj_ccast(prom_metric, self))) {
         prom_metric_panic(obj_vcast(prom_metric, self), "observe",
@@ -572,6 +724,20 @@ static void prom_histogram_observe(prom_histogram_t *self, double value)
                           "histogram buckets were not initialized");
     }
 
+    shard = prom_metric_get_shard(obj_vcast(prom_metric, self),
+                                  self->nb_buckets);
+    if (shard) {
+        prom_shard_add(&shard->value, 1.);
+        prom_shard_add(&shard->sum, value);
+        for (int i = self->nb_buckets; i-- > 0;) {
+            if (value > parent->bucket_upper_bounds[i]) {
+                break;
+            }
+            prom_shard_add(&shard->bucket_counts[i], 1.);
+        }
+        return;
+    }
+
     spin_lock(&self->lock);
 
     self->count++;
@@ -587,6 +753,31 @@ static void prom_histogram_observe(prom_histogram_t *self, double value)
     spin_unlock(&self->lock);
 }
 
+void prom_histogram_set_counts(prom_histogram_t *self,
+                               const uint64_t *counts, double sum)
+{
+    double total = 0;
+
+    if (!is_metric_observable(obj_ccast(prom_metric, self))) {
+        prom_metric_panic(obj_vcast(prom_metric, self), "set_counts",
+                          "histogram is not observable");
+    }
+
+    spin_lock(&self->lock);
+
+    /* Drop the pending observations of the workers. */
+    prom_metric_fold_shards(obj_vcast(prom_metric, self), &self->count,
+                            &self->sum, self->bucket_counts);
+    for (int i = 0; i < self->nb_buckets; i++) {
+        total += counts[i];
+        self->bucket_counts[i] = total;
+    }
+    self->count = total + counts[self->nb_buckets];
+    self->sum = sum;
+
+    spin_unlock(&self->lock);
+}
+
 OBJ_VTABLE(prom_histogram)
     prom_histogram.wipe        = prom_histogram_wipe;
     prom_histogram.do_register = prom_histogram_register;
@@ -619,6 +810,197 @@ void prom_histogram_timer_finish(prom_histogram_timer_ctx_t *ctx)
     obj_vcall(ctx->histogram, observe, duration);
 }
 
+/* }}} */
+/* {{{ prom_native_histogram_t */
+
+static prom_native_histogram_t *
+prom_native_histogram_init(prom_native_histogram_t *self)
+{
+    self->schema = PROM_NATIVE_HISTOGRAM_DEFAULT_SCHEMA;
+    self->zero_threshold = 0x1p-128;
+    return self;
+}
+
+static void prom_native_histogram_wipe(prom_native_histogram_t *self)
+{
+    qv_wipe(&self->positive.counts);
+    qv_wipe(&self->negative.counts);
+}
+
+static void prom_native_histogram_register(prom_native_histogram_t *self)
+{
+    super_call(prom_native_histogram, self, do_register);
+    prom_metric_check_histogram_labels(obj_vcast(prom_metric, self));
+}
+
+void prom_native_histogram_set_schema(prom_native_histogram_t *self,
+                                      int schema, double zero_threshold)
+{
+    /* Consistency checks */
+    if (self->parent) {
+        prom_metric_panic(obj_vcast(prom_metric, self), "set_schema",
+                          "schema can only be set on parent histogram");
+    }
+    if (self->count || !dlist_is_empty(&self->children_list)) {
+        prom_metric_panic(obj_vcast(prom_metric, self), "set_schema",
+                          "histogram was already observed");
+    }
+    if (schema < -4 || schema > 8) {
+        prom_metric_panic(obj_vcast(prom_metric, self), "set_schema",
+                          "schema must be between -4 and 8");
+    }
+    if (!isfinite(zero_threshold) || zero_threshold < 0) {
+        prom_metric_panic(obj_vcast(prom_metric, self), "set_schema",
+                          "zero threshold must be a positive finite number");
+    }
+
+    self->schema = schema;
+    self->zero_threshold = zero_threshold;
+}
+
+int32_t prom_native_histogram_bucket_idx(int schema, double value)
+{
+    int exp;
+    double frac = frexp(value, &exp);
+
+    /* value = frac * 2^exp, with frac in [0.5, 1[ */
+    if (schema > 0) {
+        /* log2(value) = exp - 1 + log2(2 * frac), only the logarithm of the
+         * mantissa has to be computed, in [0, 1[. */
+        return (exp - 1) * (1 << schema)
+             + (int32_t)ceil(log2(2 * frac) * (1 << schema));
+    }
+
+    /* The powers of two are the upper bounds of their buckets. */
+    if (frac == 0.5) {
+        exp--;
+    }
+    return (exp + (1 << -schema) - 1) >> -schema;
+}
+
+static void prom_native_buckets_add(prom_native_buckets_t *buckets,
+                                    int32_t idx, uint64_t count)
+{
+    if (!buckets->counts.len) {
+        buckets->offset = idx;
+    } else
+    if (idx < buckets->offset) {
+        int extra = buckets->offset - idx;
+
+        p_clear(__qv_splice(&buckets->counts, 0, 0, extra), extra);
+        buckets->offset = idx;
+    }
+    if (idx - buckets->offset >= buckets->counts.len) {
+        qv_growlen0(&buckets->counts,
+                    idx - buckets->offset - buckets->counts.len + 1);
+    }
+    buckets->counts.tab[idx - buckets->offset] += count;
+}
+
+static void prom_native_buckets_merge(prom_native_buckets_t *buckets,
+                                      const prom_native_buckets_t *other)
+{
+    tab_for_each_pos(pos, &other->counts) {
+        if (other->counts.tab[pos]) {
+            prom_native_buckets_add(buckets, other->offset + pos,
+                                    other->counts.tab[pos]);
+        }
+    }
+}
+
+static void prom_native_histogram_observe(prom_native_histogram_t *self,
+                                          double value)
+{
+    prom_native_histogram_t *parent = self->parent ?: self;
+    prom_native_buckets_t *buckets = NULL;
+    int32_t idx = 0;
+
+    if (!is_metric_observable(obj_ccast(prom_metric, self))) {
+        prom_metric_panic(obj_vcast(prom_metric, self), "observe",
+                          "histogram is not observable");
+    }
+
+    /* NaN values are only accounted in the count and the sum. */
+    if (fabs(value) > parent->zero_threshold) {
+        buckets = value > 0 ? &self->positive : &self->negative;
+        idx = prom_native_histogram_bucket_idx(parent->schema,
+                                               MIN(fabs(value), DBL_MAX));
+    }
+
+    spin_lock(&self->lock);
+
+    self->count++;
+    self->sum += value;
+    if (buckets) {
+        prom_native_buckets_add(buckets, idx, 1);
+    } else
+    if (!isnan(value)) {
+        self->zero_count++;
+    }
+
+    spin_unlock(&self->lock);
+}
+
+static void prom_native_histogram_merge(prom_native_histogram_t *self,
+                                        prom_native_histogram_t *other)
+{
+    t_scope;
+    prom_native_histogram_t *parent = self->parent ?: self;
+    prom_native_histogram_t *other_parent = other->parent ?: other;
+    prom_native_buckets_t positive;
+    prom_native_buckets_t negative;
+    uint64_t count;
+    uint64_t zero_count;
+    double sum;
+
+    if (!is_metric_observable(obj_ccast(prom_metric, self))
+    ||  !is_metric_observable(obj_ccast(prom_metric, other)))
+    {
+        prom_metric_panic(obj_vcast(prom_metric, self), "merge",
+                          "histograms are not observable");
+    }
+    if (self == other) {
+        prom_metric_panic(obj_vcast(prom_metric, self), "merge",
+                          "cannot merge a histogram into itself");
+    }
+    if (parent->schema != other_parent->schema
+    ||  parent->zero_threshold != other_parent->zero_threshold)
+    {
+        prom_metric_panic(obj_vcast(prom_metric, self), "merge",
+                          "histograms have different schemas");
+    }
+
+    /* Copy the other histogram so that the two locks are never held
+     * together. */
+    spin_lock(&other->lock);
+    count = other->count;
+    sum = other->sum;
+    zero_count = other->zero_count;
+    positive.offset = other->positive.offset;
+    t_qv_init(&positive.counts, other->positive.counts.len);
+    qv_extend_tab(&positive.counts, &other->positive.counts);
+    negative.offset = other->negative.offset;
+    t_qv_init(&negative.counts, other->negative.counts.len);
+    qv_extend_tab(&negative.counts, &other->negative.counts);
+    spin_unlock(&other->lock);
+
+    spin_lock(&self->lock);
+    self->count += count;
+    self->sum += sum;
+    self->zero_count += zero_count;
+    prom_native_buckets_merge(&self->positive, &positive);
+    prom_native_buckets_merge(&self->negative, &negative);
+    spin_unlock(&self->lock);
+}
+
+OBJ_VTABLE(prom_native_histogram)
+    prom_native_histogram.init        = prom_native_histogram_init;
+    prom_native_histogram.wipe        = prom_native_histogram_wipe;
+    prom_native_histogram.do_register = prom_native_histogram_register;
+    prom_native_histogram.observe     = prom_native_histogram_observe;
+    prom_native_histogram.merge       = prom_native_histogram_merge;
+OBJ_VTABLE_END()
+
 /* }}} */
 /* {{{ Bridge function for exposition in text format */
 
@@ -647,23 +1029,28 @@ static void bridge_simple_value(prom_simple_value_metric_t *metric, sb_t *out)
     sb_addf(out, " %g\n", metric->value);
 }
 
-static void bridge_histogram(prom_histogram_t *metric, sb_t *out)
+static void bridge_label_names(const prom_metric_t *metric, sb_t *out)
 {
-    SB_1k(label_names);
-    prom_histogram_t *parent = metric->parent ?: metric;
-
-    /* Build a buffer containing label names */
     for (int i = 0; i < metric->label_values.len; i++) {
         const char *label_name = metric->parent->label_names.tab[i];
         const char *label_value = metric->label_values.tab[i];
 
         if (i > 0) {
-            sb_addc(&label_names, ',');
+            sb_addc(out, ',');
         }
-        sb_addf(&label_names, "%s=\"", label_name);
-        sb_adds_slashes(&label_names, label_value, "\\\n", "\\n");
-        sb_addc(&label_names, '"');
+        sb_addf(out, "%s=\"", label_name);
+        sb_adds_slashes(out, label_value, "\\\n", "\\n");
+        sb_addc(out, '"');
     }
+}
+
+static void bridge_histogram(prom_histogram_t *metric, sb_t *out)
+{
+    SB_1k(label_names);
+    prom_histogram_t *parent = metric->parent ?: metric;
+
+    /* Build a buffer containing label names */
+    bridge_label_names(obj_ccast(prom_metric, metric), &label_names);
 
     /* Add the line for each bucket */
     for (int i = 0; i < metric->nb_buckets; i++) {
@@ -704,36 +1091,76 @@ static void bridge_histogram(prom_histogram_t *metric, sb_t *out)
     sb_addc(out, '\n');
 }
 
-static void bridge_sample(prom_metric_t *metric, sb_t *out)
+/* The buckets of the native histograms are only exposed in the protobuf
+ * format, the text format only gets their count and sum. */
+static void bridge_native_histogram(prom_native_histogram_t *metric,
+                                    sb_t *out)
+{
+    SB_1k(label_names);
+    lstr_t name = metric->parent ? metric->parent->name : metric->name;
+
+    bridge_label_names(obj_ccast(prom_metric, metric), &label_names);
+
+    sb_add_lstr(out, name);
+    sb_addf(out, "_bucket{%*pM", SB_FMT_ARG(&label_names));
+    if (metric->label_values.len) {
+        sb_addc(out, ',');
+    }
+    sb_addf(out, "le=\"+Inf\"} %ju\n", metric->count);
+
+    sb_add_lstr(out, name);
+    sb_adds(out, "_sum");
+    if (metric->label_values.len) {
+        sb_addf(out, "{%*pM}", SB_FMT_ARG(&label_names));
+    }
+    sb_addf(out, " %g\n", metric->sum);
+
+    sb_add_lstr(out, name);
+    sb_adds(out, "_count");
+    if (metric->label_values.len) {
+        sb_addf(out, "{%*pM}", SB_FMT_ARG(&label_names));
+    }
+    sb_addf(out, " %ju\n", metric->count);
+
+    sb_addc(out, '\n');
+}
+
+/* Fold the shards of a sample into its values, with its lock held. */
+static void bridge_fold_sample(prom_metric_t *metric)
 {
     prom_simple_value_metric_t *simple_value;
+    prom_histogram_t *histogram;
 
     simple_value = obj_dynvcast(prom_simple_value_metric, metric);
     if (simple_value) {
-        bridge_simple_value(simple_value, out);
-    } else {
-        bridge_histogram(obj_vcast(prom_histogram, metric), out);
+        prom_metric_fold_shards(metric, &simple_value->value, NULL, NULL);
+        return;
+    }
+    histogram = obj_dynvcast(prom_histogram, metric);
+    if (histogram) {
+        prom_metric_fold_shards(metric, &histogram->count, &histogram->sum,
+                                histogram->bucket_counts);
     }
 }
 
-static void prom_collector_bridge_metric(prom_metric_t *metric, sb_t *out)
+static void bridge_sample(prom_metric_t *metric, sb_t *out)
 {
-    lstr_t metric_type = LSTR_NULL_V;
+    bridge_fold_sample(metric);
 
-    /* Skip metrics without samples */
-    if (metric->label_names.len
-    &&  !qm_len(prom_metric, metric->children_by_labels))
-    {
-        return;
+    if (obj_is_a(metric, prom_simple_value_metric)) {
+        bridge_simple_value(obj_vcast(prom_simple_value_metric, metric), out);
+    } else
+    if (obj_is_a(metric, prom_native_histogram)) {
+        bridge_native_histogram(obj_vcast(prom_native_histogram, metric),
+                                out);
+    } else {
+        bridge_histogram(obj_vcast(prom_histogram, metric), out);
     }
+}
 
-    /* Ensure there is an empty line between each metric */
-    if (out->len >= 2
-    &&  (out->data[out->len - 1] != '\n'
-      || out->data[out->len - 2] != '\n'))
-    {
-        sb_adds(out, "\n");
-    }
+static void bridge_metric(prom_metric_t *metric, sb_t *out)
+{
+    lstr_t metric_type = LSTR_NULL_V;
 
     /* Add HELP and TYPE */
     sb_addf(out, "# HELP %*pM ", LSTR_FMT_ARG(metric->name));
@@ -749,7 +1176,9 @@ static void prom_collector_bridge_metric(prom_metric_t *metric, sb_t *out)
     if (obj_is_a(metric, prom_gauge)) {
         metric_type = LSTR("gauge");
     } else
-    if (obj_is_a(metric, prom_histogram)) {
+    if (obj_is_a(metric, prom_histogram)
+    ||  obj_is_a(metric, prom_native_histogram))
+    {
         metric_type = LSTR("histogram");
     } else {
         assert (false);
@@ -772,13 +1201,100 @@ static void prom_collector_bridge_metric(prom_metric_t *metric, sb_t *out)
     }
 }
 
+static void prom_hash_add(uint64_t *hash, const void *data, ssize_t len)
+{
+    if (len) {
+        *hash = (*hash * 0x100000001b3ULL) ^ mem_hash64(data, len);
+    }
+}
+
+/* Hash the values of a sample, with its lock held. */
+static void bridge_hash_sample(prom_metric_t *metric, uint64_t *hash)
+{
+    bridge_fold_sample(metric);
+    prom_hash_add(hash, &metric, sizeof(metric));
+
+    if (obj_is_a(metric, prom_simple_value_metric)) {
+        prom_simple_value_metric_t *simple_value;
+
+        simple_value = obj_vcast(prom_simple_value_metric, metric);
+        prom_hash_add(hash, &simple_value->value, sizeof(double));
+    } else
+    if (obj_is_a(metric, prom_native_histogram)) {
+        prom_native_histogram_t *native;
+
+        native = obj_vcast(prom_native_histogram, metric);
+        prom_hash_add(hash, &native->count, sizeof(uint64_t));
+        prom_hash_add(hash, &native->sum, sizeof(double));
+        prom_hash_add(hash, &native->zero_count, sizeof(uint64_t));
+    } else {
+        prom_histogram_t *histogram = obj_vcast(prom_histogram, metric);
+
+        prom_hash_add(hash, &histogram->count, sizeof(double));
+        prom_hash_add(hash, &histogram->sum, sizeof(double));
+        prom_hash_add(hash, histogram->bucket_counts,
+                      histogram->nb_buckets * sizeof(double));
+    }
+}
+
+/* Hash the values of a metric, to know if its text exposition changed
+ * since the last scrape. This is much cheaper than formatting it. */
+static uint64_t bridge_hash_metric(prom_metric_t *metric)
+{
+    uint64_t hash = metric->children_gen;
+
+    if (is_metric_observable(metric)) {
+        bridge_hash_sample(metric, &hash);
+    } else {
+        dlist_for_each_entry(prom_metric_t, child, &metric->children_list,
+                             siblings_list)
+        {
+            spin_lock(&child->lock);
+            bridge_hash_sample(child, &hash);
+            spin_unlock(&child->lock);
+        }
+    }
+    return hash;
+}
+
+static void prom_collector_bridge_metric(prom_metric_t *metric, sb_t *out)
+{
+    uint64_t hash;
+
+    /* Skip metrics without samples */
+    if (metric->label_names.len
+    &&  !qm_len(prom_metric, metric->children_by_labels))
+    {
+        return;
+    }
+
+    /* Ensure there is an empty line between each metric */
+    if (out->len >= 2
+    &&  (out->data[out->len - 1] != '\n'
+      || out->data[out->len - 2] != '\n'))
+    {
+        sb_adds(out, "\n");
+    }
+
+    /* Format the metric again only if its values changed */
+    hash = bridge_hash_metric(metric);
+    if (!metric->text_cache.len || hash != metric->text_cache_hash) {
+        sb_reset(&metric->text_cache);
+        bridge_metric(metric, &metric->text_cache);
+        metric->text_cache_hash = hash;
+    }
+    sb_addsb(out, &metric->text_cache);
+}
+
 void prom_collector_bridge(const dlist_t *collector, sb_t *out)
 {
+    pthread_mutex_lock(&prom_collector_lock_g);
     dlist_for_each_entry(prom_metric_t, metric, collector, siblings_list) {
         spin_lock(&metric->lock);
         prom_collector_bridge_metric(metric, out);
         spin_unlock(&metric->lock);
     }
+    pthread_mutex_unlock(&prom_collector_lock_g);
 
     if (out->len && out->data[out->len - 1] == '\n') {
         sb_shrink(out, 1);
@@ -786,3 +1302,272 @@ void prom_collector_bridge(const dlist_t *collector, sb_t *out)
 }
 
 /* }}} */
+/* {{{ Bridge function for exposition in protobuf format */
+
+/* Subset of the protobuf encoding needed by the messages of
+ * io.prometheus.client, see
+ * https://github.com/prometheus/client_model/blob/master/io/prometheus/client/metrics.proto
+ */
+
+enum {
+    PB_WIRE_VARINT  = 0,
+    PB_WIRE_FIXED64 = 1,
+    PB_WIRE_LEN     = 2,
+};
+
+enum {
+    PB_METRIC_TYPE_COUNTER   = 0,
+    PB_METRIC_TYPE_GAUGE     = 1,
+    PB_METRIC_TYPE_HISTOGRAM = 4,
+};
+
+static int pb_encode_varint(uint8_t buf[static 10], uint64_t v)
+{
+    int len = 0;
+
+    while (v >= 0x80) {
+        buf[len++] = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    buf[len++] = v;
+    return len;
+}
+
+static void pb_add_varint(sb_t *out, uint64_t v)
+{
+    uint8_t buf[10];
+
+    sb_add(out, buf, pb_encode_varint(buf, v));
+}
+
+static void pb_add_tag(sb_t *out, int field, int wire_type)
+{
+    pb_add_varint(out, (field << 3) | wire_type);
+}
+
+static void pb_add_uint64(sb_t *out, int field, uint64_t v)
+{
+    pb_add_tag(out, field, PB_WIRE_VARINT);
+    pb_add_varint(out, v);
+}
+
+static void pb_add_sint64(sb_t *out, int field, int64_t v)
+{
+    pb_add_tag(out, field, PB_WIRE_VARINT);
+    pb_add_varint(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static void pb_add_double(sb_t *out, int field, double d)
+{
+    uint64_t v;
+
+    memcpy(&v, &d, sizeof(v));
+    pb_add_tag(out, field, PB_WIRE_FIXED64);
+    put_unaligned_le64(sb_growlen(out, sizeof(v)), v);
+}
+
+static void pb_add_str(sb_t *out, int field, const char *s, int len)
+{
+    pb_add_tag(out, field, PB_WIRE_LEN);
+    pb_add_varint(out, len);
+    sb_add(out, s, len);
+}
+
+/* The length of a message is only known once it is written: it is inserted
+ * in front of it by pb_end(), with the position returned by pb_start(). */
+static int pb_start(sb_t *out, int field)
+{
+    pb_add_tag(out, field, PB_WIRE_LEN);
+    return out->len;
+}
+
+static void pb_end(sb_t *out, int pos)
+{
+    uint8_t buf[10];
+
+    sb_splice(out, pos, 0, buf, pb_encode_varint(buf, out->len - pos));
+}
+
+static void pb_bridge_labels(const prom_metric_t *metric, sb_t *out)
+{
+    for (int i = 0; i < metric->label_values.len; i++) {
+        const char *label_name = metric->parent->label_names.tab[i];
+        const char *label_value = metric->label_values.tab[i];
+        int pos = pb_start(out, 1);
+
+        pb_add_str(out, 1, label_name, strlen(label_name));
+        pb_add_str(out, 2, label_value, strlen(label_value));
+        pb_end(out, pos);
+    }
+}
+
+static void pb_bridge_histogram(const prom_histogram_t *metric, sb_t *out)
+{
+    const prom_histogram_t *parent = metric->parent ?: metric;
+    int pos = pb_start(out, 7);
+
+    pb_add_uint64(out, 1, metric->count);
+    pb_add_double(out, 2, metric->sum);
+    for (int i = 0; i < metric->nb_buckets; i++) {
+        int bucket_pos = pb_start(out, 3);
+
+        pb_add_uint64(out, 1, metric->bucket_counts[i]);
+        pb_add_double(out, 2, parent->bucket_upper_bounds[i]);
+        pb_end(out, bucket_pos);
+    }
+    pb_end(out, pos);
+}
+
+/* Write the spans of consecutive non-empty buckets, then the difference of
+ * each non-empty bucket with the previous one. */
+static int pb_bridge_native_buckets(const prom_native_buckets_t *buckets,
+                                    int span_field, int delta_field,
+                                    sb_t *out)
+{
+    const qv_t(u64) *counts = &buckets->counts;
+    int32_t prev_end = 0;
+    int64_t prev_count = 0;
+    int nb_spans = 0;
+
+    for (int i = 0; i < counts->len;) {
+        int start;
+        int pos;
+
+        if (!counts->tab[i]) {
+            i++;
+            continue;
+        }
+        start = i;
+        while (i < counts->len && counts->tab[i]) {
+            i++;
+        }
+
+        pos = pb_start(out, span_field);
+        pb_add_sint64(out, 1, buckets->offset + start - prev_end);
+        pb_add_uint64(out, 2, i - start);
+        pb_end(out, pos);
+        prev_end = buckets->offset + i;
+        nb_spans++;
+    }
+
+    tab_for_each_entry(count, counts) {
+        if (count) {
+            pb_add_sint64(out, delta_field, (int64_t)count - prev_count);
+            prev_count = count;
+        }
+    }
+
+    return nb_spans;
+}
+
+static void pb_bridge_native_histogram(const prom_native_histogram_t *metric,
+                                       sb_t *out)
+{
+    const prom_native_histogram_t *parent = metric->parent ?: metric;
+    int pos = pb_start(out, 7);
+    int nb_spans = 0;
+
+    pb_add_uint64(out, 1, metric->count);
+    pb_add_double(out, 2, metric->sum);
+    pb_add_sint64(out, 5, parent->schema);
+    pb_add_double(out, 6, parent->zero_threshold);
+    pb_add_uint64(out, 7, metric->zero_count);
+    nb_spans += pb_bridge_native_buckets(&metric->negative, 9, 10, out);
+    nb_spans += pb_bridge_native_buckets(&metric->positive, 12, 13, out);
+
+    /* An empty span tells the scraper that the histogram is a native one
+     * when nothing else does. */
+    if (!nb_spans && !metric->zero_count && !parent->zero_threshold) {
+        int span_pos = pb_start(out, 12);
+
+        pb_end(out, span_pos);
+    }
+    pb_end(out, pos);
+}
+
+static void pb_bridge_sample(prom_metric_t *metric, sb_t *out)
+{
+    int pos = pb_start(out, 4);
+
+    bridge_fold_sample(metric);
+    pb_bridge_labels(metric, out);
+
+    if (obj_is_a(metric, prom_simple_value_metric)) {
+        prom_simple_value_metric_t *simple_value;
+        int value_pos;
+
+        simple_value = obj_vcast(prom_simple_value_metric, metric);
+        value_pos = pb_start(out, obj_is_a(metric, prom_counter) ? 3 : 2);
+        pb_add_double(out, 1, simple_value->value);
+        pb_end(out, value_pos);
+    } else
+    if (obj_is_a(metric, prom_native_histogram)) {
+        pb_bridge_native_histogram(obj_vcast(prom_native_histogram, metric),
+                                   out);
+    } else {
+        pb_bridge_histogram(obj_vcast(prom_histogram, metric), out);
+    }
+
+    pb_end(out, pos);
+}
+
+static void prom_collector_bridge_pb_metric(prom_metric_t *metric, sb_t *out)
+{
+    int type;
+    int pos;
+
+    /* Skip metrics without samples */
+    if (metric->label_names.len
+    &&  !qm_len(prom_metric, metric->children_by_labels))
+    {
+        return;
+    }
+
+    if (obj_is_a(metric, prom_counter)) {
+        type = PB_METRIC_TYPE_COUNTER;
+    } else
+    if (obj_is_a(metric, prom_gauge)) {
+        type = PB_METRIC_TYPE_GAUGE;
+    } else
+    if (obj_is_a(metric, prom_histogram)
+    ||  obj_is_a(metric, prom_native_histogram))
+    {
+        type = PB_METRIC_TYPE_HISTOGRAM;
+    } else {
+        assert (false);
+        return;
+    }
+
+    /* Each MetricFamily message is prefixed by its length */
+    pos = out->len;
+    pb_add_str(out, 1, metric->name.s, metric->name.len);
+    pb_add_str(out, 2, metric->documentation.s, metric->documentation.len);
+    pb_add_uint64(out, 3, type);
+
+    if (is_metric_observable(metric)) {
+        pb_bridge_sample(metric, out);
+    } else {
+        dlist_for_each_entry(prom_metric_t, child, &metric->children_list,
+                             siblings_list)
+        {
+            spin_lock(&child->lock);
+            pb_bridge_sample(child, out);
+            spin_unlock(&child->lock);
+        }
+    }
+
+    pb_end(out, pos);
+}
+
+void prom_collector_bridge_pb(const dlist_t *collector, sb_t *out)
+{
+    pthread_mutex_lock(&prom_collector_lock_g);
+    dlist_for_each_entry(prom_metric_t, metric, collector, siblings_list) {
+        spin_lock(&metric->lock);
+        prom_collector_bridge_pb_metric(metric, out);
+        spin_unlock(&metric->lock);
+    }
+    pthread_mutex_unlock(&prom_collector_lock_g);
+}
+
+/* }}} */
@@ -21,6 +21,7 @@
 
 #include <lib-common/prometheus-client.h>
 #include <lib-common/log.h>
+#include <lib-common/thr.h>
 
 /** Base logger for all prometheus client code modules. */
 extern logger_t prom_logger_g;
@@ -35,6 +36,14 @@ extern logger_t prom_logger_g;
  */
 extern dlist_t prom_collector_g;
 
+/** Lock of the collector.
+ *
+ * The scrapes are formatted in a thr_job, so the list of the registered
+ * metrics is protected by this lock; it is held during the whole
+ * formatting by the bridge functions.
+ */
+extern pthread_mutex_t prom_collector_lock_g;
+
 /** Validate the name of a metric.
  *
  * Exposed for tests.
@@ -53,9 +62,113 @@ int prom_metric_check_label_name(const char *label_name);
  * default metric exposition format, described here:
  *
  * https://prometheus.io/docs/instrumenting/exposition_formats
+ *
+ * The text of each metric is kept until the next call, and is reused if the
+ * values of the metric did not change.
  */
 void prom_collector_bridge(const dlist_t *collector, sb_t *out);
 
+/** Bridge function for protobuf metric exposition format.
+ *
+ * It fills the output buffer with the metrics of the collector encoded as
+ * length-delimited io.prometheus.client.MetricFamily messages. Unlike the
+ * text format, it exposes the buckets of the native histograms.
+ */
+void prom_collector_bridge_pb(const dlist_t *collector, sb_t *out);
+
+/** Overwrite the value of an histogram.
+ *
+ * This is meant for the histograms that mirror counts maintained elsewhere,
+ * and that are pulled at scraping time.
+ *
+ * \param[in]  counts  the number of observations in each bucket (not
+ *                     cumulated), followed by the number of observations
+ *                     above the last bucket. Its length must be the number
+ *                     of buckets plus one.
+ * \param[in]  sum     the sum of the observations.
+ */
+void prom_histogram_set_counts(prom_histogram_t *self,
+                               const uint64_t *counts, double sum);
+
+/** Register the metrics of the stack and ring pools. */
+void prom_mem_metrics_register(void);
+
+/** Forget the metrics of the stack and ring pools, once the collector has
+ * been destroyed. */
+void prom_mem_metrics_wipe(void);
+
+/** Update the metrics of the stack and ring pools, see
+ * mem_stack_pools_window_stats().
+ */
+void prom_mem_metrics_refresh(void);
+
+/** Register the metrics of the tagged jobs (see thr_job_tag()) and of the
+ * eventcounts. */
+void prom_thr_metrics_register(void);
+
+/** Forget the metrics of the thr module, once the collector has been
+ * destroyed. */
+void prom_thr_metrics_wipe(void);
+
+/** Update the metrics of the thr module, see thr_job_tags_stats() and
+ * thr_ec_get_stats(). */
+void prom_thr_metrics_refresh(void);
+
+/** Register the metrics of the busy polling and of the profiling of the
+ * event loops. */
+void prom_el_metrics_register(void);
+
+/** Forget the metrics of the event loops, once the collector has been
+ * destroyed. */
+void prom_el_metrics_wipe(void);
+
+/** Update the metrics of the event loops, see el_fd_get_busy_poll_stats()
+ * and el_profile_get_stats(). */
+void prom_el_metrics_refresh(void);
+
+/** Register the metrics of the RPCs and of the concurrency limits of the
+ * ichannels. */
+void prom_ic_metrics_register(void);
+
+/** Forget the metrics of the ichannels, once the collector has been
+ * destroyed. */
+void prom_ic_metrics_wipe(void);
+
+/** Update the metrics of the ichannels, see ic_limits_stats(). */
+void prom_ic_metrics_refresh(void);
+
+/** Register the metrics of the DNS resolver. */
+void prom_dns_metrics_register(void);
+
+/** Forget the metrics of the DNS resolver, once the collector has been
+ * destroyed. */
+void prom_dns_metrics_wipe(void);
+
+/** Update the metrics of the DNS resolver, see dns_get_stats(). */
+void prom_dns_metrics_refresh(void);
+
+/** Register the metrics of the TLS handshakes. */
+void prom_ssl_metrics_register(void);
+
+/** Forget the metrics of the TLS handshakes, once the collector has been
+ * destroyed. */
+void prom_ssl_metrics_wipe(void);
+
+/** Update the metrics of the TLS handshakes, see ssl_get_handshake_stats().
+ */
+void prom_ssl_metrics_refresh(void);
+
+/** Register the metrics of the asynchronous file writes. */
+void prom_file_aio_metrics_register(void);
+
+/** Forget the metrics of the asynchronous file writes, once the collector
+ * has been destroyed. */
+void prom_file_aio_metrics_wipe(void);
+
+/** Update the metrics of the asynchronous file writes, see
+ * file_aio_get_stats(). */
+void prom_file_aio_metrics_refresh(void);
+
 /** Module for HTTP server for scraping. */
 MODULE_DECLARE(prometheus_client_http);
 
@@ -0,0 +1,68 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/ssl.h>
+
+#include "priv.h"
+
+/* Metrics of the TLS handshakes, see ssl_get_handshake_stats(); the
+ * resumption ratio is the rate of the resumed handshakes over the rate of
+ * all of them.
+ */
+
+static struct {
+    prom_gauge_t *handshakes;
+    prom_gauge_t *cache_len;
+} prom_ssl_g;
+#define _G  prom_ssl_g
+
+void prom_ssl_metrics_register(void)
+{
+    _G.handshakes = prom_gauge_new("lib_common_tls_handshakes",
+                                   "Number of completed TLS handshakes, "
+                                   "full or resuming a session",
+                                   "side", "kind");
+    _G.cache_len = prom_gauge_new("lib_common_tls_session_cache_entries",
+                                  "Number of peers in the cache of the "
+                                  "client TLS sessions");
+}
+
+void prom_ssl_metrics_wipe(void)
+{
+    /* the metrics themselves are destroyed with the collector */
+    p_clear(&_G, 1);
+}
+
+void prom_ssl_metrics_refresh(void)
+{
+    ssl_handshake_stats_t stats;
+
+    if (!_G.handshakes) {
+        return;
+    }
+    ssl_get_handshake_stats(&stats);
+    obj_vcall(prom_gauge_labels(_G.handshakes, "server", "full"), set,
+              stats.server_full);
+    obj_vcall(prom_gauge_labels(_G.handshakes, "server", "resumed"), set,
+              stats.server_resumed);
+    obj_vcall(prom_gauge_labels(_G.handshakes, "client", "full"), set,
+              stats.client_full);
+    obj_vcall(prom_gauge_labels(_G.handshakes, "client", "resumed"), set,
+              stats.client_resumed);
+    obj_vcall(_G.cache_len, set, stats.session_cache_len);
+}
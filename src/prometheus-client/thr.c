@@ -0,0 +1,101 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/thr.h>
+
+#include "priv.h"
+
+/* Metrics of the tagged jobs, of the eventcounts and of the blocking
+ * sections of the thr module.
+ *
+ * The thr module cannot depend on the prometheus client, so its statistics
+ * are pulled into the metrics each time they are scraped.
+ */
+
+static struct {
+    prom_histogram_t *wait;
+    prom_histogram_t *run;
+    prom_gauge_t     *evc_waits;
+    prom_gauge_t     *blocking;
+    prom_gauge_t     *blocked;
+} prom_thr_g;
+#define _G  prom_thr_g
+
+void prom_thr_metrics_register(void)
+{
+    /* the bucket i of the tags counts the durations below 2^i us, the last
+     * one is the +Inf bucket */
+    _G.wait = prom_histogram_new("lib_common_thr_job_wait_seconds",
+                                 "Time waited by the tagged jobs before "
+                                 "they ran", "tag");
+    prom_histogram_set_exponential_buckets(_G.wait, 1e-6, 2,
+                                           THR_JOB_TAG_BUCKETS - 1);
+    _G.run = prom_histogram_new("lib_common_thr_job_run_seconds",
+                                "Run time of the tagged jobs", "tag");
+    prom_histogram_set_exponential_buckets(_G.run, 1e-6, 2,
+                                           THR_JOB_TAG_BUCKETS - 1);
+
+    _G.evc_waits = prom_gauge_new("lib_common_thr_evc_waits",
+                                  "Number of waits on the eventcounts that "
+                                  "ended while spinning or that slept",
+                                  "how");
+
+    _G.blocking = prom_gauge_new("lib_common_thr_blocking_sections",
+                                 "Number of blocking sections that were "
+                                 "compensated by a standby thread or not",
+                                 "compensation");
+    _G.blocked = prom_gauge_new("lib_common_thr_blocked_threads",
+                                "Number of threads in a blocking section");
+}
+
+void prom_thr_metrics_wipe(void)
+{
+    /* the metrics themselves are destroyed with the collector */
+    p_clear(&_G, 1);
+}
+
+static void prom_thr_tag_refresh(const thr_job_tag_stats_t *stats,
+                                 void *priv)
+{
+    prom_histogram_set_counts(prom_histogram_labels(_G.wait, stats->name),
+                              stats->wait_hist, stats->wait_sum / 1e9);
+    prom_histogram_set_counts(prom_histogram_labels(_G.run, stats->name),
+                              stats->run_hist, stats->run_sum / 1e9);
+}
+
+void prom_thr_metrics_refresh(void)
+{
+    thr_ec_stats_t evc;
+    thr_blocking_stats_t blocking;
+
+    if (!_G.wait) {
+        return;
+    }
+    thr_job_tags_stats(&prom_thr_tag_refresh, NULL);
+
+    thr_ec_get_stats(&evc);
+    obj_vcall(prom_gauge_labels(_G.evc_waits, "spin"), set, evc.spins);
+    obj_vcall(prom_gauge_labels(_G.evc_waits, "park"), set, evc.parks);
+
+    thr_get_blocking_stats(&blocking);
+    obj_vcall(prom_gauge_labels(_G.blocking, "standby"), set,
+              blocking.compensations);
+    obj_vcall(prom_gauge_labels(_G.blocking, "capped"), set,
+              blocking.capped);
+    obj_vcall(_G.blocked, set, blocking.blocked);
+}
@@ -47,6 +47,25 @@ static inline size_t lzo_cbuf_size(size_t insz) {
 
 size_t  qlzo1x_compress(void *out, size_t outlen, pstream_t in, void *buf);
 
+/** Default size of the blocks of qlzo1x_compress_mt(). */
+#define LZO_MT_BLOCK_SIZE       (256 << 10)
+
+/** Compress a large buffer using the thr jobs.
+ *
+ * The input is cut in blocks of \p block_size bytes (LZO_MT_BLOCK_SIZE if
+ * 0), compressed in parallel without references from a block to the
+ * previous ones, and put together in a single stream, which is decoded by
+ * qlzo1x_decompress() as any other. The compression ratio is slightly
+ * lower than the one of qlzo1x_compress().
+ *
+ * The input is compressed with qlzo1x_compress() when it fits in a single
+ * block or when the thr module is not loaded.
+ *
+ * \p out must be at least lzo_cbuf_size(ps_len(&in)) bytes long.
+ */
+size_t  qlzo1x_compress_mt(void *out, size_t outlen, pstream_t in,
+                           size_t block_size);
+
 /*
  * qlzo1x_decompress is unsafe and assumes that the input stream can be
  * overread of LZO_INPUT_PADDING octets.
@@ -41,6 +41,48 @@ void *qpage_remap(void *ptr, size_t old_n, uint32_t old_seg,
 void *qpage_remap_raw(void *ptr, size_t old_n, uint32_t old_seg,
                       uint32_t new_n, uint32_t *new_seg, bool may_move);
 
+/** Ask for transparent huge pages for the new page runs.
+ *
+ * The arena maps memory by runs of at least 16MB, which are then advised with
+ * MADV_HUGEPAGE. Note that releasing physical memory of free chunks splits
+ * the huge pages again, so this is mostly useful for long lived pages.
+ */
+void qpage_set_huge_pages(bool enable);
+
+#define QPAGE_ZERO_RESERVE_MAX  16
+
+/** Keep a reserve of pre-zeroed runs for qpage_alloc_align().
+ *
+ * A low priority background thread zeroes runs of the sizes that were
+ * recently asked to qpage_alloc_align() (up to 32 pages), so that the
+ * callers do not pay for the zeroing of the pages that were freed dirty.
+ *
+ * \param[in] depth  number of runs kept per size, at most
+ *                   QPAGE_ZERO_RESERVE_MAX; 0 stops the reserve and gives its
+ *                   runs back.
+ * \return -1 if the background thread cannot be created, 0 otherwise.
+ */
+int qpage_zero_reserve_set_depth(uint32_t depth);
+
+typedef struct qpage_zero_reserve_stats_t {
+    uint32_t depth;  /*< number of runs kept per size */
+    uint32_t runs;   /*< number of runs in the reserve */
+    uint64_t pages;  /*< number of pages in the reserve */
+    uint64_t hits;   /*< zeroed allocations served by the reserve */
+    uint64_t misses; /*< zeroed allocations the reserve could not serve */
+} qpage_zero_reserve_stats_t;
+
+void qpage_zero_reserve_stats(qpage_zero_reserve_stats_t *stats);
+
+/** Get the amount of memory of the free pages.
+ *
+ * \param[out] lazy_bytes     free memory advised with MADV_FREE, that the
+ *                            system may reclaim, see mem_decay_set_delay().
+ * \param[out] decayed_bytes  free memory given back to the system after the
+ *                            decay delay, since the start of the program.
+ */
+void qpage_decay_stats(uint64_t *lazy_bytes, uint64_t *decayed_bytes);
+
 void *qpage_dup_n(const void *ptr, size_t n, uint32_t *seg);
 void  qpage_free_n(void *, size_t n, uint32_t seg);
 
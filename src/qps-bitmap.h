@@ -133,6 +133,43 @@ qps_bitmap_init(qps_bitmap_t *map, qps_t *qps, qps_handle_t handle)
     assert (strequal(QPS_BITMAP_SIG, (const char *)map->root->sig));
 }
 
+/* }}} */
+/* {{{ Bulk operations */
+
+/* These operations work a leaf at a time instead of a key at a time: the
+ * words of the leaves are combined and counted, and the absent dispatch
+ * nodes and leaves are skipped. They only work on non-nullable bitmaps.
+ */
+
+/** Keep in dst the keys set in both dst and src. */
+void qps_bitmap_and(qps_bitmap_t *dst, qps_bitmap_t *src) __leaf;
+
+/** Set in dst the keys set in src. */
+void qps_bitmap_or(qps_bitmap_t *dst, qps_bitmap_t *src) __leaf;
+
+/** Reset in dst the keys set in src. */
+void qps_bitmap_andnot(qps_bitmap_t *dst, qps_bitmap_t *src) __leaf;
+
+/** Number of keys set in the bitmap. */
+uint64_t qps_bitmap_cardinality(qps_bitmap_t *map) __leaf;
+
+/** Number of keys set in both bitmaps, without building their
+ * intersection. */
+uint64_t qps_bitmap_and_cardinality(qps_bitmap_t *a, qps_bitmap_t *b)
+    __leaf;
+
+/** Number of keys set in the bitmap that are lower than row. */
+uint64_t qps_bitmap_rank(qps_bitmap_t *map, uint32_t row) __leaf;
+
+/** Find the key set in the bitmap of a given rank.
+ *
+ * \param[in]  rank  the rank of the key, from 0.
+ * \param[out] row   the key whose qps_bitmap_rank() is rank.
+ * \return -1 if the bitmap has no more than rank keys set.
+ */
+int qps_bitmap_select(qps_bitmap_t *map, uint64_t rank, uint32_t *row)
+    __leaf;
+
 /* }}} */
 /* {{{ Bitmap enumerator */
 
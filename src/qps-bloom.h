@@ -0,0 +1,103 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_QPS_BLOOM_H
+#define IS_LIB_COMMON_QPS_BLOOM_H
+
+#include <lib-common/bloom.h>
+#include <lib-common/qps.h>
+
+/** \defgroup qkv__ll__bloom QPS Bloom filter
+ * \ingroup qkv__ll
+ * \brief QPS Bloom filter
+ *
+ * \{
+ *
+ * Persistent version of bloom_t: the filter lives in the QPS, and is thus
+ * kept across restarts and snapshotted with the rest of the QPS. The
+ * filter has the same format and false positive rate as a bloom_t, its
+ * words being stored in contiguous QPS pages (which limits it to
+ * QPS_BLOOM_MAX_BLOCKS blocks, about 100 million keys at 1%).
+ */
+
+#define QPS_BLOOM_MAX_BLOCKS \
+    ((QPS_MAP_PAGES / 2) * QPS_PAGE_SIZE / (4 * BLOOM_BLOCK_WORDS))
+
+#define QPS_BLOOM_SIG  "QPS_bloom/v01.0"
+typedef struct qps_bloom_root_t {
+    /* Signature */
+    uint8_t  sig[16];
+
+    /* Structure description */
+    uint32_t nb_blocks;
+    qps_pg_t words;
+} qps_bloom_root_t;
+
+typedef struct qps_bloom_t {
+    qps_t *qps;
+
+    union {
+        qps_bloom_root_t *root;
+        qps_hptr_t        root_cache;
+    };
+} qps_bloom_t;
+
+/** Create a filter, see bloom_nb_blocks() for the parameters. */
+qps_handle_t qps_bloom_create(qps_t *qps, uint64_t nb_keys, double fpr)
+    __leaf;
+void qps_bloom_destroy(qps_bloom_t *bf) __leaf;
+void qps_bloom_clear(qps_bloom_t *bf) __leaf;
+
+static inline void
+qps_bloom_init(qps_bloom_t *bf, qps_t *qps, qps_handle_t handle)
+{
+    p_clear(bf, 1);
+    bf->qps = qps;
+    qps_hptr_init(qps, handle, &bf->root_cache);
+    assert (strequal(QPS_BLOOM_SIG, (const char *)bf->root->sig));
+}
+
+static inline void qps_bloom_add_hash(qps_bloom_t *bf, uint64_t hash)
+{
+    qps_hptr_deref(bf->qps, &bf->root_cache);
+    __bloom_add(qps_pg_deref(bf->qps, bf->root->words), bf->root->nb_blocks,
+                hash);
+}
+
+static inline bool qps_bloom_has_hash(qps_bloom_t *bf, uint64_t hash)
+{
+    qps_hptr_deref(bf->qps, &bf->root_cache);
+    return __bloom_has(qps_pg_deref(bf->qps, bf->root->words),
+                       bf->root->nb_blocks, hash);
+}
+
+static inline void qps_bloom_add(qps_bloom_t *bf, const void *data,
+                                 size_t len)
+{
+    qps_bloom_add_hash(bf, wyhash64(data, len, 0));
+}
+
+static inline bool qps_bloom_has(qps_bloom_t *bf, const void *data,
+                                 size_t len)
+{
+    return qps_bloom_has_hash(bf, wyhash64(data, len, 0));
+}
+
+/** \} */
+
+#endif
@@ -134,6 +134,7 @@ typedef struct qhat_root_t {
     uint32_t    value_len;
     bool        is_nullable : 1;
     bool        do_stats : 1;
+    bool        has_packed : 1;
     qhat_node_t nodes[QHAT_ROOTS];
 
     /* Statistics */
@@ -220,6 +221,19 @@ typedef struct qhat_compacthdr_t {
     uint32_t  keys[];
 } qhat_compacthdr_t;
 
+/* A packed leaf is a compact leaf whose keys are bit-packed, as offsets of
+ * key_bits bits from key_base; its values follow at values_offset. */
+typedef struct qhat_packedhdr_t {
+    uint32_t  count;
+    uint16_t  parent_left;
+    uint16_t  parent_right;
+    uint32_t  key_base;
+    uint8_t   key_bits;
+    uint8_t   padding;
+    uint16_t  values_offset;
+    uint8_t   keys[];
+} qhat_packedhdr_t;
+
 qps_handle_t qhat_create(qps_t *qps, uint32_t value_len, bool is_nullable)
     __leaf;
 void qhat_init(qhat_t *hat, qps_t *qps, qps_handle_t handle);
@@ -227,6 +241,23 @@ void qhat_destroy(qhat_t *hat) __leaf;
 void qhat_clear(qhat_t *hat) __leaf;
 void qhat_unload(qhat_t *hat) __leaf;
 
+/** Fill an empty trie from sorted keys.
+ *
+ * This is equivalent to a qhat_set() (or a qhat_set0() for the zero values)
+ * of each key, but the leaves and the dispatch nodes are built bottom-up and
+ * written once at their final place, instead of being split again and again
+ * by the insertions. The compact leaves are filled up to the split threshold
+ * so that later insertions do not split them right away.
+ *
+ * \param[in] keys    the keys, in strictly increasing order.
+ * \param[in] values  the values of the keys, `count` values of the value
+ *                    length of the trie, packed.
+ * \return -1 if the trie is not empty or if the keys are not sorted, in
+ *         which case the trie is left untouched.
+ */
+int qhat_bulk_load(qhat_t *hat, const uint32_t *keys, const void *values,
+                   uint32_t count);
+
 /** \name Accessors
  * \{
  */
@@ -358,6 +389,20 @@ const void *qhat_get(qhat_t *hat, uint32_t row)
     return qhat_get_path(&path);
 }
 
+/** Get read-only pointers to the values associated with several keys.
+ *
+ * This is equivalent to a qhat_get() of each key, but the path of a key is
+ * reused for the next keys while they fall in the same leaf, and the nodes
+ * of the next keys are prefetched while the current one is looked up, so
+ * that the cache misses of several lookups overlap. The paths are only
+ * shared when the keys are sorted, or at least grouped.
+ *
+ * \param[out] out  the pointers to the values, out[i] being the one
+ *                  qhat_get() would return for keys[i].
+ */
+void qhat_get_many(qhat_t *hat, const uint32_t *keys, uint32_t count,
+                   const void **out);
+
 /** Check if an entry is NULL.
  */
 static ALWAYS_INLINE
@@ -392,6 +437,23 @@ uint64_t qhat_compute_memory(qhat_t *hat);
  */
 uint64_t qhat_compute_memory_overhead(qhat_t *hat);
 
+/** Pack the compact leaves of the trie.
+ *
+ * The keys of a packed leaf are stored as bit-packed offsets from its first
+ * key, its values are left as is so that qhat_get() and the enumerators
+ * still return pointers in the trie. With clustered keys, this halves the
+ * memory of the compact leaves of the tries of up to 32 bits values, and
+ * saves a third of it with 64 bits values. The leaves whose keys are too
+ * spread to save a page are left as they are.
+ *
+ * A packed leaf is turned back into a compact leaf as soon as it is
+ * modified, so a trie is best packed once it is loaded, or after each batch
+ * of updates.
+ *
+ * \return the number of bytes saved.
+ */
+uint64_t qhat_pack(qhat_t *hat);
+
 typedef enum qhat_check_flags_t {
     /* Do not 'panic' in case of error.
      * Instead, log an error, print a backtrace with information about the
@@ -489,6 +551,7 @@ typedef union qhat_node_const_memory_t {
     const qhat_128_t  *u128;
     const qhat_node_t *nodes;
     const qhat_compacthdr_t *compact;
+    const qhat_packedhdr_t  *packed;
     const qhat_compact8_t   *compact8;
     const qhat_compact16_t  *compact16;
     const qhat_compact32_t  *compact32;
@@ -505,6 +568,7 @@ typedef union qhat_node_memory_t {
     qhat_128_t  *u128;
     qhat_node_t *nodes;
     qhat_compacthdr_t *compact;
+    qhat_packedhdr_t  *packed;
     qhat_compact8_t   *compact8;
     qhat_compact16_t  *compact16;
     qhat_compact32_t  *compact32;
@@ -558,6 +622,9 @@ typedef struct qhat_tree_enumerator_t {
      * added or removed in the qhat. */
     uint32_t count;
 
+    /* Whether the current compact is packed, see qhat_pack(). */
+    bool packed;
+
     /* Current leaf of the enumerator, cached here for quicker access. */
     qhat_node_const_memory_t memory;
 } qhat_tree_enumerator_t;
@@ -698,6 +765,46 @@ qhat_t *qhat_enumerator_get_hat(qhat_enumerator_t *en)
 
 #define qhat_for_each qhat_for_each_safe
 
+/* }}} */
+/* {{{ Parallel enumeration */
+
+/** Range of keys of a trie, bounds included. */
+typedef struct qhat_range_t {
+    uint32_t from;
+    uint32_t to;
+} qhat_range_t;
+qvector_t(qhat_range, qhat_range_t);
+
+/** Split the keys of a trie in ranges of similar sizes.
+ *
+ * The ranges are consecutive, they cover all the keys and start on the
+ * leaves of the trie; their sizes are estimated from the counts of the
+ * compact leaves, the flat leaves counting as full. There are at most
+ * `count` ranges, less when the trie has not enough leaves.
+ *
+ * Each range can then be enumerated by a separate job with
+ * qhat_for_each_range(), as long as the trie is not modified:
+ *
+ * > qhat_split_ranges(&hat, thr_parallelism_g, &ranges);
+ * > thr_for_each(ranges.len, ^(size_t i) {
+ * >     qhat_for_each_range(en, &hat, ranges.tab[i]) {
+ * >         ...
+ * >     }
+ * > });
+ *
+ * The ranges being sorted, the ordered output of the whole enumeration is
+ * the concatenation of the outputs of the ranges in their order.
+ *
+ * \param[out] ranges  the ranges, the vector is cleared first.
+ */
+void qhat_split_ranges(qhat_t *hat, uint32_t count,
+                       qv_t(qhat_range) *ranges);
+
+#define qhat_for_each_range(en, hat, range)                                  \
+    for (qhat_enumerator_t en = qhat_get_enumerator_at(hat, (range).from);   \
+         !en.end && en.key <= (range).to;                                    \
+         qhat_enumerator_next(&en, false))
+
 /* }}} */
 /* Debugging tools
  */
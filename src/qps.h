@@ -192,6 +192,12 @@ union qps_map_t {
 #define QPS_MAP_SIZE     (1UL << QPS_MAP_SHIFT)
 #define QPS_MAP_MASK     (QPS_MAP_SIZE - 1)
 
+/* the paged maps track their writes by chunks of 64k, see
+ * qps_t#snap_max_deltas */
+#define QPS_MAP_CHUNK_SHIFT  (QPS_PAGE_SHIFT + 4UL)
+#define QPS_MAP_CHUNK_PAGES  (1UL << (QPS_MAP_CHUNK_SHIFT - QPS_PAGE_SHIFT))
+#define QPS_MAP_CHUNKS       (QPS_MAP_SIZE >> QPS_MAP_CHUNK_SHIFT)
+
     struct {
 #define QPS_META_SIG     "QPS_meta/v01.00"
 #define QPS_MAP_PG_SIG   "QPS_page/v01.00"
@@ -206,6 +212,11 @@ union qps_map_t {
         struct qps_t   *qps;
         uint32_t        remaining;      /* only for memory */
         uint32_t        disk_usage;     /* only for memory */
+        uint32_t        snap_gen;       /* only for pages: generation of the
+                                           last snapshot of the map */
+        uint32_t        snap_deltas;    /* only for pages: deltas on top of
+                                           the full snapshot of the map */
+        uint64_t        dirty[QPS_MAP_CHUNKS / 64]; /* only for pages */
     } hdr;
     uint8_t data[QPS_PAGE_SIZE];
 };
@@ -221,10 +232,26 @@ qvector_t(qps_gcmap, qps_gcmap_t);
 
 #ifdef __has_blocks
 typedef void (BLOCK_CARET qps_notify_b)(uint32_t gen);
+typedef void (BLOCK_CARET qps_progress_b)(uint32_t gen, uint64_t done,
+                                          uint64_t total, int64_t eta_ms);
 #else
 typedef void *qps_notify_b;
+typedef void *qps_progress_b;
 #endif
 
+/** Distribution of the accesses to the maps of a qps, see qps_heat_start().
+ *
+ * The sizes are in bytes, they are computed on each tracking period.
+ */
+typedef struct qps_heat_stats_t {
+    uint64_t hot;        /* accessed during the last period */
+    uint64_t warm;       /* accessed during the previous periods only */
+    uint64_t cold;       /* not accessed during the tracked periods */
+    uint64_t advised;    /* advised cold and not accessed since */
+    uint64_t paged_out;  /* paged out and not accessed since */
+    uint64_t rss;        /* resident size of the process */
+} qps_heat_stats_t;
+
 typedef struct qps_t {
     logger_t logger;
     logger_t tracing_logger;
@@ -232,6 +259,9 @@ typedef struct qps_t {
     dir_lock_t   lock;
     int          dfd;
     uint16_t     snapshotting;
+    /* set for the stores attached with qps_attach(), that must never be
+     * written to */
+    bool         read_only;
     uint32_t     generation;
     qv_t(qpsm)   maps;
     qv_t(qpsm)   smaps;
@@ -249,15 +279,41 @@ typedef struct qps_t {
 
     /* Allocator state, private */
     qps_pghdr_t *hdrs;
+    spinlock_t   load_lock;  /* serializes the maps opened in parallel */
     qps_map_t   *gc_map;     /* do not use, filled for the SIGBUS handler */
     thr_syn_t   *snapshot_syn; /* not owned by the qps_t */
     el_t         snap_el;
     el_t         snap_timer_el;
     qps_notify_b snap_notify;
+    el_t         snap_progress_el;
+    qps_progress_b snap_progress;
+    uint64_t     snap_total;
     pid_t        snap_pid;
     struct timeval snap_start;
     uint32_t     snap_gen;
     uint32_t     snap_max_duration; /* in seconds, 3600 by default */
+    /* when not 0, the snapshots of the paged maps only write the chunks
+     * that changed since the previous snapshot, as a delta on top of it,
+     * until snap_max_deltas deltas are chained (see qps_snapshot) */
+    uint8_t      snap_max_deltas;
+    /* when not 0, the snapshotter writes at most snap_max_rate MB/s of
+     * snapshotted data, and pushes them to the disk as it goes */
+    uint32_t     snap_max_rate;
+
+    /* write-ahead log of the handles, see qps_wal_start() */
+    struct qps_wal_t *wal;
+    uint32_t     wal_seq;   /* sequence number of the last WAL file */
+
+    /* access tracking of the chunks of the maps, see qps_heat_start() */
+    struct {
+#define QPS_HEAT_TOUCHED     0x80U
+#define QPS_HEAT_PAGED_OUT   0x02U
+#define QPS_HEAT_ADVISED     0x01U
+        uint8_t    *chunks;    /* QPS_MAP_CHUNKS bytes per map number */
+        el_t        timer;
+        uint64_t    rss_budget;
+        qps_heat_stats_t stats;
+    } heat;
 
     struct {
 #define QPS_PGL2_SHIFT       5U
@@ -302,6 +358,46 @@ qps_t    *_qps_open(const char *path, const char *name,
                     bool load_whole_spool, sb_t *priv);
 #define qps_open(path, name, priv)  _qps_open((path), (name), true, (priv))
 
+/** Attach a qps store read-only.
+ *
+ * This loads the last snapshot of a store that is owned by another process,
+ * typically to serve lookups from several worker processes while a single
+ * process updates the store and snapshots it.
+ *
+ * Unlike qps_open(), it neither takes the lock of the store nor cleans it
+ * up, and it does not check the consistency of the maps, even in debug
+ * builds: the snapshots are supposed to be valid. The memory maps are
+ * mapped MAP_SHARED | PROT_READ from the store files, so their pages are
+ * shared by all the processes that attached the store, the paged maps are
+ * still inflated from their compressed snapshots in each process.
+ *
+ * The attached qps_t must only be read: allocations, snapshots and writes
+ * into its maps are fatal. A new snapshot of the store is not seen by an
+ * attached qps_t, the store has to be attached again (see
+ * qps_attach_watch()).
+ *
+ * \param[in]  path  path to the qps spool
+ * \param[in]  name  the name of the qps logger
+ * \param[out] priv  a sb_t to hold the private metadata serialized along
+ *                   the snapshot, may be NULL.
+ *
+ * \return NULL if it failed, the attached qps otherwise, to be closed with
+ *         qps_close().
+ */
+qps_t    *qps_attach(const char *path, const char *name, sb_t *priv);
+
+#ifdef __has_blocks
+/** Watch a qps store for new snapshots.
+ *
+ * The block is called from the event loop each time a snapshot is committed
+ * in the store at \p path, so that the readers can qps_attach() the new
+ * snapshot and switch to it once they are done with the previous one.
+ *
+ * \return the fs watch, to unregister with el_unregister().
+ */
+el_t      qps_attach_watch(const char *path, void (BLOCK_CARET cb)(void));
+#endif
+
 int       __qps_check_consistency(const char *path, const char *name);
 int       __qps_check_maps(qps_t *qps, bool fatal);
 bool      qps_exists(const char *path);
@@ -330,11 +426,25 @@ uint32_t  qps_snapshot(qps_t *qps, const void *data, size_t dlen,
  */
 void qps_set_snapshot_syn(qps_t *qps, thr_syn_t *syn);
 
+/** Set a block to call with the progress of the snapshots.
+ *
+ * The block is called about every second while a snapshot is written, with
+ * the generation of the snapshot, the number of bytes written so far, the
+ * number of bytes to write and the estimated remaining time in ms (-1 while
+ * nothing was written). The bytes are the bytes of the snapshotted maps,
+ * before compression.
+ *
+ * A NULL block stops the reports, the block is released by qps_close().
+ */
+void qps_set_snapshot_progress(qps_t *qps, qps_progress_b nullable blk);
+
 /** Backup a qps.
  * This function shall not be called during a snapshot.
  *
  * /param[in] dfd_dst       a descriptor on the destination directory.
  * /param[in] link_as_copy  if true do a hard link rather than a copy.
+ *                          Copies use filecopyat(), so they are reflinks
+ *                          on file systems supporting it (XFS, btrfs).
  *
  * /return 0   if OK
  *         -1  error with arguments
@@ -356,6 +466,64 @@ void qps_gc_run(qps_t *qps);
 
 void qps_snapshot_wait(qps_t *qps);
 
+/* }}} */
+/* qps: write-ahead log {{{ */
+
+/** Default period of the group commits of the WAL. */
+#define QPS_WAL_COMMIT_MS_DFL   10
+/** Default size of the WAL that triggers a checkpoint. */
+#define QPS_WAL_MAX_SIZE_DFL    (256ULL << 20)
+
+typedef struct qps_wal_cfg_t {
+    /* period of the group commits in ms, QPS_WAL_COMMIT_MS_DFL when 0 */
+    int      commit_ms;
+    /* size of the WAL written since the last snapshot that triggers a
+     * snapshot (a checkpoint), QPS_WAL_MAX_SIZE_DFL when 0 */
+    uint64_t max_size;
+} qps_wal_cfg_t;
+
+/** Log the changes of the handles of a qps between its snapshots.
+ *
+ * Once started, the handles allocated, reallocated, freed or written (that
+ * is, dereferenced with qps_w_deref(), qps_handle_w_deref() or
+ * qps_hptr_w_deref()) are tracked, and every \p cfg->commit_ms their new
+ * content is appended to a write-ahead log in the qps directory, by a
+ * background thread that fdatasync()s it. The changes of a period form a
+ * single record of the log (a group), so they are either all recovered or
+ * not at all.
+ *
+ * qps_open() replays the log on top of the last snapshot, so the changes
+ * lost by a crash are at most the ones of the last period. Once the log
+ * grows past \p cfg->max_size, a snapshot is taken with the private data
+ * of the last snapshot (or \p data), after which the log is truncated: the
+ * replay time and the log size stay bounded.
+ *
+ * Only the handles are logged: the pages of the paged allocator
+ * (qps_pg_map(), thus the qhat and qps bitmap nodes) are only persisted by
+ * the snapshots, and so is the private data of the snapshots, the roots of
+ * a logged store must live in its handles. A handle written after a return
+ * to the event loop must be dereferenced for writing again, like after a
+ * snapshot.
+ *
+ * \param[in] cfg   the configuration, NULL for the defaults.
+ * \param[in] data  the private data of the checkpoints, until the next call
+ *                  to qps_snapshot().
+ * \param[in] dlen  the length of \p data.
+ *
+ * \return 0 on success, -1 if the log cannot be created.
+ */
+int qps_wal_start(qps_t *qps, const qps_wal_cfg_t * nullable cfg,
+                  const void * nullable data, size_t dlen);
+
+/** Write the pending changes in the WAL and wait for them to be synced.
+ *
+ * Like for the snapshots, the I/O errors on the WAL are fatal.
+ */
+void qps_wal_commit(qps_t *qps);
+
+/** Commit the pending changes and stop the WAL, done by qps_close(). */
+void qps_wal_stop(qps_t *qps);
+
 /* }}} */
 /* qps: Allocation routines {{{ */
 
@@ -436,12 +604,36 @@ void *qps_pg_deref(const qps_t *qps, qps_pg_t pg)
     return pg ? qps->maps.tab[pg >> 16][pg & 0xffff].data : NULL;
 }
 
+/** Record an access to the chunk of \p ptr when the heat is tracked.
+ *
+ * The byte of the chunk is only written once per tracking period, the races
+ * between the threads only lose accesses.
+ */
+static ALWAYS_INLINE
+void qps_heat_touch(const qps_t *qps, const void *ptr)
+{
+    if (unlikely(qps->heat.chunks) && ptr) {
+        uintptr_t c = (cast(uintptr_t, ptr) & QPS_MAP_MASK)
+                    >> QPS_MAP_CHUNK_SHIFT;
+        uint8_t  *h = &qps->heat.chunks[qps_map_of(ptr)->hdr.mapno
+                                        * QPS_MAP_CHUNKS + c];
+
+        if (!(*h & QPS_HEAT_TOUCHED)) {
+            *h = QPS_HEAT_TOUCHED;
+        }
+    }
+}
+
 #if !defined(__doxygen_mode__)
 void *qps_w_deref_(qps_t *, qps_handle_t, void *);
+void  qps_wal_touch(qps_t *, qps_handle_t);
 #endif
 static ALWAYS_INLINE
 void *qps_w_deref(qps_t *qps, qps_handle_t id, void *ptr)
 {
+    if (unlikely(qps->wal)) {
+        qps_wal_touch(qps, id);
+    }
     return qps_is_ro(qps, qps_map_of(ptr)) ? qps_w_deref_(qps, id, ptr) : ptr;
 }
 
@@ -488,6 +680,7 @@ const void *qps_hptr_deref(qps_t *qps, qps_hptr_t *cache)
         cache->data   = qps_handle_deref(qps, cache->handle);
         cache->gc_gen = qps->handles_gc_gen;
     }
+    qps_heat_touch(qps, cache->data);
     return cache->data;
 }
 
@@ -520,6 +713,41 @@ void qps_hptr_free(qps_t *qps, qps_hptr_t *cache)
     p_clear(cache, 1);
 }
 
+/* }}} */
+/* qps: access heat tracking {{{ */
+
+/** Track the accesses to the maps of a qps and evict the cold ones.
+ *
+ * The accesses are recorded by chunks of 64k of the maps, by
+ * qps_hptr_deref() and by the walks of the qhat tries. Every \p period_ms,
+ * the accesses are aged (the last 6 periods are remembered), the
+ * distribution of the accesses is computed (see qps_heat_get_stats()), and
+ * when the resident size of the process exceeds \p rss_budget:
+ *  - the chunks that were not accessed during the tracked periods are
+ *    advised cold (MADV_COLD), so that the kernel reclaims them first;
+ *  - the least recently accessed chunks are paged out (MADV_PAGEOUT) until
+ *    the excess is covered, the chunks accessed during the last period are
+ *    never paged out.
+ *
+ * The pages of the memory maps are dropped from the page cache as they are
+ * mapped from the store files, the pages of the paged maps are anonymous and
+ * can only be swapped out. Nothing is lost: the evicted pages are read back
+ * on the next access.
+ *
+ * \param[in] rss_budget  the budget in bytes, 0 to only track the accesses.
+ * \param[in] period_ms   the tracking period.
+ */
+void qps_heat_start(qps_t *qps, uint64_t rss_budget, int period_ms);
+
+/** Stop the access tracking of a qps, done by qps_close().
+ *
+ * It must not be called while other threads access the qps.
+ */
+void qps_heat_stop(qps_t *qps);
+
+/** Get the distribution of the accesses computed on the last period. */
+void qps_heat_get_stats(const qps_t *qps, qps_heat_stats_t *stats);
+
 /* }}} */
 
 /** \brief Initialize the QPS module.
@@ -78,6 +78,22 @@ typedef int (*sctp_on_data_f)(sctp_conn_t * nonnull conn,
                               const sb_t * nullable data,
                               bool no_more_msgs);
 
+/**
+ * \brief Callback called in a worker thread when a message is received.
+ *
+ * This callback replaces \p sctp_on_data_f on the connections for which
+ * \fn sctp_conn_set_stream_dispatch() was called. It runs in the thr_job
+ * workers, the messages of a given stream being processed one at a time and
+ * in their order of arrival, while the messages of different streams may be
+ * processed in parallel.
+ *
+ * The connection must only be read from this callback: sending messages or
+ * closing the connection has to be done from the event loop thread (see
+ * \p thr_queue_main_g). The data is freed when the callback returns.
+ */
+typedef void (*sctp_on_stream_data_f)(sctp_conn_t * nonnull conn,
+                                      uint16_t stream, lstr_t data);
+
 /**
  * \brief Callback when a remote entity connects to the listening socket.
  *
@@ -201,6 +217,46 @@ sctp_connect(qv_t(lstr) source_addrs,
 void sctp_send_msg(sctp_conn_t * nonnull conn, lstr_t payload,
                    uint32_t payload_protocol_id);
 
+/**
+ * \brief Enqueue a message to be sent on a given stream.
+ *
+ * Same as \fn sctp_send_msg(), which sends on the stream 0. The messages
+ * queued during an event loop iteration are sent together, in batches, when
+ * the socket is writable.
+ *
+ * \param[in] conn  the connection context
+ * \param[in] payload  the message's content
+ * \param[in] payload_protocol_id  defined in the protocol specification
+ * \param[in] stream  the stream number, lower than the number of outbound
+ *                    streams of the association
+ */
+void sctp_send_msg_stream(sctp_conn_t * nonnull conn, lstr_t payload,
+                          uint32_t payload_protocol_id, uint16_t stream);
+
+/**
+ * \brief Dispatch the received messages to thr_job workers.
+ *
+ * From now on, the messages received on the connection are given to \p
+ * on_stream_data_cb in the workers instead of being given to the \p
+ * sctp_on_data_f callback in the event loop. Each stream is bound to one of
+ * \p nb_queues serial queues, so that the order of the messages of a stream
+ * is kept.
+ *
+ * On a listening context, this applies to the connections accepted later.
+ * The messages already dispatched are processed before the connection is
+ * closed, and before the dispatch is changed. Passing a NULL callback goes
+ * back to the \p sctp_on_data_f callback.
+ *
+ * The thr module must be loaded.
+ *
+ * \param[in] conn  the connection context
+ * \param[in] nb_queues  the number of serial queues (at least 1)
+ * \param[in] on_stream_data_cb  the callback run in the workers
+ */
+void sctp_conn_set_stream_dispatch(sctp_conn_t * nonnull conn, int nb_queues,
+                                   sctp_on_stream_data_f nullable
+                                   on_stream_data_cb);
+
 /**
  * \brief Close the connection.
  *
@@ -18,6 +18,7 @@
 
 #include <lib-common/net.h>
 #include <lib-common/sctp-tools.h>
+#include <lib-common/thr.h>
 #include <lib-common/unix.h>
 
 #include "netdb.h"
@@ -30,11 +31,16 @@ typedef enum sctp_msg_type_t {
 } sctp_msg_type_t;
 
 qvector_t(sctp_su, sockunion_t);
+qvector_t(thr_queue, thr_queue_t *);
+
+/* Maximum number of messages given to one sendmmsg(2) call. */
+#define SCTP_SEND_BATCH_MAX  64
 
 typedef struct sctp_msg_t {
     dlist_t  msg_list;
     lstr_t   msg;
     uint32_t ppid;              /* Payload Protocol ID */
+    uint16_t stream;
 } sctp_msg_t;
 
 static sctp_msg_t * nonnull sctp_msg_init(sctp_msg_t * nonnull msg)
@@ -77,12 +83,22 @@ typedef struct sctp_conn_priv_t {
      */
     bool reset_rbuf;
 
-    /* Read buffer. */
+    /* Read buffer, and the stream of the message it contains. */
     sb_t rbuf;
+    uint16_t rstream;
 
-    /* Queue of messages to be sent on this connection. */
+    /* Queue of messages to be sent on this connection, in the order of the
+     * calls to sctp_send_msg_stream(), flushed in batches on POLLOUT. */
     dlist_t msgs;
 
+    /* Serial queues the received data is dispatched to when
+     * on_stream_data_cb is set, the data of a stream always going to the
+     * same queue. The listening contexts only keep the number of queues for
+     * the connections they accept. */
+    int nb_stream_queues;
+    qv_t(thr_queue) stream_queues;
+    sctp_on_stream_data_f on_stream_data_cb;
+
     sctp_on_connect_f on_connect_cb;
 
     sctp_on_disconnect_f on_disconnect_cb;
@@ -102,12 +118,30 @@ sctp_conn_priv_init(sctp_conn_priv_t * nonnull conn)
 
     sb_init(&conn->rbuf);
     dlist_init(&conn->msgs);
+    qv_init(&conn->stream_queues);
     return conn;
 }
 GENERIC_NEW(sctp_conn_priv_t, sctp_conn_priv);
 
+static void sctp_conn_stream_queues_init(sctp_conn_priv_t * nonnull conn)
+{
+    for (int i = 0; i < conn->nb_stream_queues; i++) {
+        qv_append(&conn->stream_queues, thr_queue_create());
+    }
+}
+
+/* Waits for the data already dispatched to be processed. */
+static void sctp_conn_stream_queues_wipe(sctp_conn_priv_t * nonnull conn)
+{
+    tab_for_each_entry(q, &conn->stream_queues) {
+        thr_queue_destroy(q, true);
+    }
+    qv_wipe(&conn->stream_queues);
+}
+
 static void sctp_conn_priv_wipe(sctp_conn_priv_t * nonnull conn)
 {
+    sctp_conn_stream_queues_wipe(conn);
     sb_wipe(&conn->rbuf);
     sctp_msg_list_wipe(&conn->msgs);
     lstr_wipe(&(conn->user_ctx.entity_id));
@@ -209,16 +243,51 @@ sctp_ep_init_sock(int fd, size_t sndbuf)
 static int sctp_send_queued_msgs(sctp_conn_priv_t **pconn)
 {
     sctp_conn_priv_t *conn = *pconn;
-    int      fd            = el_fd_get_fd(conn->evh);
-    uint16_t stream_no     = 0;
-    int      msg_flags     = 0;
-    int      len;
+    int fd = el_fd_get_fd(conn->evh);
+
+    /* The queued messages are sent in batches, with one sendmmsg(2) per
+     * batch rather than one sendmsg(2) per message. The order of the queue
+     * is kept, and so is the order of the messages in each stream. */
+    while (!dlist_is_empty(&conn->msgs)) {
+        struct mmsghdr hdrs[SCTP_SEND_BATCH_MAX];
+        struct iovec   iov[SCTP_SEND_BATCH_MAX];
+        union {
+            char buf[CMSG_SPACE(sizeof(struct sctp_sndrcvinfo))];
+            struct cmsghdr align;
+        } ctrl[SCTP_SEND_BATCH_MAX];
+        int count = 0;
+        int res;
+
+        dlist_for_each_entry(sctp_msg_t, msg, &conn->msgs, msg_list) {
+            struct msghdr *hdr = &hdrs[count].msg_hdr;
+            struct sctp_sndrcvinfo sinfo = {
+                .sinfo_stream = msg->stream,
+                .sinfo_ppid   = htonl(msg->ppid),
+            };
+            struct cmsghdr *cmsg;
+
+            iov[count] = MAKE_IOVEC(msg->msg.data, msg->msg.len);
+            p_clear(&hdrs[count], 1);
+            hdr->msg_iov        = &iov[count];
+            hdr->msg_iovlen     = 1;
+            hdr->msg_control    = ctrl[count].buf;
+            hdr->msg_controllen = sizeof(ctrl[count].buf);
+
+            cmsg = CMSG_FIRSTHDR(hdr);
+            cmsg->cmsg_level = IPPROTO_SCTP;
+            cmsg->cmsg_type  = SCTP_SNDRCV;
+            cmsg->cmsg_len   = CMSG_LEN(sizeof(sinfo));
+            hdr->msg_controllen = cmsg->cmsg_len;
+            memcpy(CMSG_DATA(cmsg), &sinfo, sizeof(sinfo));
+
+            if (++count == SCTP_SEND_BATCH_MAX) {
+                break;
+            }
+        }
 
-    dlist_for_each_entry(sctp_msg_t, msg, &conn->msgs, msg_list) {
         errno = 0;
-        len = sctp_sendmsg(fd, msg->msg.data, msg->msg.len, NULL, 0,
-                           htonl(msg->ppid), msg_flags, stream_no, 0, 0);
-        if (len < 0) {
+        res = sendmmsg(fd, hdrs, count, MSG_DONTWAIT);
+        if (res < 0) {
             if (!ERR_RW_RETRIABLE(errno)) {
                 logger_error(conn->user_ctx.logger,
                              "SCTP send message to fd: %d failed: %m", fd);
@@ -229,9 +298,17 @@ static int sctp_send_queued_msgs(sctp_conn_priv_t **pconn)
         }
 
         logger_trace(conn->user_ctx.logger, 2,
-                     "send message to %d succeed (%d bytes)",
-                     fd, len);
-        sctp_msg_delete(&msg);
+                     "send %d messages to %d succeed", res, fd);
+        for (int i = 0; i < res; i++) {
+            sctp_msg_t *msg = dlist_first_entry(&conn->msgs, sctp_msg_t,
+                                                msg_list);
+
+            sctp_msg_delete(&msg);
+        }
+        if (res < count) {
+            /* The send buffer is full, wait for the next POLLOUT. */
+            return 0;
+        }
     }
     el_fd_set_mask(conn->evh, POLLIN);
     return 0;
@@ -366,13 +443,44 @@ static int sctp_receive_full_msg(sctp_conn_priv_t **pconn)
     }
 
     logger_trace(conn->user_ctx.logger, 2,
-                 "SCTP received %d bytes from fd: %d",
-                 ibuf->len, fd);
+                 "SCTP received %d bytes from fd: %d on stream %d",
+                 ibuf->len, fd, sinfo.sinfo_stream);
     conn->reset_rbuf = true;
+    conn->rstream = sinfo.sinfo_stream;
 
     return SCTP_MSG_TYPE_DATA;
 }
 
+typedef struct sctp_stream_job_t {
+    thr_job_t         job;
+    sctp_conn_priv_t *conn;
+    uint16_t          stream;
+    lstr_t            data;
+} sctp_stream_job_t;
+
+static void sctp_stream_job_run(thr_job_t *job, thr_syn_t *syn)
+{
+    sctp_stream_job_t *sjob = container_of(job, sctp_stream_job_t, job);
+    sctp_conn_priv_t *conn = sjob->conn;
+
+    conn->on_stream_data_cb(&conn->user_ctx, sjob->stream, sjob->data);
+    lstr_wipe(&sjob->data);
+    p_delete(&sjob);
+}
+
+/* Hand the message of the read buffer to the serial queue of its stream. */
+static void sctp_conn_dispatch_data(sctp_conn_priv_t *conn)
+{
+    sctp_stream_job_t *sjob = p_new(sctp_stream_job_t, 1);
+    int qpos = conn->rstream % conn->stream_queues.len;
+
+    sjob->job.run = &sctp_stream_job_run;
+    sjob->conn    = conn;
+    sjob->stream  = conn->rstream;
+    sjob->data    = lstr_dup(LSTR_SB_V(&conn->rbuf));
+    thr_queue(conn->stream_queues.tab[qpos], &sjob->job);
+}
+
 static int sctp_conn_on_event_in(sctp_conn_priv_t **pconn)
 {
     sctp_conn_priv_t *conn = *pconn;
@@ -391,6 +499,10 @@ static int sctp_conn_on_event_in(sctp_conn_priv_t **pconn)
             RETHROW(sctp_handle_notification(pconn));
             break;
         case SCTP_MSG_TYPE_DATA:
+            if (conn->stream_queues.len) {
+                sctp_conn_dispatch_data(conn);
+                break;
+            }
             data_received = true;
             if (conn->on_data_cb(&conn->user_ctx, &conn->rbuf, false) < 0) {
                 logger_warning(conn->user_ctx.logger,
@@ -527,11 +639,14 @@ static int sctp_srv_on_event(el_t evh, int fd, short ev, el_data_t priv)
         conn->is_listening         = false;
         conn->on_disconnect_cb     = listen_ctx->on_disconnect_cb;
         conn->on_data_cb           = listen_ctx->on_data_cb;
+        conn->on_stream_data_cb    = listen_ctx->on_stream_data_cb;
+        conn->nb_stream_queues     = listen_ctx->nb_stream_queues;
         conn->user_ctx.entity_id   = lstr_dup(user_ctx->entity_id);
         conn->user_ctx.priv        = user_ctx->priv;
         conn->user_ctx.logger      = logger;
         conn->user_ctx.host        = lstr_dup(LSTR(host));
         conn->user_ctx.port        = port;
+        sctp_conn_stream_queues_init(conn);
 
         listen_ctx->on_accept_cb(&conn->user_ctx);
     }
@@ -547,6 +662,7 @@ static void sctp_conn_close_priv(sctp_conn_priv_t **pconn)
                 &conn->user_ctx.entity_id);
 
     el_unregister(&conn->evh);
+    sctp_conn_stream_queues_wipe(conn);
 
     logger_trace(conn->user_ctx.logger, 4, "connection closed");
     if (conn->on_disconnect_cb) {
@@ -725,8 +841,8 @@ sctp_conn_t *sctp_listen(const lstr__array_t *addrs, int port, size_t sndbuf,
     return &conn->user_ctx;
 }
 
-void sctp_send_msg(sctp_conn_t *pub_ctx, lstr_t payload,
-                   uint32_t payload_protocol_id)
+void sctp_send_msg_stream(sctp_conn_t *pub_ctx, lstr_t payload,
+                          uint32_t payload_protocol_id, uint16_t stream)
 {
     sctp_conn_priv_t *conn = NULL;
     sctp_msg_t *msg;
@@ -749,6 +865,7 @@ void sctp_send_msg(sctp_conn_t *pub_ctx, lstr_t payload,
 
     msg = sctp_msg_new();
     msg->ppid = payload_protocol_id;
+    msg->stream = stream;
     msg->msg = lstr_dup(payload);
 
     dlist_add_tail(&conn->msgs, &msg->msg_list);
@@ -756,6 +873,25 @@ void sctp_send_msg(sctp_conn_t *pub_ctx, lstr_t payload,
     el_fd_set_mask(conn->evh, POLLINOUT);
 }
 
+void sctp_send_msg(sctp_conn_t *pub_ctx, lstr_t payload,
+                   uint32_t payload_protocol_id)
+{
+    sctp_send_msg_stream(pub_ctx, payload, payload_protocol_id, 0);
+}
+
+void sctp_conn_set_stream_dispatch(sctp_conn_t *pub_ctx, int nb_queues,
+                                   sctp_on_stream_data_f on_stream_data_cb)
+{
+    sctp_conn_priv_t *conn = GET_PRIV_CONN(pub_ctx);
+
+    sctp_conn_stream_queues_wipe(conn);
+    conn->on_stream_data_cb = on_stream_data_cb;
+    conn->nb_stream_queues = on_stream_data_cb ? MAX(nb_queues, 1) : 0;
+    if (!conn->is_listening) {
+        sctp_conn_stream_queues_init(conn);
+    }
+}
+
 void sctp_conn_close(sctp_conn_t **ppub_ctx)
 {
     sctp_conn_t *pub_ctx;
@@ -0,0 +1,279 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_SKETCH_H
+#define IS_LIB_COMMON_SKETCH_H
+
+#include <lib-common/core.h>
+#include <lib-common/hash.h>
+#include <lib-common/iop.h>
+#include "core/core.iop.h"
+
+/** \defgroup sketch Streaming sketches.
+ * \brief Approximate counting of distinct and frequent keys.
+ *
+ * \{
+ *
+ * These structures summarize a stream of keys in a small and bounded
+ * amount of memory, and answer approximately questions that would need to
+ * keep all the keys otherwise:
+ *  - hll_t: how many distinct keys were seen?
+ *  - cms_t: how many times was this key seen?
+ *  - topk_t: what are the most frequent keys?
+ *
+ * All of them can be merged, which allows to compute them on several
+ * threads or nodes and to aggregate the results; they have an IOP
+ * representation (see core.iop) to be sent over the network or stored.
+ *
+ * The keys are given by their 64-bit hash (wyhash64() for the helpers
+ * taking the data directly), which must thus be the same on all the nodes.
+ *
+ * The sketches are not thread-safe.
+ */
+
+/* {{{ HyperLogLog */
+
+/** HyperLogLog distinct counter.
+ *
+ * This is the HyperLogLog++ variant: small cardinalities are counted with a
+ * sparse list of registers at a high precision, which is converted to the
+ * 2^precision dense registers when it would take more memory than them.
+ * The estimation uses the improved estimator of Otmar Ertl, which needs no
+ * empirical bias correction.
+ *
+ * The standard error is about 1.04 / sqrt(2^precision), that is 0.81% for
+ * the default precision of 14, with 16kB of registers.
+ */
+typedef struct hll_t {
+    uint8_t   precision;
+    bool      is_dense;
+
+    /* Sparse representation: sorted (index << 6 | rank) entries at the
+     * precision HLL_SPARSE_PRECISION, and the entries that are not sorted
+     * nor deduplicated yet. */
+    qv_t(u32) sparse;
+    qv_t(u32) pending;
+
+    /* Dense representation: 2^precision registers. */
+    uint8_t  *dense;
+} hll_t;
+
+#define HLL_PRECISION_MIN      4
+#define HLL_PRECISION_MAX      18
+#define HLL_PRECISION_DEFAULT  14
+#define HLL_SPARSE_PRECISION   25
+
+hll_t * nonnull hll_init(hll_t * nonnull hll, int precision);
+void hll_wipe(hll_t * nonnull hll);
+GENERIC_DELETE(hll_t, hll);
+
+static inline hll_t * nonnull hll_new(int precision)
+{
+    return hll_init(p_new_raw(hll_t, 1), precision);
+}
+
+/** Forget all the keys of a sketch. */
+void hll_clear(hll_t * nonnull hll);
+
+void hll_add_hash(hll_t * nonnull hll, uint64_t hash);
+
+static inline void hll_add(hll_t * nonnull hll,
+                           const void * nonnull data, size_t len)
+{
+    hll_add_hash(hll, wyhash64(data, len, 0));
+}
+
+/** Estimate the number of distinct keys added to a sketch. */
+uint64_t hll_count(hll_t * nonnull hll);
+
+/** Add in \p dst the keys of \p src.
+ *
+ * \return 0 on success, -1 if the sketches have different precisions.
+ */
+int hll_merge(hll_t * nonnull dst, hll_t * nonnull src);
+
+/** Get the IOP representation of a sketch.
+ *
+ * \p out points to the memory of \p hll, and is valid until it is modified.
+ */
+void hll_to_iop(hll_t * nonnull hll, core__hll_sketch__t * nonnull out);
+
+/** Initialize a sketch from its IOP representation.
+ *
+ * \return 0 on success, -1 if the representation is invalid (\p hll is
+ *         then initialized empty, with the default precision).
+ */
+int hll_init_from_iop(hll_t * nonnull hll,
+                      const core__hll_sketch__t * nonnull in);
+
+/* }}} */
+/* {{{ Count-min sketch */
+
+/** Count-min sketch.
+ *
+ * The sketch is made of depth rows of width counters, each key
+ * incrementing one counter of each row; its count is the minimum of its
+ * counters. The count is never underestimated, and overestimated by more
+ * than epsilon * total with a probability lower than delta, with a width
+ * of e / epsilon and a depth of ln(1 / delta).
+ */
+typedef struct cms_t {
+    uint32_t  width;
+    uint32_t  depth;
+    uint64_t  total;
+    uint64_t *counters;
+} cms_t;
+
+cms_t * nonnull cms_init(cms_t * nonnull cms, uint32_t width,
+                         uint32_t depth);
+void cms_wipe(cms_t * nonnull cms);
+GENERIC_DELETE(cms_t, cms);
+
+/** Compute the dimensions of a sketch for the given error bounds.
+ *
+ * \param[in]  epsilon  the maximum overestimation, as a fraction of the
+ *                      total count, in ]0, 1[.
+ * \param[in]  delta    the probability to exceed it, in ]0, 1[.
+ */
+void cms_dimensions(double epsilon, double delta,
+                    uint32_t * nonnull width, uint32_t * nonnull depth);
+
+static inline cms_t * nonnull cms_new(uint32_t width, uint32_t depth)
+{
+    return cms_init(p_new_raw(cms_t, 1), width, depth);
+}
+
+void cms_clear(cms_t * nonnull cms);
+
+/** Add \p count occurrences of a key.
+ *
+ * \return the new estimated count of the key.
+ */
+uint64_t cms_add_hash(cms_t * nonnull cms, uint64_t hash, uint64_t count);
+
+uint64_t cms_count_hash(const cms_t * nonnull cms, uint64_t hash);
+
+static inline uint64_t cms_add(cms_t * nonnull cms, const void * nonnull data,
+                               size_t len, uint64_t count)
+{
+    return cms_add_hash(cms, wyhash64(data, len, 0), count);
+}
+
+static inline uint64_t cms_count(const cms_t * nonnull cms,
+                                 const void * nonnull data, size_t len)
+{
+    return cms_count_hash(cms, wyhash64(data, len, 0));
+}
+
+/** Add in \p dst the counts of \p src.
+ *
+ * \return 0 on success, -1 if the sketches have different dimensions.
+ */
+int cms_merge(cms_t * nonnull dst, const cms_t * nonnull src);
+
+/** Get the IOP representation of a sketch.
+ *
+ * \p out points to the memory of \p cms, and is valid until it is modified.
+ */
+void cms_to_iop(const cms_t * nonnull cms,
+                core__count_min_sketch__t * nonnull out);
+
+/** Initialize a sketch from its IOP representation.
+ *
+ * \return 0 on success, -1 if the representation is invalid.
+ */
+int cms_init_from_iop(cms_t * nonnull cms,
+                      const core__count_min_sketch__t * nonnull in);
+
+/* }}} */
+/* {{{ Top-k */
+
+typedef struct topk_entry_t {
+    lstr_t   key;
+    uint64_t count;
+} topk_entry_t;
+
+qvector_t(topk_entry, topk_entry_t);
+qm_kvec_t(topk_pos, lstr_t, uint32_t, qhash_lstr_hash, qhash_lstr_equal);
+
+/** Heavy hitters sketch.
+ *
+ * The sketch keeps the k keys with the highest counts, as estimated by a
+ * count-min sketch of all the keys. Unlike the count-min sketch alone, the
+ * keys themselves are kept (and copied), so that they can be listed.
+ */
+typedef struct topk_t {
+    uint32_t k;
+    cms_t    cms;
+
+    /* The candidates, and their position in entries. */
+    qv_t(topk_entry) entries;
+    qm_t(topk_pos)   pos;
+} topk_t;
+
+topk_t * nonnull topk_init(topk_t * nonnull topk, uint32_t k,
+                           uint32_t width, uint32_t depth);
+void topk_wipe(topk_t * nonnull topk);
+GENERIC_DELETE(topk_t, topk);
+
+static inline topk_t * nonnull topk_new(uint32_t k, uint32_t width,
+                                        uint32_t depth)
+{
+    return topk_init(p_new_raw(topk_t, 1), k, width, depth);
+}
+
+void topk_clear(topk_t * nonnull topk);
+
+/** Add \p count occurrences of a key. */
+void topk_add(topk_t * nonnull topk, lstr_t key, uint64_t count);
+
+/** Get the top keys, sorted by decreasing count.
+ *
+ * The vector belongs to \p topk, and is valid until it is modified.
+ */
+const qv_t(topk_entry) * nonnull topk_get(topk_t * nonnull topk);
+
+/** Add in \p dst the keys of \p src.
+ *
+ * The top keys are recomputed from the union of the candidates of both
+ * sketches, with the counts of the merged count-min sketch.
+ *
+ * \return 0 on success, -1 if the sketches have different dimensions.
+ */
+int topk_merge(topk_t * nonnull dst, const topk_t * nonnull src);
+
+/** Get the IOP representation of a sketch.
+ *
+ * The entries are allocated on the t_stack, the rest points to the memory
+ * of \p topk.
+ */
+void t_topk_to_iop(const topk_t * nonnull topk,
+                   core__top_k_sketch__t * nonnull out);
+
+/** Initialize a sketch from its IOP representation.
+ *
+ * \return 0 on success, -1 if the representation is invalid.
+ */
+int topk_init_from_iop(topk_t * nonnull topk,
+                       const core__top_k_sketch__t * nonnull in);
+
+/* }}} */
+
+/** \} */
+
+#endif
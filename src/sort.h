@@ -23,14 +23,28 @@
 
 /* {{{ Numeric optimized versions */
 
+/* bisect*() and contains*() scan the arrays of at most BISECT_SCAN_MAX
+ * items instead of bisecting them.
+ *
+ * bisect*_many() bisect sorted values: pos[i] = bisect*(what[i], data, len,
+ * NULL), each search starting from the result of the previous one.
+ */
+#define BISECT_SCAN_MAX  8
+
 static inline
 size_t bisect8(uint8_t what, const uint8_t data[], size_t len, bool *found);
 static inline
 size_t bisect_i8(int8_t what, const int8_t data[], size_t len, bool *found);
 static inline
 bool contains8(uint8_t what, const uint8_t data[], size_t len);
+static inline void
+bisect8_many(const uint8_t what[], size_t nb, const uint8_t data[],
+             size_t len, size_t pos[]);
 static inline
 bool contains_i8(int8_t what, const int8_t data[], size_t len);
+static inline void
+bisect_i8_many(const int8_t what[], size_t nb, const int8_t data[],
+               size_t len, size_t pos[]);
 
 void   dsort8(uint8_t base[], size_t n);
 void   dsort_i8(int8_t base[], size_t n);
@@ -45,8 +59,14 @@ static inline size_t
 bisect_i16(int16_t what, const int16_t data[], size_t len, bool *found);
 static inline
 bool contains16(uint16_t what, const uint16_t data[], size_t len);
+static inline void
+bisect16_many(const uint16_t what[], size_t nb, const uint16_t data[],
+              size_t len, size_t pos[]);
 static inline
 bool contains_i16(int16_t what, const int16_t data[], size_t len);
+static inline void
+bisect_i16_many(const int16_t what[], size_t nb, const int16_t data[],
+                size_t len, size_t pos[]);
 
 void   dsort16(uint16_t base[], size_t n);
 void   dsort_i16(int16_t base[], size_t n);
@@ -61,8 +81,14 @@ static inline size_t
 bisect_i32(int32_t what, const int32_t data[], size_t len, bool *found);
 static inline
 bool contains32(uint32_t what, const uint32_t data[], size_t len);
+static inline void
+bisect32_many(const uint32_t what[], size_t nb, const uint32_t data[],
+              size_t len, size_t pos[]);
 static inline
 bool contains_i32(int32_t what, const int32_t data[], size_t len);
+static inline void
+bisect_i32_many(const int32_t what[], size_t nb, const int32_t data[],
+                size_t len, size_t pos[]);
 
 void   dsort32(uint32_t base[], size_t n);
 void   dsort_i32(int32_t base[], size_t n);
@@ -77,8 +103,14 @@ static inline size_t
 bisect_i64(int64_t what, const int64_t data[], size_t len, bool *found);
 static inline
 bool contains64(uint64_t what, const uint64_t data[], size_t len);
+static inline void
+bisect64_many(const uint64_t what[], size_t nb, const uint64_t data[],
+              size_t len, size_t pos[]);
 static inline
 bool contains_i64(int64_t what, const int64_t data[], size_t len);
+static inline void
+bisect_i64_many(const int64_t what[], size_t nb, const int64_t data[],
+                size_t len, size_t pos[]);
 
 void   dsort64(uint64_t base[], size_t n);
 void   dsort_i64(int64_t base[], size_t n);
@@ -87,44 +119,59 @@ static inline size_t uniq_i64(int64_t base[], size_t n) {
     return uniq64((uint64_t *)base, n);
 }
 
+/** Sort keys and move their values along.
+ *
+ * This is the same radix sort as dsort64(), it is stable: the values of
+ * equal keys keep their order.
+ */
+void dsort64_kv32(uint64_t keys[], uint32_t vals[], size_t n);
+
 #define type_t   uint8_t
 #define bisect   bisect8
 #define contains contains8
+#define bisect_many bisect8_many
 #include "core/sort-numeric.in.h"
 
 #define type_t   int8_t
 #define bisect   bisect_i8
 #define contains contains_i8
+#define bisect_many bisect_i8_many
 #include "core/sort-numeric.in.h"
 
 #define type_t   uint16_t
 #define bisect   bisect16
 #define contains contains16
+#define bisect_many bisect16_many
 #include "core/sort-numeric.in.h"
 
 #define type_t   int16_t
 #define bisect   bisect_i16
 #define contains contains_i16
+#define bisect_many bisect_i16_many
 #include "core/sort-numeric.in.h"
 
 #define type_t   uint32_t
 #define bisect   bisect32
 #define contains contains32
+#define bisect_many bisect32_many
 #include "core/sort-numeric.in.h"
 
 #define type_t   int32_t
 #define bisect   bisect_i32
 #define contains contains_i32
+#define bisect_many bisect_i32_many
 #include "core/sort-numeric.in.h"
 
 #define type_t   uint64_t
 #define bisect   bisect64
 #define contains contains64
+#define bisect_many bisect64_many
 #include "core/sort-numeric.in.h"
 
 #define type_t   int64_t
 #define bisect   bisect_i64
 #define contains contains_i64
+#define bisect_many bisect_i64_many
 #include "core/sort-numeric.in.h"
 
 /* }}} */
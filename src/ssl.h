@@ -521,6 +521,91 @@ typedef enum ssl_handshake_status_t {
 ssl_handshake_status_t
 ssl_do_handshake(SSL *ssl, el_t nullable ev, int fd, sb_t * nullable rbuf);
 
+/** Ask for the kernel TLS offload of the connections of a context.
+ *
+ * When the negotiated cipher is supported by the kernel, the keys are
+ * installed on the socket at the end of the handshake, and the records are
+ * encrypted (resp. decrypted) by the kernel: the plain text can then be
+ * written directly on the socket, with writev() or sendfile().
+ *
+ * \return 0 on success, -1 with errno set to ENOTSUP when openssl is built
+ *         without kTLS.
+ */
+int ssl_ctx_enable_ktls(SSL_CTX *ctx);
+
+/** Ask for the kernel TLS offload of a connection, see ssl_ctx_enable_ktls().
+ *
+ * It must be called before the handshake.
+ */
+int ssl_enable_ktls(SSL *ssl);
+
+/** Tell whether the records sent on a connection are encrypted by the kernel.
+ *
+ * It is only meaningful once the handshake is completed; when it is true,
+ * the plain text can be written directly on the socket of the connection.
+ */
+bool ssl_ktls_send_enabled(SSL *ssl);
+
+/** Session resumption.
+ *
+ * A resumed handshake skips the asymmetric cryptography (signature and
+ * verification of the certificates), which dominates the cost of the
+ * reconnections.
+ *
+ * On the server side, the session tickets are encrypted with keys shared by
+ * all the server contexts of the process (thus all the reactors), and
+ * rotated every `rotation` seconds; a ticket is accepted as long as its key
+ * is one of the SSL_TICKET_KEYS_MAX last ones. The keys can be shared by
+ * several processes listening on the same address through a file.
+ *
+ * On the client side, the sessions received from the servers are cached by
+ * peer, and used by the next connections to the same peer.
+ */
+#define SSL_TICKET_KEYS_MAX          3
+#define SSL_TICKET_ROTATION_DFL      (12 * 3600)
+#define SSL_SESSION_CACHE_MAX        1024
+
+/** Configure the rotation of the session ticket keys.
+ *
+ * \param[in] path      the file in which the keys are shared with the other
+ *                      processes, NULL for keys private to the process.
+ * \param[in] rotation  the period of rotation of the keys in seconds,
+ *                      SSL_TICKET_ROTATION_DFL if 0.
+ */
+void ssl_ticket_keys_configure(const char * nullable path, int rotation);
+
+/** Encrypt the session tickets of a server context with the shared keys. */
+int ssl_ctx_enable_ticket_keys(SSL_CTX *ctx);
+
+/** Cache the sessions of the client connections of a context.
+ *
+ * The sessions are only cached for the connections whose peer is set with
+ * ssl_set_session_peer().
+ */
+int ssl_ctx_enable_session_cache(SSL_CTX *ctx);
+
+/** Set the peer of a client connection, before its handshake.
+ *
+ * The cached session of the peer, if any, is resumed, and the sessions
+ * received on the connection are cached for that peer.
+ *
+ * \param[in] peer  the key of the peer in the cache, usually its address.
+ * \return true if a cached session is proposed to the server.
+ */
+bool ssl_set_session_peer(SSL *ssl, lstr_t peer);
+
+typedef struct ssl_handshake_stats_t {
+    uint64_t server_full;
+    uint64_t server_resumed;
+    uint64_t client_full;
+    uint64_t client_resumed;
+    uint32_t session_cache_len;
+} ssl_handshake_stats_t;
+
+/** Get the number of handshakes completed by ssl_do_handshake(), and how
+ * many of them resumed a session. */
+void ssl_get_handshake_stats(ssl_handshake_stats_t *stats);
+
 /** Wrapper to SSL_read that mimic read(2).
  *
  * \warning please carefully read what follows:
@@ -585,8 +670,12 @@ ssize_t ssl_write(SSL *ssl, const void *buf, size_t len);
  * configured to allow partial write (see SSL_MODE_ENABLE_PARTIAL_WRITE and
  * SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER).
  *
- * \param[in]  fd  The socket from which data are sent; this argument is
- *                 unused: the ssl context (`priv`) is used instead.
+ * When the records are encrypted by the kernel (see ssl_ktls_send_enabled()),
+ * the buffers are written directly on `fd` with writev().
+ *
+ * \param[in]  fd  The socket from which data are sent; it is only used when
+ *                 kTLS is enabled, the ssl context (`priv`) is used
+ *                 otherwise.
  * \param[in]  iov  The buffers to write.
  * \param[in]  iovcnt  The number of iov buffers.
  * \param[in]  priv  A pointer to the corresponding SSL structure.
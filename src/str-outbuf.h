@@ -39,6 +39,11 @@ typedef struct outbuf_t {
     int      sb_trailing;
     sb_t     sb;
     htlist_t chunks_list;
+
+    /* chunks sent with MSG_ZEROCOPY, waiting for their completion */
+    htlist_t zc_chunks;
+    uint32_t zc_seq;
+    bool     zerocopy;
 } outbuf_t;
 
 void ob_check_invariants(outbuf_t * nonnull ob) __leaf;
@@ -49,6 +54,9 @@ static inline outbuf_t * nonnull ob_init(outbuf_t * nonnull ob)
     ob->sb_trailing = 0;
     htlist_init(&ob->chunks_list);
     sb_init(&ob->sb);
+    htlist_init(&ob->zc_chunks);
+    ob->zc_seq      = 0;
+    ob->zerocopy    = false;
     return ob;
 }
 
@@ -64,6 +72,12 @@ static inline bool ob_is_empty(const outbuf_t * nonnull ob)
     return ob->length == 0;
 }
 
+/** Write the content of \p ob to \p fd.
+ *
+ * When \p writerv is NULL, the chunks backed by a file (see
+ * ob_add_filemap()) are sent with sendfile(), and the big memory chunks are
+ * sent with MSG_ZEROCOPY if ob_enable_zerocopy() has been called.
+ */
 int ob_write_with(outbuf_t * nonnull ob, int fd,
                   ssize_t (* nullable writerv)(int,
                                                const struct iovec * nonnull,
@@ -74,12 +88,40 @@ static inline int ob_write(outbuf_t * nonnull ob, int fd) {
 }
 int ob_xread(outbuf_t * nonnull ob, int fd, int size) __leaf;
 
+/** Send the big memory chunks of \p ob with MSG_ZEROCOPY.
+ *
+ * \p fd must be the socket \p ob is written to. The chunks sent this way
+ * are only released once the kernel notified their completion on the error
+ * queue of the socket: ob_zerocopy_reap() must be called when POLLERR is
+ * reported on \p fd.
+ *
+ * \return -1 if the socket does not support zero-copy sends.
+ */
+int ob_enable_zerocopy(outbuf_t * nonnull ob, int fd) __leaf;
+
+/** Process the zero-copy completions queued on the error queue of \p fd.
+ *
+ * The kernel may have to copy the data anyway (e.g. on the loopback), in
+ * which case the zero-copy sends are disabled for \p ob.
+ */
+int ob_zerocopy_reap(outbuf_t * nonnull ob, int fd) __leaf;
+
+typedef struct outbuf_stats_t {
+    uint64_t sendfile_bytes;   /* bytes sent with sendfile()               */
+    uint64_t zerocopy_bytes;   /* bytes sent with MSG_ZEROCOPY             */
+    uint64_t zerocopy_copied;  /* zero-copy completions that were copied   */
+} outbuf_stats_t;
+
+/** Get the counters of the bytes the outbufs sent without copy. */
+void ob_get_stats(outbuf_stats_t * nonnull stats) __leaf;
+
 
 /****************************************************************************/
 /* Chunks                                                                   */
 /****************************************************************************/
 
 #define OUTBUF_CHUNK_MIN_SIZE    (16 << 10)
+#define OUTBUF_ZEROCOPY_MIN_SIZE (64 << 10)
 
 enum outbuf_on_wipe {
     OUTBUF_DO_NOTHING,
@@ -93,13 +135,24 @@ typedef struct outbuf_chunk_t {
     int       offset;
     int       sb_leading;
     int       on_wipe;
+    int       fd;            /* file mapped by the chunk, or -1           */
+    uint32_t  zc_seq;        /* last zero-copy send of the chunk          */
+    bool      zc_pending;
     union {
         const void    * nonnull p;
         const uint8_t * nonnull b;
         void          * nonnull vp;
     } u;
 } outbuf_chunk_t;
+static inline outbuf_chunk_t * nonnull
+ob_chunk_init(outbuf_chunk_t * nonnull obc)
+{
+    p_clear(obc, 1);
+    obc->fd = -1;
+    return obc;
+}
 void ob_chunk_wipe(outbuf_chunk_t * nonnull obc) __leaf;
+GENERIC_NEW(outbuf_chunk_t, ob_chunk);
 GENERIC_DELETE(outbuf_chunk_t, ob_chunk);
 
 static inline void ob_add_chunk(outbuf_t * nonnull ob,
@@ -168,7 +221,7 @@ void ob_add_memchunk(outbuf_t * nonnull ob, const void * nonnull ptr,
         if (!is_const)
             ifree((void *)ptr, MEM_LIBC);
     } else {
-        outbuf_chunk_t *obc = p_new(outbuf_chunk_t, 1);
+        outbuf_chunk_t *obc = ob_chunk_new();
 
         obc->u.p    = ptr;
         obc->length = len;
@@ -185,7 +238,7 @@ static inline void ob_add_memmap(outbuf_t * nonnull ob, void * nonnull map,
         ob_add(ob, map, len);
         munmap(map, len);
     } else {
-        outbuf_chunk_t *obc = p_new(outbuf_chunk_t, 1);
+        outbuf_chunk_t *obc = ob_chunk_new();
 
         obc->u.p     = map;
         obc->length  = len;
@@ -194,9 +247,41 @@ static inline void ob_add_memmap(outbuf_t * nonnull ob, void * nonnull map,
     }
 }
 
+/** adds the mapping \p map of the whole file \p fd.
+ *
+ * Unlike ob_add_memmap(), ob_write() can send it with sendfile(), without
+ * copying the file through the user space. The ownership of both \p map and
+ * \p fd is transfered to \p ob.
+ */
+static inline void ob_add_filemap(outbuf_t * nonnull ob, int fd,
+                                  void * nonnull map, int len)
+{
+    if (len <= OUTBUF_CHUNK_MIN_SIZE) {
+        ob_add(ob, map, len);
+        munmap(map, len);
+        close(fd);
+    } else {
+        outbuf_chunk_t *obc = ob_chunk_new();
+
+        obc->u.p     = map;
+        obc->length  = len;
+        obc->on_wipe = OUTBUF_DO_MUNMAP;
+        obc->fd      = fd;
+        ob_add_chunk(ob, obc);
+    }
+}
+
 int ob_add_file(outbuf_t * nonnull ob, const char * nonnull file, int size)
     __leaf;
 
+/** moves the content of \p rope at the end of \p ob.
+ *
+ * The blocks of the rope become chunks of \p ob without being copied, so
+ * that the rope is written with writev() without being flattened first.
+ * \p rope is left empty.
+ */
+void ob_add_rope(outbuf_t * nonnull ob, sb_rope_t * nonnull rope) __leaf;
+
 #if __has_feature(nullability)
 #pragma GCC diagnostic pop
 #endif
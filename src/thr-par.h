@@ -0,0 +1,101 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_THR_PAR_H
+#define IS_LIB_COMMON_THR_PAR_H
+
+#include <lib-common/container-qvector.h>
+#include <lib-common/thr.h>
+
+/* Parallel algorithms
+ * ~~~~~~~~~~~~~~~~~~~
+ *
+ * These helpers split their input in chunks run as thr jobs, and return
+ * when the whole work is done. The size of the chunks is adaptive: there
+ * are about 8 chunks per thread so that the threads can balance the load,
+ * but they are never smaller than a minimum that amortizes the cost of the
+ * jobs.
+ *
+ * They run serially when there is no parallelism (thr module not loaded,
+ * or thr_parallelism_g == 1) or when the input is too small.
+ */
+
+#ifdef __has_blocks
+
+/** Accumulate the items of [from, to[ into acc. */
+typedef void (BLOCK_CARET thr_par_reduce_b)(size_t from, size_t to,
+                                            void * nonnull acc);
+
+/** Accumulate v into acc: acc = acc . v, where . is an associative
+ * operation. */
+typedef void (BLOCK_CARET thr_par_combine_b)(void * nonnull acc,
+                                             const void * nonnull v);
+
+/** Reduce the range [0, count[ to a single value.
+ *
+ * \param[in]     count     number of items.
+ * \param[in,out] res       the identity of the reduction on input, the
+ *                          result on output.
+ * \param[in]     res_size  size of \p res.
+ * \param[in]     reduce    reduce a range of items; its accumulator starts
+ *                          from a copy of the identity.
+ * \param[in]     combine   combine two partial results. They are combined
+ *                          in the order of their ranges, so the operation
+ *                          only needs to be associative.
+ */
+void thr_parallel_reduce(size_t count, void * nonnull res, size_t res_size,
+                         thr_par_reduce_b nonnull reduce,
+                         thr_par_combine_b nonnull combine);
+
+/** Compute the inclusive prefix scan of an array, in place.
+ *
+ * On return, tab[i] is tab[0] . tab[1] . ... . tab[i] where . is the
+ * operation implemented by \p combine.
+ */
+void thr_parallel_scan(void * nonnull tab, size_t v_size, size_t count,
+                       thr_par_combine_b nonnull combine);
+
+/** Sort an array with a parallel merge sort.
+ *
+ * The comparator is the same as the ones of __qv_sort(), which means that
+ * the comparators built for qv_sort() or by iop_msort_desc() can be used.
+ * The merges are stable, but the chunks are sorted with qsort_r() that is
+ * not guaranteed to be.
+ */
+void thr_parallel_sort(void * nonnull tab, size_t v_size, size_t len,
+                       qvector_cmp_b nonnull cmp);
+
+/** Sort a qv_t vector with thr_parallel_sort(). */
+#define thr_qv_sort(vec, cmp)                                                \
+    thr_parallel_sort((vec)->tab, __qv_sz(vec), (vec)->len,                  \
+                      (qvector_cmp_b)(cmp))
+
+#endif
+
+/** Parallel versions of dsort32(), dsort64() and dsort64_kv32(), from
+ * sort.h.
+ *
+ * The large arrays are sorted with a radix sort whose passes are run in
+ * parallel, the smaller ones with the merge sort of thr_parallel_sort().
+ */
+void thr_parallel_dsort32(uint32_t * nonnull base, size_t n);
+void thr_parallel_dsort64(uint64_t * nonnull base, size_t n);
+void thr_parallel_dsort64_kv32(uint64_t * nonnull keys,
+                               uint32_t * nonnull vals, size_t n);
+
+#endif
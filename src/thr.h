@@ -24,9 +24,11 @@
 #include <lib-common/container-dlist.h>
 
 #include "core/thr-evc.h"
+#include "core/thr-epoch.h"
 #include "core/thr-job.h"
 #include "core/thr-spsc.h"
 #include "core/thr-mpsc.h"
+#include "core/thr-mpmc.h"
 
 extern struct thr_hooks {
     dlist_t init_cbs;
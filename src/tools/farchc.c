@@ -28,7 +28,10 @@ static struct opts_g {
     int help;
     int verbose;
     int compress_lzo;
-} opts_g;
+    int block_size;
+} opts_g = {
+    .block_size = 64,
+};
 
 static popt_t popt[] = {
     OPT_FLAG('h', "help",         &opts_g.help,    "show help"),
@@ -40,6 +43,9 @@ static popt_t popt[] = {
             "add that to the dep target"),
     OPT_FLAG('c', "compress-lzo", &opts_g.compress_lzo,
              "compress files using LZO algorithm"),
+    OPT_INT('B',  "block-size",   &opts_g.block_size,
+            "compress files by independent blocks of this size in KiB, "
+            "0 to compress them as a whole (default: 64)"),
     OPT_END(),
 };
 
@@ -98,14 +104,53 @@ static int dump_and_obfuscate(const char *data, int len, FILE *out)
     return nb_chunk;
 }
 
-static void dump_file(const char *path, farch_entry_t *entry, FILE *out)
+/* Compress the file by blocks, so that it can be read partially. The
+ * blocks offsets are allocated on the t_stack of the caller. */
+static void t_dump_file_blocks(lstr_t file, farch_entry_t *entry, FILE *out)
+{
+    byte lzo_buf[LZO_BUF_MEM_SIZE];
+    int block_size = opts_g.block_size << 10;
+    int nb_blocks = DIV_ROUND_UP(file.len, block_size);
+    int *offsets = t_new_raw(int, nb_blocks + 1);
+    sb_t cdata;
+
+    sb_init(&cdata);
+    for (int i = 0; i < nb_blocks; i++) {
+        pstream_t block = ps_init(file.s + i * block_size,
+                                  MIN(block_size, file.len - i * block_size));
+        int clen = lzo_cbuf_size(ps_len(&block));
+        char *cbuf = sb_grow(&cdata, clen);
+
+        offsets[i] = cdata.len;
+        clen = qlzo1x_compress(cbuf, clen, block, lzo_buf);
+        if (clen < (int)ps_len(&block)) {
+            sb_growlen(&cdata, clen);
+        } else {
+            sb_add(&cdata, block.s, ps_len(&block));
+        }
+    }
+    offsets[nb_blocks] = cdata.len;
+
+    entry->block_size = block_size;
+    entry->block_offsets = offsets;
+    entry->nb_chunks = dump_and_obfuscate(cdata.data, cdata.len, out);
+    entry->compressed_size = cdata.len;
+    sb_wipe(&cdata);
+}
+
+static void t_dump_file(const char *path, farch_entry_t *entry, FILE *out)
 {
     lstr_t file;
 
     DIE_IF(lstr_init_from_file(&file, path, PROT_READ, MAP_SHARED) < 0,
            "unable to open `%s` for reading: %m", path);
     entry->size = file.len;
+    entry->block_size = 0;
+    entry->block_offsets = NULL;
 
+    if (opts_g.compress_lzo && opts_g.block_size > 0 && file.len > 0) {
+        t_dump_file_blocks(file, entry, out);
+    } else
     if (opts_g.compress_lzo) {
         t_scope;
         byte lzo_buf[LZO_BUF_MEM_SIZE];
@@ -133,10 +178,32 @@ static void dump_file(const char *path, farch_entry_t *entry, FILE *out)
 
 qvector_t(farch_entry, farch_entry_t);
 
+static void dump_blocks(const char *archname,
+                        const qv_t(farch_entry) *entries, FILE *out)
+{
+    fprintf(out, "static const int %s_blocks[] = {\n", archname);
+    tab_for_each_ptr(entry, entries) {
+        int nb_blocks;
+
+        if (!entry->block_size) {
+            continue;
+        }
+        nb_blocks = DIV_ROUND_UP(entry->size, entry->block_size);
+        fprintf(out, "    /* %*pM */\n", LSTR_FMT_ARG(entry->name));
+        for (int i = 0; i <= nb_blocks; i++) {
+            fprintf(out, "    %d,\n", entry->block_offsets[i]);
+        }
+    }
+    /* Avoid an empty array. */
+    fprintf(out, "    0,\n"
+            "};\n\n");
+}
+
 static void dump_entries(const char *archname,
                          const qv_t(farch_entry) *entries, FILE *out)
 {
     int chunk = 0;
+    int block = 0;
 
     tab_for_each_ptr(entry, entries) {
         char buffer[2 * PATH_MAX];
@@ -152,11 +219,18 @@ static void dump_entries(const char *archname,
                 "    .chunks = &%s_data[%d],\n"
                 "    .size = %d,\n"
                 "    .compressed_size = %d,\n"
-                "    .nb_chunks = %d,\n"
-                "},\n"
-                "/* }""}} */\n",
+                "    .nb_chunks = %d,\n",
                 archname, chunk, entry->size, entry->compressed_size,
                 entry->nb_chunks);
+        if (entry->block_size) {
+            fprintf(out,
+                    "    .block_size = %d,\n"
+                    "    .block_offsets = &%s_blocks[%d],\n",
+                    entry->block_size, archname, block);
+            block += DIV_ROUND_UP(entry->size, entry->block_size) + 1;
+        }
+        fprintf(out, "},\n"
+                "/* }""}} */\n");
         chunk += entry->nb_chunks;
     }
 }
@@ -224,13 +298,14 @@ static int do_work(const char *reldir, FILE *in, FILE *out, FILE *deps)
         TRACE("adding `%s` as `%s`", path, fullname);
         entry.name = t_lstr_dups(fullname, -1);
         fprintf(out, "/* {""{{ %s */\n", fullname);
-        dump_file(path, &entry, out);
+        t_dump_file(path, &entry, out);
         fprintf(out, "/* }""}} */\n");
         qv_append(&entries, entry);
     }
 
-    fprintf(out, "};\n\n"
-            "static const farch_entry_t %s[] = {\n", name);
+    fprintf(out, "};\n\n");
+    dump_blocks(name, &entries, out);
+    fprintf(out, "static const farch_entry_t %s[] = {\n", name);
     dump_entries(name, &entries, out);
 
     fprintf(out,
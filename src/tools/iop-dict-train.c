@@ -0,0 +1,183 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+/* Train a zstd dictionary for the bpacked messages of an IOP structure,
+ * from samples in JSON, to be used with iop_bpack_dict_register().
+ */
+
+#include <lib-common/iop-compress.h>
+#include <lib-common/iop-json.h>
+#include <lib-common/parseopt.h>
+#include <lib-common/unix.h>
+
+static struct {
+    bool help;
+    const char *dso_path;
+    const char *type;
+    const char *output;
+    int max_size;
+    int level;
+} opts_g = {
+    .max_size = 16 << 10,
+};
+
+static iop_dso_t *
+handle_args(int *argc, char ***argv)
+{
+    const char *arg0 = NEXTARG(*argc, *argv);
+    iop_dso_t *dso;
+    SB_1k(err);
+    popt_t options[] = {
+        OPT_FLAG('h', "help", &opts_g.help, "show help"),
+        OPT_STR('d', "dso", &opts_g.dso_path, "path to IOP dso file"),
+        OPT_STR('t', "type", &opts_g.type,
+                "fullname of the IOP structure of the samples"),
+        OPT_STR('o', "output", &opts_g.output,
+                "output file of the dictionary"),
+        OPT_INT('s', "max-size", &opts_g.max_size,
+                "maximum size of the dictionary (default: 16k)"),
+        OPT_INT('l', "level", &opts_g.level,
+                "compression level used for the statistics"),
+        OPT_END(),
+    };
+
+    *argc = parseopt(*argc, *argv, options, 0);
+    if (*argc < 1 || opts_g.help) {
+        makeusage(!opts_g.help, arg0, "<sample.json>...", NULL, options);
+    }
+
+    if (!opts_g.dso_path) {
+        e_error("A dso file must be provided");
+        return NULL;
+    }
+    if (!opts_g.type) {
+        e_error("The fullname of the IOP structure must be provided");
+        return NULL;
+    }
+    if (!opts_g.output) {
+        e_error("An output file must be provided");
+        return NULL;
+    }
+
+    dso = iop_dso_open(opts_g.dso_path, LM_ID_BASE, &err);
+    if (!dso) {
+        e_error("cannot open dso `%s`: %pL", opts_g.dso_path, &err);
+        return NULL;
+    }
+
+    return dso;
+}
+
+static int
+t_load_samples(const iop_struct_t *st, int argc, char **argv,
+               qv_t(cvoid) *samples)
+{
+    SB_1k(err);
+
+    for (int i = 0; i < argc; i++) {
+        void *value = NULL;
+
+        if (t_iop_junpack_ptr_file(argv[i], st, &value, 0, NULL, &err) < 0)
+        {
+            e_error("cannot load sample `%s`: %pL", argv[i], &err);
+            return -1;
+        }
+        qv_append(samples, value);
+    }
+    return 0;
+}
+
+/* Print the average sizes of the samples, bpacked and compressed with
+ * and without the dictionary. */
+static void print_stats(const iop_struct_t *st, const qv_t(cvoid) *samples,
+                        lstr_t dict_data)
+{
+    compress_dict_t *dict = compress_dict_new(dict_data, opts_g.level);
+    size_t raw = 0, nodict = 0, withdict = 0;
+    SB_8k(buf);
+    SB_8k(out);
+
+    if (!dict) {
+        e_error("cannot load the trained dictionary");
+        return;
+    }
+    tab_for_each_entry(v, samples) {
+        sb_reset(&buf);
+        sb_reset(&out);
+        iop_bpack_sb(&buf, st, v, 0);
+        raw += buf.len;
+        nodict += sb_add_compress(&out, COMPRESS_ZSTD, opts_g.level, NULL,
+                                  buf.data, buf.len);
+        withdict += sb_add_compress(&out, COMPRESS_ZSTD, opts_g.level, dict,
+                                    buf.data, buf.len);
+    }
+    printf("dictionary %u: %d bytes, %d samples\n",
+           compress_dict_id(dict), dict_data.len, samples->len);
+    printf("average size: bpack %zu, zstd %zu, zstd with dictionary %zu\n",
+           raw / samples->len, nodict / samples->len,
+           withdict / samples->len);
+
+    compress_dict_delete(&dict);
+    sb_wipe(&buf);
+    sb_wipe(&out);
+}
+
+int main(int argc, char **argv)
+{
+    t_scope;
+    const iop_struct_t *st;
+    qv_t(cvoid) samples;
+    iop_dso_t *dso;
+    SB_8k(dict);
+    int ret = -1;
+
+    dso = handle_args(&argc, &argv);
+    if (!dso) {
+        return -1;
+    }
+
+    st = iop_dso_find_type(dso, LSTR(opts_g.type));
+    if (!st) {
+        e_error("cannot find the IOP structure `%s` in the DSO",
+                opts_g.type);
+        goto end;
+    }
+
+    t_qv_init(&samples, argc);
+    if (t_load_samples(st, argc, argv, &samples) < 0) {
+        goto end;
+    }
+    if (iop_bpack_dict_train(&dict, st, samples.tab, samples.len,
+                             opts_g.max_size) < 0)
+    {
+        e_error("dictionary training failed, more samples are probably "
+                "needed");
+        goto end;
+    }
+    if (sb_write_file(&dict, opts_g.output) < 0) {
+        e_error("cannot write `%s`: %m", opts_g.output);
+        goto end;
+    }
+    print_stats(st, &samples, LSTR_SB_V(&dict));
+    ret = 0;
+
+  end:
+    sb_wipe(&dict);
+    iop_dso_close(&dso);
+    return ret;
+}
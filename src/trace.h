@@ -0,0 +1,228 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_TRACE_H
+#define IS_LIB_COMMON_TRACE_H
+
+#include <lib-common/core.h>
+
+/** \defgroup trace Distributed tracing.
+ * \brief Sampled spans, propagated between the processes.
+ *
+ * \{
+ *
+ * A span measures an operation (an RPC, a job, an HTTP query...). The spans
+ * of a trace form a tree: each one but the root has the id of its parent,
+ * and they all share the 128-bit id of the trace, which is propagated to the
+ * other processes in the IC headers and in the HTTP `traceparent` header
+ * (W3C trace context).
+ *
+ * Whether a trace is recorded is decided once, when its root span is
+ * started (see trace_set_sample_rate()); the spans of a trace that is not
+ * sampled cost a few tests, and only the sampled contexts are propagated.
+ *
+ * The ended spans are written into a ring of the thread that ran them,
+ * without lock nor allocation, and a background thread reads the rings and
+ * gives the records by batches to the exporter (see trace_set_exporter()).
+ * The records that don't fit in a full ring are dropped.
+ *
+ * lib-common opens spans for the RPCs received by the ichannels, the
+ * queries of the HTTP servers, the tagged jobs (see thr_job_tag()) and the
+ * callbacks of the events of the loop flagged by el_set_span(); the user
+ * code can add its own around any operation.
+ */
+
+/** Context of a span, propagated to its children.
+ *
+ * A zero span_id means that there is no sampled span.
+ */
+typedef struct trace_ctx_t {
+    uint64_t trace_hi;
+    uint64_t trace_lo;
+    uint64_t span_id;
+} trace_ctx_t;
+
+/** Context of the span running in the current thread. */
+extern __thread trace_ctx_t trace_ctx_g;
+
+/** Threshold under which a random 64-bit number samples a root span. */
+extern uint64_t trace_sample_threshold_g;
+
+static inline bool trace_ctx_is_sampled(const trace_ctx_t * nullable ctx)
+{
+    return ctx && ctx->span_id;
+}
+
+/** A span being measured.
+ *
+ * The span lives in the caller memory (the stack, or the structure of the
+ * operation for the asynchronous ones).
+ */
+typedef struct trace_span_t {
+    trace_ctx_t  ctx;
+    uint64_t     parent_id;
+    const char  * nullable name;
+    int64_t      start;
+} trace_span_t;
+
+/** A span as given to the exporter. */
+typedef struct trace_record_t {
+    trace_ctx_t  ctx;
+    uint64_t     parent_id;  /**< 0 for the root spans */
+    const char  * nonnull name;
+    int64_t      start;      /**< wall-clock time, in nanoseconds */
+    int64_t      duration;   /**< in nanoseconds */
+    int32_t      status;     /**< status of the operation: the IC status for
+                                  the RPCs, the HTTP code for the queries */
+    int32_t      tid;        /**< system id of the thread */
+} trace_record_t;
+
+bool __trace_span_start(trace_span_t * nonnull span,
+                        const char * nonnull name,
+                        const trace_ctx_t * nullable parent);
+void __trace_span_end(trace_span_t * nonnull span, int status);
+
+/** Start a span.
+ *
+ * The span is a child of \p parent when it is sampled, otherwise of the
+ * span running in the thread when there is one, otherwise it is the root of
+ * a new trace which is sampled with the probability of the sample rate.
+ *
+ * This does not change the span running in the thread, see
+ * trace_span_enter().
+ *
+ * \param[out] span    the span to start.
+ * \param[in]  name    a static name for the operation.
+ * \param[in]  parent  the context received from a remote caller, if any.
+ *
+ * \return whether the span is sampled.
+ */
+static inline bool trace_span_start(trace_span_t * nonnull span,
+                                    const char * nonnull name,
+                                    const trace_ctx_t * nullable parent)
+{
+    if (likely(!trace_ctx_is_sampled(parent)
+           &&  !trace_ctx_is_sampled(&trace_ctx_g)
+           &&  !trace_sample_threshold_g))
+    {
+        span->ctx = (trace_ctx_t){ .span_id = 0 };
+        return false;
+    }
+    return __trace_span_start(span, name, parent);
+}
+
+/** End a span, and record it when it is sampled. */
+static inline void trace_span_end(trace_span_t * nonnull span, int status)
+{
+    if (unlikely(span->ctx.span_id)) {
+        __trace_span_end(span, status);
+    }
+}
+
+/** Make a span the one running in the thread.
+ *
+ * \return the previous context, to give to trace_span_leave().
+ */
+static inline trace_ctx_t trace_span_enter(const trace_span_t * nonnull span)
+{
+    trace_ctx_t prev = trace_ctx_g;
+
+    trace_ctx_g = span->ctx;
+    return prev;
+}
+
+static inline void trace_span_leave(trace_ctx_t prev)
+{
+    trace_ctx_g = prev;
+}
+
+static inline void trace_span_scope_cleanup(trace_span_t * nonnull span)
+{
+    trace_span_end(span, 0);
+}
+
+static inline void trace_span_leave_cleanup(trace_ctx_t * nonnull prev)
+{
+    trace_span_leave(*prev);
+}
+
+/** Run the end of the current scope in a span named \p name.
+ *
+ * The span is the one running in the thread until the end of the scope.
+ */
+#define trace_span_scope(name)                                               \
+    __attribute__((cleanup(trace_span_scope_cleanup)))                       \
+    trace_span_t PFX_LINE(trace_span) = ({                                   \
+        trace_span_t __span;                                                 \
+                                                                             \
+        trace_span_start(&__span, (name), NULL);                             \
+        __span;                                                              \
+    });                                                                      \
+    __attribute__((cleanup(trace_span_leave_cleanup)))                       \
+    trace_ctx_t PFX_LINE(trace_prev) = trace_span_enter(&PFX_LINE(trace_span))
+
+/** Set the probability to sample the root spans, between 0 (the default,
+ * only the traces started by the remote callers are recorded) and 1.
+ */
+void trace_set_sample_rate(double rate);
+
+/** Callback of the exporter.
+ *
+ * It is called in the background thread, with the records of at most
+ * TRACE_EXPORT_BATCH spans of any thread, in no particular order.
+ */
+typedef void (trace_export_f)(const trace_record_t * nonnull recs, int len,
+                              void * nullable priv);
+
+#define TRACE_EXPORT_BATCH   256
+
+/** Set the exporter of the spans.
+ *
+ * The first exporter starts the background thread, which reads the rings
+ * every TRACE_EXPORT_PERIOD milliseconds, or as soon as a ring is half full.
+ * Setting a NULL exporter exports the pending records and stops the thread;
+ * the spans are not recorded without exporter.
+ *
+ * \return -1 if the thread cannot be started.
+ */
+int trace_set_exporter(trace_export_f * nullable cb, void * nullable priv);
+
+#define TRACE_EXPORT_PERIOD  100
+
+/** Number of records of the ring of each thread. */
+#define TRACE_RING_SIZE      1024
+
+typedef struct trace_stats_t {
+    uint64_t exported;
+    uint64_t dropped;
+} trace_stats_t;
+
+void trace_get_stats(trace_stats_t * nonnull stats);
+
+/** Parse a W3C `traceparent` header.
+ *
+ * \return -1 if the header is invalid, the context is then cleared. A valid
+ *         header of a trace that is not sampled gives a cleared context.
+ */
+int trace_ctx_parse_traceparent(lstr_t s, trace_ctx_t * nonnull ctx);
+
+/** Write a context as a W3C `traceparent` header value. */
+void sb_add_traceparent(sb_t * nonnull sb, const trace_ctx_t * nonnull ctx);
+
+/** \} */
+#endif
@@ -159,27 +159,25 @@ int which(const char *nonnull cmd, char cmd_path[static PATH_MAX]);
 
 #if defined(__linux__)
 
+/* Layout of the entries returned by getdents64. */
 typedef struct linux_dirent_t {
-    long           d_ino;
-    off_t          d_off;
+    uint64_t       d_ino;
+    int64_t        d_off;
     unsigned short d_reclen;
+    unsigned char  d_type;
     char           d_name[];
 } linux_dirent_t;
 
-/* XXX: D_TYPE works only on ext2, ext3, ext4, btrfs (man getdents)
- *      using D_TYPE() inside of a list_dir block call back is safe,
- *      list_dir will set the type for you.
- */
-#define D_TYPE(ld)            *((byte *)ld + ld->d_reclen - 1)
-#define D_SET_TYPE(ld, type)  *((byte *)ld + ld->d_reclen - 1) = type
-
 #else
 typedef struct dirent linux_dirent_t;
+#endif
 
+/* XXX: d_type is only filled by some file systems (man getdents), others
+ *      give DT_UNKNOWN; using D_TYPE() inside of a list_dir block call back
+ *      is safe, list_dir will set the type for you.
+ */
 #define D_TYPE(ld)  ((ld)->d_type)
-#define D_SET_TYPE(ld, type) ((ld)->d_type = type)
-
-#endif
+#define D_SET_TYPE(ld, type) ((ld)->d_type = (type))
 
 #ifdef __has_blocks
 typedef int (BLOCK_CARET on_file_b)(const char * nonnull dir,
@@ -191,14 +189,27 @@ enum list_dir_flags_t {
 
     /** Follow symbolic links when inspecting files/directories. */
     LIST_DIR_FOLLOW_SYMLINK = 1 << 1,
+
+    /** Walk the subdirectories in parallel, using thr jobs.
+     *
+     * The processing function may then be called concurrently from
+     * several threads. The entry of a directory is still given to it after
+     * all the entries below that directory.
+     */
+    LIST_DIR_PARALLEL = 1 << 2,
 };
 
 /** List all the files of a directory and apply the specified treatment
  * on them.
  *
  * This function is designed to limit system calls even on directories with a
- * very large amount of files. The performance will mostly rely on the
- * treatment function given.
+ * very large amount of files: directories are read by large batches with
+ * getdents64, and files are only stat'ed when the file system does not give
+ * their type or when following symbolic links. The performance will mostly
+ * rely on the treatment function given.
+ *
+ * When recursing, the entries of a directory are given to the treatment
+ * function before the directory itself.
  *
  * @param dir Path to the directory to read.
  * @param flags 0 or a combination of \ref list_dir_flags_t flags.
@@ -294,6 +305,8 @@ void term_get_size(int * nonnull cols, int * nonnull rows);
 
 typedef enum {
     FD_FEAT_TCP_NODELAY = 1 << 0,
+    /* SO_REUSEPORT, it must be set before binding, see bindx() */
+    FD_FEAT_REUSEPORT   = 1 << 1,
 
     FD_FEAT_NONBLOCK = O_NONBLOCK,
     FD_FEAT_DIRECT   = O_DIRECT,
@@ -353,6 +366,95 @@ static inline int p_close(int * nonnull hdp) {
     return 0;
 }
 
+/* }}} */
+/* {{{ Hardware performance counters */
+
+/* The hardware events counted by a perf_counters_t. */
+typedef enum perf_counter_t {
+    PERF_COUNTER_CYCLES,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_CACHE_MISSES,
+    PERF_COUNTER_BRANCH_MISSES,
+    PERF_COUNTER__MAX,
+} perf_counter_t;
+
+/* "cycles", "instructions", "cache-misses" and "branch-misses". */
+extern const char * nonnull const perf_counter_names_g[PERF_COUNTER__MAX];
+
+/** Hardware performance counters of a thread, see perf_event_open(2).
+ *
+ * The counters count the events of the thread that opened them, in user
+ * space, from their opening on. They can be read from any thread of the
+ * process, and their counts are scaled when the kernel multiplexed them with
+ * other counters.
+ *
+ * The events that the CPU does not support (often the case in virtual
+ * machines) are counted as 0; the opening fails when the cycles cannot be
+ * counted, or when perf_event_paranoid forbids it.
+ *
+ *     perf_counters_t pc;
+ *
+ *     if (perf_counters_open(&pc) >= 0) {
+ *         {
+ *             perf_counters_scope(&pc);
+ *
+ *             ...
+ *         }
+ *         printf("%.2f IPC\n", perf_counters_ipc(pc.counts));
+ *         perf_counters_close(&pc);
+ *     }
+ */
+typedef struct perf_counters_t {
+    /* the first one is the leader of the group, -1 if not counted */
+    int      fds[PERF_COUNTER__MAX];
+    /* counts at the last perf_counters_start() */
+    uint64_t start[PERF_COUNTER__MAX];
+    /* counts accumulated between perf_counters_start() and
+     * perf_counters_stop() */
+    uint64_t counts[PERF_COUNTER__MAX];
+} perf_counters_t;
+
+/** Open the counters of the calling thread.
+ *
+ * \return -1 with errno set if the counters cannot be opened; \p pc can then
+ *         still be used, its counts stay 0.
+ */
+int perf_counters_open(perf_counters_t * nonnull pc);
+void perf_counters_close(perf_counters_t * nonnull pc);
+
+/** Read the counts since the opening of the counters. */
+int perf_counters_read(const perf_counters_t * nonnull pc,
+                       uint64_t counts[PERF_COUNTER__MAX]);
+
+perf_counters_t * nonnull perf_counters_start(perf_counters_t * nonnull pc);
+void perf_counters_stop(perf_counters_t * nonnull pc);
+
+static inline void perf_counters_reset(perf_counters_t * nonnull pc)
+{
+    p_clear(&pc->counts, 1);
+}
+
+/** Instructions per cycle. */
+static inline double perf_counters_ipc(const uint64_t counts[PERF_COUNTER__MAX])
+{
+    if (!counts[PERF_COUNTER_CYCLES]) {
+        return 0;
+    }
+    return (double)counts[PERF_COUNTER_INSTRUCTIONS]
+         / counts[PERF_COUNTER_CYCLES];
+}
+
+static inline void
+perf_counters_scope_cleanup(perf_counters_t * nonnull * nonnull pc)
+{
+    perf_counters_stop(*pc);
+}
+
+/** Accumulate in \p pc the events of the rest of the scope. */
+#define perf_counters_scope(pc)                                              \
+    __attribute__((unused,cleanup(perf_counters_scope_cleanup)))             \
+    perf_counters_t *PFX_LINE(perf_counters_scope_) = perf_counters_start(pc)
+
 /* }}} */
 /* {{{ Misc */
 
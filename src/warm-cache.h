@@ -0,0 +1,148 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_WARM_CACHE_H
+#define IS_LIB_COMMON_WARM_CACHE_H
+
+#include <lib-common/core.h>
+
+#if __has_feature(nullability)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic error "-Wnullability-completeness"
+#if __has_warning("-Wnullability-completeness-on-arrays")
+#pragma GCC diagnostic ignored "-Wnullability-completeness-on-arrays"
+#endif
+#endif
+
+/** \defgroup warm_cache Warm start cache.
+ * \brief Snapshots of the state derived at startup, reused by the next run.
+ *
+ * \{
+ *
+ * The modules that spend time at startup building state derived from their
+ * inputs (lookup tables built from the configuration, parsed files...) can
+ * save it in the warm cache, and restore it on the next start instead of
+ * computing it again.
+ *
+ * The cache is a single file, mapped in memory. Each entry has a name, the
+ * version of its format, chosen by its module, and a hash of the inputs it
+ * was derived from (see warm_cache_hash_file()): it is only restored if the
+ * three match, and if the cache was written by the very same binary (same
+ * ELF build id). The data of the entries is aligned on 64 bytes, so that
+ * the structures that can be used in place, like the tables written by
+ * qm_dump() and loaded by qm_attach(), need neither copy nor parsing.
+ *
+ *     static int dump_index(int fd, void *priv)
+ *     {
+ *         return qm_dump(index, priv, fd);
+ *     }
+ *
+ *     inputs = warm_cache_hash_file(0, cfg_path);
+ *     data = warm_cache_get("index", 1, inputs);
+ *     if (!data.s || qm_attach(index, &index_g, data.s, data.len) < 0) {
+ *         build_index(&index_g, cfg_path);
+ *         warm_cache_put_cb("index", 1, inputs, &dump_index, &index_g);
+ *     }
+ *
+ * The entries that are neither put again nor invalidated are kept as is
+ * when the cache is saved, so that a run that does not use all the modules
+ * does not lose the entries of the others.
+ */
+
+/** Open the warm cache stored in \p path.
+ *
+ * A missing or invalid file, or a file written by another binary, gives an
+ * empty cache, which will replace the file when saved.
+ *
+ * \return -1 if a cache is already opened.
+ */
+int warm_cache_open(const char * nonnull path);
+
+/** Get the data of an entry saved by a previous run.
+ *
+ * \param[in] name     the name of the entry.
+ * \param[in] version  the version of the format of the data.
+ * \param[in] inputs   the hash of the inputs the data is derived from.
+ *
+ * \return the data, valid until warm_cache_close(), LSTR_NULL if there is
+ *         no valid entry.
+ */
+lstr_t warm_cache_get(const char * nonnull name, uint32_t version,
+                      uint64_t inputs);
+
+/** Write the data of an entry, called by warm_cache_put_cb().
+ *
+ * \return 0 on success, -1 on error.
+ */
+typedef int (warm_cache_write_f)(int fd, void * nullable priv);
+
+/** Set the data of an entry, to be used by the next runs.
+ *
+ * The data is written in the new version of the cache, which replaces the
+ * current one when warm_cache_save() is called.
+ *
+ * \return 0 on success, -1 on error (the entry is then dropped).
+ */
+int warm_cache_put_cb(const char * nonnull name, uint32_t version,
+                      uint64_t inputs, warm_cache_write_f * nonnull cb,
+                      void * nullable priv);
+
+/** Set the data of an entry from a buffer.
+ *
+ * \see warm_cache_put_cb()
+ */
+int warm_cache_put(const char * nonnull name, uint32_t version,
+                   uint64_t inputs, lstr_t data);
+
+/** Save the cache, if any entry was put since it was opened.
+ *
+ * It is meant to be called once the startup is done. The file is replaced
+ * atomically, and the data of the current entries stays valid.
+ *
+ * \return 0 on success, -1 on error.
+ */
+int warm_cache_save(void);
+
+/** Close the cache, without saving it.
+ *
+ * The data returned by warm_cache_get() is unmapped, so everything that
+ * uses it in place must be wiped before.
+ */
+void warm_cache_close(void);
+
+/** Fold the content of a file into a hash of inputs.
+ *
+ * A file that cannot be read changes the hash as well.
+ */
+uint64_t warm_cache_hash_file(uint64_t inputs, const char * nonnull path);
+
+typedef struct warm_cache_stats_t {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t puts;
+} warm_cache_stats_t;
+
+void warm_cache_get_stats(warm_cache_stats_t * nonnull stats);
+
+/** \} */
+
+#if __has_feature(nullability)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
@@ -21,17 +21,47 @@
 
 #include <lib-common/container-qvector.h>
 
+typedef int (xmlpp_writecb_f)(void *priv, const void *buf, int len);
+
 typedef struct xmlpp_t {
     bool can_do_attr : 1;
     bool was_a_tag   : 1;
     bool nospace     : 1;
     sb_t  *buf;
     qv_t(lstr) stack;
+
+    /* optional output callback, see xmlpp_set_writecb() */
+    xmlpp_writecb_f *writecb;
+    void *priv;
+    int   write_res;
 } xmlpp_t;
 
 void xmlpp_open_banner(xmlpp_t *, sb_t *buf);
 void xmlpp_open(xmlpp_t *, sb_t *buf);
-void xmlpp_close(xmlpp_t *);
+
+/** Stream the generated XML to a callback.
+ *
+ * The buffer given to xmlpp_open() is then only a working buffer, that is
+ * flushed to \p writecb (like iop_sb_write) whenever it grows over a few
+ * kilobytes, so that the memory used does not depend on the size of the
+ * document. The first negative value returned by \p writecb is kept in
+ * write_res and nothing more is written after it.
+ */
+void xmlpp_set_writecb(xmlpp_t *, xmlpp_writecb_f *writecb, void *priv);
+
+/** Write the whole working buffer to the callback.
+ *
+ * This must be called before writing to the callback directly (without
+ * the xmlpp), which also means that no attribute can be added to the
+ * current tag anymore.
+ */
+void xmlpp_flush(xmlpp_t *);
+
+/** Close the remaining tags, and flush the working buffer.
+ *
+ * \return write_res, which is 0 if no callback is used.
+ */
+int xmlpp_close(xmlpp_t *);
 
 void xmlpp_opentag(xmlpp_t *, const char *tag);
 void xmlpp_closetag(xmlpp_t *);
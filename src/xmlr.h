@@ -20,9 +20,82 @@
 #define IS_LIB_INET_XMLR_H
 
 #include <lib-common/core.h>
-#include <libxml/xmlreader.h>
 
-typedef xmlTextReaderPtr xml_reader_t;
+/** Attribute of the current element.
+ *
+ * The name and the value point into the parsed document; the value is raw,
+ * the references are decoded by the xmlr_getattr_* functions.
+ */
+typedef struct xmlr_attr_t {
+    lstr_t name;
+    lstr_t value;
+} xmlr_attr_t;
+qvector_t(xmlr_attr, xmlr_attr_t);
+
+/* Element being parsed, and the number of namespace bindings before it. */
+typedef struct xmlr_frame_t {
+    lstr_t name;
+    int    nb_ns;
+    bool   has_children;
+} xmlr_frame_t;
+qvector_t(xmlr_frame, xmlr_frame_t);
+
+/* Namespace binding, as offsets in ns_buf. */
+typedef struct xmlr_ns_t {
+    int prefix_off;
+    int prefix_len;
+    int uri_off;
+    int uri_len;
+} xmlr_ns_t;
+qvector_t(xmlr_ns, xmlr_ns_t);
+
+typedef enum xmlr_node_type_t {
+    XMLR_NODE_NONE,
+    XMLR_NODE_ELEMENT,
+    XMLR_NODE_END_ELEMENT,
+    XMLR_NODE_TEXT,
+} xmlr_node_type_t;
+
+/** XML pull parser.
+ *
+ * The document is parsed in place: it is not copied, and must stay valid
+ * until the reader is closed. Only the values that are read are copied,
+ * their references decoded when there are some.
+ *
+ * This is not a validating parser: the structure of the document is
+ * checked, but the DTD are skipped, and the references are only checked in
+ * the values that are read.
+ */
+typedef struct xmlr_t {
+    const char *start;
+    const char *end;
+    const char *pos;
+    bool        has_root;
+    bool        failed;
+
+    /* Current node. */
+    xmlr_node_type_t type;
+    const char *node_start;
+    bool        is_empty;
+    lstr_t      local_name;
+    lstr_t      prefix;
+    qv_t(xmlr_attr) attrs;
+
+    /* Text of the current text node, that may contain markup (comments,
+     * CDATA sections, ...) or references if it is not plain. */
+    lstr_t      text;
+    bool        text_plain;
+
+    qv_t(xmlr_frame) frames;
+    qv_t(xmlr_ns)    ns;
+    sb_t        ns_buf;
+
+    /* Decoded names and values. */
+    sb_t        name_buf;
+    sb_t        value_buf;
+} xmlr_t;
+
+typedef xmlr_t *xml_reader_t;
 
 extern __thread xml_reader_t xmlr_g;
 
@@ -39,17 +112,12 @@ enum xmlr_error {
  *
  * This function wants to position itself (pre-load) the root node of the
  * document.
+ *
+ * The buffer is not copied, and must stay valid until xmlr_close().
  */
 int xmlr_setup(xml_reader_t *xrp, const void *buf, int len);
 void xmlr_close(xml_reader_t *xrp);
-
-static inline void xmlr_delete(xml_reader_t *xrp)
-{
-    if (*xrp) {
-        xmlFreeTextReader(*xrp);
-        *xrp = NULL;
-    }
-}
+void xmlr_delete(xml_reader_t *xrp);
 
 __cold
 int  xmlr_fail(xml_reader_t xr, const char *fmt, ...) __attr_printf__(2, 3);
@@ -84,12 +152,18 @@ int xmlr_next_uncle(xml_reader_t xr);
 
 static inline int xmlr_node_is_empty(xml_reader_t xr)
 {
-    return RETHROW(xmlTextReaderIsEmptyElement(xr));
+    if (unlikely(xr->failed)) {
+        return XMLR_ERROR;
+    }
+    return xr->type == XMLR_NODE_ELEMENT && xr->is_empty;
 }
 
 static inline int xmlr_node_is_closing(xml_reader_t xr)
 {
-    return RETHROW(xmlTextReaderNodeType(xr)) == XML_READER_TYPE_END_ELEMENT;
+    if (unlikely(xr->failed)) {
+        return XMLR_ERROR;
+    }
+    return xr->type == XMLR_NODE_END_ELEMENT;
 }
 
 int xmlr_node_get_local_name(xml_reader_t xr, lstr_t *out);
@@ -247,12 +321,11 @@ int mp_xmlr_get_inner_xml(mem_pool_t *mp, xml_reader_t xr, lstr_t *out);
 /* attributes stuff */
 
 #define xmlr_for_each_attr(attr, xr) \
-    for (xmlAttrPtr attr = xmlTextReaderCurrentNode(xr)->properties; \
-         attr; attr = attr->next)
+    tab_for_each_ptr(attr, &(xr)->attrs)
 
-xmlAttrPtr
+const xmlr_attr_t *
 xmlr_find_attr(xml_reader_t xr, const char *name, size_t len, bool needed);
-static ALWAYS_INLINE xmlAttrPtr
+static ALWAYS_INLINE const xmlr_attr_t *
 xmlr_find_attr_s(xml_reader_t xr, const char *name, bool needed)
 {
     return xmlr_find_attr(xr, name, strlen(name), needed);
@@ -260,7 +333,7 @@ xmlr_find_attr_s(xml_reader_t xr, const char *name, bool needed)
 
 /* \brief Get the current node attribute value.
  */
-int t_xmlr_getattr_str(xml_reader_t xr, xmlAttrPtr attr,
+int t_xmlr_getattr_str(xml_reader_t xr, const xmlr_attr_t *attr,
                        bool nullok, lstr_t *out);
 
 /** Get the current node attribute integer value between minv and maxv.
@@ -268,7 +341,7 @@ int t_xmlr_getattr_str(xml_reader_t xr, xmlAttrPtr attr,
  * This function accepts decimal values depending on the base parameter (see
  * man strtol).
  */
-int xmlr_getattr_int_range_base(xml_reader_t xr, xmlAttrPtr attr,
+int xmlr_getattr_int_range_base(xml_reader_t xr, const xmlr_attr_t *attr,
                                 int minv, int maxv, int base, int *ip);
 
 /** Get the current node attribute signed integer value.
@@ -276,7 +349,7 @@ int xmlr_getattr_int_range_base(xml_reader_t xr, xmlAttrPtr attr,
  * This function accepts decimal values depending on the base parameter (see
  * man strtol).
  */
-int xmlr_getattr_i64_base(xml_reader_t xr, xmlAttrPtr attr, int base,
+int xmlr_getattr_i64_base(xml_reader_t xr, const xmlr_attr_t *attr, int base,
                           int64_t *i64p);
 
 /** Get the current node attribute unsigned integer value.
@@ -284,7 +357,7 @@ int xmlr_getattr_i64_base(xml_reader_t xr, xmlAttrPtr attr, int base,
  * This function accepts decimal values depending on the base parameter (see
  * man strtol).
  */
-int xmlr_getattr_u64_base(xml_reader_t xr, xmlAttrPtr attr, int base,
+int xmlr_getattr_u64_base(xml_reader_t xr, const xmlr_attr_t *attr, int base,
                           uint64_t *u64p);
 
 /** Get the current node attribute integer value between minv and maxv.
@@ -292,8 +365,8 @@ int xmlr_getattr_u64_base(xml_reader_t xr, xmlAttrPtr attr, int base,
  * This function accepts decimal values only.
  */
 static inline int
-xmlr_getattr_int_range(xml_reader_t xr, xmlAttrPtr attr, int minv, int maxv,
-                       int *ip)
+xmlr_getattr_int_range(xml_reader_t xr, const xmlr_attr_t *attr,
+                       int minv, int maxv, int *ip)
 {
     return xmlr_getattr_int_range_base(xr, attr, minv, maxv, 10, ip);
 }
@@ -303,7 +376,7 @@ xmlr_getattr_int_range(xml_reader_t xr, xmlAttrPtr attr, int minv, int maxv,
  * This function accepts decimal values only.
  */
 static inline int
-xmlr_getattr_i64(xml_reader_t xr, xmlAttrPtr attr, int64_t *i64p)
+xmlr_getattr_i64(xml_reader_t xr, const xmlr_attr_t *attr, int64_t *i64p)
 {
     return xmlr_getattr_i64_base(xr, attr, 10, i64p);
 }
@@ -313,7 +386,7 @@ xmlr_getattr_i64(xml_reader_t xr, xmlAttrPtr attr, int64_t *i64p)
  * This function accepts decimal values only.
  */
 static inline int
-xmlr_getattr_u64(xml_reader_t xr, xmlAttrPtr attr, uint64_t *u64p)
+xmlr_getattr_u64(xml_reader_t xr, const xmlr_attr_t *attr, uint64_t *u64p)
 {
     return xmlr_getattr_u64_base(xr, attr, 10, u64p);
 }
@@ -322,10 +395,10 @@ xmlr_getattr_u64(xml_reader_t xr, xmlAttrPtr attr, uint64_t *u64p)
  *
  * This function accepts the following values: 0, 1, true, false.
  */
-int xmlr_getattr_bool(xml_reader_t xr, xmlAttrPtr attr, bool *bp);
+int xmlr_getattr_bool(xml_reader_t xr, const xmlr_attr_t *attr, bool *bp);
 
 
 /** Get the current node attribute double value. */
-int xmlr_getattr_dbl(xml_reader_t xr, xmlAttrPtr attr, double *dp);
+int xmlr_getattr_dbl(xml_reader_t xr, const xmlr_attr_t *attr, double *dp);
 
 #endif
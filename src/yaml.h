@@ -263,6 +263,72 @@ void
 t_yaml_data_get_presentation(const yaml_data_t * nonnull data,
                              yaml__document_presentation__t * nonnull pres);
 
+/* }}} */
+/* {{{ Streaming parsing */
+
+/** Type of the events of the streaming parser.
+ *
+ * A data is either a SCALAR event, or a container that starts with a
+ * SEQ_START or OBJ_START event, and ends with the matching SEQ_END or
+ * OBJ_END event. In between, a sequence has its elements, and an object
+ * has a KEY event followed by a data for each of its fields.
+ */
+typedef enum yaml_event_type_t {
+    YAML_EVENT_SCALAR,
+    YAML_EVENT_SEQ_START,
+    YAML_EVENT_SEQ_END,
+    YAML_EVENT_OBJ_START,
+    YAML_EVENT_KEY,
+    YAML_EVENT_OBJ_END,
+    /* End of the document, returned after the root data. */
+    YAML_EVENT_DOC_END,
+} yaml_event_type_t;
+
+typedef struct yaml_event_t {
+    yaml_event_type_t type;
+
+    /* Span of the scalar or of the key, or position of the start or end of
+     * the container. */
+    yaml_span_t span;
+
+    union {
+        /* SCALAR events. */
+        yaml_scalar_t scalar;
+        /* KEY events. */
+        lstr_t key;
+    };
+
+    /* Tag of the SCALAR, SEQ_START and OBJ_START events, LSTR_NULL_V if
+     * the data has no tag. */
+    lstr_t tag;
+    yaml_span_t tag_span;
+} yaml_event_t;
+
+/** Get the next event of a YAML stream.
+ *
+ * This is an alternative to t_yaml_parse for large documents: the document
+ * is read one event at a time, without building its AST, so that it can
+ * be consumed (for example unpacked into an IOP, see
+ * t_iop_yunpack_stream_ps) with a memory usage that does not depend on its
+ * size.
+ *
+ * The streaming parser only handles plain YAML: the includes, variables
+ * and merge keys are rejected, and no presentation data can be generated
+ * (YAML_PARSE_GEN_PRES_DATA must not be used).
+ *
+ * `yaml_parse_attach_ps` or `yaml_parse_attach_file` must have been called
+ * first. The strings of the event point either to the parsed document, or
+ * to buffers of \p self that are only valid until the next call.
+ *
+ * \param[in]   self   A YAML parsing object.
+ * \param[out]  event  The next event of the document.
+ * \param[out]  err    Error buffer filled in case of error. The parsing
+ *                     cannot go on after an error.
+ * \return -1 on error, 0 otherwise.
+ */
+int yaml_parse_next_event(yaml_parse_t * nonnull self,
+                          yaml_event_t * nonnull event, sb_t * nonnull err);
+
 /* }}} */
 /* {{{ Packing */
 
@@ -401,6 +467,66 @@ int
 t_yaml_pack_file(yaml_pack_env_t * nonnull env, const char * nonnull filename,
                  const yaml_data_t * nonnull data, sb_t * nonnull err);
 
+/* {{{ Streaming packing */
+
+/* The document can also be written one node at a time, without building
+ * its yaml_data_t, which is what the IOP packer does (see t_iop_sb_ypack).
+ * The output is the same as the one of t_yaml_pack on the equivalent data.
+ *
+ * A sequence is written with t_yaml_pack_stream_seq_start, then
+ * t_yaml_pack_stream_seq_elem followed by the element for each of its
+ * elements, and t_yaml_pack_stream_seq_end. An object likewise, with
+ * t_yaml_pack_stream_key before the value of each key.
+ *
+ * The presentation set with t_yaml_pack_env_set_presentation is applied. The
+ * lookups are only done in the parts of the document that have presentation
+ * data, so that packing a large document with a small presentation is not
+ * slower than without presentation.
+ *
+ * The functions return the number of bytes written, or -1 if a write
+ * failed, the error being then returned by yaml_pack_stream_end.
+ */
+
+/** Whether the document can be packed with the streaming functions.
+ *
+ * This is not the case when the presentation contains includes, templates,
+ * merge keys or flow mode, which need the whole data: t_yaml_pack must be
+ * used then.
+ */
+bool yaml_pack_env_can_stream(const yaml_pack_env_t * nonnull env);
+
+/** Start the streaming packing of a document.
+ *
+ * \p writecb and \p priv are the same as for t_yaml_pack.
+ */
+void t_yaml_pack_stream_start(yaml_pack_env_t * nonnull env,
+                              yaml_pack_writecb_f * nonnull writecb,
+                              void * nullable priv);
+
+/** Write a scalar, with the tag \p tag if it is not LSTR_NULL_V. */
+int t_yaml_pack_stream_scalar(yaml_pack_env_t * nonnull env,
+                              const yaml_scalar_t * nonnull scalar,
+                              lstr_t tag);
+
+int t_yaml_pack_stream_seq_start(yaml_pack_env_t * nonnull env,
+                                 const lstr_t tag);
+int t_yaml_pack_stream_seq_elem(yaml_pack_env_t * nonnull env);
+int t_yaml_pack_stream_seq_end(yaml_pack_env_t * nonnull env);
+
+int t_yaml_pack_stream_obj_start(yaml_pack_env_t * nonnull env,
+                                 const lstr_t tag);
+int t_yaml_pack_stream_key(yaml_pack_env_t * nonnull env, const lstr_t key);
+int t_yaml_pack_stream_obj_end(yaml_pack_env_t * nonnull env);
+
+/** End the streaming packing of a document.
+ *
+ * \param[out] err  Filled with the error of the write that failed, if any.
+ * \return -1 if one of the writes failed, 0 otherwise.
+ */
+int yaml_pack_stream_end(yaml_pack_env_t * nonnull env, sb_t * nullable err);
+
+/* }}} */
+
 /* }}} */
 /* {{{ Packing helpers */
 
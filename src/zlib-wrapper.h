@@ -51,6 +51,29 @@ ssize_t sb_add_compressed(sb_t * nonnull out, const void * nonnull data,
 #define ob_add_compressed(ob, data, dlen, level, do_gzip)  \
     OB_WRAP(sb_add_compressed, ob, data, dlen, level, do_gzip)
 
+/** Default size of the blocks of sb_add_compressed_mt(). */
+#define ZLIB_MT_BLOCK_SIZE  (128 << 10)
+
+/** Add compressed data in the string buffer, using the thr jobs.
+ *
+ * Same as sb_add_compressed(), but the input is cut in blocks of
+ * \p block_size bytes (ZLIB_MT_BLOCK_SIZE if 0) that are deflated in
+ * parallel, the way pigz does: each block is primed with the last 32KB of
+ * the previous one, so the compression ratio is almost the same as the
+ * one of sb_add_compressed(), and the outputs are put together in a single
+ * standard gzip or deflate stream.
+ *
+ * The input is compressed with sb_add_compressed() when it fits in a
+ * single block or when the thr module is not loaded.
+ */
+ssize_t sb_add_compressed_mt(sb_t * nonnull out, const void * nonnull data,
+                             size_t dlen, int level, bool do_gzip,
+                             size_t block_size);
+
+#define ob_add_compressed_mt(ob, data, dlen, level, do_gzip, block_size)  \
+    OB_WRAP(sb_add_compressed_mt, ob, data, dlen, level, do_gzip,         \
+            block_size)
+
 #if __has_feature(nullability)
 #pragma GCC diagnostic pop
 #endif
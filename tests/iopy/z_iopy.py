@@ -222,6 +222,14 @@ class IopyTest(z.TestCase):
         exp = b'\x01\x05plop\x00\x02\x05plip\x00\x03\x05plup\x00'
         self.assertEqual(exp, b.to_bin())
 
+    def test_from_bin_buffer(self):
+        b = self.p.test.StructB(a='plop', b='plip', tab=['plup'])
+        data = b.to_bin()
+        self.assertEqual(b, self.p.test.StructB(_bin=bytearray(data)))
+        self.assertEqual(b, self.p.test.StructB(_bin=memoryview(data)))
+        self.assertEqual(b, self.p.test.StructB(
+            _hex=bytearray(b.to_hex(), 'ascii')))
+
     def test_to_hex(self):
         b = self.p.test.StructB(a='plop', b='plip', tab=['plup'])
         exp = '0105706c6f70000205706c6970000305706c757000'
@@ -17,6 +17,7 @@
 /***************************************************************************/
 
 #include <lib-common/asn1/per-priv.h>
+#include <lib-common/datetime.h>
 #include <lib-common/z.h>
 #include <lib-common/iop.h>
 #include <lib-common/bit-buf.h>
@@ -1293,6 +1294,100 @@ Z_GROUP_EXPORT(asn1_aper) {
         }
     } Z_TEST_END;
     /* }}} */
+    /* {{{ partial_decoding */
+    Z_TEST(partial_decoding, "aligned per: partial decoding") {
+        t_scope;
+        lstr_t one_ext = LSTR_IMMED("\xE4\x01\x16\x05\x00\x05\x04toto");
+        lstr_t more_ext = LSTR_IMMED("\xE4\x01\x16\x04\xC0\x03\x40\x27"
+                                     "\x10\x02\x00\x2A");
+        lstr_t choice = LSTR_IMMED("\x80\x05\x04\x74\x65\x73\x74");
+        tstiop__asn1_ext_choice__t choice_out;
+        sequence1_t out;
+        pstream_t ps;
+
+        /* The decoding stops after the root field. */
+        ps = ps_initlstr(&more_ext);
+        Z_ASSERT_EQ(t_aper_decode_partial(&ps, sequence1, LSTR("root2"),
+                                          false, &out), 1);
+        Z_ASSERT(OPT_ISSET(out.root1));
+        Z_ASSERT_EQ(OPT_VAL(out.root1), 10);
+        Z_ASSERT_EQ(out.root2, -20);
+        Z_ASSERT(!OPT_ISSET(out.ext2));
+        Z_ASSERT(!OPT_ISSET(out.ext3));
+
+        /* The extensions preceding the path are skipped. */
+        ps = ps_initlstr(&more_ext);
+        Z_ASSERT_EQ(t_aper_decode_partial(&ps, sequence1, LSTR("ext3"),
+                                          false, &out), 1);
+        Z_ASSERT(!OPT_ISSET(out.ext2));
+        Z_ASSERT(OPT_ISSET(out.ext3));
+        Z_ASSERT_EQ(OPT_VAL(out.ext3), 42);
+
+        ps = ps_initlstr(&one_ext);
+        Z_ASSERT_ZERO(t_aper_decode_partial(&ps, sequence1, LSTR("ext2"),
+                                            false, &out));
+        Z_ASSERT_NULL(out.ext1.s);
+        Z_ASSERT_ZERO(t_aper_decode_partial(&ps, sequence1, LSTR("foo"),
+                                            false, &out));
+
+        /* Choices. */
+        ps = ps_initlstr(&choice);
+        Z_ASSERT_EQ(t_aper_decode_partial(&ps, tstiop__asn1_ext_choice_,
+                                          LSTR("ext_s"), false,
+                                          &choice_out), 1);
+        Z_ASSERT_LSTREQUAL(choice_out.ext_s, LSTR("test"));
+        Z_ASSERT_ZERO(t_aper_decode_partial(&ps, tstiop__asn1_ext_choice_,
+                                            LSTR("i"), false, &choice_out));
+        Z_ASSERT_EQ(choice_out.iop_tag,
+                    IOP_UNION_TAG(tstiop__asn1_ext_choice, ext_s));
+
+        /* Truncated input. */
+        ps = ps_initlstr(&more_ext);
+        ps_shrink(&ps, 3);
+        Z_ASSERT_NEG(t_aper_decode_partial(&ps, sequence1, LSTR("ext3"),
+                                           false, &out));
+    } Z_TEST_END;
+    /* }}} */
+    /* {{{ decode_bench */
+    Z_TEST(decode_bench, "aligned per: decoding benchmark") {
+        lstr_t seqs[] = {
+            LSTR_IMMED("\x64\x01\x16"),
+            LSTR_IMMED("\xE4\x01\x16\x05\x00\x05\x04toto"),
+            LSTR_IMMED("\xE4\x01\x16\x04\xC0\x03\x40\x27\x10\x02"
+                       "\x00\x2A"),
+        };
+        lstr_t choices[] = {
+            LSTR_IMMED("\x00\x00\x96"),
+            LSTR_IMMED("\x80\x05\x04\x74\x65\x73\x74"),
+            LSTR_IMMED("\x81\x02\x00\x01"),
+        };
+        proctimer_t pt;
+        long long us;
+
+        proctimer_start(&pt);
+        for (int n = 0; n < 100000; n++) {
+            t_scope;
+
+            carray_for_each_ptr(seq, seqs) {
+                pstream_t ps = ps_initlstr(seq);
+                sequence1_t out;
+
+                Z_ASSERT_N(t_aper_decode(&ps, sequence1, false, &out));
+            }
+            carray_for_each_ptr(choice, choices) {
+                pstream_t ps = ps_initlstr(choice);
+                tstiop__asn1_ext_choice__t out;
+
+                Z_ASSERT_N(t_aper_decode(&ps, tstiop__asn1_ext_choice_,
+                                         false, &out));
+            }
+        }
+        us = proctimer_stop(&pt);
+
+        e_named_trace(1, "aper_bench", "decoding of %d PDUs: %lldus",
+                      100000 * (countof(seqs) + countof(choices)), us);
+    } Z_TEST_END;
+    /* }}} */
     /* {{{ ints_overflows */
     Z_TEST(ints_overflows, "integers overflows") {
         ints_seq_base_t base_min = {
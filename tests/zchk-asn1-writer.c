@@ -548,6 +548,54 @@ Z_GROUP_EXPORT(asn1_ber)
         Z_ASSERT_EQUAL(buf, len, expected, sizeof(expected));
     } Z_TEST_END;
 
+    Z_TEST(enc_ob, "asn1: BER encoding in an outbuf") {
+        t_scope;
+        test_1_t t = t1;
+        qv_t(i32) stack;
+        outbuf_t ob;
+        outbuf_chunk_t *obc;
+        uint8_t *flat;
+        int len;
+        int flat_len;
+        int big_len = 2 * OUTBUF_CHUNK_MIN_SIZE;
+        char *big = t_new_raw(char, big_len);
+
+        memset(big, 'x', big_len);
+        t.opt = LSTR_DATA_V(big, big_len);
+
+        qv_init(&stack);
+        flat_len = asn1_pack_size(test_1, &t, &stack);
+        Z_ASSERT_N(flat_len);
+        flat = t_new_raw(uint8_t, flat_len);
+        asn1_pack(test_1, flat, &t, &stack);
+
+        /* The big string is referenced, not copied. */
+        ob_init(&ob);
+        len = asn1_pack_ob(test_1, &ob, &t, &stack);
+        Z_ASSERT_EQ(len, flat_len);
+        Z_ASSERT_EQ(ob.length, flat_len);
+        Z_ASSERT_EQ(ob.sb.len, flat_len - big_len);
+        obc = htlist_first_entry(&ob.chunks_list, outbuf_chunk_t,
+                                 chunks_link);
+        Z_ASSERT(obc->u.p == big);
+        Z_ASSERT_EQ(obc->length, big_len);
+        Z_ASSERT_EQUAL(ob.sb.data, obc->sb_leading,
+                       flat, obc->sb_leading);
+        Z_ASSERT_EQUAL(ob.sb.data + obc->sb_leading, ob.sb_trailing,
+                       flat + obc->sb_leading + big_len, ob.sb_trailing);
+        ob_wipe(&ob);
+
+        /* Small values are fully written in the buffer. */
+        ob_init(&ob);
+        len = asn1_pack_ob(test_1, &ob, &t1, &stack);
+        Z_ASSERT_EQ(len, 12);
+        Z_ASSERT(htlist_is_empty(&ob.chunks_list));
+        Z_ASSERT_EQUAL(ob.sb.data, ob.sb.len, flat + flat_len - len, len);
+        Z_ASSERT_EQ(ob.length, len);
+        ob_wipe(&ob);
+        qv_wipe(&stack);
+    } Z_TEST_END;
+
     Z_TEST(indef_len_skip_trailing_fields, "asn1: BER decoder - "
            "skip trailing filed in case of indefinite length")
     {
@@ -0,0 +1,316 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+/* LCOV_EXCL_START */
+
+#include <lib-common/z.h>
+#include <lib-common/compress.h>
+#include <lib-common/thr.h>
+#include <lib-common/zlib-wrapper.h>
+
+/* Fill a buffer with compressible data: random words from a small set. */
+static void z_compress_fill(sb_t *sb, int len)
+{
+    static const char *words[] = {
+        "lorem", "ipsum", "dolor", "sit", "amet", "consectetur",
+        "adipiscing", "elit", "sed", "do", "eiusmod", "tempor",
+    };
+
+    while (sb->len < len) {
+        sb_adds(sb, words[rand_range(0, countof(words) - 1)]);
+        sb_addc(sb, ' ');
+    }
+    sb_clip(sb, len);
+}
+
+static compress_algo_t z_compress_algos[] = {
+    COMPRESS_ZSTD,
+    COMPRESS_LZ4,
+};
+
+Z_GROUP_EXPORT(compress) {
+    Z_TEST(oneshot, "one-shot compression and decompression") {
+        SB_1k(data);
+        SB_1k(zdata);
+        SB_1k(out);
+
+        carray_for_each_entry(algo, z_compress_algos) {
+            int sizes[] = { 0, 1, 100, 4096, 100000, 3 << 20 };
+
+            carray_for_each_entry(size, sizes) {
+                ssize_t zlen;
+
+                sb_reset(&data);
+                z_compress_fill(&data, size);
+                sb_reset(&zdata);
+                sb_reset(&out);
+
+                zlen = sb_add_compress(&zdata, algo, COMPRESS_LEVEL_DEFAULT,
+                                       NULL, data.data, data.len);
+                Z_ASSERT_N(zlen, "algo %d, size %d", algo, size);
+                Z_ASSERT_EQ(zlen, zdata.len);
+                if (size >= 4096) {
+                    Z_ASSERT_LT(zdata.len, data.len / 2);
+                }
+                Z_ASSERT_EQ(sb_add_decompress(&out, algo, NULL, zdata.data,
+                                              zdata.len), data.len);
+                Z_ASSERT_EQUAL(out.data, out.len, data.data, data.len,
+                               "algo %d, size %d", algo, size);
+            }
+
+            /* Concatenated frames. */
+            sb_reset(&zdata);
+            sb_reset(&out);
+            Z_ASSERT_N(sb_add_compress(&zdata, algo, 1, NULL, "foo", 3));
+            Z_ASSERT_N(sb_add_compress(&zdata, algo, 5, NULL, "bar", 3));
+            Z_ASSERT_EQ(sb_add_decompress(&out, algo, NULL, zdata.data,
+                                          zdata.len), 6);
+            Z_ASSERT_STREQUAL(out.data, "foobar");
+
+            /* Truncated and corrupted data. */
+            sb_reset(&zdata);
+            Z_ASSERT_N(sb_add_compress(&zdata, algo, COMPRESS_LEVEL_DEFAULT,
+                                       NULL, data.data, data.len));
+            sb_setf(&out, "prefix");
+            Z_ASSERT_NEG(sb_add_decompress(&out, algo, NULL, zdata.data,
+                                           zdata.len - 1));
+            Z_ASSERT_STREQUAL(out.data, "prefix");
+            zdata.data[0] ^= 0xff;
+            Z_ASSERT_NEG(sb_add_decompress(&out, algo, NULL, zdata.data,
+                                           zdata.len));
+            Z_ASSERT_STREQUAL(out.data, "prefix");
+        }
+
+        sb_wipe(&data);
+        sb_wipe(&zdata);
+        sb_wipe(&out);
+    } Z_TEST_END;
+
+    Z_TEST(stream, "streaming compression and decompression") {
+        SB_1k(data);
+        SB_1k(zdata);
+        SB_1k(out);
+
+        z_compress_fill(&data, 1 << 20);
+
+        carray_for_each_entry(algo, z_compress_algos) {
+            compress_stream_t *cs;
+            decompress_stream_t *ds;
+            pstream_t ps;
+            int flushed;
+            int pos = 0;
+
+            sb_reset(&zdata);
+            sb_reset(&out);
+
+            /* Two frames, the first one being flushed in the middle. */
+            cs = compress_stream_new(algo, COMPRESS_LEVEL_DEFAULT, NULL);
+            while (pos < data.len / 2) {
+                int len = MIN(rand_range(1, 10000), data.len / 2 - pos);
+
+                Z_ASSERT_N(compress_stream_add(cs, &zdata, data.data + pos,
+                                               len));
+                pos += len;
+            }
+            Z_ASSERT_N(compress_stream_flush(cs, &zdata));
+            flushed = zdata.len;
+            Z_ASSERT_N(compress_stream_add(cs, &zdata, data.data + pos,
+                                           data.len - pos));
+            Z_ASSERT_N(compress_stream_end(cs, &zdata));
+            Z_ASSERT_N(compress_stream_add(cs, &zdata, "foo", 3));
+            Z_ASSERT_N(compress_stream_end(cs, &zdata));
+            compress_stream_delete(&cs);
+            Z_ASSERT_NULL(cs);
+
+            /* Everything added before the flush can be decompressed. */
+            ds = decompress_stream_new(algo, NULL);
+            ps = ps_init(zdata.data, flushed);
+            Z_ASSERT_ZERO(decompress_stream_add(ds, &out, &ps));
+            Z_ASSERT(ps_done(&ps));
+            Z_ASSERT_EQUAL(out.data, out.len, data.data, pos);
+
+            /* Then feed the rest byte by byte at first. */
+            ps = ps_init(zdata.data + flushed, zdata.len - flushed);
+            for (int i = 0; i < 100; i++) {
+                pstream_t chunk = __ps_get_ps(&ps, 1);
+
+                Z_ASSERT_ZERO(decompress_stream_add(ds, &out, &chunk));
+                Z_ASSERT(ps_done(&chunk));
+            }
+            Z_ASSERT_EQ(decompress_stream_add(ds, &out, &ps), 1);
+            Z_ASSERT_EQUAL(out.data, out.len, data.data, data.len);
+
+            /* The second frame. */
+            sb_reset(&out);
+            Z_ASSERT(!ps_done(&ps));
+            Z_ASSERT_EQ(decompress_stream_add(ds, &out, &ps), 1);
+            Z_ASSERT(ps_done(&ps));
+            Z_ASSERT_STREQUAL(out.data, "foo");
+
+            /* Invalid data. */
+            ps = ps_initstr("this is not compressed data");
+            Z_ASSERT_NEG(decompress_stream_add(ds, &out, &ps));
+            decompress_stream_delete(&ds);
+            Z_ASSERT_NULL(ds);
+        }
+
+        sb_wipe(&data);
+        sb_wipe(&zdata);
+        sb_wipe(&out);
+    } Z_TEST_END;
+
+    Z_TEST(dict, "zstd dictionaries") {
+        t_scope;
+        qv_t(lstr) samples;
+        compress_dict_t *dict;
+        compress_stream_t *cs;
+        decompress_stream_t *ds;
+        pstream_t ps;
+        lstr_t msg;
+        SB_1k(buf);
+        SB_1k(zdata);
+        SB_1k(out);
+        int len_nodict;
+
+        /* Small similar messages. */
+        t_qv_init(&samples, 2000);
+        for (int i = 0; i < 2000; i++) {
+            qv_append(&samples, t_lstr_fmt(
+                "{ \"login\": \"user%d\", \"id\": %d, \"active\": %s, "
+                "\"groups\": [ \"group%d\", \"admin\" ], \"quota\": %d }",
+                (int)rand_range(0, 100000), i,
+                rand_range(0, 1) ? "true" : "false",
+                (int)rand_range(0, 10), (int)rand_range(0, 1 << 20)));
+        }
+        Z_ASSERT_N(compress_dict_train(&buf, samples.tab, samples.len,
+                                       4096));
+        Z_ASSERT_LE(buf.len, 4096);
+        dict = compress_dict_new(LSTR_SB_V(&buf), COMPRESS_LEVEL_DEFAULT);
+        Z_ASSERT_P(dict);
+        Z_ASSERT(compress_dict_id(dict));
+
+        msg = t_lstr_fmt("{ \"login\": \"user%d\", \"id\": %d, "
+                         "\"active\": true, \"groups\": [ \"group1\", "
+                         "\"admin\" ], \"quota\": 1234 }", 42, 3000);
+        Z_ASSERT_N(sb_add_compress(&zdata, COMPRESS_ZSTD,
+                                   COMPRESS_LEVEL_DEFAULT, NULL,
+                                   msg.s, msg.len));
+        len_nodict = zdata.len;
+        sb_reset(&zdata);
+        Z_ASSERT_N(sb_add_compress(&zdata, COMPRESS_ZSTD,
+                                   COMPRESS_LEVEL_DEFAULT, dict,
+                                   msg.s, msg.len));
+        Z_ASSERT_LT(zdata.len, len_nodict / 2);
+
+        Z_ASSERT_NEG(sb_add_decompress(&out, COMPRESS_ZSTD, NULL,
+                                       zdata.data, zdata.len));
+        Z_ASSERT_EQ(sb_add_decompress(&out, COMPRESS_ZSTD, dict,
+                                      zdata.data, zdata.len), msg.len);
+        Z_ASSERT_LSTREQUAL(LSTR_SB_V(&out), msg);
+
+        /* Dictionaries are not supported by LZ4. */
+        Z_ASSERT_NEG(sb_add_compress(&zdata, COMPRESS_LZ4,
+                                     COMPRESS_LEVEL_DEFAULT, dict,
+                                     msg.s, msg.len));
+
+        /* Streaming. */
+        sb_reset(&zdata);
+        sb_reset(&out);
+        cs = compress_stream_new(COMPRESS_ZSTD, COMPRESS_LEVEL_DEFAULT, dict);
+        ds = decompress_stream_new(COMPRESS_ZSTD, dict);
+        for (int i = 0; i < 2; i++) {
+            Z_ASSERT_N(compress_stream_add(cs, &zdata, msg.s, msg.len));
+            Z_ASSERT_N(compress_stream_end(cs, &zdata));
+        }
+        ps = ps_init(zdata.data, zdata.len);
+        Z_ASSERT_EQ(decompress_stream_add(ds, &out, &ps), 1);
+        Z_ASSERT_EQ(decompress_stream_add(ds, &out, &ps), 1);
+        Z_ASSERT(ps_done(&ps));
+        Z_ASSERT_EQ(out.len, 2 * msg.len);
+        compress_stream_delete(&cs);
+        decompress_stream_delete(&ds);
+
+        compress_dict_delete(&dict);
+        Z_ASSERT_NULL(dict);
+        sb_wipe(&buf);
+        sb_wipe(&zdata);
+        sb_wipe(&out);
+    } Z_TEST_END;
+
+    Z_TEST(zlib_mt, "parallel gzip and deflate compression") {
+        SB_1k(data);
+        SB_1k(zdata);
+        SB_1k(ref);
+        SB_1k(out);
+
+        MODULE_REQUIRE(thr);
+        z_compress_fill(&data, 3 << 20);
+        /* Make the end less compressible than the rest. */
+        for (int i = data.len - 100000; i < data.len; i += 7) {
+            data.data[i] = rand();
+        }
+
+        for (int gz = 0; gz < 2; gz++) {
+            int levels[] = { Z_DEFAULT_COMPRESSION, 0, 1, 9 };
+
+            carray_for_each_entry(level, levels) {
+                z_stream stream;
+
+                sb_reset(&zdata);
+                sb_reset(&ref);
+                sb_reset(&out);
+                Z_ASSERT_EQ(sb_add_compressed_mt(&zdata, data.data,
+                                                 data.len, level, gz, 0),
+                            zdata.len);
+                Z_ASSERT_N(sb_add_compressed(&ref, data.data, data.len,
+                                             level, gz));
+                Z_ASSERT_LE(zdata.len, ref.len + ref.len / 100 + 100,
+                            "gz %d, level %d", gz, level);
+
+                p_clear(&stream, 1);
+                stream.next_in  = (Bytef *)zdata.data;
+                stream.avail_in = zdata.len;
+                Z_ASSERT_EQ(inflateInit2(&stream,
+                                         MAX_WBITS + (gz ? 16 : 0)), Z_OK);
+                stream.next_out  = (Bytef *)sb_grow(&out, data.len + 1);
+                stream.avail_out = data.len + 1;
+                Z_ASSERT_EQ(inflate(&stream, Z_FINISH), Z_STREAM_END,
+                            "gz %d, level %d", gz, level);
+                Z_ASSERT_ZERO(stream.avail_in);
+                __sb_fixlen(&out, stream.total_out);
+                IGNORE(inflateEnd(&stream));
+                Z_ASSERT_EQUAL(out.data, out.len, data.data, data.len,
+                               "gz %d, level %d", gz, level);
+            }
+        }
+
+        /* Invalid level. */
+        sb_setf(&zdata, "prefix");
+        Z_ASSERT_NEG(sb_add_compressed_mt(&zdata, data.data, data.len, 42,
+                                          true, 0));
+        Z_ASSERT_STREQUAL(zdata.data, "prefix");
+
+        MODULE_RELEASE(thr);
+        sb_wipe(&data);
+        sb_wipe(&zdata);
+        sb_wipe(&ref);
+        sb_wipe(&out);
+    } Z_TEST_END;
+} Z_GROUP_END;
+
+/* LCOV_EXCL_STOP */
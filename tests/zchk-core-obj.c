@@ -120,6 +120,29 @@ OBJ_EXT_VTABLE_WITH_PRIO(my_child_object, OBJ_EXT_VTABLE_DEF_PRIO + 1)
     my_child_object.get_extended_a = my_child_object_get_extended_a_2;
 OBJ_EXT_VTABLE_END()
 
+OBJ_CLASS(my_pooled_object, my_base_object,
+          MY_BASE_OBJECT_FIELDS, MY_BASE_OBJECT_METHODS)
+
+static int my_pooled_object_get_a(my_pooled_object_t *self)
+{
+    return 2 * self->a;
+}
+
+OBJ_VTABLE(my_pooled_object)
+    my_pooled_object.type_mp = obj_class_pool(my_pooled_object, 2);
+    my_pooled_object.get_a = my_pooled_object_get_a;
+OBJ_VTABLE_END()
+
+#define MY_POOLED_CHILD_FIELDS(pfx)                                          \
+    MY_BASE_OBJECT_FIELDS(pfx);                                              \
+    int more[16]
+
+OBJ_CLASS(my_pooled_child, my_pooled_object,
+          MY_POOLED_CHILD_FIELDS, MY_BASE_OBJECT_METHODS)
+
+OBJ_VTABLE(my_pooled_child)
+OBJ_VTABLE_END()
+
 static lstr_t t_get_obj_desc_indirect(my_base_object_t *obj)
 {
     return obj_vcall(obj, t_get_desc);
@@ -189,6 +212,77 @@ Z_GROUP_EXPORT(core_obj)
         obj_delete(&child_obj);
     } Z_TEST_END;
 
+    Z_TEST(class_pool, "test the free-list pools of the classes") {
+        mem_pool_t *mp = obj_class_mp(my_pooled_object_class());
+        my_pooled_object_t *objs[3];
+        my_pooled_child_t *child;
+        obj_pool_stats_t start;
+        obj_pool_stats_t stats;
+        void *deleted;
+
+        Z_ASSERT(obj_class_mp(my_pooled_child_class()) == mp,
+                 "the pool is inherited");
+        obj_pool_get_stats(mp, &start);
+        Z_ASSERT_EQ(start.nb_free, 0u);
+
+        for (int i = 0; i < countof(objs); i++) {
+            objs[i] = obj_new(my_pooled_object);
+            Z_ASSERT_EQ(objs[i]->a, 42);
+            objs[i]->a = i;
+        }
+        for (int i = 0; i < countof(objs); i++) {
+            obj_delete(&objs[i]);
+        }
+        obj_pool_get_stats(mp, &stats);
+        Z_ASSERT_EQ(stats.nb_free, 2u, "the free list is bounded");
+        Z_ASSERT_EQ(stats.misses - start.misses, 3u);
+
+        /* the last instance put in the free list is reused first, zeroed and
+         * initialized again */
+        objs[0] = obj_new(my_pooled_object);
+        deleted = objs[0];
+        Z_ASSERT_EQ(objs[0]->a, 42);
+        Z_ASSERT_EQ(objs[0]->refcnt, 1);
+        obj_delete(&objs[0]);
+        objs[0] = obj_new(my_pooled_object);
+        Z_ASSERT(objs[0] == deleted);
+        obj_pool_get_stats(mp, &stats);
+        Z_ASSERT_EQ(stats.hits - start.hits, 2u);
+        Z_ASSERT_EQ(stats.nb_free, 1u);
+
+        /* the bigger instances of the sub-classes bypass the free list */
+        child = obj_new(my_pooled_child);
+        Z_ASSERT_EQ(child->a, 42);
+        child->more[15] = 1;
+        obj_delete(&child);
+        obj_pool_get_stats(mp, &stats);
+        Z_ASSERT_EQ(stats.nb_free, 1u);
+        Z_ASSERT_EQ(stats.hits - start.hits, 2u);
+
+        obj_delete(&objs[0]);
+    } Z_TEST_END;
+
+    Z_TEST(vcall_cached, "test the cached virtual method calls") {
+        obj_vmethod_cache_t(my_base_object, get_a) cache = { };
+        my_base_object_t *objs[4];
+        int sum = 0;
+
+        objs[0] = obj_new(my_base_object);
+        objs[1] = obj_new(my_base_object);
+        objs[2] = obj_vcast(my_base_object, obj_new(my_pooled_object));
+        objs[3] = obj_new(my_base_object);
+
+        for (int i = 0; i < countof(objs); i++) {
+            sum += obj_vcall_cached(&cache, objs[i], get_a);
+        }
+        Z_ASSERT_EQ(sum, 5 * 42, "the method follows the class");
+        Z_ASSERT(cache.cls == my_base_object_class());
+
+        for (int i = 0; i < countof(objs); i++) {
+            obj_delete(&objs[i]);
+        }
+    } Z_TEST_END;
+
     Z_TEST(refcounting, "test refcounting") {
         my_base_object_t *obj;
         my_base_object_t *tmp;
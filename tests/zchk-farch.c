@@ -18,8 +18,60 @@
 
 #include <lib-common/z.h>
 #include <lib-common/farch.h>
+#include <lib-common/qlzo.h>
 #include "zchk-farch.fc.c"
 
+/* Build an entry compressed by blocks of block_size bytes, as farchc does
+ * with --block-size. */
+static farch_entry_t t_z_farch_build_blocks(lstr_t contents, int block_size)
+{
+    byte lzo_buf[LZO_BUF_MEM_SIZE];
+    int nb_blocks = DIV_ROUND_UP(contents.len, block_size);
+    int *offsets = t_new_raw(int, nb_blocks + 1);
+    lstr_t *chunks;
+    int nb_chunks;
+    t_SB_1k(cdata);
+
+    for (int i = 0; i < nb_blocks; i++) {
+        pstream_t block = ps_init(contents.s + i * block_size,
+                                  MIN(block_size,
+                                      contents.len - i * block_size));
+        int clen = lzo_cbuf_size(ps_len(&block));
+        char *cbuf = sb_grow(&cdata, clen);
+
+        offsets[i] = cdata.len;
+        clen = qlzo1x_compress(cbuf, clen, block, lzo_buf);
+        if (clen < (int)ps_len(&block)) {
+            sb_growlen(&cdata, clen);
+        } else {
+            sb_add(&cdata, block.s, ps_len(&block));
+        }
+    }
+    offsets[nb_blocks] = cdata.len;
+
+    nb_chunks = DIV_ROUND_UP(cdata.len, FARCH_MAX_SYMBOL_SIZE);
+    chunks = t_new(lstr_t, nb_chunks);
+    for (int i = 0; i < nb_chunks; i++) {
+        int len = MIN(FARCH_MAX_SYMBOL_SIZE,
+                      cdata.len - i * FARCH_MAX_SYMBOL_SIZE);
+        lstr_t chunk = LSTR_INIT_V(t_new_raw(char, len), len);
+
+        lstr_obfuscate(LSTR_INIT_V(cdata.data + i * FARCH_MAX_SYMBOL_SIZE,
+                                   len), len, chunk);
+        chunks[i] = chunk;
+    }
+
+    return (farch_entry_t){
+        .name = LSTR_NULL,
+        .chunks = chunks,
+        .compressed_size = cdata.len,
+        .size = contents.len,
+        .nb_chunks = nb_chunks,
+        .block_size = block_size,
+        .block_offsets = offsets,
+    };
+}
+
 Z_GROUP_EXPORT(farch)
 {
     static const char *farch_filenames[] = {
@@ -66,5 +118,60 @@ Z_GROUP_EXPORT(farch)
         }
     } Z_TEST_END;
 
+    Z_TEST(farch_range, "partial reads of farch entries") {
+        t_scope;
+        const char *path;
+        lstr_t contents;
+        farch_entry_t entries[2];
+
+        path = t_fmt("%*pM/%s", LSTR_FMT_ARG(z_cmddir_g), farch_filenames[2]);
+        Z_ASSERT_ZERO(lstr_init_from_file(&contents, path, PROT_READ,
+                                          MAP_SHARED));
+
+        /* The same file, compressed by farchc as a whole or by blocks. */
+        entries[0] = farch_test[2];
+        entries[1] = t_z_farch_build_blocks(contents, 256);
+
+        carray_for_each_ptr(entry, entries) {
+            Z_ASSERT_LSTREQUAL(t_farch_unarchive(entry), contents);
+
+            for (int off = 0; off < contents.len; off += 97) {
+                for (int len = 0; len < 600; len += 131) {
+                    lstr_t exp = LSTR_INIT_V(contents.s + off,
+                                             MIN(len, contents.len - off));
+
+                    Z_ASSERT_LSTREQUAL(t_farch_unarchive_range(entry, off,
+                                                               len),
+                                       exp, "off %d, len %d", off, len);
+                }
+            }
+            Z_ASSERT_LSTREQUAL(t_farch_unarchive_range(entry, contents.len,
+                                                       10),
+                               LSTR_EMPTY_V);
+            Z_ASSERT_NULL(t_farch_unarchive_range(entry, contents.len + 1,
+                                                  10).s);
+        }
+
+        lstr_wipe(&contents);
+    } Z_TEST_END;
+
+    Z_TEST(farch_acquire, "refcounted farch entries") {
+        const farch_entry_t *entry = &farch_test[1];
+        lstr_t c1;
+        lstr_t c2;
+
+        c1 = farch_unarchive_acquire(entry);
+        c2 = farch_unarchive_acquire(entry);
+        Z_ASSERT(c1.s == c2.s);
+        Z_ASSERT_LSTREQUAL(c1, t_farch_get_data(entry, NULL));
+
+        /* Shared with the persisted content. */
+        Z_ASSERT(farch_unarchive_persist(entry).s == c1.s);
+
+        farch_unarchive_release(entry);
+        farch_unarchive_release(entry);
+        Z_ASSERT(farch_unarchive_persist(entry).s == c1.s);
+    } Z_TEST_END;
+
     MODULE_RELEASE(farch);
 } Z_GROUP_END
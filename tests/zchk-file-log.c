@@ -20,6 +20,7 @@
 
 #include <lib-common/el.h>
 #include <lib-common/file-log.h>
+#include <lib-common/zlib-wrapper.h>
 #include <lib-common/z.h>
 
 struct {
@@ -55,6 +56,35 @@ static int z_check_file_permission(const char *prefix, uint32_t mode)
     Z_HELPER_END;
 }
 
+/* Uncompress a file made of several gzip members. */
+static int z_gunzip_members(lstr_t data, sb_t *out, int *members)
+{
+    z_stream zs;
+
+    p_clear(&zs, 1);
+    Z_ASSERT_EQ(inflateInit2(&zs, MAX_WBITS + 16), Z_OK);
+    zs.next_in  = (Bytef *)data.s;
+    zs.avail_in = data.len;
+    *members = 0;
+    while (zs.avail_in) {
+        int res;
+
+        zs.next_out  = (Bytef *)sb_grow(out, 64 << 10);
+        zs.avail_out = sb_avail(out);
+        res = inflate(&zs, Z_NO_FLUSH);
+        __sb_fixlen(out, (char *)zs.next_out - out->data);
+        if (res == Z_STREAM_END) {
+            (*members)++;
+            Z_ASSERT_EQ(inflateReset(&zs), Z_OK);
+        } else {
+            Z_ASSERT_EQ(res, Z_OK);
+        }
+    }
+    inflateEnd(&zs);
+
+    Z_HELPER_END;
+}
+
 Z_GROUP_EXPORT(file_log)
 {
 #define RANDOM_DATA_SIZE  (2 << 20)
@@ -164,4 +194,40 @@ Z_GROUP_EXPORT(file_log)
 
         Z_HELPER_RUN(z_check_file_permission(path.s, 0640u));
     } Z_TEST_END;
+
+    Z_TEST(file_log_compress_stream, "streaming compression") {
+        t_scope;
+        lstr_t path = t_lstr_fmt("%*pMtmp_log_gz", LSTR_FMT_ARG(z_tmpdir_g));
+        log_file_t *log_file;
+        glob_t globbuf;
+        lstr_t data;
+        SB_1k(exp);
+        SB_1k(out);
+        int members;
+
+        log_file = log_file_new(path.s, LOG_FILE_COMPRESS_STREAM);
+        Z_ASSERT_N(log_file_open(log_file, false));
+
+        for (int i = 0; i < 100000; i++) {
+            Z_ASSERT_N(log_fprintf(log_file, "line %d of the log\n", i));
+            sb_addf(&exp, "line %d of the log\n", i);
+        }
+        Z_ASSERT_EQ(log_file_tell(log_file), exp.len);
+
+        Z_ASSERT_N(log_fwrite(log_file, "last\n", 5));
+        sb_adds(&exp, "last\n");
+        Z_ASSERT_N(log_file_close(&log_file));
+
+        Z_ASSERT_EQ(glob(t_fmt("%s_????????_??????.log.gz", path.s), 0,
+                         NULL, &globbuf), 0);
+        Z_ASSERT_EQ(globbuf.gl_pathc, 1u);
+        Z_ASSERT_N(lstr_init_from_file(&data, globbuf.gl_pathv[0],
+                                       PROT_READ, MAP_SHARED));
+        globfree(&globbuf);
+
+        Z_HELPER_RUN(z_gunzip_members(data, &out, &members));
+        lstr_wipe(&data);
+        Z_ASSERT_GE(members, 2);
+        Z_ASSERT_LSTREQUAL(LSTR_SB_V(&out), LSTR_SB_V(&exp));
+    } Z_TEST_END;
 } Z_GROUP_END
@@ -65,6 +65,139 @@ Z_GROUP_EXPORT(hash32) {
     } Z_TEST_END;
 } Z_GROUP_END;
 
+/* }}} */
+/* {{{ hash64 */
+
+Z_GROUP_EXPORT(hash64) {
+    Z_TEST(wyhash64, "wyhash64") {
+        lstr_t s = LSTR("Est-ce que vous voulez etre ma femme ? "
+                        "Et apres on boira un cafe.");
+
+        Z_ASSERT_EQ(mem_hash64(s.s, -1), mem_hash64(s.s, s.len));
+        Z_ASSERT_EQ(mem_hash64(s.s, s.len), wyhash64(s.s, s.len, 0));
+        Z_ASSERT_NE(wyhash64(s.s, s.len, 0), wyhash64(s.s, s.len, 1));
+
+        /* All the lengths must give different hashes. */
+        for (int i = 1; i <= s.len; i++) {
+            Z_ASSERT_NE(wyhash64(s.s, i - 1, 0), wyhash64(s.s, i, 0),
+                        "len %d", i);
+        }
+    } Z_TEST_END;
+
+    Z_TEST(wyhash64_update, "wyhash64 streaming API") {
+        t_scope;
+        const int size = 1024;
+        byte *buf = t_new_raw(byte, size);
+
+        for (int i = 0; i < size; i++) {
+            buf[i] = rand();
+        }
+
+        for (int i = 0; i < 1000; i++) {
+            int len = rand_range(0, size);
+            uint64_t seed = rand();
+            wyhash64_ctx ctx;
+
+            wyhash64_starts(&ctx, seed);
+            for (int pos = 0; pos < len;) {
+                int n = MIN(rand_range(0, i % 2 ? 10 : 100), len - pos);
+
+                wyhash64_update(&ctx, buf + pos, n);
+                pos += n;
+            }
+            Z_ASSERT_EQ(wyhash64_finish(&ctx), wyhash64(buf, len, seed),
+                        "len %d", len);
+        }
+    } Z_TEST_END;
+} Z_GROUP_END;
+
+/* }}} */
+/* {{{ crc */
+
+/* Bitwise reference implementation of reflected CRCs. */
+static uint64_t z_crc_ref(uint64_t poly, int width, uint64_t crc,
+                          const byte *data, size_t len)
+{
+    uint64_t mask = width == 64 ? UINT64_MAX : (1ULL << width) - 1;
+
+    crc = ~crc & mask;
+    while (len--) {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? poly : 0);
+        }
+    }
+    return ~crc & mask;
+}
+
+Z_GROUP_EXPORT(crc) {
+    Z_TEST(check, "standard check values") {
+        lstr_t s = LSTR("123456789");
+
+        Z_ASSERT_EQ(icrc32(0, s.s, s.len), 0xcbf43926u);
+        Z_ASSERT_EQ(icrc32c(0, s.s, s.len), 0xe3069283u);
+        Z_ASSERT_EQ(icrc64(0, s.s, s.len), 0x995dc9bbdf1939faull);
+    } Z_TEST_END;
+
+    Z_TEST(large, "large and unaligned buffers") {
+        t_scope;
+        const int size = 64 << 10;
+        byte *buf = t_new_raw(byte, size);
+
+        for (int i = 0; i < size; i++) {
+            buf[i] = rand();
+        }
+
+        for (int i = 0; i < 200; i++) {
+            int off = rand_range(0, 63);
+            int len = rand_range(0, size - off);
+            uint32_t crc = rand();
+
+            Z_ASSERT_EQ(icrc32(crc, buf + off, len),
+                        z_crc_ref(0xedb88320, 32, crc, buf + off, len),
+                        "off %d, len %d", off, len);
+            Z_ASSERT_EQ(icrc32c(crc, buf + off, len),
+                        z_crc_ref(0x82f63b78, 32, crc, buf + off, len),
+                        "off %d, len %d", off, len);
+            Z_ASSERT_EQ(icrc64(crc, buf + off, len),
+                        z_crc_ref(0xc96c5795d7870f42, 64, crc, buf + off,
+                                  len),
+                        "off %d, len %d", off, len);
+        }
+
+        /* Chaining. */
+        Z_ASSERT_EQ(icrc32(icrc32(0, buf, 1000), buf + 1000, size - 1000),
+                    icrc32(0, buf, size));
+        Z_ASSERT_EQ(icrc32c(icrc32c(0, buf, 1000), buf + 1000, size - 1000),
+                    icrc32c(0, buf, size));
+        Z_ASSERT_EQ(icrc64(icrc64(0, buf, 1000), buf + 1000, size - 1000),
+                    icrc64(0, buf, size));
+    } Z_TEST_END;
+
+    Z_TEST(combine, "combination of the CRCs of consecutive buffers") {
+        t_scope;
+        const int size = 64 << 10;
+        byte *buf = t_new_raw(byte, size);
+
+        for (int i = 0; i < size; i++) {
+            buf[i] = rand();
+        }
+
+        for (int i = 0; i < 200; i++) {
+            int cut = rand_range(0, size);
+
+            Z_ASSERT_EQ(icrc32_combine(icrc32(0, buf, cut),
+                                       icrc32(0, buf + cut, size - cut),
+                                       size - cut),
+                        icrc32(0, buf, size), "cut %d", cut);
+            Z_ASSERT_EQ(icrc32c_combine(icrc32c(0, buf, cut),
+                                        icrc32c(0, buf + cut, size - cut),
+                                        size - cut),
+                        icrc32c(0, buf, size), "cut %d", cut);
+        }
+    } Z_TEST_END;
+} Z_GROUP_END;
+
 /* }}} */
 /* {{{ sha2 */
 
@@ -293,6 +426,54 @@ Z_GROUP_EXPORT(sha2)
         }
     } Z_TEST_END;
 
+    Z_TEST(multi, "multi-buffer hashing") {
+        static const int lens[] = {
+            0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 200, 1000, 4097,
+        };
+        const void *inputs[3 * countof(lens)];
+        ssize_t ilens[3 * countof(lens)];
+        byte outputs[3 * countof(lens)][32];
+        byte buf[5000];
+        byte key[100];
+
+        for (int i = 0; i < countof(buf); i++) {
+            buf[i] = i * 7 + (i >> 8);
+        }
+        for (int i = 0; i < countof(key); i++) {
+            key[i] = i;
+        }
+        /* More messages than lanes, of various lengths and alignments, so
+         * that lanes are reused while others are still running. */
+        for (int i = 0; i < countof(inputs); i++) {
+            inputs[i] = buf + i % 7;
+            ilens[i] = lens[i % countof(lens)];
+        }
+
+        for (int is224 = 0; is224 < 2; is224++) {
+            int len = is224 ? 28 : 32;
+
+            sha2_multi(inputs, ilens, countof(inputs), outputs, is224);
+            for (int i = 0; i < countof(inputs); i++) {
+                byte sum[32];
+
+                sha2(inputs[i], ilens[i], sum, is224);
+                Z_ASSERT_EQUAL(outputs[i], len, sum, len, "message %d", i);
+            }
+
+            for (int keylen = 0; keylen <= 100; keylen += 50) {
+                sha2_hmac_multi(key, keylen, inputs, ilens,
+                                countof(inputs), outputs, is224);
+                for (int i = 0; i < countof(inputs); i++) {
+                    byte sum[32];
+
+                    sha2_hmac(key, keylen, inputs[i], ilens[i], sum, is224);
+                    Z_ASSERT_EQUAL(outputs[i], len, sum, len,
+                                   "message %d, key length %d", i, keylen);
+                }
+            }
+        }
+    } Z_TEST_END;
+
     Z_TEST(crypt, "") {
 
         /* Those are extracted from Ulrich Drepper's
@@ -762,6 +943,98 @@ static const byte aes_test_cfb_enc[3][16] =
       0x41, 0x78, 0x91, 0xD5, 0x98, 0x78, 0xE1, 0xFA }
 };
 
+/*
+ * AES-CTR test vectors from NIST SP 800-38A (F.5.1)
+ */
+static const byte aes_test_ctr_key[16] =
+{
+    0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+    0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C,
+};
+
+static const byte aes_test_ctr_nonce_counter[16] =
+{
+    0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7,
+    0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF,
+};
+
+static const byte aes_test_ctr_pt[64] =
+{
+    0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96,
+    0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
+    0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C,
+    0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51,
+    0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11,
+    0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+    0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17,
+    0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10,
+};
+
+static const byte aes_test_ctr_ct[64] =
+{
+    0x87, 0x4D, 0x61, 0x91, 0xB6, 0x20, 0xE3, 0x26,
+    0x1B, 0xEF, 0x68, 0x64, 0x99, 0x0D, 0xB6, 0xCE,
+    0x98, 0x06, 0xF6, 0x6B, 0x79, 0x70, 0xFD, 0xFF,
+    0x86, 0x17, 0x18, 0x7B, 0xB9, 0xFF, 0xFD, 0xFF,
+    0x5A, 0xE4, 0xDF, 0x3E, 0xDB, 0xD5, 0xD3, 0x5E,
+    0x5B, 0x4F, 0x09, 0x02, 0x0D, 0xB0, 0x3E, 0xAB,
+    0x1E, 0x03, 0x1D, 0xDA, 0x2F, 0xBE, 0x03, 0xD1,
+    0x79, 0x21, 0x70, 0xA0, 0xF3, 0x00, 0x9C, 0xEE,
+};
+
+/*
+ * AES-GCM test vectors from "The Galois/Counter Mode of Operation" (test
+ * case 4)
+ */
+static const byte aes_test_gcm_key[16] =
+{
+    0xFE, 0xFF, 0xE9, 0x92, 0x86, 0x65, 0x73, 0x1C,
+    0x6D, 0x6A, 0x8F, 0x94, 0x67, 0x30, 0x83, 0x08,
+};
+
+static const byte aes_test_gcm_iv[12] =
+{
+    0xCA, 0xFE, 0xBA, 0xBE, 0xFA, 0xCE, 0xDB, 0xAD,
+    0xDE, 0xCA, 0xF8, 0x88,
+};
+
+static const byte aes_test_gcm_add[20] =
+{
+    0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF,
+    0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF,
+    0xAB, 0xAD, 0xDA, 0xD2,
+};
+
+static const byte aes_test_gcm_pt[60] =
+{
+    0xD9, 0x31, 0x32, 0x25, 0xF8, 0x84, 0x06, 0xE5,
+    0xA5, 0x59, 0x09, 0xC5, 0xAF, 0xF5, 0x26, 0x9A,
+    0x86, 0xA7, 0xA9, 0x53, 0x15, 0x34, 0xF7, 0xDA,
+    0x2E, 0x4C, 0x30, 0x3D, 0x8A, 0x31, 0x8A, 0x72,
+    0x1C, 0x3C, 0x0C, 0x95, 0x95, 0x68, 0x09, 0x53,
+    0x2F, 0xCF, 0x0E, 0x24, 0x49, 0xA6, 0xB5, 0x25,
+    0xB1, 0x6A, 0xED, 0xF5, 0xAA, 0x0D, 0xE6, 0x57,
+    0xBA, 0x63, 0x7B, 0x39,
+};
+
+static const byte aes_test_gcm_ct[60] =
+{
+    0x42, 0x83, 0x1E, 0xC2, 0x21, 0x77, 0x74, 0x24,
+    0x4B, 0x72, 0x21, 0xB7, 0x84, 0xD0, 0xD4, 0x9C,
+    0xE3, 0xAA, 0x21, 0x2F, 0x2C, 0x02, 0xA4, 0xE0,
+    0x35, 0xC1, 0x7E, 0x23, 0x29, 0xAC, 0xA1, 0x2E,
+    0x21, 0xD5, 0x14, 0xB2, 0x54, 0x66, 0x93, 0x1C,
+    0x7D, 0x8F, 0x6A, 0x5A, 0xAC, 0x84, 0xAA, 0x05,
+    0x1B, 0xA3, 0x0B, 0x39, 0x6A, 0x0A, 0xAC, 0x97,
+    0x3D, 0x58, 0xE0, 0x91,
+};
+
+static const byte aes_test_gcm_tag[16] =
+{
+    0x5B, 0xC9, 0x4F, 0xBC, 0x32, 0x21, 0xA5, 0xDB,
+    0x94, 0xFA, 0xE9, 0x5A, 0xE7, 0x12, 0x1A, 0x47,
+};
+
 Z_GROUP_EXPORT(aes)
 {
     Z_TEST(ECB, "ECB mode") {
@@ -869,6 +1142,131 @@ Z_GROUP_EXPORT(aes)
             }
         }
     } Z_TEST_END;
+
+    Z_TEST(CTR, "CTR mode") {
+        byte nonce_counter[16];
+        byte stream_block[16];
+        byte buf[64];
+        aes_ctx ctx;
+
+        aes_setkey_enc(&ctx, aes_test_ctr_key, 128);
+
+        /* Whatever the way the input is split, the output is the same. */
+        for (int cut = 0; cut <= 64; cut += 7) {
+            int offset = 0;
+
+            memcpy(nonce_counter, aes_test_ctr_nonce_counter, 16);
+            aes_crypt_ctr(&ctx, cut, &offset, nonce_counter, stream_block,
+                          aes_test_ctr_pt, buf);
+            aes_crypt_ctr(&ctx, 64 - cut, &offset, nonce_counter,
+                          stream_block, aes_test_ctr_pt + cut, buf + cut);
+            Z_ASSERT_EQUAL(buf, 64, aes_test_ctr_ct, 64, "cut %d", cut);
+            Z_ASSERT_ZERO(offset);
+        }
+    } Z_TEST_END;
+
+    Z_TEST(CTR_large, "CTR mode on large buffers") {
+        byte nonce_counter[16];
+        byte stream_block[16];
+        byte buf[1000];
+        byte enc[1000];
+        byte ref[1000];
+        byte key[32];
+        aes_ctx ctx;
+        int offset = 0;
+
+        for (int i = 0; i < countof(key); i++) {
+            key[i] = 3 * i;
+        }
+        for (int i = 0; i < countof(buf); i++) {
+            buf[i] = i;
+        }
+        aes_setkey_enc(&ctx, key, 256);
+
+        /* Compare with a block by block encryption, the counter wraps
+         * around its lowest 64 bits. */
+        memset(nonce_counter, 0, 8);
+        memset(nonce_counter + 8, 0xff, 8);
+        for (int i = 0; i < countof(buf); i += 16) {
+            aes_crypt_ecb(&ctx, AES_ENCRYPT, nonce_counter, stream_block);
+            for (int j = i; j < MIN(i + 16, countof(buf)); j++) {
+                ref[j] = buf[j] ^ stream_block[j - i];
+            }
+            for (int j = 16; j-- > 0 && ++nonce_counter[j] == 0; ) {
+            }
+        }
+
+        memset(nonce_counter, 0, 8);
+        memset(nonce_counter + 8, 0xff, 8);
+        aes_crypt_ctr(&ctx, countof(buf), &offset, nonce_counter,
+                      stream_block, buf, enc);
+        Z_ASSERT_EQUAL(enc, countof(enc), ref, countof(ref));
+    } Z_TEST_END;
+
+    Z_TEST(GCM, "GCM mode") {
+        byte buf[60];
+        byte tag[16];
+        aes_gcm_ctx ctx;
+
+        aes_gcm_setkey(&ctx, aes_test_gcm_key, 128);
+
+        aes_gcm_crypt_and_tag(&ctx, AES_ENCRYPT, 60, aes_test_gcm_iv, 12,
+                              aes_test_gcm_add, 20, aes_test_gcm_pt, buf,
+                              16, tag);
+        Z_ASSERT_EQUAL(buf, 60, aes_test_gcm_ct, 60);
+        Z_ASSERT_EQUAL(tag, 16, aes_test_gcm_tag, 16);
+
+        /* Streaming API, with chunks that are not multiples of blocks. */
+        for (int cut = 0; cut <= 60; cut += 7) {
+            aes_gcm_starts(&ctx, AES_ENCRYPT, aes_test_gcm_iv, 12,
+                           aes_test_gcm_add, 20);
+            aes_gcm_update(&ctx, cut, aes_test_gcm_pt, buf);
+            aes_gcm_update(&ctx, 60 - cut, aes_test_gcm_pt + cut, buf + cut);
+            aes_gcm_finish(&ctx, tag, 16);
+            Z_ASSERT_EQUAL(buf, 60, aes_test_gcm_ct, 60, "cut %d", cut);
+            Z_ASSERT_EQUAL(tag, 16, aes_test_gcm_tag, 16, "cut %d", cut);
+        }
+
+        Z_ASSERT_N(aes_gcm_auth_decrypt(&ctx, 60, aes_test_gcm_iv, 12,
+                                        aes_test_gcm_add, 20,
+                                        aes_test_gcm_tag, 16,
+                                        aes_test_gcm_ct, buf));
+        Z_ASSERT_EQUAL(buf, 60, aes_test_gcm_pt, 60);
+
+        /* A modified ciphertext is rejected. */
+        memcpy(buf, aes_test_gcm_ct, 60);
+        buf[10] ^= 1;
+        Z_ASSERT_NEG(aes_gcm_auth_decrypt(&ctx, 60, aes_test_gcm_iv, 12,
+                                          aes_test_gcm_add, 20,
+                                          aes_test_gcm_tag, 16, buf, buf));
+    } Z_TEST_END;
+
+    Z_TEST(GCM_large, "GCM mode on large buffers") {
+        byte buf[1000];
+        byte enc[1000];
+        byte dec[1000];
+        byte tag[16];
+        aes_gcm_ctx ctx;
+
+        for (int i = 0; i < countof(buf); i++) {
+            buf[i] = i;
+        }
+        aes_gcm_setkey(&ctx, aes_test_gcm_key, 128);
+
+        /* Encrypt in one call, and decrypt byte by byte to go through both
+         * the bulk and the per-block code paths. */
+        aes_gcm_crypt_and_tag(&ctx, AES_ENCRYPT, countof(buf),
+                              aes_test_gcm_iv, 12, NULL, 0, buf, enc,
+                              16, tag);
+        aes_gcm_starts(&ctx, AES_DECRYPT, aes_test_gcm_iv, 12, NULL, 0);
+        for (int i = 0; i < countof(enc); i++) {
+            aes_gcm_update(&ctx, 1, enc + i, dec + i);
+        }
+        Z_ASSERT_EQUAL(dec, countof(dec), buf, countof(buf));
+        Z_ASSERT_N(aes_gcm_auth_decrypt(&ctx, countof(enc), aes_test_gcm_iv,
+                                        12, NULL, 0, tag, 16, enc, dec));
+        Z_ASSERT_EQUAL(dec, countof(dec), buf, countof(buf));
+    } Z_TEST_END;
 } Z_GROUP_END
 
 /* }}} */
@@ -16,6 +16,7 @@
 /*                                                                         */
 /***************************************************************************/
 
+#include <lib-common/datetime.h>
 #include <lib-common/net/hpack-priv.h>
 #include <lib-common/z.h>
 
@@ -49,6 +50,9 @@ static int z_hpack_decode_huffman(lstr_t str, lstr_t expected)
     len = hpack_decode_huffman(str, buff);
     Z_ASSERT_N(len);
     Z_ASSERT_DATAEQUAL(LSTR_DATA_V(buff, len), expected);
+    len = hpack_decode_huffman_nibbles(str, buff);
+    Z_ASSERT_N(len);
+    Z_ASSERT_DATAEQUAL(LSTR_DATA_V(buff, len), expected);
     Z_HELPER_END;
 }
 
@@ -95,6 +99,80 @@ Z_GROUP_EXPORT(hpack_huffman) {
                 "7f 36 72 c1 ab 27 0f b5 29 1f 95 87 31 60 65 c0 03 ed 4e e5"
                 "b1 06 3d 50 07");
     } Z_TEST_END;
+    Z_TEST(hpack_huffman_random, "byte and nibble decoders agree") {
+        char in[64];
+        char out8[128];
+        char out4[128];
+
+        /* random inputs are mostly invalid: they check the errors (EOS,
+         * bad padding) as well */
+        for (int i = 0; i < 100000; i++) {
+            int len = rand() % countof(in);
+            int len8;
+            int len4;
+
+            for (int j = 0; j < len; j++) {
+                /* favor the long codes, made of one-valued bits */
+                in[j] = rand() % 2 ? 0xff : rand();
+            }
+            len8 = hpack_decode_huffman(LSTR_DATA_V(in, len), out8);
+            len4 = hpack_decode_huffman_nibbles(LSTR_DATA_V(in, len), out4);
+            Z_ASSERT_EQ(len8, len4, "input %*pX", len, in);
+            if (len8 > 0) {
+                Z_ASSERT_DATAEQUAL(LSTR_DATA_V(out8, len8),
+                                   LSTR_DATA_V(out4, len4));
+            }
+        }
+    } Z_TEST_END;
+    Z_TEST(hpack_huffman_bench, "byte and nibble decoders benchmark") {
+        t_scope;
+        lstr_t strs[] = {
+            LSTR_IMMED("www.example.com"),
+            LSTR_IMMED("application/grpc"),
+            LSTR_IMMED("gzip, deflate, br"),
+            LSTR_IMMED("/api/v1/users/12345/profile?fields=name,email"),
+            LSTR_IMMED("Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+                       "(KHTML, like Gecko) Chrome/105.0 Safari/537.36"),
+            LSTR_IMMED("text/html,application/xhtml+xml,application/xml;"
+                       "q=0.9,*/*;q=0.8"),
+        };
+        lstr_t zstrs[countof(strs)];
+        char out[1024];
+        proctimer_t pt;
+        long long us8;
+        long long us4;
+        size_t total = 0;
+
+        for (int i = 0; i < countof(strs); i++) {
+            int len = hpack_get_huffman_len(strs[i]);
+            char *buf = t_new_raw(char, len);
+
+            hpack_encode_huffman(strs[i], buf, len);
+            zstrs[i] = LSTR_DATA_V(buf, len);
+            total += len;
+        }
+
+        proctimer_start(&pt);
+        for (int n = 0; n < 100000; n++) {
+            carray_for_each_ptr(zstr, zstrs) {
+                Z_ASSERT_N(hpack_decode_huffman(*zstr, out));
+            }
+        }
+        us8 = proctimer_stop(&pt);
+
+        proctimer_start(&pt);
+        for (int n = 0; n < 100000; n++) {
+            carray_for_each_ptr(zstr, zstrs) {
+                Z_ASSERT_N(hpack_decode_huffman_nibbles(*zstr, out));
+            }
+        }
+        us4 = proctimer_stop(&pt);
+
+        e_named_trace(1, "hpack_bench",
+                      "huffman decoding of %zu bytes: %lldus a byte at a "
+                      "time, %lldus a nibble at a time",
+                      total * 100000, us8, us4);
+    } Z_TEST_END;
 
 #undef ZT_TEST
 } Z_GROUP_END;
@@ -1232,3 +1310,151 @@ Z_GROUP_EXPORT(hpack_examples) {
 #undef HPACK_DTBL_SZCHCK
 
 /* }}} */
+/* {{{ Encoder policy */
+
+/* Encode the headers of a gRPC-like stream: most of them recur on every
+ * stream, others have a value per stream. */
+static int z_hpack_enc_stream(hpack_enc_dtbl_t *enc,
+                              hpack_enc_policy_t * nullable policy, int i,
+                              sb_t *out, sb_t *lines)
+{
+    t_scope;
+    lstr_t hdrs[][2] = {
+        { LSTR_IMMED(":method"), LSTR_IMMED("POST") },
+        { LSTR_IMMED(":scheme"), LSTR_IMMED("http") },
+        { LSTR_IMMED(":path"), t_lstr_fmt("/pkg.Service/Method%d", i % 4) },
+        { LSTR_IMMED(":authority"), LSTR_IMMED("backend.intersec.com:8080") },
+        { LSTR_IMMED("content-type"), LSTR_IMMED("application/grpc") },
+        { LSTR_IMMED("te"), LSTR_IMMED("trailers") },
+        { LSTR_IMMED("user-agent"), LSTR_IMMED("grpc-c/1.48.0 (linux)") },
+        { LSTR_IMMED("grpc-accept-encoding"),
+          LSTR_IMMED("identity,deflate,gzip") },
+        { LSTR_IMMED("grpc-encoding"), LSTR_IMMED("identity") },
+        { LSTR_IMMED("grpc-timeout"), LSTR_IMMED("10S") },
+        { LSTR_IMMED("x-tenant"), LSTR_IMMED("intersec-production") },
+        { LSTR_IMMED("x-client-version"), LSTR_IMMED("2022.3.14") },
+        { LSTR_IMMED("x-region"), LSTR_IMMED("eu-west-3") },
+        { LSTR_IMMED("accept-language"), LSTR_IMMED("en-US,en;q=0.9") },
+        { LSTR_IMMED("cache-control"), LSTR_IMMED("no-cache") },
+        { LSTR_IMMED("authorization"),
+          LSTR_IMMED("Bearer eyJhbGciOiJIUzI1NiJ9.c2VjcmV0") },
+        { LSTR_IMMED("x-trace-flags"), LSTR_IMMED("sampled") },
+        { LSTR_IMMED("x-request-id"), t_lstr_fmt("req-%08x", i * 7919) },
+        { LSTR_IMMED("content-length"), t_lstr_fmt("%d", 100 + i % 97) },
+        { LSTR_IMMED("x-priority"), LSTR_IMMED("normal") },
+    };
+
+    carray_for_each_ptr(hdr, hdrs) {
+        int len;
+        byte *buf;
+
+        buf = (byte *)sb_grow(out, hpack_buflen_to_write_hdr((*hdr)[0],
+                                                             (*hdr)[1], 0));
+        if (policy) {
+            len = hpack_enc_policy_write_hdr(policy, enc, (*hdr)[0],
+                                             (*hdr)[1], buf);
+        } else {
+            len = hpack_encoder_write_hdr(enc, (*hdr)[0], (*hdr)[1], 0, 0,
+                                          0, buf);
+        }
+        Z_ASSERT_GT(len, 0);
+        __sb_fixlen(out, out->len + len);
+        sb_addf(lines, "%pL: %pL\r\n", &(*hdr)[0], &(*hdr)[1]);
+    }
+    Z_HELPER_END;
+}
+
+static int z_hpack_dec_block(hpack_dec_dtbl_t *dec, pstream_t in,
+                             lstr_t expected)
+{
+    SB_8k(lines);
+
+    while (!ps_done(&in)) {
+        hpack_xhdr_t xhdr;
+        int keylen;
+        int len = hpack_decoder_extract_hdr(dec, &in, &xhdr);
+
+        Z_ASSERT_N(len);
+        len = hpack_decoder_write_hdr(dec, &xhdr,
+                                      (byte *)sb_grow(&lines, len + 4),
+                                      &keylen);
+        Z_ASSERT_N(len);
+        __sb_fixlen(&lines, lines.len + len);
+    }
+    Z_ASSERT_LSTREQUAL(LSTR_SB_V(&lines), expected);
+    Z_HELPER_END;
+}
+
+Z_GROUP_EXPORT(hpack_enc_policy) {
+    Z_TEST(hpack_enc_policy_grpc, "encoder policy on recurring headers") {
+        hpack_enc_dtbl_t enc_plain;
+        hpack_enc_dtbl_t enc;
+        hpack_enc_policy_t policy;
+        hpack_dec_dtbl_t dec;
+        proctimer_t pt;
+        long long plain_us;
+        long long policy_us;
+        size_t plain_bytes = 0;
+        size_t policy_bytes = 0;
+        SB_8k(out);
+        SB_8k(lines);
+        enum { STREAMS = 2000 };
+
+        hpack_enc_dtbl_init(&enc_plain);
+        hpack_enc_dtbl_init_settings(&enc_plain, 4096);
+        hpack_enc_dtbl_init(&enc);
+        hpack_enc_dtbl_init_settings(&enc, 4096);
+        hpack_enc_policy_init(&policy);
+        hpack_dec_dtbl_init(&dec);
+        hpack_dec_dtbl_init_settings(&dec, 4096);
+
+        proctimer_start(&pt);
+        for (int i = 0; i < STREAMS; i++) {
+            sb_reset(&out);
+            sb_reset(&lines);
+            Z_HELPER_RUN(z_hpack_enc_stream(&enc_plain, NULL, i, &out,
+                                            &lines));
+            plain_bytes += out.len;
+        }
+        plain_us = proctimer_stop(&pt);
+
+        proctimer_start(&pt);
+        for (int i = 0; i < STREAMS; i++) {
+            sb_reset(&out);
+            sb_reset(&lines);
+            Z_HELPER_RUN(z_hpack_enc_stream(&enc, &policy, i, &out,
+                                            &lines));
+            policy_bytes += out.len;
+
+            /* the blocks must decode to the same headers */
+            Z_HELPER_RUN(z_hpack_dec_block(&dec, ps_initsb(&out),
+                                           LSTR_SB_V(&lines)));
+        }
+        policy_us = proctimer_stop(&pt);
+
+        e_named_trace(1, "hpack_bench",
+                      "plain: %zu bytes in %lldus, "
+                      "policy: %zu bytes in %lldus (with decoding)",
+                      plain_bytes, plain_us, policy_bytes, policy_us);
+
+        /* the recurring headers are indexed after two streams, the others
+         * are literals: it is at least 3 times smaller */
+        Z_ASSERT_LT(policy_bytes * 3, plain_bytes);
+        Z_ASSERT_EQ(policy.bytes, policy_bytes);
+        Z_ASSERT_EQ(policy.hdrs, 20U * STREAMS);
+        Z_ASSERT_GE(policy.indexed, 16U * (STREAMS - 2));
+
+        /* the high-cardinality values are not in the dynamic table, which
+         * keeps the recurring headers */
+        Z_ASSERT_LE(enc.tbl_size, 4096U);
+        Z_ASSERT_LE(qm_len(hpack_enc_vals, &policy.vals),
+                    20 * HPACK_ENC_POLICY_KEY_VALS_MAX);
+
+        hpack_dec_dtbl_wipe(&dec);
+        hpack_enc_policy_wipe(&policy);
+        hpack_enc_dtbl_wipe(&enc);
+        hpack_enc_dtbl_wipe(&enc_plain);
+    } Z_TEST_END;
+} Z_GROUP_END;
+
+/* }}} */
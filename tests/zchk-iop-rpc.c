@@ -40,6 +40,7 @@ static struct {
     bool sub_query_called;
     bool sub_query_called_synchronously;
     bool reply_status_is_abort;
+    bool echo_fails;
 } z_iop_rpc_g;
 #define _G  z_iop_rpc_g
 
@@ -184,10 +185,23 @@ static void IOP_RPC_CB(tstiop_rpc__rpc, test, echo)
 
 static void IOP_RPC_IMPL(tstiop_rpc__rpc, test, echo)
 {
+    if (_G.echo_fails) {
+        ic_reply_err(ic, slot, IC_MSG_SERVER_ERROR);
+        return;
+    }
     ic_reply(ic, slot, tstiop_rpc__rpc, test, echo, arg->i);
     _G.echo_rpc_answered++;
 }
 
+static void z_group_echo_cb(IOP_RPC_CB_ARGS(tstiop_rpc__rpc, test, echo))
+{
+    int *answers = *acast(int *, msg->priv);
+
+    if (status == IC_MSG_OK) {
+        (*answers)++;
+    }
+}
+
 /* }}} */
 /* {{{ Helpers */
 
@@ -196,6 +210,14 @@ static void dummy_on_event(ichannel_t *ic, ic_event_t evt)
     return;
 }
 
+static void z_rpc_metrics_count_echo(const ic_rpc_stats_t *stats,
+                                     void *priv)
+{
+    if (lstr_equal(stats->rpc, LSTR("echo"))) {
+        (*(int *)priv)++;
+    }
+}
+
 /* }}} */
 /* {{{ Tests */
 
@@ -373,6 +395,99 @@ Z_GROUP_EXPORT(iop_rpc)
         el_loop_timeout(0);
     } Z_TEST_END;
 
+    Z_TEST(ic_group, "iop-rpc: groups of ichannels") {
+        ichannel_t ics[2];
+        qm_t(ic_cbs) impl = QM_INIT(ic_cbs, impl);
+        ic_group_t *g;
+        ic_group_stats_t stats;
+        ichannel_t *ejected;
+        int answers = 0;
+
+        /* the latencies of local channels are too close to be compared */
+        g = ic_group_new(&(ic_group_cfg_t){ .eject_slow_ratio = -1 });
+        ic_register(&impl, tstiop_rpc__rpc, test, echo);
+        carray_for_each_ptr(ic, ics) {
+            ic_init(ic);
+            ic_set_local(ic, false);
+            ic->impl = &impl;
+            ic_group_add(g, ic);
+        }
+
+        /* the queries are spread over the channels */
+        for (int i = 0; i < 100; i++) {
+            Z_ASSERT_N(ic_group_query(g, ic_msg(int *, &answers),
+                                      &z_group_echo_cb,
+                                      tstiop_rpc__rpc, test, echo, .i = i));
+        }
+        Z_ASSERT_EQ(answers, 100);
+        carray_for_each_ptr(ic, ics) {
+            Z_ASSERT_N(ic_group_get_stats(g, ic, &stats));
+            Z_ASSERT_GT(stats.queries, 0U);
+            Z_ASSERT_ZERO(stats.failures);
+        }
+
+        /* the first channel failing 5 times in a row is ejected, but not
+         * the other one: at most half of the channels are ejected */
+        _G.echo_fails = true;
+        for (int i = 0; i < 100; i++) {
+            Z_ASSERT_N(ic_group_query(g, ic_msg(int *, &answers),
+                                      &z_group_echo_cb,
+                                      tstiop_rpc__rpc, test, echo, .i = i));
+        }
+        _G.echo_fails = false;
+        Z_ASSERT_N(ic_group_get_stats(g, &ics[0], &stats));
+        ejected = stats.ejected ? &ics[0] : &ics[1];
+        Z_ASSERT_N(ic_group_get_stats(g, ejected, &stats));
+        Z_ASSERT(stats.ejected);
+        Z_ASSERT_EQ(stats.ejections, 1U);
+        Z_ASSERT_EQ(stats.failures, 5U);
+        Z_ASSERT_N(ic_group_get_stats(g, &ics[ejected == &ics[0]], &stats));
+        Z_ASSERT(!stats.ejected);
+        Z_ASSERT_EQ(stats.failures, 95U);
+
+        /* the ejected channel is used when no other one is ready */
+        answers = 0;
+        ics[ejected == &ics[0]].impl = NULL;
+        Z_ASSERT(ic_group_pick(g) == ejected);
+        Z_ASSERT_N(ic_group_query(g, ic_msg(int *, &answers),
+                                  &z_group_echo_cb,
+                                  tstiop_rpc__rpc, test, echo, .i = 1));
+        Z_ASSERT_EQ(answers, 1);
+
+        /* no ready channel */
+        ejected->impl = NULL;
+        Z_ASSERT_NULL(ic_group_pick(g));
+        Z_ASSERT_NEG(ic_group_query(g, ic_msg_new(0), &z_group_echo_cb,
+                                    tstiop_rpc__rpc, test, echo, .i = 1));
+
+        ic_group_remove(g, &ics[1]);
+        Z_ASSERT_NEG(ic_group_get_stats(g, &ics[1], &stats));
+        ic_group_delete(&g);
+        carray_for_each_ptr(ic, ics) {
+            ic_wipe(ic);
+        }
+        qm_wipe(ic_cbs, &impl);
+    } Z_TEST_END;
+
+    Z_TEST(ic_rpc_metrics, "iop-rpc: metrics of the RPCs") {
+        qm_t(ic_cbs) impl;
+        ic_rpc_metrics_t *m;
+        int found = 0;
+
+        qm_init(ic_cbs, &impl);
+        ic_register(&impl, tstiop_rpc__rpc, test, echo);
+        m = ic_rpc_metrics(IOP_IFACE(tstiop_rpc__rpc, test),
+                           IOP_RPC(tstiop_rpc__rpc, test, echo));
+        Z_ASSERT_P(m);
+        Z_ASSERT(qm_get(ic_cbs, &impl,
+                        IOP_RPC_CMD(tstiop_rpc__rpc, test, echo)).metrics
+                 == m, "the metrics are shared");
+
+        ic_rpcs_stats(&z_rpc_metrics_count_echo, &found);
+        Z_ASSERT_EQ(found, 1);
+        qm_wipe(ic_cbs, &impl);
+    } Z_TEST_END;
+
     Z_TEST(ic_hook_ctx, "iop-rpc: ic hook ctx leak") {
         /* Test that allocated hook contexts are properly wiped when ichannel
          * module shuts down, which can happens in real-life when a program
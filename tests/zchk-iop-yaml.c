@@ -44,6 +44,43 @@ static void t_z_yaml_pack_struct(const iop_struct_t *st, const void *v,
     }
 }
 
+/* The IOP packer writes the same document as the packing of its AST. */
+static int
+z_check_ypack_as_ast(const iop_struct_t * nonnull st,
+                     const void * nonnull value,
+                     const yaml__document_presentation__t * nullable pres,
+                     const sb_t * nonnull packed)
+{
+    t_scope;
+    yaml_pack_env_t *env = t_yaml_pack_env_new();
+    yaml_data_t data;
+    SB_1k(sb);
+
+    t_iop_to_yaml_data(st, value, &data);
+    if (pres) {
+        t_yaml_pack_env_set_presentation(env, pres);
+    }
+    Z_ASSERT_N(t_yaml_pack_sb(env, &data, &sb, NULL));
+    Z_ASSERT_STREQUAL(packed->data, sb.data);
+
+    Z_HELPER_END;
+}
+
+static int z_ypack_sb_write(void *priv, const void *buf, int len,
+                            sb_t *err)
+{
+    sb_add(priv, buf, len);
+    return len;
+}
+
+static int z_ypack_write_fail(void *priv, const void *buf, int len,
+                              sb_t *err)
+{
+    errno = EIO;
+    sb_sets(err, "write failed");
+    return -1;
+}
+
 static int
 iop_yaml_test_unpack_error(const iop_struct_t *st, unsigned flags,
                            const char *yaml, const char *expected_err,
@@ -66,6 +103,13 @@ iop_yaml_test_unpack_error(const iop_struct_t *st, unsigned flags,
                  &err);
     }
 
+    /* The streaming unpacker rejects it too, the span of the error can
+     * differ as it has no AST. */
+    ps = ps_initstr(yaml);
+    res = NULL;
+    ret = t_iop_yunpack_ptr_stream_ps(&ps, st, &res, flags, &err);
+    Z_ASSERT_NEG(ret, "YAML streaming unpacking unexpected success");
+
     Z_HELPER_END;
 }
 
@@ -80,6 +124,7 @@ iop_yaml_test_unpack(const iop_struct_t * nonnull st, unsigned flags,
     pstream_t ps;
     void *res = NULL;
     void *file_res = NULL;
+    void *stream_res = NULL;
     int ret;
     SB_1k(err);
     SB_1k(packed);
@@ -88,8 +133,19 @@ iop_yaml_test_unpack(const iop_struct_t * nonnull st, unsigned flags,
     ret = t_iop_yunpack_ptr_ps(&ps, st, &res, flags, &pres, &err);
     Z_ASSERT_N(ret, "YAML unpacking error: %pL", &err);
 
+    /* The streaming unpacker gives the same result. */
+    ps = ps_initstr(yaml);
+    ret = t_iop_yunpack_ptr_stream_ps(&ps, st, &stream_res, flags, &err);
+    Z_ASSERT_N(ret, "YAML streaming unpacking error: %pL", &err);
+    Z_ASSERT_IOPEQUAL_DESC(st, res, stream_res);
+
     t_z_yaml_pack_struct(st, res, 0, &packed);
     Z_ASSERT_STREQUAL(new_yaml ?: yaml, packed.data);
+    Z_HELPER_RUN(z_check_ypack_as_ast(st, res, NULL, &packed));
+
+    sb_reset(&packed);
+    t_iop_sb_ypack(&packed, st, res, pres);
+    Z_HELPER_RUN(z_check_ypack_as_ast(st, res, pres, &packed));
 
     /* Test iop_ypack_file / t_iop_yunpack_file */
     path = t_fmt("%*pM/tstyaml.yml", LSTR_FMT_ARG(z_tmpdir_g));
@@ -112,6 +168,9 @@ static int iop_yaml_test_pack(const iop_struct_t *st, const void *value,
 
     t_z_yaml_pack_struct(st, value, flags, &sb);
     Z_ASSERT_STREQUAL(sb.data, expected);
+    if (flags == 0) {
+        Z_HELPER_RUN(z_check_ypack_as_ast(st, value, NULL, &sb));
+    }
 
     if (test_unpack) {
         pstream_t ps = ps_initsb(&sb);
@@ -1014,6 +1073,35 @@ Z_GROUP_EXPORT(iop_yaml)
 #undef TST
     } Z_TEST_END;
     /* }}} */
+    Z_TEST(pack_writecb, "test IOP YAML packing with a writer") { /* {{{ */
+        t_scope;
+        const char *yaml = "# header\n"
+                           "a: 1 # one\n"
+                           "\n"
+                           "# before b\n"
+                           "b: 2";
+        tstiop__my_struct_a_opt__t *obj = NULL;
+        yaml__document_presentation__t *pres;
+        pstream_t ps = ps_initstr(yaml);
+        t_SB_1k(sb);
+        SB_1k(err);
+
+        Z_ASSERT_N(t_iop_yunpack_ptr_ps(&ps, &tstiop__my_struct_a_opt__s,
+                                        (void **)&obj, 0, &pres, &err),
+                   "%pL", &err);
+
+        Z_ASSERT_N(t_iop_ypack(&tstiop__my_struct_a_opt__s, obj, pres,
+                               &z_ypack_sb_write, &sb, &err));
+        Z_ASSERT_STREQUAL(sb.data, yaml);
+        Z_HELPER_RUN(z_check_ypack_as_ast(&tstiop__my_struct_a_opt__s, obj,
+                                          pres, &sb));
+
+        /* the errors of the writer are returned */
+        Z_ASSERT_NEG(t_iop_ypack(&tstiop__my_struct_a_opt__s, obj, pres,
+                                 &z_ypack_write_fail, NULL, &err));
+        Z_ASSERT_STREQUAL(err.data, "write failed");
+    } Z_TEST_END;
+    /* }}} */
     Z_TEST(unpack_compat, "test YAML unpacking backward compat") { /* {{{ */
 #define TST(_st, _yaml, _new_yaml)                                           \
         Z_HELPER_RUN(iop_yaml_test_unpack((_st), 0, (_yaml), (_new_yaml)))
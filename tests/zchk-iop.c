@@ -25,8 +25,10 @@
 #include <lib-common/thr.h>
 #include <lib-common/unix.h>
 #include <lib-common/z.h>
+#include <lib-common/iop-compress.h>
 #include <lib-common/iop-json.h>
 #include <lib-common/iop-yaml.h>
+#include <lib-common/iop/codec.h>
 #include <lib-common/iop/priv.h>
 #include <lib-common/iop/ic.iop.h>
 #include <lib-common/xmlr.h>
@@ -274,6 +276,8 @@ static int z_test_macros_dup_copy(const tstiop__full_struct__t *v)
     out = mp_iop_dup_sz(t_pool(), tstiop__full_struct, v, &sz);
     Z_HELPER_RUN(z_test_macros_dup_copy_eq(v, out, false));
     Z_ASSERT_NE(sz, (size_t)0);
+    Z_ASSERT_EQ(iop_memory_footprint(tstiop__full_struct, v), sz);
+    Z_ASSERT_EQ(iop_memory_footprint(tstiop__full_struct, out), sz);
 
     out = mp_iop_dup(t_pool(), tstiop__full_struct, v);
     Z_HELPER_RUN(z_test_macros_dup_copy_eq(v, out, false));
@@ -714,6 +718,14 @@ static int iop_xml_test_struct(const iop_struct_t *st, void *v,
                        "XML packing/unpacking doesn't match! (%s, %s)",
                        st->fullname.s, info);
 
+    /* the streamed packing gives the same result */
+    t_sb_init(&sb, 10);
+    Z_ASSERT_N(iop_xpack_cb(st, res, &iop_sb_write, &sb,
+                            IOP_XPACK_LITERAL_ENUMS));
+    Z_ASSERT_LSTREQUAL(s, LSTR_SB_V(&sb),
+                       "XML streamed packing doesn't match! (%s, %s)",
+                       st->fullname.s, info);
+
     /* In case of, check hashes equality */
     iop_hash_sha1(st, v,   buf1, 0);
     iop_hash_sha1(st, res, buf2, 0);
@@ -1005,6 +1017,60 @@ static void iop_std_test_speed(const iop_struct_t *st, void *v, int iter,
                   (float)elapsed / elapsed2);
 }
 
+/* Check that the codec generated by iopc for a struct packs and unpacks
+ * like the generic packer. */
+static int z_iop_check_codec(const iop_struct_t *st, const void *v,
+                             const unsigned flags)
+{
+    t_scope;
+    iop_struct_t generic;
+    lstr_t packed;
+    lstr_t generic_packed;
+    void *res = NULL;
+
+    p_copy(&generic, st, 1);
+    generic.flags &= ~(1 << IOP_STRUCT_HAS_CODEC);
+
+    packed = t_iop_bpack_struct_flags(st, v, flags);
+    generic_packed = t_iop_bpack_struct_flags(&generic, v, flags);
+    Z_ASSERT_DATAEQUAL(packed, generic_packed);
+
+    Z_ASSERT_N(iop_bunpack_ptr(t_pool(), st, &res, ps_initlstr(&packed),
+                               false), "%s", iop_get_err());
+    Z_ASSERT_IOPEQUAL_DESC(st, v, res);
+    Z_ASSERT_N(iop_bunpack_ptr(t_pool(), st, &res, ps_initlstr(&packed),
+                               true), "%s", iop_get_err());
+    Z_ASSERT_IOPEQUAL_DESC(st, v, res);
+
+    Z_HELPER_END;
+}
+
+/* Check that the single pass packer gives the same result as the two passes
+ * one, and that its wide lengths are understood by the unpacker. */
+static int z_iop_check_bpack_sb(const iop_struct_t *st, const void *v,
+                                const unsigned flags)
+{
+    t_scope;
+    SB_1k(sb);
+    lstr_t packed;
+    void *res = NULL;
+
+    packed = t_iop_bpack_struct_flags(st, v, flags);
+    sb_adds(&sb, "prefix");
+    Z_ASSERT_EQ(iop_bpack_sb(&sb, st, v, flags), packed.len);
+    Z_ASSERT_DATAEQUAL(LSTR_INIT_V(sb.data, 6), LSTR("prefix"));
+    Z_ASSERT_DATAEQUAL(LSTR_PTR_V(sb.data + 6, sb.data + sb.len), packed);
+
+    sb_reset(&sb);
+    Z_ASSERT_N(iop_bpack_sb(&sb, st, v, flags | IOP_BPACK_WIDE_LENGTHS));
+    Z_ASSERT_GE(sb.len, packed.len);
+    Z_ASSERT_N(iop_bunpack_ptr(t_pool(), st, &res, ps_initsb(&sb), false),
+               "%s", iop_get_err());
+    Z_ASSERT_IOPEQUAL_DESC(st, v, res);
+
+    Z_HELPER_END;
+}
+
 static int iop_std_test_struct_flags(const iop_struct_t *st, void *v,
                                      const unsigned flags, const char *info)
 {
@@ -1015,6 +1081,8 @@ static int iop_std_test_struct_flags(const iop_struct_t *st, void *v,
     qv_t(i32) szs, szs2;
     int len, len2;
     byte *dst, *dst2;
+    SB_1k(json);
+    SB_1k(json2);
 
     /* XXX: Use a small t_qv here to force a realloc during (un)packing and
      *      detect possible illegal usage of the t_pool in the (un)packing
@@ -1032,6 +1100,8 @@ static int iop_std_test_struct_flags(const iop_struct_t *st, void *v,
                                                 IOP_BPACK_STRICT),
                        LSTR_INIT_V((const char *)dst, len));
 
+    Z_ASSERT_N(iop_sb_jpack(&json, st, v, 0));
+
     /* packing in threaded mode should work */
     module_require(MODULE(thr), NULL);
     iop_bpack_set_threaded_threshold(2);
@@ -1053,6 +1123,15 @@ static int iop_std_test_struct_flags(const iop_struct_t *st, void *v,
     iop_bpack(dst2, st, v, szs2.tab);
     Z_ASSERT_DATAEQUAL(LSTR_INIT_V((const char *)dst, len),
                        LSTR_INIT_V((const char *)dst2, len2));
+
+    /* unpacking and json packing in threaded mode should work too */
+    ret = iop_bunpack_ptr(t_pool(), st, &res, ps_init(dst, len), false);
+    Z_ASSERT_N(ret, "threaded IOP unpacking error (%s, %s, %s)",
+               st->fullname.s, info, iop_get_err());
+    Z_ASSERT_IOPEQUAL_DESC(st, v, res);
+    res = NULL;
+    Z_ASSERT_N(iop_sb_jpack(&json2, st, v, 0));
+    Z_ASSERT_DATAEQUAL(LSTR_SB_V(&json), LSTR_SB_V(&json2));
     module_release(MODULE(thr));
 
     /* unpacking */
@@ -1602,6 +1681,99 @@ Z_GROUP_EXPORT(iop)
         Z_ASSERT(memcmp(buf1, buf2, sizeof(buf1)) == 0);
     } Z_TEST_END;
     /* }}} */
+    Z_TEST(hash_cached, "test the cached IOP digests") { /* {{{ */
+        t_scope;
+        const iop_struct_t *st = &tstiop__my_struct_c__s;
+        tstiop__my_struct_c__t sc;
+        tstiop__my_struct_c__t sub;
+        tstiop__child__t child;
+        tstiop__ancestor__t tutor;
+        tstiop__obj_container__t container;
+        iop_hash_cache_t *cache = iop_hash_cache_new(0);
+        uint64_t h;
+
+        iop_init(tstiop__my_struct_c, &sc);
+        iop_init(tstiop__my_struct_c, &sub);
+        sc.a = 1;
+        sc.b = &sub;
+        sc.c.tab = t_new(tstiop__my_struct_c__t, 200);
+        sc.c.len = 200;
+        for (int i = 0; i < sc.c.len; i++) {
+            iop_init(tstiop__my_struct_c, &sc.c.tab[i]);
+            sc.c.tab[i].a = i;
+        }
+        sub.c.tab = t_new(tstiop__my_struct_c__t, 100);
+        sub.c.len = 100;
+        for (int i = 0; i < sub.c.len; i++) {
+            iop_init(tstiop__my_struct_c, &sub.c.tab[i]);
+            sub.c.tab[i].a = -i;
+        }
+
+        Z_ASSERT_EQ(iop_hash64(st, &sc, 0), iop_hash64(st, t_iop_dup(st, &sc),
+                                                       0));
+
+        /* the digests do not depend on the state of the cache */
+#define CHECK_HASH(v)                                                        \
+        do {                                                                 \
+            iop_hash_cache_t *_fresh = iop_hash_cache_new(0);                \
+                                                                             \
+            h = iop_hash64_cached(cache, st, v);                             \
+            Z_ASSERT_EQ(h, iop_hash64_cached(cache, st, v));                 \
+            Z_ASSERT_EQ(h, iop_hash64_cached(_fresh, st, v));                \
+            iop_hash_cache_delete(&_fresh);                                  \
+        } while (0)
+
+        CHECK_HASH(&sc);
+
+        Z_ASSERT_N(iop_hash_cache_invalidate(cache, st, &sc,
+                                             LSTR("b.c[70].a")));
+        sub.c.tab[70].a = 42;
+        CHECK_HASH(&sc);
+
+        Z_ASSERT_N(iop_hash_cache_invalidate(cache, st, &sc, LSTR("c[-1]")));
+        sc.c.tab[199].b = t_iop_dup(st, &sub);
+        CHECK_HASH(&sc);
+
+        Z_ASSERT_N(iop_hash_cache_invalidate(cache, st, &sc, LSTR("c")));
+        sc.c.len = 150;
+        CHECK_HASH(&sc);
+
+        Z_ASSERT_N(iop_hash_cache_invalidate(cache, st, &sc, LSTR("b")));
+        sc.b = NULL;
+        CHECK_HASH(&sc);
+
+        Z_ASSERT_N(iop_hash_cache_invalidate(cache, st, &sc, LSTR("a")));
+        sc.a = 2;
+        CHECK_HASH(&sc);
+
+        Z_ASSERT_NEG(iop_hash_cache_invalidate(cache, st, &sc,
+                                               LSTR("c[150]")));
+        Z_ASSERT_NEG(iop_hash_cache_invalidate(cache, st, &sc,
+                                               LSTR("a.b")));
+        Z_ASSERT_NEG(iop_hash_cache_invalidate(cache, st, &sc,
+                                               LSTR("unknown")));
+
+        /* classes */
+        st = &tstiop__obj_container__s;
+        iop_init(tstiop__obj_container, &container);
+        iop_init(tstiop__child, &child);
+        iop_init(tstiop__ancestor, &tutor);
+        child.name = LSTR("child");
+        tutor.name = LSTR("tutor");
+        child.tutor = &tutor;
+        container.obj = &child.super.super.super;
+        h = iop_hash64_cached(cache, st, &container);
+        Z_ASSERT_N(iop_hash_cache_invalidate(cache, st, &container,
+                                             LSTR("obj.tutor.name")));
+        tutor.name = LSTR("other");
+        Z_ASSERT_NE(h, iop_hash64_cached(cache, st, &container));
+        CHECK_HASH(&container);
+#undef CHECK_HASH
+
+        iop_hash_cache_delete(&cache);
+        Z_ASSERT_NULL(cache);
+    } Z_TEST_END;
+    /* }}} */
     Z_TEST(constant_folder, "test the IOP constant folder") { /* {{{ */
 #define feed_num(_num)                                                  \
         Z_ASSERT_N(iop_cfolder_feed_number(&cfolder, _num, true),       \
@@ -3144,6 +3316,64 @@ Z_GROUP_EXPORT(iop)
 #undef CLEAR_SUB_FILES
         /* }}} */
 
+    } Z_TEST_END
+    /* }}} */
+    Z_TEST(json_include_cache, "test the cache of the included files") { /* {{{ */
+        t_scope;
+        SB_1k(err);
+        const char *dir = t_fmt("%*pM/include-cache",
+                                LSTR_FMT_ARG(z_tmpdir_g));
+        const char *main_path = t_fmt("%s/main.json", dir);
+        const char *b_path = t_fmt("%s/b.json", dir);
+        const char *c_path = t_fmt("%s/c.json", dir);
+        tstiop__my_struct_c__t obj;
+        struct timespec times[2];
+        struct stat st;
+
+#define WRITE(_path, _content)                                               \
+        Z_ASSERT_N(xwrite_file(_path, _content, strlen(_content)))
+#define UNPACK()                                                             \
+        Z_ASSERT_N(t_iop_junpack_file(main_path, &tstiop__my_struct_c__s,    \
+                                      &obj, 0, NULL, &err),                  \
+                   "%*pM", SB_FMT_ARG(&err))
+
+        Z_ASSERT_N(mkdir_p(dir, 0755));
+        WRITE(main_path, "{ a: 1, b: @include(\"b.json\") }");
+        WRITE(b_path, "{ a: 2, b: @include(\"c.json\") }");
+        WRITE(c_path, "{ a: 3 }");
+
+        iop_junpack_set_include_cache(true);
+        UNPACK();
+        Z_ASSERT_EQ(obj.b->a, 2);
+        Z_ASSERT_EQ(obj.b->b->a, 3);
+
+        /* The cached value is used when the files look unchanged: rewrite
+         * c.json with the same size and modification time. */
+        Z_ASSERT_N(stat(c_path, &st));
+        WRITE(c_path, "{ a: 4 }");
+        times[0] = st.st_atim;
+        times[1] = st.st_mtim;
+        Z_ASSERT_N(utimensat(AT_FDCWD, c_path, times, 0));
+        UNPACK();
+        Z_ASSERT_EQ(obj.b->a, 2);
+        Z_ASSERT_EQ(obj.b->b->a, 3);
+
+        /* The modification of a file included by b.json invalidates it. */
+        WRITE(c_path, "{ a: 42 }");
+        UNPACK();
+        Z_ASSERT_EQ(obj.b->a, 2);
+        Z_ASSERT_EQ(obj.b->b->a, 42);
+        UNPACK();
+        Z_ASSERT_EQ(obj.b->b->a, 42);
+
+        /* A removed file is not used anymore. */
+        Z_ASSERT_N(unlink(c_path));
+        Z_ASSERT_NEG(t_iop_junpack_file(main_path, &tstiop__my_struct_c__s,
+                                        &obj, 0, NULL, &err));
+
+        iop_junpack_set_include_cache(false);
+#undef WRITE
+#undef UNPACK
     } Z_TEST_END
     /* }}} */
     Z_TEST(std, "test IOP std (un)packer") { /* {{{ */
@@ -3351,6 +3581,484 @@ Z_GROUP_EXPORT(iop)
                                          &out, ps_initlstr(&bpacked), 0));
     } Z_TEST_END;
     /* }}} */
+    Z_TEST(bpack_codecs, "test the binary packers generated by iopc") { /* {{{ */
+        t_scope;
+        tstiop__my_struct_g__t sg;
+        tstiop__my_struct_d__t sd = { .a = 1000, .b = -3 };
+        tstiop__my_struct_n__t sn = { .u = UINT64_MAX, .i = INT64_MIN };
+        unsigned sflags;
+        lstr_t packed;
+        sb_t buf;
+        uint8_t *end;
+
+        sflags = tstiop__my_struct_g__s.flags;
+        Z_ASSERT(TST_BIT(&sflags, IOP_STRUCT_HAS_CODEC));
+        /* structs with repeated or struct fields have no codec */
+        sflags = tstiop__my_struct_b__s.flags;
+        Z_ASSERT(!TST_BIT(&sflags, IOP_STRUCT_HAS_CODEC));
+        sflags = tstiop__my_struct_a__s.flags;
+        Z_ASSERT(!TST_BIT(&sflags, IOP_STRUCT_HAS_CODEC));
+
+        iop_init(tstiop__my_struct_g, &sg);
+        Z_HELPER_RUN(z_iop_check_codec(&tstiop__my_struct_g__s, &sg, 0));
+        Z_HELPER_RUN(z_iop_check_codec(&tstiop__my_struct_g__s, &sg,
+                                       IOP_BPACK_SKIP_DEFVAL));
+        sg.a = INT32_MIN;
+        sg.b = UINT32_MAX;
+        sg.d = 200;
+        sg.h = UINT64_MAX;
+        sg.j = LSTR("plop");
+        sg.l = -0.5;
+        sg.m = false;
+        Z_HELPER_RUN(z_iop_check_codec(&tstiop__my_struct_g__s, &sg, 0));
+        Z_HELPER_RUN(z_iop_check_codec(&tstiop__my_struct_g__s, &sg,
+                                       IOP_BPACK_SKIP_DEFVAL));
+
+        /* long tags */
+        Z_HELPER_RUN(z_iop_check_codec(&tstiop__my_struct_d__s, &sd, 0));
+        Z_HELPER_RUN(z_iop_check_codec(&tstiop__my_struct_n__s, &sn, 0));
+
+        /* an unknown field makes the generic unpacker take over */
+        t_sb_init(&buf, 100);
+        sb_add_lstr(&buf, t_iop_bpack_struct(&tstiop__my_struct_n__s, &sn));
+        end = (uint8_t *)sb_grow(&buf, 16);
+        end = iop_codec_pack_int32(end, 12, 0, 42);
+        __sb_fixlen(&buf, end - (uint8_t *)buf.data);
+        packed = LSTR_SB_V(&buf);
+        p_clear(&sn, 1);
+        Z_ASSERT_N(iop_bunpack(t_pool(), &tstiop__my_struct_n__s, &sn,
+                               ps_initlstr(&packed), false));
+        Z_ASSERT_EQ(sn.u, UINT64_MAX);
+        Z_ASSERT_EQ(sn.i, INT64_MIN);
+
+        /* and so does a missing required field, to report the error */
+        Z_ASSERT_NEG(iop_bunpack(t_pool(), &tstiop__my_struct_d__s, &sd,
+                                 ps_init("", 0), false));
+    } Z_TEST_END;
+    /* }}} */
+    Z_TEST(bpack_sb, "test the single pass binary packer") { /* {{{ */
+        t_scope;
+        tstiop__my_struct_g__t sg;
+        tstiop__my_struct_c__t sc[4];
+        tstiop__my_struct_f__t sf;
+        tstiop__my_class3__t cls3;
+        tstiop__my_class2__t cls2;
+        tstiop__my_class1__t *classes[2];
+        tstiop__my_union_a__t unions[3];
+        lstr_t strings[2];
+        tstiop__my_struct_b__t stb[2];
+        int ints[] = { 1, 2, 3 };
+        tstiop__constraint_u__t cu;
+        SB_1k(buf);
+
+        iop_init(tstiop__my_struct_g, &sg);
+        Z_HELPER_RUN(z_iop_check_bpack_sb(&tstiop__my_struct_g__s, &sg, 0));
+        Z_HELPER_RUN(z_iop_check_bpack_sb(&tstiop__my_struct_g__s, &sg,
+                                          IOP_BPACK_SKIP_DEFVAL));
+
+        /* nested blocks whose lengths take 1, 2 and 4 bytes */
+        for (int i = 0; i < countof(sc); i++) {
+            iop_init(tstiop__my_struct_c, &sc[i]);
+            sc[i].a = i;
+        }
+        sc[0].c.tab = t_new(tstiop__my_struct_c__t, 300);
+        sc[0].c.len = 300;
+        for (int i = 0; i < sc[0].c.len; i++) {
+            iop_init(tstiop__my_struct_c, &sc[0].c.tab[i]);
+            sc[0].c.tab[i].a = i * 1000;
+        }
+        sc[1].c.tab = t_new(tstiop__my_struct_c__t, 30000);
+        sc[1].c.len = 30000;
+        for (int i = 0; i < sc[1].c.len; i++) {
+            iop_init(tstiop__my_struct_c, &sc[1].c.tab[i]);
+            sc[1].c.tab[i].a = i;
+        }
+        sc[1].b = &sc[0];
+        sc[2].c = T_IOP_ARRAY(tstiop__my_struct_c, sc[0], sc[1], sc[0]);
+        sc[3].b = &sc[2];
+        sc[3].c = T_IOP_ARRAY(tstiop__my_struct_c, sc[1], sc[2]);
+        Z_HELPER_RUN(z_iop_check_bpack_sb(&tstiop__my_struct_c__s,
+                                          &sc[3], 0));
+
+        /* repeated fields, unions and classes */
+        iop_init(tstiop__my_class3, &cls3);
+        cls3.int1 = 1;
+        cls3.int3 = 3;
+        cls3.string1 = LSTR("string1");
+        iop_init(tstiop__my_class2, &cls2);
+        cls3.next_class = &cls2.super;
+        classes[0] = &cls3.super.super;
+        classes[1] = &cls2.super;
+        unions[0] = IOP_UNION(tstiop__my_union_a, ua, 1);
+        unions[1] = IOP_UNION(tstiop__my_union_a, ub, 2);
+        unions[2] = IOP_UNION(tstiop__my_union_a, us, LSTR("us"));
+        strings[0] = LSTR("foo");
+        strings[1] = LSTR_EMPTY_V;
+        iop_init(tstiop__my_struct_b, &stb[0]);
+        iop_init(tstiop__my_struct_b, &stb[1]);
+        stb[1].b = (iop_array_i32_t)IOP_ARRAY(ints, countof(ints));
+        iop_init(tstiop__my_struct_f, &sf);
+        sf.a = (iop_array_lstr_t)IOP_ARRAY(strings, countof(strings));
+        sf.c = T_IOP_ARRAY(tstiop__my_struct_b, stb[0], stb[1]);
+        sf.d = (tstiop__my_union_a__array_t)IOP_ARRAY(unions,
+                                                      countof(unions));
+        sf.e = (tstiop__my_class1__array_t)IOP_ARRAY(classes,
+                                                     countof(classes));
+        sf.f = &cls3.super.super;
+        Z_HELPER_RUN(z_iop_check_bpack_sb(&tstiop__my_struct_f__s, &sf, 0));
+        Z_HELPER_RUN(z_iop_check_bpack_sb(&tstiop__my_struct_f__s, &sf,
+                                          IOP_BPACK_SKIP_DEFVAL));
+        Z_HELPER_RUN(z_iop_check_bpack_sb(&tstiop__my_class3__s, &cls3, 0));
+        Z_HELPER_RUN(z_iop_check_bpack_sb(&tstiop__my_union_a__s,
+                                          &unions[2], 0));
+
+        /* nothing is appended when a constraint is violated */
+        sb_adds(&buf, "prefix");
+        cu = IOP_UNION(tstiop__constraint_u, u8, 0);
+        Z_ASSERT_NEG(iop_bpack_sb(&buf, &tstiop__constraint_u__s, &cu,
+                                  IOP_BPACK_STRICT));
+        Z_ASSERT_EQ(buf.len, 6);
+    } Z_TEST_END;
+    /* }}} */
+    Z_TEST(bpack_int_vec, "test the bulk (un)packing of integers") { /* {{{ */
+        t_scope;
+        const int32_t vals[] = {
+            0, 1, -1, 127, -128, 128, -129, 1000, INT32_MAX, INT32_MIN,
+        };
+        tstiop__repeated__t rep;
+        tstiop__repeated__t *rep_res = NULL;
+        tstiop__my_class2__t cls2;
+        tstiop__my_union_a__t un = IOP_UNION(tstiop__my_union_a, ua, 1);
+        tstiop__my_struct_a__t sa = {
+            .lr = &un,
+            .cls2 = &cls2,
+        };
+        tstiop__my_struct_a__t *sa_res = NULL;
+        int32_t *i32 = t_new(int32_t, 1000);
+        uint64_t *u64 = t_new(uint64_t, 1000);
+        SB_1k(sb);
+        lstr_t packed;
+
+        /* runs of small integers broken by bigger ones at every position */
+        for (int i = 0; i < 1000; i++) {
+            if (i % 37 < 20) {
+                i32[i] = (i % 256) - 128;
+                u64[i] = i % 128;
+            } else {
+                i32[i] = vals[i % countof(vals)];
+                u64[i] = (uint64_t)vals[i % countof(vals)];
+            }
+        }
+
+        iop_init(tstiop__repeated, &rep);
+        iop_init(tstiop__my_class2, &cls2);
+        for (int len = 1; len <= 1000; len += len < 40 ? 1 : 97) {
+            rep.i32 = (iop_array_i32_t)IOP_ARRAY(i32, len);
+            sa.htab = (iop_array_u64_t)IOP_ARRAY(u64, len);
+
+            /* the single pass packer packs the elements one by one */
+            packed = t_iop_bpack_struct(&tstiop__repeated__s, &rep);
+            sb_reset(&sb);
+            Z_ASSERT_N(iop_bpack_sb(&sb, &tstiop__repeated__s, &rep, 0));
+            Z_ASSERT_DATAEQUAL(packed, LSTR_SB_V(&sb), "len %d", len);
+            Z_ASSERT_N(iop_bunpack_ptr(t_pool(), &tstiop__repeated__s,
+                                       (void **)&rep_res,
+                                       ps_initlstr(&packed), false),
+                       "len %d: %s", len, iop_get_err());
+            Z_ASSERT_IOPEQUAL(tstiop__repeated, &rep, rep_res, "len %d", len);
+
+            packed = t_iop_bpack_struct(&tstiop__my_struct_a__s, &sa);
+            sb_reset(&sb);
+            Z_ASSERT_N(iop_bpack_sb(&sb, &tstiop__my_struct_a__s, &sa, 0));
+            Z_ASSERT_DATAEQUAL(packed, LSTR_SB_V(&sb), "len %d", len);
+            Z_ASSERT_N(iop_bunpack_ptr(t_pool(), &tstiop__my_struct_a__s,
+                                       (void **)&sa_res,
+                                       ps_initlstr(&packed), false),
+                       "len %d: %s", len, iop_get_err());
+            Z_ASSERT_IOPEQUAL(tstiop__my_struct_a, &sa, sa_res,
+                              "len %d", len);
+        }
+    } Z_TEST_END;
+    /* }}} */
+    Z_TEST(bunpack_threaded, "test the multi-threaded unpacking") { /* {{{ */
+        t_scope;
+        const int n = 1000;
+        tstiop__my_struct_f__t sf;
+        tstiop__my_struct_f__t *sf_res = NULL;
+        tstiop__my_union_a__t *d = t_new_raw(tstiop__my_union_a__t, n);
+        lstr_t packed;
+        lstr_t err;
+        byte *corrupted;
+
+        iop_init(tstiop__my_struct_f, &sf);
+        for (int i = 0; i < n; i++) {
+            d[i] = IOP_UNION(tstiop__my_union_a, ua, 1);
+        }
+        sf.d = IOP_TYPED_ARRAY(tstiop__my_union_a, d, n);
+        packed = t_iop_bpack_struct(&tstiop__my_struct_f__s, &sf);
+        /* REPEAT tag and count, then 4 bytes per element */
+        Z_ASSERT_EQ(packed.len, 5 + n * 4);
+
+        module_require(MODULE(thr), NULL);
+        iop_bpack_set_threaded_threshold(2);
+
+        Z_ASSERT_N(iop_bunpack_ptr(t_pool(), &tstiop__my_struct_f__s,
+                                   (void **)&sf_res, ps_initlstr(&packed),
+                                   false), "%s", iop_get_err());
+        Z_ASSERT_IOPEQUAL(tstiop__my_struct_f, &sf, sf_res);
+
+        /* the error of an invalid element is the one of the sequential
+         * unpacking: set an unknown union tag in the 500th element */
+        corrupted = t_new_raw(byte, packed.len);
+        memcpy(corrupted, packed.data, packed.len);
+        corrupted[5 + 500 * 4 + 2] = 0x85;
+        sf_res = NULL;
+        Z_ASSERT_NEG(iop_bunpack_ptr(t_pool(), &tstiop__my_struct_f__s,
+                                     (void **)&sf_res,
+                                     ps_init(corrupted, packed.len), false));
+        err = t_lstr_dup(iop_get_err_lstr());
+        sf_res = NULL;
+        Z_ASSERT_NEG(iop_bunpack_ptr_flags(t_pool(), &tstiop__my_struct_f__s,
+                                           (void **)&sf_res,
+                                           ps_init(corrupted, packed.len),
+                                           IOP_UNPACK_MONOTHREAD));
+        Z_ASSERT_LSTREQUAL(err, iop_get_err_lstr());
+
+        module_release(MODULE(thr));
+    } Z_TEST_END;
+    /* }}} */
+    Z_TEST(bpack_compress, "test the compression with dictionaries") { /* {{{ */
+        t_scope;
+        const iop_struct_t *st = &tstiop__my_struct_f__s;
+        static const char *groups[] = {
+            "administrators", "operators", "supervisors", "customers",
+        };
+        tstiop__my_struct_f__t *values;
+        const void **ptrs;
+        tstiop__my_struct_f__t sf;
+        tstiop__my_struct_f__t res;
+        SB_1k(dict);
+        SB_1k(packed);
+        SB_1k(zdata);
+        SB_1k(zdata_old);
+        int nb = 1000;
+
+        values = t_new(tstiop__my_struct_f__t, nb + 1);
+        ptrs = t_new(const void *, nb);
+        for (int i = 0; i <= nb; i++) {
+            lstr_t *strings = t_new(lstr_t, 4);
+
+            strings[0] = t_lstr_fmt("user-%d@example.com",
+                                    (int)rand_range(0, 100000));
+            strings[1] = LSTR(groups[rand_range(0, countof(groups) - 1)]);
+            strings[2] = LSTR(groups[rand_range(0, countof(groups) - 1)]);
+            strings[3] = t_lstr_fmt("session-%08x",
+                                    (int)rand_range(0, 1 << 30));
+            iop_init(tstiop__my_struct_f, &values[i]);
+            values[i].a = (iop_array_lstr_t)IOP_ARRAY(strings, 4);
+            if (i < nb) {
+                ptrs[i] = &values[i];
+            }
+        }
+        sf = values[nb];
+
+        /* Without dictionary. */
+        Z_ASSERT_NULL(iop_bpack_dict_get(st));
+        Z_ASSERT_N(iop_bpack_compress(&zdata, st, &sf, 0));
+        Z_ASSERT_N(t_iop_bunpack_decompress(st, &res, ps_initsb(&zdata), 0));
+        Z_ASSERT_IOPEQUAL(tstiop__my_struct_f, &res, &sf);
+        iop_bpack_sb(&packed, st, &sf, 0);
+        Z_ASSERT_GT(zdata.len, packed.len / 2);
+
+        /* With a dictionary. */
+        Z_ASSERT_N(iop_bpack_dict_train(&dict, st, ptrs, nb, 4096));
+        Z_ASSERT_N(iop_bpack_dict_register(st, LSTR_SB_V(&dict),
+                                           COMPRESS_LEVEL_DEFAULT));
+        Z_ASSERT_P(iop_bpack_dict_get(st));
+        Z_ASSERT_NEG(iop_bpack_dict_register(st, LSTR_SB_V(&dict),
+                                             COMPRESS_LEVEL_DEFAULT),
+                     "the same dictionary cannot be registered twice");
+        Z_ASSERT_NEG(iop_bpack_dict_register(st, LSTR("raw dictionary"),
+                                             COMPRESS_LEVEL_DEFAULT));
+        Z_ASSERT_N(iop_bpack_compress(&zdata_old, st, &sf, 0));
+        Z_ASSERT_LT(zdata_old.len, packed.len / 2);
+        Z_ASSERT_N(t_iop_bunpack_decompress(st, &res,
+                                            ps_initsb(&zdata_old), 0));
+        Z_ASSERT_IOPEQUAL(tstiop__my_struct_f, &res, &sf);
+
+        /* The previous generations of dictionaries stay usable. */
+        for (int i = 0; i < nb; i++) {
+            values[i].a.tab[0] = t_lstr_fmt("client-%d",
+                                            (int)rand_range(0, 100000));
+        }
+        sb_reset(&dict);
+        Z_ASSERT_N(iop_bpack_dict_train(&dict, st, ptrs, nb, 4096));
+        Z_ASSERT_N(iop_bpack_dict_register(st, LSTR_SB_V(&dict), 19));
+        sb_reset(&zdata);
+        Z_ASSERT_N(iop_bpack_compress(&zdata, st, &sf, 0));
+        Z_ASSERT_NE(compress_dict_id_from_frame(LSTR_SB_V(&zdata)),
+                    compress_dict_id_from_frame(LSTR_SB_V(&zdata_old)));
+        Z_ASSERT_N(t_iop_bunpack_decompress(st, &res, ps_initsb(&zdata), 0));
+        Z_ASSERT_IOPEQUAL(tstiop__my_struct_f, &res, &sf);
+        Z_ASSERT_N(t_iop_bunpack_decompress(st, &res,
+                                            ps_initsb(&zdata_old), 0));
+        Z_ASSERT_IOPEQUAL(tstiop__my_struct_f, &res, &sf);
+
+        /* Invalid data. */
+        Z_ASSERT_NEG(t_iop_bunpack_decompress(st, &res,
+                                              ps_init(zdata.data,
+                                                      zdata.len - 1), 0));
+        Z_ASSERT_NEG(t_iop_bunpack_decompress(st, &res,
+                                              ps_initsb(&packed), 0));
+    } Z_TEST_END;
+    /* }}} */
+    Z_TEST(bview, "test the lazy views over packed values") { /* {{{ */
+#define FIELD(st, name)  ({                                                  \
+        const iop_field_t *__f = NULL;                                       \
+                                                                             \
+        Z_ASSERT_N(iop_field_find_by_name(&(st), LSTR(name), NULL, &__f));   \
+        __f;                                                                 \
+    })
+
+        t_scope;
+        tstiop__my_class2__t cls2;
+        tstiop__my_union_a__t un = IOP_UNION(tstiop__my_union_a, ua, 1);
+        uint64_t htab[] = { 1, UINT64_MAX, 3 };
+        tstiop__my_struct_a__t sa = {
+            .a = 42,
+            .b = UINT32_MAX,
+            .htab = IOP_ARRAY(htab, countof(htab)),
+            .j = LSTR_IMMED("foo"),
+            .k = MY_ENUM_A_B,
+            .l = IOP_UNION(tstiop__my_union_a, ub, 42),
+            .lr = &un,
+            .cls2 = &cls2,
+            .m = 3.14159265,
+        };
+        int ints[] = { -1, 1000 };
+        tstiop__my_struct_b__t sb = {
+            .b = IOP_ARRAY(ints, countof(ints)),
+        };
+        lstr_t strings[] = { LSTR_IMMED("a"), LSTR_IMMED("bc") };
+        tstiop__my_struct_f__t sf;
+        tstiop__my_struct_g__t sg;
+        const iop_struct_t *st = &tstiop__my_struct_a__s;
+        iop_view_t view;
+        iop_view_t sub;
+        iop_view_array_t it;
+        lstr_t packed;
+        lstr_t s;
+        int64_t i;
+        double d;
+
+        iop_init(tstiop__my_class2, &cls2);
+        cls2.int1 = 1;
+        cls2.int2 = 2;
+        packed = t_iop_bpack_struct(st, &sa);
+        Z_ASSERT_N(iop_view_init(&view, st, packed));
+
+        Z_ASSERT_EQ(iop_view_get_int(&view, FIELD(*st, "a"), &i), 1);
+        Z_ASSERT_EQ(i, 42);
+        Z_ASSERT_EQ(iop_view_get_int(&view, FIELD(*st, "b"), &i), 1);
+        Z_ASSERT_EQ(i, (int64_t)UINT32_MAX);
+        Z_ASSERT_EQ(iop_view_get_array(&view, FIELD(*st, "htab"), &it), 1);
+        Z_ASSERT_EQ(it.len, 3U);
+        for (int pos = 0; pos < countof(htab); pos++) {
+            Z_ASSERT_EQ(iop_view_array_next_int(&it, &i), 1);
+            Z_ASSERT_EQ((uint64_t)i, htab[pos]);
+        }
+        Z_ASSERT_ZERO(iop_view_array_next_int(&it, &i));
+        Z_ASSERT_EQ(iop_view_get_lstr(&view, FIELD(*st, "j"), &s), 1);
+        Z_ASSERT_LSTREQUAL(s, LSTR("foo"));
+        Z_ASSERT(s.s >= packed.s && s.s < packed.s + packed.len);
+        Z_ASSERT_EQ(iop_view_get_int(&view, FIELD(*st, "k"), &i), 1);
+        Z_ASSERT_EQ(i, MY_ENUM_A_B);
+
+        /* nested union and class */
+        Z_ASSERT_EQ(iop_view_get_view(&view, FIELD(*st, "l"), &sub), 1);
+        Z_ASSERT(iop_view_get_union_field(&sub)
+                 == FIELD(tstiop__my_union_a__s, "ub"));
+        Z_ASSERT_EQ(iop_view_get_int(&sub, FIELD(tstiop__my_union_a__s, "ub"),
+                                     &i), 1);
+        Z_ASSERT_EQ(i, 42);
+        Z_ASSERT_ZERO(iop_view_get_int(&sub,
+                                       FIELD(tstiop__my_union_a__s, "ua"),
+                                       &i));
+        Z_ASSERT_EQ(iop_view_get_view(&view, FIELD(*st, "cls2"), &sub), 1);
+        Z_ASSERT(sub.st == &tstiop__my_class2__s);
+        Z_ASSERT_EQ(iop_view_get_int(&sub,
+                                     FIELD(tstiop__my_class2__s, "int2"), &i),
+                    1);
+        Z_ASSERT_EQ(i, 2);
+        Z_ASSERT_EQ(iop_view_get_int(&sub,
+                                     FIELD(tstiop__my_class2__s, "int1"), &i),
+                    1);
+        Z_ASSERT_EQ(i, 1);
+
+        Z_ASSERT_EQ(iop_view_get_double(&view, FIELD(*st, "m"), &d), 1);
+        Z_ASSERT_EQ(d, 3.14159265);
+        /* looking up a field before the last one restarts the lookup */
+        Z_ASSERT_EQ(iop_view_get_int(&view, FIELD(*st, "a"), &i), 1);
+        Z_ASSERT_EQ(i, 42);
+
+        /* repeated fields */
+        st = &tstiop__my_struct_b__s;
+        packed = t_iop_bpack_struct(st, &sb);
+        Z_ASSERT_N(iop_view_init(&view, st, packed));
+        Z_ASSERT_EQ(iop_view_get_array(&view, FIELD(*st, "b"), &it), 1);
+        Z_ASSERT_EQ(iop_view_array_next_int(&it, &i), 1);
+        Z_ASSERT_EQ(i, -1);
+        Z_ASSERT_EQ(iop_view_array_next_int(&it, &i), 1);
+        Z_ASSERT_EQ(i, 1000);
+        Z_ASSERT_ZERO(iop_view_array_next_int(&it, &i));
+        Z_ASSERT_ZERO(iop_view_get_int(&view, FIELD(*st, "a"), &i));
+        sb.b.len = 1;
+        packed = t_iop_bpack_struct(st, &sb);
+        Z_ASSERT_N(iop_view_init(&view, st, packed));
+        Z_ASSERT_EQ(iop_view_get_array(&view, FIELD(*st, "b"), &it), 1);
+        Z_ASSERT_EQ(iop_view_array_next_int(&it, &i), 1);
+        Z_ASSERT_EQ(i, -1);
+        Z_ASSERT_ZERO(iop_view_array_next_int(&it, &i));
+
+        st = &tstiop__my_struct_f__s;
+        iop_init(tstiop__my_struct_f, &sf);
+        sf.a = (iop_array_lstr_t)IOP_ARRAY(strings, countof(strings));
+        sf.f = &cls2.super;
+        packed = t_iop_bpack_struct(st, &sf);
+        Z_ASSERT_N(iop_view_init(&view, st, packed));
+        Z_ASSERT_EQ(iop_view_get_array(&view, FIELD(*st, "a"), &it), 1);
+        for (int pos = 0; pos < countof(strings); pos++) {
+            Z_ASSERT_EQ(iop_view_array_next_lstr(&it, &s), 1);
+            Z_ASSERT_LSTREQUAL(s, strings[pos]);
+        }
+        Z_ASSERT_ZERO(iop_view_array_next_lstr(&it, &s));
+        Z_ASSERT_ZERO(iop_view_get_array(&view, FIELD(*st, "e"), &it));
+        Z_ASSERT_ZERO(iop_view_array_next_view(&it, &sub));
+        Z_ASSERT_EQ(iop_view_get_view(&view, FIELD(*st, "f"), &sub), 1);
+        Z_ASSERT(sub.st == &tstiop__my_class2__s);
+
+        /* default values */
+        st = &tstiop__my_struct_g__s;
+        iop_init(tstiop__my_struct_g, &sg);
+        packed = t_iop_bpack_struct_flags(st, &sg, IOP_BPACK_SKIP_DEFVAL);
+        Z_ASSERT_N(iop_view_init(&view, st, packed));
+        Z_ASSERT_ZERO(iop_view_get_int(&view, FIELD(*st, "a"), &i));
+        Z_ASSERT_EQ(i, -1);
+        Z_ASSERT_ZERO(iop_view_get_lstr(&view, FIELD(*st, "j"), &s));
+        Z_ASSERT_LSTREQUAL(s, sg.j);
+        Z_ASSERT_ZERO(iop_view_get_double(&view, FIELD(*st, "l"), &d));
+        Z_ASSERT_EQ(d, 10.5);
+
+        /* invalid values */
+        Z_ASSERT_NEG(iop_view_init(&view, &tstiop__my_class1__s, LSTR("")));
+        st = &tstiop__my_struct_a__s;
+        packed = t_iop_bpack_struct(st, &sa);
+        packed.len = 3;
+        Z_ASSERT_N(iop_view_init(&view, st, packed));
+        Z_ASSERT_NEG(iop_view_get_int(&view, FIELD(*st, "b"), &i));
+#undef FIELD
+    } Z_TEST_END;
+    /* }}} */
     Z_TEST(equals_and_cmp, "test iop_equals()/iop_cmp()") { /* {{{ */
 #define CHECK_IOP_GT(st, lhs, rhs, ...)                                      \
     Z_HELPER_RUN(z_assert_iop_gt_desc((st), (lhs), (rhs)), ##__VA_ARGS__)
@@ -3800,6 +4508,49 @@ Z_GROUP_EXPORT(iop)
         iop_dso_close(&dso);
     } Z_TEST_END
     /* }}} */
+    Z_TEST(constraints_range, "test IOP @min/@max on arrays") { /* {{{ */
+        int32_t  i32[256];
+        uint64_t u64[] = { 0, 1000, 3 };
+        double   d[] = { 0.5, 1e10, NAN };
+        int32_t  occurs[] = { 1, 2, 3, 4 };
+        tstiop__constraint_range__t r = {
+            .i32 = IOP_TYPED_ARRAY(i32, i32, countof(i32)),
+            .u64 = IOP_TYPED_ARRAY(u64, u64, countof(u64)),
+            .d = IOP_TYPED_ARRAY(double, d, countof(d)),
+            .occurs = IOP_TYPED_ARRAY(i32, occurs, 2),
+        };
+
+        for (int i = 0; i < countof(i32); i++) {
+            i32[i] = i % 21 - 10;
+        }
+        for (int i = 0; i < 2; i++) {
+            /* the second time with the check plan in the cache */
+            Z_ASSERT_N(iop_check_constraints(tstiop__constraint_range, &r));
+        }
+
+        i32[200] = 11;
+        Z_ASSERT_NEG(iop_check_constraints(tstiop__constraint_range, &r));
+        Z_ASSERT(strstr(iop_get_err(), "i32[200]"), "%s", iop_get_err());
+        i32[200] = -11;
+        Z_ASSERT_NEG(iop_check_constraints(tstiop__constraint_range, &r));
+        i32[200] = 0;
+
+        u64[1] = 1001;
+        Z_ASSERT_NEG(iop_check_constraints(tstiop__constraint_range, &r));
+        Z_ASSERT(strstr(iop_get_err(), "u64[1]"), "%s", iop_get_err());
+        u64[1] = 1000;
+
+        d[0] = 0.4;
+        Z_ASSERT_NEG(iop_check_constraints(tstiop__constraint_range, &r));
+        d[0] = 0.5;
+
+        occurs[1] = -1;
+        Z_ASSERT_NEG(iop_check_constraints(tstiop__constraint_range, &r));
+        occurs[1] = 1;
+        r.occurs.len = 4;
+        Z_ASSERT_NEG(iop_check_constraints(tstiop__constraint_range, &r));
+    } Z_TEST_END
+    /* }}} */
     Z_TEST(iop_sort, "test IOP structures/unions sorting") { /* {{{ */
         t_scope;
         qv_t(my_struct_a) vec;
@@ -4386,6 +5137,63 @@ Z_GROUP_EXPORT(iop)
 #undef ADD_PARAM
 #undef SORT_AND_CHECK
 
+    } Z_TEST_END;
+    /* }}} */
+    Z_TEST(iop_sort_radix, "test IOP sorting on integer fields") { /* {{{ */
+        t_scope;
+        qv_t(my_struct_a) vec;
+        tstiop__my_struct_a__t a;
+
+        /* enough values to use the radix sort, with duplicated keys */
+        t_qv_init(&vec, 1000);
+        iop_init(tstiop__my_struct_a, &a);
+        for (int i = 0; i < 1000; i++) {
+            a.a = (i * 7919) % 97 - 48;
+            a.cOfMyStructA = (i * 31) % 256 - 128;
+            a.f = (i * 13) % 300;
+            a.k = i % 3;
+            a.p = i;
+            qv_append(&vec, a);
+        }
+
+#define TST_SORT_VEC(p, f)  \
+        iop_sort(tstiop__my_struct_a, vec.tab, vec.len, LSTR(p), f, NULL)
+
+#define CHECK_SORTED(field, rev)                                             \
+        do {                                                                 \
+            for (int i = 1; i < vec.len; i++) {                              \
+                const tstiop__my_struct_a__t *prev = &vec.tab[i - 1];        \
+                const tstiop__my_struct_a__t *cur = &vec.tab[i];             \
+                                                                             \
+                if (rev) {                                                   \
+                    Z_ASSERT_GE(prev->field, cur->field);                    \
+                } else {                                                     \
+                    Z_ASSERT_LE(prev->field, cur->field);                    \
+                }                                                            \
+            }                                                                \
+        } while (0)
+
+        Z_ASSERT_N(TST_SORT_VEC("a", 0));
+        CHECK_SORTED(a, false);
+        Z_ASSERT_EQ(vec.tab[0].a, -48);
+        Z_ASSERT_N(TST_SORT_VEC("cOfMyStructA", IOP_SORT_REVERSE));
+        CHECK_SORTED(cOfMyStructA, true);
+        Z_ASSERT_EQ(vec.tab[0].cOfMyStructA, 127);
+        Z_ASSERT_N(TST_SORT_VEC("f", 0));
+        CHECK_SORTED(f, false);
+
+        /* the values with equal keys keep their order */
+        Z_ASSERT_N(TST_SORT_VEC("p", 0));
+        Z_ASSERT_N(TST_SORT_VEC("k", 0));
+        CHECK_SORTED(k, false);
+        for (int i = 1; i < vec.len; i++) {
+            if (vec.tab[i - 1].k == vec.tab[i].k) {
+                Z_ASSERT_LT(vec.tab[i - 1].p, vec.tab[i].p);
+            }
+        }
+
+#undef CHECK_SORTED
+#undef TST_SORT_VEC
     } Z_TEST_END;
     /* }}} */
     Z_TEST(iop_filter, "test IOP structures filtering") { /* {{{ */
@@ -4656,6 +5464,184 @@ Z_GROUP_EXPORT(iop)
 
 #undef CHECK_FILTER
 
+    } Z_TEST_END;
+    /* }}} */
+    Z_TEST(iop_batch, "test IOP columnar batches") { /* {{{ */
+        t_scope;
+        SB_1k(err);
+        tstiop__my_struct_a_opt__t *rows = t_new(tstiop__my_struct_a_opt__t,
+                                                 100);
+        lstr_t strs[] = { LSTR("abc"), LSTR("Jkl"), LSTR("xyz") };
+        int32_t a_vals[] = { 3, -5 };
+        int8_t c_vals[] = { -1 };
+        lstr_t j_vals[] = { LSTR("jkl") };
+        void *a_ptrs[] = { &a_vals[0], &a_vals[1] };
+        void *c_ptrs[] = { &c_vals[0] };
+        void *j_ptrs[] = { &j_vals[0] };
+        const iop_struct_t *st = &tstiop__my_struct_a_opt__s;
+        iop_batch_t *batch;
+        const int32_t *col;
+        const byte *is_set;
+        byte *exp;
+        byte *res;
+        int len;
+
+        for (int i = 0; i < 100; i++) {
+            iop_init(tstiop__my_struct_a_opt, &rows[i]);
+            if (i % 7) {
+                OPT_SET(rows[i].a, i % 10 - 5);
+            }
+            if (i % 3) {
+                OPT_SET(rows[i].cOfMyStructA, i % 4 - 2);
+                rows[i].j = strs[i % countof(strs)];
+            }
+        }
+        batch = t_iop_batch_new(st, rows, 100);
+        Z_ASSERT_EQ(iop_batch_get_len(batch), 100);
+        Z_ASSERT(iop_batch_get_row(batch, 42) == &rows[42]);
+
+        col = iop_batch_get_column(batch, LSTR("a"), &is_set);
+        Z_ASSERT_P(col);
+        Z_ASSERT_P(is_set);
+        for (int i = 0; i < 100; i++) {
+            Z_ASSERT_EQ(!!TST_BIT(is_set, i), OPT_ISSET(rows[i].a));
+            Z_ASSERT_EQ(col[i], OPT_DEFVAL(rows[i].a, 0));
+        }
+        Z_ASSERT_NULL(iop_batch_get_column(batch, LSTR("l"), NULL));
+        Z_ASSERT_NEG(t_iop_batch_filter_opt_bitmap(batch, LSTR("u"), true,
+                                                   BITMAP_OP_OR, &res,
+                                                   &err));
+
+        /* the bitmaps are the ones of the filters of the rows */
+#define CHECK_FILTER(field, ptrs, flags, op)                                 \
+        do {                                                                 \
+            Z_ASSERT_N(t_iop_filter_bitmap(st, rows, 100, LSTR(field), ptrs, \
+                                           countof(ptrs), flags, op, &exp,   \
+                                           &err), "%pL", &err);              \
+            Z_ASSERT_N(t_iop_batch_filter_bitmap(batch, LSTR(field), ptrs,   \
+                                                 countof(ptrs), flags, op,   \
+                                                 &res, &err), "%pL", &err);  \
+            Z_ASSERT_EQUAL(res, 13, exp, 13);                                \
+        } while (0)
+
+        exp = res = NULL;
+        CHECK_FILTER("a", a_ptrs, 0, BITMAP_OP_OR);
+        CHECK_FILTER("cOfMyStructA", c_ptrs, 0, BITMAP_OP_AND);
+        exp = res = NULL;
+        CHECK_FILTER("a", a_ptrs, IOP_FILTER_INVERT_MATCH, BITMAP_OP_OR);
+        CHECK_FILTER("j", j_ptrs, 0, BITMAP_OP_OR);
+        exp = res = NULL;
+        CHECK_FILTER("j", j_ptrs, IOP_FILTER_INVERT_MATCH, BITMAP_OP_OR);
+#undef CHECK_FILTER
+
+        exp = res = NULL;
+        Z_ASSERT_N(t_iop_filter_opt_bitmap(st, rows, 100, LSTR("a"), false,
+                                           BITMAP_OP_OR, &exp, &err));
+        Z_ASSERT_N(t_iop_batch_filter_opt_bitmap(batch, LSTR("a"), false,
+                                                 BITMAP_OP_OR, &res, &err));
+        Z_ASSERT_EQUAL(res, 13, exp, 13);
+
+        /* back to the rows */
+        len = 100;
+        iop_filter_bitmap_apply(st, rows, &len, res);
+        Z_ASSERT_EQ(len, 15);
+        for (int i = 0; i < len; i++) {
+            Z_ASSERT(!OPT_ISSET(rows[i].a));
+        }
+    } Z_TEST_END;
+    /* }}} */
+    Z_TEST(iop_pred, "test IOP compiled predicates") { /* {{{ */
+        t_scope;
+        SB_1k(err);
+        const iop_struct_t *st = &tstiop__filtered_struct__s;
+        tstiop__filtered_struct__t *rows = t_new(tstiop__filtered_struct__t,
+                                                 1000);
+        lstr_t strs[] = { LSTR("foo"), LSTR("foobar"), LSTR("bar") };
+        iop_pred_t *pred;
+        byte *bitmap;
+        int len;
+
+        for (int i = 0; i < 1000; i++) {
+            iop_init(tstiop__filtered_struct, &rows[i]);
+            rows[i].a = i % 20 - 10;
+            rows[i].b = i;
+            rows[i].d = i % 256;
+            rows[i].s = strs[i % countof(strs)];
+            if (i % 5 == 0) {
+                rows[i].c = T_IOP_ARRAY(i32, i % 3, 7);
+            }
+            if (i % 4 == 0) {
+                rows[i].longString = LSTR("x");
+            }
+        }
+
+        /* the bitmaps are the ones of the conditions on the rows */
+#define CHECK_PRED(expr, cond)                                               \
+        do {                                                                 \
+            pred = t_iop_pred_compile(st, LSTR(expr), &err);                 \
+            Z_ASSERT_P(pred, "%s: %pL", expr, &err);                         \
+            bitmap = NULL;                                                   \
+            t_iop_pred_filter_bitmap(pred, rows, 1000, BITMAP_OP_OR,         \
+                                     &bitmap);                               \
+            for (int i = 0; i < 1000; i++) {                                 \
+                const tstiop__filtered_struct__t *r = &rows[i];              \
+                                                                             \
+                Z_ASSERT_EQ(!!TST_BIT(bitmap, i), !!(cond),                  \
+                            "%s: row %d", expr, i);                          \
+                Z_ASSERT_EQ(iop_pred_match(pred, r), !!(cond));              \
+            }                                                                \
+        } while (0)
+
+        CHECK_PRED("a < 0", r->a < 0);
+        CHECK_PRED("a >= -3 AND b != 10", r->a >= -3 && r->b != 10);
+        CHECK_PRED("d in (1, 2, 255)",
+                   r->d == 1 || r->d == 2 || r->d == 255);
+        CHECK_PRED("s PREFIX \"foo\"", lstr_startswith(r->s, LSTR("foo")));
+        CHECK_PRED("s > \"c\"", lstr_cmp(r->s, LSTR("c")) > 0);
+        CHECK_PRED("s = \"bar\" OR NOT (a > 5 OR a < -5)",
+                   lstr_equal(r->s, LSTR("bar")) || (r->a <= 5 && r->a >= -5));
+        CHECK_PRED("s IN (\"foo\", \"bar\") and not b in (1, 2, 3)",
+                   (lstr_equal(r->s, LSTR("foo"))
+                 ||  lstr_equal(r->s, LSTR("bar"))) && (r->b < 1 || r->b > 3));
+
+        /* repeated and optional fields */
+        CHECK_PRED("c = 7", r->c.len);
+        CHECK_PRED("c != 7", r->c.len);
+        CHECK_PRED("c[0] IN (0, 2)", r->c.len && r->c.tab[0] != 1);
+        CHECK_PRED("c.len > 1", r->c.len > 1);
+        CHECK_PRED("c IS NOT SET", !r->c.len);
+        CHECK_PRED("longString IS SET and longString = \"x\"",
+                   r->longString.s);
+        CHECK_PRED("longString != \"y\"", r->longString.s);
+#undef CHECK_PRED
+
+        /* in-place */
+        pred = t_iop_pred_compile(st, LSTR("a = 0"), &err);
+        Z_ASSERT_P(pred, "%pL", &err);
+        len = 1000;
+        iop_pred_filter(pred, rows, &len);
+        Z_ASSERT_EQ(len, 50);
+        for (int i = 0; i < len; i++) {
+            Z_ASSERT_EQ(rows[i].a, 0);
+        }
+
+        /* errors */
+#define CHECK_ERROR(expr)                                                    \
+        Z_ASSERT_NULL(t_iop_pred_compile(st, LSTR(expr), &err), expr)
+
+        CHECK_ERROR("");
+        CHECK_ERROR("a <");
+        CHECK_ERROR("a < 1 b");
+        CHECK_ERROR("(a < 1");
+        CHECK_ERROR("e = 1");
+        CHECK_ERROR("a = \"1\"");
+        CHECK_ERROR("d > -1");
+        CHECK_ERROR("s > 1");
+        CHECK_ERROR("s = \"1");
+        CHECK_ERROR("a PREFIX \"1\"");
+        CHECK_ERROR("a IS SET");
+        CHECK_ERROR("a IN ()");
+#undef CHECK_ERROR
     } Z_TEST_END;
     /* }}} */
     Z_TEST(iop_filter_invert_match, "test IOP filtering by fields with invert match") { /* {{{ */
@@ -7406,6 +8392,67 @@ Z_GROUP_EXPORT(iop)
         Z_ASSERT_NULL(res);
     } Z_TEST_END;
     /* }}} */
+    Z_TEST(intern, "test the interning of IOP values") { /* {{{ */
+        t_scope;
+        SB_1k(err);
+        iop_intern_t *in = iop_intern_new();
+        tstiop__my_referenced_struct__t rs1 = { .a = 1 };
+        tstiop__my_referenced_struct__t rs2 = { .a = 1 };
+        tstiop__my_referenced_union__t ru1 =
+            IOP_UNION(tstiop__my_referenced_union, b, 2);
+        tstiop__my_referenced_union__t ru2 =
+            IOP_UNION(tstiop__my_referenced_union, b, 3);
+        tstiop__my_ref_struct__t v1 = { .s = &rs1, .u = &ru1 };
+        tstiop__my_ref_struct__t v2 = { .s = &rs2, .u = &ru1 };
+        tstiop__my_ref_struct__t v3 = { .s = &rs2, .u = &ru2 };
+        const tstiop__my_ref_struct__t *i1, *i2, *i3;
+        const tstiop__full_struct__t *ifs1, *ifs2;
+        tstiop__full_struct__t fs;
+        const char *path;
+
+        i1 = iop_intern(in, tstiop__my_ref_struct, &v1);
+        i2 = iop_intern(in, tstiop__my_ref_struct, &v2);
+        i3 = iop_intern(in, tstiop__my_ref_struct, &v3);
+        Z_ASSERT_IOPEQUAL(tstiop__my_ref_struct, i1, &v1);
+        Z_ASSERT_IOPEQUAL(tstiop__my_ref_struct, i3, &v3);
+        Z_ASSERT(i1 != &v1);
+
+        /* equal values and sub-objects are shared */
+        Z_ASSERT(i1 == i2);
+        Z_ASSERT(i1 != i3);
+        Z_ASSERT(i1->s == i3->s);
+        Z_ASSERT(i1->s != &rs1);
+        Z_ASSERT(i1->u != i3->u);
+        Z_ASSERT_EQ(iop_intern_get_count(in), 5);
+
+        /* the canonical copies are freed with their last reference */
+        iop_intern_release(in, tstiop__my_ref_struct, i3);
+        Z_ASSERT_EQ(iop_intern_get_count(in), 3);
+        iop_intern_release(in, tstiop__my_ref_struct, i2);
+        Z_ASSERT_EQ(iop_intern_get_count(in), 3);
+        iop_intern_release(in, tstiop__my_ref_struct, i1);
+        Z_ASSERT_EQ(iop_intern_get_count(in), 0);
+
+        /* deep values, with arrays, strings and classes */
+        path = t_fmt("%*pM/samples/z-full-struct.json",
+                     LSTR_FMT_ARG(z_cmddir_g));
+        Z_ASSERT_N(t_iop_junpack_file(path, tstiop__full_struct__sp, &fs, 0,
+                                      NULL, &err), "%pL", &err);
+        ifs1 = iop_intern(in, tstiop__full_struct, &fs);
+        ifs2 = iop_intern(in, tstiop__full_struct,
+                          t_iop_dup(tstiop__full_struct, &fs));
+        Z_ASSERT(ifs1 == ifs2);
+        Z_ASSERT_IOPEQUAL(tstiop__full_struct, ifs1, &fs);
+        Z_ASSERT(ifs1->required.o != fs.required.o);
+        Z_ASSERT(ifs1->required.o->__vptr == fs.required.o->__vptr);
+        iop_intern_release(in, tstiop__full_struct, ifs1);
+        Z_ASSERT_IOPEQUAL(tstiop__full_struct, ifs2, &fs);
+
+        /* the remaining references are freed with the arena */
+        iop_intern_delete(&in);
+        Z_ASSERT_NULL(in);
+    } Z_TEST_END;
+    /* }}} */
     Z_TEST(nr_58558, "avoid leak when copying an IOP with no value") { /* {{{ */
         tstiop__my_struct_c__t st;
         tstiop__my_struct_c__t *p;
@@ -8654,6 +9701,90 @@ Z_GROUP_EXPORT(iop)
         Z_ASSERT_STREQUAL(err.data, error);
     } Z_TEST_END;
     /* }}} */
+    Z_TEST(json_field_order, "test JSON unpacking of unordered members") { /* {{{ */
+        t_scope;
+        tstiop__my_struct_d__t sd;
+        tstiop__my_class3__t *cls3 = NULL;
+        tstiop__my_class3__t *cls3_rev = NULL;
+        pstream_t json;
+
+#define UNPACK_D(str)                                                        \
+        ({ json = ps_initstr(str);                                           \
+           t_iop_junpack_ps(&json, &tstiop__my_struct_d__s, &sd, 0, NULL); })
+
+        Z_ASSERT_N(UNPACK_D("{ \"a\": 1, \"b\": 2 }"));
+        Z_ASSERT_EQ(sd.a, 1);
+        Z_ASSERT_EQ(sd.b, 2);
+        Z_ASSERT_N(UNPACK_D("{ \"b\": 3, \"a\": 4 }"));
+        Z_ASSERT_EQ(sd.a, 4);
+        Z_ASSERT_EQ(sd.b, 3);
+
+        /* duplicated members are detected whatever their order is */
+        Z_ASSERT_NEG(UNPACK_D("{ \"a\": 1, \"a\": 2 }"));
+        Z_ASSERT_NEG(UNPACK_D("{ \"a\": 1, \"b\": 2, \"a\": 3 }"));
+        Z_ASSERT_NEG(UNPACK_D("{ \"b\": 1, \"a\": 2, \"b\": 3 }"));
+#undef UNPACK_D
+
+        /* the fields of the parent classes come first when packed */
+        json = ps_initstr("{ \"_class\": \"tstiop.MyClass3\", \"int1\": 1, "
+                          "\"int2\": 2, \"int3\": 3, \"bool1\": true }");
+        Z_ASSERT_N(t_iop_junpack_ptr_ps(&json, &tstiop__my_class3__s,
+                                        (void **)&cls3, 0, NULL));
+        json = ps_initstr("{ \"bool1\": true, \"int3\": 3, \"int2\": 2, "
+                          "\"_class\": \"tstiop.MyClass3\", \"int1\": 1 }");
+        Z_ASSERT_N(t_iop_junpack_ptr_ps(&json, &tstiop__my_class3__s,
+                                        (void **)&cls3_rev, 0, NULL));
+        Z_ASSERT_EQ(cls3->int1, 1);
+        Z_ASSERT_EQ(cls3->int3, 3);
+        Z_ASSERT_IOPEQUAL(tstiop__my_class3, cls3, cls3_rev);
+
+        json = ps_initstr("{ \"_class\": \"tstiop.MyClass3\", \"int1\": 1, "
+                          "\"int2\": 2, \"int3\": 3, \"bool1\": true, "
+                          "\"int1\": 4 }");
+        Z_ASSERT_NEG(t_iop_junpack_ptr_ps(&json, &tstiop__my_class3__s,
+                                          (void **)&cls3, 0, NULL));
+    } Z_TEST_END;
+    /* }}} */
+    Z_TEST(json_escaping, "test the escaping of the JSON strings") { /* {{{ */
+        t_scope;
+        const char *specials[] = { "\"", "\\", "\n", "\x01", "é", "\t" };
+        const char *prefix = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+        const char *suffix = "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb";
+        tstiop__my_struct_f__t sf;
+        tstiop__my_struct_f__t *sf_res = NULL;
+        lstr_t str;
+        SB_1k(sb);
+
+        iop_init(tstiop__my_struct_f, &sf);
+        sf.a = (iop_array_lstr_t)IOP_ARRAY(&str, 1);
+
+        /* the special characters are escaped wherever they are, inside and
+         * after the blocks of 16 bytes that are scanned at once */
+        for (int len = 0; len < 40; len++) {
+            carray_for_each_entry(special, specials) {
+                for (int pos = 0; pos <= len; pos++) {
+                    pstream_t ps;
+
+                    str = t_lstr_fmt("%*pM%s%*pM", pos, prefix, special,
+                                     len - pos, suffix);
+                    sb_reset(&sb);
+                    Z_ASSERT_N(iop_sb_jpack(&sb, &tstiop__my_struct_f__s, &sf,
+                                            IOP_JPACK_MINIMAL));
+                    Z_ASSERT_NULL(memchr(sb.data, '\n', sb.len));
+                    ps = ps_initsb(&sb);
+                    sf_res = NULL;
+                    Z_ASSERT_N(t_iop_junpack_ptr_ps(&ps,
+                                                    &tstiop__my_struct_f__s,
+                                                    (void **)&sf_res, 0,
+                                                    NULL), "%*pM",
+                               SB_FMT_ARG(&sb));
+                    Z_ASSERT_EQ(sf_res->a.len, 1);
+                    Z_ASSERT_LSTREQUAL(sf_res->a.tab[0], str);
+                }
+            }
+        }
+    } Z_TEST_END;
+    /* }}} */
     Z_TEST(repeated_field_removal, "repeated field removal") { /* {{{ */
         t_scope;
         lstr_t data;
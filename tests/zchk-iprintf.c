@@ -36,6 +36,52 @@ Z_GROUP_EXPORT(iprintf) {
         Z_ASSERT_STREQUAL(buffer, "+Inf");
     } Z_TEST_END;
 
+    Z_TEST(double_digits, "") {
+        uint64_t bits = 0x9e3779b97f4a7c15ULL;
+        char ref[128];
+        char buffer[128];
+
+        /* the digits are computed by a fast path with a dtoa() fallback,
+         * they must be the correctly rounded ones of the libc */
+#define T(_fmt)                                                              \
+        do {                                                                 \
+            snprintf(ref, sizeof(ref), _fmt, d);                             \
+            isprintf(buffer, _fmt, d);                                       \
+            Z_ASSERT_STREQUAL(buffer, ref, "format: %s, value: %a",          \
+                              _fmt, d);                                      \
+        } while (0)
+
+        for (int i = 0; i < 20000; i++) {
+            double d;
+
+            bits ^= bits << 13;
+            bits ^= bits >> 7;
+            bits ^= bits << 17;
+            switch (i % 3) {
+              case 0:
+                memcpy(&d, &bits, sizeof(d));
+                break;
+              case 1:
+                d = (double)(bits % 100000000) / 1000;
+                break;
+              default:
+                d = ldexp(bits & 0xffff, (int)(bits >> 48) % 2200 - 1100);
+                break;
+            }
+            if (!isfinite(d)) {
+                continue;
+            }
+            T("%.17g");
+            T("%.15g");
+            T("%g");
+            T("%.1g");
+            T("%e");
+            T("%.16e");
+            T("%#.17g");
+        }
+#undef T
+    } Z_TEST_END;
+
     Z_TEST(pM, "") {
         char buffer[128];
 
@@ -171,6 +217,55 @@ Z_GROUP_EXPORT(iprintf) {
 
 #undef T
     } Z_TEST_END;
+
+    Z_TEST(pre_parsed, "") {
+        char ref[256];
+        char buffer[256];
+        const lstr_t str = LSTR_IMMED("1234");
+        SB_1k(sb);
+
+#define T(_fmt, ...)                                                          \
+    do {                                                                     \
+        int _len = isprintf(ref, _fmt, ##__VA_ARGS__);                       \
+                                                                             \
+        Z_ASSERT_EQ(isnprintf_cached(buffer, sizeof(buffer), _fmt,           \
+                                     ##__VA_ARGS__), _len,                   \
+                    "format: %s", _fmt);                                     \
+        Z_ASSERT_STREQUAL(buffer, ref, "format: %s", _fmt);                  \
+        sb_reset(&sb);                                                       \
+        Z_ASSERT_EQ(sb_addf_cached(&sb, _fmt, ##__VA_ARGS__), _len);         \
+        Z_ASSERT_STREQUAL(sb.data, ref, "format: %s", _fmt);                 \
+    } while (0)
+
+        T("no conversion");
+        T("100%% %%s%%");
+        T("%d|%c|%lld|%d|%d|%u|%d|\n", 1178096605, 'A', 33612345678LL,
+          -12, 0, 1U, INT_MIN);
+        T("%i %hd %hhd %ld %zd %jd", -1, (short)-2, (char)-3, LONG_MIN,
+          (ssize_t)-5, (intmax_t)6);
+        T("%u %hu %hhu %lu %llu %zu", UINT_MAX, (unsigned short)65535,
+          (unsigned char)255, ULONG_MAX, 0ULL, (size_t)42);
+        T("%x %X %lx %llX %hhx", 0xdeadbeefU, 0xcafeU, 0UL, ~0ULL,
+          (unsigned char)0xab);
+        T("[%s] [%.*s]", "str", 2, "abc");
+        T("%5d|%-5d|%05d|%3d|%08x|%-8X|%012lu|", -42, -42, -42, 123456,
+          0xabcU, 0xabcU, 123UL);
+        T("%-3c|%3c|%8s|%-8s|%2s|", 'x', 'y', "abc", "abc", "abcdef");
+        T("%+d|% d|%.3d|%5.2s", 4, 5, 6, "abc");
+        T("%#x|%#o|%8.3f|%g|%e|%p", 255U, 8U, 3.14159, 0.5, 1e10,
+          (void *)0x1234);
+        T("%'d %*d %-*s|", 1234567, 6, 42, 4, "ab");
+        T("%*pM|%*pX|%*px|%pL;", 3, "1234", 2, "\x01\xff", 2, "\x01\xff",
+          &str);
+        T("%c%c%c", 'a', 'b', 'c');
+
+#undef T
+
+        /* the output is truncated as with isnprintf() */
+        Z_ASSERT_EQ(isnprintf_cached(buffer, 4, "%s-%d", "abcdef", 12), 9);
+        Z_ASSERT_STREQUAL(buffer, "abc");
+        Z_ASSERT_EQ(isnprintf_cached(NULL, 0, "%s-%d", "abcdef", 12), 9);
+    } Z_TEST_END;
 } Z_GROUP_END
 
 /* LCOV_EXCL_STOP */
@@ -16,6 +16,9 @@
 /*                                                                         */
 /***************************************************************************/
 
+#include <pthread.h>
+
+#include <lib-common/qpage.h>
 #include <lib-common/z.h>
 
 /*{{{1 Memory Pool Macros */
@@ -148,6 +151,30 @@ Z_GROUP_EXPORT(mem_pool_macros) {
 /*}}}1*/
 /*{{{1 FIFO Pool */
 
+/* Free the odd (resp. even) entries of an array of 64 pointers whose first
+ * entry is the pool. */
+static void *z_free_odd_thr(void *arg)
+{
+    void **objs = arg;
+    mem_pool_t *pool = objs[0];
+
+    for (int i = 1; i < 64; i += 2) {
+        mp_delete(pool, &objs[i]);
+    }
+    return NULL;
+}
+
+static void *z_free_even_thr(void *arg)
+{
+    void **objs = arg;
+    mem_pool_t *pool = objs[0];
+
+    for (int i = 2; i < 64; i += 2) {
+        mp_delete(pool, &objs[i]);
+    }
+    return NULL;
+}
+
 Z_GROUP_EXPORT(fifo)
 {
     Z_TEST(fifo_pool, "fifo_pool:allocate an amount near pool page size") {
@@ -173,11 +200,121 @@ Z_GROUP_EXPORT(fifo)
 
         mem_fifo_pool_delete(&pool);
     } Z_TEST_END
+
+    Z_TEST(fifo_pool_remote_free, "fifo_pool: free from another thread") {
+        mem_pool_t *pool;
+        void *objs[64];
+        pthread_t thr;
+        ssize_t allocated;
+        ssize_t used;
+
+        if (!mem_pool_is_enabled()) {
+            Z_SKIP("memory pools are disabled");
+        }
+        pool = mem_fifo_pool_new("fifo.remote_free", 0);
+        objs[0] = pool;
+        for (int i = 1; i < countof(objs); i++) {
+            objs[i] = mp_new(pool, char, 100);
+        }
+        Z_ASSERT_ZERO(pthread_create(&thr, NULL, &z_free_odd_thr, objs));
+        Z_ASSERT_ZERO(pthread_join(thr, NULL));
+
+        /* the remote frees are processed on the next allocation */
+        mp_delete(pool, &objs[2]);
+        objs[2] = mp_new(pool, char, 100);
+        mem_fifo_pool_stats(pool, &allocated, &used);
+        Z_ASSERT_LT(used, 2 * 100 * 32);
+
+        /* blocks freed remotely after the pool deletion */
+        mem_fifo_pool_delete(&pool);
+        Z_ASSERT_P(pool);
+        Z_ASSERT_ZERO(pthread_create(&thr, NULL, &z_free_even_thr, objs));
+        Z_ASSERT_ZERO(pthread_join(thr, NULL));
+        Z_ASSERT_NULL(pool);
+    } Z_TEST_END
+} Z_GROUP_END
+
+/*1}}}*/
+/*{{{1 Slab Pool */
+
+Z_GROUP_EXPORT(slab)
+{
+    Z_TEST(slab_pool, "slab_pool: allocate and free in random order") {
+        mem_pool_t *pool = mem_slab_pool_new("slab.slab_pool", 0);
+        void *objs[1000];
+        ssize_t allocated = 0;
+        ssize_t used = 0;
+        char *p;
+
+        for (int i = 0; i < countof(objs); i++) {
+            size_t size = 1 + (i * 37) % MEM_SLAB_MAX_SIZE;
+
+            objs[i] = mp_new(pool, char, size);
+            Z_ASSERT_ZERO(((uintptr_t)objs[i]) % 16);
+            for (size_t j = 0; j < size; j++) {
+                Z_ASSERT_ZERO(((char *)objs[i])[j]);
+            }
+            memset(objs[i], 'a', size);
+        }
+        mem_slab_pool_stats(pool, &allocated, &used);
+        if (mem_pool_is_enabled()) {
+            Z_ASSERT_GE(allocated, used);
+            Z_ASSERT_GT(used, 0);
+        }
+        for (int i = 0; i < countof(objs); i += 3) {
+            mp_delete(pool, &objs[i]);
+        }
+        for (int i = 0; i < countof(objs); i++) {
+            mp_delete(pool, &objs[i]);
+        }
+
+        /* big and aligned allocations */
+        p = mp_new(pool, char, 3 * MEM_SLAB_MAX_SIZE);
+        Z_ASSERT_ZERO(p[3 * MEM_SLAB_MAX_SIZE - 1]);
+        p = mp_irealloc(pool, p, 3 * MEM_SLAB_MAX_SIZE, 16, 1, MEM_RAW);
+        mp_delete(pool, &p);
+        p = mpa_new(pool, char, 100, 64);
+        Z_ASSERT_ZERO(((uintptr_t)p) % 64);
+        p = mp_irealloc(pool, p, 100, 200, 64, 0);
+        Z_ASSERT_ZERO(((uintptr_t)p) % 64);
+        Z_ASSERT_ZERO(p[199]);
+        mp_delete(pool, &p);
+
+        mem_slab_pool_delete(&pool);
+        Z_ASSERT_NULL(pool);
+    } Z_TEST_END
+
+    Z_TEST(slab_pool_threads, "slab_pool: free from another thread") {
+        mem_pool_t *pool = mem_slab_pool_new("slab.slab_pool_threads", 256);
+        void *objs[64];
+        pthread_t thr;
+
+        objs[0] = pool;
+        for (int i = 1; i < countof(objs); i++) {
+            objs[i] = mp_new(pool, char, 48);
+        }
+        Z_ASSERT_ZERO(pthread_create(&thr, NULL, &z_free_odd_thr, objs));
+        Z_ASSERT_ZERO(pthread_join(thr, NULL));
+        for (int i = 2; i < countof(objs); i += 2) {
+            mp_delete(pool, &objs[i]);
+        }
+        mem_slab_pool_delete(&pool);
+    } Z_TEST_END
 } Z_GROUP_END
 
 /*1}}}*/
 /*{{{1 Memstack */
 
+static void z_window_stats_cb(const mem_pool_window_stats_t *stats,
+                              void *data)
+{
+    mem_pool_window_stats_t *res = data;
+
+    if (stats->pool == res->pool) {
+        *res = *stats;
+    }
+}
+
 Z_GROUP_EXPORT(core_mem_stack) {
     Z_TEST(big_alloc_mean, "non regression on #39120") {
         mem_stack_pool_t sp;
@@ -206,11 +343,173 @@ Z_GROUP_EXPORT(core_mem_stack) {
         mem_stack_pop(sp);
         mem_stack_delete(&sp);
     } Z_TEST_END;
+
+    Z_TEST(huge_pages, "huge pages backed blocks") {
+        mem_stack_pool_t sp;
+        char *p;
+
+        mem_stack_pool_init_flags(&sp, "core_mem_stack.huge_pages", 0,
+                                  MEM_POOL_HUGE_PAGES);
+        mem_stack_pool_push(&sp);
+
+        /* Huge pages may not be available on the host, in which case the
+         * blocks silently fall back on the regular allocator. */
+        p = mp_new(&sp.funcs, char, 4 << 20);
+        Z_ASSERT_P(p);
+        Z_ASSERT_ZERO(p[(4 << 20) - 1]);
+        memset(p, 'a', 4 << 20);
+        Z_ASSERT_LE(sp.huge_stacksize, sp.stacksize);
+
+        mem_stack_pool_pop(&sp);
+        mem_stack_pool_wipe(&sp);
+        Z_ASSERT_ZERO(sp.huge_stacksize);
+    } Z_TEST_END
+
+    Z_TEST(frames_hwm, "retain the blocks up to the frames high-water") {
+        mem_stack_pool_t sp;
+        mem_pool_window_stats_t stats = { .pool = &sp };
+        uint32_t churn;
+
+        if (!mem_pool_is_enabled()) {
+            Z_SKIP("memory pools are disabled");
+        }
+        mem_stack_pool_init(&sp, "core_mem_stack.frames_hwm", 64 << 10);
+
+        mem_stack_pool_push(&sp);
+        for (int i = 0; i < 3; i++) {
+            Z_ASSERT_P(mp_new_raw(&sp.funcs, char, 1 << 20));
+        }
+        mem_stack_pool_pop(&sp);
+
+        mem_stack_pools_window_stats(&z_window_stats_cb, &stats);
+        Z_ASSERT_STREQUAL(stats.name, "core_mem_stack.frames_hwm");
+        Z_ASSERT_GE(stats.hwm, 1U << 20);
+        Z_ASSERT_GT(stats.churn, 0U);
+        Z_ASSERT_EQ(stats.size, sp.stacksize);
+
+        /* the reset keeps what the frames needed, so the same burst does
+         * not create any block */
+        mem_stack_pool_reset(&sp);
+        Z_ASSERT_GE(sp.stacksize, stats.hwm);
+        churn = mem_window_churn(&sp.window);
+
+        mem_stack_pool_push(&sp);
+        for (int i = 0; i < 3; i++) {
+            Z_ASSERT_P(mp_new_raw(&sp.funcs, char, 1 << 20));
+        }
+        mem_stack_pool_pop(&sp);
+        Z_ASSERT_EQ(mem_window_churn(&sp.window), churn);
+
+        mem_stack_pool_wipe(&sp);
+    } Z_TEST_END
+
+    Z_TEST(decay, "retain the destroyed blocks for the decay delay") {
+        mem_stack_pool_t sp;
+        int delay = mem_decay_delay_g;
+        size_t retained;
+
+        if (!mem_pool_is_enabled()) {
+            Z_SKIP("memory pools are disabled");
+        }
+#ifndef MADV_FREE
+        Z_SKIP("MADV_FREE is not supported");
+#endif
+        mem_decay_set_delay(3600);
+        mem_stack_pool_init(&sp, "core_mem_stack.decay", 64 << 10);
+
+        /* the block of the first frame is too small for the second one,
+         * it is destroyed but kept aside */
+        mem_stack_pool_push(&sp);
+        Z_ASSERT_P(mp_new_raw(&sp.funcs, char, 1 << 20));
+        mem_stack_pool_pop(&sp);
+        mem_stack_pool_push(&sp);
+        Z_ASSERT_P(mp_new_raw(&sp.funcs, char, 16 << 20));
+        mem_stack_pool_pop(&sp);
+
+        retained = sp.retained_size;
+        Z_ASSERT_GE(retained, 1U << 20);
+        Z_ASSERT_EQ(sp.decayed_size, 0U);
+
+        /* the wipe releases everything */
+        mem_stack_pool_wipe(&sp);
+        Z_ASSERT_EQ(sp.retained_size, 0U);
+        Z_ASSERT_GE(sp.decayed_size, retained);
+
+        /* without delay, the blocks are released right away */
+        mem_decay_set_delay(0);
+        mem_stack_pool_init(&sp, "core_mem_stack.decay", 64 << 10);
+        mem_stack_pool_push(&sp);
+        Z_ASSERT_P(mp_new_raw(&sp.funcs, char, 1 << 20));
+        mem_stack_pool_pop(&sp);
+        mem_stack_pool_push(&sp);
+        Z_ASSERT_P(mp_new_raw(&sp.funcs, char, 16 << 20));
+        mem_stack_pool_pop(&sp);
+        Z_ASSERT_EQ(sp.retained_size, 0U);
+        mem_stack_pool_wipe(&sp);
+
+        mem_decay_set_delay(delay);
+    } Z_TEST_END
+
+    Z_TEST(checkpoint, "rewind a part of a frame") {
+        mem_stack_pool_t sp;
+        mem_stack_checkpoint_t cp;
+        int *kept;
+        char *p, *q;
+
+        if (!mem_pool_is_enabled()) {
+            Z_SKIP("memory pools are disabled");
+        }
+        mem_stack_pool_init(&sp, "core_mem_stack.checkpoint", 64 << 10);
+        mem_stack_pool_push(&sp);
+
+        kept = mp_new(&sp.funcs, int, 16);
+        kept[15] = 42;
+        cp = mem_stack_pool_checkpoint(&sp);
+
+        p = mp_new_raw(&sp.funcs, char, 32);
+        mem_stack_pool_rewind(&sp, &cp);
+        q = mp_new_raw(&sp.funcs, char, 32);
+        Z_ASSERT(p == q);
+
+        /* rewind across blocks, several times */
+        for (int i = 0; i < 2; i++) {
+            mem_stack_pool_rewind(&sp, &cp);
+            Z_ASSERT_P(mp_new_raw(&sp.funcs, char, 1 << 20));
+            Z_ASSERT(sp.stack->blk != cp.blk);
+            mem_stack_pool_rewind(&sp, &cp);
+            Z_ASSERT(sp.stack->blk == cp.blk);
+            q = mp_new_raw(&sp.funcs, char, 32);
+            Z_ASSERT(p == q);
+        }
+        Z_ASSERT_EQ(kept[15], 42);
+
+        mem_stack_pool_pop(&sp);
+        mem_stack_pool_wipe(&sp);
+    } Z_TEST_END
 } Z_GROUP_END
 
 /*}}}1*/
 /*{{{1 Memring */
 
+/* Check and release an array of sealed frames whose cookies are in the
+ * odd entries, the even entries pointing on the data of the frames. */
+static void *z_release_frames_thr(void *arg)
+{
+    void **frames = arg;
+
+    for (int i = 0; i < 32; i += 2) {
+        int *data = frames[i + 1];
+
+        for (int j = 0; j < 1024; j++) {
+            if (data[j] != i + j) {
+                return frames;
+            }
+        }
+        mem_ring_release(frames[i]);
+    }
+    return NULL;
+}
+
 Z_GROUP_EXPORT(core_mem_ring) {
     Z_TEST(big_alloc_mean, "non regression on #39120") {
         mem_pool_t *rp = mem_ring_new("core_mem_ring.big_alloc_mean", 0);
@@ -224,6 +523,177 @@ Z_GROUP_EXPORT(core_mem_ring) {
         mem_ring_release(rframe);
         mem_ring_delete(&rp);
     } Z_TEST_END
+
+    Z_TEST(footprint_node, "per NUMA node footprint") {
+        mem_pool_t *rp = mem_ring_new("core_mem_ring.footprint_node", 0);
+        size_t node_size = 0;
+
+        for (int i = 0; i < mem_numa_nodes_count(); i++) {
+            node_size += mem_ring_memory_footprint_node(rp, i);
+        }
+        Z_ASSERT_GT(node_size, 0U);
+        Z_ASSERT_LT(node_size, mem_ring_memory_footprint(rp));
+        Z_ASSERT_ZERO(mem_ring_memory_footprint_node(rp, MEM_NUMA_NODES_MAX));
+        if (!mem_numa_is_enabled()) {
+            Z_ASSERT_EQ(node_size, mem_ring_memory_footprint_node(rp, 0));
+        }
+        mem_ring_delete(&rp);
+    } Z_TEST_END
+
+    Z_TEST(release_remote, "sealed frames released by another thread") {
+        mem_pool_t *rp = mem_ring_new("core_mem_ring.release_remote", 0);
+        const void *frames[32];
+        const void *frame;
+        pthread_t thr;
+        void *res;
+
+        for (int i = 0; i < countof(frames); i += 2) {
+            int *data;
+
+            frames[i] = mem_ring_newframe(rp);
+            data = mp_new_raw(rp, int, 1024);
+            for (int j = 0; j < 1024; j++) {
+                data[j] = i + j;
+            }
+            frames[i + 1] = data;
+            Z_ASSERT(mem_ring_seal(rp) == frames[i]);
+        }
+        /* one frame is shared, and released once more here */
+        Z_ASSERT(mem_ring_retain(frames[4]) == frames[4]);
+
+        Z_ASSERT_ZERO(pthread_create(&thr, NULL, &z_release_frames_thr,
+                                     frames));
+        /* the owner keeps on allocating meanwhile */
+        for (int i = 0; i < 100; i++) {
+            frame = mem_ring_newframe(rp);
+            Z_ASSERT_P(mp_new(rp, char, 4096));
+            mem_ring_seal(rp);
+            mem_ring_release(frame);
+        }
+        Z_ASSERT_ZERO(pthread_join(thr, &res));
+        Z_ASSERT_NULL(res, "data of a frame overwritten");
+        mem_ring_release(frames[4]);
+
+        /* the ring is deleted by the last release */
+        frame = mem_ring_newframe(rp);
+        Z_ASSERT_P(mp_new(rp, char, 100));
+        mem_ring_seal(rp);
+        mem_ring_delete(&rp);
+        Z_ASSERT_NULL(rp);
+        mem_ring_release(frame);
+    } Z_TEST_END
+} Z_GROUP_END
+
+/*}}}1*/
+/*{{{1 Allocation profiler */
+
+Z_GROUP_EXPORT(mem_prof) {
+    Z_TEST(collapsed, "mem_prof: collapsed stacks of the samples") {
+        mem_pool_t *pool = mem_fifo_pool_new("mem_prof.collapsed", 0);
+        SB_1k(sb);
+        void *p;
+
+        mem_prof_reset();
+        mem_prof_start(1);
+        for (int i = 0; i < 10; i++) {
+            p = mp_new_raw(pool, char, 100);
+            mp_delete(pool, &p);
+        }
+        mem_prof_stop();
+        mem_fifo_pool_delete(&pool);
+
+        mem_prof_dump_collapsed(&sb);
+        if (mem_pool_is_enabled()) {
+            Z_ASSERT(strstr(sb.data, "mem_prof.collapsed;"), "%s", sb.data);
+            Z_ASSERT(strstr(sb.data, " 1000\n"), "%s", sb.data);
+        }
+        mem_prof_reset();
+        sb_reset(&sb);
+        mem_prof_dump_collapsed(&sb);
+        Z_ASSERT_ZERO(sb.len);
+    } Z_TEST_END
+} Z_GROUP_END
+
+/*}}}1*/
+/*{{{1 QPage */
+
+Z_GROUP_EXPORT(qpage) {
+    MODULE_REQUIRE(qpage);
+
+    Z_TEST(thread_cache, "qpage: per-thread cache of freed runs") {
+        uint32_t seg;
+        uint32_t seg2;
+        uint8_t *p;
+        uint8_t *q;
+
+        p = qpage_alloc_n(4, &seg);
+        Z_ASSERT_P(p);
+        memset(p, 0xaa, 4 * QPAGE_SIZE);
+        qpage_free_n(p, 4, seg);
+
+        /* A run of the same size is served from the thread cache, and must
+         * still be zeroed by qpage_alloc_n(). */
+        q = qpage_alloc_n(4, &seg2);
+        Z_ASSERT(q == p);
+        Z_ASSERT_EQ(seg2, seg);
+        for (size_t i = 0; i < 4 * QPAGE_SIZE; i++) {
+            Z_ASSERT_ZERO(q[i], "page not zeroed at offset %zu", i);
+        }
+
+        /* Partial frees bypass the cache. */
+        qpage_free_n(q + QPAGE_SIZE, 3, seg2);
+        qpage_free_n(q, 1, seg2);
+
+        p = qpage_allocraw_n(2, &seg);
+        Z_ASSERT_P(p);
+        qpage_free_n_noseg(p, 2);
+        q = qpage_allocraw_align(2, 1, &seg2);
+        Z_ASSERT_P(q);
+        Z_ASSERT_ZERO(((uintptr_t)q >> QPAGE_SHIFT) & 1);
+        qpage_free_n(q, 2, seg2);
+    } Z_TEST_END
+
+    Z_TEST(zero_reserve, "qpage: pre-zeroed reserve") {
+        qpage_zero_reserve_stats_t stats;
+        uint32_t seg;
+        uint32_t seg2;
+        uint8_t *p;
+        uint8_t *q;
+
+        Z_ASSERT_N(qpage_zero_reserve_set_depth(2));
+
+        /* the first allocation misses, and asks for runs of its size */
+        p = qpage_alloc_n(3, &seg);
+        Z_ASSERT_P(p);
+        for (int i = 0; i < 1000; i++) {
+            qpage_zero_reserve_stats(&stats);
+            if (stats.runs) {
+                break;
+            }
+            usleep(10000);
+        }
+        Z_ASSERT_EQ(stats.depth, 2U);
+        Z_ASSERT_GE(stats.misses, 1U);
+        Z_ASSERT_GE(stats.runs, 1U);
+
+        q = qpage_alloc_n(3, &seg2);
+        Z_ASSERT_P(q);
+        for (size_t i = 0; i < 3 * QPAGE_SIZE; i++) {
+            Z_ASSERT_ZERO(q[i], "page not zeroed at offset %zu", i);
+        }
+        qpage_zero_reserve_stats(&stats);
+        Z_ASSERT_GE(stats.hits, 1U);
+
+        qpage_free_n(p, 3, seg);
+        qpage_free_n(q, 3, seg2);
+
+        Z_ASSERT_N(qpage_zero_reserve_set_depth(0));
+        qpage_zero_reserve_stats(&stats);
+        Z_ASSERT_ZERO(stats.depth);
+        Z_ASSERT_ZERO(stats.runs);
+    } Z_TEST_END
+
+    MODULE_RELEASE(qpage);
 } Z_GROUP_END
 
 /*}}}1*/
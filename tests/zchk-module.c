@@ -18,6 +18,7 @@
 
 #include <lib-common/z.h>
 #include <lib-common/el.h>
+#include <lib-common/thr.h>
 #include <lib-common/core.h>
 
 /* mock module {{{ */
@@ -291,6 +292,83 @@ static MODULE_BEGIN(module_a)
     MODULE_DEPENDS_ON(module_c);
 MODULE_END()
 
+/* }}} */
+/* {{{ Parallel initialization
+ *
+ *          par_root
+ *         /        \
+ *     par_w1     par_w2     (initialized in thr workers)
+ *         \        /
+ *          par_base
+ */
+
+static struct {
+    _Atomic(int) seq;
+    int base;
+    int w1;
+    int w2;
+    int root;
+    bool w1_deps;
+    bool w2_deps;
+} par_state_g;
+
+static int par_base_initialize(void *arg)
+{
+    par_state_g.base = ++par_state_g.seq;
+    return 0;
+}
+
+static int par_w1_initialize(void *arg)
+{
+    par_state_g.w1_deps = MODULE_IS_LOADED(par_base);
+    par_state_g.w1 = ++par_state_g.seq;
+    return 0;
+}
+
+static int par_w2_initialize(void *arg)
+{
+    par_state_g.w2_deps = MODULE_IS_LOADED(par_base);
+    par_state_g.w2 = ++par_state_g.seq;
+    return 0;
+}
+
+static int par_root_initialize(void *arg)
+{
+    par_state_g.root = ++par_state_g.seq;
+    return 0;
+}
+
+#define PAR_SHUTDOWN_FUNCTION(mod)                                           \
+    static int mod##_shutdown(void)                                          \
+    {                                                                        \
+        return 0;                                                            \
+    }
+
+PAR_SHUTDOWN_FUNCTION(par_base)
+PAR_SHUTDOWN_FUNCTION(par_w1)
+PAR_SHUTDOWN_FUNCTION(par_w2)
+PAR_SHUTDOWN_FUNCTION(par_root)
+
+#undef PAR_SHUTDOWN_FUNCTION
+
+static MODULE_BEGIN(par_base)
+MODULE_END()
+
+static MODULE_BEGIN(par_w1)
+    MODULE_DEPENDS_ON(par_base);
+    MODULE_PARALLEL_INIT();
+MODULE_END()
+
+static MODULE_BEGIN(par_w2)
+    MODULE_DEPENDS_ON(par_base);
+    MODULE_PARALLEL_INIT();
+MODULE_END()
+
+static MODULE_BEGIN(par_root)
+    MODULE_DEPENDS_ON(par_w1);
+    MODULE_DEPENDS_ON(par_w2);
+MODULE_END()
+
 /* }}} */
 
 Z_GROUP_EXPORT(module)
@@ -691,6 +769,44 @@ Z_GROUP_EXPORT(module)
                            LSTR(module_get_name(MODULE(module_i))));
     } Z_TEST_END;
 
+/* }}} */
+/* parallel initialization {{{ */
+
+    Z_TEST(parallel, "parallel initialization") {
+        SB_1k(times);
+
+        for (int i = 0; i < 2; i++) {
+            /* first without thr: sequential fallback */
+            if (i == 1) {
+                MODULE_REQUIRE(thr);
+            }
+            p_clear(&par_state_g, 1);
+            MODULE_REQUIRE_PARALLEL(par_root);
+
+            Z_ASSERT(MODULE_IS_LOADED(par_base));
+            Z_ASSERT(MODULE_IS_LOADED(par_w1));
+            Z_ASSERT(MODULE_IS_LOADED(par_w2));
+            Z_ASSERT(MODULE_IS_LOADED(par_root));
+            Z_ASSERT(par_state_g.w1_deps);
+            Z_ASSERT(par_state_g.w2_deps);
+            Z_ASSERT_GT(par_state_g.w1, par_state_g.base);
+            Z_ASSERT_GT(par_state_g.w2, par_state_g.base);
+            Z_ASSERT_GT(par_state_g.root, par_state_g.w1);
+            Z_ASSERT_GT(par_state_g.root, par_state_g.w2);
+
+            /* required once, as with MODULE_REQUIRE */
+            MODULE_RELEASE(par_root);
+            Z_ASSERT(!MODULE_IS_LOADED(par_root));
+            Z_ASSERT(!MODULE_IS_LOADED(par_w1));
+            Z_ASSERT(!MODULE_IS_LOADED(par_base));
+        }
+        MODULE_RELEASE(thr);
+
+        module_debug_dump_init_times(&times);
+        Z_ASSERT(lstr_startswith(LSTR_SB_V(&times), LSTR("nodes;init_us\n")));
+        Z_ASSERT_P(strstr(times.data, "\npar_root;"));
+    } Z_TEST_END;
+
 /* }}} */
 
 } Z_GROUP_END;
@@ -16,8 +16,11 @@
 /*                                                                         */
 /***************************************************************************/
 
+#include <lib-common/arith.h>
 #include <lib-common/z.h>
+#include <lib-common/el.h>
 #include <lib-common/net.h>
+#include <lib-common/unix.h>
 
 /* {{{ net_addr */
 
@@ -211,3 +214,363 @@ Z_GROUP_EXPORT(net_addr)
 } Z_GROUP_END;
 
 /* }}} */
+/* {{{ net_dgram */
+
+static struct {
+    int  batches;
+    int  msgs;
+    bool ordered;
+} zchk_dgram_g;
+
+static void zchk_dgram_on_recv(net_dgram_t *dg, const net_dgram_msg_t *msgs,
+                               int count, data_t priv)
+{
+    zchk_dgram_g.batches++;
+    for (int i = 0; i < count; i++) {
+        char buf[16];
+
+        snprintf(buf, sizeof(buf), "msg %d", zchk_dgram_g.msgs++);
+        if (!lstr_equal(msgs[i].data, LSTR(buf)) || msgs[i].truncated) {
+            zchk_dgram_g.ordered = false;
+        }
+    }
+}
+
+Z_GROUP_EXPORT(net_dgram)
+{
+    Z_TEST(batch, "net_dgram: batched send and receive") {
+        net_dgram_t *tx;
+        net_dgram_t *rx;
+        net_dgram_stats_t stats;
+        data_t priv = { .ptr = NULL };
+        int fds[2];
+
+        Z_ASSERT_N(socketpairx(AF_UNIX, SOCK_DGRAM, 0, O_NONBLOCK, fds));
+        tx = net_dgram_new(fds[0], 8, 64, &zchk_dgram_on_recv, priv);
+        rx = net_dgram_new(fds[1], 8, 64, &zchk_dgram_on_recv, priv);
+        p_clear(&zchk_dgram_g, 1);
+        zchk_dgram_g.ordered = true;
+
+        /* the first 8 datagrams are sent as soon as the batch is full, the
+         * last 4 ones before the loop waits for events */
+        for (int i = 0; i < 12; i++) {
+            char buf[16];
+            int len = snprintf(buf, sizeof(buf), "msg %d", i);
+
+            net_dgram_send(tx, NULL, buf, len);
+        }
+        net_dgram_get_stats(tx, &stats);
+        Z_ASSERT_EQ(stats.send_calls, 1U);
+        Z_ASSERT_EQ(stats.send_msgs, 8U);
+
+        for (int i = 0; i < 10 && zchk_dgram_g.msgs < 12; i++) {
+            el_loop_timeout(10);
+        }
+        Z_ASSERT_EQ(zchk_dgram_g.msgs, 12);
+        Z_ASSERT(zchk_dgram_g.ordered);
+
+        net_dgram_get_stats(tx, &stats);
+        Z_ASSERT_EQ(stats.send_calls, 2U);
+        Z_ASSERT_EQ(stats.send_msgs, 12U);
+        Z_ASSERT_ZERO(stats.send_errors);
+
+        /* at most 8 datagrams are received per call */
+        net_dgram_get_stats(rx, &stats);
+        Z_ASSERT_EQ(stats.recv_msgs, 12U);
+        Z_ASSERT_LE(stats.recv_calls, 3U);
+        Z_ASSERT_GE(zchk_dgram_g.batches, 2);
+
+        net_dgram_delete(&tx);
+        net_dgram_delete(&rx);
+        Z_ASSERT_NULL(tx);
+        Z_ASSERT_NULL(rx);
+    } Z_TEST_END;
+} Z_GROUP_END;
+
+/* }}} */
+/* {{{ net_connect */
+
+static struct {
+    bool done;
+    int  fd;
+    int  count;
+    net_connect_attempt_t attempts[NET_CONNECT_ADDRS_MAX];
+} zchk_connect_g;
+
+static void zchk_connect_on_done(int fd, int err,
+                                 const net_connect_attempt_t *attempts,
+                                 int count, data_t priv)
+{
+    zchk_connect_g.done  = true;
+    zchk_connect_g.fd    = fd;
+    zchk_connect_g.count = count;
+    p_copy(zchk_connect_g.attempts, attempts, count);
+}
+
+Z_GROUP_EXPORT(net_connect)
+{
+    Z_TEST(sort, "net_connect: interleave the address families") {
+        sockunion_t sus[5];
+        const char *addrs[] = { "::1", "::2", "::3", "1.1.1.1", "1.1.1.2" };
+        const char *sorted[] = {
+            "::1", "1.1.1.1", "::2", "1.1.1.2", "::3"
+        };
+
+        for (int i = 0; i < countof(sus); i++) {
+            Z_ASSERT_N(addr_info_str(&sus[i], addrs[i], 80, AF_UNSPEC));
+        }
+        net_connect_sort_addrs(sus, countof(sus));
+        for (int i = 0; i < countof(sus); i++) {
+            Z_ASSERT_LSTREQUAL(t_sockunion_gethost_lstr(&sus[i]),
+                               LSTR(sorted[i]), "%d", i);
+        }
+    } Z_TEST_END;
+
+    Z_TEST(race, "net_connect: skip an unreachable address") {
+        sockunion_t sus[2];
+        net_connect_t *nc;
+        int srv;
+        int port;
+
+        /* the first address is a closed port, the second one listens */
+        Z_ASSERT_N(addr_info_str(&sus[0], "127.0.0.1", 0, AF_INET));
+        srv = listenx(-1, &sus[0], 1, SOCK_STREAM, IPPROTO_TCP, O_NONBLOCK);
+        Z_ASSERT_N(srv);
+        port = getsockport(srv, AF_INET);
+        sus[1] = sus[0];
+        sockunion_setport(&sus[1], port);
+        sockunion_setport(&sus[0], port == 65535 ? port - 1 : port + 1);
+
+        /* the failure of the first attempt starts the second one without
+         * waiting for the delay */
+        p_clear(&zchk_connect_g, 1);
+        nc = net_connect_start(sus, 2, NULL, 10000, 5000,
+                               &zchk_connect_on_done, (data_t){ NULL });
+        Z_ASSERT_P(nc);
+        for (int i = 0; i < 100 && !zchk_connect_g.done; i++) {
+            el_loop_timeout(10);
+        }
+        Z_ASSERT(zchk_connect_g.done);
+        Z_ASSERT_N(zchk_connect_g.fd);
+        Z_ASSERT_EQ(zchk_connect_g.count, 2);
+        Z_ASSERT_EQ(zchk_connect_g.attempts[0].err, ECONNREFUSED);
+        Z_ASSERT_ZERO(zchk_connect_g.attempts[1].err);
+        Z_ASSERT_GE(zchk_connect_g.attempts[1].latency, 0);
+        Z_ASSERT_EQ(sockunion_getport(&zchk_connect_g.attempts[1].su), port);
+
+        p_close(&zchk_connect_g.fd);
+        p_close(&srv);
+    } Z_TEST_END;
+} Z_GROUP_END;
+
+/* }}} */
+/* {{{ net_dns */
+
+static struct {
+    int  queries;
+    bool done;
+    int  results;
+    int  err;
+    int  cnt;
+    sockunion_t su;
+} zchk_dns_g;
+
+/* Fake name server: www.example.com has the address 10.0.0.1 for a minute,
+ * the other names do not exist. */
+static int zchk_dns_on_query(el_t ev, int fd, short events, data_t priv)
+{
+    static const char name[] = "\3www\7example\3com";
+    SB_1k(out);
+    byte buf[512];
+    sockunion_t su;
+    socklen_t su_len = sizeof(su);
+    ssize_t len = recvfrom(fd, buf, sizeof(buf), 0, &su.sa, &su_len);
+    pstream_t ps;
+    pstream_t question;
+    bool found;
+    int c;
+
+    if (len < 12) {
+        return 0;
+    }
+    zchk_dns_g.queries++;
+    ps = ps_init(buf + 12, len - 12);
+    question = ps;
+    while ((c = ps_getc(&ps)) > 0) {
+        ps_skip(&ps, c);
+    }
+    ps_skip(&ps, 4);
+    question.s_end = ps.s;
+    found = ps_len(&question) == sizeof(name) + 4
+         && !memcmp(question.s, name, sizeof(name))
+         && get_unaligned_be16(question.s + sizeof(name)) == 1;
+
+    sb_add(&out, buf, 2);
+    sb_add_be16(&out, found ? 0x8180 : 0x8183);
+    sb_add_be16(&out, 1);
+    sb_add_be16(&out, found);
+    sb_add_be16(&out, 0);
+    sb_add_be16(&out, 0);
+    sb_add(&out, question.s, ps_len(&question));
+    if (found) {
+        sb_add_be16(&out, 0xc00c);
+        sb_add_be16(&out, 1);
+        sb_add_be16(&out, 1);
+        sb_add_be32(&out, 60);
+        sb_add_be16(&out, 4);
+        sb_add_be32(&out, 0x0a000001);
+    }
+    sendto(fd, out.data, out.len, 0, &su.sa, su_len);
+    return 0;
+}
+
+static void zchk_dns_on_result(const sockunion_t *sus, int cnt, int err,
+                               data_t priv)
+{
+    zchk_dns_g.results++;
+    zchk_dns_g.done = true;
+    zchk_dns_g.err  = err;
+    zchk_dns_g.cnt  = cnt;
+    if (cnt) {
+        zchk_dns_g.su = sus[0];
+    }
+}
+
+Z_GROUP_EXPORT(net_dns)
+{
+    MODULE_REQUIRE(dns);
+
+    Z_TEST(resolve, "dns: cache, coalescing and negative answers") {
+        dns_stats_t start;
+        dns_stats_t stats;
+        dns_query_t *queries[2];
+        sockunion_t sus[DNS_ADDRS_MAX];
+        sockunion_t su;
+        el_t srv;
+        int fd;
+
+        Z_ASSERT_N(addr_info_str(&su, "127.0.0.1", 0, AF_INET));
+        fd = bindx(-1, &su, 1, SOCK_DGRAM, IPPROTO_UDP, O_NONBLOCK);
+        Z_ASSERT_N(fd);
+        sockunion_setport(&su, getsockport(fd, AF_INET));
+        srv = el_fd_register(fd, true, POLLIN, &zchk_dns_on_query, NULL);
+        dns_set_servers(&su, 1);
+        dns_cache_flush();
+        dns_get_stats(&start);
+        p_clear(&zchk_dns_g, 1);
+
+        /* two resolutions of the same name share the query */
+        for (int i = 0; i < countof(queries); i++) {
+            queries[i] = dns_resolve(LSTR("WWW.example.com."), AF_INET, 80,
+                                     &zchk_dns_on_result, (data_t){ NULL });
+            Z_ASSERT_P(queries[i]);
+        }
+        for (int i = 0; i < 100 && zchk_dns_g.results < 2; i++) {
+            el_loop_timeout(10);
+        }
+        Z_ASSERT_EQ(zchk_dns_g.results, 2);
+        Z_ASSERT_ZERO(zchk_dns_g.err);
+        Z_ASSERT_EQ(zchk_dns_g.cnt, 1);
+        Z_ASSERT_STREQUAL(t_addr_fmt(&zchk_dns_g.su, NULL), "10.0.0.1:80");
+        Z_ASSERT_EQ(zchk_dns_g.queries, 1);
+
+        /* answered from the cache, synchronously, and by addr_info() */
+        p_clear(&zchk_dns_g, 1);
+        Z_ASSERT_NULL(dns_resolve(LSTR("www.example.com"), AF_INET, 443,
+                                  &zchk_dns_on_result, (data_t){ NULL }));
+        Z_ASSERT(zchk_dns_g.done);
+        Z_ASSERT_STREQUAL(t_addr_fmt(&zchk_dns_g.su, NULL), "10.0.0.1:443");
+        Z_ASSERT_EQ(dns_lookup(LSTR("www.example.com"), AF_INET, 80,
+                               sus, countof(sus)), 1);
+        Z_ASSERT_N(addr_info_str(&su, "www.example.com", 80, AF_INET));
+        Z_ASSERT(sockunion_equal(&su, &sus[0]));
+        Z_ASSERT_ZERO(zchk_dns_g.queries);
+
+        /* unknown names are cached too */
+        p_clear(&zchk_dns_g, 1);
+        queries[0] = dns_resolve(LSTR("nope.example.com"), AF_INET, 80,
+                                 &zchk_dns_on_result, (data_t){ NULL });
+        Z_ASSERT_P(queries[0]);
+        for (int i = 0; i < 100 && !zchk_dns_g.done; i++) {
+            el_loop_timeout(10);
+        }
+        Z_ASSERT_EQ(zchk_dns_g.err, ENOENT);
+        Z_ASSERT_NEG(dns_lookup(LSTR("nope.example.com"), AF_INET, 80,
+                                sus, countof(sus)));
+        Z_ASSERT_EQ(errno, ENOENT);
+        Z_ASSERT_EQ(zchk_dns_g.queries, 1);
+
+        /* the cancelled queries are not called back */
+        p_clear(&zchk_dns_g, 1);
+        queries[0] = dns_resolve(LSTR("other.example.com"), AF_UNSPEC, 80,
+                                 &zchk_dns_on_result, (data_t){ NULL });
+        Z_ASSERT_P(queries[0]);
+        dns_query_cancel(&queries[0]);
+        Z_ASSERT_NULL(queries[0]);
+        for (int i = 0; i < 100 && zchk_dns_g.queries < 2; i++) {
+            el_loop_timeout(10);
+        }
+        el_loop_timeout(10);
+        Z_ASSERT(!zchk_dns_g.done);
+
+        dns_get_stats(&stats);
+        Z_ASSERT_EQ(stats.hits - start.hits, 3u);
+        Z_ASSERT_EQ(stats.negative_hits - start.negative_hits, 1u);
+        Z_ASSERT_EQ(stats.coalesced - start.coalesced, 1u);
+        Z_ASSERT_EQ(stats.queries - start.queries, 4u);
+
+        el_unregister(&srv);
+    } Z_TEST_END;
+
+    MODULE_RELEASE(dns);
+} Z_GROUP_END;
+
+/* }}} */
+/* {{{ net_tbucket */
+
+Z_GROUP_EXPORT(net_tbucket)
+{
+    Z_TEST(nested, "net_tbucket: nested buckets") {
+        net_tbucket_t global;
+        net_tbucket_t clients[2];
+
+        /* without refill */
+        net_tbucket_init(&global, NULL, 0, 3);
+        net_tbucket_init(&clients[0], &global, 0, 2);
+        net_tbucket_init(&clients[1], &global, 0, 2);
+
+        Z_ASSERT(net_tbucket_fire(&clients[0]));
+        Z_ASSERT(net_tbucket_fire(&clients[0]));
+        Z_ASSERT(!net_tbucket_can_fire(&clients[0]));
+        Z_ASSERT(!net_tbucket_fire(&clients[0]));
+
+        /* the last token of the global bucket, the client keeps its own */
+        Z_ASSERT(net_tbucket_fire(&clients[1]));
+        Z_ASSERT(!net_tbucket_fire(&clients[1]));
+        Z_ASSERT(!net_tbucket_can_fire(&global));
+    } Z_TEST_END;
+
+    Z_TEST(refill, "net_tbucket: lazy refill") {
+        net_tbucket_t tb;
+
+        /* a token per second, rewind the clock of the bucket rather than
+         * waiting */
+        net_tbucket_init(&tb, NULL, 1, 1);
+        Z_ASSERT(net_tbucket_fire(&tb));
+        tb.last -= 500000;
+        Z_ASSERT(!net_tbucket_fire(&tb));
+        tb.last -= 600000;
+        Z_ASSERT(net_tbucket_fire(&tb));
+        Z_ASSERT(!net_tbucket_fire(&tb));
+
+        /* no more than the burst */
+        net_tbucket_set_rate(&tb, 1, 5);
+        tb.last -= 10000000;
+        for (int i = 0; i < 5; i++) {
+            Z_ASSERT(net_tbucket_fire(&tb));
+        }
+        Z_ASSERT(!net_tbucket_fire(&tb));
+    } Z_TEST_END;
+} Z_GROUP_END;
+
+/* }}} */
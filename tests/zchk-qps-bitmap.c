@@ -154,6 +154,83 @@ Z_GROUP_EXPORT(qps_bitmap) {
         }
     } Z_TEST_END;
 
+    /* }}} */
+    Z_TEST(bulk_operations, "") { /* {{{ */
+        qps_bitmap_t a;
+        qps_bitmap_t b;
+        qps_bitmap_t res;
+        uint64_t count_a = 0;
+        uint64_t count_and = 0;
+        uint64_t count_or = 0;
+        uint64_t rank = 0;
+        uint32_t row;
+
+        qps_bitmap_init(&a, qps, qps_bitmap_create(qps, false));
+        qps_bitmap_init(&b, qps, qps_bitmap_create(qps, false));
+        qps_bitmap_init(&res, qps, qps_bitmap_create(qps, false));
+
+        /* overlapping ranges, and keys in dispatch nodes of their own */
+        for (uint32_t i = 0; i < 200000; i += 3) {
+            qps_bitmap_set(&a, i);
+        }
+        for (uint32_t i = 100000; i < 300000; i += 5) {
+            qps_bitmap_set(&b, i);
+        }
+        qps_bitmap_set(&a, 0xf0000000);
+        qps_bitmap_set(&b, 0xe0000000);
+        qps_bitmap_set(&b, UINT32_MAX);
+        for (uint32_t i = 0; i < 300000; i++) {
+            bool in_a = qps_bitmap_get(&a, i) == QPS_BITMAP_1;
+            bool in_b = qps_bitmap_get(&b, i) == QPS_BITMAP_1;
+
+            count_a   += in_a;
+            count_and += in_a && in_b;
+            count_or  += in_a || in_b;
+        }
+
+        Z_ASSERT_EQ(qps_bitmap_cardinality(&a), count_a + 1);
+        Z_ASSERT_EQ(qps_bitmap_and_cardinality(&a, &b), count_and);
+
+        qps_bitmap_or(&res, &a);
+        qps_bitmap_and(&res, &b);
+        Z_ASSERT_EQ(qps_bitmap_cardinality(&res), count_and);
+        qps_bitmap_for_each_unsafe(en, &res) {
+            Z_ASSERT_EQ(qps_bitmap_get(&a, en.key.key),
+                        (uint32_t)QPS_BITMAP_1);
+            Z_ASSERT_EQ(qps_bitmap_get(&b, en.key.key),
+                        (uint32_t)QPS_BITMAP_1);
+        }
+
+        qps_bitmap_or(&res, &a);
+        qps_bitmap_or(&res, &b);
+        Z_ASSERT_EQ(qps_bitmap_cardinality(&res), count_or + 3);
+
+        qps_bitmap_andnot(&res, &b);
+        Z_ASSERT_EQ(qps_bitmap_cardinality(&res), count_a + 1 - count_and);
+        Z_ASSERT_EQ(qps_bitmap_get(&res, UINT32_MAX),
+                    (uint32_t)QPS_BITMAP_0);
+        qps_bitmap_andnot(&res, &res);
+        Z_ASSERT_EQ(qps_bitmap_cardinality(&res), 0u);
+        Z_ASSERT_EQ(res.root->roots[0], 0u);
+
+        /* rank and select are the inverses of each other */
+        qps_bitmap_for_each_unsafe(en, &a) {
+            if (rank % 7 == 0) {
+                Z_ASSERT_EQ(qps_bitmap_rank(&a, en.key.key), rank);
+                Z_ASSERT_N(qps_bitmap_select(&a, rank, &row));
+                Z_ASSERT_EQ(row, en.key.key);
+            }
+            rank++;
+        }
+        Z_ASSERT_EQ(qps_bitmap_rank(&a, 1), 1u);
+        Z_ASSERT_EQ(qps_bitmap_rank(&a, UINT32_MAX), count_a + 1);
+        Z_ASSERT_NEG(qps_bitmap_select(&a, rank, &row));
+
+        qps_bitmap_destroy(&res);
+        qps_bitmap_destroy(&b);
+        qps_bitmap_destroy(&a);
+    } Z_TEST_END;
+
     /* }}} */
 
     qps_close(&qps);
@@ -0,0 +1,273 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+/* LCOV_EXCL_START */
+
+#include <math.h>
+#include <lib-common/z.h>
+#include <lib-common/sketch.h>
+
+/* Distinct well-mixed hashes (splitmix64). */
+static uint64_t z_sketch_hash(uint64_t i)
+{
+    i += 0x9e3779b97f4a7c15ULL;
+    i = (i ^ (i >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    i = (i ^ (i >> 27)) * 0x94d049bb133111ebULL;
+    return i ^ (i >> 31);
+}
+
+/* Pack and unpack an IOP sketch, as when it is sent to another node. */
+#define t_z_sketch_iop_copy(pfx, in, out)  ({                                \
+        SB_1k(_buf);                                                         \
+                                                                             \
+        iop_bpack_sb(&_buf, &pfx##__s, (in), 0);                             \
+        t_iop_bunpack_ps(&pfx##__s, (out), ps_initsb(&_buf), true);          \
+    })
+
+Z_GROUP_EXPORT(hll) {
+    Z_TEST(count, "accuracy of the estimation") {
+        int nbs[] = { 0, 1, 100, 1000, 10000, 100000, 1000000 };
+
+        carray_for_each_entry(nb, nbs) {
+            hll_t hll;
+
+            hll_init(&hll, HLL_PRECISION_DEFAULT);
+            for (int i = 0; i < nb; i++) {
+                hll_add_hash(&hll, z_sketch_hash(i));
+                /* Duplicates are not counted. */
+                hll_add_hash(&hll, z_sketch_hash(i / 2));
+            }
+            /* The small cardinalities are exact in practice. */
+            if (nb <= 1000) {
+                Z_ASSERT(!hll.is_dense);
+                Z_ASSERT_EQ(hll_count(&hll), (uint64_t)nb);
+            } else {
+                Z_ASSERT_LT(fabs((double)hll_count(&hll) - nb), nb * 0.04,
+                            "%d keys", nb);
+            }
+            hll_wipe(&hll);
+        }
+    } Z_TEST_END;
+
+    Z_TEST(merge, "merge of sparse and dense sketches") {
+        int nbs[] = { 10, 100000 };
+
+        carray_for_each_entry(nb_a, nbs) {
+            carray_for_each_entry(nb_b, nbs) {
+                hll_t *a = hll_new(12);
+                hll_t *b = hll_new(12);
+                hll_t *all = hll_new(12);
+                hll_t *other = hll_new(10);
+
+                for (int i = 0; i < nb_a; i++) {
+                    hll_add_hash(a, z_sketch_hash(i));
+                    hll_add_hash(all, z_sketch_hash(i));
+                }
+                for (int i = 0; i < nb_b; i++) {
+                    hll_add_hash(b, z_sketch_hash(i + 1000000));
+                    hll_add_hash(all, z_sketch_hash(i + 1000000));
+                }
+                Z_ASSERT_N(hll_merge(a, b));
+                Z_ASSERT_EQ(hll_count(a), hll_count(all));
+                Z_ASSERT_EQ(a->is_dense, all->is_dense);
+                if (a->is_dense) {
+                    Z_ASSERT_EQUAL(a->dense, 1 << 12, all->dense, 1 << 12);
+                }
+                Z_ASSERT_NEG(hll_merge(a, other));
+
+                hll_delete(&a);
+                hll_delete(&b);
+                hll_delete(&all);
+                hll_delete(&other);
+            }
+        }
+    } Z_TEST_END;
+
+    Z_TEST(iop, "IOP representation") {
+        t_scope;
+        int nbs[] = { 0, 100, 100000 };
+
+        carray_for_each_entry(nb, nbs) {
+            core__hll_sketch__t iop;
+            core__hll_sketch__t copy;
+            hll_t hll;
+            hll_t res;
+
+            hll_init(&hll, HLL_PRECISION_DEFAULT);
+            for (int i = 0; i < nb; i++) {
+                hll_add_hash(&hll, z_sketch_hash(i));
+            }
+            hll_to_iop(&hll, &iop);
+            Z_ASSERT_N(t_z_sketch_iop_copy(core__hll_sketch, &iop, &copy));
+            Z_ASSERT_N(hll_init_from_iop(&res, &copy));
+            Z_ASSERT_EQ(hll_count(&res), hll_count(&hll));
+            hll_wipe(&res);
+            hll_wipe(&hll);
+        }
+
+        /* Invalid representations. */
+        {
+            core__hll_sketch__t iop;
+            uint32_t unsorted[] = { 2 << 6 | 1, 1 << 6 | 1 };
+            hll_t res;
+
+            iop_init(core__hll_sketch, &iop);
+            iop.precision = 2;
+            Z_ASSERT_NEG(hll_init_from_iop(&res, &iop));
+            hll_wipe(&res);
+
+            iop.precision = HLL_PRECISION_DEFAULT;
+            iop.dense = LSTR("abc");
+            Z_ASSERT_NEG(hll_init_from_iop(&res, &iop));
+            hll_wipe(&res);
+
+            iop.dense = LSTR_NULL_V;
+            iop.sparse = IOP_TYPED_ARRAY(u32, unsorted, countof(unsorted));
+            Z_ASSERT_NEG(hll_init_from_iop(&res, &iop));
+            hll_wipe(&res);
+        }
+    } Z_TEST_END;
+} Z_GROUP_END;
+
+Z_GROUP_EXPORT(cms) {
+    Z_TEST(count, "counts are never underestimated") {
+        uint32_t width, depth;
+        cms_t cms;
+        int over = 0;
+
+        cms_dimensions(0.001, 0.01, &width, &depth);
+        Z_ASSERT_EQ(width, 2719U);
+        Z_ASSERT_EQ(depth, 5U);
+        cms_init(&cms, width, depth);
+
+        /* 5000 keys seen 20 times, and a heavy one. */
+        for (int i = 0; i < 100000; i++) {
+            cms_add_hash(&cms, z_sketch_hash(i % 5000), 1);
+        }
+        Z_ASSERT_GE(cms_add(&cms, "heavy", 5, 1000), 1000U);
+        Z_ASSERT_EQ(cms.total, 101000U);
+
+        for (int i = 0; i < 5000; i++) {
+            uint64_t count = cms_count_hash(&cms, z_sketch_hash(i));
+
+            Z_ASSERT_GE(count, 20U);
+            over += count > 20 + 0.001 * cms.total;
+        }
+        Z_ASSERT_LT(over, 5000 * 0.01 * 2);
+
+        cms_clear(&cms);
+        Z_ASSERT_EQ(cms_count(&cms, "heavy", 5), 0U);
+        cms_wipe(&cms);
+    } Z_TEST_END;
+
+    Z_TEST(merge, "merge and IOP representation") {
+        t_scope;
+        cms_t *a = cms_new(100, 4);
+        cms_t *b = cms_new(100, 4);
+        cms_t *other = cms_new(50, 4);
+        core__count_min_sketch__t iop;
+        core__count_min_sketch__t copy;
+        cms_t res;
+
+        cms_add(a, "foo", 3, 3);
+        cms_add(b, "foo", 3, 4);
+        cms_add(b, "bar", 3, 5);
+        Z_ASSERT_N(cms_merge(a, b));
+        Z_ASSERT_NEG(cms_merge(a, other));
+        Z_ASSERT_EQ(cms_count(a, "foo", 3), 7U);
+        Z_ASSERT_EQ(cms_count(a, "bar", 3), 5U);
+
+        cms_to_iop(a, &iop);
+        Z_ASSERT_N(t_z_sketch_iop_copy(core__count_min_sketch, &iop, &copy));
+        Z_ASSERT_N(cms_init_from_iop(&res, &copy));
+        Z_ASSERT_EQ(res.total, 12U);
+        Z_ASSERT_EQ(cms_count(&res, "foo", 3), 7U);
+        cms_wipe(&res);
+
+        copy.width++;
+        Z_ASSERT_NEG(cms_init_from_iop(&res, &copy));
+
+        cms_delete(&a);
+        cms_delete(&b);
+        cms_delete(&other);
+    } Z_TEST_END;
+} Z_GROUP_END;
+
+Z_GROUP_EXPORT(topk) {
+    Z_TEST(heavy_hitters, "the most frequent keys are found") {
+        t_scope;
+        topk_t topk;
+        const qv_t(topk_entry) *top;
+
+        topk_init(&topk, 10, 1000, 4);
+        /* Key i is counted 100 * i times for i < 10, amid noise. */
+        for (int round = 0; round < 20; round++) {
+            for (int i = 1; i < 10; i++) {
+                topk_add(&topk, t_lstr_fmt("heavy-%d", i), 5 * i);
+            }
+            for (int i = 0; i < 500; i++) {
+                topk_add(&topk, t_lstr_fmt("noise-%d-%d", round, i), 1);
+            }
+        }
+
+        top = topk_get(&topk);
+        Z_ASSERT_LE(top->len, 10);
+        for (int i = 0; i < 9; i++) {
+            Z_ASSERT_LSTREQUAL(top->tab[i].key, t_lstr_fmt("heavy-%d", 9 - i));
+            Z_ASSERT_GE(top->tab[i].count, 100U * (9 - i));
+        }
+        topk_wipe(&topk);
+    } Z_TEST_END;
+
+    Z_TEST(merge, "merge and IOP representation") {
+        t_scope;
+        topk_t *a = topk_new(2, 100, 4);
+        topk_t *b = topk_new(2, 100, 4);
+        core__top_k_sketch__t iop;
+        core__top_k_sketch__t copy;
+        const qv_t(topk_entry) *top;
+        topk_t res;
+
+        topk_add(a, LSTR("foo"), 12);
+        topk_add(a, LSTR("bar"), 5);
+        topk_add(b, LSTR("qux"), 8);
+        topk_add(b, LSTR("bar"), 5);
+        Z_ASSERT_N(topk_merge(a, b));
+
+        top = topk_get(a);
+        Z_ASSERT_EQ(top->len, 2);
+        Z_ASSERT_LSTREQUAL(top->tab[0].key, LSTR("foo"));
+        Z_ASSERT_LSTREQUAL(top->tab[1].key, LSTR("bar"));
+        Z_ASSERT_EQ(top->tab[1].count, 10U);
+
+        t_topk_to_iop(a, &iop);
+        Z_ASSERT_N(t_z_sketch_iop_copy(core__top_k_sketch, &iop, &copy));
+        Z_ASSERT_N(topk_init_from_iop(&res, &copy));
+        Z_ASSERT_EQ(res.cms.total, 30U);
+        topk_add(&res, LSTR("qux"), 5);
+        top = topk_get(&res);
+        Z_ASSERT_LSTREQUAL(top->tab[0].key, LSTR("qux"));
+        Z_ASSERT_EQ(top->tab[0].count, 13U);
+        topk_wipe(&res);
+
+        topk_delete(&a);
+        topk_delete(&b);
+    } Z_TEST_END;
+} Z_GROUP_END;
+
+/* LCOV_EXCL_STOP */
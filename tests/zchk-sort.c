@@ -337,6 +337,39 @@ Z_GROUP_EXPORT(sort) {
         }
     } Z_TEST_END;
 
+    Z_TEST(bisect, "bisect/contains/bisect_many on larger arrays") {
+        t_scope;
+        int len = 1000;
+        uint32_t *data = t_new(uint32_t, len);
+        uint32_t *what = t_new(uint32_t, len);
+        size_t *pos = t_new(size_t, len);
+
+        for (int i = 0; i < len; i++) {
+            data[i] = mrand48() % 4000;
+            what[i] = mrand48() % 4100;
+        }
+        dsort32(data, len);
+        len = uniq32(data, len);
+        dsort32(what, len);
+
+        for (int n = 0; n <= len; n += (n < 40 ? 1 : 97)) {
+            bisect32_many(what, len, data, n, pos);
+            for (int i = 0; i < len; i++) {
+                size_t scan_pos = 0;
+                bool found;
+
+                while (scan_pos < (size_t)n && data[scan_pos] < what[i]) {
+                    scan_pos++;
+                }
+                Z_ASSERT_EQ(bisect32(what[i], data, n, &found), scan_pos);
+                Z_ASSERT_EQ(pos[i], scan_pos);
+                Z_ASSERT_EQ(found, scan_pos < (size_t)n
+                                && data[scan_pos] == what[i]);
+                Z_ASSERT_EQ(contains32(what[i], data, n), found);
+            }
+        }
+    } Z_TEST_END;
+
 #define Z_TEST_DSORT_IX(x)                                                   \
     Z_TEST(dsort_i##x, "dsort_i" #x) {                                       \
         t_scope;                                                             \
@@ -370,6 +403,38 @@ Z_GROUP_EXPORT(sort) {
     Z_TEST_DSORT_IX(16);
     Z_TEST_DSORT_IX(32);
     Z_TEST_DSORT_IX(64);
+
+    Z_TEST(dsort64_kv32, "dsort64_kv32") {
+        t_scope;
+        int len = 1024;
+        uint64_t *keys = t_new(uint64_t, len);
+        uint64_t *orig = t_new(uint64_t, len);
+        uint32_t *vals = t_new(uint32_t, len);
+
+        /* few distinct keys, so that the stability is checked */
+        for (int i = 0; i < len; i++) {
+            keys[i] = MAKE64(mrand48() % 4, mrand48() % 8);
+            vals[i] = i;
+        }
+        p_copy(orig, keys, len);
+        dsort64_kv32(keys, vals, len);
+
+        for (int i = 0; i < len; i++) {
+            Z_ASSERT_EQ(keys[i], orig[vals[i]], "bad value (i=%d)", i);
+            if (i > 0) {
+                Z_ASSERT_LE(keys[i - 1], keys[i], "not sorted (i=%d)", i);
+                if (keys[i - 1] == keys[i]) {
+                    Z_ASSERT_LT(vals[i - 1], vals[i], "not stable (i=%d)", i);
+                }
+            }
+        }
+
+        /* already sorted */
+        dsort64_kv32(keys, vals, len);
+        for (int i = 0; i < len; i++) {
+            Z_ASSERT_EQ(keys[i], orig[vals[i]], "bad value (i=%d)", i);
+        }
+    } Z_TEST_END;
 } Z_GROUP_END;
 
 /* LCOV_EXCL_STOP */
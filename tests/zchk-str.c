@@ -124,6 +124,13 @@ Z_GROUP_EXPORT(str) {
         Z_ASSERT_LSTREQUAL(lower, LSTR("the fox jumps over the lazy dog"));
         Z_ASSERT_LSTREQUAL(upper, LSTR("THE FOX JUMPS OVER THE LAZY DOG"));
         Z_ASSERT_LSTREQUAL(reversed, LSTR("gOd YzaL eHt ReVo sPmUj XoF EhT"));
+
+        /* only the ASCII letters are converted */
+        src = LSTR("@AZ[`az{\xc0\xe0\xc9\xe9 ThE FoX");
+        Z_ASSERT_LSTREQUAL(t_lstr_ascii_tolower(src),
+                           LSTR("@az[`az{\xc0\xe0\xc9\xe9 the fox"));
+        Z_ASSERT_LSTREQUAL(t_lstr_ascii_toupper(src),
+                           LSTR("@AZ[`AZ{\xc0\xe0\xc9\xe9 THE FOX"));
     } Z_TEST_END;
 
     Z_TEST(sb_detach, "sb_detach") {
@@ -144,6 +151,111 @@ Z_GROUP_EXPORT(str) {
         p_delete(&p);
     } Z_TEST_END;
 
+    Z_TEST(sb_mremap, "large sb use mem_pool_mremap") {
+        const int count = 2 * MEM_MREMAP_THRESHOLD;
+        sb_t sb;
+        char *p;
+        int len;
+
+        sb_init(&sb);
+        for (int i = 0; i < count; i++) {
+            sb_addc(&sb, 'a' + i % 26);
+        }
+        Z_ASSERT(sb.mp == &mem_pool_mremap);
+        Z_ASSERT_EQ(sb.len, count);
+        for (int i = 0; i < count; i++) {
+            Z_ASSERT_EQ(sb.data[i], 'a' + i % 26);
+        }
+        Z_ASSERT_EQ(sb.data[count], '\0');
+
+        /* the detached buffer is allocated with the libc */
+        p = sb_detach(&sb, &len);
+        Z_ASSERT_EQ(len, count);
+        Z_ASSERT_EQ(p[count - 1], 'a' + (count - 1) % 26);
+        p_delete(&p);
+        Z_ASSERT(sb.mp == &mem_pool_libc);
+    } Z_TEST_END;
+
+    Z_TEST(sb_rope, "sb_rope") {
+        sb_rope_t rope;
+        const char *block0;
+        SB_1k(ref);
+        sb_t out;
+
+        sb_rope_init(&rope, 64);
+        for (int i = 0; i < 100; i++) {
+            sb_rope_addf(&rope, "%d,", i);
+            sb_addf(&ref, "%d,", i);
+        }
+        Z_ASSERT_EQ(sb_rope_len(&rope), ref.len);
+        Z_ASSERT_LT(1, rope.nb_blocks);
+        for (int i = 0; i < rope.nb_blocks; i++) {
+            Z_ASSERT_LE(rope.seal_at, rope.blocks[i].len);
+            Z_ASSERT_LT(rope.blocks[i].len, 64);
+        }
+
+        /* sealed blocks are not moved by the following appends */
+        block0 = rope.blocks[0].data;
+        sb_rope_adds(&rope, "end");
+        sb_rope_add(&rope, ref.data, ref.len);
+        sb_adds(&ref, "end");
+        sb_add(&ref, ref.data, ref.len - 3);
+        Z_ASSERT(rope.blocks[0].data == block0);
+
+        sb_init(&out);
+        sb_adds(&out, "start,");
+        sb_rope_flatten(&rope, &out);
+        Z_ASSERT_EQ(sb_rope_len(&rope), 0);
+        Z_ASSERT_EQ(out.len, ref.len + 6);
+        Z_ASSERT_STREQUAL(out.data + 6, ref.data);
+
+        sb_rope_addc(&rope, 'a');
+        sb_rope_reset(&rope);
+        Z_ASSERT_EQ(sb_rope_len(&rope), 0);
+        sb_rope_wipe(&rope);
+        sb_wipe(&out);
+    } Z_TEST_END;
+
+    Z_TEST(sb_rbuf, "sb_rbuf_borrow/sb_rbuf_release") {
+        sb_rbuf_stats_t before;
+        sb_rbuf_stats_t stats;
+        const char *data;
+        sb_t sb;
+
+        sb_init(&sb);
+        sb_rbuf_borrow(&sb, 0);
+        Z_ASSERT(sb.data != __sb_slop);
+        Z_ASSERT_LT(BUFSIZ, sb_avail(&sb));
+        data = sb.data;
+        sb_rbuf_get_stats(&before);
+        Z_ASSERT_LE((size_t)sb.size, before.borrowed_bytes);
+
+        /* the buffer is kept while it holds data */
+        sb_adds(&sb, "foobar");
+        sb_skip(&sb, 3);
+        sb_rbuf_release(&sb);
+        Z_ASSERT_STREQUAL(sb.data, "bar");
+
+        /* then cached, and reused by the next borrow */
+        sb_skip(&sb, 3);
+        sb_rbuf_release(&sb);
+        Z_ASSERT(sb.data == __sb_slop);
+        sb_rbuf_get_stats(&stats);
+        Z_ASSERT_LT(stats.borrowed_bytes, before.borrowed_bytes);
+        Z_ASSERT_EQ(stats.resident_bytes, before.resident_bytes);
+
+        sb_rbuf_borrow(&sb, 0);
+        Z_ASSERT(sb.data == data);
+
+        /* a buffer that grew is freed */
+        sb_grow(&sb, 512 << 10);
+        sb_rbuf_release(&sb);
+        Z_ASSERT(sb.data == __sb_slop);
+        sb_rbuf_get_stats(&stats);
+        Z_ASSERT_LT(stats.resident_bytes, before.resident_bytes);
+        sb_wipe(&sb);
+    } Z_TEST_END;
+
     Z_TEST(sb_add, "sb_add/sb_prepend") {
         SB_1k(sb);
         char buf2[BUFSIZ * 2];
@@ -260,6 +372,57 @@ Z_GROUP_EXPORT(str) {
         }
     } Z_TEST_END;
 
+    Z_TEST(utf8_strnlen, "str: utf8_strnlen/utf8_skip_valid by blocks") {
+        SB_1k(sb);
+        SB_1k(ucs2);
+        int nchars = 0;
+
+        /* characters of 1 to 4 bytes across the block boundaries */
+        for (int i = 0; i < 40; i++) {
+            sb_adds(&sb, "abcd" "\xc3\xa9" "\xe2\x82\xac" "\xf0\x9f\x98\x80");
+            nchars += 7;
+        }
+        for (int i = 0; i < 8; i++) {
+            sb_adds(&sb, "0123456789abcdef");
+            nchars += 16;
+        }
+        Z_ASSERT_EQ(utf8_strnlen(sb.data, sb.len), nchars);
+        Z_ASSERT(utf8_skip_valid(sb.data, sb_end(&sb)) == sb_end(&sb));
+
+        /* characters cut by the end of the string */
+        Z_ASSERT_NEG(utf8_strnlen(sb.data, 13 * 16 + 7));
+        Z_ASSERT(utf8_skip_valid(sb.data, sb.data + 13 * 16 + 7)
+                 == sb.data + 13 * 16 + 6);
+
+        /* invalid bytes in the middle of a block: a continuation byte
+         * instead of 'a', a leading byte of 5 bytes instead of the one of
+         * 'é', and 'a' instead of the second byte of the emoji */
+        for (int i = 0; i < 3; i++) {
+            static int const offsets[] = { 0, 4, 10 };
+            static int const errors[] = { 0, 4, 9 };
+            int pos = 17 * 13 + offsets[i];
+            char c = sb.data[pos];
+
+            sb.data[pos] = "\x80\xf8" "a"[i];
+            Z_ASSERT_NEG(utf8_strnlen(sb.data, sb.len));
+            Z_ASSERT(utf8_skip_valid(sb.data, sb_end(&sb))
+                     == sb.data + 17 * 13 + errors[i]);
+            sb.data[pos] = c;
+        }
+
+        /* the ASCII runs are widened by blocks */
+        sb_reset(&sb);
+        sb_adds(&sb, "0123456789abcdef0123456789abcdef\xc3\xa9");
+        Z_ASSERT_N(sb_conv_to_ucs2be(&ucs2, sb.data, sb.len));
+        Z_ASSERT_EQ(ucs2.len, 66);
+        Z_ASSERT_EQ(memcmp(ucs2.data, "\0" "0" "\0" "1", 4), 0);
+        Z_ASSERT_EQ(memcmp(ucs2.data + 62, "\0" "f" "\0" "\xe9", 4), 0);
+        sb_reset(&ucs2);
+        Z_ASSERT_N(sb_conv_to_ucs2le(&ucs2, sb.data, sb.len));
+        Z_ASSERT_EQ(ucs2.len, 66);
+        Z_ASSERT_EQ(memcmp(ucs2.data + 62, "f" "\0" "\xe9" "\0", 4), 0);
+    } Z_TEST_END;
+
     Z_TEST(utf8_stricmp, "str: utf8_stricmp test") {
 
 #define RUN_UTF8_TEST_(Str1, Str2, Strip, Val) \
@@ -890,6 +1053,19 @@ Z_GROUP_EXPORT(str) {
         T("0", 0, 0, -1);
         T("0x0", 0, 0, 1);
         T("010", 0, 10, -1);
+
+        /* runs of 8 digits */
+        T("1234567890", 0, 1234567890, -1);
+        T("123456789z", 0, 123456789, 9);
+        T("1234567z90", 0, 1234567, 7);
+        T("12345678/0", 0, 12345678, 8);
+        T("12345678:0", 0, 12345678, 8);
+        T("-1234567890", 0, -1234567890, -1);
+        T("0000000000000000002147483647", 0, 2147483647, -1);
+        T("0000000000000000002147483648", ERANGE, 2147483647, -1);
+        T("-000000000000000002147483648", 0, -2147483647 - 1, -1);
+        T("-000000000000000002147483649", ERANGE, -2147483647 - 1, -1);
+        T("21474836470000000000", ERANGE, 2147483647, -1);
 #undef T
     } Z_TEST_END;
 
@@ -1089,8 +1265,44 @@ Z_GROUP_EXPORT(str) {
         TD("010", 0, 10, -1);
         TD("10e3", 0, 10000, -1);
         TD("0.1e-3", 0, 0.0001, -1);
+        TD("1e", 0, 1, 1);
+        TD("1.5.3", 0, 1.5, 3);
+        TD(".5", 0, 0.5, -1);
+        TD("-0", 0, 0, -1);
 
 #undef TD
+
+        /* the exact fast path must give the result of strtod() */
+#define TD_EXACT(p)                                                          \
+        ({  const byte *endp;                                                \
+            char *endp_ref;                                                  \
+            double res_ref = strtod(p, &endp_ref);                           \
+            double res = memtod(p, strlen(p), &endp);                        \
+                                                                             \
+            Z_ASSERT(!memcmp(&res, &res_ref, sizeof(res)), "%s", p);         \
+            Z_ASSERT_EQ(endp_ref - p, endp - (const byte *)p, "%s", p);      \
+            res = memtod(p, -1, &endp);                                      \
+            Z_ASSERT(!memcmp(&res, &res_ref, sizeof(res)), "%s", p);         \
+            Z_ASSERT_EQ(endp_ref - p, endp - (const byte *)p, "%s", p);      \
+        })
+
+        TD_EXACT("3.14159");
+        TD_EXACT("-0.0");
+        TD_EXACT("1e22");
+        TD_EXACT("1e23");
+        TD_EXACT("1e-22");
+        TD_EXACT("1e-23");
+        TD_EXACT("123e30");
+        TD_EXACT("9007199254740992");
+        TD_EXACT("9007199254740993");
+        TD_EXACT("1234567890123456789");
+        TD_EXACT("12345678901234567890");
+        TD_EXACT("0.30000000000000004");
+        TD_EXACT("2.2250738585072014e-308");
+        TD_EXACT("0x1p3");
+        TD_EXACT("inf");
+
+#undef TD_EXACT
 #undef DOUBLE_CMP
 #undef DOUBLE_ABS
     } Z_TEST_END;
@@ -1136,6 +1348,57 @@ Z_GROUP_EXPORT(str) {
 #undef T_OVERFLOW
     } Z_TEST_END;
 
+    Z_TEST(lstr_intern, "str: lstr_intern") {
+        t_scope;
+        lstr_intern_table_t *table = lstr_intern_table_new();
+        lstr_t foo = lstr_intern_in(table, LSTR("foo"));
+        lstr_t empty = lstr_intern_in(table, LSTR_EMPTY_V);
+        qh_t(lstr_intern) qh;
+        char *big;
+
+        Z_ASSERT_LSTREQUAL(foo, LSTR("foo"));
+        Z_ASSERT_EQ(foo.s[foo.len], '\0');
+        Z_ASSERT_EQ(lstr_intern_hash(foo), qhash_lstr_hash(NULL, &foo));
+        Z_ASSERT(lstr_intern_in(table, t_lstr_dup(LSTR("foo"))).s == foo.s);
+        Z_ASSERT(lstr_intern_find_in(table, LSTR("foo")).s == foo.s);
+        Z_ASSERT_NULL(lstr_intern_find_in(table, LSTR("bar")).s);
+        Z_ASSERT_NULL(lstr_intern_in(table, LSTR_NULL_V).s);
+        Z_ASSERT_LSTREQUAL(empty, LSTR_EMPTY_V);
+        Z_ASSERT(lstr_intern_in(table, LSTR("")).s == empty.s);
+
+        /* the tables are independent */
+        Z_ASSERT(lstr_intern_find(LSTR("foo")).s != foo.s);
+
+        /* strings interned before the table grows are kept */
+        for (int i = 0; i < 10000; i++) {
+            lstr_intern_in(table, t_lstr_fmt("key-%d", i));
+        }
+        big = t_new_raw(char, 64 << 10);
+        memset(big, 'a', 64 << 10);
+        lstr_intern_in(table, LSTR_INIT_V(big, 64 << 10));
+        Z_ASSERT_EQ(lstr_intern_table_count(table), 10003);
+        Z_ASSERT(lstr_intern_find_in(table, LSTR("foo")).s == foo.s);
+        for (int i = 0; i < 10000; i++) {
+            lstr_t key = t_lstr_fmt("key-%d", i);
+            lstr_t s = lstr_intern_find_in(table, key);
+
+            Z_ASSERT_LSTREQUAL(s, key);
+            Z_ASSERT(lstr_intern_in(table, key).s == s.s);
+        }
+
+        qh_init(lstr_intern, &qh);
+        for (int i = 0; i < 100; i++) {
+            lstr_t key = lstr_intern_in(table, t_lstr_fmt("key-%d", i % 10));
+
+            qh_add(lstr_intern, &qh, &key);
+        }
+        Z_ASSERT_EQ(qh_len(lstr_intern, &qh), 10);
+        qh_wipe(lstr_intern, &qh);
+
+        lstr_intern_table_delete(&table);
+        Z_ASSERT_NULL(table);
+    } Z_TEST_END;
+
     Z_TEST(memtoxllp, "str: memtoxllp") {
         lstr_t s = LSTR("123");
         const byte *end;
@@ -1147,6 +1410,36 @@ Z_GROUP_EXPORT(str) {
         Z_ASSERT_EQ(123U, memtoullp(s.s, s.len, NULL));
         Z_ASSERT_EQ(123U, memtoullp(s.s, s.len, &end));
         Z_ASSERT(end == (byte *)s.s + s.len);
+
+        /* the length is honored without a terminating NUL */
+        s = LSTR("12345678901234567890123");
+        Z_ASSERT_EQ(1234567890123456789, memtollp(s.s, 19, &end));
+        Z_ASSERT(end == (byte *)s.s + 19);
+        Z_ASSERT_EQ(12345678901234567890U, memtoullp(s.s, 20, &end));
+        Z_ASSERT(end == (byte *)s.s + 20);
+        Z_ASSERT_EQ(123456789U, memtoullp(s.s, 9, &end));
+        Z_ASSERT(end == (byte *)s.s + 9);
+
+        s = LSTR(" +18446744073709551615 ");
+        errno = 0;
+        Z_ASSERT_EQ(UINT64_MAX, memtoullp(s.s, s.len, &end));
+        Z_ASSERT_EQ(0, errno);
+        Z_ASSERT(end == (byte *)s.s + s.len - 1);
+
+        s = LSTR("18446744073709551616");
+        errno = 0;
+        Z_ASSERT_EQ(UINT64_MAX, memtoullp(s.s, s.len, &end));
+        Z_ASSERT_EQ(ERANGE, errno);
+        Z_ASSERT(end == (byte *)s.s + s.len);
+
+        s = LSTR("-9223372036854775808");
+        errno = 0;
+        Z_ASSERT_EQ(INT64_MIN, memtollp(s.s, s.len, &end));
+        Z_ASSERT_EQ(0, errno);
+        Z_ASSERT(end == (byte *)s.s + s.len);
+        errno = 0;
+        Z_ASSERT_EQ(0U, memtoullp(s.s, s.len, &end));
+        Z_ASSERT_EQ(ERANGE, errno);
     } Z_TEST_END;
 
     Z_TEST(str_tables, "str: test conversion tables") {
@@ -1858,6 +2151,28 @@ Z_GROUP_EXPORT(str) {
 #undef T
     } Z_TEST_END;
 
+    Z_TEST(sb_add_escapes, "xml and slashes escaping of long inputs") {
+        SB_1k(sb);
+        lstr_t clean = LSTR("The quick brown fox jumps over the lazy dog. ");
+
+        sb_add_lstr_xmlescape(&sb, clean);
+        Z_ASSERT_LSTREQUAL(clean, LSTR_SB_V(&sb));
+        sb_reset(&sb);
+        sb_adds_xmlescape(&sb, "0123456789abcdef\x01<0123456789abcdef\xc3"
+                          "\xa9&0123456789abcdef'\"");
+        Z_ASSERT_STREQUAL("0123456789abcdef&lt;0123456789abcdef\xc3\xa9"
+                          "&amp;0123456789abcdef&#39;&#34;", sb.data);
+
+        sb_reset(&sb);
+        sb_add_slashes(&sb, clean.s, clean.len, "\n", "n");
+        Z_ASSERT_LSTREQUAL(clean, LSTR_SB_V(&sb));
+        sb_reset(&sb);
+        sb_add_slashes(&sb, "0123456789abcdef\n0123456789abcdef\xff\\", 35,
+                       "\n\xff", "nx");
+        Z_ASSERT_STREQUAL("0123456789abcdef\\n0123456789abcdef\\x\\\\",
+                          sb.data);
+    } Z_TEST_END;
+
     Z_TEST(sb_add_csvescape, "") {
         SB_1k(sb);
 
@@ -1880,6 +2195,10 @@ Z_GROUP_EXPORT(str) {
         CHECK("toto\"\ntata", ';', "\"toto\"\"\ntata\"");
         CHECK("", ';', "");
         CHECK("\"", ';', "\"\"\"\"");
+        CHECK("0123456789abcdef0123456789abcdef\xe9",
+              0xe9, "\"0123456789abcdef0123456789abcdef\xe9\"");
+        CHECK("0123456789abcdef0123456789abcdef;",
+              ';', "\"0123456789abcdef0123456789abcdef;\"");
     } Z_TEST_END;
 
     Z_TEST(sb_splice_lstr, "") {
@@ -2087,9 +2406,63 @@ Z_GROUP_EXPORT(str) {
         T("faaa", "FAAA",  == 0);
         T("faab", "faaba", <  0);
         T("faab", "faaab", >  0);
+        T("The Quick Brown Fox", "THE QUICK BROWN FOX", == 0);
+        T("The Quick Brown Fox", "THE QUICK BROWN FOY", <  0);
+        T("The Quick Brown Fox", "THE QUICK brown FO",  >  0);
+        T("The Quick Brown Fox", "THE QUICK CROWN FOX", <  0);
+        T("[the quick brown fox", "{THE QUICK BROWN FOX", <  0);
+        T("the quick \xe9 fox", "THE QUICK \xc9 FOX", >  0);
 #undef T
     } Z_TEST_END;
 
+    Z_TEST(ctype_desc_span, "str: ctype_desc_span/ctype_desc_cspan") {
+        ctype_desc_t d;
+        pstream_t ps;
+        pstream_t tok;
+        byte buf[256];
+
+        for (int i = 0; i < 1000; i++) {
+            int len = rand() % countof(buf);
+
+            for (int j = 0; j < countof(d.tab); j++) {
+                d.tab[j] = rand() | rand();
+            }
+            for (int j = 0; j < len; j++) {
+                do {
+                    buf[j] = rand();
+                } while (!ctype_desc_contains(&d, buf[j]) && rand() % 32);
+            }
+
+            for (int in = 0; in < 2; in++) {
+                size_t span = 0;
+
+                while (span < (size_t)len
+                &&     ctype_desc_contains(&d, buf[span]) == in)
+                {
+                    span++;
+                }
+                if (in) {
+                    Z_ASSERT_EQ(ctype_desc_span(&d, buf, len), span);
+                } else {
+                    Z_ASSERT_EQ(ctype_desc_cspan(&d, buf, len), span);
+                }
+            }
+        }
+
+        ps = ps_initstr("   \t\n  abcdefghijklmnopqrstuvwxyz0123456789"
+                        "ABCDEFGHIJKLMNOPQRSTUVWXYZ_abcdefghijklmnopq   x");
+        Z_ASSERT_EQ(ps_skip_span(&ps, &ctype_isspace), 8U);
+        Z_ASSERT(ps_has_char_in_ctype(&ps, &ctype_isspace));
+        tok = ps_get_cspan(&ps, &ctype_isspace);
+        Z_ASSERT_LSTREQUAL(LSTR_PS_V(&tok),
+                           LSTR("abcdefghijklmnopqrstuvwxyz0123456789"
+                                "ABCDEFGHIJKLMNOPQRSTUVWXYZ_"
+                                "abcdefghijklmnopq"));
+        Z_ASSERT(!ps_has_char_in_ctype(&ps, &ctype_isdigit));
+        Z_ASSERT_EQ(ps_skip_cspan(&ps, &ctype_isalpha), 3U);
+        Z_ASSERT_LSTREQUAL(LSTR_PS_V(&ps), LSTR("x"));
+    } Z_TEST_END;
+
     Z_TEST(lstr_to_int, "str: lstr_to_int and friends") {
         t_scope;
         int      i;
@@ -2405,6 +2778,83 @@ Z_GROUP_EXPORT(str) {
         Z_ASSERT_NEG(sb_adds_unb64url(&data_decoded, "wQA&03e="));
     } Z_TEST_END
 
+    Z_TEST(codecs_blocks, "hex/base64/url codecs on long inputs") {
+        /* check the block by block paths against a byte by byte
+         * reference, with the blocks at every offset */
+        SB_1k(raw);
+        SB_1k(enc);
+        SB_1k(ref);
+        SB_1k(dec);
+
+        for (int i = 0; i < 200; i++) {
+            sb_addc(&raw, i * 37 + (i >> 3));
+        }
+        for (int len = 0; len <= raw.len; len += 7) {
+            sb_b64_ctx_t ctx;
+
+            sb_reset(&enc);
+            sb_reset(&ref);
+            sb_reset(&dec);
+            sb_add_hex(&enc, raw.data, len);
+            for (int i = 0; i < len; i++) {
+                sb_addf(&ref, "%02X", (byte)raw.data[i]);
+            }
+            Z_ASSERT_LSTREQUAL(LSTR_SB_V(&enc), LSTR_SB_V(&ref));
+            for (int i = 0; i < enc.len; i += 3) {
+                enc.data[i] = tolower(enc.data[i]);
+            }
+            Z_ASSERT_N(sb_add_unhex(&dec, enc.data, enc.len));
+            Z_ASSERT_LSTREQUAL(LSTR_SB_V(&dec), LSTR_INIT_V(raw.data, len));
+            if (len) {
+                enc.data[enc.len - 1] = 'g';
+                Z_ASSERT_NEG(sb_add_unhex(&dec, enc.data, enc.len));
+            }
+
+            /* base64 with and without lines, as a whole or by pieces */
+            for (int width = -1; width <= 76; width += 77) {
+                sb_reset(&enc);
+                sb_reset(&ref);
+                sb_reset(&dec);
+                sb_add_b64(&enc, raw.data, len, width);
+                sb_add_b64_start(&ref, len, width, &ctx);
+                for (int i = 0; i < len; i += 5) {
+                    sb_add_b64_update(&ref, raw.data + i, MIN(5, len - i),
+                                      &ctx);
+                }
+                sb_add_b64_finish(&ref, &ctx);
+                Z_ASSERT_LSTREQUAL(LSTR_SB_V(&enc), LSTR_SB_V(&ref));
+                Z_ASSERT_N(sb_add_unb64(&dec, enc.data, enc.len));
+                Z_ASSERT_LSTREQUAL(LSTR_SB_V(&dec),
+                                   LSTR_INIT_V(raw.data, len));
+                if (enc.len > 20) {
+                    enc.data[enc.len - 20] = '*';
+                    Z_ASSERT_NEG(sb_add_unb64(&dec, enc.data, enc.len));
+                }
+            }
+            sb_reset(&enc);
+            sb_reset(&dec);
+            sb_add_b64url(&enc, raw.data, len, -1);
+            Z_ASSERT_NULL(memchr(enc.data, '+', enc.len));
+            Z_ASSERT_NULL(memchr(enc.data, '/', enc.len));
+            Z_ASSERT_N(sb_add_unb64url(&dec, enc.data, enc.len));
+            Z_ASSERT_LSTREQUAL(LSTR_SB_V(&dec), LSTR_INIT_V(raw.data, len));
+        }
+
+        sb_reset(&enc);
+        sb_reset(&ref);
+        for (int i = 0; i < 100; i++) {
+            sb_adds(&enc, "a-Z_0.9/");
+            sb_adds(&ref, "a-Z_0.9/");
+            if (i % 7 == 0) {
+                sb_addc(&enc, '@');
+                sb_adds(&ref, "%40");
+            }
+        }
+        sb_reset(&dec);
+        sb_add_urlencode(&dec, enc.data, enc.len);
+        Z_ASSERT_LSTREQUAL(LSTR_SB_V(&dec), LSTR_SB_V(&ref));
+    } Z_TEST_END
+
 } Z_GROUP_END;
 
 /* }}} */
@@ -399,6 +399,148 @@ Z_GROUP_EXPORT(time)
         Z_ASSERT_EQ(strlen(buf), 24U);
     } Z_TEST_END;
 
+    Z_TEST(gmtime, "time: time_gmtime and time_localtime") {
+        time_t ts[] = {
+            0, -1, 59, 60, 86399, 86400, -86400, -86401, 951782400,
+            951868799, 1173180853, 1382835600, 1364691600, INT32_MAX,
+            (time_t)INT32_MIN - 1, UINT32_MAX, 253402300799, 253402300800,
+            -62167219200, -62167219201,
+        };
+
+        for (int i = 0; i < countof(ts) + 10000; i++) {
+            time_t t;
+            struct tm ref, tm;
+
+            if (i < countof(ts)) {
+                t = ts[i];
+            } else {
+                t = (int64_t)rand() * rand() - (int64_t)RAND_MAX * 1000;
+            }
+
+            Z_ASSERT_P(gmtime_r(&t, &ref));
+            Z_ASSERT_P(time_gmtime(t, &tm), "%jd", t);
+            Z_ASSERT_EQ(tm.tm_year, ref.tm_year, "%jd", t);
+            Z_ASSERT_EQ(tm.tm_mon,  ref.tm_mon,  "%jd", t);
+            Z_ASSERT_EQ(tm.tm_mday, ref.tm_mday, "%jd", t);
+            Z_ASSERT_EQ(tm.tm_hour, ref.tm_hour, "%jd", t);
+            Z_ASSERT_EQ(tm.tm_min,  ref.tm_min,  "%jd", t);
+            Z_ASSERT_EQ(tm.tm_sec,  ref.tm_sec,  "%jd", t);
+            Z_ASSERT_EQ(tm.tm_wday, ref.tm_wday, "%jd", t);
+            Z_ASSERT_EQ(tm.tm_yday, ref.tm_yday, "%jd", t);
+            Z_ASSERT_EQ(time_days_from_civil(tm.tm_year + 1900LL, tm.tm_mon,
+                                             tm.tm_mday) * 86400
+                        + tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec,
+                        (int64_t)t);
+
+            /* Twice, for the cached offset. */
+            for (int j = 0; j < 2; j++) {
+                Z_ASSERT_P(localtime_r(&t, &ref));
+                Z_ASSERT_P(time_localtime(t, &tm), "%jd", t);
+                Z_ASSERT_EQ(tm.tm_year,   ref.tm_year,   "%jd", t);
+                Z_ASSERT_EQ(tm.tm_yday,   ref.tm_yday,   "%jd", t);
+                Z_ASSERT_EQ(tm.tm_hour,   ref.tm_hour,   "%jd", t);
+                Z_ASSERT_EQ(tm.tm_min,    ref.tm_min,    "%jd", t);
+                Z_ASSERT_EQ(tm.tm_sec,    ref.tm_sec,    "%jd", t);
+                Z_ASSERT_EQ(tm.tm_isdst,  ref.tm_isdst,  "%jd", t);
+                Z_ASSERT_EQ(tm.tm_gmtoff, ref.tm_gmtoff, "%jd", t);
+            }
+        }
+    } Z_TEST_END;
+
+    Z_TEST(iso8601_fmt_cache, "time: cached iso8601 formatting") {
+        time_t ts = 1342088430; /* 2012-07-12T10:20:30Z */
+        char buf[30];
+        char ref[30];
+        struct tm tm;
+        int delta_h, delta_m;
+
+        for (int i = 0; i < 3; i++) {
+            time_fmt_iso8601(buf, ts + i / 2);
+            gmtime_r(&(time_t){ ts + i / 2 }, &tm);
+            snprintf(ref, sizeof(ref), ISO8601_GMT_FMT,
+                     ISO8601_GMT_FMT_ARG(&tm));
+            Z_ASSERT_STREQUAL(buf, ref);
+
+            time_fmt_iso8601_msec(buf, ts + i / 2, 7 * i);
+            snprintf(ref, sizeof(ref), ISO8601_GMT_MSEC_FMT,
+                     ISO8601_GMT_MSEC_FMT_ARG(&tm, 7 * i));
+            Z_ASSERT_STREQUAL(buf, ref);
+
+            localtime_r(&(time_t){ ts + i / 2 }, &tm);
+            time_get_gmt_delta(&tm, &delta_h, &delta_m);
+            time_fmt_localtime_iso8601(buf, ts + i / 2, NULL);
+            snprintf(ref, sizeof(ref), ISO8601_TZ_FMT,
+                     ISO8601_TZ_FMT_ARG(&tm, delta_h, delta_m));
+            Z_ASSERT_STREQUAL(buf, ref);
+
+            time_fmt_localtime_iso8601_msec(buf, ts + i / 2, 7 * i, NULL);
+            snprintf(ref, sizeof(ref), ISO8601_TZ_MSEC_FMT,
+                     ISO8601_TZ_MSEC_FMT_ARG(&tm, 7 * i, delta_h, delta_m));
+            Z_ASSERT_STREQUAL(buf, ref);
+        }
+
+        time_fmt_iso8601(buf, 253402300799);
+        Z_ASSERT_STREQUAL(buf, "9999-12-31T23:59:59Z");
+    } Z_TEST_END;
+
+    Z_TEST(iso8601_fixed, "time: fixed layout iso8601 parsing") {
+        static const char *dates[] = {
+            "2007-03-06T11:34:13Z",
+            "2007-03-06t11:34:13z",
+            "2007-03-06T11:34:13.123Z",
+            "2007-03-06T11:34:13.123456789Z",
+            "2007-03-06T11:34:13+00:00",
+            "2007-03-06T01:04:13-10:30",
+            "2007-03-07T00:04:13+12:30",
+            "2007-03-07T00:04:13+1230",
+            "2007-03-07T00:04:13+12",
+            "2016-02-29T23:59:59Z",
+            "2100-12-31T23:59:59-00:01",
+            "1901-01-01T00:00:00+14:00",
+        };
+        static const char *invalid[] = {
+            "2007-02-29T11:34:13Z",
+            "2007-03-06T11:34:13+0",
+            "1900-03-06T11:34:13Z",
+        };
+        time_t ref[] = {
+            1173180853, 1173180853, 1173180853, 1173180853, 1173180853,
+            1173180853, 1173180853, 1173180853, 1173182653, 1456790399,
+            4133980859, -2177503200,
+        };
+
+        for (int i = 0; i < countof(dates); i++) {
+            pstream_t ps = ps_initstr(dates[i]);
+            time_t t;
+
+            Z_ASSERT_N(time_parse_iso8601(&ps, &t), "%s", dates[i]);
+            Z_ASSERT_EQ(t, ref[i], "%s", dates[i]);
+            Z_ASSERT_LE(ps_len(&ps), 1, "%s", dates[i]);
+        }
+
+        /* Layouts and ranges left to the generic parser. */
+#define CHECK_DATE(str, res)  do {                                           \
+            time_t ts;                                                       \
+            Z_ASSERT_N(time_parse_iso8601s(str, &ts));                       \
+            Z_ASSERT_EQ(ts, res);                                            \
+        } while (0)
+
+        CHECK_DATE("2007-03-06T11:34:60Z", 1173180900);
+        CHECK_DATE("2007-03-06T24:00:00Z", 1173225600);
+        CHECK_DATE("2007-03-06T11:34:13.Z", 1173180853);
+        CHECK_DATE("2007-3-06T11:34:13Z", 1173180853);
+        CHECK_DATE("2007-03-06T11:34:13GMT", 1173180853);
+        CHECK_DATE("2007-03-06T11:34:13", 1173180853 + timezone);
+#undef CHECK_DATE
+
+        for (int i = 0; i < countof(invalid); i++) {
+            time_t t;
+
+            Z_ASSERT_NEG(time_parse_iso8601s(invalid[i], &t), "%s",
+                         invalid[i]);
+        }
+    } Z_TEST_END;
+
     Z_TEST(nb_leap_years_since_1900, "time: nb_leap_years_since_1900") {
         Z_ASSERT_EQ(0, nb_leap_years_since_1900(1900));
         Z_ASSERT_EQ(28, nb_leap_years_since_1900(2015));
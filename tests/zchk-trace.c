@@ -0,0 +1,155 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+/* LCOV_EXCL_START */
+
+#include <lib-common/trace.h>
+#include <lib-common/z.h>
+
+qvector_t(trace_record, trace_record_t);
+
+static struct {
+    spinlock_t lock;
+    qv_t(trace_record) recs;
+} z_trace_g;
+
+static void z_trace_export(const trace_record_t *recs, int len, void *priv)
+{
+    spin_lock(&z_trace_g.lock);
+    qv_extend(&z_trace_g.recs, recs, len);
+    spin_unlock(&z_trace_g.lock);
+}
+
+Z_GROUP_EXPORT(trace)
+{
+    Z_TEST(traceparent, "W3C traceparent header") {
+        SB_1k(sb);
+        trace_ctx_t ctx;
+        const char *invalid[] = {
+            "",
+            "00-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331",
+            "00-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01-x",
+            "ff-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01",
+            "00-00000000000000000000000000000000-b7ad6b7169203331-01",
+            "00-0af7651916cd43dd8448eb211c80319c-0000000000000000-01",
+            "00-0af7651916cd43dd8448eb211c80319g-b7ad6b7169203331-01",
+            "00_0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01",
+        };
+
+        Z_ASSERT_N(trace_ctx_parse_traceparent(LSTR("00-0af7651916cd43dd8448"
+            "eb211c80319c-b7ad6b7169203331-01"), &ctx));
+        Z_ASSERT_EQ(ctx.trace_hi, 0x0af7651916cd43ddULL);
+        Z_ASSERT_EQ(ctx.trace_lo, 0x8448eb211c80319cULL);
+        Z_ASSERT_EQ(ctx.span_id, 0xb7ad6b7169203331ULL);
+
+        sb_add_traceparent(&sb, &ctx);
+        Z_ASSERT_STREQUAL(sb.data, "00-0af7651916cd43dd8448eb211c80319c-"
+                          "b7ad6b7169203331-01");
+
+        /* not sampled */
+        Z_ASSERT_N(trace_ctx_parse_traceparent(LSTR("00-0af7651916cd43dd8448"
+            "eb211c80319c-b7ad6b7169203331-00"), &ctx));
+        Z_ASSERT(!trace_ctx_is_sampled(&ctx));
+
+        /* future versions can have more fields */
+        Z_ASSERT_N(trace_ctx_parse_traceparent(LSTR("01-0af7651916cd43dd8448"
+            "eb211c80319c-b7ad6b7169203331-01-what"), &ctx));
+        Z_ASSERT(trace_ctx_is_sampled(&ctx));
+
+        carray_for_each_entry(s, invalid) {
+            Z_ASSERT_NEG(trace_ctx_parse_traceparent(LSTR(s), &ctx), "%s", s);
+            Z_ASSERT(!trace_ctx_is_sampled(&ctx));
+        }
+    } Z_TEST_END;
+
+    Z_TEST(spans, "sampling and parents of the spans") {
+        trace_ctx_t remote = {
+            .trace_hi = 1,
+            .trace_lo = 2,
+            .span_id  = 3,
+        };
+        trace_span_t root, child, span;
+        trace_ctx_t prev;
+
+        trace_set_sample_rate(0);
+        Z_ASSERT(!trace_span_start(&span, "root", NULL));
+
+        /* the remote callers decide */
+        Z_ASSERT(trace_span_start(&span, "remote", &remote));
+        Z_ASSERT_EQ(span.ctx.trace_hi, 1U);
+        Z_ASSERT_EQ(span.ctx.trace_lo, 2U);
+        Z_ASSERT_EQ(span.parent_id, 3U);
+        Z_ASSERT(span.ctx.span_id != 3);
+
+        trace_set_sample_rate(1);
+        Z_ASSERT(trace_span_start(&root, "root", NULL));
+        Z_ASSERT_ZERO(root.parent_id);
+
+        prev = trace_span_enter(&root);
+        Z_ASSERT(trace_span_start(&child, "child", NULL));
+        Z_ASSERT_EQ(child.ctx.trace_hi, root.ctx.trace_hi);
+        Z_ASSERT_EQ(child.ctx.trace_lo, root.ctx.trace_lo);
+        Z_ASSERT_EQ(child.parent_id, root.ctx.span_id);
+        trace_span_leave(prev);
+        Z_ASSERT(!trace_ctx_is_sampled(&trace_ctx_g));
+        trace_set_sample_rate(0);
+    } Z_TEST_END;
+
+    Z_TEST(export, "export of the ended spans") {
+        trace_span_t root, child;
+        trace_ctx_t prev;
+        trace_stats_t stats;
+        uint64_t exported;
+
+        qv_init(&z_trace_g.recs);
+        trace_get_stats(&stats);
+        exported = stats.exported;
+
+        Z_ASSERT_N(trace_set_exporter(&z_trace_export, NULL));
+        trace_set_sample_rate(1);
+        trace_span_start(&root, "root", NULL);
+        prev = trace_span_enter(&root);
+        trace_span_start(&child, "child", NULL);
+        trace_span_end(&child, 42);
+        trace_span_leave(prev);
+        trace_span_end(&root, 0);
+        trace_set_sample_rate(0);
+
+        /* stopping the exporter exports the pending records */
+        Z_ASSERT_N(trace_set_exporter(NULL, NULL));
+        Z_ASSERT_EQ(z_trace_g.recs.len, 2);
+        Z_ASSERT_STREQUAL(z_trace_g.recs.tab[0].name, "child");
+        Z_ASSERT_EQ(z_trace_g.recs.tab[0].status, 42);
+        Z_ASSERT_EQ(z_trace_g.recs.tab[0].parent_id, root.ctx.span_id);
+        Z_ASSERT_STREQUAL(z_trace_g.recs.tab[1].name, "root");
+        Z_ASSERT(z_trace_g.recs.tab[1].duration
+               >= z_trace_g.recs.tab[0].duration);
+        trace_get_stats(&stats);
+        Z_ASSERT_EQ(stats.exported, exported + 2);
+
+        /* nothing is recorded without exporter */
+        trace_set_sample_rate(1);
+        trace_span_start(&root, "root", NULL);
+        trace_span_end(&root, 0);
+        trace_set_sample_rate(0);
+        Z_ASSERT_EQ(z_trace_g.recs.len, 2);
+        qv_wipe(&z_trace_g.recs);
+    } Z_TEST_END;
+} Z_GROUP_END;
+
+/* LCOV_EXCL_STOP */
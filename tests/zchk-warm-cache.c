@@ -0,0 +1,124 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+/* LCOV_EXCL_START */
+
+#include <lib-common/container-qhash.h>
+#include <lib-common/warm-cache.h>
+#include <lib-common/z.h>
+
+qm_k64_t(z_warm, uint64_t);
+
+static int z_warm_dump(int fd, void *priv)
+{
+    return qm_dump(z_warm, priv, fd);
+}
+
+Z_GROUP_EXPORT(warm_cache)
+{
+    Z_TEST(roundtrip, "entries saved and restored by the next run") {
+        t_scope;
+        const char *path = t_fmt("%*pM/warm", LSTR_FMT_ARG(z_tmpdir_g));
+        const char *cfg = t_fmt("%*pM/cfg", LSTR_FMT_ARG(z_tmpdir_g));
+        warm_cache_stats_t start;
+        warm_cache_stats_t stats;
+        qm_t(z_warm) map;
+        uint64_t inputs;
+        lstr_t data;
+
+        warm_cache_get_stats(&start);
+        Z_ASSERT_N(xwrite_file(cfg, "a = 1", 5));
+        inputs = warm_cache_hash_file(0, cfg);
+
+        /* first run, nothing in the cache */
+        Z_ASSERT_N(warm_cache_open(path));
+        Z_ASSERT_NEG(warm_cache_open(path), "already opened");
+        Z_ASSERT_NULL(warm_cache_get("blob", 1, inputs).s);
+
+        qm_init(z_warm, &map);
+        for (uint64_t i = 0; i < 1000; i++) {
+            qm_add(z_warm, &map, i, 3 * i);
+        }
+        Z_ASSERT_N(warm_cache_put("blob", 1, inputs, LSTR("derived")));
+        Z_ASSERT_NEG(warm_cache_put("blob", 1, inputs, LSTR("twice")));
+        Z_ASSERT_N(warm_cache_put_cb("map", 2, inputs, &z_warm_dump, &map));
+        Z_ASSERT_N(warm_cache_put("other", 1, 0, LSTR("kept")));
+        qm_wipe(z_warm, &map);
+        Z_ASSERT_N(warm_cache_save());
+        Z_ASSERT(access(t_fmt("%s.tmp", path), F_OK) < 0);
+        warm_cache_close();
+
+        /* second run, the entries are restored, the map in place */
+        Z_ASSERT_N(warm_cache_open(path));
+        Z_ASSERT_LSTREQUAL(warm_cache_get("blob", 1, inputs),
+                           LSTR("derived"));
+        data = warm_cache_get("map", 2, inputs);
+        Z_ASSERT_P(data.s);
+        Z_ASSERT_EQ((uintptr_t)data.s % 64, 0u);
+        qm_init(z_warm, &map);
+        Z_ASSERT_EQ(qm_attach(z_warm, &map, data.s, data.len), data.len);
+        Z_ASSERT_EQ(qm_len(z_warm, &map), 1000u);
+        for (uint64_t i = 0; i < 1000; i++) {
+            Z_ASSERT_EQ(qm_get_def_safe(z_warm, &map, i, 0), 3 * i);
+        }
+        qm_wipe(z_warm, &map);
+
+        /* the inputs change: the entries derived from them are stale */
+        Z_ASSERT_N(xwrite_file(cfg, "a = 2", 5));
+        inputs = warm_cache_hash_file(0, cfg);
+        Z_ASSERT_NULL(warm_cache_get("blob", 1, inputs).s);
+        Z_ASSERT_NULL(warm_cache_get("map", 3, inputs).s, "new version");
+        Z_ASSERT_N(warm_cache_put("blob", 1, inputs, LSTR("rebuilt")));
+        Z_ASSERT_N(warm_cache_save());
+        Z_ASSERT_LSTREQUAL(warm_cache_get("other", 1, 0), LSTR("kept"),
+                           "the data outlives the save");
+        warm_cache_close();
+
+        /* third run, the untouched entry was carried over */
+        Z_ASSERT_N(warm_cache_open(path));
+        Z_ASSERT_LSTREQUAL(warm_cache_get("blob", 1, inputs),
+                           LSTR("rebuilt"));
+        Z_ASSERT_NULL(warm_cache_get("map", 2, inputs).s);
+        Z_ASSERT_LSTREQUAL(warm_cache_get("other", 1, 0), LSTR("kept"));
+        warm_cache_get_stats(&stats);
+        Z_ASSERT_EQ(stats.hits - start.hits, 5u);
+        Z_ASSERT_EQ(stats.misses - start.misses, 4u);
+        Z_ASSERT_EQ(stats.puts - start.puts, 4u);
+        warm_cache_close();
+    } Z_TEST_END;
+
+    Z_TEST(invalid, "invalid cache files are ignored") {
+        t_scope;
+        const char *path = t_fmt("%*pM/warm", LSTR_FMT_ARG(z_tmpdir_g));
+
+        Z_ASSERT_N(xwrite_file(path, "garbage", 7));
+        Z_ASSERT_N(warm_cache_open(path));
+        Z_ASSERT_NULL(warm_cache_get("blob", 1, 0).s);
+        Z_ASSERT_N(warm_cache_put("blob", 1, 0, LSTR("data")));
+        Z_ASSERT_N(warm_cache_save());
+        warm_cache_close();
+
+        /* truncated */
+        Z_ASSERT_N(truncate(path, 100));
+        Z_ASSERT_N(warm_cache_open(path));
+        Z_ASSERT_NULL(warm_cache_get("blob", 1, 0).s);
+        warm_cache_close();
+    } Z_TEST_END;
+} Z_GROUP_END;
+
+/* LCOV_EXCL_STOP */
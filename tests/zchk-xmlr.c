@@ -124,6 +124,72 @@ Z_GROUP_EXPORT(xmlr)
         Z_ASSERT_ZERO(xmlr_node_skip_s(xmlr_g, "child", XMLR_ENTER_EMPTY_OK));
         Z_ASSERT_ZERO(xmlr_node_close(xmlr_g));
     } Z_TEST_END;
+
+    Z_TEST(values, "entities, CDATA, comments and attributes") {
+        t_scope;
+        lstr_t xml = LSTR("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                          "<!-- header -->\n"
+                          "<root a='x &amp; &#x41;&#66;' b=\"1\r\n2\">\n"
+                          "  <s>a &lt;b&gt; &quot;c&apos; &#xe9;</s>\n"
+                          "  <c><![CDATA[x<y&z]]></c>\n"
+                          "  <m>a<!-- x -->b<?pi?>c</m>\n"
+                          "  <i> 42 </i>\n"
+                          "  <e/>\n"
+                          "  <x><y a='1'>t<z/></y>tail</x>\n"
+                          "  <bad>&foo;</bad>\n"
+                          "</root>\n");
+        const xmlr_attr_t *attr;
+        lstr_t val;
+        int64_t i64;
+
+        Z_ASSERT_N(xmlr_setup(&xmlr_g, xml.s, xml.len));
+        Z_ASSERT_EQ(xmlr_node_is_s(xmlr_g, "root"), 1);
+        attr = xmlr_find_attr_s(xmlr_g, "a", true);
+        Z_ASSERT_P(attr);
+        Z_ASSERT_N(t_xmlr_getattr_str(xmlr_g, attr, false, &val));
+        Z_ASSERT_LSTREQUAL(val, LSTR("x & AB"));
+        attr = xmlr_find_attr_s(xmlr_g, "b", true);
+        Z_ASSERT_P(attr);
+        Z_ASSERT_N(t_xmlr_getattr_str(xmlr_g, attr, false, &val));
+        Z_ASSERT_LSTREQUAL(val, LSTR("1 2"));
+        Z_ASSERT_NULL(xmlr_find_attr_s(xmlr_g, "c", false));
+
+        Z_ASSERT_EQ(xmlr_node_open_s(xmlr_g, "root"), 1);
+        Z_ASSERT_N(t_xmlr_get_str(xmlr_g, false, &val));
+        Z_ASSERT_LSTREQUAL(val, LSTR("a <b> \"c' \xc3\xa9"));
+        Z_ASSERT_N(t_xmlr_get_str(xmlr_g, false, &val));
+        Z_ASSERT_LSTREQUAL(val, LSTR("x<y&z"));
+        Z_ASSERT_N(t_xmlr_get_str(xmlr_g, false, &val));
+        Z_ASSERT_LSTREQUAL(val, LSTR("abc"));
+        Z_ASSERT_N(xmlr_get_i64(xmlr_g, &i64));
+        Z_ASSERT_EQ(i64, 42);
+        Z_ASSERT_N(t_xmlr_get_str(xmlr_g, true, &val));
+        Z_ASSERT_EQ(val.len, 0);
+        Z_ASSERT_EQ(xmlr_node_is_s(xmlr_g, "x"), 1);
+        Z_ASSERT_N(xmlr_get_inner_xml(xmlr_g, &val));
+        Z_ASSERT_LSTREQUAL(val, LSTR("<y a='1'>t<z/></y>tail"));
+        lstr_wipe(&val);
+        Z_ASSERT_EQ(xmlr_node_is_s(xmlr_g, "bad"), 1);
+        Z_ASSERT_NEG(t_xmlr_get_str(xmlr_g, false, &val));
+        xmlr_close(&xmlr_g);
+    } Z_TEST_END;
+
+    Z_TEST(syntax_errors, "malformed documents are rejected") {
+        const char *docs[] = {
+            "", "<a>", "<a></b>", "<a><b></a>", "<a/><b/>", "x<a/>",
+            "<a x=1/>", "<a x='1'y='2'/>", "<a x='<'/>", "<a/>junk",
+        };
+
+        carray_for_each_entry(doc, docs) {
+            int res = xmlr_setup(&xmlr_g, doc, strlen(doc));
+
+            if (res >= 0) {
+                res = xmlr_next_sibling(xmlr_g);
+            }
+            Z_ASSERT_NEG(res, "`%s` should be rejected", doc);
+            xmlr_close(&xmlr_g);
+        }
+    } Z_TEST_END;
 } Z_GROUP_END;
 
 /* LCOV_EXCL_STOP */
@@ -481,6 +481,31 @@ Z_GROUP_EXPORT(bit_stream)
         Z_ASSERT_NEG(bs_be_get_bits(&bs, 1, &res));
     } Z_TEST_END;
 
+    Z_TEST(be_get_bits_multi, "bit_stream: bs_be_get_bits on several bits") {
+        byte data[32];
+
+        for (int i = 0; i < countof(data); i++) {
+            data[i] = 0x5b * i + 0x31;
+        }
+
+        /* Compare with a bit by bit read, across the 64-bits words. */
+        for (int start = 0; start < 128; start++) {
+            for (int blen = 1; blen <= 64; blen++) {
+                bit_stream_t bs = bs_init(data, start, 256 - start);
+                bit_stream_t bits = bs;
+                uint64_t res = 0;
+                uint64_t exp = 0;
+
+                for (int i = 0; i < blen; i++) {
+                    exp = (exp << 1) | bs_be_get_bit(&bits);
+                }
+                Z_ASSERT_EQ(bs_be_get_bits(&bs, blen, &res), blen);
+                Z_ASSERT_EQ(res, exp, "start %d, blen %d", start, blen);
+                Z_ASSERT_EQ(bs_len(&bs), bs_len(&bits));
+            }
+        }
+    } Z_TEST_END;
+
     /* }}} */
     /* Scans {{{ */
 
@@ -17,6 +17,7 @@
 /***************************************************************************/
 
 #include <lib-common/qlzo.h>
+#include <lib-common/thr.h>
 
 #define MODE_C  0
 #define MODE_D  1
@@ -77,6 +78,29 @@ static int do_self_test(void)
         olen = qlzo1x_decompress(obuf, ilen, ps_init(cbuf, clen));
         assert (olen == ilen && memcmp(ibuf, obuf, ilen) == 0);
         e_trace(0, "%d: %zd bytes ok", i, ilen);
+
+        if (i % 16 == 0) {
+            /* Parallel compression of a larger buffer, made of copies of
+             * the random one, so that it is partly compressible. */
+            ssize_t mt_ilen = 16 * ilen + rand_range(0, 100);
+            char *mt_ibuf = t_new_raw(char, mt_ilen);
+            char *mt_obuf = t_new_raw(char, mt_ilen);
+
+            for (ssize_t j = 0; j < mt_ilen; j++) {
+                mt_ibuf[j] = ibuf[rand_range(0, MAX(ilen - 1, 0))];
+                if (ilen && j >= ilen && rand_range(0, 4)) {
+                    mt_ibuf[j] = mt_ibuf[j - ilen];
+                }
+            }
+            clen = lzo_cbuf_size(mt_ilen);
+            cbuf = t_new_raw(char, clen + LZO_INPUT_PADDING);
+            clen = qlzo1x_compress_mt(cbuf, clen, ps_init(mt_ibuf, mt_ilen),
+                                      64 << 10);
+
+            olen = qlzo1x_decompress(mt_obuf, mt_ilen, ps_init(cbuf, clen));
+            assert (olen == mt_ilen && memcmp(mt_ibuf, mt_obuf, olen) == 0);
+            e_trace(0, "%d: %zd bytes ok in parallel", i, mt_ilen);
+        }
     }
 
     return 0;
@@ -100,6 +124,7 @@ int main(int argc, char **argv)
             out = optarg;
             break;
           case 'r':
+            MODULE_REQUIRE(thr);
             return do_self_test();
           default:
             fprintf(stderr, "error: unknown option '%c'", c);